@@ -0,0 +1,279 @@
+﻿/**
+ * \brief Starting point for the benchmark-suite: Simulates a fixed list of scenes headless and reports the timing.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#include <osg/Timer>
+
+#include <boost/program_options.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <json.hpp>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "../scene/SceneManager.h"
+#include "../scene/BinaryScene.h"
+#include "../scene/SceneGenerator.h"
+#include "../scene/SpaceObject.h"
+#include "../physics/SimulationManager.h"
+#include "../physics/Profiler.h"
+#include "../osg/AssetCache.h"
+#include "../config.h"
+
+
+using namespace boost::program_options;
+// for convenience
+using json = nlohmann::json;
+
+
+namespace {
+
+	/**
+	 * \brief Scene of the suite: Either a json-file of the demo-scenes or the arguments of an emitter.
+	 */
+	struct BenchScene {
+		//! Name in the report
+		std::string name;
+		//! Json-file relative to the demo-scenes ("" => emitted)
+		std::string file;
+		//! Command-line of the emitter (same options as asteroid_field)
+		std::vector<std::string> emitter;
+	};
+
+
+	/**
+	 * \brief Get the fixed list of scenes, from two bodies up to the emitted galaxy. The emitters have fixed seeds.
+	 */
+	std::vector<BenchScene> getScenes() {
+		return {
+			{ "twoBody", "circularOrbit.json", {} },
+			{ "ellipticalOrbit", "ellipticalOrbit.json", {} },
+			{ "figureEight", "figureEight.json", {} },
+			{ "solarSystem", "solarSystem.json", {} },
+			{ "spiralAsteroidField", "spiralAsteroidField.json", {} },
+			{ "galaxyDemo", "galaxy/galaxy.json", {} },
+			{ "sphere1k", "", { "--emitter", "sphere", "--spheres", "1000", "--seed", "1" } },
+			{ "belt10k", "", { "--emitter", "belt", "--asteroids", "10000", "--seed", "1" } },
+			{ "galaxy20k", "", { "--emitter", "galaxy", "--asteroids", "20000", "--rings", "50", "--seed", "1" } }
+		};
+	}
+
+
+	/**
+	 * \brief Get the peak resident set size of the process (it only grows, so it's the maximum of all scenes so far).
+	 *
+	 * \return Peak RSS in kilobytes.
+	 */
+	long getPeakRss() {
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+			return static_cast<long>(counters.PeakWorkingSetSize / 1024);
+		}
+		return 0;
+#else
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+		return usage.ru_maxrss / 1024;
+#else
+		return usage.ru_maxrss;
+#endif
+#endif
+	}
+
+
+	/**
+	 * \brief Load a scene of the suite into the scene-manager.
+	 *
+	 * \param scene
+	 *      Scene of the suite.
+	 * \param sceneManager
+	 *      Scene-manager which constructs the space-objects.
+	 *
+	 * \return False if the scene can't be loaded.
+	 */
+	bool loadScene(const BenchScene &scene, pbs17::SceneManager &sceneManager) {
+		if (scene.file != "") {
+			std::ifstream stream(SCENES_PATH + "/" + scene.file);
+			if (!stream) return false;
+
+			sceneManager.loadScene(stream);
+			return true;
+		}
+
+		// the emitter gets the same defaults as the main program
+		options_description desc{ "Emitter" };
+		desc.add_options()
+			("spheres,s", value<int>()->default_value(10), "Spheres")
+			("asteroids,a", value<int>()->default_value(0), "Asteroids")
+			("emitter,e", value<std::string>()->default_value("sphere"), "Emitter")
+			("rings", value<int>()->default_value(50), "Rings")
+			("seed", value<unsigned int>()->default_value(0), "Seed")
+			("rand,r", value<bool>()->default_value(true), "Random")
+			("gameplay,g", value<bool>()->default_value(false), "Gameplay");
+
+		variables_map vm;
+		store(command_line_parser(scene.emitter).options(desc).run(), vm);
+		notify(vm);
+
+		pbs17::BinaryScene binaryScene;
+		if (!pbs17::SceneGenerator::generate(vm, binaryScene)) return false;
+
+		sceneManager.loadScene(binaryScene);
+		return true;
+	}
+}
+
+
+int main(int argc, const char *argv[]) {
+	variables_map vm;
+
+	options_description desc{ "Options" };
+	desc.add_options()
+		("help,h", "Help screen")
+		("steps", value<int>()->default_value(500), "Number of steps per scene")
+		("warmup", value<int>()->default_value(10), "Number of steps per scene which are not measured")
+		("scene", value<std::vector<std::string>>(), "Run only these scenes (default: all)")
+		("output,o", value<std::string>(), "Write the report into this file (default: stdout)")
+		("gravitySolver", value<std::string>(), "Gravity solver of all scenes (direct, spatialGrid, barnesHut, particleMesh, gpu, fmm, gpuBarnesHut)")
+		("integrator", value<std::string>(), "Integrator of all scenes (euler, leapfrog, velocityVerlet, yoshida, wisdomHolman, hermite)")
+		("broadPhase", value<std::string>(), "Broad-phase of all scenes (incremental, singleAxis, aabbTree, spatialHash, gpu)");
+
+	try {
+		store(parse_command_line(argc, argv, desc), vm);
+		notify(vm);
+	}
+	catch (const error &ex) {
+		std::cerr << ex.what() << '\n';
+		return 1;
+	}
+
+	if (vm.count("help")) {
+		std::cout << desc << '\n';
+		return 0;
+	}
+
+	// only the physics-representation is simulated, the prepared hulls of the cache would hide the loading
+	pbs17::SpaceObject::setIsHeadless(true);
+	pbs17::AssetCache::setIsEnabled(false);
+	pbs17::Profiler::setIsEnabled(true);
+
+	int steps = vm["steps"].as<int>();
+	int warmup = vm["warmup"].as<int>();
+	std::vector<std::string> selected = vm.count("scene") ? vm["scene"].as<std::vector<std::string>>() : std::vector<std::string>();
+
+	std::ofstream file;
+	if (vm.count("output")) {
+		file.open(vm["output"].as<std::string>());
+		if (!file) {
+			std::cerr << "File " + vm["output"].as<std::string>() + " can't be written!" << '\n';
+			return 1;
+		}
+	}
+	std::ostream &report = vm.count("output") ? file : std::cout;
+
+	const osg::Timer* timer = osg::Timer::instance();
+	pbs17::Profiler* profiler = pbs17::Profiler::Instance();
+	int threads = 1;
+#if defined(_OPENMP)
+	threads = omp_get_max_threads();
+#endif
+
+	std::vector<BenchScene> scenes = getScenes();
+	for (unsigned int s = 0; s < scenes.size(); ++s) {
+		const BenchScene &scene = scenes[s];
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), scene.name) == selected.end()) continue;
+
+		pbs17::SceneManager* sceneManager = new pbs17::SceneManager;
+		osg::Timer_t loadStart = timer->tick();
+
+		if (!loadScene(scene, *sceneManager)) {
+			std::cerr << "Scene " + scene.name + " can't be loaded!" << '\n';
+			delete sceneManager;
+			continue;
+		}
+
+		double loadTime = timer->delta_s(loadStart, timer->tick());
+
+		// the same overrides as the main program, so the backends can be compared on the same scenes
+		json settings = sceneManager->getSimulationSettings();
+		if (vm.count("gravitySolver")) {
+			settings["gravitySolver"] = vm["gravitySolver"].as<std::string>();
+		}
+		if (vm.count("integrator")) {
+			settings["integrator"] = vm["integrator"].as<std::string>();
+		}
+		if (vm.count("broadPhase")) {
+			settings["broadPhase"] = vm["broadPhase"].as<std::string>();
+		}
+
+		pbs17::SimulationManager* simulationManager = new pbs17::SimulationManager(sceneManager->getSpaceObjects(), settings);
+		double dt = simulationManager->getSimulationDt();
+		unsigned int cntBodies = simulationManager->getSpaceObjects().size();
+
+		for (int i = 0; i < warmup; ++i) {
+			simulationManager->step(dt);
+		}
+
+		profiler->reset();
+		osg::Timer_t start = timer->tick();
+
+		for (int i = 0; i < steps; ++i) {
+			osg::Timer_t stepStart = timer->tick();
+			simulationManager->step(dt);
+			profiler->endFrame(timer->delta_s(stepStart, timer->tick()));
+		}
+
+		double duration = timer->delta_s(start, timer->tick());
+
+		// one json-object per line (times in milliseconds)
+		json phases = json::object();
+		for (int i = 0; i <= pbs17::Profiler::CNT_PHASES; ++i) {
+			pbs17::Profiler::Phase phase = static_cast<pbs17::Profiler::Phase>(i);
+			phases[pbs17::Profiler::getPhaseName(phase)] = {
+				{ "total", 1000.0 * profiler->getTotal(phase) },
+				{ "p50", 1000.0 * profiler->getPercentile(phase, 50.0) },
+				{ "p95", 1000.0 * profiler->getPercentile(phase, 95.0) },
+				{ "p99", 1000.0 * profiler->getPercentile(phase, 99.0) }
+			};
+		}
+
+		json result = {
+			{ "scene", scene.name },
+			{ "version", VERSION },
+			{ "bodies", cntBodies },
+			{ "steps", steps },
+			{ "threads", threads },
+			{ "settings", settings },
+			{ "loadTime", loadTime },
+			{ "time", duration },
+			{ "bodyStepsPerSecond", duration > 0.0 ? cntBodies * static_cast<double>(steps) / duration : 0.0 },
+			{ "peakRssKb", getPeakRss() },
+			{ "phases", phases }
+		};
+		report << result.dump() << std::endl;
+
+		delete simulationManager;
+		delete sceneManager;
+	}
+
+	return 0;
+}
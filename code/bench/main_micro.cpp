@@ -0,0 +1,466 @@
+﻿/**
+ * \brief Starting point for the micro-benchmarks of the collision- and gravity-kernels.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#include <osg/Timer>
+#include <osg/Quat>
+
+#include <boost/program_options.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdint.h>
+#include <json.hpp>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "../scene/SceneManager.h"
+#include "../scene/BinaryScene.h"
+#include "../scene/SceneGenerator.h"
+#include "../scene/SpaceObject.h"
+#include "../physics/SweepAndPrune.h"
+#include "../physics/GravityKernel.h"
+#include "../physics/GpuGravity.h"
+#include "../physics/FastMultipole.h"
+#include "../physics/BodyState.h"
+#include "../graphics/GjkAlgorithm.h"
+#include "../graphics/ConvexHull3D.h"
+#include "../graphics/SoaVertices.h"
+#include "../osg/ModelManager.h"
+#include "../osg/AssetCache.h"
+#include "../config.h"
+
+
+using namespace pbs17;
+using namespace boost::program_options;
+// for convenience
+using json = nlohmann::json;
+
+
+namespace {
+
+	//! Number of timed repetitions of each benchmark (the median is reported)
+	int CNT_RUNS = 7;
+
+	//! Minimal time of a run in seconds (the iterations per run are increased until it's reached)
+	double MIN_RUN_TIME = 0.05;
+
+
+	/**
+	 * \brief Deterministic random numbers (xorshift), so each run uses the same inputs.
+	 */
+	class Random {
+	public:
+		explicit Random(uint64_t seed) : _state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+		//! Uniform random number in [0, 1).
+		double next() {
+			_state ^= _state << 13;
+			_state ^= _state >> 7;
+			_state ^= _state << 17;
+			return (_state >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+	private:
+		uint64_t _state;
+	};
+
+
+	/**
+	 * \brief Time a kernel: The iterations per run are calibrated to MIN_RUN_TIME, then CNT_RUNS runs are measured.
+	 *
+	 * \param name
+	 *      Name of the benchmark in the report.
+	 * \param params
+	 *      Parameters of the benchmark (written to the report).
+	 * \param kernel
+	 *      Kernel which is called once per iteration (the argument is the index of the iteration).
+	 * \param report
+	 *      Output-parameter: Stream of the json-lines.
+	 */
+	template <typename Kernel>
+	void measure(const std::string &name, const json &params, Kernel kernel, std::ostream &report) {
+		const osg::Timer* timer = osg::Timer::instance();
+		unsigned long iterations = 1;
+		unsigned long counter = 0;
+
+		// calibrate the iterations per run (the first calls also warm up the caches)
+		while (true) {
+			osg::Timer_t start = timer->tick();
+			for (unsigned long i = 0; i < iterations; ++i) {
+				kernel(counter++);
+			}
+			double time = timer->delta_s(start, timer->tick());
+
+			if (time >= MIN_RUN_TIME || iterations >= (1ul << 30)) break;
+			iterations *= time > 0.0 ? std::max(2ul, std::min(100ul, static_cast<unsigned long>(MIN_RUN_TIME / time) + 1)) : 100ul;
+		}
+
+		std::vector<double> runs(CNT_RUNS);
+		for (int r = 0; r < CNT_RUNS; ++r) {
+			osg::Timer_t start = timer->tick();
+			for (unsigned long i = 0; i < iterations; ++i) {
+				kernel(counter++);
+			}
+			runs[r] = timer->delta_s(start, timer->tick()) / iterations;
+		}
+
+		std::sort(runs.begin(), runs.end());
+
+		json result = {
+			{ "benchmark", name },
+			{ "params", params },
+			{ "iterations", iterations },
+			{ "median_ns", 1e9 * runs[CNT_RUNS / 2] },
+			{ "min_ns", 1e9 * runs.front() },
+			{ "max_ns", 1e9 * runs.back() }
+		};
+		report << result.dump() << std::endl;
+	}
+
+
+	/**
+	 * \brief Transform the vertices of a hull into the world-space (same as the world-hull of a space-object).
+	 *
+	 * \param vertices
+	 *      Vertices in the model-space.
+	 * \param rotation, translation
+	 *      Transformation of the instance.
+	 * \param res
+	 *      Output-parameter: Transformed vertices (resized).
+	 */
+	void transformHull(const std::vector<Eigen::Vector3d> &vertices, const Eigen::Matrix3d &rotation, const Eigen::Vector3d &translation,
+		std::vector<Eigen::Vector3d> &res) {
+		res.resize(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); ++i) {
+			res[i] = rotation * vertices[i] + translation;
+		}
+	}
+
+
+	/**
+	 * \brief GJK/EPA on pairs of asteroid-hulls: separated, overlapping (with EPA) and with the linear scan and the
+	 * hill-climbing support-mapping.
+	 *
+	 * \param report
+	 *      Output-parameter: Stream of the json-lines.
+	 */
+	void benchGjk(std::ostream &report) {
+		const int models[][2] = { { 1, 2 }, { 5, 17 }, { 11, 30 } };
+		// distance of the centers in radii of the first hull
+		const double distances[] = { 3.0, 0.75, 0.25 };
+
+		for (const int (&pair)[2] : models) {
+			const ConvexHull3D* hull1 = ModelManager::Instance()->loadConvexHull(DATA_PATH + "/asteroid" + std::to_string(pair[0]) + ".obj", false);
+			const ConvexHull3D* hull2 = ModelManager::Instance()->loadConvexHull(DATA_PATH + "/asteroid" + std::to_string(pair[1]) + ".obj", false);
+
+			double radius = 0.0;
+			for (const Eigen::Vector3d &v : hull1->getVertices()) {
+				radius = std::max(radius, v.norm());
+			}
+			for (const Eigen::Vector3d &v : hull2->getVertices()) {
+				radius = std::max(radius, v.norm());
+			}
+
+			// a few orientations, so the results do not depend on a single lucky direction
+			const int cntPoses = 16;
+			Random random(pair[0] * 31 + pair[1]);
+			std::vector<Eigen::Matrix3d> rotations(cntPoses);
+			for (int k = 0; k < cntPoses; ++k) {
+				Eigen::Vector3d axis(random.next() - 0.5, random.next() - 0.5, random.next() - 0.5);
+				rotations[k] = Eigen::AngleAxisd(2.0 * MATH_PI * random.next(), axis.normalized()).toRotationMatrix();
+			}
+
+			for (double distance : distances) {
+				Eigen::Vector3d offset(distance * radius, 0.0, 0.0);
+				json params = {
+					{ "hulls", { "asteroid" + std::to_string(pair[0]), "asteroid" + std::to_string(pair[1]) } },
+					{ "vertices", { hull1->getVertices().size(), hull2->getVertices().size() } },
+					{ "distance", distance }
+				};
+
+				std::vector<std::vector<Eigen::Vector3d>> world1(cntPoses), world2(cntPoses);
+				std::vector<SoaVertices> soa1(cntPoses), soa2(cntPoses);
+				for (int k = 0; k < cntPoses; ++k) {
+					transformHull(hull1->getVertices(), rotations[k], Eigen::Vector3d::Zero(), world1[k]);
+					transformHull(hull2->getVertices(), rotations[(k + 1) % cntPoses], offset, world2[k]);
+					soa1[k].assign(world1[k], Eigen::Vector3d::Zero());
+					soa2[k].assign(world2[k], offset);
+				}
+
+				measure("gjkLinearScan", params, [&](unsigned long i) {
+					Collision collision;
+					GjkAlgorithm::intersect(world1[i % cntPoses], world2[i % cntPoses], collision);
+				}, report);
+
+				measure("gjkHillClimbing", params, [&](unsigned long i) {
+					Collision collision;
+					ConvexShape shape1(world1[i % cntPoses], hull1->getAdjacencyStart(), hull1->getAdjacency(), 0);
+					ConvexShape shape2(world2[i % cntPoses], hull2->getAdjacencyStart(), hull2->getAdjacency(), 0);
+					GjkAlgorithm::intersect(shape1, shape2, collision);
+				}, report);
+
+				measure("gjkVectorizedScan", params, [&](unsigned long i) {
+					Collision collision;
+					ConvexShape shape1(world1[i % cntPoses], &soa1[i % cntPoses]);
+					ConvexShape shape2(world2[i % cntPoses], &soa2[i % cntPoses]);
+					GjkAlgorithm::intersect(shape1, shape2, collision);
+				}, report);
+			}
+
+			// the world-hull is transformed again, whenever an object has moved
+			std::vector<Eigen::Vector3d> world;
+			measure("hullTransform", { { "hull", "asteroid" + std::to_string(pair[0]) }, { "vertices", hull1->getVertices().size() } },
+				[&](unsigned long i) {
+				transformHull(hull1->getVertices(), rotations[i % cntPoses], Eigen::Vector3d(1.0, 2.0, 3.0), world);
+			}, report);
+		}
+	}
+
+
+	/**
+	 * \brief Sweep-and-prune on synthetic distributions of spheres, which are jittered each step.
+	 *
+	 * \param report
+	 *      Output-parameter: Stream of the json-lines.
+	 */
+	void benchSweepAndPrune(std::ostream &report) {
+		const char* emitters[] = { "sphere", "cube" };
+		const int sizes[] = { 1000, 10000 };
+
+		for (const char* emitter : emitters) {
+			for (int n : sizes) {
+				// the same options as the main program (random positions with a fixed seed)
+				options_description desc{ "Emitter" };
+				desc.add_options()
+					("spheres,s", value<int>()->default_value(n), "Spheres")
+					("asteroids,a", value<int>()->default_value(0), "Asteroids")
+					("emitter,e", value<std::string>()->default_value(emitter), "Emitter")
+					("rings", value<int>()->default_value(50), "Rings")
+					("seed", value<unsigned int>()->default_value(1), "Seed")
+					("rand,r", value<bool>()->default_value(true), "Random")
+					("gameplay,g", value<bool>()->default_value(false), "Gameplay");
+
+				variables_map vm;
+				store(command_line_parser(std::vector<std::string>()).options(desc).run(), vm);
+				notify(vm);
+
+				BinaryScene binaryScene;
+				SceneGenerator::generate(vm, binaryScene);
+
+				SceneManager* sceneManager = new SceneManager;
+				sceneManager->loadScene(binaryScene);
+				std::vector<SpaceObject*> objects = sceneManager->getSpaceObjects();
+
+				// small random displacements per step, so the incremental mode only has to swap a few endpoints
+				std::vector<Eigen::Vector3d> origins(objects.size());
+				for (unsigned int i = 0; i < objects.size(); ++i) {
+					origins[i] = objects[i]->getPosition();
+				}
+				Random random(n);
+
+				std::vector<SweepAndPrune::Mode> modes = { SweepAndPrune::INCREMENTAL, SweepAndPrune::SINGLE_AXIS };
+				if (GpuBroadPhase::isAvailable()) {
+					modes.push_back(SweepAndPrune::GPU);
+				}
+				for (SweepAndPrune::Mode mode : modes) {
+					SweepAndPrune sweepAndPrune;
+					sweepAndPrune.setMode(mode);
+					sweepAndPrune.init(objects);
+
+					AabbArray aabbs;
+					std::vector<std::pair<SpaceObject *, SpaceObject *>> pairs;
+					json params = {
+						{ "distribution", emitter },
+						{ "objects", objects.size() },
+						{ "mode", mode == SweepAndPrune::INCREMENTAL ? "incremental" : (mode == SweepAndPrune::GPU ? "gpu" : "singleAxis") }
+					};
+
+					measure("sweepAndPrune", params, [&](unsigned long) {
+						for (unsigned int i = 0; i < objects.size(); ++i) {
+							Eigen::Vector3d jitter(random.next() - 0.5, random.next() - 0.5, random.next() - 0.5);
+							objects[i]->setPositionOrientation(origins[i] + 0.01 * jitter, objects[i]->getOrientation());
+						}
+						aabbs.update(objects);
+						sweepAndPrune.update(aabbs, pairs);
+					}, report);
+				}
+
+				delete sceneManager;
+			}
+		}
+	}
+
+
+	/**
+	 * \brief All-pairs gravity kernel (full, symmetric, mixed-precision, fast multipole and on the GPU if available) on a random cloud of bodies.
+	 *
+	 * \param maxBodies
+	 *      Largest number of bodies (the sizes grow by a factor of 10 from 1000).
+	 * \param report
+	 *      Output-parameter: Stream of the json-lines.
+	 */
+	void benchGravityKernel(int maxBodies, std::ostream &report) {
+		for (int n = 1000; n <= maxBodies; n *= 10) {
+			std::vector<double> x(n), y(n), z(n), m(n), ax(n), ay(n), az(n);
+			Random random(n);
+
+			for (int i = 0; i < n; ++i) {
+				x[i] = 100.0 * random.next();
+				y[i] = 100.0 * random.next();
+				z[i] = 100.0 * random.next();
+				m[i] = 1.0 + random.next();
+			}
+
+			json params = { { "bodies", n }, { "instructionSet", GravityKernel::getInstructionSet() } };
+
+			measure("gravityKernel", params, [&](unsigned long) {
+				GravityKernel::computeFields(x.data(), y.data(), z.data(), m.data(), n, 1e-3, ax.data(), ay.data(), az.data());
+			}, report);
+
+			measure("gravityKernelSymmetric", params, [&](unsigned long) {
+				GravityKernel::computeFieldsSymmetric(x.data(), y.data(), z.data(), m.data(), n, 1e-3, ax.data(), ay.data(), az.data());
+			}, report);
+
+			// error of the mixed-precision kernel relative to the double precision field (normalized by the sum of
+			// the magnitudes of the pairs, the cancelling pairs would blow up the error of a plain relative norm)
+			std::vector<double> mx(n), my(n), mz(n);
+			GravityKernel::computeFields(x.data(), y.data(), z.data(), m.data(), n, 1e-3, ax.data(), ay.data(), az.data());
+			GravityKernel::computeFieldsMixed(x.data(), y.data(), z.data(), m.data(), n, 1e-3, mx.data(), my.data(), mz.data());
+
+			int cntSamples = std::min(n, 512);
+			double maxError = 0.0;
+			double sumSquareError = 0.0;
+			for (int k = 0; k < cntSamples; ++k) {
+				int i = static_cast<int>((static_cast<long long>(k) * n) / cntSamples);
+				double magnitude = 0.0;
+				for (int j = 0; j < n; ++j) {
+					double dx = x[j] - x[i], dy = y[j] - y[i], dz = z[j] - z[i];
+					double r2 = dx * dx + dy * dy + dz * dz + 1e-3;
+					magnitude += m[j] * std::sqrt(dx * dx + dy * dy + dz * dz) / (r2 * std::sqrt(r2));
+				}
+
+				double ex = mx[i] - ax[i], ey = my[i] - ay[i], ez = mz[i] - az[i];
+				double error = magnitude > 0.0 ? std::sqrt(ex * ex + ey * ey + ez * ez) / magnitude : 0.0;
+				maxError = std::max(maxError, error);
+				sumSquareError += error * error;
+			}
+
+			// the fast multipole method is compared on the same targets (error of the field relative to its rms)
+			BodyState bodies;
+			bodies.x = x;
+			bodies.y = y;
+			bodies.z = z;
+			bodies.m = m;
+			FastMultipole fastMultipole;
+			std::vector<double> fx, fy, fz;
+			fastMultipole.computeFields(bodies, 1e-3, fx, fy, fz);
+
+			double sumSquareFmmError = 0.0;
+			double sumSquareField = 0.0;
+			for (int k = 0; k < cntSamples; ++k) {
+				int i = static_cast<int>((static_cast<long long>(k) * n) / cntSamples);
+				double ex = fx[i] - ax[i], ey = fy[i] - ay[i], ez = fz[i] - az[i];
+				sumSquareFmmError += ex * ex + ey * ey + ez * ez;
+				sumSquareField += ax[i] * ax[i] + ay[i] * ay[i] + az[i] * az[i];
+			}
+
+			json fmmParams = { { "bodies", n }, { "theta", fastMultipole.getTheta() },
+				{ "rmsRelativeError", std::sqrt(sumSquareFmmError / std::max(sumSquareField, 1e-300)) } };
+
+			measure("gravityFmm", fmmParams, [&](unsigned long) {
+				fastMultipole.computeFields(bodies, 1e-3, fx, fy, fz);
+			}, report);
+
+			json mixedParams = params;
+			mixedParams["maxRelativeError"] = maxError;
+			mixedParams["rmsRelativeError"] = std::sqrt(sumSquareError / cntSamples);
+			mixedParams["errorBound"] = GravityKernel::MIXED_ERROR_BOUND;
+			mixedParams["isWithinBound"] = maxError <= GravityKernel::MIXED_ERROR_BOUND;
+
+			measure("gravityKernelMixed", mixedParams, [&](unsigned long) {
+				GravityKernel::computeFieldsMixed(x.data(), y.data(), z.data(), m.data(), n, 1e-3, ax.data(), ay.data(), az.data());
+			}, report);
+
+			// the device-buffers are reused, so the runs include the upload of the positions and the download of the fields
+			if (GpuGravity::isAvailable()) {
+				GpuGravity gpuGravity;
+				json gpuParams = { { "bodies", n }, { "device", GpuGravity::getDeviceName() } };
+
+				measure("gravityKernelGpu", gpuParams, [&](unsigned long) {
+					gpuGravity.computeFields(x.data(), y.data(), z.data(), m.data(), n, 1e-3, ax.data(), ay.data(), az.data());
+				}, report);
+			}
+		}
+	}
+}
+
+
+int main(int argc, const char *argv[]) {
+	variables_map vm;
+
+	options_description desc{ "Options" };
+	desc.add_options()
+		("help,h", "Help screen")
+		("kernel", value<std::vector<std::string>>(), "Run only these kernels (gjk, sweepAndPrune, gravity; default: all)")
+		("maxBodies", value<int>()->default_value(100000), "Largest number of bodies of the gravity-kernel")
+		("runs", value<int>()->default_value(7), "Number of timed runs per benchmark")
+		("minRunTime", value<double>()->default_value(0.05), "Minimal time of a run in seconds")
+		("output,o", value<std::string>(), "Write the report into this file (default: stdout)");
+
+	try {
+		store(parse_command_line(argc, argv, desc), vm);
+		notify(vm);
+	}
+	catch (const error &ex) {
+		std::cerr << ex.what() << '\n';
+		return 1;
+	}
+
+	if (vm.count("help")) {
+		std::cout << desc << '\n';
+		return 0;
+	}
+
+	// only the physics-representation is needed
+	SpaceObject::setIsHeadless(true);
+	AssetCache::setIsEnabled(true);
+
+	CNT_RUNS = std::max(1, vm["runs"].as<int>());
+	MIN_RUN_TIME = vm["minRunTime"].as<double>();
+
+	std::vector<std::string> kernels = vm.count("kernel") ? vm["kernel"].as<std::vector<std::string>>() :
+		std::vector<std::string>{ "gjk", "sweepAndPrune", "gravity" };
+
+	std::ofstream file;
+	if (vm.count("output")) {
+		file.open(vm["output"].as<std::string>());
+		if (!file) {
+			std::cerr << "File " + vm["output"].as<std::string>() + " can't be written!" << '\n';
+			return 1;
+		}
+	}
+	std::ostream &report = vm.count("output") ? file : std::cout;
+
+	for (const std::string &kernel : kernels) {
+		if (kernel == "gjk") {
+			benchGjk(report);
+		} else if (kernel == "sweepAndPrune") {
+			benchSweepAndPrune(report);
+		} else if (kernel == "gravity") {
+			benchGravityKernel(vm["maxBodies"].as<int>(), report);
+		} else {
+			std::cerr << "Kernel " + kernel + " is not supported!" << '\n';
+		}
+	}
+
+	return 0;
+}
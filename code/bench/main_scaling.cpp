@@ -0,0 +1,441 @@
+﻿/**
+ * \brief Starting point for the scaling-harness: Simulates scenes headless at 1..N threads (strong scaling: fixed
+ *        number of bodies, weak scaling: number of emitted bodies proportional to the threads) and reports the
+ *        speedup, the parallel efficiency and the imbalance of the threads per phase.
+ *
+ * Each measurement runs in a worker-process of its own (the same executable with --worker), so the size of the
+ * thread-pools is set before their first use and the runs do not share the caches or the heap.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include <osg/Timer>
+
+#include <boost/program_options.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <json.hpp>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "../scene/SceneManager.h"
+#include "../scene/BinaryScene.h"
+#include "../scene/SceneGenerator.h"
+#include "../scene/SpaceObject.h"
+#include "../physics/SimulationManager.h"
+#include "../physics/Profiler.h"
+#include "../physics/ThreadBudget.h"
+#include "../osg/AssetCache.h"
+#include "../config.h"
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+
+using namespace boost::program_options;
+// for convenience
+using json = nlohmann::json;
+
+
+namespace {
+
+	/**
+	 * \brief Scene of the harness: Either a json-file of the demo-scenes or the arguments of an emitter.
+	 */
+	struct ScalingScene {
+		//! Name in the report
+		std::string name;
+		//! Json-file relative to the demo-scenes ("" => emitted)
+		std::string file;
+		//! Command-line of the emitter (same options as asteroid_field)
+		std::vector<std::string> emitter;
+	};
+
+
+	/**
+	 * \brief Get the scenes of the harness (the same as the benchmark-suite). Only the emitted scenes can be scaled
+	 *        for the weak scaling. The emitters have fixed seeds.
+	 */
+	std::vector<ScalingScene> getScenes() {
+		return {
+			{ "solarSystem", "solarSystem.json", {} },
+			{ "spiralAsteroidField", "spiralAsteroidField.json", {} },
+			{ "galaxyDemo", "galaxy/galaxy.json", {} },
+			{ "sphere1k", "", { "--emitter", "sphere", "--spheres", "1000", "--seed", "1" } },
+			{ "belt10k", "", { "--emitter", "belt", "--asteroids", "10000", "--seed", "1" } },
+			{ "galaxy20k", "", { "--emitter", "galaxy", "--asteroids", "20000", "--rings", "50", "--seed", "1" } }
+		};
+	}
+
+
+	/**
+	 * \brief Multiply the number of emitted bodies of a scene.
+	 *
+	 * \param scene
+	 *      Input-/Output-parameter: Scene of the harness.
+	 * \param scale
+	 *      Factor of the number of bodies.
+	 *
+	 * \return False if the scene is not emitted (the json-files can't be scaled).
+	 */
+	bool scaleScene(ScalingScene &scene, int scale) {
+		if (scene.file != "") return scale == 1;
+
+		for (unsigned int i = 0; i + 1 < scene.emitter.size(); ++i) {
+			if (scene.emitter[i] == "--asteroids" || scene.emitter[i] == "--spheres") {
+				scene.emitter[i + 1] = std::to_string(std::stoi(scene.emitter[i + 1]) * scale);
+			}
+		}
+
+		return true;
+	}
+
+
+	/**
+	 * \brief Load a scene of the harness into the scene-manager.
+	 *
+	 * \param scene
+	 *      Scene of the harness.
+	 * \param sceneManager
+	 *      Scene-manager which constructs the space-objects.
+	 *
+	 * \return False if the scene can't be loaded.
+	 */
+	bool loadScene(const ScalingScene &scene, pbs17::SceneManager &sceneManager) {
+		if (scene.file != "") {
+			std::ifstream stream(SCENES_PATH + "/" + scene.file);
+			if (!stream) return false;
+
+			sceneManager.loadScene(stream);
+			return true;
+		}
+
+		// the emitter gets the same defaults as the main program
+		options_description desc{ "Emitter" };
+		desc.add_options()
+			("spheres,s", value<int>()->default_value(10), "Spheres")
+			("asteroids,a", value<int>()->default_value(0), "Asteroids")
+			("emitter,e", value<std::string>()->default_value("sphere"), "Emitter")
+			("rings", value<int>()->default_value(50), "Rings")
+			("seed", value<unsigned int>()->default_value(0), "Seed")
+			("rand,r", value<bool>()->default_value(true), "Random")
+			("gameplay,g", value<bool>()->default_value(false), "Gameplay");
+
+		variables_map vm;
+		store(command_line_parser(scene.emitter).options(desc).run(), vm);
+		notify(vm);
+
+		pbs17::BinaryScene binaryScene;
+		if (!pbs17::SceneGenerator::generate(vm, binaryScene)) return false;
+
+		sceneManager.loadScene(binaryScene);
+		return true;
+	}
+
+
+	/**
+	 * \brief Measure one scene at a fixed number of threads (the worker-process) and write one json-line.
+	 *
+	 * \param scene
+	 *      Scene of the harness (already scaled).
+	 * \param backend
+	 *      Gravity solver ("" => the setting of the scene).
+	 * \param threads
+	 *      Number of threads of the simulation.
+	 * \param steps, warmup
+	 *      Number of measured steps and of steps before them.
+	 *
+	 * \return Exit-code of the worker.
+	 */
+	int runWorker(const ScalingScene &scene, const std::string &backend, int threads, int steps, int warmup) {
+		// the budget sizes the task-graph on its first use, so it's set before the scene is loaded
+		pbs17::ThreadBudget::setNumCores(threads);
+		pbs17::ThreadBudget::setRenderThreads(0);
+		pbs17::ThreadBudget::setBackgroundThreads(0);
+#if defined(_OPENMP)
+		omp_set_num_threads(threads);
+#endif
+
+		pbs17::SpaceObject::setIsHeadless(true);
+		pbs17::AssetCache::setIsEnabled(false);
+		pbs17::Profiler::setIsEnabled(true);
+		pbs17::Profiler::setIsThreadTimes(true);
+
+		pbs17::SceneManager sceneManager;
+		if (!loadScene(scene, sceneManager)) {
+			std::cerr << "Scene " + scene.name + " can't be loaded!" << '\n';
+			return 1;
+		}
+
+		json settings = sceneManager.getSimulationSettings();
+		if (backend != "") {
+			settings["gravitySolver"] = backend;
+		}
+
+		pbs17::SimulationManager* simulationManager = new pbs17::SimulationManager(sceneManager.getSpaceObjects(), settings);
+		double dt = simulationManager->getSimulationDt();
+		unsigned int cntBodies = simulationManager->getSpaceObjects().size();
+
+		const osg::Timer* timer = osg::Timer::instance();
+		pbs17::Profiler* profiler = pbs17::Profiler::Instance();
+
+		for (int i = 0; i < warmup; ++i) {
+			simulationManager->step(dt);
+		}
+
+		profiler->reset();
+		osg::Timer_t start = timer->tick();
+
+		for (int i = 0; i < steps; ++i) {
+			osg::Timer_t stepStart = timer->tick();
+			simulationManager->step(dt);
+			profiler->endFrame(timer->delta_s(stepStart, timer->tick()));
+		}
+
+		double duration = timer->delta_s(start, timer->tick());
+
+		// times in milliseconds, the imbalance is the largest cpu-time of a thread divided by the mean
+		json phases = json::object();
+		for (int i = 0; i < pbs17::Profiler::CNT_PHASES; ++i) {
+			pbs17::Profiler::Phase phase = static_cast<pbs17::Profiler::Phase>(i);
+			phases[pbs17::Profiler::getPhaseName(phase)] = {
+				{ "total", 1000.0 * profiler->getTotal(phase) },
+				{ "imbalance", profiler->getThreadImbalance(phase) }
+			};
+		}
+
+		json result = {
+			{ "bodies", cntBodies },
+			{ "time", duration },
+			{ "phases", phases }
+		};
+		std::cout << result.dump() << std::endl;
+
+		delete simulationManager;
+		return 0;
+	}
+
+
+	/**
+	 * \brief Start a worker-process and read its json-line.
+	 *
+	 * \param executable
+	 *      Path of this executable.
+	 * \param arguments
+	 *      Arguments of the worker (without --worker).
+	 * \param result
+	 *      Output-parameter: Measurement of the worker.
+	 *
+	 * \return False if the worker failed.
+	 */
+	bool runProcess(const std::string &executable, const std::string &arguments, json &result) {
+		std::string command = "\"" + executable + "\" --worker " + arguments;
+		FILE* pipe = popen(command.c_str(), "r");
+		if (!pipe) return false;
+
+		std::string output;
+		char buffer[4096];
+		while (fgets(buffer, sizeof(buffer), pipe)) {
+			output += buffer;
+		}
+
+		if (pclose(pipe) != 0) return false;
+
+		// the simulation may log before the measurement, the json-line is the last one
+		size_t begin = output.rfind("\n{");
+		begin = begin == std::string::npos ? output.find('{') : begin + 1;
+		if (begin == std::string::npos) return false;
+
+		try {
+			result = json::parse(output.substr(begin));
+		}
+		catch (const std::exception &) {
+			return false;
+		}
+
+		return result.is_object();
+	}
+
+
+	/**
+	 * \brief Get the measured numbers of threads: The powers of two up to the maximum and the maximum itself.
+	 *
+	 * \param maxThreads
+	 *      Largest number of threads.
+	 */
+	std::vector<int> getThreadCounts(int maxThreads) {
+		std::vector<int> counts;
+		for (int k = 1; k < maxThreads; k *= 2) {
+			counts.push_back(k);
+		}
+		counts.push_back(std::max(maxThreads, 1));
+
+		return counts;
+	}
+}
+
+
+int main(int argc, const char *argv[]) {
+	variables_map vm;
+
+	int maxThreads = 1;
+#if defined(_OPENMP)
+	maxThreads = omp_get_max_threads();
+#endif
+
+	options_description desc{ "Options" };
+	desc.add_options()
+		("help,h", "Help screen")
+		("steps", value<int>()->default_value(100), "Number of measured steps per run")
+		("warmup", value<int>()->default_value(10), "Number of steps per run which are not measured")
+		("scene", value<std::vector<std::string>>(), "Run only these scenes (default: all)")
+		("backend", value<std::vector<std::string>>(), "Gravity solvers to compare (default: the setting of the scene)")
+		("maxThreads", value<int>()->default_value(maxThreads), "Largest number of threads")
+		("mode", value<std::string>()->default_value("both"), "Scaling to measure (strong, weak, both)")
+		("format", value<std::string>()->default_value("csv"), "Format of the report (csv, json)")
+		("output,o", value<std::string>(), "Write the report into this file (default: stdout)")
+		("worker", "Measure a single run (started by the harness)")
+		("threads", value<int>()->default_value(1), "Number of threads of the worker")
+		("scale", value<int>()->default_value(1), "Factor of the emitted bodies of the worker");
+
+	try {
+		store(parse_command_line(argc, argv, desc), vm);
+		notify(vm);
+	}
+	catch (const error &ex) {
+		std::cerr << ex.what() << '\n';
+		return 1;
+	}
+
+	if (vm.count("help")) {
+		std::cout << desc << '\n';
+		return 0;
+	}
+
+	int steps = vm["steps"].as<int>();
+	int warmup = vm["warmup"].as<int>();
+	std::vector<std::string> selected = vm.count("scene") ? vm["scene"].as<std::vector<std::string>>() : std::vector<std::string>();
+	std::vector<std::string> backends = vm.count("backend") ? vm["backend"].as<std::vector<std::string>>() : std::vector<std::string>{ "" };
+	std::vector<ScalingScene> scenes = getScenes();
+
+	if (vm.count("worker")) {
+		for (ScalingScene scene : scenes) {
+			if (selected.empty() || scene.name != selected.front()) continue;
+			if (!scaleScene(scene, vm["scale"].as<int>())) return 1;
+
+			return runWorker(scene, backends.front(), std::max(vm["threads"].as<int>(), 1), steps, warmup);
+		}
+
+		return 1;
+	}
+
+	std::string mode = vm["mode"].as<std::string>();
+	bool isCsv = vm["format"].as<std::string>() != "json";
+
+	std::ofstream file;
+	if (vm.count("output")) {
+		file.open(vm["output"].as<std::string>());
+		if (!file) {
+			std::cerr << "File " + vm["output"].as<std::string>() + " can't be written!" << '\n';
+			return 1;
+		}
+	}
+	std::ostream &report = vm.count("output") ? file : std::cout;
+
+	// spinning threads would count as busy, so the waiting threads of the workers sleep (unless set by the user)
+#if defined(_WIN32)
+	if (!std::getenv("OMP_WAIT_POLICY")) _putenv("OMP_WAIT_POLICY=PASSIVE");
+#else
+	setenv("OMP_WAIT_POLICY", "PASSIVE", 0);
+#endif
+
+	if (isCsv) {
+		report << "scene,backend,mode,threads,bodies,time,speedup,efficiency";
+		for (int i = 0; i < pbs17::Profiler::CNT_PHASES; ++i) {
+			std::string name = pbs17::Profiler::getPhaseName(static_cast<pbs17::Profiler::Phase>(i));
+			report << ',' << name << "Time," << name << "Imbalance";
+		}
+		report << std::endl;
+	}
+
+	std::vector<int> threadCounts = getThreadCounts(vm["maxThreads"].as<int>());
+	std::vector<std::string> modes;
+	if (mode != "weak") modes.push_back("strong");
+	if (mode != "strong") modes.push_back("weak");
+
+	for (const ScalingScene &scene : scenes) {
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), scene.name) == selected.end()) continue;
+
+		for (const std::string &backend : backends) {
+			for (const std::string &scaling : modes) {
+				bool isWeak = scaling == "weak";
+				if (isWeak && scene.file != "") continue;
+
+				double baseTime = 0.0;
+				for (int threads : threadCounts) {
+					std::ostringstream arguments;
+					arguments << "--scene " << scene.name << " --threads " << threads << " --scale " << (isWeak ? threads : 1)
+						<< " --steps " << steps << " --warmup " << warmup;
+					if (backend != "") {
+						arguments << " --backend " << backend;
+					}
+
+					json result;
+					if (!runProcess(argv[0], arguments.str(), result)) {
+						std::cerr << "Run " + scene.name + " with " + std::to_string(threads) + " threads failed!" << '\n';
+						continue;
+					}
+
+					double time = result["time"].get<double>();
+					if (threads == 1) {
+						baseTime = time;
+					}
+
+					// strong: speedup t1/tk and efficiency speedup/k, weak: efficiency t1/tk and the scaled speedup k*t1/tk
+					double ratio = baseTime > 0.0 && time > 0.0 ? baseTime / time : 0.0;
+					double speedup = isWeak ? threads * ratio : ratio;
+					double efficiency = isWeak ? ratio : ratio / threads;
+
+					if (isCsv) {
+						report << scene.name << ',' << (backend == "" ? "scene" : backend) << ',' << scaling << ',' << threads
+							<< ',' << result["bodies"].get<unsigned int>() << ',' << time << ',' << speedup << ',' << efficiency;
+						for (int i = 0; i < pbs17::Profiler::CNT_PHASES; ++i) {
+							const json &phase = result["phases"][pbs17::Profiler::getPhaseName(static_cast<pbs17::Profiler::Phase>(i))];
+							report << ',' << phase["total"].get<double>() << ',' << phase["imbalance"].get<double>();
+						}
+						report << std::endl;
+					} else {
+						json row = {
+							{ "scene", scene.name },
+							{ "version", VERSION },
+							{ "backend", backend == "" ? "scene" : backend },
+							{ "mode", scaling },
+							{ "threads", threads },
+							{ "steps", steps },
+							{ "bodies", result["bodies"] },
+							{ "time", time },
+							{ "speedup", speedup },
+							{ "efficiency", efficiency },
+							{ "phases", result["phases"] }
+						};
+						report << row.dump() << std::endl;
+					}
+				}
+			}
+		}
+	}
+
+	return 0;
+}
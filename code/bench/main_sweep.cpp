@@ -0,0 +1,466 @@
+﻿/**
+ * \brief Starting point for the parameter-sweep: Simulates the variants of a scene headless and concurrently, and
+ *        reports a summary per run.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-08
+ */
+
+#include <osg/Timer>
+
+#include <boost/program_options.hpp>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <json.hpp>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "../scene/SceneManager.h"
+#include "../scene/BinaryScene.h"
+#include "../scene/SpaceObject.h"
+#include "../physics/SimulationManager.h"
+#include "../physics/EnsembleIntegrator.h"
+#include "../physics/TrajectoryRecorder.h"
+#include "../physics/BodyState.h"
+#include "../physics/Profiler.h"
+#include "../osg/AssetCache.h"
+#include "../config.h"
+
+
+using namespace boost::program_options;
+// for convenience
+using json = nlohmann::json;
+
+
+namespace {
+
+	/**
+	 * \brief Load the base-scene of the sweep (json- or binary-file, relative to the demo-scenes as fallback).
+	 *
+	 * \param vm
+	 *      Input parameters (sceneJson or sceneBin).
+	 * \param scene
+	 *      Output-parameter: Loaded scene.
+	 *
+	 * \return False if the scene can't be loaded.
+	 */
+	bool loadBaseScene(const variables_map &vm, pbs17::BinaryScene &scene) {
+		if (vm.count("sceneBin")) {
+			const std::string filePath = vm["sceneBin"].as<std::string>();
+
+			return scene.load(filePath) || scene.load(SCENES_PATH + "/" + filePath);
+		}
+
+		const std::string filePath = vm["sceneJson"].as<std::string>();
+		std::ifstream stream(filePath);
+		if (!stream) {
+			stream = std::ifstream(SCENES_PATH + "/" + filePath);
+			if (!stream) return false;
+		}
+
+		// the scene is parsed once and each run is loaded from the columns
+		json j;
+		stream >> j;
+
+		return scene.fromJson(j);
+	}
+
+
+	/**
+	 * \brief Read the parameter-grid: {"restitution": [0.5, 0.9], "integrator": ["leapfrog", "yoshida"], ...}.
+	 * The keys are simulation-settings, a single value is the same as an array with one value.
+	 *
+	 * \param value
+	 *      Inline json-object or path to a json-file.
+	 * \param grid
+	 *      Output-parameter: Parameter-grid.
+	 *
+	 * \return False if the grid can't be read.
+	 */
+	bool loadGrid(const std::string &value, json &grid) {
+		try {
+			if (!value.empty() && value[0] == '{') {
+				grid = json::parse(value);
+			} else {
+				std::ifstream stream(value);
+				if (!stream) return false;
+
+				stream >> grid;
+			}
+		}
+		catch (const std::exception &ex) {
+			std::cerr << ex.what() << '\n';
+			return false;
+		}
+
+		return grid.is_object();
+	}
+
+
+	/**
+	 * \brief Expand the grid into the cartesian product of its values (the last key varies fastest).
+	 *
+	 * \param grid
+	 *      Parameter-grid.
+	 *
+	 * \return Parameters of each run.
+	 */
+	std::vector<json> expandGrid(const json &grid) {
+		std::vector<json> runs(1, json::object());
+
+		for (json::const_iterator it = grid.begin(); it != grid.end(); ++it) {
+			json values = it.value().is_array() ? it.value() : json::array({ it.value() });
+			std::vector<json> expanded;
+
+			for (unsigned int r = 0; r < runs.size(); ++r) {
+				for (unsigned int v = 0; v < values.size(); ++v) {
+					json parameters = runs[r];
+					parameters[it.key()] = values[v];
+					expanded.push_back(parameters);
+				}
+			}
+
+			runs.swap(expanded);
+		}
+
+		return runs;
+	}
+
+
+	/**
+	 * \brief Read a vector of a body of the scene.
+	 *
+	 * \param value
+	 *      Json-object with x, y and z.
+	 *
+	 * \return Vector (zero if the value is missing).
+	 */
+	Eigen::Vector3d toVector(const json &value) {
+		if (!value.is_object()) {
+			return Eigen::Vector3d::Zero();
+		}
+
+		return Eigen::Vector3d(value.value("x", 0.0), value.value("y", 0.0), value.value("z", 0.0));
+	}
+
+
+	/**
+	 * \brief Integrate all runs at once with the ensemble-integrator (only the gravity): Each point of the grid
+	 * ("positionScale", "velocityScale", "massScale" of all bodies) is a system with the given number of copies, the
+	 * copies after the first one are perturbed randomly. The summary of each system is reported as a json-line.
+	 *
+	 * \param vm
+	 *      Input parameters (steps, copies, perturbation, record, recordInterval).
+	 * \param baseScene
+	 *      Scene whose bodies are the bodies of each system.
+	 * \param runs
+	 *      Parameters of each point of the grid.
+	 * \param report
+	 *      Output-parameter: Summaries of the systems.
+	 *
+	 * \return Exit-code of the program.
+	 */
+	int runEnsemble(const variables_map &vm, const pbs17::BinaryScene &baseScene, const std::vector<json> &runs, std::ostream &report) {
+		static const char* SCALES[3] = { "positionScale", "velocityScale", "massScale" };
+
+		for (unsigned int r = 0; r < runs.size(); ++r) {
+			for (json::const_iterator it = runs[r].begin(); it != runs[r].end(); ++it) {
+				if (std::find(SCALES, SCALES + 3, it.key()) == SCALES + 3) {
+					std::cerr << "The ensemble only varies positionScale, velocityScale and massScale, not " << it.key() << '\n';
+					return 1;
+				}
+			}
+		}
+
+		// all systems share the settings of the scene (same integrator and time-step)
+		json settings = baseScene.getSettings()["simulation"];
+		if (!settings.is_object()) {
+			settings = json::object();
+		}
+
+		pbs17::NBodyManager::Integrator integrator = pbs17::NBodyManager::SEMI_IMPLICIT_EULER;
+		if (settings["integrator"].is_string() && !pbs17::NBodyManager::parseIntegrator(settings["integrator"].get<std::string>(), integrator)) {
+			std::cerr << "Integrator (" << settings["integrator"].get<std::string>() << ") not supported!" << '\n';
+		}
+		// same default as the SimulationManager
+		double dt = settings["dt"].is_number() ? settings["dt"].get<double>() : 0.01;
+
+		const unsigned int cntBodies = baseScene.getNumBodies();
+		const unsigned int cntCopies = static_cast<unsigned int>(std::max(vm["copies"].as<int>(), 1));
+		const unsigned int cntSystems = static_cast<unsigned int>(runs.size()) * cntCopies;
+		const double perturbation = vm["perturbation"].as<double>();
+
+		pbs17::EnsembleIntegrator ensemble(cntBodies, cntSystems);
+		if (!ensemble.setIntegrator(integrator)) {
+			std::cerr << "The ensemble uses the leapfrog instead of the integrator of the scene" << '\n';
+		}
+
+		std::vector<json> bodies(cntBodies);
+		for (unsigned int i = 0; i < cntBodies; ++i) {
+			bodies[i] = baseScene.getBody(i);
+		}
+
+		for (unsigned int s = 0; s < cntSystems; ++s) {
+			const json &parameters = runs[s / cntCopies];
+			double positionScale = parameters.value("positionScale", 1.0);
+			double velocityScale = parameters.value("velocityScale", 1.0);
+			double massScale = parameters.value("massScale", 1.0);
+
+			// the same system gets the same perturbation in every sweep
+			std::mt19937 random(s);
+			std::normal_distribution<double> normal(0.0, s % cntCopies == 0 ? 0.0 : perturbation);
+
+			for (unsigned int i = 0; i < cntBodies; ++i) {
+				Eigen::Vector3d position = positionScale * toVector(bodies[i]["position"]);
+				Eigen::Vector3d velocity = velocityScale * toVector(bodies[i]["linearVelocity"]);
+				for (int k = 0; k < 3; ++k) {
+					position(k) *= 1.0 + normal(random);
+					velocity(k) *= 1.0 + normal(random);
+				}
+
+				ensemble.setBody(s, i, massScale * bodies[i].value("mass", 1.0), position, velocity);
+			}
+		}
+
+		pbs17::TrajectoryRecorder* recorder = nullptr;
+		pbs17::BodyState recorded;
+		unsigned int recordInterval = std::max(vm["recordInterval"].as<unsigned int>(), 1u);
+		if (vm.count("record")) {
+			recorder = new pbs17::TrajectoryRecorder(vm["record"].as<std::string>(), recordInterval);
+			recorder->start();
+		}
+
+		std::vector<double> initialEnergy(cntSystems);
+		for (unsigned int s = 0; s < cntSystems; ++s) {
+			initialEnergy[s] = ensemble.computeEnergy(s);
+		}
+
+		std::cerr << "Ensemble of " << cntSystems << " systems with " << cntBodies << " bodies" << '\n';
+
+		const osg::Timer* timer = osg::Timer::instance();
+		osg::Timer_t start = timer->tick();
+		int steps = vm["steps"].as<int>();
+		const std::vector<pbs17::Collision> noContacts;
+
+		for (int i = 1; i <= steps; ++i) {
+			ensemble.step(dt);
+
+			// the state is only copied for the recorded steps
+			if (recorder && i % recordInterval == 0) {
+				ensemble.copyTo(recorded);
+				recorder->record(i, ensemble.getTime(), recorded, noContacts);
+			}
+		}
+
+		double duration = timer->delta_s(start, timer->tick());
+
+		if (recorder) {
+			recorder->stop();
+			if (recorder->getNumDropped() > 0) {
+				std::cerr << "Dropped snapshots: " << recorder->getNumDropped() << '\n';
+			}
+			delete recorder;
+		}
+
+		for (unsigned int s = 0; s < cntSystems; ++s) {
+			double energy = ensemble.computeEnergy(s);
+
+			json result = {
+				{ "system", s },
+				{ "copy", s % cntCopies },
+				{ "version", VERSION },
+				{ "parameters", runs[s / cntCopies] },
+				{ "bodies", cntBodies },
+				{ "steps", steps },
+				{ "simulatedTime", ensemble.getTime() },
+				{ "energy", energy },
+				{ "energyDrift", initialEnergy[s] != 0.0 ? (energy - initialEnergy[s]) / std::abs(initialEnergy[s]) : 0.0 }
+			};
+			report << result.dump() << '\n';
+		}
+		report.flush();
+
+		std::cerr << "Systems: " << cntSystems << "\ttime: " << duration << "\tsystem-steps per second: "
+			<< (duration > 0.0 ? cntSystems * static_cast<double>(steps) / duration : 0.0) << '\n';
+
+		return 0;
+	}
+}
+
+
+int main(int argc, const char *argv[]) {
+	variables_map vm;
+
+	options_description desc{ "Options" };
+	desc.add_options()
+		("help,h", "Help screen")
+		("sceneJson,j", value<std::string>(), "Json file containing the scene")
+		("sceneBin,b", value<std::string>(), "Binary file containing the scene (see --convertScene of asteroid_field)")
+		("grid", value<std::string>(), "Simulation-settings to vary as json-object of arrays (inline or file), e.g. {\"restitution\": [0.5, 0.9]}")
+		("steps", value<int>()->default_value(1000), "Number of steps per run")
+		("jobs", value<int>()->default_value(0), "Number of concurrent runs (0 => one per core)")
+		("ensemble", "Integrate all runs at once as independent systems (only the gravity, the grid varies positionScale, velocityScale and massScale)")
+		("copies", value<int>()->default_value(1), "Systems per point of the grid (--ensemble)")
+		("perturbation", value<double>()->default_value(0.0), "Relative random perturbation of the positions and velocities of the copies after the first one (--ensemble)")
+		("record", value<std::string>(), "Write the trajectories of all systems into this log (--ensemble, body i of system s has the id s * bodies + i)")
+		("recordInterval", value<unsigned int>()->default_value(10), "Record every n-th step (--ensemble)")
+		("output,o", value<std::string>(), "Write the summaries into this file (default: stdout)");
+
+	try {
+		store(parse_command_line(argc, argv, desc), vm);
+		notify(vm);
+	}
+	catch (const error &ex) {
+		std::cerr << ex.what() << '\n';
+		return 1;
+	}
+
+	if (vm.count("help") || (!vm.count("sceneJson") && !vm.count("sceneBin"))) {
+		std::cout << desc << '\n';
+		return vm.count("help") ? 0 : 1;
+	}
+
+	// the runs only share the loaded models, the profiler would serialize them on its mutex
+	pbs17::SpaceObject::setIsHeadless(true);
+	pbs17::Profiler::setIsEnabled(false);
+
+	pbs17::BinaryScene baseScene;
+	if (!loadBaseScene(vm, baseScene)) {
+		std::cerr << "The scene doesnt exists or can't be loaded!" << '\n';
+		return 1;
+	}
+
+	json grid = json::object();
+	if (vm.count("grid") && !loadGrid(vm["grid"].as<std::string>(), grid)) {
+		std::cerr << "The grid " + vm["grid"].as<std::string>() + " can't be read!" << '\n';
+		return 1;
+	}
+
+	std::ofstream file;
+	if (vm.count("output")) {
+		file.open(vm["output"].as<std::string>());
+		if (!file) {
+			std::cerr << "File " + vm["output"].as<std::string>() + " can't be written!" << '\n';
+			return 1;
+		}
+	}
+	std::ostream &report = vm.count("output") ? file : std::cout;
+
+	std::vector<json> runs = expandGrid(grid);
+	if (vm.count("ensemble")) {
+		return runEnsemble(vm, baseScene, runs, report);
+	}
+
+	int cntRuns = runs.size();
+	int steps = vm["steps"].as<int>();
+	int jobs = vm["jobs"].as<int>();
+#if defined(_OPENMP)
+	if (jobs <= 0) {
+		jobs = omp_get_num_procs();
+	}
+#endif
+	jobs = std::max(1, std::min(jobs, cntRuns));
+
+	std::cerr << "Sweep of " << cntRuns << " runs with " << jobs << " jobs" << '\n';
+
+	const osg::Timer* timer = osg::Timer::instance();
+	osg::Timer_t sweepStart = timer->tick();
+
+	// one run per thread: the parallel loops within a run are nested and run single-threaded
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1) num_threads(jobs)
+#endif
+	for (int r = 0; r < cntRuns; ++r) {
+		pbs17::SceneManager* sceneManager = nullptr;
+		pbs17::SimulationManager* simulationManager = nullptr;
+		json settings;
+
+		// the scene-manager shares the models and the ids of the objects between all runs
+#if defined(_OPENMP)
+#pragma omp critical(loadRun)
+#endif
+		{
+			sceneManager = new pbs17::SceneManager;
+			sceneManager->loadScene(baseScene);
+
+			settings = sceneManager->getSimulationSettings();
+			if (!settings.is_object()) {
+				settings = json::object();
+			}
+			for (json::const_iterator it = runs[r].begin(); it != runs[r].end(); ++it) {
+				settings[it.key()] = it.value();
+			}
+
+			simulationManager = new pbs17::SimulationManager(sceneManager->getSpaceObjects(), settings);
+		}
+
+		double dt = simulationManager->getSimulationDt();
+		unsigned long cntContacts = 0;
+		unsigned int maxContacts = 0;
+		osg::Timer_t start = timer->tick();
+
+		for (int i = 0; i < steps; ++i) {
+			simulationManager->step(dt);
+
+			cntContacts += simulationManager->getNumContacts();
+			maxContacts = std::max(maxContacts, simulationManager->getNumContacts());
+		}
+
+		double duration = timer->delta_s(start, timer->tick());
+
+		// conserved quantities of the final state (kinetic energy without the rotation)
+		const std::vector<pbs17::SpaceObject*> &objects = simulationManager->getSpaceObjects();
+		double kineticEnergy = 0.0;
+		Eigen::Vector3d momentum = Eigen::Vector3d::Zero();
+		for (unsigned int i = 0; i < objects.size(); ++i) {
+			Eigen::Vector3d v = objects[i]->getLinearVelocity();
+			kineticEnergy += 0.5 * objects[i]->getMass() * v.squaredNorm();
+			momentum += objects[i]->getMass() * v;
+		}
+
+		// one json-object per line (in the order of completion)
+		json result = {
+			{ "run", r },
+			{ "version", VERSION },
+			{ "parameters", runs[r] },
+			{ "settings", settings },
+			{ "bodies", objects.size() },
+			{ "steps", steps },
+			{ "simulatedTime", simulationManager->getTime() },
+			{ "time", duration },
+			{ "bodyStepsPerSecond", duration > 0.0 ? objects.size() * static_cast<double>(steps) / duration : 0.0 },
+			{ "contacts", cntContacts },
+			{ "maxContacts", maxContacts },
+			{ "kineticEnergy", kineticEnergy },
+			{ "momentum", { { "x", momentum(0) }, { "y", momentum(1) }, { "z", momentum(2) } } }
+		};
+
+#if defined(_OPENMP)
+#pragma omp critical(reportRun)
+#endif
+		{
+			report << result.dump() << std::endl;
+		}
+
+#if defined(_OPENMP)
+#pragma omp critical(loadRun)
+#endif
+		{
+			delete simulationManager;
+			delete sceneManager;
+		}
+	}
+
+	double duration = timer->delta_s(sweepStart, timer->tick());
+	std::cerr << "Runs: " << cntRuns << "\ttime: " << duration << "\truns per second: " << (duration > 0.0 ? cntRuns / duration : 0.0) << '\n';
+
+	return 0;
+}
@@ -44,6 +44,8 @@ OBJECT_DISTANCE = 1.
 INTERRING_DISTANCE = 0.5
 RING_NUMBER = 25
 
+PARTICLE_MESH_THRESHOLD = 50000
+
 START_ANGLE = 0.
 RING_ANGLE_OFFSET = 5.
 
@@ -51,6 +53,18 @@ mainDict = {}
 mainDict["name"] = "Galaxy"
 mainDict["id"] = "S9"
 mainDict["objects"] = []
+# tree codes get expensive for very large discs, the particle-mesh solver scales near-linearly
+if OBJECTS_PER_RING * RING_NUMBER > PARTICLE_MESH_THRESHOLD:
+    mainDict["simulation"] = {
+        "gravitySolver": "particleMesh",
+        "meshResolution": 128,
+        "p3m": True
+    }
+else:
+    mainDict["simulation"] = {
+        "gravitySolver": "barnesHut",
+        "theta": 0.5
+    }
 
 sun = {}
 sun["id"] = "0"
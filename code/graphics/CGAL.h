@@ -19,3 +19,4 @@ typedef K::Point_3                                                     Point_3;
 typedef Polyhedron_3::Vertex_iterator                                  Vertex_iterator;
 typedef Polyhedron_3::Facet_iterator                                   Facet_iterator;
 typedef Polyhedron_3::Halfedge_around_facet_circulator                 Halfedge_around_facet_circulator;
+typedef Polyhedron_3::Halfedge_around_vertex_circulator                Halfedge_around_vertex_circulator;
@@ -0,0 +1,252 @@
+﻿/**
+ * \brief Approximate convex decomposition of a concave model into the convex parts of a compound shape.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "ConvexDecomposition.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
+#include <CGAL/Polyhedron_3.h>
+#include <CGAL/convex_hull_3.h>
+
+using namespace pbs17;
+
+namespace {
+	// the planes of the candidate-hulls only need exact predicates (much faster than the exact kernel of the hulls)
+	typedef CGAL::Exact_predicates_inexact_constructions_kernel		InexactKernel;
+	typedef CGAL::Polyhedron_3<InexactKernel>						InexactPolyhedron;
+}
+
+
+//! Decomposition of the loaded models is disabled by default
+bool ConvexDecomposition::IS_ENABLED = false;
+
+//! Maximum number of parts per model
+const int ConvexDecomposition::MAX_PARTS;
+//! Parts with a smaller concavity (relative to the diagonal of the model) are not split anymore
+const double ConvexDecomposition::MAX_CONCAVITY = 0.03;
+//! Maximum number of vertices of the model which are used (the others are skipped evenly)
+const unsigned int ConvexDecomposition::MAX_POINTS;
+//! Relative positions of the split-planes in the AABB of a part
+const double ConvexDecomposition::SPLIT_POSITIONS[3] = { 0.25, 0.5, 0.75 };
+//! Width of the band around the split-plane (relative to the diagonal of the model) which is in both parts
+const double ConvexDecomposition::OVERLAP = 0.01;
+//! A split which does not reduce the concavity below this ratio is discarded (the part is final)
+const double ConvexDecomposition::MIN_IMPROVEMENT = 0.9;
+
+
+/**
+ * \brief Split the vertices of a model into convex parts.
+ *
+ * \param vertices
+ *      All vertices of the model (in the model-space).
+ * \param parts
+ *      Output-parameter: Convex parts (owned by the caller, empty if the model is convex enough).
+ */
+void ConvexDecomposition::decompose(const osg::Vec3Array* vertices, std::vector<ConvexHull3D*> &parts) {
+	parts.clear();
+
+	if (vertices == nullptr || vertices->size() < 8) {
+		return;
+	}
+
+	std::vector<Part> pieces(1);
+	unsigned int stride = (static_cast<unsigned int>(vertices->size()) + MAX_POINTS - 1) / MAX_POINTS;
+	Eigen::Vector3d boxMin = Eigen::Vector3d::Constant(std::numeric_limits<double>::infinity());
+	Eigen::Vector3d boxMax = -boxMin;
+
+	for (unsigned int i = 0; i < vertices->size(); i += stride) {
+		const osg::Vec3 &vertex = (*vertices)[i];
+		Eigen::Vector3d point(vertex.x(), vertex.y(), vertex.z());
+
+		pieces[0].points.push_back(point);
+		boxMin = boxMin.cwiseMin(point);
+		boxMax = boxMax.cwiseMax(point);
+	}
+
+	double diagonal = (boxMax - boxMin).norm();
+	double threshold = MAX_CONCAVITY * diagonal;
+	double band = OVERLAP * diagonal;
+
+	pieces[0].concavity = measure(pieces[0].points);
+	if (pieces[0].concavity <= threshold) {
+		return;
+	}
+
+	while (pieces.size() < static_cast<unsigned int>(MAX_PARTS)) {
+		unsigned int worst = 0;
+		for (unsigned int i = 1; i < pieces.size(); ++i) {
+			if (pieces[i].concavity > pieces[worst].concavity) {
+				worst = i;
+			}
+		}
+
+		if (pieces[worst].concavity <= threshold) {
+			break;
+		}
+
+		const std::vector<Eigen::Vector3d> &points = pieces[worst].points;
+		Eigen::Vector3d partMin = points[0];
+		Eigen::Vector3d partMax = points[0];
+		for (unsigned int i = 1; i < points.size(); ++i) {
+			partMin = partMin.cwiseMin(points[i]);
+			partMax = partMax.cwiseMax(points[i]);
+		}
+
+		// the candidate with the smallest concavity of its worse half is taken
+		double bestConcavity = std::numeric_limits<double>::infinity();
+		Part bestBelow, bestAbove;
+
+		for (int axis = 0; axis < 3; ++axis) {
+			for (int s = 0; s < 3; ++s) {
+				double plane = partMin[axis] + SPLIT_POSITIONS[s] * (partMax[axis] - partMin[axis]);
+				Part below, above;
+
+				for (unsigned int i = 0; i < points.size(); ++i) {
+					if (points[i][axis] <= plane + band) {
+						below.points.push_back(points[i]);
+					}
+					if (points[i][axis] >= plane - band) {
+						above.points.push_back(points[i]);
+					}
+				}
+
+				if (below.points.size() < 4 || above.points.size() < 4) {
+					continue;
+				}
+
+				below.concavity = measure(below.points);
+				above.concavity = measure(above.points);
+
+				double concavity = std::max(below.concavity, above.concavity);
+				if (concavity < bestConcavity) {
+					bestConcavity = concavity;
+					std::swap(bestBelow, below);
+					std::swap(bestAbove, above);
+				}
+			}
+		}
+
+		// no plane makes the part more convex => keep it as it is
+		if (bestConcavity >= MIN_IMPROVEMENT * pieces[worst].concavity) {
+			pieces[worst].concavity = 0.0;
+			continue;
+		}
+
+		std::swap(pieces[worst], bestBelow);
+		pieces.push_back(Part());
+		std::swap(pieces.back(), bestAbove);
+	}
+
+	if (pieces.size() < 2) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < pieces.size(); ++i) {
+		osg::ref_ptr<osg::Vec3Array> partVertices = new osg::Vec3Array;
+		partVertices->reserve(pieces[i].points.size());
+
+		for (unsigned int p = 0; p < pieces[i].points.size(); ++p) {
+			const Eigen::Vector3d &point = pieces[i].points[p];
+			partVertices->push_back(osg::Vec3(point.x(), point.y(), point.z()));
+		}
+
+		parts.push_back(new ConvexHull3D(partVertices.get()));
+	}
+}
+
+
+/**
+ * \brief Compute the hull of the vertices of a part and their concavity.
+ *
+ * \param points
+ *      Vertices of the part.
+ *
+ * \return Concavity of the part (see computeConcavity()).
+ */
+double ConvexDecomposition::measure(const std::vector<Eigen::Vector3d> &points) {
+	std::vector<Plane> faces;
+	computeHullPlanes(points, faces);
+
+	return computeConcavity(points, faces);
+}
+
+
+/**
+ * \brief Compute the concavity of the vertices of a part.
+ *
+ * \param points
+ *      Vertices of the part.
+ * \param faces
+ *      Planes of the outward faces of the hull of the points.
+ *
+ * \return Largest distance of a vertex below the hull.
+ */
+double ConvexDecomposition::computeConcavity(const std::vector<Eigen::Vector3d> &points, const std::vector<Plane> &faces) {
+	if (faces.empty()) {
+		return 0.0;
+	}
+
+	double concavity = 0.0;
+
+	for (unsigned int i = 0; i < points.size(); ++i) {
+		// distance to the closest face (the points are inside of the hull)
+		double depth = std::numeric_limits<double>::infinity();
+		for (unsigned int f = 0; f < faces.size() && depth > concavity; ++f) {
+			depth = std::min(depth, faces[f].offset - faces[f].normal.dot(points[i]));
+		}
+
+		concavity = std::max(concavity, depth);
+	}
+
+	return concavity;
+}
+
+
+/**
+ * \brief Compute the planes of the faces of the convex-hull of points (without simplification).
+ *
+ * \param points
+ *      Vertices of the part.
+ * \param faces
+ *      Output-parameter: Planes of the outward faces.
+ */
+void ConvexDecomposition::computeHullPlanes(const std::vector<Eigen::Vector3d> &points, std::vector<Plane> &faces) {
+	faces.clear();
+
+	std::vector<InexactKernel::Point_3> cgalPoints(points.size());
+	for (unsigned int i = 0; i < points.size(); ++i) {
+		cgalPoints[i] = InexactKernel::Point_3(points[i].x(), points[i].y(), points[i].z());
+	}
+
+	InexactPolyhedron polyhedron;
+	CGAL::convex_hull_3(cgalPoints.begin(), cgalPoints.end(), polyhedron);
+
+	// the facets are oriented counter-clockwise seen from the outside
+	for (InexactPolyhedron::Facet_iterator facet = polyhedron.facets_begin(); facet != polyhedron.facets_end(); ++facet) {
+		InexactPolyhedron::Halfedge_around_facet_circulator halfedge = facet->facet_begin();
+		Eigen::Vector3d corners[3];
+
+		for (int k = 0; k < 3; ++k, ++halfedge) {
+			const InexactKernel::Point_3 &point = halfedge->vertex()->point();
+			corners[k] = Eigen::Vector3d(point.x(), point.y(), point.z());
+		}
+
+		Eigen::Vector3d normal = (corners[1] - corners[0]).cross(corners[2] - corners[0]);
+		double length = normal.norm();
+		if (length <= 0.0) {
+			continue;
+		}
+
+		Plane plane;
+		plane.normal = normal / length;
+		plane.offset = plane.normal.dot(corners[0]);
+		faces.push_back(plane);
+	}
+}
@@ -0,0 +1,130 @@
+﻿/**
+ * \brief Approximate convex decomposition of a concave model into the convex parts of a compound shape.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+#include <Eigen/Core>
+#include <osg/Array>
+
+#include "ConvexHull3D.h"
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief ConvexDecomposition splits the vertices of a concave model recursively by axis-aligned planes until
+	 * the hull of every part is close to its vertices. The concavity of a part is the deepest vertex below the faces
+	 * of its hull, the part with the largest concavity is split next by the plane which reduces it most. The parts
+	 * overlap by a thin band around the planes, so the union of the parts has no gaps. The decomposition is only
+	 * computed once per model and stored in the asset-cache (see ModelManager::computeShape()).
+	 */
+	class ConvexDecomposition {
+	public:
+		/**
+		 * \brief Split the vertices of a model into convex parts.
+		 *
+		 * \param vertices
+		 *      All vertices of the model (in the model-space).
+		 * \param parts
+		 *      Output-parameter: Convex parts (owned by the caller, empty if the model is convex enough).
+		 */
+		static void decompose(const osg::Vec3Array* vertices, std::vector<ConvexHull3D*> &parts);
+
+
+		/**
+		 * \brief Enable or disable the decomposition of the loaded models (the procedural asteroids stay convex). Has
+		 *        to be set before loading the scene.
+		 *
+		 * \param isEnabled
+		 *      True if concave models collide with their convex parts.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the decomposition of the loaded models is enabled.
+		 *
+		 * \return True if concave models collide with their convex parts.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+		//! Maximum number of parts per model
+		static const int MAX_PARTS = 16;
+		//! Parts with a smaller concavity (relative to the diagonal of the model) are not split anymore
+		static const double MAX_CONCAVITY;
+
+
+	private:
+		/**
+		 * \brief Part of the decomposition which may be split further.
+		 */
+		struct Part {
+			//! Vertices of the model inside of the part
+			std::vector<Eigen::Vector3d> points;
+			//! Deepest vertex below the faces of the hull of the points (0.0 => final part)
+			double concavity = 0.0;
+		};
+
+		/**
+		 * \brief Plane of a face of a hull (n * x <= offset inside of the hull).
+		 */
+		struct Plane {
+			Eigen::Vector3d normal;
+			double offset;
+		};
+
+		/**
+		 * \brief Compute the concavity of the vertices of a part.
+		 *
+		 * \param points
+		 *      Vertices of the part.
+		 * \param faces
+		 *      Planes of the outward faces of the hull of the points.
+		 *
+		 * \return Largest distance of a vertex below the hull.
+		 */
+		static double computeConcavity(const std::vector<Eigen::Vector3d> &points, const std::vector<Plane> &faces);
+
+		/**
+		 * \brief Compute the planes of the faces of the convex-hull of points (without simplification).
+		 *
+		 * \param points
+		 *      Vertices of the part.
+		 * \param faces
+		 *      Output-parameter: Planes of the outward faces.
+		 */
+		static void computeHullPlanes(const std::vector<Eigen::Vector3d> &points, std::vector<Plane> &faces);
+
+		/**
+		 * \brief Compute the hull of the vertices of a part and their concavity.
+		 *
+		 * \param points
+		 *      Vertices of the part.
+		 *
+		 * \return Concavity of the part (see computeConcavity()).
+		 */
+		static double measure(const std::vector<Eigen::Vector3d> &points);
+
+		//! Maximum number of vertices of the model which are used (the others are skipped evenly)
+		static const unsigned int MAX_POINTS = 4096;
+		//! Relative positions of the split-planes in the AABB of a part
+		static const double SPLIT_POSITIONS[3];
+		//! Width of the band around the split-plane (relative to the diagonal of the model) which is in both parts
+		static const double OVERLAP;
+		//! A split which does not reduce the concavity below this ratio is discarded (the part is final)
+		static const double MIN_IMPROVEMENT;
+
+		//! Decomposition of the loaded models is disabled by default
+		static bool IS_ENABLED;
+	};
+}
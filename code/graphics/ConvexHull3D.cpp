@@ -7,6 +7,10 @@
 
 #include "ConvexHull3D.h"
 
+#include <algorithm>
+
+#include "GjkAlgorithm.h"
+
 #include <CGAL/convex_hull_3.h>
 
 #include <CGAL/Surface_mesh_simplification/edge_collapse.h>
@@ -17,6 +21,9 @@
 using namespace pbs17;
 namespace SMS = CGAL::Surface_mesh_simplification;
 
+//! Hulls with at most this number of vertices are their own coarse level
+const unsigned int ConvexHull3D::MAX_COARSE_VERTICES;
+
 
 /**
  * \brief Constructor which initializes the convex-hull based on the given vertices.
@@ -29,6 +36,39 @@ ConvexHull3D::ConvexHull3D(osg::Vec3Array* vertices) {
 }
 
 
+/**
+ * \brief Constructor which initializes an already computed convex-hull (e.g. from the asset-cache).
+ * No CGAL-model is available for such a hull.
+ *
+ * \param vertices
+ *      Vertices of the convex-hull.
+ * \param faces
+ *      Triangles of the convex-hull => (#F x 3)-matrix. (based on vertices)
+ * \param adjacencyStart
+ *      First entry in adjacency per vertex (size = #V + 1).
+ * \param adjacency
+ *      Neighbours of all vertices.
+ */
+ConvexHull3D::ConvexHull3D(const std::vector<Eigen::Vector3d> &vertices, const Eigen::MatrixXi &faces,
+	const std::vector<int> &adjacencyStart, const std::vector<int> &adjacency)
+	: _vertices(vertices), _faces(faces), _adjacencyStart(adjacencyStart), _adjacency(adjacency) {
+	_osgModel = toGeometry(_vertices, _faces);
+	computeBounds();
+	computeCoarseHull();
+}
+
+
+/**
+ * \brief Destructor (deletes the convex parts of a compound).
+ */
+ConvexHull3D::~ConvexHull3D() {
+	for (unsigned int i = 0; i < _parts.size(); ++i) {
+		delete _parts[i];
+	}
+	delete _distanceField;
+}
+
+
 /**
  * \brief Initialize the convex-hull based on the given vertices.
  *
@@ -45,10 +85,53 @@ void ConvexHull3D::init(osg::Vec3Array* vertices) {
 	}
 
 	// Define polyhedron to hold convex hull and compute convex hull of non-collinear points
-	CGAL::convex_hull_3(points.begin(), points.end(), _cgalModel);
-	simplifyCgalModel(_cgalModel, 300);
+	// (only needed during the conversion, the hull keeps the eigen- and osg-representation)
+	Polyhedron_3 polyhedron;
+	CGAL::convex_hull_3(points.begin(), points.end(), polyhedron);
+	simplifyCgalModel(polyhedron, 300);
 
-	fromPolyhedron(_cgalModel, _osgModel, _vertices);
+	fromPolyhedron(polyhedron, _osgModel, _vertices, _faces);
+	computeAdjacency(polyhedron, _adjacencyStart, _adjacency);
+	computeBounds();
+	computeCoarseHull();
+}
+
+
+/**
+ * \brief Estimate the memory of the hull (vertices, faces, adjacency, coarse level and the osg-geometry).
+ *
+ * \return Memory in bytes.
+ */
+size_t ConvexHull3D::getMemorySize() const {
+	size_t size = sizeof(ConvexHull3D);
+	size += _vertices.capacity() * sizeof(Eigen::Vector3d);
+	size += static_cast<size_t>(_faces.size()) * sizeof(int);
+	size += (_adjacencyStart.capacity() + _adjacency.capacity()) * sizeof(int);
+	size += _coarseVertices.capacity() * sizeof(Eigen::Vector3d);
+	size += _partTree.capacity() * sizeof(PartNode);
+
+	for (unsigned int i = 0; i < _parts.size(); ++i) {
+		size += _parts[i]->getMemorySize();
+	}
+	if (_distanceField) {
+		size += _distanceField->getMemorySize();
+	}
+
+	if (_osgModel.valid()) {
+		osg::Geometry::ArrayList arrays;
+		_osgModel->getArrayList(arrays);
+		for (unsigned int i = 0; i < arrays.size(); ++i) {
+			size += arrays[i]->getTotalDataSize();
+		}
+		for (unsigned int i = 0; i < _osgModel->getNumPrimitiveSets(); ++i) {
+			const osg::DrawElements* elements = _osgModel->getPrimitiveSet(i)->getDrawElements();
+			if (elements) {
+				size += elements->getTotalDataSize();
+			}
+		}
+	}
+
+	return size;
 }
 
 
@@ -94,41 +177,274 @@ void ConvexHull3D::simplifyCgalModel(Polyhedron_3& polyhedron, int numEdges) {
  *		Output-parameter:
  *			Input:		ignored
  *			Output:		Eigen-vectors with all the vertices
+ * \param faces
+ *		Output-parameter:
+ *			Input:		ignored
+ *			Output:		Triangles of the convex-hull => (#F x 3)-matrix
  */
-void ConvexHull3D::fromPolyhedron(Polyhedron_3 &convexHull, osg::ref_ptr<osg::Geometry> &geometry, std::vector<Eigen::Vector3d> &vertices) {
+void ConvexHull3D::fromPolyhedron(Polyhedron_3 &convexHull, osg::ref_ptr<osg::Geometry> &geometry, std::vector<Eigen::Vector3d> &vertices, Eigen::MatrixXi &faces) {
 	// Reset output-parameters
-	geometry = new osg::Geometry;
 	vertices.resize(0);
+	faces.resize(convexHull.size_of_facets(), 3);
 
-	// Vectors to store the vertices and faces of the convex-hull
-	osg::ref_ptr<osg::Vec3Array> convexVertices = new osg::Vec3Array;
-	osg::ref_ptr<osg::DrawElementsUInt> convexFaces = new osg::DrawElementsUInt(GL_TRIANGLES);
-
-	// Set the index of each vertex and add it to the convex-hull-vertices (osg)
+	// Set the index of each vertex and add it to the convex-hull-vertices
 	unsigned int index = 0;
 	for (Vertex_iterator v = convexHull.vertices_begin(); v != convexHull.vertices_end(); ++v, ++index) {
 		v->id() = index;
 		Point_3 vertex = v->point();
 
-		convexVertices->push_back(osg::Vec3(CGAL::to_double(vertex[0]), CGAL::to_double(vertex[1]), CGAL::to_double(vertex[2])));
 		vertices.push_back(Eigen::Vector3d(CGAL::to_double(vertex[0]), CGAL::to_double(vertex[1]), CGAL::to_double(vertex[2])));
 	}
 
-	// Store each face of the convex-hull
+	// Store each face of the convex-hull (the hull and its simplification are triangulated)
 	unsigned int row = 0;
 	for (Facet_iterator pFacet = convexHull.facets_begin(); pFacet != convexHull.facets_end(); ++pFacet) {
 		unsigned int col = 0;
 		Halfedge_around_facet_circulator pHalfedge = pFacet->facet_begin();
 
 		do {
-			convexFaces->push_back(pHalfedge->vertex()->id());
+			faces(row, col) = pHalfedge->vertex()->id();
 			++col;
-		} while (++pHalfedge != pFacet->facet_begin());
+		} while (++pHalfedge != pFacet->facet_begin() && col < 3);
 
 		++row;
 	}
 
+	geometry = toGeometry(vertices, faces);
+}
+
+
+/**
+ * \brief Create the geometry from OSG (to render) of a triangulated convex-hull.
+ *
+ * \param vertices
+ *      Vertices of the convex-hull.
+ * \param faces
+ *      Triangles of the convex-hull => (#F x 3)-matrix.
+ *
+ * \return Geometry for OSG to render the convex-hull.
+ */
+osg::ref_ptr<osg::Geometry> ConvexHull3D::toGeometry(const std::vector<Eigen::Vector3d> &vertices, const Eigen::MatrixXi &faces) {
+	// Vectors to store the vertices and faces of the convex-hull
+	osg::ref_ptr<osg::Vec3Array> convexVertices = new osg::Vec3Array;
+	osg::ref_ptr<osg::DrawElementsUInt> convexFaces = new osg::DrawElementsUInt(GL_TRIANGLES);
+
+	for (unsigned int i = 0; i < vertices.size(); ++i) {
+		convexVertices->push_back(osg::Vec3(vertices[i].x(), vertices[i].y(), vertices[i].z()));
+	}
+
+	for (int row = 0; row < faces.rows(); ++row) {
+		for (int col = 0; col < 3; ++col) {
+			convexFaces->push_back(faces(row, col));
+		}
+	}
+
 	// Create the osg-entity which represents the convex-hull
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
 	geometry->setVertexArray(convexVertices);
 	geometry->addPrimitiveSet(convexFaces);
+
+	return geometry;
+}
+
+
+/**
+ * \brief Get the vertex-adjacency of the polyhedron (used by the hill-climbing of the support-function).
+ * The ids of the vertices have to be set (see fromPolyhedron).
+ *
+ * \param convexHull
+ *      Polyhedron which is the convex-hull.
+ * \param adjacencyStart
+ *		Output-parameter: First entry in adjacency per vertex (size = #V + 1).
+ * \param adjacency
+ *		Output-parameter: Neighbours of all vertices.
+ */
+void ConvexHull3D::computeAdjacency(Polyhedron_3 &convexHull, std::vector<int> &adjacencyStart, std::vector<int> &adjacency) {
+	adjacencyStart.assign(convexHull.size_of_vertices() + 1, 0);
+	adjacency.clear();
+	adjacency.reserve(convexHull.size_of_halfedges());
+
+	for (Vertex_iterator v = convexHull.vertices_begin(); v != convexHull.vertices_end(); ++v) {
+		adjacencyStart[v->id()] = adjacency.size();
+
+		// the halfedges around the vertex point to it => the neighbour is on the opposite end
+		Halfedge_around_vertex_circulator pHalfedge = v->vertex_begin();
+		do {
+			adjacency.push_back(pHalfedge->opposite()->vertex()->id());
+		} while (++pHalfedge != v->vertex_begin());
+	}
+
+	adjacencyStart[convexHull.size_of_vertices()] = adjacency.size();
+}
+
+
+/**
+ * \brief Compute the bounding-sphere and the AABB of the vertices.
+ */
+void ConvexHull3D::computeBounds() {
+	_radius = 0.0;
+	_boxMin = _vertices.empty() ? Eigen::Vector3d::Zero() : _vertices[0];
+	_boxMax = _boxMin;
+
+	for (unsigned int i = 0; i < _vertices.size(); ++i) {
+		_radius = std::max(_radius, _vertices[i].norm());
+		_boxMin = _boxMin.cwiseMin(_vertices[i]);
+		_boxMax = _boxMax.cwiseMax(_vertices[i]);
+	}
+}
+
+
+/**
+ * \brief Compute the coarse level of the hull and its margin.
+ */
+void ConvexHull3D::computeCoarseHull() {
+	_coarseMargin = 0.0;
+
+	if (_vertices.size() <= MAX_COARSE_VERTICES) {
+		_coarseVertices = _vertices;
+		return;
+	}
+
+	// support-vertices towards the faces, edges and corners of a cube
+	std::vector<int> support;
+	for (int x = -1; x <= 1; ++x) {
+		for (int y = -1; y <= 1; ++y) {
+			for (int z = -1; z <= 1; ++z) {
+				if (x == 0 && y == 0 && z == 0) continue;
+
+				Eigen::Vector3d direction(x, y, z);
+				int best = 0;
+				for (unsigned int i = 1; i < _vertices.size(); ++i) {
+					if (_vertices[i].dot(direction) > _vertices[best].dot(direction)) {
+						best = i;
+					}
+				}
+
+				support.push_back(best);
+			}
+		}
+	}
+
+	std::sort(support.begin(), support.end());
+	support.erase(std::unique(support.begin(), support.end()), support.end());
+
+	_coarseVertices.clear();
+	for (unsigned int i = 0; i < support.size(); ++i) {
+		_coarseVertices.push_back(_vertices[support[i]]);
+	}
+
+	// the vertices outside of the coarse hull are covered by the margin
+	ConvexShape coarseHull(_coarseVertices);
+	for (unsigned int i = 0; i < _vertices.size(); ++i) {
+		Eigen::Vector3d closest;
+		if (GjkAlgorithm::getClosestPoint(coarseHull, _vertices[i], closest)) {
+			_coarseMargin = std::max(_coarseMargin, (_vertices[i] - closest).norm());
+		}
+	}
+}
+
+
+/**
+ * \brief Set the convex parts of a concave model (see ConvexDecomposition), the hull stays the convex
+ * envelope of all parts (used by the broad-, mid- and continuous phase). The hierarchy over the parts is
+ * built again.
+ *
+ * \param parts
+ *      Convex parts in the same model-space (owned by the hull afterwards, less than two => no compound).
+ */
+void ConvexHull3D::setParts(const std::vector<ConvexHull3D*> &parts) {
+	for (unsigned int i = 0; i < _parts.size(); ++i) {
+		delete _parts[i];
+	}
+	_parts.clear();
+	_partTree.clear();
+
+	// a single part is the hull itself
+	if (parts.size() < 2) {
+		for (unsigned int i = 0; i < parts.size(); ++i) {
+			delete parts[i];
+		}
+		return;
+	}
+
+	_parts = parts;
+
+	std::vector<int> indices(_parts.size());
+	for (unsigned int i = 0; i < indices.size(); ++i) {
+		indices[i] = i;
+	}
+
+	_partTree.reserve(2 * _parts.size() - 1);
+	buildPartNode(indices, 0, static_cast<int>(indices.size()));
+}
+
+
+/**
+ * \brief Set the signed distance field of the model (see DistanceField), e.g. after computing or loading it.
+ *
+ * \param distanceField
+ *      Field in the same model-space (owned by the hull afterwards, nullptr => the contacts only use EPA).
+ */
+void ConvexHull3D::setDistanceField(DistanceField* distanceField) {
+	if (distanceField != _distanceField) {
+		delete _distanceField;
+	}
+
+	_distanceField = distanceField;
+}
+
+
+/**
+ * \brief Build the node of the part-hierarchy of a range of parts (split at the median of the centers along
+ * the longest axis).
+ *
+ * \param parts
+ *      Output-parameter: Indices of the parts, the range is sorted along the split-axis.
+ * \param first, last
+ *      Range of the parts of the node.
+ *
+ * \return Index of the node in _partTree.
+ */
+int ConvexHull3D::buildPartNode(std::vector<int> &parts, int first, int last) {
+	int index = static_cast<int>(_partTree.size());
+	_partTree.push_back(PartNode());
+
+	Eigen::Vector3d boxMin = _parts[parts[first]]->getBoxMin();
+	Eigen::Vector3d boxMax = _parts[parts[first]]->getBoxMax();
+	for (int i = first + 1; i < last; ++i) {
+		boxMin = boxMin.cwiseMin(_parts[parts[i]]->getBoxMin());
+		boxMax = boxMax.cwiseMax(_parts[parts[i]]->getBoxMax());
+	}
+
+	// sphere around the center of the AABB which contains all vertices of the parts
+	Eigen::Vector3d center = 0.5 * (boxMin + boxMax);
+	double radius = 0.0;
+	for (int i = first; i < last; ++i) {
+		const std::vector<Eigen::Vector3d> &vertices = _parts[parts[i]]->getVertices();
+		for (unsigned int v = 0; v < vertices.size(); ++v) {
+			radius = std::max(radius, (vertices[v] - center).norm());
+		}
+	}
+
+	_partTree[index].center = center;
+	_partTree[index].radius = radius;
+
+	if (last - first == 1) {
+		_partTree[index].part = parts[first];
+		return index;
+	}
+
+	int axis;
+	(boxMax - boxMin).maxCoeff(&axis);
+	int middle = (first + last) / 2;
+	std::nth_element(parts.begin() + first, parts.begin() + middle, parts.begin() + last, [this, axis](int a, int b) {
+		return _parts[a]->getBoxMin()[axis] + _parts[a]->getBoxMax()[axis] < _parts[b]->getBoxMin()[axis] + _parts[b]->getBoxMax()[axis];
+	});
+
+	int left = buildPartNode(parts, first, middle);
+	int right = buildPartNode(parts, middle, last);
+	_partTree[index].left = left;
+	_partTree[index].right = right;
+
+	return index;
 }
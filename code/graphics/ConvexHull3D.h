@@ -11,6 +11,7 @@
 #include <osg/Geometry>
 
 #include "CGAL.h"
+#include "DistanceField.h"
 
 namespace pbs17 {
 
@@ -29,6 +30,32 @@ namespace pbs17 {
 		ConvexHull3D(osg::Vec3Array* vertices);
 
 
+		/**
+		 * \brief Constructor which initializes an already computed convex-hull (e.g. from the asset-cache).
+		 * No CGAL-model is available for such a hull.
+		 * 
+		 * \param vertices
+		 *      Vertices of the convex-hull.
+		 * \param faces
+		 *      Triangles of the convex-hull => (#F x 3)-matrix. (based on vertices)
+		 * \param adjacencyStart
+		 *      First entry in adjacency per vertex (size = #V + 1).
+		 * \param adjacency
+		 *      Neighbours of all vertices.
+		 */
+		ConvexHull3D(const std::vector<Eigen::Vector3d> &vertices, const Eigen::MatrixXi &faces,
+			const std::vector<int> &adjacencyStart, const std::vector<int> &adjacency);
+
+
+		/**
+		 * \brief Destructor (deletes the convex parts of a compound).
+		 */
+		~ConvexHull3D();
+
+		ConvexHull3D(const ConvexHull3D&) = delete;
+		ConvexHull3D& operator=(const ConvexHull3D&) = delete;
+
+
 		/**
 		* \brief Initialize the convex-hull based on the given vertices.
 		*
@@ -58,6 +85,157 @@ namespace pbs17 {
 		}
 
 
+		/**
+		 * \brief Get the first entry in the adjacency per vertex.
+		 * 
+		 * \return Offsets into getAdjacency() (size = #V + 1).
+		 */
+		const std::vector<int>& getAdjacencyStart() const {
+			return _adjacencyStart;
+		}
+
+
+		/**
+		 * \brief Get the neighbours of all vertices (the neighbours of vertex i are stored from
+		 * getAdjacencyStart()[i] to getAdjacencyStart()[i + 1]).
+		 * 
+		 * \return Indices of the neighbours.
+		 */
+		const std::vector<int>& getAdjacency() const {
+			return _adjacency;
+		}
+
+
+		/**
+		 * \brief Get the radius of the bounding-sphere around the origin of the model (used by the mid-phase).
+		 * 
+		 * \return Largest distance of a vertex to the origin.
+		 */
+		double getRadius() const {
+			return _radius;
+		}
+
+
+		/**
+		 * \brief Get the minimum of the AABB of the vertices in the model-space (box of the OBB-test).
+		 * 
+		 * \return Minimum of the AABB.
+		 */
+		const Eigen::Vector3d& getBoxMin() const {
+			return _boxMin;
+		}
+
+
+		/**
+		 * \brief Get the maximum of the AABB of the vertices in the model-space (box of the OBB-test).
+		 * 
+		 * \return Maximum of the AABB.
+		 */
+		const Eigen::Vector3d& getBoxMax() const {
+			return _boxMax;
+		}
+
+
+		/**
+		 * \brief Get the vertices of the coarse level: the support-vertices of the hull in 26 directions. The hull
+		 * is contained in the coarse hull enlarged by the coarse margin, so the coarse level is a conservative test.
+		 * 
+		 * \return Vertices of the coarse hull (all vertices if the hull is small).
+		 */
+		const std::vector<Eigen::Vector3d>& getCoarseVertices() const {
+			return _coarseVertices;
+		}
+
+
+		/**
+		 * \brief Get the largest distance of a vertex of the hull to the coarse hull.
+		 * 
+		 * \return Margin around the coarse hull (in the model-space).
+		 */
+		double getCoarseMargin() const {
+			return _coarseMargin;
+		}
+
+
+		//! Hulls with at most this number of vertices are their own coarse level
+		static const unsigned int MAX_COARSE_VERTICES = 32;
+
+
+		/**
+		 * \brief Node of the bounding-sphere hierarchy over the parts of a compound (in the model-space).
+		 */
+		struct PartNode {
+			//! Bounding-sphere of all parts below the node
+			Eigen::Vector3d center = Eigen::Vector3d::Zero();
+			double radius = 0.0;
+			//! Children of an inner node (-1 => leaf)
+			int left = -1;
+			int right = -1;
+			//! Part of a leaf (-1 => inner node)
+			int part = -1;
+		};
+
+
+		/**
+		 * \brief Set the convex parts of a concave model (see ConvexDecomposition), the hull stays the convex
+		 * envelope of all parts (used by the broad-, mid- and continuous phase). The hierarchy over the parts is
+		 * built again.
+		 *
+		 * \param parts
+		 *      Convex parts in the same model-space (owned by the hull afterwards, less than two => no compound).
+		 */
+		void setParts(const std::vector<ConvexHull3D*> &parts);
+
+
+		/**
+		 * \brief Check if the model is concave and collides with its convex parts.
+		 *
+		 * \return True if the hull has at least two parts.
+		 */
+		bool isCompound() const {
+			return !_parts.empty();
+		}
+
+
+		/**
+		 * \brief Get the convex parts of a compound.
+		 *
+		 * \return Parts in the model-space (empty if the model is convex).
+		 */
+		const std::vector<ConvexHull3D*>& getParts() const {
+			return _parts;
+		}
+
+
+		/**
+		 * \brief Get the bounding-sphere hierarchy over the parts (the root is the first node).
+		 *
+		 * \return Nodes of the hierarchy (empty if the model is convex).
+		 */
+		const std::vector<PartNode>& getPartTree() const {
+			return _partTree;
+		}
+
+
+		/**
+		 * \brief Set the signed distance field of the model (see DistanceField), e.g. after computing or loading it.
+		 *
+		 * \param distanceField
+		 *      Field in the same model-space (owned by the hull afterwards, nullptr => the contacts only use EPA).
+		 */
+		void setDistanceField(DistanceField* distanceField);
+
+
+		/**
+		 * \brief Get the signed distance field of the deep contacts.
+		 *
+		 * \return Field in the model-space (nullptr if there is none).
+		 */
+		const DistanceField* getDistanceField() const {
+			return _distanceField;
+		}
+
+
 		/**
 		 * \brief Get the osg-model which can be added to the scene-graph.
 		 * 
@@ -69,13 +247,11 @@ namespace pbs17 {
 
 
 		/**
-		 * \brief Get the cgal-model which is calculated as the convex-hull from cgal.
+		 * \brief Estimate the memory of the hull (vertices, faces, adjacency, coarse level and the osg-geometry).
 		 * 
-		 * \return Polyhedron which represents the convex-hull.
+		 * \return Memory in bytes.
 		 */
-		Polyhedron_3 getCgalModel() const {
-			return _cgalModel;
-		}
+		size_t getMemorySize() const;
 
 
 		/**
@@ -105,8 +281,65 @@ namespace pbs17 {
 		 *		Output-parameter:
 		 *			Input:		ignored
 		 *			Output:		Eigen-vectors with all the vertices
+		 * \param faces
+		 *		Output-parameter:
+		 *			Input:		ignored
+		 *			Output:		Triangles of the convex-hull => (#F x 3)-matrix
 		 */
-		static void fromPolyhedron(Polyhedron_3 &convexHull, osg::ref_ptr<osg::Geometry> &geometry, std::vector<Eigen::Vector3d> &vertices);
+		static void fromPolyhedron(Polyhedron_3 &convexHull, osg::ref_ptr<osg::Geometry> &geometry, std::vector<Eigen::Vector3d> &vertices, Eigen::MatrixXi &faces);
+
+
+		/**
+		 * \brief Create the geometry from OSG (to render) of a triangulated convex-hull.
+		 * 
+		 * \param vertices
+		 *      Vertices of the convex-hull.
+		 * \param faces
+		 *      Triangles of the convex-hull => (#F x 3)-matrix.
+		 * 
+		 * \return Geometry for OSG to render the convex-hull.
+		 */
+		static osg::ref_ptr<osg::Geometry> toGeometry(const std::vector<Eigen::Vector3d> &vertices, const Eigen::MatrixXi &faces);
+
+
+		/**
+		 * \brief Get the vertex-adjacency of the polyhedron (used by the hill-climbing of the support-function).
+		 * The ids of the vertices have to be set (see fromPolyhedron).
+		 * 
+		 * \param convexHull
+		 *      Polyhedron which is the convex-hull.
+		 * \param adjacencyStart
+		 *		Output-parameter: First entry in adjacency per vertex (size = #V + 1).
+		 * \param adjacency
+		 *		Output-parameter: Neighbours of all vertices.
+		 */
+		static void computeAdjacency(Polyhedron_3 &convexHull, std::vector<int> &adjacencyStart, std::vector<int> &adjacency);
+
+
+		/**
+		 * \brief Compute the bounding-sphere and the AABB of the vertices.
+		 */
+		void computeBounds();
+
+
+		/**
+		 * \brief Compute the coarse level of the hull and its margin.
+		 */
+		void computeCoarseHull();
+
+
+		/**
+		 * \brief Build the node of the part-hierarchy of a range of parts (split at the median of the centers along
+		 * the longest axis).
+		 *
+		 * \param parts
+		 *      Output-parameter: Indices of the parts, the range is sorted along the split-axis.
+		 * \param first, last
+		 *      Range of the parts of the node.
+		 *
+		 * \return Index of the node in _partTree.
+		 */
+		int buildPartNode(std::vector<int> &parts, int first, int last);
 
 
 	private:
@@ -117,11 +350,29 @@ namespace pbs17 {
 		//! Faced which belongs on the convex-hull => (#F x 3)-matrix. (based on _vertices)
 		Eigen::MatrixXi _faces;
 
+		//! First entry in _adjacency per vertex (size = #V + 1)
+		std::vector<int> _adjacencyStart;
+		//! Neighbours of all vertices (based on _vertices)
+		std::vector<int> _adjacency;
+
+		//! Bounding-sphere around the origin and AABB of the vertices in the model-space
+		double _radius = 0.0;
+		Eigen::Vector3d _boxMin = Eigen::Vector3d::Zero();
+		Eigen::Vector3d _boxMax = Eigen::Vector3d::Zero();
+
+		//! Vertices of the coarse level and the distance of the hull to it
+		std::vector<Eigen::Vector3d> _coarseVertices;
+		double _coarseMargin = 0.0;
+
 		//! Generated geometry which represents the convex-hull in OSG.
 		osg::ref_ptr<osg::Geometry> _osgModel;
 
-		//! Generated geometry which represents the convex-hull in CGAL.
-		Polyhedron_3 _cgalModel;
+		//! Convex parts of a concave model and the bounding-sphere hierarchy over them
+		std::vector<ConvexHull3D*> _parts;
+		std::vector<PartNode> _partTree;
+
+		//! Signed distance field of the deep contacts (nullptr => none)
+		DistanceField* _distanceField = nullptr;
 
 	};
 }
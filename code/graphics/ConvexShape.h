@@ -0,0 +1,161 @@
+﻿/**
+ * \brief Support-mapping of a convex-hull which is used by the GJK-algorithm and EPA.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-29
+ */
+
+#pragma once
+
+#include <vector>
+#include <limits>
+
+#include <Eigen/Core>
+
+#include "SoaVertices.h"
+
+namespace pbs17 {
+	/**
+	 * \brief Vertices of a convex-hull with their adjacency. The furthest vertex in a direction is found by
+	 * hill-climbing along the edges, starting from the vertex of the previous query. On a convex polyhedron
+	 * the local maximum is the global one, so only a few vertices are visited if the direction changes slowly.
+	 * Without adjacency, all vertices are scanned (vectorized if the shape has a single precision copy of the
+	 * vertices, which also replaces the first hill-climbing of a shape without a previous query).
+	 */
+	class ConvexShape {
+	public:
+		/**
+		 * \brief Constructor of a shape without adjacency (linear scan).
+		 *
+		 * \param vertices
+		 *      Vertices of the convex-hull.
+		 * \param soa
+		 *      Single precision copy of the vertices (nullptr => scanned in double precision).
+		 */
+		ConvexShape(const std::vector<Eigen::Vector3d> &vertices, const SoaVertices* soa = nullptr)
+			: _vertices(vertices), _adjacencyStart(nullptr), _adjacency(nullptr), _soa(soa), _lastVertex(0), _isFresh(false) {
+			if (_soa != nullptr && _soa->size() != vertices.size()) {
+				_soa = nullptr;
+			}
+		}
+
+
+		/**
+		 * \brief Constructor of a shape with adjacency (hill-climbing).
+		 *
+		 * \param vertices
+		 *      Vertices of the convex-hull.
+		 * \param adjacencyStart
+		 *      First entry in adjacency per vertex (size = #V + 1).
+		 * \param adjacency
+		 *      Neighbours of all vertices.
+		 * \param startVertex
+		 *      Vertex to start the first query from (e.g. the result of the previous frame, < 0 => no previous query).
+		 * \param soa
+		 *      Single precision copy of the vertices (nullptr => the first query climbs from the first vertex).
+		 */
+		ConvexShape(const std::vector<Eigen::Vector3d> &vertices, const std::vector<int> &adjacencyStart, const std::vector<int> &adjacency, int startVertex,
+			const SoaVertices* soa = nullptr)
+			: _vertices(vertices), _adjacencyStart(&adjacencyStart), _adjacency(&adjacency), _soa(soa), _lastVertex(0), _isFresh(startVertex < 0) {
+			if (adjacencyStart.size() != vertices.size() + 1) {
+				_adjacencyStart = nullptr;
+				_adjacency = nullptr;
+			}
+
+			if (_soa != nullptr && _soa->size() != vertices.size()) {
+				_soa = nullptr;
+			}
+
+			if (startVertex >= 0 && startVertex < static_cast<int>(vertices.size())) {
+				_lastVertex = startVertex;
+			}
+		}
+
+
+		/**
+		 * \brief Get the furthest vertex of the convex-hull in the given direction.
+		 *
+		 * \param direction
+		 *      Direction to search the furthest vertex.
+		 *
+		 * \return Furthest vertex.
+		 */
+		const Eigen::Vector3d& getFurthestPoint(const Eigen::Vector3d &direction) {
+			// the vectorized scan replaces the full scan, and the hill-climbing over the whole hull of a fresh shape
+			if (_soa != nullptr && (_adjacencyStart == nullptr || _isFresh)) {
+				_lastVertex = _soa->getFurthest(direction);
+				_isFresh = false;
+
+				// the climbing corrects the rounding of the single precision
+				if (_adjacencyStart == nullptr) {
+					return _vertices[_lastVertex];
+				}
+			}
+
+			if (_adjacencyStart == nullptr) {
+				double max = -std::numeric_limits<double>::max();
+
+				for (unsigned int i = 0; i < _vertices.size(); ++i) {
+					double dot = _vertices[i].dot(direction);
+
+					if (dot > max) {
+						max = dot;
+						_lastVertex = i;
+					}
+				}
+
+				return _vertices[_lastVertex];
+			}
+
+			int current = _lastVertex;
+			double max = _vertices[current].dot(direction);
+			bool improved = true;
+
+			// move to a better neighbour as long as there is one
+			while (improved) {
+				improved = false;
+				int from = current;
+
+				for (int k = (*_adjacencyStart)[from]; k < (*_adjacencyStart)[from + 1]; ++k) {
+					int neighbour = (*_adjacency)[k];
+					double dot = _vertices[neighbour].dot(direction);
+
+					if (dot > max) {
+						max = dot;
+						current = neighbour;
+						improved = true;
+					}
+				}
+			}
+
+			_lastVertex = current;
+			return _vertices[current];
+		}
+
+
+		/**
+		 * \brief Get the vertex of the last query (to warm-start the next frame).
+		 *
+		 * \return Index of the vertex.
+		 */
+		int getLastVertex() const {
+			return _lastVertex;
+		}
+
+
+	private:
+
+		//! Vertices of the convex-hull
+		const std::vector<Eigen::Vector3d> &_vertices;
+		//! First entry in _adjacency per vertex (nullptr => no adjacency)
+		const std::vector<int>* _adjacencyStart;
+		//! Neighbours of all vertices
+		const std::vector<int>* _adjacency;
+		//! Single precision copy of the vertices (nullptr => scanned in double precision)
+		const SoaVertices* _soa;
+		//! Vertex of the last query
+		int _lastVertex;
+		//! True if the shape has no vertex of a previous query yet
+		bool _isFresh;
+	};
+}
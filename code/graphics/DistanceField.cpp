@@ -0,0 +1,220 @@
+﻿/**
+ * \brief Narrow-band signed distance field of a model for the deep contacts.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "DistanceField.h"
+
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <Eigen/Geometry>
+
+#include "ConvexHull3D.h"
+
+using namespace pbs17;
+
+
+//! Fields are disabled by default
+bool DistanceField::IS_ENABLED = false;
+//! Cells along the longest axis of the models
+int DistanceField::RESOLUTION = 32;
+
+//! Cells of the band around the AABB of the hull
+const int DistanceField::BAND_CELLS;
+//! Hulls with fewer vertices use EPA for all contacts (unless they are compounds)
+const unsigned int DistanceField::MIN_VERTICES;
+
+
+/**
+ * \brief Constructor of a computed field (e.g. from the asset-cache).
+ *
+ * \param origin
+ *      Position of the first sample in the model-space.
+ * \param cellSize
+ *      Distance between two samples.
+ * \param dims
+ *      Number of samples per axis (at least 2).
+ * \param values
+ *      Signed distances, x runs fastest (size = dims.prod()).
+ */
+DistanceField::DistanceField(const Eigen::Vector3d &origin, double cellSize, const Eigen::Vector3i &dims, const std::vector<float> &values)
+	: _origin(origin), _cellSize(cellSize), _dims(dims), _values(values) {
+}
+
+
+/**
+ * \brief Compute the field of a hull (and its parts) with getResolution() cells along the longest axis.
+ *
+ * \param hull
+ *      Convex-hull of the model (the parts of a compound are used instead of the envelope).
+ *
+ * \return New field (owned by the caller).
+ */
+DistanceField* DistanceField::compute(const ConvexHull3D &hull) {
+	// a compound is the union of its parts => the smallest distance of the parts
+	std::vector<std::vector<Plane> > parts;
+	if (hull.isCompound()) {
+		parts.resize(hull.getParts().size());
+		for (unsigned int p = 0; p < parts.size(); ++p) {
+			collectPlanes(*hull.getParts()[p], parts[p]);
+		}
+	} else {
+		parts.resize(1);
+		collectPlanes(hull, parts[0]);
+	}
+
+	Eigen::Vector3d extent = hull.getBoxMax() - hull.getBoxMin();
+	double cellSize = std::max(extent.maxCoeff(), 1e-9) / RESOLUTION;
+	Eigen::Vector3d origin = hull.getBoxMin() - Eigen::Vector3d::Constant(BAND_CELLS * cellSize);
+	Eigen::Vector3i dims;
+	for (int k = 0; k < 3; ++k) {
+		dims[k] = static_cast<int>(std::ceil(extent[k] / cellSize)) + 1 + 2 * BAND_CELLS;
+	}
+
+	std::vector<float> values(static_cast<size_t>(dims.prod()));
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+	for (int z = 0; z < dims.z(); ++z) {
+		for (int y = 0; y < dims.y(); ++y) {
+			for (int x = 0; x < dims.x(); ++x) {
+				Eigen::Vector3d point = origin + cellSize * Eigen::Vector3d(x, y, z);
+				double distance = std::numeric_limits<double>::infinity();
+
+				for (unsigned int p = 0; p < parts.size(); ++p) {
+					double partDistance = -std::numeric_limits<double>::infinity();
+					for (unsigned int i = 0; i < parts[p].size(); ++i) {
+						partDistance = std::max(partDistance, parts[p][i].normal.dot(point) - parts[p][i].offset);
+					}
+					distance = std::min(distance, partDistance);
+				}
+
+				values[(static_cast<size_t>(z) * dims.y() + y) * dims.x() + x] = static_cast<float>(distance);
+			}
+		}
+	}
+
+	return new DistanceField(origin, cellSize, dims, values);
+}
+
+
+/**
+ * \brief Check if the contacts of a hull profit from a field: the hulls with many vertices and the compounds.
+ *
+ * \param hull
+ *      Convex-hull of the model.
+ *
+ * \return True if a field should be computed.
+ */
+bool DistanceField::isUseful(const ConvexHull3D &hull) {
+	return hull.isCompound() || hull.getVertices().size() >= MIN_VERTICES;
+}
+
+
+/**
+ * \brief Sample the distance and its gradient at a point (trilinear interpolation).
+ *
+ * \param point
+ *      Point in the unscaled model-space.
+ * \param distance
+ *      Output-parameter: Signed distance to the surface (negative inside).
+ * \param gradient
+ *      Output-parameter: Gradient of the distance (not normalized, points outwards).
+ *
+ * \return False if the point is outside of the grid (farther than the band from the model).
+ */
+bool DistanceField::sample(const Eigen::Vector3d &point, double &distance, Eigen::Vector3d &gradient) const {
+	Eigen::Vector3d cell = (point - _origin) / _cellSize;
+	int i[3];
+	double f[3];
+
+	for (int k = 0; k < 3; ++k) {
+		double c = std::floor(cell[k]);
+		if (c < 0.0 || c >= _dims[k] - 1) {
+			return false;
+		}
+		i[k] = static_cast<int>(c);
+		f[k] = cell[k] - c;
+	}
+
+	const size_t strideY = _dims.x();
+	const size_t strideZ = static_cast<size_t>(_dims.x()) * _dims.y();
+	const float* v = &_values[i[2] * strideZ + i[1] * strideY + i[0]];
+
+	// corners of the cell (x, y, z as bits of the index)
+	double c000 = v[0], c100 = v[1];
+	double c010 = v[strideY], c110 = v[strideY + 1];
+	double c001 = v[strideZ], c101 = v[strideZ + 1];
+	double c011 = v[strideZ + strideY], c111 = v[strideZ + strideY + 1];
+
+	double c00 = c000 + f[0] * (c100 - c000);
+	double c10 = c010 + f[0] * (c110 - c010);
+	double c01 = c001 + f[0] * (c101 - c001);
+	double c11 = c011 + f[0] * (c111 - c011);
+	double c0 = c00 + f[1] * (c10 - c00);
+	double c1 = c01 + f[1] * (c11 - c01);
+	distance = c0 + f[2] * (c1 - c0);
+
+	// derivatives of the trilinear interpolation
+	double dx0 = (c100 - c000) + f[1] * ((c110 - c010) - (c100 - c000));
+	double dx1 = (c101 - c001) + f[1] * ((c111 - c011) - (c101 - c001));
+	gradient.x() = dx0 + f[2] * (dx1 - dx0);
+	gradient.y() = (c10 - c00) + f[2] * ((c11 - c01) - (c10 - c00));
+	gradient.z() = c1 - c0;
+	gradient /= _cellSize;
+
+	return true;
+}
+
+
+/**
+ * \brief Set the number of cells along the longest axis of the models. Has to be set before loading the scene.
+ *
+ * \param resolution
+ *      Cells along the longest axis (at least 4).
+ */
+void DistanceField::setResolution(int resolution) {
+	RESOLUTION = std::max(resolution, 4);
+}
+
+
+/**
+ * \brief Collect the planes of the faces of a convex hull (normals point outwards).
+ *
+ * \param hull
+ *      Convex hull.
+ * \param planes
+ *      Output-parameter: Planes of the faces (appended).
+ */
+void DistanceField::collectPlanes(const ConvexHull3D &hull, std::vector<Plane> &planes) {
+	const std::vector<Eigen::Vector3d> &vertices = hull.getVertices();
+	const Eigen::MatrixXi &faces = hull.getFaces();
+
+	// the centroid is inside of the convex hull => orients the normals independent of the winding
+	Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+	for (unsigned int i = 0; i < vertices.size(); ++i) {
+		centroid += vertices[i];
+	}
+	centroid /= std::max(static_cast<double>(vertices.size()), 1.0);
+
+	for (int f = 0; f < faces.rows(); ++f) {
+		const Eigen::Vector3d &a = vertices[faces(f, 0)];
+		Eigen::Vector3d normal = (vertices[faces(f, 1)] - a).cross(vertices[faces(f, 2)] - a);
+		double length = normal.norm();
+		if (length <= 1e-12) continue;
+
+		Plane plane;
+		plane.normal = normal / length;
+		plane.offset = plane.normal.dot(a);
+		if (plane.normal.dot(centroid) - plane.offset > 0.0) {
+			plane.normal = -plane.normal;
+			plane.offset = -plane.offset;
+		}
+
+		planes.push_back(plane);
+	}
+}
@@ -0,0 +1,215 @@
+﻿/**
+ * \brief Narrow-band signed distance field of a model for the deep contacts.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+#include <Eigen/Core>
+
+
+namespace pbs17 {
+	class ConvexHull3D;
+
+	/**
+	 * \brief DistanceField samples the signed distance to the surface of a model (negative inside) on a regular grid
+	 * in the unscaled model-space. The grid covers the AABB of the hull and a narrow band of BAND_CELLS cells around
+	 * it, the points outside of the grid are far away from the model. The distance of a convex hull is the largest
+	 * distance to the planes of its faces, a compound takes the smallest distance of its parts (so the field also
+	 * follows the concave surface). It is computed once per model and stored in the asset-cache with the shape (see
+	 * ModelManager::computeShape()).
+	 *
+	 * The narrow-phase samples the field at the vertices of the other hull of a deep contact instead of running EPA,
+	 * so the cost of a deep contact only depends on the vertices of the other hull (see CollisionManager).
+	 */
+	class DistanceField {
+	public:
+		/**
+		 * \brief Constructor of a computed field (e.g. from the asset-cache).
+		 *
+		 * \param origin
+		 *      Position of the first sample in the model-space.
+		 * \param cellSize
+		 *      Distance between two samples.
+		 * \param dims
+		 *      Number of samples per axis (at least 2).
+		 * \param values
+		 *      Signed distances, x runs fastest (size = dims.prod()).
+		 */
+		DistanceField(const Eigen::Vector3d &origin, double cellSize, const Eigen::Vector3i &dims, const std::vector<float> &values);
+
+
+		/**
+		 * \brief Compute the field of a hull (and its parts) with getResolution() cells along the longest axis.
+		 *
+		 * \param hull
+		 *      Convex-hull of the model (the parts of a compound are used instead of the envelope).
+		 *
+		 * \return New field (owned by the caller).
+		 */
+		static DistanceField* compute(const ConvexHull3D &hull);
+
+
+		/**
+		 * \brief Check if the contacts of a hull profit from a field: the hulls with many vertices and the compounds.
+		 *
+		 * \param hull
+		 *      Convex-hull of the model.
+		 *
+		 * \return True if a field should be computed.
+		 */
+		static bool isUseful(const ConvexHull3D &hull);
+
+
+		/**
+		 * \brief Sample the distance and its gradient at a point (trilinear interpolation).
+		 *
+		 * \param point
+		 *      Point in the unscaled model-space.
+		 * \param distance
+		 *      Output-parameter: Signed distance to the surface (negative inside).
+		 * \param gradient
+		 *      Output-parameter: Gradient of the distance (not normalized, points outwards).
+		 *
+		 * \return False if the point is outside of the grid (farther than the band from the model).
+		 */
+		bool sample(const Eigen::Vector3d &point, double &distance, Eigen::Vector3d &gradient) const;
+
+
+		/**
+		 * \brief Get the position of the first sample.
+		 *
+		 * \return Origin of the grid in the model-space.
+		 */
+		const Eigen::Vector3d& getOrigin() const {
+			return _origin;
+		}
+
+
+		/**
+		 * \brief Get the distance between two samples.
+		 *
+		 * \return Size of a cell in the model-space.
+		 */
+		double getCellSize() const {
+			return _cellSize;
+		}
+
+
+		/**
+		 * \brief Get the number of samples per axis.
+		 *
+		 * \return Dimensions of the grid.
+		 */
+		const Eigen::Vector3i& getDims() const {
+			return _dims;
+		}
+
+
+		/**
+		 * \brief Get the sampled distances.
+		 *
+		 * \return Signed distances, x runs fastest.
+		 */
+		const std::vector<float>& getValues() const {
+			return _values;
+		}
+
+
+		/**
+		 * \brief Estimate the memory of the field.
+		 *
+		 * \return Memory in bytes.
+		 */
+		size_t getMemorySize() const {
+			return sizeof(DistanceField) + _values.capacity() * sizeof(float);
+		}
+
+
+		/**
+		 * \brief Enable or disable the fields of the loaded models. Has to be set before loading the scene.
+		 *
+		 * \param isEnabled
+		 *      True if the deep contacts of the large hulls are sampled in their fields.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Check if the fields of the loaded models are enabled.
+		 *
+		 * \return True if the deep contacts of the large hulls are sampled in their fields.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+		/**
+		 * \brief Set the number of cells along the longest axis of the models. Has to be set before loading the scene.
+		 *
+		 * \param resolution
+		 *      Cells along the longest axis (at least 4).
+		 */
+		static void setResolution(int resolution);
+
+
+		/**
+		 * \brief Get the number of cells along the longest axis of the models.
+		 *
+		 * \return Cells along the longest axis.
+		 */
+		static int getResolution() {
+			return RESOLUTION;
+		}
+
+
+		//! Cells of the band around the AABB of the hull
+		static const int BAND_CELLS = 2;
+		//! Hulls with fewer vertices use EPA for all contacts (unless they are compounds)
+		static const unsigned int MIN_VERTICES = 64;
+
+
+	private:
+		/**
+		 * \brief Plane of a face of a convex hull: normal.dot(p) - offset is the distance of p to the plane.
+		 */
+		struct Plane {
+			//! Unit normal (points outwards)
+			Eigen::Vector3d normal;
+			//! Distance of the plane to the origin along the normal
+			double offset;
+		};
+
+
+		//! Position of the first sample in the model-space
+		Eigen::Vector3d _origin;
+		//! Distance between two samples
+		double _cellSize;
+		//! Number of samples per axis
+		Eigen::Vector3i _dims;
+		//! Signed distances (x runs fastest)
+		std::vector<float> _values;
+
+		//! Fields are disabled by default
+		static bool IS_ENABLED;
+		//! Cells along the longest axis of the models
+		static int RESOLUTION;
+
+
+		/**
+		 * \brief Collect the planes of the faces of a convex hull (normals point outwards).
+		 *
+		 * \param hull
+		 *      Convex hull.
+		 * \param planes
+		 *      Output-parameter: Planes of the faces (appended).
+		 */
+		static void collectPlanes(const ConvexHull3D &hull, std::vector<Plane> &planes);
+	};
+}
@@ -21,21 +21,23 @@ namespace pbs17 {
 		 * \brief Empty constructor.
 		 */
 		Face()
-			: Face(std::vector<SupportPoint*>(), 0, Eigen::Vector3d(1, 0, 0)) {}
+			: _distance(0), _normal(Eigen::Vector3d(1, 0, 0)) {}
 
 
 		/**
 		 * \brief Constructor to initialize all values.
 		 * 
-		 * \param vertices
+		 * \param a, b, c
 		 *      The three vertices of the face.
 		 * \param distance
 		 *	    Distance from the face to the zero-point.
 		 * \param normal
 		 *      Normal of the face. (poinring outside)
 		 */
-		Face(std::vector<SupportPoint*> vertices, double distance, Eigen::Vector3d normal)
-			: _vertices(vertices), _distance(distance), _normal(normal) {}
+		Face(const SupportPoint &a, const SupportPoint &b, const SupportPoint &c, double distance, Eigen::Vector3d normal)
+			: _distance(distance), _normal(normal) {
+			setVertices(a, b, c);
+		}
 
 
 
@@ -47,7 +49,7 @@ namespace pbs17 {
 		 * 
 		 * \return Vertex at given position in the triangle.
 		 */
-		SupportPoint* operator[](const int pos) const {
+		const SupportPoint& operator[](const int pos) const {
 			return _vertices[pos];
 		}
 
@@ -55,11 +57,13 @@ namespace pbs17 {
 		/**
 		 * \brief Set all vertices at once.
 		 * 
-		 * \param vertices
-		 *      New vertices of the triangle.
+		 * \param a, b, c
+		 *      New vertices of the triangle (copied, so the face stays valid when the simplex grows).
 		 */
-		void setVertices(const std::vector<SupportPoint*> vertices) {
-			_vertices = vertices;
+		void setVertices(const SupportPoint &a, const SupportPoint &b, const SupportPoint &c) {
+			_vertices[0] = a;
+			_vertices[1] = b;
+			_vertices[2] = c;
 		}
 
 
@@ -104,8 +108,7 @@ namespace pbs17 {
 		}
 		
 	private:
-		Eigen::Vector3i _indices;
-		std::vector<SupportPoint*> _vertices;
+		SupportPoint _vertices[3];
 		double _distance;
 		Eigen::Vector3d _normal;
 	};
@@ -8,6 +8,8 @@
 #include "GjkAlgorithm.h"
 
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 #include <Eigen/Core>
 // ReSharper disable once CppUnusedIncludeDirective
@@ -15,6 +17,7 @@
 #include <limits>
 
 #include "Geometry.h"
+#include "../physics/Tracer.h"
 
 using namespace pbs17;
 
@@ -24,6 +27,22 @@ const int GjkAlgorithm::MAX_ITERATIONS = 50;
 //! Tolerance of the EPA algorithm to determine if the hull can be still extended or not.
 const double GjkAlgorithm::EPA_TOLERANCE = 0.00001;
 
+//! Maximum number of extensions of the EPA (the closest face so far is used after that).
+const int GjkAlgorithm::EPA_MAX_ITERATIONS = 64;
+
+//! The counters are per thread, so the parallel searches do not have to synchronize.
+thread_local GjkAlgorithm::Statistics GjkAlgorithm::STATISTICS = { 0, 0, 0 };
+
+
+/**
+ * \brief Get the counters of the searches of the current thread.
+ *
+ * \return Counters of the thread.
+ */
+const GjkAlgorithm::Statistics& GjkAlgorithm::getStatistics() {
+	return STATISTICS;
+}
+
 
 /**
  * \brief Identifies if two convex-hulls intersect.
@@ -39,23 +58,88 @@ const double GjkAlgorithm::EPA_TOLERANCE = 0.00001;
  *
  * \return True if there is an intersection, false otherwise.
  */
-bool GjkAlgorithm::intersect(std::vector<Eigen::Vector3d> &convex1, std::vector<Eigen::Vector3d> &convex2, Collision &collision) {
+bool GjkAlgorithm::intersect(const std::vector<Eigen::Vector3d> &convex1, const std::vector<Eigen::Vector3d> &convex2, Collision &collision) {
+	ConvexShape shape1(convex1);
+	ConvexShape shape2(convex2);
+
+	return intersect(shape1, shape2, collision);
+}
+
+
+/**
+ * \brief Identifies if two convex-hulls intersect. The support-points are found by hill-climbing if the
+ * shapes have an adjacency, and each shape remembers its last support-vertex.
+ *
+ * \param convex1
+ *      Convex-hull of first object.
+ * \param convex2
+ *      Convex-hull of second object.
+ * \param collision
+ *	    Output-parameter:
+ *			Input:		Collision-object with the link to the two space-objects.
+ *			Output:		Collision-object with all information of the intersection. (if there is any)
+ *
+ * \return True if there is an intersection, false otherwise.
+ */
+bool GjkAlgorithm::intersect(ConvexShape &convex1, ConvexShape &convex2, Collision &collision) {
+	Eigen::Vector3d direction(1.0, 1.0, 1.0);
+
+	return intersect(convex1, convex2, direction, collision);
+}
+
+
+/**
+ * \brief Identifies if two convex-hulls intersect, starting the search with the given direction (e.g. the
+ * separating axis of the previous frame). If the direction still separates both hulls, only one
+ * support-point is needed.
+ *
+ * \param convex1
+ *      Convex-hull of first object.
+ * \param convex2
+ *      Convex-hull of second object.
+ * \param direction
+ *      Output-parameter:
+ *			Input:		Initial search-direction on the Minkowski-sum (zero => (1, 1, 1)).
+ *			Output:		Separating axis if there is no intersection, last search-direction otherwise.
+ * \param collision
+ *	    Output-parameter:
+ *			Input:		Collision-object with the link to the two space-objects.
+ *			Output:		Collision-object with all information of the intersection. (if there is any)
+ *
+ * \return True if there is an intersection, false otherwise.
+ */
+bool GjkAlgorithm::intersect(ConvexShape &convex1, ConvexShape &convex2, Eigen::Vector3d &direction, Collision &collision) {
+	++STATISTICS.gjkCalls;
+
+	if (direction.squaredNorm() == 0.0) {
+		direction = Eigen::Vector3d(1.0, 1.0, 1.0);
+	}
+
 	// Get an initial point on the Minkowski-sum.
-	SupportPoint* s = support(convex1, convex2, Eigen::Vector3d(1.0, 1.0, 1.0));
-	std::vector<SupportPoint*> sVertices;
-	sVertices.push_back(s);
+	SupportPoint s = support(convex1, convex2, direction);
+
+	// If the Minkowski-sum is completely behind the plane through the origin, the direction is still a separating axis.
+	if (isOppositeDirection(s.getMinkowskiPoint(), direction)) {
+		return false;
+	}
 
 	// Create our initial simplex with the single point and initialize the search toward the origin.
-	Simplex simplex(sVertices);
-	Eigen::Vector3d d = -s->getMinkowskiPoint();
+	// The simplex is reused per thread, so its buffers keep their capacity and the search does not allocate.
+	static thread_local Simplex simplex;
+	simplex.clear();
+	simplex.add(s);
+	Eigen::Vector3d d = -s.getMinkowskiPoint();
 
 	// Try to find out if the origin is contained in the minkowski-sum or not.
 	for (int i = 0; i < MAX_ITERATIONS; i++) {
+		++STATISTICS.gjkIterations;
+
 		// Get our next simplex point toward the origin.
-		SupportPoint* a = support(convex1, convex2, d);
+		SupportPoint a = support(convex1, convex2, d);
 
 		// If we move toward the origin and didn't pass it then we never will and there's no intersection.
-		if (isOppositeDirection(a->getMinkowskiPoint(), d)) {
+		if (isOppositeDirection(a.getMinkowskiPoint(), d)) {
+			direction = d;
 			return false;
 		}
 
@@ -70,6 +154,8 @@ bool GjkAlgorithm::intersect(std::vector<Eigen::Vector3d> &convex1, std::vector<
 		}
 	}
 
+	direction = d;
+
 	// Two cases:
 	// - We are sure that there is a collision and we stopped the loop
 	// - We still couldn't find a simplex that contains the origin and so we "probably" have an intersection
@@ -78,6 +164,421 @@ bool GjkAlgorithm::intersect(std::vector<Eigen::Vector3d> &convex1, std::vector<
 }
 
 
+/**
+ * \brief Get the closest point of a convex-hull to a point (GJK distance-query on the hull minus the point).
+ *
+ * \param convex
+ *      Convex-hull of the object.
+ * \param point
+ *      Point to query (e.g. center of a sphere).
+ * \param closest
+ *      Output-parameter: Closest point on the convex-hull (only if the point is outside).
+ *
+ * \return True if the point is outside of the convex-hull, false if it is inside (or on the surface).
+ */
+bool GjkAlgorithm::getClosestPoint(ConvexShape &convex, const Eigen::Vector3d &point, Eigen::Vector3d &closest) {
+	// Work on the hull moved by -point, so the closest point to the origin is searched.
+	Eigen::Vector3d simplex[4];
+	int count = 1;
+	simplex[0] = convex.getFurthestPoint(Eigen::Vector3d(1.0, 1.0, 1.0)) - point;
+	Eigen::Vector3d v = simplex[0];
+
+	for (int i = 0; i < MAX_ITERATIONS; i++) {
+		double squaredDistance = v.squaredNorm();
+
+		// The origin is on the simplex => the point is inside the hull
+		if (squaredDistance < EPS * EPS) {
+			return false;
+		}
+
+		Eigen::Vector3d w = convex.getFurthestPoint(-v) - point;
+
+		// No vertex is closer to the origin in the direction of v => converged
+		if (squaredDistance - v.dot(w) <= EPA_TOLERANCE * squaredDistance) {
+			break;
+		}
+
+		simplex[count++] = w;
+		v = reduceSimplex(simplex, count);
+
+		if (count == 4) {
+			return false;
+		}
+	}
+
+	closest = v + point;
+	return true;
+}
+
+
+/**
+ * \brief Get the distance of two convex-hulls (GJK distance-query on the Minkowski-difference), with the
+ * first convex-hull moved by an offset (e.g. back along its path for the continuous collision-detection).
+ * 
+ * \param convex1
+ *      Convex-hull of first object.
+ * \param convex2
+ *      Convex-hull of second object.
+ * \param offset
+ *      Translation of the first convex-hull.
+ * \param separation
+ *      Output-parameter: Shortest vector from the second to the moved first convex-hull (only if they are separated).
+ * 
+ * \return True if the convex-hulls are separated, false if they intersect (or touch).
+ */
+bool GjkAlgorithm::getDistance(ConvexShape &convex1, ConvexShape &convex2, const Eigen::Vector3d &offset, Eigen::Vector3d &separation) {
+	Eigen::Vector3d simplex[4];
+	int count = 1;
+	Eigen::Vector3d direction(1.0, 1.0, 1.0);
+	simplex[0] = convex1.getFurthestPoint(direction) - convex2.getFurthestPoint(-direction) + offset;
+	Eigen::Vector3d v = simplex[0];
+
+	for (int i = 0; i < MAX_ITERATIONS; i++) {
+		double squaredDistance = v.squaredNorm();
+
+		// The origin is on the simplex => the convex-hulls touch or intersect
+		if (squaredDistance < EPS * EPS) {
+			return false;
+		}
+
+		Eigen::Vector3d w = convex1.getFurthestPoint(-v) - convex2.getFurthestPoint(v) + offset;
+
+		// No point of the Minkowski-difference is closer to the origin in the direction of v => converged
+		if (squaredDistance - v.dot(w) <= EPA_TOLERANCE * squaredDistance) {
+			break;
+		}
+
+		simplex[count++] = w;
+		v = reduceSimplex(simplex, count);
+
+		if (count == 4) {
+			return false;
+		}
+	}
+
+	separation = v;
+	return true;
+}
+
+
+/**
+ * \brief Get the closest points of two convex-hulls (GJK distance-query which keeps the support-vertices of
+ * the simplex), warm-started with the separation of the previous frame.
+ *
+ * \param convex1
+ *      Convex-hull of first object.
+ * \param convex2
+ *      Convex-hull of second object.
+ * \param separation
+ *      Output-parameter:
+ *			Input:		Separation of the previous query (zero => (1, 1, 1)).
+ *			Output:		Shortest vector from the second to the first convex-hull if they are separated, last
+ *						vector of the search otherwise.
+ * \param closest1
+ *      Output-parameter: Closest point on the first convex-hull (only if they are separated).
+ * \param closest2
+ *      Output-parameter: Closest point on the second convex-hull (only if they are separated).
+ *
+ * \return True if the convex-hulls are separated, false if they intersect (or touch).
+ */
+bool GjkAlgorithm::getClosestPoints(ConvexShape &convex1, ConvexShape &convex2, Eigen::Vector3d &separation,
+	Eigen::Vector3d &closest1, Eigen::Vector3d &closest2) {
+	++STATISTICS.gjkCalls;
+
+	if (separation.squaredNorm() == 0.0) {
+		separation = Eigen::Vector3d(1.0, 1.0, 1.0);
+	}
+
+	// Minkowski-points of the simplex with the support-vertices they are made of
+	Eigen::Vector3d simplex[4];
+	Eigen::Vector3d points1[4];
+	Eigen::Vector3d points2[4];
+	int count = 1;
+
+	// the closest points of the last frame are usually the support-vertices against the last separation
+	points1[0] = convex1.getFurthestPoint(-separation);
+	points2[0] = convex2.getFurthestPoint(separation);
+	simplex[0] = points1[0] - points2[0];
+	Eigen::Vector3d v = simplex[0];
+
+	for (int i = 0; i < MAX_ITERATIONS; i++) {
+		++STATISTICS.gjkIterations;
+		double squaredDistance = v.squaredNorm();
+
+		// The origin is on the simplex => the convex-hulls touch or intersect
+		if (squaredDistance < EPS * EPS) {
+			separation = v;
+			return false;
+		}
+
+		Eigen::Vector3d p1 = convex1.getFurthestPoint(-v);
+		Eigen::Vector3d p2 = convex2.getFurthestPoint(v);
+		Eigen::Vector3d w = p1 - p2;
+
+		// No point of the Minkowski-difference is closer to the origin in the direction of v => converged
+		if (squaredDistance - v.dot(w) <= EPA_TOLERANCE * squaredDistance) {
+			break;
+		}
+
+		Eigen::Vector3d previous[4];
+		Eigen::Vector3d previous1[4];
+		Eigen::Vector3d previous2[4];
+		simplex[count] = w;
+		points1[count] = p1;
+		points2[count] = p2;
+		++count;
+
+		for (int k = 0; k < count; ++k) {
+			previous[k] = simplex[k];
+			previous1[k] = points1[k];
+			previous2[k] = points2[k];
+		}
+		int previousCount = count;
+
+		v = reduceSimplex(simplex, count);
+
+		if (count == 4) {
+			separation = v;
+			return false;
+		}
+
+		// the reduction keeps copies of the Minkowski-points of the closest feature => their support-vertices are found again
+		for (int k = 0; k < count; ++k) {
+			for (int j = 0; j < previousCount; ++j) {
+				if (simplex[k] == previous[j]) {
+					points1[k] = previous1[j];
+					points2[k] = previous2[j];
+					break;
+				}
+			}
+		}
+	}
+
+	double weights[3];
+	getBarycentric(simplex, count, v, weights);
+
+	closest1 = Eigen::Vector3d::Zero();
+	closest2 = Eigen::Vector3d::Zero();
+	for (int k = 0; k < count; ++k) {
+		closest1 += weights[k] * points1[k];
+		closest2 += weights[k] * points2[k];
+	}
+
+	separation = v;
+	return true;
+}
+
+
+/**
+ * \brief Get the barycentric coordinates of a point on a simplex of the distance-query.
+ *
+ * \param simplex
+ *      Vertices of the simplex (a point, a line or a triangle).
+ * \param count
+ *      Number of vertices of the simplex (1 to 3).
+ * \param point
+ *      Point on the simplex.
+ * \param weights
+ *      Output-parameter: Weights of the vertices (they sum up to one).
+ */
+void GjkAlgorithm::getBarycentric(const Eigen::Vector3d *simplex, int count, const Eigen::Vector3d &point, double *weights) {
+	if (count == 1) {
+		weights[0] = 1.0;
+		return;
+	}
+
+	if (count == 2) {
+		Eigen::Vector3d ab = simplex[1] - simplex[0];
+		double length = ab.squaredNorm();
+		double t = length > 0.0 ? std::max(0.0, std::min((point - simplex[0]).dot(ab) / length, 1.0)) : 0.0;
+
+		weights[0] = 1.0 - t;
+		weights[1] = t;
+		return;
+	}
+
+	// Cramer's rule on the edges of the triangle (see Ericson, Real-Time Collision Detection, 3.4)
+	Eigen::Vector3d v0 = simplex[1] - simplex[0];
+	Eigen::Vector3d v1 = simplex[2] - simplex[0];
+	Eigen::Vector3d v2 = point - simplex[0];
+	double d00 = v0.dot(v0);
+	double d01 = v0.dot(v1);
+	double d11 = v1.dot(v1);
+	double d20 = v2.dot(v0);
+	double d21 = v2.dot(v1);
+	double denominator = d00 * d11 - d01 * d01;
+
+	// degenerated triangle (not kept by the reduction in practice) => its first vertex
+	if (std::abs(denominator) <= EPS * d00 * d11) {
+		weights[0] = 1.0;
+		weights[1] = 0.0;
+		weights[2] = 0.0;
+		return;
+	}
+
+	weights[1] = (d11 * d20 - d01 * d21) / denominator;
+	weights[2] = (d00 * d21 - d01 * d20) / denominator;
+	weights[0] = 1.0 - weights[1] - weights[2];
+}
+
+
+/**
+ * \brief Get the closest point to the origin on the simplex of the distance-query and reduce the simplex to
+ * the vertices of the closest feature.
+ *
+ * \param simplex
+ *      Output-parameter: Vertices of the simplex (1 to 4), reduced to the closest feature.
+ * \param count
+ *      Output-parameter: Number of vertices of the simplex.
+ *
+ * \return Closest point to the origin (zero if the tetrahedron contains the origin).
+ */
+Eigen::Vector3d GjkAlgorithm::reduceSimplex(Eigen::Vector3d *simplex, int &count) {
+	if (count == 1) {
+		return simplex[0];
+	}
+
+	if (count == 2) {
+		Eigen::Vector3d ab = simplex[1] - simplex[0];
+		double t = -simplex[0].dot(ab);
+
+		if (t <= 0.0) {
+			count = 1;
+			return simplex[0];
+		}
+
+		double length = ab.squaredNorm();
+		if (t >= length) {
+			simplex[0] = simplex[1];
+			count = 1;
+			return simplex[0];
+		}
+
+		return simplex[0] + (t / length) * ab;
+	}
+
+	if (count == 3) {
+		return reduceTriangle(simplex, count);
+	}
+
+	// Tetrahedron: check each face which has the origin and the opposite vertex on different sides.
+	static const int FACES[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+	double minDistance = std::numeric_limits<double>::max();
+	Eigen::Vector3d best = Eigen::Vector3d::Zero();
+	Eigen::Vector3d bestSimplex[3];
+	int bestCount = 4;
+
+	for (int f = 0; f < 4; ++f) {
+		const Eigen::Vector3d &a = simplex[FACES[f][0]];
+		const Eigen::Vector3d &b = simplex[FACES[f][1]];
+		const Eigen::Vector3d &c = simplex[FACES[f][2]];
+		const Eigen::Vector3d &d = simplex[FACES[f][3]];
+		Eigen::Vector3d normal = (b - a).cross(c - a);
+
+		double signOrigin = -a.dot(normal);
+		double signOpposite = (d - a).dot(normal);
+
+		if (signOrigin * signOpposite >= 0.0) {
+			continue;
+		}
+
+		Eigen::Vector3d triangle[3] = { a, b, c };
+		int triangleCount = 3;
+		Eigen::Vector3d p = reduceTriangle(triangle, triangleCount);
+		double distance = p.squaredNorm();
+
+		if (distance < minDistance) {
+			minDistance = distance;
+			best = p;
+			bestCount = triangleCount;
+
+			for (int k = 0; k < triangleCount; ++k) {
+				bestSimplex[k] = triangle[k];
+			}
+		}
+	}
+
+	// No face separates the origin => the origin is inside (count stays 4)
+	if (bestCount == 4) {
+		return Eigen::Vector3d::Zero();
+	}
+
+	count = bestCount;
+	for (int k = 0; k < count; ++k) {
+		simplex[k] = bestSimplex[k];
+	}
+
+	return best;
+}
+
+
+/**
+ * \brief Get the closest point to the origin on a triangle and reduce it to the vertices of the closest feature.
+ *
+ * \param simplex
+ *      Output-parameter: Vertices of the triangle, reduced to the closest feature.
+ * \param count
+ *      Output-parameter: Number of vertices of the feature.
+ *
+ * \return Closest point to the origin.
+ */
+Eigen::Vector3d GjkAlgorithm::reduceTriangle(Eigen::Vector3d *simplex, int &count) {
+	// Voronoi-regions of the triangle (see Ericson, Real-Time Collision Detection, 5.1.5)
+	Eigen::Vector3d a = simplex[0];
+	Eigen::Vector3d b = simplex[1];
+	Eigen::Vector3d c = simplex[2];
+	Eigen::Vector3d ab = b - a;
+	Eigen::Vector3d ac = c - a;
+
+	double d1 = -ab.dot(a);
+	double d2 = -ac.dot(a);
+	if (d1 <= 0.0 && d2 <= 0.0) {
+		count = 1;
+		return a;
+	}
+
+	double d3 = -ab.dot(b);
+	double d4 = -ac.dot(b);
+	if (d3 >= 0.0 && d4 <= d3) {
+		simplex[0] = b;
+		count = 1;
+		return b;
+	}
+
+	double vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) {
+		count = 2;
+		return a + d1 / (d1 - d3) * ab;
+	}
+
+	double d5 = -ab.dot(c);
+	double d6 = -ac.dot(c);
+	if (d6 >= 0.0 && d5 <= d6) {
+		simplex[0] = c;
+		count = 1;
+		return c;
+	}
+
+	double vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) {
+		simplex[1] = c;
+		count = 2;
+		return a + d2 / (d2 - d6) * ac;
+	}
+
+	double va = d3 * d6 - d5 * d4;
+	if (va <= 0.0 && d4 - d3 >= 0.0 && d5 - d6 >= 0.0) {
+		simplex[0] = b;
+		simplex[1] = c;
+		count = 2;
+		return b + (d4 - d3) / ((d4 - d3) + (d5 - d6)) * (c - b);
+	}
+
+	double denominator = 1.0 / (va + vb + vc);
+	return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+
 /**
  * \brief Get the furthest point on the Minkowski-sum on direction.
  *
@@ -90,10 +591,10 @@ bool GjkAlgorithm::intersect(std::vector<Eigen::Vector3d> &convex1, std::vector<
  *
  * \return Furthest point on the Minkowski-sum with corresponding two vertices of convex hull.
  */
-SupportPoint* GjkAlgorithm::support(std::vector<Eigen::Vector3d> &convex1, std::vector<Eigen::Vector3d> &convex2, Eigen::Vector3d direction) {
-	Eigen::Vector3d conv1Point = getFurthestPoint(convex1, direction);
-	Eigen::Vector3d conv2Point = getFurthestPoint(convex2, -direction);
-	return new SupportPoint(conv1Point - conv2Point, conv1Point, conv2Point);
+SupportPoint GjkAlgorithm::support(ConvexShape &convex1, ConvexShape &convex2, const Eigen::Vector3d &direction) {
+	Eigen::Vector3d conv1Point = convex1.getFurthestPoint(direction);
+	Eigen::Vector3d conv2Point = convex2.getFurthestPoint(-direction);
+	return SupportPoint(conv1Point - conv2Point, conv1Point, conv2Point);
 }
 
 
@@ -107,7 +608,7 @@ SupportPoint* GjkAlgorithm::support(std::vector<Eigen::Vector3d> &convex1, std::
  *
  * \return Furthest point.
  */
-Eigen::Vector3d GjkAlgorithm::getFurthestPoint(std::vector<Eigen::Vector3d> &convex, Eigen::Vector3d direction) {
+Eigen::Vector3d GjkAlgorithm::getFurthestPoint(const std::vector<Eigen::Vector3d> &convex, Eigen::Vector3d direction) {
 	double max = -std::numeric_limits<double>::max();
 	Eigen::Vector3d maxV(0, 0, 0);
 
@@ -158,17 +659,15 @@ bool GjkAlgorithm::processSimplex(Simplex &simplex, Eigen::Vector3d &direction)
  * \return False, since a line does not "include" the origin.
  */
 bool GjkAlgorithm::processLine(Simplex &simplex, Eigen::Vector3d &direction) {
-	SupportPoint* aSP = simplex[1];
-	SupportPoint* bSP = simplex[0];
-	Eigen::Vector3d a = aSP->getMinkowskiPoint();
-	Eigen::Vector3d b = bSP->getMinkowskiPoint();
+	Eigen::Vector3d a = simplex[1].getMinkowskiPoint();
+	Eigen::Vector3d b = simplex[0].getMinkowskiPoint();
 	Eigen::Vector3d ab = b - a;
 	Eigen::Vector3d aO = -a;
 
 	if (isSameDirection(ab, aO)) {
 		direction = (ab.cross(aO)).cross(ab);
 	} else {
-		simplex.remove(bSP);
+		simplex.remove(0);
 		direction = aO;
 	}
 
@@ -187,12 +686,9 @@ bool GjkAlgorithm::processLine(Simplex &simplex, Eigen::Vector3d &direction) {
  * \return False, since a triangle does not "include" the origin.
  */
 bool GjkAlgorithm::processTriangle(Simplex &simplex, Eigen::Vector3d &direction) {
-	SupportPoint* aSP = simplex[2];
-	SupportPoint* bSP = simplex[1];
-	SupportPoint* cSP = simplex[0];
-	Eigen::Vector3d a = aSP->getMinkowskiPoint();
-	Eigen::Vector3d b = bSP->getMinkowskiPoint();
-	Eigen::Vector3d c = cSP->getMinkowskiPoint();
+	Eigen::Vector3d a = simplex[2].getMinkowskiPoint();
+	Eigen::Vector3d b = simplex[1].getMinkowskiPoint();
+	Eigen::Vector3d c = simplex[0].getMinkowskiPoint();
 	Eigen::Vector3d ab = b - a;
 	Eigen::Vector3d ac = c - a;
 	Eigen::Vector3d abc = ab.cross(ac);
@@ -202,26 +698,26 @@ bool GjkAlgorithm::processTriangle(Simplex &simplex, Eigen::Vector3d &direction)
 
 	if (isSameDirection(acNormal, aO)) {
 		if (isSameDirection(ac, aO)) {
-			simplex.remove(bSP);
+			simplex.remove(1);
 			direction = (ac.cross(aO)).cross(ac);
 		} else {
 			if (isSameDirection(ab, aO)) {
-				simplex.remove(cSP);
+				simplex.remove(0);
 				direction = (ab.cross(aO)).cross(ab);
 			} else {
-				simplex.remove(bSP);
-				simplex.remove(cSP);
+				simplex.remove(1);
+				simplex.remove(0);
 				direction = aO;
 			}
 		}
 	} else {
 		if (isSameDirection(abNormal, aO)) {
 			if (isSameDirection(ab, aO)) {
-				simplex.remove(cSP);
+				simplex.remove(0);
 				direction = (ab.cross(aO)).cross(ab);
 			} else {
-				simplex.remove(bSP);
-				simplex.remove(cSP);
+				simplex.remove(1);
+				simplex.remove(0);
 				direction = aO;
 			}
 		} else {
@@ -248,14 +744,10 @@ bool GjkAlgorithm::processTriangle(Simplex &simplex, Eigen::Vector3d &direction)
  * \return True if the tetrahedron contains the origin; false otherwise.
  */
 bool GjkAlgorithm::processTetrahedron(Simplex &simplex, Eigen::Vector3d &direction) {
-	SupportPoint* aSP = simplex[3];
-	SupportPoint* bSP = simplex[2];
-	SupportPoint* cSP = simplex[1];
-	SupportPoint* dSP = simplex[0];
-	Eigen::Vector3d a = aSP->getMinkowskiPoint();
-	Eigen::Vector3d b = bSP->getMinkowskiPoint();
-	Eigen::Vector3d c = cSP->getMinkowskiPoint();
-	Eigen::Vector3d d = dSP->getMinkowskiPoint();
+	Eigen::Vector3d a = simplex[3].getMinkowskiPoint();
+	Eigen::Vector3d b = simplex[2].getMinkowskiPoint();
+	Eigen::Vector3d c = simplex[1].getMinkowskiPoint();
+	Eigen::Vector3d d = simplex[0].getMinkowskiPoint();
 	Eigen::Vector3d ac = c - a;
 	Eigen::Vector3d ad = d - a;
 	Eigen::Vector3d ab = b - a;
@@ -268,41 +760,41 @@ bool GjkAlgorithm::processTetrahedron(Simplex &simplex, Eigen::Vector3d &directi
 
 	if (isSameDirection(abc, aO)) {
 		if (isSameDirection(abc.cross(ac), aO)) {
-			simplex.remove(bSP);
-			simplex.remove(dSP);
+			simplex.remove(2);
+			simplex.remove(0);
 			direction = (ac.cross(aO)).cross(ac);
 		} else if (isSameDirection(ab.cross(abc), aO)) {
-			simplex.remove(cSP);
-			simplex.remove(dSP);
+			simplex.remove(1);
+			simplex.remove(0);
 			direction = (ab.cross(aO)).cross(ab);
 		} else {
-			simplex.remove(dSP);
+			simplex.remove(0);
 			direction = abc;
 		}
 	} else if (isSameDirection(acd, aO)) {
 		if (isSameDirection(acd.cross(ad), aO)) {
-			simplex.remove(bSP);
-			simplex.remove(cSP);
+			simplex.remove(2);
+			simplex.remove(1);
 			direction = (ad.cross(aO)).cross(ad);
 		} else if (isSameDirection(ac.cross(acd), aO)) {
-			simplex.remove(bSP);
-			simplex.remove(dSP);
+			simplex.remove(2);
+			simplex.remove(0);
 			direction = (ac.cross(aO)).cross(ac);
 		} else {
-			simplex.remove(bSP);
+			simplex.remove(2);
 			direction = acd;
 		}
 	} else if (isSameDirection(abd, aO)) {
 		if (isSameDirection(abd.cross(ab), aO)) {
-			simplex.remove(cSP);
-			simplex.remove(dSP);
+			simplex.remove(1);
+			simplex.remove(0);
 			direction = (ab.cross(aO)).cross(ab);
 		} else if (isSameDirection(ad.cross(abd), aO)) {
-			simplex.remove(bSP);
-			simplex.remove(cSP);
+			simplex.remove(2);
+			simplex.remove(1);
 			direction = (ad.cross(aO)).cross(ad);
 		} else {
-			simplex.remove(cSP);
+			simplex.remove(1);
 			direction = abd;
 		}
 	} else {
@@ -330,11 +822,15 @@ bool GjkAlgorithm::processTetrahedron(Simplex &simplex, Eigen::Vector3d &directi
  *
  * \return Direction of the colision.
  */
-bool GjkAlgorithm::EPA(Simplex &simplex, std::vector<Eigen::Vector3d>& convex1, std::vector<Eigen::Vector3d>& convex2, Collision &collision) {
+bool GjkAlgorithm::EPA(Simplex &simplex, ConvexShape &convex1, ConvexShape &convex2, Collision &collision) {
+	TRACE_SCOPE("epa");
 	simplex.triangulate();
 	
-	while (true) {
-		bool stop = false;
+	for (int i = 0; ; ++i) {
+		++STATISTICS.epaIterations;
+
+		// - Too many extensions (deep penetrations of detailed hulls) => use the closest face so far
+		bool stop = i + 1 >= EPA_MAX_ITERATIONS;
 
 		// Get the closest face to the origin.
 		Face face = simplex.findClosestFace();
@@ -342,10 +838,10 @@ bool GjkAlgorithm::EPA(Simplex &simplex, std::vector<Eigen::Vector3d>& convex1,
 		double distance = face.getDistance();
 
 		// Get the new support-point in the direction of the faces normal to expand the simplex.
-		SupportPoint* p = support(convex1, convex2, normal);
+		SupportPoint p = support(convex1, convex2, normal);
 
 		// Check the distance to the new support point.
-		double d = abs(p->getMinkowskiPoint().dot(normal));
+		double d = abs(p.getMinkowskiPoint().dot(normal));
 
 		// - New point does not expand the simplex => converged
 		if (d - distance < EPA_TOLERANCE) {
@@ -359,9 +855,9 @@ bool GjkAlgorithm::EPA(Simplex &simplex, std::vector<Eigen::Vector3d>& convex1,
 
 		// To finish the EPA, store the needed intersection-information on the collision
 		if (stop) {
-			Eigen::Vector3d bary = barycentric(p->getMinkowskiPoint(), face[0]->getMinkowskiPoint(), face[1]->getMinkowskiPoint(), face[2]->getMinkowskiPoint());
-			Eigen::Vector3d poc1 = cartesian(bary, face[0]->getConvexHull1Point(), face[1]->getConvexHull1Point(), face[2]->getConvexHull1Point());
-			Eigen::Vector3d poc2 = cartesian(bary, face[0]->getConvexHull2Point(), face[1]->getConvexHull2Point(), face[2]->getConvexHull2Point());
+			Eigen::Vector3d bary = barycentric(p.getMinkowskiPoint(), face[0].getMinkowskiPoint(), face[1].getMinkowskiPoint(), face[2].getMinkowskiPoint());
+			Eigen::Vector3d poc1 = cartesian(bary, face[0].getConvexHull1Point(), face[1].getConvexHull1Point(), face[2].getConvexHull1Point());
+			Eigen::Vector3d poc2 = cartesian(bary, face[0].getConvexHull2Point(), face[1].getConvexHull2Point(), face[2].getConvexHull2Point());
 
 			collision.setFirstPOC(poc1);
 			collision.setSecondPOC(poc2);
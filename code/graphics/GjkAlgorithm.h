@@ -11,6 +11,7 @@
 
 #include "Simplex.h"
 #include "SupportPoint.h"
+#include "ConvexShape.h"
 #include "../physics/Collision.h"
 
 namespace pbs17 {
@@ -23,6 +24,27 @@ namespace pbs17 {
 	 */
 	class GjkAlgorithm {
 	public:
+		/**
+		 * \brief Counters of the searches of one thread (they are only increased, the caller takes the differences).
+		 */
+		struct Statistics {
+			//! Number of GJK-searches (intersect())
+			unsigned long gjkCalls;
+			//! Number of iterations of all GJK-searches
+			unsigned long gjkIterations;
+			//! Number of iterations of all EPA-expansions
+			unsigned long epaIterations;
+		};
+
+
+		/**
+		 * \brief Get the counters of the searches of the current thread.
+		 *
+		 * \return Counters of the thread.
+		 */
+		static const Statistics& getStatistics();
+
+
 		/**
 		 * \brief Identifies if two convex-hulls intersect.
 		 * 
@@ -37,7 +59,105 @@ namespace pbs17 {
 		 * 
 		 * \return True if there is an intersection, false otherwise.
 		 */
-		static bool intersect(std::vector<Eigen::Vector3d> &convex1, std::vector<Eigen::Vector3d> &convex2, Collision &collision);
+		static bool intersect(const std::vector<Eigen::Vector3d> &convex1, const std::vector<Eigen::Vector3d> &convex2, Collision &collision);
+
+
+		/**
+		 * \brief Identifies if two convex-hulls intersect. The support-points are found by hill-climbing if the
+		 * shapes have an adjacency, and each shape remembers its last support-vertex.
+		 * 
+		 * \param convex1
+		 *      Convex-hull of first object.
+		 * \param convex2
+		 *      Convex-hull of second object.
+		 * \param collision
+		 *	    Output-parameter:
+		 *			Input:		Collision-object with the link to the two space-objects.
+		 *			Output:		Collision-object with all information of the intersection. (if there is any)
+		 * 
+		 * \return True if there is an intersection, false otherwise.
+		 */
+		static bool intersect(ConvexShape &convex1, ConvexShape &convex2, Collision &collision);
+
+
+		/**
+		 * \brief Identifies if two convex-hulls intersect, starting the search with the given direction (e.g. the
+		 * separating axis of the previous frame). If the direction still separates both hulls, only one
+		 * support-point is needed.
+		 * 
+		 * \param convex1
+		 *      Convex-hull of first object.
+		 * \param convex2
+		 *      Convex-hull of second object.
+		 * \param direction
+		 *      Output-parameter:
+		 *			Input:		Initial search-direction on the Minkowski-sum (zero => (1, 1, 1)).
+		 *			Output:		Separating axis if there is no intersection, last search-direction otherwise.
+		 * \param collision
+		 *	    Output-parameter:
+		 *			Input:		Collision-object with the link to the two space-objects.
+		 *			Output:		Collision-object with all information of the intersection. (if there is any)
+		 * 
+		 * \return True if there is an intersection, false otherwise.
+		 */
+		static bool intersect(ConvexShape &convex1, ConvexShape &convex2, Eigen::Vector3d &direction, Collision &collision);
+
+
+		/**
+		 * \brief Get the closest point of a convex-hull to a point (GJK distance-query on the hull minus the point).
+		 * 
+		 * \param convex
+		 *      Convex-hull of the object.
+		 * \param point
+		 *      Point to query (e.g. center of a sphere).
+		 * \param closest
+		 *      Output-parameter: Closest point on the convex-hull (only if the point is outside).
+		 * 
+		 * \return True if the point is outside of the convex-hull, false if it is inside (or on the surface).
+		 */
+		static bool getClosestPoint(ConvexShape &convex, const Eigen::Vector3d &point, Eigen::Vector3d &closest);
+
+
+		/**
+		 * \brief Get the distance of two convex-hulls (GJK distance-query on the Minkowski-difference), with the
+		 * first convex-hull moved by an offset (e.g. back along its path for the continuous collision-detection).
+		 * 
+		 * \param convex1
+		 *      Convex-hull of first object.
+		 * \param convex2
+		 *      Convex-hull of second object.
+		 * \param offset
+		 *      Translation of the first convex-hull.
+		 * \param separation
+		 *      Output-parameter: Shortest vector from the second to the moved first convex-hull (only if they are separated).
+		 * 
+		 * \return True if the convex-hulls are separated, false if they intersect (or touch).
+		 */
+		static bool getDistance(ConvexShape &convex1, ConvexShape &convex2, const Eigen::Vector3d &offset, Eigen::Vector3d &separation);
+
+
+		/**
+		 * \brief Get the closest points of two convex-hulls (GJK distance-query which keeps the support-vertices of
+		 * the simplex), warm-started with the separation of the previous frame.
+		 * 
+		 * \param convex1
+		 *      Convex-hull of first object.
+		 * \param convex2
+		 *      Convex-hull of second object.
+		 * \param separation
+		 *      Output-parameter:
+		 *			Input:		Separation of the previous query (zero => (1, 1, 1)).
+		 *			Output:		Shortest vector from the second to the first convex-hull if they are separated, last
+		 *						vector of the search otherwise.
+		 * \param closest1
+		 *      Output-parameter: Closest point on the first convex-hull (only if they are separated).
+		 * \param closest2
+		 *      Output-parameter: Closest point on the second convex-hull (only if they are separated).
+		 * 
+		 * \return True if the convex-hulls are separated, false if they intersect (or touch).
+		 */
+		static bool getClosestPoints(ConvexShape &convex1, ConvexShape &convex2, Eigen::Vector3d &separation,
+			Eigen::Vector3d &closest1, Eigen::Vector3d &closest2);
 
 
 		/**
@@ -52,7 +172,7 @@ namespace pbs17 {
 		 * 
 		 * \return Furthest point on the Minkowski-sum with corresponding two vertices of convex hull.
 		 */
-		static SupportPoint* support(std::vector<Eigen::Vector3d> &convex1, std::vector<Eigen::Vector3d> &convex2, Eigen::Vector3d direction);
+		static SupportPoint support(ConvexShape &convex1, ConvexShape &convex2, const Eigen::Vector3d &direction);
 
 
 		/**
@@ -65,7 +185,7 @@ namespace pbs17 {
 		 *      
 		 * \return Furthest point.
 		 */
-		static Eigen::Vector3d getFurthestPoint(std::vector<Eigen::Vector3d> &convex, Eigen::Vector3d direction);
+		static Eigen::Vector3d getFurthestPoint(const std::vector<Eigen::Vector3d> &convex, Eigen::Vector3d direction);
 
 
 		/**
@@ -90,6 +210,12 @@ namespace pbs17 {
 		//! Tolerance of the EPA algorithm to determine if the hull can be still extended or not.
 		static const double EPA_TOLERANCE;
 
+		//! Maximum number of extensions of the EPA (the closest face so far is used after that).
+		static const int EPA_MAX_ITERATIONS;
+
+		//! Counters of the searches of each thread
+		static thread_local Statistics STATISTICS;
+
 
 		/**
 		 * \brief Check on which Voronoi-region the origin is. Then adjust the simplex to cut off regions.
@@ -130,6 +256,48 @@ namespace pbs17 {
 		static bool processTetrahedron(Simplex &simplex, Eigen::Vector3d &direction);
 
 
+		/**
+		 * \brief Get the closest point to the origin on the simplex of the distance-query and reduce the simplex to
+		 * the vertices of the closest feature.
+		 * 
+		 * \param simplex
+		 *      Output-parameter: Vertices of the simplex (1 to 4), reduced to the closest feature.
+		 * \param count
+		 *      Output-parameter: Number of vertices of the simplex.
+		 * 
+		 * \return Closest point to the origin (zero if the tetrahedron contains the origin).
+		 */
+		static Eigen::Vector3d reduceSimplex(Eigen::Vector3d *simplex, int &count);
+
+
+		/**
+		 * \brief Get the closest point to the origin on a triangle and reduce it to the vertices of the closest feature.
+		 * 
+		 * \param simplex
+		 *      Output-parameter: Vertices of the triangle, reduced to the closest feature.
+		 * \param count
+		 *      Output-parameter: Number of vertices of the feature.
+		 * 
+		 * \return Closest point to the origin.
+		 */
+		static Eigen::Vector3d reduceTriangle(Eigen::Vector3d *simplex, int &count);
+
+
+		/**
+		 * \brief Get the barycentric coordinates of a point on a simplex of the distance-query.
+		 * 
+		 * \param simplex
+		 *      Vertices of the simplex (a point, a line or a triangle).
+		 * \param count
+		 *      Number of vertices of the simplex (1 to 3).
+		 * \param point
+		 *      Point on the simplex.
+		 * \param weights
+		 *      Output-parameter: Weights of the vertices (they sum up to one).
+		 */
+		static void getBarycentric(const Eigen::Vector3d *simplex, int count, const Eigen::Vector3d &point, double *weights);
+
+
 		/**
 		 * \brief Expanding Polytope Algorithm: Extends the simplex which contains the origin so that the nearest point on the
 		 * Minkowski-sum to the origin is found.
@@ -147,6 +315,6 @@ namespace pbs17 {
 		 *
 		 * \return Direction of the colision.
 		 */
-		static bool EPA(Simplex &simplex, std::vector<Eigen::Vector3d> &convex1, std::vector<Eigen::Vector3d> &convex2, Collision &collision);
+		static bool EPA(Simplex &simplex, ConvexShape &convex1, ConvexShape &convex2, Collision &collision);
 	};
 }
@@ -11,8 +11,11 @@
 // ReSharper disable once CppUnusedIncludeDirective
 #include <Eigen/Geometry>
 #include <limits>
+#include <functional>
+#include <cmath>
 
 #include "Geometry.h"
+#include "../physics/Logger.h"
 #include <iostream>
 
 using namespace pbs17;
@@ -28,136 +31,191 @@ void Simplex::triangulate() {
 	}
 
 	if (_vertices.size() == 2) {
-		std::cout << "Simplex of 2\n";
+		LOG_DEBUG("Simplex of 2");
 
 		// If only a line is available at the moment when GJK converged, add two points to form a tetrahedron.
 		// Create a new vertex which is perpendicular to the plane given by the two vertices and the origin.
 		// Add another vertex which is close to the origin. With this, the hope is that after few steps the valid
 		// and correct tetrahedron is computed and contains the origin (or at least that the origin is on the surface).
 		Eigen::Vector3d o = Eigen::Vector3d(0, 0, 0);
-		Eigen::Vector3d a = _vertices[0]->getMinkowskiPoint();
-		Eigen::Vector3d b = _vertices[1]->getMinkowskiPoint();
+		Eigen::Vector3d a = _vertices[0].getMinkowskiPoint();
+		Eigen::Vector3d b = _vertices[1].getMinkowskiPoint();
 		Eigen::Vector3d ba = a - b;
 		Eigen::Vector3d bo = o - b;
 
 		Eigen::Vector3d toC = ba.cross(bo);
-		_vertices.push_back(new SupportPoint(a + toC.normalized() * 0.1, Eigen::Vector3d(0,0,0), Eigen::Vector3d(0,0,0)));
-		_vertices.push_back(new SupportPoint(b + (1.0 + EPS) * bo, Eigen::Vector3d(0,0,0), Eigen::Vector3d(0,0,0)));
+		_vertices.push_back(SupportPoint(a + toC.normalized() * 0.1, Eigen::Vector3d(0,0,0), Eigen::Vector3d(0,0,0)));
+		_vertices.push_back(SupportPoint(b + (1.0 + EPS) * bo, Eigen::Vector3d(0,0,0), Eigen::Vector3d(0,0,0)));
 	}
 
 	if (_vertices.size() == 3) {
-		std::cout << "Simplex of 3\n";
+		LOG_DEBUG("Simplex of 3");
 	
 		// If only a triangle is available at the moment when GJK converged, add one point to form a tetrahedron.
 		// Add the point so that the origin is included or at least that the origin is on the surface.
 		Eigen::Vector3d o = Eigen::Vector3d(0, 0, 0);
-		Eigen::Vector3d b = _vertices[1]->getMinkowskiPoint();
+		Eigen::Vector3d b = _vertices[1].getMinkowskiPoint();
 		Eigen::Vector3d bo = o - b;
 
-		_vertices.push_back(new SupportPoint(b + (1.0 + EPS) * bo, Eigen::Vector3d(0,0,0), Eigen::Vector3d(0,0,0)));
+		_vertices.push_back(SupportPoint(b + (1.0 + EPS) * bo, Eigen::Vector3d(0,0,0), Eigen::Vector3d(0,0,0)));
 	}
 
 	// Triangulate the tetrahedron so that the normals point all outwards.
+	_faces.clear();
+	_heap.clear();
+	_closestFace = -1;
+
 	if (isCorrectOrder(0, 1, 2, 3)) {
-		_triangles.push_back(Eigen::Vector3i(0, 1, 2));
-		_triangles.push_back(Eigen::Vector3i(0, 3, 1));
-		_triangles.push_back(Eigen::Vector3i(0, 2, 3));
-		_triangles.push_back(Eigen::Vector3i(1, 3, 2));
+		addFace(0, 1, 2);
+		addFace(0, 3, 1);
+		addFace(0, 2, 3);
+		addFace(1, 3, 2);
 	} else {
-		_triangles.push_back(Eigen::Vector3i(0, 2, 1));
-		_triangles.push_back(Eigen::Vector3i(0, 1, 3));
-		_triangles.push_back(Eigen::Vector3i(0, 3, 2));
-		_triangles.push_back(Eigen::Vector3i(1, 2, 3));
+		addFace(0, 2, 1);
+		addFace(0, 1, 3);
+		addFace(0, 3, 2);
+		addFace(1, 2, 3);
+	}
+
+	// Link the neighbours: each edge is used in the opposite direction by the neighbour.
+	for (int f = 0; f < 4; ++f) {
+		for (int e = 0; e < 3; ++e) {
+			int a = _faces[f].vertices[e];
+			int b = _faces[f].vertices[(e + 1) % 3];
+
+			for (int g = 0; g < 4; ++g) {
+				for (int h = 0; h < 3; ++h) {
+					if (_faces[g].vertices[h] == b && _faces[g].vertices[(h + 1) % 3] == a) {
+						_faces[f].adjacent[e] = g;
+						_faces[f].adjacentEdge[e] = h;
+					}
+				}
+			}
+		}
 	}
 }
 
 
 
 /**
- * \brief Only in EPA: Find the closest face to the origin.
+ * \brief Only in EPA: Find the closest face to the origin. The faces are kept in a min-heap by their
+ * distance, so only the removed faces on top of the heap have to be skipped.
  *
  * \return The face with all needed information for EPA.
  */
 Face Simplex::findClosestFace() {
+	while (!_heap.empty() && _faces[_heap.front().second].isRemoved) {
+		std::pop_heap(_heap.begin(), _heap.end(), std::greater<std::pair<double, int>>());
+		_heap.pop_back();
+	}
+
 	Face closest;
 	closest.setDistance(std::numeric_limits<double>::max());
+	_closestFace = -1;
 
-	// Check each face if it is the closest or not.
-	for (unsigned int i = 0; i < _triangles.size(); ++i) {
-		SupportPoint* aSP = _vertices[_triangles[i].x()];
-		SupportPoint* bSP = _vertices[_triangles[i].y()];
-		SupportPoint* cSP = _vertices[_triangles[i].z()];
-		Eigen::Vector3d a = aSP->getMinkowskiPoint();
-		Eigen::Vector3d b = bSP->getMinkowskiPoint();
-		Eigen::Vector3d c = cSP->getMinkowskiPoint();
-		Eigen::Vector3d normal = getNormalFromPoints(a, b, c);
-		double d = -normal.dot(a);
-
-		double distance = abs(d / normal.norm());
-
-		if (distance < closest.getDistance()) {
-			closest.setDistance(distance);
-			closest.setNormal(normal.normalized());
-			closest.setVertices({ aSP, bSP, cSP });
-		}
+	if (_heap.empty()) {
+		return closest;
 	}
 
+	_closestFace = _heap.front().second;
+	const EpaFace &face = _faces[_closestFace];
+	closest.setDistance(face.distance);
+	closest.setNormal(face.normal);
+	closest.setVertices(_vertices[face.vertices[0]], _vertices[face.vertices[1]], _vertices[face.vertices[2]]);
+
 	return closest;
 }
 
 
 /**
  * \brief Only in EPA: Extend the triangulated simplex with a new point. All triangles which are
- * visible to the point will be removed and replaced by new ones including the new point.
+ * visible to the point will be removed and replaced by new ones including the new point. The visible
+ * triangles are found by walking over the neighbours, starting at the closest face.
  *
  * \param v
  *      New point to extend the triangulated simplex.
  * 
  * \return True if the new vertex has been inserted; false otherwise (when vertex was already in the simplex)
  */
-bool Simplex::extend(SupportPoint* v) {
-	for (std::vector<SupportPoint*>::iterator it = _vertices.begin(); it != _vertices.end(); ++it) {
-		if ((*it)->getMinkowskiPoint() == v->getMinkowskiPoint()) {
+bool Simplex::extend(const SupportPoint &v) {
+	for (std::vector<SupportPoint>::iterator it = _vertices.begin(); it != _vertices.end(); ++it) {
+		if (it->getMinkowskiPoint() == v.getMinkowskiPoint()) {
 			return false;
 		}
 	}
 
-	std::vector<Eigen::Vector3i> newTriangles;
-	std::vector<Edge> edges;
+	Eigen::Vector3d point = v.getMinkowskiPoint();
+
+	// Start at the closest face if it is visible (usual case in EPA), otherwise search a visible face.
+	int start = _closestFace;
+	if (start < 0 || _faces[start].isRemoved || !isVisible(start, point)) {
+		start = -1;
+
+		for (unsigned int f = 0; f < _faces.size(); ++f) {
+			if (!_faces[f].isRemoved && isVisible(f, point)) {
+				start = f;
+				break;
+			}
+		}
+	}
+
+	// The point is inside => nothing to extend
+	if (start < 0) {
+		return false;
+	}
+
 	int newVertexPosition = static_cast<int>(_vertices.size());
 	_vertices.push_back(v);
 
-	// Check each triangle if the new point is visible:
-	//  - yes: remove the trianlge and keep edge-information which edges to keep.
-	//  - no:  keep the triangle
-	for (unsigned int i = 0; i < _triangles.size(); ++i) {
-		int a = _triangles[i].x();
-		int b = _triangles[i].y();
-		int c = _triangles[i].z();
-		Eigen::Vector3d normal = getNormalFromPoints(_vertices[a]->getMinkowskiPoint(), _vertices[b]->getMinkowskiPoint(), _vertices[c]->getMinkowskiPoint());
-
-		// Point is visible by face
-		if (isSameDirection(normal, v->getMinkowskiPoint() - _vertices[a]->getMinkowskiPoint())) {
-			addEdge(edges, a, b);
-			addEdge(edges, b, c);
-			addEdge(edges, c, a);
-		} else {
-			newTriangles.push_back(_triangles[i]);
-		}
+	// Remove all visible faces and collect the horizon (ordered edges of the hole).
+	_horizon.clear();
+	_faces[start].isRemoved = true;
+
+	for (int e = 0; e < 3; ++e) {
+		findHorizon(_faces[start].adjacent[e], _faces[start].adjacentEdge[e], point);
+	}
+
+	// Create new triangles based on the horizon-edges and the new vertex. The edge (a, b) of the removed
+	// triangle is the edge (b, a) of the remaining face.
+	int firstNewFace = static_cast<int>(_faces.size());
+
+	for (unsigned int i = 0; i < _horizon.size(); ++i) {
+		int face = _horizon[i].first;
+		int edge = _horizon[i].second;
+		int a = _faces[face].vertices[(edge + 1) % 3];
+		int b = _faces[face].vertices[edge];
+
+		int newFace = addFace(newVertexPosition, a, b);
+		_faces[newFace].adjacent[1] = face;
+		_faces[newFace].adjacentEdge[1] = edge;
+		_faces[face].adjacent[edge] = newFace;
+		_faces[face].adjacentEdge[edge] = 1;
 	}
 
-	// Create new triangles based on the remaining edges and the new vertex.
-	for (unsigned int i = 0; i < edges.size(); ++i) {
-		newTriangles.push_back(Eigen::Vector3i(newVertexPosition, edges[i].getA(), edges[i].getB()));
+	// Link the new triangles with each other: (new, a, b) is next to the one which ends with a resp. starts with b.
+	int lastFace = static_cast<int>(_faces.size());
+
+	for (int f = firstNewFace; f < lastFace; ++f) {
+		for (int g = firstNewFace; g < lastFace; ++g) {
+			if (_faces[g].vertices[2] == _faces[f].vertices[1]) {
+				_faces[f].adjacent[0] = g;
+				_faces[f].adjacentEdge[0] = 2;
+			}
+
+			if (_faces[g].vertices[1] == _faces[f].vertices[2]) {
+				_faces[f].adjacent[2] = g;
+				_faces[f].adjacentEdge[2] = 0;
+			}
+		}
 	}
 
-	_triangles = newTriangles;
 	return true;
 }
 
 
 /**
- * \brief Check if the polygon defined by vertices a, b and c (in this order) is pointing outwards.
+ * \brief Only EPA: Add a triangle with its cached plane to the faces and to the heap. The neighbours
+ * have to be linked afterwards.
  *
  * \param a
  *      Index of 1st vertex.
@@ -165,11 +223,81 @@ bool Simplex::extend(SupportPoint* v) {
  *      Index of 2nd vertex.
  * \param c
  *      Index of 3rd vertex.
- * \param opposite
- *      Index of the opposite vertex (4th vertex) to check if the normal is pointing outwards.
+ *
+ * \return Index of the new face.
  */
-bool Simplex::isCorrectOrder(int a, int b, int c, int opposite) {
-	return isCorrectOrder(a, b, c, _vertices[opposite]->getMinkowskiPoint());
+int Simplex::addFace(int a, int b, int c) {
+	EpaFace face;
+	face.vertices[0] = a;
+	face.vertices[1] = b;
+	face.vertices[2] = c;
+
+	for (int e = 0; e < 3; ++e) {
+		face.adjacent[e] = -1;
+		face.adjacentEdge[e] = -1;
+	}
+
+	Eigen::Vector3d pointA = _vertices[a].getMinkowskiPoint();
+	Eigen::Vector3d normal = getNormalFromPoints(pointA, _vertices[b].getMinkowskiPoint(), _vertices[c].getMinkowskiPoint());
+	double length = normal.norm();
+
+	face.normal = length > 0.0 ? Eigen::Vector3d(normal / length) : normal;
+	face.distance = length > 0.0 ? std::abs(face.normal.dot(pointA)) : std::numeric_limits<double>::max();
+	face.isRemoved = false;
+
+	int index = static_cast<int>(_faces.size());
+	_faces.push_back(face);
+
+	_heap.push_back(std::make_pair(face.distance, index));
+	std::push_heap(_heap.begin(), _heap.end(), std::greater<std::pair<double, int>>());
+
+	return index;
+}
+
+
+/**
+ * \brief Only EPA: Check if a face can be seen from a point (the point is in front of its plane).
+ *
+ * \param face
+ *      Index of the face.
+ * \param point
+ *      Point to check.
+ */
+bool Simplex::isVisible(int face, const Eigen::Vector3d &point) const {
+	const EpaFace &f = _faces[face];
+
+	return isSameDirection(f.normal, point - _vertices[f.vertices[0]].getMinkowskiPoint());
+}
+
+
+/**
+ * \brief Only EPA: Remove the visible faces behind an edge (depth-first) and collect the horizon: The
+ * edges where a visible face meets a face which is not visible.
+ *
+ * \param face
+ *      Index of the face behind the edge.
+ * \param edge
+ *      Edge of the face which has been crossed.
+ * \param point
+ *      New point of the simplex.
+ */
+void Simplex::findHorizon(int face, int edge, const Eigen::Vector3d &point) {
+	if (_faces[face].isRemoved) {
+		return;
+	}
+
+	if (!isVisible(face, point)) {
+		_horizon.push_back(std::make_pair(face, edge));
+		return;
+	}
+
+	_faces[face].isRemoved = true;
+
+	// continue over the other two edges
+	for (int k = 1; k < 3; ++k) {
+		int e = (edge + k) % 3;
+		findHorizon(_faces[face].adjacent[e], _faces[face].adjacentEdge[e], point);
+	}
 }
 
 
@@ -183,38 +311,30 @@ bool Simplex::isCorrectOrder(int a, int b, int c, int opposite) {
  * \param c
  *      Index of 3rd vertex.
  * \param opposite
- *      Position of the opposite vertex (4th vertex) to check if the normal is pointing outwards.
+ *      Index of the opposite vertex (4th vertex) to check if the normal is pointing outwards.
  */
-bool Simplex::isCorrectOrder(int a, int b, int c, Eigen::Vector3d opposite) {
-	Eigen::Vector3d normal = getNormalFromPoints(_vertices[a]->getMinkowskiPoint(), _vertices[b]->getMinkowskiPoint(), _vertices[c]->getMinkowskiPoint());
-	Eigen::Vector3d height = opposite - _vertices[a]->getMinkowskiPoint();
-
-	return isOppositeDirection(normal, height);
+bool Simplex::isCorrectOrder(int a, int b, int c, int opposite) {
+	return isCorrectOrder(a, b, c, _vertices[opposite].getMinkowskiPoint());
 }
 
 
 /**
- * \brief Only EPA: while removing the triangles which are seen by the added point, this keeps track
- * of the deleted edges. As soon as one edge is added a second time but in the opposite direction,
- * we know the edge is connecting two triangles which are both removed, so we can simply remove this
- * edge as well and no longer keep track of it.
+ * \brief Check if the polygon defined by vertices a, b and c (in this order) is pointing outwards.
  *
- * \param edges
- *      List of all observed (potentially removed) edges.
  * \param a
- *      Index of the start-vertex.
+ *      Index of 1st vertex.
  * \param b
- *      Index of the end-vertex.
+ *      Index of 2nd vertex.
+ * \param c
+ *      Index of 3rd vertex.
+ * \param opposite
+ *      Position of the opposite vertex (4th vertex) to check if the normal is pointing outwards.
  */
-void Simplex::addEdge(std::vector<Edge>& edges, int a, int b) {
-	for (unsigned int i = 0; i < edges.size(); ++i) {
-		if (edges[i].getA() == b && edges[i].getB() == a) {
-			edges.erase(edges.begin() + i);
-			return;
-		}
-	}
+bool Simplex::isCorrectOrder(int a, int b, int c, Eigen::Vector3d opposite) {
+	Eigen::Vector3d normal = getNormalFromPoints(_vertices[a].getMinkowskiPoint(), _vertices[b].getMinkowskiPoint(), _vertices[c].getMinkowskiPoint());
+	Eigen::Vector3d height = opposite - _vertices[a].getMinkowskiPoint();
 
-	edges.push_back(Edge(a, b));
+	return isOppositeDirection(normal, height);
 }
 
 
@@ -227,10 +347,12 @@ void Simplex::printMatlabPlot() const
 	std::string y_0 = "", y_1 = "", y_2 = "";
 	std::string z_0 = "", z_1 = "", z_2 = "";
 
-	for (unsigned int i = 0; i < _triangles.size(); ++i) {
-		Eigen::Vector3d a = _vertices[_triangles[i].x()]->getMinkowskiPoint();
-		Eigen::Vector3d b = _vertices[_triangles[i].y()]->getMinkowskiPoint();
-		Eigen::Vector3d c = _vertices[_triangles[i].z()]->getMinkowskiPoint();
+	for (unsigned int i = 0; i < _faces.size(); ++i) {
+		if (_faces[i].isRemoved) continue;
+
+		Eigen::Vector3d a = _vertices[_faces[i].vertices[0]].getMinkowskiPoint();
+		Eigen::Vector3d b = _vertices[_faces[i].vertices[1]].getMinkowskiPoint();
+		Eigen::Vector3d c = _vertices[_faces[i].vertices[2]].getMinkowskiPoint();
 
 		x_0 += " " + std::to_string(a.x());
 		x_1 += " " + std::to_string(b.x());
@@ -257,15 +379,17 @@ void Simplex::printMatlabPlot() const
  * \param closest
  *      Print the face in the matlab-plot with a special color to see which is the closest to the origin.
  */
-void Simplex::printMatlabPlot(Face &closest) const {
+void Simplex::printMatlabPlot(const Face &closest) const {
 	std::string x_0 = "", x_1 = "", x_2 = "";
 	std::string y_0 = "", y_1 = "", y_2 = "";
 	std::string z_0 = "", z_1 = "", z_2 = "";
 
-	for (unsigned int i = 0; i < _triangles.size(); ++i) {
-		Eigen::Vector3d a = _vertices[_triangles[i].x()]->getMinkowskiPoint();
-		Eigen::Vector3d b = _vertices[_triangles[i].y()]->getMinkowskiPoint();
-		Eigen::Vector3d c = _vertices[_triangles[i].z()]->getMinkowskiPoint();
+	for (unsigned int i = 0; i < _faces.size(); ++i) {
+		if (_faces[i].isRemoved) continue;
+
+		Eigen::Vector3d a = _vertices[_faces[i].vertices[0]].getMinkowskiPoint();
+		Eigen::Vector3d b = _vertices[_faces[i].vertices[1]].getMinkowskiPoint();
+		Eigen::Vector3d c = _vertices[_faces[i].vertices[2]].getMinkowskiPoint();
 
 		x_0 += " " + std::to_string(a.x());
 		x_1 += " " + std::to_string(b.x());
@@ -282,9 +406,9 @@ void Simplex::printMatlabPlot(Face &closest) const {
 		<< "Y = [" << y_0 << ";" << y_1 << ";" << y_2 << "];" << std::endl
 		<< "Z = [" << z_0 << ";" << z_1 << ";" << z_2 << "];" << std::endl
 		<< "C = [ 0 0 1];" << std::endl
-		<< "X_closest = [ " << closest[0]->getMinkowskiPoint().x() << "; " << closest[1]->getMinkowskiPoint().x() << "; " << closest[2]->getMinkowskiPoint().x() << "];" << std::endl
-		<< "Y_closest = [ " << closest[0]->getMinkowskiPoint().y() << "; " << closest[1]->getMinkowskiPoint().y() << "; " << closest[2]->getMinkowskiPoint().y() << "];" << std::endl
-		<< "Z_closest = [ " << closest[0]->getMinkowskiPoint().z() << "; " << closest[1]->getMinkowskiPoint().z() << "; " << closest[2]->getMinkowskiPoint().z() << "];" << std::endl
+		<< "X_closest = [ " << closest[0].getMinkowskiPoint().x() << "; " << closest[1].getMinkowskiPoint().x() << "; " << closest[2].getMinkowskiPoint().x() << "];" << std::endl
+		<< "Y_closest = [ " << closest[0].getMinkowskiPoint().y() << "; " << closest[1].getMinkowskiPoint().y() << "; " << closest[2].getMinkowskiPoint().y() << "];" << std::endl
+		<< "Z_closest = [ " << closest[0].getMinkowskiPoint().z() << "; " << closest[1].getMinkowskiPoint().z() << "; " << closest[2].getMinkowskiPoint().z() << "];" << std::endl
 		<< "C_closest = [ 1 0 0 ];" << std::endl << std::endl
 		<< "figure" << std::endl << "patch(X, Y, Z, C);" << std::endl << "patch(X_closest, Y_closest, Z_closest, C_closest);" << std::endl;
 }
@@ -13,7 +13,6 @@
 #include <Eigen/Core>
 
 #include "Face.h"
-#include "Edge.h"
 #include "SupportPoint.h"
 
 namespace pbs17 {
@@ -23,16 +22,34 @@ namespace pbs17 {
 	 */
 	class Simplex {
 	public:
+		/**
+		 * \brief Constructor of an empty simplex.
+		 */
+		Simplex() {}
+
+
 		/**
 		 * \brief Constructor.
 		 * 
 		 * \param vertices
 		 *      List of vertices which forms the simplex at the beginning.
 		 */
-		Simplex(std::vector<SupportPoint*> vertices)
+		Simplex(std::vector<SupportPoint> vertices)
 			: _vertices(vertices) {}
 
 
+		/**
+		 * \brief Remove all vertices and triangles. The buffers keep their capacity, so a reused simplex does
+		 * not allocate again.
+		 */
+		void clear() {
+			_vertices.clear();
+			_faces.clear();
+			_heap.clear();
+			_closestFace = -1;
+		}
+
+
 		/**
 		 * \brief Get the size of the simplex, which defines the shape of it (line, triangle or tetrahedron).
 		 * 
@@ -51,7 +68,7 @@ namespace pbs17 {
 		 * 
 		 * \return Vertex at position i.
 		 */
-		SupportPoint* operator[](int i) {
+		const SupportPoint& operator[](int i) const {
 			return _vertices[i];
 		}
 
@@ -62,20 +79,20 @@ namespace pbs17 {
 		 * \param v
 		 *      New vertex of the simplex.
 		 */
-		void add(SupportPoint* v) {
+		void add(const SupportPoint &v) {
 			_vertices.push_back(v);
 		}
 
 
 		/**
-		 * \brief Remove an existing vertex.
+		 * \brief Remove an existing vertex. The order of the other vertices is kept, so if multiple vertices
+		 * are removed, the higher index has to be removed first.
 		 * 
-		 * \param v
-		 *      Vertex to remove off the simplex.
+		 * \param i
+		 *      Position of the vertex to remove off the simplex.
 		 */
-		void remove(SupportPoint* v) {
-			_vertices.erase(std::remove(_vertices.begin(), _vertices.end(), v));
-			delete v;
+		void remove(int i) {
+			_vertices.erase(_vertices.begin() + i);
 		}
 
 
@@ -87,7 +104,8 @@ namespace pbs17 {
 
 
 		/**
-		 * \brief Only in EPA: Find the closest face to the origin
+		 * \brief Only in EPA: Find the closest face to the origin. The faces are kept in a min-heap by their
+		 * distance, so only the removed faces on top of the heap have to be skipped.
 		 * 
 		 * \return The face with all needed information for EPA.
 		 */
@@ -96,22 +114,50 @@ namespace pbs17 {
 
 		/**
 		 * \brief Only in EPA: Extend the triangulated simplex with a new point. All triangles which are
-		 * visible to the point will be removed and replaced by new ones including the new point.
+		 * visible to the point will be removed and replaced by new ones including the new point. The visible
+		 * triangles are found by walking over the neighbours, starting at the closest face.
 		 * 
 		 * \param v
 		 *      New point to extend the triangulated simplex.
 		 * 
 		 * \return True if the new vertex has been inserted; false otherwise (when vertex was already in the simplex)      
 		 */
-		bool extend(SupportPoint* v);
+		bool extend(const SupportPoint &v);
 
 	private:
 
 		//! All vertices which are used to define the simplex.
-		std::vector<SupportPoint*> _vertices;
+		std::vector<SupportPoint> _vertices;
 
-		//! All triangles which are used to define the simplex. (counter-clockwise)
-		std::vector<Eigen::Vector3i> _triangles;
+		/**
+		 * \brief Only EPA: triangle of the simplex with its neighbours and the cached plane.
+		 */
+		struct EpaFace {
+			//! Indices of the vertices (counter-clockwise)
+			int vertices[3];
+			//! Neighbour across the edge from vertices[i] to vertices[(i + 1) % 3]
+			int adjacent[3];
+			//! Edge of the neighbour which is the same edge
+			int adjacentEdge[3];
+			//! Normal of the face (normalized, pointing outwards)
+			Eigen::Vector3d normal;
+			//! Distance from the face to the origin
+			double distance;
+			//! True if the face has been removed by an extension
+			bool isRemoved;
+		};
+
+		//! All triangles which are used to define the simplex, including the removed ones (only EPA).
+		std::vector<EpaFace> _faces;
+
+		//! Min-heap of the (distance, face) of all faces; removed faces are skipped lazily (only EPA).
+		std::vector<std::pair<double, int>> _heap;
+
+		//! Face which has been returned by findClosestFace() (-1 => none)
+		int _closestFace = -1;
+
+		//! Only EPA: horizon-edges (face, edge) of extend(), kept to reuse the capacity.
+		std::vector<std::pair<int, int>> _horizon;
 
 
 		/**
@@ -145,19 +191,44 @@ namespace pbs17 {
 
 
 		/**
-		 * \brief Only EPA: while removing the triangles which are seen by the added point, this keeps track
-		 * of the deleted edges. As soon as one edge is added a second time but in the opposite direction,
-		 * we know the edge is connecting two triangles which are both removed, so we can simply remove this
-		 * edge as well and no longer keep track of it.
+		 * \brief Only EPA: Add a triangle with its cached plane to the faces and to the heap. The neighbours
+		 * have to be linked afterwards.
 		 * 
-		 * \param edges
-		 *      List of all observed (potentially removed) edges.
 		 * \param a
-		 *      Index of the start-vertex.
+		 *      Index of 1st vertex.
 		 * \param b
-		 *      Index of the end-vertex.
+		 *      Index of 2nd vertex.
+		 * \param c
+		 *      Index of 3rd vertex.
+		 *
+		 * \return Index of the new face.
+		 */
+		int addFace(int a, int b, int c);
+
+
+		/**
+		 * \brief Only EPA: Check if a face can be seen from a point (the point is in front of its plane).
+		 * 
+		 * \param face
+		 *      Index of the face.
+		 * \param point
+		 *      Point to check.
+		 */
+		bool isVisible(int face, const Eigen::Vector3d &point) const;
+
+
+		/**
+		 * \brief Only EPA: Remove the visible faces behind an edge (depth-first) and collect the horizon: The
+		 * edges where a visible face meets a face which is not visible.
+		 * 
+		 * \param face
+		 *      Index of the face behind the edge.
+		 * \param edge
+		 *      Edge of the face which has been crossed.
+		 * \param point
+		 *      New point of the simplex.
 		 */
-		static void addEdge(std::vector<Edge> &edges, int a, int b);
+		void findHorizon(int face, int edge, const Eigen::Vector3d &point);
 
 
 		/**
@@ -172,6 +243,6 @@ namespace pbs17 {
 		 * \param closest
 		 *      Print the face in the matlab-plot with a special color to see which is the closest to the origin.
 		 */
-		void printMatlabPlot(Face &closest) const;
+		void printMatlabPlot(const Face &closest) const;
 	};
 }
@@ -0,0 +1,163 @@
+﻿/**
+ * \brief Vertices of a convex-hull as single precision structure-of-arrays for the vectorized support-queries.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "SoaVertices.h"
+
+#include <limits>
+
+// Same as the gravity-kernel: the vectorized kernel is compiled with a function-specific target-attribute
+// and selected at runtime, so the rest of the project does not need any special compiler-flags.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PBS17_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+using namespace pbs17;
+
+//! Number of floats per AVX-register (the arrays are padded to a multiple of it)
+const unsigned int SoaVertices::WIDTH;
+
+
+/**
+ * \brief Copy the vertices.
+ *
+ * \param vertices
+ *      Vertices of the convex-hull.
+ * \param origin
+ *      Origin of the stored coordinates (does not change the furthest vertex).
+ */
+void SoaVertices::assign(const std::vector<Eigen::Vector3d> &vertices, const Eigen::Vector3d &origin) {
+	_size = vertices.size();
+	unsigned int padded = (_size + WIDTH - 1) / WIDTH * WIDTH;
+
+	_x.resize(padded);
+	_y.resize(padded);
+	_z.resize(padded);
+
+	for (unsigned int i = 0; i < padded; ++i) {
+		// the padding repeats the first vertex, so it never beats it
+		Eigen::Vector3d v = i < _size ? Eigen::Vector3d(vertices[i] - origin) : Eigen::Vector3d(vertices[0] - origin);
+		_x[i] = static_cast<float>(v.x());
+		_y[i] = static_cast<float>(v.y());
+		_z[i] = static_cast<float>(v.z());
+	}
+}
+
+
+/**
+ * \brief Get the furthest vertex in a direction.
+ *
+ * \param direction
+ *      Direction to search the furthest vertex.
+ *
+ * \return Index of the furthest vertex (the first one of equal vertices, 0 if there is none).
+ */
+int SoaVertices::getFurthest(const Eigen::Vector3d &direction) const {
+	static const KernelFunction kernel = selectKernel();
+
+	if (_size == 0) return 0;
+
+	int best = kernel(_x.data(), _y.data(), _z.data(), _x.size(), static_cast<float>(direction.x()),
+		static_cast<float>(direction.y()), static_cast<float>(direction.z()));
+
+	return best < static_cast<int>(_size) ? best : 0;
+}
+
+
+/**
+ * \brief Select the best kernel which is supported by the CPU.
+ *
+ * \return Kernel implementation.
+ */
+SoaVertices::KernelFunction SoaVertices::selectKernel() {
+#if defined(PBS17_X86_SIMD)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return &SoaVertices::getFurthestAvx2;
+	}
+#endif
+
+	return &SoaVertices::getFurthestScalar;
+}
+
+
+/**
+ * \brief Scalar implementation (fallback).
+ *
+ * \param x, y, z
+ *      Coordinates of the padded vertices.
+ * \param n
+ *      Number of padded vertices (multiple of WIDTH).
+ * \param dx, dy, dz
+ *      Direction to search the furthest vertex.
+ *
+ * \return Index of the furthest vertex (may be in the padding).
+ */
+int SoaVertices::getFurthestScalar(const float* x, const float* y, const float* z, int n, float dx, float dy, float dz) {
+	float max = -std::numeric_limits<float>::max();
+	int best = 0;
+
+	for (int i = 0; i < n; ++i) {
+		float dot = x[i] * dx + y[i] * dy + z[i] * dz;
+
+		if (dot > max) {
+			max = dot;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+
+#if defined(PBS17_X86_SIMD)
+
+/**
+ * \brief AVX2/FMA implementation with 8 vertices per register. Same parameters as getFurthestScalar().
+ */
+__attribute__((target("avx2,fma")))
+int SoaVertices::getFurthestAvx2(const float* x, const float* y, const float* z, int n, float dx, float dy, float dz) {
+	const __m256 vDx = _mm256_set1_ps(dx);
+	const __m256 vDy = _mm256_set1_ps(dy);
+	const __m256 vDz = _mm256_set1_ps(dz);
+	const __m256i vStep = _mm256_set1_epi32(WIDTH);
+
+	// maximum and its index per lane, each lane keeps its first maximum
+	__m256 vMax = _mm256_set1_ps(-std::numeric_limits<float>::max());
+	__m256i vBest = _mm256_setzero_si256();
+	__m256i vIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+	for (int i = 0; i < n; i += WIDTH) {
+		__m256 dot = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), vDx,
+			_mm256_fmadd_ps(_mm256_loadu_ps(y + i), vDy, _mm256_mul_ps(_mm256_loadu_ps(z + i), vDz)));
+		__m256 isGreater = _mm256_cmp_ps(dot, vMax, _CMP_GT_OQ);
+
+		vMax = _mm256_blendv_ps(vMax, dot, isGreater);
+		vBest = _mm256_blendv_epi8(vBest, vIndex, _mm256_castps_si256(isGreater));
+		vIndex = _mm256_add_epi32(vIndex, vStep);
+	}
+
+	// horizontal reduction (the smaller index wins a tie, same as the scalar scan)
+	alignas(32) float max[WIDTH];
+	alignas(32) int best[WIDTH];
+	_mm256_store_ps(max, vMax);
+	_mm256_store_si256(reinterpret_cast<__m256i*>(best), vBest);
+
+	int result = best[0];
+	float resultMax = max[0];
+	for (unsigned int lane = 1; lane < WIDTH; ++lane) {
+		if (max[lane] > resultMax || (max[lane] == resultMax && best[lane] < result)) {
+			resultMax = max[lane];
+			result = best[lane];
+		}
+	}
+
+	return result;
+}
+
+#endif
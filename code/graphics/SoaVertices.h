@@ -0,0 +1,112 @@
+﻿/**
+ * \brief Vertices of a convex-hull as single precision structure-of-arrays for the vectorized support-queries.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/StdVector>
+
+namespace pbs17 {
+
+	/**
+	 * \brief Copy of the vertices of a convex-hull as aligned float-arrays (x, y, z), relative to an origin (e.g. the
+	 * center of the object), so the single precision keeps the resolution of the shape far from the world-origin.
+	 * The arrays are padded with the first vertex to a multiple of the register-width. The furthest vertex in a
+	 * direction is found with 8 dot-products per register and a horizontal max-reduction (AVX2 or scalar, selected
+	 * once at runtime based on the capabilities of the CPU).
+	 */
+	class SoaVertices {
+	public:
+		/**
+		 * \brief Copy the vertices.
+		 *
+		 * \param vertices
+		 *      Vertices of the convex-hull.
+		 * \param origin
+		 *      Origin of the stored coordinates (does not change the furthest vertex).
+		 */
+		void assign(const std::vector<Eigen::Vector3d> &vertices, const Eigen::Vector3d &origin);
+
+
+		/**
+		 * \brief Get the furthest vertex in a direction.
+		 *
+		 * \param direction
+		 *      Direction to search the furthest vertex.
+		 *
+		 * \return Index of the furthest vertex (the first one of equal vertices, 0 if there is none).
+		 */
+		int getFurthest(const Eigen::Vector3d &direction) const;
+
+
+		/**
+		 * \brief Get the number of vertices (without the padding).
+		 *
+		 * \return Number of vertices.
+		 */
+		unsigned int size() const {
+			return _size;
+		}
+
+
+		/**
+		 * \brief Get the memory of the coordinate-arrays (including the padding and the reserved capacity).
+		 *
+		 * \return Memory in bytes.
+		 */
+		size_t getMemorySize() const {
+			return (_x.capacity() + _y.capacity() + _z.capacity()) * sizeof(float);
+		}
+
+
+	private:
+		//! Number of floats per AVX-register (the arrays are padded to a multiple of it)
+		static const unsigned int WIDTH = 8;
+
+		//! Signature of the kernel implementations
+		typedef int(*KernelFunction)(const float*, const float*, const float*, int, float, float, float);
+
+
+		/**
+		 * \brief Select the best kernel which is supported by the CPU.
+		 *
+		 * \return Kernel implementation.
+		 */
+		static KernelFunction selectKernel();
+
+
+		/**
+		 * \brief Scalar implementation (fallback).
+		 *
+		 * \param x, y, z
+		 *      Coordinates of the padded vertices.
+		 * \param n
+		 *      Number of padded vertices (multiple of WIDTH).
+		 * \param dx, dy, dz
+		 *      Direction to search the furthest vertex.
+		 *
+		 * \return Index of the furthest vertex (may be in the padding).
+		 */
+		static int getFurthestScalar(const float* x, const float* y, const float* z, int n, float dx, float dy, float dz);
+
+
+		/**
+		 * \brief AVX2/FMA implementation with 8 vertices per register. Same parameters as getFurthestScalar().
+		 */
+		static int getFurthestAvx2(const float* x, const float* y, const float* z, int n, float dx, float dy, float dz);
+
+
+		//! Coordinates of the padded vertices relative to the origin
+		std::vector<float, Eigen::aligned_allocator<float>> _x;
+		std::vector<float, Eigen::aligned_allocator<float>> _y;
+		std::vector<float, Eigen::aligned_allocator<float>> _z;
+		//! Number of vertices (without the padding)
+		unsigned int _size = 0;
+	};
+}
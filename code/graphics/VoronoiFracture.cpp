@@ -0,0 +1,450 @@
+﻿/**
+ * \brief Implementation of the Voronoi-fracture of a convex-hull into pre-fractured pieces.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#include "VoronoiFracture.h"
+
+#include <set>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#include <Eigen/Geometry>
+#include <osg/Math>
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Get a random number of a seed (SplitMix64, same as the scene-generator).
+	 *
+	 * \param seed
+	 *      Seed of the fracture.
+	 * \param k
+	 *      Index of the random number.
+	 *
+	 * \return Uniform random number in [0, 1).
+	 */
+	double getRandom(unsigned int seed, unsigned int k) {
+		uint64_t z = seed + 0x9E3779B97F4A7C15ull * (static_cast<uint64_t>(k) + 1);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		z ^= z >> 31;
+
+		return (z >> 11) * (1.0 / 9007199254740992.0);
+	}
+}
+
+
+const double VoronoiFracture::EPSILON = 1e-9;
+const double VoronoiFracture::SHRINK = 0.98;
+
+
+/**
+ * \brief Split a convex-hull into the Voronoi-cells of random seeds (the hull itself is not changed).
+ *
+ * \param hull
+ *      Convex-hull in the model-space.
+ * \param cntPieces
+ *      Number of seeds (cells without volume are dropped).
+ * \param seed
+ *      Seed of the random seeds, so the same model always breaks in the same way.
+ * \param withGeometry
+ *      True if the geometries to render the pieces are built.
+ * \param pieces
+ *      Output-parameter: Pieces of the hull (the hulls are owned by the caller).
+ */
+void VoronoiFracture::fracture(const ConvexHull3D &hull, int cntPieces, unsigned int seed, bool withGeometry, std::vector<Piece> &pieces) {
+	const std::vector<Eigen::Vector3d> &vertices = hull.getVertices();
+	const Eigen::MatrixXi &triangles = hull.getFaces();
+	pieces.clear();
+
+	if (vertices.size() < 4 || cntPieces < 1) {
+		return;
+	}
+
+	Eigen::Vector3d center = Eigen::Vector3d::Zero();
+	Eigen::Vector3d lower = vertices[0];
+	Eigen::Vector3d upper = vertices[0];
+	for (unsigned int i = 0; i < vertices.size(); ++i) {
+		center += vertices[i];
+		lower = lower.cwiseMin(vertices[i]);
+		upper = upper.cwiseMax(vertices[i]);
+	}
+	center /= static_cast<double>(vertices.size());
+
+	// the triangles of the hull with their outward planes
+	std::vector<Polygon> hullFaces;
+	std::vector<Eigen::Vector3d> normals;
+	std::vector<double> distances;
+	for (int row = 0; row < triangles.rows(); ++row) {
+		Eigen::Vector3d a = vertices[triangles(row, 0)];
+		Eigen::Vector3d b = vertices[triangles(row, 1)];
+		Eigen::Vector3d c = vertices[triangles(row, 2)];
+		Eigen::Vector3d normal = (b - a).cross(c - a);
+
+		if (normal.norm() < EPSILON) continue;
+
+		normal.normalize();
+		if (normal.dot(a - center) < 0.0) {
+			std::swap(b, c);
+			normal = -normal;
+		}
+
+		Polygon face = { a, b, c };
+		hullFaces.push_back(face);
+		normals.push_back(normal);
+		distances.push_back(normal.dot(a));
+	}
+
+	// the seeds are sampled inside of the hull
+	std::vector<Eigen::Vector3d> seeds;
+	unsigned int k = 0;
+	for (int attempt = 0; attempt < 1000 * cntPieces && static_cast<int>(seeds.size()) < cntPieces; ++attempt) {
+		Eigen::Vector3d sample;
+		for (int axis = 0; axis < 3; ++axis) {
+			sample(axis) = lower(axis) + (upper(axis) - lower(axis)) * getRandom(seed, k++);
+		}
+
+		bool isInside = true;
+		for (unsigned int f = 0; f < normals.size() && isInside; ++f) {
+			isInside = normals[f].dot(sample) < distances[f];
+		}
+
+		if (isInside) {
+			seeds.push_back(sample);
+		}
+	}
+
+	// the cell of each seed is the hull clipped by the bisecting planes to all other seeds
+	std::vector<std::vector<Polygon> > cells;
+	std::vector<double> volumes;
+	std::vector<Eigen::Vector3d> centroids;
+	std::vector<Eigen::Matrix3d> inertias;
+	double totalVolume = 0.0;
+
+	for (unsigned int i = 0; i < seeds.size(); ++i) {
+		std::vector<Polygon> cell = hullFaces;
+
+		for (unsigned int j = 0; j < seeds.size() && cell.size() >= 4; ++j) {
+			Eigen::Vector3d normal = seeds[j] - seeds[i];
+			if (i == j || normal.norm() < EPSILON) continue;
+
+			normal.normalize();
+			clip(cell, normal, normal.dot(0.5 * (seeds[i] + seeds[j])));
+		}
+
+		double volume;
+		Eigen::Vector3d centroid;
+		Eigen::Matrix3d inertia;
+		if (cell.size() < 4) continue;
+
+		computeMassProperties(cell, volume, centroid, inertia);
+		if (volume <= EPSILON * EPSILON) continue;
+
+		cells.push_back(cell);
+		volumes.push_back(volume);
+		centroids.push_back(centroid);
+		inertias.push_back(inertia);
+		totalVolume += volume;
+	}
+
+	for (unsigned int i = 0; i < cells.size(); ++i) {
+		// relative to the center of mass (the inertia per mass of the shrunk piece scales quadratically)
+		std::vector<Polygon> &cell = cells[i];
+		for (unsigned int f = 0; f < cell.size(); ++f) {
+			for (unsigned int v = 0; v < cell[f].size(); ++v) {
+				cell[f][v] = SHRINK * (cell[f][v] - centroids[i]);
+			}
+		}
+
+		Piece piece;
+		piece.hull = toConvexHull(cell);
+		piece.centroid = centroids[i];
+		piece.volumeRatio = volumes[i] / totalVolume;
+		piece.inertiaPerMass = (SHRINK * SHRINK / volumes[i]) * inertias[i];
+		if (withGeometry) {
+			piece.geometry = toGeometry(cell, centroids[i]);
+		}
+
+		pieces.push_back(piece);
+	}
+}
+
+
+/**
+ * \brief Clip a convex polyhedron by a plane and close the cut with a new face.
+ *
+ * \param faces
+ *      Faces of the polyhedron (replaced by the clipped faces).
+ * \param normal
+ *      Normal of the plane (the side in the direction of the normal is removed).
+ * \param distance
+ *      Distance of the plane along its normal.
+ */
+void VoronoiFracture::clip(std::vector<Polygon> &faces, const Eigen::Vector3d &normal, double distance) {
+	std::vector<Polygon> clipped;
+	Polygon cut;
+
+	// Sutherland-Hodgman per face, the vertices on the plane are the vertices of the new face
+	for (unsigned int f = 0; f < faces.size(); ++f) {
+		const Polygon &face = faces[f];
+		Polygon kept;
+
+		for (unsigned int v = 0; v < face.size(); ++v) {
+			const Eigen::Vector3d &a = face[v];
+			const Eigen::Vector3d &b = face[(v + 1) % face.size()];
+			double da = normal.dot(a) - distance;
+			double db = normal.dot(b) - distance;
+			int sideA = da > EPSILON ? 1 : (da < -EPSILON ? -1 : 0);
+			int sideB = db > EPSILON ? 1 : (db < -EPSILON ? -1 : 0);
+
+			if (sideA <= 0) {
+				kept.push_back(a);
+			}
+			if (sideA == 0) {
+				cut.push_back(a);
+			}
+			if (sideA * sideB < 0) {
+				Eigen::Vector3d intersection = a + (da / (da - db)) * (b - a);
+				kept.push_back(intersection);
+				cut.push_back(intersection);
+			}
+		}
+
+		// the intersections may coincide with the vertices on the plane
+		Polygon unique;
+		for (unsigned int v = 0; v < kept.size(); ++v) {
+			if (unique.empty() || (kept[v] - unique.back()).norm() > EPSILON) {
+				unique.push_back(kept[v]);
+			}
+		}
+		while (unique.size() > 1 && (unique.front() - unique.back()).norm() <= EPSILON) {
+			unique.pop_back();
+		}
+
+		if (unique.size() >= 3) {
+			clipped.push_back(unique);
+		}
+	}
+
+	Polygon cap;
+	for (unsigned int v = 0; v < cut.size(); ++v) {
+		bool isNew = true;
+		for (unsigned int u = 0; u < cap.size() && isNew; ++u) {
+			isNew = (cut[v] - cap[u]).norm() > EPSILON;
+		}
+
+		if (isNew) {
+			cap.push_back(cut[v]);
+		}
+	}
+
+	// the new face is convex => sorted by the angle around its center (counter-clockwise around the normal)
+	if (cap.size() >= 3) {
+		Eigen::Vector3d center = Eigen::Vector3d::Zero();
+		for (unsigned int v = 0; v < cap.size(); ++v) {
+			center += cap[v];
+		}
+		center /= static_cast<double>(cap.size());
+
+		Eigen::Vector3d u = (cap[0] - center).normalized();
+		Eigen::Vector3d w = normal.cross(u);
+		std::vector<std::pair<double, Eigen::Vector3d> > sorted;
+		for (unsigned int v = 0; v < cap.size(); ++v) {
+			Eigen::Vector3d d = cap[v] - center;
+			sorted.push_back(std::make_pair(std::atan2(d.dot(w), d.dot(u)), cap[v]));
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const std::pair<double, Eigen::Vector3d> &lhs, const std::pair<double, Eigen::Vector3d> &rhs) {
+			return lhs.first < rhs.first;
+		});
+
+		for (unsigned int v = 0; v < sorted.size(); ++v) {
+			cap[v] = sorted[v].second;
+		}
+		clipped.push_back(cap);
+	}
+
+	faces.swap(clipped);
+}
+
+
+/**
+ * \brief Calculate the volume, the center of mass and the covariance of a closed convex polyhedron
+ *        (sum of the tetrahedra between its triangles and an inner point).
+ *
+ * \param faces
+ *      Faces of the polyhedron.
+ * \param volume
+ *      Output-parameter: Volume of the polyhedron.
+ * \param centroid
+ *      Output-parameter: Center of mass (constant density).
+ * \param inertia
+ *      Output-parameter: Moment of inertia about the center of mass (unit density).
+ */
+void VoronoiFracture::computeMassProperties(const std::vector<Polygon> &faces, double &volume, Eigen::Vector3d &centroid, Eigen::Matrix3d &inertia) {
+	// the mean of the vertices is inside of the convex polyhedron
+	Eigen::Vector3d reference = Eigen::Vector3d::Zero();
+	int cntVertices = 0;
+	for (unsigned int f = 0; f < faces.size(); ++f) {
+		for (unsigned int v = 0; v < faces[f].size(); ++v) {
+			reference += faces[f][v];
+			++cntVertices;
+		}
+	}
+	reference /= static_cast<double>(std::max(cntVertices, 1));
+
+	volume = 0.0;
+	Eigen::Vector3d moment = Eigen::Vector3d::Zero();
+	Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+
+	for (unsigned int f = 0; f < faces.size(); ++f) {
+		const Polygon &face = faces[f];
+
+		for (unsigned int v = 1; v + 1 < face.size(); ++v) {
+			Eigen::Vector3d a = face[0] - reference;
+			Eigen::Vector3d b = face[v] - reference;
+			Eigen::Vector3d c = face[v + 1] - reference;
+			double tetrahedron = a.dot(b.cross(c)) / 6.0;
+			Eigen::Vector3d sum = a + b + c;
+
+			volume += tetrahedron;
+			moment += tetrahedron * sum / 4.0;
+			// covariance of a tetrahedron with a vertex in the origin
+			covariance += (tetrahedron / 20.0) * (a * a.transpose() + b * b.transpose() + c * c.transpose() + sum * sum.transpose());
+		}
+	}
+
+	if (volume <= 0.0) {
+		centroid = reference;
+		inertia = Eigen::Matrix3d::Zero();
+		return;
+	}
+
+	Eigen::Vector3d offset = moment / volume;
+	covariance -= volume * offset * offset.transpose();
+
+	centroid = reference + offset;
+	inertia = covariance.trace() * Eigen::Matrix3d::Identity() - covariance;
+}
+
+
+/**
+ * \brief Build the convex-hull (shared vertices, triangles and adjacency) of the faces of a piece.
+ *
+ * \param faces
+ *      Faces of the piece relative to its center of mass.
+ *
+ * \return Convex-hull of the piece.
+ */
+ConvexHull3D* VoronoiFracture::toConvexHull(const std::vector<Polygon> &faces) {
+	std::vector<Eigen::Vector3d> vertices;
+	std::vector<std::vector<int> > indices(faces.size());
+
+	for (unsigned int f = 0; f < faces.size(); ++f) {
+		for (unsigned int v = 0; v < faces[f].size(); ++v) {
+			int index = -1;
+			for (unsigned int u = 0; u < vertices.size() && index < 0; ++u) {
+				if ((vertices[u] - faces[f][v]).norm() <= EPSILON) {
+					index = u;
+				}
+			}
+
+			if (index < 0) {
+				index = vertices.size();
+				vertices.push_back(faces[f][v]);
+			}
+			indices[f].push_back(index);
+		}
+	}
+
+	// fans of the faces, the edges of the faces are the adjacency of the hill-climbing
+	std::vector<Eigen::Vector3i> triangles;
+	std::vector<std::set<int> > neighbours(vertices.size());
+	for (unsigned int f = 0; f < indices.size(); ++f) {
+		const std::vector<int> &face = indices[f];
+
+		for (unsigned int v = 0; v < face.size(); ++v) {
+			int next = face[(v + 1) % face.size()];
+			if (face[v] != next) {
+				neighbours[face[v]].insert(next);
+				neighbours[next].insert(face[v]);
+			}
+		}
+
+		for (unsigned int v = 1; v + 1 < face.size(); ++v) {
+			if (face[0] != face[v] && face[v] != face[v + 1] && face[0] != face[v + 1]) {
+				triangles.push_back(Eigen::Vector3i(face[0], face[v], face[v + 1]));
+			}
+		}
+	}
+
+	Eigen::MatrixXi triangleMatrix(triangles.size(), 3);
+	for (unsigned int t = 0; t < triangles.size(); ++t) {
+		triangleMatrix.row(t) = triangles[t].transpose();
+	}
+
+	std::vector<int> adjacencyStart(1, 0);
+	std::vector<int> adjacency;
+	for (unsigned int v = 0; v < neighbours.size(); ++v) {
+		adjacency.insert(adjacency.end(), neighbours[v].begin(), neighbours[v].end());
+		adjacencyStart.push_back(adjacency.size());
+	}
+
+	return new ConvexHull3D(vertices, triangleMatrix, adjacencyStart, adjacency);
+}
+
+
+/**
+ * \brief Build the flat-shaded geometry of the faces of a piece (the texture-coordinates are the spherical
+ *        coordinates in the model-space, so the pieces of a model are textured alike).
+ *
+ * \param faces
+ *      Faces of the piece relative to its center of mass.
+ * \param centroid
+ *      Center of mass of the piece in the model-space.
+ *
+ * \return Geometry of the piece.
+ */
+osg::ref_ptr<osg::Geometry> VoronoiFracture::toGeometry(const std::vector<Polygon> &faces, const Eigen::Vector3d &centroid) {
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+	osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+	osg::ref_ptr<osg::Vec2Array> texCoords = new osg::Vec2Array;
+
+	for (unsigned int f = 0; f < faces.size(); ++f) {
+		const Polygon &face = faces[f];
+		Eigen::Vector3d normal = Eigen::Vector3d::Zero();
+		for (unsigned int v = 1; v + 1 < face.size(); ++v) {
+			normal += (face[v] - face[0]).cross(face[v + 1] - face[0]);
+		}
+		if (normal.norm() < EPSILON) continue;
+		normal.normalize();
+
+		for (unsigned int v = 1; v + 1 < face.size(); ++v) {
+			const Eigen::Vector3d* corners[3] = { &face[0], &face[v], &face[v + 1] };
+
+			for (int k = 0; k < 3; ++k) {
+				const Eigen::Vector3d &p = *corners[k];
+				Eigen::Vector3d direction = (p / SHRINK + centroid).normalized();
+
+				vertices->push_back(osg::Vec3(p.x(), p.y(), p.z()));
+				normals->push_back(osg::Vec3(normal.x(), normal.y(), normal.z()));
+				texCoords->push_back(osg::Vec2(0.5 + std::atan2(direction.y(), direction.x()) / (2.0 * osg::PI),
+					0.5 + std::asin(std::max(-1.0, std::min(direction.z(), 1.0))) / osg::PI));
+			}
+		}
+	}
+
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry->setVertexArray(vertices);
+	geometry->setNormalArray(normals, osg::Array::BIND_PER_VERTEX);
+	geometry->setTexCoordArray(0, texCoords, osg::Array::BIND_PER_VERTEX);
+	geometry->addPrimitiveSet(new osg::DrawArrays(GL_TRIANGLES, 0, vertices->size()));
+
+	return geometry;
+}
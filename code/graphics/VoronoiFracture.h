@@ -0,0 +1,123 @@
+﻿/**
+ * \brief Implementation of the Voronoi-fracture of a convex-hull into pre-fractured pieces.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#pragma once
+
+#include <vector>
+#include <Eigen/Core>
+#include <osg/Geometry>
+
+#include "ConvexHull3D.h"
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief VoronoiFracture splits a convex-hull into the Voronoi-cells of random seeds inside of it. Each cell is
+	 * the hull clipped by the bisecting planes to all other seeds, so the cells stay convex and no CGAL is needed.
+	 * The pieces are computed once per model (see FractureManager), a fracture only places them.
+	 */
+	class VoronoiFracture {
+	public:
+		/**
+		 * \brief Pre-fractured piece of a convex-hull.
+		 */
+		struct Piece {
+			//! Convex-hull of the piece relative to its center of mass (unscaled)
+			ConvexHull3D* hull = nullptr;
+			//! Flat-shaded triangles of the piece relative to its center of mass (nullptr => headless)
+			osg::ref_ptr<osg::Geometry> geometry;
+			//! Center of mass in the model-space of the fractured hull
+			Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+			//! Ratio of the volume of the piece to the volume of all pieces
+			double volumeRatio = 0.0;
+			//! Moment of inertia about the center of mass per unit of mass (unscaled)
+			Eigen::Matrix3d inertiaPerMass = Eigen::Matrix3d::Identity();
+		};
+
+
+		/**
+		 * \brief Split a convex-hull into the Voronoi-cells of random seeds (the hull itself is not changed).
+		 *
+		 * \param hull
+		 *      Convex-hull in the model-space.
+		 * \param cntPieces
+		 *      Number of seeds (cells without volume are dropped).
+		 * \param seed
+		 *      Seed of the random seeds, so the same model always breaks in the same way.
+		 * \param withGeometry
+		 *      True if the geometries to render the pieces are built.
+		 * \param pieces
+		 *      Output-parameter: Pieces of the hull (the hulls are owned by the caller).
+		 */
+		static void fracture(const ConvexHull3D &hull, int cntPieces, unsigned int seed, bool withGeometry, std::vector<Piece> &pieces);
+
+
+	private:
+		//! Convex polygon (counter-clockwise around its outward normal)
+		typedef std::vector<Eigen::Vector3d> Polygon;
+
+		//! Distance below which two vertices are merged
+		static const double EPSILON;
+		//! The pieces are shrunk by this factor around their centroids, so they don't touch each other
+		static const double SHRINK;
+
+
+		/**
+		 * \brief Clip a convex polyhedron by a plane and close the cut with a new face.
+		 *
+		 * \param faces
+		 *      Faces of the polyhedron (replaced by the clipped faces).
+		 * \param normal
+		 *      Normal of the plane (the side in the direction of the normal is removed).
+		 * \param distance
+		 *      Distance of the plane along its normal.
+		 */
+		static void clip(std::vector<Polygon> &faces, const Eigen::Vector3d &normal, double distance);
+
+
+		/**
+		 * \brief Calculate the volume, the center of mass and the covariance of a closed convex polyhedron
+		 *        (sum of the tetrahedra between its triangles and an inner point).
+		 *
+		 * \param faces
+		 *      Faces of the polyhedron.
+		 * \param volume
+		 *      Output-parameter: Volume of the polyhedron.
+		 * \param centroid
+		 *      Output-parameter: Center of mass (constant density).
+		 * \param inertia
+		 *      Output-parameter: Moment of inertia about the center of mass (unit density).
+		 */
+		static void computeMassProperties(const std::vector<Polygon> &faces, double &volume, Eigen::Vector3d &centroid, Eigen::Matrix3d &inertia);
+
+
+		/**
+		 * \brief Build the convex-hull (shared vertices, triangles and adjacency) of the faces of a piece.
+		 *
+		 * \param faces
+		 *      Faces of the piece relative to its center of mass.
+		 *
+		 * \return Convex-hull of the piece.
+		 */
+		static ConvexHull3D* toConvexHull(const std::vector<Polygon> &faces);
+
+
+		/**
+		 * \brief Build the flat-shaded geometry of the faces of a piece (the texture-coordinates are the spherical
+		 *        coordinates in the model-space, so the pieces of a model are textured alike).
+		 *
+		 * \param faces
+		 *      Faces of the piece relative to its center of mass.
+		 * \param centroid
+		 *      Center of mass of the piece in the model-space.
+		 *
+		 * \return Geometry of the piece.
+		 */
+		static osg::ref_ptr<osg::Geometry> toGeometry(const std::vector<Polygon> &faces, const Eigen::Vector3d &centroid);
+	};
+}
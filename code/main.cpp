@@ -9,6 +9,7 @@
 #include <osgDB/WriteFile>
 #include <osgViewer/Viewer>
 #include <osgViewer/ViewerEventHandlers>
+#include <osg/Timer>
 
 #include <boost/program_options.hpp>
 
@@ -18,10 +19,66 @@
 
 #include <iostream>
 #include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
 
 #include "scene/SceneManager.h"
+#include "scene/BinaryScene.h"
+#include "scene/SceneGenerator.h"
+#include "scene/SpaceObject.h"
 #include "physics/SimulationManager.h"
+#include "physics/SectorManager.h"
+#include "physics/DistributedSimulation.h"
+#include "physics/PhysicsThread.h"
+#include "physics/Profiler.h"
+#include "physics/NumaPolicy.h"
+#include "physics/ThreadBudget.h"
+#include "physics/JobSystem.h"
+#include "physics/Logger.h"
+#include "physics/MemoryTracker.h"
+#include "physics/Tracer.h"
+#include "physics/PararealIntegrator.h"
+#include "physics/TrajectoryRecorder.h"
+#include "physics/StatePublisher.h"
+#include "physics/MetricsExporter.h"
+#include "physics/StateSubscriber.h"
+#include "physics/TrajectoryPlayer.h"
+#include "physics/RunServer.h"
+#include "graphics/ConvexDecomposition.h"
+#include "graphics/DistanceField.h"
+#include "osg/AssetCache.h"
+#include "osg/ObjReader.h"
+#include "osg/ModelManager.h"
+#include "osg/ImageManager.h"
+#include "osg/ResourceCache.h"
+#include "osg/TextureStreamer.h"
+#include "osg/MipStreamer.h"
+#include "osg/SpatialCells.h"
+#include "osg/ProgramBinaryCache.h"
+#include "osg/UploadRing.h"
+#include "osg/IncrementalCompiler.h"
+#include "osg/InstanceCuller.h"
+#include "osg/InstanceManager.h"
+#include "osg/TrailSystem.h"
+#include "osg/particles/GpuParticleSystem.h"
+#include "osg/shaders/SunShader.h"
 #include "osg/SnapImageDrawCallback.h"
+#include "osg/FrameWriterThread.h"
+#include "osg/PhysicsUpdateCallback.h"
+#include "osg/SceneSyncCallback.h"
+#include "osg/SceneReloadCallback.h"
+#include "osg/ReplayUpdateCallback.h"
+#include "osg/StreamUpdateCallback.h"
+#include "osg/ComputeGravity.h"
+#include "osg/FrameGovernor.h"
+#include "osg/IdleRenderer.h"
+#include "osg/DynamicResolution.h"
+#include "osg/StereoRenderer.h"
+#include "osg/DensitySplat.h"
+#include "osg/OffscreenContext.h"
+#include "osg/LoadProfiler.h"
 #include "config.h"
 
 
@@ -30,9 +87,166 @@ using namespace boost::program_options;
 using json = nlohmann::json;
 
 
+namespace {
+
+	/**
+	 * \brief Write the queued snapshots of the recorder and close its log.
+	 *
+	 * \param recorder
+	 *      Recorder of the trajectories (nullptr => nothing is recorded).
+	 */
+	void closeRecorder(pbs17::TrajectoryRecorder* recorder) {
+		if (!recorder) return;
+
+		recorder->stop();
+		if (recorder->getNumDropped() > 0) {
+			LOG_WARNING("Dropped snapshots: " << recorder->getNumDropped());
+		}
+		delete recorder;
+	}
+
+
+	/**
+	 * \brief Write the times of the start into the json-file of the command-line (if any).
+	 *
+	 * \param vm
+	 *      Input parameters which have been passed by starting the program.
+	 */
+	void writeLoadReport(const variables_map &vm) {
+		if (!vm.count("loadReport")) return;
+
+		if (!pbs17::LoadProfiler::Instance()->writeJson(vm["loadReport"].as<std::string>())) {
+			LOG_WARNING("File " + vm["loadReport"].as<std::string>() + " can't be written!");
+		}
+	}
+
+
+	/**
+	 * \brief Simulate the steps as fast as possible without rendering and report the time and the diagnostics.
+	 *
+	 * \param simulationManager
+	 *      Simulation of the scene.
+	 * \param steps
+	 *      Number of steps.
+	 */
+	void simulateHeadless(pbs17::SimulationManager* simulationManager, int steps) {
+		double dt = simulationManager->getSimulationDt();
+		const osg::Timer* timer = osg::Timer::instance();
+		osg::Timer_t start = timer->tick();
+
+		for (int i = 0; i < steps; ++i) {
+			osg::Timer_t stepStart = timer->tick();
+			simulationManager->step(dt);
+			pbs17::MemoryTracker::count();
+			pbs17::Profiler::Instance()->endFrame(timer->delta_s(stepStart, timer->tick()));
+		}
+
+		double duration = timer->delta_s(start, timer->tick());
+		LOG_INFO("Steps: " << steps << "\ttime: " << duration << "\ttime per step: " << duration / std::max(steps, 1));
+
+		if (simulationManager->getDiagnostics().isEnabled()) {
+			const pbs17::Diagnostics::Sample &sample = simulationManager->getDiagnostics().getLast();
+			LOG_INFO("Energy: " << sample.totalEnergy << "\tdrift: " << sample.energyDrift << "\tmomentum-drift: " << sample.momentumDrift
+				<< "\tangular momentum-drift: " << sample.angularMomentumDrift);
+		}
+	}
+
+
+	/**
+	 * \brief Integrate the steps of the gravity headless and parallel in time (Parareal) and report the iterations,
+	 *        the time and the energy-drift.
+	 *
+	 * \param simulationManager
+	 *      Simulation of the scene (the initial state of the bodies).
+	 * \param settings
+	 *      Simulation-settings of the scene (integrator).
+	 * \param steps
+	 *      Number of steps.
+	 * \param vm
+	 *      Input parameters which have been passed by starting the program.
+	 */
+	void simulateParareal(pbs17::SimulationManager* simulationManager, const json &settings, int steps, const variables_map &vm) {
+		const pbs17::BodyState &bodies = simulationManager->getBodies();
+		double dt = simulationManager->getSimulationDt();
+
+		pbs17::NBodyManager::Integrator integrator = pbs17::NBodyManager::SEMI_IMPLICIT_EULER;
+		if (settings.count("integrator") && settings["integrator"].is_string()) {
+			pbs17::NBodyManager::parseIntegrator(settings["integrator"].get<std::string>(), integrator);
+		}
+
+		pbs17::PararealIntegrator::Coarse coarse = pbs17::PararealIntegrator::LEAPFROG;
+		if (!pbs17::PararealIntegrator::parseCoarse(vm["pararealCoarse"].as<std::string>(), coarse)) {
+			LOG_WARNING("Coarse propagator (" << vm["pararealCoarse"].as<std::string>() << ") not supported, the leapfrog is used.");
+		}
+
+		pbs17::PararealIntegrator parareal(static_cast<unsigned int>(bodies.size()));
+		for (unsigned int i = 0; i < bodies.size(); ++i) {
+			parareal.setBody(i, bodies.m[i], bodies.getPosition(i), bodies.getLinearVelocity(i));
+		}
+		if (!parareal.setIntegrator(integrator)) {
+			LOG_WARNING("The Parareal-mode uses the leapfrog instead of the integrator of the scene.");
+		}
+		parareal.setCoarse(coarse, static_cast<unsigned int>(std::max(vm["pararealCoarseSteps"].as<int>(), 1)));
+		parareal.setConvergence(vm["pararealTolerance"].as<double>(), 0);
+
+		double energy = parareal.computeEnergy();
+		const osg::Timer* timer = osg::Timer::instance();
+		osg::Timer_t start = timer->tick();
+
+		unsigned int slices = static_cast<unsigned int>(vm["parareal"].as<int>());
+		unsigned int iterations = parareal.integrate(dt, static_cast<unsigned int>(std::max(steps, 0)), slices);
+
+		double duration = timer->delta_s(start, timer->tick());
+		double drift = energy != 0.0 ? (parareal.computeEnergy() - energy) / std::abs(energy) : 0.0;
+		LOG_INFO("Steps: " << steps << "\tslices: " << slices << "\titerations: " << iterations << "\ttime: " << duration
+			<< "\ttime per step: " << duration / std::max(steps, 1));
+		LOG_INFO("Last correction: " << parareal.getLastCorrection() << "\tenergy-drift: " << drift);
+	}
+
+
+	/**
+	 * \brief Simulate the steps headless with the spatial domains split across the MPI-ranks (rank 0 reports).
+	 *
+	 * \param spaceObjects
+	 *      All space-objects in the scene (every rank loads the whole scene).
+	 * \param settings
+	 *      Simulation-settings of the scene.
+	 * \param steps
+	 *      Number of steps.
+	 */
+	void simulateDistributed(const std::vector<pbs17::SpaceObject*> &spaceObjects, const json &settings, int steps) {
+		pbs17::DistributedSimulation simulation(spaceObjects, settings);
+		double dt = simulation.getSimulationDt();
+		const osg::Timer* timer = osg::Timer::instance();
+		osg::Timer_t start = timer->tick();
+
+		for (int i = 0; i < steps; ++i) {
+			simulation.step(dt);
+		}
+
+		double duration = timer->delta_s(start, timer->tick());
+		std::vector<unsigned int> bodiesPerRank = simulation.getNumBodiesPerRank();
+
+		if (simulation.getRank() == 0) {
+			LOG_INFO("Steps: " << steps << "\tranks: " << simulation.getNumRanks() << "\ttime: " << duration
+				<< "\ttime per step: " << duration / std::max(steps, 1));
+			std::string counts;
+			for (unsigned int r = 0; r < bodiesPerRank.size(); ++r) {
+				counts += ' ' + std::to_string(bodiesPerRank[r]);
+			}
+			LOG_INFO("Bodies per rank:" << counts);
+		}
+	}
+}
+
+
 int main(int argc, const char *argv[]) {
     pbs17::SceneManager* sceneManager = new pbs17::SceneManager;
     osg::ref_ptr<osg::Node> scene = nullptr;
+	// base of the checkpoints, or the loaded checkpoint
+	pbs17::BinaryScene checkpointScene;
+	// json-file of the loaded scene (empty => not loaded from a json-file)
+	std::string sceneJsonPath;
 
 	std::cout << std::fixed << std::setprecision(6);
     variables_map vm;
@@ -43,99 +257,868 @@ int main(int argc, const char *argv[]) {
 			("help,h", "Help screen")
 			("spheres,s", value<int>()->default_value(10), "Spheres")
 			("asteroids,a", value<int>()->default_value(0), "Asteroids")
-			("emitter,e", value<std::string>()->default_value("sphere"), "Emitter")
+			("emitter,e", value<std::string>()->default_value("sphere"), "Emitter (sphere, cube, galaxy, ring, belt)")
+			("rings", value<int>()->default_value(50), "Rings of the galaxy- and ring-emitter")
+			("seed", value<unsigned int>()->default_value(0), "Seed of the emitter")
+			("proceduralAsteroids", value<bool>()->default_value(false), "Generate the asteroids of the galaxy-, ring- and belt-emitter from seeds (instead of the OBJ-models)")
+			("dust", value<int>()->default_value(0), "Massless dust-particles of the galaxy-, ring- and belt-emitter (point-sprites)")
+			("dustCollisions", value<bool>(), "Damp the dust by statistical inelastic collisions per cell (DSMC, linear in the particles)")
+			("dustRestitution", value<double>(), "Fraction of the relative speed which a pair of dust-particles keeps by a collision")
             ("rand,r", value<bool>()->default_value(true), "Random")
             ("gameplay,g", value<bool>()->default_value(false), "Gameplay")
             ("saveFrames,f", value<bool>()->default_value(false), "Save frame sto image files")
-			("sceneJson,j", value<std::string>(), "Json file containing the scene");
+			("frameQueue", value<unsigned int>()->default_value(8), "Number of captured frames which can wait for the writer-thread")
+			("dropFrames", value<bool>()->default_value(false), "Drop captured frames while the queue is full (instead of waiting)")
+			("videoFile", value<std::string>(), "Encode the frames into this video with ffmpeg (instead of --saveFrames)")
+			("videoFps", value<double>()->default_value(30.0), "Framerate of the video (one simulation-step per frame)")
+			("offscreen", value<std::string>(), "Render the frames of the size widthxheight without a window (e.g. 1920x1080 for the video of a server, needs -DPBS17_EGL=ON without a display)")
+			("maxFrames", value<long>()->default_value(0), "Stop after this number of frames (0 => until the viewer is closed)")
+			("frameRange", value<std::string>(), "Render only the frames start:end of the video of a replay (end excluded, start: => to the end of the log), e.g. the range of a worker of a render-farm")
+			("stitch", value<std::string>(), "Join the videos of --segments into this video (without encoding them again) and exit")
+			("segments", value<std::vector<std::string>>()->multitoken(), "Videos of the ranges of frames in their order (see --stitch)")
+			("physicsThread", value<bool>()->default_value(false), "Simulate on a separate thread with a fixed rate")
+			("physicsRate", value<double>()->default_value(60.0), "Steps per second of the physics-thread (and of the main-loop)")
+			("maxSubsteps", value<int>()->default_value(8), "Maximum steps per frame of the main-loop (0 => one step per frame)")
+			("fastForwardBudget", value<double>()->default_value(50.0), "Wall-clock in ms per frame which is simulated in the fast-forward mode (toggled by F)")
+			("pinThreads", value<bool>()->default_value(false), "Pin the OpenMP-threads and the rendering to fixed cpus, so the bodies stay in the memory of their NUMA-node (Linux)")
+			("renderCpus", value<int>()->default_value(1), "Cpus which are left to the rendering by the OpenMP-threads of the physics")
+			("threads", value<int>()->default_value(0), "Cores which are shared by the physics, the rendering and the background-work (0 => all)")
+			("backgroundThreads", value<int>()->default_value(1), "Shared threads for the loading, decoding and encoding (lowest priority)")
+			("jobs", value<bool>()->default_value(true), "Spread the work which no step waits for (e.g. writing the checkpoints) over the frames and the background-threads")
+			("jobBudget", value<double>()->default_value(2.0), "Time in ms per frame for the callbacks and the slices of the jobs on the thread of the simulation")
+			("hugePages", value<bool>()->default_value(false), "Back the arrays of the bodies by transparent huge pages (Linux)")
+			("gpuPhysics", value<bool>()->default_value(false), "Integrate the gravity in a compute-shader and draw the instances from the same buffer (gravity-only scenes, no collisions, needs OpenGL 4.3)")
+			("headless", value<bool>()->default_value(false), "Simulate without a viewer (physics only)")
+			("steps", value<int>()->default_value(1000), "Number of steps in the headless-mode")
+			("serve", value<unsigned int>(), "Load the scene once and simulate each parameter-set received on this TCP-port in a forked child (headless, POSIX), e.g. {\"steps\": 1000, \"settings\": {\"theta\": 0.7}, \"record\": \"run.pbst\"}")
+			("maxRuns", value<unsigned int>()->default_value(0), "Maximal number of concurrent runs of --serve (0 => unlimited)")
+			("mpi", value<bool>()->default_value(false), "Split the headless-mode into spatial domains of the MPI-ranks (mpirun, needs -DPBS17_MPI=ON)")
+			("rebalanceInterval", value<int>(), "Steps between two decompositions of the MPI-domains")
+			("parareal", value<int>()->default_value(0), "Integrate the gravity of the headless-mode parallel in time with this number of slices (Parareal, no collisions, 0 => off)")
+			("pararealCoarse", value<std::string>()->default_value("leapfrog"), "Coarse propagator of the Parareal-mode (leapfrog, kepler: orbits about the heaviest body)")
+			("pararealCoarseSteps", value<int>()->default_value(4), "Leapfrog-steps per slice of the coarse propagator")
+			("pararealTolerance", value<double>()->default_value(1e-8), "Largest relative change of the states at the slice-boundaries after which the Parareal-mode stops iterating")
+			("assetCache", value<bool>()->default_value(true), "Store the prepared models and convex-hulls in the cache-directory")
+			("resourceBudget", value<unsigned int>()->default_value(0), "Memory in MB of the loaded models and of the loaded textures above which the unused ones are evicted (0 => unlimited)")
+			("fastObj", value<bool>()->default_value(true), "Read the OBJ-models with the parallel parser instead of osgDB")
+			("convexDecomposition", value<bool>()->default_value(false), "Split concave models into convex parts which collide separately (computed once and stored in the asset-cache)")
+			("distanceFields", value<bool>()->default_value(false), "Sample the deep contacts of the large or compound models in precomputed distance-fields (stored in the asset-cache)")
+			("distanceFieldResolution", value<int>()->default_value(32), "Number of cells of a distance-field along the longest axis of the model")
+			("quantizedMeshes", value<bool>()->default_value(false), "Compress the vertex-arrays of the models (16-bit positions and uvs, 8-bit normals and tangents)")
+			("instancing", value<bool>()->default_value(false), "Draw the asteroids instanced per model (needs OpenGL 3.2)")
+			("gpuCulling", value<bool>()->default_value(false), "Cull the instances against the view and the planets in a compute-shader and draw them indirect (needs --instancing, OpenGL 4.3 and OSG 3.6)")
+			("sharedTrails", value<bool>()->default_value(false), "Draw all following-ribbons with one draw-call (needs OpenGL 3.2)")
+			("sunNoise", value<std::string>()->default_value("off"), "Granulation of the suns (off, baked: sampled from a tiling 3D-texture, procedural: evaluated per fragment)")
+			("gpuParticles", value<bool>()->default_value(false), "Simulate the exhaust and the dust and debris of the collisions in a GPU ring-buffer (needs OpenGL 3.2)")
+			("threadingModel", value<std::string>()->default_value("singleThreaded"), "Threading-model of the viewer (singleThreaded, cullDrawThreadPerContext, drawThreadPerContext, cullThreadPerCameraDrawThreadPerContext, automatic)")
+			("spatialCells", value<bool>()->default_value(true), "Group the objects by their position, so the clusters outside of the view are culled at once")
+			("lazyNodes", value<bool>()->default_value(false), "Build the nodes of the asteroids once they are visible and release them after they were culled for a while")
+			("lodQuality", value<double>()->default_value(1.0), "Quality of the levels of detail (> 1 => more detail, < 1 => faster)")
+			("dynamicResolution", value<double>()->default_value(0.0), "Render into an offscreen-target whose resolution holds this GPU-time per frame in ms (0 => native resolution, needs FBOs)")
+			("minResolution", value<double>()->default_value(0.5), "Smallest scale of the width and height of the dynamic resolution")
+			("sharpness", value<double>()->default_value(0.3), "Strength of the sharpening of the upscaled dynamic resolution (0 => bilinear)")
+			("stereo", value<bool>()->default_value(false), "Render both eyes side by side, the instanced models in a single pass (needs GL_ARB_shader_viewport_layer_array)")
+			("eyeSeparation", value<double>()->default_value(0.065), "Distance between the eyes of the stereo-rendering")
+			("fusionDistance", value<double>()->default_value(15.0), "Distance at which the eyes of the stereo-rendering converge")
+			("densitySplat", value<bool>()->default_value(false), "Draw the bodies as an additive density-field once most of them are smaller than a pixel (needs FBOs)")
+			("splatResolution", value<double>()->default_value(0.5), "Scale of the width and height of the density-field")
+			("splatExposure", value<double>()->default_value(1.0), "Exposure of the tone-mapping of the density-field")
+			("idleWhenPaused", value<bool>()->default_value(true), "Draw a paused scene only on input or when the camera moves, the main-loop sleeps otherwise")
+			("targetFps", value<double>()->default_value(0.0), "Hold this framerate by lowering the fidelity down to the --governor* limits (0 => off, the knobs are shown in the HUD)")
+			("governorMaxTheta", value<double>()->default_value(1.2), "Largest opening angle of the Barnes-Hut and the fast multipole solver (see --targetFps)")
+			("governorMinSubsteps", value<int>()->default_value(1), "Smallest number of collision-substeps (see --targetFps)")
+			("governorMaxLodScale", value<double>()->default_value(4.0), "Largest factor of the LOD-scale (see --targetFps)")
+			("governorMinParticles", value<double>()->default_value(0.25), "Smallest fraction of the emitted GPU-particles (see --targetFps)")
+			("governorMinTrails", value<double>()->default_value(0.25), "Smallest fraction of the length of the shared trails (see --targetFps)")
+			("streamTextures", value<bool>()->default_value(false), "Draw the first frames with placeholders while the textures are decoded on a background-thread")
+			("mipStreaming", value<bool>()->default_value(false), "Stream the mip-levels of the planet-textures by their size on the screen (the levels are stored in the cache-directory)")
+			("mipBudget", value<unsigned int>()->default_value(64), "Memory in MB of the resident mip-levels of the planet-textures")
+			("prebakedTextures", value<bool>()->default_value(true), "Load the block-compressed .ktx/.dds-file next to a texture if it exists (see asteroid_field_texconv)")
+			("programBinaries", value<bool>()->default_value(false), "Store the linked shader-programs in the cache-directory and load them instead of compiling the shaders (needs GL_ARB_get_program_binary)")
+			("uploadRing", value<bool>()->default_value(false), "Upload the trails, particles, ribbons and debug-boxes through a persistent-mapped, triple-buffered ring (needs GL_ARB_buffer_storage)")
+			("incrementalCompile", value<bool>()->default_value(true), "Compile the GL-objects of the scene, the pools and the reloaded objects over several frames before they are drawn (not for the videos)")
+			("compileBudget", value<double>()->default_value(4.0), "Time in ms per frame which is at least available for the incremental compilation (see --incrementalCompile)")
+			("logLevel", value<std::string>()->default_value("info"), "Lowest level of the written messages (debug, info, warning, error; debug needs a debug-build or cmake -DPBS17_LOG_LEVEL=0)")
+			("loadReport", value<std::string>(), "Write the times of the phases and of the assets of the start (until the first frame) into this json-file")
+			("profile", value<bool>()->default_value(true), "Measure the time of the phases of each frame (toggle the HUD with T)")
+			("profileCsv", value<std::string>(), "Write the time of the phases of each frame into this csv-file")
+			("traceFile", value<std::string>(), "Write the spans of the phases into this chrome-trace (needs -DPBS17_TRACING=ON)")
+			("record", value<std::string>(), "Record the trajectories and the contacts into this binary log")
+			("recordInterval", value<unsigned int>()->default_value(1), "Record the state of the bodies every n steps")
+			("recordQuantization", value<double>()->default_value(0.0), "Quantize the recorded positions to this resolution (0 => doubles)")
+			("checkpoint", value<std::string>(), "Write the complete state of the simulation into this binary scene with K (continue with --sceneBin)")
+			("checkpointInterval", value<double>()->default_value(0.0), "Also write the checkpoint every n seconds (0 => only with K)")
+			("replay", value<std::string>(), "Play the recorded log of the same scene back instead of simulating (seek with left/right, speed with up/down)")
+			("publish", value<unsigned int>(), "Stream the state of the bodies to remote viewers on this TCP-port (see --connect)")
+			("publishRate", value<double>()->default_value(60.0), "Maximal number of streamed frames per second")
+			("publishQuantization", value<double>()->default_value(0.001), "Resolution of the streamed positions")
+			("metrics", value<unsigned int>(), "Serve the counters of the simulation in the format of Prometheus on this TCP-port (http://host:port/metrics)")
+			("connect", value<std::string>(), "Render the state streamed by the simulation of the same scene (host:port, see --publish) instead of simulating")
+			("sceneJson,j", value<std::string>(), "Json file containing the scene")
+			("watchScene", value<bool>()->default_value(false), "Apply the changes of the json-scene (--sceneJson) to the running simulation whenever the file is saved")
+			("sceneBin,b", value<std::string>(), "Binary file containing the scene (see --convertScene)")
+			("convertScene", value<std::string>(), "Write the json-scene (--sceneJson) or the emitted scene into this binary file and exit")
+			("convertSectors", value<std::string>(), "Partition the asteroids of the scene (--sceneJson or --sceneBin) into sector-files in this existing directory and exit (load its scene.pbsc)")
+			("sectorSize", value<double>()->default_value(1000.0), "Edge-length of the sectors (see --convertSectors)")
+			("gravitySolver", value<std::string>(), "Gravity solver (direct, spatialGrid, barnesHut, particleMesh, gpu, fmm, gpuBarnesHut)")
+			("integrator", value<std::string>(), "Integrator (euler, leapfrog, velocityVerlet, yoshida, wisdomHolman, hermite)")
+			("blockTimesteps", value<bool>(), "Use hierarchical block-timesteps (power-of-two sub-steps per body)")
+			("theta", value<double>(), "Opening angle of the Barnes-Hut and the fast multipole solver")
+			("treeRefitThreshold", value<double>(), "Refit the Barnes-Hut tree until its cell-sizes grew by this factor (1 => rebuild each step)")
+			("symmetricForces", value<bool>(), "Evaluate each pair of the direct solver only once")
+			("reorderInterval", value<int>(), "Steps between two Morton-sorts of the bodies for the cache-locality (0 => never)")
+			("pipeline", value<bool>(), "Overlap the update of the AABBs and the preparation of the broad-phase per chunk of bodies")
+			("rewindInterval", value<int>(), "Steps between two keyframes to rewind the live simulation with R (0 => disabled)")
+			("rewindKeyframes", value<int>(), "Number of the kept keyframes to rewind (default 32)")
+			("diagnosticsInterval", value<int>(), "Steps between two measurements of the energy, the momentum and the angular momentum (0 => never)")
+			("mixedPrecision", value<bool>(), "Evaluate the pairs of the direct solver in single precision (summed in double precision)")
+			("groupedWalk", value<bool>(), "Traverse the Barnes-Hut tree once per group of nearby bodies with a shared interaction-list")
+			("taskGraph", value<bool>(), "Overlap the forces of the Barnes-Hut solver and the integration with a work-stealing task-graph")
+			("fusedKick", value<bool>(), "Kick (and drift) each chunk of bodies right after its forces in the same pass (direct and Barnes-Hut solver)")
+			("cutoffRadius", value<double>(), "Cut-off radius of the spatial-grid solver")
+			("testParticles", value<bool>(), "Let the spatial-grid solver treat the objects flagged as testParticle as massless for the other bodies")
+			("sourceTable", value<bool>(), "Interpolate the field of the far-reaching bodies of the spatial-grid solver from nested grids around them")
+			("sourceTableTolerance", value<double>(), "Movement of a source (in samples of its finest grid) after which the source-table is sampled again")
+			("broadPhase", value<std::string>(), "Broad-phase of the collision-detection (incremental, singleAxis, aabbTree, spatialHash, gpu)")
+			("deterministic", value<bool>(), "Get bitwise the same results with any number of threads (fixed summation- and contact-order)")
+			("fracture", value<bool>(), "Break the asteroids into their pre-fractured Voronoi-pieces on hard contacts")
+			("fractureVelocity", value<double>(), "Change of the velocity (impulse / mass) of a contact at which an asteroid breaks")
+			("merge", value<bool>(), "Merge the bodies of slow contacts into one body (accretion)")
+			("mergeVelocity", value<double>(), "Relative velocity below which two bodies merge (0 => their escape-velocity)")
+			("clusters", value<bool>(), "Fuse the objects which rest on each other into rigid clusters (their contacts are skipped)")
+			("clusterVelocity", value<double>(), "Relative velocity below which a contact is resting (see --clusters)")
+			("clusterSplitVelocity", value<double>(), "Velocity-change of a cluster by an external impulse above which it is split again (see --clusters)")
+			("lodRadius", value<double>(), "Radius around the camera outside of which the asteroids collide as spheres (0 => everywhere exact)")
+			("railsRadius", value<double>(), "Radius around the player (or the camera) outside of which the bodies follow their Kepler-orbits (0 => all integrated)")
+			("speculativeContacts", value<bool>(), "Give the approaching pairs which are still separated a contact with their closest points, so they stop before they penetrate")
+			("collisionSubsteps", value<int>(), "Collision-substeps per evaluation of the gravity (1 => none)")
+			("adaptiveDt", value<bool>(), "Select the time-step of each step from the accelerations and the approaching pairs (the simulation-step is the upper bound)")
+			("minDt", value<double>(), "Smallest adaptive time-step")
+			("dtAccuracy", value<double>(), "Fraction of the time-scales of the bodies and pairs for the adaptive time-step");
 
 
 		store(parse_command_line(argc, argv, desc), vm);
 		notify(vm);
 
+		pbs17::Logger::Level logLevel = pbs17::Logger::LEVEL_INFO;
+		if (!pbs17::Logger::parseLevel(vm["logLevel"].as<std::string>(), logLevel)) {
+			LOG_WARNING("Log-level (" + vm["logLevel"].as<std::string>() + ") not supported!");
+		}
+		pbs17::Logger::setLevel(logLevel);
+		pbs17::LoadProfiler::Instance()->start();
+
+		// only the physics-representation is needed without a viewer
+		pbs17::SpaceObject::setIsHeadless(vm["headless"].as<bool>() || vm.count("serve"));
+		pbs17::AssetCache::setIsEnabled(vm["assetCache"].as<bool>());
+		pbs17::ResourceCache::setBudget(static_cast<size_t>(vm["resourceBudget"].as<unsigned int>()) << 20);
+		pbs17::ObjReader::setIsEnabled(vm["fastObj"].as<bool>());
+		pbs17::ModelManager::setIsQuantized(vm["quantizedMeshes"].as<bool>());
+		pbs17::ConvexDecomposition::setIsEnabled(vm["convexDecomposition"].as<bool>());
+		pbs17::DistanceField::setIsEnabled(vm["distanceFields"].as<bool>());
+		pbs17::DistanceField::setResolution(vm["distanceFieldResolution"].as<int>());
+		// the bodies of the compute-shader are only drawn by the instanced models
+		pbs17::InstanceManager::setIsEnabled(vm["instancing"].as<bool>() || vm["gpuPhysics"].as<bool>());
+		if (vm["gpuCulling"].as<bool>() && !pbs17::InstanceCuller::isSupported()) {
+			LOG_WARNING("The indirect draws need OSG 3.6, the instances are culled on the CPU.");
+		}
+		pbs17::InstanceCuller::setIsEnabled(vm["gpuCulling"].as<bool>() && pbs17::InstanceCuller::isSupported());
+		pbs17::TrailSystem::setIsEnabled(vm["sharedTrails"].as<bool>());
+		pbs17::GpuParticleSystem::setIsEnabled(vm["gpuParticles"].as<bool>());
+		pbs17::DynamicResolution::setIsEnabled(vm["dynamicResolution"].as<double>() > 0.0);
+		if (pbs17::DynamicResolution::getIsEnabled()) {
+			pbs17::DynamicResolution::Instance()->setTargetGpuTime(vm["dynamicResolution"].as<double>() / 1000.0);
+			pbs17::DynamicResolution::Instance()->setMinScale(vm["minResolution"].as<double>());
+			pbs17::DynamicResolution::Instance()->setSharpness(static_cast<float>(vm["sharpness"].as<double>()));
+		}
+		// the instanced shaders are built with the stereo, so it's set before the scene is loaded
+		pbs17::StereoRenderer::setIsEnabled(vm["stereo"].as<bool>());
+		if (pbs17::StereoRenderer::getIsEnabled()) {
+			if (pbs17::DynamicResolution::getIsEnabled()) {
+				LOG_WARNING("The stereo-rendering has its own offscreen-target, the dynamic resolution is disabled.");
+				pbs17::DynamicResolution::setIsEnabled(false);
+			}
+			pbs17::StereoRenderer::Instance()->setEyeSeparation(vm["eyeSeparation"].as<double>());
+			pbs17::StereoRenderer::Instance()->setFusionDistance(vm["fusionDistance"].as<double>());
+		}
+		// the bodies of the compute-shader do not write their transformations
+		if (vm["densitySplat"].as<bool>() && vm["gpuPhysics"].as<bool>()) {
+			LOG_WARNING("The density-splats need the bodies on the CPU, the models are drawn.");
+		}
+		if (vm.count("offscreen")) {
+			int width = 0, height = 0;
+			if (pbs17::OffscreenContext::parseSize(vm["offscreen"].as<std::string>(), width, height)) {
+				pbs17::OffscreenContext::setSize(width, height);
+			} else {
+				LOG_WARNING("Size (" + vm["offscreen"].as<std::string>() + ") is not of the form widthxheight!");
+			}
+		}
+		pbs17::DensitySplat::setIsEnabled(vm["densitySplat"].as<bool>() && !vm["gpuPhysics"].as<bool>());
+		pbs17::DensitySplat::Instance()->setResolution(vm["splatResolution"].as<double>());
+		pbs17::DensitySplat::Instance()->setExposure(static_cast<float>(vm["splatExposure"].as<double>()));
+
+		pbs17::SunShader::NoiseMode sunNoise = pbs17::SunShader::NOISE_OFF;
+		if (!pbs17::SunShader::parseNoiseMode(vm["sunNoise"].as<std::string>(), sunNoise)) {
+			LOG_WARNING("Sun-noise (" + vm["sunNoise"].as<std::string>() + ") not supported!");
+		}
+		pbs17::SunShader::setNoiseMode(sunNoise);
+		pbs17::SpatialCells::setIsEnabled(vm["spatialCells"].as<bool>());
+		pbs17::SpaceObject::setIsLazyNodes(vm["lazyNodes"].as<bool>());
+		pbs17::ImageManager::setUsePrebaked(vm["prebakedTextures"].as<bool>());
+		pbs17::TextureStreamer::setIsEnabled(vm["streamTextures"].as<bool>());
+		pbs17::MipStreamer::setIsEnabled(vm["mipStreaming"].as<bool>());
+		pbs17::MipStreamer::setBudget(vm["mipBudget"].as<unsigned int>());
+		pbs17::ProgramBinaryCache::setIsEnabled(vm["programBinaries"].as<bool>());
+		pbs17::UploadRing::setIsEnabled(vm["uploadRing"].as<bool>());
+		pbs17::NumaPolicy::setIsPinned(vm["pinThreads"].as<bool>());
+		pbs17::NumaPolicy::setRenderCpus(vm["renderCpus"].as<int>());
+		pbs17::NumaPolicy::setUseHugePages(vm["hugePages"].as<bool>());
+		pbs17::ThreadBudget::setNumCores(vm["threads"].as<int>());
+		pbs17::ThreadBudget::setRenderThreads(vm["renderCpus"].as<int>());
+		pbs17::ThreadBudget::setBackgroundThreads(vm["backgroundThreads"].as<int>());
+		pbs17::JobSystem::setIsEnabled(vm["jobs"].as<bool>());
+		pbs17::JobSystem::setBudget(vm["jobBudget"].as<double>());
+		// the pages of the bodies are touched by the same team of threads which integrates them, the server loads the
+		// scene single-threaded and each forked run starts its own team
+		if (vm.count("serve")) {
+			pbs17::RunServer::prepareParent();
+		} else {
+			pbs17::NumaPolicy::pinWorkers();
+		}
+		pbs17::Profiler::setIsEnabled(vm["profile"].as<bool>() || vm.count("profileCsv") || vm.count("metrics") || vm["targetFps"].as<double>() > 0.0);
+
+		if (vm.count("profileCsv") && !pbs17::Profiler::Instance()->openCsv(vm["profileCsv"].as<std::string>())) {
+			LOG_WARNING("File " + vm["profileCsv"].as<std::string>() + " can't be written!");
+		}
+
+		if (vm.count("traceFile")) {
+#if defined(PBS17_TRACING)
+			pbs17::Tracer::Instance()->open(vm["traceFile"].as<std::string>());
+#else
+			LOG_WARNING("The tracing is not compiled in (cmake -DPBS17_TRACING=ON).");
+#endif
+		}
+
 		if (vm.count("help")) {
 			std::cout << desc << '\n';
 			return 0;
+		} else if (vm.count("stitch")) {
+			std::vector<std::string> segments = vm.count("segments") ? vm["segments"].as<std::vector<std::string>>() : std::vector<std::string>();
+			return pbs17::FrameWriterThread::concatenate(segments, vm["stitch"].as<std::string>()) ? 0 : 1;
+		} else if (vm.count("sceneBin")) {
+			const std::string binFilePath = vm["sceneBin"].as<std::string>();
+
+			// the columns of the file are read at once
+			pbs17::BinaryScene binaryScene;
+			bool isLoaded;
+			{
+				pbs17::LoadProfiler::ScopedTimer timer(pbs17::LoadProfiler::SCENE_FILE);
+				isLoaded = binaryScene.load(binFilePath) || binaryScene.load(SCENES_PATH + "/" + binFilePath);
+			}
+			if (!isLoaded) {
+				LOG_WARNING("File " + binFilePath + " doesnt exists or is not a binary scene!");
+				return 0;
+			}
+
+			if (vm.count("convertSectors")) {
+				int cntSectors = pbs17::SectorManager::writeSectors(binaryScene, vm["convertSectors"].as<std::string>(), vm["sectorSize"].as<double>());
+				LOG_INFO("partitioned the scene into " << cntSectors << " sectors");
+				return 0;
+			}
+
+			LOG_INFO("load scene with binary file: " << binFilePath);
+			scene = sceneManager->loadScene(binaryScene);
+			checkpointScene = binaryScene;
 		} else if (vm.count("sceneJson")) {
 			const std::string jsonFilePath = vm["sceneJson"].as<std::string>();
 
 			// check if file exists
 			std::ifstream stream(jsonFilePath);
+			sceneJsonPath = jsonFilePath;
 			if (!stream) {
 				stream = std::ifstream(SCENES_PATH + "/" + jsonFilePath);
+				sceneJsonPath = SCENES_PATH + "/" + jsonFilePath;
 
 				if (!stream) {
-					std::cout << "File " + jsonFilePath + " doesnt exists!" << std::endl;
+					LOG_WARNING("File " + jsonFilePath + " doesnt exists!");
 					return 0;
 				}
 			}
 
-			// read json files
-			json j;
-			stream >> j;
+			if (vm.count("convertScene")) {
+				const std::string binFilePath = vm["convertScene"].as<std::string>();
+
+				json j;
+				stream >> j;
 
-			// load scene with json file
-			std::cout << "load scene with json: " << jsonFilePath << '\n';
-			scene = sceneManager->loadScene(j);
+				pbs17::BinaryScene binaryScene;
+				if (binaryScene.fromJson(j) && binaryScene.save(binFilePath)) {
+					LOG_INFO("converted scene with " << binaryScene.getNumBodies() << " objects into: " << binFilePath);
+				} else {
+					LOG_WARNING("Scene can't be converted into " + binFilePath + "!");
+				}
+
+				return 0;
+			} else if (vm.count("convertSectors")) {
+				json j;
+				stream >> j;
+
+				pbs17::BinaryScene binaryScene;
+				int cntSectors = binaryScene.fromJson(j)
+					? pbs17::SectorManager::writeSectors(binaryScene, vm["convertSectors"].as<std::string>(), vm["sectorSize"].as<double>()) : -1;
+				LOG_INFO("partitioned the scene into " << cntSectors << " sectors");
+				return 0;
+			}
+
+			// load scene with json file (the objects are constructed while the file is parsed)
+			LOG_INFO("load scene with json: " << jsonFilePath);
+			scene = sceneManager->loadScene(stream, vm.count("checkpoint") ? &checkpointScene : nullptr);
+		} else if (vm.count("convertScene")) {
+			const std::string binFilePath = vm["convertScene"].as<std::string>();
+
+			pbs17::BinaryScene binaryScene;
+			if (pbs17::SceneGenerator::generate(vm, binaryScene) && binaryScene.save(binFilePath)) {
+				LOG_INFO("emitted scene with " << binaryScene.getNumBodies() << " objects into: " << binFilePath);
+			} else {
+				LOG_WARNING("Scene can't be emitted into " + binFilePath + "!");
+			}
+
+			return 0;
 		} else {
 			// load scene with parameters
-			std::cout << "load scene with parameters" << '\n';
-			scene = sceneManager->loadScene(vm);
+			LOG_INFO("load scene with parameters");
+
+			if (vm.count("checkpoint")) {
+				pbs17::SceneGenerator::generate(vm, checkpointScene);
+				scene = sceneManager->loadScene(checkpointScene);
+			} else {
+				scene = sceneManager->loadScene(vm);
+			}
 		}
 	}
 	catch (const error &ex) {
-		std::cerr << ex.what() << '\n';
+		LOG_ERROR(ex.what());
+	}
+
+
+
+
+
+
+	// settings of the scene can be overwritten by the command-line
+	json simulationSettings = sceneManager->getSimulationSettings();
+	if (vm.count("gravitySolver")) {
+		simulationSettings["gravitySolver"] = vm["gravitySolver"].as<std::string>();
+	}
+	if (vm.count("integrator")) {
+		simulationSettings["integrator"] = vm["integrator"].as<std::string>();
+	}
+	if (vm.count("blockTimesteps")) {
+		simulationSettings["blockTimesteps"] = vm["blockTimesteps"].as<bool>();
+	}
+	if (vm.count("theta")) {
+		simulationSettings["theta"] = vm["theta"].as<double>();
+	}
+	if (vm.count("treeRefitThreshold")) {
+		simulationSettings["treeRefitThreshold"] = vm["treeRefitThreshold"].as<double>();
+	}
+	if (vm.count("symmetricForces")) {
+		simulationSettings["symmetricForces"] = vm["symmetricForces"].as<bool>();
+	}
+	if (vm.count("mixedPrecision")) {
+		simulationSettings["mixedPrecision"] = vm["mixedPrecision"].as<bool>();
+	}
+	if (vm.count("groupedWalk")) {
+		simulationSettings["groupedWalk"] = vm["groupedWalk"].as<bool>();
+	}
+	if (vm.count("taskGraph")) {
+		simulationSettings["taskGraph"] = vm["taskGraph"].as<bool>();
+	}
+	if (vm.count("fusedKick")) {
+		simulationSettings["fusedKick"] = vm["fusedKick"].as<bool>();
+	}
+	if (vm.count("reorderInterval")) {
+		simulationSettings["reorderInterval"] = vm["reorderInterval"].as<int>();
+	}
+	if (vm.count("pipeline")) {
+		simulationSettings["pipeline"] = vm["pipeline"].as<bool>();
+	}
+	if (vm.count("rewindInterval")) {
+		simulationSettings["rewindInterval"] = vm["rewindInterval"].as<int>();
+	}
+	if (vm.count("rewindKeyframes")) {
+		simulationSettings["rewindKeyframes"] = vm["rewindKeyframes"].as<int>();
+	}
+	// the dust of the scene collides (no dust => nothing to collide)
+	if (vm.count("dustCollisions") && simulationSettings["dust"].is_object()) {
+		simulationSettings["dust"]["collisions"] = vm["dustCollisions"].as<bool>();
+	}
+	if (vm.count("dustRestitution") && simulationSettings["dust"].is_object()) {
+		simulationSettings["dust"]["restitution"] = vm["dustRestitution"].as<double>();
+	}
+	if (vm.count("diagnosticsInterval")) {
+		simulationSettings["diagnosticsInterval"] = vm["diagnosticsInterval"].as<int>();
+	}
+	if (vm.count("cutoffRadius")) {
+		simulationSettings["cutoffRadius"] = vm["cutoffRadius"].as<double>();
+	}
+	if (vm.count("testParticles")) {
+		simulationSettings["testParticles"] = vm["testParticles"].as<bool>();
+	}
+	if (vm.count("sourceTable")) {
+		simulationSettings["sourceTable"] = vm["sourceTable"].as<bool>();
+	}
+	if (vm.count("sourceTableTolerance")) {
+		simulationSettings["sourceTableTolerance"] = vm["sourceTableTolerance"].as<double>();
+	}
+	if (vm.count("broadPhase")) {
+		simulationSettings["broadPhase"] = vm["broadPhase"].as<std::string>();
 	}
+	if (vm.count("deterministic")) {
+		simulationSettings["deterministic"] = vm["deterministic"].as<bool>();
+	}
+	if (vm.count("fracture")) {
+		simulationSettings["fracture"] = vm["fracture"].as<bool>();
+	}
+	if (vm.count("fractureVelocity")) {
+		simulationSettings["fractureVelocity"] = vm["fractureVelocity"].as<double>();
+	}
+	if (vm.count("merge")) {
+		simulationSettings["merge"] = vm["merge"].as<bool>();
+	}
+	if (vm.count("lodRadius")) {
+		simulationSettings["lodRadius"] = vm["lodRadius"].as<double>();
+	}
+	if (vm.count("railsRadius")) {
+		simulationSettings["railsRadius"] = vm["railsRadius"].as<double>();
+	}
+	if (vm.count("speculativeContacts")) {
+		simulationSettings["speculativeContacts"] = vm["speculativeContacts"].as<bool>();
+	}
+	if (vm.count("collisionSubsteps")) {
+		simulationSettings["collisionSubsteps"] = vm["collisionSubsteps"].as<int>();
+	}
+	if (vm.count("adaptiveDt")) {
+		simulationSettings["adaptiveDt"] = vm["adaptiveDt"].as<bool>();
+	}
+	if (vm.count("minDt")) {
+		simulationSettings["minDt"] = vm["minDt"].as<double>();
+	}
+	if (vm.count("dtAccuracy")) {
+		simulationSettings["dtAccuracy"] = vm["dtAccuracy"].as<double>();
+	}
+	if (vm.count("mergeVelocity")) {
+		simulationSettings["mergeVelocity"] = vm["mergeVelocity"].as<double>();
+	}
+	if (vm.count("clusters")) {
+		simulationSettings["clusters"] = vm["clusters"].as<bool>();
+	}
+	if (vm.count("clusterVelocity")) {
+		simulationSettings["clusterVelocity"] = vm["clusterVelocity"].as<double>();
+	}
+	if (vm.count("clusterSplitVelocity")) {
+		simulationSettings["clusterSplitVelocity"] = vm["clusterSplitVelocity"].as<double>();
+	}
+	if (vm.count("rebalanceInterval")) {
+		simulationSettings["rebalanceInterval"] = vm["rebalanceInterval"].as<int>();
+	}
+
+	// each rank integrates the bodies of its domain, without recording or checkpoints
+	if (pbs17::SpaceObject::getIsHeadless() && vm["mpi"].as<bool>()) {
+		if (!pbs17::DistributedSimulation::isEnabled()) {
+			LOG_WARNING("MPI is not compiled in (cmake -DPBS17_MPI=ON), the simulation runs on a single rank.");
+		}
 
+		simulateDistributed(sceneManager->getSpaceObjects(), simulationSettings, vm["steps"].as<int>());
+		delete sceneManager;
 
+		return 0;
+	}
+
+	// each parameter-set is simulated by a fork of the loaded scene, which shares its models and hulls copy-on-write
+	if (vm.count("serve")) {
+		if (!pbs17::RunServer::isSupported()) {
+			LOG_ERROR("The runs can only be forked on POSIX-systems!");
+			delete sceneManager;
+			return 1;
+		}
+		writeLoadReport(vm);
+
+		pbs17::RunServer server(static_cast<unsigned short>(vm["serve"].as<unsigned int>()), vm["maxRuns"].as<unsigned int>(),
+			[&](const json &request) {
+				json settings = simulationSettings;
+				if (request.count("settings")) {
+					for (json::const_iterator it = request["settings"].begin(); it != request["settings"].end(); ++it) {
+						settings[it.key()] = it.value();
+					}
+				}
+
+				pbs17::SimulationManager* simulationManager = new pbs17::SimulationManager(sceneManager->getSpaceObjects(), settings);
+				if (checkpointScene.hasState()) {
+					simulationManager->restoreCheckpoint(checkpointScene);
+				}
+
+				pbs17::TrajectoryRecorder* recorder = nullptr;
+				if (request.count("record")) {
+					recorder = new pbs17::TrajectoryRecorder(request["record"].get<std::string>(),
+						request.value("recordInterval", vm["recordInterval"].as<unsigned int>()), vm["recordQuantization"].as<double>());
+					recorder->start();
+					simulationManager->setRecorder(recorder);
+				}
 
+				simulateHeadless(simulationManager, request.value("steps", vm["steps"].as<int>()));
+				closeRecorder(recorder);
 
+				return 0;
+			});
 
+		int code = server.isListening() ? server.serve() : 1;
+		delete sceneManager;
+
+		return code;
+	}
+
+	pbs17::SimulationManager* simulationManager;
+	{
+		pbs17::LoadProfiler::ScopedTimer timer(pbs17::LoadProfiler::SIMULATION);
+		simulationManager = new pbs17::SimulationManager(sceneManager->getSpaceObjects(), simulationSettings);
+	}
+	simulationManager->setFastForwardBudget(vm["fastForwardBudget"].as<double>() / 1000.0);
+
+	// a checkpoint continues where it was written, only the acceleration-structures are rebuilt
+	if (checkpointScene.hasState()) {
+		simulationManager->restoreCheckpoint(checkpointScene);
+	}
+	if (vm.count("checkpoint")) {
+		simulationManager->setCheckpoint(checkpointScene, vm["checkpoint"].as<std::string>(), vm["checkpointInterval"].as<double>());
+	}
+
+	// the trajectories are written by their own thread
+	pbs17::TrajectoryRecorder* recorder = nullptr;
+	if (vm.count("record")) {
+		recorder = new pbs17::TrajectoryRecorder(vm["record"].as<std::string>(), vm["recordInterval"].as<unsigned int>(),
+			vm["recordQuantization"].as<double>());
+		recorder->start();
+		simulationManager->setRecorder(recorder);
+	}
+
+	// the state is sent to the remote viewers by its own thread
+	pbs17::StatePublisher* publisher = nullptr;
+	if (vm.count("publish")) {
+		publisher = new pbs17::StatePublisher(static_cast<unsigned short>(vm["publish"].as<unsigned int>()),
+			vm["publishQuantization"].as<double>(), vm["publishRate"].as<double>());
+		publisher->start();
+		simulationManager->setPublisher(publisher);
+	}
+
+	// the counters are served to the monitoring by their own thread
+	pbs17::MetricsExporter* metrics = nullptr;
+	if (vm.count("metrics")) {
+		metrics = new pbs17::MetricsExporter(static_cast<unsigned short>(vm["metrics"].as<unsigned int>()));
+		metrics->start();
+		simulationManager->setMetrics(metrics);
+	}
+
+	// batch-mode: simulate the steps as fast as possible without rendering
+	if (pbs17::SpaceObject::getIsHeadless()) {
+		writeLoadReport(vm);
+		if (vm["parareal"].as<int>() > 0) {
+			simulateParareal(simulationManager, simulationSettings, vm["steps"].as<int>(), vm);
+		} else {
+			simulateHeadless(simulationManager, vm["steps"].as<int>());
+		}
+
+		pbs17::Profiler::Instance()->closeCsv();
+		pbs17::Tracer::Instance()->close();
+		closeRecorder(recorder);
+		delete publisher;
+		delete metrics;
+
+		delete sceneManager;
+		delete simulationManager;
+
+		return 0;
+	}
+
+	// the pooled fragments are hidden until their asteroids break
+	if (simulationManager->getFragmentRoot().valid()) {
+		scene->asGroup()->addChild(simulationManager->getFragmentRoot());
+	}
+
+	// the pooled asteroids of the sectors are hidden until their sectors are loaded
+	if (simulationManager->getSectorRoot().valid()) {
+		scene->asGroup()->addChild(simulationManager->getSectorRoot());
+	}
+
+	// the dust is drawn as one geometry of point-sprites, which is refreshed from the snapshots of the steps
+	if (simulationManager->getDustRoot().valid()) {
+		scene->asGroup()->addChild(simulationManager->getDustRoot());
+	}
 
-    //osg::ref_ptr<osg::Node> scene = sceneManager->loadScene();
-	osg::ref_ptr<osgViewer::Viewer> viewer = sceneManager->initViewer(scene);
+	osg::ref_ptr<osgViewer::Viewer> viewer = sceneManager->initViewer(scene, simulationManager);
+	// the scene-graph is only changed by the update-traversal, so the cull- and draw-traversal can overlap with the next frame
+	osgViewer::ViewerBase::ThreadingModel threadingModel = osgViewer::ViewerBase::SingleThreaded;
+	if (!pbs17::SceneManager::parseThreadingModel(vm["threadingModel"].as<std::string>(), threadingModel)) {
+		LOG_WARNING("Threading-model (" + vm["threadingModel"].as<std::string>() + ") not supported!");
+	}
+	viewer->setThreadingModel(threadingModel);
+	// the levels of detail are selected by their size on the screen, divided by the LOD-scale
+	viewer->getCamera()->setLODScale(1.0 / vm["lodQuality"].as<double>());
 	osg::StateSet* state = scene->getOrCreateStateSet();
 	state->setMode(GL_LIGHTING, osg::StateAttribute::ON);
 	state->setMode(GL_LIGHT0, osg::StateAttribute::ON);
 
 
-	// Set-up the screenshot functionality
-	osg::ref_ptr<pbs17::SnapImageDrawCallback> screenshotCallback = new pbs17::SnapImageDrawCallback();
+	// Set-up the screenshot functionality (the frames are encoded and written by their own thread)
+	std::string videoFile = vm.count("videoFile") ? vm["videoFile"].as<std::string>() : "";
+	double videoFps = vm["videoFps"].as<double>();
+	bool captureFrame = vm["saveFrames"].as<bool>() || videoFile != "";
+	if (pbs17::OffscreenContext::getIsEnabled() && !captureFrame) {
+		LOG_WARNING("The offscreen-frames are not saved (see --saveFrames and --videoFile).");
+	}
+	pbs17::FrameWriterThread* frameWriter = nullptr;
+	if (captureFrame) {
+		frameWriter = new pbs17::FrameWriterThread(vm["frameQueue"].as<unsigned int>(), vm["dropFrames"].as<bool>(), videoFile, videoFps);
+		frameWriter->start();
+	}
+
+	osg::ref_ptr<pbs17::SnapImageDrawCallback> screenshotCallback = new pbs17::SnapImageDrawCallback(frameWriter);
 	viewer->getCamera()->setPostDrawCallback(screenshotCallback.get());
 
-	pbs17::SimulationManager* simulationManager = new pbs17::SimulationManager(sceneManager->getSpaceObjects());
+
+	// the replay drives the matrix-transformations directly from the log, the physics is not stepped
+	bool isReplay = false;
+	if (vm.count("replay")) {
+		isReplay = pbs17::TrajectoryPlayer::Instance()->load(vm["replay"].as<std::string>(), sceneManager->getSpaceObjects());
+
+		if (isReplay) {
+			scene->addUpdateCallback(new pbs17::ReplayUpdateCallback);
+		} else {
+			LOG_WARNING("File " + vm["replay"].as<std::string>() + " doesnt exists or is not a trajectory-log!");
+		}
+	}
+
+	// a worker of a render-farm starts at the key-frame of its range, the frames keep their numbers of the whole video
+	long maxFrames = vm["maxFrames"].as<long>();
+	long frameOffset = 0;
+	bool isFrameRange = false;
+	if (vm.count("frameRange") && isReplay) {
+		long start = 0, end = 0;
+		int cntParsed = std::sscanf(vm["frameRange"].as<std::string>().c_str(), "%ld:%ld", &start, &end);
+		if (cntParsed < 1 || start < 0) {
+			LOG_WARNING("Range (" + vm["frameRange"].as<std::string>() + ") is not of the form start:end!");
+		} else {
+			long cntFrames = static_cast<long>(pbs17::TrajectoryPlayer::Instance()->getDuration() * videoFps) + 1;
+			end = cntParsed == 2 ? std::min(end, cntFrames) : cntFrames;
+
+			isFrameRange = true;
+			frameOffset = start;
+			maxFrames = std::max(end - start, 1L);
+			pbs17::TrajectoryPlayer::Instance()->seekTime(start / videoFps);
+			LOG_INFO("Rendering the frames " << start << " to " << end << " of " << cntFrames);
+		}
+	} else if (vm.count("frameRange")) {
+		LOG_WARNING("The range of frames needs a replay (see --replay).");
+	}
+
+	// the viewer of a remote simulation renders the streamed state, the physics is not stepped
+	bool isRemote = false;
+	pbs17::StateSubscriber* subscriber = nullptr;
+	if (vm.count("connect") && !isReplay) {
+		std::string host;
+		unsigned short port;
+
+		if (pbs17::StateSubscriber::parseAddress(vm["connect"].as<std::string>(), host, port)) {
+			subscriber = new pbs17::StateSubscriber(host, port, simulationManager->getSpaceObjects());
+			subscriber->start();
+			scene->addUpdateCallback(new pbs17::StreamUpdateCallback(subscriber));
+			isRemote = true;
+		} else {
+			LOG_WARNING("Address " + vm["connect"].as<std::string>() + " is not of the form host:port!");
+		}
+	}
+
+	// the bodies stay on the GPU, the simulation-manager is not stepped anymore
+	osg::ref_ptr<pbs17::ComputeGravity> computeGravity = nullptr;
+	if (vm["gpuPhysics"].as<bool>() && !isReplay && !isRemote) {
+		if (pbs17::ComputeGravity::isSupported()) {
+			computeGravity = new pbs17::ComputeGravity(sceneManager->getSpaceObjects());
+			scene->asGroup()->addChild(computeGravity);
+		} else {
+			LOG_WARNING("The compute-shaders need OSG 3.4, the bodies are simulated on the CPU.");
+		}
+	}
+
+	// the video, the replay and the stream need every frame
+	pbs17::IdleRenderer::setIsEnabled(vm["idleWhenPaused"].as<bool>() && videoFile == "" && !isFrameRange && !isReplay && !isRemote);
+	pbs17::IdleRenderer idleRenderer(viewer.get(), simulationManager);
+
+	// the sub-graphs of the scene (with the hidden pools) are attached once their GL-objects are compiled, the
+	// frames of the videos have to show the whole scene
+	pbs17::IncrementalCompiler::setIsEnabled(vm["incrementalCompile"].as<bool>() && videoFile == "" && !isFrameRange);
+	pbs17::IncrementalCompiler::setBudget(vm["compileBudget"].as<double>());
+	pbs17::IncrementalCompiler::Instance()->attach(viewer.get());
+	pbs17::IncrementalCompiler::Instance()->addChildren(scene->asGroup());
+
+	// rendering and simulation overlap, the scene is updated from the snapshots of the physics-thread
+	pbs17::PhysicsThread* physicsThread = nullptr;
+	if (isReplay || isRemote || computeGravity.valid()) {
+		// nothing is simulated on the CPU
+	} else if (vm["physicsThread"].as<bool>() && videoFile != "") {
+		// the video needs exactly one step per frame, independent of the wall-clock
+		LOG_WARNING("The physics-thread is not used for the video.");
+	} else if (vm["physicsThread"].as<bool>()) {
+		physicsThread = new pbs17::PhysicsThread(simulationManager, vm["physicsRate"].as<double>());
+		scene->addUpdateCallback(new pbs17::PhysicsUpdateCallback(physicsThread));
+		physicsThread->start();
+		pbs17::NumaPolicy::pinRenderThread();
+		pbs17::ThreadBudget::enterThread(pbs17::ThreadBudget::RENDER);
+	} else {
+		// the main-loop simulates, its team is the critical path
+		pbs17::ThreadBudget::enterThread(pbs17::ThreadBudget::CRITICAL);
+	}
+
+	// the steps of the main-loop are written to the nodes by the update-traversal of the next frame
+	if (physicsThread == nullptr && !isReplay && !isRemote && !computeGravity.valid()) {
+		scene->addUpdateCallback(new pbs17::SceneSyncCallback(simulationManager));
+	}
+
+	// the edits of the json-scene are applied between two steps, the models of the added objects come from the caches
+	if (vm["watchScene"].as<bool>() && sceneJsonPath != "" && !isReplay && !isRemote && !computeGravity.valid()) {
+		osg::ref_ptr<pbs17::SceneReloadCallback> reloadCallback = new pbs17::SceneReloadCallback(sceneJsonPath, sceneManager, simulationManager);
+		scene->asGroup()->addChild(reloadCallback->getRoot());
+		scene->addUpdateCallback(reloadCallback);
+	}
+
+	// the video is rendered with its own clock, so its fidelity is not traded for the frame-time
+	pbs17::FrameGovernor* governor = nullptr;
+	if (vm["targetFps"].as<double>() > 0.0 && videoFile == "") {
+		pbs17::FrameGovernor::Limits limits;
+		limits.maxTheta = vm["governorMaxTheta"].as<double>();
+		limits.minSubsteps = vm["governorMinSubsteps"].as<int>();
+		limits.maxLodScale = vm["governorMaxLodScale"].as<double>();
+		limits.minParticleRate = vm["governorMinParticles"].as<double>();
+		limits.minTrailLength = vm["governorMinTrails"].as<double>();
+		governor = new pbs17::FrameGovernor(viewer->getCamera(), simulationManager, 1.0 / vm["targetFps"].as<double>(), limits);
+	}
 
 	double startTime = 0.0;
-    bool captureFrame = vm["saveFrames"].as<bool>();
+	bool isFirstFrame = true;
 
 
 	while (!viewer->done()) {
 
-        viewer->frame();
+		// a paused and static scene is not drawn again, the time of the sleep is not part of the next frame
+		if (!idleRenderer.needsFrame()) {
+			idleRenderer.wait();
+			startTime = viewer->elapsedTime();
+			continue;
+		}
+
+		// the video is rendered with its own clock, so it can be faster or slower than the real time
+		{
+			TRACE_SCOPE("render");
+			osg::Timer_t frameStart = osg::Timer::instance()->tick();
+
+			if (videoFile != "" || isFrameRange) {
+				viewer->frame(viewer->getFrameStamp()->getFrameNumber() / videoFps);
+			} else if (physicsThread != nullptr && sceneManager->getPlayer() != nullptr && !isFirstFrame) {
+				// late-latching: the player and the camera which tracks it use the newest snapshot just before the
+				// cull-traversal, so the camera does not lag the ship by a snapshot (the first frame realizes the viewer)
+				viewer->advance();
+				viewer->eventTraversal();
+				viewer->updateTraversal();
+
+				physicsThread->latchObject(sceneManager->getPlayer());
+				if (viewer->getCameraManipulator()) {
+					viewer->getCameraManipulator()->updateCamera(*viewer->getCamera());
+				}
+
+				viewer->renderingTraversals();
+			} else {
+				viewer->frame();
+			}
+
+			// the first frame compiles the shaders and uploads the textures and buffers
+			if (isFirstFrame) {
+				double firstFrame = osg::Timer::instance()->delta_s(frameStart, osg::Timer::instance()->tick());
+				pbs17::LoadProfiler::Instance()->add(pbs17::LoadProfiler::FIRST_FRAME, "", firstFrame);
+				LOG_INFO("First frame (shaders, uploads) in " << firstFrame << " s");
+				writeLoadReport(vm);
+			}
+
+			isFirstFrame = false;
+			idleRenderer.frameDrawn();
+		}
+
+		// the exact collisions follow the camera
+		{
+			osg::Vec3d eye, center, up;
+			viewer->getCamera()->getViewMatrixAsLookAt(eye, center, up);
+			simulationManager->setFocus(Eigen::Vector3d(eye.x(), eye.y(), eye.z()));
+		}
 
 		long frameNumber = viewer->getFrameStamp()->getFrameNumber();
+		// the readback of a frame is finished by the next one, so one more frame is drawn
+		if (maxFrames > 0 && frameNumber >= maxFrames) {
+			viewer->setDone(true);
+		}
 		double currentTime = viewer->elapsedTime();
 		double dt = currentTime - startTime;
-		std::cout << "Frame: " << frameNumber << "\tdt: " << dt << "\tfps: " << 1.0 / dt << std::endl;
+		// flushing the output each frame would be a measurable part of the frame
+		LOG_DEBUG("Frame: " << frameNumber << "\tdt: " << dt << "\tfps: " << 1.0 / dt);
 
         if(captureFrame) {
-            std::string screenCaptureFilename =  std::to_string(frameNumber) + "_frame.png";
+            std::string screenCaptureFilename =  std::to_string(frameOffset + frameNumber) + "_frame.png";
 			osg::ref_ptr<pbs17::SnapImageDrawCallback> snapImageDrawCallback = dynamic_cast<pbs17::SnapImageDrawCallback*>(viewer->getCamera()->getPostDrawCallback());
 			
         	if (snapImageDrawCallback.get()) {
-				std::cout << "make screenshot" << std::endl;
+				LOG_INFO("make screenshot");
 				snapImageDrawCallback->setFileName(screenCaptureFilename);
 				snapImageDrawCallback->setSnapImageOnNextFrame(true);
 			}
         }
 
-		dt = pbs17::SimulationManager::getSimulationDt();
-		simulationManager->simulate(dt);
+		if (computeGravity.valid()) {
+			// one step per frame is dispatched before the next frame is drawn
+			computeGravity->setDt(simulationManager->getIsPaused() ? 0.0 : simulationManager->getSimulationDt());
+		} else if (physicsThread == nullptr && !isReplay && !isRemote && videoFile == "" && simulationManager->getIsFastForward()) {
+			// fast-forward (F): the steps fill the budget of the frame, the newest state is shown
+			simulationManager->fastForward(simulationManager->getFastForwardBudget());
+		} else if (physicsThread == nullptr && !isReplay && !isRemote && videoFile == "" && vm["maxSubsteps"].as<int>() > 0) {
+			// the steps follow the wall-clock, the frames in between are interpolated by the sync
+			simulationManager->advance(dt, 1.0 / std::max(vm["physicsRate"].as<double>(), 1.0), vm["maxSubsteps"].as<int>());
+		} else if (physicsThread == nullptr && !isReplay && !isRemote) {
+			dt = simulationManager->getSimulationDt();
+			simulationManager->step(dt);
+		}
 
+		pbs17::MemoryTracker::count();
+		pbs17::JobSystem::Instance()->beginFrame();
+		pbs17::Profiler::Instance()->endFrame(currentTime - startTime);
+		if (governor) {
+			governor->update(currentTime - startTime);
+		}
 		startTime = currentTime;
 
 	}
 
+	delete governor;
+	delete physicsThread;
+	delete publisher;
+	delete metrics;
+	delete subscriber;
+	pbs17::Profiler::Instance()->closeCsv();
+	pbs17::Tracer::Instance()->close();
+	closeRecorder(recorder);
+
+	// the queued frames are written before the writer stops
+	if (frameWriter) {
+		if (frameWriter->getNumDropped() > 0) {
+			LOG_WARNING("Dropped frames: " << frameWriter->getNumDropped());
+		}
+		delete frameWriter;
+	}
+
 	delete sceneManager;
 	delete simulationManager;
 
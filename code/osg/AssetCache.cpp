@@ -0,0 +1,445 @@
+﻿/**
+ * \brief Functionality for caching the prepared assets on the disk, so they are only prepared once.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-18
+ */
+
+#include "AssetCache.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+
+#include <osgDB/ReadFile>
+#include <osgDB/WriteFile>
+#include <osgDB/FileUtils>
+
+#include "../config.h"
+#include "../graphics/ConvexHull3D.h"
+#include "../graphics/DistanceField.h"
+#include "Loader.h"
+#include "LoadProfiler.h"
+
+using namespace pbs17;
+
+
+//! True if the cache-directory is used
+bool AssetCache::IS_ENABLED = true;
+
+//! Identifier at the beginning of the shape-files ("PBSH")
+const unsigned int AssetCache::SHAPE_MAGIC = 0x48534250;
+//! Version of the shape-files (increase if the format or the preparation changes)
+const unsigned int AssetCache::SHAPE_VERSION = 3;
+//! Version of the model-files (increase if the preparation changes)
+const unsigned int AssetCache::MODEL_VERSION = 2;
+
+
+namespace {
+
+	/**
+	 * \brief Write an array of values in the binary representation.
+	 */
+	template<typename T>
+	void writeValues(std::ofstream &stream, const T *values, unsigned int count) {
+		stream.write(reinterpret_cast<const char*>(values), sizeof(T) * count);
+	}
+
+
+	/**
+	 * \brief Reads the values of a file which is completely read into the memory.
+	 */
+	struct BufferReader {
+		const std::vector<char> &buffer;
+		size_t position;
+
+		explicit BufferReader(const std::vector<char> &buffer) : buffer(buffer), position(0) {}
+
+		template<typename T>
+		bool read(T *values, unsigned int count) {
+			size_t size = sizeof(T) * count;
+
+			if (position + size > buffer.size()) {
+				return false;
+			}
+
+			std::copy(buffer.begin() + position, buffer.begin() + position + size, reinterpret_cast<char*>(values));
+			position += size;
+			return true;
+		}
+	};
+
+
+	/**
+	 * \brief Read a convex-hull (counts, vertices, faces and adjacency), nullptr if the buffer is too short.
+	 */
+	ConvexHull3D* readHull(BufferReader &reader) {
+		unsigned int cntVertices, cntFaces, cntAdjacency;
+
+		if (!reader.read(&cntVertices, 1) || !reader.read(&cntFaces, 1) || !reader.read(&cntAdjacency, 1)) {
+			return nullptr;
+		}
+
+		std::vector<Eigen::Vector3d> vertices(cntVertices);
+		Eigen::MatrixXi faces(cntFaces, 3);
+		std::vector<int> adjacencyStart(cntVertices + 1);
+		std::vector<int> adjacency(cntAdjacency);
+
+		for (unsigned int i = 0; i < cntVertices; ++i) {
+			if (!reader.read(vertices[i].data(), 3)) {
+				return nullptr;
+			}
+		}
+
+		if (!reader.read(faces.data(), 3 * cntFaces) || !reader.read(adjacencyStart.data(), cntVertices + 1)
+			|| !reader.read(adjacency.data(), cntAdjacency)) {
+			return nullptr;
+		}
+
+		return new ConvexHull3D(vertices, faces, adjacencyStart, adjacency);
+	}
+
+
+	/**
+	 * \brief Write a convex-hull (counts, vertices, faces and adjacency).
+	 */
+	void writeHull(std::ofstream &stream, const ConvexHull3D &convexHull) {
+		const std::vector<Eigen::Vector3d> &vertices = convexHull.getVertices();
+		const Eigen::MatrixXi &faces = convexHull.getFaces();
+		const std::vector<int> &adjacencyStart = convexHull.getAdjacencyStart();
+		const std::vector<int> &adjacency = convexHull.getAdjacency();
+
+		unsigned int counts[3] = { static_cast<unsigned int>(vertices.size()), static_cast<unsigned int>(faces.rows()), static_cast<unsigned int>(adjacency.size()) };
+		writeValues(stream, counts, 3);
+
+		for (unsigned int i = 0; i < vertices.size(); ++i) {
+			writeValues(stream, vertices[i].data(), 3);
+		}
+
+		writeValues(stream, faces.data(), 3 * counts[1]);
+		writeValues(stream, adjacencyStart.data(), counts[0] + 1);
+		writeValues(stream, adjacency.data(), counts[2]);
+	}
+
+
+	/**
+	 * \brief Read a distance-field (origin, cell-size, dimensions and values), nullptr if the buffer is too short.
+	 */
+	DistanceField* readDistanceField(BufferReader &reader) {
+		double origin[3];
+		double cellSize;
+		int dims[3];
+
+		if (!reader.read(origin, 3) || !reader.read(&cellSize, 1) || !reader.read(dims, 3)
+			|| dims[0] < 2 || dims[1] < 2 || dims[2] < 2) {
+			return nullptr;
+		}
+
+		std::vector<float> values(static_cast<size_t>(dims[0]) * dims[1] * dims[2]);
+		if (!reader.read(values.data(), static_cast<unsigned int>(values.size()))) {
+			return nullptr;
+		}
+
+		return new DistanceField(Eigen::Vector3d(origin[0], origin[1], origin[2]), cellSize, Eigen::Vector3i(dims[0], dims[1], dims[2]), values);
+	}
+
+
+	/**
+	 * \brief Write a distance-field (origin, cell-size, dimensions and values).
+	 */
+	void writeDistanceField(std::ofstream &stream, const DistanceField &distanceField) {
+		const Eigen::Vector3i &dims = distanceField.getDims();
+		double cellSize = distanceField.getCellSize();
+
+		writeValues(stream, distanceField.getOrigin().data(), 3);
+		writeValues(stream, &cellSize, 1);
+		writeValues(stream, dims.data(), 3);
+		writeValues(stream, distanceField.getValues().data(), static_cast<unsigned int>(distanceField.getValues().size()));
+	}
+}
+
+
+/**
+ * \brief Get the key of a model-file in the cache.
+ *
+ * \param filePath
+ *      Complete path to the model-file.
+ *
+ * \return Hash of the content of the file ("" => cache disabled or the file can't be read).
+ */
+std::string AssetCache::getKey(std::string filePath) {
+	if (!IS_ENABLED) {
+		return "";
+	}
+
+	std::ifstream stream(filePath, std::ios::binary);
+	if (!stream) {
+		return "";
+	}
+
+	// 64-bit FNV-1a over the content of the file
+	uint64_t hash = 14695981039346656037ull;
+	std::vector<char> chunk(1 << 16);
+
+	while (stream) {
+		stream.read(chunk.data(), chunk.size());
+		std::streamsize read = stream.gcount();
+
+		for (std::streamsize i = 0; i < read; ++i) {
+			hash ^= static_cast<unsigned char>(chunk[i]);
+			hash *= 1099511628211ull;
+		}
+	}
+
+	std::ostringstream key;
+	key << std::hex << std::setw(16) << std::setfill('0') << hash;
+	return key.str();
+}
+
+
+/**
+ * \brief Load a (simplified) model from the cache. If it's not cached yet, it's loaded with the Loader and
+ * written to the cache.
+ *
+ * \param filePath
+ *      Complete path to the model-file.
+ * \param key
+ *      Key of the model-file (see getKey(), "" => not cached).
+ * \param ratio
+ *      Ratio of the simplifier. (Supported values: [0..1])
+ *
+ * \return Node which can be added to the scene graph.
+ */
+osg::ref_ptr<osg::Node> AssetCache::loadModel(std::string filePath, std::string key, float ratio) {
+	return loadModels(filePath, key, std::vector<float>(1, ratio))[0];
+}
+
+
+/**
+ * \brief Load several (simplified) levels of a model from the cache. The levels which are not cached yet are
+ * simplified from copies of a single parse of the model-file (concurrently), prepared and written to the cache.
+ *
+ * \param filePath
+ *      Complete path to the model-file.
+ * \param key
+ *      Key of the model-file (see getKey(), "" => not cached).
+ * \param ratios
+ *      Ratios of the simplifier for each level. (Supported values: [0..1])
+ * \param prepare
+ *      Applied to each new level before it's cached (e.g. the mesh-optimizations, nullptr => none).
+ *
+ * \return Nodes of the levels in the order of the ratios.
+ */
+std::vector<osg::ref_ptr<osg::Node> > AssetCache::loadModels(std::string filePath, std::string key, const std::vector<float> &ratios,
+	void (*prepare)(osg::ref_ptr<osg::Node>)) {
+	int cntLevels = ratios.size();
+	std::vector<osg::ref_ptr<osg::Node> > models(cntLevels);
+	std::vector<std::string> cachePaths(cntLevels);
+	std::vector<int> missing;
+
+	for (int i = 0; i < cntLevels; ++i) {
+		if (key != "") {
+			std::ostringstream suffix;
+			suffix << "_" << static_cast<int>(ratios[i] * 100.0f + 0.5f) << "_v" << MODEL_VERSION << ".osgb";
+			cachePaths[i] = getCachePath(key, suffix.str());
+
+			if (osgDB::fileExists(cachePaths[i])) {
+				LoadProfiler::ScopedTimer timer(LoadProfiler::MODEL_CACHE, filePath);
+				models[i] = osgDB::readNodeFile(cachePaths[i]);
+			}
+		}
+
+		// not cached yet (or the cached file is broken) => prepared from the parsed model-file
+		if (!models[i]) {
+			missing.push_back(i);
+		}
+	}
+
+	if (missing.empty()) {
+		return models;
+	}
+
+	// the model-file is parsed only once, the simplifier changes the geometries => each level gets its own copy
+	// (copied before the simplification, the last level keeps the parsed model)
+	osg::ref_ptr<osg::Node> parsed = Loader::loadModel(filePath);
+	int cntMissing = missing.size();
+
+	for (int m = 0; m < cntMissing; ++m) {
+		models[missing[m]] = m + 1 < cntMissing ? osg::clone(parsed.get(), osg::CopyOp::DEEP_COPY_ALL) : parsed.get();
+	}
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (int m = 0; m < cntMissing; ++m) {
+		int i = missing[m];
+
+		if (ratios[i] != 1.0f) {
+			models[i] = Loader::simplifyNode(models[i], ratios[i]);
+		}
+
+		if (prepare != nullptr) {
+			prepare(models[i]);
+		}
+	}
+
+	if (key != "") {
+		osgDB::makeDirectory(CACHE_PATH);
+
+		for (int m = 0; m < cntMissing; ++m) {
+			osgDB::writeNodeFile(*models[missing[m]], cachePaths[missing[m]]);
+		}
+	}
+
+	return models;
+}
+
+
+/**
+ * \brief Load the bounding-box and the convex-hull of a model (with the parts of a compound and the
+ *        distance-field) from the cache.
+ *
+ * \param key
+ *      Key of the model-file (see getKey(), "" => not cached).
+ * \param boundingBox
+ *      Output-parameter: Bounding-box of the vertices of the unscaled model.
+ * \param convexHull
+ *      Output-parameter: Unscaled convex-hull (newly allocated, nullptr if the shape is not cached).
+ *
+ * \return True if the shape has been found in the cache.
+ */
+bool AssetCache::loadShape(std::string key, osg::BoundingBox &boundingBox, ConvexHull3D* &convexHull) {
+	convexHull = nullptr;
+
+	if (key == "") {
+		return false;
+	}
+
+	// read the whole file at once and parse it from the memory
+	std::ifstream stream(getCachePath(key, ".shape"), std::ios::binary | std::ios::ate);
+	if (!stream) {
+		return false;
+	}
+
+	std::vector<char> buffer(static_cast<size_t>(stream.tellg()));
+	stream.seekg(0);
+	if (!stream.read(buffer.data(), buffer.size())) {
+		return false;
+	}
+
+	BufferReader reader(buffer);
+	unsigned int header[2];
+	float box[6];
+
+	if (!reader.read(header, 2) || header[0] != SHAPE_MAGIC || header[1] != SHAPE_VERSION || !reader.read(box, 6)) {
+		return false;
+	}
+
+	ConvexHull3D* hull = readHull(reader);
+	unsigned int cntParts;
+
+	if (hull == nullptr || !reader.read(&cntParts, 1)) {
+		delete hull;
+		return false;
+	}
+
+	// the parts of a concave model follow the hull (0 => convex)
+	std::vector<ConvexHull3D*> parts;
+	for (unsigned int i = 0; i < cntParts; ++i) {
+		ConvexHull3D* part = readHull(reader);
+
+		if (part == nullptr) {
+			for (unsigned int p = 0; p < parts.size(); ++p) {
+				delete parts[p];
+			}
+			delete hull;
+			return false;
+		}
+
+		parts.push_back(part);
+	}
+
+	hull->setParts(parts);
+
+	// the distance-field of the deep contacts follows the parts (0 => none)
+	unsigned int cntFields;
+	if (!reader.read(&cntFields, 1)) {
+		delete hull;
+		return false;
+	}
+	if (cntFields > 0) {
+		DistanceField* distanceField = readDistanceField(reader);
+		if (distanceField == nullptr) {
+			delete hull;
+			return false;
+		}
+		hull->setDistanceField(distanceField);
+	}
+
+	boundingBox = osg::BoundingBox(box[0], box[1], box[2], box[3], box[4], box[5]);
+	convexHull = hull;
+
+	return true;
+}
+
+
+/**
+ * \brief Write the bounding-box and the convex-hull of a model (with the parts of a compound and the
+ *        distance-field) to the cache.
+ *
+ * \param key
+ *      Key of the model-file (see getKey(), "" => not cached).
+ * \param boundingBox
+ *      Bounding-box of the vertices of the unscaled model.
+ * \param convexHull
+ *      Unscaled convex-hull.
+ */
+void AssetCache::saveShape(std::string key, const osg::BoundingBox &boundingBox, const ConvexHull3D &convexHull) {
+	if (key == "") {
+		return;
+	}
+
+	osgDB::makeDirectory(CACHE_PATH);
+	std::ofstream stream(getCachePath(key, ".shape"), std::ios::binary | std::ios::trunc);
+	if (!stream) {
+		return;
+	}
+
+	const std::vector<ConvexHull3D*> &parts = convexHull.getParts();
+	unsigned int header[2] = { SHAPE_MAGIC, SHAPE_VERSION };
+	float box[6] = { boundingBox.xMin(), boundingBox.yMin(), boundingBox.zMin(), boundingBox.xMax(), boundingBox.yMax(), boundingBox.zMax() };
+	unsigned int cntParts = static_cast<unsigned int>(parts.size());
+
+	writeValues(stream, header, 2);
+	writeValues(stream, box, 6);
+	writeHull(stream, convexHull);
+	writeValues(stream, &cntParts, 1);
+
+	for (unsigned int i = 0; i < parts.size(); ++i) {
+		writeHull(stream, *parts[i]);
+	}
+
+	unsigned int cntFields = convexHull.getDistanceField() ? 1 : 0;
+	writeValues(stream, &cntFields, 1);
+	if (cntFields > 0) {
+		writeDistanceField(stream, *convexHull.getDistanceField());
+	}
+}
+
+
+/**
+ * \brief Get the path of a file in the cache-directory.
+ *
+ * \param key
+ *      Key of the model-file.
+ * \param suffix
+ *      Suffix of the asset (including the extension).
+ *
+ * \return Complete path to the cached file.
+ */
+std::string AssetCache::getCachePath(std::string key, std::string suffix) {
+	return CACHE_PATH + "/" + key + suffix;
+}
@@ -0,0 +1,144 @@
+﻿/**
+ * \brief Functionality for caching the prepared assets on the disk, so they are only prepared once.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-18
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <osg/Node>
+#include <osg/BoundingBox>
+
+// Forward declarations
+namespace pbs17 {
+	class ConvexHull3D;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief AssetCache stores the prepared assets of the model-files in the cache-directory.
+	 * The simplified models (LOD-levels) are written as binary OSG-files, the bounding-box and the simplified convex-hull
+	 * are written into an own binary file. The files are named by the hash of the content of the model-file, so a changed
+	 * model is prepared again.
+	 */
+	class AssetCache {
+	public:
+
+		/**
+		 * \brief Get the key of a model-file in the cache.
+		 *
+		 * \param filePath
+		 *      Complete path to the model-file.
+		 *
+		 * \return Hash of the content of the file ("" => cache disabled or the file can't be read).
+		 */
+		static std::string getKey(std::string filePath);
+
+
+		/**
+		 * \brief Load a (simplified) model from the cache. If it's not cached yet, it's loaded with the Loader and
+		 * written to the cache.
+		 *
+		 * \param filePath
+		 *      Complete path to the model-file.
+		 * \param key
+		 *      Key of the model-file (see getKey(), "" => not cached).
+		 * \param ratio
+		 *      Ratio of the simplifier. (Supported values: [0..1])
+		 *
+		 * \return Node which can be added to the scene graph.
+		 */
+		static osg::ref_ptr<osg::Node> loadModel(std::string filePath, std::string key, float ratio);
+
+
+		/**
+		 * \brief Load several (simplified) levels of a model from the cache. The levels which are not cached yet are
+		 * simplified from copies of a single parse of the model-file (concurrently), prepared and written to the cache.
+		 *
+		 * \param filePath
+		 *      Complete path to the model-file.
+		 * \param key
+		 *      Key of the model-file (see getKey(), "" => not cached).
+		 * \param ratios
+		 *      Ratios of the simplifier for each level. (Supported values: [0..1])
+		 * \param prepare
+		 *      Applied to each new level before it's cached (e.g. the mesh-optimizations, nullptr => none).
+		 *
+		 * \return Nodes of the levels in the order of the ratios.
+		 */
+		static std::vector<osg::ref_ptr<osg::Node> > loadModels(std::string filePath, std::string key, const std::vector<float> &ratios,
+			void (*prepare)(osg::ref_ptr<osg::Node>) = nullptr);
+
+
+		/**
+		 * \brief Load the bounding-box and the convex-hull of a model (with the parts of a compound and the
+		 *        distance-field) from the cache.
+		 *
+		 * \param key
+		 *      Key of the model-file (see getKey(), "" => not cached).
+		 * \param boundingBox
+		 *      Output-parameter: Bounding-box of the vertices of the unscaled model.
+		 * \param convexHull
+		 *      Output-parameter: Unscaled convex-hull (newly allocated, nullptr if the shape is not cached).
+		 *
+		 * \return True if the shape has been found in the cache.
+		 */
+		static bool loadShape(std::string key, osg::BoundingBox &boundingBox, ConvexHull3D* &convexHull);
+
+
+		/**
+		 * \brief Write the bounding-box and the convex-hull of a model (with the parts of a compound and the
+		 *        distance-field) to the cache.
+		 *
+		 * \param key
+		 *      Key of the model-file (see getKey(), "" => not cached).
+		 * \param boundingBox
+		 *      Bounding-box of the vertices of the unscaled model.
+		 * \param convexHull
+		 *      Unscaled convex-hull.
+		 */
+		static void saveShape(std::string key, const osg::BoundingBox &boundingBox, const ConvexHull3D &convexHull);
+
+
+		/**
+		 * \brief Enable or disable the cache (if disabled, all assets are prepared on each start).
+		 *
+		 * \param isEnabled
+		 *      True if the cache-directory is used.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+	private:
+
+		//! True if the cache-directory is used
+		static bool IS_ENABLED;
+
+		//! Identifier at the beginning of the shape-files
+		static const unsigned int SHAPE_MAGIC;
+		//! Version of the shape-files (increase if the format or the preparation changes)
+		static const unsigned int SHAPE_VERSION;
+		//! Version of the model-files (increase if the preparation changes)
+		static const unsigned int MODEL_VERSION;
+
+
+		/**
+		 * \brief Get the path of a file in the cache-directory.
+		 *
+		 * \param key
+		 *      Key of the model-file.
+		 * \param suffix
+		 *      Suffix of the asset (including the extension).
+		 *
+		 * \return Complete path to the cached file.
+		 */
+		static std::string getCachePath(std::string key, std::string suffix);
+	};
+}
@@ -0,0 +1,191 @@
+﻿/**
+ * \brief Functionality for integrating the gravity of the bodies in a compute-shader (without the CPU).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-09
+ */
+
+#include "ComputeGravity.h"
+
+#include <set>
+#include <algorithm>
+
+#include <osg/Version>
+#include <osg/Geode>
+#include <osg/Program>
+#include <osg/Shader>
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 4, 0)
+#include <osg/BufferObject>
+#include <osg/BufferIndexBinding>
+#endif
+
+#include "../scene/SpaceObject.h"
+#include "DispatchDrawable.h"
+#include "InstanceManager.h"
+#include "InstancedModel.h"
+#include "OsgEigenConversions.h"
+#include "shaders/InstancedShader.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	//! Pass 0 kicks the velocities with the field of all bodies, pass 1 drifts the positions
+	const char* COMPUTE_SHADER =
+		"#version 430\n"
+		"layout(local_size_x = 256) in;\n"
+		"struct Body { vec4 position; vec4 velocity; };\n"
+		"layout(std430, binding = 0) buffer Bodies { Body bodies[]; };\n"
+		"uniform int cntBodies;\n"
+		"uniform int pass;\n"
+		"uniform float dt;\n"
+		"uniform float gravity;\n"
+		"uniform float softening;\n"
+		"shared vec4 tile[256];\n"
+		"void main()\n"
+		"{\n"
+		"    int i = int(gl_GlobalInvocationID.x);\n"
+		"    if (pass == 1) {\n"
+		"        if (i < cntBodies) bodies[i].position.xyz += dt * bodies[i].velocity.xyz;\n"
+		"        return;\n"
+		"    }\n"
+		"    vec3 p = i < cntBodies ? bodies[i].position.xyz : vec3(0.0);\n"
+		"    vec3 field = vec3(0.0);\n"
+		"    for (int start = 0; start < cntBodies; start += 256) {\n"
+		"        int j = start + int(gl_LocalInvocationID.x);\n"
+		"        tile[gl_LocalInvocationID.x] = j < cntBodies ? bodies[j].position : vec4(0.0);\n"
+		"        barrier();\n"
+		"        for (int t = 0; t < 256; ++t) {\n"
+		"            vec3 d = tile[t].xyz - p;\n"
+		"            float invDist = inversesqrt(dot(d, d) + softening);\n"
+		"            field += (tile[t].w * invDist * invDist * invDist) * d;\n"
+		"        }\n"
+		"        barrier();\n"
+		"    }\n"
+		"    if (i < cntBodies) bodies[i].velocity.xyz += (dt * gravity) * field;\n"
+		"}\n";
+}
+
+
+//! Same gravitational constant and softening as NBodyManager
+const float ComputeGravity::G = 1.0f;
+const float ComputeGravity::EPS = 0.000000001f;
+
+
+/**
+ * \brief Constructor of the compute-gravity. Uploads the state of the space-objects and lets their
+ *        instanced models read the buffer.
+ *
+ * \param spaceObjects
+ *      All space-objects in the scene.
+ */
+ComputeGravity::ComputeGravity(const std::vector<SpaceObject*> &spaceObjects) : _dt(new osg::Uniform("dt", 0.0f)) {
+	int cntBodies = spaceObjects.size();
+	// set by the main-loop while the previous frame may still be drawn
+	_dt->setDataVariance(osg::Object::DYNAMIC);
+	unsigned int cntGroups = std::max((cntBodies + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 4, 0)
+	// position and mass, velocity per body (the array is never dirtied again, the GPU owns the state)
+	osg::ref_ptr<osg::Vec4Array> bodies = new osg::Vec4Array(2 * std::max(cntBodies, 1));
+	osg::BoundingBox bound;
+	for (int i = 0; i < cntBodies; ++i) {
+		osg::Vec3 position = toOsg(spaceObjects[i]->getPosition());
+		(*bodies)[2 * i] = osg::Vec4(position, static_cast<float>(spaceObjects[i]->getMass()));
+		(*bodies)[2 * i + 1] = osg::Vec4(toOsg(spaceObjects[i]->getLinearVelocity()), 0.0f);
+		bound.expandBy(spaceObjects[i]->getAABB());
+	}
+
+	osg::ref_ptr<osg::ShaderStorageBufferObject> buffer = new osg::ShaderStorageBufferObject;
+	bodies->setBufferObject(buffer.get());
+	GLsizeiptr size = bodies->getTotalDataSize();
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 6, 0)
+	_bodyBinding = new osg::ShaderStorageBufferBinding(InstancedShader::BODY_BINDING, bodies.get(), 0, size);
+#else
+	_bodyBinding = new osg::ShaderStorageBufferBinding(InstancedShader::BODY_BINDING, buffer.get(), 0, size);
+#endif
+
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	program->addShader(new osg::Shader(osg::Shader::COMPUTE, COMPUTE_SHADER));
+
+	osg::StateSet* stateset = getOrCreateStateSet();
+	stateset->setAttributeAndModes(_bodyBinding);
+	stateset->setAttributeAndModes(program);
+	stateset->addUniform(new osg::Uniform("cntBodies", cntBodies));
+	stateset->addUniform(new osg::Uniform("gravity", G));
+	stateset->addUniform(new osg::Uniform("softening", EPS));
+	stateset->addUniform(_dt);
+
+	// the passes are ordered by their render-bins before the culling of the instances (bin -1, see InstanceCuller)
+	// and the scene (default bin 0)
+	for (int pass = 0; pass < 2; ++pass) {
+		osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+		geode->setCullingActive(false);
+		geode->addDrawable(new DispatchDrawable(cntGroups));
+
+		osg::StateSet* passState = geode->getOrCreateStateSet();
+		passState->addUniform(new osg::Uniform("pass", pass));
+		passState->setRenderBinDetails(pass - 3, "RenderBin");
+
+		_passes[pass] = geode;
+		addChild(geode);
+	}
+
+	// the instances are drawn at the positions of the buffer, the bodies may spread around their initial region
+	osg::BoundingBox region(bound.center() - (bound._max - bound._min), bound.center() + (bound._max - bound._min));
+	std::set<InstancedModel*> models;
+	for (int i = 0; i < cntBodies; ++i) {
+		InstancedModel* model = spaceObjects[i]->getInstancedModel();
+
+		if (model) {
+			model->setBody(spaceObjects[i]->getInstance(), i);
+			models.insert(model);
+		}
+	}
+	for (std::set<InstancedModel*>::iterator it = models.begin(); it != models.end(); ++it) {
+		(*it)->setReadsBodies(region);
+	}
+	InstanceManager::Instance()->getRoot()->getOrCreateStateSet()->setAttributeAndModes(_bodyBinding);
+#endif
+
+	setDt(0.0);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+ComputeGravity::~ComputeGravity() {}
+
+
+/**
+ * \brief Check if the compute-shaders are supported by the version of OSG.
+ *
+ * \return True if the bodies can be integrated on the GPU.
+ */
+bool ComputeGravity::isSupported() {
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 4, 0)
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * \brief Set the time difference of the next frame (0 => paused, nothing is dispatched).
+ *
+ * \param dt
+ *      Time difference of a step.
+ */
+void ComputeGravity::setDt(double dt) {
+	_dt->set(static_cast<float>(dt));
+
+	for (int pass = 0; pass < 2; ++pass) {
+		if (_passes[pass].valid()) {
+			_passes[pass]->setNodeMask(dt > 0.0 ? ~0u : 0u);
+		}
+	}
+}
@@ -0,0 +1,102 @@
+﻿/**
+ * \brief Functionality for integrating the gravity of the bodies in a compute-shader (without the CPU).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-09
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <osg/Group>
+#include <osg/Uniform>
+#include <osg/StateAttribute>
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief ComputeGravity integrates the bodies of a gravity-only scene (galaxy, ring, ...) on the GPU. The bodies
+	 * live in a shader-storage-buffer (position and mass, velocity), which is integrated by a compute-shader before
+	 * the scene is drawn (semi-implicit euler, same as the default integrator of NBodyManager):
+	 *  - pass 0: the field of each body is summed tile by tile in shared memory, the velocity is kicked.
+	 *  - pass 1: the positions are drifted.
+	 * The instanced models read their positions from the same buffer (see InstancedModel::setReadsBodies()), so
+	 * nothing is copied between the CPU and the GPU after the upload of the initial state.
+	 *
+	 * The collisions are not detected and objects which are not instanced (e.g. the planets) are not moved, they
+	 * only attract the other bodies. Needs OpenGL 4.3 and OSG 3.4 (shader-storage-buffers).
+	 */
+	class ComputeGravity : public osg::Group {
+	public:
+
+		/**
+		 * \brief Constructor of the compute-gravity. Uploads the state of the space-objects and lets their
+		 *        instanced models read the buffer.
+		 *
+		 * \param spaceObjects
+		 *      All space-objects in the scene.
+		 */
+		explicit ComputeGravity(const std::vector<SpaceObject*> &spaceObjects);
+
+
+		/**
+		 * \brief Check if the compute-shaders are supported by the version of OSG.
+		 *
+		 * \return True if the bodies can be integrated on the GPU.
+		 */
+		static bool isSupported();
+
+
+		/**
+		 * \brief Set the time difference of the next frame (0 => paused, nothing is dispatched).
+		 *
+		 * \param dt
+		 *      Time difference of a step.
+		 */
+		void setDt(double dt);
+
+
+		/**
+		 * \brief Get the binding of the shader-storage-buffer of the bodies (applied to the instanced models).
+		 *
+		 * \return Buffer-binding of the bodies.
+		 */
+		osg::ref_ptr<osg::StateAttribute> getBodyBinding() const {
+			return _bodyBinding;
+		}
+
+
+	protected:
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~ComputeGravity();
+
+
+	private:
+
+		//! Invocations per work-group, also the number of bodies of a tile in shared memory
+		static const int GROUP_SIZE = 256;
+		//! Same gravitational constant and softening as NBodyManager
+		static const float G;
+		static const float EPS;
+
+		//! Binding of the shader-storage-buffer of the bodies
+		osg::ref_ptr<osg::StateAttribute> _bodyBinding;
+
+		//! Time difference of a step
+		osg::ref_ptr<osg::Uniform> _dt;
+
+		//! Nodes of the two passes (hidden while paused)
+		osg::ref_ptr<osg::Node> _passes[2];
+	};
+}
@@ -0,0 +1,202 @@
+﻿/**
+ * \brief Functionality for drawing the bounding-boxes of all space-objects with one draw-call.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-12
+ */
+
+#include "DebugOverlay.h"
+
+#include <osg/NodeCallback>
+#include <osg/GLExtensions>
+#include <osg/State>
+
+#include "UploadRing.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Uploads the written boxes once per frame.
+	 */
+	class DebugOverlayUpdateCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			DebugOverlay::Instance()->update();
+			traverse(node, nv);
+		}
+	};
+
+
+	/**
+	 * \brief Copies the written boxes before the geometry is drawn.
+	 */
+	class DebugOverlayDrawCallback : public osg::Drawable::DrawCallback {
+	public:
+		void drawImplementation(osg::RenderInfo &renderInfo, const osg::Drawable* drawable) const override {
+			DebugOverlay::Instance()->upload(renderInfo);
+			drawable->drawImplementation(renderInfo);
+		}
+	};
+
+
+	/**
+	 * \brief Copy a whole array into its compiled buffer-object (through the ring if possible).
+	 *
+	 * \param state
+	 *      State of the current context.
+	 * \param array
+	 *      Written array.
+	 */
+	void uploadArray(osg::State &state, osg::Array* array) {
+		osg::GLBufferObject* glBufferObject = array->getOrCreateGLBufferObject(state.getContextID());
+
+		// the whole array is uploaded by osg if the buffer has not been compiled yet
+		if (!glBufferObject || glBufferObject->isDirty()) return;
+
+		GLintptr offset = glBufferObject->getOffset(array->getBufferIndex());
+		if (!UploadRing::Instance()->bufferSubData(state, glBufferObject->getGLObjectID(), offset, array->getDataPointer(), array->getTotalDataSize())) {
+			state.bindVertexBufferObject(glBufferObject);
+			state.get<osg::GLExtensions>()->glBufferSubData(GL_ARRAY_BUFFER_ARB, offset, array->getTotalDataSize(), array->getDataPointer());
+		}
+	}
+
+
+	//! Corners (bits: x, y, z => max) of the 12 edges of a box
+	const unsigned int EDGES[24] = {
+		0, 1, 2, 3, 4, 5, 6, 7,
+		0, 2, 1, 3, 4, 6, 5, 7,
+		0, 4, 1, 5, 2, 6, 3, 7
+	};
+}
+
+
+//! Pointer to the only instance of this class.
+DebugOverlay* DebugOverlay::_pInstance = nullptr;
+
+
+/**
+ * \brief Singleton instance of the DebugOverlay-class.
+ */
+DebugOverlay* DebugOverlay::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new DebugOverlay();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Private constructor: Prepare the hidden line-geometry.
+ */
+DebugOverlay::DebugOverlay() : _root(new osg::Geode), _geometry(new osg::Geometry), _vertices(new osg::Vec3Array),
+	_colors(new osg::Vec4Array), _lines(new osg::DrawArrays(GL_LINES, 0, 0)) {
+	_geometry->setDataVariance(osg::Object::DYNAMIC);
+	_geometry->setUseDisplayList(false);
+	_geometry->setUseVertexBufferObjects(true);
+	_geometry->setVertexArray(_vertices);
+	_geometry->setColorArray(_colors, osg::Array::BIND_PER_VERTEX);
+	_geometry->addPrimitiveSet(_lines);
+	_geometry->setDrawCallback(new DebugOverlayDrawCallback);
+
+	_root->addDrawable(_geometry);
+	_root->setDataVariance(osg::Object::DYNAMIC);
+	_root->setNodeMask(0);
+	_root->setUpdateCallback(new DebugOverlayUpdateCallback);
+	_root->getOrCreateStateSet()->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+}
+
+
+/**
+ * \brief Add the box of an object (has to be done before the first frame).
+ *
+ * \return Index of the box.
+ */
+unsigned int DebugOverlay::addBox() {
+	unsigned int box = _vertices->size() / VERTICES_PER_BOX;
+
+	_vertices->resize(_vertices->size() + VERTICES_PER_BOX);
+	_colors->resize(_colors->size() + VERTICES_PER_BOX, osg::Vec4(1, 1, 1, 1));
+	_lines->setCount(_vertices->size());
+	_isDirty = true;
+	_isResized = true;
+
+	return box;
+}
+
+
+/**
+ * \brief Write the AABB of an object (ignored while the overlay is hidden).
+ *
+ * \param box
+ *      Index of the box.
+ * \param aabb
+ *      Global AABB of the object.
+ * \param collisionState
+ *      Collision-state of the object (colour of the box).
+ */
+void DebugOverlay::setBox(unsigned int box, const osg::BoundingBox &aabb, int collisionState) {
+	if (!_isVisible) return;
+
+	osg::Vec4 color = collisionState == 0 ? osg::Vec4(1, 1, 1, 1) :
+		(collisionState == 1 ? osg::Vec4(0, 1, 0, 1) : osg::Vec4(1, 0, 0, 1));
+
+	unsigned int first = box * VERTICES_PER_BOX;
+	for (unsigned int k = 0; k < VERTICES_PER_BOX; ++k) {
+		(*_vertices)[first + k] = aabb.corner(EDGES[k]);
+		(*_colors)[first + k] = color;
+	}
+
+	_isDirty = true;
+}
+
+
+/**
+ * \brief Upload the boxes which have been written since the last frame (called once per frame by the
+ * update-callback of the root).
+ */
+void DebugOverlay::update() {
+	if (!_isVisible || !_isDirty) return;
+
+	// the boxes of a frame are copied by the draw-callback, added boxes need larger buffers
+	if (UploadRing::getIsEnabled() && !_isResized) {
+		_isUploadPending = true;
+	} else {
+		_vertices->dirty();
+		_colors->dirty();
+		_isResized = false;
+	}
+	_geometry->dirtyBound();
+	_isDirty = false;
+}
+
+
+/**
+ * \brief Copy the boxes of the frame through the UploadRing (called by the draw-callback of the geometry).
+ *
+ * \param renderInfo
+ *      Render-info of the current context.
+ */
+void DebugOverlay::upload(osg::RenderInfo &renderInfo) {
+	if (!_isUploadPending) return;
+
+	uploadArray(*renderInfo.getState(), _vertices.get());
+	uploadArray(*renderInfo.getState(), _colors.get());
+	_isUploadPending = false;
+}
+
+
+/**
+ * \brief Show or hide the bounding-boxes.
+ *
+ * \param isVisible
+ *      True if the bounding-boxes are drawn.
+ */
+void DebugOverlay::setIsVisible(bool isVisible) {
+	_isVisible = isVisible;
+	_root->setNodeMask(_isVisible ? ~0u : 0u);
+}
@@ -0,0 +1,133 @@
+﻿/**
+ * \brief Functionality for drawing the bounding-boxes of all space-objects with one draw-call.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-12
+ */
+
+#pragma once
+
+#include <osg/BoundingBox>
+#include <osg/Geode>
+#include <osg/Geometry>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief DebugOverlay draws the AABBs of all space-objects (toggled by the keyboard-handler) as one batched
+	 * line-geometry (12 edges per box, coloured by the collision-state). The boxes are only written while the
+	 * overlay is visible, so the hidden overlay costs nothing per step: no drawable is dirtied and nothing is
+	 * uploaded. When it's shown again, the objects have to be marked as dirty to write their current boxes.
+	 */
+	class DebugOverlay {
+	public:
+
+		/**
+		 * \brief Singleton instance of the DebugOverlay-class.
+		 */
+		static DebugOverlay* Instance();
+
+
+		/**
+		 * \brief Add the box of an object (has to be done before the first frame).
+		 *
+		 * \return Index of the box.
+		 */
+		unsigned int addBox();
+
+
+		/**
+		 * \brief Write the AABB of an object (ignored while the overlay is hidden).
+		 *
+		 * \param box
+		 *      Index of the box.
+		 * \param aabb
+		 *      Global AABB of the object.
+		 * \param collisionState
+		 *      Collision-state of the object (colour of the box).
+		 */
+		void setBox(unsigned int box, const osg::BoundingBox &aabb, int collisionState);
+
+
+		/**
+		 * \brief Upload the boxes which have been written since the last frame (called once per frame by the
+		 * update-callback of the root).
+		 */
+		void update();
+
+
+		/**
+		 * \brief Copy the boxes of the frame through the UploadRing (called by the draw-callback of the geometry).
+		 *
+		 * \param renderInfo
+		 *      Render-info of the current context.
+		 */
+		void upload(osg::RenderInfo &renderInfo);
+
+
+		/**
+		 * \brief Show or hide the bounding-boxes.
+		 *
+		 * \param isVisible
+		 *      True if the bounding-boxes are drawn.
+		 */
+		void setIsVisible(bool isVisible);
+
+
+		/**
+		 * \brief Get if the bounding-boxes are shown (only then the boxes have to be written).
+		 *
+		 * \return True if the bounding-boxes are drawn.
+		 */
+		bool isVisible() const {
+			return _isVisible;
+		}
+
+
+		/**
+		 * \brief Get the node which draws all boxes (has to be added once to the scene).
+		 *
+		 * \return Root of the boxes.
+		 */
+		osg::ref_ptr<osg::Geode> getRoot() const {
+			return _root;
+		}
+
+
+	private:
+
+		//! Number of vertices of a box (2 per edge)
+		static const unsigned int VERTICES_PER_BOX = 24;
+
+		//! Root which draws the boxes
+		osg::ref_ptr<osg::Geode> _root;
+		//! Lines of all boxes
+		osg::ref_ptr<osg::Geometry> _geometry;
+		osg::ref_ptr<osg::Vec3Array> _vertices;
+		osg::ref_ptr<osg::Vec4Array> _colors;
+		osg::ref_ptr<osg::DrawArrays> _lines;
+
+		//! True if the boxes are shown
+		bool _isVisible = false;
+		//! True if a box has been written since the last upload
+		bool _isDirty = false;
+		//! True if boxes have been added since the last upload (the buffers are allocated again by osg)
+		bool _isResized = true;
+		//! True if the written boxes wait for the draw-callback
+		bool _isUploadPending = false;
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		DebugOverlay();
+
+		//! Private copy-constructor to prevent copying the class.
+		DebugOverlay(DebugOverlay const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		DebugOverlay& operator=(DebugOverlay const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static DebugOverlay* _pInstance;
+	};
+}
@@ -0,0 +1,322 @@
+﻿/**
+ * \brief Functionality for drawing the bodies of galaxy-scale scenes as an additive density-field.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "DensitySplat.h"
+
+#include <cmath>
+
+#include <osg/Geode>
+#include <osg/NodeCallback>
+#include <osgUtil/CullVisitor>
+
+#include "OsgEigenConversions.h"
+#include "shaders/SplatShader.h"
+#include "shaders/ToneMapShader.h"
+#include "../scene/SpaceObject.h"
+#include "../physics/Logger.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Writes the positions of the bodies during the update-traversal (after the sync of the scene).
+	 */
+	class DensitySplatUpdateCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			DensitySplat::Instance()->update();
+			traverse(node, nv);
+		}
+	};
+
+
+	/**
+	 * \brief Measures the projected size of the bodies during the cull-traversal of the camera.
+	 */
+	class DensitySplatCullCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+
+			if (cv && cv->getViewport()) {
+				DensitySplat::Instance()->cull(*cv->getModelViewMatrix(), *cv->getProjectionMatrix(),
+					static_cast<int>(cv->getViewport()->width()), static_cast<int>(cv->getViewport()->height()));
+			}
+
+			traverse(node, nv);
+		}
+	};
+}
+
+
+//! Pointer to the only instance of this class.
+DensitySplat* DensitySplat::_pInstance = nullptr;
+
+//! Disabled by default, the models are always drawn.
+bool DensitySplat::IS_ENABLED = false;
+
+//! A few hundred bodies decide the mode of a galaxy as well as all of them.
+const unsigned int DensitySplat::SAMPLE_SIZE = 256;
+//! One pixel on the screen.
+const double DensitySplat::PIXEL_SIZE = 1.0;
+//! Nearly all bodies are dots anyway, a few close ones become soft discs.
+const double DensitySplat::SPLAT_FRACTION = 0.9;
+//! The models come back once a quarter of the bodies is bigger than a pixel.
+const double DensitySplat::MESH_FRACTION = 0.75;
+//! A sun is as bright as sixteen average bodies.
+const float DensitySplat::MAX_WEIGHT = 16.0f;
+
+
+/**
+ * \brief Singleton instance of the DensitySplat-class.
+ */
+DensitySplat* DensitySplat::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new DensitySplat();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Splat the given bodies (has to be called once, before the first frame).
+ *
+ * \param objects
+ *      Bodies which are splatted (their transformations are read by each update).
+ * \param meshRoots
+ *      Nodes which draw the models of the bodies (hidden while the splats are shown).
+ */
+void DensitySplat::init(const std::vector<SpaceObject*> &objects, const std::vector<osg::ref_ptr<osg::Node> > &meshRoots) {
+	_objects = objects;
+	_meshRoots = meshRoots;
+
+	unsigned int n = _objects.size();
+	double meanMass = 0.0;
+	for (unsigned int i = 0; i < n; ++i) {
+		meanMass += _objects[i]->getMass() / n;
+	}
+
+	_weights.resize(n);
+	_positions = new osg::Vec3Array(n);
+	_sizes = new osg::Vec2Array(n);
+	for (unsigned int i = 0; i < n; ++i) {
+		_weights[i] = meanMass > 0.0 ? std::min(static_cast<float>(_objects[i]->getMass() / meanMass), MAX_WEIGHT) : 1.0f;
+		(*_positions)[i] = toOsg(_objects[i]->getPosition());
+		(*_sizes)[i].set(static_cast<float>(_objects[i]->getCoarseRadius()), _weights[i]);
+	}
+
+	// the positions are streamed each frame, so they live in a dynamic vertex-buffer
+	_positions->setDataVariance(osg::Object::DYNAMIC);
+	_sizes->setDataVariance(osg::Object::DYNAMIC);
+	_points = new osg::Geometry;
+	_points->setUseDisplayList(false);
+	_points->setUseVertexBufferObjects(true);
+	_points->setDataVariance(osg::Object::DYNAMIC);
+	_points->setVertexArray(_positions.get());
+	_points->setTexCoordArray(0, _sizes.get(), osg::Array::BIND_PER_VERTEX);
+	_points->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, n));
+	_points->setCullingActive(false);
+
+	osg::ref_ptr<osg::Geode> splats = new osg::Geode;
+	splats->addDrawable(_points.get());
+	splats->setCullingActive(false);
+
+	_viewportHeightUniform = new osg::Uniform("viewportHeight", 1.0f);
+	_viewportHeightUniform->setDataVariance(osg::Object::DYNAMIC);
+	SplatShader splatShader(osg::Vec3(1.0f, 0.85f, 0.7f), _viewportHeightUniform);
+	splatShader.apply(splats);
+
+	// the density of the dense core exceeds one by far, so it's accumulated with half-floats
+	_targetWidth = std::max(static_cast<int>(1000 * _resolution), 1);
+	_targetHeight = std::max(static_cast<int>(600 * _resolution), 1);
+	_target = new osg::Texture2D;
+	_target->setTextureSize(_targetWidth, _targetHeight);
+	_target->setInternalFormat(GL_RGBA16F_ARB);
+	_target->setSourceFormat(GL_RGBA);
+	_target->setSourceType(GL_FLOAT);
+	_target->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+	_target->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+	_target->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+	_target->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+
+	// the accumulation-camera inherits the view and the projection of the camera of the scene
+	_accumulationCamera = new osg::Camera;
+	_accumulationCamera->setReferenceFrame(osg::Transform::RELATIVE_RF);
+	_accumulationCamera->setViewMatrix(osg::Matrix::identity());
+	_accumulationCamera->setProjectionMatrix(osg::Matrix::identity());
+	_accumulationCamera->setRenderOrder(osg::Camera::PRE_RENDER);
+	_accumulationCamera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+	_accumulationCamera->attach(osg::Camera::COLOR_BUFFER, _target.get());
+	_accumulationCamera->setClearColor(osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+	_accumulationCamera->setClearMask(GL_COLOR_BUFFER_BIT);
+	_accumulationCamera->setViewport(0, 0, _targetWidth, _targetHeight);
+	_accumulationCamera->addChild(splats);
+
+	_scaleUniform = new osg::Uniform("scale", osg::Vec2(1.0f, 1.0f));
+	_scaleUniform->setDataVariance(osg::Object::DYNAMIC);
+	_exposureUniform = new osg::Uniform("exposure", _exposure);
+
+	// one quad over the whole window adds the tone-mapped density to the scene
+	osg::ref_ptr<osg::Geode> quad = new osg::Geode;
+	quad->addDrawable(osg::createTexturedQuadGeometry(osg::Vec3(0.0f, 0.0f, 0.0f), osg::Vec3(1.0f, 0.0f, 0.0f), osg::Vec3(0.0f, 1.0f, 0.0f)));
+	quad->setCullingActive(false);
+	ToneMapShader toneMapShader(_target, _scaleUniform, _exposureUniform);
+	toneMapShader.apply(quad);
+
+	_toneMapCamera = new osg::Camera;
+	_toneMapCamera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+	_toneMapCamera->setProjectionMatrixAsOrtho2D(0.0, 1.0, 0.0, 1.0);
+	_toneMapCamera->setViewMatrix(osg::Matrix::identity());
+	_toneMapCamera->setClearMask(0);
+	_toneMapCamera->setRenderOrder(osg::Camera::NESTED_RENDER);
+	_toneMapCamera->setAllowEventFocus(false);
+	_toneMapCamera->addChild(quad);
+
+	// the root is always culled, so the size of the bodies is measured in both modes
+	_root = new osg::Group;
+	_root->addChild(_accumulationCamera);
+	_root->addChild(_toneMapCamera);
+	_root->setCullingActive(false);
+	_root->setUpdateCallback(new DensitySplatUpdateCallback);
+	_root->setCullCallback(new DensitySplatCullCallback);
+
+	_isSplatted = true;
+	applyMode(false);
+}
+
+
+/**
+ * \brief Write the positions of the bodies and apply the mode of the last cull-traversal (called by the
+ *        update-callback).
+ */
+void DensitySplat::update() {
+	if (!_root.valid()) return;
+
+	if (_isSplatRequested != _isSplatted) {
+		applyMode(_isSplatRequested);
+	}
+
+	int width = std::max(static_cast<int>(_windowWidth * _resolution + 0.5), 1);
+	int height = std::max(static_cast<int>(_windowHeight * _resolution + 0.5), 1);
+	if (_windowWidth > 0 && (width > _targetWidth || height > _targetHeight)) {
+		resize(width, height);
+	}
+	if (_windowWidth > 0) {
+		_accumulationCamera->setViewport(0, 0, width, height);
+		_scaleUniform->set(osg::Vec2(static_cast<float>(width) / _targetWidth, static_cast<float>(height) / _targetHeight));
+		_viewportHeightUniform->set(static_cast<float>(height));
+	}
+
+	// the rendered transformations include the interpolation between the steps (the pooled objects are not splatted)
+	osg::BoundingBox bound;
+	for (unsigned int i = 0; i < _objects.size(); ++i) {
+		SpaceObject* object = _objects[i];
+		osg::Vec3 position = object->getTransformation().valid() ? osg::Vec3(object->getTransformation()->getMatrix().getTrans()) : osg::Vec3(toOsg(object->getPosition()));
+
+		(*_positions)[i] = position;
+		(*_sizes)[i].set(static_cast<float>(object->getCoarseRadius()), object->isActive() ? _weights[i] : 0.0f);
+		bound.expandBy(position);
+	}
+
+	// the buffers are only uploaded while they are drawn, the near- and far-plane follow the bodies
+	if (_isSplatted) {
+		_positions->dirty();
+		_sizes->dirty();
+		_points->setInitialBound(bound);
+		_points->dirtyBound();
+	}
+}
+
+
+/**
+ * \brief Select the mode from the projected size of a sample of the bodies (called by the cull-callback).
+ *
+ * \param modelView
+ *      Model-view-matrix of the splats (the positions are global).
+ * \param projection
+ *      Projection-matrix of the camera.
+ * \param width, height
+ *      Size of the viewport of the camera.
+ */
+void DensitySplat::cull(const osg::Matrix &modelView, const osg::Matrix &projection, int width, int height) {
+	_windowWidth = width;
+	_windowHeight = height;
+
+	unsigned int n = _positions.valid() ? _positions->size() : 0;
+	if (n == 0) return;
+
+	// the sample rotates through all bodies, so a cluster near the camera is not missed by a fixed stride
+	unsigned int cntSamples = std::min(n, SAMPLE_SIZE);
+	unsigned int stride = n / cntSamples;
+	unsigned int cntVisible = 0, cntSmall = 0;
+
+	for (unsigned int k = 0; k < cntSamples; ++k) {
+		unsigned int i = (_sampleOffset + k * stride) % n;
+		if ((*_sizes)[i].y() <= 0.0f) continue;
+
+		// the bodies behind the camera do not count
+		double depth = -((*_positions)[i] * modelView).z();
+		if (depth <= 0.0) continue;
+
+		double size = height * projection(1, 1) * (*_sizes)[i].x() / depth;
+		++cntVisible;
+		if (size < PIXEL_SIZE) {
+			++cntSmall;
+		}
+	}
+	_sampleOffset = (_sampleOffset + 1) % n;
+
+	if (cntVisible == 0) return;
+
+	double fraction = static_cast<double>(cntSmall) / cntVisible;
+	if (!_isSplatRequested && fraction >= SPLAT_FRACTION) {
+		_isSplatRequested = true;
+	} else if (_isSplatRequested && fraction < MESH_FRACTION) {
+		_isSplatRequested = false;
+	}
+}
+
+
+/**
+ * \brief Show the splats or the models.
+ *
+ * \param isSplatted
+ *      True if the models are hidden and the splats are shown.
+ */
+void DensitySplat::applyMode(bool isSplatted) {
+	if (isSplatted == _isSplatted) return;
+	_isSplatted = isSplatted;
+
+	for (unsigned int i = 0; i < _meshRoots.size(); ++i) {
+		_meshRoots[i]->setNodeMask(isSplatted ? 0u : ~0u);
+	}
+	_accumulationCamera->setNodeMask(isSplatted ? ~0u : 0u);
+	_toneMapCamera->setNodeMask(isSplatted ? ~0u : 0u);
+
+	LOG_DEBUG((isSplatted ? "Splatting " : "Drawing the models of ") << _objects.size() << " bodies.");
+}
+
+
+/**
+ * \brief Reallocate the target for another size of the window.
+ *
+ * \param width, height
+ *      Size of the window.
+ */
+void DensitySplat::resize(int width, int height) {
+	_targetWidth = std::max(width, _targetWidth);
+	_targetHeight = std::max(height, _targetHeight);
+
+	// the frame-buffer-object is attached again with the new texture-object
+	_target->setTextureSize(_targetWidth, _targetHeight);
+	_target->dirtyTextureObject();
+	_accumulationCamera->dirtyAttachmentMap();
+}
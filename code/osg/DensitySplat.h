@@ -0,0 +1,234 @@
+﻿/**
+ * \brief Functionality for drawing the bodies of galaxy-scale scenes as an additive density-field.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <osg/Array>
+#include <osg/Camera>
+#include <osg/Geometry>
+#include <osg/Group>
+#include <osg/Texture2D>
+#include <osg/Uniform>
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief DensitySplat replaces the models of the bodies by one point-cloud once most of them are smaller than a
+	 * pixel on the screen: The positions of all bodies are written into one vertex-buffer by the update-traversal and
+	 * splatted additively (weighted by their mass) into an HDR-target (RGBA16F) with a fraction of the resolution of
+	 * the window. The target is tone-mapped onto the scene by a quad over the whole window (see SplatShader and
+	 * ToneMapShader), so the cost of the fill follows the pixels instead of the bodies.
+	 *
+	 * The cull-traversal measures the projected size of a sample of the bodies: If at least SPLAT_FRACTION of the
+	 * visible ones are below a pixel, the models (and the instanced renderers) are hidden and the splats are shown
+	 * by the next update, they come back below MESH_FRACTION (the gap keeps the mode from flickering).
+	 */
+	class DensitySplat {
+	public:
+
+		/**
+		 * \brief Singleton instance of the DensitySplat-class.
+		 */
+		static DensitySplat* Instance();
+
+
+		/**
+		 * \brief Splat the given bodies (has to be called once, before the first frame).
+		 *
+		 * \param objects
+		 *      Bodies which are splatted (their transformations are read by each update).
+		 * \param meshRoots
+		 *      Nodes which draw the models of the bodies (hidden while the splats are shown).
+		 */
+		void init(const std::vector<SpaceObject*> &objects, const std::vector<osg::ref_ptr<osg::Node> > &meshRoots);
+
+
+		/**
+		 * \brief Write the positions of the bodies and apply the mode of the last cull-traversal (called by the
+		 *        update-callback).
+		 */
+		void update();
+
+
+		/**
+		 * \brief Select the mode from the projected size of a sample of the bodies (called by the cull-callback).
+		 *
+		 * \param modelView
+		 *      Model-view-matrix of the splats (the positions are global).
+		 * \param projection
+		 *      Projection-matrix of the camera.
+		 * \param width, height
+		 *      Size of the viewport of the camera.
+		 */
+		void cull(const osg::Matrix &modelView, const osg::Matrix &projection, int width, int height);
+
+
+		/**
+		 * \brief Get the root-node which contains the accumulation and the tone-mapping.
+		 *
+		 * \return Root-node of the splats.
+		 */
+		osg::ref_ptr<osg::Group> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Set the scale of the resolution of the accumulation-target.
+		 *
+		 * \param resolution
+		 *      Fraction of the width and the height of the window.
+		 */
+		void setResolution(double resolution) {
+			_resolution = std::max(0.1, std::min(resolution, 1.0));
+		}
+
+
+		/**
+		 * \brief Set the exposure of the tone-mapping.
+		 *
+		 * \param exposure
+		 *      Factor of the accumulated density (higher value => brighter core).
+		 */
+		void setExposure(float exposure) {
+			_exposure = std::max(exposure, 0.0f);
+		}
+
+
+		/**
+		 * \brief Get if the bodies are currently drawn as splats.
+		 *
+		 * \return True if the models are hidden.
+		 */
+		bool getIsSplatted() const {
+			return _isSplatted;
+		}
+
+
+		/**
+		 * \brief Enable or disable the density-splats. Has to be set before the scene is loaded.
+		 *
+		 * \param isEnabled
+		 *      True if the bodies are splatted once they are smaller than a pixel.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the density-splats are enabled.
+		 *
+		 * \return True if the bodies are splatted once they are smaller than a pixel.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+
+		//! True if the bodies are splatted once they are smaller than a pixel
+		static bool IS_ENABLED;
+
+		//! Maximum number of bodies whose projected size is measured per frame
+		static const unsigned int SAMPLE_SIZE;
+		//! Projected diameter below which a body counts as smaller than a pixel: unit = pixels
+		static const double PIXEL_SIZE;
+		//! Fraction of the sampled bodies below a pixel which switches to the splats
+		static const double SPLAT_FRACTION;
+		//! Fraction of the sampled bodies below a pixel which switches back to the models
+		static const double MESH_FRACTION;
+		//! Upper bound of the weight of a body (relative to the mean mass, so a sun does not saturate the field)
+		static const float MAX_WEIGHT;
+
+		//! Splatted bodies
+		std::vector<SpaceObject*> _objects;
+		//! Weight of each body (relative to the mean mass)
+		std::vector<float> _weights;
+		//! Nodes which draw the models of the bodies
+		std::vector<osg::ref_ptr<osg::Node> > _meshRoots;
+
+		//! Accumulation and tone-mapping
+		osg::ref_ptr<osg::Group> _root;
+		//! Camera which splats the bodies into the target
+		osg::ref_ptr<osg::Camera> _accumulationCamera;
+		//! Camera which draws the tone-mapped target over the window
+		osg::ref_ptr<osg::Camera> _toneMapCamera;
+		//! HDR-target of the density
+		osg::ref_ptr<osg::Texture2D> _target;
+		//! Point per body
+		osg::ref_ptr<osg::Geometry> _points;
+		//! Positions of the bodies
+		osg::ref_ptr<osg::Vec3Array> _positions;
+		//! Radius and weight of the bodies
+		osg::ref_ptr<osg::Vec2Array> _sizes;
+		//! Height of the target for the size of the sprites
+		osg::ref_ptr<osg::Uniform> _viewportHeightUniform;
+		//! Rendered part of the target for the tone-mapping
+		osg::ref_ptr<osg::Uniform> _scaleUniform;
+		//! Exposure of the tone-mapping
+		osg::ref_ptr<osg::Uniform> _exposureUniform;
+
+		//! Size of the target
+		int _targetWidth = 0, _targetHeight = 0;
+		//! Size of the window of the last cull-traversal
+		int _windowWidth = 0, _windowHeight = 0;
+
+		//! Scale of the resolution of the target
+		double _resolution = 0.5;
+		//! Exposure of the tone-mapping
+		float _exposure = 1.0f;
+		//! Mode which is applied by the next update (written by the cull-traversal)
+		bool _isSplatRequested = false;
+		//! Mode of the scene-graph
+		bool _isSplatted = false;
+		//! First sampled body of the next cull-traversal (the sample rotates through all bodies)
+		unsigned int _sampleOffset = 0;
+
+
+		/**
+		 * \brief Show the splats or the models.
+		 *
+		 * \param isSplatted
+		 *      True if the models are hidden and the splats are shown.
+		 */
+		void applyMode(bool isSplatted);
+
+
+		/**
+		 * \brief Reallocate the target for another size of the window.
+		 *
+		 * \param width, height
+		 *      Size of the window.
+		 */
+		void resize(int width, int height);
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		DensitySplat() = default;
+
+		//! Private copy-constructor to prevent copying the class.
+		DensitySplat(DensitySplat const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		DensitySplat& operator=(DensitySplat const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static DensitySplat* _pInstance;
+	};
+}
@@ -0,0 +1,61 @@
+﻿/**
+ * \brief Functionality for dispatching a compute-shader during the draw-traversal.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "DispatchDrawable.h"
+
+#include <osg/GLExtensions>
+#include <osg/State>
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor of the dispatch.
+ *
+ * \param cntGroups
+ *      Number of work-groups.
+ * \param barriers
+ *      Barrier-bits of the memory-barrier after the dispatch.
+ */
+DispatchDrawable::DispatchDrawable(unsigned int cntGroups, GLbitfield barriers) : _cntGroups(cntGroups), _barriers(barriers) {
+	setUseDisplayList(false);
+	setUseVertexBufferObjects(false);
+	setCullingActive(false);
+}
+
+
+/**
+ * \brief Copy-constructor (needed by META_Object).
+ */
+DispatchDrawable::DispatchDrawable(const DispatchDrawable &other, const osg::CopyOp &copyop)
+	: osg::Drawable(other, copyop), _cntGroups(other._cntGroups), _barriers(other._barriers) {}
+
+
+/**
+ * \brief Dispatch the compute-shader and wait for its writes.
+ *
+ * \param renderInfo
+ *      Render-info of the draw-traversal.
+ */
+void DispatchDrawable::drawImplementation(osg::RenderInfo &renderInfo) const {
+	const osg::GLExtensions* extensions = renderInfo.getState()->get<osg::GLExtensions>();
+
+	extensions->glDispatchCompute(_cntGroups, 1, 1);
+	// the next pass and the vertex-shaders read the written buffers
+	extensions->glMemoryBarrier(_barriers);
+}
+
+
+/**
+ * \brief Get the bounding-box of the dispatch (not related to the buffers, only has to be valid to pass the
+ *        cull-traversal).
+ *
+ * \return Unit-box at the origin.
+ */
+osg::BoundingBox DispatchDrawable::computeBoundingBox() const {
+	return osg::BoundingBox(-1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f);
+}
@@ -0,0 +1,88 @@
+﻿/**
+ * \brief Functionality for dispatching a compute-shader during the draw-traversal.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <osg/Drawable>
+#include <osg/GL>
+
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief DispatchDrawable dispatches the compute-shader of its state-set (instead of drawing anything). The
+	 * dispatch is ordered by the render-bin of the state-set and is followed by a memory-barrier, so the next passes
+	 * and draws read the written buffers.
+	 */
+	class DispatchDrawable : public osg::Drawable {
+	public:
+
+		/**
+		 * \brief Constructor of the dispatch.
+		 *
+		 * \param cntGroups
+		 *      Number of work-groups.
+		 * \param barriers
+		 *      Barrier-bits of the memory-barrier after the dispatch.
+		 */
+		explicit DispatchDrawable(unsigned int cntGroups = 1, GLbitfield barriers = GL_SHADER_STORAGE_BARRIER_BIT);
+
+
+		/**
+		 * \brief Copy-constructor (needed by META_Object).
+		 */
+		DispatchDrawable(const DispatchDrawable &other, const osg::CopyOp &copyop = osg::CopyOp::SHALLOW_COPY);
+
+		META_Object(pbs17, DispatchDrawable);
+
+
+		/**
+		 * \brief Set the number of work-groups of the next dispatches.
+		 *
+		 * \param cntGroups
+		 *      Number of work-groups.
+		 */
+		void setNumGroups(unsigned int cntGroups) {
+			_cntGroups = cntGroups;
+		}
+
+
+		/**
+		 * \brief Dispatch the compute-shader and wait for its writes.
+		 *
+		 * \param renderInfo
+		 *      Render-info of the draw-traversal.
+		 */
+		void drawImplementation(osg::RenderInfo &renderInfo) const override;
+
+
+		/**
+		 * \brief Get the bounding-box of the dispatch (not related to the buffers, only has to be valid to pass the
+		 *        cull-traversal).
+		 *
+		 * \return Unit-box at the origin.
+		 */
+		osg::BoundingBox computeBoundingBox() const override;
+
+
+	private:
+
+		//! Number of work-groups
+		unsigned int _cntGroups;
+
+		//! Barrier-bits of the memory-barrier after the dispatch
+		GLbitfield _barriers;
+	};
+}
@@ -0,0 +1,205 @@
+﻿/**
+ * \brief Functionality for rendering the scene with a dynamically scaled resolution.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "DynamicResolution.h"
+
+#include <cmath>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeCallback>
+#include <osg/Stats>
+
+#include "shaders/UpscaleShader.h"
+#include "../physics/Profiler.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Selects the scale of the next frame during the update-traversal.
+	 */
+	class DynamicResolutionCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			DynamicResolution::Instance()->update();
+			traverse(node, nv);
+		}
+	};
+}
+
+
+//! Pointer to the only instance of this class.
+DynamicResolution* DynamicResolution::_pInstance = nullptr;
+
+//! Disabled by default, rendered directly into the window.
+bool DynamicResolution::IS_ENABLED = false;
+
+//! The timer-queries of the viewer are read back two or three frames later.
+const unsigned int DynamicResolution::INTERVAL = 8;
+//! Half of the way per adjustment, so a single slow frame does not halve the resolution.
+const double DynamicResolution::DAMPING = 0.5;
+//! Steps of 1/64 of the window.
+const double DynamicResolution::QUANTIZATION = 64.0;
+
+
+/**
+ * \brief Singleton instance of the DynamicResolution-class.
+ */
+DynamicResolution* DynamicResolution::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new DynamicResolution();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Render the scene of the viewer into the offscreen-target (has to be called once, before the viewer is
+ *        realized).
+ *
+ * \param viewer
+ *      Viewer whose camera measures the GPU-time and draws the upscaled target.
+ * \param scene
+ *      Scene which is rendered with the scaled resolution.
+ *
+ * \return Root which replaces the scene-data of the viewer.
+ */
+osg::ref_ptr<osg::Group> DynamicResolution::attach(osgViewer::Viewer* viewer, osg::ref_ptr<osg::Node> scene) {
+	_camera = viewer->getCamera();
+	if (_camera->getStats()) {
+		_camera->getStats()->collectStats("gpu", true);
+	}
+
+	// the window of the viewer exists already, its size is the size of the target
+	const osg::Viewport* viewport = _camera->getViewport();
+	_targetWidth = viewport ? static_cast<int>(viewport->width()) : 1000;
+	_targetHeight = viewport ? static_cast<int>(viewport->height()) : 600;
+
+	_target = new osg::Texture2D;
+	_target->setTextureSize(_targetWidth, _targetHeight);
+	_target->setInternalFormat(GL_RGBA8);
+	_target->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+	_target->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+	_target->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+	_target->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+
+	// the offscreen-camera inherits the view and the projection of the manipulated camera
+	_offscreenCamera = new osg::Camera;
+	_offscreenCamera->setReferenceFrame(osg::Transform::RELATIVE_RF);
+	_offscreenCamera->setViewMatrix(osg::Matrix::identity());
+	_offscreenCamera->setProjectionMatrix(osg::Matrix::identity());
+	_offscreenCamera->setRenderOrder(osg::Camera::PRE_RENDER);
+	_offscreenCamera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+	_offscreenCamera->attach(osg::Camera::COLOR_BUFFER, _target.get());
+	_offscreenCamera->attach(osg::Camera::DEPTH_BUFFER, GL_DEPTH_COMPONENT24);
+	_offscreenCamera->setClearColor(_camera->getClearColor());
+	_offscreenCamera->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	_offscreenCamera->setViewport(0, 0, _targetWidth, _targetHeight);
+	_offscreenCamera->addChild(scene);
+
+	_scaleUniform = new osg::Uniform("scale", osg::Vec2(1.0f, 1.0f));
+	_scaleUniform->setDataVariance(osg::Object::DYNAMIC);
+	_texelSizeUniform = new osg::Uniform("texelSize", osg::Vec2(1.0f / _targetWidth, 1.0f / _targetHeight));
+	_texelSizeUniform->setDataVariance(osg::Object::DYNAMIC);
+	_sharpnessUniform = new osg::Uniform("sharpness", 0.0f);
+	_sharpnessUniform->setDataVariance(osg::Object::DYNAMIC);
+
+	// one quad over the whole window draws the rendered part of the target
+	osg::ref_ptr<osg::Geode> quad = new osg::Geode;
+	quad->addDrawable(osg::createTexturedQuadGeometry(osg::Vec3(0.0f, 0.0f, 0.0f), osg::Vec3(1.0f, 0.0f, 0.0f), osg::Vec3(0.0f, 1.0f, 0.0f)));
+	quad->setCullingActive(false);
+	UpscaleShader shader(_target, _scaleUniform, _texelSizeUniform, _sharpnessUniform);
+	shader.apply(quad);
+
+	osg::StateSet* state = quad->getOrCreateStateSet();
+	state->setMode(GL_LIGHTING, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
+	state->setMode(GL_DEPTH_TEST, osg::StateAttribute::OFF);
+
+	osg::ref_ptr<osg::Camera> upscaleCamera = new osg::Camera;
+	upscaleCamera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+	upscaleCamera->setProjectionMatrixAsOrtho2D(0.0, 1.0, 0.0, 1.0);
+	upscaleCamera->setViewMatrix(osg::Matrix::identity());
+	upscaleCamera->setClearMask(0);
+	upscaleCamera->setRenderOrder(osg::Camera::NESTED_RENDER);
+	upscaleCamera->setAllowEventFocus(false);
+	upscaleCamera->addChild(quad);
+
+	osg::ref_ptr<osg::Group> root = new osg::Group;
+	root->addChild(_offscreenCamera);
+	root->addChild(upscaleCamera);
+	root->setUpdateCallback(new DynamicResolutionCallback);
+
+	return root;
+}
+
+
+/**
+ * \brief Select the scale of the next frame from the measured GPU-time (called by the update-callback).
+ */
+void DynamicResolution::update() {
+	if (!_camera.valid()) return;
+
+	const osg::Viewport* viewport = _camera->getViewport();
+	if (!viewport) return;
+
+	int width = std::max(static_cast<int>(viewport->width()), 1);
+	int height = std::max(static_cast<int>(viewport->height()), 1);
+	if (width > _targetWidth || height > _targetHeight) {
+		resize(width, height);
+	}
+
+	// the newest frame whose timer-query has been read back
+	osg::Stats* stats = _camera->getStats();
+	if (++_cntFrames >= INTERVAL && stats) {
+		double gpuTime = 0.0;
+		unsigned int frame = stats->getLatestFrameNumber();
+		for (unsigned int i = 0; i < 4 && frame >= stats->getEarliestFrameNumber(); ++i, --frame) {
+			if (stats->getAttribute(frame, "GPU draw time taken", gpuTime)) break;
+		}
+
+		// the shaded pixels grow with the square of the scale
+		if (gpuTime > 0.0) {
+			double scale = _scale * std::sqrt(_targetGpuTime / gpuTime);
+			scale = std::max(_minScale, std::min(_scale + DAMPING * (scale - _scale), 1.0));
+			_scale = std::floor(scale * QUANTIZATION + 0.5) / QUANTIZATION;
+			_cntFrames = 0;
+		}
+	}
+
+	int scaledWidth = std::max(static_cast<int>(width * _scale + 0.5), 1);
+	int scaledHeight = std::max(static_cast<int>(height * _scale + 0.5), 1);
+	_offscreenCamera->setViewport(0, 0, scaledWidth, scaledHeight);
+	_scaleUniform->set(osg::Vec2(static_cast<float>(scaledWidth) / _targetWidth, static_cast<float>(scaledHeight) / _targetHeight));
+
+	// the native resolution is not sharpened
+	_sharpnessUniform->set(_sharpness * static_cast<float>(std::min(4.0 * (1.0 - _scale), 1.0)));
+
+	Profiler::Instance()->count(Profiler::RENDER_SCALE, _scale);
+}
+
+
+/**
+ * \brief Reallocate the target for a bigger window.
+ *
+ * \param width, height
+ *      Size of the window.
+ */
+void DynamicResolution::resize(int width, int height) {
+	_targetWidth = std::max(width, _targetWidth);
+	_targetHeight = std::max(height, _targetHeight);
+
+	// the frame-buffer-object is attached again with the new texture-object
+	_target->setTextureSize(_targetWidth, _targetHeight);
+	_target->dirtyTextureObject();
+	_offscreenCamera->dirtyAttachmentMap();
+	_texelSizeUniform->set(osg::Vec2(1.0f / _targetWidth, 1.0f / _targetHeight));
+}
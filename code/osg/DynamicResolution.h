@@ -0,0 +1,183 @@
+﻿/**
+ * \brief Functionality for rendering the scene with a dynamically scaled resolution.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <algorithm>
+
+#include <osg/Camera>
+#include <osg/Group>
+#include <osg/Texture2D>
+#include <osg/Uniform>
+#include <osgViewer/Viewer>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief DynamicResolution renders the scene into an offscreen-target (FBO) instead of the window, so the number
+	 * of the shaded pixels follows the measured GPU-time: The GPU-time of the camera (timer-queries of the viewer) is
+	 * compared with the target every few frames and the scale of the resolution is moved towards the scale which would
+	 * hold it (the pixels grow with the square of the scale). The rendered part of the target is upscaled to the whole
+	 * window and sharpened (see UpscaleShader). The target keeps the size of the window, only the viewport of the
+	 * offscreen-camera is scaled, so a new scale does not reallocate anything.
+	 */
+	class DynamicResolution {
+	public:
+
+		/**
+		 * \brief Singleton instance of the DynamicResolution-class.
+		 */
+		static DynamicResolution* Instance();
+
+
+		/**
+		 * \brief Render the scene of the viewer into the offscreen-target (has to be called once, before the viewer is
+		 *        realized).
+		 *
+		 * \param viewer
+		 *      Viewer whose camera measures the GPU-time and draws the upscaled target.
+		 * \param scene
+		 *      Scene which is rendered with the scaled resolution.
+		 *
+		 * \return Root which replaces the scene-data of the viewer.
+		 */
+		osg::ref_ptr<osg::Group> attach(osgViewer::Viewer* viewer, osg::ref_ptr<osg::Node> scene);
+
+
+		/**
+		 * \brief Select the scale of the next frame from the measured GPU-time (called by the update-callback).
+		 */
+		void update();
+
+
+		/**
+		 * \brief Set the GPU-time which should be held.
+		 *
+		 * \param targetGpuTime
+		 *      GPU-time of a frame: unit = s
+		 */
+		void setTargetGpuTime(double targetGpuTime) {
+			_targetGpuTime = targetGpuTime;
+		}
+
+
+		/**
+		 * \brief Set the lowest scale of the resolution.
+		 *
+		 * \param minScale
+		 *      Smallest fraction of the width and the height of the window.
+		 */
+		void setMinScale(double minScale) {
+			_minScale = std::max(0.1, std::min(minScale, 1.0));
+		}
+
+
+		/**
+		 * \brief Set the strength of the sharpening of the upscaled target (faded out towards the native resolution).
+		 *
+		 * \param sharpness
+		 *      Strength of the sharpening (0 => bilinear only).
+		 */
+		void setSharpness(float sharpness) {
+			_sharpness = std::max(sharpness, 0.0f);
+		}
+
+
+		/**
+		 * \brief Get the current scale of the resolution.
+		 *
+		 * \return Fraction of the width and the height of the window.
+		 */
+		double getScale() const {
+			return _scale;
+		}
+
+
+		/**
+		 * \brief Enable or disable the dynamic resolution. Has to be set before the viewer is created.
+		 *
+		 * \param isEnabled
+		 *      True if the scene is rendered into the scaled offscreen-target.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the dynamic resolution is enabled.
+		 *
+		 * \return True if the scene is rendered into the scaled offscreen-target.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+
+		//! True if the scene is rendered into the scaled offscreen-target
+		static bool IS_ENABLED;
+
+		//! Frames between two adjustments of the scale (the timer-queries arrive a few frames late)
+		static const unsigned int INTERVAL;
+		//! Fraction of the way to the scale which would hold the target per adjustment
+		static const double DAMPING;
+		//! Steps of the scale (a tiny change does not move the viewport every time)
+		static const double QUANTIZATION;
+
+		//! Camera of the viewer (measures the GPU-time, draws the upscaled target)
+		osg::ref_ptr<osg::Camera> _camera;
+		//! Camera which renders the scene into the target
+		osg::ref_ptr<osg::Camera> _offscreenCamera;
+		//! Color of the offscreen-target
+		osg::ref_ptr<osg::Texture2D> _target;
+		//! Rendered part of the target for the shader
+		osg::ref_ptr<osg::Uniform> _scaleUniform;
+		//! Size of a texel of the target for the shader
+		osg::ref_ptr<osg::Uniform> _texelSizeUniform;
+		//! Strength of the sharpening for the shader
+		osg::ref_ptr<osg::Uniform> _sharpnessUniform;
+
+		//! Size of the target
+		int _targetWidth = 0, _targetHeight = 0;
+
+		//! GPU-time which should be held: unit = s
+		double _targetGpuTime = 1.0 / 60.0;
+		//! Lowest scale of the resolution
+		double _minScale = 0.5;
+		//! Strength of the sharpening
+		float _sharpness = 0.3f;
+		//! Current scale of the resolution
+		double _scale = 1.0;
+		//! Frames since the last adjustment
+		unsigned int _cntFrames = 0;
+
+
+		/**
+		 * \brief Reallocate the target for a bigger window.
+		 *
+		 * \param width, height
+		 *      Size of the window.
+		 */
+		void resize(int width, int height);
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		DynamicResolution() = default;
+
+		//! Private copy-constructor to prevent copying the class.
+		DynamicResolution(DynamicResolution const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		DynamicResolution& operator=(DynamicResolution const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static DynamicResolution* _pInstance;
+	};
+}
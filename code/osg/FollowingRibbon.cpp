@@ -8,10 +8,50 @@
 #include "FollowingRibbon.h"
 
 #include <osg/Geometry>
+#include <osg/GLExtensions>
+#include <osg/State>
+
+#include "UploadRing.h"
 
 using namespace pbs17;
 
 
+namespace {
+
+	/**
+	 * \brief Uploads the new segments of the ribbon before the geometry is drawn.
+	 */
+	class RibbonDrawCallback : public osg::Drawable::DrawCallback {
+	public:
+		explicit RibbonDrawCallback(FollowingRibbon* ribbon) : _ribbon(ribbon) {}
+
+		void drawImplementation(osg::RenderInfo &renderInfo, const osg::Drawable* drawable) const override {
+			_ribbon->uploadSegments(renderInfo);
+			drawable->drawImplementation(renderInfo);
+		}
+
+	private:
+		FollowingRibbon* _ribbon;
+	};
+
+
+	/**
+	 * \brief The geometry is bounded by all segments which have been written (without visiting the vertices).
+	 */
+	class RibbonBoundCallback : public osg::Drawable::ComputeBoundingBoxCallback {
+	public:
+		explicit RibbonBoundCallback(const FollowingRibbon* ribbon) : _ribbon(ribbon) {}
+
+		osg::BoundingBox computeBound(const osg::Drawable &) const override {
+			return _ribbon->getBound();
+		}
+
+	private:
+		const FollowingRibbon* _ribbon;
+	};
+}
+
+
 /**
  *\brief Default constructor. When this is used, don't forget to set up the textures with CSkyBox::setEnvironmentMap.
  */
@@ -24,34 +64,98 @@ FollowingRibbon::FollowingRibbon() {}
 osg::Geometry* FollowingRibbon::init(osg::Vec3 startPosition, osg::Vec3 color, unsigned int numPoints, float halfWidth) {
 	_numPoints = numPoints;
 	_halfWidth = halfWidth;
+	_numSegments = _numPoints / 2;
+	_head = 0;
 
-	_vertices =	new osg::Vec3Array(_numPoints);
-	_normals = new osg::Vec3Array(_numPoints);
-	_colors = new osg::Vec4Array(_numPoints);
-
+	// one more segment for the copy of the first one, the colour and the fading are set by the shader
 	_origin = startPosition;
-	_normal = osg::Vec3(0.0f, 0.0f, 1.0f);
-
-	for (unsigned int i = 0; i<_numPoints - 1; i += 2) {
-		(*_vertices)[i] = _origin; (*_vertices)[i + 1] = _origin;
-		(*_normals)[i] = _normal; (*_normals)[i + 1] = _normal;
-		float alpha = sinf(osg::PI * static_cast<float>(i) / static_cast<float>(_numPoints));
-		(*_colors)[i] = osg::Vec4(color, alpha);
-		(*_colors)[i + 1] = osg::Vec4(color, alpha);
-	}
+	_vertices = new osg::Vec3Array(2 * (_numSegments + 1), _origin);
+	_vertices->setDataVariance(osg::Object::DYNAMIC);
+	_bound.init();
+	_bound.expandBy(_origin);
+	_headUniform = new osg::Uniform("head", static_cast<int>(_head));
+	_headUniform->setDataVariance(osg::Object::DYNAMIC);
+
+	_older = new osg::DrawArrays(GL_QUAD_STRIP, 2 * (_head + 1), 2 * (_numSegments - _head));
+	_newer = new osg::DrawArrays(GL_QUAD_STRIP, 0, 2 * (_head + 1));
 
 	osg::ref_ptr<osg::Geometry> geom = new osg::Geometry;
 	geom->setDataVariance(osg::Object::DYNAMIC);
 	geom->setUseDisplayList(false);
 	geom->setUseVertexBufferObjects(true);
-	
+	geom->setDrawCallback(new RibbonDrawCallback(this));
+	geom->setComputeBoundingBoxCallback(new RibbonBoundCallback(this));
+
 	geom->setVertexArray(_vertices.get());
-	geom->setNormalArray(_normals.get());
-	geom->setNormalBinding(osg::Geometry::BIND_PER_VERTEX);
-	geom->setColorArray(_colors.get());
-	geom->setColorBinding(osg::Geometry::BIND_PER_VERTEX);
-	geom->addPrimitiveSet(new osg::DrawArrays(GL_QUAD_STRIP, 0, _numPoints));
+	geom->addPrimitiveSet(_older.get());
+	geom->addPrimitiveSet(_newer.get());
 
 	return geom.release();
 }
 
+
+/**
+ * \brief Overwrite the oldest segment with the current position of the object.
+ *
+ * \param left, right
+ *      Vertices of the new segment.
+ */
+void FollowingRibbon::addSegment(const osg::Vec3 &left, const osg::Vec3 &right) {
+	_head = (_head + 1) % _numSegments;
+
+	(*_vertices)[2 * _head] = left;
+	(*_vertices)[2 * _head + 1] = right;
+	_dirtySegments.push_back(_head);
+
+	// the last segment closes the ring
+	if (_head == 0) {
+		(*_vertices)[2 * _numSegments] = left;
+		(*_vertices)[2 * _numSegments + 1] = right;
+		_dirtySegments.push_back(_numSegments);
+	}
+
+	_older->setFirst(2 * (_head + 1));
+	_older->setCount(2 * (_numSegments - _head));
+	_newer->setCount(2 * (_head + 1));
+	_headUniform->set(static_cast<int>(_head));
+
+	_bound.expandBy(left);
+	_bound.expandBy(right);
+}
+
+
+/**
+ * \brief Upload the segments which have been written since the last call into the VBO (called by the
+ * draw-callback of the geometry before it's drawn).
+ *
+ * \param renderInfo
+ *      Render-info of the current context.
+ */
+void FollowingRibbon::uploadSegments(osg::RenderInfo &renderInfo) {
+	if (_dirtySegments.empty()) {
+		return;
+	}
+
+	osg::State* state = renderInfo.getState();
+	osg::GLBufferObject* glBufferObject = _vertices->getOrCreateGLBufferObject(state->getContextID());
+
+	// the whole array is uploaded by osg if the buffer has not been compiled yet
+	if (glBufferObject && !glBufferObject->isDirty()) {
+		osg::GLExtensions* extensions = state->get<osg::GLExtensions>();
+		state->bindVertexBufferObject(glBufferObject);
+
+		GLintptr offset = glBufferObject->getOffset(_vertices->getBufferIndex());
+		GLsizeiptr size = 2 * sizeof(osg::Vec3);
+
+		for (unsigned int i = 0; i < _dirtySegments.size(); ++i) {
+			unsigned int segment = _dirtySegments[i];
+			const osg::Vec3* vertices = &(*_vertices)[2 * segment];
+
+			if (!UploadRing::Instance()->bufferSubData(*state, glBufferObject->getGLObjectID(), offset + segment * size, vertices, size)) {
+				extensions->glBufferSubData(GL_ARRAY_BUFFER_ARB, offset + segment * size, size, vertices);
+			}
+		}
+	}
+
+	_dirtySegments.clear();
+}
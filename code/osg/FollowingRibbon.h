@@ -7,15 +7,20 @@
 
 #pragma once
 
+#include <vector>
+
 #include <osg/Transform>
 #include <osg/Geometry>
+#include <osg/Uniform>
 
 
 namespace pbs17 {
 
 	/**
-	 * \brief The SkyBox representate the implementation for a cubemap for the sky visualisation.
-	 * This class generates a box and applies the 6 different textures in a way that the user has the feeling to watch on a common environment.
+	 * \brief The FollowingRibbon stores the trace of a space-object as a ring-buffer of segments (two vertices each).
+	 * A new segment overwrites the oldest one at the head, only the written segments are uploaded into the VBO and the
+	 * age of a segment (fading) is computed by the RibbonShader from the head. The ring is drawn as two quad-strips
+	 * (oldest to last segment and first segment to head), the last segment is a copy of the first one.
 	 */
 	class FollowingRibbon {
 	public:
@@ -32,6 +37,26 @@ namespace pbs17 {
 		 */
 		osg::Geometry* init(osg::Vec3 startPosition, osg::Vec3 color, unsigned int numPoints, float halfWidth);
 
+
+		/**
+		 * \brief Overwrite the oldest segment with the current position of the object.
+		 *
+		 * \param left, right
+		 *      Vertices of the new segment.
+		 */
+		void addSegment(const osg::Vec3 &left, const osg::Vec3 &right);
+
+
+		/**
+		 * \brief Upload the segments which have been written since the last call into the VBO (called by the
+		 * draw-callback of the geometry before it's drawn).
+		 *
+		 * \param renderInfo
+		 *      Render-info of the current context.
+		 */
+		void uploadSegments(osg::RenderInfo &renderInfo);
+
+
 		unsigned int getNumPoints() const {
 			return _numPoints;
 		}
@@ -40,16 +65,40 @@ namespace pbs17 {
 			return _halfWidth;
 		}
 
+		unsigned int getNumSegments() const {
+			return _numSegments;
+		}
+
+		osg::ref_ptr<osg::Uniform> getHeadUniform() const {
+			return _headUniform;
+		}
+
+		const osg::BoundingBox& getBound() const {
+			return _bound;
+		}
+
 
 	private:
 
 		unsigned int _numPoints = 800;
 		float _halfWidth = 0.5f;
 
+		//! Number of segments in the ring (without the copy of the first one)
+		unsigned int _numSegments = 400;
+		//! Index of the newest segment
+		unsigned int _head = 0;
+		//! Segments which have been written since the last upload
+		std::vector<unsigned int> _dirtySegments;
+		//! Index of the newest segment for the shader
+		osg::ref_ptr<osg::Uniform> _headUniform;
+		//! Bounding-box of all segments which have been written (grows only)
+		osg::BoundingBox _bound;
+
 		osg::ref_ptr<osg::Vec3Array> _vertices;
-		osg::ref_ptr<osg::Vec3Array> _normals;
-		osg::ref_ptr<osg::Vec4Array> _colors;
+		//! Quad-strip from the oldest segment to the copy of the first one
+		osg::ref_ptr<osg::DrawArrays> _older;
+		//! Quad-strip from the first segment to the newest one
+		osg::ref_ptr<osg::DrawArrays> _newer;
 		osg::Vec3 _origin = osg::Vec3(0.0f, 0.0f, 0.0f);
-		osg::Vec3 _normal = osg::Vec3(0.0f, 0.0f, 1.0f);
 	};
 }
@@ -0,0 +1,247 @@
+﻿/**
+ * \brief Functionality for holding a target frame-time by trading the fidelity of the simulation and the rendering.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "FrameGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include <OpenThreads/ScopedLock>
+
+#include "StatsOverlay.h"
+#include "TrailSystem.h"
+#include "particles/GpuParticleSystem.h"
+#include "../physics/SimulationManager.h"
+#include "../physics/Profiler.h"
+#include "../physics/Logger.h"
+
+using namespace pbs17;
+
+
+//! Four steps from the configured value to the limit
+const double FrameGovernor::STEP = 0.25;
+//! A few frames even at low framerates, but fast enough to react within a second
+const double FrameGovernor::WINDOW = 0.5;
+//! The raised knob should not immediately be lowered again
+const double FrameGovernor::SLOWER = 1.05;
+const double FrameGovernor::FASTER = 0.8;
+//! Fits below the counters of the HUD
+const unsigned int FrameGovernor::CNT_REPORTED = 5;
+
+
+/**
+ * \brief Constructor of the governor (the current values of the knobs are the highest fidelity).
+ *
+ * \param camera
+ *      Camera whose LOD-scale is adjusted.
+ * \param simulationManager
+ *      Simulation whose opening angle and collision-substeps are adjusted.
+ * \param targetFrameTime
+ *      Frame-time which should be held: unit = s
+ * \param limits
+ *      Lowest fidelity of the knobs.
+ */
+FrameGovernor::FrameGovernor(osg::Camera* camera, SimulationManager* simulationManager, double targetFrameTime, const Limits &limits)
+	: _camera(camera), _simulationManager(simulationManager), _targetFrameTime(targetFrameTime) {
+	// a limit which is above the configured fidelity does not change the knob (nor does a solver without a theta)
+	_highest[THETA] = simulationManager->getTheta();
+	_lowest[THETA] = _highest[THETA] > 0.0 ? std::max(limits.maxTheta, _highest[THETA]) : _highest[THETA];
+	_highest[SUBSTEPS] = simulationManager->getCollisionSubsteps();
+	_lowest[SUBSTEPS] = std::min(static_cast<double>(std::max(limits.minSubsteps, 1)), _highest[SUBSTEPS]);
+	_highest[LOD_SCALE] = camera->getLODScale();
+	_lowest[LOD_SCALE] = _highest[LOD_SCALE] * std::max(limits.maxLodScale, 1.0);
+	_highest[PARTICLE_RATE] = GpuParticleSystem::getIsEnabled() ? 1.0 : 0.0;
+	_lowest[PARTICLE_RATE] = GpuParticleSystem::getIsEnabled() ? std::max(0.0, std::min(limits.minParticleRate, 1.0)) : 0.0;
+	_highest[TRAIL_LENGTH] = TrailSystem::getIsEnabled() ? 1.0 : 0.0;
+	_lowest[TRAIL_LENGTH] = TrailSystem::getIsEnabled() ? std::max(0.0, std::min(limits.minTrailLength, 1.0)) : 0.0;
+
+	std::fill(_levels, _levels + CNT_KNOBS, 0.0);
+	StatsOverlay::Instance()->setReport(getReport());
+}
+
+
+/**
+ * \brief Add the time of a frame and adjust a knob at the end of the window (called by the main-loop).
+ *
+ * \param frameTime
+ *      Total time of the frame in seconds.
+ */
+void FrameGovernor::update(double frameTime) {
+	++_cntFrames;
+	_windowTime += frameTime;
+	++_windowFrames;
+
+	if (_windowTime < WINDOW) return;
+
+	_averageFrameTime = _windowTime / _windowFrames;
+	_windowTime = 0.0;
+	_windowFrames = 0;
+
+	if (_averageFrameTime > SLOWER * _targetFrameTime) {
+		adjust(true);
+	} else if (_averageFrameTime < FASTER * _targetFrameTime) {
+		adjust(false);
+	}
+
+	StatsOverlay::Instance()->setReport(getReport());
+}
+
+
+/**
+ * \brief Get the lines of the stats-HUD: The target, the average frame-time, the knobs and the last adjustments.
+ *
+ * \return Report of the governor.
+ */
+std::string FrameGovernor::getReport() const {
+	char line[128];
+	snprintf(line, sizeof(line), "governor: target %.1f ms, average %.1f ms\n", 1000.0 * _targetFrameTime, 1000.0 * _averageFrameTime);
+	std::string report = line;
+
+	for (int i = 0; i < CNT_KNOBS; ++i) {
+		Knob knob = static_cast<Knob>(i);
+		if (_highest[knob] == _lowest[knob]) continue;
+
+		snprintf(line, sizeof(line), "%-14s %8.3g  (%.3g .. %.3g)\n", getKnobName(knob), getValue(knob), _highest[knob], _lowest[knob]);
+		report += line;
+	}
+
+	for (auto it = _adjustments.begin(); it != _adjustments.end(); ++it) {
+		report += *it + "\n";
+	}
+
+	return report;
+}
+
+
+/**
+ * \brief Change the level of the first knob in the order which can still be changed by a step.
+ *
+ * \param isLowered
+ *      True if the fidelity is lowered, false if it's raised.
+ */
+void FrameGovernor::adjust(bool isLowered) {
+	static const Knob PHYSICS_FIRST[CNT_KNOBS] = { THETA, SUBSTEPS, LOD_SCALE, PARTICLE_RATE, TRAIL_LENGTH };
+	static const Knob RENDERING_FIRST[CNT_KNOBS] = { LOD_SCALE, PARTICLE_RATE, TRAIL_LENGTH, THETA, SUBSTEPS };
+
+	// the phases of the physics are measured on its thread too, the rest of the frame is the rendering
+	Profiler* profiler = Profiler::Instance();
+	double physicsTime = 0.0;
+	for (int i = Profiler::FORCES; i < Profiler::SCENE_SYNC; ++i) {
+		physicsTime += profiler->getPercentile(static_cast<Profiler::Phase>(i), 50.0);
+	}
+	bool isPhysicsBound = physicsTime > 0.5 * profiler->getPercentile(Profiler::CNT_PHASES, 50.0);
+
+	// the knobs are raised in the reversed order, so the cheapest fidelity comes back first
+	const Knob* order = isPhysicsBound ? PHYSICS_FIRST : RENDERING_FIRST;
+	for (int i = 0; i < CNT_KNOBS; ++i) {
+		Knob knob = order[isLowered ? i : CNT_KNOBS - 1 - i];
+		if (_highest[knob] == _lowest[knob]) continue;
+
+		// the rounded substeps may need more than one step to change
+		double before = getValue(knob);
+		double level = _levels[knob];
+		while (getValue(knob) == before) {
+			double next = std::max(0.0, std::min(_levels[knob] + (isLowered ? STEP : -STEP), 1.0));
+			if (next == _levels[knob]) break;
+			_levels[knob] = next;
+		}
+
+		if (getValue(knob) == before) {
+			_levels[knob] = level;
+			continue;
+		}
+
+		apply(knob);
+
+		char line[128];
+		snprintf(line, sizeof(line), "frame %-7lu %-14s %.3g -> %.3g (%.1f ms)", _cntFrames, getKnobName(knob), before,
+			getValue(knob), 1000.0 * _averageFrameTime);
+		LOG_INFO("Governor: " << line);
+
+		_adjustments.push_back(line);
+		if (_adjustments.size() > CNT_REPORTED) {
+			_adjustments.pop_front();
+		}
+
+		return;
+	}
+}
+
+
+/**
+ * \brief Write the value of a knob at its level into the simulation or the rendering.
+ *
+ * \param knob
+ *      Changed knob.
+ */
+void FrameGovernor::apply(Knob knob) {
+	double value = getValue(knob);
+
+	switch (knob) {
+	case THETA:
+	{
+		// the physics-thread may step at the same time
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(SimulationManager::getStateMutex());
+		_simulationManager->setTheta(value);
+		break;
+	}
+	case SUBSTEPS:
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(SimulationManager::getStateMutex());
+		_simulationManager->setCollisionSubsteps(static_cast<int>(value));
+		break;
+	}
+	case LOD_SCALE:
+		_camera->setLODScale(static_cast<float>(value));
+		break;
+	case PARTICLE_RATE:
+		GpuParticleSystem::Instance()->setRateScale(static_cast<float>(value));
+		break;
+	case TRAIL_LENGTH:
+		TrailSystem::Instance()->setLength(static_cast<float>(value));
+		break;
+	default:
+		break;
+	}
+}
+
+
+/**
+ * \brief Get the value of a knob at its level.
+ *
+ * \param knob
+ *      Knob.
+ *
+ * \return Value between the highest and the lowest fidelity.
+ */
+double FrameGovernor::getValue(Knob knob) const {
+	double value = _highest[knob] + _levels[knob] * (_lowest[knob] - _highest[knob]);
+
+	return knob == SUBSTEPS ? std::floor(value + 0.5) : value;
+}
+
+
+/**
+ * \brief Get the name of a knob.
+ *
+ * \param knob
+ *      Knob.
+ *
+ * \return Name of the knob (shown in the HUD).
+ */
+const char* FrameGovernor::getKnobName(Knob knob) {
+	switch (knob) {
+	case THETA: return "theta";
+	case SUBSTEPS: return "substeps";
+	case LOD_SCALE: return "lod scale";
+	case PARTICLE_RATE: return "particle rate";
+	case TRAIL_LENGTH: return "trail length";
+	default: return "";
+	}
+}
@@ -0,0 +1,168 @@
+﻿/**
+ * \brief Functionality for holding a target frame-time by trading the fidelity of the simulation and the rendering.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+
+#include <osg/Camera>
+
+
+// forward declarations
+namespace pbs17 {
+	class SimulationManager;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief FrameGovernor adjusts the knobs of the fidelity, so the frames hold a target frame-time on slower machines.
+	 * The frame-times are averaged over a window of half a second: If the average is too slow, one knob is lowered by
+	 * a step, if there is enough headroom, one knob is raised again (the configured values are the upper bound, the
+	 * limits of the user the lower bound). The phases of the Profiler select the order of the knobs: If the physics
+	 * takes most of the frame, its knobs (opening angle, collision-substeps) are lowered first, otherwise the knobs of
+	 * the rendering (LOD-scale, particle-rates, trail-length). Each adjustment is reported in the stats-HUD.
+	 */
+	class FrameGovernor {
+	public:
+
+		/**
+		 * \brief Limits of the knobs (the lowest fidelity which is accepted).
+		 */
+		struct Limits {
+			//! Largest opening angle of the Barnes-Hut and the fast multipole solver
+			double maxTheta = 1.2;
+			//! Smallest number of collision-substeps
+			int minSubsteps = 1;
+			//! Largest factor of the LOD-scale of the camera (larger => the coarser levels are used nearer)
+			double maxLodScale = 4.0;
+			//! Smallest fraction of the emitted particles
+			double minParticleRate = 0.25;
+			//! Smallest fraction of the drawn samples of the trails
+			double minTrailLength = 0.25;
+		};
+
+
+		/**
+		 * \brief Constructor of the governor (the current values of the knobs are the highest fidelity).
+		 *
+		 * \param camera
+		 *      Camera whose LOD-scale is adjusted.
+		 * \param simulationManager
+		 *      Simulation whose opening angle and collision-substeps are adjusted.
+		 * \param targetFrameTime
+		 *      Frame-time which should be held: unit = s
+		 * \param limits
+		 *      Lowest fidelity of the knobs.
+		 */
+		FrameGovernor(osg::Camera* camera, SimulationManager* simulationManager, double targetFrameTime, const Limits &limits);
+
+
+		/**
+		 * \brief Add the time of a frame and adjust a knob at the end of the window (called by the main-loop).
+		 *
+		 * \param frameTime
+		 *      Total time of the frame in seconds.
+		 */
+		void update(double frameTime);
+
+
+		/**
+		 * \brief Get the lines of the stats-HUD: The target, the average frame-time, the knobs and the last adjustments.
+		 *
+		 * \return Report of the governor.
+		 */
+		std::string getReport() const;
+
+
+	private:
+
+		//! Adjusted knobs
+		enum Knob {
+			THETA = 0,
+			SUBSTEPS,
+			LOD_SCALE,
+			PARTICLE_RATE,
+			TRAIL_LENGTH,
+			CNT_KNOBS
+		};
+
+		//! Change of the level of a knob per adjustment
+		static const double STEP;
+		//! Time over which the frame-times are averaged before an adjustment: unit = s
+		static const double WINDOW;
+		//! Factors of the target above which a knob is lowered and below which a knob is raised
+		static const double SLOWER, FASTER;
+		//! Number of adjustments shown in the HUD
+		static const unsigned int CNT_REPORTED;
+
+		//! Camera whose LOD-scale is adjusted
+		osg::ref_ptr<osg::Camera> _camera;
+		//! Simulation whose opening angle and collision-substeps are adjusted
+		SimulationManager* _simulationManager;
+		//! Frame-time which should be held
+		double _targetFrameTime;
+
+		//! Values of the knobs at the highest (configured) and at the lowest fidelity (limit)
+		double _highest[CNT_KNOBS], _lowest[CNT_KNOBS];
+		//! Level of the knobs between the highest (0) and the lowest fidelity (1)
+		double _levels[CNT_KNOBS];
+
+		//! Time and number of the frames of the current window
+		double _windowTime = 0.0;
+		unsigned int _windowFrames = 0;
+		//! Average frame-time of the last window
+		double _averageFrameTime = 0.0;
+		//! Frames since the start
+		unsigned long _cntFrames = 0;
+
+		//! Last adjustments (newest at the back)
+		std::deque<std::string> _adjustments;
+
+
+		/**
+		 * \brief Change the level of the first knob in the order which can still be changed by a step.
+		 *
+		 * \param isLowered
+		 *      True if the fidelity is lowered, false if it's raised.
+		 */
+		void adjust(bool isLowered);
+
+
+		/**
+		 * \brief Write the value of a knob at its level into the simulation or the rendering.
+		 *
+		 * \param knob
+		 *      Changed knob.
+		 */
+		void apply(Knob knob);
+
+
+		/**
+		 * \brief Get the value of a knob at its level.
+		 *
+		 * \param knob
+		 *      Knob.
+		 *
+		 * \return Value between the highest and the lowest fidelity.
+		 */
+		double getValue(Knob knob) const;
+
+
+		/**
+		 * \brief Get the name of a knob.
+		 *
+		 * \param knob
+		 *      Knob.
+		 *
+		 * \return Name of the knob (shown in the HUD).
+		 */
+		static const char* getKnobName(Knob knob);
+	};
+}
@@ -0,0 +1,258 @@
+﻿/**
+ * \brief Implementation of the thread which encodes and writes the captured frames.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-22
+ */
+
+#include "FrameWriterThread.h"
+#include "../physics/Logger.h"
+#include "../physics/ThreadBudget.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <osgDB/WriteFile>
+#include <OpenThreads/ScopedLock>
+
+using namespace pbs17;
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+
+namespace {
+
+	/**
+	 * \brief Get the absolute path of a file (the paths of the list of ffmpeg are relative to the list).
+	 */
+	std::string getAbsolutePath(const std::string &path) {
+#if defined(_WIN32)
+		char* absolute = _fullpath(nullptr, path.c_str(), 0);
+#else
+		char* absolute = realpath(path.c_str(), nullptr);
+#endif
+		if (!absolute) {
+			return path;
+		}
+
+		std::string result(absolute);
+		free(absolute);
+		return result;
+	}
+}
+
+
+/**
+ * \brief Constructor of the writer-thread.
+ *
+ * \param maxQueueSize
+ *      Number of frames which can wait for the writer.
+ * \param dropFrames
+ *      True if new frames are dropped while the queue is full, false if the caller waits.
+ * \param videoFile
+ *      Complete path of the video ("" => each frame is written as an image-file).
+ * \param fps
+ *      Framerate of the video.
+ */
+FrameWriterThread::FrameWriterThread(unsigned int maxQueueSize, bool dropFrames, std::string videoFile, double fps)
+	: _maxQueueSize(std::max(maxQueueSize, 1u)), _dropFrames(dropFrames), _isRunning(true), _videoFile(videoFile), _fps(fps) {}
+
+
+/**
+ * \brief Destructor of the writer-thread (writes the queued frames and stops the thread).
+ */
+FrameWriterThread::~FrameWriterThread() {
+	stop();
+}
+
+
+/**
+ * \brief Main-loop of the thread.
+ */
+void FrameWriterThread::run() {
+	// the encoding must not take the cores of the physics (the encoder-process inherits the priority)
+	ThreadBudget::enterThread(ThreadBudget::BACKGROUND);
+
+	while (true) {
+		Frame frame;
+
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+			while (_queue.empty() && _isRunning) {
+				_notEmpty.wait(&_mutex);
+			}
+
+			// the queued frames are written before the thread stops
+			if (_queue.empty()) {
+				return;
+			}
+
+			frame = _queue.front();
+			_queue.pop_front();
+			_notFull.signal();
+		}
+
+		if (_videoFile != "") {
+			encode(*frame.image);
+		} else if (osgDB::writeImageFile(*frame.image, frame.filename)) {
+			LOG_INFO("Saved screen image to `" << frame.filename << "`");
+		}
+	}
+}
+
+
+/**
+ * \brief Write the queued frames, stop the thread and wait until it is finished.
+ */
+void FrameWriterThread::stop() {
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		_isRunning = false;
+		_notEmpty.signal();
+	}
+
+	if (isRunning()) {
+		join();
+	}
+
+	// the encoder finishes the video when its input is closed
+	if (_encoder) {
+		pclose(_encoder);
+		_encoder = nullptr;
+		LOG_INFO("Saved video to `" << _videoFile << "`");
+	}
+}
+
+
+/**
+ * \brief Queue a frame for writing.
+ *
+ * \param image
+ *      Captured frame (it must not be changed afterwards).
+ * \param filename
+ *      Complete path of the image-file.
+ *
+ * \return False if the frame has been dropped.
+ */
+bool FrameWriterThread::push(osg::ref_ptr<osg::Image> image, const std::string &filename) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	if (_queue.size() >= _maxQueueSize) {
+		if (_dropFrames) {
+			++_cntDropped;
+			return false;
+		}
+
+		while (_queue.size() >= _maxQueueSize) {
+			_notFull.wait(&_mutex);
+		}
+	}
+
+	Frame frame;
+	frame.image = image;
+	frame.filename = filename;
+	_queue.push_back(frame);
+	_notEmpty.signal();
+
+	return true;
+}
+
+
+/**
+ * \brief Pass a frame to the encoder-process (it's started with the size of the first frame).
+ *
+ * \param image
+ *      Captured frame.
+ *
+ * \return False if the encoder can't be started.
+ */
+bool FrameWriterThread::encode(const osg::Image &image) {
+	if (!_encoder) {
+		// the rows of the frames start at the bottom => flipped by the encoder
+		std::ostringstream command;
+		command << "ffmpeg -loglevel error -y -f rawvideo -pixel_format rgb24 -video_size " << image.s() << "x" << image.t()
+			<< " -framerate " << _fps << " -i - -vf vflip -c:v libx264 -pix_fmt yuv420p \"" << _videoFile << "\"";
+
+#if defined(_WIN32)
+		_encoder = popen(command.str().c_str(), "wb");
+#else
+		_encoder = popen(command.str().c_str(), "w");
+#endif
+
+		if (!_encoder) {
+			LOG_ERROR("Encoder can't be started: " << command.str());
+			_videoFile = "";
+			return false;
+		}
+
+		_width = image.s();
+		_height = image.t();
+	}
+
+	// all frames need the size of the first one (e.g. the window has been resized)
+	if (image.s() != _width || image.t() != _height) {
+		return true;
+	}
+
+	fwrite(image.data(), 1, image.getTotalSizeInBytes(), _encoder);
+	return true;
+}
+
+
+/**
+ * \brief Join the videos of the ranges of frames into one video without encoding them again (e.g. the
+ *        segments of the workers of a render-farm, which have been encoded with the same settings).
+ *
+ * \param segments
+ *      Paths of the videos in the order of their frames.
+ * \param videoFile
+ *      Complete path of the joined video.
+ *
+ * \return False if the encoder-process failed.
+ */
+bool FrameWriterThread::concatenate(const std::vector<std::string> &segments, const std::string &videoFile) {
+	if (segments.empty()) {
+		return false;
+	}
+
+	// the concat-demuxer of ffmpeg copies the streams, so the segments are joined at the speed of the disk
+	std::string listFile = videoFile + ".segments";
+	{
+		std::ofstream list(listFile);
+		if (!list) {
+			LOG_ERROR("List of the segments can't be written: " << listFile);
+			return false;
+		}
+
+		for (unsigned int i = 0; i < segments.size(); ++i) {
+			std::string path = getAbsolutePath(segments[i]);
+
+			// the quotes of the list are escaped as '\''
+			std::string quoted;
+			for (char c : path) {
+				quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+			}
+			list << "file '" << quoted << "'\n";
+		}
+	}
+
+	std::ostringstream command;
+	command << "ffmpeg -loglevel error -y -f concat -safe 0 -i \"" << listFile << "\" -c copy \"" << videoFile << "\"";
+	int status = std::system(command.str().c_str());
+	std::remove(listFile.c_str());
+
+	if (status != 0) {
+		LOG_ERROR("Segments can't be joined: " << command.str());
+		return false;
+	}
+
+	LOG_INFO("Joined " << segments.size() << " segments into " << videoFile);
+	return true;
+}
@@ -0,0 +1,150 @@
+﻿/**
+ * \brief Implementation of the thread which encodes and writes the captured frames.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-22
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <osg/Image>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Writes the captured frames on its own thread, so the encoding and the disk-access do not stall the
+	 * rendering. The frames are passed through a bounded queue: If it's full, a new frame is either dropped or the
+	 * rendering-thread waits until the writer has caught up.
+	 * The frames are either written as image-files or streamed as raw pixels into an encoder-process (ffmpeg), which
+	 * writes a video with a fixed framerate.
+	 */
+	class FrameWriterThread : public OpenThreads::Thread {
+	public:
+		/**
+		 * \brief Constructor of the writer-thread.
+		 *
+		 * \param maxQueueSize
+		 *      Number of frames which can wait for the writer.
+		 * \param dropFrames
+		 *      True if new frames are dropped while the queue is full, false if the caller waits.
+		 * \param videoFile
+		 *      Complete path of the video ("" => each frame is written as an image-file).
+		 * \param fps
+		 *      Framerate of the video.
+		 */
+		FrameWriterThread(unsigned int maxQueueSize, bool dropFrames, std::string videoFile = "", double fps = 30.0);
+
+
+		/**
+		 * \brief Destructor of the writer-thread (writes the queued frames and stops the thread).
+		 */
+		~FrameWriterThread();
+
+
+		/**
+		 * \brief Main-loop of the thread.
+		 */
+		void run() override;
+
+
+		/**
+		 * \brief Write the queued frames, stop the thread and wait until it is finished.
+		 */
+		void stop();
+
+
+		/**
+		 * \brief Queue a frame for writing.
+		 *
+		 * \param image
+		 *      Captured frame (it must not be changed afterwards).
+		 * \param filename
+		 *      Complete path of the image-file.
+		 *
+		 * \return False if the frame has been dropped.
+		 */
+		bool push(osg::ref_ptr<osg::Image> image, const std::string &filename);
+
+
+		/**
+		 * \brief Get the number of frames which have been dropped.
+		 *
+		 * \return Number of dropped frames.
+		 */
+		unsigned int getNumDropped() const {
+			return _cntDropped;
+		}
+
+
+		/**
+		 * \brief Join the videos of the ranges of frames into one video without encoding them again (e.g. the
+		 *        segments of the workers of a render-farm, which have been encoded with the same settings).
+		 *
+		 * \param segments
+		 *      Paths of the videos in the order of their frames.
+		 * \param videoFile
+		 *      Complete path of the joined video.
+		 *
+		 * \return False if the encoder-process failed.
+		 */
+		static bool concatenate(const std::vector<std::string> &segments, const std::string &videoFile);
+
+
+	private:
+		/**
+		 * \brief Captured frame which waits for the writer.
+		 */
+		struct Frame {
+			osg::ref_ptr<osg::Image> image;
+			std::string filename;
+		};
+
+
+		//! Number of frames which can wait for the writer
+		unsigned int _maxQueueSize;
+		//! True if new frames are dropped while the queue is full
+		bool _dropFrames;
+		//! Number of frames which have been dropped
+		unsigned int _cntDropped = 0;
+
+		//! True as long as the thread should run
+		bool _isRunning;
+
+		//! Complete path of the video ("" => image-files)
+		std::string _videoFile;
+		//! Framerate of the video
+		double _fps;
+		//! Pipe into the encoder-process (opened with the first frame)
+		FILE* _encoder = nullptr;
+		//! Size of the video (size of the first frame)
+		int _width = 0, _height = 0;
+
+		//! Frames which wait for the writer
+		std::deque<Frame> _queue;
+		//! Protects _queue and _isRunning
+		OpenThreads::Mutex _mutex;
+		//! Signaled if a frame has been queued or the thread should stop
+		OpenThreads::Condition _notEmpty;
+		//! Signaled if a frame has been taken from the queue
+		OpenThreads::Condition _notFull;
+
+
+		/**
+		 * \brief Pass a frame to the encoder-process (it's started with the size of the first frame).
+		 *
+		 * \param image
+		 *      Captured frame.
+		 *
+		 * \return False if the encoder can't be started.
+		 */
+		bool encode(const osg::Image &image);
+	};
+}
@@ -0,0 +1,89 @@
+﻿/**
+ * \brief Functionality for drawing the frames on demand while the simulation is paused.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "IdleRenderer.h"
+
+#include <OpenThreads/Thread>
+
+#include "TextureStreamer.h"
+#include "MipStreamer.h"
+#include "IncrementalCompiler.h"
+#include "../physics/SimulationManager.h"
+
+using namespace pbs17;
+
+
+//! The frames are drawn continuously by default.
+bool IdleRenderer::IS_ENABLED = false;
+//! The input is answered within a frame at 60 Hz
+const unsigned int IdleRenderer::POLL_INTERVAL = 15000;
+//! The edits of the watched scene are shown within a second
+const double IdleRenderer::KEEP_ALIVE = 1.0;
+//! Both buffers of the window
+const int IdleRenderer::CNT_SETTLE_FRAMES = 2;
+
+
+/**
+ * \brief Constructor of the idle-renderer.
+ *
+ * \param viewer
+ *      Viewer whose events and camera are checked.
+ * \param simulationManager
+ *      Simulation whose pause is checked.
+ */
+IdleRenderer::IdleRenderer(osgViewer::Viewer* viewer, SimulationManager* simulationManager)
+	: _viewer(viewer), _simulationManager(simulationManager), _settleFrames(CNT_SETTLE_FRAMES) {
+}
+
+
+/**
+ * \brief Check if the next frame has to be drawn (called by the main-loop before each frame).
+ *
+ * \return True if the frame is drawn, false if the main-loop waits.
+ */
+bool IdleRenderer::needsFrame() {
+	bool isPaused = _simulationManager->getIsPaused();
+	if (isPaused != _wasPaused) {
+		_wasPaused = isPaused;
+		_settleFrames = CNT_SETTLE_FRAMES;
+	}
+
+	if (!IS_ENABLED || !isPaused || !_viewer.valid() || _isMoving || _settleFrames > 0) return true;
+
+	// the events of the window are moved into the queue of the viewer, which handles them in the next frame
+	if (_viewer->checkEvents()) return true;
+	if (TextureStreamer::getIsEnabled() && TextureStreamer::Instance()->hasDecoded()) return true;
+	if (MipStreamer::getIsEnabled() && MipStreamer::Instance()->hasLoaded()) return true;
+	if (IncrementalCompiler::Instance()->hasPending()) return true;
+
+	return _viewer->elapsedTime() - _lastFrameTime >= KEEP_ALIVE;
+}
+
+
+/**
+ * \brief Remember the camera of the drawn frame (called by the main-loop after each frame).
+ */
+void IdleRenderer::frameDrawn() {
+	if (!_viewer.valid()) return;
+
+	osg::Matrixd view = _viewer->getCamera()->getViewMatrix();
+	_isMoving = view != _lastView;
+	_lastView = view;
+	_lastFrameTime = _viewer->elapsedTime();
+
+	if (_settleFrames > 0) {
+		--_settleFrames;
+	}
+}
+
+
+/**
+ * \brief Sleep until the events are checked again.
+ */
+void IdleRenderer::wait() const {
+	OpenThreads::Thread::microSleep(POLL_INTERVAL);
+}
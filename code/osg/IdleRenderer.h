@@ -0,0 +1,110 @@
+﻿/**
+ * \brief Functionality for drawing the frames on demand while the simulation is paused.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <osg/Matrixd>
+#include <osgViewer/Viewer>
+
+
+// forward declarations
+namespace pbs17 {
+	class SimulationManager;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief IdleRenderer lets the main-loop sleep instead of drawing the same frame again while the simulation is
+	 * paused (as the ON_DEMAND-scheme of osgViewer, which can't be used since the scene always has update-callbacks).
+	 * A frame is drawn if there is an input-event, if the camera has moved in the last frame (e.g. a thrown
+	 * trackball), if decoded textures wait for their swap, while sub-graphs are compiled incrementally, or after the pause has been toggled. One frame per second
+	 * keeps the update-callbacks (e.g. the watched json-scene) alive.
+	 */
+	class IdleRenderer {
+	public:
+
+		/**
+		 * \brief Constructor of the idle-renderer.
+		 *
+		 * \param viewer
+		 *      Viewer whose events and camera are checked.
+		 * \param simulationManager
+		 *      Simulation whose pause is checked.
+		 */
+		IdleRenderer(osgViewer::Viewer* viewer, SimulationManager* simulationManager);
+
+
+		/**
+		 * \brief Check if the next frame has to be drawn (called by the main-loop before each frame).
+		 *
+		 * \return True if the frame is drawn, false if the main-loop waits.
+		 */
+		bool needsFrame();
+
+
+		/**
+		 * \brief Remember the camera of the drawn frame (called by the main-loop after each frame).
+		 */
+		void frameDrawn();
+
+
+		/**
+		 * \brief Sleep until the events are checked again.
+		 */
+		void wait() const;
+
+
+		/**
+		 * \brief Enable or disable the idling (if disabled, the frames are drawn continuously).
+		 *
+		 * \param isEnabled
+		 *      True if no frames are drawn for a paused and static scene.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the idling is enabled.
+		 *
+		 * \return True if no frames are drawn for a paused and static scene.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+		//! True if no frames are drawn for a paused and static scene
+		static bool IS_ENABLED;
+		//! Time between the checks of the events: unit = us
+		static const unsigned int POLL_INTERVAL;
+		//! Largest time without a frame: unit = s
+		static const double KEEP_ALIVE;
+		//! Frames which are drawn after the pause has been toggled (the HUD and the double-buffer show the new state)
+		static const int CNT_SETTLE_FRAMES;
+
+		//! Viewer whose events and camera are checked
+		osg::observer_ptr<osgViewer::Viewer> _viewer;
+		//! Simulation whose pause is checked
+		SimulationManager* _simulationManager;
+
+		//! View-matrix of the last drawn frame
+		osg::Matrixd _lastView;
+		//! True if the camera has moved in the last drawn frame
+		bool _isMoving = true;
+		//! Pause of the last check
+		bool _wasPaused = false;
+		//! Frames which are still drawn after the pause has been toggled
+		int _settleFrames;
+		//! Time of the last drawn frame: unit = s
+		double _lastFrameTime = 0.0;
+	};
+}
@@ -7,7 +7,12 @@
 
 #include "ImageManager.h"
 
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <OpenThreads/ScopedLock>
+
 #include "Loader.h"
+#include "TextureStreamer.h"
 
 using namespace pbs17;
 
@@ -15,6 +20,9 @@ using namespace pbs17;
 //! Pointer to the only instance of this class.
 ImageManager* ImageManager::_pInstance = nullptr;
 
+//! The pre-baked files are used if they exist.
+bool ImageManager::USE_PREBAKED = true;
+
 
 /**
 * \brief Singleton instance of the ImageManager-class.
@@ -31,27 +39,43 @@ ImageManager* ImageManager::Instance() {
 
 /**
  * \brief Load a Texture2D-object from an image-file. It's implemented in a way that the image is loaded only once.
+ * If the streaming is enabled, the texture has a placeholder until the image is decoded (see TextureStreamer).
  *
  * \param filePath
  *      Complete path to the image-file.
+ * \param isNormalMap
+ *      True if the texture is a bumpmap (the placeholder is a flat normal).
  *
  * \return Texture object to attach to osg-nodes.
  */
-osg::ref_ptr<osg::Texture2D> ImageManager::loadTexture(std::string filePath) {
+osg::ref_ptr<osg::Texture2D> ImageManager::loadTexture(std::string filePath, bool isNormalMap) {
 	// try to find the texture, if it's found => return it and otherwise load it new
-	osg::ref_ptr<osg::Texture2D> retTexture;
-	std::map<std::string, osg::ref_ptr<osg::Texture2D>>::iterator found = _textures.find(filePath);
-
-	if (found == _textures.end()) {
-		// texture wasn't found => load and store it in the manager and return it
-		retTexture = Loader::loadTexture(filePath);
-		_textures.insert(std::pair<std::string, osg::ref_ptr<osg::Texture2D>>(filePath, retTexture));
-	} else {
-		// take found.
-		retTexture = _textures[filePath];
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		osg::Referenced* found = _textures.find(filePath);
+
+		if (found) {
+			return static_cast<osg::Texture2D*>(found);
+		}
+	}
+
+	// texture wasn't found => load it without the lock and store it in the manager (the first stored one is shared)
+	osg::ref_ptr<osg::Texture2D> retTexture = TextureStreamer::getIsEnabled() ?
+		TextureStreamer::Instance()->push(findPrebaked(filePath), isNormalMap) : Loader::loadTexture(findPrebaked(filePath));
+
+	const osg::Image* image = retTexture.valid() ? retTexture->getImage() : nullptr;
+	size_t size = image ? image->getTotalSizeInBytesIncludingMipmaps() : 0;
+
+	// the uniforms of the evicted textures are removed, their address may be reused by a new texture
+	std::vector<osg::ref_ptr<osg::Referenced> > evicted;
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	osg::ref_ptr<osg::Texture2D> stored = static_cast<osg::Texture2D*>(_textures.insert(filePath, retTexture.get(), size, &evicted));
+
+	for (unsigned int i = 0; i < evicted.size(); ++i) {
+		_twoChannelUniforms.erase(static_cast<osg::Texture2D*>(evicted[i].get()));
 	}
 
-	return retTexture;
+	return stored;
 }
 
 
@@ -65,17 +89,110 @@ osg::ref_ptr<osg::Texture2D> ImageManager::loadTexture(std::string filePath) {
  */
 osg::ref_ptr<osg::Image> ImageManager::loadImage(std::string filePath) {
 	// try to find the texture, if it's found => return it and otherwise load it new
-	osg::ref_ptr<osg::Image> retImage;
-	std::map<std::string, osg::ref_ptr<osg::Image>>::iterator found = _images.find(filePath);
-
-	if (found == _images.end()) {
-		// texture wasn't found => load and store it in the manager and return it
-		retImage = Loader::loadImage(filePath);
-		_images.insert(std::pair<std::string, osg::ref_ptr<osg::Image>>(filePath, retImage));
-	} else {
-		// take found.
-		retImage = _images[filePath];
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		osg::Referenced* found = _images.find(filePath);
+
+		if (found) {
+			return static_cast<osg::Image*>(found);
+		}
+	}
+
+	// image wasn't found => load it without the lock and store it in the manager (the first stored one is shared)
+	osg::ref_ptr<osg::Image> retImage = Loader::loadImage(findPrebaked(filePath));
+
+	size_t size = retImage.valid() ? retImage->getTotalSizeInBytesIncludingMipmaps() : 0;
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	return static_cast<osg::Image*>(_images.insert(filePath, retImage.get(), size));
+}
+
+
+/**
+ * \brief Get the uniform "twoChannelNormals" of a normal-texture: true if it has only the x- and y-component
+ *        (BC5), so the shader has to reconstruct z. The uniform is shared by all users of the texture.
+ *
+ * \param texture
+ *      Normal-texture.
+ *
+ * \return Uniform for the state-set of the shader.
+ */
+osg::ref_ptr<osg::Uniform> ImageManager::getTwoChannelUniform(osg::Texture2D* texture) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	osg::ref_ptr<osg::Uniform> &uniform = _twoChannelUniforms[texture];
+
+	if (!uniform.valid()) {
+		uniform = new osg::Uniform("twoChannelNormals", isTwoChannel(texture));
+		// the streamed image may replace the placeholder between the frames
+		uniform->setDataVariance(TextureStreamer::getIsEnabled() ? osg::Object::DYNAMIC : osg::Object::STATIC);
+	}
+
+	return uniform;
+}
+
+
+/**
+ * \brief Update the uniform "twoChannelNormals" of a texture whose image has been replaced.
+ *
+ * \param texture
+ *      Normal-texture.
+ */
+void ImageManager::updateTwoChannelUniform(osg::Texture2D* texture) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	std::map<osg::Texture2D*, osg::ref_ptr<osg::Uniform>>::iterator found = _twoChannelUniforms.find(texture);
+
+	if (found != _twoChannelUniforms.end()) {
+		found->second->set(isTwoChannel(texture));
 	}
+}
+
+
+/**
+ * \brief Check if a normal-texture has only the x- and y-component (BC5).
+ *
+ * \param texture
+ *      Normal-texture.
+ *
+ * \return True if the z-component of the normals is not stored.
+ */
+bool ImageManager::isTwoChannel(const osg::Texture2D* texture) {
+	return hasTwoChannels(texture ? texture->getImage() : nullptr);
+}
+
+
+/**
+ * \brief Check if an image of a normal-texture has only the x- and y-component (BC5).
+ *
+ * \param image
+ *      Image of the normal-texture.
+ *
+ * \return True if the z-component of the normals is not stored.
+ */
+bool ImageManager::hasTwoChannels(const osg::Image* image) {
+	if (!image) return false;
+
+	GLenum format = image->getPixelFormat();
+	return format == GL_COMPRESSED_RED_GREEN_RGTC2_EXT || format == GL_COMPRESSED_SIGNED_RED_GREEN_RGTC2_EXT;
+}
+
+
+/**
+ * \brief Get the pre-baked file of an image (same name with the extension .ktx or .dds).
+ *
+ * \param filePath
+ *      Complete path to the image-file.
+ *
+ * \return Path to the pre-baked file if it exists, otherwise the given path.
+ */
+std::string ImageManager::findPrebaked(const std::string &filePath) {
+	if (!USE_PREBAKED) return filePath;
 
-	return retImage;
-}
\ No newline at end of file
+	std::string extension = osgDB::getLowerCaseFileExtension(filePath);
+	if (extension == "ktx" || extension == "dds") return filePath;
+
+	std::string name = osgDB::getNameLessExtension(filePath);
+	if (osgDB::fileExists(name + ".ktx")) return name + ".ktx";
+	if (osgDB::fileExists(name + ".dds")) return name + ".dds";
+
+	return filePath;
+}
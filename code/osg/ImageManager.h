@@ -9,8 +9,13 @@
 
 #include <osg/Image>
 #include <osg/Texture2D>
+#include <osg/Uniform>
+#include <OpenThreads/Mutex>
 
 #include <map>
+#include <string>
+
+#include "ResourceCache.h"
 
 
 namespace pbs17 {
@@ -18,6 +23,12 @@ namespace pbs17 {
 	/**
 	 * \brief ImageManager manages already loaded images.
 	 * This class prevents to load the same picture several times. If a picture is requested which was already loaded, it will return the already loaded image. Otherwise it will load it into the cache.
+	 * The manager can be used by several threads (different images are loaded concurrently). The unused textures and
+	 * images are evicted beyond the budget (see ResourceCache).
+	 *
+	 * If a pre-baked file with the same name exists next to the image (<name>.ktx or <name>.dds, see the tool
+	 * asteroid_field_texconv), it's loaded instead: the block-compressed formats (BC1/BC3/BC5) need 4-8 times less
+	 * memory and their full mip-chain is uploaded as it is, so nothing is generated at the first frame.
 	 */
 	class ImageManager {
 	public:
@@ -28,13 +39,16 @@ namespace pbs17 {
 
 		/**
 		 * \brief Load a Texture2D-object from an image-file. It's implemented in a way that the image is loaded only once.
+		 * If the streaming is enabled, the texture has a placeholder until the image is decoded (see TextureStreamer).
 		 * 
 		 * \param filePath
 		 *      Complete path to the image-file.
+		 * \param isNormalMap
+		 *      True if the texture is a bumpmap (the placeholder is a flat normal).
 		 * 
 		 * \return Texture object to attach to osg-nodes.
 		 */
-		osg::ref_ptr<osg::Texture2D> loadTexture(std::string filePath);
+		osg::ref_ptr<osg::Texture2D> loadTexture(std::string filePath, bool isNormalMap = false);
 		
 
 		/**
@@ -48,17 +62,91 @@ namespace pbs17 {
 		osg::ref_ptr<osg::Image> loadImage(std::string filePath);
 
 
+		/**
+		 * \brief Get the uniform "twoChannelNormals" of a normal-texture: true if it has only the x- and y-component
+		 *        (BC5), so the shader has to reconstruct z. The uniform is shared by all users of the texture.
+		 *
+		 * \param texture
+		 *      Normal-texture.
+		 *
+		 * \return Uniform for the state-set of the shader.
+		 */
+		osg::ref_ptr<osg::Uniform> getTwoChannelUniform(osg::Texture2D* texture);
+
+
+		/**
+		 * \brief Update the uniform "twoChannelNormals" of a texture whose image has been replaced.
+		 *
+		 * \param texture
+		 *      Normal-texture.
+		 */
+		void updateTwoChannelUniform(osg::Texture2D* texture);
+
+
+		/**
+		 * \brief Check if an image of a normal-texture has only the x- and y-component (BC5).
+		 *
+		 * \param image
+		 *      Image of the normal-texture.
+		 *
+		 * \return True if the z-component of the normals is not stored.
+		 */
+		static bool hasTwoChannels(const osg::Image* image);
+
+
+		/**
+		 * \brief Enable or disable the pre-baked files (has to be set before loading the scene).
+		 *
+		 * \param usePrebaked
+		 *      True if the .ktx- or .dds-file is preferred to the image.
+		 */
+		static void setUsePrebaked(bool usePrebaked) {
+			USE_PREBAKED = usePrebaked;
+		}
+
+
 	private:
 
-		//! All textures which have been loaded already.
-		std::map<std::string, osg::ref_ptr<osg::Texture2D>> _textures;
+		//! True if the .ktx- or .dds-file is preferred to the image
+		static bool USE_PREBAKED;
+
+		//! All textures which have been loaded already (and not evicted).
+		ResourceCache _textures;
+
+		//! All images which have been loaded already (and not evicted).
+		ResourceCache _images;
+
+		//! Uniforms "twoChannelNormals" of the normal-textures.
+		std::map<osg::Texture2D*, osg::ref_ptr<osg::Uniform>> _twoChannelUniforms;
+
+		//! Protects the maps (the images are loaded without holding it).
+		OpenThreads::Mutex _mutex;
+
+
+		/**
+		 * \brief Get the pre-baked file of an image (same name with the extension .ktx or .dds).
+		 *
+		 * \param filePath
+		 *      Complete path to the image-file.
+		 *
+		 * \return Path to the pre-baked file if it exists, otherwise the given path.
+		 */
+		static std::string findPrebaked(const std::string &filePath);
+
 
-		//! All images which have been loaded already.
-		std::map<std::string, osg::ref_ptr<osg::Image>> _images;
+		/**
+		 * \brief Check if a normal-texture has only the x- and y-component (BC5).
+		 *
+		 * \param texture
+		 *      Normal-texture.
+		 *
+		 * \return True if the z-component of the normals is not stored.
+		 */
+		static bool isTwoChannel(const osg::Texture2D* texture);
 
 
 		//! Private constructor to be sure the class can't be created outside of this class.
-		ImageManager() {}
+		ImageManager() : _textures(MemoryTracker::TEXTURES), _images(MemoryTracker::TEXTURES) {}
 
 		//! Private copy-constructor to prevent copying the class.
 		ImageManager(ImageManager const&) {};
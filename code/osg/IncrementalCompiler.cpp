@@ -0,0 +1,153 @@
+﻿/**
+ * \brief Functionality for compiling the GL-objects of new nodes over several frames before they are drawn.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "IncrementalCompiler.h"
+
+#include <osg/Camera>
+#include <osg/NodeCallback>
+
+#include "../physics/Logger.h"
+
+using namespace pbs17;
+
+
+//! Pointer to the only instance of this class.
+IncrementalCompiler* IncrementalCompiler::_pInstance = nullptr;
+
+//! The new sub-graphs are compiled incrementally by default.
+bool IncrementalCompiler::IS_ENABLED = true;
+
+//! A quarter of a frame at 60 fps.
+double IncrementalCompiler::BUDGET = 4.0;
+
+//! The remaining time of a frame at 60 fps is used as well.
+const double IncrementalCompiler::TARGET_FRAME_RATE = 60.0;
+
+
+namespace {
+
+	/**
+	 * \brief Counts the compiled sub-graphs, which are merged afterwards by the update-traversal of the viewer.
+	 */
+	class CompiledCallback : public osgUtil::IncrementalCompileOperation::CompileCompletedCallback {
+	public:
+		bool compileCompleted(osgUtil::IncrementalCompileOperation::CompileSet*) override {
+			IncrementalCompiler::Instance()->compiled();
+
+			// false => the compile-operation attaches the sub-graph to its parent
+			return false;
+		}
+	};
+
+
+	/**
+	 * \brief Hands the queued sub-graphs to the compile-operation (update-callback of the camera).
+	 */
+	class QueueCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			IncrementalCompiler::Instance()->update();
+			traverse(node, nv);
+		}
+	};
+}
+
+
+/**
+ * \brief Singleton instance of the IncrementalCompiler-class.
+ */
+IncrementalCompiler* IncrementalCompiler::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new IncrementalCompiler();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Let the viewer run the compile-operation on its contexts and merge the compiled sub-graphs (has to be
+ *        called before the viewer is realized).
+ *
+ * \param viewer
+ *      Viewer which draws the sub-graphs.
+ */
+void IncrementalCompiler::attach(osgViewer::Viewer* viewer) {
+	if (!IS_ENABLED) return;
+
+	// the compile-operation also compiles the sub-graphs of the database-pager
+	_operation = new osgUtil::IncrementalCompileOperation;
+	_operation->setTargetFrameRate(TARGET_FRAME_RATE);
+	_operation->setMinimumTimeAvailableForGLCompileAndDeletePerFrame(BUDGET / 1000.0);
+	viewer->setIncrementalCompileOperation(_operation.get());
+
+	viewer->getCamera()->addUpdateCallback(new QueueCallback);
+}
+
+
+/**
+ * \brief Add a node to its parent once its GL-objects are compiled.
+ *
+ * \param parent
+ *      Group to which the node is attached.
+ * \param node
+ *      Root of the new sub-graph.
+ */
+void IncrementalCompiler::add(osg::Group* parent, osg::Node* node) {
+	if (!_operation.valid()) {
+		parent->addChild(node);
+		return;
+	}
+
+	osg::ref_ptr<osgUtil::IncrementalCompileOperation::CompileSet> compileSet =
+		new osgUtil::IncrementalCompileOperation::CompileSet(parent, node);
+	compileSet->_compileCompletedCallback = new CompiledCallback;
+
+	_cntPending.fetch_add(1, std::memory_order_relaxed);
+	_queued.push_back(compileSet);
+	update();
+}
+
+
+/**
+ * \brief Detach the children of a group and add them again once they are compiled (see add()).
+ *
+ * \param parent
+ *      Group whose children are compiled.
+ */
+void IncrementalCompiler::addChildren(osg::Group* parent) {
+	if (!_operation.valid()) return;
+
+	// each child is its own compile-set, so the small ones are not held back by the large ones
+	std::vector<osg::ref_ptr<osg::Node> > children;
+	for (unsigned int i = 0; i < parent->getNumChildren(); ++i) {
+		children.push_back(parent->getChild(i));
+	}
+	parent->removeChildren(0, parent->getNumChildren());
+
+	for (unsigned int i = 0; i < children.size(); ++i) {
+		add(parent, children[i].get());
+	}
+}
+
+
+/**
+ * \brief Hand the queued sub-graphs to the compile-operation once the contexts are assigned (called by the
+ *        update-callback of the camera).
+ */
+void IncrementalCompiler::update() {
+	// without the contexts, the compile-maps would be empty and the sub-graphs compiled by their first draw
+	if (_queued.empty() || !_operation.valid() || _operation->getContextSet().empty()) return;
+
+	for (unsigned int i = 0; i < _queued.size(); ++i) {
+		_operation->add(_queued[i].get());
+	}
+
+	LOG_DEBUG("Compiling " << _queued.size() << " sub-graphs incrementally.");
+	_queued.clear();
+}
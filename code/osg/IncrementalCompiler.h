@@ -0,0 +1,153 @@
+﻿/**
+ * \brief Functionality for compiling the GL-objects of new nodes over several frames before they are drawn.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <osg/Group>
+#include <osgUtil/IncrementalCompileOperation>
+#include <osgViewer/Viewer>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief IncrementalCompiler compiles the display-lists/VBOs, textures and programs of new sub-graphs with the
+	 * IncrementalCompileOperation of osgUtil, so they are not all compiled by the first draw which sees them (the
+	 * initial frame, the pooled fragments and sector-asteroids, the reloaded objects).
+	 *  - add() keeps the node out of its parent until the compile-operation of the draw-thread has compiled it
+	 *    within the budget of the frames, the update-traversal of the viewer attaches it afterwards.
+	 *  - The sub-graphs which are added before the viewer is realized are queued until the contexts are known.
+	 * Without the compiler (or the viewer), add() attaches the node immediately.
+	 */
+	class IncrementalCompiler {
+	public:
+
+		/**
+		 * \brief Singleton instance of the IncrementalCompiler-class.
+		 */
+		static IncrementalCompiler* Instance();
+
+
+		/**
+		 * \brief Let the viewer run the compile-operation on its contexts and merge the compiled sub-graphs (has to be
+		 *        called before the viewer is realized).
+		 *
+		 * \param viewer
+		 *      Viewer which draws the sub-graphs.
+		 */
+		void attach(osgViewer::Viewer* viewer);
+
+
+		/**
+		 * \brief Add a node to its parent once its GL-objects are compiled.
+		 *
+		 * \param parent
+		 *      Group to which the node is attached.
+		 * \param node
+		 *      Root of the new sub-graph.
+		 */
+		void add(osg::Group* parent, osg::Node* node);
+
+
+		/**
+		 * \brief Detach the children of a group and add them again once they are compiled (see add()).
+		 *
+		 * \param parent
+		 *      Group whose children are compiled.
+		 */
+		void addChildren(osg::Group* parent);
+
+
+		/**
+		 * \brief Hand the queued sub-graphs to the compile-operation once the contexts are assigned (called by the
+		 *        update-callback of the camera).
+		 */
+		void update();
+
+
+		/**
+		 * \brief Check if sub-graphs are waiting for their compilation (the frames have to be drawn to finish them).
+		 *
+		 * \return True if a sub-graph is not yet attached.
+		 */
+		bool hasPending() const {
+			return _cntPending.load(std::memory_order_relaxed) > 0;
+		}
+
+
+		/**
+		 * \brief Report that a sub-graph has been compiled (called by the compile-operation of the draw-thread).
+		 */
+		void compiled() {
+			_cntPending.fetch_sub(1, std::memory_order_relaxed);
+		}
+
+
+		/**
+		 * \brief Enable or disable the compiler (if disabled, the nodes are compiled by their first draw).
+		 *
+		 * \param isEnabled
+		 *      True if the new sub-graphs are compiled incrementally.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the compiler is enabled.
+		 *
+		 * \return True if the new sub-graphs are compiled incrementally.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+		/**
+		 * \brief Set the time of each frame which is at least available for the compilation.
+		 *
+		 * \param budget
+		 *      Time per frame: unit = ms.
+		 */
+		static void setBudget(double budget) {
+			BUDGET = budget;
+		}
+
+
+	private:
+		//! True if the new sub-graphs are compiled incrementally
+		static bool IS_ENABLED;
+		//! Time of each frame which is at least available for the compilation: unit = ms
+		static double BUDGET;
+		//! Frame-rate whose remaining frame-time is used for the compilation (at least the budget)
+		static const double TARGET_FRAME_RATE;
+
+		//! Compile-operation of the viewer (nullptr => not attached)
+		osg::ref_ptr<osgUtil::IncrementalCompileOperation> _operation;
+		//! Sub-graphs which wait for the contexts
+		std::vector<osg::ref_ptr<osgUtil::IncrementalCompileOperation::CompileSet> > _queued;
+		//! Sub-graphs which are not yet attached
+		std::atomic<int> _cntPending;
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		IncrementalCompiler() : _cntPending(0) {}
+
+		//! Private copy-constructor to prevent copying the class.
+		IncrementalCompiler(IncrementalCompiler const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		IncrementalCompiler& operator=(IncrementalCompiler const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static IncrementalCompiler* _pInstance;
+	};
+}
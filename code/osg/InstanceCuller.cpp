@@ -0,0 +1,467 @@
+﻿/**
+ * \brief Functionality for culling the instances of an instanced model on the GPU.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "InstanceCuller.h"
+
+#include <algorithm>
+#include <string>
+
+#include <osg/Version>
+#include <osg/CullingSet>
+#include <osg/Geometry>
+#include <osg/GLExtensions>
+#include <osg/Program>
+#include <osg/Shader>
+#include <osg/State>
+#include <osgUtil/CullVisitor>
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 6, 0)
+#include <osg/BufferObject>
+#include <osg/BufferIndexBinding>
+#endif
+
+#include "DispatchDrawable.h"
+#include "InstanceManager.h"
+#include "StereoRenderer.h"
+#include "shaders/InstancedShader.h"
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+using namespace pbs17;
+
+
+namespace {
+
+	//! One invocation per instance: frustum, occluders, level of detail and compaction into the list of the level
+	const char* COMPUTE_SHADER =
+		"layout(local_size_x = 64) in;\n"
+		"#ifdef READS_BODIES\n"
+		"struct Body { vec4 position; vec4 velocity; };\n"
+		"layout(std430, binding = 0) readonly buffer Bodies { Body bodies[]; };\n"
+		"#endif\n"
+		"layout(std430, binding = 1) writeonly buffer Visible { uint visible[]; };\n"
+		"layout(std430, binding = 2) buffer Commands { uint commands[]; };\n"
+		"uniform samplerBuffer instanceMatrices;\n"
+		"uniform int cntInstances;\n"
+		"uniform int capacity;\n"
+		"uniform mat4 cullMatrix;\n"
+		"uniform vec3 eye;\n"
+		"uniform vec4 pixelSizeVector;\n"
+		"uniform float lodScale;\n"
+		"uniform bool pixelSizeRanges;\n"
+		"uniform vec4 modelBound;\n"
+		"uniform int cntLevels;\n"
+		"uniform float minRanges[8];\n"
+		"uniform float maxRanges[8];\n"
+		"uniform int firstCommands[9];\n"
+		"uniform int cntOccluders;\n"
+		"uniform vec4 occluders[8];\n"
+		"uniform int cntEyes;\n"
+		"void main()\n"
+		"{\n"
+		"    int i = int(gl_GlobalInvocationID.x);\n"
+		"    if (i >= cntInstances) return;\n"
+		"    int base = 4 * i;\n"
+		"    mat4 model = mat4(texelFetch(instanceMatrices, base), texelFetch(instanceMatrices, base + 1),\n"
+		"                      texelFetch(instanceMatrices, base + 2), texelFetch(instanceMatrices, base + 3));\n"
+		"    model[1][3] = 0.0;\n"
+		"    model[2][3] = 0.0;\n"
+		"#ifdef READS_BODIES\n"
+		"    int body = int(model[0][3]);\n"
+		"    model[0][3] = 0.0;\n"
+		"    model[3] = vec4(bodies[body].position.xyz, 1.0);\n"
+		"#endif\n"
+		"    float scaling = length(model[0].xyz);\n"
+		"    if (scaling == 0.0) return;\n"
+		"    vec3 center = (model * vec4(modelBound.xyz, 1.0)).xyz;\n"
+		"    float radius = modelBound.w * scaling;\n"
+
+		// side-planes of the clip-space (the near- and far-plane are computed from the bound of all instances)
+		"    mat4 rows = transpose(cullMatrix);\n"
+		"    vec4 planes[4] = vec4[4](rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1]);\n"
+		"    for (int p = 0; p < 4; ++p) {\n"
+		"        if (dot(planes[p], vec4(center, 1.0)) < -radius * length(planes[p].xyz)) return;\n"
+		"    }\n"
+
+		// hidden by an occluder if the instance is behind its center and within the cone of its silhouette
+		"    vec3 toCenter = center - eye;\n"
+		"    float dist = length(toCenter);\n"
+		"    if (dist > radius) {\n"
+		"        float angle = asin(radius / dist);\n"
+		"        for (int o = 0; o < cntOccluders; ++o) {\n"
+		"            vec3 toOccluder = occluders[o].xyz - eye;\n"
+		"            float occluderDist = length(toOccluder);\n"
+		"            if (occluderDist > occluders[o].w && dist - radius > occluderDist) {\n"
+		"                float between = acos(clamp(dot(toCenter, toOccluder) / (dist * occluderDist), -1.0, 1.0));\n"
+		"                if (between + angle < asin(occluders[o].w / occluderDist)) return;\n"
+		"            }\n"
+		"        }\n"
+		"    }\n"
+
+		// same range as osg::LOD::traverse(), the first command of the level counts the slots of its list (the
+		// instanced stereo draws each slot once per eye, see StereoRenderer)
+		"    float range = pixelSizeRanges ? abs(radius / dot(vec4(center, 1.0), pixelSizeVector)) / lodScale : dist * lodScale;\n"
+		"    for (int l = 0; l < cntLevels; ++l) {\n"
+		"        if (range >= minRanges[l] && range < maxRanges[l]) {\n"
+		"            int first = firstCommands[l];\n"
+		"            int end = firstCommands[l + 1];\n"
+		"            if (first == end) return;\n"
+		"            uint slot = atomicAdd(commands[5 * first + 1], uint(cntEyes)) / uint(cntEyes);\n"
+		"            for (int c = first + 1; c < end; ++c) atomicAdd(commands[5 * c + 1], uint(cntEyes));\n"
+		"            visible[l * capacity + int(slot)] = uint(i);\n"
+		"            return;\n"
+		"        }\n"
+		"    }\n"
+		"}\n";
+
+
+	/**
+	 * \brief Get the program of the compute-shader (shared by all culled models).
+	 *
+	 * \param readsBodies
+	 *      True if the positions are read from the buffer of the bodies.
+	 *
+	 * \return Program of the variant.
+	 */
+	osg::ref_ptr<osg::Program> getCullProgram(bool readsBodies) {
+		static osg::ref_ptr<osg::Program> programs[2];
+		osg::ref_ptr<osg::Program> &program = programs[readsBodies ? 1 : 0];
+
+		if (!program.valid()) {
+			std::string source = readsBodies ? "#version 430\n#define READS_BODIES\n" : "#version 430\n";
+			program = new osg::Program;
+			program->addShader(new osg::Shader(osg::Shader::COMPUTE, source + COMPUTE_SHADER));
+		}
+
+		return program;
+	}
+
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 6, 0)
+	/**
+	 * \brief Bind the buffer of the commands as the buffer of the indirect draws.
+	 *
+	 * \param state
+	 *      State of the draw-traversal.
+	 * \param commands
+	 *      Commands of the indirect draws.
+	 * \param command
+	 *      Index of the command to draw.
+	 * \param commandSize
+	 *      Number of values of a command.
+	 *
+	 * \return Offset of the command in the buffer.
+	 */
+	const GLvoid* bindCommand(osg::State &state, const osg::UIntArray* commands, unsigned int command, unsigned int commandSize) {
+		osg::GLBufferObject* buffer = commands->getOrCreateGLBufferObject(state.getContextID());
+		if (buffer->isDirty()) {
+			buffer->compileBuffer();
+		}
+
+		state.get<osg::GLExtensions>()->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer->getGLObjectID());
+		return reinterpret_cast<const GLvoid*>(buffer->getOffset(commands->getBufferIndex()) + command * commandSize * sizeof(GLuint));
+	}
+
+
+	/**
+	 * \brief Indexed primitives whose number of instances is read from the buffer of the commands.
+	 */
+	class IndirectElements : public osg::DrawElementsUInt {
+	public:
+		IndirectElements(const osg::PrimitiveSet &primitives, osg::UIntArray* commands, unsigned int command, unsigned int commandSize)
+			: osg::DrawElementsUInt(primitives.getMode()), _commands(commands), _command(command), _commandSize(commandSize) {
+			for (unsigned int i = 0; i < primitives.getNumIndices(); ++i) {
+				push_back(primitives.index(i));
+			}
+
+			// the first index of the command is 0
+			setElementBufferObject(new osg::ElementBufferObject);
+		}
+
+		void draw(osg::State &state, bool) const override {
+			osg::GLBufferObject* ebo = getOrCreateGLBufferObject(state.getContextID());
+			if (ebo->isDirty()) {
+				ebo->compileBuffer();
+			}
+			state.getCurrentVertexArrayState()->bindElementBufferObject(ebo);
+
+			const GLvoid* offset = bindCommand(state, _commands.get(), _command, _commandSize);
+			state.get<osg::GLExtensions>()->glDrawElementsIndirect(getMode(), GL_UNSIGNED_INT, offset);
+			state.get<osg::GLExtensions>()->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+
+	private:
+		osg::ref_ptr<osg::UIntArray> _commands;
+		unsigned int _command;
+		unsigned int _commandSize;
+	};
+
+
+	/**
+	 * \brief Arrays (the points of the impostors) whose number of instances is read from the buffer of the commands.
+	 */
+	class IndirectArrays : public osg::DrawArrays {
+	public:
+		IndirectArrays(const osg::DrawArrays &primitives, osg::UIntArray* commands, unsigned int command, unsigned int commandSize)
+			: osg::DrawArrays(primitives.getMode(), primitives.getFirst(), primitives.getCount()), _commands(commands),
+			_command(command), _commandSize(commandSize) {}
+
+		void draw(osg::State &state, bool) const override {
+			const GLvoid* offset = bindCommand(state, _commands.get(), _command, _commandSize);
+			state.get<osg::GLExtensions>()->glDrawArraysIndirect(getMode(), offset);
+			state.get<osg::GLExtensions>()->glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+
+	private:
+		osg::ref_ptr<osg::UIntArray> _commands;
+		unsigned int _command;
+		unsigned int _commandSize;
+	};
+
+
+	/**
+	 * \brief Create the binding of an array as shader-storage-buffer.
+	 *
+	 * \param index
+	 *      Binding-point of the buffer.
+	 * \param array
+	 *      Array with a shader-storage-buffer-object.
+	 *
+	 * \return Buffer-binding for the state-sets.
+	 */
+	osg::ref_ptr<osg::StateAttribute> createBinding(unsigned int index, osg::UIntArray* array) {
+		return new osg::ShaderStorageBufferBinding(index, array, 0, array->getTotalDataSize());
+	}
+#endif
+}
+
+
+//! The culling on the GPU is disabled by default (needs OpenGL 4.3).
+bool InstanceCuller::IS_ENABLED = false;
+
+
+/**
+ * \brief Constructor of the culler.
+ *
+ * \param modelBound
+ *      Bounding-sphere of the unscaled LOD-model (used for the selection of the level).
+ * \param rangeMode
+ *      Range-mode of the LOD-model.
+ * \param shared
+ *      State-set of the instanced model (the list of the visible instances is bound to it).
+ */
+InstanceCuller::InstanceCuller(const osg::BoundingSphere &modelBound, osg::LOD::RangeMode rangeMode, osg::StateSet* shared)
+	: _shared(shared), _commands(new osg::UIntArray), _visible(new osg::UIntArray), _capacity(0),
+	_minRanges(new osg::Uniform(osg::Uniform::FLOAT, "minRanges", MAX_LEVELS)),
+	_maxRanges(new osg::Uniform(osg::Uniform::FLOAT, "maxRanges", MAX_LEVELS)),
+	_firstCommandsUniform(new osg::Uniform(osg::Uniform::INT, "firstCommands", MAX_LEVELS + 1)),
+	_cntLevels(new osg::Uniform("cntLevels", 0)), _cntInstances(new osg::Uniform("cntInstances", 0)),
+	_capacityUniform(new osg::Uniform("capacity", 0)), _cullMatrix(new osg::Uniform("cullMatrix", osg::Matrixf())),
+	_eye(new osg::Uniform("eye", osg::Vec3())), _pixelSizeVector(new osg::Uniform("pixelSizeVector", osg::Vec4())),
+	_lodScale(new osg::Uniform("lodScale", 1.0f)),
+	_occluders(new osg::Uniform(osg::Uniform::FLOAT_VEC4, "occluders", MAX_OCCLUDERS)),
+	_cntOccluders(new osg::Uniform("cntOccluders", 0)), _dispatch(new DispatchDrawable(1, GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT)) {
+	setCullingActive(false);
+	_firstCommands.push_back(0);
+	_firstCommandsUniform->setElement(0, 0);
+
+	// the camera is set by the cull-traversal while the previous frame may still be drawn
+	osg::Uniform* dynamics[] = { _cullMatrix.get(), _eye.get(), _pixelSizeVector.get(), _lodScale.get(),
+		_occluders.get(), _cntOccluders.get(), _cntInstances.get(), _capacityUniform.get() };
+	for (unsigned int u = 0; u < sizeof(dynamics) / sizeof(dynamics[0]); ++u) {
+		dynamics[u]->setDataVariance(osg::Object::DYNAMIC);
+	}
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 6, 0)
+	_commands->setDataVariance(osg::Object::DYNAMIC);
+	_commands->setBufferObject(new osg::ShaderStorageBufferObject);
+	_visible->setBufferObject(new osg::ShaderStorageBufferObject);
+#endif
+
+	osg::StateSet* stateset = getOrCreateStateSet();
+	stateset->setAttributeAndModes(getCullProgram(false));
+	stateset->addUniform(new osg::Uniform("instanceMatrices", InstancedShader::MATRIX_UNIT));
+	stateset->addUniform(new osg::Uniform("modelBound", osg::Vec4(modelBound.center(), modelBound.radius())));
+	stateset->addUniform(new osg::Uniform("pixelSizeRanges", rangeMode == osg::LOD::PIXEL_SIZE_ON_SCREEN));
+	stateset->addUniform(_minRanges);
+	stateset->addUniform(_maxRanges);
+	stateset->addUniform(_firstCommandsUniform);
+	stateset->addUniform(_cntLevels);
+	stateset->addUniform(_cntInstances);
+	stateset->addUniform(_capacityUniform);
+	stateset->addUniform(_cullMatrix);
+	stateset->addUniform(_eye);
+	stateset->addUniform(_pixelSizeVector);
+	stateset->addUniform(_lodScale);
+	stateset->addUniform(_occluders);
+	stateset->addUniform(_cntOccluders);
+	stateset->addUniform(new osg::Uniform("cntEyes", static_cast<int>(StereoRenderer::getCntEyes())));
+
+	// after the integration of the bodies (see ComputeGravity) and before the scene (default bin 0)
+	stateset->setRenderBinDetails(-1, "RenderBin");
+	addDrawable(_dispatch);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+InstanceCuller::~InstanceCuller() {}
+
+
+/**
+ * \brief Check if the indirect draws are supported by the version of OSG.
+ *
+ * \return True if the instances can be culled on the GPU.
+ */
+bool InstanceCuller::isSupported() {
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 6, 0)
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * \brief Add a level of detail: its primitives are replaced by indirect draws.
+ *
+ * \param minRange, maxRange
+ *      Range of the pixel-size or the distance to the camera.
+ * \param geode
+ *      Geode with the instanced geometries of the level.
+ */
+void InstanceCuller::addLevel(float minRange, float maxRange, osg::Geode* geode) {
+	unsigned int level = _visibleOffsets.size();
+	if (level >= static_cast<unsigned int>(MAX_LEVELS)) {
+		// more levels than the shader can select => never drawn
+		geode->setNodeMask(0);
+		return;
+	}
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 6, 0)
+	for (unsigned int d = 0; d < geode->getNumDrawables(); ++d) {
+		osg::Geometry* geometry = geode->getDrawable(d)->asGeometry();
+		if (!geometry) continue;
+
+		for (unsigned int p = 0; p < geometry->getNumPrimitiveSets(); ++p) {
+			osg::PrimitiveSet* primitives = geometry->getPrimitiveSet(p);
+			unsigned int command = _commands->size() / COMMAND_SIZE;
+
+			// count, instances, first index (or first vertex), base vertex (or base instance), base instance
+			if (primitives->getType() == osg::PrimitiveSet::DrawArraysPrimitiveType) {
+				osg::DrawArrays* arrays = static_cast<osg::DrawArrays*>(primitives);
+				GLuint values[COMMAND_SIZE] = { static_cast<GLuint>(arrays->getCount()), 0, static_cast<GLuint>(arrays->getFirst()), 0, 0 };
+				_commands->insert(_commands->end(), values, values + COMMAND_SIZE);
+				geometry->setPrimitiveSet(p, new IndirectArrays(*arrays, _commands.get(), command, COMMAND_SIZE));
+			} else if (primitives->getDrawElements() != nullptr) {
+				GLuint values[COMMAND_SIZE] = { primitives->getNumIndices(), 0, 0, 0, 0 };
+				_commands->insert(_commands->end(), values, values + COMMAND_SIZE);
+				geometry->setPrimitiveSet(p, new IndirectElements(*primitives, _commands.get(), command, COMMAND_SIZE));
+			}
+		}
+	}
+#endif
+
+	_firstCommands.push_back(_commands->size() / COMMAND_SIZE);
+	_minRanges->setElement(level, minRange);
+	_maxRanges->setElement(level, maxRange);
+	_firstCommandsUniform->setElement(level + 1, static_cast<int>(_firstCommands.back()));
+	_cntLevels->set(static_cast<int>(level + 1));
+
+	// the vertex-shaders of the level read its part of the list
+	osg::ref_ptr<osg::Uniform> visibleOffset = new osg::Uniform("visibleOffset", 0);
+	visibleOffset->setDataVariance(osg::Object::DYNAMIC);
+	geode->getOrCreateStateSet()->addUniform(visibleOffset);
+	_visibleOffsets.push_back(visibleOffset);
+
+	bindCommands();
+}
+
+
+/**
+ * \brief Resize the list of the visible instances, so each level can hold all instances.
+ *
+ * \param cntInstances
+ *      Number of instances.
+ */
+void InstanceCuller::reserve(unsigned int cntInstances) {
+	_cntInstances->set(static_cast<int>(cntInstances));
+	_dispatch->setNumGroups(std::max((cntInstances + GROUP_SIZE - 1) / GROUP_SIZE, 1u));
+
+	if (cntInstances <= _capacity && _capacity > 0) {
+		return;
+	}
+
+	// the capacity grows by doubling, so the buffer is rarely allocated again while objects are added
+	_capacity = std::max(std::max(cntInstances, 2 * _capacity), 1u);
+	_capacityUniform->set(static_cast<int>(_capacity));
+	_visible->resize(_capacity * _visibleOffsets.size(), 0);
+	_visible->dirty();
+
+	for (unsigned int l = 0; l < _visibleOffsets.size(); ++l) {
+		_visibleOffsets[l]->set(static_cast<int>(l * _capacity));
+	}
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 6, 0)
+	_shared->setAttributeAndModes(createBinding(InstancedShader::VISIBLE_BINDING, _visible.get()));
+#endif
+}
+
+
+/**
+ * \brief Set the camera of the next dispatch and reset the number of instances of the draws.
+ * (called by the instanced model during the cull-traversal)
+ *
+ * \param cv
+ *      Cull-visitor of the camera (position, projection and LOD-scale).
+ */
+void InstanceCuller::update(osgUtil::CullVisitor* cv) {
+	const osg::RefMatrix &modelView = *cv->getModelViewMatrix();
+	const osg::RefMatrix &projection = *cv->getProjectionMatrix();
+
+	_cullMatrix->set(osg::Matrixf(modelView * projection));
+	_eye->set(cv->getEyeLocal());
+	_pixelSizeVector->set(osg::Vec4(osg::CullingSet::computePixelSizeVector(*cv->getViewport(), projection, modelView)));
+	_lodScale->set(cv->getLODScale());
+
+	std::vector<osg::Vec4> occluders = InstanceManager::Instance()->getOccluders();
+	unsigned int cntOccluders = std::min(static_cast<unsigned int>(occluders.size()), static_cast<unsigned int>(MAX_OCCLUDERS));
+	for (unsigned int o = 0; o < cntOccluders; ++o) {
+		_occluders->setElement(o, occluders[o]);
+	}
+	_cntOccluders->set(static_cast<int>(cntOccluders));
+
+	// only the number of instances is written by the compute-shader (a few bytes per level are uploaded again)
+	for (unsigned int c = 0; c < _commands->size(); c += COMMAND_SIZE) {
+		(*_commands)[c + 1] = 0;
+	}
+	_commands->dirty();
+}
+
+
+/**
+ * \brief Read the positions from the shader-storage-buffer of the bodies (see ComputeGravity).
+ */
+void InstanceCuller::setReadsBodies() {
+	getOrCreateStateSet()->setAttributeAndModes(getCullProgram(true));
+}
+
+
+/**
+ * \brief Bind the commands to the state-set of the dispatch (again after they have been resized).
+ */
+void InstanceCuller::bindCommands() {
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 6, 0)
+	if (_commands->empty()) return;
+
+	_commands->dirty();
+	getOrCreateStateSet()->setAttributeAndModes(createBinding(COMMAND_BINDING, _commands.get()));
+#endif
+}
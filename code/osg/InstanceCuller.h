@@ -0,0 +1,195 @@
+﻿/**
+ * \brief Functionality for culling the instances of an instanced model on the GPU.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <osg/Array>
+#include <osg/BoundingSphere>
+#include <osg/Geode>
+#include <osg/LOD>
+#include <osg/StateAttribute>
+#include <osg/StateSet>
+#include <osg/Uniform>
+
+
+// Forward declarations
+namespace osgUtil {
+	class CullVisitor;
+}
+
+namespace pbs17 {
+	class DispatchDrawable;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief InstanceCuller culls the instances of an InstancedModel in a compute-shader instead of the cull-traversal.
+	 * Each instance is tested against the side-planes of the view-frustum and against the spheres of the occluders
+	 * (the planets, see InstanceManager::addOccluder()), and the visible ones are assigned to the levels of detail
+	 * in the same way as the CPU does it. Their indices are compacted into a list per level, which is read by the
+	 * vertex-shaders (see InstancedShader).
+	 *
+	 * The primitives of the levels are drawn with indirect draws: the number of instances of each draw is written by
+	 * the compute-shader into the command-buffer, so the CPU only sets the uniforms of the camera per frame. The
+	 * dispatch is ordered by its render-bin (-1) before the scene is drawn. Needs OpenGL 4.3 and OSG 3.6.
+	 */
+	class InstanceCuller : public osg::Geode {
+	public:
+
+		/**
+		 * \brief Constructor of the culler.
+		 *
+		 * \param modelBound
+		 *      Bounding-sphere of the unscaled LOD-model (used for the selection of the level).
+		 * \param rangeMode
+		 *      Range-mode of the LOD-model.
+		 * \param shared
+		 *      State-set of the instanced model (the list of the visible instances is bound to it).
+		 */
+		InstanceCuller(const osg::BoundingSphere &modelBound, osg::LOD::RangeMode rangeMode, osg::StateSet* shared);
+
+
+		/**
+		 * \brief Check if the indirect draws are supported by the version of OSG.
+		 *
+		 * \return True if the instances can be culled on the GPU.
+		 */
+		static bool isSupported();
+
+
+		/**
+		 * \brief Add a level of detail: its primitives are replaced by indirect draws.
+		 *
+		 * \param minRange, maxRange
+		 *      Range of the pixel-size or the distance to the camera.
+		 * \param geode
+		 *      Geode with the instanced geometries of the level.
+		 */
+		void addLevel(float minRange, float maxRange, osg::Geode* geode);
+
+
+		/**
+		 * \brief Resize the list of the visible instances, so each level can hold all instances.
+		 *
+		 * \param cntInstances
+		 *      Number of instances.
+		 */
+		void reserve(unsigned int cntInstances);
+
+
+		/**
+		 * \brief Set the camera of the next dispatch and reset the number of instances of the draws.
+		 * (called by the instanced model during the cull-traversal)
+		 *
+		 * \param cv
+		 *      Cull-visitor of the camera (position, projection and LOD-scale).
+		 */
+		void update(osgUtil::CullVisitor* cv);
+
+
+		/**
+		 * \brief Read the positions from the shader-storage-buffer of the bodies (see ComputeGravity).
+		 */
+		void setReadsBodies();
+
+
+		/**
+		 * \brief Enable or disable the culling on the GPU (has to be set before loading the scene).
+		 *
+		 * \param isEnabled
+		 *      True if the instances are culled on the GPU.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the culling on the GPU is enabled.
+		 *
+		 * \return True if the instances are culled on the GPU.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	protected:
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~InstanceCuller();
+
+
+	private:
+
+		//! Invocations per work-group (one instance per invocation)
+		static const int GROUP_SIZE = 64;
+		//! Maximum number of levels of detail (incl. the impostors)
+		static const int MAX_LEVELS = 8;
+		//! Maximum number of occluders per model
+		static const int MAX_OCCLUDERS = 8;
+		//! Binding-point of the shader-storage-buffer with the commands of the indirect draws
+		static const int COMMAND_BINDING = 2;
+		//! Number of values of a command (DrawElementsIndirectCommand, the DrawArraysIndirectCommand uses the first 4)
+		static const unsigned int COMMAND_SIZE = 5;
+
+		//! State-set of the instanced model
+		osg::ref_ptr<osg::StateSet> _shared;
+
+		//! Commands of the indirect draws (the second value is the number of instances)
+		osg::ref_ptr<osg::UIntArray> _commands;
+		//! Visible instances of each level (capacity per level)
+		osg::ref_ptr<osg::UIntArray> _visible;
+
+		//! Number of instances which each level can hold
+		unsigned int _capacity;
+
+		//! Index of the first command of each level (and the end of the last one)
+		std::vector<unsigned int> _firstCommands;
+
+		//! Offset of each level in the list of the visible instances (uniform of its geode)
+		std::vector<osg::ref_ptr<osg::Uniform> > _visibleOffsets;
+
+		//! Ranges and commands of the levels
+		osg::ref_ptr<osg::Uniform> _minRanges;
+		osg::ref_ptr<osg::Uniform> _maxRanges;
+		osg::ref_ptr<osg::Uniform> _firstCommandsUniform;
+		osg::ref_ptr<osg::Uniform> _cntLevels;
+
+		//! Number of instances and their capacity per level
+		osg::ref_ptr<osg::Uniform> _cntInstances;
+		osg::ref_ptr<osg::Uniform> _capacityUniform;
+
+		//! Camera of the next dispatch
+		osg::ref_ptr<osg::Uniform> _cullMatrix;
+		osg::ref_ptr<osg::Uniform> _eye;
+		osg::ref_ptr<osg::Uniform> _pixelSizeVector;
+		osg::ref_ptr<osg::Uniform> _lodScale;
+
+		//! Spheres of the occluders (center and radius)
+		osg::ref_ptr<osg::Uniform> _occluders;
+		osg::ref_ptr<osg::Uniform> _cntOccluders;
+
+		//! Dispatch of the compute-shader
+		osg::ref_ptr<DispatchDrawable> _dispatch;
+
+		//! True if the instances are culled on the GPU
+		static bool IS_ENABLED;
+
+
+		/**
+		 * \brief Bind the commands to the state-set of the dispatch (again after they have been resized).
+		 */
+		void bindCommands();
+	};
+}
@@ -0,0 +1,146 @@
+﻿/**
+ * \brief Functionality for managing the instanced models to draw all objects with the same model together.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-20
+ */
+
+#include "InstanceManager.h"
+
+#include <OpenThreads/ScopedLock>
+
+#include <sstream>
+
+#include "ImageManager.h"
+#include "ModelManager.h"
+#include "ProceduralAsteroid.h"
+
+using namespace pbs17;
+
+
+//! Pointer to the only instance of this class.
+InstanceManager* InstanceManager::_pInstance = nullptr;
+
+//! The instancing is disabled by default (needs OpenGL 3.2).
+bool InstanceManager::IS_ENABLED = false;
+
+
+/**
+ * \brief Singleton instance of the InstanceManager-class.
+ */
+InstanceManager* InstanceManager::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new InstanceManager();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Get the instanced model of a model-file with its textures. It's implemented in a way that the
+ * model is prepared only once per size and format of the textures, the textures themselves are layers of
+ * its texture-arrays. All seeds of the generated asteroids share one model (see ProceduralAsteroid).
+ *
+ * \param modelPath
+ *      Complete path to the model.
+ * \param texturePath
+ *      Complete path to the image-texture ("" => white).
+ * \param bumpmapPath
+ *      Complete path to the normal-texture ("" => the normals of the model are used).
+ * \param layer
+ *      Layer of the textures in the instanced model (output).
+ *
+ * \return Instanced model to add the instances to.
+ */
+osg::ref_ptr<InstancedModel> InstanceManager::getModel(std::string modelPath, std::string texturePath, std::string bumpmapPath, unsigned int &layer) {
+	// the layers of a texture-array need their images (they are not streamed, see TextureStreamer)
+	osg::ref_ptr<osg::Image> texture = texturePath != "" ? ImageManager::Instance()->loadImage(texturePath) : nullptr;
+	osg::ref_ptr<osg::Image> normals = bumpmapPath != "" ? ImageManager::Instance()->loadImage(bumpmapPath) : nullptr;
+
+	// the icosphere is displaced by the seed of each instance in the shader
+	bool isProcedural = ProceduralAsteroid::isProcedural(modelPath);
+	if (isProcedural) {
+		modelPath = ProceduralAsteroid::getBasePath(modelPath);
+	}
+
+	std::string key = modelPath + "|" + getSignature(texture.get()) + "|" + (normals.valid() ? getSignature(normals.get()) : "");
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	std::map<std::string, osg::ref_ptr<InstancedModel> >::iterator found = _models.find(key);
+	osg::ref_ptr<InstancedModel> instancedModel;
+
+	if (found != _models.end()) {
+		instancedModel = found->second;
+	} else {
+		// model wasn't found => prepare it from the shared model
+		osg::ref_ptr<osg::LOD> model = ModelManager::Instance()->loadModel(modelPath);
+
+		instancedModel = new InstancedModel(model, normals.valid(), isProcedural);
+		_root->addChild(instancedModel);
+		_models[key] = instancedModel;
+	}
+
+	layer = instancedModel->addLayer(texturePath + "|" + bumpmapPath, texture, normals);
+
+	return instancedModel;
+}
+
+
+/**
+ * \brief Add a sphere which hides the instances behind it (e.g. a planet), used by the culling on the GPU
+ *        (see InstanceCuller).
+ *
+ * \param transformation
+ *      Transformation of the occluder (its translation is the center of the sphere).
+ * \param radius
+ *      Radius of a sphere which lies completely inside the model.
+ */
+void InstanceManager::addOccluder(osg::ref_ptr<osg::MatrixTransform> transformation, float radius) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_occluders.push_back(std::make_pair(osg::observer_ptr<osg::MatrixTransform>(transformation.get()), radius));
+}
+
+
+/**
+ * \brief Get the current spheres of the occluders.
+ *
+ * \return Center and radius of each occluder.
+ */
+std::vector<osg::Vec4> InstanceManager::getOccluders() {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	std::vector<osg::Vec4> occluders;
+
+	for (unsigned int o = 0; o < _occluders.size(); ++o) {
+		osg::ref_ptr<osg::MatrixTransform> transformation;
+
+		// removed objects don't hide anything anymore
+		if (_occluders[o].first.lock(transformation)) {
+			occluders.push_back(osg::Vec4(transformation->getMatrix().getTrans(), _occluders[o].second));
+		}
+	}
+
+	return occluders;
+}
+
+
+/**
+ * \brief Get the signature of an image: images with the same signature can be layers of the same
+ *        texture-array.
+ *
+ * \param image
+ *      Image of a texture (nullptr => white).
+ *
+ * \return Size, format and number of mipmaps of the image.
+ */
+std::string InstanceManager::getSignature(const osg::Image* image) {
+	if (!image) {
+		return "white";
+	}
+
+	std::ostringstream signature;
+	signature << image->s() << "x" << image->t() << "_" << image->getPixelFormat() << "_" << image->getNumMipmapLevels();
+
+	return signature.str();
+}
@@ -0,0 +1,153 @@
+﻿/**
+ * \brief Functionality for managing the instanced models to draw all objects with the same model together.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-20
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <osg/Group>
+#include <osg/MatrixTransform>
+#include <osg/observer_ptr>
+#include <OpenThreads/Mutex>
+
+#include "InstancedModel.h"
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief InstanceManager manages the instanced models of the scene.
+	 * The objects with the same model and textures of the same size share one InstancedModel, which draws all of them
+	 * with one draw-call per level of detail. All instanced models are children of the root of the manager, which has to
+	 * be added once to the scene.
+	 */
+	class InstanceManager {
+	public:
+
+		/**
+		 * \brief Singleton instance of the InstanceManager-class.
+		 */
+		static InstanceManager* Instance();
+
+
+		/**
+		 * \brief Get the instanced model of a model-file with its textures. It's implemented in a way that the
+		 * model is prepared only once per size and format of the textures, the textures themselves are layers of
+		 * its texture-arrays. All seeds of the generated asteroids share one model (see ProceduralAsteroid).
+		 *
+		 * \param modelPath
+		 *      Complete path to the model.
+		 * \param texturePath
+		 *      Complete path to the image-texture ("" => white).
+		 * \param bumpmapPath
+		 *      Complete path to the normal-texture ("" => the normals of the model are used).
+		 * \param layer
+		 *      Layer of the textures in the instanced model (output).
+		 *
+		 * \return Instanced model to add the instances to.
+		 */
+		osg::ref_ptr<InstancedModel> getModel(std::string modelPath, std::string texturePath, std::string bumpmapPath, unsigned int &layer);
+
+
+		/**
+		 * \brief Add a sphere which hides the instances behind it (e.g. a planet), used by the culling on the GPU
+		 *        (see InstanceCuller).
+		 *
+		 * \param transformation
+		 *      Transformation of the occluder (its translation is the center of the sphere).
+		 * \param radius
+		 *      Radius of a sphere which lies completely inside the model.
+		 */
+		void addOccluder(osg::ref_ptr<osg::MatrixTransform> transformation, float radius);
+
+
+		/**
+		 * \brief Get the current spheres of the occluders.
+		 *
+		 * \return Center and radius of each occluder.
+		 */
+		std::vector<osg::Vec4> getOccluders();
+
+
+		/**
+		 * \brief Get the node which contains all instanced models.
+		 *
+		 * \return Root of the instanced models.
+		 */
+		osg::ref_ptr<osg::Group> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Enable or disable the instancing (if disabled, each asteroid has its own subtree). Has to be set
+		 *        before loading the scene.
+		 *
+		 * \param isEnabled
+		 *      True if the asteroids are drawn instanced.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the instancing is enabled.
+		 *
+		 * \return True if the asteroids are drawn instanced.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+
+		//! All instanced models which have been prepared already (key = model and the signatures of the textures).
+		std::map<std::string, osg::ref_ptr<InstancedModel> > _models;
+
+		//! Root of the instanced models
+		osg::ref_ptr<osg::Group> _root;
+
+		//! Transformations and radii of the occluders
+		std::vector<std::pair<osg::observer_ptr<osg::MatrixTransform>, float> > _occluders;
+
+		//! Protects the map, the root and the occluders.
+		OpenThreads::Mutex _mutex;
+
+		//! True if the asteroids are drawn instanced
+		static bool IS_ENABLED;
+
+
+		/**
+		 * \brief Get the signature of an image: images with the same signature can be layers of the same
+		 *        texture-array.
+		 *
+		 * \param image
+		 *      Image of a texture (nullptr => white).
+		 *
+		 * \return Size, format and number of mipmaps of the image.
+		 */
+		static std::string getSignature(const osg::Image* image);
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		InstanceManager() : _root(new osg::Group) {}
+
+		//! Private copy-constructor to prevent copying the class.
+		InstanceManager(InstanceManager const&) {}
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		InstanceManager& operator=(InstanceManager const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static InstanceManager* _pInstance;
+	};
+}
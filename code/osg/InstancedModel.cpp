@@ -0,0 +1,652 @@
+﻿/**
+ * \brief Functionality for drawing all instances of a model with one draw-call per level of detail.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-20
+ */
+
+#include "InstancedModel.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include <osg/Camera>
+#include <osg/Math>
+#include <osg/MatrixTransform>
+#include <osg/NodeVisitor>
+#include <osg/Program>
+#include <osg/Texture2D>
+#include <osgUtil/CullVisitor>
+
+#include "InstanceCuller.h"
+#include "Loader.h"
+#include "MaterialCache.h"
+#include "StereoRenderer.h"
+#include "shaders/ImpostorShader.h"
+#include "shaders/InstancedShader.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Collects the geometries of a model.
+	 */
+	class GeometryCollector : public osg::NodeVisitor {
+	public:
+		std::vector<osg::Geometry*> geometries;
+
+		GeometryCollector() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+		void apply(osg::Geode &geode) override {
+			for (unsigned int i = 0; i < geode.getNumDrawables(); ++i) {
+				osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
+
+				if (geometry) {
+					geometries.push_back(geometry);
+				}
+			}
+		}
+	};
+
+
+	/**
+	 * \brief Updates the instances before the levels are culled.
+	 */
+	class InstancesCullCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+
+			if (cv) {
+				static_cast<InstancedModel*>(node)->updateInstances(cv);
+			}
+
+			traverse(node, nv);
+		}
+	};
+
+
+	/**
+	 * \brief The geometries of the levels are bounded by all instances instead of the model (used for the near- and
+	 *        far-plane of the camera).
+	 */
+	class InstancesBoundCallback : public osg::Drawable::ComputeBoundingBoxCallback {
+	public:
+		explicit InstancesBoundCallback(const InstancedModel* model) : _model(model) {}
+
+		osg::BoundingBox computeBound(const osg::Drawable &) const override {
+			return _model->getInstancesBound();
+		}
+
+	private:
+		const InstancedModel* _model;
+	};
+
+
+	/**
+	 * \brief Lets the camera of the impostor-atlas render only at the first frame.
+	 */
+	class RenderOnceCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			traverse(node, nv);
+			node->setNodeMask(0);
+		}
+	};
+}
+
+
+//! Pixel-size on the screen below which the instances are drawn as impostors
+const float InstancedModel::IMPOSTOR_PIXEL_SIZE = 16.0f;
+//! Number of views of the impostor-atlas
+const int InstancedModel::IMPOSTOR_VIEWS = 8;
+//! Size of a view of the impostor-atlas in pixels
+const int InstancedModel::IMPOSTOR_SIZE = 64;
+
+
+/**
+ * \brief Constructor of the instanced model.
+ *
+ * \param model
+ *      LOD-model of the ModelManager (its geometries are shared, the primitives are copied).
+ * \param useBumpmap
+ *      True if the layers have a normal-texture (otherwise the normals of the model are used).
+ * \param isProcedural
+ *      True if the model is the icosphere of the generated asteroids (displaced by the seeds of the instances).
+ */
+InstancedModel::InstancedModel(osg::ref_ptr<osg::LOD> model, bool useBumpmap, bool isProcedural)
+	: _radius(model->getBound().radius() + (model->getBound().center()).length()), _modelBound(model->getBound()),
+	_rangeMode(model->getRangeMode()), _viewportHeight(new osg::Uniform("viewportHeight", 1.0f)),
+	_textures(createTextureArray()), _normals(useBumpmap ? createTextureArray() : nullptr), _isProcedural(isProcedural) {
+	setDataVariance(osg::Object::DYNAMIC);
+	_viewportHeight->setDataVariance(osg::Object::DYNAMIC);
+	// the instances are placed by the shader => the bounds of the nodes are not related to the instances
+	setCullingActive(false);
+	setCullCallback(new InstancesCullCallback);
+
+	if (InstanceCuller::getIsEnabled()) {
+		// the matrices of all instances are read by the dispatch and the levels through the list of the visible ones
+		_culler = new InstanceCuller(_modelBound, _rangeMode, getOrCreateStateSet());
+		addChild(_culler);
+
+		_matrixImage = new osg::Image;
+		_matrixImage->setDataVariance(osg::Object::DYNAMIC);
+		_matrixBuffer = new osg::TextureBuffer;
+		_matrixBuffer->setInternalFormat(GL_RGBA32F_ARB);
+		_matrixBuffer->setImage(_matrixImage);
+		getOrCreateStateSet()->setTextureAttribute(InstancedShader::MATRIX_UNIT, _matrixBuffer);
+	}
+
+	// the impostors are only used for the pixel-sizes (simplified models are only used for large scenes)
+	bool useImpostors = _rangeMode == osg::LOD::PIXEL_SIZE_ON_SCREEN && model->getNumChildren() > 1;
+	unsigned int full = 0;
+
+	for (unsigned int i = 0; i < model->getNumChildren(); ++i) {
+		osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+
+		// the instances are placed in the shader => the decoding of a quantized level is passed as uniform (see QuantizeVisitor)
+		osg::MatrixTransform* decode = dynamic_cast<osg::MatrixTransform*>(model->getChild(i));
+		if (decode != nullptr) {
+			osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet(*decode->getOrCreateStateSet());
+			stateset->addUniform(new osg::Uniform("dequantization", osg::Matrixf(decode->getMatrix())));
+			geode->setStateSet(stateset.get());
+		}
+
+		GeometryCollector collector;
+		model->getChild(i)->accept(collector);
+
+		for (unsigned int g = 0; g < collector.geometries.size(); ++g) {
+			// the arrays (incl. the tangents) are shared with the model, only the primitives get the number of instances
+			osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry(*collector.geometries[g], osg::CopyOp::DEEP_COPY_PRIMITIVES);
+			geometry->setDataVariance(osg::Object::DYNAMIC);
+			geometry->setUseDisplayList(false);
+			geometry->setUseVertexBufferObjects(true);
+			geometry->setComputeBoundingBoxCallback(new InstancesBoundCallback(this));
+			geode->addDrawable(geometry);
+		}
+
+		// the smallest levels of a LOD-model on the screen are replaced by the impostors
+		float minRange = model->getMinRange(i);
+		if (useImpostors && minRange < IMPOSTOR_PIXEL_SIZE) {
+			minRange = IMPOSTOR_PIXEL_SIZE;
+		}
+
+		addLevel(minRange, model->getMaxRange(i), geode);
+
+		if (model->getMaxRange(i) > model->getMaxRange(full)) {
+			full = i;
+		}
+	}
+
+	// the layers are added by the InstanceManager
+	InstancedShader shader(_textures, _normals, false, _culler.valid(), _isProcedural);
+	shader.apply(this);
+
+	// same material as the objects which are not instanced (see SpaceObject::initTexturing())
+	MaterialCache::Instance()->applyMaterial(getOrCreateStateSet(), MaterialCache::DEFAULT);
+
+	// the atlas of the generated asteroids shows the undisplaced icosphere (a small point on the screen)
+	if (useImpostors) {
+		addImpostors(model->getChild(full), model->getBound().center());
+	}
+}
+
+
+/**
+ * \brief Destructor.
+ */
+InstancedModel::~InstancedModel() {}
+
+
+/**
+ * \brief Get the layer of a combination of textures or add it to the texture-arrays. All layers must have
+ *        the same size and format (see InstanceManager).
+ *
+ * \param key
+ *      Unique key of the combination (e.g. the paths of the images).
+ * \param texture
+ *      Image of the image-texture (nullptr => white).
+ * \param normals
+ *      Image of the normal-texture (ignored if the model doesn't use a bumpmap).
+ *
+ * \return Layer of the textures.
+ */
+unsigned int InstancedModel::addLayer(const std::string &key, osg::ref_ptr<osg::Image> texture, osg::ref_ptr<osg::Image> normals) {
+	std::map<std::string, unsigned int>::iterator found = _layerKeys.find(key);
+
+	if (found != _layerKeys.end()) {
+		return found->second;
+	}
+
+	// models without a texture are white (as the models which are not instanced)
+	if (!texture.valid()) {
+		texture = new osg::Image;
+		texture->allocateImage(1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE);
+		std::fill(texture->data(), texture->data() + 4, 255);
+	}
+
+	unsigned int layer = _layerKeys.size();
+	_layerKeys[key] = layer;
+
+	// the texture-objects have to be allocated again with the new depth
+	_textures->setTextureDepth(layer + 1);
+	_textures->setImage(layer, texture.get());
+	_textures->dirtyTextureObject();
+
+	if (_normals.valid()) {
+		_normals->setTextureDepth(layer + 1);
+		_normals->setImage(layer, normals.get());
+		_normals->dirtyTextureObject();
+	}
+
+	// the atlas of the impostors is rendered by the fixed function-pipeline, which can't sample the arrays
+	if (layer == 0 && _impostorCamera.valid()) {
+		_impostorCamera->getOrCreateStateSet()->setTextureAttributeAndModes(0, Loader::createTexture(texture.get()),
+			osg::StateAttribute::ON | osg::StateAttribute::PROTECTED);
+	}
+
+	return layer;
+}
+
+
+/**
+ * \brief Add an instance of the model.
+ *
+ * \param matrix
+ *      Model-matrix of the instance (scaling, rotation and translation).
+ * \param layer
+ *      Layer of the textures of the instance (see addLayer()).
+ * \param seed
+ *      Seed of the generated asteroid (ignored if the model is not procedural).
+ *
+ * \return Index of the instance.
+ */
+unsigned int InstancedModel::addInstance(const osg::Matrixf &matrix, unsigned int layer, unsigned int seed) {
+	_matrices.push_back(matrix);
+	_layers.push_back(static_cast<float>(layer));
+	_seeds.push_back(_isProcedural ? static_cast<float>(seed & 0xffffffu) : 0.0f);
+	_matricesDirty = true;
+	return _matrices.size() - 1;
+}
+
+
+/**
+ * \brief Set the body of an instance in the buffer of the bodies (see setReadsBodies()).
+ *
+ * \param instance
+ *      Index of the instance.
+ * \param body
+ *      Index of the body in the shader-storage-buffer.
+ */
+void InstancedModel::setBody(unsigned int instance, unsigned int body) {
+	if (_bodies.size() < _matrices.size()) {
+		_bodies.resize(_matrices.size(), 0);
+	}
+
+	_bodies[instance] = body;
+	_matricesDirty = true;
+}
+
+
+/**
+ * \brief Draw the instances at the positions of the shader-storage-buffer of the bodies, which are integrated
+ *        on the GPU (see ComputeGravity). All instances are drawn with the coarsest level of detail (the levels
+ *        can't be selected without the positions) and their current rotation and scaling.
+ *
+ * \param bound
+ *      Region which contains the bodies (used instead of the bounding-box of the instances).
+ */
+void InstancedModel::setReadsBodies(const osg::BoundingBox &bound) {
+	_readsBodies = true;
+	_bodies.resize(_matrices.size(), 0);
+	_instancesBound = bound;
+
+	// the level is uploaded again with the bodies by the next update
+	_levels[0].cntInstances = 0;
+	_matricesDirty = true;
+
+	InstancedShader shader(_textures, _normals, true, _culler.valid(), _isProcedural);
+	shader.apply(this);
+
+	// the levels are still selected by the culling on the GPU (incl. the impostors)
+	if (_culler.valid()) {
+		_culler->setReadsBodies();
+
+		if (_impostors.valid()) {
+			ImpostorShader impostorShader(_impostorAtlas, IMPOSTOR_VIEWS, _impostorRadius, true, true);
+			impostorShader.apply(_impostors);
+		}
+
+		for (unsigned int d = 0; d < _levels.size(); ++d) {
+			for (unsigned int g = 0; g < _levels[d].geode->getNumDrawables(); ++g) {
+				_levels[d].geode->getDrawable(g)->dirtyBound();
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Assign the instances to the levels of detail and upload their model-matrices.
+ * (called by the cull-callback before the levels are traversed)
+ *
+ * \param cv
+ *      Cull-visitor of the camera (position, projection and LOD-scale).
+ */
+void InstancedModel::updateInstances(osgUtil::CullVisitor* cv) {
+	reserveBuffers();
+	_viewportHeight->set(static_cast<float>(cv->getViewport()->height()));
+
+	if (_culler.valid()) {
+		updateCulledInstances(cv);
+		return;
+	}
+
+	if (_readsBodies) {
+		updateBodyInstances();
+		return;
+	}
+
+	osg::Vec3 eye = cv->getEyeLocal();
+	float lodScale = cv->getLODScale();
+
+	_instancesBound.init();
+	for (unsigned int l = 0; l < _levels.size(); ++l) {
+		_levels[l].cntInstances = 0;
+	}
+
+	for (unsigned int i = 0; i < _matrices.size(); ++i) {
+		const osg::Matrixf &matrix = _matrices[i];
+		osg::Vec3 position = matrix.getTrans();
+		float scaling = osg::Vec3(matrix(0, 0), matrix(0, 1), matrix(0, 2)).length();
+
+		// hidden instances are not drawn at all
+		if (scaling == 0.0f) continue;
+
+		// same range as osg::LOD::traverse() with the bounding-sphere of the instance
+		osg::Vec3 center = _modelBound.center() * matrix;
+		float range = _rangeMode == osg::LOD::PIXEL_SIZE_ON_SCREEN ?
+			cv->clampedPixelSize(center, _modelBound.radius() * scaling) / lodScale : (center - eye).length() * lodScale;
+
+		for (unsigned int l = 0; l < _levels.size(); ++l) {
+			Level &level = _levels[l];
+
+			if (range >= level.minRange && range < level.maxRange) {
+				float* texels = reinterpret_cast<float*>(level.image->data()) + 16 * level.cntInstances;
+				std::copy(matrix.ptr(), matrix.ptr() + 16, texels);
+				// the unused projective elements (1, 3) and (2, 3) hold the layer of the textures and the seed
+				texels[7] = _layers[i];
+				texels[11] = _seeds[i];
+				++level.cntInstances;
+				break;
+			}
+		}
+
+		_instancesBound.expandBy(osg::BoundingSphere(position, _radius * scaling));
+	}
+
+	for (unsigned int l = 0; l < _levels.size(); ++l) {
+		Level &level = _levels[l];
+		level.geode->setNodeMask(level.cntInstances > 0 ? ~0u : 0u);
+
+		for (unsigned int d = 0; d < level.geode->getNumDrawables(); ++d) {
+			osg::Geometry* geometry = level.geode->getDrawable(d)->asGeometry();
+
+			for (unsigned int p = 0; p < geometry->getNumPrimitiveSets(); ++p) {
+				// the instanced stereo draws each instance once per eye
+				geometry->getPrimitiveSet(p)->setNumInstances(level.cntInstances * StereoRenderer::getCntEyes());
+			}
+
+			geometry->dirtyBound();
+		}
+
+		if (level.cntInstances > 0) {
+			level.image->dirty();
+		}
+	}
+}
+
+
+/**
+ * \brief Resize the texture-buffers of the levels, so each of them can hold all instances.
+ */
+void InstancedModel::reserveBuffers() {
+	int texels = 4 * std::max(static_cast<int>(_matrices.size()), 1);
+
+	// the levels of the culling on the GPU share the buffer of all instances
+	if (_culler.valid()) {
+		if (_matrixImage->s() < texels) {
+			_matrixImage->allocateImage(texels, 1, 1, GL_RGBA, GL_FLOAT);
+			_matrixImage->setInternalTextureFormat(GL_RGBA32F_ARB);
+			_matrixBuffer->setTextureWidth(texels);
+			_matricesDirty = true;
+		}
+
+		_culler->reserve(_matrices.size());
+		return;
+	}
+
+	for (unsigned int l = 0; l < _levels.size(); ++l) {
+		Level &level = _levels[l];
+
+		if (level.image->s() < texels) {
+			level.image->allocateImage(texels, 1, 1, GL_RGBA, GL_FLOAT);
+			level.image->setInternalTextureFormat(GL_RGBA32F_ARB);
+			level.buffer->setTextureWidth(texels);
+		}
+	}
+}
+
+
+/**
+ * \brief Create a texture-array with the settings of the loaded textures.
+ *
+ * \return Empty texture-array.
+ */
+osg::ref_ptr<osg::Texture2DArray> InstancedModel::createTextureArray() {
+	osg::ref_ptr<osg::Texture2DArray> textures = new osg::Texture2DArray;
+	textures->setWrap(osg::Texture::WRAP_S, osg::Texture::REPEAT);
+	textures->setWrap(osg::Texture::WRAP_T, osg::Texture::REPEAT);
+	textures->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR_MIPMAP_LINEAR);
+	textures->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+
+	return textures;
+}
+
+
+/**
+ * \brief Upload the rotation, the scaling and the body of all instances into the coarsest level (once).
+ */
+void InstancedModel::updateBodyInstances() {
+	Level &coarsest = _levels[0];
+
+	if (coarsest.cntInstances != _matrices.size()) {
+		for (unsigned int i = 0; i < _matrices.size(); ++i) {
+			// the translation is read from the buffer, the unused projective elements hold the body, the layer and the seed
+			osg::Matrixf matrix = _matrices[i];
+			matrix.setTrans(0.0f, 0.0f, 0.0f);
+			matrix(0, 3) = static_cast<float>(_bodies[i]);
+			matrix(1, 3) = _layers[i];
+			matrix(2, 3) = _seeds[i];
+
+			float* texels = reinterpret_cast<float*>(coarsest.image->data()) + 16 * i;
+			std::copy(matrix.ptr(), matrix.ptr() + 16, texels);
+		}
+
+		coarsest.cntInstances = _matrices.size();
+		coarsest.image->dirty();
+	}
+
+	for (unsigned int l = 0; l < _levels.size(); ++l) {
+		Level &level = _levels[l];
+		level.geode->setNodeMask(l == 0 && level.cntInstances > 0 ? ~0u : 0u);
+	}
+
+	for (unsigned int d = 0; d < coarsest.geode->getNumDrawables(); ++d) {
+		osg::Geometry* geometry = coarsest.geode->getDrawable(d)->asGeometry();
+
+		for (unsigned int p = 0; p < geometry->getNumPrimitiveSets(); ++p) {
+			geometry->getPrimitiveSet(p)->setNumInstances(coarsest.cntInstances * StereoRenderer::getCntEyes());
+		}
+
+		geometry->dirtyBound();
+	}
+}
+
+
+/**
+ * \brief Upload the changed model-matrices of all instances and set the camera of the culling on the GPU.
+ *
+ * \param cv
+ *      Cull-visitor of the camera (position, projection and LOD-scale).
+ */
+void InstancedModel::updateCulledInstances(osgUtil::CullVisitor* cv) {
+	if (_matricesDirty) {
+		// the positions of the bodies are only known by the GPU, their region is the bound
+		if (!_readsBodies) {
+			_instancesBound.init();
+		}
+
+		float* texels = reinterpret_cast<float*>(_matrixImage->data());
+		for (unsigned int i = 0; i < _matrices.size(); ++i) {
+			osg::Matrixf matrix = _matrices[i];
+
+			if (_readsBodies) {
+				// same layout as updateBodyInstances()
+				matrix.setTrans(0.0f, 0.0f, 0.0f);
+				matrix(0, 3) = static_cast<float>(_bodies[i]);
+			} else {
+				float scaling = osg::Vec3(matrix(0, 0), matrix(0, 1), matrix(0, 2)).length();
+				if (scaling > 0.0f) {
+					_instancesBound.expandBy(osg::BoundingSphere(matrix.getTrans(), _radius * scaling));
+				}
+			}
+			// the unused projective elements (1, 3) and (2, 3) hold the layer of the textures and the seed
+			matrix(1, 3) = _layers[i];
+			matrix(2, 3) = _seeds[i];
+
+			std::copy(matrix.ptr(), matrix.ptr() + 16, texels + 16 * i);
+		}
+
+		_matrixImage->dirty();
+		_matricesDirty = false;
+
+		for (unsigned int l = 0; l < _levels.size(); ++l) {
+			for (unsigned int d = 0; d < _levels[l].geode->getNumDrawables(); ++d) {
+				_levels[l].geode->getDrawable(d)->dirtyBound();
+			}
+		}
+	}
+
+	_culler->update(cv);
+}
+
+
+/**
+ * \brief Add a level of detail with its texture-buffer for the model-matrices.
+ *
+ * \param minRange, maxRange
+ *      Range of the pixel-size or the distance to the camera.
+ * \param geode
+ *      Geode with the instanced geometries.
+ */
+void InstancedModel::addLevel(float minRange, float maxRange, osg::ref_ptr<osg::Geode> geode) {
+	Level level;
+	level.minRange = minRange;
+	level.maxRange = maxRange;
+	level.cntInstances = 0;
+	level.geode = geode;
+	level.geode->setCullingActive(false);
+
+	if (_culler.valid()) {
+		// the instances of the level are drawn indirect from the buffer of all instances
+		_culler->addLevel(minRange, maxRange, level.geode.get());
+	} else {
+		level.image = new osg::Image;
+		level.image->setDataVariance(osg::Object::DYNAMIC);
+		level.buffer = new osg::TextureBuffer;
+		level.buffer->setInternalFormat(GL_RGBA32F_ARB);
+		level.buffer->setImage(level.image);
+		level.geode->getOrCreateStateSet()->setTextureAttribute(InstancedShader::MATRIX_UNIT, level.buffer);
+	}
+
+	addChild(level.geode);
+	_levels.push_back(level);
+}
+
+
+/**
+ * \brief Add the level of the impostors and the camera which renders their atlas at the first frame.
+ *
+ * \param model
+ *      Full model (the highest level of detail).
+ * \param center
+ *      Center of the bounding-sphere of the unscaled model.
+ */
+void InstancedModel::addImpostors(osg::ref_ptr<osg::Node> model, const osg::Vec3 &center) {
+	float radius = model->getBound().radius() + (model->getBound().center() - center).length();
+
+	osg::ref_ptr<osg::Texture2D> atlas = new osg::Texture2D;
+	atlas->setTextureSize(IMPOSTOR_VIEWS * IMPOSTOR_SIZE, IMPOSTOR_SIZE);
+	atlas->setInternalFormat(GL_RGBA);
+	atlas->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+	atlas->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+
+	// the views are placed side by side in front of an orthographic camera (view k is rotated by k * 2pi / views)
+	osg::ref_ptr<osg::Camera> camera = new osg::Camera;
+	camera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+	camera->setRenderOrder(osg::Camera::PRE_RENDER);
+	camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+	camera->attach(osg::Camera::COLOR_BUFFER, atlas.get());
+	camera->setViewport(0, 0, IMPOSTOR_VIEWS * IMPOSTOR_SIZE, IMPOSTOR_SIZE);
+	camera->setClearColor(osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+	camera->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+	camera->setProjectionMatrixAsOrtho(0.0, 2.0 * radius * IMPOSTOR_VIEWS, -radius, radius, -radius, radius);
+	camera->setViewMatrix(osg::Matrix::identity());
+	camera->setCullCallback(new RenderOnceCallback);
+
+	for (int k = 0; k < IMPOSTOR_VIEWS; ++k) {
+		osg::ref_ptr<osg::MatrixTransform> view = new osg::MatrixTransform;
+		view->setMatrix(osg::Matrix::translate(-center) *
+			osg::Matrix::rotate(2.0 * osg::PI * k / IMPOSTOR_VIEWS, osg::Vec3(0.0f, 1.0f, 0.0f)) *
+			osg::Matrix::translate((2.0 * k + 1.0) * radius, 0.0, 0.0));
+		view->addChild(model);
+		camera->addChild(view);
+	}
+
+	// the atlas contains the unlit texture of the model, it's lit by the impostor-shader
+	osg::StateSet* stateset = camera->getOrCreateStateSet();
+	stateset->setAttributeAndModes(new osg::Program, osg::StateAttribute::ON | osg::StateAttribute::PROTECTED);
+	stateset->setTextureMode(1, GL_TEXTURE_2D, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
+	stateset->setMode(GL_LIGHTING, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
+	addChild(camera);
+	_impostorCamera = camera;
+
+	// one point per instance at the center of the model
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+	vertices->push_back(center);
+
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry->setDataVariance(osg::Object::DYNAMIC);
+	geometry->setUseDisplayList(false);
+	geometry->setUseVertexBufferObjects(true);
+	geometry->setVertexArray(vertices);
+	geometry->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, 1));
+	geometry->setComputeBoundingBoxCallback(new InstancesBoundCallback(this));
+
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	geode->addDrawable(geometry);
+
+	ImpostorShader shader(atlas, IMPOSTOR_VIEWS, radius, false, _culler.valid());
+	shader.apply(geode);
+	geode->getOrCreateStateSet()->addUniform(_viewportHeight);
+
+	_impostorAtlas = atlas;
+	_impostorRadius = radius;
+	_impostors = geode;
+
+	addLevel(0.0f, IMPOSTOR_PIXEL_SIZE, geode);
+}
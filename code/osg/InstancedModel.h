@@ -0,0 +1,311 @@
+﻿/**
+ * \brief Functionality for drawing all instances of a model with one draw-call per level of detail.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-20
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <osg/Camera>
+#include <osg/Group>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/LOD>
+#include <osg/Image>
+#include <osg/Matrixf>
+#include <osg/Texture2D>
+#include <osg/Texture2DArray>
+#include <osg/TextureBuffer>
+#include <osg/Uniform>
+
+
+// Forward declarations
+namespace osgUtil {
+	class CullVisitor;
+}
+
+namespace pbs17 {
+	class InstanceCuller;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief InstancedModel draws all instances of a model (with textures of the same size) instead of a subtree per object.
+	 * Each level of the LOD-model is a copy of its geometries whose primitives are drawn instanced
+	 * (glDrawElementsInstanced). During the cull-traversal, the instances are assigned to the levels in the same way
+	 * as the LOD-model would do it (pixel-size on the screen or distance to the camera, scaled by the LOD-scale of the
+	 * camera), and their model-matrices are uploaded into a texture-buffer per level (see InstancedShader).
+	 * The textures of the instances are the layers of a texture-array, so instances with different textures are
+	 * still drawn together (the layer is passed in the model-matrix). The generated asteroids share the icosphere of
+	 * all seeds, the seed of an instance is passed in the model-matrix as well (see ProceduralAsteroid).
+	 *
+	 * Below IMPOSTOR_PIXEL_SIZE, the instances are drawn as point-sprites (one point per instance, see ImpostorShader),
+	 * which show one of the views of an atlas. The atlas is rendered once from the full model at the first frame.
+	 *
+	 * If the culling on the GPU is enabled, the model-matrices of all instances are uploaded into one texture-buffer
+	 * (only when they have changed) and the levels are assigned by a compute-shader instead (see InstanceCuller).
+	 */
+	class InstancedModel : public osg::Group {
+	public:
+
+		/**
+		 * \brief Constructor of the instanced model.
+		 *
+		 * \param model
+		 *      LOD-model of the ModelManager (its geometries are shared, the primitives are copied).
+		 * \param useBumpmap
+		 *      True if the layers have a normal-texture (otherwise the normals of the model are used).
+		 * \param isProcedural
+		 *      True if the model is the icosphere of the generated asteroids (displaced by the seeds of the instances).
+		 */
+		InstancedModel(osg::ref_ptr<osg::LOD> model, bool useBumpmap, bool isProcedural = false);
+
+
+		/**
+		 * \brief Get the layer of a combination of textures or add it to the texture-arrays. All layers must have
+		 *        the same size and format (see InstanceManager).
+		 *
+		 * \param key
+		 *      Unique key of the combination (e.g. the paths of the images).
+		 * \param texture
+		 *      Image of the image-texture (nullptr => white).
+		 * \param normals
+		 *      Image of the normal-texture (ignored if the model doesn't use a bumpmap).
+		 *
+		 * \return Layer of the textures.
+		 */
+		unsigned int addLayer(const std::string &key, osg::ref_ptr<osg::Image> texture, osg::ref_ptr<osg::Image> normals);
+
+
+		/**
+		 * \brief Add an instance of the model.
+		 *
+		 * \param matrix
+		 *      Model-matrix of the instance (scaling, rotation and translation).
+		 * \param layer
+		 *      Layer of the textures of the instance (see addLayer()).
+		 * \param seed
+		 *      Seed of the generated asteroid (ignored if the model is not procedural).
+		 *
+		 * \return Index of the instance.
+		 */
+		unsigned int addInstance(const osg::Matrixf &matrix, unsigned int layer = 0, unsigned int seed = 0);
+
+
+		/**
+		 * \brief Set the model-matrix of an instance (it's uploaded with the next frame).
+		 *
+		 * \param instance
+		 *      Index of the instance.
+		 * \param matrix
+		 *      Model-matrix of the instance (scaling, rotation and translation, zero => hidden).
+		 */
+		void setMatrix(unsigned int instance, const osg::Matrixf &matrix) {
+			_matrices[instance] = matrix;
+			_matricesDirty = true;
+		}
+
+
+		/**
+		 * \brief Get the number of instances.
+		 *
+		 * \return Number of instances.
+		 */
+		unsigned int getNumInstances() const {
+			return _matrices.size();
+		}
+
+
+		/**
+		 * \brief Assign the instances to the levels of detail and upload their model-matrices.
+		 * (called by the cull-callback before the levels are traversed)
+		 *
+		 * \param cv
+		 *      Cull-visitor of the camera (position, projection and LOD-scale).
+		 */
+		void updateInstances(osgUtil::CullVisitor* cv);
+
+
+		/**
+		 * \brief Set the body of an instance in the buffer of the bodies (see setReadsBodies()).
+		 *
+		 * \param instance
+		 *      Index of the instance.
+		 * \param body
+		 *      Index of the body in the shader-storage-buffer.
+		 */
+		void setBody(unsigned int instance, unsigned int body);
+
+
+		/**
+		 * \brief Draw the instances at the positions of the shader-storage-buffer of the bodies, which are integrated
+		 *        on the GPU (see ComputeGravity). All instances are drawn with the coarsest level of detail (the levels
+		 *        can't be selected without the positions, unless they are culled on the GPU) and their current
+		 *        rotation and scaling.
+		 *
+		 * \param bound
+		 *      Region which contains the bodies (used instead of the bounding-box of the instances).
+		 */
+		void setReadsBodies(const osg::BoundingBox &bound);
+
+
+		/**
+		 * \brief Get the bounding-box of all instances of the last update (used by the geometries of the levels).
+		 *
+		 * \return Bounding-box in the world-space.
+		 */
+		const osg::BoundingBox& getInstancesBound() const {
+			return _instancesBound;
+		}
+
+
+	protected:
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~InstancedModel();
+
+
+	private:
+
+		/**
+		 * \brief Level of detail with its own copy of the geometries and its own model-matrices.
+		 */
+		struct Level {
+			//! Range of the pixel-size or the distance to the camera (same as the LOD-model)
+			float minRange, maxRange;
+			//! Geode with the instanced geometries
+			osg::ref_ptr<osg::Geode> geode;
+			//! Model-matrices of the instances in this level (4 RGBA-texels per instance)
+			osg::ref_ptr<osg::Image> image;
+			//! Texture-buffer of the model-matrices
+			osg::ref_ptr<osg::TextureBuffer> buffer;
+			//! Number of instances in this level since the last update
+			unsigned int cntInstances;
+		};
+
+		//! Pixel-size on the screen below which the instances are drawn as impostors (see osg::CullStack::pixelSize())
+		static const float IMPOSTOR_PIXEL_SIZE;
+		//! Number of views of the impostor-atlas (rotated around the y-axis of the model)
+		static const int IMPOSTOR_VIEWS;
+		//! Size of a view of the impostor-atlas in pixels
+		static const int IMPOSTOR_SIZE;
+
+		//! Levels of detail
+		std::vector<Level> _levels;
+
+		//! Model-matrix of each instance
+		std::vector<osg::Matrixf> _matrices;
+
+		//! Radius of the bounding-sphere of the unscaled model (around its origin)
+		float _radius;
+
+		//! Bounding-sphere of the unscaled LOD-model (used for the selection of the level)
+		osg::BoundingSphere _modelBound;
+
+		//! Range-mode of the LOD-model
+		osg::LOD::RangeMode _rangeMode;
+
+		//! Bounding-box of all instances of the last update
+		osg::BoundingBox _instancesBound;
+
+		//! Height of the viewport of the last update (used by the impostors)
+		osg::ref_ptr<osg::Uniform> _viewportHeight;
+
+		//! Texture-arrays of the model (the shader is replaced if the positions are read from the buffer of the bodies)
+		osg::ref_ptr<osg::Texture2DArray> _textures;
+		osg::ref_ptr<osg::Texture2DArray> _normals;
+
+		//! Layer of each combination of textures (key = paths of the images)
+		std::map<std::string, unsigned int> _layerKeys;
+
+		//! Layer of the textures of each instance
+		std::vector<float> _layers;
+
+		//! True if the model is the icosphere of the generated asteroids
+		bool _isProcedural;
+		//! Seed of each instance (24 bit => exact as float)
+		std::vector<float> _seeds;
+
+		//! Camera which renders the impostor-atlas (nullptr if there are no impostors)
+		osg::ref_ptr<osg::Camera> _impostorCamera;
+
+		//! True if the positions are read from the buffer of the bodies
+		bool _readsBodies = false;
+		//! Index of the body of each instance in the buffer of the bodies
+		std::vector<unsigned int> _bodies;
+
+		//! Culling on the GPU (nullptr => the instances are assigned to the levels by the CPU)
+		osg::ref_ptr<InstanceCuller> _culler;
+		//! Model-matrices of all instances for the culling on the GPU (4 RGBA-texels per instance)
+		osg::ref_ptr<osg::Image> _matrixImage;
+		//! Texture-buffer of the model-matrices of all instances
+		osg::ref_ptr<osg::TextureBuffer> _matrixBuffer;
+		//! True if the model-matrices have changed since the last upload
+		bool _matricesDirty = true;
+
+		//! Atlas, radius and geode of the impostors (the shader is replaced if the positions are read from the bodies)
+		osg::ref_ptr<osg::Texture2D> _impostorAtlas;
+		float _impostorRadius = 0.0f;
+		osg::ref_ptr<osg::Geode> _impostors;
+
+
+		/**
+		 * \brief Add a level of detail with its texture-buffer for the model-matrices.
+		 *
+		 * \param minRange, maxRange
+		 *      Range of the pixel-size or the distance to the camera.
+		 * \param geode
+		 *      Geode with the instanced geometries.
+		 */
+		void addLevel(float minRange, float maxRange, osg::ref_ptr<osg::Geode> geode);
+
+
+		/**
+		 * \brief Add the level of the impostors and the camera which renders their atlas at the first frame.
+		 *
+		 * \param model
+		 *      Full model (the highest level of detail).
+		 * \param center
+		 *      Center of the bounding-sphere of the unscaled model.
+		 */
+		void addImpostors(osg::ref_ptr<osg::Node> model, const osg::Vec3 &center);
+
+
+		/**
+		 * \brief Resize the texture-buffers of the levels, so each of them can hold all instances.
+		 */
+		void reserveBuffers();
+
+
+		/**
+		 * \brief Create a texture-array with the settings of the loaded textures.
+		 *
+		 * \return Empty texture-array.
+		 */
+		static osg::ref_ptr<osg::Texture2DArray> createTextureArray();
+
+
+		/**
+		 * \brief Upload the rotation, the scaling and the body of all instances into the coarsest level (once).
+		 */
+		void updateBodyInstances();
+
+
+		/**
+		 * \brief Upload the changed model-matrices of all instances and set the camera of the culling on the GPU.
+		 *
+		 * \param cv
+		 *      Cull-visitor of the camera (position, projection and LOD-scale).
+		 */
+		void updateCulledInstances(osgUtil::CullVisitor* cv);
+	};
+}
@@ -13,7 +13,7 @@
 using json = nlohmann::json;
 
 namespace pbs17 {
-	inline Eigen::Vector3d fromJson(json j) {
+	inline Eigen::Vector3d fromJson(const json &j) {
 		return Eigen::Vector3d(
 			j["x"].get<double>(),
 			j["y"].get<double>(),
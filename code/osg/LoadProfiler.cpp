@@ -0,0 +1,297 @@
+﻿/**
+ * \brief Functionality for measuring the phases of the loading of a scene and the time of each asset.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "LoadProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <OpenThreads/ScopedLock>
+#include <json.hpp>
+
+#include "../physics/Logger.h"
+
+using namespace pbs17;
+using json = nlohmann::json;
+
+
+//! Singleton-instance
+LoadProfiler* LoadProfiler::_pInstance = nullptr;
+
+//! The loading is measured by default (a timer per asset and phase).
+bool LoadProfiler::IS_ENABLED = true;
+
+//! The slowest assets which fit into the console.
+const unsigned int LoadProfiler::CNT_OFFENDERS = 10;
+
+
+namespace {
+	//! Innermost running timer of each thread (its time is reduced by the nested timers)
+	thread_local LoadProfiler::ScopedTimer* currentTimer = nullptr;
+}
+
+
+/**
+ * \brief Start the timer of a phase.
+ *
+ * \param phase
+ *      Measured phase.
+ * \param asset
+ *      Complete path of the processed asset ("" => the time is not part of an asset).
+ */
+LoadProfiler::ScopedTimer::ScopedTimer(Phase phase, const std::string &asset)
+	: _phase(phase), _start(0), _nested(0.0), _parent(nullptr) {
+	if (!IS_ENABLED) return;
+
+	// the loading starts with the first timer if the program has not started it
+	LoadProfiler::Instance();
+
+	_asset = asset;
+	_parent = currentTimer;
+	currentTimer = this;
+	_start = osg::Timer::instance()->tick();
+}
+
+
+/**
+ * \brief Stop the timer and add its own time to its phase and asset.
+ */
+LoadProfiler::ScopedTimer::~ScopedTimer() {
+	if (currentTimer != this) return;
+
+	double elapsed = osg::Timer::instance()->delta_s(_start, osg::Timer::instance()->tick());
+	currentTimer = _parent;
+
+	if (_parent != nullptr) {
+		_parent->_nested += elapsed;
+	}
+
+	LoadProfiler::Instance()->add(_phase, _asset, elapsed - _nested);
+}
+
+
+/**
+ * \brief Private constructor of the profiler.
+ */
+LoadProfiler::LoadProfiler() : _start(osg::Timer::instance()->tick()), _loadTime(0.0) {
+	std::fill(_phases, _phases + CNT_PHASES, 0.0);
+}
+
+
+/**
+ * \brief Singleton instance of the LoadProfiler-class.
+ */
+LoadProfiler* LoadProfiler::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new LoadProfiler();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Restart the time of the loading (at the start of the program).
+ */
+void LoadProfiler::start() {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_start = osg::Timer::instance()->tick();
+}
+
+
+/**
+ * \brief Add the time of a phase (called concurrently by the threads which prepare the assets).
+ *
+ * \param phase
+ *      Measured phase.
+ * \param asset
+ *      Complete path of the processed asset ("" => not part of an asset).
+ * \param seconds
+ *      Time of the phase.
+ */
+void LoadProfiler::add(Phase phase, const std::string &asset, double seconds) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_phases[phase] += seconds;
+
+	if (asset != "") {
+		std::vector<double> &times = _assets[asset];
+		times.resize(CNT_PHASES, 0.0);
+		times[phase] += seconds;
+	}
+}
+
+
+/**
+ * \brief Log the time of the loading, the totals of the phases and the slowest assets (at the end of the
+ *        loading of the scene).
+ */
+void LoadProfiler::report() {
+	if (!IS_ENABLED) return;
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_loadTime = osg::Timer::instance()->delta_s(_start, osg::Timer::instance()->tick());
+
+	double work = 0.0;
+	for (int p = 0; p < CNT_PHASES; ++p) {
+		work += _phases[p];
+	}
+
+	std::ostringstream report;
+	report << std::fixed << std::setprecision(3);
+	report << "Loaded in " << _loadTime << " s (" << work << " s of all threads):";
+
+	for (int p = 0; p < CNT_PHASES; ++p) {
+		if (_phases[p] > 0.0) {
+			report << "\n  " << std::left << std::setw(14) << getPhaseName(static_cast<Phase>(p)) << std::right
+				<< std::setw(10) << _phases[p] << " s";
+		}
+	}
+
+	// each asset with its slowest phase
+	std::vector<std::pair<double, std::string> > sorted = getSortedAssets();
+	unsigned int cntOffenders = std::min(CNT_OFFENDERS, static_cast<unsigned int>(sorted.size()));
+
+	if (cntOffenders > 0) {
+		report << "\nSlowest of " << sorted.size() << " assets:";
+	}
+
+	for (unsigned int i = 0; i < cntOffenders; ++i) {
+		const std::vector<double> &times = _assets[sorted[i].second];
+		int slowest = std::max_element(times.begin(), times.end()) - times.begin();
+
+		report << "\n  " << std::setw(10) << sorted[i].first << " s  " << sorted[i].second << " ("
+			<< getPhaseName(static_cast<Phase>(slowest)) << " " << times[slowest] << " s)";
+	}
+
+	LOG_INFO(report.str());
+}
+
+
+/**
+ * \brief Write the time of the loading, the phases and all assets (sorted by their time) as json.
+ *
+ * \param filePath
+ *      Complete path of the json-file (overwritten).
+ *
+ * \return False if the file can't be written.
+ */
+bool LoadProfiler::writeJson(const std::string &filePath) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	json j;
+	j["loadTime"] = _loadTime;
+	j["phases"] = json::object();
+	for (int p = 0; p < CNT_PHASES; ++p) {
+		j["phases"][getPhaseName(static_cast<Phase>(p))] = _phases[p];
+	}
+
+	j["assets"] = json::array();
+	std::vector<std::pair<double, std::string> > sorted = getSortedAssets();
+
+	for (unsigned int i = 0; i < sorted.size(); ++i) {
+		const std::vector<double> &times = _assets[sorted[i].second];
+		json asset;
+		asset["path"] = sorted[i].second;
+		asset["time"] = sorted[i].first;
+		asset["phases"] = json::object();
+
+		for (int p = 0; p < CNT_PHASES; ++p) {
+			if (times[p] > 0.0) {
+				asset["phases"][getPhaseName(static_cast<Phase>(p))] = times[p];
+			}
+		}
+
+		j["assets"].push_back(asset);
+	}
+
+	std::ofstream file(filePath);
+	if (!file) {
+		return false;
+	}
+
+	file << std::setw(2) << j << std::endl;
+	return static_cast<bool>(file);
+}
+
+
+/**
+ * \brief Get the time of a phase.
+ *
+ * \param phase
+ *      Measured phase.
+ *
+ * \return Summed time of the phase in seconds.
+ */
+double LoadProfiler::getTime(Phase phase) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	return _phases[phase];
+}
+
+
+/**
+ * \brief Get the name of a phase.
+ *
+ * \param phase
+ *      Measured phase.
+ *
+ * \return Name of the phase (also used as key of the json-report).
+ */
+const char* LoadProfiler::getPhaseName(Phase phase) {
+	switch (phase) {
+	case SCENE_FILE:
+		return "sceneFile";
+	case MODEL_FILE:
+		return "modelFile";
+	case MODEL_CACHE:
+		return "modelCache";
+	case SIMPLIFIER:
+		return "simplifier";
+	case OPTIMIZER:
+		return "optimizer";
+	case TANGENTS:
+		return "tangents";
+	case CONVEX_HULL:
+		return "convexHull";
+	case TEXTURES:
+		return "textures";
+	case OBJECTS:
+		return "objects";
+	case SIMULATION:
+		return "simulation";
+	case FIRST_FRAME:
+		return "firstFrame";
+	default:
+		return "other";
+	}
+}
+
+
+/**
+ * \brief Get the assets sorted by their summed time (slowest first). Has to be called with the lock.
+ *
+ * \return Assets with their summed time.
+ */
+std::vector<std::pair<double, std::string> > LoadProfiler::getSortedAssets() const {
+	std::vector<std::pair<double, std::string> > sorted;
+	sorted.reserve(_assets.size());
+
+	for (std::map<std::string, std::vector<double> >::const_iterator it = _assets.begin(); it != _assets.end(); ++it) {
+		double time = 0.0;
+		for (unsigned int p = 0; p < it->second.size(); ++p) {
+			time += it->second[p];
+		}
+		sorted.push_back(std::make_pair(time, it->first));
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](const std::pair<double, std::string> &a, const std::pair<double, std::string> &b) {
+		return a.first > b.first;
+	});
+
+	return sorted;
+}
@@ -0,0 +1,216 @@
+﻿/**
+ * \brief Functionality for measuring the phases of the loading of a scene and the time of each asset.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <osg/Timer>
+#include <OpenThreads/Mutex>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief LoadProfiler measures where the start of the program goes: The phases of the loading (reading the
+	 * scene- and model-files, simplifier, optimizer, tangents, convex-hulls, textures, ...) are measured with a
+	 * ScopedTimer, which only counts its own time (the nested timers are subtracted), and their time is also
+	 * summed per asset. The assets are prepared concurrently, so the sum of the phases (the work of all threads)
+	 * can be larger than the time of the loading.
+	 *
+	 * At the end of the loading, the totals and the slowest assets are logged. The report can be written as json
+	 * after the first frame, which includes the setup of the simulation and the compilation of the shaders.
+	 */
+	class LoadProfiler {
+	public:
+
+		//! Measured phases of the start
+		enum Phase {
+			SCENE_FILE = 0,
+			MODEL_FILE,
+			MODEL_CACHE,
+			SIMPLIFIER,
+			OPTIMIZER,
+			TANGENTS,
+			CONVEX_HULL,
+			TEXTURES,
+			OBJECTS,
+			SIMULATION,
+			FIRST_FRAME,
+			CNT_PHASES
+		};
+
+
+		/**
+		 * \brief Measures the time of a phase (and of an asset) from its construction until its destruction.
+		 */
+		class ScopedTimer {
+		public:
+
+			/**
+			 * \brief Start the timer of a phase.
+			 *
+			 * \param phase
+			 *      Measured phase.
+			 * \param asset
+			 *      Complete path of the processed asset ("" => the time is not part of an asset).
+			 */
+			explicit ScopedTimer(Phase phase, const std::string &asset = "");
+
+
+			/**
+			 * \brief Stop the timer and add its own time to its phase and asset.
+			 */
+			~ScopedTimer();
+
+
+		private:
+
+			//! Measured phase
+			Phase _phase;
+
+			//! Processed asset
+			std::string _asset;
+
+			//! Start of the timer
+			osg::Timer_t _start;
+
+			//! Time of the nested timers in seconds
+			double _nested;
+
+			//! Enclosing timer of the same thread (nullptr => outermost)
+			ScopedTimer* _parent;
+
+			ScopedTimer(ScopedTimer const&) = delete;
+			ScopedTimer& operator=(ScopedTimer const&) = delete;
+		};
+
+
+		/**
+		 * \brief Singleton instance of the LoadProfiler-class.
+		 */
+		static LoadProfiler* Instance();
+
+
+		/**
+		 * \brief Restart the time of the loading (at the start of the program).
+		 */
+		void start();
+
+
+		/**
+		 * \brief Add the time of a phase (called concurrently by the threads which prepare the assets).
+		 *
+		 * \param phase
+		 *      Measured phase.
+		 * \param asset
+		 *      Complete path of the processed asset ("" => not part of an asset).
+		 * \param seconds
+		 *      Time of the phase.
+		 */
+		void add(Phase phase, const std::string &asset, double seconds);
+
+
+		/**
+		 * \brief Log the time of the loading, the totals of the phases and the slowest assets (at the end of the
+		 *        loading of the scene).
+		 */
+		void report();
+
+
+		/**
+		 * \brief Write the time of the loading, the phases and all assets (sorted by their time) as json.
+		 *
+		 * \param filePath
+		 *      Complete path of the json-file (overwritten).
+		 *
+		 * \return False if the file can't be written.
+		 */
+		bool writeJson(const std::string &filePath);
+
+
+		/**
+		 * \brief Get the time of a phase.
+		 *
+		 * \param phase
+		 *      Measured phase.
+		 *
+		 * \return Summed time of the phase in seconds.
+		 */
+		double getTime(Phase phase);
+
+
+		/**
+		 * \brief Get the name of a phase.
+		 *
+		 * \param phase
+		 *      Measured phase.
+		 *
+		 * \return Name of the phase (also used as key of the json-report).
+		 */
+		static const char* getPhaseName(Phase phase);
+
+
+		/**
+		 * \brief Enable or disable the measurements.
+		 *
+		 * \param isEnabled
+		 *      True if the phases are measured.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Check if the phases are measured.
+		 *
+		 * \return True if the phases are measured.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+		//! Singleton-instance
+		static LoadProfiler* _pInstance;
+		//! True if the phases are measured
+		static bool IS_ENABLED;
+		//! Number of assets in the logged report
+		static const unsigned int CNT_OFFENDERS;
+
+		//! Start of the loading
+		osg::Timer_t _start;
+		//! Time of the loading until the report (0 => not reported yet)
+		double _loadTime;
+		//! Summed time of each phase
+		double _phases[CNT_PHASES];
+		//! Time of each phase per asset
+		std::map<std::string, std::vector<double> > _assets;
+		//! Protects the times
+		OpenThreads::Mutex _mutex;
+
+
+		/**
+		 * \brief Private constructor of the profiler.
+		 */
+		LoadProfiler();
+		LoadProfiler(const LoadProfiler&) = delete;
+		LoadProfiler& operator=(const LoadProfiler&) = delete;
+
+
+		/**
+		 * \brief Get the assets sorted by their summed time (slowest first). Has to be called with the lock.
+		 *
+		 * \return Assets with their summed time.
+		 */
+		std::vector<std::pair<double, std::string> > getSortedAssets() const;
+	};
+}
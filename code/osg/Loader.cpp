@@ -15,6 +15,10 @@
 
 #include <osgUtil/Simplifier>
 
+#include "ObjReader.h"
+#include "LoadProfiler.h"
+#include "../physics/Logger.h"
+
 using namespace pbs17;
 
 
@@ -33,10 +37,18 @@ using namespace pbs17;
 osg::ref_ptr<osg::Node> Loader::loadModel(std::string filePath, float ratio, float scaling) {
 	//std::cout << "Starting to load the model: \"" << filePath << "\"..." << std::endl;
 	
-	osg::ref_ptr<osg::Node> model = osgDB::readNodeFile(filePath);
+	// the OBJ-models are read by the parallel parser, everything it doesn't handle by osgDB
+	osg::ref_ptr<osg::Node> model;
+	{
+		LoadProfiler::ScopedTimer timer(LoadProfiler::MODEL_FILE, filePath);
+		model = ObjReader::readModel(filePath);
+		if (!model) {
+			model = osgDB::readNodeFile(filePath);
+		}
+	}
 
 	if (!model) {
-		std::cout << "File not found! Aborting..." << std::endl;
+		LOG_WARNING("File not found! Aborting...");
 		exit(0);
 	}
 
@@ -66,6 +78,8 @@ osg::ref_ptr<osg::Node> Loader::loadModel(std::string filePath, float ratio, flo
 osg::ref_ptr<osg::Node> Loader::simplifyNode(osg::ref_ptr<osg::Node> node, float ratio) {
 	//std::cout << "Simplifing node \"" << node->getName() << "\" with the ratio " << ratio << std::endl;
 
+	LoadProfiler::ScopedTimer timer(LoadProfiler::SIMPLIFIER, node->getName());
+
 	osgUtil::Simplifier simplifier;
 	simplifier.setSampleRatio(ratio);
 	node->accept(simplifier);
@@ -104,17 +118,32 @@ osg::ref_ptr<osg::MatrixTransform> Loader::scaleNode(osg::ref_ptr<osg::Node> nod
  * \return Texture object to attach to osg-nodes.
  */
 osg::ref_ptr<osg::Texture2D> Loader::loadTexture(std::string filename) {
-	// Set up the texture for the walls and don't optimise this texture by OSG.
-	osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D;
+	LoadProfiler::ScopedTimer timer(LoadProfiler::TEXTURES, filename);
 
 	// load the image
 	osg::Image* image = osgDB::readImageFile(filename);
 
 	if (!image) {
-		std::cout << "Couldn't find image: \"" << filename << "\" is missing!" << std::endl;
+		LOG_WARNING("Couldn't find image: \"" << filename << "\" is missing!");
 		exit(0);
 	}
 
+	return createTexture(image);
+}
+
+
+/**
+ * \brief Create a Texture2D-object with the settings of the loaded textures.
+ *
+ * \param image
+ *      Image of the texture.
+ *
+ * \return Texture object to attach to osg-nodes.
+ */
+osg::ref_ptr<osg::Texture2D> Loader::createTexture(osg::Image* image) {
+	// Set up the texture for the walls and don't optimise this texture by OSG.
+	osg::ref_ptr<osg::Texture2D> texture = new osg::Texture2D;
+
 	texture->setImage(image);
 	texture->setDataVariance(osg::Object::STATIC);
 	texture->setWrap(osg::Texture2D::WRAP_S, osg::Texture2D::WrapMode::REPEAT);
@@ -133,11 +162,13 @@ osg::ref_ptr<osg::Texture2D> Loader::loadTexture(std::string filename) {
  * \return Image object to attach to osg-nodes.
  */
 osg::ref_ptr<osg::Image> Loader::loadImage(std::string filename) {
+	LoadProfiler::ScopedTimer timer(LoadProfiler::TEXTURES, filename);
+
 	// load the image
 	osg::ref_ptr<osg::Image> image = osgDB::readImageFile(filename);
 
 	if (!image) {
-		std::cout << "Couldn't find image: \"" << filename << "\" is missing! Aborting..." << std::endl;
+		LOG_WARNING("Couldn't find image: \"" << filename << "\" is missing! Aborting...");
 		exit(0);
 	}
 
@@ -72,6 +72,17 @@ namespace pbs17 {
 		static osg::ref_ptr<osg::Texture2D> loadTexture(std::string filename);
 
 
+		/**
+		 * \brief Create a Texture2D-object with the settings of the loaded textures.
+		 *
+		 * \param image
+		 *      Image of the texture.
+		 *
+		 * \return Texture object to attach to osg-nodes.
+		 */
+		static osg::ref_ptr<osg::Texture2D> createTexture(osg::Image* image);
+
+
 		/**
 		 * \brief Load an image.
 		 *
@@ -0,0 +1,272 @@
+﻿/**
+ * \brief Functionality for sharing the state (textures, shader-program and material) of the space-objects.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#include "MaterialCache.h"
+
+#include <osg/Shader>
+#include <osg/Texture2D>
+#include <OpenThreads/ScopedLock>
+
+#include "ImageManager.h"
+#include "MipStreamer.h"
+#include "ProgramBinaryCache.h"
+#include "shaders/BumpmapShader.h"
+#include "shaders/SunShader.h"
+
+using namespace pbs17;
+
+
+//! Pointer to the only instance of this class.
+MaterialCache* MaterialCache::_pInstance = nullptr;
+
+
+/**
+ * \brief Constructor of the cache. The light-uniforms are a white headlight (same as the default light of the
+ *        viewer) until a sun sets them.
+ */
+MaterialCache::MaterialCache()
+	: _lightPosition(new osg::Uniform("lightPosition", osg::Vec4(0.0f, 0.0f, 1.0f, 0.0f))),
+	_lightAmbient(new osg::Uniform("lightAmbient", osg::Vec4(0.0f, 0.0f, 0.0f, 1.0f))),
+	_lightDiffuse(new osg::Uniform("lightDiffuse", osg::Vec4(0.8f, 0.8f, 0.8f, 1.0f))),
+	_lightSpecular(new osg::Uniform("lightSpecular", osg::Vec4(1.0f, 1.0f, 1.0f, 1.0f))),
+	_spinTime(new osg::Uniform("spinTime", 0.0f)) {
+	_lightPosition->setDataVariance(osg::Object::DYNAMIC);
+	_spinTime->setDataVariance(osg::Object::DYNAMIC);
+}
+
+
+/**
+ * \brief Singleton instance of the MaterialCache-class.
+ */
+MaterialCache* MaterialCache::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new MaterialCache();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Get the shared state-set of the textures and the shader. It's implemented in a way that the
+ *        state-set is created only once.
+ *
+ * \param texturePath
+ *      Complete path to the image-file of the texture ("" => no texture).
+ * \param bumpmapPath
+ *      Complete path to the image-file of the bumpmap ("" => no bumpmap).
+ * \param shader
+ *      Shader and material of the state-set.
+ *
+ * \return State-set to set on the osg-nodes (it must not be changed afterwards).
+ */
+osg::ref_ptr<osg::StateSet> MaterialCache::getStateSet(const std::string &texturePath, const std::string &bumpmapPath, ShaderType shader) {
+	StateSetKey key(texturePath, bumpmapPath, shader);
+
+	// try to find the state-set, if it's found => return it and otherwise create it new
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		std::map<StateSetKey, osg::ref_ptr<osg::StateSet> >::iterator found = _stateSets.find(key);
+
+		if (found != _stateSets.end()) {
+			return found->second;
+		}
+	}
+
+	// state-set wasn't found => create it without the lock (the shaders get their programs from the cache)
+	osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet;
+
+	if (texturePath != "") {
+		osg::ref_ptr<osg::Texture2D> colorTex = shader == STREAMED ? MipStreamer::Instance()->push(texturePath, false)
+			: ImageManager::Instance()->loadTexture(texturePath);
+
+		if (bumpmapPath != "") {
+			osg::ref_ptr<osg::Texture2D> normalTex = shader == STREAMED ? MipStreamer::Instance()->push(bumpmapPath, true)
+				: ImageManager::Instance()->loadTexture(bumpmapPath, true);
+
+			if (shader == SUN) {
+				SunShader sunShader(colorTex, normalTex);
+				sunShader.apply(stateset.get());
+			} else {
+				BumpmapShader bumpmapShader(colorTex, normalTex);
+				bumpmapShader.apply(stateset.get());
+			}
+		} else {
+			stateset->setTextureAttributeAndModes(0, colorTex.get(), osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE);
+		}
+	}
+
+	applyMaterial(stateset.get(), shader);
+
+	// the first stored one is shared
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	return _stateSets.insert(std::make_pair(key, stateset)).first->second;
+}
+
+
+/**
+ * \brief Get the shared program of the shader-sources. It's implemented in a way that the program is
+ *        created only once.
+ *
+ * \param vertSource
+ *      Source of the vertex-shader.
+ * \param fragSource
+ *      Source of the fragment-shader.
+ * \param bindings
+ *      Locations of the vertex-attributes.
+ *
+ * \return Program to attach to the state-sets.
+ */
+osg::ref_ptr<osg::Program> MaterialCache::getProgram(const char* vertSource, const char* fragSource,
+	const std::vector<std::pair<std::string, unsigned int> > &bindings) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	osg::ref_ptr<osg::Program> &program = _programs[std::make_pair(std::string(vertSource), std::string(fragSource))];
+
+	if (!program.valid()) {
+		program = new osg::Program;
+		program->addShader(new osg::Shader(osg::Shader::VERTEX, vertSource));
+		program->addShader(new osg::Shader(osg::Shader::FRAGMENT, fragSource));
+
+		for (unsigned int i = 0; i < bindings.size(); ++i) {
+			program->addBindAttribLocation(bindings[i].first, bindings[i].second);
+		}
+
+		// the linked program is stored by the first frame and loaded instead of the sources by the next start
+		if (ProgramBinaryCache::getIsEnabled()) {
+			ProgramBinaryCache::Instance()->add(program.get(), std::string(vertSource) + fragSource);
+		}
+	}
+
+	return program;
+}
+
+
+/**
+ * \brief Get the shared material of a shader.
+ *
+ * \param shader
+ *      Shader of the state-set.
+ *
+ * \return Material to attach to the state-sets.
+ */
+osg::ref_ptr<osg::Material> MaterialCache::getMaterial(ShaderType shader) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	osg::ref_ptr<osg::Material> &material = _materials[shader];
+
+	if (!material.valid()) {
+		// Define material-properties (the sun is lit by itself => less ambient light)
+		float ambient = shader == SUN ? 0.1f : 0.4f;
+
+		material = new osg::Material();
+		material->setDiffuse(osg::Material::FRONT, osg::Vec4(1.0f, 1.0f, 1.0f, 1.0f));
+		material->setSpecular(osg::Material::FRONT, osg::Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		material->setAmbient(osg::Material::FRONT, osg::Vec4(ambient, ambient, ambient, 1.0f));
+		material->setEmission(osg::Material::FRONT, osg::Vec4(0.0f, 0.0f, 0.0f, 1.0f));
+		material->setShininess(osg::Material::FRONT, 100);
+	}
+
+	return material;
+}
+
+
+/**
+ * \brief Apply the shared material of a shader to the given state-set (the material for the fixed pipeline
+ *        and the same values as uniforms for the shaders).
+ *
+ * \param stateset
+ *      The state-set to which the material should be applied.
+ * \param shader
+ *      Shader of the state-set.
+ */
+void MaterialCache::applyMaterial(osg::StateSet* stateset, ShaderType shader) {
+	osg::ref_ptr<osg::Material> material = getMaterial(shader);
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	std::vector<osg::ref_ptr<osg::Uniform> > &uniforms = _materialUniforms[shader];
+
+	if (uniforms.empty()) {
+		uniforms.push_back(new osg::Uniform("materialAmbient", material->getAmbient(osg::Material::FRONT)));
+		uniforms.push_back(new osg::Uniform("materialDiffuse", material->getDiffuse(osg::Material::FRONT)));
+		uniforms.push_back(new osg::Uniform("materialSpecular", material->getSpecular(osg::Material::FRONT)));
+		uniforms.push_back(new osg::Uniform("materialShininess", material->getShininess(osg::Material::FRONT)));
+	}
+
+	stateset->setAttribute(material.get());
+	for (unsigned int i = 0; i < uniforms.size(); ++i) {
+		stateset->addUniform(uniforms[i].get());
+	}
+}
+
+
+/**
+ * \brief Apply the shared light-uniforms and the time of the visual spin to the given state-set (has to be done
+ *        once for the root of the scene).
+ *
+ * \param stateset
+ *      The state-set to which the light-uniforms should be applied.
+ */
+void MaterialCache::applyLight(osg::StateSet* stateset) {
+	stateset->addUniform(_lightPosition.get());
+	stateset->addUniform(_lightAmbient.get());
+	stateset->addUniform(_lightDiffuse.get());
+	stateset->addUniform(_lightSpecular.get());
+	stateset->addUniform(_spinTime.get());
+}
+
+
+/**
+ * \brief Set the colours of the light (until a sun sets them, the scene is lit by a white headlight).
+ *
+ * \param ambient
+ *      Ambient colour of the light.
+ * \param diffuse
+ *      Diffuse colour of the light.
+ * \param specular
+ *      Specular colour of the light.
+ */
+void MaterialCache::setLight(const osg::Vec4 &ambient, const osg::Vec4 &diffuse, const osg::Vec4 &specular) {
+	_lightAmbient->set(ambient);
+	_lightDiffuse->set(diffuse);
+	_lightSpecular->set(specular);
+}
+
+
+/**
+ * \brief Set the position of the light (has to be called from the rendering-thread).
+ *
+ * \param position
+ *      Position of the light in the world.
+ */
+void MaterialCache::setLightPosition(const osg::Vec3 &position) {
+	_lightPosition->set(osg::Vec4(position, 1.0f));
+}
+
+
+/**
+ * \brief Set the simulated time of the rendered state, the bumpmap-shader rotates the objects with a visual spin
+ *        by it (has to be called from the rendering-thread, see SpaceObject::isVisualSpin()).
+ *
+ * \param time
+ *      Simulated time of the frame.
+ */
+void MaterialCache::setSpinTime(double time) {
+	_spinTime->set(static_cast<float>(time));
+}
+
+
+/**
+ * \brief Get the simulated time of the rendered state (see setSpinTime()).
+ *
+ * \return Simulated time of the frame.
+ */
+float MaterialCache::getSpinTime() const {
+	float time = 0.0f;
+	_spinTime->get(time);
+
+	return time;
+}
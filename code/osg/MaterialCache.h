@@ -0,0 +1,205 @@
+﻿/**
+ * \brief Functionality for sharing the state (textures, shader-program and material) of the space-objects.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <osg/Material>
+#include <osg/Program>
+#include <osg/StateSet>
+#include <osg/Uniform>
+#include <OpenThreads/Mutex>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief MaterialCache shares the state-sets of the space-objects with the same textures and shader (e.g. all
+	 * asteroids of a texture), so OSG sorts them into the same state-graph and the textures, the program and the
+	 * material are only bound once for all of them. The shader-programs are shared by their sources, so also the
+	 * state-sets which are not cached use the same program.
+	 * The shaders (GLSL 1.50) don't read the fixed-function state: the material and the light are passed as explicit
+	 * uniforms (materialAmbient, ..., lightPosition, ...), the light-uniforms are shared by the whole scene
+	 * (see applyLight()) and are written by the first sun.
+	 * The cache can be used by several threads (as the ImageManager).
+	 */
+	class MaterialCache {
+	public:
+
+		/**
+		 * \brief Shader and material of the state-set.
+		 */
+		enum ShaderType {
+			//! BumpmapShader if there is a bumpmap, the fixed pipeline otherwise
+			DEFAULT,
+			//! SunShader if there is a bumpmap, the fixed pipeline otherwise (less ambient light)
+			SUN,
+			//! Same as DEFAULT, but the mip-levels of the textures are streamed (see MipStreamer)
+			STREAMED
+		};
+
+
+		/**
+		 * \brief Singleton instance of the MaterialCache-class.
+		 */
+		static MaterialCache* Instance();
+
+
+		/**
+		 * \brief Get the shared state-set of the textures and the shader. It's implemented in a way that the
+		 *        state-set is created only once.
+		 *
+		 * \param texturePath
+		 *      Complete path to the image-file of the texture ("" => no texture).
+		 * \param bumpmapPath
+		 *      Complete path to the image-file of the bumpmap ("" => no bumpmap).
+		 * \param shader
+		 *      Shader and material of the state-set.
+		 *
+		 * \return State-set to set on the osg-nodes (it must not be changed afterwards).
+		 */
+		osg::ref_ptr<osg::StateSet> getStateSet(const std::string &texturePath, const std::string &bumpmapPath, ShaderType shader);
+
+
+		/**
+		 * \brief Get the shared program of the shader-sources. It's implemented in a way that the program is
+		 *        created only once.
+		 *
+		 * \param vertSource
+		 *      Source of the vertex-shader.
+		 * \param fragSource
+		 *      Source of the fragment-shader.
+		 * \param bindings
+		 *      Locations of the vertex-attributes.
+		 *
+		 * \return Program to attach to the state-sets.
+		 */
+		osg::ref_ptr<osg::Program> getProgram(const char* vertSource, const char* fragSource,
+			const std::vector<std::pair<std::string, unsigned int> > &bindings);
+
+
+		/**
+		 * \brief Get the shared material of a shader.
+		 *
+		 * \param shader
+		 *      Shader of the state-set.
+		 *
+		 * \return Material to attach to the state-sets.
+		 */
+		osg::ref_ptr<osg::Material> getMaterial(ShaderType shader);
+
+
+		/**
+		 * \brief Apply the shared material of a shader to the given state-set (the material for the fixed pipeline
+		 *        and the same values as uniforms for the shaders).
+		 *
+		 * \param stateset
+		 *      The state-set to which the material should be applied.
+		 * \param shader
+		 *      Shader of the state-set.
+		 */
+		void applyMaterial(osg::StateSet* stateset, ShaderType shader);
+
+
+		/**
+		 * \brief Apply the shared light-uniforms and the time of the visual spin to the given state-set (has to be done
+		 *        once for the root of the scene).
+		 *
+		 * \param stateset
+		 *      The state-set to which the light-uniforms should be applied.
+		 */
+		void applyLight(osg::StateSet* stateset);
+
+
+		/**
+		 * \brief Set the colours of the light (until a sun sets them, the scene is lit by a white headlight).
+		 *
+		 * \param ambient
+		 *      Ambient colour of the light.
+		 * \param diffuse
+		 *      Diffuse colour of the light.
+		 * \param specular
+		 *      Specular colour of the light.
+		 */
+		void setLight(const osg::Vec4 &ambient, const osg::Vec4 &diffuse, const osg::Vec4 &specular);
+
+
+		/**
+		 * \brief Set the position of the light (has to be called from the rendering-thread).
+		 *
+		 * \param position
+		 *      Position of the light in the world.
+		 */
+		void setLightPosition(const osg::Vec3 &position);
+
+
+		/**
+		 * \brief Set the simulated time of the rendered state, the bumpmap-shader rotates the objects with a visual spin
+		 *        by it (has to be called from the rendering-thread, see SpaceObject::isVisualSpin()).
+		 *
+		 * \param time
+		 *      Simulated time of the frame.
+		 */
+		void setSpinTime(double time);
+
+
+		/**
+		 * \brief Get the simulated time of the rendered state (see setSpinTime()).
+		 *
+		 * \return Simulated time of the frame.
+		 */
+		float getSpinTime() const;
+
+
+	private:
+
+		//! Key of a state-set: texture, bumpmap and shader
+		typedef std::tuple<std::string, std::string, int> StateSetKey;
+
+		//! All state-sets which have been created already.
+		std::map<StateSetKey, osg::ref_ptr<osg::StateSet> > _stateSets;
+
+		//! All programs which have been created already (by the sources).
+		std::map<std::pair<std::string, std::string>, osg::ref_ptr<osg::Program> > _programs;
+
+		//! Materials of the shaders.
+		std::map<int, osg::ref_ptr<osg::Material> > _materials;
+
+		//! Uniforms of the materials (ambient, diffuse, specular and shininess).
+		std::map<int, std::vector<osg::ref_ptr<osg::Uniform> > > _materialUniforms;
+
+		//! Shared uniforms of the light (w of the position = 1: point in the world, 0: direction in the eye-space).
+		osg::ref_ptr<osg::Uniform> _lightPosition;
+		osg::ref_ptr<osg::Uniform> _lightAmbient;
+		osg::ref_ptr<osg::Uniform> _lightDiffuse;
+		osg::ref_ptr<osg::Uniform> _lightSpecular;
+
+		//! Shared uniform of the simulated time (rotation of the objects with a visual spin)
+		osg::ref_ptr<osg::Uniform> _spinTime;
+
+		//! Protects the maps (the state-sets are created without holding it).
+		OpenThreads::Mutex _mutex;
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		MaterialCache();
+
+		//! Private copy-constructor to prevent copying the class.
+		MaterialCache(MaterialCache const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		MaterialCache& operator=(MaterialCache const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static MaterialCache* _pInstance;
+	};
+}
@@ -0,0 +1,571 @@
+﻿/**
+ * \brief Functionality for streaming the mip-levels of the planet-textures by their size on the screen.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "MipStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <osg/NodeCallback>
+#include <osgDB/FileUtils>
+#include <osgDB/ReadFile>
+#include <osgUtil/CullVisitor>
+#include <OpenThreads/ScopedLock>
+
+#include "../config.h"
+#include "AssetCache.h"
+#include "ImageManager.h"
+#include "Loader.h"
+#include "LoadProfiler.h"
+#include "TextureStreamer.h"
+#include "../physics/Logger.h"
+#include "../physics/MemoryTracker.h"
+#include "../physics/ThreadBudget.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Streams the levels once per frame.
+	 */
+	class MipUpdateCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			MipStreamer::Instance()->update();
+			traverse(node, nv);
+		}
+	};
+
+
+	/**
+	 * \brief Measures the diameter of a planet on the screen for the levels of its textures.
+	 */
+	class MipCullCallback : public osg::NodeCallback {
+	public:
+		MipCullCallback(const std::vector<std::string> &filePaths) : _filePaths(filePaths) {}
+
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+
+			if (cv) {
+				MipStreamer::Instance()->measure(_filePaths, cv->pixelSize(node->getBound()));
+			}
+
+			traverse(node, nv);
+		}
+
+	private:
+		std::vector<std::string> _filePaths;
+	};
+}
+
+
+//! Pointer to the only instance of this class.
+MipStreamer* MipStreamer::_pInstance = nullptr;
+
+//! The planet-textures are loaded as the other textures by default.
+bool MipStreamer::IS_ENABLED = false;
+//! 64 MB of resident levels by default.
+long long MipStreamer::BUDGET = 64ll << 20;
+//! Identifier at the beginning of the index-files ("MIPS").
+const unsigned int MipStreamer::INDEX_MAGIC = 0x5350494d;
+//! Version of the index- and level-files.
+const unsigned int MipStreamer::INDEX_VERSION = 1;
+
+
+/**
+ * \brief Singleton instance of the MipStreamer-class.
+ */
+MipStreamer* MipStreamer::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new MipStreamer();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Private constructor: Prepare the placeholders and the root with the update-callback.
+ */
+MipStreamer::MipStreamer() : _colorPlaceholder(TextureStreamer::createPlaceholder(osg::Vec3ub(128, 128, 128))),
+	_normalPlaceholder(TextureStreamer::createPlaceholder(osg::Vec3ub(128, 128, 255))), _root(new osg::Node) {
+	_root->setUpdateCallback(new MipUpdateCallback);
+}
+
+
+/**
+ * \brief Get the streamed texture of an image-file (shared by all users). The texture has a placeholder
+ *        until the mip-chain is prepared, then its coarsest level.
+ *
+ * \param filePath
+ *      Complete path to the image-file.
+ * \param isNormalMap
+ *      True if the placeholder is a flat normal (instead of grey).
+ *
+ * \return Texture object to attach to osg-nodes (the image is replaced by each streamed level).
+ */
+osg::ref_ptr<osg::Texture2D> MipStreamer::push(const std::string &filePath, bool isNormalMap) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	Entry &entry = _entries[filePath];
+
+	if (!entry.texture.valid()) {
+		entry.texture = Loader::createTexture(isNormalMap ? _normalPlaceholder : _colorPlaceholder);
+		// the image is replaced between the frames
+		entry.texture->setDataVariance(osg::Object::DYNAMIC);
+		entry.filePath = filePath;
+
+		Entry* pEntry = &entry;
+		ThreadBudget::Instance()->submit(ThreadBudget::BACKGROUND, [this, pEntry]() {
+			prepare(pEntry);
+		});
+	}
+
+	return entry.texture;
+}
+
+
+/**
+ * \brief Measure the size of a node on the screen for the levels of its streamed textures (adds a cull-callback).
+ *
+ * \param node
+ *      Node which is drawn with the textures (its bounding-sphere is measured).
+ * \param filePaths
+ *      Image-files of the textures (see push()).
+ */
+void MipStreamer::addUser(osg::Node* node, const std::vector<std::string> &filePaths) {
+	node->addCullCallback(new MipCullCallback(filePaths));
+}
+
+
+/**
+ * \brief Report the diameter of a user on the screen (called by its cull-callback, see addUser()).
+ *
+ * \param filePaths
+ *      Image-files of the textures of the user.
+ * \param pixelSize
+ *      Diameter of the user in pixels.
+ */
+void MipStreamer::measure(const std::vector<std::string> &filePaths, float pixelSize) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	for (unsigned int i = 0; i < filePaths.size(); ++i) {
+		std::map<std::string, Entry>::iterator found = _entries.find(filePaths[i]);
+
+		if (found != _entries.end()) {
+			found->second.pixelSize = std::max(found->second.pixelSize, pixelSize);
+		}
+	}
+}
+
+
+/**
+ * \brief Choose the levels within the budget, queue the changed ones and swap the loaded chains into their
+ *        textures (called once per frame by the update-callback of the root).
+ */
+void MipStreamer::update() {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	for (unsigned int i = 0; i < _loaded.size(); ++i) {
+		Entry* entry = _loaded[i].entry;
+		long long oldSize = entry->residentLevel >= 0 ? entry->chainSizes[entry->residentLevel] : 0;
+
+		entry->texture->setImage(_loaded[i].image);
+		// the texture-object has the size of the previous level => it's created again with the new chain
+		entry->texture->dirtyTextureObject();
+		ImageManager::Instance()->updateTwoChannelUniform(entry->texture);
+		MemoryTracker::add(MemoryTracker::TEXTURES, entry->chainSizes[_loaded[i].level] - oldSize);
+
+		entry->residentLevel = _loaded[i].level;
+		entry->loadingLevel = -1;
+	}
+	_loaded.clear();
+
+	// the levels of the last frame's sizes, the largest chains are coarsened until they fit into the budget
+	std::vector<Entry*> entries;
+	std::vector<int> levels;
+	long long total = 0;
+
+	for (std::map<std::string, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+		Entry &entry = it->second;
+		if (entry.cntLevels == 0) continue;
+
+		// a new texture shows its coarsest level first (small and read at once)
+		entries.push_back(&entry);
+		levels.push_back(entry.residentLevel < 0 ? entry.cntLevels - 1 : getRequestedLevel(entry, entry.pixelSize));
+		total += entry.chainSizes[levels.back()];
+		entry.pixelSize = 0.0f;
+	}
+
+	while (total > BUDGET) {
+		int largest = -1;
+
+		for (unsigned int i = 0; i < entries.size(); ++i) {
+			if (levels[i] + 1 < entries[i]->cntLevels
+				&& (largest < 0 || entries[i]->chainSizes[levels[i]] > entries[largest]->chainSizes[levels[largest]])) {
+				largest = i;
+			}
+		}
+
+		if (largest < 0) break;
+
+		total -= entries[largest]->chainSizes[levels[largest]] - entries[largest]->chainSizes[levels[largest] + 1];
+		++levels[largest];
+	}
+
+	for (unsigned int i = 0; i < entries.size(); ++i) {
+		Entry* entry = entries[i];
+		int level = levels[i];
+
+		if (level != entry->residentLevel && entry->loadingLevel == -1) {
+			entry->loadingLevel = level;
+			ThreadBudget::Instance()->submit(ThreadBudget::BACKGROUND, [this, entry, level]() {
+				load(entry, level);
+			});
+		}
+	}
+}
+
+
+/**
+ * \brief Check if loaded levels wait for the swap.
+ *
+ * \return True if the next frame swaps a level.
+ */
+bool MipStreamer::hasLoaded() {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	return !_loaded.empty();
+}
+
+
+/**
+ * \brief Read the index of the cached levels, or decode the image-file and write its levels (runs on a
+ *        background-worker). The coarsest level is requested by the next update.
+ *
+ * \param entry
+ *      Streamed texture.
+ */
+void MipStreamer::prepare(Entry* entry) {
+	// the fields are only read by the workers and the update once cntLevels is set
+	Entry prepared;
+	prepared.key = AssetCache::getKey(entry->filePath);
+	unsigned int cntLevels = 0;
+
+	if (prepared.key != "") {
+		std::ifstream stream(getCachePath(prepared.key, -1), std::ios::binary);
+		unsigned int index[9] = { 0 };
+
+		if (stream.read(reinterpret_cast<char*>(index), sizeof(index)) && index[0] == INDEX_MAGIC && index[1] == INDEX_VERSION) {
+			prepared.width = index[2];
+			prepared.height = index[3];
+			prepared.internalFormat = index[4];
+			prepared.pixelFormat = index[5];
+			prepared.dataType = index[6];
+			prepared.packing = index[7];
+			cntLevels = index[8];
+		}
+	}
+
+	// not cached yet (or the index is broken) => the levels are calculated from the decoded image-file
+	if (cntLevels == 0) {
+		osg::ref_ptr<osg::Image> image;
+		{
+			LoadProfiler::ScopedTimer timer(LoadProfiler::TEXTURES, entry->filePath);
+			image = osgDB::readImageFile(entry->filePath);
+		}
+		if (!image) {
+			LOG_WARNING("Couldn't find image: \"" << entry->filePath << "\" is missing!");
+			return;
+		}
+
+		buildLevels(image.get(), prepared.levels);
+		cntLevels = prepared.levels.size();
+		prepared.width = image->s();
+		prepared.height = image->t();
+		prepared.internalFormat = image->getInternalTextureFormat();
+		prepared.pixelFormat = image->getPixelFormat();
+		prepared.dataType = image->getDataType();
+		prepared.packing = prepared.levels[0]->getPacking();
+
+		if (cntLevels == 1) {
+			LOG_WARNING("The image \"" << entry->filePath << "\" has no mipmaps and can't be filtered, it's streamed as a whole.");
+		}
+
+		if (prepared.key != "") {
+			bool isWritten = true;
+			osgDB::makeDirectory(CACHE_PATH + "/mips");
+
+			for (unsigned int l = 0; l < cntLevels && isWritten; ++l) {
+				std::ofstream stream(getCachePath(prepared.key, l), std::ios::binary | std::ios::trunc);
+				isWritten = static_cast<bool>(stream.write(reinterpret_cast<const char*>(prepared.levels[l]->data()), getLevelSize(prepared, l)));
+			}
+
+			// the index is written last, so a partial cache is prepared again
+			if (isWritten) {
+				std::ofstream stream(getCachePath(prepared.key, -1), std::ios::binary | std::ios::trunc);
+				unsigned int index[9] = { INDEX_MAGIC, INDEX_VERSION, static_cast<unsigned int>(prepared.width),
+					static_cast<unsigned int>(prepared.height), static_cast<unsigned int>(prepared.internalFormat), prepared.pixelFormat,
+					prepared.dataType, prepared.packing, cntLevels };
+				stream.write(reinterpret_cast<const char*>(index), sizeof(index));
+
+				// the levels are read from the cache, only the resident chain stays in memory
+				prepared.levels.clear();
+			} else {
+				prepared.key = "";
+			}
+		}
+	}
+
+	prepared.chainSizes.resize(cntLevels + 1, 0);
+	for (int l = cntLevels - 1; l >= 0; --l) {
+		prepared.chainSizes[l] = prepared.chainSizes[l + 1] + getLevelSize(prepared, l);
+	}
+	prepared.chainSizes.pop_back();
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	entry->key = prepared.key;
+	entry->width = prepared.width;
+	entry->height = prepared.height;
+	entry->internalFormat = prepared.internalFormat;
+	entry->pixelFormat = prepared.pixelFormat;
+	entry->dataType = prepared.dataType;
+	entry->packing = prepared.packing;
+	entry->levels.swap(prepared.levels);
+	entry->chainSizes.swap(prepared.chainSizes);
+	entry->cntLevels = cntLevels;
+}
+
+
+/**
+ * \brief Read the chain of a level (the level and all coarser ones) and queue it for the swap (runs on a
+ *        background-worker).
+ *
+ * \param entry
+ *      Streamed texture (its levels are prepared).
+ * \param level
+ *      First level of the chain.
+ */
+void MipStreamer::load(Entry* entry, int level) {
+	std::vector<osg::ref_ptr<osg::Image> > levels = entry->levels;
+
+	if (entry->key != "") {
+		LoadProfiler::ScopedTimer timer(LoadProfiler::TEXTURES, entry->filePath);
+		levels.resize(entry->cntLevels);
+
+		for (int l = level; l < entry->cntLevels; ++l) {
+			long long size = getLevelSize(*entry, l);
+			unsigned char* data = new unsigned char[size];
+			std::ifstream stream(getCachePath(entry->key, l), std::ios::binary);
+
+			if (!stream.read(reinterpret_cast<char*>(data), size)) {
+				// the texture keeps its current level, the cache is prepared again by the next start
+				delete[] data;
+				std::remove(getCachePath(entry->key, -1).c_str());
+				LOG_WARNING("The cached level " << l << " of \"" << entry->filePath << "\" is broken.");
+				return;
+			}
+
+			levels[l] = new osg::Image;
+			levels[l]->setImage(std::max(1, entry->width >> l), std::max(1, entry->height >> l), 1, entry->internalFormat,
+				entry->pixelFormat, entry->dataType, data, osg::Image::USE_NEW_DELETE, entry->packing);
+		}
+	}
+
+	Loaded loaded;
+	loaded.entry = entry;
+	loaded.level = level;
+	loaded.image = createChain(*entry, levels, level);
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_loaded.push_back(loaded);
+}
+
+
+/**
+ * \brief Get the finest level which is sampled at a diameter on the screen.
+ *
+ * \param entry
+ *      Streamed texture (its levels are prepared).
+ * \param pixelSize
+ *      Largest diameter in pixels of the users (0 => not drawn, the coarsest level).
+ *
+ * \return Requested level.
+ */
+int MipStreamer::getRequestedLevel(const Entry &entry, float pixelSize) {
+	if (pixelSize <= 0.0f) {
+		return entry.cntLevels - 1;
+	}
+
+	// the equator wraps the sphere: w / (pi * d) texels per pixel at the center of the planet
+	double texelsPerPixel = entry.width / (osg::PI * pixelSize);
+	int level = texelsPerPixel > 1.0 ? static_cast<int>(std::floor(std::log2(texelsPerPixel))) : 0;
+
+	return std::min(level, entry.cntLevels - 1);
+}
+
+
+/**
+ * \brief Get the memory of a level.
+ *
+ * \param entry
+ *      Streamed texture (its levels are prepared).
+ * \param level
+ *      Level of the texture.
+ *
+ * \return Size of the data of the level in bytes.
+ */
+long long MipStreamer::getLevelSize(const Entry &entry, int level) {
+	return osg::Image::computeImageSizeInBytes(std::max(1, entry.width >> level), std::max(1, entry.height >> level), 1,
+		entry.pixelFormat, entry.dataType, entry.packing);
+}
+
+
+/**
+ * \brief Calculate the mip-chain of an image (box-filtered down to 1x1 if it's uncompressed, otherwise
+ *        the mipmaps of the image).
+ *
+ * \param image
+ *      Decoded image-file.
+ * \param levels
+ *      Output-parameter: One image per level (without mipmaps).
+ */
+void MipStreamer::buildLevels(const osg::Image* image, std::vector<osg::ref_ptr<osg::Image> > &levels) {
+	levels.clear();
+
+	// the pre-baked chains are block-compressed and are split into their levels
+	if (image->isCompressed() || image->getDataType() != GL_UNSIGNED_BYTE) {
+		int cntLevels = std::max(1u, image->getNumMipmapLevels());
+
+		for (int l = 0; l < cntLevels; ++l) {
+			int s = std::max(1, image->s() >> l);
+			int t = std::max(1, image->t() >> l);
+			unsigned int size = osg::Image::computeImageSizeInBytes(s, t, 1, image->getPixelFormat(), image->getDataType(), image->getPacking());
+			unsigned char* data = new unsigned char[size];
+			std::memcpy(data, l == 0 ? image->data() : image->getMipmapData(l), size);
+
+			osg::ref_ptr<osg::Image> level = new osg::Image;
+			level->setImage(s, t, 1, image->getInternalTextureFormat(), image->getPixelFormat(), image->getDataType(), data,
+				osg::Image::USE_NEW_DELETE, image->getPacking());
+			levels.push_back(level);
+		}
+
+		return;
+	}
+
+	// the uncompressed levels are tightly packed, the rows of the decoded image may be aligned
+	int cntChannels = osg::Image::computeNumComponents(image->getPixelFormat());
+	int s = image->s();
+	int t = image->t();
+	unsigned char* data = new unsigned char[s * t * cntChannels];
+
+	for (int y = 0; y < t; ++y) {
+		std::memcpy(data + y * s * cntChannels, image->data(0, y), s * cntChannels);
+	}
+
+	osg::ref_ptr<osg::Image> level = new osg::Image;
+	level->setImage(s, t, 1, image->getInternalTextureFormat(), image->getPixelFormat(), GL_UNSIGNED_BYTE, data,
+		osg::Image::USE_NEW_DELETE, 1);
+	levels.push_back(level);
+
+	// 2x2 box-filter (the odd last row or column is repeated), the normals are normalized by the shader
+	while (s > 1 || t > 1) {
+		const unsigned char* src = levels.back()->data();
+		int srcS = s;
+		int srcT = t;
+		s = std::max(1, s >> 1);
+		t = std::max(1, t >> 1);
+		data = new unsigned char[s * t * cntChannels];
+
+		for (int y = 0; y < t; ++y) {
+			int y0 = std::min(2 * y, srcT - 1);
+			int y1 = std::min(2 * y + 1, srcT - 1);
+
+			for (int x = 0; x < s; ++x) {
+				int x0 = std::min(2 * x, srcS - 1);
+				int x1 = std::min(2 * x + 1, srcS - 1);
+
+				for (int c = 0; c < cntChannels; ++c) {
+					int sum = src[(y0 * srcS + x0) * cntChannels + c] + src[(y0 * srcS + x1) * cntChannels + c]
+						+ src[(y1 * srcS + x0) * cntChannels + c] + src[(y1 * srcS + x1) * cntChannels + c];
+					data[(y * s + x) * cntChannels + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+
+		level = new osg::Image;
+		level->setImage(s, t, 1, image->getInternalTextureFormat(), image->getPixelFormat(), GL_UNSIGNED_BYTE, data,
+			osg::Image::USE_NEW_DELETE, 1);
+		levels.push_back(level);
+	}
+}
+
+
+/**
+ * \brief Combine the levels into one image with mipmaps.
+ *
+ * \param entry
+ *      Streamed texture (its levels are prepared).
+ * \param levels
+ *      One image per level (the ones from the first level with data).
+ * \param first
+ *      First level of the chain.
+ *
+ * \return Image of the first level with the coarser levels as its mipmaps.
+ */
+osg::ref_ptr<osg::Image> MipStreamer::createChain(const Entry &entry, const std::vector<osg::ref_ptr<osg::Image> > &levels, int first) {
+	unsigned char* data = new unsigned char[entry.chainSizes[first]];
+	osg::Image::MipmapDataType offsets;
+	unsigned int offset = 0;
+
+	for (int l = first; l < entry.cntLevels; ++l) {
+		if (l > first) {
+			offsets.push_back(offset);
+		}
+
+		long long size = getLevelSize(entry, l);
+		std::memcpy(data + offset, levels[l]->data(), size);
+		offset += size;
+	}
+
+	osg::ref_ptr<osg::Image> chain = new osg::Image;
+	chain->setImage(std::max(1, entry.width >> first), std::max(1, entry.height >> first), 1, entry.internalFormat,
+		entry.pixelFormat, entry.dataType, data, osg::Image::USE_NEW_DELETE, entry.packing);
+	chain->setMipmapLevels(offsets);
+
+	return chain;
+}
+
+
+/**
+ * \brief Get the path of a file of the cached levels.
+ *
+ * \param key
+ *      Key of the image-file.
+ * \param level
+ *      Level of the file (-1 => index).
+ *
+ * \return Complete path to the cached file.
+ */
+std::string MipStreamer::getCachePath(const std::string &key, int level) {
+	std::ostringstream path;
+	path << CACHE_PATH << "/mips/" << key;
+
+	if (level < 0) {
+		path << ".index";
+	} else {
+		path << "_" << level << ".mip";
+	}
+
+	return path.str();
+}
@@ -0,0 +1,305 @@
+﻿/**
+ * \brief Functionality for streaming the mip-levels of the planet-textures by their size on the screen.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <osg/Image>
+#include <osg/Node>
+#include <osg/Texture2D>
+#include <OpenThreads/Mutex>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief MipStreamer keeps only the mip-levels of the planet-textures resident which are sampled on the screen,
+	 * so the source images can have any resolution. On the first use, the image is decoded and its mip-chain is
+	 * written to the cache-directory, one file per level (<key>_<level>.mip, the uncompressed levels are box-filtered,
+	 * the pre-baked .ktx/.dds keep their own chain). The textures start with the coarsest level.
+	 *
+	 * The cull-callback of each planet measures its diameter on the screen (see osg::CullStack::pixelSize()), which
+	 * gives the finest useful level: the equator of a texture of width w wraps the sphere, so about w / (pi * d)
+	 * texels fall onto a pixel at the center of a planet with a diameter of d pixels. Once per frame the levels of
+	 * all textures are chosen within the budget (the largest textures are coarsened first) and the changed levels
+	 * are read by the background-workers of the ThreadBudget. The loaded chains are swapped into their textures by
+	 * the update-callback of the root (as the TextureStreamer). Without the asset-cache, the chain is kept in memory.
+	 */
+	class MipStreamer {
+	public:
+
+		/**
+		 * \brief Singleton instance of the MipStreamer-class.
+		 */
+		static MipStreamer* Instance();
+
+
+		/**
+		 * \brief Get the streamed texture of an image-file (shared by all users). The texture has a placeholder
+		 *        until the mip-chain is prepared, then its coarsest level.
+		 *
+		 * \param filePath
+		 *      Complete path to the image-file.
+		 * \param isNormalMap
+		 *      True if the placeholder is a flat normal (instead of grey).
+		 *
+		 * \return Texture object to attach to osg-nodes (the image is replaced by each streamed level).
+		 */
+		osg::ref_ptr<osg::Texture2D> push(const std::string &filePath, bool isNormalMap);
+
+
+		/**
+		 * \brief Measure the size of a node on the screen for the levels of its streamed textures (adds a cull-callback).
+		 *
+		 * \param node
+		 *      Node which is drawn with the textures (its bounding-sphere is measured).
+		 * \param filePaths
+		 *      Image-files of the textures (see push()).
+		 */
+		void addUser(osg::Node* node, const std::vector<std::string> &filePaths);
+
+
+		/**
+		 * \brief Choose the levels within the budget, queue the changed ones and swap the loaded chains into their
+		 *        textures (called once per frame by the update-callback of the root).
+		 */
+		void update();
+
+
+		/**
+		 * \brief Check if loaded levels wait for the swap.
+		 *
+		 * \return True if the next frame swaps a level.
+		 */
+		bool hasLoaded();
+
+
+		/**
+		 * \brief Report the diameter of a user on the screen (called by its cull-callback, see addUser()).
+		 *
+		 * \param filePaths
+		 *      Image-files of the textures of the user.
+		 * \param pixelSize
+		 *      Diameter of the user in pixels.
+		 */
+		void measure(const std::vector<std::string> &filePaths, float pixelSize);
+
+
+		/**
+		 * \brief Get the node which streams the levels (has to be added once to the scene).
+		 *
+		 * \return Root of the streamer (nothing is drawn).
+		 */
+		osg::ref_ptr<osg::Node> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Enable or disable the streaming of the planet-textures (if disabled, they are loaded as the other
+		 *        textures). Has to be set before loading the scene.
+		 *
+		 * \param isEnabled
+		 *      True if the mip-levels are streamed.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the streaming of the planet-textures is enabled.
+		 *
+		 * \return True if the mip-levels are streamed.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+		/**
+		 * \brief Set the memory of all resident levels (including their coarser levels).
+		 *
+		 * \param budget
+		 *      Budget in MB (0 => only the coarsest levels).
+		 */
+		static void setBudget(unsigned int budget) {
+			BUDGET = static_cast<long long>(budget) << 20;
+		}
+
+
+	private:
+		/**
+		 * \brief Streamed texture with the levels of its image-file.
+		 */
+		struct Entry {
+			osg::ref_ptr<osg::Texture2D> texture;
+			std::string filePath;
+			//! Key of the image-file in the cache ("" => the levels are kept in memory)
+			std::string key;
+			//! Size of the finest level
+			int width = 0;
+			int height = 0;
+			//! Formats of all levels
+			GLint internalFormat = 0;
+			GLenum pixelFormat = 0;
+			GLenum dataType = 0;
+			unsigned int packing = 1;
+			//! Levels with their data if they are kept in memory (empty with the cache)
+			std::vector<osg::ref_ptr<osg::Image> > levels;
+			//! Memory of the chain starting at each level
+			std::vector<long long> chainSizes;
+			//! Number of levels (0 => the chain is not prepared yet)
+			int cntLevels = 0;
+			//! Level of the current image (-1 => placeholder)
+			int residentLevel = -1;
+			//! Level which is read by a worker (-1 => none)
+			int loadingLevel = -1;
+			//! Largest diameter in pixels of the users since the last update
+			float pixelSize = 0.0f;
+		};
+
+
+		/**
+		 * \brief Chain of levels which waits for the swap.
+		 */
+		struct Loaded {
+			Entry* entry;
+			int level;
+			osg::ref_ptr<osg::Image> image;
+		};
+
+
+		//! True if the mip-levels of the planet-textures are streamed
+		static bool IS_ENABLED;
+		//! Memory of all resident levels in bytes
+		static long long BUDGET;
+		//! Identifier at the beginning of the index-files
+		static const unsigned int INDEX_MAGIC;
+		//! Version of the index- and level-files (increase if the format or the filter changes)
+		static const unsigned int INDEX_VERSION;
+
+		//! Streamed textures by their image-file
+		std::map<std::string, Entry> _entries;
+		//! Loaded chains which wait for the swap
+		std::deque<Loaded> _loaded;
+		//! Protects the entries and _loaded
+		OpenThreads::Mutex _mutex;
+
+		//! Placeholders for the colour and the normals (shared by all textures until their chain is prepared)
+		osg::ref_ptr<osg::Image> _colorPlaceholder;
+		osg::ref_ptr<osg::Image> _normalPlaceholder;
+
+		//! Root with the update-callback which streams the levels
+		osg::ref_ptr<osg::Node> _root;
+
+
+		/**
+		 * \brief Read the index of the cached levels, or decode the image-file and write its levels (runs on a
+		 *        background-worker). The coarsest level is requested by the next update.
+		 *
+		 * \param entry
+		 *      Streamed texture.
+		 */
+		void prepare(Entry* entry);
+
+
+		/**
+		 * \brief Read the chain of a level (the level and all coarser ones) and queue it for the swap (runs on a
+		 *        background-worker).
+		 *
+		 * \param entry
+		 *      Streamed texture (its levels are prepared).
+		 * \param level
+		 *      First level of the chain.
+		 */
+		void load(Entry* entry, int level);
+
+
+		/**
+		 * \brief Get the finest level which is sampled at a diameter on the screen.
+		 *
+		 * \param entry
+		 *      Streamed texture (its levels are prepared).
+		 * \param pixelSize
+		 *      Largest diameter in pixels of the users (0 => not drawn, the coarsest level).
+		 *
+		 * \return Requested level.
+		 */
+		static int getRequestedLevel(const Entry &entry, float pixelSize);
+
+
+		/**
+		 * \brief Get the memory of a level.
+		 *
+		 * \param entry
+		 *      Streamed texture (its levels are prepared).
+		 * \param level
+		 *      Level of the texture.
+		 *
+		 * \return Size of the data of the level in bytes.
+		 */
+		static long long getLevelSize(const Entry &entry, int level);
+
+
+		/**
+		 * \brief Calculate the mip-chain of an image (box-filtered down to 1x1 if it's uncompressed, otherwise
+		 *        the mipmaps of the image).
+		 *
+		 * \param image
+		 *      Decoded image-file.
+		 * \param levels
+		 *      Output-parameter: One image per level (without mipmaps).
+		 */
+		static void buildLevels(const osg::Image* image, std::vector<osg::ref_ptr<osg::Image> > &levels);
+
+
+		/**
+		 * \brief Combine the levels into one image with mipmaps.
+		 *
+		 * \param entry
+		 *      Streamed texture (its levels are prepared).
+		 * \param levels
+		 *      One image per level (the ones from the first level with data).
+		 * \param first
+		 *      First level of the chain.
+		 *
+		 * \return Image of the first level with the coarser levels as its mipmaps.
+		 */
+		static osg::ref_ptr<osg::Image> createChain(const Entry &entry, const std::vector<osg::ref_ptr<osg::Image> > &levels, int first);
+
+
+		/**
+		 * \brief Get the path of a file of the cached levels.
+		 *
+		 * \param key
+		 *      Key of the image-file.
+		 * \param level
+		 *      Level of the file (-1 => index).
+		 *
+		 * \return Complete path to the cached file.
+		 */
+		static std::string getCachePath(const std::string &key, int level);
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		MipStreamer();
+
+		//! Private copy-constructor to prevent copying the class.
+		MipStreamer(MipStreamer const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		MipStreamer& operator=(MipStreamer const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static MipStreamer* _pInstance;
+	};
+}
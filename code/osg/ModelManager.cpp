@@ -7,7 +7,26 @@
 
 #include "ModelManager.h"
 
-#include "Loader.h"
+#include <algorithm>
+#include <vector>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Math>
+#include <OpenThreads/ScopedLock>
+#include <osgUtil/Optimizer>
+
+#include "AssetCache.h"
+#include "ProceduralAsteroid.h"
+#include "LoadProfiler.h"
+#include "../graphics/ConvexDecomposition.h"
+#include "../graphics/ConvexHull3D.h"
+#include "../graphics/DistanceField.h"
+#include "../physics/Tracer.h"
+#include "../scene/SpaceObject.h"
+#include "visitors/ComputeTangentVisitor.h"
+#include "visitors/ConvexHullVisitor.h"
+#include "visitors/QuantizeVisitor.h"
+#include "visitors/VertexListVisitor.h"
 
 using namespace pbs17;
 
@@ -15,6 +34,70 @@ using namespace pbs17;
 //! Pointer to the only instance of this class.
 ModelManager* ModelManager::_pInstance = nullptr;
 
+//! Allowed geometric error of a simplified level in pixels
+const float ModelManager::SCREEN_SPACE_ERROR = 1.0f;
+
+//! True if the vertex-arrays of the models are quantized
+bool ModelManager::IS_QUANTIZED = false;
+
+
+namespace {
+
+	/**
+	 * \brief Counts the vertices of all geometries of a model.
+	 */
+	class VertexCounter : public osg::NodeVisitor {
+	public:
+		unsigned int cntVertices = 0;
+
+		VertexCounter() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+		void apply(osg::Geode &geode) override {
+			for (unsigned int i = 0; i < geode.getNumDrawables(); ++i) {
+				osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
+
+				if (geometry && geometry->getVertexArray()) {
+					cntVertices += geometry->getVertexArray()->getNumElements();
+				}
+			}
+		}
+	};
+
+
+	/**
+	 * \brief Estimates the memory of the vertex-arrays and the indices of all geometries of a model.
+	 */
+	class MemoryCounter : public osg::NodeVisitor {
+	public:
+		size_t cntBytes = 0;
+
+		MemoryCounter() : osg::NodeVisitor(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN) {}
+
+		void apply(osg::Geode &geode) override {
+			for (unsigned int i = 0; i < geode.getNumDrawables(); ++i) {
+				osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
+
+				if (!geometry) {
+					continue;
+				}
+
+				osg::Geometry::ArrayList arrays;
+				geometry->getArrayList(arrays);
+				for (unsigned int a = 0; a < arrays.size(); ++a) {
+					cntBytes += arrays[a]->getTotalDataSize();
+				}
+
+				for (unsigned int p = 0; p < geometry->getNumPrimitiveSets(); ++p) {
+					const osg::DrawElements* elements = geometry->getPrimitiveSet(p)->getDrawElements();
+					if (elements) {
+						cntBytes += elements->getTotalDataSize();
+					}
+				}
+			}
+		}
+	};
+}
+
 
 /**
  * \brief Singleton instance of the ModelManager-class.
@@ -31,40 +114,393 @@ ModelManager* ModelManager::Instance() {
 
 /**
  * \brief Load a Node-object from a model-file. It's implemented in a way that the model is loaded only once.
+ * The tangents of the bumpmaps are computed once with the model (shared by all objects of the model).
+ * The simplified levels are selected by the pixel-size of the model on the screen (see getMaxPixelSize()),
+ * the global quality is set by the LOD-scale of the camera.
  * 
  * \param filePath
  *	    Complete path to the model to load.
  * \param useLod
- *      True if simplified models should be used if the camera is far away.
+ *      True if simplified models should be used if the model is small on the screen.
  *
  *  \return Model-node to attach to osg-nodes.
  */
 osg::ref_ptr<osg::LOD> ModelManager::loadModel(std::string filePath, bool useLod) {
 	// try to find the model, if it's found => return it and otherwise load it new
-	osg::ref_ptr<osg::LOD> retModel;
-	std::map<std::string, osg::ref_ptr<osg::LOD> >::iterator found = _loaded.find(filePath);
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		osg::Referenced* found = _loaded.find(filePath);
 
-	if (found == _loaded.end()) {
-		// model wasn't found => load and store it in the manager and return it
-		osg::ref_ptr<osg::Node> modelL3 = Loader::loadModel(filePath, 1.0);
-		osg::ref_ptr<osg::Node> modelL2 = Loader::loadModel(filePath, 0.5);
-		osg::ref_ptr<osg::Node> modelL1 = Loader::loadModel(filePath, 0.1);
+		if (found) {
+			return static_cast<osg::LOD*>(found);
+		}
+	}
 
-		retModel = new osg::LOD;
+	// model wasn't found => load (from the asset-cache if possible) without the lock, so other models can be loaded meanwhile
+	TRACE_SCOPE("loadModel");
 
-		if (useLod) {
-			retModel->addChild(modelL1.get(), 50.0f, FLT_MAX);
-			retModel->addChild(modelL2.get(), 10.0f, 50.0f);
-			retModel->addChild(modelL3.get(), 0.0f, 10.0f);
-		} else {
-			retModel->addChild(modelL3.get(), 0.0f, FLT_MAX);
+	// the simplified models are only computed if they are used, all levels are prepared from one parse of the file
+	std::vector<float> ratios(1, 1.0f);
+	if (useLod) {
+		ratios.push_back(0.5f);
+		ratios.push_back(0.1f);
+	}
+
+	std::vector<osg::ref_ptr<osg::Node> > levels;
+	if (ProceduralAsteroid::isProcedural(filePath)) {
+		// the generated models are faster to generate than to read => not cached
+		{
+			LoadProfiler::ScopedTimer timer(LoadProfiler::MODEL_FILE, filePath);
+			levels = ProceduralAsteroid::createLevels(filePath, ratios.size());
+		}
+		for (unsigned int l = 0; l < levels.size(); ++l) {
+			optimizeModel(levels[l]);
 		}
+	} else {
+		// the levels are optimized before they are cached => a cached level is used as it is
+		levels = AssetCache::loadModels(filePath, getCacheKey(filePath), ratios, &ModelManager::optimizeModel);
+	}
 
-		_loaded.insert(std::pair<std::string, osg::ref_ptr<osg::LOD> >(filePath, retModel));
+	osg::ref_ptr<osg::Node> modelL3 = levels[0];
+	osg::ref_ptr<osg::LOD> retModel = new osg::LOD;
+
+	if (useLod) {
+		osg::ref_ptr<osg::Node> modelL2 = levels[1];
+		osg::ref_ptr<osg::Node> modelL1 = levels[2];
+
+		// the levels are selected by the size on the screen => independent of the scaling and the viewport
+		float pixelSizeL1 = getMaxPixelSize(modelL1);
+		float pixelSizeL2 = std::max(pixelSizeL1, getMaxPixelSize(modelL2));
+
+		retModel->setRangeMode(osg::LOD::PIXEL_SIZE_ON_SCREEN);
+		retModel->addChild(modelL1.get(), 0.0f, pixelSizeL1);
+		retModel->addChild(modelL2.get(), pixelSizeL1, pixelSizeL2);
+		retModel->addChild(modelL3.get(), pixelSizeL2, FLT_MAX);
 	} else {
-		// take found.
-		retModel = _loaded[filePath];
+		retModel->addChild(modelL3.get(), 0.0f, FLT_MAX);
+	}
+
+	// the tangents of the bumpmaps are computed once for all objects of the model (not drawn without a viewer)
+	if (!SpaceObject::getIsHeadless()) {
+		{
+			LoadProfiler::ScopedTimer timer(LoadProfiler::TANGENTS, filePath);
+			ComputeTangentVisitor ctv;
+			ctv.setTraversalMode(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN);
+			retModel->accept(ctv);
+		}
+
+		// the convex-hull and the bounding-box are read from the float-arrays => computed before the compression
+		// (the shapes of the generated models are computed from their seed when they are used)
+		if (IS_QUANTIZED) {
+			if (!ProceduralAsteroid::isProcedural(filePath)) {
+				computeShape(filePath, retModel);
+			}
+			QuantizeVisitor::quantize(retModel);
+		}
+	}
+
+	// store it in the manager (if another thread has loaded the same model meanwhile, its model is shared)
+	MemoryCounter counter;
+	retModel->accept(counter);
+
+	std::vector<osg::ref_ptr<osg::Referenced> > evicted;
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	osg::LOD* stored = static_cast<osg::LOD*>(_loaded.insert(filePath, retModel.get(), counter.cntBytes, &evicted));
+
+	// the simplified levels are the first children, the full model the last one (see above)
+	if (stored == retModel.get()) {
+		MemoryTracker::add(MemoryTracker::SIMPLIFIED_LEVELS, getSimplifiedSize(stored));
+	}
+	for (unsigned int i = 0; i < evicted.size(); ++i) {
+		MemoryTracker::add(MemoryTracker::SIMPLIFIED_LEVELS, -getSimplifiedSize(static_cast<osg::LOD*>(evicted[i].get())));
+	}
+
+	return stored;
+}
+
+
+/**
+ * \brief Get the simplified convex-hull of a model-file in the unscaled model-space. It's implemented in a way
+ * that the hull is computed only once per model, the scaling of an instance has to be applied to the vertices.
+ *
+ * \param filePath
+ *	    Complete path to the model.
+ * \param useLod
+ *      True if simplified models should be used if the model is not loaded yet (see loadModel()).
+ *
+ *  \return Convex-hull of the model (owned by the manager).
+ */
+const ConvexHull3D* ModelManager::loadConvexHull(std::string filePath, bool useLod) {
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		std::map<std::string, ConvexHull3D*>::iterator found = _convexHulls.find(filePath);
+
+		if (found != _convexHulls.end()) {
+			return found->second;
+		}
+	}
+
+	loadShape(filePath, useLod);
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	return _convexHulls[filePath];
+}
+
+
+/**
+ * \brief Get the bounding-box of the vertices of a model-file in the unscaled model-space (e.g. to approximate
+ * the moment of inertia). It's implemented in a way that the bounding-box is computed only once per model.
+ *
+ * \param filePath
+ *	    Complete path to the model.
+ * \param useLod
+ *      True if simplified models should be used if the model is not loaded yet (see loadModel()).
+ *
+ *  \return Bounding-box of the model.
+ */
+const osg::BoundingBox& ModelManager::getBoundingBox(std::string filePath, bool useLod) {
+	{
+		// the entries of the map are never changed once they are stored => the reference stays valid
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		std::map<std::string, osg::BoundingBox>::iterator found = _boundingBoxes.find(filePath);
+
+		if (found != _boundingBoxes.end()) {
+			return found->second;
+		}
+	}
+
+	// the box of a generated model is read from the vertices of its seed => its hull is computed on its first use
+	if (ProceduralAsteroid::isProcedural(filePath)) {
+		osg::ref_ptr<osg::Vec3Array> vertices = ProceduralAsteroid::createHullVertices(filePath);
+		osg::BoundingBox boundingBox;
+
+		for (unsigned int i = 0; i < vertices->size(); ++i) {
+			boundingBox.expandBy(vertices->at(i));
+		}
+
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		return _boundingBoxes.insert(std::pair<std::string, osg::BoundingBox>(filePath, boundingBox)).first->second;
+	}
+
+	loadShape(filePath, useLod);
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	return _boundingBoxes[filePath];
+}
+
+
+/**
+ * \brief Get the largest pixel-size on the screen (see osg::CullStack::pixelSize()) for which a simplified level
+ * keeps the geometric error below SCREEN_SPACE_ERROR. The vertices of a level with n vertices are spaced by about
+ * r * sqrt(4pi / n) on its bounding-sphere, which deviates by r * pi / (2n) from the sphere.
+ *
+ * \param model
+ *      Simplified level of a model.
+ *
+ * \return Maximal pixel-size of the level.
+ */
+float ModelManager::getMaxPixelSize(osg::ref_ptr<osg::Node> model) {
+	VertexCounter counter;
+	model->accept(counter);
+
+	return SCREEN_SPACE_ERROR * 2.0f * counter.cntVertices / static_cast<float>(osg::PI);
+}
+
+
+/**
+ * \brief Estimate the memory of the simplified levels of a model (all children but the last one).
+ *
+ * \param model
+ *      LOD-model of the manager.
+ *
+ * \return Memory of the vertex-arrays and indices in bytes.
+ */
+long long ModelManager::getSimplifiedSize(osg::LOD* model) {
+	MemoryCounter counter;
+
+	for (unsigned int i = 0; i + 1 < model->getNumChildren(); ++i) {
+		model->getChild(i)->accept(counter);
+	}
+
+	return static_cast<long long>(counter.cntBytes);
+}
+
+
+/**
+ * \brief Optimize a level of a model for the rendering (once before it's cached, the optimizer is never applied to the
+ *        nodes of the space-objects, which are updated by the physics).
+ *
+ * \param model
+ *      Level of a model.
+ */
+void ModelManager::optimizeModel(osg::ref_ptr<osg::Node> model) {
+	// only the options which keep the vertices of the model (the convex-hull and the tangents are computed from them):
+	// the geometries are indexed, the triangles are reordered for the post-transform vertex-cache (Forsyth) and the
+	// vertices by their first use for the fetch locality (see osgUtil::MeshOptimizers)
+	unsigned int options = osgUtil::Optimizer::SHARE_DUPLICATE_STATE | osgUtil::Optimizer::REMOVE_REDUNDANT_NODES
+		| osgUtil::Optimizer::MERGE_GEODES | osgUtil::Optimizer::MERGE_GEOMETRY | osgUtil::Optimizer::CHECK_GEOMETRY
+		| osgUtil::Optimizer::STATIC_OBJECT_DETECTION | osgUtil::Optimizer::INDEX_MESH
+		| osgUtil::Optimizer::VERTEX_POSTTRANSFORM | osgUtil::Optimizer::VERTEX_PRETRANSFORM;
+
+	LoadProfiler::ScopedTimer timer(LoadProfiler::OPTIMIZER, model->getName());
+	osgUtil::Optimizer optimizer;
+	optimizer.optimize(model.get(), options);
+}
+
+
+/**
+ * \brief Get the key of a model in the asset-cache (the hash is computed only once per model).
+ *
+ * \param filePath
+ *	    Complete path to the model.
+ *
+ *  \return Key of the model ("" => not cached).
+ */
+std::string ModelManager::getCacheKey(std::string filePath) {
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		std::map<std::string, std::string>::iterator found = _cacheKeys.find(filePath);
+
+		if (found != _cacheKeys.end()) {
+			return found->second;
+		}
+	}
+
+	std::string key = AssetCache::getKey(filePath);
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_cacheKeys[filePath] = key;
+
+	return key;
+}
+
+
+/**
+ * \brief Load the convex-hull and the bounding-box of a model from the asset-cache or compute them.
+ *
+ * \param filePath
+ *	    Complete path to the model.
+ * \param useLod
+ *      True if simplified models should be used if the model is not loaded yet (see loadModel()).
+ */
+void ModelManager::loadShape(std::string filePath, bool useLod) {
+	// the shape of a generated model doesn't depend on the rendered levels (see computeShape())
+	if (ProceduralAsteroid::isProcedural(filePath)) {
+		computeShape(filePath, nullptr);
+		return;
+	}
+
+	osg::ref_ptr<osg::LOD> model = loadModel(filePath, useLod);
+
+	// the quantized models have computed their shapes while they were loaded
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		if (_convexHulls.count(filePath) != 0) {
+			return;
+		}
+	}
+
+	computeShape(filePath, model);
+}
+
+
+/**
+ * \brief Load the convex-hull and the bounding-box of a loaded model from the asset-cache or compute them from
+ * its vertices.
+ *
+ * \param filePath
+ *	    Complete path to the model.
+ * \param model
+ *      LOD-model with the float vertex-arrays.
+ */
+void ModelManager::computeShape(std::string filePath, osg::ref_ptr<osg::LOD> model) {
+	// the vertices of all LOD-levels are part of the hull => the key depends on the loaded levels
+	TRACE_SCOPE("loadShape");
+	LoadProfiler::ScopedTimer timer(LoadProfiler::CONVEX_HULL, filePath);
+
+	// the hull of a generated model is computed from a coarse icosphere of its seed (not from the rendered levels)
+	if (ProceduralAsteroid::isProcedural(filePath)) {
+		osg::ref_ptr<osg::Vec3Array> vertices = ProceduralAsteroid::createHullVertices(filePath);
+		osg::BoundingBox boundingBox;
+
+		for (unsigned int i = 0; i < vertices->size(); ++i) {
+			boundingBox.expandBy(vertices->at(i));
+		}
+
+		ConvexHull3D* hull = new ConvexHull3D(vertices.get());
+		if (DistanceField::getIsEnabled() && DistanceField::isUseful(*hull)) {
+			hull->setDistanceField(DistanceField::compute(*hull));
+		}
+
+		storeShape(filePath, boundingBox, hull);
+		return;
+	}
+
+	std::string key = getCacheKey(filePath);
+	if (key != "" && model->getNumChildren() > 1) {
+		key += "_lod";
+	}
+	if (key != "" && ConvexDecomposition::getIsEnabled()) {
+		key += "_parts";
+	}
+	if (key != "" && DistanceField::getIsEnabled()) {
+		key += "_sdf" + std::to_string(DistanceField::getResolution());
 	}
 
-	return retModel;
+	osg::BoundingBox boundingBox;
+	ConvexHull3D* hull = nullptr;
+
+	if (!AssetCache::loadShape(key, boundingBox, hull)) {
+		// the hull of the unscaled model => the simplification is the same for all scalings
+		ConvexHullVisitor convexHull(osg::Matrix::identity());
+		model->accept(convexHull);
+		hull = convexHull.getConvexHull();
+
+		// a concave model collides with its convex parts (the hull stays the envelope of the compound)
+		if (ConvexDecomposition::getIsEnabled()) {
+			std::vector<ConvexHull3D*> parts;
+			ConvexDecomposition::decompose(convexHull.getVertices(), parts);
+			hull->setParts(parts);
+		}
+
+		// the field of the deep contacts follows the concave surface of the parts
+		if (DistanceField::getIsEnabled() && DistanceField::isUseful(*hull)) {
+			hull->setDistanceField(DistanceField::compute(*hull));
+		}
+
+		// bounding-box of the vertices of the last geometry (the full model of the LOD)
+		VertexListVisitor vListVisitor;
+		model->accept(vListVisitor);
+		const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(vListVisitor.getVertices());
+
+		for (unsigned int i = 0; vertices && i < vertices->size(); ++i) {
+			boundingBox.expandBy(vertices->at(i));
+		}
+
+		AssetCache::saveShape(key, boundingBox, *hull);
+	}
+
+	storeShape(filePath, boundingBox, hull);
+}
+
+
+/**
+ * \brief Store the convex-hull and the bounding-box of a model (if another thread has computed the same shape
+ *        meanwhile, its shape is shared).
+ *
+ * \param filePath
+ *	    Complete path to the model.
+ * \param boundingBox
+ *      Bounding-box of the unscaled model.
+ * \param hull
+ *      Convex-hull of the unscaled model (owned by the manager).
+ */
+void ModelManager::storeShape(std::string filePath, const osg::BoundingBox &boundingBox, ConvexHull3D* hull) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	if (!_convexHulls.insert(std::pair<std::string, ConvexHull3D*>(filePath, hull)).second) {
+		delete hull;
+	} else {
+		MemoryTracker::add(MemoryTracker::HULLS, static_cast<long long>(hull->getMemorySize()));
+	}
+	_boundingBoxes.insert(std::pair<std::string, osg::BoundingBox>(filePath, boundingBox));
 }
@@ -11,13 +11,26 @@
 
 #include <osg/Node>
 #include <osg/LOD>
+#include <osg/BoundingBox>
+#include <OpenThreads/Mutex>
 
+#include "ResourceCache.h"
+
+// Forward declarations
+namespace pbs17 {
+	class ConvexHull3D;
+}
 
 namespace pbs17 {
 
 	/**
 	 * \brief ModelManager manages already loaded models.
 	 * This class prevents to load the same model several times. If a model is requested which was already loaded, it will return the already loaded model. Otherwise it will load it into the cache.
+	 * The same holds for the convex-hulls of the models, which are stored unscaled and shared by all instances of a model.
+	 * The prepared models and hulls are additionally stored in the asset-cache on the disk (see AssetCache), except the
+	 * generated models (see ProceduralAsteroid). The unused models are evicted beyond the budget (see ResourceCache),
+	 * the hulls and bounding-boxes are small and referenced by the space-objects, so they are kept.
+	 * The manager can be used by several threads (different models are loaded concurrently).
 	 */
 	class ModelManager {
 	public:
@@ -30,25 +43,167 @@ namespace pbs17 {
 
 		/**
 		 * \brief Load a Node-object from a model-file. It's implemented in a way that the model is loaded only once.
+		 * The tangents of the bumpmaps are computed once with the model (shared by all objects of the model).
+		 * The simplified levels are selected by the pixel-size of the model on the screen (see getMaxPixelSize()),
+		 * the global quality is set by the LOD-scale of the camera.
 		 * 
 		 * \param filePath
 		 *	    Complete path to the model to load.
 		 * \param useLod
-		 *      True if simplified models should be used if the camera is far away.
+		 *      True if simplified models should be used if the model is small on the screen.
 		 *
 		 *  \return Model-node to attach to osg-nodes.
 		 */
 		osg::ref_ptr<osg::LOD> loadModel(std::string filePath, bool useLod = true);
 
 
+		/**
+		 * \brief Get the simplified convex-hull of a model-file in the unscaled model-space. It's implemented in a way
+		 * that the hull is computed only once per model, the scaling of an instance has to be applied to the vertices.
+		 * 
+		 * \param filePath
+		 *	    Complete path to the model.
+		 * \param useLod
+		 *      True if simplified models should be used if the model is not loaded yet (see loadModel()).
+		 *
+		 *  \return Convex-hull of the model (owned by the manager).
+		 */
+		const ConvexHull3D* loadConvexHull(std::string filePath, bool useLod = true);
+
+
+		/**
+		 * \brief Get the bounding-box of the vertices of a model-file in the unscaled model-space (e.g. to approximate
+		 * the moment of inertia). It's implemented in a way that the bounding-box is computed only once per model.
+		 * 
+		 * \param filePath
+		 *	    Complete path to the model.
+		 * \param useLod
+		 *      True if simplified models should be used if the model is not loaded yet (see loadModel()).
+		 *
+		 *  \return Bounding-box of the model.
+		 */
+		const osg::BoundingBox& getBoundingBox(std::string filePath, bool useLod = true);
+
+
+		/**
+		 * \brief Enable or disable the compressed vertex-arrays of the loaded models (see QuantizeVisitor).
+		 *
+		 * \param isQuantized
+		 *      True if the models are quantized after their tangents and convex-hulls are computed.
+		 */
+		static void setIsQuantized(bool isQuantized) {
+			IS_QUANTIZED = isQuantized;
+		}
+
+
 	private:
 
-		//! All models which have been loaded already.
-		std::map<std::string, osg::ref_ptr<osg::LOD> > _loaded;
+		//! All models which have been loaded already (and not evicted).
+		ResourceCache _loaded;
+
+		//! Unscaled convex-hulls of all models which have been computed already.
+		std::map<std::string, ConvexHull3D*> _convexHulls;
+
+		//! Unscaled bounding-boxes of all models which have been computed already.
+		std::map<std::string, osg::BoundingBox> _boundingBoxes;
+
+		//! Keys of the models in the asset-cache.
+		std::map<std::string, std::string> _cacheKeys;
+
+		//! Protects the maps (the models are loaded without holding it).
+		OpenThreads::Mutex _mutex;
+
+		//! Allowed geometric error of a simplified level in pixels
+		static const float SCREEN_SPACE_ERROR;
+
+		//! True if the vertex-arrays of the models are quantized
+		static bool IS_QUANTIZED;
+
+
+		/**
+		 * \brief Get the key of a model in the asset-cache (the hash is computed only once per model).
+		 *
+		 * \param filePath
+		 *	    Complete path to the model.
+		 *
+		 *  \return Key of the model ("" => not cached).
+		 */
+		std::string getCacheKey(std::string filePath);
+
+
+		/**
+		 * \brief Load the convex-hull and the bounding-box of a model from the asset-cache or compute them.
+		 *
+		 * \param filePath
+		 *	    Complete path to the model.
+		 * \param useLod
+		 *      True if simplified models should be used if the model is not loaded yet (see loadModel()).
+		 */
+		void loadShape(std::string filePath, bool useLod);
+
+
+		/**
+		 * \brief Load the convex-hull and the bounding-box of a loaded model from the asset-cache or compute them from
+		 * its vertices.
+		 *
+		 * \param filePath
+		 *	    Complete path to the model.
+		 * \param model
+		 *      LOD-model with the float vertex-arrays.
+		 */
+		void computeShape(std::string filePath, osg::ref_ptr<osg::LOD> model);
+
+
+		/**
+		 * \brief Store the convex-hull and the bounding-box of a model (if another thread has computed the same shape
+		 *        meanwhile, its shape is shared).
+		 *
+		 * \param filePath
+		 *	    Complete path to the model.
+		 * \param boundingBox
+		 *      Bounding-box of the unscaled model.
+		 * \param hull
+		 *      Convex-hull of the unscaled model (owned by the manager).
+		 */
+		void storeShape(std::string filePath, const osg::BoundingBox &boundingBox, ConvexHull3D* hull);
+
+
+		/**
+		 * \brief Get the largest pixel-size on the screen (see osg::CullStack::pixelSize()) for which a simplified level
+		 * keeps the geometric error below SCREEN_SPACE_ERROR. The vertices of a level with n vertices are spaced by about
+		 * r * sqrt(4pi / n) on its bounding-sphere, which deviates by r * pi / (2n) from the sphere.
+		 *
+		 * \param model
+		 *      Simplified level of a model.
+		 *
+		 * \return Maximal pixel-size of the level.
+		 */
+		static float getMaxPixelSize(osg::ref_ptr<osg::Node> model);
+
+
+		/**
+		 * \brief Estimate the memory of the simplified levels of a model (all children but the last one).
+		 *
+		 * \param model
+		 *      LOD-model of the manager.
+		 *
+		 * \return Memory of the vertex-arrays and indices in bytes.
+		 */
+		static long long getSimplifiedSize(osg::LOD* model);
+
+
+		/**
+		 * \brief Optimize a level of a model for the rendering (once before it's cached, the optimizer is never applied to the
+		 *        nodes of the space-objects, which are updated by the physics).
+		 *
+		 * \param model
+		 *      Level of a model.
+		 */
+		static void optimizeModel(osg::ref_ptr<osg::Node> model);
 
 
 		//! Private constructor to be sure the class can't be created outside of this class.
-		ModelManager() {}
+		ModelManager() : _loaded(MemoryTracker::MODELS) {}
 
 		//! Private copy-constructor to prevent copying the class.
 		ModelManager(ModelManager const&) {}
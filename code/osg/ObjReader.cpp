@@ -0,0 +1,678 @@
+﻿/**
+ * \brief Functionality for reading Wavefront OBJ-models without the generic osgDB-plugin.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "ObjReader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <osg/BlendFunc>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Material>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ReadFile>
+#include <osgUtil/SmoothingVisitor>
+
+#include "Loader.h"
+
+using namespace pbs17;
+
+
+//! True if the OBJ-models are read by this reader
+bool ObjReader::IS_ENABLED = true;
+
+//! Bytes per chunk which is parsed by one task
+const size_t ObjReader::CHUNK_SIZE = 1 << 18;
+
+
+namespace {
+
+	/**
+	 * \brief Content of a file mapped into the memory (read completely on windows).
+	 */
+	class MappedFile {
+	public:
+		const char* data = nullptr;
+		size_t size = 0;
+
+		explicit MappedFile(const std::string &filePath) {
+#if defined(_WIN32)
+			std::ifstream file(filePath, std::ios::in | std::ios::binary);
+			if (!file) return;
+
+			_content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			data = _content.data();
+			size = _content.size();
+#else
+			int fd = ::open(filePath.c_str(), O_RDONLY);
+			if (fd < 0) return;
+
+			struct stat info;
+			if (fstat(fd, &info) != 0 || info.st_size == 0) {
+				::close(fd);
+				return;
+			}
+
+			void* map = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			::close(fd);
+			if (map == MAP_FAILED) return;
+
+			data = static_cast<const char*>(map);
+			size = static_cast<size_t>(info.st_size);
+#endif
+		}
+
+		~MappedFile() {
+#if !defined(_WIN32)
+			if (data != nullptr) {
+				munmap(const_cast<char*>(data), size);
+			}
+#endif
+		}
+
+	private:
+		std::vector<char> _content;
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+	};
+
+
+	/**
+	 * \brief Lines of a file which are parsed by one task, with the statements which are needed to build the geometries.
+	 */
+	struct ObjChunk {
+		const char* begin;
+		const char* end;
+		//! Number of positions, texture-coordinates and normals in the chunk
+		int cntPositions = 0;
+		int cntTexCoords = 0;
+		int cntNormals = 0;
+		//! Position, texture-coordinate and normal (-1 => none) of each corner of the faces
+		std::vector<int> corners;
+		//! Number of corners of each face
+		std::vector<int> faceSizes;
+		//! First face of each usemtl-statement and its material
+		std::vector<std::pair<int, std::string> > materials;
+		//! Material-libraries of the mtllib-statements
+		std::vector<std::string> libraries;
+		//! False if the chunk contains an unsupported or broken statement
+		bool isValid = true;
+	};
+
+
+	/**
+	 * \brief Material of a MTL-file (the properties used by the rendering).
+	 */
+	struct ObjMaterial {
+		osg::Vec4 ambient = osg::Vec4(0.2f, 0.2f, 0.2f, 1.0f);
+		osg::Vec4 diffuse = osg::Vec4(0.8f, 0.8f, 0.8f, 1.0f);
+		osg::Vec4 specular = osg::Vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		float shininess = 0.0f;
+		float alpha = 1.0f;
+		std::string diffuseMap;
+	};
+
+
+	/**
+	 * \brief Corner of a face which is unique in a geometry.
+	 */
+	struct CornerKey {
+		int position;
+		int texCoord;
+		int normal;
+
+		bool operator==(const CornerKey &other) const {
+			return position == other.position && texCoord == other.texCoord && normal == other.normal;
+		}
+	};
+
+	struct CornerKeyHash {
+		size_t operator()(const CornerKey &key) const {
+			return (static_cast<size_t>(key.position) * 73856093u) ^ (static_cast<size_t>(key.texCoord + 1) * 19349663u)
+				^ (static_cast<size_t>(key.normal + 1) * 83492791u);
+		}
+	};
+
+
+	/**
+	 * \brief Triangles of all faces with the same material.
+	 */
+	struct ObjGroup {
+		std::string material;
+		//! Position, texture-coordinate and normal of the corners of the triangles
+		std::vector<int> corners;
+	};
+
+
+	inline bool isBlank(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+
+	inline const char* skipBlanks(const char* p, const char* end) {
+		while (p < end && isBlank(*p)) ++p;
+		return p;
+	}
+
+
+	inline const char* skipLine(const char* p, const char* end) {
+		const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+		return newline ? newline + 1 : end;
+	}
+
+
+	/**
+	 * \brief Parse a decimal number without the locale (the number has to end at a blank, a slash or the line).
+	 */
+	bool parseFloat(const char* &p, const char* end, float &value) {
+		p = skipBlanks(p, end);
+		bool isNegative = false;
+
+		if (p < end && (*p == '-' || *p == '+')) {
+			isNegative = *p == '-';
+			++p;
+		}
+
+		double mantissa = 0.0;
+		int exponent = 0;
+		bool hasDigits = false;
+
+		for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+			mantissa = mantissa * 10.0 + (*p - '0');
+			hasDigits = true;
+		}
+
+		if (p < end && *p == '.') {
+			for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+				mantissa = mantissa * 10.0 + (*p - '0');
+				--exponent;
+				hasDigits = true;
+			}
+		}
+
+		if (!hasDigits) {
+			return false;
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			++p;
+			bool isNegativeExponent = false;
+			if (p < end && (*p == '-' || *p == '+')) {
+				isNegativeExponent = *p == '-';
+				++p;
+			}
+
+			int e = 0;
+			for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+				e = std::min(e * 10 + (*p - '0'), 1000);
+			}
+			exponent += isNegativeExponent ? -e : e;
+		}
+
+		// powers of ten by squaring (exact for the usual exponents of the exported models)
+		double scale = 1.0;
+		double base = 10.0;
+		for (int e = std::abs(exponent); e > 0; e >>= 1, base *= base) {
+			if (e & 1) scale *= base;
+		}
+
+		double result = exponent < 0 ? mantissa / scale : mantissa * scale;
+		value = static_cast<float>(isNegative ? -result : result);
+
+		return p == end || isBlank(*p) || *p == '\n';
+	}
+
+
+	/**
+	 * \brief Parse the integer of an index of a face.
+	 */
+	bool parseInt(const char* &p, const char* end, int &value) {
+		bool isNegative = false;
+
+		if (p < end && (*p == '-' || *p == '+')) {
+			isNegative = *p == '-';
+			++p;
+		}
+
+		if (p == end || *p < '0' || *p > '9') {
+			return false;
+		}
+
+		int result = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+			result = result * 10 + (*p - '0');
+		}
+
+		value = isNegative ? -result : result;
+		return true;
+	}
+
+
+	/**
+	 * \brief Convert an index of a face (1-based or relative to the current end) to a 0-based index.
+	 */
+	inline bool resolveIndex(int index, int cntBefore, int cntTotal, int &resolved) {
+		resolved = index > 0 ? index - 1 : cntBefore + index;
+		return index != 0 && resolved >= 0 && resolved < cntTotal;
+	}
+
+
+	/**
+	 * \brief Get the rest of the line without the surrounding blanks (names may contain spaces).
+	 */
+	std::string restOfLine(const char* p, const char* end) {
+		p = skipBlanks(p, end);
+		const char* last = p;
+
+		while (last < end && *last != '\n') ++last;
+		while (last > p && isBlank(last[-1])) --last;
+
+		return std::string(p, last);
+	}
+
+
+	/**
+	 * \brief Get the keyword at the beginning of a line (p is moved behind it).
+	 */
+	std::string readKeyword(const char* &p, const char* end) {
+		const char* first = p;
+		while (p < end && !isBlank(*p) && *p != '\n') ++p;
+
+		return std::string(first, p);
+	}
+
+
+	/**
+	 * \brief Count the positions, texture-coordinates and normals of a chunk (the first character of each line is enough).
+	 */
+	void countVertices(ObjChunk &chunk) {
+		for (const char* p = chunk.begin; p < chunk.end; p = skipLine(p, chunk.end)) {
+			p = skipBlanks(p, chunk.end);
+
+			if (p + 1 < chunk.end && p[0] == 'v') {
+				if (isBlank(p[1])) {
+					++chunk.cntPositions;
+				} else if (p + 2 < chunk.end && isBlank(p[2])) {
+					chunk.cntTexCoords += p[1] == 't';
+					chunk.cntNormals += p[1] == 'n';
+				}
+			}
+		}
+	}
+
+
+	/**
+	 * \brief Parse the statements of a chunk, the vertices are written at the offsets of the chunk.
+	 */
+	void parseChunk(ObjChunk &chunk, const int offsets[3], const int totals[3],
+		osg::Vec3Array &positions, osg::Vec2Array &texCoords, osg::Vec3Array &normals) {
+		int counts[3] = { offsets[0], offsets[1], offsets[2] };
+
+		for (const char* p = chunk.begin; p < chunk.end && chunk.isValid; p = skipLine(p, chunk.end)) {
+			p = skipBlanks(p, chunk.end);
+
+			if (p == chunk.end || *p == '\n' || *p == '#') {
+				continue;
+			}
+
+			std::string keyword = readKeyword(p, chunk.end);
+			bool hasArguments = p < chunk.end && isBlank(*p);
+
+			// the vertices without arguments weren't counted
+			if (!hasArguments && keyword[0] == 'v') {
+				chunk.isValid = false;
+			} else if (keyword == "v") {
+				osg::Vec3 &v = positions[counts[0]++];
+				chunk.isValid = parseFloat(p, chunk.end, v.x()) && parseFloat(p, chunk.end, v.y()) && parseFloat(p, chunk.end, v.z());
+			} else if (keyword == "vt") {
+				// the second coordinate is optional
+				osg::Vec2 &t = texCoords[counts[1]++];
+				chunk.isValid = parseFloat(p, chunk.end, t.x());
+				const char* second = skipBlanks(p, chunk.end);
+				if (chunk.isValid && second < chunk.end && *second != '\n') {
+					chunk.isValid = parseFloat(p, chunk.end, t.y());
+				}
+			} else if (keyword == "vn") {
+				osg::Vec3 &n = normals[counts[2]++];
+				chunk.isValid = parseFloat(p, chunk.end, n.x()) && parseFloat(p, chunk.end, n.y()) && parseFloat(p, chunk.end, n.z());
+			} else if (keyword == "f") {
+				int cntCorners = 0;
+
+				for (p = skipBlanks(p, chunk.end); chunk.isValid && p < chunk.end && *p != '\n'; p = skipBlanks(p, chunk.end)) {
+					// v, v/vt, v//vn or v/vt/vn
+					int index[3] = { 0, 0, 0 };
+					int corner[3] = { -1, -1, -1 };
+					chunk.isValid = parseInt(p, chunk.end, index[0]);
+
+					for (int k = 1; k < 3 && chunk.isValid && p < chunk.end && *p == '/'; ++k) {
+						++p;
+						if (p < chunk.end && *p != '/' && !isBlank(*p) && *p != '\n') {
+							chunk.isValid = parseInt(p, chunk.end, index[k]);
+						}
+					}
+
+					for (int k = 0; k < 3 && chunk.isValid; ++k) {
+						if (k == 0 || index[k] != 0) {
+							chunk.isValid = resolveIndex(index[k], counts[k], totals[k], corner[k]);
+						}
+					}
+
+					chunk.isValid = chunk.isValid && (p == chunk.end || isBlank(*p) || *p == '\n');
+					chunk.corners.insert(chunk.corners.end(), corner, corner + 3);
+					++cntCorners;
+				}
+
+				chunk.isValid = chunk.isValid && cntCorners >= 3;
+				chunk.faceSizes.push_back(cntCorners);
+			} else if (keyword == "usemtl") {
+				chunk.materials.push_back(std::make_pair(static_cast<int>(chunk.faceSizes.size()), restOfLine(p, chunk.end)));
+			} else if (keyword == "mtllib") {
+				chunk.libraries.push_back(restOfLine(p, chunk.end));
+			} else if (keyword != "o" && keyword != "g" && keyword != "s" && keyword != "mg") {
+				// lines, points, free-form geometry, ... => read by osgDB
+				chunk.isValid = false;
+			}
+		}
+	}
+
+
+	/**
+	 * \brief Read the materials of a MTL-file (unknown statements are ignored).
+	 */
+	void readMaterials(const std::string &filePath, std::map<std::string, ObjMaterial> &materials) {
+		std::ifstream stream(filePath);
+		std::string line;
+		ObjMaterial* material = nullptr;
+
+		while (std::getline(stream, line)) {
+			const char* p = line.c_str();
+			const char* end = p + line.size();
+			p = skipBlanks(p, end);
+			std::string keyword = readKeyword(p, end);
+
+			if (keyword == "newmtl") {
+				material = &materials[restOfLine(p, end)];
+			} else if (material == nullptr) {
+				continue;
+			} else if (keyword == "Ka" || keyword == "Kd" || keyword == "Ks") {
+				osg::Vec4 color(0.0f, 0.0f, 0.0f, 1.0f);
+				if (!parseFloat(p, end, color.r()) || !parseFloat(p, end, color.g()) || !parseFloat(p, end, color.b())) {
+					continue;
+				}
+
+				(keyword == "Ka" ? material->ambient : keyword == "Kd" ? material->diffuse : material->specular) = color;
+			} else if (keyword == "Ns") {
+				parseFloat(p, end, material->shininess);
+			} else if (keyword == "d") {
+				parseFloat(p, end, material->alpha);
+			} else if (keyword == "Tr") {
+				float transparency;
+				if (parseFloat(p, end, transparency)) {
+					material->alpha = 1.0f - transparency;
+				}
+			} else if (keyword == "map_Kd") {
+				// the options are in front of the name of the image
+				std::string map = restOfLine(p, end);
+				size_t option = map.rfind(' ');
+				material->diffuseMap = !map.empty() && map[0] == '-' && option != std::string::npos ? map.substr(option + 1) : map;
+			}
+		}
+	}
+
+
+	/**
+	 * \brief Create the state-set of a material (the textures are searched next to the model-file).
+	 */
+	osg::ref_ptr<osg::StateSet> createStateSet(const ObjMaterial &material, const std::string &directory) {
+		osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet;
+		osg::ref_ptr<osg::Material> osgMaterial = new osg::Material;
+		osg::Vec4 diffuse = material.diffuse;
+		diffuse.a() = material.alpha;
+
+		osgMaterial->setAmbient(osg::Material::FRONT_AND_BACK, material.ambient);
+		osgMaterial->setDiffuse(osg::Material::FRONT_AND_BACK, diffuse);
+		osgMaterial->setSpecular(osg::Material::FRONT_AND_BACK, material.specular);
+		osgMaterial->setShininess(osg::Material::FRONT_AND_BACK, std::min(std::max(material.shininess / 1000.0f * 128.0f, 0.0f), 128.0f));
+		stateset->setAttribute(osgMaterial.get());
+
+		if (material.alpha < 1.0f) {
+			stateset->setAttributeAndModes(new osg::BlendFunc(osg::BlendFunc::SRC_ALPHA, osg::BlendFunc::ONE_MINUS_SRC_ALPHA));
+			stateset->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+		}
+
+		if (material.diffuseMap != "") {
+			std::string imagePath = osgDB::fileExists(directory + "/" + material.diffuseMap) ? directory + "/" + material.diffuseMap : material.diffuseMap;
+			osg::ref_ptr<osg::Image> image = osgDB::readImageFile(imagePath);
+
+			if (image) {
+				stateset->setTextureAttributeAndModes(0, Loader::createTexture(image.get()).get());
+			}
+		}
+
+		return stateset;
+	}
+
+
+	/**
+	 * \brief Build the indexed geometry of a group (each unique corner becomes one vertex).
+	 */
+	osg::ref_ptr<osg::Geometry> createGeometry(const ObjGroup &group, const osg::Vec3Array &positions,
+		const osg::Vec2Array &texCoords, const osg::Vec3Array &normals) {
+		int cntCorners = group.corners.size() / 3;
+		bool hasTexCoords = false;
+		bool hasNormals = true;
+
+		for (int i = 0; i < cntCorners; ++i) {
+			hasTexCoords = hasTexCoords || group.corners[3 * i + 1] >= 0;
+			hasNormals = hasNormals && group.corners[3 * i + 2] >= 0;
+		}
+
+		osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+		osg::ref_ptr<osg::Vec2Array> uvs = hasTexCoords ? new osg::Vec2Array : nullptr;
+		osg::ref_ptr<osg::Vec3Array> vertexNormals = hasNormals ? new osg::Vec3Array : nullptr;
+		osg::ref_ptr<osg::DrawElementsUInt> triangles = new osg::DrawElementsUInt(GL_TRIANGLES);
+		triangles->reserve(cntCorners);
+
+		std::unordered_map<CornerKey, unsigned int, CornerKeyHash> unique;
+		unique.reserve(cntCorners);
+
+		for (int i = 0; i < cntCorners; ++i) {
+			// without normals on all corners, the normals are smoothed => only the positions and uvs are unique
+			CornerKey key = { group.corners[3 * i], group.corners[3 * i + 1], hasNormals ? group.corners[3 * i + 2] : -1 };
+			std::pair<std::unordered_map<CornerKey, unsigned int, CornerKeyHash>::iterator, bool> inserted =
+				unique.insert(std::make_pair(key, static_cast<unsigned int>(vertices->size())));
+
+			if (inserted.second) {
+				vertices->push_back(positions[key.position]);
+				if (hasTexCoords) {
+					uvs->push_back(key.texCoord >= 0 ? texCoords[key.texCoord] : osg::Vec2());
+				}
+				if (hasNormals) {
+					vertexNormals->push_back(normals[key.normal]);
+				}
+			}
+
+			triangles->push_back(inserted.first->second);
+		}
+
+		osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+		geometry->setVertexArray(vertices.get());
+		if (hasTexCoords) {
+			geometry->setTexCoordArray(0, uvs.get(), osg::Array::BIND_PER_VERTEX);
+		}
+		if (hasNormals) {
+			geometry->setNormalArray(vertexNormals.get(), osg::Array::BIND_PER_VERTEX);
+		}
+		geometry->addPrimitiveSet(triangles.get());
+
+		if (!hasNormals) {
+			osgUtil::SmoothingVisitor::smooth(*geometry);
+		}
+
+		return geometry;
+	}
+}
+
+
+/**
+ * \brief Read an OBJ-model.
+ *
+ * \param filePath
+ *      Complete path to the model-file.
+ *
+ * \return Node of the model (nullptr => the file can't be read or contains unsupported statements).
+ */
+osg::ref_ptr<osg::Node> ObjReader::readModel(std::string filePath) {
+	if (!IS_ENABLED || osgDB::getLowerCaseFileExtension(filePath) != "obj") {
+		return nullptr;
+	}
+
+	MappedFile file(filePath);
+	if (file.data == nullptr) {
+		return nullptr;
+	}
+
+	// split the file into chunks of whole lines
+	std::vector<ObjChunk> chunks;
+	const char* end = file.data + file.size;
+
+	for (const char* p = file.data; p < end;) {
+		ObjChunk chunk;
+		chunk.begin = p;
+		chunk.end = static_cast<size_t>(end - p) > CHUNK_SIZE ? skipLine(p + CHUNK_SIZE, end) : end;
+		chunks.push_back(chunk);
+		p = chunk.end;
+	}
+
+	int cntChunks = chunks.size();
+
+	// the vertices of each chunk are placed behind the vertices of the previous chunks
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (int c = 0; c < cntChunks; ++c) {
+		countVertices(chunks[c]);
+	}
+
+	std::vector<int> offsets(3 * (cntChunks + 1), 0);
+	for (int c = 0; c < cntChunks; ++c) {
+		offsets[3 * (c + 1)] = offsets[3 * c] + chunks[c].cntPositions;
+		offsets[3 * (c + 1) + 1] = offsets[3 * c + 1] + chunks[c].cntTexCoords;
+		offsets[3 * (c + 1) + 2] = offsets[3 * c + 2] + chunks[c].cntNormals;
+	}
+
+	const int* totals = &offsets[3 * cntChunks];
+	osg::ref_ptr<osg::Vec3Array> positions = new osg::Vec3Array(totals[0]);
+	osg::ref_ptr<osg::Vec2Array> texCoords = new osg::Vec2Array(totals[1]);
+	osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array(totals[2]);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (int c = 0; c < cntChunks; ++c) {
+		parseChunk(chunks[c], &offsets[3 * c], totals, *positions, *texCoords, *normals);
+	}
+
+	// the triangles of the faces are grouped by their material (in the order of the file)
+	std::vector<ObjGroup> groups;
+	std::map<std::string, int> groupOfMaterial;
+	std::vector<std::string> libraries;
+	int group = -1;
+
+	for (int c = 0; c < cntChunks; ++c) {
+		const ObjChunk &chunk = chunks[c];
+		if (!chunk.isValid) {
+			return nullptr;
+		}
+
+		libraries.insert(libraries.end(), chunk.libraries.begin(), chunk.libraries.end());
+		unsigned int nextMaterial = 0;
+		int corner = 0;
+
+		for (int f = 0; f <= static_cast<int>(chunk.faceSizes.size()); ++f) {
+			for (; nextMaterial < chunk.materials.size() && chunk.materials[nextMaterial].first == f; ++nextMaterial) {
+				std::map<std::string, int>::iterator found = groupOfMaterial.insert(std::make_pair(chunk.materials[nextMaterial].second, static_cast<int>(groups.size()))).first;
+				if (found->second == static_cast<int>(groups.size())) {
+					groups.push_back(ObjGroup());
+					groups.back().material = found->first;
+				}
+				group = found->second;
+			}
+
+			if (f == static_cast<int>(chunk.faceSizes.size())) {
+				break;
+			}
+
+			// faces in front of the first usemtl-statement have no material
+			if (group < 0) {
+				groupOfMaterial[""] = 0;
+				groups.push_back(ObjGroup());
+				group = 0;
+			}
+
+			// fan-triangulation of the (convex) faces
+			std::vector<int> &corners = groups[group].corners;
+			const int* face = &chunk.corners[3 * corner];
+
+			for (int k = 1; k + 1 < chunk.faceSizes[f]; ++k) {
+				corners.insert(corners.end(), face, face + 3);
+				corners.insert(corners.end(), face + 3 * k, face + 3 * k + 6);
+			}
+
+			corner += chunk.faceSizes[f];
+		}
+	}
+
+	if (groups.empty()) {
+		return nullptr;
+	}
+
+	std::string directory = osgDB::getFilePath(filePath);
+	std::map<std::string, ObjMaterial> materials;
+	for (unsigned int i = 0; i < libraries.size(); ++i) {
+		readMaterials(directory.empty() ? libraries[i] : directory + "/" + libraries[i], materials);
+	}
+
+	int cntGroups = groups.size();
+	std::vector<osg::ref_ptr<osg::Geometry> > geometries(cntGroups);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (int g = 0; g < cntGroups; ++g) {
+		geometries[g] = createGeometry(groups[g], *positions, *texCoords, *normals);
+	}
+
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	for (int g = 0; g < cntGroups; ++g) {
+		std::map<std::string, ObjMaterial>::const_iterator material = materials.find(groups[g].material);
+
+		if (material != materials.end()) {
+			geometries[g]->setStateSet(createStateSet(material->second, directory));
+		}
+
+		geode->addDrawable(geometries[g].get());
+	}
+
+	return geode;
+}
@@ -0,0 +1,69 @@
+﻿/**
+ * \brief Functionality for reading Wavefront OBJ-models without the generic osgDB-plugin.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <string>
+
+#include <osg/Node>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief ObjReader reads the OBJ-models of the data-directory with a dedicated parser.
+	 * The file is mapped into the memory and parsed in chunks of lines concurrently (the vertices of a chunk are placed by
+	 * counting the vertices of the previous chunks first). The corners of the faces are deduplicated into one indexed
+	 * geometry per material, the materials are read from the MTL-files (colors and the diffuse texture).
+	 *
+	 * Files with statements it doesn't handle (e.g. lines, points or free-form surfaces) are rejected, so the caller can
+	 * fall back to osgDB (see Loader::loadModel()).
+	 */
+	class ObjReader {
+	public:
+
+		/**
+		 * \brief Read an OBJ-model.
+		 *
+		 * \param filePath
+		 *      Complete path to the model-file.
+		 *
+		 * \return Node of the model (nullptr => the file can't be read or contains unsupported statements).
+		 */
+		static osg::ref_ptr<osg::Node> readModel(std::string filePath);
+
+
+		/**
+		 * \brief Enable or disable the reader (if disabled, all models are read by osgDB).
+		 *
+		 * \param isEnabled
+		 *      True if the OBJ-models are read by this reader.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the reader is enabled.
+		 *
+		 * \return True if the OBJ-models are read by this reader.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+
+		//! True if the OBJ-models are read by this reader
+		static bool IS_ENABLED;
+
+		//! Bytes per chunk which is parsed by one task
+		static const size_t CHUNK_SIZE;
+	};
+}
@@ -0,0 +1,231 @@
+﻿/**
+ * \brief Functionality for rendering without a window (e.g. the videos of a compute-server without a display).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "OffscreenContext.h"
+
+#include <cstdio>
+
+#include <osg/State>
+
+#if defined(PBS17_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "../physics/Logger.h"
+
+using namespace pbs17;
+
+
+#if defined(PBS17_EGL)
+namespace {
+
+	/**
+	 * \brief Graphics-context of a pbuffer-surface of EGL with the desktop-OpenGL (compatibility-profile, the shaders
+	 * of the scene use the built-in uniforms).
+	 */
+	class EglContext : public osg::GraphicsContext {
+	public:
+		EglContext(osg::GraphicsContext::Traits* traits) {
+			_traits = traits;
+
+			setState(new osg::State);
+			getState()->setGraphicsContext(this);
+			getState()->setContextID(osg::GraphicsContext::createNewContextID());
+		}
+
+		bool isSameKindAs(const osg::Object* object) const override {
+			return dynamic_cast<const EglContext*>(object) != nullptr;
+		}
+
+		const char* libraryName() const override {
+			return "pbs17";
+		}
+
+		const char* className() const override {
+			return "EglContext";
+		}
+
+		bool valid() const override {
+			return _traits.valid();
+		}
+
+		bool realizeImplementation() override {
+			// the first GPU-device does not need a display-server, older drivers only have the default display
+			_display = EGL_NO_DISPLAY;
+			PFNEGLQUERYDEVICESEXTPROC queryDevices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(eglGetProcAddress("eglQueryDevicesEXT"));
+			PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+			EGLDeviceEXT device;
+			EGLint cntDevices = 0;
+			if (queryDevices && getPlatformDisplay && queryDevices(1, &device, &cntDevices) && cntDevices > 0) {
+				_display = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+			}
+			if (_display == EGL_NO_DISPLAY) {
+				_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+			}
+
+			EGLint major, minor;
+			if (_display == EGL_NO_DISPLAY || !eglInitialize(_display, &major, &minor)) {
+				LOG_ERROR("No display of EGL could be initialized.");
+				return false;
+			}
+
+			const EGLint configAttributes[] = {
+				EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+				EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+				EGL_RED_SIZE, 8,
+				EGL_GREEN_SIZE, 8,
+				EGL_BLUE_SIZE, 8,
+				EGL_ALPHA_SIZE, 8,
+				EGL_DEPTH_SIZE, 24,
+				EGL_SAMPLE_BUFFERS, _traits->samples > 0 ? 1 : 0,
+				EGL_SAMPLES, static_cast<EGLint>(_traits->samples),
+				EGL_NONE
+			};
+			EGLConfig config;
+			EGLint cntConfigs = 0;
+			if (!eglChooseConfig(_display, configAttributes, &config, 1, &cntConfigs) || cntConfigs == 0) {
+				LOG_ERROR("No configuration of EGL has a pbuffer with the desktop-OpenGL.");
+				eglTerminate(_display);
+				return false;
+			}
+
+			const EGLint surfaceAttributes[] = {
+				EGL_WIDTH, _traits->width,
+				EGL_HEIGHT, _traits->height,
+				EGL_NONE
+			};
+			eglBindAPI(EGL_OPENGL_API);
+			_surface = eglCreatePbufferSurface(_display, config, surfaceAttributes);
+			_context = eglCreateContext(_display, config, EGL_NO_CONTEXT, nullptr);
+
+			if (_surface == EGL_NO_SURFACE || _context == EGL_NO_CONTEXT) {
+				LOG_ERROR("The pbuffer of EGL (" << _traits->width << "x" << _traits->height << ") could not be created.");
+				closeImplementation();
+				return false;
+			}
+
+			LOG_INFO("Rendering into a pbuffer of EGL " << major << "." << minor << " (" << _traits->width << "x" << _traits->height << ").");
+			return true;
+		}
+
+		bool isRealizedImplementation() const override {
+			return _context != EGL_NO_CONTEXT;
+		}
+
+		void closeImplementation() override {
+			if (_display == EGL_NO_DISPLAY) return;
+
+			eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (_context != EGL_NO_CONTEXT) {
+				eglDestroyContext(_display, _context);
+			}
+			if (_surface != EGL_NO_SURFACE) {
+				eglDestroySurface(_display, _surface);
+			}
+			eglTerminate(_display);
+
+			_display = EGL_NO_DISPLAY;
+			_surface = EGL_NO_SURFACE;
+			_context = EGL_NO_CONTEXT;
+		}
+
+		bool makeCurrentImplementation() override {
+			return eglMakeCurrent(_display, _surface, _surface, _context) == EGL_TRUE;
+		}
+
+		bool makeContextCurrentImplementation(osg::GraphicsContext* readContext) override {
+			return makeCurrentImplementation();
+		}
+
+		bool releaseContextImplementation() override {
+			return eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT) == EGL_TRUE;
+		}
+
+		void bindPBufferToTextureImplementation(GLenum buffer) override {}
+
+		void swapBuffersImplementation() override {
+			eglSwapBuffers(_display, _surface);
+		}
+
+	protected:
+		~EglContext() {
+			close(true);
+		}
+
+	private:
+		EGLDisplay _display = EGL_NO_DISPLAY;
+		EGLSurface _surface = EGL_NO_SURFACE;
+		EGLContext _context = EGL_NO_CONTEXT;
+	};
+}
+#endif
+
+
+//! Rendered into a window by default.
+int OffscreenContext::WIDTH = 0;
+//! Rendered into a window by default.
+int OffscreenContext::HEIGHT = 0;
+
+
+/**
+ * \brief Create the graphics-context of the given size (it's realized by the viewer).
+ *
+ * \param width, height
+ *      Size of the rendered frames: unit = pixels
+ * \param samples
+ *      Number of samples per pixel (0 => no multisampling).
+ *
+ * \return Graphics-context (nullptr => no pbuffer is supported).
+ */
+osg::ref_ptr<osg::GraphicsContext> OffscreenContext::create(int width, int height, int samples) {
+	osg::ref_ptr<osg::GraphicsContext::Traits> traits = new osg::GraphicsContext::Traits;
+	traits->x = 0;
+	traits->y = 0;
+	traits->width = width;
+	traits->height = height;
+	traits->samples = samples;
+	traits->windowDecoration = false;
+	traits->pbuffer = true;
+
+#if defined(PBS17_EGL)
+	// a pbuffer of EGL is read from its back-buffer
+	traits->doubleBuffer = true;
+	return new EglContext(traits.get());
+#else
+	traits->doubleBuffer = false;
+	osg::ref_ptr<osg::GraphicsContext> context = osg::GraphicsContext::createGraphicsContext(traits.get());
+	if (!context.valid()) {
+		LOG_ERROR("The windowing-system has no pbuffer (the offscreen-rendering without a display needs -DPBS17_EGL=ON).");
+	}
+
+	return context;
+#endif
+}
+
+
+/**
+ * \brief Parse the size of the frames as used on the command-line (e.g. 1920x1080).
+ *
+ * \param size
+ *      Size in the form widthxheight.
+ * \param width, height
+ *      Output-parameters: Parsed size (only written if the size is valid).
+ *
+ * \return True if the size is valid.
+ */
+bool OffscreenContext::parseSize(const std::string &size, int &width, int &height) {
+	int w = 0, h = 0;
+	char rest = 0;
+	if (std::sscanf(size.c_str(), "%dx%d%c", &w, &h, &rest) != 2 || w <= 0 || h <= 0) {
+		return false;
+	}
+
+	width = w;
+	height = h;
+	return true;
+}
@@ -0,0 +1,102 @@
+﻿/**
+ * \brief Functionality for rendering without a window (e.g. the videos of a compute-server without a display).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <string>
+
+#include <osg/GraphicsContext>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief OffscreenContext creates the graphics-context of the viewer without a window, so the frames of the
+	 * capture-pipeline (see SnapImageDrawCallback and FrameWriterThread) can be rendered on a machine without a
+	 * display. With PBS17_EGL, the context is a pbuffer of EGL on the first GPU-device (EGL_EXT_platform_device, the
+	 * default display otherwise), which needs neither an X-server nor a desktop. Without it, the pbuffer of the
+	 * windowing-system of OSG is used (needs a display-connection, e.g. a virtual one).
+	 */
+	class OffscreenContext {
+	public:
+
+		/**
+		 * \brief Create the graphics-context of the given size (it's realized by the viewer).
+		 *
+		 * \param width, height
+		 *      Size of the rendered frames: unit = pixels
+		 * \param samples
+		 *      Number of samples per pixel (0 => no multisampling).
+		 *
+		 * \return Graphics-context (nullptr => no pbuffer is supported).
+		 */
+		static osg::ref_ptr<osg::GraphicsContext> create(int width, int height, int samples);
+
+
+		/**
+		 * \brief Parse the size of the frames as used on the command-line (e.g. 1920x1080).
+		 *
+		 * \param size
+		 *      Size in the form widthxheight.
+		 * \param width, height
+		 *      Output-parameters: Parsed size (only written if the size is valid).
+		 *
+		 * \return True if the size is valid.
+		 */
+		static bool parseSize(const std::string &size, int &width, int &height);
+
+
+		/**
+		 * \brief Render without a window. Has to be set before the viewer is created.
+		 *
+		 * \param width, height
+		 *      Size of the rendered frames (0 => rendered into a window).
+		 */
+		static void setSize(int width, int height) {
+			WIDTH = width;
+			HEIGHT = height;
+		}
+
+
+		/**
+		 * \brief Get the width of the rendered frames.
+		 *
+		 * \return Width of the frames: unit = pixels
+		 */
+		static int getWidth() {
+			return WIDTH;
+		}
+
+
+		/**
+		 * \brief Get the height of the rendered frames.
+		 *
+		 * \return Height of the frames: unit = pixels
+		 */
+		static int getHeight() {
+			return HEIGHT;
+		}
+
+
+		/**
+		 * \brief Get if the viewer renders without a window.
+		 *
+		 * \return True if the graphics-context is offscreen.
+		 */
+		static bool getIsEnabled() {
+			return WIDTH > 0 && HEIGHT > 0;
+		}
+
+
+	private:
+
+		//! Width of the rendered frames (0 => rendered into a window)
+		static int WIDTH;
+		//! Height of the rendered frames (0 => rendered into a window)
+		static int HEIGHT;
+	};
+}
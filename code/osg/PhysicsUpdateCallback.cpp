@@ -0,0 +1,18 @@
+﻿/**
+ * \brief Update-callback which writes the state of the physics-thread to the scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-06
+ */
+
+#include "PhysicsUpdateCallback.h"
+
+#include "../physics/PhysicsThread.h"
+
+using namespace pbs17;
+
+void PhysicsUpdateCallback::operator()(osg::Node* node, osg::NodeVisitor* nv) {
+	_physicsThread->applySnapshot();
+
+	traverse(node, nv);
+}
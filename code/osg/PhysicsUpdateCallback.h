@@ -0,0 +1,36 @@
+﻿/**
+* \brief Update-callback which writes the state of the physics-thread to the scene.
+*
+* \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+* \Date:   2017-12-06
+*/
+
+#pragma once
+
+#include <osg/NodeCallback>
+
+
+namespace pbs17 {
+	class PhysicsThread;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief This callback interpolates the snapshot of the physics-thread into the matrix-transformations
+	 *        during the update-traversal.
+	 */
+	class PhysicsUpdateCallback : public osg::NodeCallback {
+	public:
+
+		PhysicsUpdateCallback(PhysicsThread* physicsThread)
+			: _physicsThread(physicsThread) {}
+
+		void operator () (osg::Node* node, osg::NodeVisitor* nv) override;
+
+	protected:
+
+		PhysicsThread* _physicsThread;
+	};
+}
@@ -0,0 +1,509 @@
+﻿/**
+ * \brief Functionality for generating the asteroid-models from a seed instead of loading them from a file.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "ProceduralAsteroid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <stdint.h>
+
+#include <osg/BoundingBox>
+#include <osg/Geode>
+#include <osg/Math>
+#include <osg/PrimitiveSet>
+
+using namespace pbs17;
+
+
+//! Radius of the undisplaced icosphere
+const float ProceduralAsteroid::RADIUS = 25.0f;
+//! Relative displacement of the surface by the noise
+const float ProceduralAsteroid::AMPLITUDE = 0.35f;
+//! Number of subdivisions of the icosahedron of the finest level (2562 vertices)
+const unsigned int ProceduralAsteroid::SUBDIVISIONS = 4;
+//! Number of subdivisions of the icosahedron of the convex-hull (162 vertices)
+const unsigned int ProceduralAsteroid::HULL_SUBDIVISIONS = 2;
+//! Frequency of the first octave of the noise on the unit-sphere
+const float ProceduralAsteroid::FREQUENCY = 1.5f;
+//! Number of octaves of the noise
+const int ProceduralAsteroid::OCTAVES = 4;
+//! Largest relative shortening of an axis of the ellipsoid
+const float ProceduralAsteroid::ELONGATION = 0.4f;
+
+
+namespace {
+
+	//! Prefix of the names of the generated models
+	const std::string PREFIX = "procedural";
+
+	//! Step along the tangents of the unit-sphere for the normals of the displaced surface
+	const float NORMAL_STEP = 0.01f;
+
+
+	/**
+	 * \brief Integer-hash with a good avalanche (same operations as hashInt() of the shader).
+	 */
+	uint32_t hashInt(uint32_t x) {
+		x ^= x >> 16;
+		x *= 0x7feb352dU;
+		x ^= x >> 15;
+		x *= 0x846ca68bU;
+		x ^= x >> 16;
+		return x;
+	}
+
+
+	/**
+	 * \brief Map the upper 24 bit of a hash to [0, 1] (exact in a float).
+	 */
+	float unitHash(uint32_t h) {
+		return static_cast<float>(h >> 8) * (1.0f / 16777215.0f);
+	}
+
+
+	/**
+	 * \brief Random value in [-1, 1] at a point of the integer-lattice.
+	 */
+	float latticeValue(int x, int y, int z, uint32_t seed) {
+		uint32_t h = hashInt(seed ^ hashInt(static_cast<uint32_t>(x) + hashInt(static_cast<uint32_t>(y) + hashInt(static_cast<uint32_t>(z)))));
+		return unitHash(h) * 2.0f - 1.0f;
+	}
+
+
+	/**
+	 * \brief Value-noise: the lattice-values are interpolated with a smoothstep.
+	 */
+	float valueNoise(const osg::Vec3 &p, uint32_t seed) {
+		float cellX = std::floor(p.x()), cellY = std::floor(p.y()), cellZ = std::floor(p.z());
+		float fx = p.x() - cellX, fy = p.y() - cellY, fz = p.z() - cellZ;
+		float wx = fx * fx * (3.0f - 2.0f * fx), wy = fy * fy * (3.0f - 2.0f * fy), wz = fz * fz * (3.0f - 2.0f * fz);
+		int x = static_cast<int>(cellX), y = static_cast<int>(cellY), z = static_cast<int>(cellZ);
+
+		float x00 = latticeValue(x, y, z, seed) * (1.0f - wx) + latticeValue(x + 1, y, z, seed) * wx;
+		float x10 = latticeValue(x, y + 1, z, seed) * (1.0f - wx) + latticeValue(x + 1, y + 1, z, seed) * wx;
+		float x01 = latticeValue(x, y, z + 1, seed) * (1.0f - wx) + latticeValue(x + 1, y, z + 1, seed) * wx;
+		float x11 = latticeValue(x, y + 1, z + 1, seed) * (1.0f - wx) + latticeValue(x + 1, y + 1, z + 1, seed) * wx;
+		float y0 = x00 * (1.0f - wy) + x10 * wy;
+		float y1 = x01 * (1.0f - wy) + x11 * wy;
+
+		return y0 * (1.0f - wz) + y1 * wz;
+	}
+
+
+	/**
+	 * \brief Normal of the displaced surface: cross-product of the differences along two tangents of the unit-sphere.
+	 */
+	osg::Vec3 getSurfaceNormal(const osg::Vec3 &direction, unsigned int seed) {
+		osg::Vec3 reference = std::abs(direction.y()) < 0.99f ? osg::Vec3(0.0f, 1.0f, 0.0f) : osg::Vec3(1.0f, 0.0f, 0.0f);
+		osg::Vec3 tangent = reference ^ direction;
+		tangent.normalize();
+		osg::Vec3 binormal = direction ^ tangent;
+
+		osg::Vec3 position = ProceduralAsteroid::getSurface(direction, seed);
+		osg::Vec3 stepT = direction + tangent * NORMAL_STEP;
+		osg::Vec3 stepB = direction + binormal * NORMAL_STEP;
+		stepT.normalize();
+		stepB.normalize();
+
+		osg::Vec3 normal = (ProceduralAsteroid::getSurface(stepT, seed) - position) ^ (ProceduralAsteroid::getSurface(stepB, seed) - position);
+		normal.normalize();
+
+		return normal;
+	}
+}
+
+
+/**
+ * \brief Check if a model is generated instead of loaded.
+ *
+ * \param filePath
+ *      Complete path to the model (the path of the data-folder is ignored).
+ *
+ * \return True if the name of the model is "procedural" or "procedural:<seed>".
+ */
+bool ProceduralAsteroid::isProcedural(const std::string &filePath) {
+	std::string name = filePath.substr(filePath.find_last_of("/\\") + 1);
+	return name == PREFIX || name.compare(0, PREFIX.size() + 1, PREFIX + ":") == 0;
+}
+
+
+/**
+ * \brief Get the seed of a generated model.
+ *
+ * \param filePath
+ *      Complete path to the model.
+ * \param seed
+ *      Seed of the model (output, reduced to 24 bit so it's exact in the float-matrices of the instances).
+ *
+ * \return False if the model has no seed (the undisplaced icosphere).
+ */
+bool ProceduralAsteroid::getSeed(const std::string &filePath, unsigned int &seed) {
+	std::string name = filePath.substr(filePath.find_last_of("/\\") + 1);
+	if (!isProcedural(name) || name == PREFIX) {
+		return false;
+	}
+
+	seed = static_cast<unsigned int>(std::strtoul(name.c_str() + PREFIX.size() + 1, nullptr, 10)) & 0xffffffu;
+	return true;
+}
+
+
+/**
+ * \brief Get the path of the undisplaced icosphere which is shared by all seeds of the instanced models.
+ *
+ * \param filePath
+ *      Complete path to a generated model.
+ *
+ * \return Path of the model "procedural" in the same folder.
+ */
+std::string ProceduralAsteroid::getBasePath(const std::string &filePath) {
+	return filePath.substr(0, filePath.find_last_of("/\\") + 1) + PREFIX;
+}
+
+
+/**
+ * \brief Generate the levels of detail of a model (from the finest to the coarsest level, the levels are
+ *        icospheres with one subdivision less per level).
+ *
+ * \param filePath
+ *      Complete path to the generated model.
+ * \param cntLevels
+ *      Number of levels.
+ *
+ * \return One geode per level.
+ */
+std::vector<osg::ref_ptr<osg::Node> > ProceduralAsteroid::createLevels(const std::string &filePath, unsigned int cntLevels) {
+	unsigned int seed = 0;
+	bool isDisplaced = getSeed(filePath, seed);
+	std::vector<osg::ref_ptr<osg::Node> > levels;
+
+	for (unsigned int l = 0; l < cntLevels; ++l) {
+		osg::ref_ptr<osg::Geometry> geometry = createGeometry(SUBDIVISIONS - std::min(l, SUBDIVISIONS), isDisplaced, seed);
+
+		// the icosphere is displaced by the shader => bounded by the largest displacement
+		if (!isDisplaced) {
+			float bound = RADIUS * (1.0f + AMPLITUDE);
+			geometry->setInitialBound(osg::BoundingBox(-bound, -bound, -bound, bound, bound, bound));
+		}
+
+		osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+		geode->addDrawable(geometry.get());
+		levels.push_back(geode);
+	}
+
+	return levels;
+}
+
+
+/**
+ * \brief Get the vertices of the coarse icosphere of a model for its convex-hull (see HULL_SUBDIVISIONS).
+ *
+ * \param filePath
+ *      Complete path to the generated model.
+ *
+ * \return Displaced vertices in the unscaled model-space.
+ */
+osg::ref_ptr<osg::Vec3Array> ProceduralAsteroid::createHullVertices(const std::string &filePath) {
+	unsigned int seed = 0;
+	bool isDisplaced = getSeed(filePath, seed);
+
+	std::vector<osg::Vec3> directions;
+	std::vector<unsigned int> triangles;
+	createIcosphere(HULL_SUBDIVISIONS, directions, triangles);
+
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+	vertices->reserve(directions.size());
+
+	for (unsigned int i = 0; i < directions.size(); ++i) {
+		vertices->push_back(isDisplaced ? getSurface(directions[i], seed) : directions[i] * RADIUS);
+	}
+
+	return vertices;
+}
+
+
+/**
+ * \brief Get the point of the surface of a seed in a direction (same computation as the shader).
+ *
+ * \param direction
+ *      Normalized direction from the center of the model.
+ * \param seed
+ *      Seed of the model.
+ *
+ * \return Point in the unscaled model-space.
+ */
+osg::Vec3 ProceduralAsteroid::getSurface(const osg::Vec3 &direction, unsigned int seed) {
+	// ellipsoid of the seed, displaced along the direction
+	osg::Vec3 axes(1.0f - ELONGATION * unitHash(hashInt(seed * 3u)), 1.0f - ELONGATION * unitHash(hashInt(seed * 3u + 1u)),
+		1.0f - ELONGATION * unitHash(hashInt(seed * 3u + 2u)));
+	float displacement = RADIUS * (1.0f + AMPLITUDE * fractalNoise(direction, seed));
+
+	return osg::Vec3(axes.x() * direction.x(), axes.y() * direction.y(), axes.z() * direction.z()) * displacement;
+}
+
+
+/**
+ * \brief Get the GLSL-source of the surface: vec3 asteroidSurface(vec3 direction, uint seed) with the same
+ *        constants as getSurface().
+ *
+ * \return Source of the function (inserted into the vertex-shaders before their main-function).
+ */
+std::string ProceduralAsteroid::getShaderSource() {
+	std::ostringstream source;
+	source << std::showpoint << std::setprecision(9);
+
+	source <<
+		"uint hashInt(uint x)\n"
+		"{\n"
+		"    x ^= x >> 16u;\n"
+		"    x *= 0x7feb352du;\n"
+		"    x ^= x >> 15u;\n"
+		"    x *= 0x846ca68bu;\n"
+		"    x ^= x >> 16u;\n"
+		"    return x;\n"
+		"}\n"
+		"float unitHash(uint h)\n"
+		"{\n"
+		"    return float(h >> 8u) * (1.0 / 16777215.0);\n"
+		"}\n"
+		"float latticeValue(ivec3 c, uint seed)\n"
+		"{\n"
+		"    return unitHash(hashInt(seed ^ hashInt(uint(c.x) + hashInt(uint(c.y) + hashInt(uint(c.z)))))) * 2.0 - 1.0;\n"
+		"}\n"
+		"float valueNoise(vec3 p, uint seed)\n"
+		"{\n"
+		"    vec3 cell = floor(p);\n"
+		"    vec3 f = p - cell;\n"
+		"    vec3 w = f * f * (3.0 - 2.0 * f);\n"
+		"    ivec3 c = ivec3(cell);\n"
+		"    float x00 = mix(latticeValue(c, seed), latticeValue(c + ivec3(1, 0, 0), seed), w.x);\n"
+		"    float x10 = mix(latticeValue(c + ivec3(0, 1, 0), seed), latticeValue(c + ivec3(1, 1, 0), seed), w.x);\n"
+		"    float x01 = mix(latticeValue(c + ivec3(0, 0, 1), seed), latticeValue(c + ivec3(1, 0, 1), seed), w.x);\n"
+		"    float x11 = mix(latticeValue(c + ivec3(0, 1, 1), seed), latticeValue(c + ivec3(1, 1, 1), seed), w.x);\n"
+		"    return mix(mix(x00, x10, w.y), mix(x01, x11, w.y), w.z);\n"
+		"}\n"
+		"float fractalNoise(vec3 p, uint seed)\n"
+		"{\n"
+		"    float sum = 0.0;\n"
+		"    float total = 0.0;\n"
+		"    float amplitude = 0.5;\n"
+		"    float frequency = " << FREQUENCY << ";\n"
+		"    for (int o = 0; o < " << OCTAVES << "; ++o)\n"
+		"    {\n"
+		"        sum += amplitude * valueNoise(p * frequency, seed + uint(o));\n"
+		"        total += amplitude;\n"
+		"        amplitude *= 0.5;\n"
+		"        frequency *= 2.0;\n"
+		"    }\n"
+		"    return sum / total;\n"
+		"}\n"
+		"vec3 asteroidSurface(vec3 direction, uint seed)\n"
+		"{\n"
+		"    vec3 axes = vec3(1.0) - " << ELONGATION << " * vec3(unitHash(hashInt(seed * 3u)), unitHash(hashInt(seed * 3u + 1u)),\n"
+		"        unitHash(hashInt(seed * 3u + 2u)));\n"
+		"    return axes * direction * (" << RADIUS << " * (1.0 + " << AMPLITUDE << " * fractalNoise(direction, seed)));\n"
+		"}\n";
+
+	return source.str();
+}
+
+
+/**
+ * \brief Generate the vertices and the triangles of a subdivided icosahedron on the unit-sphere.
+ *
+ * \param subdivisions
+ *      Number of subdivisions (each splits a triangle into four).
+ * \param directions
+ *      Vertices on the unit-sphere (output).
+ * \param triangles
+ *      Three indices per triangle (output, counter-clockwise from the outside).
+ */
+void ProceduralAsteroid::createIcosphere(unsigned int subdivisions, std::vector<osg::Vec3> &directions, std::vector<unsigned int> &triangles) {
+	const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+	const float corners[12][3] = {
+		{ -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+		{ 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+		{ t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 }
+	};
+	const unsigned int faces[60] = {
+		0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+		1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+		3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+		4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1
+	};
+
+	directions.clear();
+	for (int c = 0; c < 12; ++c) {
+		osg::Vec3 direction(corners[c][0], corners[c][1], corners[c][2]);
+		direction.normalize();
+		directions.push_back(direction);
+	}
+	triangles.assign(faces, faces + 60);
+
+	for (unsigned int s = 0; s < subdivisions; ++s) {
+		// the midpoint of an edge is shared by its two triangles
+		std::map<std::pair<unsigned int, unsigned int>, unsigned int> midpoints;
+		std::vector<unsigned int> subdivided;
+		subdivided.reserve(4 * triangles.size());
+
+		for (unsigned int f = 0; f < triangles.size(); f += 3) {
+			unsigned int mid[3];
+
+			for (int e = 0; e < 3; ++e) {
+				unsigned int a = triangles[f + e], b = triangles[f + (e + 1) % 3];
+				std::pair<unsigned int, unsigned int> edge(std::min(a, b), std::max(a, b));
+				std::map<std::pair<unsigned int, unsigned int>, unsigned int>::iterator found = midpoints.find(edge);
+
+				if (found != midpoints.end()) {
+					mid[e] = found->second;
+				} else {
+					osg::Vec3 direction = directions[a] + directions[b];
+					direction.normalize();
+					mid[e] = directions.size();
+					directions.push_back(direction);
+					midpoints[edge] = mid[e];
+				}
+			}
+
+			unsigned int split[12] = {
+				triangles[f], mid[0], mid[2], mid[0], triangles[f + 1], mid[1],
+				mid[2], mid[1], triangles[f + 2], mid[0], mid[1], mid[2]
+			};
+			subdivided.insert(subdivided.end(), split, split + 12);
+		}
+
+		triangles.swap(subdivided);
+	}
+}
+
+
+/**
+ * \brief Generate the geometry of a level (the vertices on the seam of the spherical texture-coordinates
+ *        and on the poles are duplicated).
+ *
+ * \param subdivisions
+ *      Number of subdivisions of the icosphere.
+ * \param isDisplaced
+ *      True if the vertices are displaced by the seed (otherwise the sphere with RADIUS).
+ * \param seed
+ *      Seed of the model.
+ *
+ * \return Indexed geometry with normals and texture-coordinates.
+ */
+osg::ref_ptr<osg::Geometry> ProceduralAsteroid::createGeometry(unsigned int subdivisions, bool isDisplaced, unsigned int seed) {
+	std::vector<osg::Vec3> directions;
+	std::vector<unsigned int> triangles;
+	createIcosphere(subdivisions, directions, triangles);
+
+	// spherical texture-coordinates around the y-axis
+	std::vector<osg::Vec2> texCoords(directions.size());
+	for (unsigned int i = 0; i < directions.size(); ++i) {
+		const osg::Vec3 &d = directions[i];
+		texCoords[i] = osg::Vec2(0.5f + std::atan2(d.z(), d.x()) / (2.0f * osg::PIf),
+			0.5f + std::asin(osg::clampBetween(d.y(), -1.0f, 1.0f)) / osg::PIf);
+	}
+
+	// the directions of the vertices with the texture-coordinates (the seam and the poles get their own copies)
+	std::vector<osg::Vec3> vertexDirections(directions);
+	std::vector<osg::Vec2> vertexTexCoords(texCoords);
+	std::map<unsigned int, unsigned int> wrapped;
+	osg::ref_ptr<osg::DrawElementsUInt> elements = new osg::DrawElementsUInt(GL_TRIANGLES);
+	elements->reserve(triangles.size());
+
+	for (unsigned int f = 0; f < triangles.size(); f += 3) {
+		unsigned int corners[3] = { triangles[f], triangles[f + 1], triangles[f + 2] };
+		float minU = std::min(texCoords[corners[0]].x(), std::min(texCoords[corners[1]].x(), texCoords[corners[2]].x()));
+		float maxU = std::max(texCoords[corners[0]].x(), std::max(texCoords[corners[1]].x(), texCoords[corners[2]].x()));
+
+		// a triangle across the seam uses the copies of its left vertices which continue to the right (u + 1)
+		if (maxU - minU > 0.5f) {
+			for (int c = 0; c < 3; ++c) {
+				if (texCoords[corners[c]].x() < 0.5f) {
+					std::map<unsigned int, unsigned int>::iterator found = wrapped.find(corners[c]);
+
+					if (found == wrapped.end()) {
+						found = wrapped.insert(std::make_pair(corners[c], static_cast<unsigned int>(vertexDirections.size()))).first;
+						vertexDirections.push_back(directions[corners[c]]);
+						vertexTexCoords.push_back(texCoords[corners[c]] + osg::Vec2(1.0f, 0.0f));
+					}
+
+					corners[c] = found->second;
+				}
+			}
+		}
+
+		// a pole has no longitude => each triangle gets a copy with the longitude of its other vertices
+		for (int c = 0; c < 3; ++c) {
+			const osg::Vec3 &d = vertexDirections[corners[c]];
+
+			if (std::abs(d.x()) < 1e-6f && std::abs(d.z()) < 1e-6f) {
+				float u = 0.5f * (vertexTexCoords[corners[(c + 1) % 3]].x() + vertexTexCoords[corners[(c + 2) % 3]].x());
+				vertexTexCoords.push_back(osg::Vec2(u, vertexTexCoords[corners[c]].y()));
+				vertexDirections.push_back(d);
+				corners[c] = vertexDirections.size() - 1;
+			}
+		}
+
+		elements->push_back(corners[0]);
+		elements->push_back(corners[1]);
+		elements->push_back(corners[2]);
+	}
+
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+	osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array;
+	osg::ref_ptr<osg::Vec2Array> uvs = new osg::Vec2Array;
+	vertices->reserve(vertexDirections.size());
+	normals->reserve(vertexDirections.size());
+	uvs->reserve(vertexDirections.size());
+
+	for (unsigned int i = 0; i < vertexDirections.size(); ++i) {
+		const osg::Vec3 &d = vertexDirections[i];
+		vertices->push_back(isDisplaced ? getSurface(d, seed) : d * RADIUS);
+		normals->push_back(isDisplaced ? getSurfaceNormal(d, seed) : d);
+		uvs->push_back(vertexTexCoords[i]);
+	}
+
+	osg::ref_ptr<osg::Geometry> geometry = new osg::Geometry;
+	geometry->setVertexArray(vertices.get());
+	geometry->setTexCoordArray(0, uvs.get(), osg::Array::BIND_PER_VERTEX);
+	geometry->setNormalArray(normals.get(), osg::Array::BIND_PER_VERTEX);
+	geometry->addPrimitiveSet(elements.get());
+
+	return geometry;
+}
+
+
+/**
+ * \brief Get the fractal value-noise of a seed at a point (OCTAVES octaves starting at FREQUENCY).
+ *
+ * \param point
+ *      Point on the unit-sphere.
+ * \param seed
+ *      Seed of the model.
+ *
+ * \return Noise in [-1, 1].
+ */
+float ProceduralAsteroid::fractalNoise(const osg::Vec3 &point, unsigned int seed) {
+	float sum = 0.0f;
+	float total = 0.0f;
+	float amplitude = 0.5f;
+	float frequency = FREQUENCY;
+
+	for (int o = 0; o < OCTAVES; ++o) {
+		sum += amplitude * valueNoise(point * frequency, seed + static_cast<uint32_t>(o));
+		total += amplitude;
+		amplitude *= 0.5f;
+		frequency *= 2.0f;
+	}
+
+	return sum / total;
+}
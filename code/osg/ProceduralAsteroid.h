@@ -0,0 +1,182 @@
+﻿/**
+ * \brief Functionality for generating the asteroid-models from a seed instead of loading them from a file.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <osg/Array>
+#include <osg/Geometry>
+#include <osg/Node>
+#include <osg/Vec3>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief ProceduralAsteroid generates the models named "procedural:<seed>" (instead of an OBJ-file).
+	 * The surface of an asteroid is an ellipsoid of the seed, which is displaced along its directions by the fractal
+	 * value-noise of the seed. The same surface is evaluated by the vertex-shader of the instanced models (see
+	 * getShaderSource()), so all seeds share one icosphere per level of detail which is displaced on the GPU (the seed
+	 * is passed per instance, see InstancedModel). The models which are not instanced and the convex-hulls are
+	 * displaced on the CPU (the hull from a coarse icosphere).
+	 *
+	 * The model "procedural" without a seed is the undisplaced icosphere of the instanced models.
+	 */
+	class ProceduralAsteroid {
+	public:
+
+		/**
+		 * \brief Check if a model is generated instead of loaded.
+		 *
+		 * \param filePath
+		 *      Complete path to the model (the path of the data-folder is ignored).
+		 *
+		 * \return True if the name of the model is "procedural" or "procedural:<seed>".
+		 */
+		static bool isProcedural(const std::string &filePath);
+
+
+		/**
+		 * \brief Get the seed of a generated model.
+		 *
+		 * \param filePath
+		 *      Complete path to the model.
+		 * \param seed
+		 *      Seed of the model (output, reduced to 24 bit so it's exact in the float-matrices of the instances).
+		 *
+		 * \return False if the model has no seed (the undisplaced icosphere).
+		 */
+		static bool getSeed(const std::string &filePath, unsigned int &seed);
+
+
+		/**
+		 * \brief Get the path of the undisplaced icosphere which is shared by all seeds of the instanced models.
+		 *
+		 * \param filePath
+		 *      Complete path to a generated model.
+		 *
+		 * \return Path of the model "procedural" in the same folder.
+		 */
+		static std::string getBasePath(const std::string &filePath);
+
+
+		/**
+		 * \brief Generate the levels of detail of a model (from the finest to the coarsest level, the levels are
+		 *        icospheres with one subdivision less per level).
+		 *
+		 * \param filePath
+		 *      Complete path to the generated model.
+		 * \param cntLevels
+		 *      Number of levels.
+		 *
+		 * \return One geode per level.
+		 */
+		static std::vector<osg::ref_ptr<osg::Node> > createLevels(const std::string &filePath, unsigned int cntLevels);
+
+
+		/**
+		 * \brief Get the vertices of the coarse icosphere of a model for its convex-hull (see HULL_SUBDIVISIONS).
+		 *
+		 * \param filePath
+		 *      Complete path to the generated model.
+		 *
+		 * \return Displaced vertices in the unscaled model-space.
+		 */
+		static osg::ref_ptr<osg::Vec3Array> createHullVertices(const std::string &filePath);
+
+
+		/**
+		 * \brief Get the point of the surface of a seed in a direction (same computation as the shader).
+		 *
+		 * \param direction
+		 *      Normalized direction from the center of the model.
+		 * \param seed
+		 *      Seed of the model.
+		 *
+		 * \return Point in the unscaled model-space.
+		 */
+		static osg::Vec3 getSurface(const osg::Vec3 &direction, unsigned int seed);
+
+
+		/**
+		 * \brief Get the GLSL-source of the surface: vec3 asteroidSurface(vec3 direction, uint seed) with the same
+		 *        constants as getSurface().
+		 *
+		 * \return Source of the function (inserted into the vertex-shaders before their main-function).
+		 */
+		static std::string getShaderSource();
+
+
+		//! Radius of the undisplaced icosphere (about the size of the asteroids of the OBJ-files)
+		static const float RADIUS;
+
+		//! Relative displacement of the surface by the noise (the model is bounded by RADIUS * (1 + AMPLITUDE))
+		static const float AMPLITUDE;
+
+
+	private:
+
+		//! Number of subdivisions of the icosahedron of the finest level
+		static const unsigned int SUBDIVISIONS;
+
+		//! Number of subdivisions of the icosahedron of the convex-hull
+		static const unsigned int HULL_SUBDIVISIONS;
+
+		//! Frequency of the first octave of the noise on the unit-sphere
+		static const float FREQUENCY;
+
+		//! Number of octaves of the noise
+		static const int OCTAVES;
+
+		//! Largest relative shortening of an axis of the ellipsoid
+		static const float ELONGATION;
+
+
+		/**
+		 * \brief Generate the vertices and the triangles of a subdivided icosahedron on the unit-sphere.
+		 *
+		 * \param subdivisions
+		 *      Number of subdivisions (each splits a triangle into four).
+		 * \param directions
+		 *      Vertices on the unit-sphere (output).
+		 * \param triangles
+		 *      Three indices per triangle (output, counter-clockwise from the outside).
+		 */
+		static void createIcosphere(unsigned int subdivisions, std::vector<osg::Vec3> &directions, std::vector<unsigned int> &triangles);
+
+
+		/**
+		 * \brief Generate the geometry of a level (the vertices on the seam of the spherical texture-coordinates
+		 *        and on the poles are duplicated).
+		 *
+		 * \param subdivisions
+		 *      Number of subdivisions of the icosphere.
+		 * \param isDisplaced
+		 *      True if the vertices are displaced by the seed (otherwise the sphere with RADIUS).
+		 * \param seed
+		 *      Seed of the model.
+		 *
+		 * \return Indexed geometry with normals and texture-coordinates.
+		 */
+		static osg::ref_ptr<osg::Geometry> createGeometry(unsigned int subdivisions, bool isDisplaced, unsigned int seed);
+
+
+		/**
+		 * \brief Get the fractal value-noise of a seed at a point (OCTAVES octaves starting at FREQUENCY).
+		 *
+		 * \param point
+		 *      Point on the unit-sphere.
+		 * \param seed
+		 *      Seed of the model.
+		 *
+		 * \return Noise in [-1, 1].
+		 */
+		static float fractalNoise(const osg::Vec3 &point, unsigned int seed);
+	};
+}
@@ -0,0 +1,245 @@
+﻿/**
+ * \brief Functionality for storing the linked shader-programs on the disk (GL_ARB_get_program_binary).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#include "ProgramBinaryCache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+
+#include <osg/GL>
+#include <osg/Camera>
+#include <osg/GraphicsContext>
+#include <osg/OperationThread>
+#include <osg/Version>
+#include <osgDB/FileUtils>
+#include <OpenThreads/ScopedLock>
+
+#include "../config.h"
+#include "../physics/JobSystem.h"
+#include "../physics/Logger.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Loads the binaries when the context is realized (with the current context).
+	 */
+	class LoadBinariesOperation : public osg::Operation {
+	public:
+		explicit LoadBinariesOperation(osg::Operation* previous) : osg::Operation("LoadProgramBinaries", false), _previous(previous) {}
+
+		void operator()(osg::Object* object) override {
+			if (_previous.valid()) {
+				(*_previous)(object);
+			}
+
+			const GLubyte* strings[3] = { glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION) };
+			std::string driver;
+			for (int i = 0; i < 3; ++i) {
+				driver += (strings[i] ? reinterpret_cast<const char*>(strings[i]) : "") + std::string("\n");
+			}
+
+			ProgramBinaryCache::Instance()->load(driver);
+		}
+
+	private:
+		//! Realize-operation which has been set before (nullptr => none)
+		osg::ref_ptr<osg::Operation> _previous;
+	};
+
+
+	/**
+	 * \brief Stores the binaries after the programs have been linked by the draw-traversal.
+	 */
+	class SaveBinariesCallback : public osg::Camera::DrawCallback {
+	public:
+		void operator()(osg::RenderInfo &renderInfo) const override {
+			ProgramBinaryCache::Instance()->save(*renderInfo.getState());
+		}
+	};
+}
+
+
+//! Pointer to the only instance of this class.
+ProgramBinaryCache* ProgramBinaryCache::_pInstance = nullptr;
+bool ProgramBinaryCache::IS_ENABLED = false;
+const unsigned int ProgramBinaryCache::BINARY_MAGIC = 0x50534250;
+const unsigned int ProgramBinaryCache::BINARY_VERSION = 1;
+
+
+/**
+ * \brief Singleton instance of the ProgramBinaryCache-class.
+ */
+ProgramBinaryCache* ProgramBinaryCache::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new ProgramBinaryCache();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Add a program to the cache (has to be done before the viewer is realized to load its binary).
+ *
+ * \param program
+ *      Program which is linked from the sources.
+ * \param sources
+ *      Sources of all shaders of the program (part of the key).
+ */
+void ProgramBinaryCache::add(osg::Program* program, const std::string &sources) {
+	Entry entry;
+	entry.program = program;
+	entry.sources = sources;
+	entry.isLoaded = false;
+	entry.isDone = false;
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_entries.push_back(entry);
+	++_cntPending;
+}
+
+
+/**
+ * \brief Let the viewer load the binaries when its context is realized and store the new ones when they
+ *        are linked (has to be called before the viewer is realized).
+ *
+ * \param viewer
+ *      Viewer which draws the programs.
+ */
+void ProgramBinaryCache::attach(osgViewer::Viewer* viewer) {
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 4, 0)
+	viewer->setRealizeOperation(new LoadBinariesOperation(viewer->getRealizeOperation()));
+	// the post-draw-callback is used for the screenshots
+	viewer->getCamera()->setFinalDrawCallback(new SaveBinariesCallback);
+#endif
+}
+
+
+/**
+ * \brief Load the binaries of the added programs (called by the realize-operation with the current context).
+ *
+ * \param driver
+ *      Vendor, renderer and version of the driver.
+ */
+void ProgramBinaryCache::load(const std::string &driver) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_driver = driver;
+
+	for (unsigned int i = 0; i < _entries.size(); ++i) {
+		Entry &entry = _entries[i];
+		std::ifstream stream(getCachePath(entry.sources), std::ios::binary);
+		unsigned int header[4];
+
+		if (!stream || !stream.read(reinterpret_cast<char*>(header), sizeof(header))
+			|| header[0] != BINARY_MAGIC || header[1] != BINARY_VERSION || header[3] == 0) {
+			continue;
+		}
+
+		osg::ref_ptr<osg::ProgramBinary> binary = new osg::ProgramBinary;
+		binary->allocate(header[3]);
+		binary->setFormat(header[2]);
+
+		if (stream.read(reinterpret_cast<char*>(binary->getData()), header[3])) {
+			entry.program->setProgramBinary(binary.get());
+			entry.isLoaded = true;
+		}
+	}
+}
+
+
+/**
+ * \brief Store the binaries of the programs which have been linked since the last call (called by the
+ *        final-draw-callback).
+ *
+ * \param state
+ *      State of the context in which the programs have been linked.
+ */
+void ProgramBinaryCache::save(osg::State &state) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	if (_cntPending == 0 || _driver == "") {
+		return;
+	}
+
+	osgDB::makeDirectory(CACHE_PATH + "/programs");
+
+	for (unsigned int i = 0; i < _entries.size(); ++i) {
+		Entry &entry = _entries[i];
+
+		if (entry.isDone) {
+			continue;
+		}
+
+#if OSG_VERSION_GREATER_OR_EQUAL(3, 4, 0)
+		osg::Program::PerContextProgram* pcp = entry.program->getPCP(state);
+
+		// not yet drawn => not yet linked
+		if (!pcp || pcp->needsLink()) {
+			continue;
+		}
+
+		if (entry.isLoaded) {
+			// the driver has rejected the binary (e.g. after an update) => compiled from the sources next time
+			if (!pcp->isLinked()) {
+				LOG_WARNING("The cached program-binary can't be linked, it is removed from the cache!");
+				std::remove(getCachePath(entry.sources).c_str());
+			}
+		} else if (pcp->isLinked()) {
+			osg::ref_ptr<osg::ProgramBinary> binary = pcp->compileProgramBinary(state);
+
+			// no binary without GL_ARB_get_program_binary, the file is written by a background-job (not by the draw)
+			if (binary.valid() && binary->getSize() > 0) {
+				std::string filePath = getCachePath(entry.sources);
+
+				JobSystem::Instance()->submit([binary, filePath]() {
+					std::ofstream stream(filePath, std::ios::binary | std::ios::trunc);
+					unsigned int header[4] = { BINARY_MAGIC, BINARY_VERSION, binary->getFormat(), binary->getSize() };
+
+					stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+					stream.write(reinterpret_cast<const char*>(binary->getData()), binary->getSize());
+				});
+			}
+		}
+#endif
+
+		entry.isDone = true;
+		--_cntPending;
+	}
+}
+
+
+/**
+ * \brief Get the path of the binary of a program in the cache-directory.
+ *
+ * \param sources
+ *      Sources of all shaders of the program.
+ *
+ * \return Complete path to the cached file (depends on the driver).
+ */
+std::string ProgramBinaryCache::getCachePath(const std::string &sources) const {
+	// 64-bit FNV-1a over the driver and the sources (same as the keys of the AssetCache)
+	uint64_t hash = 14695981039346656037ull;
+	std::string key = _driver + sources;
+
+	for (unsigned int i = 0; i < key.size(); ++i) {
+		hash ^= static_cast<unsigned char>(key[i]);
+		hash *= 1099511628211ull;
+	}
+
+	std::ostringstream path;
+	path << CACHE_PATH << "/programs/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".bin";
+
+	return path.str();
+}
@@ -0,0 +1,161 @@
+﻿/**
+ * \brief Functionality for storing the linked shader-programs on the disk (GL_ARB_get_program_binary).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <osg/Program>
+#include <osg/State>
+#include <osgViewer/Viewer>
+#include <OpenThreads/Mutex>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief ProgramBinaryCache stores the shader-programs of the MaterialCache after they have been linked by the
+	 * driver and loads them instead of their sources by the next start, so the shaders are not compiled again.
+	 *  - The realize-operation of the viewer loads the binaries which match the sources and the driver (vendor,
+	 *    renderer and version are part of the key), before anything is drawn.
+	 *  - The final-draw-callback of the camera writes the binaries of the programs which have been linked from
+	 *    their sources (once per program). A binary which can't be linked any more is removed, so the program is
+	 *    compiled from its sources by the next start.
+	 * Needs OSG 3.4 and a driver with GL_ARB_get_program_binary (otherwise nothing is stored).
+	 */
+	class ProgramBinaryCache {
+	public:
+
+		/**
+		 * \brief Singleton instance of the ProgramBinaryCache-class.
+		 */
+		static ProgramBinaryCache* Instance();
+
+
+		/**
+		 * \brief Add a program to the cache (has to be done before the viewer is realized to load its binary).
+		 *
+		 * \param program
+		 *      Program which is linked from the sources.
+		 * \param sources
+		 *      Sources of all shaders of the program (part of the key).
+		 */
+		void add(osg::Program* program, const std::string &sources);
+
+
+		/**
+		 * \brief Let the viewer load the binaries when its context is realized and store the new ones when they
+		 *        are linked (has to be called before the viewer is realized).
+		 *
+		 * \param viewer
+		 *      Viewer which draws the programs.
+		 */
+		void attach(osgViewer::Viewer* viewer);
+
+
+		/**
+		 * \brief Load the binaries of the added programs (called by the realize-operation with the current context).
+		 *
+		 * \param driver
+		 *      Vendor, renderer and version of the driver.
+		 */
+		void load(const std::string &driver);
+
+
+		/**
+		 * \brief Store the binaries of the programs which have been linked since the last call (called by the
+		 *        final-draw-callback).
+		 *
+		 * \param state
+		 *      State of the context in which the programs have been linked.
+		 */
+		void save(osg::State &state);
+
+
+		/**
+		 * \brief Enable or disable the cache (if disabled, the programs are always compiled from their sources).
+		 *        Has to be set before loading the scene.
+		 *
+		 * \param isEnabled
+		 *      True if the binaries are stored and loaded.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Check if the cache is enabled.
+		 *
+		 * \return True if the binaries are stored and loaded.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+
+		/**
+		 * \brief Program of the cache with the state of its binary.
+		 */
+		struct Entry {
+			//! Program which is linked from the sources or the binary
+			osg::ref_ptr<osg::Program> program;
+			//! Sources of all shaders of the program
+			std::string sources;
+			//! True if the binary has been loaded from the cache
+			bool isLoaded;
+			//! True if nothing has to be done any more for the program
+			bool isDone;
+		};
+
+		//! Magic and version of the binary-files ("PBSP")
+		static const unsigned int BINARY_MAGIC;
+		static const unsigned int BINARY_VERSION;
+
+		//! All added programs.
+		std::vector<Entry> _entries;
+
+		//! Vendor, renderer and version of the driver ("" => not yet realized, nothing is stored)
+		std::string _driver;
+
+		//! Number of programs which are not yet done (the callback returns immediately if there are none).
+		unsigned int _cntPending = 0;
+
+		//! Protects the entries (added by the loading thread, stored by the draw-thread).
+		OpenThreads::Mutex _mutex;
+
+		//! True if the binaries are stored and loaded.
+		static bool IS_ENABLED;
+
+
+		/**
+		 * \brief Get the path of the binary of a program in the cache-directory.
+		 *
+		 * \param sources
+		 *      Sources of all shaders of the program.
+		 *
+		 * \return Complete path to the cached file (depends on the driver).
+		 */
+		std::string getCachePath(const std::string &sources) const;
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		ProgramBinaryCache() {}
+
+		//! Private copy-constructor to prevent copying the class.
+		ProgramBinaryCache(ProgramBinaryCache const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		ProgramBinaryCache& operator=(ProgramBinaryCache const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static ProgramBinaryCache* _pInstance;
+	};
+}
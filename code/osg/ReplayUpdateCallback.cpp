@@ -0,0 +1,25 @@
+﻿/**
+ * \brief Update-callback which writes the recorded trajectories to the scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#include "ReplayUpdateCallback.h"
+
+#include <osg/FrameStamp>
+#include <osg/NodeVisitor>
+
+#include "../physics/TrajectoryPlayer.h"
+
+using namespace pbs17;
+
+void ReplayUpdateCallback::operator()(osg::Node* node, osg::NodeVisitor* nv) {
+	double time = nv->getFrameStamp() ? nv->getFrameStamp()->getSimulationTime() : 0.0;
+	double elapsed = _lastTime < 0.0 ? 0.0 : time - _lastTime;
+	_lastTime = time;
+
+	TrajectoryPlayer::Instance()->update(elapsed);
+
+	traverse(node, nv);
+}
@@ -0,0 +1,32 @@
+﻿/**
+* \brief Update-callback which writes the recorded trajectories to the scene.
+*
+* \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+* \Date:   2017-12-23
+*/
+
+#pragma once
+
+#include <osg/NodeCallback>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief This callback advances the playback of the TrajectoryPlayer during the update-traversal. The time is taken
+	 *        from the frame-stamp, so a video renders the replay with its own clock.
+	 */
+	class ReplayUpdateCallback : public osg::NodeCallback {
+	public:
+
+		ReplayUpdateCallback()
+			: _lastTime(-1.0) {}
+
+		void operator () (osg::Node* node, osg::NodeVisitor* nv) override;
+
+	protected:
+
+		//! Simulation-time of the last update (-1 => first update)
+		double _lastTime;
+	};
+}
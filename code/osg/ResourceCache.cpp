@@ -0,0 +1,117 @@
+﻿/**
+ * \brief Functionality for keeping the loaded resources (models, textures and images) within a memory-budget.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "ResourceCache.h"
+
+#include "../physics/Profiler.h"
+
+using namespace pbs17;
+
+
+//! The resources are kept until the end by default.
+size_t ResourceCache::BUDGET = 0;
+
+
+/**
+ * \brief Find a resource and mark it as the most recently used one.
+ *
+ * \param key
+ *      Path of the resource.
+ *
+ * \return Resource (nullptr => not stored).
+ */
+osg::Referenced* ResourceCache::find(const std::string &key) {
+	std::unordered_map<std::string, Entry>::iterator found = _entries.find(key);
+
+	if (found == _entries.end()) {
+		Profiler::Instance()->count(Profiler::RESOURCE_MISSES, 1.0);
+		return nullptr;
+	}
+
+	Profiler::Instance()->count(Profiler::RESOURCE_HITS, 1.0);
+	_used.splice(_used.begin(), _used, found->second.used);
+
+	return found->second.resource.get();
+}
+
+
+/**
+ * \brief Store a resource (if another thread has stored the same resource meanwhile, its resource is kept)
+ *        and evict the unused resources beyond the budget.
+ *
+ * \param key
+ *      Path of the resource.
+ * \param resource
+ *      Loaded resource.
+ * \param size
+ *      Estimated memory of the resource in bytes.
+ * \param evicted
+ *      Appended with the evicted resources (nullptr => not needed).
+ *
+ * \return Stored resource of the key (nullptr => the resource is nullptr, it's not stored).
+ */
+osg::Referenced* ResourceCache::insert(const std::string &key, osg::Referenced* resource, size_t size, std::vector<osg::ref_ptr<osg::Referenced> >* evicted) {
+	std::unordered_map<std::string, Entry>::iterator found = _entries.find(key);
+
+	if (found != _entries.end()) {
+		return found->second.resource.get();
+	}
+
+	// a resource which couldn't be loaded is not stored
+	if (!resource) {
+		return nullptr;
+	}
+
+	// the new resource is the most recently used one => it's only evicted after the older ones
+	_used.push_front(key);
+
+	Entry &entry = _entries[key];
+	entry.resource = resource;
+	entry.size = size;
+	entry.used = _used.begin();
+	_size += size;
+	MemoryTracker::add(_category, static_cast<long long>(size));
+
+	// the caller holds no reference yet => the new resource itself is skipped while evicting
+	osg::ref_ptr<osg::Referenced> stored = resource;
+	evict(evicted);
+
+	return stored.get();
+}
+
+
+/**
+ * \brief Evict the least recently used resources which are only referenced by the cache until the budget is met.
+ *
+ * \param evicted
+ *      Appended with the evicted resources (nullptr => not needed).
+ */
+void ResourceCache::evict(std::vector<osg::ref_ptr<osg::Referenced> >* evicted) {
+	if (BUDGET == 0) {
+		return;
+	}
+
+	std::list<std::string>::iterator it = _used.end();
+	while (_size > BUDGET && it != _used.begin()) {
+		--it;
+		std::unordered_map<std::string, Entry>::iterator entry = _entries.find(*it);
+
+		if (entry->second.resource->referenceCount() > 1) {
+			continue;
+		}
+
+		if (evicted) {
+			evicted->push_back(entry->second.resource);
+		}
+		_size -= entry->second.size;
+		MemoryTracker::add(_category, -static_cast<long long>(entry->second.size));
+		_entries.erase(entry);
+		it = _used.erase(it);
+
+		Profiler::Instance()->count(Profiler::RESOURCE_EVICTIONS, 1.0);
+	}
+}
@@ -0,0 +1,129 @@
+﻿/**
+ * \brief Functionality for keeping the loaded resources (models, textures and images) within a memory-budget.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <osg/ref_ptr>
+#include <osg/Referenced>
+
+#include "../physics/MemoryTracker.h"
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief ResourceCache stores the shared resources of a manager by their path and evicts the least recently used
+	 * ones once their estimated size exceeds the budget. Resources which are still referenced outside of the cache
+	 * (e.g. by the nodes of the scene) are never evicted, evicting them would not free their memory and a later request
+	 * would load them a second time. The hits, misses and evictions are counted by the Profiler, the stored memory by
+	 * the MemoryTracker.
+	 * The cache is not synchronized, the managers use it while holding their mutex.
+	 */
+	class ResourceCache {
+	public:
+
+		/**
+		 * \brief Constructor of an empty cache.
+		 *
+		 * \param category
+		 *      Category of the stored memory (see MemoryTracker).
+		 */
+		explicit ResourceCache(MemoryTracker::Category category) : _category(category) {}
+
+
+		/**
+		 * \brief Find a resource and mark it as the most recently used one.
+		 *
+		 * \param key
+		 *      Path of the resource.
+		 *
+		 * \return Resource (nullptr => not stored).
+		 */
+		osg::Referenced* find(const std::string &key);
+
+
+		/**
+		 * \brief Store a resource (if another thread has stored the same resource meanwhile, its resource is kept)
+		 *        and evict the unused resources beyond the budget.
+		 *
+		 * \param key
+		 *      Path of the resource.
+		 * \param resource
+		 *      Loaded resource.
+		 * \param size
+		 *      Estimated memory of the resource in bytes.
+		 * \param evicted
+		 *      Appended with the evicted resources (nullptr => not needed).
+		 *
+		 * \return Stored resource of the key (nullptr => the resource is nullptr, it's not stored).
+		 */
+		osg::Referenced* insert(const std::string &key, osg::Referenced* resource, size_t size, std::vector<osg::ref_ptr<osg::Referenced> >* evicted = nullptr);
+
+
+		/**
+		 * \brief Get the estimated memory of all stored resources.
+		 *
+		 * \return Memory in bytes.
+		 */
+		size_t getSize() const {
+			return _size;
+		}
+
+
+		/**
+		 * \brief Set the memory-budget of each cache (has to be set before loading the scene).
+		 *
+		 * \param budget
+		 *      Budget in bytes (0 => unlimited).
+		 */
+		static void setBudget(size_t budget) {
+			BUDGET = budget;
+		}
+
+
+	private:
+
+		/**
+		 * \brief Stored resource with its position in the LRU-list.
+		 */
+		struct Entry {
+			osg::ref_ptr<osg::Referenced> resource;
+			size_t size;
+			std::list<std::string>::iterator used;
+		};
+
+		//! Resources by their path
+		std::unordered_map<std::string, Entry> _entries;
+
+		//! Paths of the resources, the most recently used first
+		std::list<std::string> _used;
+
+		//! Estimated memory of all resources in bytes
+		size_t _size = 0;
+
+		//! Category of the stored memory
+		MemoryTracker::Category _category;
+
+		//! Memory-budget of each cache in bytes (0 => unlimited)
+		static size_t BUDGET;
+
+
+		/**
+		 * \brief Evict the least recently used resources which are only referenced by the cache until the budget is met.
+		 *
+		 * \param evicted
+		 *      Appended with the evicted resources (nullptr => not needed).
+		 */
+		void evict(std::vector<osg::ref_ptr<osg::Referenced> >* evicted);
+	};
+}
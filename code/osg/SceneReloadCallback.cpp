@@ -0,0 +1,282 @@
+﻿/**
+ * \brief Update-callback which applies the changes of the watched json-scene to the running simulation.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "SceneReloadCallback.h"
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sys/stat.h>
+
+#include "JsonEigenConversions.h"
+#include "IncrementalCompiler.h"
+#include "../physics/SimulationManager.h"
+#include "../scene/SceneManager.h"
+#include "../scene/SpaceObject.h"
+#include "../physics/Logger.h"
+
+using namespace pbs17;
+
+//! Seconds between two checks of the file
+const double SceneReloadCallback::CHECK_INTERVAL = 0.25;
+
+
+/**
+ * \brief Check if an object of a json-scene is constructed by the scene-manager.
+ *
+ * \param d
+ *      JSON-configuration of the object.
+ *
+ * \return True for the planets, asteroids and suns.
+ */
+static bool isSupported(const json &d) {
+	return d.is_object() && d.count("type") && (d["type"] == "planet" || d["type"] == "asteroid" || d["type"] == "sun");
+}
+
+
+/**
+ * \brief Get the configuration of an object without its state (which can be modified in place).
+ *
+ * \param d
+ *      JSON-configuration of the object.
+ *
+ * \return Configuration without the id, the mass and the motion.
+ */
+static json withoutState(json d) {
+	const char* keys[] = { "id", "mass", "position", "linearVelocity", "angularVelocity", "force", "torque" };
+	for (int k = 0; k < 7; ++k) {
+		d.erase(keys[k]);
+	}
+
+	return d;
+}
+
+
+/**
+ * \brief Constructor of the callback: the objects of the loaded scene are the first version.
+ *
+ * \param filePath
+ *      Loaded json-file of the scene.
+ * \param sceneManager
+ *      Scene-manager which loaded the file (the new objects are constructed by it).
+ * \param simulationManager
+ *      Simulation of the scene.
+ */
+SceneReloadCallback::SceneReloadCallback(std::string filePath, SceneManager* sceneManager, SimulationManager* simulationManager)
+	: _filePath(filePath), _sceneManager(sceneManager), _simulationManager(simulationManager), _root(new osg::Group) {
+	_lastCheck = osg::Timer::instance()->tick();
+	isModified();
+
+	json j;
+	try {
+		std::ifstream stream(_filePath);
+		stream >> j;
+	} catch (const std::exception &e) {
+		LOG_WARNING("Scene " + _filePath + " can't be watched: " << e.what());
+		return;
+	}
+
+	if (!j["objects"].is_array()) return;
+
+	// the objects follow the player in the order of the file
+	std::vector<SpaceObject*> spaceObjects = _sceneManager->getSpaceObjects();
+	unsigned int cntObjects = 0;
+	for (unsigned int i = 0; i < j["objects"].size(); ++i) {
+		cntObjects += isSupported(j["objects"][i]) ? 1 : 0;
+	}
+
+	if (cntObjects > spaceObjects.size()) return;
+
+	unsigned int next = spaceObjects.size() - cntObjects;
+	for (unsigned int i = 0; i < j["objects"].size(); ++i) {
+		json &d = j["objects"][i];
+		if (!isSupported(d)) continue;
+
+		Entry entry;
+		entry.config = d;
+		entry.object = spaceObjects[next++];
+		_objects[getKey(d, i)] = entry;
+	}
+}
+
+
+void SceneReloadCallback::operator()(osg::Node* node, osg::NodeVisitor* nv) {
+	const osg::Timer* timer = osg::Timer::instance();
+
+	if (timer->delta_s(_lastCheck, timer->tick()) >= CHECK_INTERVAL) {
+		_lastCheck = timer->tick();
+
+		if (isModified()) {
+			reload();
+		}
+	}
+
+	traverse(node, nv);
+}
+
+
+/**
+ * \brief Get the key of an object of the scene.
+ *
+ * \param d
+ *      JSON-configuration of the object.
+ * \param index
+ *      Index of the object in the file.
+ *
+ * \return Its "id", or its index if it has none.
+ */
+std::string SceneReloadCallback::getKey(const json &d, unsigned int index) {
+	return d.count("id") ? "id:" + d["id"].dump() : "index:" + std::to_string(index);
+}
+
+
+/**
+ * \brief Check if the file has been saved since the last check.
+ *
+ * \return True if the modification-time or the size changed.
+ */
+bool SceneReloadCallback::isModified() {
+	struct stat status;
+	if (stat(_filePath.c_str(), &status) != 0) {
+		return false;
+	}
+
+	bool isChanged = status.st_mtime != _modified || static_cast<long long>(status.st_size) != _size;
+	_modified = status.st_mtime;
+	_size = static_cast<long long>(status.st_size);
+
+	return isChanged;
+}
+
+
+/**
+ * \brief Parse the file and apply its differences to the simulation.
+ */
+void SceneReloadCallback::reload() {
+	json j;
+	try {
+		std::ifstream stream(_filePath);
+		stream >> j;
+	} catch (const std::exception &e) {
+		// e.g. the file is saved while it's edited, the next save is tried again
+		LOG_WARNING("Scene " + _filePath + " can't be reloaded: " << e.what());
+		return;
+	}
+
+	if (!j["objects"].is_array()) return;
+
+	const osg::Timer_t start = osg::Timer::instance()->tick();
+	unsigned int cntAdded = 0, cntRemoved = 0, cntModified = 0;
+	std::set<std::string> found;
+
+	for (unsigned int i = 0; i < j["objects"].size(); ++i) {
+		json &d = j["objects"][i];
+		if (!isSupported(d)) continue;
+
+		std::string key = getKey(d, i);
+		found.insert(key);
+
+		std::map<std::string, Entry>::iterator it = _objects.find(key);
+		if (it == _objects.end()) {
+			Entry entry;
+			entry.config = d;
+			entry.object = add(d);
+			if (entry.object) {
+				_objects[key] = entry;
+				++cntAdded;
+			}
+			continue;
+		}
+
+		if (it->second.config == d) continue;
+
+		// only the state changed: the object keeps its nodes and its index in the simulation
+		if (withoutState(it->second.config) == withoutState(d)) {
+			SimulationManager::SceneChange change;
+			change.type = SimulationManager::SceneChange::MODIFY;
+			change.object = it->second.object;
+			change.position = fromJson(d["position"]);
+			change.linearVelocity = fromJson(d["linearVelocity"]);
+			change.angularVelocity = fromJson(d["angularVelocity"]);
+			change.mass = d["mass"].get<double>();
+			_simulationManager->queueSceneChange(change);
+
+			it->second.config = d;
+			++cntModified;
+			continue;
+		}
+
+		SpaceObject* object = add(d);
+		if (object == nullptr) continue;
+
+		remove(it->second.object);
+		it->second.config = d;
+		it->second.object = object;
+		++cntModified;
+	}
+
+	for (std::map<std::string, Entry>::iterator it = _objects.begin(); it != _objects.end();) {
+		if (found.count(it->first) > 0) {
+			++it;
+			continue;
+		}
+
+		remove(it->second.object);
+		it = _objects.erase(it);
+		++cntRemoved;
+	}
+
+	LOG_INFO("Reloaded " << _filePath << " in " << osg::Timer::instance()->delta_m(start, osg::Timer::instance()->tick()) << " ms: "
+		<< cntAdded << " added, " << cntRemoved << " removed, " << cntModified << " modified");
+}
+
+
+/**
+ * \brief Construct an object of the new version and queue it for the simulation.
+ *
+ * \param d
+ *      JSON-configuration of the object.
+ *
+ * \return New object (nullptr => the type is not supported).
+ */
+SpaceObject* SceneReloadCallback::add(json &d) {
+	// the configuration of the file is kept unchanged for the comparison with the next version
+	json config = d;
+	SpaceObject* object = _sceneManager->createSpaceObject(config);
+	if (object == nullptr) return nullptr;
+
+	// the new model is drawn once its GL-objects are compiled
+	IncrementalCompiler::Instance()->add(_root.get(), object->getModel());
+
+	SimulationManager::SceneChange change;
+	change.type = SimulationManager::SceneChange::ADD;
+	change.object = object;
+	_simulationManager->queueSceneChange(change);
+
+	return object;
+}
+
+
+/**
+ * \brief Queue the removal of an object and detach its model.
+ *
+ * \param object
+ *      Removed object.
+ */
+void SceneReloadCallback::remove(SpaceObject* object) {
+	SimulationManager::SceneChange change;
+	change.type = SimulationManager::SceneChange::REMOVE;
+	change.object = object;
+	_simulationManager->queueSceneChange(change);
+
+	// the callback runs before the children of the scene are traversed
+	osg::ref_ptr<osg::Node> model = object->getModel();
+	osg::Node::ParentList parents = model->getParents();
+	for (unsigned int i = 0; i < parents.size(); ++i) {
+		parents[i]->removeChild(model);
+	}
+}
@@ -0,0 +1,144 @@
+﻿/**
+ * \brief Update-callback which applies the changes of the watched json-scene to the running simulation.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <osg/NodeCallback>
+#include <osg/Group>
+#include <osg/Timer>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+
+namespace pbs17 {
+	class SceneManager;
+	class SimulationManager;
+	class SpaceObject;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief This callback watches the json-file of the scene. When it's saved, the objects are compared with the
+	 *        last version of the file (by their "id", or by their index without one) and only the differences are
+	 *        applied through the changes of the simulation (see SimulationManager::queueSceneChange()):
+	 *
+	 *  - New objects are constructed (the models and textures come from the caches of the managers) and spawned.
+	 *  - Removed objects are despawned and their models are detached.
+	 *  - Objects whose state or mass changed are modified in place.
+	 *  - Objects whose model, texture or any other setting changed are replaced.
+	 *
+	 * The settings of the scene (e.g. the simulation) and the player are not reloaded.
+	 */
+	class SceneReloadCallback : public osg::NodeCallback {
+	public:
+		/**
+		 * \brief Constructor of the callback: the objects of the loaded scene are the first version.
+		 *
+		 * \param filePath
+		 *      Loaded json-file of the scene.
+		 * \param sceneManager
+		 *      Scene-manager which loaded the file (the new objects are constructed by it).
+		 * \param simulationManager
+		 *      Simulation of the scene.
+		 */
+		SceneReloadCallback(std::string filePath, SceneManager* sceneManager, SimulationManager* simulationManager);
+
+
+		void operator () (osg::Node* node, osg::NodeVisitor* nv) override;
+
+
+		/**
+		 * \brief Get the root of the added objects (has to be added once to the scene).
+		 *
+		 * \return Root-node of the added objects.
+		 */
+		osg::ref_ptr<osg::Group> getRoot() const {
+			return _root;
+		}
+
+	protected:
+		/**
+		 * \brief Object of the last version of the file with its configuration.
+		 */
+		struct Entry {
+			json config;
+			SpaceObject* object;
+		};
+
+
+		//! Watched json-file
+		std::string _filePath;
+		SceneManager* _sceneManager;
+		SimulationManager* _simulationManager;
+		//! Objects of the last version (by their key, see getKey())
+		std::map<std::string, Entry> _objects;
+		//! Parent of the added objects
+		osg::ref_ptr<osg::Group> _root;
+
+		//! Modification-time and size of the last version
+		time_t _modified = 0;
+		long long _size = -1;
+		//! Time of the last check of the file
+		osg::Timer_t _lastCheck;
+
+		//! Seconds between two checks of the file
+		static const double CHECK_INTERVAL;
+
+
+		/**
+		 * \brief Get the key of an object of the scene.
+		 *
+		 * \param d
+		 *      JSON-configuration of the object.
+		 * \param index
+		 *      Index of the object in the file.
+		 *
+		 * \return Its "id", or its index if it has none.
+		 */
+		static std::string getKey(const json &d, unsigned int index);
+
+
+		/**
+		 * \brief Check if the file has been saved since the last check.
+		 *
+		 * \return True if the modification-time or the size changed.
+		 */
+		bool isModified();
+
+
+		/**
+		 * \brief Parse the file and apply its differences to the simulation.
+		 */
+		void reload();
+
+
+		/**
+		 * \brief Construct an object of the new version and queue it for the simulation.
+		 *
+		 * \param d
+		 *      JSON-configuration of the object.
+		 *
+		 * \return New object (nullptr => the type is not supported).
+		 */
+		SpaceObject* add(json &d);
+
+
+		/**
+		 * \brief Queue the removal of an object and detach its model.
+		 *
+		 * \param object
+		 *      Removed object.
+		 */
+		void remove(SpaceObject* object);
+	};
+}
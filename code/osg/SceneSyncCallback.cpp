@@ -0,0 +1,18 @@
+﻿/**
+ * \brief Update-callback which writes the simulated state to the scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "SceneSyncCallback.h"
+
+#include "../physics/SimulationManager.h"
+
+using namespace pbs17;
+
+void SceneSyncCallback::operator()(osg::Node* node, osg::NodeVisitor* nv) {
+	_simulationManager->syncScene();
+
+	traverse(node, nv);
+}
@@ -0,0 +1,37 @@
+﻿/**
+ * \brief Update-callback which writes the simulated state to the scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <osg/NodeCallback>
+
+
+namespace pbs17 {
+	class SimulationManager;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief This callback writes the objects which have been changed by the last step of the simulation into the
+	 *        matrix-transformations during the update-traversal. So the scene-graph is only changed by the
+	 *        update-traversal and the cull- and draw-traversal of the viewer can run on their own threads.
+	 */
+	class SceneSyncCallback : public osg::NodeCallback {
+	public:
+
+		SceneSyncCallback(SimulationManager* simulationManager)
+			: _simulationManager(simulationManager) {}
+
+		void operator () (osg::Node* node, osg::NodeVisitor* nv) override;
+
+	protected:
+
+		SimulationManager* _simulationManager;
+	};
+}
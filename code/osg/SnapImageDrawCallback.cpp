@@ -7,30 +7,79 @@
 
 #include "SnapImageDrawCallback.h"
 
-#include <osgDB/WriteFile>
-#include <osg/Camera>
+#include <string.h>
+#include <osg/BufferObject>
+#include <osg/GLExtensions>
+#include <osg/Image>
+#include <osg/State>
+
+#include "FrameWriterThread.h"
 #include "../config.h"
 
 using namespace pbs17;
 
-void SnapImageDrawCallback::operator()(const osg::Camera& camera) const {
-	//osg::notify(osg::NOTICE) << "Saved screen image to `"<<_filename << "`" << std::endl;
-	if (!_snapImageOnNextFrame) {
+void SnapImageDrawCallback::operator()(osg::RenderInfo& renderInfo) const {
+	Readback &previous = _readbacks[1 - _next];
+
+	// the request is taken over at once, so the next one can be set while this frame is read back
+	bool snapImage;
+	std::string filename;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		snapImage = _snapImageOnNextFrame;
+		filename = _filename;
+		_snapImageOnNextFrame = false;
+	}
+
+	if (!snapImage && previous.filename == "") {
 		return;
 	}
 
-	int x = camera.getViewport()->x();
-	int y = camera.getViewport()->y();
-	int width = camera.getViewport()->width();
-	int height = camera.getViewport()->height();
+	const osg::Camera* camera = renderInfo.getCurrentCamera();
+	osg::GLExtensions* extensions = renderInfo.getState()->get<osg::GLExtensions>();
+
+	if (_pixelBuffers[0] == 0) {
+		extensions->glGenBuffers(2, _pixelBuffers);
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+	// start the transfer of this frame, it's mapped at the next frame (the pixels are not waited for now)
+	if (snapImage) {
+		Readback &readback = _readbacks[_next];
+		readback.filename = SCREENSHOT_PATH + "/" + filename;
+		readback.width = camera->getViewport()->width();
+		readback.height = camera->getViewport()->height();
+
+		extensions->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, _pixelBuffers[_next]);
+		if (readback.size != 3 * readback.width * readback.height) {
+			readback.size = 3 * readback.width * readback.height;
+			extensions->glBufferData(GL_PIXEL_PACK_BUFFER_ARB, readback.size, nullptr, GL_STREAM_READ_ARB);
+		}
+
+		glReadPixels(camera->getViewport()->x(), camera->getViewport()->y(), readback.width, readback.height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+	}
+
+	// the transfer of the previous frame has finished meanwhile => copy and pass it to the writer
+	if (previous.filename != "") {
+		extensions->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, _pixelBuffers[1 - _next]);
+		const unsigned char* pixels = static_cast<const unsigned char*>(extensions->glMapBuffer(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB));
+
+		if (pixels) {
+			osg::ref_ptr<osg::Image> image = new osg::Image;
+			image->allocateImage(previous.width, previous.height, 1, GL_RGB, GL_UNSIGNED_BYTE, 1);
+			memcpy(image->data(), pixels, 3 * previous.width * previous.height);
+			extensions->glUnmapBuffer(GL_PIXEL_PACK_BUFFER_ARB);
 
-	osg::ref_ptr<osg::Image> image = new osg::Image;
-	image->readPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE);
-	std::string filename = SCREENSHOT_PATH + "/" + _filename;
+			if (_frameWriter) {
+				_frameWriter->push(image, previous.filename);
+			}
+		}
 
-	if (osgDB::writeImageFile(*image, filename)) {
-		std::cout << "Saved screen image to `" << filename << "`" << std::endl;
+		previous.filename = "";
 	}
 
-	_snapImageOnNextFrame = false;
+	extensions->glBindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	_next = 1 - _next;
 }
@@ -7,42 +7,82 @@
 
 #pragma once
 
-#include <osgDB/WriteFile>
+#include <string>
 #include <osg/Camera>
+#include <osg/GL>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
 
 
+// Forward declarations
+namespace pbs17 {
+	class FrameWriterThread;
+}
+
 namespace pbs17 {
 
 	/**
 	 * \brief This callback saves each frame to a given location.
+	 * The pixels are read asynchronously into one of two pixel-buffer-objects and mapped one frame later (when the
+	 * transfer has finished), the frames are encoded and written by the FrameWriterThread.
+	 * The next snapshot can be requested by the main-thread while the draw-thread is running the callback.
 	 */
 	class SnapImageDrawCallback : public osg::Camera::DrawCallback {
 	public:
 
-		SnapImageDrawCallback()
-			: _snapImageOnNextFrame(false) {}
+		SnapImageDrawCallback(FrameWriterThread* frameWriter)
+			: _snapImageOnNextFrame(false), _frameWriter(frameWriter) {}
 
 		void setFileName(const std::string& filename) {
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 			_filename = filename;
 		}
 
-		const std::string& getFileName() const {
+		std::string getFileName() const {
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 			return _filename;
 		}
 
 		void setSnapImageOnNextFrame(bool flag) {
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 			_snapImageOnNextFrame = flag;
 		}
 
 		bool getSnapImageOnNextFrame() const {
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
 			return _snapImageOnNextFrame;
 		}
 
-		void operator () (const osg::Camera& camera) const override;
+		void operator () (osg::RenderInfo& renderInfo) const override;
 
 	protected:
 
+		/**
+		 * \brief Readback which has been started in a previous frame.
+		 */
+		struct Readback {
+			//! Complete path of the image-file ("" => no readback)
+			std::string filename;
+			//! Size of the frame
+			int width = 0, height = 0;
+			//! Allocated size of the pixel-buffer-object
+			int size = 0;
+		};
+
 		std::string _filename;
 		mutable bool _snapImageOnNextFrame;
+
+		//! Protects the filename and the flag (set by the main-thread, read by the draw-thread)
+		mutable OpenThreads::Mutex _mutex;
+
+		//! Writer of the captured frames (nullptr => the frames are not captured)
+		FrameWriterThread* _frameWriter;
+
+		//! Pixel-buffer-objects of the readbacks (0 => not created yet)
+		mutable GLuint _pixelBuffers[2] = { 0, 0 };
+		//! Readback of each pixel-buffer-object
+		mutable Readback _readbacks[2];
+		//! Pixel-buffer-object of the next readback
+		mutable unsigned int _next = 0;
 	};
 }
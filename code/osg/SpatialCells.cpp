@@ -0,0 +1,199 @@
+﻿/**
+ * \brief Functionality for grouping the space-objects by their position, so the clusters are culled at once.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "SpatialCells.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace pbs17;
+
+
+namespace {
+
+	//! Offset of the coordinates of the cells (21 bits per axis => [-2^20, 2^20))
+	const int64_t KEY_OFFSET = 1 << 20;
+	const uint64_t KEY_MASK = (1u << 21) - 1;
+
+
+	/**
+	 * \brief Pack the coordinates of a cell or a block into one key.
+	 */
+	uint64_t packKey(int64_t x, int64_t y, int64_t z) {
+		return (static_cast<uint64_t>(x + KEY_OFFSET) & KEY_MASK)
+			| ((static_cast<uint64_t>(y + KEY_OFFSET) & KEY_MASK) << 21)
+			| ((static_cast<uint64_t>(z + KEY_OFFSET) & KEY_MASK) << 42);
+	}
+
+
+	/**
+	 * \brief Get one coordinate of a key.
+	 */
+	int64_t unpackKey(uint64_t key, int axis) {
+		return static_cast<int64_t>((key >> (21 * axis)) & KEY_MASK) - KEY_OFFSET;
+	}
+
+
+	/**
+	 * \brief Division which rounds towards negative infinity (the blocks of the negative cells).
+	 */
+	int64_t floorDiv(int64_t value, int64_t divisor) {
+		return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+	}
+}
+
+
+//! Pointer to the only instance of this class.
+SpatialCells* SpatialCells::_pInstance = nullptr;
+bool SpatialCells::IS_ENABLED = true;
+const unsigned int SpatialCells::CELL_OBJECTS = 64;
+
+
+/**
+ * \brief Singleton instance of the SpatialCells-class.
+ */
+SpatialCells* SpatialCells::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new SpatialCells();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Constructor of the cells (without any cell).
+ */
+SpatialCells::SpatialCells() : _root(new osg::Group) {}
+
+
+/**
+ * \brief Choose the cell-size for the region of the objects (has to be called before adding them).
+ *
+ * \param region
+ *      Region which contains the initial positions of the objects.
+ * \param cntObjects
+ *      Number of objects which are added.
+ */
+void SpatialCells::init(const osg::BoundingBox &region, unsigned int cntObjects) {
+	if (!region.valid() || cntObjects == 0) {
+		return;
+	}
+
+	// flat regions (e.g. a ring or a disk) are at least one cell thick
+	float extent = std::max(std::max(region.xMax() - region.xMin(), region.yMax() - region.yMin()), region.zMax() - region.zMin());
+	if (extent <= 0.0f) {
+		return;
+	}
+
+	float minExtent = extent / std::cbrt(static_cast<float>(std::max(cntObjects / CELL_OBJECTS, 1u)));
+	float volume = std::max(region.xMax() - region.xMin(), minExtent) * std::max(region.yMax() - region.yMin(), minExtent)
+		* std::max(region.zMax() - region.zMin(), minExtent);
+
+	_cellSize = std::cbrt(volume * CELL_OBJECTS / cntObjects);
+}
+
+
+/**
+ * \brief Add the model of an object to its cell (the model is removed from its current parents).
+ *
+ * \param model
+ *      Root-node of the object.
+ * \param position
+ *      Position of the object.
+ *
+ * \return Index of the object.
+ */
+int SpatialCells::add(osg::Node* model, const osg::Vec3 &position) {
+	Entry entry;
+	entry.model = model;
+	entry.cell = getKey(position);
+
+	// the parents are copied, because they are changed while the node is removed
+	osg::Node::ParentList parents = model->getParents();
+	for (unsigned int i = 0; i < parents.size(); ++i) {
+		parents[i]->removeChild(model);
+	}
+
+	getCell(entry.cell)->addChild(model);
+	_entries.push_back(entry);
+
+	return static_cast<int>(_entries.size()) - 1;
+}
+
+
+/**
+ * \brief Move an object to the cell of its position (nothing is done while it stays in its cell).
+ *
+ * \param index
+ *      Index of the object.
+ * \param position
+ *      Position of the object.
+ */
+void SpatialCells::setPosition(int index, const osg::Vec3 &position) {
+	Entry &entry = _entries[index];
+	uint64_t key = getKey(position);
+
+	if (key == entry.cell) {
+		return;
+	}
+
+	// the empty cells are kept (their bound is invalid, they are skipped by the cull-traversal)
+	_cells[entry.cell]->removeChild(entry.model.get());
+	getCell(key)->addChild(entry.model.get());
+	entry.cell = key;
+}
+
+
+/**
+ * \brief Get the key of the cell which contains a position.
+ *
+ * \param position
+ *      Position in the world.
+ *
+ * \return Key of the cell (21 bits per axis).
+ */
+uint64_t SpatialCells::getKey(const osg::Vec3 &position) const {
+	// objects which escape far from the region share the outermost cells
+	int64_t coordinates[3];
+	for (int axis = 0; axis < 3; ++axis) {
+		double cell = std::floor(position[axis] / _cellSize);
+		coordinates[axis] = static_cast<int64_t>(std::min(std::max(cell, static_cast<double>(-KEY_OFFSET)), static_cast<double>(KEY_OFFSET - 1)));
+	}
+
+	return packKey(coordinates[0], coordinates[1], coordinates[2]);
+}
+
+
+/**
+ * \brief Get the group of a cell (the cell and its block are created if they are not used yet).
+ *
+ * \param key
+ *      Key of the cell.
+ *
+ * \return Group of the cell.
+ */
+osg::Group* SpatialCells::getCell(uint64_t key) {
+	osg::ref_ptr<osg::Group> &cell = _cells[key];
+
+	if (!cell.valid()) {
+		uint64_t blockKey = packKey(floorDiv(unpackKey(key, 0), BLOCK_CELLS), floorDiv(unpackKey(key, 1), BLOCK_CELLS),
+			floorDiv(unpackKey(key, 2), BLOCK_CELLS));
+		osg::ref_ptr<osg::Group> &block = _blocks[blockKey];
+
+		if (!block.valid()) {
+			block = new osg::Group;
+			_root->addChild(block);
+		}
+
+		cell = new osg::Group;
+		block->addChild(cell);
+	}
+
+	return cell.get();
+}
@@ -0,0 +1,173 @@
+﻿/**
+ * \brief Functionality for grouping the space-objects by their position, so the clusters are culled at once.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+#include <osg/BoundingBox>
+#include <osg/Group>
+#include <osg/Vec3>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief SpatialCells groups the models of the space-objects into the cells of a uniform grid, and the cells into
+	 * blocks of 4x4x4 cells (a flat two-level hierarchy below the root). The cull-traversal tests the bound of a block
+	 * or a cell before its children, so a whole cluster outside the frustum costs one test instead of one per object.
+	 * The cell-size is chosen from the initial region, so a cell contains about CELL_OBJECTS objects on average.
+	 * The objects are moved to their new cell by the sync-pass as soon as they leave their cell (the cells are
+	 * created when they are first used) and only the changed cells are dirtied by OSG.
+	 */
+	class SpatialCells {
+	public:
+
+		/**
+		 * \brief Singleton instance of the SpatialCells-class.
+		 */
+		static SpatialCells* Instance();
+
+
+		/**
+		 * \brief Choose the cell-size for the region of the objects (has to be called before adding them).
+		 *
+		 * \param region
+		 *      Region which contains the initial positions of the objects.
+		 * \param cntObjects
+		 *      Number of objects which are added.
+		 */
+		void init(const osg::BoundingBox &region, unsigned int cntObjects);
+
+
+		/**
+		 * \brief Add the model of an object to its cell (the model is removed from its current parents).
+		 *
+		 * \param model
+		 *      Root-node of the object.
+		 * \param position
+		 *      Position of the object.
+		 *
+		 * \return Index of the object.
+		 */
+		int add(osg::Node* model, const osg::Vec3 &position);
+
+
+		/**
+		 * \brief Move an object to the cell of its position (nothing is done while it stays in its cell).
+		 *
+		 * \param index
+		 *      Index of the object.
+		 * \param position
+		 *      Position of the object.
+		 */
+		void setPosition(int index, const osg::Vec3 &position);
+
+
+		/**
+		 * \brief Get the node which contains the blocks (has to be added once to the scene).
+		 *
+		 * \return Root of the cells.
+		 */
+		osg::ref_ptr<osg::Group> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Enable or disable the cells (if disabled, the models are children of one group). Has to be set
+		 *        before loading the scene.
+		 *
+		 * \param isEnabled
+		 *      True if the models are grouped by their position.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Check if the cells are enabled.
+		 *
+		 * \return True if the models are grouped by their position.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+
+		/**
+		 * \brief Object of the cells.
+		 */
+		struct Entry {
+			//! Root-node of the object
+			osg::ref_ptr<osg::Node> model;
+			//! Key of the cell which contains the model
+			uint64_t cell;
+		};
+
+		//! Average number of objects per cell
+		static const unsigned int CELL_OBJECTS;
+		//! Cells per block along each axis
+		static const int BLOCK_CELLS = 4;
+
+		//! All added objects.
+		std::vector<Entry> _entries;
+
+		//! Groups of the cells and the blocks (by their key).
+		std::unordered_map<uint64_t, osg::ref_ptr<osg::Group> > _cells;
+		std::unordered_map<uint64_t, osg::ref_ptr<osg::Group> > _blocks;
+
+		//! Root of the blocks.
+		osg::ref_ptr<osg::Group> _root;
+
+		//! Edge-length of a cell.
+		float _cellSize = 1.0f;
+
+		//! True if the models are grouped by their position.
+		static bool IS_ENABLED;
+
+
+		/**
+		 * \brief Get the key of the cell which contains a position.
+		 *
+		 * \param position
+		 *      Position in the world.
+		 *
+		 * \return Key of the cell (21 bits per axis).
+		 */
+		uint64_t getKey(const osg::Vec3 &position) const;
+
+
+		/**
+		 * \brief Get the group of a cell (the cell and its block are created if they are not used yet).
+		 *
+		 * \param key
+		 *      Key of the cell.
+		 *
+		 * \return Group of the cell.
+		 */
+		osg::Group* getCell(uint64_t key);
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		SpatialCells();
+
+		//! Private copy-constructor to prevent copying the class.
+		SpatialCells(SpatialCells const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		SpatialCells& operator=(SpatialCells const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static SpatialCells* _pInstance;
+	};
+}
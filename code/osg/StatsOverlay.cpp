@@ -0,0 +1,136 @@
+﻿/**
+ * \brief Functionality for showing the timing of the phases of the frames on the screen.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#include "StatsOverlay.h"
+
+#include <cstdio>
+#include <string>
+
+#include <osg/Geode>
+#include <osg/NodeCallback>
+
+#include "../physics/Profiler.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Refreshes the text a few times per second (only while the HUD is shown).
+	 */
+	class StatsUpdateCallback : public osg::NodeCallback {
+	public:
+		StatsUpdateCallback() : _lastTime(-1.0) {}
+
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			double time = nv->getFrameStamp() ? nv->getFrameStamp()->getReferenceTime() : 0.0;
+
+			if (_lastTime < 0.0 || time - _lastTime > 0.25) {
+				StatsOverlay::Instance()->updateText();
+				_lastTime = time;
+			}
+
+			traverse(node, nv);
+		}
+
+	private:
+		double _lastTime;
+	};
+}
+
+
+//! Pointer to the only instance of this class.
+StatsOverlay* StatsOverlay::_pInstance = nullptr;
+
+//! Same size as the projection of the osgViewer::StatsHandler.
+const double StatsOverlay::WIDTH = 1280.0;
+const double StatsOverlay::HEIGHT = 1024.0;
+
+
+/**
+ * \brief Singleton instance of the StatsOverlay-class.
+ */
+StatsOverlay* StatsOverlay::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new StatsOverlay();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Private constructor: Prepare the hidden HUD-camera with its text.
+ */
+StatsOverlay::StatsOverlay() : _root(new osg::Camera), _text(new osgText::Text), _isVisible(false) {
+	_root->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+	_root->setProjectionMatrixAsOrtho2D(0.0, WIDTH, 0.0, HEIGHT);
+	_root->setViewMatrix(osg::Matrix::identity());
+	_root->setClearMask(GL_DEPTH_BUFFER_BIT);
+	_root->setRenderOrder(osg::Camera::POST_RENDER);
+	_root->setAllowEventFocus(false);
+	_root->setNodeMask(0);
+	_root->setUpdateCallback(new StatsUpdateCallback);
+
+	_text->setCharacterSize(18.0f);
+	_text->setPosition(osg::Vec3(10.0f, HEIGHT - 10.0f, 0.0f));
+	_text->setAlignment(osgText::Text::LEFT_TOP);
+	_text->setColor(osg::Vec4(1.0f, 1.0f, 0.0f, 1.0f));
+	_text->setDataVariance(osg::Object::DYNAMIC);
+
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	geode->addDrawable(_text);
+
+	osg::StateSet* state = geode->getOrCreateStateSet();
+	state->setMode(GL_LIGHTING, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
+	state->setMode(GL_DEPTH_TEST, osg::StateAttribute::OFF);
+
+	_root->addChild(geode);
+}
+
+
+/**
+ * \brief Show or hide the HUD.
+ */
+void StatsOverlay::toggle() {
+	_isVisible = !_isVisible;
+	_root->setNodeMask(_isVisible ? ~0u : 0u);
+}
+
+
+/**
+ * \brief Write the current percentiles of the phases and the counters into the text (called by the update-callback).
+ */
+void StatsOverlay::updateText() {
+	Profiler* profiler = Profiler::Instance();
+	std::string text = "phase            p50 ms    p95 ms    p99 ms\n";
+	char line[128];
+
+	for (int i = 0; i <= Profiler::CNT_PHASES; ++i) {
+		Profiler::Phase phase = static_cast<Profiler::Phase>(i);
+		snprintf(line, sizeof(line), "%-14s %8.3f  %8.3f  %8.3f\n", Profiler::getPhaseName(phase),
+			1000.0 * profiler->getPercentile(phase, 50.0), 1000.0 * profiler->getPercentile(phase, 95.0),
+			1000.0 * profiler->getPercentile(phase, 99.0));
+		text += line;
+	}
+
+	// counters of the last frame
+	text += "\ncounter                  last frame\n";
+	for (int i = 0; i < Profiler::CNT_COUNTERS; ++i) {
+		Profiler::Counter counter = static_cast<Profiler::Counter>(i);
+		snprintf(line, sizeof(line), "%-18s %16.6g\n", Profiler::getCounterName(counter), profiler->getCounter(counter));
+		text += line;
+	}
+
+	if (!_report.empty()) {
+		text += "\n" + _report;
+	}
+
+	_text->setText(text);
+}
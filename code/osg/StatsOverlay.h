@@ -0,0 +1,96 @@
+﻿/**
+ * \brief Functionality for showing the timing of the phases of the frames on the screen.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#pragma once
+
+#include <string>
+
+#include <osg/Camera>
+#include <osgText/Text>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief StatsOverlay shows the percentiles of the phases of the Profiler in a HUD (similar to the
+	 * osgViewer::StatsHandler). The HUD is a post-render camera with its own orthographic projection, whose text is
+	 * refreshed by an update-callback a few times per second. It's hidden by default and toggled by the
+	 * keyboard-handler.
+	 */
+	class StatsOverlay {
+	public:
+
+		/**
+		 * \brief Singleton instance of the StatsOverlay-class.
+		 */
+		static StatsOverlay* Instance();
+
+
+		/**
+		 * \brief Get the camera of the HUD (has to be added once to the scene).
+		 *
+		 * \return Root of the HUD.
+		 */
+		osg::ref_ptr<osg::Camera> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Show or hide the HUD.
+		 */
+		void toggle();
+
+
+		/**
+		 * \brief Write the current percentiles of the phases and the counters into the text (called by the update-callback).
+		 */
+		void updateText();
+
+
+		/**
+		 * \brief Set the lines which are shown below the counters (e.g. the knobs of the FrameGovernor).
+		 *
+		 * \param report
+		 *      Lines of the report (empty => nothing is shown).
+		 */
+		void setReport(const std::string &report) {
+			_report = report;
+		}
+
+
+	private:
+
+		//! Size of the orthographic projection of the HUD
+		static const double WIDTH, HEIGHT;
+
+		//! Camera of the HUD
+		osg::ref_ptr<osg::Camera> _root;
+
+		//! Text with one line per phase
+		osg::ref_ptr<osgText::Text> _text;
+
+		//! True if the HUD is shown
+		bool _isVisible;
+
+		//! Lines below the counters
+		std::string _report;
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		StatsOverlay();
+
+		//! Private copy-constructor to prevent copying the class.
+		StatsOverlay(StatsOverlay const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		StatsOverlay& operator=(StatsOverlay const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static StatsOverlay* _pInstance;
+	};
+}
@@ -0,0 +1,268 @@
+﻿/**
+ * \brief Functionality for rendering the scene for both eyes of a headset with a single pass of the instanced models.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "StereoRenderer.h"
+
+#include <algorithm>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/NodeCallback>
+
+#include "shaders/StereoShader.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Sets the eyes from the camera of the viewer before they are culled (the manipulator has updated it).
+	 */
+	class StereoCullCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			StereoRenderer::Instance()->update();
+			traverse(node, nv);
+		}
+	};
+
+
+	/**
+	 * \brief Create a texture-array with one layer per eye.
+	 *
+	 * \param width, height
+	 *      Size of a layer.
+	 * \param internalFormat
+	 *      Format of the texels.
+	 *
+	 * \return Texture-array (allocated by the frame-buffer-objects).
+	 */
+	osg::ref_ptr<osg::Texture2DArray> createTarget(int width, int height, GLint internalFormat) {
+		osg::ref_ptr<osg::Texture2DArray> target = new osg::Texture2DArray;
+		target->setTextureSize(width, height, 2);
+		target->setInternalFormat(internalFormat);
+		target->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+		target->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+		target->setWrap(osg::Texture::WRAP_S, osg::Texture::CLAMP_TO_EDGE);
+		target->setWrap(osg::Texture::WRAP_T, osg::Texture::CLAMP_TO_EDGE);
+
+		return target;
+	}
+}
+
+
+//! Pointer to the only instance of this class.
+StereoRenderer* StereoRenderer::_pInstance = nullptr;
+
+//! Disabled by default, rendered for a single eye.
+bool StereoRenderer::IS_ENABLED = false;
+
+//! A bit which no other node of the scene uses.
+const unsigned int StereoRenderer::SINGLE_PASS_MASK = 1u << 30;
+
+
+/**
+ * \brief Singleton instance of the StereoRenderer-class.
+ */
+StereoRenderer* StereoRenderer::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new StereoRenderer();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Render the scene of the viewer for both eyes (has to be called once, before the viewer is realized).
+ *
+ * \param viewer
+ *      Viewer whose camera is the center between the eyes and shows the target.
+ * \param scene
+ *      Scene which is rendered per eye.
+ * \param instanced
+ *      Root of the instanced models within the scene, which is rendered once for both eyes (nullptr => none).
+ *
+ * \return Root which replaces the scene-data of the viewer.
+ */
+osg::ref_ptr<osg::Group> StereoRenderer::attach(osgViewer::Viewer* viewer, osg::ref_ptr<osg::Node> scene, osg::ref_ptr<osg::Node> instanced) {
+	_camera = viewer->getCamera();
+
+	// the window of the viewer exists already, each eye gets half of its width
+	const osg::Viewport* viewport = _camera->getViewport();
+	_targetWidth = std::max(viewport ? static_cast<int>(viewport->width()) / 2 : 500, 1);
+	_targetHeight = std::max(viewport ? static_cast<int>(viewport->height()) : 600, 1);
+
+	_colors = createTarget(_targetWidth, _targetHeight, GL_RGBA8);
+	_depths = createTarget(_targetWidth, _targetHeight, GL_DEPTH_COMPONENT24);
+	_depths->setSourceFormat(GL_DEPTH_COMPONENT);
+	_depths->setSourceType(GL_UNSIGNED_INT);
+
+	osg::ref_ptr<osg::Group> root = new osg::Group;
+
+	// the cameras share the layers, so the depth has to be the same => the near- and far-plane are not computed
+	for (unsigned int eye = 0; eye < 2; ++eye) {
+		osg::ref_ptr<osg::Camera> camera = new osg::Camera;
+		camera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+		camera->setRenderOrder(osg::Camera::PRE_RENDER, eye);
+		camera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+		camera->attach(osg::Camera::COLOR_BUFFER, _colors.get(), 0, eye);
+		camera->attach(osg::Camera::DEPTH_BUFFER, _depths.get(), 0, eye);
+		camera->setClearColor(_camera->getClearColor());
+		camera->setClearMask(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		camera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+		camera->setViewport(0, 0, _targetWidth, _targetHeight);
+		camera->setCullMask(~SINGLE_PASS_MASK);
+		camera->addChild(scene);
+
+		root->addChild(camera);
+		_eyeCameras[eye] = camera;
+	}
+
+	_viewsUniform = new osg::Uniform(osg::Uniform::FLOAT_MAT4, "stereoViews", 2);
+	_viewsUniform->setDataVariance(osg::Object::DYNAMIC);
+	_projectionsUniform = new osg::Uniform(osg::Uniform::FLOAT_MAT4, "stereoProjections", 2);
+	_projectionsUniform->setDataVariance(osg::Object::DYNAMIC);
+
+	// the instanced models are drawn after both eyes into both layers (the layer is selected by the vertex-shaders)
+	_singlePassCamera = new osg::Camera;
+	_singlePassCamera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+	_singlePassCamera->setRenderOrder(osg::Camera::PRE_RENDER, 2);
+	_singlePassCamera->setRenderTargetImplementation(osg::Camera::FRAME_BUFFER_OBJECT);
+	_singlePassCamera->attach(osg::Camera::COLOR_BUFFER, _colors.get(), 0, osg::Camera::FACE_CONTROLLED_BY_GEOMETRY_SHADER);
+	_singlePassCamera->attach(osg::Camera::DEPTH_BUFFER, _depths.get(), 0, osg::Camera::FACE_CONTROLLED_BY_GEOMETRY_SHADER);
+	_singlePassCamera->setClearMask(0);
+	_singlePassCamera->setComputeNearFarMode(osg::CullSettings::DO_NOT_COMPUTE_NEAR_FAR);
+	_singlePassCamera->setViewport(0, 0, _targetWidth, _targetHeight);
+	_singlePassCamera->getOrCreateStateSet()->addUniform(_viewsUniform);
+	_singlePassCamera->getOrCreateStateSet()->addUniform(_projectionsUniform);
+
+	if (instanced.valid()) {
+		instanced->setNodeMask(SINGLE_PASS_MASK);
+		_singlePassCamera->addChild(instanced);
+	}
+	root->addChild(_singlePassCamera);
+
+	_scaleUniform = new osg::Uniform("scale", osg::Vec2(1.0f, 1.0f));
+	_scaleUniform->setDataVariance(osg::Object::DYNAMIC);
+
+	// one quad over the whole window shows both layers side by side
+	osg::ref_ptr<osg::Geode> quad = new osg::Geode;
+	quad->addDrawable(osg::createTexturedQuadGeometry(osg::Vec3(0.0f, 0.0f, 0.0f), osg::Vec3(1.0f, 0.0f, 0.0f), osg::Vec3(0.0f, 1.0f, 0.0f)));
+	quad->setCullingActive(false);
+	StereoShader shader(_colors, _scaleUniform);
+	shader.apply(quad);
+
+	osg::StateSet* state = quad->getOrCreateStateSet();
+	state->setMode(GL_LIGHTING, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
+	state->setMode(GL_DEPTH_TEST, osg::StateAttribute::OFF);
+
+	osg::ref_ptr<osg::Camera> presentCamera = new osg::Camera;
+	presentCamera->setReferenceFrame(osg::Transform::ABSOLUTE_RF);
+	presentCamera->setProjectionMatrixAsOrtho2D(0.0, 1.0, 0.0, 1.0);
+	presentCamera->setViewMatrix(osg::Matrix::identity());
+	presentCamera->setClearMask(0);
+	presentCamera->setRenderOrder(osg::Camera::NESTED_RENDER);
+	presentCamera->setAllowEventFocus(false);
+	presentCamera->addChild(quad);
+
+	root->addChild(presentCamera);
+	root->setCullCallback(new StereoCullCallback);
+
+	return root;
+}
+
+
+/**
+ * \brief Set the views and projections of the eyes from the camera of the viewer (called by the cull-callback
+ *        before the cameras of the eyes are traversed).
+ */
+void StereoRenderer::update() {
+	if (!_camera.valid()) return;
+
+	const osg::Viewport* viewport = _camera->getViewport();
+	if (!viewport) return;
+
+	int width = std::max(static_cast<int>(viewport->width()) / 2, 1);
+	int height = std::max(static_cast<int>(viewport->height()), 1);
+	if (width > _targetWidth || height > _targetHeight) {
+		resize(width, height);
+	}
+
+	_eyeCameras[0]->setViewport(0, 0, width, height);
+	_eyeCameras[1]->setViewport(0, 0, width, height);
+	_singlePassCamera->setViewport(0, 0, width, height);
+	_scaleUniform->set(osg::Vec2(static_cast<float>(width) / _targetWidth, static_cast<float>(height) / _targetHeight));
+
+	// an eye has half of the width of the window => half of the horizontal extent of the projection
+	osg::Matrixd view = _camera->getViewMatrix();
+	osg::Matrixd projection = _camera->getProjectionMatrix() * osg::Matrixd::scale(2.0, 1.0, 1.0);
+	double focal = projection(0, 0);
+
+	// the outer planes of the eyes meet behind them at this distance => the pulled back frustum contains both
+	double pullBack = 0.5 * _eyeSeparation * focal;
+	_singlePassCamera->setViewMatrix(view * osg::Matrixd::translate(0.0, 0.0, -pullBack));
+	_singlePassCamera->setProjectionMatrix(projection);
+
+	for (unsigned int eye = 0; eye < 2; ++eye) {
+		// the left eye is at -separation / 2, its projection is shifted so both views meet at the fusion-distance
+		double offset = (eye == 0 ? 0.5 : -0.5) * _eyeSeparation;
+		osg::Matrixd eyeView = osg::Matrixd::translate(offset, 0.0, 0.0);
+		osg::Matrixd eyeProjection = projection * osg::Matrixd::translate(-focal * offset / std::max(_fusionDistance, 1e-6), 0.0, 0.0);
+
+		_eyeCameras[eye]->setViewMatrix(view * eyeView);
+		_eyeCameras[eye]->setProjectionMatrix(eyeProjection);
+
+		_viewsUniform->setElement(eye, osg::Matrixf(osg::Matrixd::translate(0.0, 0.0, pullBack) * eyeView));
+		_projectionsUniform->setElement(eye, osg::Matrixf(eyeProjection));
+	}
+}
+
+
+/**
+ * \brief Get the defines, the extension and the uniforms of the instanced stereo for the vertex-shaders of the
+ *        instanced models (directly after the version). The shader draws the instance gl_InstanceID / 2 for the eye
+ *        gl_InstanceID % 2, the vertex in the space of the culling camera is transformed to the eye by
+ *        stereoViews[eye] and projected by stereoProjections[eye].
+ *
+ * \return Source-code of the header ("" if the stereo is disabled).
+ */
+std::string StereoRenderer::getShaderHeader() {
+	if (!IS_ENABLED) {
+		return "";
+	}
+
+	return
+		"#extension GL_ARB_shader_viewport_layer_array : require\n"
+		"#define STEREO\n"
+		"uniform mat4 stereoViews[2];\n"
+		"uniform mat4 stereoProjections[2];\n";
+}
+
+
+/**
+ * \brief Reallocate the target for a bigger window.
+ *
+ * \param width, height
+ *      Size of a layer (half of the window).
+ */
+void StereoRenderer::resize(int width, int height) {
+	_targetWidth = std::max(width, _targetWidth);
+	_targetHeight = std::max(height, _targetHeight);
+
+	// the frame-buffer-objects are attached again with the new texture-objects
+	_colors->setTextureSize(_targetWidth, _targetHeight, 2);
+	_colors->dirtyTextureObject();
+	_depths->setTextureSize(_targetWidth, _targetHeight, 2);
+	_depths->dirtyTextureObject();
+
+	_eyeCameras[0]->dirtyAttachmentMap();
+	_eyeCameras[1]->dirtyAttachmentMap();
+	_singlePassCamera->dirtyAttachmentMap();
+}
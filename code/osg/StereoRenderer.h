@@ -0,0 +1,181 @@
+﻿/**
+ * \brief Functionality for rendering the scene for both eyes of a headset with a single pass of the instanced models.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <string>
+
+#include <osg/Camera>
+#include <osg/Group>
+#include <osg/Texture2DArray>
+#include <osg/Uniform>
+#include <osgViewer/Viewer>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief StereoRenderer renders the scene into a layered offscreen-target (one layer of a texture-array per eye),
+	 * which is shown side by side in the window (left eye on the left half, see StereoShader). The instanced models are
+	 * drawn in one pass for both eyes (instanced stereo): they are culled once against a frustum which contains both
+	 * eyes (the view pulled back behind the eyes), each draw has twice the instances and the shaders select the eye by
+	 * the lowest bit of gl_InstanceID, transform the vertex with its view and projection and write it to its layer
+	 * (gl_Layer in the vertex-shader, needs GL_ARB_shader_viewport_layer_array, see getShaderHeader()). The other
+	 * nodes of the scene (planets, sun, trails, ...) are rendered by one camera per eye into the same layers.
+	 * The eyes are parallel with an off-axis projection which converges at the fusion-distance.
+	 */
+	class StereoRenderer {
+	public:
+
+		/**
+		 * \brief Singleton instance of the StereoRenderer-class.
+		 */
+		static StereoRenderer* Instance();
+
+
+		/**
+		 * \brief Render the scene of the viewer for both eyes (has to be called once, before the viewer is realized).
+		 *
+		 * \param viewer
+		 *      Viewer whose camera is the center between the eyes and shows the target.
+		 * \param scene
+		 *      Scene which is rendered per eye.
+		 * \param instanced
+		 *      Root of the instanced models within the scene, which is rendered once for both eyes (nullptr => none).
+		 *
+		 * \return Root which replaces the scene-data of the viewer.
+		 */
+		osg::ref_ptr<osg::Group> attach(osgViewer::Viewer* viewer, osg::ref_ptr<osg::Node> scene, osg::ref_ptr<osg::Node> instanced);
+
+
+		/**
+		 * \brief Set the views and projections of the eyes from the camera of the viewer (called by the cull-callback
+		 *        before the cameras of the eyes are traversed).
+		 */
+		void update();
+
+
+		/**
+		 * \brief Set the distance between the eyes.
+		 *
+		 * \param eyeSeparation
+		 *      Distance between the eyes (in the units of the scene).
+		 */
+		void setEyeSeparation(double eyeSeparation) {
+			_eyeSeparation = eyeSeparation;
+		}
+
+
+		/**
+		 * \brief Set the distance at which the views of the eyes converge (appears at the depth of the screen).
+		 *
+		 * \param fusionDistance
+		 *      Distance in front of the camera (in the units of the scene).
+		 */
+		void setFusionDistance(double fusionDistance) {
+			_fusionDistance = fusionDistance;
+		}
+
+
+		/**
+		 * \brief Get the defines, the extension and the uniforms of the instanced stereo for the vertex-shaders of the
+		 *        instanced models (directly after the version). The shader draws the instance gl_InstanceID / 2 for the eye
+		 *        gl_InstanceID % 2, the vertex in the space of the culling camera is transformed to the eye by
+		 *        stereoViews[eye] and projected by stereoProjections[eye].
+		 *
+		 * \return Source-code of the header ("" if the stereo is disabled).
+		 */
+		static std::string getShaderHeader();
+
+
+		/**
+		 * \brief Get the number of instances which are drawn per visible instance.
+		 *
+		 * \return 2 if the stereo is enabled, otherwise 1.
+		 */
+		static unsigned int getCntEyes() {
+			return IS_ENABLED ? 2 : 1;
+		}
+
+
+		/**
+		 * \brief Enable or disable the stereo-rendering. Has to be set before loading the scene (the instanced shaders
+		 *        read it).
+		 *
+		 * \param isEnabled
+		 *      True if both eyes are rendered.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the stereo-rendering is enabled.
+		 *
+		 * \return True if both eyes are rendered.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+
+		//! True if both eyes are rendered
+		static bool IS_ENABLED;
+
+		//! Node-mask of the instanced models (not traversed by the cameras of the eyes)
+		static const unsigned int SINGLE_PASS_MASK;
+
+		//! Camera of the viewer (center between the eyes, shows the target)
+		osg::ref_ptr<osg::Camera> _camera;
+		//! Camera per eye which renders the scene without the instanced models into its layer
+		osg::ref_ptr<osg::Camera> _eyeCameras[2];
+		//! Camera which renders the instanced models into both layers (its frustum contains both eyes)
+		osg::ref_ptr<osg::Camera> _singlePassCamera;
+		//! Color and depth of the target (one layer per eye)
+		osg::ref_ptr<osg::Texture2DArray> _colors;
+		osg::ref_ptr<osg::Texture2DArray> _depths;
+		//! Transformation from the view of the single pass to the view of each eye for the shaders
+		osg::ref_ptr<osg::Uniform> _viewsUniform;
+		//! Projection of each eye for the shaders
+		osg::ref_ptr<osg::Uniform> _projectionsUniform;
+		//! Rendered part of the target for the shader
+		osg::ref_ptr<osg::Uniform> _scaleUniform;
+
+		//! Size of a layer of the target
+		int _targetWidth = 0, _targetHeight = 0;
+
+		//! Distance between the eyes
+		double _eyeSeparation = 0.065;
+		//! Distance at which the views of the eyes converge
+		double _fusionDistance = 15.0;
+
+
+		/**
+		 * \brief Reallocate the target for a bigger window.
+		 *
+		 * \param width, height
+		 *      Size of a layer (half of the window).
+		 */
+		void resize(int width, int height);
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		StereoRenderer() = default;
+
+		//! Private copy-constructor to prevent copying the class.
+		StereoRenderer(StereoRenderer const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		StereoRenderer& operator=(StereoRenderer const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static StereoRenderer* _pInstance;
+	};
+}
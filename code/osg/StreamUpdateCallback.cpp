@@ -0,0 +1,18 @@
+﻿/**
+ * \brief Update-callback which writes the state streamed by a remote simulation to the scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "StreamUpdateCallback.h"
+
+#include "../physics/StateSubscriber.h"
+
+using namespace pbs17;
+
+void StreamUpdateCallback::operator()(osg::Node* node, osg::NodeVisitor* nv) {
+	_subscriber->update();
+
+	traverse(node, nv);
+}
@@ -0,0 +1,36 @@
+﻿/**
+ * \brief Update-callback which writes the state streamed by a remote simulation to the scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <osg/NodeCallback>
+
+
+namespace pbs17 {
+	class StateSubscriber;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief This callback writes the objects which have been changed by the received frames of the StateSubscriber
+	 *        into the matrix-transformations during the update-traversal (the viewer is not simulating).
+	 */
+	class StreamUpdateCallback : public osg::NodeCallback {
+	public:
+
+		StreamUpdateCallback(StateSubscriber* subscriber)
+			: _subscriber(subscriber) {}
+
+		void operator () (osg::Node* node, osg::NodeVisitor* nv) override;
+
+	protected:
+
+		StateSubscriber* _subscriber;
+	};
+}
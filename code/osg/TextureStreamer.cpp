@@ -0,0 +1,165 @@
+﻿/**
+ * \brief Functionality for decoding the textures on a background-thread while the scene is already drawn.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-12
+ */
+
+#include "TextureStreamer.h"
+
+#include <cstring>
+#include <iostream>
+
+#include <osg/NodeCallback>
+#include <osgDB/ReadFile>
+#include <OpenThreads/ScopedLock>
+
+#include "ImageManager.h"
+#include "Loader.h"
+#include "LoadProfiler.h"
+#include "../physics/Logger.h"
+#include "../physics/ThreadBudget.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Swaps the decoded images once per frame.
+	 */
+	class StreamerUpdateCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			TextureStreamer::Instance()->swapDecoded();
+			traverse(node, nv);
+		}
+	};
+}
+
+
+//! Pointer to the only instance of this class.
+TextureStreamer* TextureStreamer::_pInstance = nullptr;
+
+//! The textures are decoded when they are loaded by default.
+bool TextureStreamer::IS_ENABLED = false;
+
+
+/**
+ * \brief Singleton instance of the TextureStreamer-class.
+ */
+TextureStreamer* TextureStreamer::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new TextureStreamer();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Private constructor: Prepare the placeholders and the root with the update-callback.
+ */
+TextureStreamer::TextureStreamer() : _colorPlaceholder(createPlaceholder(osg::Vec3ub(128, 128, 128))),
+	_normalPlaceholder(createPlaceholder(osg::Vec3ub(128, 128, 255))), _root(new osg::Node) {
+	_root->setUpdateCallback(new StreamerUpdateCallback);
+}
+
+
+/**
+ * \brief Create the texture with a placeholder and queue the image-file for decoding.
+ *
+ * \param filePath
+ *      Complete path to the image-file.
+ * \param isNormalMap
+ *      True if the placeholder is a flat normal (instead of grey).
+ *
+ * \return Texture object to attach to osg-nodes (the image is replaced when it's decoded).
+ */
+osg::ref_ptr<osg::Texture2D> TextureStreamer::push(const std::string &filePath, bool isNormalMap) {
+	osg::ref_ptr<osg::Texture2D> texture = Loader::createTexture(isNormalMap ? _normalPlaceholder : _colorPlaceholder);
+	// the image is replaced between the frames
+	texture->setDataVariance(osg::Object::DYNAMIC);
+
+	Request request;
+	request.texture = texture;
+	request.filePath = filePath;
+
+	ThreadBudget::Instance()->submit(ThreadBudget::BACKGROUND, [this, request]() {
+		decode(request);
+	});
+
+	return texture;
+}
+
+
+/**
+ * \brief Swap the decoded images into their textures (called once per frame by the update-callback of the root).
+ */
+void TextureStreamer::swapDecoded() {
+	std::deque<Request> decoded;
+
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		if (_decoded.empty()) return;
+		decoded.swap(_decoded);
+	}
+
+	for (unsigned int i = 0; i < decoded.size(); ++i) {
+		decoded[i].texture->setImage(decoded[i].image);
+		// the texture-object has the size of the placeholder => it's created again with the new image
+		decoded[i].texture->dirtyTextureObject();
+		ImageManager::Instance()->updateTwoChannelUniform(decoded[i].texture);
+	}
+}
+
+
+/**
+ * \brief Check if decoded images wait for the swap.
+ *
+ * \return True if the next frame swaps images.
+ */
+bool TextureStreamer::hasDecoded() {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	return !_decoded.empty();
+}
+
+
+/**
+ * \brief Create a 1x1 placeholder.
+ *
+ * \param color
+ *      Colour of the texel.
+ *
+ * \return Placeholder-image.
+ */
+osg::ref_ptr<osg::Image> TextureStreamer::createPlaceholder(const osg::Vec3ub &color) {
+	osg::ref_ptr<osg::Image> image = new osg::Image;
+	image->allocateImage(1, 1, 1, GL_RGB, GL_UNSIGNED_BYTE);
+	std::memcpy(image->data(), color.ptr(), 3);
+
+	return image;
+}
+
+
+/**
+ * \brief Decode the image-file of a request and queue it for the swap (runs on a background-worker).
+ *
+ * \param request
+ *      Texture and its image-file.
+ */
+void TextureStreamer::decode(Request request) {
+	// a missing image-file keeps its placeholder (instead of aborting as the synchronous loader)
+	{
+		LoadProfiler::ScopedTimer timer(LoadProfiler::TEXTURES, request.filePath);
+		request.image = osgDB::readImageFile(request.filePath);
+	}
+	if (!request.image) {
+		LOG_WARNING("Couldn't find image: \"" << request.filePath << "\" is missing!");
+		return;
+	}
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_decoded.push_back(request);
+}
@@ -0,0 +1,155 @@
+﻿/**
+ * \brief Functionality for decoding the textures on a background-thread while the scene is already drawn.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-12
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+
+#include <osg/Image>
+#include <osg/Node>
+#include <osg/Texture2D>
+#include <OpenThreads/Mutex>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief TextureStreamer lets the ImageManager return a texture with a 1x1 placeholder immediately (grey for the
+	 * colour, a flat normal for the bumpmaps), while the image-files are decoded by the background-workers of the
+	 * ThreadBudget (with the lowest priority, so the decoding does not take cores from the physics). The decoded
+	 * images are swapped into their textures by the update-callback of the root (once per frame, before the cull-
+	 * and draw-traversal), so the first frame does not wait for any texture.
+	 */
+	class TextureStreamer {
+	public:
+
+		/**
+		 * \brief Singleton instance of the TextureStreamer-class.
+		 */
+		static TextureStreamer* Instance();
+
+
+		/**
+		 * \brief Create the texture with a placeholder and queue the image-file for decoding.
+		 *
+		 * \param filePath
+		 *      Complete path to the image-file.
+		 * \param isNormalMap
+		 *      True if the placeholder is a flat normal (instead of grey).
+		 *
+		 * \return Texture object to attach to osg-nodes (the image is replaced when it's decoded).
+		 */
+		osg::ref_ptr<osg::Texture2D> push(const std::string &filePath, bool isNormalMap);
+
+
+		/**
+		 * \brief Swap the decoded images into their textures (called once per frame by the update-callback of the root).
+		 */
+		void swapDecoded();
+
+
+		/**
+		 * \brief Check if decoded images wait for the swap.
+		 *
+		 * \return True if the next frame swaps images.
+		 */
+		bool hasDecoded();
+
+
+		/**
+		 * \brief Get the node which swaps the decoded images (has to be added once to the scene).
+		 *
+		 * \return Root of the streamer (nothing is drawn).
+		 */
+		osg::ref_ptr<osg::Node> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Create a 1x1 placeholder.
+		 *
+		 * \param color
+		 *      Colour of the texel.
+		 *
+		 * \return Placeholder-image.
+		 */
+		static osg::ref_ptr<osg::Image> createPlaceholder(const osg::Vec3ub &color);
+
+
+		/**
+		 * \brief Enable or disable the streaming (if disabled, the textures are decoded when they are loaded). Has to
+		 *        be set before loading the scene.
+		 *
+		 * \param isEnabled
+		 *      True if the textures are decoded on the background-thread.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the streaming is enabled.
+		 *
+		 * \return True if the textures are decoded on the background-thread.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+		/**
+		 * \brief Texture whose image-file waits for the decoding (or whose decoded image waits for the swap).
+		 */
+		struct Request {
+			osg::ref_ptr<osg::Texture2D> texture;
+			std::string filePath;
+			osg::ref_ptr<osg::Image> image;
+		};
+
+
+		//! True if the textures are decoded on the background-thread
+		static bool IS_ENABLED;
+
+		//! Placeholders for the colour and the normals (shared by all waiting textures)
+		osg::ref_ptr<osg::Image> _colorPlaceholder;
+		osg::ref_ptr<osg::Image> _normalPlaceholder;
+
+		//! Decoded images which wait for the swap
+		std::deque<Request> _decoded;
+		//! Protects _decoded
+		OpenThreads::Mutex _mutex;
+
+		//! Root with the update-callback which swaps the images
+		osg::ref_ptr<osg::Node> _root;
+
+
+		/**
+		 * \brief Decode the image-file of a request and queue it for the swap (runs on a background-worker).
+		 *
+		 * \param request
+		 *      Texture and its image-file.
+		 */
+		void decode(Request request);
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		TextureStreamer();
+
+		//! Private copy-constructor to prevent copying the class.
+		TextureStreamer(TextureStreamer const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		TextureStreamer& operator=(TextureStreamer const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static TextureStreamer* _pInstance;
+	};
+}
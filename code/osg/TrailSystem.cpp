@@ -0,0 +1,285 @@
+﻿/**
+ * \brief Functionality for drawing the following-ribbons of all space-objects with one draw-call.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-22
+ */
+
+#include "TrailSystem.h"
+
+#include <algorithm>
+
+#include <osg/NodeCallback>
+#include <osg/State>
+
+#include "UploadRing.h"
+#include "shaders/TrailShader.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Samples the positions once per frame.
+	 */
+	class TrailUpdateCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			TrailSystem::Instance()->update();
+			traverse(node, nv);
+		}
+	};
+
+
+	/**
+	 * \brief Allocates the history-texture and uploads only the new samples.
+	 */
+	class HistorySubloadCallback : public osg::Texture2D::SubloadCallback {
+	public:
+		void load(const osg::Texture2D &texture, osg::State &state) const override {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F_ARB, texture.getTextureWidth(), texture.getTextureHeight(), 0,
+				GL_RGB, GL_FLOAT, nullptr);
+			TrailSystem::Instance()->uploadSamples(state);
+		}
+
+		void subload(const osg::Texture2D &, osg::State &state) const override {
+			TrailSystem::Instance()->uploadSamples(state);
+		}
+	};
+
+
+	/**
+	 * \brief The trails are bounded by all samples which have been written.
+	 */
+	class TrailBoundCallback : public osg::Drawable::ComputeBoundingBoxCallback {
+	public:
+		osg::BoundingBox computeBound(const osg::Drawable &) const override {
+			return TrailSystem::Instance()->getBound();
+		}
+	};
+}
+
+
+//! Pointer to the only instance of this class.
+TrailSystem* TrailSystem::_pInstance = nullptr;
+
+//! The shared trail-system is disabled by default (needs OpenGL 3.2).
+bool TrailSystem::IS_ENABLED = false;
+
+//! The trails are sampled every frame by default
+bool TrailSystem::IS_FROZEN = false;
+
+//! Maximal width of the history-texture
+const unsigned int TrailSystem::MAX_WIDTH = 4096;
+
+
+/**
+ * \brief Singleton instance of the TrailSystem-class.
+ */
+TrailSystem* TrailSystem::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new TrailSystem();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Private constructor to be sure the class can't be created outside of this class.
+ */
+TrailSystem::TrailSystem() : _root(new osg::Geode) {
+	_root->setDataVariance(osg::Object::DYNAMIC);
+	_root->setCullingActive(false);
+	_root->setUpdateCallback(new TrailUpdateCallback);
+
+	osg::StateSet* stateset = _root->getOrCreateStateSet();
+	stateset->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+	stateset->setMode(GL_BLEND, osg::StateAttribute::ON);
+	stateset->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+}
+
+
+/**
+ * \brief Add the trail of an object (has to be done before the first frame).
+ *
+ * \param position
+ *      Initial position of the object.
+ * \param color
+ *      Color of the trail.
+ * \param numSamples
+ *      Number of samples of the trail. Higher value => longer trail.
+ * \param halfWidth
+ *      Width of the trail.
+ *
+ * \return Index of the trail.
+ */
+unsigned int TrailSystem::addTrail(const osg::Vec3 &position, const osg::Vec3 &color, unsigned int numSamples, float halfWidth) {
+	numSamples = std::max(numSamples, 2u);
+
+	_positions.push_back(position);
+	_parameters.push_back(osg::Vec4f(color, halfWidth));
+	_parameters.push_back(osg::Vec4f(static_cast<float>(numSamples), 0.0f, 0.0f, 0.0f));
+	_numSamples = std::max(_numSamples, numSamples);
+	_bound.expandBy(position);
+
+	return _positions.size() - 1;
+}
+
+
+/**
+ * \brief Write the current positions of all trails as the newest sample (called once per frame by the
+ * update-callback of the root).
+ */
+void TrailSystem::update() {
+	if (_positions.empty()) return;
+
+	if (IS_FROZEN) {
+		_wasFrozen = true;
+		return;
+	}
+
+	if (!_geometry.valid()) {
+		allocate();
+	}
+
+	// the trails restart at the current positions (no segments across the frozen frames)
+	if (_wasFrozen) {
+		for (unsigned int sample = 0; sample < _numSamples; ++sample) {
+			std::copy(_positions.begin(), _positions.end(), &_history[sample * _width * _height]);
+			_dirtySamples.push_back(sample);
+		}
+		_wasFrozen = false;
+	}
+
+	// the oldest sample is overwritten by the current positions
+	_head = (_head + 1) % _numSamples;
+
+	osg::Vec3f* band = &_history[_head * _width * _height];
+	std::copy(_positions.begin(), _positions.end(), band);
+	for (unsigned int i = 0; i < _positions.size(); ++i) {
+		_bound.expandBy(_positions[i]);
+	}
+
+	_dirtySamples.push_back(_head);
+	_headUniform->set(static_cast<int>(_head));
+	_geometry->dirtyBound();
+}
+
+
+/**
+ * \brief Upload the samples which have been written since the last call (called by the texture before it's used).
+ *
+ * \param state
+ *      State of the current context (the samples are uploaded through its UploadRing).
+ */
+void TrailSystem::uploadSamples(osg::State &state) const {
+	for (unsigned int i = 0; i < _dirtySamples.size(); ++i) {
+		unsigned int sample = _dirtySamples[i];
+		const osg::Vec3f* pixels = &_history[sample * _width * _height];
+
+		if (!UploadRing::Instance()->texSubImage2D(state, 0, sample * _height, _width, _height, GL_RGB, GL_FLOAT,
+			pixels, _width * _height * sizeof(osg::Vec3f))) {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, sample * _height, _width, _height, GL_RGB, GL_FLOAT, pixels);
+		}
+	}
+
+	_dirtySamples.clear();
+}
+
+
+/**
+ * \brief Allocate the history, the textures and the geometry for all added trails (at the first update).
+ */
+void TrailSystem::allocate() {
+	unsigned int cntTrails = _positions.size();
+	_width = std::min(cntTrails, MAX_WIDTH);
+	_height = (cntTrails + _width - 1) / _width;
+
+	// all samples start at the initial positions => the whole history is uploaded once
+	_history.resize(_width * _height * _numSamples);
+	for (unsigned int k = 0; k < _numSamples; ++k) {
+		std::copy(_positions.begin(), _positions.end(), _history.begin() + k * _width * _height);
+		_dirtySamples.push_back(k);
+	}
+
+	_historyTexture = new osg::Texture2D;
+	_historyTexture->setDataVariance(osg::Object::DYNAMIC);
+	_historyTexture->setTextureSize(_width, _height * _numSamples);
+	_historyTexture->setInternalFormat(GL_RGB32F_ARB);
+	_historyTexture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::NEAREST);
+	_historyTexture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::NEAREST);
+	_historyTexture->setSubloadCallback(new HistorySubloadCallback);
+
+	_parametersImage = new osg::Image;
+	_parametersImage->allocateImage(_parameters.size(), 1, 1, GL_RGBA, GL_FLOAT);
+	_parametersImage->setInternalTextureFormat(GL_RGBA32F_ARB);
+	std::copy(_parameters.begin(), _parameters.end(), reinterpret_cast<osg::Vec4f*>(_parametersImage->data()));
+	_parametersBuffer = new osg::TextureBuffer;
+	_parametersBuffer->setInternalFormat(GL_RGBA32F_ARB);
+	_parametersBuffer->setImage(_parametersImage);
+	_parametersBuffer->setTextureWidth(_parameters.size());
+
+	// each vertex of the quad-strip is a sample (x) and a side (y) of the ribbon
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+	for (unsigned int k = 0; k < _numSamples; ++k) {
+		vertices->push_back(osg::Vec3(static_cast<float>(k), -1.0f, 0.0f));
+		vertices->push_back(osg::Vec3(static_cast<float>(k), 1.0f, 0.0f));
+	}
+
+	_strip = new osg::DrawArrays(GL_QUAD_STRIP, 0, vertices->size());
+	_strip->setNumInstances(cntTrails);
+
+	_geometry = new osg::Geometry;
+	_geometry->setDataVariance(osg::Object::DYNAMIC);
+	_geometry->setUseDisplayList(false);
+	_geometry->setUseVertexBufferObjects(true);
+	_geometry->setVertexArray(vertices);
+	_geometry->addPrimitiveSet(_strip);
+	_geometry->setComputeBoundingBoxCallback(new TrailBoundCallback);
+	_root->addDrawable(_geometry);
+
+	_headUniform = new osg::Uniform("head", static_cast<int>(_head));
+	_headUniform->setDataVariance(osg::Object::DYNAMIC);
+	TrailShader shader(_historyTexture, _parametersBuffer, _numSamples, _width, _height, _headUniform);
+	shader.apply(_root);
+
+	_oldestUniform = new osg::Uniform("oldest", 0);
+	_oldestUniform->setDataVariance(osg::Object::DYNAMIC);
+	_root->getOrCreateStateSet()->addUniform(_oldestUniform);
+	applyLength();
+}
+
+
+/**
+ * \brief Shorten all trails to their newest samples (e.g. by the FrameGovernor), the shortened trails are
+ *        faded over their drawn samples and only those are drawn.
+ *
+ * \param length
+ *      Fraction of the samples which are drawn (1 => whole trails).
+ */
+void TrailSystem::setLength(float length) {
+	_length = std::max(0.0f, std::min(length, 1.0f));
+
+	// before the first update, the length is applied by the allocation
+	if (_strip.valid()) {
+		applyLength();
+	}
+}
+
+
+/**
+ * \brief Write the length of the trails into the drawn range of the quad-strip and the uniform.
+ */
+void TrailSystem::applyLength() {
+	// at least two samples are drawn, the older ones are skipped by the draw-call
+	unsigned int drawn = std::max(static_cast<unsigned int>(_length * _numSamples + 0.5f), 2u);
+	unsigned int oldest = _numSamples - std::min(drawn, _numSamples);
+
+	_strip->setFirst(2 * oldest);
+	_strip->setCount(2 * (_numSamples - oldest));
+	_strip->dirty();
+	_oldestUniform->set(static_cast<int>(oldest));
+}
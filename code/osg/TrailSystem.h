@@ -0,0 +1,247 @@
+﻿/**
+ * \brief Functionality for drawing the following-ribbons of all space-objects with one draw-call.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-22
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Texture2D>
+#include <osg/TextureBuffer>
+#include <osg/Uniform>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief TrailSystem replaces the separate FollowingRibbon of each space-object by one shared trail-system.
+	 * The positions of all trails are stored in a history-texture (one band of rows per sample, one texel per trail),
+	 * which is used as a ring-buffer: Once per frame, the current positions are written into the oldest band and only
+	 * this band is uploaded. The trails are drawn as one instanced quad-strip (one instance per trail), the vertex-shader
+	 * reads the samples, faces the ribbons to the camera and fades them by their age (see TrailShader).
+	 */
+	class TrailSystem {
+	public:
+
+		/**
+		 * \brief Singleton instance of the TrailSystem-class.
+		 */
+		static TrailSystem* Instance();
+
+
+		/**
+		 * \brief Add the trail of an object (has to be done before the first frame).
+		 *
+		 * \param position
+		 *      Initial position of the object.
+		 * \param color
+		 *      Color of the trail.
+		 * \param numSamples
+		 *      Number of samples of the trail. Higher value => longer trail.
+		 * \param halfWidth
+		 *      Width of the trail.
+		 *
+		 * \return Index of the trail.
+		 */
+		unsigned int addTrail(const osg::Vec3 &position, const osg::Vec3 &color, unsigned int numSamples, float halfWidth);
+
+
+		/**
+		 * \brief Set the current position of a trail (it's sampled at the next update).
+		 *
+		 * \param trail
+		 *      Index of the trail.
+		 * \param position
+		 *      Position of the object.
+		 */
+		void setPosition(unsigned int trail, const osg::Vec3 &position) {
+			_positions[trail] = position;
+		}
+
+
+		/**
+		 * \brief Write the current positions of all trails as the newest sample (called once per frame by the
+		 * update-callback of the root).
+		 */
+		void update();
+
+
+		/**
+		 * \brief Upload the samples which have been written since the last call (called by the texture before it's used).
+		 *
+		 * \param state
+		 *      State of the current context (the samples are uploaded through its UploadRing).
+		 */
+		void uploadSamples(osg::State &state) const;
+
+
+		/**
+		 * \brief Get the node which draws all trails.
+		 *
+		 * \return Root of the trails.
+		 */
+		osg::ref_ptr<osg::Geode> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Get the bounding-box of all samples which have been written (grows only).
+		 *
+		 * \return Bounding-box in the world-space.
+		 */
+		const osg::BoundingBox& getBound() const {
+			return _bound;
+		}
+
+
+		/**
+		 * \brief Enable or disable the shared trail-system (if disabled, each object has its own FollowingRibbon). Has
+		 *        to be set before loading the scene.
+		 *
+		 * \param isEnabled
+		 *      True if all trails are drawn with one draw-call.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the shared trail-system is enabled.
+		 *
+		 * \return True if all trails are drawn with one draw-call.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+		/**
+		 * \brief Shorten all trails to their newest samples (e.g. by the FrameGovernor), the shortened trails are
+		 *        faded over their drawn samples and only those are drawn.
+		 *
+		 * \param length
+		 *      Fraction of the samples which are drawn (1 => whole trails).
+		 */
+		void setLength(float length);
+
+
+		/**
+		 * \brief Get the fraction of the samples which are drawn.
+		 *
+		 * \return Length of the trails (1 => whole trails).
+		 */
+		float getLength() const {
+			return _length;
+		}
+
+
+		/**
+		 * \brief Freeze all trails (e.g. during the fast-forward), so no segments are drawn across the skipped steps.
+		 *        The trails restart at the current positions once they are not frozen anymore. Applies to the shared
+		 *        trail-system and to the own ribbons of the objects.
+		 *
+		 * \param isFrozen
+		 *      True if no samples are written.
+		 */
+		static void setIsFrozen(bool isFrozen) {
+			IS_FROZEN = isFrozen;
+		}
+
+
+		/**
+		 * \brief Get if the trails are frozen.
+		 *
+		 * \return True if no samples are written.
+		 */
+		static bool getIsFrozen() {
+			return IS_FROZEN;
+		}
+
+
+	private:
+
+		//! Maximal width of the history-texture (the trails wrap into several rows)
+		static const unsigned int MAX_WIDTH;
+
+		//! True if all trails are drawn with one draw-call
+		static bool IS_ENABLED;
+
+		//! True if no samples are written (see setIsFrozen())
+		static bool IS_FROZEN;
+		//! True if the trails were frozen since the last update (the history is reset to the current positions)
+		bool _wasFrozen = false;
+
+		//! Current position of each trail
+		std::vector<osg::Vec3f> _positions;
+
+		//! Color and half-width (first texel), number of samples (second texel) of each trail
+		std::vector<osg::Vec4f> _parameters;
+
+		//! Samples of all trails (band k contains the sample k of all trails)
+		std::vector<osg::Vec3f> _history;
+
+		//! Samples which have been written since the last upload
+		mutable std::vector<unsigned int> _dirtySamples;
+
+		//! Number of samples in the ring-buffer (the maximal number of samples of the trails)
+		unsigned int _numSamples = 2;
+		//! Width and height of a band of the history-texture
+		unsigned int _width = 0, _height = 0;
+		//! Index of the newest sample
+		unsigned int _head = 0;
+		//! Fraction of the samples which are drawn
+		float _length = 1.0f;
+
+		//! Bounding-box of all samples which have been written
+		osg::BoundingBox _bound;
+
+		//! Root which draws the trails
+		osg::ref_ptr<osg::Geode> _root;
+		//! Instanced quad-strip of the trails
+		osg::ref_ptr<osg::Geometry> _geometry;
+		//! Texture of the samples
+		osg::ref_ptr<osg::Texture2D> _historyTexture;
+		//! Image of the parameters of the trails
+		osg::ref_ptr<osg::Image> _parametersImage;
+		//! Texture-buffer of the parameters of the trails
+		osg::ref_ptr<osg::TextureBuffer> _parametersBuffer;
+		//! Index of the newest sample for the shader
+		osg::ref_ptr<osg::Uniform> _headUniform;
+		//! Index of the oldest drawn sample for the shader (see setLength())
+		osg::ref_ptr<osg::Uniform> _oldestUniform;
+		//! Drawn samples of the quad-strip
+		osg::ref_ptr<osg::DrawArrays> _strip;
+
+
+		/**
+		 * \brief Allocate the history, the textures and the geometry for all added trails (at the first update).
+		 */
+		void allocate();
+
+
+		/**
+		 * \brief Write the length of the trails into the drawn range of the quad-strip and the uniform.
+		 */
+		void applyLength();
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		TrailSystem();
+
+		//! Private copy-constructor to prevent copying the class.
+		TrailSystem(TrailSystem const&) {}
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		TrailSystem& operator=(TrailSystem const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static TrailSystem* _pInstance;
+	};
+}
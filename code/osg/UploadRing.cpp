@@ -0,0 +1,237 @@
+﻿/**
+ * \brief Functionality for uploading the per-frame data of the dynamic producers through a persistent-mapped ring.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "UploadRing.h"
+
+#include <cstring>
+
+#include <osg/FrameStamp>
+#include <osg/GLExtensions>
+
+#include "../physics/Logger.h"
+
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_COPY_READ_BUFFER
+#define GL_COPY_READ_BUFFER 0x8F36
+#endif
+#ifndef GL_COPY_WRITE_BUFFER
+#define GL_COPY_WRITE_BUFFER 0x8F37
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+
+using namespace pbs17;
+
+
+//! Pointer to the only instance of this class.
+UploadRing* UploadRing::_pInstance = nullptr;
+
+//! The dynamic data is uploaded from the client-memory by default.
+bool UploadRing::IS_ENABLED = false;
+//! A frame of the trails, the particles and the debug-boxes of a large scene
+GLsizeiptr UploadRing::REGION_SIZE = 4 * 1024 * 1024;
+
+
+/**
+ * \brief Singleton instance of the UploadRing-class.
+ */
+UploadRing* UploadRing::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new UploadRing();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Upload a part of the bound 2D-texture through the ring (same parameters as glTexSubImage2D).
+ *
+ * \param state
+ *      State of the current context.
+ * \param x, y, width, height
+ *      Uploaded rectangle of the first mipmap-level.
+ * \param format, type
+ *      Format of the pixels.
+ * \param pixels
+ *      Pixels of the rectangle.
+ * \param size
+ *      Size of the pixels in bytes.
+ *
+ * \return False if the pixels have to be uploaded from the client-memory.
+ */
+bool UploadRing::texSubImage2D(osg::State &state, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type,
+	const void* pixels, GLsizeiptr size) {
+	GLintptr offset;
+	if (!write(state, pixels, size, offset)) return false;
+
+	const Context &context = _contexts[state.getContextID()];
+	osg::GLExtensions* extensions = state.get<osg::GLExtensions>();
+
+	// the pixels are read from the ring by the GPU (the pointer is the offset within the bound unpack-buffer)
+	extensions->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, context.buffer);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, type, reinterpret_cast<const void*>(offset));
+	extensions->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	return true;
+}
+
+
+/**
+ * \brief Upload a range of a buffer-object through the ring.
+ *
+ * \param state
+ *      State of the current context.
+ * \param buffer
+ *      Name of the buffer-object.
+ * \param offset
+ *      Offset of the range within the buffer-object in bytes.
+ * \param data
+ *      Data of the range.
+ * \param size
+ *      Size of the range in bytes.
+ *
+ * \return False if the range has to be uploaded from the client-memory.
+ */
+bool UploadRing::bufferSubData(osg::State &state, GLuint buffer, GLintptr offset, const void* data, GLsizeiptr size) {
+	GLintptr ringOffset;
+	if (!write(state, data, size, ringOffset)) return false;
+
+	const Context &context = _contexts[state.getContextID()];
+	osg::GLExtensions* extensions = state.get<osg::GLExtensions>();
+
+	// the copy-targets do not disturb the bindings of the vertex-arrays which are tracked by the state
+	extensions->glBindBuffer(GL_COPY_READ_BUFFER, context.buffer);
+	extensions->glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	context.glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, ringOffset, offset, size);
+	extensions->glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	extensions->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	return true;
+}
+
+
+/**
+ * \brief Copy the data into the region of the current frame (the first write of a frame fences the previous
+ *        region and waits for the next one).
+ *
+ * \param state
+ *      State of the current context.
+ * \param data
+ *      Data to upload.
+ * \param size
+ *      Size of the data in bytes.
+ * \param offset
+ *      Output-parameter: Offset of the copy within the ring.
+ *
+ * \return False if the ring can't be used or the region is full.
+ */
+bool UploadRing::write(osg::State &state, const void* data, GLsizeiptr size, GLintptr &offset) {
+	if (!IS_ENABLED) return false;
+
+	Context &context = _contexts[state.getContextID()];
+	if (!context.isInitialized) {
+		initialize(state, context);
+	}
+	if (!context.isSupported) return false;
+
+	unsigned int frameNumber = state.getFrameStamp() ? state.getFrameStamp()->getFrameNumber() : 0;
+	if (frameNumber != context.frameNumber) {
+		// the copies of the previous frame are fenced, the region of this frame was last used CNT_REGIONS frames ago
+		if (context.head > 0) {
+			context.fences[context.region] = context.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			context.region = (context.region + 1) % CNT_REGIONS;
+		}
+
+		Sync &fence = context.fences[context.region];
+		if (fence) {
+			while (context.glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+			context.glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		context.head = 0;
+		context.frameNumber = frameNumber;
+	}
+
+	// the offsets stay aligned for any of the texel-formats
+	GLsizeiptr aligned = (context.head + 15) & ~static_cast<GLsizeiptr>(15);
+	if (aligned + size > REGION_SIZE) return false;
+
+	offset = context.region * REGION_SIZE + aligned;
+	std::memcpy(context.mapped + offset, data, size);
+	context.head = aligned + size;
+
+	return true;
+}
+
+
+/**
+ * \brief Create and map the ring of a context.
+ *
+ * \param state
+ *      State of the context.
+ * \param context
+ *      Ring of the context.
+ */
+void UploadRing::initialize(osg::State &state, Context &context) const {
+	context.isInitialized = true;
+
+	unsigned int contextID = state.getContextID();
+	if (!osg::isGLExtensionOrVersionSupported(contextID, "GL_ARB_buffer_storage", 4.4f) ||
+		!osg::isGLExtensionOrVersionSupported(contextID, "GL_ARB_copy_buffer", 3.1f) ||
+		!osg::isGLExtensionOrVersionSupported(contextID, "GL_ARB_sync", 3.2f)) {
+		LOG_WARNING("The upload-ring needs GL_ARB_buffer_storage, the dynamic data is uploaded from the client-memory.");
+		return;
+	}
+
+	osg::setGLExtensionFuncPtr(context.glBufferStorage, "glBufferStorage", "glBufferStorageARB");
+	osg::setGLExtensionFuncPtr(context.glMapBufferRange, "glMapBufferRange", "glMapBufferRangeARB");
+	osg::setGLExtensionFuncPtr(context.glCopyBufferSubData, "glCopyBufferSubData", "glCopyBufferSubDataARB");
+	osg::setGLExtensionFuncPtr(context.glFenceSync, "glFenceSync", "glFenceSyncARB");
+	osg::setGLExtensionFuncPtr(context.glClientWaitSync, "glClientWaitSync", "glClientWaitSyncARB");
+	osg::setGLExtensionFuncPtr(context.glDeleteSync, "glDeleteSync", "glDeleteSyncARB");
+	if (!context.glBufferStorage || !context.glMapBufferRange || !context.glCopyBufferSubData ||
+		!context.glFenceSync || !context.glClientWaitSync || !context.glDeleteSync) {
+		return;
+	}
+
+	// one immutable buffer for all regions, mapped until the context is destroyed (the writes are coherent)
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = CNT_REGIONS * REGION_SIZE;
+	osg::GLExtensions* extensions = state.get<osg::GLExtensions>();
+
+	extensions->glGenBuffers(1, &context.buffer);
+	extensions->glBindBuffer(GL_COPY_READ_BUFFER, context.buffer);
+	context.glBufferStorage(GL_COPY_READ_BUFFER, size, nullptr, flags);
+	context.mapped = static_cast<unsigned char*>(context.glMapBufferRange(GL_COPY_READ_BUFFER, 0, size, flags));
+	extensions->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	context.isSupported = context.mapped != nullptr;
+	if (!context.isSupported) {
+		LOG_WARNING("The upload-ring can't be mapped, the dynamic data is uploaded from the client-memory.");
+	}
+}
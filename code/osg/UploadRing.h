@@ -0,0 +1,201 @@
+﻿/**
+ * \brief Functionality for uploading the per-frame data of the dynamic producers through a persistent-mapped ring.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <osg/GL>
+#include <osg/State>
+#include <osg/buffered_value>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief UploadRing is a buffer per context which stays mapped (GL_ARB_buffer_storage), split into one region per
+	 * frame in flight. The producers which change their data every frame (trails, particles, ribbons, debug-geometry)
+	 * copy it into the region of the current frame, and the GPU pulls it into the texture (unpack-buffer) or the
+	 * buffer-object (copy-buffer) without a synchronous upload from the client-memory. The region of a frame is
+	 * fenced once the next frame starts writing, and it's only written again after its fence has passed (a stall
+	 * happens only if the GPU is more than CNT_REGIONS frames behind).
+	 * If the ring is disabled, not supported or the region is full, the producers upload from the client-memory as before.
+	 * Has to be used by the draw-thread of the context only.
+	 */
+	class UploadRing {
+	public:
+
+		/**
+		 * \brief Singleton instance of the UploadRing-class.
+		 */
+		static UploadRing* Instance();
+
+
+		/**
+		 * \brief Upload a part of the bound 2D-texture through the ring (same parameters as glTexSubImage2D).
+		 *
+		 * \param state
+		 *      State of the current context.
+		 * \param x, y, width, height
+		 *      Uploaded rectangle of the first mipmap-level.
+		 * \param format, type
+		 *      Format of the pixels.
+		 * \param pixels
+		 *      Pixels of the rectangle.
+		 * \param size
+		 *      Size of the pixels in bytes.
+		 *
+		 * \return False if the pixels have to be uploaded from the client-memory.
+		 */
+		bool texSubImage2D(osg::State &state, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type,
+			const void* pixels, GLsizeiptr size);
+
+
+		/**
+		 * \brief Upload a range of a buffer-object through the ring.
+		 *
+		 * \param state
+		 *      State of the current context.
+		 * \param buffer
+		 *      Name of the buffer-object.
+		 * \param offset
+		 *      Offset of the range within the buffer-object in bytes.
+		 * \param data
+		 *      Data of the range.
+		 * \param size
+		 *      Size of the range in bytes.
+		 *
+		 * \return False if the range has to be uploaded from the client-memory.
+		 */
+		bool bufferSubData(osg::State &state, GLuint buffer, GLintptr offset, const void* data, GLsizeiptr size);
+
+
+		/**
+		 * \brief Enable or disable the ring. Has to be set before the first frame.
+		 *
+		 * \param isEnabled
+		 *      True if the dynamic data is uploaded through the ring.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the ring is enabled.
+		 *
+		 * \return True if the dynamic data is uploaded through the ring.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+		/**
+		 * \brief Set the size of the region of a frame. Has to be set before the first frame.
+		 *
+		 * \param size
+		 *      Size of a region in bytes.
+		 */
+		static void setRegionSize(GLsizeiptr size) {
+			REGION_SIZE = size;
+		}
+
+
+	private:
+		//! Handle of a fence (GLsync)
+		typedef struct __GLsync* Sync;
+
+		typedef void (GL_APIENTRY * BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+		typedef void* (GL_APIENTRY * MapBufferRangeProc)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+		typedef void (GL_APIENTRY * CopyBufferSubDataProc)(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size);
+		typedef Sync (GL_APIENTRY * FenceSyncProc)(GLenum condition, GLbitfield flags);
+		typedef GLenum (GL_APIENTRY * ClientWaitSyncProc)(Sync sync, GLbitfield flags, unsigned long long timeout);
+		typedef void (GL_APIENTRY * DeleteSyncProc)(Sync sync);
+
+		//! Number of frames in flight
+		static const unsigned int CNT_REGIONS = 3;
+
+		/**
+		 * \brief Ring of a context.
+		 */
+		struct Context {
+			//! True if the ring has been created (or creating it has failed)
+			bool isInitialized = false;
+			//! True if the ring can be used
+			bool isSupported = false;
+
+			//! Name and mapping of the ring
+			GLuint buffer = 0;
+			unsigned char* mapped = nullptr;
+
+			//! Fence after the last use of each region
+			Sync fences[CNT_REGIONS] = {};
+			//! Region of the current frame and the next free byte in it
+			unsigned int region = 0;
+			GLsizeiptr head = 0;
+			//! Frame of the last write
+			unsigned int frameNumber = 0;
+
+			//! Entry-points which are not part of every version of the GLExtensions of OSG
+			BufferStorageProc glBufferStorage = nullptr;
+			MapBufferRangeProc glMapBufferRange = nullptr;
+			CopyBufferSubDataProc glCopyBufferSubData = nullptr;
+			FenceSyncProc glFenceSync = nullptr;
+			ClientWaitSyncProc glClientWaitSync = nullptr;
+			DeleteSyncProc glDeleteSync = nullptr;
+		};
+
+		//! True if the dynamic data is uploaded through the ring
+		static bool IS_ENABLED;
+		//! Size of the region of a frame in bytes
+		static GLsizeiptr REGION_SIZE;
+
+		//! Ring per context
+		osg::buffered_object<Context> _contexts;
+
+
+		/**
+		 * \brief Copy the data into the region of the current frame (the first write of a frame fences the previous
+		 *        region and waits for the next one).
+		 *
+		 * \param state
+		 *      State of the current context.
+		 * \param data
+		 *      Data to upload.
+		 * \param size
+		 *      Size of the data in bytes.
+		 * \param offset
+		 *      Output-parameter: Offset of the copy within the ring.
+		 *
+		 * \return False if the ring can't be used or the region is full.
+		 */
+		bool write(osg::State &state, const void* data, GLsizeiptr size, GLintptr &offset);
+
+
+		/**
+		 * \brief Create and map the ring of a context.
+		 *
+		 * \param state
+		 *      State of the context.
+		 * \param context
+		 *      Ring of the context.
+		 */
+		void initialize(osg::State &state, Context &context) const;
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		UploadRing() {}
+
+		//! Private copy-constructor to prevent copying the class.
+		UploadRing(UploadRing const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		UploadRing& operator=(UploadRing const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static UploadRing* _pInstance;
+	};
+}
@@ -9,6 +9,7 @@
 
 #include "../../physics/SimulationManager.h"
 #include "../../scene/SpaceShip.h"
+#include "../DebugOverlay.h"
 
 
 using namespace pbs17;
@@ -21,10 +22,13 @@ bool GameKeyboardHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIAct
 		case osgGA::GUIEventAdapter::KEY_B:
 		{
 			_showBoundingBox = !_showBoundingBox;
+			DebugOverlay::Instance()->setIsVisible(_showBoundingBox);
 
-			for (auto it = _objects.begin(); it != _objects.end(); ++it) {
-				osg::ref_ptr<osg::Switch> bbSwitch = (*it)->getModel();
-				bbSwitch->setValue(1, _showBoundingBox);
+			// the boxes are not written while hidden => write the current boxes of all objects at the next sync
+			if (_showBoundingBox) {
+				for (auto it = _objects.begin(); it != _objects.end(); ++it) {
+					(*it)->setTransformationDirty();
+				}
 			}
 
 			return true;
@@ -35,9 +39,7 @@ bool GameKeyboardHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIAct
 			_showConvexHull = !_showConvexHull;
 
 			for (auto it = _objects.begin(); it != _objects.end(); ++it) {
-				osg::ref_ptr<osg::Switch> bbSwitch = (*it)->getConvexSwitch();
-				bbSwitch->setValue(0, !_showConvexHull);
-				bbSwitch->setValue(1, _showConvexHull);
+				(*it)->showConvexHull(_showConvexHull);
 			}
 
 			return true;
@@ -46,64 +48,69 @@ bool GameKeyboardHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIAct
 		{
 			_isPaused = !_isPaused;
 
-			SimulationManager::setIsPaused(_isPaused);
+			if (_simulationManager) {
+				_simulationManager->setIsPaused(_isPaused);
+			}
 
 			return true;
 		}
 		case osgGA::GUIEventAdapter::KEY_Plus:
 		case osgGA::GUIEventAdapter::KEY_KP_Add:
 		{
-			SimulationManager::increaseSimulationDt(0.01);
+			if (_simulationManager) {
+				_simulationManager->increaseSimulationDt(0.01);
+			}
 
 			return true;
 		}
 		case osgGA::GUIEventAdapter::KEY_Minus:
 		case osgGA::GUIEventAdapter::KEY_KP_Subtract:
 		{
-			SimulationManager::decreaseSimulationDt(0.01);
+			if (_simulationManager) {
+				_simulationManager->decreaseSimulationDt(0.01);
+			}
 
 			return true;
 		}
 		case osgGA::GUIEventAdapter::KEY_Up:
 		case osgGA::GUIEventAdapter::KEY_KP_Up:
-		{
-			_player->turnUp();
-
-			return true;
-		}
+			return setControl(SimulationManager::TURN_UP, true);
 		case osgGA::GUIEventAdapter::KEY_Down:
 		case osgGA::GUIEventAdapter::KEY_KP_Down:
-		{
-			_player->turnDown();
-
-			return true;
-		}
+			return setControl(SimulationManager::TURN_DOWN, true);
 		case osgGA::GUIEventAdapter::KEY_Left:
 		case osgGA::GUIEventAdapter::KEY_KP_Left:
-		{
-			_player->turnLeft();
-
-			return true;
-		}
+			return setControl(SimulationManager::TURN_LEFT, true);
 		case osgGA::GUIEventAdapter::KEY_Right:
 		case osgGA::GUIEventAdapter::KEY_KP_Right:
-		{
-			_player->turnRight();
-
-			return true;
-		}
+			return setControl(SimulationManager::TURN_RIGHT, true);
 		case osgGA::GUIEventAdapter::KEY_W:
-		{
-			_player->accelerate();
-
-			return true;
-		}
+			return setControl(SimulationManager::ACCELERATE, true);
 		case osgGA::GUIEventAdapter::KEY_S:
-		{
-			_player->decelerate();
-
-			return true;
+			return setControl(SimulationManager::DECELERATE, true);
+		default:
+			return false;
 		}
+	}
+	case osgGA::GUIEventAdapter::KEYUP:
+	{
+		switch (ea.getKey()) {
+		case osgGA::GUIEventAdapter::KEY_Up:
+		case osgGA::GUIEventAdapter::KEY_KP_Up:
+			return setControl(SimulationManager::TURN_UP, false);
+		case osgGA::GUIEventAdapter::KEY_Down:
+		case osgGA::GUIEventAdapter::KEY_KP_Down:
+			return setControl(SimulationManager::TURN_DOWN, false);
+		case osgGA::GUIEventAdapter::KEY_Left:
+		case osgGA::GUIEventAdapter::KEY_KP_Left:
+			return setControl(SimulationManager::TURN_LEFT, false);
+		case osgGA::GUIEventAdapter::KEY_Right:
+		case osgGA::GUIEventAdapter::KEY_KP_Right:
+			return setControl(SimulationManager::TURN_RIGHT, false);
+		case osgGA::GUIEventAdapter::KEY_W:
+			return setControl(SimulationManager::ACCELERATE, false);
+		case osgGA::GUIEventAdapter::KEY_S:
+			return setControl(SimulationManager::DECELERATE, false);
 		default:
 			return false;
 		}
@@ -112,4 +119,28 @@ bool GameKeyboardHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::GUIAct
 	default:
 		return false;
 	}
+}
+
+
+/**
+ * \brief Queue the changed control of the player into the simulation (sampled by every step).
+ *
+ * \param control
+ *      Control of the pressed or released key.
+ * \param isHeld
+ *      True if the key is pressed.
+ *
+ * \return True (the key is handled).
+ */
+bool GameKeyboardHandler::setControl(SimulationManager::PlayerControl control, bool isHeld) {
+	// the key-repeat sends the press again => only the changes are queued, a full queue is retried by the next event
+	if (_simulationManager && _heldControls[control] != isHeld) {
+		SimulationManager::InputCommand command = { control, isHeld };
+
+		if (_simulationManager->queueInput(command)) {
+			_heldControls[control] = isHeld;
+		}
+	}
+
+	return true;
 }
\ No newline at end of file
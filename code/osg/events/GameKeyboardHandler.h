@@ -8,6 +8,7 @@
 #pragma once
 
 #include "KeyboardHandler.h"
+#include "../../physics/SimulationManager.h"
 
 
 // Forward deklarations
@@ -27,6 +28,20 @@ namespace pbs17 {
 
 	private:
 
+		/**
+		 * \brief Queue the changed control of the player into the simulation (sampled by every step).
+		 *
+		 * \param control
+		 *      Control of the pressed or released key.
+		 * \param isHeld
+		 *      True if the key is pressed.
+		 *
+		 * \return True (the key is handled).
+		 */
+		bool setControl(SimulationManager::PlayerControl control, bool isHeld);
+
 		SpaceShip *_player;
+		//! Held controls which have been queued (the key-repeat does not queue them again)
+		bool _heldControls[SimulationManager::CNT_CONTROLS] = {};
 	};
 }
\ No newline at end of file
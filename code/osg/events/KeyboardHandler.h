@@ -13,6 +13,7 @@
 // Forward declarations
 namespace pbs17 {
 	class SpaceObject;
+	class SimulationManager;
 }
 
 
@@ -29,9 +30,15 @@ namespace pbs17 {
 			_objects = objects;
 		}
 
+		void setSimulationManager(SimulationManager* simulationManager) {
+			_simulationManager = simulationManager;
+		}
+
 	protected:
 
 		std::vector<SpaceObject*> _objects;
+		//! Simulation which is paused and stepped by the keys (nullptr => none)
+		SimulationManager* _simulationManager = nullptr;
 
 		bool _showBoundingBox;
 		bool _showConvexHull;
@@ -7,8 +7,14 @@
 
 #include "SimulationKeyboardHandler.h"
 
+#include "../../physics/Logger.h"
+#include "../../physics/MemoryTracker.h"
 #include "../../physics/SimulationManager.h"
+#include "../../physics/TrajectoryPlayer.h"
 #include "../../scene/SpaceObject.h"
+#include "../DebugOverlay.h"
+#include "../StatsOverlay.h"
+#include "../TrailSystem.h"
 
 using namespace pbs17;
 	
@@ -20,10 +26,14 @@ bool SimulationKeyboardHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::
 		case osgGA::GUIEventAdapter::KEY_B:
 		{
 			_showBoundingBox = !_showBoundingBox;
+			// the boxes are hidden during the fast-forward (see KEY_F)
+			DebugOverlay::Instance()->setIsVisible(_showBoundingBox && !(_simulationManager && _simulationManager->getIsFastForward()));
 
-			for (auto it = _objects.begin(); it != _objects.end(); ++it) {
-				osg::ref_ptr<osg::Switch> bbSwitch = (*it)->getModel();
-				bbSwitch->setValue(1, _showBoundingBox);
+			// the boxes are not written while hidden => write the current boxes of all objects at the next sync
+			if (_showBoundingBox) {
+				for (auto it = _objects.begin(); it != _objects.end(); ++it) {
+					(*it)->setTransformationDirty();
+				}
 			}
 
 			return true;
@@ -34,9 +44,7 @@ bool SimulationKeyboardHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::
 			_showConvexHull = !_showConvexHull;
 
 			for (auto it = _objects.begin(); it != _objects.end(); ++it) {
-				osg::ref_ptr<osg::Switch> bbSwitch = (*it)->getConvexSwitch();
-				bbSwitch->setValue(0, !_showConvexHull);
-				bbSwitch->setValue(1, _showConvexHull);
+				(*it)->showConvexHull(_showConvexHull);
 			}
 
 			return true;
@@ -45,21 +53,112 @@ bool SimulationKeyboardHandler::handle(const osgGA::GUIEventAdapter& ea, osgGA::
 		{
 			_isPaused = !_isPaused;
 
-			SimulationManager::setIsPaused(_isPaused);
+			if (_simulationManager) {
+				_simulationManager->setIsPaused(_isPaused);
+			}
+			TrajectoryPlayer::Instance()->setIsPaused(_isPaused);
+
+			return true;
+		}
+		case osgGA::GUIEventAdapter::KEY_F:
+		{
+			// fast-forward: as many steps as fit the budget per frame, only the newest state is rendered
+			if (!_simulationManager) return false;
+
+			bool isFastForward = !_simulationManager->getIsFastForward();
+			_simulationManager->setIsFastForward(isFastForward);
+
+			// the trails and the boxes are not written during the burst
+			TrailSystem::setIsFrozen(isFastForward);
+			DebugOverlay::Instance()->setIsVisible(_showBoundingBox && !isFastForward);
+			if (_showBoundingBox && !isFastForward) {
+				for (auto it = _objects.begin(); it != _objects.end(); ++it) {
+					(*it)->setTransformationDirty();
+				}
+			}
+
+			LOG_INFO("Fast-forward " << (isFastForward ? "enabled" : "disabled"));
+
+			return true;
+		}
+		case osgGA::GUIEventAdapter::KEY_K:
+		{
+			// written by the simulation after the current step (see --checkpoint)
+			if (_simulationManager) {
+				_simulationManager->requestCheckpoint();
+			}
+
+			return true;
+		}
+		case osgGA::GUIEventAdapter::KEY_R:
+		{
+			// back by one keyframe, done by the simulation before the next step (see --rewindInterval)
+			if (!_simulationManager || _simulationManager->getRewindInterval() == 0) return false;
+
+			_simulationManager->requestRewind(_simulationManager->getRewindInterval());
+
+			return true;
+		}
+		case osgGA::GUIEventAdapter::KEY_T:
+		{
+			// percentiles of the timing per phase
+			StatsOverlay::Instance()->toggle();
+
+			return true;
+		}
+		case osgGA::GUIEventAdapter::KEY_M:
+		{
+			// memory per subsystem
+			LOG_INFO(MemoryTracker::getReport());
 
 			return true;
 		}
 		case osgGA::GUIEventAdapter::KEY_Plus:
 		case osgGA::GUIEventAdapter::KEY_KP_Add:
 		{
-			SimulationManager::increaseSimulationDt(0.01);
+			if (_simulationManager) {
+				_simulationManager->increaseSimulationDt(0.01);
+			}
 
 			return true;
 		}
 		case osgGA::GUIEventAdapter::KEY_Minus:
 		case osgGA::GUIEventAdapter::KEY_KP_Subtract:
 		{
-			SimulationManager::decreaseSimulationDt(0.01);
+			if (_simulationManager) {
+				_simulationManager->decreaseSimulationDt(0.01);
+			}
+
+			return true;
+		}
+		case osgGA::GUIEventAdapter::KEY_Left:
+		case osgGA::GUIEventAdapter::KEY_Right:
+		{
+			// seek the replay by 5% of the recording
+			TrajectoryPlayer* player = TrajectoryPlayer::Instance();
+			if (!player->isLoaded()) return false;
+
+			player->seek(ea.getKey() == osgGA::GUIEventAdapter::KEY_Right ? 0.05 : -0.05);
+
+			return true;
+		}
+		case osgGA::GUIEventAdapter::KEY_Up:
+		case osgGA::GUIEventAdapter::KEY_Down:
+		{
+			// double or halve the speed of the replay
+			TrajectoryPlayer* player = TrajectoryPlayer::Instance();
+			if (!player->isLoaded()) return false;
+
+			player->scaleSpeed(ea.getKey() == osgGA::GUIEventAdapter::KEY_Up ? 2.0 : 0.5);
+
+			return true;
+		}
+		case osgGA::GUIEventAdapter::KEY_Home:
+		{
+			TrajectoryPlayer* player = TrajectoryPlayer::Instance();
+			if (!player->isLoaded()) return false;
+
+			player->rewind();
 
 			return true;
 		}
@@ -0,0 +1,325 @@
+﻿/**
+ * \brief Functionality for simulating and drawing all particles (exhaust, dust and debris) on the GPU.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "GpuParticleSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <osg/NodeCallback>
+#include <osg/State>
+#include <osg/FrameStamp>
+#include <osgUtil/CullVisitor>
+#include <OpenThreads/ScopedLock>
+
+#include "../../config.h"
+#include "../Loader.h"
+#include "../UploadRing.h"
+#include "../shaders/ParticleShader.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Spawns the particles once per frame.
+	 */
+	class ParticleUpdateCallback : public osg::NodeCallback {
+	public:
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			if (nv->getFrameStamp()) {
+				GpuParticleSystem::Instance()->update(nv->getFrameStamp()->getSimulationTime());
+			}
+
+			traverse(node, nv);
+		}
+	};
+
+
+	/**
+	 * \brief Updates the height of the viewport for the size of the sprites.
+	 */
+	class ParticleCullCallback : public osg::NodeCallback {
+	public:
+		ParticleCullCallback(osg::ref_ptr<osg::Uniform> viewportHeight) : _viewportHeight(viewportHeight) {}
+
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+
+			if (cv) {
+				_viewportHeight->set(static_cast<float>(cv->getViewport()->height()));
+			}
+
+			traverse(node, nv);
+		}
+
+	private:
+		osg::ref_ptr<osg::Uniform> _viewportHeight;
+	};
+
+
+	/**
+	 * \brief Allocates the texture of the records and uploads only the written rows.
+	 */
+	class RecordsSubloadCallback : public osg::Texture2D::SubloadCallback {
+	public:
+		void load(const osg::Texture2D &texture, osg::State &state) const override {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F_ARB, texture.getTextureWidth(), texture.getTextureHeight(), 0,
+				GL_RGBA, GL_FLOAT, nullptr);
+			GpuParticleSystem::Instance()->uploadRecords(state);
+		}
+
+		void subload(const osg::Texture2D &, osg::State &state) const override {
+			GpuParticleSystem::Instance()->uploadRecords(state);
+		}
+	};
+
+
+	/**
+	 * \brief The particles are bounded by all particles which have been emitted.
+	 */
+	class ParticleBoundCallback : public osg::Drawable::ComputeBoundingBoxCallback {
+	public:
+		osg::BoundingBox computeBound(const osg::Drawable &) const override {
+			return GpuParticleSystem::Instance()->getBound();
+		}
+	};
+}
+
+
+//! Pointer to the only instance of this class.
+GpuParticleSystem* GpuParticleSystem::_pInstance = nullptr;
+
+//! The GPU-particles are disabled by default (needs OpenGL 3.2).
+bool GpuParticleSystem::IS_ENABLED = false;
+
+//! Number of particles in the ring-buffer (~4 MB of records)
+const unsigned int GpuParticleSystem::CAPACITY = 65536;
+
+//! Number of particles per row of the records (a row is 4096 texels wide)
+const unsigned int GpuParticleSystem::PARTICLES_PER_ROW = 1024;
+
+
+/**
+ * \brief Singleton instance of the GpuParticleSystem-class.
+ */
+GpuParticleSystem* GpuParticleSystem::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new GpuParticleSystem();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Private constructor to be sure the class can't be created outside of this class.
+ */
+GpuParticleSystem::GpuParticleSystem() : _root(new osg::Geode) {
+	unsigned int cntRows = CAPACITY / PARTICLES_PER_ROW;
+
+	// the lifetime of the empty slots is 0 => they are discarded by the shader
+	_records.resize(4 * CAPACITY, osg::Vec4f(0.0f, 0.0f, 0.0f, 0.0f));
+	_isRowDirty.resize(cntRows, 1);
+	for (unsigned int row = 0; row < cntRows; ++row) {
+		_dirtyRows.push_back(row);
+	}
+
+	_recordsTexture = new osg::Texture2D;
+	_recordsTexture->setDataVariance(osg::Object::DYNAMIC);
+	_recordsTexture->setTextureSize(4 * PARTICLES_PER_ROW, cntRows);
+	_recordsTexture->setInternalFormat(GL_RGBA32F_ARB);
+	_recordsTexture->setFilter(osg::Texture::MIN_FILTER, osg::Texture::NEAREST);
+	_recordsTexture->setFilter(osg::Texture::MAG_FILTER, osg::Texture::NEAREST);
+	_recordsTexture->setSubloadCallback(new RecordsSubloadCallback);
+
+	// each point is a slot of the ring-buffer (the vertices are never changed)
+	osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array(CAPACITY);
+	for (unsigned int slot = 0; slot < CAPACITY; ++slot) {
+		(*vertices)[slot].set(static_cast<float>(slot), 0.0f, 0.0f);
+	}
+
+	_geometry = new osg::Geometry;
+	_geometry->setDataVariance(osg::Object::DYNAMIC);
+	_geometry->setUseDisplayList(false);
+	_geometry->setUseVertexBufferObjects(true);
+	_geometry->setVertexArray(vertices);
+	_geometry->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, CAPACITY));
+	_geometry->setComputeBoundingBoxCallback(new ParticleBoundCallback);
+	_root->addDrawable(_geometry);
+
+	_root->setDataVariance(osg::Object::DYNAMIC);
+	_root->setCullingActive(false);
+	_root->setUpdateCallback(new ParticleUpdateCallback);
+
+	osg::ref_ptr<osg::Uniform> viewportHeight = new osg::Uniform("viewportHeight", 1.0f);
+	viewportHeight->setDataVariance(osg::Object::DYNAMIC);
+	_root->setCullCallback(new ParticleCullCallback(viewportHeight));
+
+	_timeUniform = new osg::Uniform("time", 0.0f);
+	_timeUniform->setDataVariance(osg::Object::DYNAMIC);
+	ParticleShader shader(_recordsTexture, Loader::loadTexture(DATA_PATH + "/texture/dust.png"), _timeUniform, viewportHeight);
+	shader.apply(_root);
+}
+
+
+/**
+ * \brief Add a continuous emitter (e.g. the exhaust of a space-ship).
+ *
+ * \param emission
+ *      Parameters of the emitted particles.
+ * \param rate
+ *      Emitted particles per second.
+ *
+ * \return Index of the emitter.
+ */
+unsigned int GpuParticleSystem::addEmitter(const Emission &emission, float rate) {
+	Emitter emitter;
+	emitter.emission = emission;
+	emitter.lastPosition = emission.position;
+	emitter.rate = std::max(rate, 0.0f);
+	_emitters.push_back(emitter);
+
+	return _emitters.size() - 1;
+}
+
+
+/**
+ * \brief Move an emitter (the particles of the next update are spawned along the way).
+ *
+ * \param emitter
+ *      Index of the emitter.
+ * \param position
+ *      Position of the emitter.
+ * \param direction
+ *      Main direction of the particles.
+ */
+void GpuParticleSystem::setEmitter(unsigned int emitter, const osg::Vec3 &position, const osg::Vec3 &direction) {
+	_emitters[emitter].emission.position = position;
+	_emitters[emitter].emission.direction = direction;
+}
+
+
+/**
+ * \brief Emit a burst of particles at the next update (can be called by any thread, e.g. by the physics).
+ *
+ * \param emission
+ *      Parameters of the emitted particles.
+ * \param count
+ *      Number of particles.
+ */
+void GpuParticleSystem::emit(const Emission &emission, unsigned int count) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_burstMutex);
+	_bursts.push_back(std::make_pair(emission, count));
+}
+
+
+/**
+ * \brief Spawn the particles of the emitters and the bursts (called once per frame by the update-callback
+ * of the root).
+ *
+ * \param time
+ *      Simulation-time of the frame: unit = s
+ */
+void GpuParticleSystem::update(double time) {
+	double dt = _lastTime < 0.0 ? 0.0 : std::max(time - _lastTime, 0.0);
+
+	// the particles of a frame are spread over its time and the path of the emitter, so the streams stay continuous
+	for (unsigned int e = 0; e < _emitters.size(); ++e) {
+		Emitter &emitter = _emitters[e];
+		emitter.due += emitter.rate * _rateScale * dt;
+		unsigned int count = std::min(static_cast<unsigned int>(emitter.due), CAPACITY);
+		emitter.due -= std::floor(emitter.due);
+
+		for (unsigned int k = 0; k < count; ++k) {
+			float t = (k + 1.0f) / count;
+			osg::Vec3 position = emitter.lastPosition * (1.0f - t) + emitter.emission.position * t;
+			spawn(emitter.emission, position, time - dt * (1.0f - t));
+		}
+
+		emitter.lastPosition = emitter.emission.position;
+	}
+
+	std::vector<std::pair<Emission, unsigned int> > bursts;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_burstMutex);
+		bursts.swap(_bursts);
+	}
+
+	for (unsigned int b = 0; b < bursts.size(); ++b) {
+		unsigned int count = std::min(static_cast<unsigned int>(bursts[b].second * _rateScale + 0.5f), CAPACITY);
+		for (unsigned int k = 0; k < count; ++k) {
+			spawn(bursts[b].first, bursts[b].first.position, time);
+		}
+	}
+
+	_lastTime = time;
+	_timeUniform->set(static_cast<float>(time));
+
+	// the written rows are uploaded by the texture (see RecordsSubloadCallback)
+	if (!_dirtyRows.empty()) {
+		_geometry->dirtyBound();
+	}
+}
+
+
+/**
+ * \brief Upload the rows of the records which have been written since the last call (called by the texture
+ * before it's used).
+ *
+ * \param state
+ *      State of the current context (the rows are uploaded through its UploadRing).
+ */
+void GpuParticleSystem::uploadRecords(osg::State &state) const {
+	for (unsigned int i = 0; i < _dirtyRows.size(); ++i) {
+		unsigned int row = _dirtyRows[i];
+		const osg::Vec4f* texels = &_records[row * 4 * PARTICLES_PER_ROW];
+
+		if (!UploadRing::Instance()->texSubImage2D(state, 0, row, 4 * PARTICLES_PER_ROW, 1, GL_RGBA, GL_FLOAT,
+			texels, 4 * PARTICLES_PER_ROW * sizeof(osg::Vec4f))) {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, 4 * PARTICLES_PER_ROW, 1, GL_RGBA, GL_FLOAT, texels);
+		}
+		_isRowDirty[row] = 0;
+	}
+
+	_dirtyRows.clear();
+}
+
+
+/**
+ * \brief Write the record of a particle into the oldest slot.
+ *
+ * \param emission
+ *      Parameters of the particle.
+ * \param position
+ *      Position of the spawn.
+ * \param time
+ *      Time of the spawn: unit = s
+ */
+void GpuParticleSystem::spawn(const Emission &emission, const osg::Vec3 &position, double time) {
+	unsigned int slot = _head;
+	_head = (_head + 1) % CAPACITY;
+
+	// spawn (position, time), inherited velocity and lifetime, shot (direction * speed, spread), color and size
+	osg::Vec4f* record = &_records[4 * slot];
+	record[0].set(position.x(), position.y(), position.z(), static_cast<float>(time));
+	record[1].set(emission.velocity.x(), emission.velocity.y(), emission.velocity.z(), emission.lifetime);
+	osg::Vec3 shot = emission.direction * emission.speed;
+	record[2].set(shot.x(), shot.y(), shot.z(), emission.spread);
+	record[3].set(emission.color.x(), emission.color.y(), emission.color.z(), emission.size);
+
+	unsigned int row = slot / PARTICLES_PER_ROW;
+	if (!_isRowDirty[row]) {
+		_isRowDirty[row] = 1;
+		_dirtyRows.push_back(row);
+	}
+
+	float reach = (emission.velocity.length() + emission.speed) * emission.lifetime + emission.size;
+	_bound.expandBy(osg::BoundingSphere(position, reach));
+}
@@ -0,0 +1,271 @@
+﻿/**
+ * \brief Functionality for simulating and drawing all particles (exhaust, dust and debris) on the GPU.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Texture2D>
+#include <osg/Uniform>
+#include <OpenThreads/Mutex>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief GpuParticleSystem replaces the osgParticle-systems of the space-ships (see SmokeParticleSystem) by one
+	 * shared particle-system with a fixed capacity. The particles are stored as their spawn-records in a ring-buffer
+	 * texture: An emitted particle overwrites the oldest record and only the written rows are uploaded. The records are
+	 * never touched again by the CPU: The vertex-shader evaluates the motion, the fading and the growth of each
+	 * particle from the age since its spawn (see ParticleShader), the dead particles are discarded. So the CPU only
+	 * pays for the emitted particles, not for the living ones (no update, no sorting, additive blending).
+	 *
+	 * The particles are emitted by continuous emitters (the exhaust of the space-ships) and by bursts, which are
+	 * triggered by the events of the physics (collision-dust and fracture-debris, see SimulationManager).
+	 */
+	class GpuParticleSystem {
+	public:
+
+		/**
+		 * \brief Parameters of the emitted particles.
+		 */
+		struct Emission {
+			//! Position of the emission
+			osg::Vec3 position;
+			//! Velocity which is inherited by the particles
+			osg::Vec3 velocity;
+			//! Main direction of the particles (normalized)
+			osg::Vec3 direction = osg::Z_AXIS;
+			//! Speed of the particles along their direction: unit = m/s
+			float speed = 1.5f;
+			//! Half opening-angle of the cone around the direction: unit = rad (pi => all directions)
+			float spread = 0.157f;
+			//! Lifetime of the particles: unit = s
+			float lifetime = 15.0f;
+			//! Size of the particles at their spawn (doubles until their death): unit = m
+			float size = 0.2f;
+			//! Color of the particles at their spawn (fades to a transparent black)
+			osg::Vec3 color = osg::Vec3(1.0f, 1.0f, 1.0f);
+		};
+
+
+		/**
+		 * \brief Singleton instance of the GpuParticleSystem-class.
+		 */
+		static GpuParticleSystem* Instance();
+
+
+		/**
+		 * \brief Add a continuous emitter (e.g. the exhaust of a space-ship).
+		 *
+		 * \param emission
+		 *      Parameters of the emitted particles.
+		 * \param rate
+		 *      Emitted particles per second.
+		 *
+		 * \return Index of the emitter.
+		 */
+		unsigned int addEmitter(const Emission &emission, float rate);
+
+
+		/**
+		 * \brief Move an emitter (the particles of the next update are spawned along the way).
+		 *
+		 * \param emitter
+		 *      Index of the emitter.
+		 * \param position
+		 *      Position of the emitter.
+		 * \param direction
+		 *      Main direction of the particles.
+		 */
+		void setEmitter(unsigned int emitter, const osg::Vec3 &position, const osg::Vec3 &direction);
+
+
+		/**
+		 * \brief Emit a burst of particles at the next update (can be called by any thread, e.g. by the physics).
+		 *
+		 * \param emission
+		 *      Parameters of the emitted particles.
+		 * \param count
+		 *      Number of particles.
+		 */
+		void emit(const Emission &emission, unsigned int count);
+
+
+		/**
+		 * \brief Spawn the particles of the emitters and the bursts (called once per frame by the update-callback
+		 * of the root).
+		 *
+		 * \param time
+		 *      Simulation-time of the frame: unit = s
+		 */
+		void update(double time);
+
+
+		/**
+		 * \brief Upload the rows of the records which have been written since the last call (called by the texture
+		 * before it's used).
+		 *
+		 * \param state
+		 *      State of the current context (the rows are uploaded through its UploadRing).
+		 */
+		void uploadRecords(osg::State &state) const;
+
+
+		/**
+		 * \brief Get the node which draws all particles.
+		 *
+		 * \return Root of the particles.
+		 */
+		osg::ref_ptr<osg::Geode> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Get the bounding-box of all particles which have been emitted (grows only).
+		 *
+		 * \return Bounding-box in the world-space.
+		 */
+		const osg::BoundingBox& getBound() const {
+			return _bound;
+		}
+
+
+		/**
+		 * \brief Enable or disable the GPU-particles (if disabled, the space-ships use the osgParticle-systems). Has
+		 *        to be set before loading the scene.
+		 *
+		 * \param isEnabled
+		 *      True if all particles are simulated on the GPU.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the GPU-particles are enabled.
+		 *
+		 * \return True if all particles are simulated on the GPU.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+		/**
+		 * \brief Scale the rates of the emitters and the sizes of the bursts (e.g. by the FrameGovernor).
+		 *
+		 * \param rateScale
+		 *      Factor of the emitted particles (1 => as configured).
+		 */
+		void setRateScale(float rateScale) {
+			_rateScale = std::max(rateScale, 0.0f);
+		}
+
+
+		/**
+		 * \brief Get the factor of the emitted particles.
+		 *
+		 * \return Factor of the rates of the emitters and the sizes of the bursts.
+		 */
+		float getRateScale() const {
+			return _rateScale;
+		}
+
+
+		//! Number of particles in the ring-buffer
+		static const unsigned int CAPACITY;
+		//! Number of particles per row of the records (4 texels per particle)
+		static const unsigned int PARTICLES_PER_ROW;
+
+
+	private:
+
+		/**
+		 * \brief Continuous emitter.
+		 */
+		struct Emitter {
+			//! Parameters of the emitted particles (at the current position)
+			Emission emission;
+			//! Position at the last update
+			osg::Vec3 lastPosition;
+			//! Emitted particles per second
+			float rate;
+			//! Particles which are due, but not yet emitted (fraction of a particle)
+			double due = 0.0;
+		};
+
+		//! True if all particles are simulated on the GPU
+		static bool IS_ENABLED;
+
+		//! Continuous emitters
+		std::vector<Emitter> _emitters;
+
+		//! Bursts which are emitted at the next update
+		std::vector<std::pair<Emission, unsigned int> > _bursts;
+		//! Mutex of the bursts
+		OpenThreads::Mutex _burstMutex;
+
+		//! Spawn-records of all particles (4 texels per particle)
+		std::vector<osg::Vec4f> _records;
+		//! True for the rows which have been written since the last upload
+		mutable std::vector<char> _isRowDirty;
+		//! Rows which have been written since the last upload
+		mutable std::vector<unsigned int> _dirtyRows;
+
+		//! Slot of the next particle (the oldest one)
+		unsigned int _head = 0;
+		//! Time of the last update (negative before the first one)
+		double _lastTime = -1.0;
+		//! Factor of the rates of the emitters and the sizes of the bursts
+		float _rateScale = 1.0f;
+
+		//! Bounding-box of all particles which have been emitted
+		osg::BoundingBox _bound;
+
+		//! Root which draws the particles
+		osg::ref_ptr<osg::Geode> _root;
+		//! Points of all slots
+		osg::ref_ptr<osg::Geometry> _geometry;
+		//! Texture of the records
+		osg::ref_ptr<osg::Texture2D> _recordsTexture;
+		//! Time of the frame for the shader
+		osg::ref_ptr<osg::Uniform> _timeUniform;
+
+
+		/**
+		 * \brief Write the record of a particle into the oldest slot.
+		 *
+		 * \param emission
+		 *      Parameters of the particle.
+		 * \param position
+		 *      Position of the spawn.
+		 * \param time
+		 *      Time of the spawn: unit = s
+		 */
+		void spawn(const Emission &emission, const osg::Vec3 &position, double time);
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		GpuParticleSystem();
+
+		//! Private copy-constructor to prevent copying the class.
+		GpuParticleSystem(GpuParticleSystem const&) {}
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		GpuParticleSystem& operator=(GpuParticleSystem const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static GpuParticleSystem* _pInstance;
+	};
+}
@@ -11,6 +11,13 @@
 #include <osg/StateSet>
 #include <osg/Program>
 
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../ImageManager.h"
+#include "../MaterialCache.h"
+
 using namespace pbs17;
 
 
@@ -25,48 +32,77 @@ using namespace pbs17;
 BumpmapShader::BumpmapShader(osg::ref_ptr<osg::Texture2D> texture, osg::ref_ptr<osg::Texture2D> normals)
 	: _texture(texture), _normals(normals) {
 	setVertShader(
-		"attribute vec3 tangent;\n"
-		"attribute vec3 binormal;\n"
-		"varying vec3 lightDir;\n"
-		"varying vec3 position;\n"
+		"#version 150 compatibility\n"
+		"in vec3 tangent;\n"
+		"in vec3 binormal;\n"
+		"uniform mat4 osg_ViewMatrix;\n"
+		"uniform vec4 lightPosition;\n"
+		// visual spin: axis (in the model-space) times the rate and the start-time (see SpaceObject::isVisualSpin())
+		"uniform vec4 spin;\n"
+		"uniform float spinTime;\n"
+		"out vec3 lightDir;\n"
+		"out vec2 texCoord;\n"
+		"mat3 getSpinRotation()\n"
+		"{\n"
+		"    float rate = length(spin.xyz);\n"
+		"    if (rate == 0.0) return mat3(1.0);\n"
+		"    vec3 axis = spin.xyz / rate;\n"
+		"    float angle = rate * (spinTime - spin.w);\n"
+		"    float c = cos(angle);\n"
+		"    float s = sin(angle);\n"
+		// Rodrigues: c * I + s * [axis]x + (1 - c) * axis * axis^T
+		"    mat3 skew = mat3(0.0, axis.z, -axis.y, -axis.z, 0.0, axis.x, axis.y, -axis.x, 0.0);\n"
+		"    return c * mat3(1.0) + s * skew + (1.0 - c) * outerProduct(axis, axis);\n"
+		"}\n"
 		"void main()\n"
 		"{\n"
-		"    vec3 normal = normalize(gl_NormalMatrix * gl_Normal);\n"
-		"    mat3 rotation = mat3(tangent, binormal, normal);\n"
-		"    vec4 vertexInEye = gl_ModelViewMatrix * gl_Vertex;\n"
-		"    lightDir = vec3(gl_LightSource[0].position.xyz - vertexInEye.xyz);\n"
+		"    mat3 spinRotation = getSpinRotation();\n"
+		"    vec3 normal = normalize(gl_NormalMatrix * (spinRotation * gl_Normal));\n"
+		"    mat3 rotation = mat3(spinRotation * tangent, spinRotation * binormal, normal);\n"
+		"    vec4 vertexInEye = gl_ModelViewMatrix * vec4(spinRotation * gl_Vertex.xyz, gl_Vertex.w);\n"
+		// w = 1: position of the sun in the world, w = 0: direction of the headlight in the eye-space (see MaterialCache)
+		"    lightDir = lightPosition.w > 0.0 ? (osg_ViewMatrix * lightPosition).xyz - vertexInEye.xyz : lightPosition.xyz;\n"
 		"    lightDir = normalize(normalize(lightDir) * rotation);\n"
-		"    gl_Position = ftransform();\n"
-		"	 position = gl_Vertex.xyz;\n"
-		"    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+		"    gl_Position = gl_ProjectionMatrix * vertexInEye;\n"
+		// the texture-matrix decodes the quantized texture-coordinates (see QuantizeVisitor)
+		"    texCoord = (gl_TextureMatrix[0] * gl_MultiTexCoord0).xy;\n"
 		"}\n"
 	);
 
 	setFragShader(
+		"#version 150 compatibility\n"
 		"uniform sampler2D colorTex;\n"
 		"uniform sampler2D normalTex;\n"
-		"uniform vec3 CAMERA_POSITION;\n"
-		"varying vec3 lightDir;\n"
-		"varying vec3 position;\n"
+		"uniform bool twoChannelNormals;\n"
+		"uniform vec4 lightAmbient;\n"
+		"uniform vec4 lightDiffuse;\n"
+		"uniform vec4 lightSpecular;\n"
+		"uniform vec4 materialAmbient;\n"
+		"uniform vec4 materialDiffuse;\n"
+		"uniform vec4 materialSpecular;\n"
+		"uniform float materialShininess;\n"
+		"in vec3 lightDir;\n"
+		"in vec2 texCoord;\n"
+		"out vec4 fragColor;\n"
 
 		"void main (void)\n"
 		"{\n"
-		"    vec4 base = texture2D(colorTex, gl_TexCoord[0].xy);\n"
-		"    vec3 bump = texture2D(normalTex, gl_TexCoord[0].xy).xyz;\n"
-		"    bump = normalize(bump * 2.0 - 1.0);\n"
+		"    vec4 base = texture(colorTex, texCoord);\n"
+		"    vec3 bump = texture(normalTex, texCoord).xyz * 2.0 - 1.0;\n"
+		"    if (twoChannelNormals) bump.z = sqrt(max(1.0 - dot(bump.xy, bump.xy), 0.0));\n"
+		"    bump = normalize(bump);\n"
 
 		"    float lambert = max(dot(bump, lightDir), 0.0);\n"
-		"	 gl_FragColor = vec4(0.0, 0.0, 0.0, 0.0);\n"
-		"	 vec4 diffuse = vec4(0.0, 0.0, 0.0, 0.0);\n"
-		"	 vec4 specular = vec4(0.0, 0.0, 0.0, 0.0);\n"
-		"	 vec4 ambient = base * gl_FrontMaterial.ambient * gl_LightSource[0].ambient;\n"
+		"    vec4 diffuse = vec4(0.0, 0.0, 0.0, 0.0);\n"
+		"    vec4 specular = vec4(0.0, 0.0, 0.0, 0.0);\n"
+		"    vec4 ambient = base * materialAmbient * lightAmbient;\n"
 
 		"    if (lambert > 0.0)\n"
 		"    {\n"
-		"        diffuse = gl_FrontMaterial.diffuse * base * gl_LightSource[0].diffuse * lambert;\n"
-		"        //specular = gl_FrontMaterial.specular * gl_LightSource[0].specular * pow(lambert, gl_FrontMaterial.shininess);\n"
+		"        diffuse = materialDiffuse * base * lightDiffuse * lambert;\n"
+		"        //specular = materialSpecular * lightSpecular * pow(lambert, materialShininess);\n"
 		"    }\n"
-		"    gl_FragColor += ambient + diffuse + specular;\n"
+		"    fragColor = ambient + diffuse + specular;\n"
 		"}\n"
 	);
 }
@@ -85,20 +121,33 @@ BumpmapShader::~BumpmapShader() {}
  *      The node to which the shader should be applied.
  */
 void BumpmapShader::apply(osg::Node* node) {
-	// Initialise the vertex and fragment shader and load the correct parameters.
-	osg::ref_ptr<osg::Program> program = new osg::Program;
-	program->addShader(new osg::Shader(osg::Shader::VERTEX, getVertShader()));
-	program->addShader(new osg::Shader(osg::Shader::FRAGMENT, getFragShader()));
-	program->addBindAttribLocation("tangent", 6);
-	program->addBindAttribLocation("binormal", 7);
+	apply(node->getOrCreateStateSet());
+}
+
+
+/**
+ * \brief Apply the shader to the given state-set (e.g. a state-set which is shared by several nodes).
+ *
+ * \param stateset
+ *      The state-set to which the shader should be applied.
+ */
+void BumpmapShader::apply(osg::StateSet* stateset) {
+	// Initialise the vertex and fragment shader and load the correct parameters (the program is shared by all nodes).
+	std::vector<std::pair<std::string, unsigned int> > bindings;
+	bindings.push_back(std::make_pair(std::string("tangent"), 6u));
+	bindings.push_back(std::make_pair(std::string("binormal"), 7u));
+	osg::ref_ptr<osg::Program> program = MaterialCache::Instance()->getProgram(getVertShader(), getFragShader(), bindings);
 
 	// Apply the textures to the state-set.
-	osg::StateSet* stateset = node->getOrCreateStateSet();
 	stateset->setAttributeAndModes(program.get());
 	stateset->addUniform(new osg::Uniform("colorTex", 0));
 	stateset->addUniform(new osg::Uniform("normalTex", 1));
+	// no visual spin, the objects with one override it (see SpaceObject::initVisualSpin())
+	stateset->addUniform(new osg::Uniform("spin", osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f)));
+	// BC5 stores only x and y of the normals (see ImageManager)
+	stateset->addUniform(ImageManager::Instance()->getTwoChannelUniform(_normals.get()));
 
 	osg::StateAttribute::GLModeValue value = osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE;
 	stateset->setTextureAttributeAndModes(0, _texture.get(), value);
 	stateset->setTextureAttributeAndModes(1, _normals.get(), value);
-}
\ No newline at end of file
+}
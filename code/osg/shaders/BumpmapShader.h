@@ -8,6 +8,7 @@
 #pragma once
 
 #include "Shader.h"
+#include <osg/StateSet>
 #include <osg/Texture2D>
 
 namespace pbs17 {
@@ -44,6 +45,15 @@ namespace pbs17 {
 		void apply(osg::Node* node) override;
 
 
+		/**
+		 * \brief Apply the shader to the given state-set (e.g. a state-set which is shared by several nodes).
+		 *
+		 * \param stateset
+		 *      The state-set to which the shader should be applied.
+		 */
+		void apply(osg::StateSet* stateset);
+
+
 	private:
 
 		//! The image-texture to apply.
@@ -0,0 +1,105 @@
+﻿/**
+ * \brief Functionality for the shading of the dust-particles.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "DustShader.h"
+
+#include <osg/Node>
+#include <osg/StateSet>
+#include <osg/Program>
+#include <osg/PointSprite>
+#include <osg/BlendFunc>
+#include <osg/Depth>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../MaterialCache.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor. Initializes the shader-programms.
+ *
+ * \param color
+ *      Color of the dust.
+ * \param radius
+ *      Radius of a particle: unit = m
+ * \param viewportHeight
+ *      Uniform with the height of the viewport (updated by the cull-traversal).
+ */
+DustShader::DustShader(osg::Vec3 color, float radius, osg::ref_ptr<osg::Uniform> viewportHeight)
+	: _color(color), _radius(radius), _viewportHeight(viewportHeight) {
+	setVertShader(
+		"#version 150 compatibility\n"
+		"uniform float viewportHeight;\n"
+		"uniform float radius;\n"
+		"out float alpha;\n"
+
+		"void main()\n"
+		"{\n"
+		"    vec4 positionInEye = gl_ModelViewMatrix * gl_Vertex;\n"
+		"    gl_Position = gl_ProjectionMatrix * positionInEye;\n"
+
+		// the sprites smaller than a pixel keep one pixel, but their brightness shrinks with the covered area
+		"    float size = viewportHeight * gl_ProjectionMatrix[1][1] * radius / max(-positionInEye.z, 0.001);\n"
+		"    gl_PointSize = max(size, 1.0);\n"
+		"    alpha = min(size * size, 1.0);\n"
+		"}\n"
+	);
+
+	setFragShader(
+		"#version 150 compatibility\n"
+		"uniform vec3 color;\n"
+		"in float alpha;\n"
+
+		"void main (void)\n"
+		"{\n"
+		"    vec2 offset = 2.0 * gl_PointCoord - vec2(1.0);\n"
+		"    float falloff = max(1.0 - dot(offset, offset), 0.0);\n"
+		"    gl_FragColor = vec4(color * alpha * falloff, 1.0);\n"
+		"}\n"
+	);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+DustShader::~DustShader() {}
+
+
+/**
+ * \brief Apply the shader to the given node.
+ *
+ * \param node
+ *      The node to which the shader should be applied.
+ */
+void DustShader::apply(osg::Node* node) {
+	osg::ref_ptr<osg::Program> program = MaterialCache::Instance()->getProgram(getVertShader(), getFragShader(),
+		std::vector<std::pair<std::string, unsigned int> >());
+
+	osg::StateSet* stateset = node->getOrCreateStateSet();
+	stateset->setAttributeAndModes(program.get());
+	stateset->addUniform(new osg::Uniform("color", _color));
+	stateset->addUniform(new osg::Uniform("radius", _radius));
+	stateset->addUniform(_viewportHeight.get());
+
+	// the size of the sprites is computed by the vertex-shader
+	osg::ref_ptr<osg::PointSprite> sprite = new osg::PointSprite;
+	sprite->setCoordOriginMode(osg::PointSprite::LOWER_LEFT);
+	stateset->setTextureAttributeAndModes(0, sprite.get(), osg::StateAttribute::ON);
+	stateset->setMode(GL_VERTEX_PROGRAM_POINT_SIZE, osg::StateAttribute::ON);
+
+	// the dust is additive, so the particles don't have to be sorted and don't hide each other
+	stateset->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+	stateset->setMode(GL_BLEND, osg::StateAttribute::ON);
+	stateset->setAttributeAndModes(new osg::BlendFunc(GL_ONE, GL_ONE));
+	stateset->setAttributeAndModes(new osg::Depth(osg::Depth::LESS, 0.0, 1.0, false));
+	stateset->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+}
@@ -0,0 +1,62 @@
+﻿/**
+ * \brief Functionality for the shading of the dust-particles.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include "Shader.h"
+#include <osg/Vec3>
+#include <osg/Uniform>
+
+namespace pbs17 {
+	/**
+	 * \brief The DustShader draws each dust-particle as a soft, additive point-sprite (see DustManager). The sprites
+	 * have the size of the particle in the world, but at least one pixel. Smaller particles are faded instead, so
+	 * the far rings shine like a haze.
+	 */
+	class DustShader : public Shader {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initializes the shader-programms.
+		 *
+		 * \param color
+		 *      Color of the dust.
+		 * \param radius
+		 *      Radius of a particle: unit = m
+		 * \param viewportHeight
+		 *      Uniform with the height of the viewport (updated by the cull-traversal).
+		 */
+		DustShader(osg::Vec3 color, float radius, osg::ref_ptr<osg::Uniform> viewportHeight);
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~DustShader();
+
+
+		/**
+		 * \brief Apply the shader to the given node.
+		 * 
+		 * \param node
+		 *      The node to which the shader should be applied.
+		 */
+		void apply(osg::Node* node) override;
+
+
+	private:
+
+		//! Color of the dust.
+		osg::Vec3 _color;
+		//! Radius of a particle.
+		float _radius;
+		//! Uniform with the height of the viewport.
+		osg::ref_ptr<osg::Uniform> _viewportHeight;
+
+	};
+}
@@ -0,0 +1,189 @@
+﻿/**
+ * \brief Functionality for the shading of the impostors of instanced models.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-21
+ */
+
+#include "ImpostorShader.h"
+
+#include <osg/Node>
+#include <osg/StateSet>
+#include <osg/Program>
+#include <osg/PointSprite>
+#include <osg/Uniform>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "InstancedShader.h"
+#include "../MaterialCache.h"
+#include "../StereoRenderer.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	//! Vertex-shader of all variants (same defines as the InstancedShader)
+	const char* VERTEX_SHADER =
+		"#ifdef READS_BODIES\n"
+		"struct Body { vec4 position; vec4 velocity; };\n"
+		"layout(std430, binding = 0) readonly buffer Bodies { Body bodies[]; };\n"
+		"#endif\n"
+		"#ifdef GPU_CULLED\n"
+		"layout(std430, binding = 1) readonly buffer Visible { uint visible[]; };\n"
+		"uniform int visibleOffset;\n"
+		"#endif\n"
+		"uniform samplerBuffer instanceMatrices;\n"
+		"uniform int cntViews;\n"
+		"uniform float radius;\n"
+		"uniform float viewportHeight;\n"
+		"uniform mat4 osg_ViewMatrix;\n"
+		"uniform vec4 lightPosition;\n"
+		"flat out float view;\n"
+		"out vec3 lightDir;\n"
+		"void main()\n"
+		"{\n"
+		// the instanced stereo draws each instance for both eyes (see StereoRenderer)
+		"#ifdef STEREO\n"
+		"    int eye = gl_InstanceID & 1;\n"
+		"    int instance = gl_InstanceID >> 1;\n"
+		"#else\n"
+		"    int instance = gl_InstanceID;\n"
+		"#endif\n"
+		"#ifdef GPU_CULLED\n"
+		"    int base = 4 * int(visible[visibleOffset + instance]);\n"
+		"#else\n"
+		"    int base = 4 * instance;\n"
+		"#endif\n"
+		"    mat4 model = mat4(texelFetch(instanceMatrices, base), texelFetch(instanceMatrices, base + 1),\n"
+		"                      texelFetch(instanceMatrices, base + 2), texelFetch(instanceMatrices, base + 3));\n"
+		// the unused elements (1, 3) and (2, 3) hold the layer of the textures and the seed (see InstancedModel)
+		"    model[1][3] = 0.0;\n"
+		"    model[2][3] = 0.0;\n"
+		"#ifdef READS_BODIES\n"
+		"    int body = int(model[0][3]);\n"
+		"    model[0][3] = 0.0;\n"
+		"    model[3] = vec4(bodies[body].position.xyz, 1.0);\n"
+		"#endif\n"
+		"    vec4 center = model * gl_Vertex;\n"
+		"    vec4 centerInEye = gl_ModelViewMatrix * center;\n"
+		"    float scaling = length(model[0].xyz);\n"
+
+		// direction to the camera in the model-space => view of the atlas (view k is rotated by k * 2pi / cntViews)
+		"    vec3 toCamera = (gl_ModelViewMatrixInverse * vec4(0.0, 0.0, 0.0, 1.0)).xyz - center.xyz;\n"
+		"    vec3 local = transpose(mat3(model)) * toCamera;\n"
+		"    float angle = -atan(local.x, local.z) / 6.28318530718;\n"
+		"    view = mod(floor(angle * float(cntViews) + 0.5), float(cntViews));\n"
+
+		"    lightDir = normalize(lightPosition.w > 0.0 ? (osg_ViewMatrix * lightPosition).xyz - centerInEye.xyz : lightPosition.xyz);\n"
+		"#ifdef STEREO\n"
+		"    vec4 centerInStereoEye = stereoViews[eye] * centerInEye;\n"
+		"    gl_PointSize = viewportHeight * stereoProjections[eye][1][1] * radius * scaling / max(-centerInStereoEye.z, 0.001);\n"
+		"    gl_Position = stereoProjections[eye] * centerInStereoEye;\n"
+		"    gl_Layer = eye;\n"
+		"#else\n"
+		"    gl_PointSize = viewportHeight * gl_ProjectionMatrix[1][1] * radius * scaling / max(-centerInEye.z, 0.001);\n"
+		"    gl_Position = gl_ProjectionMatrix * centerInEye;\n"
+		"#endif\n"
+		"}\n";
+}
+
+
+/**
+ * \brief Constructor. Initializes the shader-programms.
+ *
+ * \param atlas
+ *      Texture with the pre-rendered views of the model (side by side).
+ * \param cntViews
+ *      Number of views in the atlas (rotated around the y-axis of the model).
+ * \param radius
+ *      Radius of the bounding-sphere of the unscaled model.
+ * \param readsBodies
+ *      True if the positions are read from the buffer of the bodies (see InstancedShader).
+ * \param isCulled
+ *      True if the instances are culled on the GPU (see InstanceCuller).
+ */
+ImpostorShader::ImpostorShader(osg::ref_ptr<osg::Texture2D> atlas, int cntViews, float radius, bool readsBodies, bool isCulled)
+	: _atlas(atlas), _cntViews(cntViews), _radius(radius) {
+	// the shader-storage-buffers and the layer of the instanced stereo need OpenGL 4.3
+	bool isStereo = StereoRenderer::getIsEnabled();
+	_vertSource = readsBodies || isCulled || isStereo ? "#version 430 compatibility\n" : "#version 150 compatibility\n";
+	_vertSource += StereoRenderer::getShaderHeader();
+	if (readsBodies) {
+		_vertSource += "#define READS_BODIES\n";
+	}
+	if (isCulled) {
+		_vertSource += "#define GPU_CULLED\n";
+	}
+	_vertSource += VERTEX_SHADER;
+	setVertShader(&_vertSource[0]);
+
+	setFragShader(
+		"#version 150 compatibility\n"
+		"uniform sampler2D atlasTex;\n"
+		"uniform int cntViews;\n"
+		"uniform vec4 lightAmbient;\n"
+		"uniform vec4 lightDiffuse;\n"
+		"uniform vec4 materialAmbient;\n"
+		"uniform vec4 materialDiffuse;\n"
+		"flat in float view;\n"
+		"in vec3 lightDir;\n"
+		"out vec4 fragColor;\n"
+
+		"void main (void)\n"
+		"{\n"
+		"    vec4 base = texture(atlasTex, vec2((view + gl_PointCoord.x) / float(cntViews), gl_PointCoord.y));\n"
+		"    if (base.a < 0.5)\n"
+		"    {\n"
+		"        discard;\n"
+		"    }\n"
+
+		// the impostor is lit as a sphere
+		"    vec2 xy = gl_PointCoord * 2.0 - 1.0;\n"
+		"    vec3 normal = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));\n"
+		"    float lambert = max(dot(normal, lightDir), 0.0);\n"
+		"    vec4 ambient = base * materialAmbient * lightAmbient;\n"
+		"    vec4 diffuse = materialDiffuse * base * lightDiffuse * lambert;\n"
+		"    fragColor = vec4((ambient + diffuse).rgb, 1.0);\n"
+		"}\n"
+	);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+ImpostorShader::~ImpostorShader() {}
+
+
+/**
+ * \brief Apply the shader to the given node.
+ *
+ * \param node
+ *      The node to which the shader should be applied.
+ */
+void ImpostorShader::apply(osg::Node* node) {
+	// the program is shared by the impostors of all models
+	osg::ref_ptr<osg::Program> program = MaterialCache::Instance()->getProgram(getVertShader(), getFragShader(),
+		std::vector<std::pair<std::string, unsigned int> >());
+
+	// the program and the atlas are protected against the overridden state of the instanced model
+	osg::StateAttribute::GLModeValue value = osg::StateAttribute::ON | osg::StateAttribute::PROTECTED;
+	osg::StateSet* stateset = node->getOrCreateStateSet();
+	stateset->setAttributeAndModes(program.get(), value);
+	stateset->setTextureAttributeAndModes(0, _atlas.get(), value);
+	stateset->setTextureMode(1, GL_TEXTURE_2D, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
+	stateset->addUniform(new osg::Uniform("atlasTex", 0));
+	stateset->addUniform(new osg::Uniform("instanceMatrices", InstancedShader::MATRIX_UNIT));
+	stateset->addUniform(new osg::Uniform("cntViews", _cntViews));
+	stateset->addUniform(new osg::Uniform("radius", _radius));
+
+	// the size of the sprites is computed by the vertex-shader, the texture-coordinates start at the bottom
+	osg::ref_ptr<osg::PointSprite> sprite = new osg::PointSprite;
+	sprite->setCoordOriginMode(osg::PointSprite::LOWER_LEFT);
+	stateset->setTextureAttributeAndModes(0, sprite.get(), value);
+	stateset->setMode(GL_VERTEX_PROGRAM_POINT_SIZE, osg::StateAttribute::ON);
+}
@@ -0,0 +1,70 @@
+﻿/**
+ * \brief Functionality for the shading of the impostors of instanced models.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-21
+ */
+
+#pragma once
+
+#include "Shader.h"
+#include <osg/Texture2D>
+
+#include <string>
+
+namespace pbs17 {
+	/**
+	 * \brief The ImpostorShader draws each instance of a model as a camera-facing point-sprite.
+	 * The sprite shows the view of the pre-rendered atlas (see InstancedModel) which is the closest to the direction
+	 * of the camera, and is lit as a sphere. The model-matrices are read from the texture-buffer of the level.
+	 */
+	class ImpostorShader : public Shader {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initializes the shader-programms.
+		 *
+		 * \param atlas
+		 *      Texture with the pre-rendered views of the model (side by side).
+		 * \param cntViews
+		 *      Number of views in the atlas (rotated around the y-axis of the model).
+		 * \param radius
+		 *      Radius of the bounding-sphere of the unscaled model.
+		 * \param readsBodies
+		 *      True if the positions are read from the buffer of the bodies (see InstancedShader).
+		 * \param isCulled
+		 *      True if the instances are culled on the GPU (see InstanceCuller).
+		 */
+		ImpostorShader(osg::ref_ptr<osg::Texture2D> atlas, int cntViews, float radius, bool readsBodies = false, bool isCulled = false);
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~ImpostorShader();
+
+
+		/**
+		 * \brief Apply the shader to the given node.
+		 * 
+		 * \param node
+		 *      The node to which the shader should be applied.
+		 */
+		void apply(osg::Node* node) override;
+
+
+	private:
+
+		//! Source of the vertex-shader with the defines of the variant.
+		std::string _vertSource;
+
+		//! Texture with the pre-rendered views of the model.
+		osg::ref_ptr<osg::Texture2D> _atlas;
+		//! Number of views in the atlas.
+		int _cntViews;
+		//! Radius of the bounding-sphere of the unscaled model.
+		float _radius;
+
+	};
+}
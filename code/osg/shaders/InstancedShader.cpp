@@ -0,0 +1,220 @@
+﻿/**
+ * \brief Functionality for the bumpmap-shading of instanced models.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-20
+ */
+
+#include "InstancedShader.h"
+
+#include <osg/Node>
+#include <osg/StateSet>
+#include <osg/Uniform>
+#include <osg/Program>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../ImageManager.h"
+#include "../MaterialCache.h"
+#include "../ProceduralAsteroid.h"
+#include "../StereoRenderer.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	//! Vertex-shader of all variants (READS_BODIES: the translation is read from the bodies, GPU_CULLED: the
+	//! instances are read through the list of the visible instances of the level, see InstanceCuller, PROCEDURAL:
+	//! the icosphere is displaced by asteroidSurface(), see ProceduralAsteroid, STEREO: both eyes in one draw, see
+	//! StereoRenderer)
+	const char* VERTEX_SHADER =
+		"#ifdef READS_BODIES\n"
+		"struct Body { vec4 position; vec4 velocity; };\n"
+		"layout(std430, binding = 0) readonly buffer Bodies { Body bodies[]; };\n"
+		"#endif\n"
+		"#ifdef GPU_CULLED\n"
+		"layout(std430, binding = 1) readonly buffer Visible { uint visible[]; };\n"
+		"uniform int visibleOffset;\n"
+		"#endif\n"
+		"uniform samplerBuffer instanceMatrices;\n"
+		"uniform mat4 dequantization;\n"
+		"in vec3 tangent;\n"
+		"in vec3 binormal;\n"
+		"uniform mat4 osg_ViewMatrix;\n"
+		"uniform vec4 lightPosition;\n"
+		"out vec3 lightDir;\n"
+		"out vec2 texCoord;\n"
+		"flat out float layer;\n"
+		"void main()\n"
+		"{\n"
+		// the instanced stereo draws each instance for both eyes (see StereoRenderer)
+		"#ifdef STEREO\n"
+		"    int eye = gl_InstanceID & 1;\n"
+		"    int instance = gl_InstanceID >> 1;\n"
+		"#else\n"
+		"    int instance = gl_InstanceID;\n"
+		"#endif\n"
+		"#ifdef GPU_CULLED\n"
+		"    int base = 4 * int(visible[visibleOffset + instance]);\n"
+		"#else\n"
+		"    int base = 4 * instance;\n"
+		"#endif\n"
+		"    mat4 model = mat4(texelFetch(instanceMatrices, base), texelFetch(instanceMatrices, base + 1),\n"
+		"                      texelFetch(instanceMatrices, base + 2), texelFetch(instanceMatrices, base + 3));\n"
+		"    layer = model[1][3];\n"
+		"    model[1][3] = 0.0;\n"
+		"#ifdef PROCEDURAL\n"
+		"    uint seed = uint(model[2][3] + 0.5);\n"
+		"    model[2][3] = 0.0;\n"
+		// the normal is the cross-product of the displaced tangents (the tangent of the texture if it's defined)
+		"    vec3 direction = normalize((dequantization * gl_Vertex).xyz);\n"
+		"    vec3 surfaceTangent = tangent - dot(tangent, direction) * direction;\n"
+		"    if (dot(surfaceTangent, surfaceTangent) < 1e-6)\n"
+		"        surfaceTangent = cross(abs(direction.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0), direction);\n"
+		"    surfaceTangent = normalize(surfaceTangent);\n"
+		"    vec3 surfaceBinormal = cross(direction, surfaceTangent);\n"
+		"    vec3 position = asteroidSurface(direction, seed);\n"
+		"    surfaceTangent = asteroidSurface(normalize(direction + 0.01 * surfaceTangent), seed) - position;\n"
+		"    surfaceBinormal = asteroidSurface(normalize(direction + 0.01 * surfaceBinormal), seed) - position;\n"
+		"    vec3 objectNormal = normalize(cross(surfaceTangent, surfaceBinormal));\n"
+		"    vec3 objectTangent = normalize(surfaceTangent);\n"
+		"    vec3 objectBinormal = cross(objectNormal, objectTangent) * (dot(cross(gl_Normal, tangent), binormal) < 0.0 ? -1.0 : 1.0);\n"
+		"    vec4 objectVertex = vec4(position, 1.0);\n"
+		"#else\n"
+		"    vec3 objectNormal = gl_Normal;\n"
+		"    vec3 objectTangent = tangent;\n"
+		"    vec3 objectBinormal = binormal;\n"
+		"    vec4 objectVertex = dequantization * gl_Vertex;\n"
+		"#endif\n"
+		"#ifdef READS_BODIES\n"
+		"    int body = int(model[0][3]);\n"
+		"    model[0][3] = 0.0;\n"
+		"    model[3] = vec4(bodies[body].position.xyz, 1.0);\n"
+		"#endif\n"
+		"    mat3 normalMatrix = gl_NormalMatrix * mat3(model);\n"
+		"    vec3 normal = normalize(normalMatrix * objectNormal);\n"
+		"    mat3 rotation = mat3(normalize(normalMatrix * objectTangent), normalize(normalMatrix * objectBinormal), normal);\n"
+		"    vec4 vertexInEye = gl_ModelViewMatrix * (model * objectVertex);\n"
+		"    lightDir = lightPosition.w > 0.0 ? (osg_ViewMatrix * lightPosition).xyz - vertexInEye.xyz : lightPosition.xyz;\n"
+		"    lightDir = normalize(normalize(lightDir) * rotation);\n"
+		"#ifdef STEREO\n"
+		"    gl_Position = stereoProjections[eye] * (stereoViews[eye] * vertexInEye);\n"
+		"    gl_Layer = eye;\n"
+		"#else\n"
+		"    gl_Position = gl_ProjectionMatrix * vertexInEye;\n"
+		"#endif\n"
+		"    texCoord = (gl_TextureMatrix[0] * gl_MultiTexCoord0).xy;\n"
+		"}\n";
+}
+
+
+/**
+ * \brief Constructor. Initializes the shader-programms.
+ *
+ * \param textures
+ *      The image-textures to apply (one layer per texture).
+ * \param normals
+ *      The normal-textures to apply (same layers as the image-textures, nullptr => the normals of the model are used).
+ * \param readsBodies
+ *      True if the positions are read from the buffer of the bodies (the model-matrices only contain the
+ *      rotation and the scaling, the index of the body is stored in their unused element (0, 3)).
+ * \param isCulled
+ *      True if the instances are culled on the GPU (see InstanceCuller).
+ * \param isProcedural
+ *      True if the model is the icosphere of the generated asteroids.
+ */
+InstancedShader::InstancedShader(osg::ref_ptr<osg::Texture2DArray> textures, osg::ref_ptr<osg::Texture2DArray> normals,
+	bool readsBodies, bool isCulled, bool isProcedural) : _textures(textures), _normals(normals) {
+	// the shader-storage-buffers and the layer of the instanced stereo need OpenGL 4.3
+	bool isStereo = StereoRenderer::getIsEnabled();
+	_vertSource = readsBodies || isCulled || isStereo ? "#version 430 compatibility\n" : "#version 150 compatibility\n";
+	_vertSource += StereoRenderer::getShaderHeader();
+	if (readsBodies) {
+		// position and mass, velocity per body (same layout as the compute-shader of ComputeGravity)
+		_vertSource += "#define READS_BODIES\n";
+	}
+	if (isCulled) {
+		_vertSource += "#define GPU_CULLED\n";
+	}
+	if (isProcedural) {
+		// same surface as the convex-hulls and the models which are not instanced
+		_vertSource += "#define PROCEDURAL\n";
+		_vertSource += ProceduralAsteroid::getShaderSource();
+	}
+	_vertSource += VERTEX_SHADER;
+	setVertShader(&_vertSource[0]);
+
+	setFragShader(
+		"#version 150 compatibility\n"
+		"uniform sampler2DArray colorTex;\n"
+		"uniform sampler2DArray normalTex;\n"
+		"uniform bool useBumpmap;\n"
+		"uniform bool twoChannelNormals;\n"
+		"uniform vec4 lightAmbient;\n"
+		"uniform vec4 lightDiffuse;\n"
+		"uniform vec4 materialAmbient;\n"
+		"uniform vec4 materialDiffuse;\n"
+		"in vec3 lightDir;\n"
+		"in vec2 texCoord;\n"
+		"flat in float layer;\n"
+		"out vec4 fragColor;\n"
+
+		"void main (void)\n"
+		"{\n"
+		"    vec4 base = texture(colorTex, vec3(texCoord, layer));\n"
+		"    vec3 bump = vec3(0.0, 0.0, 1.0);\n"
+		"    if (useBumpmap)\n"
+		"    {\n"
+		"        bump = texture(normalTex, vec3(texCoord, layer)).xyz * 2.0 - 1.0;\n"
+		"        if (twoChannelNormals) bump.z = sqrt(max(1.0 - dot(bump.xy, bump.xy), 0.0));\n"
+		"        bump = normalize(bump);\n"
+		"    }\n"
+
+		"    float lambert = max(dot(bump, lightDir), 0.0);\n"
+		"    vec4 ambient = base * materialAmbient * lightAmbient;\n"
+		"    vec4 diffuse = materialDiffuse * base * lightDiffuse * lambert;\n"
+		"    fragColor = ambient + diffuse;\n"
+		"}\n"
+	);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+InstancedShader::~InstancedShader() {}
+
+
+/**
+ * \brief Apply the shader to the given node.
+ *
+ * \param node
+ *      The node to which the shader should be applied.
+ */
+void InstancedShader::apply(osg::Node* node) {
+	// same tangent-attributes as the bumpmap (the program is shared by all instanced models)
+	std::vector<std::pair<std::string, unsigned int> > bindings;
+	bindings.push_back(std::make_pair(std::string("tangent"), 6u));
+	bindings.push_back(std::make_pair(std::string("binormal"), 7u));
+	osg::ref_ptr<osg::Program> program = MaterialCache::Instance()->getProgram(getVertShader(), getFragShader(), bindings);
+
+	osg::StateSet* stateset = node->getOrCreateStateSet();
+	stateset->setAttributeAndModes(program.get());
+	stateset->addUniform(new osg::Uniform("colorTex", 0));
+	stateset->addUniform(new osg::Uniform("normalTex", 1));
+	stateset->addUniform(new osg::Uniform("instanceMatrices", MATRIX_UNIT));
+	stateset->addUniform(new osg::Uniform("useBumpmap", _normals.valid()));
+	// BC5 stores only x and y of the normals (all layers have the same format, see InstanceManager)
+	stateset->addUniform(new osg::Uniform("twoChannelNormals", _normals.valid() && ImageManager::hasTwoChannels(_normals->getImage(0))));
+
+	// the arrays have no fixed-function mode
+	stateset->setTextureAttribute(0, _textures.get(), osg::StateAttribute::OVERRIDE);
+	if (_normals.valid()) {
+		stateset->setTextureAttribute(1, _normals.get(), osg::StateAttribute::OVERRIDE);
+	}
+	// the levels of quantized models override it (see InstancedModel)
+	stateset->addUniform(new osg::Uniform("dequantization", osg::Matrixf::identity()));
+}
@@ -0,0 +1,87 @@
+﻿/**
+ * \brief Functionality for the bumpmap-shading of instanced models.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-20
+ */
+
+#pragma once
+
+#include "Shader.h"
+#include <osg/StateSet>
+#include <osg/Texture2DArray>
+
+#include <string>
+
+namespace pbs17 {
+	/**
+	 * \brief The InstancedShader is the bumpmap-shading of models which are drawn once for all their instances.
+	 * The model-matrix of each instance is read from a texture-buffer (4 texels per instance, see InstancedModel)
+	 * and the normal-texture is optional. The textures of all instances are layers of texture-arrays, the layer of an
+	 * instance is stored in the unused element (1, 3) of its model-matrix.
+	 * If the positions are integrated on the GPU (see ComputeGravity), the translation of each instance is read from
+	 * the shader-storage-buffer of the bodies instead (needs OpenGL 4.3). If the instances are culled on the GPU, the
+	 * instance of gl_InstanceID is read from the list of the visible instances of the level (see InstanceCuller).
+	 * The icosphere of the generated asteroids is displaced by the seed in the unused element (2, 3) of the model-matrix
+	 * (see ProceduralAsteroid).
+	 */
+	class InstancedShader : public Shader {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initializes the shader-programms.
+		 *
+		 * \param textures
+		 *      The image-textures to apply (one layer per texture).
+		 * \param normals
+		 *      The normal-textures to apply (same layers as the image-textures, nullptr => the normals of the model are used).
+		 * \param readsBodies
+		 *      True if the positions are read from the buffer of the bodies (the model-matrices only contain the
+		 *      rotation and the scaling, the index of the body is stored in their unused element (0, 3)).
+		 * \param isCulled
+		 *      True if the instances are culled on the GPU (see InstanceCuller).
+		 * \param isProcedural
+		 *      True if the model is the icosphere of the generated asteroids.
+		 */
+		InstancedShader(osg::ref_ptr<osg::Texture2DArray> textures, osg::ref_ptr<osg::Texture2DArray> normals,
+			bool readsBodies = false, bool isCulled = false, bool isProcedural = false);
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~InstancedShader();
+
+
+		/**
+		 * \brief Apply the shader to the given node.
+		 * 
+		 * \param node
+		 *      The node to which the shader should be applied.
+		 */
+		void apply(osg::Node* node) override;
+
+
+		//! Texture-unit of the texture-buffer with the model-matrices
+		static const int MATRIX_UNIT = 2;
+
+		//! Binding-point of the shader-storage-buffer with the bodies (see ComputeGravity)
+		static const int BODY_BINDING = 0;
+
+		//! Binding-point of the shader-storage-buffer with the visible instances of the levels (see InstanceCuller)
+		static const int VISIBLE_BINDING = 1;
+
+
+	private:
+
+		//! Source of the vertex-shader with the defines of the variant.
+		std::string _vertSource;
+
+		//! The image-textures to apply.
+		osg::ref_ptr<osg::Texture2DArray> _textures;
+		//! The normal-textures to apply.
+		osg::ref_ptr<osg::Texture2DArray> _normals;
+
+	};
+}
@@ -0,0 +1,166 @@
+﻿/**
+ * \brief Functionality for the shading of the GPU-particles.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "ParticleShader.h"
+
+#include <osg/Node>
+#include <osg/StateSet>
+#include <osg/Program>
+#include <osg/PointSprite>
+#include <osg/BlendFunc>
+#include <osg/Depth>
+
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../MaterialCache.h"
+#include "../particles/GpuParticleSystem.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	//! Vertex-shader (the number of particles per row is defined in front of it)
+	const char* VERTEX_SHADER =
+		"uniform sampler2D records;\n"
+		"uniform float time;\n"
+		"uniform float viewportHeight;\n"
+		"out vec4 color;\n"
+
+		"uint hash(uint x)\n"
+		"{\n"
+		"    x ^= x >> 16u;\n"
+		"    x *= 0x7feb352du;\n"
+		"    x ^= x >> 15u;\n"
+		"    x *= 0x846ca68bu;\n"
+		"    x ^= x >> 16u;\n"
+		"    return x;\n"
+		"}\n"
+
+		"float random(inout uint state)\n"
+		"{\n"
+		"    state = hash(state);\n"
+		"    return float(state >> 8u) / 16777216.0;\n"
+		"}\n"
+
+		"void main()\n"
+		"{\n"
+		"    int slot = int(gl_Vertex.x);\n"
+		"    ivec2 texel = ivec2(4 * (slot % PARTICLES_PER_ROW), slot / PARTICLES_PER_ROW);\n"
+		"    vec4 spawn = texelFetch(records, texel, 0);\n"
+		"    vec4 inherited = texelFetch(records, texel + ivec2(1, 0), 0);\n"
+		"    vec4 shot = texelFetch(records, texel + ivec2(2, 0), 0);\n"
+		"    vec4 look = texelFetch(records, texel + ivec2(3, 0), 0);\n"
+
+		// the empty and the dead slots are moved out of the clip-space
+		"    float age = time - spawn.w;\n"
+		"    if (age < 0.0 || age >= inherited.w) {\n"
+		"        color = vec4(0.0);\n"
+		"        gl_PointSize = 0.0;\n"
+		"        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+		"        return;\n"
+		"    }\n"
+
+		// uniform direction in the cap of the cone, the seed changes with each spawn of the slot
+		"    uint state = uint(slot) * 747796405u + uint(spawn.w * 1000.0);\n"
+		"    float speed = length(shot.xyz);\n"
+		"    vec3 axis = speed > 0.0 ? shot.xyz / speed : vec3(0.0, 0.0, 1.0);\n"
+		"    vec3 tangent = normalize(cross(axis, abs(axis.z) < 0.9 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0)));\n"
+		"    vec3 bitangent = cross(axis, tangent);\n"
+		"    float cosTheta = 1.0 - random(state) * (1.0 - cos(shot.w));\n"
+		"    float sinTheta = sqrt(max(1.0 - cosTheta * cosTheta, 0.0));\n"
+		"    float phi = 6.28318530718 * random(state);\n"
+		"    vec3 direction = cosTheta * axis + sinTheta * (cos(phi) * tangent + sin(phi) * bitangent);\n"
+		"    speed *= 0.93 + 0.14 * random(state);\n"
+
+		"    vec3 position = spawn.xyz + (inherited.xyz + speed * direction) * age;\n"
+		"    float life = age / inherited.w;\n"
+		"    color = mix(vec4(look.rgb, 1.0), vec4(0.0, 0.0, 0.0, 0.3), life);\n"
+
+		"    vec4 positionInEye = gl_ModelViewMatrix * vec4(position, 1.0);\n"
+		"    gl_Position = gl_ProjectionMatrix * positionInEye;\n"
+		"    float radius = 0.5 * look.w * (1.0 + life);\n"
+		"    gl_PointSize = max(viewportHeight * gl_ProjectionMatrix[1][1] * radius / max(-positionInEye.z, 0.001), 1.0);\n"
+		"}\n";
+}
+
+
+/**
+ * \brief Constructor. Initializes the shader-programms.
+ *
+ * \param records
+ *      Texture with the spawn-records of the particles (4 texels per particle).
+ * \param sprite
+ *      Texture of a particle.
+ * \param time
+ *      Uniform with the time of the frame.
+ * \param viewportHeight
+ *      Uniform with the height of the viewport (updated by the cull-traversal).
+ */
+ParticleShader::ParticleShader(osg::ref_ptr<osg::Texture2D> records, osg::ref_ptr<osg::Texture2D> sprite, osg::ref_ptr<osg::Uniform> time,
+	osg::ref_ptr<osg::Uniform> viewportHeight)
+	: _records(records), _sprite(sprite), _time(time), _viewportHeight(viewportHeight) {
+	std::ostringstream defines;
+	defines << "#version 150 compatibility\n"
+		<< "#define PARTICLES_PER_ROW " << GpuParticleSystem::PARTICLES_PER_ROW << "\n";
+	_vertSource = defines.str() + VERTEX_SHADER;
+	setVertShader(&_vertSource[0]);
+
+	setFragShader(
+		"#version 150 compatibility\n"
+		"uniform sampler2D sprite;\n"
+		"in vec4 color;\n"
+
+		"void main (void)\n"
+		"{\n"
+		"    gl_FragColor = color * texture(sprite, gl_PointCoord);\n"
+		"}\n"
+	);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+ParticleShader::~ParticleShader() {}
+
+
+/**
+ * \brief Apply the shader to the given node.
+ *
+ * \param node
+ *      The node to which the shader should be applied.
+ */
+void ParticleShader::apply(osg::Node* node) {
+	osg::ref_ptr<osg::Program> program = MaterialCache::Instance()->getProgram(getVertShader(), getFragShader(),
+		std::vector<std::pair<std::string, unsigned int> >());
+
+	osg::StateSet* stateset = node->getOrCreateStateSet();
+	stateset->setAttributeAndModes(program.get());
+	stateset->setTextureAttribute(0, _records.get());
+	stateset->setTextureAttribute(1, _sprite.get());
+	stateset->addUniform(new osg::Uniform("records", 0));
+	stateset->addUniform(new osg::Uniform("sprite", 1));
+	stateset->addUniform(_time.get());
+	stateset->addUniform(_viewportHeight.get());
+
+	// the size of the sprites is computed by the vertex-shader
+	osg::ref_ptr<osg::PointSprite> pointSprite = new osg::PointSprite;
+	pointSprite->setCoordOriginMode(osg::PointSprite::LOWER_LEFT);
+	stateset->setTextureAttributeAndModes(1, pointSprite.get(), osg::StateAttribute::ON);
+	stateset->setMode(GL_VERTEX_PROGRAM_POINT_SIZE, osg::StateAttribute::ON);
+
+	// emissive like the particles of osgParticle: additive, so they are neither sorted nor hide each other
+	stateset->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
+	stateset->setMode(GL_BLEND, osg::StateAttribute::ON);
+	stateset->setAttributeAndModes(new osg::BlendFunc(GL_SRC_ALPHA, GL_ONE));
+	stateset->setAttributeAndModes(new osg::Depth(osg::Depth::LESS, 0.0, 1.0, false));
+	stateset->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+}
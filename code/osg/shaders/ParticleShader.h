@@ -0,0 +1,71 @@
+﻿/**
+ * \brief Functionality for the shading of the GPU-particles.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include "Shader.h"
+#include <osg/Texture2D>
+#include <osg/Uniform>
+
+#include <string>
+
+namespace pbs17 {
+	/**
+	 * \brief The ParticleShader evaluates each particle of the GpuParticleSystem from its spawn-record: Its direction
+	 * is randomized in the cone of the emission (hashed from the slot and the spawn), it moves linearly, grows to the
+	 * double size and fades to a transparent black until its death. The particles are drawn as additive point-sprites.
+	 */
+	class ParticleShader : public Shader {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initializes the shader-programms.
+		 *
+		 * \param records
+		 *      Texture with the spawn-records of the particles (4 texels per particle).
+		 * \param sprite
+		 *      Texture of a particle.
+		 * \param time
+		 *      Uniform with the time of the frame.
+		 * \param viewportHeight
+		 *      Uniform with the height of the viewport (updated by the cull-traversal).
+		 */
+		ParticleShader(osg::ref_ptr<osg::Texture2D> records, osg::ref_ptr<osg::Texture2D> sprite, osg::ref_ptr<osg::Uniform> time,
+			osg::ref_ptr<osg::Uniform> viewportHeight);
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~ParticleShader();
+
+
+		/**
+		 * \brief Apply the shader to the given node.
+		 * 
+		 * \param node
+		 *      The node to which the shader should be applied.
+		 */
+		void apply(osg::Node* node) override;
+
+
+	private:
+
+		//! Source of the vertex-shader with the layout of the records.
+		std::string _vertSource;
+		//! Texture with the spawn-records of the particles.
+		osg::ref_ptr<osg::Texture2D> _records;
+		//! Texture of a particle.
+		osg::ref_ptr<osg::Texture2D> _sprite;
+		//! Uniform with the time of the frame.
+		osg::ref_ptr<osg::Uniform> _time;
+		//! Uniform with the height of the viewport.
+		osg::ref_ptr<osg::Uniform> _viewportHeight;
+
+	};
+}
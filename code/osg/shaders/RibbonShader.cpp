@@ -0,0 +1,79 @@
+﻿/**
+ * \brief Functionality for the fading of the following-ribbons.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-21
+ */
+
+#include "RibbonShader.h"
+
+#include <osg/Node>
+#include <osg/StateSet>
+#include <osg/Program>
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor. Initializes the shader-programms.
+ *
+ * \param color
+ *      Color of the ribbon.
+ * \param numSegments
+ *      Number of segments in the ring-buffer.
+ * \param head
+ *      Uniform with the index of the newest segment.
+ */
+RibbonShader::RibbonShader(osg::Vec3 color, unsigned int numSegments, osg::ref_ptr<osg::Uniform> head)
+	: _color(color), _numSegments(numSegments), _head(head) {
+	setVertShader(
+		"#version 150 compatibility\n"
+		"uniform int head;\n"
+		"uniform int numSegments;\n"
+		"out float alpha;\n"
+		"void main()\n"
+		"{\n"
+		// the last segment is the copy of the first one
+		"    int segment = (gl_VertexID / 2) % numSegments;\n"
+		"    int age = (head - segment + numSegments) % numSegments;\n"
+		"    alpha = sin(3.14159265359 * (1.0 - float(age) / float(numSegments)));\n"
+		"    gl_Position = ftransform();\n"
+		"}\n"
+	);
+
+	setFragShader(
+		"#version 150 compatibility\n"
+		"uniform vec3 color;\n"
+		"in float alpha;\n"
+
+		"void main (void)\n"
+		"{\n"
+		"    gl_FragColor = vec4(color, alpha);\n"
+		"}\n"
+	);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+RibbonShader::~RibbonShader() {}
+
+
+/**
+ * \brief Apply the shader to the given node.
+ *
+ * \param node
+ *      The node to which the shader should be applied.
+ */
+void RibbonShader::apply(osg::Node* node) {
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	program->addShader(new osg::Shader(osg::Shader::VERTEX, getVertShader()));
+	program->addShader(new osg::Shader(osg::Shader::FRAGMENT, getFragShader()));
+
+	osg::StateSet* stateset = node->getOrCreateStateSet();
+	stateset->setAttributeAndModes(program.get());
+	stateset->addUniform(new osg::Uniform("color", _color));
+	stateset->addUniform(new osg::Uniform("numSegments", static_cast<int>(_numSegments)));
+	stateset->addUniform(_head.get());
+}
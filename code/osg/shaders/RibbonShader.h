@@ -0,0 +1,61 @@
+﻿/**
+ * \brief Functionality for the fading of the following-ribbons.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-21
+ */
+
+#pragma once
+
+#include "Shader.h"
+#include <osg/Uniform>
+#include <osg/Vec3>
+
+namespace pbs17 {
+	/**
+	 * \brief The RibbonShader fades the segments of a following-ribbon by their age. The age of a vertex is computed
+	 * from its index in the ring-buffer and the head of the ribbon (see FollowingRibbon).
+	 */
+	class RibbonShader : public Shader {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initializes the shader-programms.
+		 *
+		 * \param color
+		 *      Color of the ribbon.
+		 * \param numSegments
+		 *      Number of segments in the ring-buffer.
+		 * \param head
+		 *      Uniform with the index of the newest segment.
+		 */
+		RibbonShader(osg::Vec3 color, unsigned int numSegments, osg::ref_ptr<osg::Uniform> head);
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~RibbonShader();
+
+
+		/**
+		 * \brief Apply the shader to the given node.
+		 * 
+		 * \param node
+		 *      The node to which the shader should be applied.
+		 */
+		void apply(osg::Node* node) override;
+
+
+	private:
+
+		//! Color of the ribbon.
+		osg::Vec3 _color;
+		//! Number of segments in the ring-buffer.
+		unsigned int _numSegments;
+		//! Uniform with the index of the newest segment.
+		osg::ref_ptr<osg::Uniform> _head;
+
+	};
+}
@@ -0,0 +1,102 @@
+﻿/**
+ * \brief Functionality for splatting the bodies into the density-target.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "SplatShader.h"
+
+#include <osg/Node>
+#include <osg/StateSet>
+#include <osg/Program>
+#include <osg/PointSprite>
+#include <osg/BlendFunc>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../MaterialCache.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor. Initializes the shader-programms.
+ *
+ * \param color
+ *      Color of a body with the mean mass.
+ * \param viewportHeight
+ *      Uniform with the height of the accumulation-target (updated by the update-traversal).
+ */
+SplatShader::SplatShader(osg::Vec3 color, osg::ref_ptr<osg::Uniform> viewportHeight)
+	: _color(color), _viewportHeight(viewportHeight) {
+	setVertShader(
+		"#version 150 compatibility\n"
+		"uniform float viewportHeight;\n"
+		"out float density;\n"
+		"out float isSprite;\n"
+
+		"void main()\n"
+		"{\n"
+		"    vec4 positionInEye = gl_ModelViewMatrix * gl_Vertex;\n"
+		"    gl_Position = gl_ProjectionMatrix * positionInEye;\n"
+
+		// the weight is spread over the area of the sprite (the mean of the falloff over the square is pi / 8)
+		"    float size = viewportHeight * gl_ProjectionMatrix[1][1] * gl_MultiTexCoord0.x / max(-positionInEye.z, 0.001);\n"
+		"    gl_PointSize = clamp(size, 1.0, 64.0);\n"
+		"    isSprite = step(1.5, gl_PointSize);\n"
+		"    density = gl_MultiTexCoord0.y * mix(1.0, 2.546479 / (gl_PointSize * gl_PointSize), isSprite);\n"
+		"}\n"
+	);
+
+	setFragShader(
+		"#version 150 compatibility\n"
+		"uniform vec3 color;\n"
+		"in float density;\n"
+		"in float isSprite;\n"
+
+		"void main (void)\n"
+		"{\n"
+		"    vec2 offset = 2.0 * gl_PointCoord - vec2(1.0);\n"
+		"    float falloff = mix(1.0, max(1.0 - dot(offset, offset), 0.0), isSprite);\n"
+		"    gl_FragColor = vec4(color * density * falloff, 1.0);\n"
+		"}\n"
+	);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+SplatShader::~SplatShader() {}
+
+
+/**
+ * \brief Apply the shader to the given node.
+ *
+ * \param node
+ *      The node to which the shader should be applied.
+ */
+void SplatShader::apply(osg::Node* node) {
+	osg::ref_ptr<osg::Program> program = MaterialCache::Instance()->getProgram(getVertShader(), getFragShader(),
+		std::vector<std::pair<std::string, unsigned int> >());
+
+	osg::StateSet* stateset = node->getOrCreateStateSet();
+	stateset->setAttributeAndModes(program.get());
+	stateset->addUniform(new osg::Uniform("color", _color));
+	stateset->addUniform(_viewportHeight.get());
+
+	// the size of the sprites is computed by the vertex-shader
+	osg::ref_ptr<osg::PointSprite> sprite = new osg::PointSprite;
+	sprite->setCoordOriginMode(osg::PointSprite::LOWER_LEFT);
+	stateset->setTextureAttributeAndModes(0, sprite.get(), osg::StateAttribute::ON);
+	stateset->setMode(GL_VERTEX_PROGRAM_POINT_SIZE, osg::StateAttribute::ON);
+
+	// the density is summed, so the bodies neither have to be sorted nor tested against the depth
+	stateset->setMode(GL_LIGHTING, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
+	stateset->setMode(GL_DEPTH_TEST, osg::StateAttribute::OFF);
+	stateset->setMode(GL_BLEND, osg::StateAttribute::ON);
+	stateset->setAttributeAndModes(new osg::BlendFunc(GL_ONE, GL_ONE));
+}
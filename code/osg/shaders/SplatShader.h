@@ -0,0 +1,58 @@
+﻿/**
+ * \brief Functionality for splatting the bodies into the density-target.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include "Shader.h"
+#include <osg/Uniform>
+#include <osg/Vec3>
+
+namespace pbs17 {
+	/**
+	 * \brief The SplatShader draws each body as an additive point-sprite of its projected size (at least a pixel).
+	 * The density of a sprite is divided by its area, so each body adds its weight to the target, independent of
+	 * the distance (see DensitySplat). The radius and the weight of a body are passed in the first texture-coordinate.
+	 */
+	class SplatShader : public Shader {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initializes the shader-programms.
+		 *
+		 * \param color
+		 *      Color of a body with the mean mass.
+		 * \param viewportHeight
+		 *      Uniform with the height of the accumulation-target (updated by the update-traversal).
+		 */
+		SplatShader(osg::Vec3 color, osg::ref_ptr<osg::Uniform> viewportHeight);
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~SplatShader();
+
+
+		/**
+		 * \brief Apply the shader to the given node.
+		 * 
+		 * \param node
+		 *      The node to which the shader should be applied.
+		 */
+		void apply(osg::Node* node) override;
+
+
+	private:
+
+		//! Color of a body with the mean mass.
+		osg::Vec3 _color;
+		//! Uniform with the height of the accumulation-target.
+		osg::ref_ptr<osg::Uniform> _viewportHeight;
+
+	};
+}
@@ -0,0 +1,76 @@
+﻿/**
+ * \brief Functionality for presenting the two eyes of the stereo-target side by side.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "StereoShader.h"
+
+#include <osg/Node>
+#include <osg/StateSet>
+#include <osg/Program>
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor. Initializes the shader-programms.
+ *
+ * \param color
+ *      Stereo-target with one layer per eye.
+ * \param scale
+ *      Uniform with the rendered part of the target (in texture-coordinates).
+ */
+StereoShader::StereoShader(osg::ref_ptr<osg::Texture2DArray> color, osg::ref_ptr<osg::Uniform> scale)
+	: _color(color), _scale(scale) {
+	setVertShader(
+		"#version 150 compatibility\n"
+		"out vec2 texCoord;\n"
+		"void main()\n"
+		"{\n"
+		"    texCoord = gl_MultiTexCoord0.xy;\n"
+		"    gl_Position = ftransform();\n"
+		"}\n"
+	);
+	setFragShader(
+		"#version 150 compatibility\n"
+		"uniform sampler2DArray color;\n"
+		"uniform vec2 scale;\n"
+		"in vec2 texCoord;\n"
+		"out vec4 fragColor;\n"
+		"void main (void)\n"
+		"{\n"
+		// the left half of the window shows layer 0, the right half layer 1
+		"    float eye = texCoord.x < 0.5 ? 0.0 : 1.0;\n"
+		"    vec2 uv = vec2(2.0 * texCoord.x - eye, texCoord.y) * scale;\n"
+		"    fragColor = vec4(texture(color, vec3(uv, eye)).rgb, 1.0);\n"
+		"}\n"
+	);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+StereoShader::~StereoShader() {}
+
+
+/**
+ * \brief Apply the shader to the given node.
+ *
+ * \param node
+ *      The node to which the shader should be applied.
+ */
+void StereoShader::apply(osg::Node* node) {
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	program->addShader(new osg::Shader(osg::Shader::VERTEX, getVertShader()));
+	program->addShader(new osg::Shader(osg::Shader::FRAGMENT, getFragShader()));
+
+	osg::StateSet* stateset = node->getOrCreateStateSet();
+	stateset->setAttributeAndModes(program.get());
+	// the arrays have no fixed-function mode
+	stateset->setTextureAttribute(0, _color.get());
+	stateset->addUniform(new osg::Uniform("color", 0));
+	stateset->addUniform(_scale.get());
+}
@@ -0,0 +1,57 @@
+﻿/**
+ * \brief Functionality for presenting the two eyes of the stereo-target side by side.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include "Shader.h"
+#include <osg/Texture2DArray>
+#include <osg/Uniform>
+
+namespace pbs17 {
+	/**
+	 * \brief The StereoShader draws the layers of the stereo-target over the two halves of the window (layer 0 => left
+	 * eye on the left half, see StereoRenderer).
+	 */
+	class StereoShader : public Shader {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initializes the shader-programms.
+		 *
+		 * \param color
+		 *      Stereo-target with one layer per eye.
+		 * \param scale
+		 *      Uniform with the rendered part of the target (in texture-coordinates).
+		 */
+		StereoShader(osg::ref_ptr<osg::Texture2DArray> color, osg::ref_ptr<osg::Uniform> scale);
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~StereoShader();
+
+
+		/**
+		 * \brief Apply the shader to the given node.
+		 * 
+		 * \param node
+		 *      The node to which the shader should be applied.
+		 */
+		void apply(osg::Node* node) override;
+
+
+	private:
+
+		//! Stereo-target with one layer per eye.
+		osg::ref_ptr<osg::Texture2DArray> _color;
+		//! Uniform with the rendered part of the target.
+		osg::ref_ptr<osg::Uniform> _scale;
+
+	};
+}
@@ -8,12 +8,196 @@
 #include "SunShader.h"
 
 #include <osg/Node>
+#include <osg/NodeVisitor>
+#include <osg/FrameStamp>
 #include <osg/StateSet>
 #include <osg/Program>
 
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../ImageManager.h"
+#include "../MaterialCache.h"
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 using namespace pbs17;
 
 
+namespace {
+
+	//! Fragment-shader of all variants (the noise-mode is defined in front of it)
+	const char* FRAGMENT_SHADER =
+		"uniform sampler2D colorTex;\n"
+		"uniform sampler2D normalTex;\n"
+		"uniform bool twoChannelNormals;\n"
+		"uniform vec4 lightAmbient;\n"
+		"uniform vec4 lightDiffuse;\n"
+		"uniform vec4 lightSpecular;\n"
+		"uniform vec4 materialAmbient;\n"
+		"uniform vec4 materialDiffuse;\n"
+		"uniform vec4 materialSpecular;\n"
+		"uniform float materialShininess;\n"
+		"uniform float sunTime;\n"
+		"in vec3 lightDir;\n"
+		"in vec2 texCoord;\n"
+		"out vec4 fragColor;\n"
+
+		"#if defined(NOISE_BAKED)\n"
+		"uniform sampler3D noiseTex;\n"
+		"#elif defined(NOISE_PROCEDURAL)\n"
+		// same noise as the baked one (see SunShader::getNoiseTexture())
+		"float lattice(ivec3 p, int period)\n"
+		"{\n"
+		"    uvec3 q = uvec3(p & ivec3(period - 1));\n"
+		"    uint h = (q.x * 73856093u) ^ (q.y * 19349663u) ^ (q.z * 83492791u) ^ uint(period);\n"
+		"    h ^= h >> 16u;\n"
+		"    h *= 0x7feb352du;\n"
+		"    h ^= h >> 15u;\n"
+		"    h *= 0x846ca68bu;\n"
+		"    h ^= h >> 16u;\n"
+		"    return float(h >> 8u) / 16777216.0;\n"
+		"}\n"
+
+		"float valueNoise(vec3 p, int period)\n"
+		"{\n"
+		"    p *= float(period);\n"
+		"    ivec3 i = ivec3(floor(p));\n"
+		"    vec3 f = p - floor(p);\n"
+		"    f = f * f * (3.0 - 2.0 * f);\n"
+		"    float x00 = mix(lattice(i, period), lattice(i + ivec3(1, 0, 0), period), f.x);\n"
+		"    float x10 = mix(lattice(i + ivec3(0, 1, 0), period), lattice(i + ivec3(1, 1, 0), period), f.x);\n"
+		"    float x01 = mix(lattice(i + ivec3(0, 0, 1), period), lattice(i + ivec3(1, 0, 1), period), f.x);\n"
+		"    float x11 = mix(lattice(i + ivec3(0, 1, 1), period), lattice(i + ivec3(1, 1, 1), period), f.x);\n"
+		"    return mix(mix(x00, x10, f.y), mix(x01, x11, f.y), f.z);\n"
+		"}\n"
+
+		"float fbm(vec3 p)\n"
+		"{\n"
+		"    return valueNoise(p, 4) * 0.57 + valueNoise(p, 8) * 0.28 + valueNoise(p, 16) * 0.15;\n"
+		"}\n"
+		"#endif\n"
+
+		"void main (void)\n"
+		"{\n"
+		"    vec4 base = texture(colorTex, texCoord);\n"
+		"    vec3 bump = texture(normalTex, texCoord).xyz * 2.0 - 1.0;\n"
+		"    if (twoChannelNormals) bump.z = sqrt(max(1.0 - dot(bump.xy, bump.xy), 0.0));\n"
+		"    bump = normalize(bump);\n"
+
+		// the noise tiles in all dimensions, the time loops through the third one
+		"#if defined(NOISE_BAKED) || defined(NOISE_PROCEDURAL)\n"
+		"    vec3 noiseCoord = vec3(texCoord * vec2(4.0, 2.0), fract(sunTime * 0.02));\n"
+		"#if defined(NOISE_BAKED)\n"
+		"    float noise = texture(noiseTex, noiseCoord).r;\n"
+		"#else\n"
+		"    float noise = fbm(fract(noiseCoord));\n"
+		"#endif\n"
+		"    base.rgb *= 0.6 + 0.8 * noise;\n"
+		"#endif\n"
+
+		"    float lambert = abs(dot(bump, lightDir));\n"
+		"    vec4 diffuse = vec4(0.0, 0.0, 0.0, 0.0);\n"
+		"    vec4 specular = vec4(0.0, 0.0, 0.0, 0.0);\n"
+		"    vec4 ambient = base * materialAmbient * lightAmbient;\n"
+
+		"    if (lambert > 0.0)\n"
+		"    {\n"
+		"        diffuse = materialDiffuse * base * lightDiffuse * lambert;\n"
+		"        specular = materialSpecular * lightSpecular * pow(lambert, materialShininess);\n"
+		"    }\n"
+		"    fragColor = ambient + diffuse + specular;\n"
+		"}\n";
+
+
+	/**
+	 * \brief Value of the noise-lattice (same hash as the procedural shader).
+	 *
+	 * \param x, y, z
+	 *      Point of the lattice.
+	 * \param period
+	 *      Period of the lattice (power of two).
+	 *
+	 * \return Value in [0, 1).
+	 */
+	float lattice(int x, int y, int z, int period) {
+		uint32_t h = (static_cast<uint32_t>(x & (period - 1)) * 73856093u) ^ (static_cast<uint32_t>(y & (period - 1)) * 19349663u)
+			^ (static_cast<uint32_t>(z & (period - 1)) * 83492791u) ^ static_cast<uint32_t>(period);
+		h ^= h >> 16;
+		h *= 0x7feb352du;
+		h ^= h >> 15;
+		h *= 0x846ca68bu;
+		h ^= h >> 16;
+		return static_cast<float>(h >> 8) / 16777216.0f;
+	}
+
+
+	/**
+	 * \brief Tiling value-noise (smoothstep-interpolated).
+	 *
+	 * \param x, y, z
+	 *      Point in the tile [0, 1)^3.
+	 * \param period
+	 *      Number of lattice-cells per tile.
+	 *
+	 * \return Noise in [0, 1).
+	 */
+	float valueNoise(float x, float y, float z, int period) {
+		x *= period;
+		y *= period;
+		z *= period;
+		int ix = static_cast<int>(std::floor(x));
+		int iy = static_cast<int>(std::floor(y));
+		int iz = static_cast<int>(std::floor(z));
+		float fx = x - ix, fy = y - iy, fz = z - iz;
+		fx = fx * fx * (3.0f - 2.0f * fx);
+		fy = fy * fy * (3.0f - 2.0f * fy);
+		fz = fz * fz * (3.0f - 2.0f * fz);
+
+		float value[2];
+		for (int k = 0; k < 2; ++k) {
+			float x0 = lattice(ix, iy, iz + k, period) * (1.0f - fx) + lattice(ix + 1, iy, iz + k, period) * fx;
+			float x1 = lattice(ix, iy + 1, iz + k, period) * (1.0f - fx) + lattice(ix + 1, iy + 1, iz + k, period) * fx;
+			value[k] = x0 * (1.0f - fy) + x1 * fy;
+		}
+
+		return value[0] * (1.0f - fz) + value[1] * fz;
+	}
+
+
+	/**
+	 * \brief Writes the time of the frame into the uniform.
+	 */
+	class TimeUniformCallback : public osg::Uniform::Callback {
+	public:
+		void operator()(osg::Uniform* uniform, osg::NodeVisitor* nv) override {
+			if (nv->getFrameStamp()) {
+				uniform->set(static_cast<float>(nv->getFrameStamp()->getSimulationTime()));
+			}
+		}
+	};
+}
+
+
+//! The suns are not animated by default.
+SunShader::NoiseMode SunShader::NOISE_MODE = SunShader::NOISE_OFF;
+
+//! Number of texels of the baked noise per dimension (256 KB, the finest octave has 4 texels per cell)
+const int SunShader::NOISE_SIZE = 64;
+
+//! Baked noise
+osg::ref_ptr<osg::Texture3D> SunShader::NOISE_TEXTURE;
+
+//! Time of the animation
+osg::ref_ptr<osg::Uniform> SunShader::TIME_UNIFORM;
+
+
 /**
  * \brief Constructor. Initializes the shader-programms.
  *
@@ -25,50 +209,35 @@ using namespace pbs17;
 SunShader::SunShader(osg::ref_ptr<osg::Texture2D> texture, osg::ref_ptr<osg::Texture2D> normals)
 	: _texture(texture), _normals(normals) {
 	setVertShader(
-		"attribute vec3 tangent;\n"
-		"attribute vec3 binormal;\n"
-		"varying vec3 lightDir;\n"
-		"varying vec3 position;\n"
+		"#version 150 compatibility\n"
+		"in vec3 tangent;\n"
+		"in vec3 binormal;\n"
+		"uniform mat4 osg_ViewMatrix;\n"
+		"uniform vec4 lightPosition;\n"
+		"out vec3 lightDir;\n"
+		"out vec2 texCoord;\n"
 		"void main()\n"
 		"{\n"
 		"    vec3 normal = normalize(gl_NormalMatrix * gl_Normal);\n"
 		"    mat3 rotation = mat3(tangent, binormal, normal);\n"
 		"    vec4 vertexInEye = gl_ModelViewMatrix * gl_Vertex;\n"
-		"    lightDir = vec3(gl_LightSource[0].position.xyz - vertexInEye.xyz);\n"
+		// w = 1: position of the sun in the world, w = 0: direction of the headlight in the eye-space (see MaterialCache)
+		"    lightDir = lightPosition.w > 0.0 ? (osg_ViewMatrix * lightPosition).xyz - vertexInEye.xyz : lightPosition.xyz;\n"
 		"    lightDir = normalize(normalize(lightDir) * rotation);\n"
-		"    gl_Position = ftransform();\n"
-		"	 position = gl_Vertex.xyz;\n"
-		"    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+		"    gl_Position = gl_ProjectionMatrix * vertexInEye;\n"
+		// the texture-matrix decodes the quantized texture-coordinates (see QuantizeVisitor)
+		"    texCoord = (gl_TextureMatrix[0] * gl_MultiTexCoord0).xy;\n"
 		"}\n"
 	);
 
-	setFragShader(
-		"uniform sampler2D colorTex;\n"
-		"uniform sampler2D normalTex;\n"
-		"uniform vec3 CAMERA_POSITION;\n"
-		"varying vec3 lightDir;\n"
-		"varying vec3 position;\n"
-
-		"void main (void)\n"
-		"{\n"
-		"    vec4 base = texture2D(colorTex, gl_TexCoord[0].xy);\n"
-		"    vec3 bump = texture2D(normalTex, gl_TexCoord[0].xy).xyz;\n"
-		"    bump = normalize(bump * 2.0 - 1.0);\n"
-
-		"    float lambert = abs(dot(bump, lightDir));\n"
-		"	 gl_FragColor = vec4(0.0, 0.0, 0.0, 0.0);\n"
-		"	 vec4 diffuse = vec4(0.0, 0.0, 0.0, 0.0);\n"
-		"	 vec4 specular = vec4(0.0, 0.0, 0.0, 0.0);\n"
-		"	 vec4 ambient = base * gl_FrontMaterial.ambient * gl_LightSource[0].ambient;\n"
-
-		"    if (lambert > 0.0)\n"
-		"    {\n"
-		"        diffuse = gl_FrontMaterial.diffuse * base * gl_LightSource[0].diffuse * lambert;\n"
-		"        specular = gl_FrontMaterial.specular * gl_LightSource[0].specular * pow(lambert, gl_FrontMaterial.shininess);\n"
-		"    }\n"
-		"    gl_FragColor += ambient + diffuse + specular;\n"
-		"}\n"
-	);
+	_fragSource = "#version 150 compatibility\n";
+	if (NOISE_MODE == NOISE_BAKED) {
+		_fragSource += "#define NOISE_BAKED\n";
+	} else if (NOISE_MODE == NOISE_PROCEDURAL) {
+		_fragSource += "#define NOISE_PROCEDURAL\n";
+	}
+	_fragSource += FRAGMENT_SHADER;
+	setFragShader(&_fragSource[0]);
 }
 
 
@@ -85,21 +254,122 @@ SunShader::~SunShader() {}
  *      The node to which the shader should be applied.
  */
 void SunShader::apply(osg::Node* node) {
-	// Initialise the vertex and fragment shader and load the correct parameters.
-	osg::ref_ptr<osg::Program> program = new osg::Program;
-	program->addShader(new osg::Shader(osg::Shader::VERTEX, getVertShader()));
-	program->addShader(new osg::Shader(osg::Shader::FRAGMENT, getFragShader()));
-	program->addBindAttribLocation("random_noise", 6);
-	program->addBindAttribLocation("binormal", 7);
+	apply(node->getOrCreateStateSet());
+}
+
+
+/**
+ * \brief Apply the shader to the given state-set (e.g. a state-set which is shared by several nodes).
+ *
+ * \param stateset
+ *      The state-set to which the shader should be applied.
+ */
+void SunShader::apply(osg::StateSet* stateset) {
+	// Initialise the vertex and fragment shader and load the correct parameters (the program is shared by all nodes).
+	std::vector<std::pair<std::string, unsigned int> > bindings;
+	bindings.push_back(std::make_pair(std::string("random_noise"), 6u));
+	bindings.push_back(std::make_pair(std::string("binormal"), 7u));
+	osg::ref_ptr<osg::Program> program = MaterialCache::Instance()->getProgram(getVertShader(), getFragShader(), bindings);
 
 	// Apply the textures to the state-set.
-	osg::StateSet* stateset = node->getOrCreateStateSet();
 	stateset->setAttributeAndModes(program.get());
 	stateset->addUniform(new osg::Uniform("colorTex", 0));
 	stateset->addUniform(new osg::Uniform("normalTex", 7));
+	// BC5 stores only x and y of the normals (see ImageManager)
+	stateset->addUniform(ImageManager::Instance()->getTwoChannelUniform(_normals.get()));
 
 	osg::StateAttribute::GLModeValue value = osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE;
 	stateset->setTextureAttributeAndModes(0, _texture.get(), value);
 	stateset->setTextureAttributeAndModes(1, _normals.get(), value);
 
-}
\ No newline at end of file
+	if (NOISE_MODE != NOISE_OFF) {
+		stateset->addUniform(getTimeUniform().get());
+	}
+	if (NOISE_MODE == NOISE_BAKED) {
+		stateset->setTextureAttribute(2, getNoiseTexture().get(), value);
+		stateset->addUniform(new osg::Uniform("noiseTex", 2));
+	}
+}
+
+
+/**
+ * \brief Parse the name of a noise-mode.
+ *
+ * \param name
+ *      Name of the mode (off, baked, procedural).
+ * \param mode
+ *      Output-parameter: Parsed mode.
+ *
+ * \return False if the name is unknown.
+ */
+bool SunShader::parseNoiseMode(const std::string &name, NoiseMode &mode) {
+	if (name == "off") {
+		mode = NOISE_OFF;
+	} else if (name == "baked") {
+		mode = NOISE_BAKED;
+	} else if (name == "procedural") {
+		mode = NOISE_PROCEDURAL;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Get the baked noise (baked at the first call, shared by all suns).
+ *
+ * \return Tiling 3D-texture of the noise.
+ */
+osg::ref_ptr<osg::Texture3D> SunShader::getNoiseTexture() {
+	if (NOISE_TEXTURE.valid()) {
+		return NOISE_TEXTURE;
+	}
+
+	// the texels sample the same fbm as the procedural shader, at their centers
+	osg::ref_ptr<osg::Image> image = new osg::Image;
+	image->allocateImage(NOISE_SIZE, NOISE_SIZE, NOISE_SIZE, GL_LUMINANCE, GL_UNSIGNED_BYTE);
+	image->setInternalTextureFormat(GL_LUMINANCE8);
+	unsigned char* data = image->data();
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int z = 0; z < NOISE_SIZE; ++z) {
+		for (int y = 0; y < NOISE_SIZE; ++y) {
+			for (int x = 0; x < NOISE_SIZE; ++x) {
+				float px = (x + 0.5f) / NOISE_SIZE, py = (y + 0.5f) / NOISE_SIZE, pz = (z + 0.5f) / NOISE_SIZE;
+				float noise = valueNoise(px, py, pz, 4) * 0.57f + valueNoise(px, py, pz, 8) * 0.28f
+					+ valueNoise(px, py, pz, 16) * 0.15f;
+				data[(z * NOISE_SIZE + y) * NOISE_SIZE + x] = static_cast<unsigned char>(std::min(noise, 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	}
+
+	NOISE_TEXTURE = new osg::Texture3D;
+	NOISE_TEXTURE->setImage(image.get());
+	NOISE_TEXTURE->setWrap(osg::Texture::WRAP_S, osg::Texture::REPEAT);
+	NOISE_TEXTURE->setWrap(osg::Texture::WRAP_T, osg::Texture::REPEAT);
+	NOISE_TEXTURE->setWrap(osg::Texture::WRAP_R, osg::Texture::REPEAT);
+	NOISE_TEXTURE->setFilter(osg::Texture::MIN_FILTER, osg::Texture::LINEAR);
+	NOISE_TEXTURE->setFilter(osg::Texture::MAG_FILTER, osg::Texture::LINEAR);
+
+	return NOISE_TEXTURE;
+}
+
+
+/**
+ * \brief Get the time of the animation (updated by the update-traversal, shared by all suns).
+ *
+ * \return Uniform of the time.
+ */
+osg::ref_ptr<osg::Uniform> SunShader::getTimeUniform() {
+	if (!TIME_UNIFORM.valid()) {
+		TIME_UNIFORM = new osg::Uniform("sunTime", 0.0f);
+		TIME_UNIFORM->setDataVariance(osg::Object::DYNAMIC);
+		TIME_UNIFORM->setUpdateCallback(new TimeUniformCallback);
+	}
+
+	return TIME_UNIFORM;
+}
@@ -8,16 +8,35 @@
 #pragma once
 
 #include "Shader.h"
+#include <osg/StateSet>
 #include <osg/Texture2D>
+#include <osg/Texture3D>
+#include <osg/Uniform>
+
+#include <string>
 
 namespace pbs17 {
 	/**
-	 * \brief The SunShader is used to simulate the sun.
+	 * \brief The SunShader is used to simulate the sun. Optionally, the surface is animated by a granulation of
+	 * tiling fbm-noise, which is either sampled from a 3D-texture (baked once at the startup, the time is its third
+	 * coordinate) or evaluated per fragment (same noise, the quality option).
 	 */
 	class SunShader : public Shader {
 
 	public:
 
+		/**
+		 * \brief Source of the noise of the granulation.
+		 */
+		enum NoiseMode {
+			//! No granulation (only the textures)
+			NOISE_OFF,
+			//! Sampled from the baked 3D-texture
+			NOISE_BAKED,
+			//! Evaluated per fragment
+			NOISE_PROCEDURAL
+		};
+
 		/**
 		 * \brief Constructor. Initializes the shader-programms.
 		 *
@@ -44,8 +63,78 @@ namespace pbs17 {
 		void apply(osg::Node* node) override;
 
 
+		/**
+		 * \brief Apply the shader to the given state-set (e.g. a state-set which is shared by several nodes).
+		 *
+		 * \param stateset
+		 *      The state-set to which the shader should be applied.
+		 */
+		void apply(osg::StateSet* stateset);
+
+
+		/**
+		 * \brief Parse the name of a noise-mode.
+		 *
+		 * \param name
+		 *      Name of the mode (off, baked, procedural).
+		 * \param mode
+		 *      Output-parameter: Parsed mode.
+		 *
+		 * \return False if the name is unknown.
+		 */
+		static bool parseNoiseMode(const std::string &name, NoiseMode &mode);
+
+
+		/**
+		 * \brief Set the source of the noise of the granulation (has to be set before loading the scene).
+		 *
+		 * \param mode
+		 *      Source of the noise.
+		 */
+		static void setNoiseMode(NoiseMode mode) {
+			NOISE_MODE = mode;
+		}
+
+
+		/**
+		 * \brief Get the source of the noise of the granulation.
+		 *
+		 * \return Source of the noise.
+		 */
+		static NoiseMode getNoiseMode() {
+			return NOISE_MODE;
+		}
+
+
 	private:
 
+		/**
+		 * \brief Get the baked noise (baked at the first call, shared by all suns).
+		 *
+		 * \return Tiling 3D-texture of the noise.
+		 */
+		static osg::ref_ptr<osg::Texture3D> getNoiseTexture();
+
+
+		/**
+		 * \brief Get the time of the animation (updated by the update-traversal, shared by all suns).
+		 *
+		 * \return Uniform of the time.
+		 */
+		static osg::ref_ptr<osg::Uniform> getTimeUniform();
+
+		//! Source of the granulation
+		static NoiseMode NOISE_MODE;
+		//! Number of texels of the baked noise per dimension
+		static const int NOISE_SIZE;
+		//! Baked noise (nullptr until the first baked sun)
+		static osg::ref_ptr<osg::Texture3D> NOISE_TEXTURE;
+		//! Time of the animation
+		static osg::ref_ptr<osg::Uniform> TIME_UNIFORM;
+
+		//! Source of the fragment-shader with the defines of the noise.
+		std::string _fragSource;
+
 		//! The image-texture to apply.
 		osg::ref_ptr<osg::Texture2D> _texture;
 		//! The normal-texture to apply.
@@ -0,0 +1,81 @@
+﻿/**
+ * \brief Functionality for tone-mapping the density-target onto the scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "ToneMapShader.h"
+
+#include <osg/Node>
+#include <osg/StateSet>
+#include <osg/Program>
+#include <osg/BlendFunc>
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor. Initializes the shader-programms.
+ *
+ * \param density
+ *      HDR-target with the accumulated density.
+ * \param scale
+ *      Uniform with the rendered part of the target (in texture-coordinates).
+ * \param exposure
+ *      Uniform with the factor of the density.
+ */
+ToneMapShader::ToneMapShader(osg::ref_ptr<osg::Texture2D> density, osg::ref_ptr<osg::Uniform> scale, osg::ref_ptr<osg::Uniform> exposure)
+	: _density(density), _scale(scale), _exposure(exposure) {
+	setVertShader(
+		"#version 120\n"
+		"void main()\n"
+		"{\n"
+		"    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+		"    gl_Position = ftransform();\n"
+		"}\n"
+	);
+	setFragShader(
+		"#version 120\n"
+		"uniform sampler2D density;\n"
+		"uniform vec2 scale;\n"
+		"uniform float exposure;\n"
+		"void main (void)\n"
+		"{\n"
+		"    vec3 hdr = texture2D(density, gl_TexCoord[0].xy * scale).rgb;\n"
+		"    gl_FragColor = vec4(vec3(1.0) - exp(-exposure * hdr), 1.0);\n"
+		"}\n"
+	);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+ToneMapShader::~ToneMapShader() {}
+
+
+/**
+ * \brief Apply the shader to the given node.
+ *
+ * \param node
+ *      The node to which the shader should be applied.
+ */
+void ToneMapShader::apply(osg::Node* node) {
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	program->addShader(new osg::Shader(osg::Shader::VERTEX, getVertShader()));
+	program->addShader(new osg::Shader(osg::Shader::FRAGMENT, getFragShader()));
+
+	osg::StateSet* stateset = node->getOrCreateStateSet();
+	stateset->setAttributeAndModes(program.get());
+	stateset->setTextureAttributeAndModes(0, _density.get());
+	stateset->addUniform(new osg::Uniform("density", 0));
+	stateset->addUniform(_scale.get());
+	stateset->addUniform(_exposure.get());
+
+	// the splats light up the background (the models are hidden meanwhile)
+	stateset->setMode(GL_LIGHTING, osg::StateAttribute::OFF | osg::StateAttribute::PROTECTED);
+	stateset->setMode(GL_DEPTH_TEST, osg::StateAttribute::OFF);
+	stateset->setMode(GL_BLEND, osg::StateAttribute::ON);
+	stateset->setAttributeAndModes(new osg::BlendFunc(GL_ONE, GL_ONE));
+}
@@ -0,0 +1,62 @@
+﻿/**
+ * \brief Functionality for tone-mapping the density-target onto the scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include "Shader.h"
+#include <osg/Texture2D>
+#include <osg/Uniform>
+
+namespace pbs17 {
+	/**
+	 * \brief The ToneMapShader draws the rendered part of the density-target over the whole window. The accumulated
+	 * density is mapped exponentially (1 - e^(-exposure * density)), so the dense core saturates smoothly while the
+	 * sparse arms stay visible, and the result is added to the scene (see DensitySplat).
+	 */
+	class ToneMapShader : public Shader {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initializes the shader-programms.
+		 *
+		 * \param density
+		 *      HDR-target with the accumulated density.
+		 * \param scale
+		 *      Uniform with the rendered part of the target (in texture-coordinates).
+		 * \param exposure
+		 *      Uniform with the factor of the density.
+		 */
+		ToneMapShader(osg::ref_ptr<osg::Texture2D> density, osg::ref_ptr<osg::Uniform> scale, osg::ref_ptr<osg::Uniform> exposure);
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~ToneMapShader();
+
+
+		/**
+		 * \brief Apply the shader to the given node.
+		 * 
+		 * \param node
+		 *      The node to which the shader should be applied.
+		 */
+		void apply(osg::Node* node) override;
+
+
+	private:
+
+		//! HDR-target with the accumulated density.
+		osg::ref_ptr<osg::Texture2D> _density;
+		//! Uniform with the rendered part of the target.
+		osg::ref_ptr<osg::Uniform> _scale;
+		//! Uniform with the factor of the density.
+		osg::ref_ptr<osg::Uniform> _exposure;
+
+	};
+}
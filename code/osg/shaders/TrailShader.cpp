@@ -0,0 +1,113 @@
+﻿/**
+ * \brief Functionality for the shading of the shared trail-system.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-22
+ */
+
+#include "TrailShader.h"
+
+#include <osg/Node>
+#include <osg/StateSet>
+#include <osg/Program>
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor. Initializes the shader-programms.
+ *
+ * \param history
+ *      Texture with the samples of all trails (one band of rows per sample).
+ * \param parameters
+ *      Texture-buffer with the color, half-width and number of samples of each trail.
+ * \param numSamples
+ *      Number of samples in the ring-buffer.
+ * \param width, height
+ *      Size of a band of the history-texture.
+ * \param head
+ *      Uniform with the index of the newest sample.
+ */
+TrailShader::TrailShader(osg::ref_ptr<osg::Texture2D> history, osg::ref_ptr<osg::TextureBuffer> parameters, unsigned int numSamples,
+	unsigned int width, unsigned int height, osg::ref_ptr<osg::Uniform> head)
+	: _history(history), _parameters(parameters), _numSamples(numSamples), _width(width), _height(height), _head(head) {
+	setVertShader(
+		"#version 150 compatibility\n"
+		"uniform sampler2D history;\n"
+		"uniform samplerBuffer parameters;\n"
+		"uniform int head;\n"
+		"uniform int numSamples;\n"
+		// samples before the oldest drawn one are skipped (shortened trails, see TrailSystem::setLength())
+		"uniform int oldest;\n"
+		"uniform int width;\n"
+		"uniform int height;\n"
+		"out vec4 color;\n"
+
+		// sample 0 is the oldest one of the ring-buffer
+		"vec3 getSample(int trail, int index)\n"
+		"{\n"
+		"    int band = (head + 1 + index) % numSamples;\n"
+		"    return texelFetch(history, ivec2(trail % width, band * height + trail / width), 0).xyz;\n"
+		"}\n"
+
+		"void main()\n"
+		"{\n"
+		"    int trail = gl_InstanceID;\n"
+		"    vec4 parameter = texelFetch(parameters, 2 * trail);\n"
+		"    int first = max(numSamples - int(texelFetch(parameters, 2 * trail + 1).x), oldest);\n"
+
+		// the samples before the first one of a shorter trail collapse into it
+		"    int index = max(int(gl_Vertex.x), first);\n"
+		"    vec3 position = getSample(trail, index);\n"
+		"    vec3 tangent = getSample(trail, min(index + 1, numSamples - 1)) - getSample(trail, max(index - 1, first));\n"
+		"    vec3 toCamera = (gl_ModelViewMatrixInverse * vec4(0.0, 0.0, 0.0, 1.0)).xyz - position;\n"
+		"    vec3 side = cross(tangent, toCamera);\n"
+		"    float sideLength = length(side);\n"
+		"    side = sideLength > 0.0 ? side / sideLength : vec3(0.0);\n"
+
+		"    float age = float(index - first) / float(max(numSamples - 1 - first, 1));\n"
+		"    color = vec4(parameter.rgb, sin(3.14159265359 * age));\n"
+		"    gl_Position = gl_ModelViewProjectionMatrix * vec4(position + gl_Vertex.y * parameter.w * side, 1.0);\n"
+		"}\n"
+	);
+
+	setFragShader(
+		"#version 150 compatibility\n"
+		"in vec4 color;\n"
+
+		"void main (void)\n"
+		"{\n"
+		"    gl_FragColor = color;\n"
+		"}\n"
+	);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+TrailShader::~TrailShader() {}
+
+
+/**
+ * \brief Apply the shader to the given node.
+ *
+ * \param node
+ *      The node to which the shader should be applied.
+ */
+void TrailShader::apply(osg::Node* node) {
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	program->addShader(new osg::Shader(osg::Shader::VERTEX, getVertShader()));
+	program->addShader(new osg::Shader(osg::Shader::FRAGMENT, getFragShader()));
+
+	osg::StateSet* stateset = node->getOrCreateStateSet();
+	stateset->setAttributeAndModes(program.get());
+	stateset->setTextureAttribute(0, _history.get());
+	stateset->setTextureAttribute(1, _parameters.get());
+	stateset->addUniform(new osg::Uniform("history", 0));
+	stateset->addUniform(new osg::Uniform("parameters", 1));
+	stateset->addUniform(new osg::Uniform("numSamples", static_cast<int>(_numSamples)));
+	stateset->addUniform(new osg::Uniform("width", static_cast<int>(_width)));
+	stateset->addUniform(new osg::Uniform("height", static_cast<int>(_height)));
+	stateset->addUniform(_head.get());
+}
@@ -0,0 +1,71 @@
+﻿/**
+ * \brief Functionality for the shading of the shared trail-system.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-22
+ */
+
+#pragma once
+
+#include "Shader.h"
+#include <osg/Texture2D>
+#include <osg/TextureBuffer>
+#include <osg/Uniform>
+
+namespace pbs17 {
+	/**
+	 * \brief The TrailShader builds the ribbons of all trails from their samples (see TrailSystem). Each instance is
+	 * a trail, each pair of vertices is a sample, which is faced to the camera and faded by its age.
+	 */
+	class TrailShader : public Shader {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initializes the shader-programms.
+		 *
+		 * \param history
+		 *      Texture with the samples of all trails (one band of rows per sample).
+		 * \param parameters
+		 *      Texture-buffer with the color, half-width and number of samples of each trail.
+		 * \param numSamples
+		 *      Number of samples in the ring-buffer.
+		 * \param width, height
+		 *      Size of a band of the history-texture.
+		 * \param head
+		 *      Uniform with the index of the newest sample.
+		 */
+		TrailShader(osg::ref_ptr<osg::Texture2D> history, osg::ref_ptr<osg::TextureBuffer> parameters, unsigned int numSamples,
+			unsigned int width, unsigned int height, osg::ref_ptr<osg::Uniform> head);
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~TrailShader();
+
+
+		/**
+		 * \brief Apply the shader to the given node.
+		 * 
+		 * \param node
+		 *      The node to which the shader should be applied.
+		 */
+		void apply(osg::Node* node) override;
+
+
+	private:
+
+		//! Texture with the samples of all trails.
+		osg::ref_ptr<osg::Texture2D> _history;
+		//! Texture-buffer with the parameters of each trail.
+		osg::ref_ptr<osg::TextureBuffer> _parameters;
+		//! Number of samples in the ring-buffer.
+		unsigned int _numSamples;
+		//! Size of a band of the history-texture.
+		unsigned int _width, _height;
+		//! Uniform with the index of the newest sample.
+		osg::ref_ptr<osg::Uniform> _head;
+
+	};
+}
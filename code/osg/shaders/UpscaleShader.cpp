@@ -0,0 +1,92 @@
+﻿/**
+ * \brief Functionality for upscaling and sharpening the offscreen-target of the dynamic resolution.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "UpscaleShader.h"
+
+#include <osg/Node>
+#include <osg/StateSet>
+#include <osg/Program>
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor. Initializes the shader-programms.
+ *
+ * \param color
+ *      Offscreen-target which is upscaled.
+ * \param scale
+ *      Uniform with the rendered part of the target (in texture-coordinates).
+ * \param texelSize
+ *      Uniform with the size of a texel of the target (in texture-coordinates).
+ * \param sharpness
+ *      Uniform with the strength of the sharpening (0 => none).
+ */
+UpscaleShader::UpscaleShader(osg::ref_ptr<osg::Texture2D> color, osg::ref_ptr<osg::Uniform> scale, osg::ref_ptr<osg::Uniform> texelSize,
+	osg::ref_ptr<osg::Uniform> sharpness)
+	: _color(color), _scale(scale), _texelSize(texelSize), _sharpness(sharpness) {
+	setVertShader(
+		"#version 120\n"
+		"void main()\n"
+		"{\n"
+		"    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+		"    gl_Position = ftransform();\n"
+		"}\n"
+	);
+	setFragShader(
+		"#version 120\n"
+		"uniform sampler2D color;\n"
+		"uniform vec2 scale;\n"
+		"uniform vec2 texelSize;\n"
+		"uniform float sharpness;\n"
+		// the samples stay inside the rendered part, so the stale texels outside of it do not bleed in
+		"vec3 fetch(vec2 uv)\n"
+		"{\n"
+		"    return texture2D(color, clamp(uv, 0.5 * texelSize, scale - 0.5 * texelSize)).rgb;\n"
+		"}\n"
+		"void main (void)\n"
+		"{\n"
+		"    vec2 uv = gl_TexCoord[0].xy * scale;\n"
+		"    vec3 center = fetch(uv);\n"
+		"    vec3 north = fetch(uv + vec2(0.0, texelSize.y));\n"
+		"    vec3 south = fetch(uv - vec2(0.0, texelSize.y));\n"
+		"    vec3 east = fetch(uv + vec2(texelSize.x, 0.0));\n"
+		"    vec3 west = fetch(uv - vec2(texelSize.x, 0.0));\n"
+		"    vec3 low = min(center, min(min(north, south), min(east, west)));\n"
+		"    vec3 high = max(center, max(max(north, south), max(east, west)));\n"
+		"    vec3 sharpened = center + sharpness * (4.0 * center - north - south - east - west);\n"
+		"    gl_FragColor = vec4(clamp(sharpened, low, high), 1.0);\n"
+		"}\n"
+	);
+}
+
+
+/**
+ * \brief Destructor.
+ */
+UpscaleShader::~UpscaleShader() {}
+
+
+/**
+ * \brief Apply the shader to the given node.
+ *
+ * \param node
+ *      The node to which the shader should be applied.
+ */
+void UpscaleShader::apply(osg::Node* node) {
+	osg::ref_ptr<osg::Program> program = new osg::Program;
+	program->addShader(new osg::Shader(osg::Shader::VERTEX, getVertShader()));
+	program->addShader(new osg::Shader(osg::Shader::FRAGMENT, getFragShader()));
+
+	osg::StateSet* stateset = node->getOrCreateStateSet();
+	stateset->setAttributeAndModes(program.get());
+	stateset->setTextureAttributeAndModes(0, _color.get());
+	stateset->addUniform(new osg::Uniform("color", 0));
+	stateset->addUniform(_scale.get());
+	stateset->addUniform(_texelSize.get());
+	stateset->addUniform(_sharpness.get());
+}
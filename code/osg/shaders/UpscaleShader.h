@@ -0,0 +1,67 @@
+﻿/**
+ * \brief Functionality for upscaling and sharpening the offscreen-target of the dynamic resolution.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include "Shader.h"
+#include <osg/Texture2D>
+#include <osg/Uniform>
+
+namespace pbs17 {
+	/**
+	 * \brief The UpscaleShader draws the rendered part of the offscreen-target over the whole window (bilinear) and
+	 * sharpens it with an unsharp mask of the four neighbours, which is clamped to their range, so the edges do not
+	 * ring (see DynamicResolution).
+	 */
+	class UpscaleShader : public Shader {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initializes the shader-programms.
+		 *
+		 * \param color
+		 *      Offscreen-target which is upscaled.
+		 * \param scale
+		 *      Uniform with the rendered part of the target (in texture-coordinates).
+		 * \param texelSize
+		 *      Uniform with the size of a texel of the target (in texture-coordinates).
+		 * \param sharpness
+		 *      Uniform with the strength of the sharpening (0 => none).
+		 */
+		UpscaleShader(osg::ref_ptr<osg::Texture2D> color, osg::ref_ptr<osg::Uniform> scale, osg::ref_ptr<osg::Uniform> texelSize,
+			osg::ref_ptr<osg::Uniform> sharpness);
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~UpscaleShader();
+
+
+		/**
+		 * \brief Apply the shader to the given node.
+		 * 
+		 * \param node
+		 *      The node to which the shader should be applied.
+		 */
+		void apply(osg::Node* node) override;
+
+
+	private:
+
+		//! Offscreen-target which is upscaled.
+		osg::ref_ptr<osg::Texture2D> _color;
+		//! Uniform with the rendered part of the target.
+		osg::ref_ptr<osg::Uniform> _scale;
+		//! Uniform with the size of a texel of the target.
+		osg::ref_ptr<osg::Uniform> _texelSize;
+		//! Uniform with the strength of the sharpening.
+		osg::ref_ptr<osg::Uniform> _sharpness;
+
+	};
+}
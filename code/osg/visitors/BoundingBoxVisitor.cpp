@@ -7,6 +7,7 @@
  */
 
 #include "BoundingBoxVisitor.h"
+#include "../../physics/Logger.h"
 
 #include <osg/MatrixTransform>
 #include <osg/Geometry>
@@ -37,7 +38,7 @@ void CalculateBoundingBox::apply(osg::Geode& geode) {
 				}
 			}
 		} else {
-			std::cout << "Consider using OBJ-files instead of shapes.";
+			LOG_WARNING("Consider using OBJ-files instead of shapes.");
 			//osg::ShapeDrawable* drawable = dynamic_cast<osg::ShapeDrawable*>(geode.getDrawable(i));
 			//curGeom = drawable->asGeometry();
 			//bbox.expandBy(geode.getDrawable(i)->getBound());
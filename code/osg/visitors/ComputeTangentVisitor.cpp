@@ -34,6 +34,11 @@ void ComputeTangentVisitor::apply(osg::Geode &geode) {
 
 
 void ComputeTangentVisitor::generateTangentArray(osg::Geometry* geom) {
+	// shared geometries are visited once per object (e.g. a model which is not loaded by the ModelManager)
+	if (geom->getVertexAttribArray(6) && geom->getVertexAttribArray(7)) {
+		return;
+	}
+
 	osg::ref_ptr<osgUtil::TangentSpaceGenerator> tsg = new osgUtil::TangentSpaceGenerator;
 	tsg->generate(geom);
 	geom->setVertexAttribArray(6, tsg->getTangentArray());
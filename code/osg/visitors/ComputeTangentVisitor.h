@@ -19,7 +19,8 @@ namespace osg {
 
 namespace pbs17 {
 	/**
-	 * \brief Change the color to a given node and subchilds.
+	 * \brief Compute the tangents and binormals of the geometries (vertex-attributes 6 and 7). Geometries which
+	 * already have them are skipped.
 	 */
 	class ComputeTangentVisitor : public osg::NodeVisitor {
 	public:
@@ -13,6 +13,7 @@
 #include <osg/Geometry>
 
 #include "../../graphics/ConvexHull3D.h"
+#include "../../physics/Logger.h"
 
 using namespace pbs17;
 
@@ -52,7 +53,7 @@ void ConvexHullVisitor::apply(osg::Geode& geode) {
 				}
 			}
 		} else {
-			std::cout << "Consider using OBJ-files instead of shapes.";
+			LOG_WARNING("Consider using OBJ-files instead of shapes.");
 		}
 	}
 
@@ -68,6 +68,16 @@ namespace pbs17 {
 		ConvexHull3D* getConvexHull();
 
 
+		/**
+		 * \brief Get all vertices which have been collected (e.g. for the convex decomposition).
+		 *
+		 * \return Vertices of the subtree.
+		 */
+		const osg::Vec3Array* getVertices() const {
+			return _vertices;
+		}
+
+
 	protected:
 
 		//! All the vertices found of the subtree
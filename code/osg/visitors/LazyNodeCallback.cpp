@@ -0,0 +1,54 @@
+﻿/**
+ * \brief Callbacks of the placeholder-node of a space-object whose OSG-nodes are only built once it's visible
+ * (see SpaceObject::setIsLazyNodes()).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "LazyNodeCallback.h"
+
+#include <osg/Group>
+
+#include "../../scene/SpaceObject.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Mark the space-object as visible (only called if the node isn't culled).
+ *
+ * \param node
+ *      Root-node of the space-object.
+ * \param nv
+ *	    Cull-visitor.
+ */
+void LazyNodeCallback::operator()(osg::Node* node, osg::NodeVisitor* nv) {
+	_object->markVisible();
+
+	traverse(node, nv);
+}
+
+
+/**
+ * \brief Compute the bound of the root-node.
+ *
+ * \param node
+ *      Root-node of the space-object.
+ *
+ * \return Bound of the children or the last rendered AABB of the object if its nodes aren't built.
+ */
+osg::BoundingSphere LazyNodeBound::computeBound(const osg::Node &node) const {
+	const osg::Group* group = node.asGroup();
+
+	if (!group || group->getNumChildren() == 0) {
+		return _object->getRenderedBound();
+	}
+
+	osg::BoundingSphere bound;
+	for (unsigned int i = 0; i < group->getNumChildren(); ++i) {
+		bound.expandBy(group->getChild(i)->getBound());
+	}
+
+	return bound;
+}
@@ -0,0 +1,97 @@
+﻿/**
+ * \brief Callbacks of the placeholder-node of a space-object whose OSG-nodes are only built once it's visible
+ * (see SpaceObject::setIsLazyNodes()).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <osg/Node>
+#include <osg/NodeCallback>
+
+// Forward declarations
+namespace pbs17 {
+	class SpaceObject;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Cull-callback which reports to the space-object that its root-node passed the view-frustum.
+	 */
+	class LazyNodeCallback : public osg::NodeCallback {
+
+	public:
+
+		/**
+		 * \brief Constructor.
+		 *
+		 * \param object
+		 *      Space-object of the root-node.
+		 */
+		explicit LazyNodeCallback(SpaceObject* object)
+			: _object(object) {}
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~LazyNodeCallback() {}
+
+
+		/**
+		 * \brief Mark the space-object as visible (only called if the node isn't culled).
+		 *
+		 * \param node
+		 *      Root-node of the space-object.
+		 * \param nv
+		 *	    Cull-visitor.
+		 */
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override;
+
+
+	protected:
+
+		//! Space-object of the root-node
+		SpaceObject* _object;
+
+	};
+
+
+	/**
+	 * \brief Bound of the root-node of a space-object which has no children while its nodes aren't built.
+	 */
+	class LazyNodeBound : public osg::Node::ComputeBoundingSphereCallback {
+
+	public:
+
+		/**
+		 * \brief Constructor.
+		 *
+		 * \param object
+		 *      Space-object of the root-node.
+		 */
+		explicit LazyNodeBound(SpaceObject* object)
+			: _object(object) {}
+
+
+		/**
+		 * \brief Compute the bound of the root-node.
+		 *
+		 * \param node
+		 *      Root-node of the space-object.
+		 *
+		 * \return Bound of the children or the last rendered AABB of the object if its nodes aren't built.
+		 */
+		osg::BoundingSphere computeBound(const osg::Node &node) const override;
+
+
+	protected:
+
+		//! Space-object of the root-node
+		SpaceObject* _object;
+
+	};
+}
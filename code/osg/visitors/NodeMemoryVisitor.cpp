@@ -0,0 +1,86 @@
+﻿/**
+ * \brief Functionality for estimating the memory of the nodes of a scene-graph.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "NodeMemoryVisitor.h"
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/LOD>
+#include <osg/MatrixTransform>
+#include <osg/Switch>
+
+using namespace pbs17;
+
+
+//! Estimated memory of an entry in the lists of a stateset (node of the map and the attribute)
+const size_t NodeMemoryVisitor::STATE_ENTRY_SIZE = 128;
+
+
+/**
+ * \brief Count the node and its stateset (all node-types end up here).
+ *
+ * \param node
+ *      Current node.
+ */
+void NodeMemoryVisitor::apply(osg::Node &node) {
+	if (!_visited.insert(&node).second) {
+		return;
+	}
+
+	// size of the most derived type which is known (the drawables are counted by their geode, newer versions of OSG
+	// traverse them as nodes afterwards, they are skipped then)
+	if (node.asGeode()) {
+		osg::Geode* geode = node.asGeode();
+		_cntBytes += sizeof(osg::Geode) + geode->getNumDrawables() * sizeof(osg::ref_ptr<osg::Drawable>);
+
+		for (unsigned int i = 0; i < geode->getNumDrawables(); ++i) {
+			const osg::Drawable* drawable = geode->getDrawable(i);
+			if (_visited.insert(drawable).second) {
+				_cntBytes += sizeof(osg::Geometry);
+				countStateSet(drawable->getStateSet());
+			}
+		}
+	} else if (node.asSwitch()) {
+		_cntBytes += sizeof(osg::Switch) + node.asSwitch()->getValueList().capacity() * sizeof(bool);
+	} else if (dynamic_cast<osg::LOD*>(&node)) {
+		_cntBytes += sizeof(osg::LOD);
+	} else if (node.asTransform()) {
+		_cntBytes += sizeof(osg::MatrixTransform);
+	} else if (node.asGroup()) {
+		_cntBytes += sizeof(osg::Group);
+	} else {
+		_cntBytes += sizeof(osg::Node);
+	}
+
+	if (node.asGroup()) {
+		_cntBytes += node.asGroup()->getNumChildren() * sizeof(osg::ref_ptr<osg::Node>);
+	}
+
+	countStateSet(node.getStateSet());
+
+	traverse(node);
+}
+
+
+/**
+ * \brief Count a stateset once.
+ *
+ * \param stateSet
+ *      Stateset of a node or drawable (nullptr => none).
+ */
+void NodeMemoryVisitor::countStateSet(const osg::StateSet* stateSet) {
+	if (!stateSet || !_visited.insert(stateSet).second) {
+		return;
+	}
+
+	size_t cntEntries = stateSet->getAttributeList().size() + stateSet->getModeList().size() + stateSet->getUniformList().size();
+	for (unsigned int i = 0; i < stateSet->getTextureAttributeList().size(); ++i) {
+		cntEntries += stateSet->getTextureAttributeList()[i].size();
+	}
+
+	_cntBytes += sizeof(osg::StateSet) + cntEntries * STATE_ENTRY_SIZE;
+}
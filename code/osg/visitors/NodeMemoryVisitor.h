@@ -0,0 +1,76 @@
+﻿/**
+ * \brief Functionality for estimating the memory of the nodes of a scene-graph.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <set>
+#include <osg/NodeVisitor>
+
+namespace pbs17 {
+
+	/**
+	 * \brief Estimate the memory of the nodes and statesets of a scene-graph: Each node and stateset is counted once
+	 * (also if it is shared) with the size of its type and its lists. The vertex-arrays aren't included, they are
+	 * counted by the caches of the models.
+	 */
+	class NodeMemoryVisitor : public osg::NodeVisitor {
+
+	public:
+
+		/**
+		 * \brief Constructor. Initialize the visitor to traverse all children.
+		 */
+		NodeMemoryVisitor() : NodeVisitor(TRAVERSE_ALL_CHILDREN) {
+
+		}
+
+
+		/**
+		 * \brief Destructor.
+		 */
+		virtual ~NodeMemoryVisitor() {}
+
+
+		/**
+		 * \brief Count the node and its stateset (all node-types end up here).
+		 *
+		 * \param node
+		 *      Current node.
+		 */
+		void apply(osg::Node &node) override;
+
+
+		/**
+		 * \brief Return the estimated memory.
+		 *
+		 * \return Memory of the visited nodes in bytes.
+		 */
+		size_t getMemorySize() const {
+			return _cntBytes;
+		}
+
+	protected:
+
+		/**
+		 * \brief Count a stateset once.
+		 *
+		 * \param stateSet
+		 *      Stateset of a node or drawable (nullptr => none).
+		 */
+		void countStateSet(const osg::StateSet* stateSet);
+
+
+		//! Estimated memory of an entry in the lists of a stateset (node of the map and the attribute)
+		static const size_t STATE_ENTRY_SIZE;
+
+		//! Already counted nodes and statesets
+		std::set<const osg::Referenced*> _visited;
+
+		//! Estimated memory of the visited nodes
+		size_t _cntBytes = 0;
+	};
+}
@@ -0,0 +1,243 @@
+﻿/**
+ * \brief Functionality for compressing the vertex-arrays of a model.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "QuantizeVisitor.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/MatrixTransform>
+#include <osg/TexMat>
+
+using namespace pbs17;
+
+
+//! Largest value of the quantized positions and texture-coordinates
+const float QuantizeVisitor::MAX_QUANTIZED = 32767.0f;
+
+
+namespace {
+
+	inline short quantizeValue(float value, float center, float scale) {
+		return static_cast<short>(std::floor(std::min(std::max((value - center) / scale, -32767.0f), 32767.0f) + 0.5f));
+	}
+
+
+	inline signed char quantizeDirection(float value) {
+		return static_cast<signed char>(std::floor(std::min(std::max(value, -1.0f), 1.0f) * 127.0f + 0.5f));
+	}
+}
+
+
+/**
+ * \brief Collect the geometries of a geode.
+ *
+ * \param geode
+ *      Current geode-child.
+ */
+void QuantizeVisitor::apply(osg::Geode &geode) {
+	for (unsigned int i = 0; i < geode.getNumDrawables(); ++i) {
+		osg::Geometry* geometry = geode.getDrawable(i)->asGeometry();
+
+		if (geometry && std::find(_geometries.begin(), _geometries.end(), geometry) == _geometries.end()) {
+			_geometries.push_back(geometry);
+		}
+	}
+}
+
+
+/**
+ * \brief Compress the vertex-arrays of all levels of a model (after the tangents and the convex-hull are computed,
+ * both read the float-arrays).
+ *
+ * \param model
+ *      LOD-model of the ModelManager.
+ *
+ * \return False if the model isn't changed (it has geometries which can't be quantized).
+ */
+bool QuantizeVisitor::quantize(osg::ref_ptr<osg::LOD> model) {
+	QuantizeVisitor visitor;
+	model->accept(visitor);
+
+	// the levels share one decoding => all geometries are quantized or none
+	osg::BoundingBox box;
+	osg::Vec2 uvMin(FLT_MAX, FLT_MAX);
+	osg::Vec2 uvMax(-FLT_MAX, -FLT_MAX);
+
+	for (unsigned int g = 0; g < visitor._geometries.size(); ++g) {
+		const osg::Geometry* geometry = visitor._geometries[g];
+		if (!canQuantize(geometry)) {
+			return false;
+		}
+
+		const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+		for (unsigned int i = 0; i < vertices->size(); ++i) {
+			box.expandBy((*vertices)[i]);
+		}
+
+		const osg::Vec2Array* texCoords = dynamic_cast<const osg::Vec2Array*>(geometry->getTexCoordArray(0));
+		for (unsigned int i = 0; texCoords && i < texCoords->size(); ++i) {
+			uvMin.x() = std::min(uvMin.x(), (*texCoords)[i].x());
+			uvMin.y() = std::min(uvMin.y(), (*texCoords)[i].y());
+			uvMax.x() = std::max(uvMax.x(), (*texCoords)[i].x());
+			uvMax.y() = std::max(uvMax.y(), (*texCoords)[i].y());
+		}
+	}
+
+	if (!box.valid()) {
+		return false;
+	}
+
+	// signed values around the centers (the fixed-function pipeline has no unsigned positions), the same step in
+	// all directions => the transform scales uniformly
+	float extent = std::max(std::max(box.xMax() - box.xMin(), box.yMax() - box.yMin()), box.zMax() - box.zMin());
+	float scale = std::max(0.5f * extent, FLT_MIN) / MAX_QUANTIZED;
+	osg::Vec2 uvCenter(0.0f, 0.0f);
+	osg::Vec2 uvScale(1.0f, 1.0f);
+	if (uvMin.x() <= uvMax.x()) {
+		uvCenter = (uvMin + uvMax) * 0.5f;
+		uvScale.set(std::max(0.5f * (uvMax.x() - uvMin.x()), FLT_MIN) / MAX_QUANTIZED, std::max(0.5f * (uvMax.y() - uvMin.y()), FLT_MIN) / MAX_QUANTIZED);
+	}
+
+	for (unsigned int g = 0; g < visitor._geometries.size(); ++g) {
+		quantize(visitor._geometries[g], box.center(), scale, uvCenter, uvScale);
+	}
+
+	// the integer positions and texture-coordinates are converted without normalization => decoded by the matrices
+	osg::ref_ptr<osg::StateSet> stateset = new osg::StateSet;
+	stateset->setTextureAttribute(0, new osg::TexMat(osg::Matrix::scale(uvScale.x(), uvScale.y(), 1.0) * osg::Matrix::translate(uvCenter.x(), uvCenter.y(), 0.0)));
+	stateset->setMode(GL_RESCALE_NORMAL, osg::StateAttribute::ON);
+
+	for (unsigned int i = 0; i < model->getNumChildren(); ++i) {
+		osg::ref_ptr<osg::MatrixTransform> decode = new osg::MatrixTransform(osg::Matrix::scale(scale, scale, scale) * osg::Matrix::translate(box.center()));
+		decode->setStateSet(stateset.get());
+		decode->addChild(model->getChild(i));
+		model->setChild(i, decode.get());
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Check if the arrays of a geometry can be quantized (float-arrays with a value per vertex).
+ *
+ * \param geometry
+ *      Geometry of the model.
+ *
+ * \return True if all its arrays are supported.
+ */
+bool QuantizeVisitor::canQuantize(const osg::Geometry* geometry) {
+	const osg::Array* vertices = geometry->getVertexArray();
+	if (!vertices || vertices->getType() != osg::Array::Vec3ArrayType) {
+		return false;
+	}
+
+	const osg::Array* normals = geometry->getNormalArray();
+	if (normals && (normals->getType() != osg::Array::Vec3ArrayType || normals->getBinding() != osg::Array::BIND_PER_VERTEX)) {
+		return false;
+	}
+
+	const osg::Array* texCoords = geometry->getTexCoordArray(0);
+	if (texCoords && texCoords->getType() != osg::Array::Vec2ArrayType) {
+		return false;
+	}
+
+	// the tangents and binormals of the bumpmaps (see ComputeTangentVisitor)
+	for (unsigned int a = 6; a <= 7; ++a) {
+		const osg::Array* attribute = geometry->getVertexAttribArray(a);
+		if (attribute && attribute->getType() != osg::Array::Vec4ArrayType && attribute->getType() != osg::Array::Vec3ArrayType) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Quantize the arrays of a geometry.
+ *
+ * \param geometry
+ *      Geometry of the model.
+ * \param center
+ *      Center of the bounding-box of the model.
+ * \param scale
+ *      Extent of a quantization-step of the positions.
+ * \param uvCenter
+ *      Center of the range of the texture-coordinates of the model.
+ * \param uvScale
+ *      Extent of a quantization-step of the texture-coordinates.
+ */
+void QuantizeVisitor::quantize(osg::Geometry* geometry, const osg::Vec3 &center, float scale, const osg::Vec2 &uvCenter, const osg::Vec2 &uvScale) {
+	const osg::Vec3Array* vertices = static_cast<const osg::Vec3Array*>(geometry->getVertexArray());
+	osg::ref_ptr<osg::Vec3sArray> positions = new osg::Vec3sArray(vertices->size());
+
+	for (unsigned int i = 0; i < vertices->size(); ++i) {
+		const osg::Vec3 &v = (*vertices)[i];
+		(*positions)[i].set(quantizeValue(v.x(), center.x(), scale), quantizeValue(v.y(), center.y(), scale), quantizeValue(v.z(), center.z(), scale));
+	}
+
+	geometry->setVertexArray(positions.get());
+
+	// the bounds can't be computed from the integer positions
+	osg::BoundingBox bounds;
+	for (unsigned int i = 0; i < positions->size(); ++i) {
+		bounds.expandBy(osg::Vec3((*positions)[i].x(), (*positions)[i].y(), (*positions)[i].z()));
+	}
+	geometry->setInitialBound(bounds);
+
+	const osg::Vec3Array* normals = static_cast<const osg::Vec3Array*>(geometry->getNormalArray());
+	if (normals) {
+		osg::ref_ptr<osg::Vec3bArray> packed = new osg::Vec3bArray(normals->size());
+
+		for (unsigned int i = 0; i < normals->size(); ++i) {
+			const osg::Vec3 &n = (*normals)[i];
+			(*packed)[i].set(quantizeDirection(n.x()), quantizeDirection(n.y()), quantizeDirection(n.z()));
+		}
+
+		packed->setNormalize(true);
+		geometry->setNormalArray(packed.get(), osg::Array::BIND_PER_VERTEX);
+	}
+
+	const osg::Vec2Array* texCoords = static_cast<const osg::Vec2Array*>(geometry->getTexCoordArray(0));
+	if (texCoords) {
+		osg::ref_ptr<osg::Vec2sArray> packed = new osg::Vec2sArray(texCoords->size());
+
+		for (unsigned int i = 0; i < texCoords->size(); ++i) {
+			const osg::Vec2 &t = (*texCoords)[i];
+			(*packed)[i].set(quantizeValue(t.x(), uvCenter.x(), uvScale.x()), quantizeValue(t.y(), uvCenter.y(), uvScale.y()));
+		}
+
+		geometry->setTexCoordArray(0, packed.get(), osg::Array::BIND_PER_VERTEX);
+	}
+
+	for (unsigned int a = 6; a <= 7; ++a) {
+		const osg::Array* attribute = geometry->getVertexAttribArray(a);
+		if (!attribute) {
+			continue;
+		}
+
+		osg::ref_ptr<osg::Vec4bArray> packed = new osg::Vec4bArray(attribute->getNumElements());
+		const osg::Vec4Array* vec4 = dynamic_cast<const osg::Vec4Array*>(attribute);
+		const osg::Vec3Array* vec3 = dynamic_cast<const osg::Vec3Array*>(attribute);
+
+		for (unsigned int i = 0; i < packed->size(); ++i) {
+			osg::Vec3 d = vec4 ? osg::Vec3((*vec4)[i].x(), (*vec4)[i].y(), (*vec4)[i].z()) : (*vec3)[i];
+			(*packed)[i].set(quantizeDirection(d.x()), quantizeDirection(d.y()), quantizeDirection(d.z()), 0);
+		}
+
+		packed->setNormalize(true);
+		geometry->setVertexAttribArray(a, packed.get(), osg::Array::BIND_PER_VERTEX);
+	}
+
+	geometry->dirtyBound();
+	geometry->dirtyGLObjects();
+}
@@ -0,0 +1,100 @@
+﻿/**
+ * \brief Functionality for compressing the vertex-arrays of a model.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <osg/NodeVisitor>
+#include <osg/BoundingBox>
+#include <osg/LOD>
+
+namespace osg {
+	class Geode;
+	class Geometry;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Compress the vertex-arrays of a LOD-model: The positions are quantized to signed 16 bits in the bounding-box
+	 * of the model, the normals, tangents and binormals to signed normalized 8 bits and the texture-coordinates to signed
+	 * 16 bits in their range.
+	 *
+	 * The positions and the texture-coordinates are decoded by a matrix-transform and a texture-matrix above each level,
+	 * so the fixed-function pipeline and the shaders which use gl_ModelViewMatrix and gl_TextureMatrix draw the model
+	 * unchanged (the instanced shader gets the matrix as uniform "dequantization"). The positions are scaled uniformly,
+	 * so the normals aren't distorted by the transform.
+	 */
+	class QuantizeVisitor : public osg::NodeVisitor {
+	public:
+
+		/**
+		 * \brief Constructor. Initialize the visitor to traverse all children.
+		 */
+		QuantizeVisitor() : NodeVisitor(TRAVERSE_ALL_CHILDREN) {}
+
+
+		/**
+		 * \brief Collect the geometries of a geode.
+		 *
+		 * \param geode
+		 *      Current geode-child.
+		 */
+		void apply(osg::Geode &geode) override;
+
+
+		/**
+		 * \brief Compress the vertex-arrays of all levels of a model (after the tangents and the convex-hull are computed,
+		 * both read the float-arrays).
+		 *
+		 * \param model
+		 *      LOD-model of the ModelManager.
+		 *
+		 * \return False if the model isn't changed (it has geometries which can't be quantized).
+		 */
+		static bool quantize(osg::ref_ptr<osg::LOD> model);
+
+
+	private:
+
+		//! Geometries of the visited nodes
+		std::vector<osg::Geometry*> _geometries;
+
+		//! Largest value of the quantized positions and texture-coordinates
+		static const float MAX_QUANTIZED;
+
+
+		/**
+		 * \brief Check if the arrays of a geometry can be quantized (float-arrays with a value per vertex).
+		 *
+		 * \param geometry
+		 *      Geometry of the model.
+		 *
+		 * \return True if all its arrays are supported.
+		 */
+		static bool canQuantize(const osg::Geometry* geometry);
+
+
+		/**
+		 * \brief Quantize the arrays of a geometry.
+		 *
+		 * \param geometry
+		 *      Geometry of the model.
+		 * \param center
+		 *      Center of the bounding-box of the model.
+		 * \param scale
+		 *      Extent of a quantization-step of the positions.
+		 * \param uvCenter
+		 *      Center of the range of the texture-coordinates of the model.
+		 * \param uvScale
+		 *      Extent of a quantization-step of the texture-coordinates.
+		 */
+		static void quantize(osg::Geometry* geometry, const osg::Vec3 &center, float scale, const osg::Vec2 &uvCenter, const osg::Vec2 &uvScale);
+	};
+}
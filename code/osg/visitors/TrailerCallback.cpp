@@ -12,6 +12,7 @@
 #include <osg/Geometry>
 
 #include "../FollowingRibbon.h"
+#include "../TrailSystem.h"
 
 using namespace pbs17;
 
@@ -27,31 +28,13 @@ using namespace pbs17;
 void TrailerCallback::operator()(osg::Node* node, osg::NodeVisitor* nv) {
 	osg::MatrixTransform* trans = static_cast<osg::MatrixTransform*>(node);
 	
-	if (trans && _geometry.valid()) {
-		unsigned int numPoints = _ribbon->getNumPoints();
+	// no segments are written across the skipped steps of a fast-forward
+	if (trans && _geometry.valid() && !TrailSystem::getIsFrozen()) {
 		float halfWidth = _ribbon->getHalfWidth();
-
 		osg::Matrix matrix = trans->getMatrix();
-		osg::Vec3Array* vertices = static_cast<osg::Vec3Array*>(_geometry->getVertexArray());
-		osg::Vec3Array* normals = static_cast<osg::Vec3Array*>(_geometry->getNormalArray());
-
-		for (unsigned int i = 0; i < numPoints - 3; i += 2) {
-			(*vertices)[i] = (*vertices)[i + 2];
-			(*vertices)[i + 1] = (*vertices)[i + 3];
-			(*normals)[i] = (*normals)[i + 2];
-			(*normals)[i + 1] = (*normals)[i + 3];
-		}
-
-		(*vertices)[numPoints - 2] = osg::Vec3(0.0f, -halfWidth, 0.0f) * matrix;
-		(*vertices)[numPoints - 1] = osg::Vec3(0.0f, halfWidth, 0.0f) * matrix;
-		vertices->dirty();
-
-		osg::Vec3 normal = osg::Vec3(0.0f, 0.0f, 1.0f) * matrix;
-		normal.normalize();
-		(*normals)[numPoints - 2] = normal;
-		(*normals)[numPoints - 1] = normal;
-
-		normals->dirty();
+
+		// only the new segment is written (and uploaded by the draw-callback of the ribbon)
+		_ribbon->addSegment(osg::Vec3(0.0f, -halfWidth, 0.0f) * matrix, osg::Vec3(0.0f, halfWidth, 0.0f) * matrix);
 		_geometry->dirtyBound();
 	}
 
@@ -6,6 +6,7 @@
  */
 
 #include "VertexListVisitor.h"
+#include "../../physics/Logger.h"
 
 #include <osg/MatrixTransform>
 #include <osg/Geometry>
@@ -32,7 +33,7 @@ void VertexListVisitor::apply(osg::Geode& geode) {
 
 			
 		} else {
-			std::cout << "Consider using OBJ-files instead of shapes.";
+			LOG_WARNING("Consider using OBJ-files instead of shapes.");
 		}
 	}
 
@@ -0,0 +1,43 @@
+﻿/**
+ * \brief Flat array of the swept AABBs of all objects, shared by the broad-phases.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "AabbArray.h"
+
+#include "../scene/SpaceObject.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Copy the swept AABBs of the objects (in parallel).
+ *
+ * \param objects
+ *      Space-objects whose AABBs are stored (the index is kept).
+ */
+void AabbArray::update(const std::vector<SpaceObject*> &objects) {
+	int n = objects.size();
+
+	for (int axis = 0; axis < 3; ++axis) {
+		_min[axis].resize(n);
+		_max[axis].resize(n);
+	}
+
+	float* min[3] = { _min[0].data(), _min[1].data(), _min[2].data() };
+	float* max[3] = { _max[0].data(), _max[1].data(), _max[2].data() };
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static, 256)
+#endif
+	for (int i = 0; i < n; ++i) {
+		osg::BoundingBox aabb = objects[i]->getSweptAABB();
+
+		for (int axis = 0; axis < 3; ++axis) {
+			min[axis][i] = aabb._min[axis];
+			max[axis][i] = aabb._max[axis];
+		}
+	}
+}
@@ -0,0 +1,76 @@
+﻿/**
+ * \brief Flat array of the swept AABBs of all objects, shared by the broad-phases.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+
+namespace pbs17 {
+	class SpaceObject;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Swept AABBs of all checked objects as float arrays per axis (structure of arrays), indexed like the
+	 *        objects of the collision-manager. It is filled once per step, so the broad-phases (sweep-and-prune on
+	 *        the CPU and the GPU, AABB-tree and spatial hash) only read contiguous floats instead of computing the
+	 *        swept AABB of an object several times (e.g. once per endpoint and axis).
+	 */
+	class AabbArray {
+	public:
+		/**
+		 * \brief Copy the swept AABBs of the objects (in parallel).
+		 *
+		 * \param objects
+		 *      Space-objects whose AABBs are stored (the index is kept).
+		 */
+		void update(const std::vector<SpaceObject*> &objects);
+
+
+		/**
+		 * \brief Get the number of stored AABBs.
+		 *
+		 * \return Number of objects of the last update.
+		 */
+		unsigned int size() const {
+			return _min[0].size();
+		}
+
+
+		/**
+		 * \brief Get the min-coordinates of all AABBs on an axis.
+		 *
+		 * \param axis
+		 *      Axis of the coordinates.
+		 *
+		 * \return Array of size() floats.
+		 */
+		const float* getMin(int axis) const {
+			return _min[axis].data();
+		}
+
+
+		/**
+		 * \brief Get the max-coordinates of all AABBs on an axis.
+		 *
+		 * \param axis
+		 *      Axis of the coordinates.
+		 *
+		 * \return Array of size() floats.
+		 */
+		const float* getMax(int axis) const {
+			return _max[axis].data();
+		}
+
+
+	private:
+		//! Min- and max-coordinates per axis
+		std::vector<float> _min[3];
+		std::vector<float> _max[3];
+	};
+}
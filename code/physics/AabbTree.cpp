@@ -0,0 +1,752 @@
+﻿/**
+ * \brief Implementation of the dynamic AABB-tree used by the broad-phase.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#include "AabbTree.h"
+
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <functional>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "AabbArray.h"
+#include "../scene/SpaceObject.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor of the AABB-tree.
+ */
+AabbTree::AabbTree() {}
+
+
+/**
+ * \brief Build the tree for all objects.
+ *
+ * \param objects
+ *      All space-objects which are checked for collisions.
+ */
+void AabbTree::init(const std::vector<SpaceObject*> &objects) {
+	_objects = objects;
+	_nodes.clear();
+	_root = -1;
+	_freeList = -1;
+
+	int n = _objects.size();
+	_boxes.resize(n);
+	_leafOfObject.resize(n);
+	_nodes.reserve(2 * n);
+
+	for (int i = 0; i < n; ++i) {
+		_boxes[i] = getObjectBox(i);
+
+		int leaf = allocateNode();
+		_nodes[leaf].box = fatten(_boxes[i]);
+		_nodes[leaf].object = i;
+		_leafOfObject[i] = leaf;
+
+		insertLeaf(leaf);
+	}
+}
+
+
+/**
+ * \brief Append an object, its leaf is inserted next to the best sibling.
+ *
+ * \param object
+ *      Space-object which is checked from now on (gets the last index).
+ */
+void AabbTree::insert(SpaceObject* object) {
+	int i = _objects.size();
+	_objects.push_back(object);
+	_boxes.push_back(getObjectBox(i));
+
+	int leaf = allocateNode();
+	_nodes[leaf].box = fatten(_boxes[i]);
+	_nodes[leaf].object = i;
+	_leafOfObject.push_back(leaf);
+
+	insertLeaf(leaf);
+}
+
+
+/**
+ * \brief Remove an object with its leaf, the last object is moved to its index (same as BodyState::remove()).
+ *
+ * \param i
+ *      Index of the removed object.
+ */
+void AabbTree::remove(unsigned int i) {
+	if (i >= _objects.size()) {
+		return;
+	}
+
+	int leaf = _leafOfObject[i];
+	removeLeaf(leaf);
+	freeNode(leaf);
+
+	unsigned int last = _objects.size() - 1;
+	if (i != last) {
+		_objects[i] = _objects[last];
+		_boxes[i] = _boxes[last];
+		_leafOfObject[i] = _leafOfObject[last];
+		_nodes[_leafOfObject[i]].object = i;
+	}
+
+	_objects.pop_back();
+	_boxes.pop_back();
+	_leafOfObject.pop_back();
+}
+
+
+/**
+ * \brief Refit the tree to the current AABBs and get the possible collisions.
+ *
+ * \param aabbs
+ *      Swept AABBs of the objects of this step (same indices).
+ * \param res
+ *      Output-parameter: Pairs whose AABBs overlap (overwritten). By convention, on the first position the
+ *	                      object with the smaller id is stored (key.first.Id < key.second.Id).
+ */
+void AabbTree::update(const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) {
+	int n = _objects.size();
+	res.clear();
+
+	// only the objects which left their fat AABB are reinserted
+	for (int i = 0; i < n; ++i) {
+		_boxes[i] = getObjectBox(aabbs, i);
+		int leaf = _leafOfObject[i];
+
+		if (!contains(_nodes[leaf].box, _boxes[i])) {
+			removeLeaf(leaf);
+			_nodes[leaf].box = fatten(_boxes[i]);
+			insertLeaf(leaf);
+		}
+	}
+
+	if (n < 2) return;
+
+	int cntThreads = 1;
+#if defined(_OPENMP)
+	cntThreads = omp_get_max_threads();
+#endif
+
+	// pairs per thread, concatenated in the order of the threads so the result is deterministic
+	std::vector<std::vector<std::pair<SpaceObject *, SpaceObject *>>> threadPairs(cntThreads);
+
+	// the tree is only read from here on, so each object can query it in parallel
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+	{
+		int thread = 0;
+#if defined(_OPENMP)
+		thread = omp_get_thread_num();
+#endif
+		std::vector<std::pair<SpaceObject *, SpaceObject *>> &pairs = threadPairs[thread];
+		std::vector<int> stack;
+
+#if defined(_OPENMP)
+#pragma omp for schedule(static, 64)
+#endif
+		for (int i = 0; i < n; ++i) {
+			// the pairs of a sleeping object are reported by the other (awake) object
+			if (_objects[i]->isSleeping()) continue;
+
+			const Box &box = _boxes[i];
+			stack.push_back(_root);
+
+			while (!stack.empty()) {
+				const Node &node = _nodes[stack.back()];
+				stack.pop_back();
+
+				if (!overlaps(node.box, box)) continue;
+
+				if (node.isLeaf()) {
+					// each pair is reported by the object with the smaller index, the fat box of the other one
+					// contains its tight box
+					int j = node.object;
+					if ((j > i || _objects[j]->isSleeping()) && overlaps(box, _boxes[j]) && SpaceObject::canCollide(_objects[i], _objects[j])) {
+						// always have the object with the smaller id first
+						if (_objects[i]->getId() < _objects[j]->getId()) {
+							pairs.push_back(std::make_pair(_objects[i], _objects[j]));
+						} else {
+							pairs.push_back(std::make_pair(_objects[j], _objects[i]));
+						}
+					}
+				} else {
+					stack.push_back(node.child1);
+					stack.push_back(node.child2);
+				}
+			}
+		}
+	}
+
+	for (int t = 0; t < cntThreads; ++t) {
+		res.insert(res.end(), threadPairs[t].begin(), threadPairs[t].end());
+	}
+}
+
+
+/**
+ * \brief Get all objects whose AABB overlaps with a region.
+ *
+ * \param region
+ *      Box in the world-space.
+ * \param res
+ *      Output-parameter: Overlapping objects (overwritten).
+ */
+void AabbTree::queryRegion(const osg::BoundingBox &region, std::vector<SpaceObject*> &res) const {
+	res.clear();
+
+	if (_root == -1) return;
+
+	Box box;
+	for (int axis = 0; axis < 3; ++axis) {
+		box.min[axis] = region._min[axis];
+		box.max[axis] = region._max[axis];
+	}
+
+	std::vector<int> stack(1, _root);
+	while (!stack.empty()) {
+		const Node &node = _nodes[stack.back()];
+		stack.pop_back();
+
+		if (!overlaps(node.box, box)) continue;
+
+		if (node.isLeaf()) {
+			if (overlaps(_boxes[node.object], box)) {
+				res.push_back(_objects[node.object]);
+			}
+		} else {
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
+
+/**
+ * \brief Get the first object whose AABB is hit by a ray.
+ *
+ * \param origin
+ *      Start of the ray.
+ * \param direction
+ *      Direction of the ray (does not have to be normalized, the distance is in multiples of it).
+ * \param maxDistance
+ *      Maximum distance of the hit.
+ * \param distance
+ *      Output-parameter: Distance of the hit.
+ *
+ * \return Hit object (nullptr if nothing is hit).
+ */
+SpaceObject* AabbTree::rayCast(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double maxDistance, double &distance) const {
+	SpaceObject* hit = nullptr;
+	distance = maxDistance;
+
+	if (_root == -1) return hit;
+
+	std::vector<int> stack(1, _root);
+	while (!stack.empty()) {
+		const Node &node = _nodes[stack.back()];
+		stack.pop_back();
+
+		if (getEntryDistance(node.box, origin, direction, distance) > distance) continue;
+
+		if (node.isLeaf()) {
+			double t = getEntryDistance(_boxes[node.object], origin, direction, distance);
+			if (t <= distance) {
+				distance = t;
+				hit = _objects[node.object];
+			}
+		} else {
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+
+	return hit;
+}
+
+
+/**
+ * \brief Get all objects whose AABB is hit by a ray, ordered by the distance at which the ray enters the AABB.
+ *
+ * \param origin
+ *      Start of the ray.
+ * \param direction
+ *      Direction of the ray (does not have to be normalized, the distance is in multiples of it).
+ * \param maxDistance
+ *      Maximum distance of the hits.
+ * \param res
+ *      Output-parameter: Entry-distances with the hit objects (overwritten).
+ */
+void AabbTree::queryRay(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double maxDistance, std::vector<std::pair<double, SpaceObject*>> &res) const {
+	res.clear();
+
+	if (_root == -1) return;
+
+	std::vector<int> stack(1, _root);
+	while (!stack.empty()) {
+		const Node &node = _nodes[stack.back()];
+		stack.pop_back();
+
+		if (getEntryDistance(node.box, origin, direction, maxDistance) > maxDistance) continue;
+
+		if (node.isLeaf()) {
+			double t = getEntryDistance(_boxes[node.object], origin, direction, maxDistance);
+			if (t <= maxDistance) {
+				res.push_back(std::make_pair(t, _objects[node.object]));
+			}
+		} else {
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+
+	std::sort(res.begin(), res.end(), [](const std::pair<double, SpaceObject*> &a, const std::pair<double, SpaceObject*> &b) {
+		return a.first < b.first;
+	});
+}
+
+
+/**
+ * \brief Get the k objects whose centers are closest to a point (best-first traversal, the subtrees whose
+ *        AABB is further away than the k-th candidate are skipped).
+ *
+ * \param point
+ *      Point in the world-space.
+ * \param k
+ *      Maximum number of objects.
+ * \param maxDistance
+ *      Maximum distance of the centers.
+ * \param res
+ *      Output-parameter: Squared distances with the closest objects, ordered by the distance (overwritten).
+ */
+void AabbTree::queryNearest(const Eigen::Vector3d &point, unsigned int k, double maxDistance, std::vector<std::pair<double, SpaceObject*>> &res) const {
+	res.clear();
+
+	if (_root == -1 || k == 0) return;
+
+	typedef std::pair<double, SpaceObject*> Candidate;
+	auto isCloser = [](const Candidate &a, const Candidate &b) {
+		return a.first < b.first;
+	};
+
+	// nodes ordered by the distance to their box (lower bound of the distances of their centers)
+	typedef std::pair<double, int> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	queue.push(std::make_pair(getDistanceSquared(_nodes[_root].box, point), _root));
+
+	// res is a max-heap of the best k candidates until the end
+	double bound = maxDistance * maxDistance;
+	while (!queue.empty() && queue.top().first <= bound) {
+		const Node &node = _nodes[queue.top().second];
+		queue.pop();
+
+		if (node.isLeaf()) {
+			SpaceObject* object = _objects[node.object];
+			double distance = (object->getPosition() - point).squaredNorm();
+			if (distance > bound) continue;
+
+			res.push_back(std::make_pair(distance, object));
+			std::push_heap(res.begin(), res.end(), isCloser);
+
+			if (res.size() > k) {
+				std::pop_heap(res.begin(), res.end(), isCloser);
+				res.pop_back();
+			}
+			if (res.size() == k) {
+				bound = res.front().first;
+			}
+		} else {
+			queue.push(std::make_pair(getDistanceSquared(_nodes[node.child1].box, point), node.child1));
+			queue.push(std::make_pair(getDistanceSquared(_nodes[node.child2].box, point), node.child2));
+		}
+	}
+
+	std::sort_heap(res.begin(), res.end(), isCloser);
+}
+
+
+/**
+ * \brief Get a node from the pool (the pool may grow, so references to nodes are invalidated).
+ *
+ * \return Index of the node.
+ */
+int AabbTree::allocateNode() {
+	int node;
+
+	if (_freeList == -1) {
+		node = _nodes.size();
+		_nodes.push_back(Node());
+	} else {
+		node = _freeList;
+		_freeList = _nodes[node].parent;
+	}
+
+	Node &n = _nodes[node];
+	n.parent = -1;
+	n.child1 = -1;
+	n.child2 = -1;
+	n.height = 0;
+	n.object = -1;
+
+	return node;
+}
+
+
+/**
+ * \brief Return a node to the pool.
+ *
+ * \param node
+ *      Index of the node.
+ */
+void AabbTree::freeNode(int node) {
+	_nodes[node].parent = _freeList;
+	_nodes[node].height = -1;
+	_freeList = node;
+}
+
+
+/**
+ * \brief Insert a leaf next to the sibling with the smallest increase of the surface-area.
+ *
+ * \param leaf
+ *      Index of the leaf.
+ */
+void AabbTree::insertLeaf(int leaf) {
+	if (_root == -1) {
+		_root = leaf;
+		_nodes[leaf].parent = -1;
+		return;
+	}
+
+	// descend to the best sibling (cost = area of the new parent + increase of the areas of all ancestors)
+	Box leafBox = _nodes[leaf].box;
+	int index = _root;
+
+	while (!_nodes[index].isLeaf()) {
+		const Node &node = _nodes[index];
+		float area = getSurfaceArea(node.box);
+		float combinedArea = getSurfaceArea(combine(node.box, leafBox));
+
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		int children[2] = { node.child1, node.child2 };
+		for (int c = 0; c < 2; ++c) {
+			const Node &child = _nodes[children[c]];
+			float newArea = getSurfaceArea(combine(child.box, leafBox));
+			childCost[c] = (child.isLeaf() ? newArea : newArea - getSurfaceArea(child.box)) + inheritanceCost;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1]) break;
+
+		index = childCost[0] < childCost[1] ? children[0] : children[1];
+	}
+
+	int sibling = index;
+	int oldParent = _nodes[sibling].parent;
+	int newParent = allocateNode();
+
+	_nodes[newParent].parent = oldParent;
+	_nodes[newParent].box = combine(leafBox, _nodes[sibling].box);
+	_nodes[newParent].height = _nodes[sibling].height + 1;
+	_nodes[newParent].child1 = sibling;
+	_nodes[newParent].child2 = leaf;
+	_nodes[sibling].parent = newParent;
+	_nodes[leaf].parent = newParent;
+
+	if (oldParent == -1) {
+		_root = newParent;
+	} else if (_nodes[oldParent].child1 == sibling) {
+		_nodes[oldParent].child1 = newParent;
+	} else {
+		_nodes[oldParent].child2 = newParent;
+	}
+
+	refit(oldParent);
+}
+
+
+/**
+ * \brief Remove a leaf (its parent is replaced by the sibling).
+ *
+ * \param leaf
+ *      Index of the leaf.
+ */
+void AabbTree::removeLeaf(int leaf) {
+	if (leaf == _root) {
+		_root = -1;
+		return;
+	}
+
+	int parent = _nodes[leaf].parent;
+	int grandParent = _nodes[parent].parent;
+	int sibling = _nodes[parent].child1 == leaf ? _nodes[parent].child2 : _nodes[parent].child1;
+
+	if (grandParent == -1) {
+		_root = sibling;
+		_nodes[sibling].parent = -1;
+		freeNode(parent);
+		return;
+	}
+
+	if (_nodes[grandParent].child1 == parent) {
+		_nodes[grandParent].child1 = sibling;
+	} else {
+		_nodes[grandParent].child2 = sibling;
+	}
+	_nodes[sibling].parent = grandParent;
+	freeNode(parent);
+
+	refit(grandParent);
+}
+
+
+/**
+ * \brief Refit the boxes and heights from a node up to the root and rotate unbalanced nodes.
+ *
+ * \param node
+ *      First node to refit.
+ */
+void AabbTree::refit(int node) {
+	while (node != -1) {
+		node = balance(node);
+
+		Node &n = _nodes[node];
+		n.height = 1 + std::max(_nodes[n.child1].height, _nodes[n.child2].height);
+		n.box = combine(_nodes[n.child1].box, _nodes[n.child2].box);
+
+		node = n.parent;
+	}
+}
+
+
+/**
+ * \brief Rotate the higher child of the node up, if the heights of the children differ by more than one.
+ *
+ * \param a
+ *      Index of the node.
+ *
+ * \return Index of the node which is now at the position of a.
+ */
+int AabbTree::balance(int a) {
+	Node &nodeA = _nodes[a];
+	if (nodeA.isLeaf() || nodeA.height < 2) {
+		return a;
+	}
+
+	int b = nodeA.child1;
+	int c = nodeA.child2;
+	int difference = _nodes[c].height - _nodes[b].height;
+
+	if (difference >= -1 && difference <= 1) {
+		return a;
+	}
+
+	// up = higher child which replaces a, down = its lower child which moves to a
+	int up = difference > 1 ? c : b;
+	int stay = difference > 1 ? b : c;
+	Node &nodeUp = _nodes[up];
+	int f = nodeUp.child1;
+	int g = nodeUp.child2;
+
+	nodeUp.child1 = a;
+	nodeUp.parent = nodeA.parent;
+	nodeA.parent = up;
+
+	if (nodeUp.parent == -1) {
+		_root = up;
+	} else if (_nodes[nodeUp.parent].child1 == a) {
+		_nodes[nodeUp.parent].child1 = up;
+	} else {
+		_nodes[nodeUp.parent].child2 = up;
+	}
+
+	// the higher grand-child stays below up, the lower one replaces up below a
+	int high = _nodes[f].height > _nodes[g].height ? f : g;
+	int low = high == f ? g : f;
+
+	nodeUp.child2 = high;
+	if (difference > 1) {
+		nodeA.child2 = low;
+	} else {
+		nodeA.child1 = low;
+	}
+	_nodes[low].parent = a;
+
+	nodeA.box = combine(_nodes[stay].box, _nodes[low].box);
+	nodeA.height = 1 + std::max(_nodes[stay].height, _nodes[low].height);
+	nodeUp.box = combine(nodeA.box, _nodes[high].box);
+	nodeUp.height = 1 + std::max(nodeA.height, _nodes[high].height);
+
+	return up;
+}
+
+
+/**
+ * \brief Get the tight box of the current AABB of an object.
+ *
+ * \param object
+ *      Index of the object.
+ *
+ * \return Box of the object.
+ */
+AabbTree::Box AabbTree::getObjectBox(int object) const {
+	osg::BoundingBox aabb = _objects[object]->getSweptAABB();
+	Box box;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		box.min[axis] = aabb._min[axis];
+		box.max[axis] = aabb._max[axis];
+	}
+
+	return box;
+}
+
+
+/**
+ * \brief Get the tight box of an object from the AABBs of a step.
+ *
+ * \param aabbs
+ *      Swept AABBs of the objects.
+ * \param object
+ *      Index of the object.
+ *
+ * \return Box of the object.
+ */
+AabbTree::Box AabbTree::getObjectBox(const AabbArray &aabbs, int object) {
+	Box box;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		box.min[axis] = aabbs.getMin(axis)[object];
+		box.max[axis] = aabbs.getMax(axis)[object];
+	}
+
+	return box;
+}
+
+
+/**
+ * \brief Enlarge a box by the fat margin.
+ *
+ * \param box
+ *      Tight box.
+ *
+ * \return Fat box.
+ */
+AabbTree::Box AabbTree::fatten(const Box &box) const {
+	float extent = std::max(box.max[0] - box.min[0], std::max(box.max[1] - box.min[1], box.max[2] - box.min[2]));
+	float margin = static_cast<float>(_fatMargin) * std::max(extent, 0.0f);
+	Box fat;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		fat.min[axis] = box.min[axis] - margin;
+		fat.max[axis] = box.max[axis] + margin;
+	}
+
+	return fat;
+}
+
+
+/**
+ * \brief Get the smallest box containing both boxes.
+ */
+AabbTree::Box AabbTree::combine(const Box &a, const Box &b) {
+	Box box;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		box.min[axis] = std::min(a.min[axis], b.min[axis]);
+		box.max[axis] = std::max(a.max[axis], b.max[axis]);
+	}
+
+	return box;
+}
+
+
+/**
+ * \brief Get the surface-area of a box (cost-function of the insertion).
+ */
+float AabbTree::getSurfaceArea(const Box &box) {
+	float dx = box.max[0] - box.min[0];
+	float dy = box.max[1] - box.min[1];
+	float dz = box.max[2] - box.min[2];
+
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+
+/**
+ * \brief Check if two boxes overlap (touching boxes overlap).
+ */
+bool AabbTree::overlaps(const Box &a, const Box &b) {
+	return a.max[0] >= b.min[0] && b.max[0] >= a.min[0]
+		&& a.max[1] >= b.min[1] && b.max[1] >= a.min[1]
+		&& a.max[2] >= b.min[2] && b.max[2] >= a.min[2];
+}
+
+
+/**
+ * \brief Check if the box a contains the box b.
+ */
+bool AabbTree::contains(const Box &a, const Box &b) {
+	return a.min[0] <= b.min[0] && a.min[1] <= b.min[1] && a.min[2] <= b.min[2]
+		&& a.max[0] >= b.max[0] && a.max[1] >= b.max[1] && a.max[2] >= b.max[2];
+}
+
+
+/**
+ * \brief Get the distance at which a ray enters a box (slab-test).
+ *
+ * \return Entry-distance (max() => missed or farther than maxDistance).
+ */
+double AabbTree::getEntryDistance(const Box &box, const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double maxDistance) {
+	double tMin = 0.0;
+	double tMax = maxDistance;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		if (direction(axis) == 0.0) {
+			if (origin(axis) < box.min[axis] || origin(axis) > box.max[axis]) {
+				return std::numeric_limits<double>::max();
+			}
+		} else {
+			double inv = 1.0 / direction(axis);
+			double t1 = (box.min[axis] - origin(axis)) * inv;
+			double t2 = (box.max[axis] - origin(axis)) * inv;
+			tMin = std::max(tMin, std::min(t1, t2));
+			tMax = std::min(tMax, std::max(t1, t2));
+
+			if (tMin > tMax) {
+				return std::numeric_limits<double>::max();
+			}
+		}
+	}
+
+	return tMin;
+}
+
+
+/**
+ * \brief Get the squared distance of a point to a box (0 => inside).
+ */
+double AabbTree::getDistanceSquared(const Box &box, const Eigen::Vector3d &point) {
+	double distance = 0.0;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		double d = std::max(0.0, std::max(box.min[axis] - point(axis), point(axis) - box.max[axis]));
+		distance += d * d;
+	}
+
+	return distance;
+}
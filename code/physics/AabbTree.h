@@ -0,0 +1,334 @@
+﻿/**
+ * \brief Implementation of the dynamic AABB-tree used by the broad-phase.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <vector>
+#include <utility>
+#include <osg/BoundingBox>
+
+namespace pbs17 {
+	class AabbArray;
+	class SpaceObject;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Dynamic bounding-volume-hierarchy (like btDbvt / b2DynamicTree): Each object is a leaf with a fat AABB
+	 *        (enlarged by a margin), inner nodes contain both children and the tree is kept balanced by rotations.
+	 *
+	 * Only the objects which left their fat AABB are removed and reinserted. The overlapping pairs are found by
+	 * querying the tree with the tight AABB of each object, which is independent of how much the AABBs of large
+	 * and small objects differ in size.
+	 */
+	class AabbTree {
+	public:
+		/**
+		 * \brief Constructor of the AABB-tree.
+		 */
+		AabbTree();
+
+
+		/**
+		 * \brief Build the tree for all objects.
+		 *
+		 * \param objects
+		 *      All space-objects which are checked for collisions.
+		 */
+		void init(const std::vector<SpaceObject*> &objects);
+
+
+		/**
+		 * \brief Append an object, its leaf is inserted next to the best sibling.
+		 *
+		 * \param object
+		 *      Space-object which is checked from now on (gets the last index).
+		 */
+		void insert(SpaceObject* object);
+
+
+		/**
+		 * \brief Remove an object with its leaf, the last object is moved to its index (same as BodyState::remove()).
+		 *
+		 * \param i
+		 *      Index of the removed object.
+		 */
+		void remove(unsigned int i);
+
+
+		/**
+		 * \brief Refit the tree to the current AABBs and get the possible collisions.
+		 *
+		 * \param aabbs
+		 *      Swept AABBs of the objects of this step (same indices).
+		 * \param res
+		 *      Output-parameter: Pairs whose AABBs overlap (overwritten). By convention, on the first position the
+		 *	                      object with the smaller id is stored (key.first.Id < key.second.Id).
+		 */
+		void update(const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res);
+
+
+		/**
+		 * \brief Get all objects whose AABB overlaps with a region.
+		 *
+		 * \param region
+		 *      Box in the world-space.
+		 * \param res
+		 *      Output-parameter: Overlapping objects (overwritten).
+		 */
+		void queryRegion(const osg::BoundingBox &region, std::vector<SpaceObject*> &res) const;
+
+
+		/**
+		 * \brief Get the first object whose AABB is hit by a ray.
+		 *
+		 * \param origin
+		 *      Start of the ray.
+		 * \param direction
+		 *      Direction of the ray (does not have to be normalized, the distance is in multiples of it).
+		 * \param maxDistance
+		 *      Maximum distance of the hit.
+		 * \param distance
+		 *      Output-parameter: Distance of the hit.
+		 *
+		 * \return Hit object (nullptr if nothing is hit).
+		 */
+		SpaceObject* rayCast(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double maxDistance, double &distance) const;
+
+
+		/**
+		 * \brief Get all objects whose AABB is hit by a ray, ordered by the distance at which the ray enters the AABB.
+		 *
+		 * \param origin
+		 *      Start of the ray.
+		 * \param direction
+		 *      Direction of the ray (does not have to be normalized, the distance is in multiples of it).
+		 * \param maxDistance
+		 *      Maximum distance of the hits.
+		 * \param res
+		 *      Output-parameter: Entry-distances with the hit objects (overwritten).
+		 */
+		void queryRay(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double maxDistance, std::vector<std::pair<double, SpaceObject*>> &res) const;
+
+
+		/**
+		 * \brief Get the k objects whose centers are closest to a point (best-first traversal, the subtrees whose
+		 *        AABB is further away than the k-th candidate are skipped).
+		 *
+		 * \param point
+		 *      Point in the world-space.
+		 * \param k
+		 *      Maximum number of objects.
+		 * \param maxDistance
+		 *      Maximum distance of the centers.
+		 * \param res
+		 *      Output-parameter: Squared distances with the closest objects, ordered by the distance (overwritten).
+		 */
+		void queryNearest(const Eigen::Vector3d &point, unsigned int k, double maxDistance, std::vector<std::pair<double, SpaceObject*>> &res) const;
+
+
+		/**
+		 * \brief Set the margin of the fat AABBs.
+		 *
+		 * \param fatMargin
+		 *      Margin on each side relative to the largest extent of the AABB.
+		 */
+		void setFatMargin(const double fatMargin) {
+			_fatMargin = fatMargin;
+		}
+
+
+		/**
+		 * \brief Get the height of the tree.
+		 *
+		 * \return Height of the root (0 => only one leaf, -1 => empty).
+		 */
+		int getHeight() const {
+			return _root == -1 ? -1 : _nodes[_root].height;
+		}
+
+
+	private:
+		/**
+		 * \brief Axis-aligned box with single precision (same as the AABBs of the space-objects).
+		 */
+		struct Box {
+			float min[3];
+			float max[3];
+		};
+
+
+		/**
+		 * \brief Node of the tree. Leafs have no children and reference an object.
+		 */
+		struct Node {
+			//! Fat AABB of a leaf or union of the children
+			Box box;
+			//! Parent-node (next free node if the node is unused)
+			int parent;
+			//! Children (-1 => leaf)
+			int child1;
+			int child2;
+			//! Height of the subtree (0 => leaf, -1 => unused)
+			int height;
+			//! Index of the object of a leaf
+			int object;
+
+			bool isLeaf() const {
+				return child1 == -1;
+			}
+		};
+
+
+		//! Margin of the fat AABBs relative to the largest extent
+		double _fatMargin = 0.1;
+
+		//! All space-objects which are checked
+		std::vector<SpaceObject*> _objects;
+		//! Tight AABB per object of the last update
+		std::vector<Box> _boxes;
+		//! Leaf per object
+		std::vector<int> _leafOfObject;
+
+		//! Pool of the nodes
+		std::vector<Node> _nodes;
+		//! Root-node (-1 => empty)
+		int _root = -1;
+		//! First unused node (-1 => pool is full)
+		int _freeList = -1;
+
+
+		/**
+		 * \brief Get a node from the pool (the pool may grow, so references to nodes are invalidated).
+		 *
+		 * \return Index of the node.
+		 */
+		int allocateNode();
+
+
+		/**
+		 * \brief Return a node to the pool.
+		 *
+		 * \param node
+		 *      Index of the node.
+		 */
+		void freeNode(int node);
+
+
+		/**
+		 * \brief Insert a leaf next to the sibling with the smallest increase of the surface-area.
+		 *
+		 * \param leaf
+		 *      Index of the leaf.
+		 */
+		void insertLeaf(int leaf);
+
+
+		/**
+		 * \brief Remove a leaf (its parent is replaced by the sibling).
+		 *
+		 * \param leaf
+		 *      Index of the leaf.
+		 */
+		void removeLeaf(int leaf);
+
+
+		/**
+		 * \brief Refit the boxes and heights from a node up to the root and rotate unbalanced nodes.
+		 *
+		 * \param node
+		 *      First node to refit.
+		 */
+		void refit(int node);
+
+
+		/**
+		 * \brief Rotate the higher child of the node up, if the heights of the children differ by more than one.
+		 *
+		 * \param a
+		 *      Index of the node.
+		 *
+		 * \return Index of the node which is now at the position of a.
+		 */
+		int balance(int a);
+
+
+		/**
+		 * \brief Get the tight box of the current AABB of an object.
+		 *
+		 * \param object
+		 *      Index of the object.
+		 *
+		 * \return Box of the object.
+		 */
+		Box getObjectBox(int object) const;
+
+
+		/**
+		 * \brief Get the tight box of an object from the AABBs of a step.
+		 *
+		 * \param aabbs
+		 *      Swept AABBs of the objects.
+		 * \param object
+		 *      Index of the object.
+		 *
+		 * \return Box of the object.
+		 */
+		static Box getObjectBox(const AabbArray &aabbs, int object);
+
+
+		/**
+		 * \brief Enlarge a box by the fat margin.
+		 *
+		 * \param box
+		 *      Tight box.
+		 *
+		 * \return Fat box.
+		 */
+		Box fatten(const Box &box) const;
+
+
+		/**
+		 * \brief Get the smallest box containing both boxes.
+		 */
+		static Box combine(const Box &a, const Box &b);
+
+
+		/**
+		 * \brief Get the surface-area of a box (cost-function of the insertion).
+		 */
+		static float getSurfaceArea(const Box &box);
+
+
+		/**
+		 * \brief Check if two boxes overlap (touching boxes overlap).
+		 */
+		static bool overlaps(const Box &a, const Box &b);
+
+
+		/**
+		 * \brief Check if the box a contains the box b.
+		 */
+		static bool contains(const Box &a, const Box &b);
+
+
+		/**
+		 * \brief Get the distance at which a ray enters a box (slab-test).
+		 *
+		 * \return Entry-distance (max() => missed or farther than maxDistance).
+		 */
+		static double getEntryDistance(const Box &box, const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double maxDistance);
+
+
+		/**
+		 * \brief Get the squared distance of a point to a box (0 => inside).
+		 */
+		static double getDistanceSquared(const Box &box, const Eigen::Vector3d &point);
+	};
+}
@@ -0,0 +1,645 @@
+﻿/**
+ * \brief Implementation of the Barnes-Hut octree used to approximate the gravitational forces.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#include "BarnesHutTree.h"
+
+#include <math.h>
+#include <limits>
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "MortonCode.h"
+#include "GravityKernel.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor of the Barnes-Hut tree.
+ *
+ * \param theta
+ *      Opening angle (cell-size / distance) up to which a cell is approximated by its center of mass.
+ */
+BarnesHutTree::BarnesHutTree(double theta)
+	: _theta(theta) {}
+
+
+/**
+ * \brief Rebuild the tree from scratch for the given point-masses.
+ *
+ * \param positions
+ *      Positions of all bodies.
+ * \param masses
+ *      Masses of all bodies (same order as the positions, one per position).
+ */
+void BarnesHutTree::build(const std::vector<Eigen::Vector3d> &positions, const double* masses) {
+	int n = positions.size();
+
+	// the arrays keep their capacity, so nothing is allocated if the number of bodies does not change
+	_codes.resize(n);
+	_leafOfBody.resize(n);
+	_nodes.resize(std::max(2 * n - 1, 0));
+	_needsRebuild = false;
+
+	if (n == 0) {
+		_order.clear();
+		_groups.clear();
+		_builtCellSizes = 0.0;
+		return;
+	}
+
+	// Bounding cube of all bodies (the same scale on all axes, so the prefixes are cubic octree-cells)
+	double max = std::numeric_limits<double>::max();
+	Eigen::Vector3d bbMin(max, max, max);
+	Eigen::Vector3d bbMax(-max, -max, -max);
+
+	for (int i = 0; i < n; ++i) {
+		bbMin = bbMin.cwiseMin(positions[i]);
+		bbMax = bbMax.cwiseMax(positions[i]);
+	}
+
+	_rootSize = std::max((bbMax - bbMin).maxCoeff(), 1e-9);
+	double scale = ((1 << MortonCode::BITS_PER_AXIS) - 1) / _rootSize;
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		_codes[i] = MortonCode::encode(positions[i], bbMin, Eigen::Vector3d(scale, scale, scale));
+	}
+
+	MortonCode::sort(_codes, _order, _tmpCodes, _tmpOrder);
+
+	int cntInner = n - 1;
+	_nodes[0].parent = -1;
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < cntInner; ++i) {
+		buildInnerNode(i);
+	}
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < cntInner; ++i) {
+		collectChildren(i);
+	}
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < n; ++k) {
+		int leaf = cntInner + k;
+		_nodes[leaf].first = k;
+		_nodes[leaf].count = 1;
+		_leafOfBody[_order[k]] = leaf;
+	}
+
+	sumBottomUp(positions, masses);
+	_builtCellSizes = sumCellSizes();
+
+	collectGroups();
+}
+
+
+/**
+ * \brief Refit the tree to the moved bodies: the topology of the last build() is kept and the boxes, masses and
+ *        centers of mass are summed bottom-up again. The tree is rebuilt instead if it was invalidated, the
+ *        number of bodies changed or the summed cell-sizes grew by more than the refit-threshold.
+ *
+ * \param positions
+ *      Positions of all bodies (same bodies in the same order as passed to the last build()).
+ * \param masses
+ *      Masses of all bodies (same order as the positions, one per position).
+ *
+ * \return True if the tree was rebuilt.
+ */
+bool BarnesHutTree::update(const std::vector<Eigen::Vector3d> &positions, const double* masses) {
+	if (_needsRebuild || _refitThreshold <= 1.0 || positions.size() != _order.size() || positions.empty()) {
+		build(positions, masses);
+		return true;
+	}
+
+	sumBottomUp(positions, masses);
+
+	// the cells which have spread out are opened later, so the traversals get slower than after a rebuild
+	if (sumCellSizes() > _refitThreshold * _builtCellSizes) {
+		build(positions, masses);
+		return true;
+	}
+
+	return false;
+}
+
+
+/**
+ * \brief Set the leaves to the bodies and sum the inner nodes bottom-up in parallel (the second child which
+ *        arrives at a node continues with its parent).
+ *
+ * \param positions
+ *      Positions of all bodies.
+ * \param masses
+ *      Masses of all bodies.
+ */
+void BarnesHutTree::sumBottomUp(const std::vector<Eigen::Vector3d> &positions, const double* masses) {
+	int n = _order.size();
+	int cntInner = n - 1;
+	_visits.assign(cntInner, 0);
+
+	// each leaf walks up to the root, the first child which arrives at a node stops there
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < n; ++k) {
+		int body = _order[k];
+		Node &node = _nodes[cntInner + k];
+		node.boxMin = positions[body];
+		node.boxMax = positions[body];
+		node.centerOfMass = positions[body];
+		node.mass = masses[body];
+
+		for (int parent = node.parent; parent != -1; parent = _nodes[parent].parent) {
+			int visits;
+
+#if defined(_OPENMP)
+#pragma omp flush
+#pragma omp atomic capture
+#endif
+			visits = _visits[parent]++;
+
+			if (visits == 0) {
+				break;
+			}
+
+#if defined(_OPENMP)
+#pragma omp flush
+#endif
+			combineChildren(parent);
+		}
+	}
+}
+
+
+/**
+ * \brief Sum the cell-sizes of the inner nodes (quality-metric of update()).
+ *
+ * \return Sum of the cell-sizes.
+ */
+double BarnesHutTree::sumCellSizes() const {
+	int cntInner = static_cast<int>(_order.size()) - 1;
+	double sum = 0.0;
+
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(+:sum)
+#endif
+	for (int i = 0; i < cntInner; ++i) {
+		sum += _nodes[i].cellSize;
+	}
+
+	return sum;
+}
+
+
+/**
+ * \brief Calculate the mass-weighted direction field sum(m_j * d / (|d|^2 + eps)) for a body.
+ *        Multiplied by G and the mass of the body, this is the gravitational force on the body.
+ *        The traversal only reads the tree, so it can be called in parallel for all bodies.
+ *
+ * \param index
+ *      Index of the body (same order as passed to build()), which is excluded from the sum.
+ * \param eps
+ *      Softening which is added to the square distance.
+ *
+ * \return Sum of the mass-weighted directions to all other bodies.
+ */
+Eigen::Vector3d BarnesHutTree::computeField(int index, double eps) const {
+	Eigen::Vector3d field(0.0, 0.0, 0.0);
+
+	if (_nodes.empty()) {
+		return field;
+	}
+
+	const Eigen::Vector3d &position = _nodes[_leafOfBody[index]].centerOfMass;
+	double theta2 = _theta * _theta;
+
+	int stack[8 * MAX_DEPTH + 8];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		int nodeIndex = stack[--stackSize];
+		const Node &node = _nodes[nodeIndex];
+
+		if (node.mass <= 0.0) {
+			continue;
+		}
+
+		Eigen::Vector3d d = node.centerOfMass - position;
+		double r2 = d.squaredNorm();
+
+		if (isLeaf(nodeIndex)) {
+			// do not compare the object with it self
+			if (_order[nodeIndex - static_cast<int>(_order.size()) + 1] != index && r2 > 0.0) {
+				field += (node.mass / (r2 + eps)) * (d / std::sqrt(r2));
+			}
+			continue;
+		}
+
+		double size = node.cellSize;
+		bool isInside = (position.array() >= node.boxMin.array()).all() && (position.array() <= node.boxMax.array()).all();
+
+		if (!isInside && size * size < theta2 * r2) {
+			// cell is far enough away => approximate it by its center of mass
+			field += (node.mass / (r2 + eps)) * (d / std::sqrt(r2));
+		} else {
+			for (int c = 0; c < node.cntChildren; ++c) {
+				stack[stackSize++] = node.children[c];
+			}
+		}
+	}
+
+	return field;
+}
+
+
+/**
+ * \brief Calculate the potential -sum(m_j / (|d|^2 + eps)^(1/2)) of a body with the same opening decisions as
+ *        computeField(), so the energy is approximated at the same level as the forces.
+ *
+ * \param index
+ *      Index of the body (same order as passed to build()), which is excluded from the sum.
+ * \param eps
+ *      Softening which is added to the square distance.
+ *
+ * \return Potential of all other bodies (without G).
+ */
+double BarnesHutTree::computePotential(int index, double eps) const {
+	double potential = 0.0;
+
+	if (_nodes.empty()) {
+		return potential;
+	}
+
+	const Eigen::Vector3d &position = _nodes[_leafOfBody[index]].centerOfMass;
+	double theta2 = _theta * _theta;
+
+	int stack[8 * MAX_DEPTH + 8];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		int nodeIndex = stack[--stackSize];
+		const Node &node = _nodes[nodeIndex];
+
+		if (node.mass <= 0.0) {
+			continue;
+		}
+
+		double r2 = (node.centerOfMass - position).squaredNorm();
+
+		if (isLeaf(nodeIndex)) {
+			if (_order[nodeIndex - static_cast<int>(_order.size()) + 1] != index) {
+				potential -= node.mass / std::sqrt(r2 + eps);
+			}
+			continue;
+		}
+
+		double size = node.cellSize;
+		bool isInside = (position.array() >= node.boxMin.array()).all() && (position.array() <= node.boxMax.array()).all();
+
+		if (!isInside && size * size < theta2 * r2) {
+			potential -= node.mass / std::sqrt(r2 + eps);
+		} else {
+			for (int c = 0; c < node.cntChildren; ++c) {
+				stack[stackSize++] = node.children[c];
+			}
+		}
+	}
+
+	return potential;
+}
+
+
+/**
+ * \brief Calculate the field of computeField() for all bodies with one traversal per group of nearby bodies
+ *        (sub-trees of up to GROUP_SIZE bodies). A cell is approximated if it's far enough away from the whole
+ *        box of the group, so the accepted cells and bodies form one interaction-list which is evaluated
+ *        against all bodies of the group by the vectorized GravityKernel. The groups are calculated in parallel.
+ *
+ * \param eps
+ *      Softening which is added to the square distance (Plummer-softening of the GravityKernel).
+ * \param fields
+ *      Output-parameter: Sum of the mass-weighted directions to all other bodies (one per body, same order as
+ *      passed to build()).
+ */
+void BarnesHutTree::computeFieldsGrouped(double eps, std::vector<Eigen::Vector3d> &fields) const {
+	fields.resize(_order.size());
+
+	if (_nodes.empty()) {
+		return;
+	}
+
+	int cntInner = static_cast<int>(_order.size()) - 1;
+	int cntGroups = _groups.size();
+	double theta2 = _theta * _theta;
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+	{
+		// interaction-list of the current group (kept per thread, so it only grows for the first groups)
+		std::vector<double> x, y, z, m;
+		std::vector<double> ax, ay, az;
+		std::vector<int> targets;
+
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 4)
+#endif
+		for (int g = 0; g < cntGroups; ++g) {
+			const Node &group = _nodes[_groups[g]];
+			x.clear();
+			y.clear();
+			z.clear();
+			m.clear();
+			targets.assign(group.count, -1);
+
+			int stack[8 * MAX_DEPTH + 8];
+			int stackSize = 0;
+			stack[stackSize++] = 0;
+
+			while (stackSize > 0) {
+				int nodeIndex = stack[--stackSize];
+				const Node &node = _nodes[nodeIndex];
+
+				if (isLeaf(nodeIndex)) {
+					int k = nodeIndex - cntInner;
+					bool isTarget = k >= group.first && k < group.first + group.count;
+
+					// the massless bodies of the group are still needed as targets
+					if (isTarget) {
+						targets[k - group.first] = x.size();
+					} else if (node.mass <= 0.0) {
+						continue;
+					}
+				} else {
+					bool isAncestor = node.first < group.first + group.count && group.first < node.first + node.count;
+
+					if (node.mass <= 0.0 && !isAncestor) {
+						continue;
+					}
+
+					// the closest position of the group decides (as in collectEssential())
+					Eigen::Vector3d closest = node.centerOfMass.cwiseMax(group.boxMin).cwiseMin(group.boxMax);
+					double r2 = (node.centerOfMass - closest).squaredNorm();
+					double size = node.cellSize;
+					bool isOverlapping = (node.boxMin.array() <= group.boxMax.array()).all()
+						&& (node.boxMax.array() >= group.boxMin.array()).all();
+
+					if (isAncestor || isOverlapping || size * size >= theta2 * r2) {
+						for (int c = 0; c < node.cntChildren; ++c) {
+							stack[stackSize++] = node.children[c];
+						}
+						continue;
+					}
+				}
+
+				x.push_back(node.centerOfMass.x());
+				y.push_back(node.centerOfMass.y());
+				z.push_back(node.centerOfMass.z());
+				m.push_back(node.mass);
+			}
+
+			int cntSources = x.size();
+			ax.resize(cntSources);
+			ay.resize(cntSources);
+			az.resize(cntSources);
+
+			// the body itself is at distance 0 and does not contribute with the softening
+			GravityKernel::computeFieldsList(x.data(), y.data(), z.data(), m.data(), cntSources, eps,
+				targets.data(), group.count, ax.data(), ay.data(), az.data());
+
+			for (int t = 0; t < group.count; ++t) {
+				int source = targets[t];
+				fields[_order[group.first + t]] = Eigen::Vector3d(ax[source], ay[source], az[source]);
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Collect the locally essential tree of a remote domain: the cells which every position within the
+ *        domain approximates by their center of mass, and the bodies of the cells which are opened.
+ *        Built into the tree of the domain, they give the same opening decisions as this tree.
+ *
+ * \param domainMin, domainMax
+ *      Corners of the box of the remote domain.
+ * \param positions
+ *      Output-parameter: Positions of the cells and bodies (appended).
+ * \param masses
+ *      Output-parameter: Masses of the cells and bodies (appended).
+ */
+void BarnesHutTree::collectEssential(const Eigen::Vector3d &domainMin, const Eigen::Vector3d &domainMax,
+	std::vector<Eigen::Vector3d> &positions, std::vector<double> &masses) const {
+	if (_nodes.empty()) {
+		return;
+	}
+
+	double theta2 = _theta * _theta;
+
+	int stack[8 * MAX_DEPTH + 8];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		int nodeIndex = stack[--stackSize];
+		const Node &node = _nodes[nodeIndex];
+
+		if (node.mass <= 0.0) {
+			continue;
+		}
+
+		if (isLeaf(nodeIndex)) {
+			positions.push_back(node.centerOfMass);
+			masses.push_back(node.mass);
+			continue;
+		}
+
+		// the closest position of the domain decides (it's the last one which would approximate the cell)
+		Eigen::Vector3d closest = node.centerOfMass.cwiseMax(domainMin).cwiseMin(domainMax);
+		double r2 = (node.centerOfMass - closest).squaredNorm();
+		double size = node.cellSize;
+		bool isOverlapping = (node.boxMin.array() <= domainMax.array()).all() && (node.boxMax.array() >= domainMin.array()).all();
+
+		if (!isOverlapping && size * size < theta2 * r2) {
+			positions.push_back(node.centerOfMass);
+			masses.push_back(node.mass);
+		} else {
+			for (int c = 0; c < node.cntChildren; ++c) {
+				stack[stackSize++] = node.children[c];
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Length of the common prefix of two sorted codes (equal codes are told apart by their indices).
+ *
+ * \param i, j
+ *      Indices of the sorted codes.
+ *
+ * \return Common bits or -1 if j is out of range.
+ */
+int BarnesHutTree::getCommonPrefix(int i, int j) const {
+	if (j < 0 || j >= static_cast<int>(_codes.size())) {
+		return -1;
+	}
+
+	if (_codes[i] == _codes[j]) {
+		return 64 + MortonCode::countLeadingZeros(static_cast<uint64_t>(i ^ j)) - 32;
+	}
+
+	return MortonCode::countLeadingZeros(_codes[i] ^ _codes[j]);
+}
+
+
+/**
+ * \brief Find the range of the codes of an inner node and split it at the highest differing bit.
+ *
+ * \param i
+ *      Index of the inner node.
+ */
+void BarnesHutTree::buildInnerNode(int i) {
+	// direction of the range: towards the neighbour with the longer common prefix
+	int direction = getCommonPrefix(i, i + 1) - getCommonPrefix(i, i - 1) >= 0 ? 1 : -1;
+	int minPrefix = getCommonPrefix(i, i - direction);
+
+	// upper bound of the length of the range, then the exact end by a binary search
+	int maxLength = 2;
+	while (getCommonPrefix(i, i + maxLength * direction) > minPrefix) {
+		maxLength *= 2;
+	}
+
+	int length = 0;
+	for (int step = maxLength / 2; step >= 1; step /= 2) {
+		if (getCommonPrefix(i, i + (length + step) * direction) > minPrefix) {
+			length += step;
+		}
+	}
+	int j = i + length * direction;
+
+	// the split is the last code which shares more than the prefix of the range with the first one
+	int nodePrefix = getCommonPrefix(i, j);
+	int split = 0;
+	int step = length;
+	do {
+		step = (step + 1) / 2;
+		if (getCommonPrefix(i, i + (split + step) * direction) > nodePrefix) {
+			split += step;
+		}
+	} while (step > 1);
+	int gamma = i + split * direction + std::min(direction, 0);
+
+	int cntInner = static_cast<int>(_codes.size()) - 1;
+	// the highest bit of the codes is not used, a level of the octree has 3 bits (the duplicates share the finest cell)
+	Node &node = _nodes[i];
+	node.level = (nodePrefix - 1) / 3;
+	node.left = std::min(i, j) == gamma ? cntInner + gamma : gamma;
+	node.right = std::max(i, j) == gamma + 1 ? cntInner + gamma + 1 : gamma + 1;
+	node.first = std::min(i, j);
+	node.count = length + 1;
+
+	_nodes[node.left].parent = i;
+	_nodes[node.right].parent = i;
+}
+
+
+/**
+ * \brief Collect the children of an octree-node by skipping the binary nodes of the same cell.
+ *
+ * \param i
+ *      Index of the inner node (nothing is collected if it's in the same cell as its parent).
+ */
+void BarnesHutTree::collectChildren(int i) {
+	Node &node = _nodes[i];
+	node.cntChildren = 0;
+
+	if (node.parent != -1 && _nodes[node.parent].level == node.level) {
+		return;
+	}
+
+	// the binary sub-tree of a cell splits at its 3 bits, so it has at most 8 nodes of deeper cells
+	int stack[8];
+	int stackSize = 0;
+	stack[stackSize++] = node.right;
+	stack[stackSize++] = node.left;
+
+	while (stackSize > 0) {
+		int child = stack[--stackSize];
+
+		if (!isLeaf(child) && _nodes[child].level == node.level) {
+			stack[stackSize++] = _nodes[child].right;
+			stack[stackSize++] = _nodes[child].left;
+		} else {
+			node.children[node.cntChildren++] = child;
+		}
+	}
+}
+
+
+/**
+ * \brief Sum the mass, center of mass and bounding-box of an inner node from its children.
+ *
+ * \param i
+ *      Index of the inner node.
+ */
+void BarnesHutTree::combineChildren(int i) {
+	Node &node = _nodes[i];
+	const Node &left = _nodes[node.left];
+	const Node &right = _nodes[node.right];
+
+	node.boxMin = left.boxMin.cwiseMin(right.boxMin);
+	node.boxMax = left.boxMax.cwiseMax(right.boxMax);
+	node.mass = left.mass + right.mass;
+	node.centerOfMass = node.mass > 0.0
+		? Eigen::Vector3d((left.mass * left.centerOfMass + right.mass * right.centerOfMass) / node.mass)
+		: Eigen::Vector3d(0.5 * (node.boxMin + node.boxMax));
+
+	// after a build the box is within the cell, after a refit the bodies may have left it
+	node.cellSize = std::max(ldexp(_rootSize, -std::min(node.level, MortonCode::BITS_PER_AXIS)),
+		(node.boxMax - node.boxMin).maxCoeff());
+}
+
+
+
+/**
+ * \brief Collect the groups of computeFieldsGrouped() by descending the binary nodes from the root.
+ */
+void BarnesHutTree::collectGroups() {
+	_groups.clear();
+
+	std::vector<int> stack(1, 0);
+
+	while (!stack.empty()) {
+		int nodeIndex = stack.back();
+		stack.pop_back();
+		const Node &node = _nodes[nodeIndex];
+
+		if (node.count <= GROUP_SIZE) {
+			_groups.push_back(nodeIndex);
+		} else {
+			stack.push_back(node.right);
+			stack.push_back(node.left);
+		}
+	}
+}
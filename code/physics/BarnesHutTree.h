@@ -0,0 +1,320 @@
+﻿/**
+ * \brief Implementation of the Barnes-Hut octree used to approximate the gravitational forces.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <vector>
+#include <stdint.h>
+
+namespace pbs17 {
+
+	/**
+	 * \brief Tree over point-masses. Far away cells are approximated by their center of mass based
+	 *        on the opening angle theta, which reduces the force-calculation to O(N log N).
+	 *
+	 * The tree is a linear radix-tree over the sorted Morton-codes of the bodies (Karras 2012): the n - 1 inner
+	 * nodes and the n leaves live in one flat array, each inner node finds its range and split independently
+	 * (built in parallel), and the masses, centers of mass and bounding-boxes are summed bottom-up in one pass
+	 * (the second child which arrives at a node continues with its parent). A common prefix of the codes is a
+	 * common octree-cell, so the binary nodes of the same cell are collapsed into the up to 8 children of the
+	 * octree-node which is traversed.
+	 */
+	class BarnesHutTree {
+	public:
+		/**
+		 * \brief Constructor of the Barnes-Hut tree.
+		 *
+		 * \param theta
+		 *      Opening angle (cell-size / distance) up to which a cell is approximated by its center of mass.
+		 */
+		BarnesHutTree(double theta = 0.5);
+
+
+		/**
+		 * \brief Rebuild the tree from scratch for the given point-masses.
+		 *
+		 * \param positions
+		 *      Positions of all bodies.
+		 * \param masses
+		 *      Masses of all bodies (same order as the positions, one per position).
+		 */
+		void build(const std::vector<Eigen::Vector3d> &positions, const double* masses);
+
+
+		/**
+		 * \brief Refit the tree to the moved bodies: the topology of the last build() is kept and the boxes, masses and
+		 *        centers of mass are summed bottom-up again. The tree is rebuilt instead if it was invalidated, the
+		 *        number of bodies changed or the summed cell-sizes grew by more than the refit-threshold.
+		 *
+		 * \param positions
+		 *      Positions of all bodies (same bodies in the same order as passed to the last build()).
+		 * \param masses
+		 *      Masses of all bodies (same order as the positions, one per position).
+		 *
+		 * \return True if the tree was rebuilt.
+		 */
+		bool update(const std::vector<Eigen::Vector3d> &positions, const double* masses);
+
+
+		/**
+		 * \brief Rebuild the tree by the next update(), e.g. after the bodies were reordered (the leaves refer to
+		 *        the indices of the bodies).
+		 */
+		void invalidate() {
+			_needsRebuild = true;
+		}
+
+
+		/**
+		 * \brief Set the threshold of update(): the tree is refitted as long as the summed cell-sizes of the inner nodes
+		 *        are at most this factor larger than after the last build().
+		 *
+		 * \param refitThreshold
+		 *      Maximum growth of the cell-sizes (1.0 or less means rebuild each time).
+		 */
+		void setRefitThreshold(const double refitThreshold) {
+			_refitThreshold = refitThreshold;
+		}
+
+
+		/**
+		 * \brief Get the threshold of update().
+		 *
+		 * \return Maximum growth of the cell-sizes.
+		 */
+		double getRefitThreshold() const {
+			return _refitThreshold;
+		}
+
+
+		/**
+		 * \brief Calculate the mass-weighted direction field sum(m_j * d / (|d|^2 + eps)) for a body.
+		 *        Multiplied by G and the mass of the body, this is the gravitational force on the body.
+		 *        The traversal only reads the tree, so it can be called in parallel for all bodies.
+		 *
+		 * \param index
+		 *      Index of the body (same order as passed to build()), which is excluded from the sum.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 *
+		 * \return Sum of the mass-weighted directions to all other bodies.
+		 */
+		Eigen::Vector3d computeField(int index, double eps) const;
+
+
+		/**
+		 * \brief Calculate the potential -sum(m_j / (|d|^2 + eps)^(1/2)) of a body with the same opening decisions as
+		 *        computeField(), so the energy is approximated at the same level as the forces.
+		 *
+		 * \param index
+		 *      Index of the body (same order as passed to build()), which is excluded from the sum.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 *
+		 * \return Potential of all other bodies (without G).
+		 */
+		double computePotential(int index, double eps) const;
+
+
+		/**
+		 * \brief Calculate the field of computeField() for all bodies with one traversal per group of nearby bodies
+		 *        (sub-trees of up to GROUP_SIZE bodies). A cell is approximated if it's far enough away from the whole
+		 *        box of the group, so the accepted cells and bodies form one interaction-list which is evaluated
+		 *        against all bodies of the group by the vectorized GravityKernel. The groups are calculated in parallel.
+		 *
+		 * \param eps
+		 *      Softening which is added to the square distance (Plummer-softening of the GravityKernel).
+		 * \param fields
+		 *      Output-parameter: Sum of the mass-weighted directions to all other bodies (one per body, same order as
+		 *      passed to build()).
+		 */
+		void computeFieldsGrouped(double eps, std::vector<Eigen::Vector3d> &fields) const;
+
+
+		/**
+		 * \brief Collect the locally essential tree of a remote domain: the cells which every position within the
+		 *        domain approximates by their center of mass, and the bodies of the cells which are opened.
+		 *        Built into the tree of the domain, they give the same opening decisions as this tree.
+		 *
+		 * \param domainMin, domainMax
+		 *      Corners of the box of the remote domain.
+		 * \param positions
+		 *      Output-parameter: Positions of the cells and bodies (appended).
+		 * \param masses
+		 *      Output-parameter: Masses of the cells and bodies (appended).
+		 */
+		void collectEssential(const Eigen::Vector3d &domainMin, const Eigen::Vector3d &domainMax,
+			std::vector<Eigen::Vector3d> &positions, std::vector<double> &masses) const;
+
+
+		/**
+		 * \brief Set the opening angle.
+		 *
+		 * \param theta
+		 *      New opening angle (0.0 means exact all-pairs summation).
+		 */
+		void setTheta(const double theta) {
+			_theta = theta;
+		}
+
+
+		/**
+		 * \brief Get the opening angle.
+		 *
+		 * \return Opening angle.
+		 */
+		double getTheta() const {
+			return _theta;
+		}
+
+
+	private:
+		/**
+		 * \brief Single node of the tree. The inner nodes are at 0 .. n - 2 (root at 0), the leaves at n - 1 .. 2n - 2
+		 *        (one body per leaf in the order of the codes). Only the octree-nodes (the root and the nodes
+		 *        which are in a deeper cell than their parent) are traversed.
+		 */
+		struct Node {
+			//! Bounding-box of the bodies of the node
+			Eigen::Vector3d boxMin;
+			Eigen::Vector3d boxMax;
+			Eigen::Vector3d centerOfMass;
+			double mass;
+			//! Side-length of the octree-cell of the common prefix of the codes of the node (or of the box if the
+			//! bodies moved out of the cell since the build)
+			double cellSize;
+			//! Children of the binary inner node (indices into _nodes)
+			int left;
+			int right;
+			//! Parent of the node (-1 for the root)
+			int parent;
+			//! Level of the octree-cell (3 bits of the common prefix per level)
+			int level;
+			//! Children of the octree-node (the nearest nodes of a deeper cell or leaves)
+			int children[8];
+			int cntChildren;
+			//! First leaf (in the order of the codes) and number of bodies of the node
+			int first;
+			int count;
+		};
+
+		//! Maximum depth of the octree (63 bits of the codes and up to 32 bits of the index for duplicate codes)
+		static const int MAX_DEPTH = 32;
+
+		//! Maximum number of bodies which share the traversal of computeFieldsGrouped()
+		static const int GROUP_SIZE = 32;
+
+		//! Opening angle
+		double _theta;
+
+		//! Side-length of the root-cell
+		double _rootSize = 0.0;
+
+		//! Maximum growth of the cell-sizes up to which update() refits the tree (see setRefitThreshold())
+		double _refitThreshold = 1.0;
+		//! Summed cell-sizes of the inner nodes after the last build()
+		double _builtCellSizes = 0.0;
+		//! Flag if the next update() has to rebuild the tree
+		bool _needsRebuild = true;
+
+		//! All nodes of the tree (inner nodes first, then the leaves)
+		std::vector<Node> _nodes;
+
+		//! Body of each leaf (in the order of the codes)
+		std::vector<int> _order;
+		//! Leaf of each body
+		std::vector<int> _leafOfBody;
+
+		//! Sorted Morton-codes of the bodies and the buffers of the sort (kept between the builds)
+		std::vector<uint64_t> _codes;
+		std::vector<uint64_t> _tmpCodes;
+		std::vector<int> _tmpOrder;
+		//! Number of children which have been summed per inner node
+		std::vector<int> _visits;
+
+		//! Largest nodes with up to GROUP_SIZE bodies (they cover all leaves)
+		std::vector<int> _groups;
+
+
+		/**
+		 * \brief Check if a node is a leaf.
+		 *
+		 * \param node
+		 *      Index of the node.
+		 *
+		 * \return True if the node is a leaf (also the root of a tree with a single body).
+		 */
+		bool isLeaf(int node) const {
+			return node >= static_cast<int>(_order.size()) - 1;
+		}
+
+
+		/**
+		 * \brief Length of the common prefix of two sorted codes (equal codes are told apart by their indices).
+		 *
+		 * \param i, j
+		 *      Indices of the sorted codes.
+		 *
+		 * \return Common bits or -1 if j is out of range.
+		 */
+		int getCommonPrefix(int i, int j) const;
+
+
+		/**
+		 * \brief Find the range of the codes of an inner node and split it at the highest differing bit.
+		 *
+		 * \param i
+		 *      Index of the inner node.
+		 */
+		void buildInnerNode(int i);
+
+
+		/**
+		 * \brief Collect the children of an octree-node by skipping the binary nodes of the same cell.
+		 *
+		 * \param i
+		 *      Index of the inner node (nothing is collected if it's in the same cell as its parent).
+		 */
+		void collectChildren(int i);
+
+
+		/**
+		 * \brief Sum the mass, center of mass and bounding-box of an inner node from its children.
+		 *
+		 * \param i
+		 *      Index of the inner node.
+		 */
+		void combineChildren(int i);
+
+
+		/**
+		 * \brief Set the leaves to the bodies and sum the inner nodes bottom-up in parallel (the second child which
+		 *        arrives at a node continues with its parent).
+		 *
+		 * \param positions
+		 *      Positions of all bodies.
+		 * \param masses
+		 *      Masses of all bodies.
+		 */
+		void sumBottomUp(const std::vector<Eigen::Vector3d> &positions, const double* masses);
+
+
+		/**
+		 * \brief Sum the cell-sizes of the inner nodes (quality-metric of update()).
+		 *
+		 * \return Sum of the cell-sizes.
+		 */
+		double sumCellSizes() const;
+
+
+		/**
+		 * \brief Collect the groups of computeFieldsGrouped() by descending the binary nodes from the root.
+		 */
+		void collectGroups();
+	};
+}
@@ -0,0 +1,80 @@
+﻿/**
+ * \brief Implementation of a pool of preallocated bodies which are spawned and despawned at runtime.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#include "BodyPool.h"
+
+#include "../scene/SpaceObject.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Destructor of the pool (deletes all objects, spawned or not).
+ */
+BodyPool::~BodyPool() {
+	for (unsigned int i = 0; i < _objects.size(); ++i) {
+		delete _objects[i];
+	}
+}
+
+
+/**
+ * \brief Reserve the arrays for the number of objects which are added.
+ *
+ * \param n
+ *      Number of objects.
+ */
+void BodyPool::reserve(unsigned int n) {
+	_objects.reserve(n);
+	_free.reserve(n);
+}
+
+
+/**
+ * \brief Add a preallocated object to the pool (the pool takes its ownership, the object is deactivated).
+ *
+ * \param object
+ *      Object which is not simulated yet.
+ */
+void BodyPool::add(SpaceObject* object) {
+	object->setActive(false);
+	object->setPool(this);
+
+	_objects.push_back(object);
+	_free.push_back(object);
+}
+
+
+/**
+ * \brief Take a free object out of the pool.
+ *
+ * \return Free object (nullptr => the pool is exhausted).
+ */
+SpaceObject* BodyPool::acquire() {
+	if (_free.empty()) {
+		return nullptr;
+	}
+
+	SpaceObject* object = _free.back();
+	_free.pop_back();
+
+	return object;
+}
+
+
+/**
+ * \brief Give an object back to the pool after it was despawned (it's deactivated).
+ *
+ * \param object
+ *      Object of this pool which has been acquired.
+ */
+void BodyPool::release(SpaceObject* object) {
+	object->setActive(false);
+
+	// the stack has the capacity of all objects, so this never allocates
+	_free.push_back(object);
+}
@@ -0,0 +1,106 @@
+﻿/**
+ * \brief Implementation of a pool of preallocated bodies which are spawned and despawned at runtime.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#pragma once
+
+#include <vector>
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Pool of space-objects which are created (with their OSG-nodes and physics) when the scene is loaded,
+	 * so spawning and despawning a body at runtime only activates or deactivates it (see SimulationManager::spawn()
+	 * and SimulationManager::despawn()). The free objects are kept on a stack, the pool owns all of its objects.
+	 */
+	class BodyPool {
+	public:
+		/**
+		 * \brief Constructor of an empty pool.
+		 */
+		BodyPool() = default;
+
+
+		/**
+		 * \brief Destructor of the pool (deletes all objects, spawned or not).
+		 */
+		~BodyPool();
+
+
+		/**
+		 * \brief Reserve the arrays for the number of objects which are added.
+		 *
+		 * \param n
+		 *      Number of objects.
+		 */
+		void reserve(unsigned int n);
+
+
+		/**
+		 * \brief Add a preallocated object to the pool (the pool takes its ownership, the object is deactivated).
+		 *
+		 * \param object
+		 *      Object which is not simulated yet.
+		 */
+		void add(SpaceObject* object);
+
+
+		/**
+		 * \brief Take a free object out of the pool.
+		 *
+		 * \return Free object (nullptr => the pool is exhausted).
+		 */
+		SpaceObject* acquire();
+
+
+		/**
+		 * \brief Give an object back to the pool after it was despawned (it's deactivated).
+		 *
+		 * \param object
+		 *      Object of this pool which has been acquired.
+		 */
+		void release(SpaceObject* object);
+
+
+		/**
+		 * \brief Get the number of objects which can be acquired.
+		 *
+		 * \return Number of free objects.
+		 */
+		unsigned int getNumFree() const {
+			return static_cast<unsigned int>(_free.size());
+		}
+
+
+		/**
+		 * \brief Get all objects of the pool (free or not).
+		 *
+		 * \return Objects in the order in which they were added.
+		 */
+		const std::vector<SpaceObject*>& getObjects() const {
+			return _objects;
+		}
+
+
+	private:
+		//! All objects of the pool
+		std::vector<SpaceObject*> _objects;
+		//! Objects which can be acquired (the last one is acquired first)
+		std::vector<SpaceObject*> _free;
+
+
+		//! Copying would delete the objects twice
+		BodyPool(BodyPool const&) = delete;
+		BodyPool& operator=(BodyPool const&) = delete;
+	};
+}
@@ -0,0 +1,437 @@
+﻿/**
+ * \brief Implementation of the structure-of-arrays state of all simulated bodies.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#include "BodyState.h"
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "../scene/SpaceObject.h"
+#include "MortonCode.h"
+
+using namespace pbs17;
+
+//! Angle below which the exponential map uses the Taylor-expansion of sin and cos
+const double BodyState::SMALL_ANGLE = 1e-3;
+
+
+namespace {
+	/**
+	 * \brief Get the factors of the exponential map q = (cos(a / 2), sin(a / 2) / a * r) of a rotation-vector r with the angle a.
+	 *
+	 * \param angle2
+	 *      Square of the angle.
+	 * \param s
+	 *      Output-parameter: sin(a / 2) / a.
+	 * \param c
+	 *      Output-parameter: cos(a / 2).
+	 */
+	inline void getExponentialMap(double angle2, double &s, double &c) {
+		if (angle2 < BodyState::SMALL_ANGLE * BodyState::SMALL_ANGLE) {
+			// error of the order a^6, below the rounding for the small angles
+			s = 0.5 - angle2 * (1.0 / 48.0 - angle2 / 3840.0);
+			c = 1.0 - angle2 * (0.125 - angle2 / 384.0);
+		} else {
+			double angle = sqrt(angle2);
+			s = sin(0.5 * angle) / angle;
+			c = cos(0.5 * angle);
+		}
+	}
+}
+
+
+/**
+ * \brief Constructor of the body-state.
+ */
+BodyState::BodyState() {}
+
+
+/**
+ * \brief Copy the state of all space-objects into the arrays (resizes the arrays).
+ *
+ * \param spaceObjects
+ *      All space-objects in the scene.
+ */
+void BodyState::gather(const std::vector<SpaceObject*> &spaceObjects) {
+	unsigned int n = spaceObjects.size();
+
+	x.resize(n); y.resize(n); z.resize(n);
+	vx.resize(n); vy.resize(n); vz.resize(n);
+	wx.resize(n); wy.resize(n); wz.resize(n);
+	qx.resize(n); qy.resize(n); qz.resize(n); qw.resize(n);
+	m.resize(n);
+	id.resize(n);
+	sleeping.resize(n);
+	testParticle.resize(n);
+	visualSpin.resize(n);
+
+	_indexById.clear();
+	for (unsigned int i = 0; i < n; ++i) {
+		copyFrom(i, spaceObjects[i]);
+		_indexById[id[i]] = i;
+	}
+
+	_loadPosition.clear();
+	_loadOrder.clear();
+}
+
+
+/**
+ * \brief Copy the state of a single space-object into the arrays, e.g. after it was changed
+ *        by the collision-response or by the player.
+ *
+ * \param spaceObject
+ *      Space-object which has been gathered before.
+ */
+void BodyState::gather(const SpaceObject* spaceObject) {
+	int i = getIndex(spaceObject->getId());
+
+	if (i >= 0) {
+		copyFrom(i, spaceObject);
+	}
+}
+
+
+/**
+ * \brief Reserve the arrays for a number of bodies, so bodies can be added without reallocating them.
+ *
+ * \param n
+ *      Number of bodies.
+ */
+void BodyState::reserve(unsigned int n) {
+	x.reserve(n); y.reserve(n); z.reserve(n);
+	vx.reserve(n); vy.reserve(n); vz.reserve(n);
+	wx.reserve(n); wy.reserve(n); wz.reserve(n);
+	qx.reserve(n); qy.reserve(n); qz.reserve(n); qw.reserve(n);
+	m.reserve(n);
+	id.reserve(n);
+	sleeping.reserve(n);
+	testParticle.reserve(n);
+	visualSpin.reserve(n);
+}
+
+
+/**
+ * \brief Append a space-object as last body (e.g. a spawned body, see SimulationManager::spawn()).
+ *
+ * \param spaceObject
+ *      Space-object which is not gathered yet.
+ *
+ * \return Index of the new body.
+ */
+unsigned int BodyState::add(const SpaceObject* spaceObject) {
+	unsigned int i = size();
+	unsigned int n = i + 1;
+
+	x.resize(n); y.resize(n); z.resize(n);
+	vx.resize(n); vy.resize(n); vz.resize(n);
+	wx.resize(n); wy.resize(n); wz.resize(n);
+	qx.resize(n); qy.resize(n); qz.resize(n); qw.resize(n);
+	m.resize(n);
+	id.resize(n);
+	sleeping.resize(n);
+	testParticle.resize(n);
+	visualSpin.resize(n);
+
+	copyFrom(i, spaceObject);
+	_indexById[id[i]] = i;
+
+	// the scene has no position for the new body
+	_loadPosition.clear();
+	_loadOrder.clear();
+
+	return i;
+}
+
+
+/**
+ * \brief Remove a body by moving the last body to its index, so the arrays stay dense (the order of the
+ *        scene is lost, see getLoadOrder()).
+ *
+ * \param i
+ *      Index of the removed body.
+ */
+void BodyState::remove(unsigned int i) {
+	unsigned int n = size();
+	if (i >= n) {
+		return;
+	}
+
+	_indexById.erase(id[i]);
+	if (i + 1 < n) {
+		_indexById[id[n - 1]] = i;
+	}
+
+	removeFromArray(x, i); removeFromArray(y, i); removeFromArray(z, i);
+	removeFromArray(vx, i); removeFromArray(vy, i); removeFromArray(vz, i);
+	removeFromArray(wx, i); removeFromArray(wy, i); removeFromArray(wz, i);
+	removeFromArray(qx, i); removeFromArray(qy, i); removeFromArray(qz, i); removeFromArray(qw, i);
+	removeFromArray(m, i);
+	removeFromArray(id, i);
+	removeFromArray(sleeping, i);
+	removeFromArray(testParticle, i);
+	removeFromArray(visualSpin, i);
+
+	_loadPosition.clear();
+	_loadOrder.clear();
+}
+
+
+/**
+ * \brief Write the positions, orientations and velocities back to the space-objects (the OSG-nodes
+ *        are updated separately with SpaceObject::updateTransformation()). Bodies which were already
+ *        sleeping are skipped.
+ *
+ * \param spaceObjects
+ *      All space-objects in the scene (same order as gathered).
+ */
+void BodyState::scatter(const std::vector<SpaceObject*> &spaceObjects) const {
+	int n = std::min(static_cast<unsigned int>(spaceObjects.size()), size());
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		copyTo(i, spaceObjects[i]);
+	}
+}
+
+
+/**
+ * \brief Same as scatter(), but only for a range of the bodies (e.g. a chunk of a task-graph).
+ *
+ * \param spaceObjects
+ *      All space-objects in the scene (same order as gathered).
+ * \param first, last
+ *      Range of the written bodies (last is excluded).
+ */
+void BodyState::scatter(const std::vector<SpaceObject*> &spaceObjects, int first, int last) const {
+	last = std::min(last, static_cast<int>(std::min(static_cast<unsigned int>(spaceObjects.size()), size())));
+
+	for (int i = first; i < last; ++i) {
+		copyTo(i, spaceObjects[i]);
+	}
+}
+
+
+/**
+ * \brief Reorder the bodies (e.g. along a Morton-curve, see sortMorton()). The ids and with them the
+ *        space-objects stay valid, only their indices change.
+ *
+ * \param order
+ *      Old index of the body at each new index (a permutation of all bodies).
+ */
+void BodyState::permute(const std::vector<int> &order) {
+	unsigned int n = size();
+	if (order.size() != n) {
+		return;
+	}
+
+	if (_loadPosition.size() != n) {
+		_loadPosition.resize(n);
+		for (unsigned int i = 0; i < n; ++i) {
+			_loadPosition[i] = i;
+		}
+	}
+
+	permuteArray(x, order); permuteArray(y, order); permuteArray(z, order);
+	permuteArray(vx, order); permuteArray(vy, order); permuteArray(vz, order);
+	permuteArray(wx, order); permuteArray(wy, order); permuteArray(wz, order);
+	permuteArray(qx, order); permuteArray(qy, order); permuteArray(qz, order); permuteArray(qw, order);
+	permuteArray(m, order);
+	permuteArray(id, order);
+	permuteArray(sleeping, order);
+	permuteArray(testParticle, order);
+	permuteArray(visualSpin, order);
+	permuteArray(_loadPosition, order);
+
+	_loadOrder.resize(n);
+	bool isLoadOrder = true;
+	for (unsigned int i = 0; i < n; ++i) {
+		_indexById[id[i]] = i;
+		_loadOrder[_loadPosition[i]] = i;
+		isLoadOrder = isLoadOrder && _loadPosition[i] == static_cast<int>(i);
+	}
+
+	// back in the order of the scene (e.g. for a checkpoint)
+	if (isLoadOrder) {
+		_loadPosition.clear();
+		_loadOrder.clear();
+	}
+}
+
+
+/**
+ * \brief Sort the bodies along a Morton-curve (Z-curve with 21 bits per axis within their bounding-box),
+ *        so consecutive bodies are close to each other.
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param order
+ *      Output-parameter: Indices of the bodies in the order of the curve (overwritten).
+ */
+void BodyState::sortMorton(const double* x, const double* y, const double* z, int n, std::vector<int> &order) {
+	double max = std::numeric_limits<double>::max();
+	Eigen::Vector3d bbMin(max, max, max);
+	Eigen::Vector3d bbMax(-max, -max, -max);
+	for (int i = 0; i < n; ++i) {
+		Eigen::Vector3d position(x[i], y[i], z[i]);
+		bbMin = bbMin.cwiseMin(position);
+		bbMax = bbMax.cwiseMax(position);
+	}
+
+	Eigen::Vector3d scale;
+	for (int axis = 0; axis < 3; ++axis) {
+		scale(axis) = bbMax(axis) > bbMin(axis) ? ((1 << MortonCode::BITS_PER_AXIS) - 1) / (bbMax(axis) - bbMin(axis)) : 0.0;
+	}
+
+	std::vector<uint64_t> codes(n);
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		codes[i] = MortonCode::encode(Eigen::Vector3d(x[i], y[i], z[i]), bbMin, scale);
+	}
+
+	std::vector<uint64_t> tmpCodes;
+	std::vector<int> tmpOrder;
+	MortonCode::sort(codes, order, tmpCodes, tmpOrder);
+}
+
+
+/**
+ * \brief Rotate the bodies with their angular velocities over a timestep (exponential map of w * dt directly
+ *        on the quaternion-arrays). The orientations are renormalized, so the rounding does not accumulate.
+ *        The bodies with a visual spin are skipped (the shader rotates them).
+ *
+ * \param indices
+ *      Indices of the rotated bodies (nullptr for the bodies 0 to cnt - 1).
+ * \param cnt
+ *      Number of rotated bodies.
+ * \param dt
+ *      Timestep.
+ */
+void BodyState::rotate(const int* indices, int cnt, double dt) {
+	// the flags are missing if the arrays were filled without gather()
+	const char* isVisualSpin = visualSpin.size() == size() ? visualSpin.data() : nullptr;
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cnt; ++k) {
+		int i = indices ? indices[k] : k;
+		if (isVisualSpin && isVisualSpin[i]) continue;
+
+		double rx = dt * wx[i];
+		double ry = dt * wy[i];
+		double rz = dt * wz[i];
+
+		double s, c;
+		getExponentialMap(rx * rx + ry * ry + rz * rz, s, c);
+		rx *= s;
+		ry *= s;
+		rz *= s;
+
+		// orientation * (c, r) (osg::Quat multiplies in reversed order, so this equals q * orientation in OSG)
+		double w = qw[i] * c - qx[i] * rx - qy[i] * ry - qz[i] * rz;
+		double x = qw[i] * rx + qx[i] * c + qy[i] * rz - qz[i] * ry;
+		double y = qw[i] * ry - qx[i] * rz + qy[i] * c + qz[i] * rx;
+		double z = qw[i] * rz + qx[i] * ry - qy[i] * rx + qz[i] * c;
+		double invNorm = 1.0 / sqrt(w * w + x * x + y * y + z * z);
+
+		qw[i] = w * invNorm;
+		qx[i] = x * invNorm;
+		qy[i] = y * invNorm;
+		qz[i] = z * invNorm;
+	}
+}
+
+
+/**
+ * \brief Get the quaternion of a rotation-vector (axis times angle). Small angles use a Taylor-expansion,
+ *        so there is no division by the angle.
+ *
+ * \param rotation
+ *      Rotation-vector.
+ *
+ * \return Unit quaternion of the rotation.
+ */
+Eigen::Quaterniond BodyState::getRotation(const Eigen::Vector3d &rotation) {
+	double s, c;
+	getExponentialMap(rotation.squaredNorm(), s, c);
+
+	return Eigen::Quaterniond(c, s * rotation(0), s * rotation(1), s * rotation(2));
+}
+
+
+/**
+ * \brief Get the index of a body in the arrays.
+ *
+ * \param objectId
+ *      Id of the space-object.
+ *
+ * \return Index of the body or -1 if it is unknown.
+ */
+int BodyState::getIndex(long objectId) const {
+	std::map<long, unsigned int>::const_iterator it = _indexById.find(objectId);
+
+	return it != _indexById.end() ? static_cast<int>(it->second) : -1;
+}
+
+
+/**
+ * \brief Copy the state of a space-object to the given index.
+ *
+ * \param i
+ *      Index of the body.
+ * \param spaceObject
+ *      Space-object which is copied.
+ */
+void BodyState::copyFrom(unsigned int i, const SpaceObject* spaceObject) {
+	setPosition(i, spaceObject->getPosition());
+	setLinearVelocity(i, spaceObject->getLinearVelocity());
+	setAngularVelocity(i, spaceObject->getAngularVelocity());
+
+	osg::Quat q = spaceObject->getOrientation();
+	qx[i] = q.x();
+	qy[i] = q.y();
+	qz[i] = q.z();
+	qw[i] = q.w();
+
+	m[i] = spaceObject->getMass();
+	id[i] = spaceObject->getId();
+	sleeping[i] = spaceObject->isSleeping();
+	testParticle[i] = spaceObject->isTestParticle();
+	visualSpin[i] = spaceObject->isVisualSpin();
+}
+
+
+/**
+ * \brief Write the state of a body to its space-object (skipped if it was already sleeping).
+ *
+ * \param i
+ *      Index of the body.
+ * \param spaceObject
+ *      Space-object of the body.
+ */
+void BodyState::copyTo(unsigned int i, SpaceObject* spaceObject) const {
+	// a body which was already sleeping has not changed (its AABB and convex-hull stay valid)
+	if (sleeping[i] && spaceObject->isSleeping()) return;
+
+	spaceObject->setSleeping(sleeping[i] != 0);
+	spaceObject->setLinearVelocity(getLinearVelocity(i));
+	spaceObject->setAngularVelocity(getAngularVelocity(i));
+	spaceObject->setPositionOrientation(getPosition(i), osg::Quat(qx[i], qy[i], qz[i], qw[i]));
+}
@@ -0,0 +1,412 @@
+﻿/**
+ * \brief Implementation of the structure-of-arrays state of all simulated bodies.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <vector>
+#include <map>
+
+#include "NumaPolicy.h"
+
+// Forward declarations
+namespace pbs17 {
+	class SpaceObject;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Contiguous state (structure of arrays) of all bodies which is owned by the simulation.
+	 *        The hot loops read and write these arrays directly, the space-objects (and with them the
+	 *        OSG-transformations) are only synchronized once per step.
+	 */
+	class BodyState {
+	public:
+		//! Array with one value per body (its pages are placed on the nodes of the threads which work on its parts)
+		template <typename T>
+		using Array = std::vector<T, NumaAllocator<T> >;
+
+		/**
+		 * \brief Constructor of the body-state.
+		 */
+		BodyState();
+
+
+		/**
+		 * \brief Copy the state of all space-objects into the arrays (resizes the arrays).
+		 *
+		 * \param spaceObjects
+		 *      All space-objects in the scene.
+		 */
+		void gather(const std::vector<SpaceObject*> &spaceObjects);
+
+
+		/**
+		 * \brief Copy the state of a single space-object into the arrays, e.g. after it was changed
+		 *        by the collision-response or by the player.
+		 *
+		 * \param spaceObject
+		 *      Space-object which has been gathered before.
+		 */
+		void gather(const SpaceObject* spaceObject);
+
+
+		/**
+		 * \brief Reserve the arrays for a number of bodies, so bodies can be added without reallocating them.
+		 *
+		 * \param n
+		 *      Number of bodies.
+		 */
+		void reserve(unsigned int n);
+
+
+		/**
+		 * \brief Append a space-object as last body (e.g. a spawned body, see SimulationManager::spawn()).
+		 *
+		 * \param spaceObject
+		 *      Space-object which is not gathered yet.
+		 *
+		 * \return Index of the new body.
+		 */
+		unsigned int add(const SpaceObject* spaceObject);
+
+
+		/**
+		 * \brief Remove a body by moving the last body to its index, so the arrays stay dense (the order of the
+		 *        scene is lost, see getLoadOrder()).
+		 *
+		 * \param i
+		 *      Index of the removed body.
+		 */
+		void remove(unsigned int i);
+
+
+		/**
+		 * \brief Write the positions, orientations and velocities back to the space-objects (the OSG-nodes
+		 *        are updated separately with SpaceObject::updateTransformation()). Bodies which were already
+		 *        sleeping are skipped.
+		 *
+		 * \param spaceObjects
+		 *      All space-objects in the scene (same order as gathered).
+		 */
+		void scatter(const std::vector<SpaceObject*> &spaceObjects) const;
+
+
+		/**
+		 * \brief Same as scatter(), but only for a range of the bodies (e.g. a chunk of a task-graph).
+		 *
+		 * \param spaceObjects
+		 *      All space-objects in the scene (same order as gathered).
+		 * \param first, last
+		 *      Range of the written bodies (last is excluded).
+		 */
+		void scatter(const std::vector<SpaceObject*> &spaceObjects, int first, int last) const;
+
+
+		/**
+		 * \brief Reorder the bodies (e.g. along a Morton-curve, see sortMorton()). The ids and with them the
+		 *        space-objects stay valid, only their indices change.
+		 *
+		 * \param order
+		 *      Old index of the body at each new index (a permutation of all bodies).
+		 */
+		void permute(const std::vector<int> &order);
+
+
+		/**
+		 * \brief Check if the bodies have been reordered since they were gathered.
+		 *
+		 * \return True if the indices differ from the order of the space-objects of the scene (see getLoadOrder()).
+		 */
+		bool isReordered() const {
+			return !_loadOrder.empty();
+		}
+
+
+		/**
+		 * \brief Get the current index of each body in the order in which they were gathered (only valid if
+		 *        the bodies are reordered).
+		 *
+		 * \return Index per position in the scene.
+		 */
+		const std::vector<int>& getLoadOrder() const {
+			return _loadOrder;
+		}
+
+
+		/**
+		 * \brief Sort the bodies along a Morton-curve (Z-curve with 21 bits per axis within their bounding-box),
+		 *        so consecutive bodies are close to each other.
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param order
+		 *      Output-parameter: Indices of the bodies in the order of the curve (overwritten).
+		 */
+		static void sortMorton(const double* x, const double* y, const double* z, int n, std::vector<int> &order);
+
+
+		/**
+		 * \brief Rotate the bodies with their angular velocities over a timestep (exponential map of w * dt directly
+		 *        on the quaternion-arrays). The orientations are renormalized, so the rounding does not accumulate.
+		 *        The bodies with a visual spin are skipped (the shader rotates them).
+		 *
+		 * \param indices
+		 *      Indices of the rotated bodies (nullptr for the bodies 0 to cnt - 1).
+		 * \param cnt
+		 *      Number of rotated bodies.
+		 * \param dt
+		 *      Timestep.
+		 */
+		void rotate(const int* indices, int cnt, double dt);
+
+
+		/**
+		 * \brief Get the quaternion of a rotation-vector (axis times angle). Small angles use a Taylor-expansion,
+		 *        so there is no division by the angle.
+		 *
+		 * \param rotation
+		 *      Rotation-vector.
+		 *
+		 * \return Unit quaternion of the rotation.
+		 */
+		static Eigen::Quaterniond getRotation(const Eigen::Vector3d &rotation);
+
+
+		//! Angle below which the exponential map uses the Taylor-expansion of sin and cos
+		static const double SMALL_ANGLE;
+
+
+		/**
+		 * \brief Reorder an array which has one value per body in the same way as permute().
+		 *
+		 * \param values
+		 *      Values per body (unchanged if the size does not match).
+		 * \param order
+		 *      Old index of the body at each new index.
+		 */
+		template<typename Values>
+		static void permuteArray(Values &values, const std::vector<int> &order) {
+			if (values.size() != order.size()) {
+				return;
+			}
+
+			Values permuted(values.size());
+			for (unsigned int k = 0; k < order.size(); ++k) {
+				permuted[k] = values[order[k]];
+			}
+			values.swap(permuted);
+		}
+
+
+		/**
+		 * \brief Remove a value per body in the same way as remove().
+		 *
+		 * \param values
+		 *      Values per body (unchanged if the index is out of range).
+		 * \param i
+		 *      Index of the removed body.
+		 */
+		template<typename Values>
+		static void removeFromArray(Values &values, unsigned int i) {
+			if (i >= values.size()) {
+				return;
+			}
+
+			values[i] = values.back();
+			values.pop_back();
+		}
+
+
+		/**
+		 * \brief Get the number of bodies.
+		 *
+		 * \return Number of bodies.
+		 */
+		unsigned int size() const {
+			return static_cast<unsigned int>(m.size());
+		}
+
+
+		/**
+		 * \brief Get the index of a body in the arrays.
+		 *
+		 * \param objectId
+		 *      Id of the space-object.
+		 *
+		 * \return Index of the body or -1 if it is unknown.
+		 */
+		int getIndex(long objectId) const;
+
+
+		/**
+		 * \brief Get the position of a body.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 *
+		 * \return Position of the body.
+		 */
+		Eigen::Vector3d getPosition(unsigned int i) const {
+			return Eigen::Vector3d(x[i], y[i], z[i]);
+		}
+
+
+		/**
+		 * \brief Set the position of a body.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 * \param p
+		 *      New position of the body.
+		 */
+		void setPosition(unsigned int i, const Eigen::Vector3d &p) {
+			x[i] = p(0);
+			y[i] = p(1);
+			z[i] = p(2);
+		}
+
+
+		/**
+		 * \brief Get the linear velocity of a body.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 *
+		 * \return Linear velocity of the body.
+		 */
+		Eigen::Vector3d getLinearVelocity(unsigned int i) const {
+			return Eigen::Vector3d(vx[i], vy[i], vz[i]);
+		}
+
+
+		/**
+		 * \brief Set the linear velocity of a body.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 * \param v
+		 *      New linear velocity of the body.
+		 */
+		void setLinearVelocity(unsigned int i, const Eigen::Vector3d &v) {
+			vx[i] = v(0);
+			vy[i] = v(1);
+			vz[i] = v(2);
+		}
+
+
+		/**
+		 * \brief Get the angular velocity of a body.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 *
+		 * \return Angular velocity of the body.
+		 */
+		Eigen::Vector3d getAngularVelocity(unsigned int i) const {
+			return Eigen::Vector3d(wx[i], wy[i], wz[i]);
+		}
+
+
+		/**
+		 * \brief Set the angular velocity of a body.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 * \param w
+		 *      New angular velocity of the body.
+		 */
+		void setAngularVelocity(unsigned int i, const Eigen::Vector3d &w) {
+			wx[i] = w(0);
+			wy[i] = w(1);
+			wz[i] = w(2);
+		}
+
+
+		/**
+		 * \brief Get the orientation of a body.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 *
+		 * \return Orientation of the body.
+		 */
+		Eigen::Quaterniond getOrientation(unsigned int i) const {
+			return Eigen::Quaterniond(qw[i], qx[i], qy[i], qz[i]);
+		}
+
+
+		/**
+		 * \brief Set the orientation of a body.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 * \param q
+		 *      New orientation of the body.
+		 */
+		void setOrientation(unsigned int i, const Eigen::Quaterniond &q) {
+			qx[i] = q.x();
+			qy[i] = q.y();
+			qz[i] = q.z();
+			qw[i] = q.w();
+		}
+
+
+		//! Positions
+		Array<double> x, y, z;
+		//! Linear velocities
+		Array<double> vx, vy, vz;
+		//! Angular velocities
+		Array<double> wx, wy, wz;
+		//! Orientations (quaternion)
+		Array<double> qx, qy, qz, qw;
+		//! Masses
+		Array<double> m;
+		//! Ids of the space-objects
+		Array<long> id;
+		//! Flag per body if it is sleeping (not integrated, its space-object is not updated)
+		Array<char> sleeping;
+		//! Flag per body if it is a test-particle (does not attract the massive sources)
+		Array<char> testParticle;
+		//! Flag per body if its rotation is only visual (the orientation is not integrated, see SpaceObject::isVisualSpin())
+		Array<char> visualSpin;
+
+	private:
+		//! Index in the arrays per id of the space-objects
+		std::map<long, unsigned int> _indexById;
+		//! Position in the scene per index (only filled if the bodies are reordered)
+		std::vector<int> _loadPosition;
+		//! Index per position in the scene (inverse of _loadPosition)
+		std::vector<int> _loadOrder;
+
+
+		/**
+		 * \brief Copy the state of a space-object to the given index.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 * \param spaceObject
+		 *      Space-object which is copied.
+		 */
+		void copyFrom(unsigned int i, const SpaceObject* spaceObject);
+
+
+		/**
+		 * \brief Write the state of a body to its space-object (skipped if it was already sleeping).
+		 *
+		 * \param i
+		 *      Index of the body.
+		 * \param spaceObject
+		 *      Space-object of the body.
+		 */
+		void copyTo(unsigned int i, SpaceObject* spaceObject) const;
+	};
+}
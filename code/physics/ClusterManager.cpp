@@ -0,0 +1,335 @@
+﻿/**
+ * \brief Implementation of the rigid clusters of the objects which rest on each other.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "ClusterManager.h"
+
+#include <algorithm>
+#include <Eigen/SVD>
+#include <Eigen/LU>
+
+#include "Profiler.h"
+#include "../scene/SpaceObject.h"
+#include "../scene/SpaceShip.h"
+
+using namespace pbs17;
+
+//! Steps a contact has to be slow before its objects are fused
+const int ClusterManager::CLUSTER_STEPS = 30;
+
+
+namespace {
+
+	/**
+	 * \brief Get the orientation of an object as a rotation-matrix.
+	 *
+	 * \param object
+	 *      Object of a cluster.
+	 *
+	 * \return Rotation from the local to the global coordinate system.
+	 */
+	Eigen::Matrix3d getRotation(const SpaceObject* object) {
+		const osg::Quat &q = object->getOrientation();
+		return Eigen::Quaterniond(q.w(), q.x(), q.y(), q.z()).toRotationMatrix();
+	}
+}
+
+
+/**
+ * \brief Update the clusters with the contacts of the last step and move their members rigidly.
+ *
+ * \param contacts
+ *      Solved contacts of the last step (see Collision::getImpulse()).
+ * \param moved
+ *      Output-parameter: The members whose state was changed are appended.
+ */
+void ClusterManager::update(const std::vector<Collision> &contacts, std::vector<SpaceObject*> &moved) {
+	// the resting clusters are left to the sleeping, the members keep their state
+	std::vector<long> released;
+	for (std::map<long, Cluster>::const_iterator it = _clusters.begin(); it != _clusters.end(); ++it) {
+		for (unsigned int i = 0; i < it->second.members.size(); ++i) {
+			const SpaceObject* object = it->second.members[i].object;
+			if (!object->isActive() || object->isSleeping()) {
+				released.push_back(it->first);
+				break;
+			}
+		}
+	}
+
+	// the hard external hits break the clusters apart (the contacts within a cluster are filtered)
+	for (unsigned int i = 0; i < contacts.size(); ++i) {
+		SpaceObject* objects[2] = { contacts[i].getFirstObject(), contacts[i].getSecondObject() };
+
+		for (int k = 0; k < 2; ++k) {
+			long id = objects[k]->getClusterId();
+			if (id < 0 || id == objects[1 - k]->getClusterId()) continue;
+
+			std::map<long, Cluster>::const_iterator it = _clusters.find(id);
+			if (it != _clusters.end() && contacts[i].getImpulse() >= _splitVelocity * it->second.mass) {
+				released.push_back(id);
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < released.size(); ++i) {
+		if (_clusters.count(released[i])) {
+			split(released[i]);
+			++_cntSplits;
+		}
+	}
+
+	// the objects whose contact stayed slow are fused, the counts of the pairs without a contact are dropped
+	std::map<std::pair<long, long>, int> restingSteps;
+	for (unsigned int i = 0; i < contacts.size(); ++i) {
+		SpaceObject* a = contacts[i].getFirstObject();
+		SpaceObject* b = contacts[i].getSecondObject();
+		if (!canJoin(a) || !canJoin(b)) continue;
+		if ((a->getLinearVelocity() - b->getLinearVelocity()).squaredNorm() > _restingVelocity * _restingVelocity) continue;
+
+		std::pair<long, long> pair = std::make_pair(std::min(a->getId(), b->getId()), std::max(a->getId(), b->getId()));
+		// the pair can be in contact in several substeps
+		if (restingSteps.count(pair)) continue;
+
+		std::map<std::pair<long, long>, int>::const_iterator it = _restingSteps.find(pair);
+		int steps = (it == _restingSteps.end() ? 0 : it->second) + 1;
+		restingSteps[pair] = steps;
+
+		if (steps >= CLUSTER_STEPS) {
+			join(a, b);
+		}
+	}
+	_restingSteps.swap(restingSteps);
+
+	// the clusters are independent, each one only writes its own members
+	std::vector<Cluster*> clusters;
+	clusters.reserve(_clusters.size());
+	for (std::map<long, Cluster>::iterator it = _clusters.begin(); it != _clusters.end(); ++it) {
+		clusters.push_back(&it->second);
+	}
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 4)
+#endif
+	for (int c = 0; c < static_cast<int>(clusters.size()); ++c) {
+		if (clusters[c]->isChanged) {
+			rebuild(*clusters[c]);
+		}
+		project(*clusters[c]);
+	}
+
+	unsigned int cntMembers = 0;
+	for (unsigned int c = 0; c < clusters.size(); ++c) {
+		for (unsigned int i = 0; i < clusters[c]->members.size(); ++i) {
+			moved.push_back(clusters[c]->members[i].object);
+		}
+		cntMembers += clusters[c]->members.size();
+	}
+
+	Profiler::Instance()->count(Profiler::CLUSTERED_BODIES, cntMembers);
+}
+
+
+/**
+ * \brief Release an object from its cluster, the other members are released too (e.g. it's despawned).
+ *
+ * \param object
+ *      Object which leaves the simulation.
+ */
+void ClusterManager::remove(SpaceObject* object) {
+	long id = object->getClusterId();
+	if (id >= 0 && _clusters.count(id)) {
+		split(id);
+	}
+
+	object->setClusterId(-1);
+}
+
+
+/**
+ * \brief Release all objects and forget the resting contacts (e.g. after restoring a checkpoint).
+ */
+void ClusterManager::clear() {
+	while (!_clusters.empty()) {
+		split(_clusters.begin()->first);
+	}
+
+	_restingSteps.clear();
+}
+
+
+/**
+ * \brief Check if an object can be fused into a cluster.
+ *
+ * \param object
+ *      Object of a contact.
+ *
+ * \return True if it's active, awake, has a mass and its rotation is simulated (not the player).
+ */
+bool ClusterManager::canJoin(const SpaceObject* object) {
+	if (!object->isActive() || object->isSleeping() || object->getMass() <= 0.0) return false;
+	if (object->isTestParticle() || object->isVisualSpin()) return false;
+
+	// the player is controlled from outside of the simulation
+	return dynamic_cast<const SpaceShip*>(object) == nullptr;
+}
+
+
+/**
+ * \brief Fuse two objects into the same cluster (a new one, the one of either object or both clusters).
+ *
+ * \param a, b
+ *      Objects of a resting contact.
+ */
+void ClusterManager::join(SpaceObject* a, SpaceObject* b) {
+	long ia = a->getClusterId();
+	long ib = b->getClusterId();
+	if (ia >= 0 && ia == ib) return;
+
+	// the smaller cluster (or the single object) is moved into the larger one
+	if (ia < 0 || (ib >= 0 && _clusters[ib].members.size() > _clusters[ia].members.size())) {
+		std::swap(a, b);
+		std::swap(ia, ib);
+	}
+	if (ia < 0) {
+		ia = _nextId++;
+	}
+
+	Cluster &cluster = _clusters[ia];
+	if (cluster.members.empty()) {
+		Member member = { a, Eigen::Vector3d::Zero(), Eigen::Matrix3d::Identity() };
+		cluster.members.push_back(member);
+		cluster.mass = a->getMass();
+		a->setClusterId(ia);
+	}
+
+	if (ib >= 0) {
+		Cluster &other = _clusters[ib];
+		for (unsigned int i = 0; i < other.members.size(); ++i) {
+			other.members[i].object->setClusterId(ia);
+		}
+		cluster.members.insert(cluster.members.end(), other.members.begin(), other.members.end());
+		cluster.mass += other.mass;
+		_clusters.erase(ib);
+	} else {
+		Member member = { b, Eigen::Vector3d::Zero(), Eigen::Matrix3d::Identity() };
+		cluster.members.push_back(member);
+		cluster.mass += b->getMass();
+		b->setClusterId(ia);
+	}
+
+	cluster.isChanged = true;
+}
+
+
+/**
+ * \brief Release all members of a cluster, they keep their last velocities.
+ *
+ * \param id
+ *      Id of the cluster.
+ */
+void ClusterManager::split(long id) {
+	std::map<long, Cluster>::iterator it = _clusters.find(id);
+	if (it == _clusters.end()) return;
+
+	for (unsigned int i = 0; i < it->second.members.size(); ++i) {
+		it->second.members[i].object->setClusterId(-1);
+	}
+
+	_clusters.erase(it);
+}
+
+
+/**
+ * \brief Set the frame of a cluster to the current state of its members (the frame is aligned with the world).
+ *
+ * \param cluster
+ *      Cluster with new members.
+ */
+void ClusterManager::rebuild(Cluster &cluster) {
+	Eigen::Vector3d center = Eigen::Vector3d::Zero();
+	cluster.mass = 0.0;
+	for (unsigned int i = 0; i < cluster.members.size(); ++i) {
+		const SpaceObject* object = cluster.members[i].object;
+		center += object->getMass() * object->getPosition();
+		cluster.mass += object->getMass();
+	}
+	center /= cluster.mass;
+
+	for (unsigned int i = 0; i < cluster.members.size(); ++i) {
+		Member &member = cluster.members[i];
+		member.offset = member.object->getPosition() - center;
+		member.rotation = getRotation(member.object);
+	}
+
+	cluster.isChanged = false;
+}
+
+
+/**
+ * \brief Move the members of a cluster rigidly with their combined momentum and angular momentum.
+ *
+ * \param cluster
+ *      Cluster whose members were integrated separately.
+ */
+void ClusterManager::project(Cluster &cluster) {
+	Eigen::Vector3d center = Eigen::Vector3d::Zero();
+	Eigen::Vector3d velocity = Eigen::Vector3d::Zero();
+	for (unsigned int i = 0; i < cluster.members.size(); ++i) {
+		const SpaceObject* object = cluster.members[i].object;
+		center += object->getMass() * object->getPosition();
+		velocity += object->getMass() * object->getLinearVelocity();
+	}
+	center /= cluster.mass;
+	velocity /= cluster.mass;
+
+	// best-fitting rotation of the frame (polar decomposition): the offsets of the members and their own rotations
+	// (weighted by their inertia), so also a pair of members keeps its orientation around the axis between them
+	Eigen::Matrix3d moments = Eigen::Matrix3d::Zero();
+	Eigen::Vector3d angularMomentum = Eigen::Vector3d::Zero();
+	for (unsigned int i = 0; i < cluster.members.size(); ++i) {
+		const Member &member = cluster.members[i];
+		const SpaceObject* object = member.object;
+		Eigen::Matrix3d rotation = getRotation(object);
+		Eigen::Vector3d r = object->getPosition() - center;
+
+		moments += object->getMass() * r * member.offset.transpose()
+			+ object->getMomentOfInertia().trace() * rotation * member.rotation.transpose();
+
+		// spin of the members and their orbit around the common center of mass
+		angularMomentum += rotation * object->getMomentOfInertia() * rotation.transpose() * object->getAngularVelocity()
+			+ object->getMass() * r.cross(object->getLinearVelocity() - velocity);
+	}
+
+	Eigen::JacobiSVD<Eigen::Matrix3d> svd(moments, Eigen::ComputeFullU | Eigen::ComputeFullV);
+	Eigen::Matrix3d u = svd.matrixU();
+	if ((u * svd.matrixV().transpose()).determinant() < 0.0) {
+		u.col(2) = -u.col(2);
+	}
+	Eigen::Matrix3d frame = u * svd.matrixV().transpose();
+
+	// inertia of the rigid shape around the center of mass
+	Eigen::Matrix3d inertia = Eigen::Matrix3d::Zero();
+	for (unsigned int i = 0; i < cluster.members.size(); ++i) {
+		const Member &member = cluster.members[i];
+		Eigen::Matrix3d rotation = frame * member.rotation;
+		Eigen::Vector3d r = frame * member.offset;
+
+		inertia += rotation * member.object->getMomentOfInertia() * rotation.transpose()
+			+ member.object->getMass() * (r.squaredNorm() * Eigen::Matrix3d::Identity() - r * r.transpose());
+	}
+	Eigen::Vector3d angularVelocity = inertia.inverse() * angularMomentum;
+
+	for (unsigned int i = 0; i < cluster.members.size(); ++i) {
+		const Member &member = cluster.members[i];
+		SpaceObject* object = member.object;
+		Eigen::Vector3d r = frame * member.offset;
+		Eigen::Quaterniond q(frame * member.rotation);
+
+		object->setPositionOrientation(center + r, osg::Quat(q.x(), q.y(), q.z(), q.w()));
+		object->setLinearVelocity(velocity + angularVelocity.cross(r));
+		object->setAngularVelocity(angularVelocity);
+	}
+}
@@ -0,0 +1,198 @@
+﻿/**
+ * \brief Implementation of the rigid clusters of the objects which rest on each other.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "Collision.h"
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief The manager which fuses the clumps of debris that stay in contact into rigid clusters. Two objects
+	 * join a cluster once their contact has been slow for CLUSTER_STEPS steps. The members of a cluster don't
+	 * collide with each other anymore (see SpaceObject::canCollide()), so their pairs skip GJK/EPA and the solver.
+	 * Their hulls stay the parts of the cluster for the contacts with all other objects.
+	 *
+	 * After each step, the members are moved as one rigid body: the combined momentum and angular momentum of the
+	 * members (with the gravity and the external contacts of the step) are conserved, the shape of the cluster is
+	 * kept (the best-fitting rotation of the members). A cluster is split again if an external impulse would change
+	 * its velocity by more than the split-velocity, if a member falls asleep or leaves the simulation.
+	 */
+	class ClusterManager {
+	public:
+		/**
+		 * \brief Update the clusters with the contacts of the last step and move their members rigidly.
+		 *
+		 * \param contacts
+		 *      Solved contacts of the last step (see Collision::getImpulse()).
+		 * \param moved
+		 *      Output-parameter: The members whose state was changed are appended.
+		 */
+		void update(const std::vector<Collision> &contacts, std::vector<SpaceObject*> &moved);
+
+
+		/**
+		 * \brief Release an object from its cluster, the other members are released too (e.g. it's despawned).
+		 *
+		 * \param object
+		 *      Object which leaves the simulation.
+		 */
+		void remove(SpaceObject* object);
+
+
+		/**
+		 * \brief Release all objects and forget the resting contacts (e.g. after restoring a checkpoint).
+		 */
+		void clear();
+
+
+		/**
+		 * \brief Set the relative velocity below which a contact counts as resting.
+		 *
+		 * \param velocity
+		 *      Relative velocity of the centers: unit = m/s
+		 */
+		void setRestingVelocity(const double velocity) {
+			_restingVelocity = velocity;
+		}
+
+
+		/**
+		 * \brief Set the velocity-change by an external impulse above which a cluster is split.
+		 *
+		 * \param velocity
+		 *      Impulse divided by the mass of the cluster: unit = m/s
+		 */
+		void setSplitVelocity(const double velocity) {
+			_splitVelocity = velocity;
+		}
+
+
+		/**
+		 * \brief Get the number of clusters.
+		 *
+		 * \return Current number of clusters.
+		 */
+		unsigned int getNumClusters() const {
+			return static_cast<unsigned int>(_clusters.size());
+		}
+
+
+		/**
+		 * \brief Get the number of splits.
+		 *
+		 * \return Split clusters since the start.
+		 */
+		unsigned int getNumSplits() const {
+			return _cntSplits;
+		}
+
+
+	private:
+		/**
+		 * \brief Object of a cluster with its place in the frame of the cluster.
+		 */
+		struct Member {
+			//! Fused object
+			SpaceObject* object;
+			//! Position relative to the center of mass in the frame of the cluster
+			Eigen::Vector3d offset;
+			//! Rotation relative to the frame of the cluster
+			Eigen::Matrix3d rotation;
+		};
+
+		/**
+		 * \brief Objects which are moved as one rigid body.
+		 */
+		struct Cluster {
+			//! Objects of the cluster
+			std::vector<Member> members;
+			//! Total mass of the members
+			double mass = 0.0;
+			//! True if the frame has to be rebuilt (new members)
+			bool isChanged = true;
+		};
+
+
+		//! Steps a contact has to be slow before its objects are fused
+		static const int CLUSTER_STEPS;
+
+		//! Clusters by their ids
+		std::map<long, Cluster> _clusters;
+		//! Id of the next cluster
+		long _nextId = 0;
+		//! Consecutive slow steps per pair of objects in contact (ids of the objects, smaller first)
+		std::map<std::pair<long, long>, int> _restingSteps;
+		//! Relative velocity below which a contact counts as resting
+		double _restingVelocity = 0.1;
+		//! Velocity-change by an external impulse above which a cluster is split
+		double _splitVelocity = 0.5;
+		//! Number of split clusters
+		unsigned int _cntSplits = 0;
+
+
+		/**
+		 * \brief Check if an object can be fused into a cluster.
+		 *
+		 * \param object
+		 *      Object of a contact.
+		 *
+		 * \return True if it's active, awake, has a mass and its rotation is simulated (not the player).
+		 */
+		static bool canJoin(const SpaceObject* object);
+
+
+		/**
+		 * \brief Fuse two objects into the same cluster (a new one, the one of either object or both clusters).
+		 *
+		 * \param a, b
+		 *      Objects of a resting contact.
+		 */
+		void join(SpaceObject* a, SpaceObject* b);
+
+
+		/**
+		 * \brief Release all members of a cluster, they keep their last velocities.
+		 *
+		 * \param id
+		 *      Id of the cluster.
+		 */
+		void split(long id);
+
+
+		/**
+		 * \brief Set the frame of a cluster to the current state of its members (the frame is aligned with the world).
+		 *
+		 * \param cluster
+		 *      Cluster with new members.
+		 */
+		static void rebuild(Cluster &cluster);
+
+
+		/**
+		 * \brief Move the members of a cluster rigidly with their combined momentum and angular momentum.
+		 *
+		 * \param cluster
+		 *      Cluster whose members were integrated separately.
+		 */
+		static void project(Cluster &cluster);
+	};
+}
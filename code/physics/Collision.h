@@ -67,6 +67,30 @@ namespace pbs17 {
 			_intersectionVector = iv;
 		}
 
+		double getImpulse() const {
+			return _impulse;
+		}
+
+		void setImpulse(double impulse) {
+			_impulse = impulse;
+		}
+
+		double getRelativeSpeed() const {
+			return _relativeSpeed;
+		}
+
+		void setRelativeSpeed(double relativeSpeed) {
+			_relativeSpeed = relativeSpeed;
+		}
+
+		double getSeparation() const {
+			return _separation;
+		}
+
+		void setSeparation(double separation) {
+			_separation = separation;
+		}
+
 
 	private:
 
@@ -82,6 +106,12 @@ namespace pbs17 {
 		Eigen::Vector3d _secondPOC;
 		//! Represents the displacement vector needed to annul collision
 		Eigen::Vector3d _intersectionVector;
+		//! Accumulated impulse along the normal after the contact-solver (0 => not solved)
+		double _impulse = 0.0;
+		//! Approaching speed along the normal before the contact-solver (> 0 => approaching)
+		double _relativeSpeed = 0.0;
+		//! Distance of the closest points of a separated pair (> 0 => speculative contact, the objects don't touch yet)
+		double _separation = 0.0;
 	};
 
 	struct CollisionCompareLess {
@@ -8,6 +8,8 @@
 #include "CollisionManager.h"
 
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 #include <Eigen/Core>
 // ReSharper disable CppUnusedIncludeDirective
@@ -15,12 +17,50 @@
 #include <Eigen/Dense>
 // ReSharper restore CppUnusedIncludeDirective
 
-#include "../osg/OsgEigenConversions.h"
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 #include "../scene/Planet.h"
 #include "../graphics/GjkAlgorithm.h"
+#include "../graphics/DistanceField.h"
+#include "BodyState.h"
+#include "ContactBatch.h"
+#include "SpatialGrid.h"
+#include "Profiler.h"
+#include "Tracer.h"
+#include "Logger.h"
 
 using namespace pbs17;
 
+//! Exact tests per shape-types of the pair ([o1->getShapeType()][o2->getShapeType()])
+const CollisionManager::NarrowPhaseTest CollisionManager::NARROW_PHASE_TESTS[2][2] = {
+	{ &CollisionManager::testConvexHulls, &CollisionManager::testConvexSphere },
+	{ &CollisionManager::testSphereConvex, &CollisionManager::testSpheres }
+};
+
+//! Objects which move further than this ratio of their smallest extent per step are checked continuously
+const double CollisionManager::CCD_MOTION_RATIO = 0.5;
+
+//! Distance at which the conservative advancement has found the time of impact
+const double CollisionManager::CCD_TOLERANCE = 0.001;
+
+//! Maximum number of advancements per pair
+const int CollisionManager::CCD_MAX_ITERATIONS = 32;
+
+//! The approach is measured between the centers, the closest points may approach up to twice as fast.
+const double CollisionManager::SPECULATIVE_RATIO = 2.0;
+//! Objects below this coarse radius collide with their coarse convex-hull
+double CollisionManager::COARSE_CONTACT_RADIUS = 0.0;
+//! Distance to the surface (relative to the coarse radius) at which a ray has hit a convex-hull
+const double CollisionManager::RAY_TOLERANCE = 1e-4;
+//! Maximum number of advancements of a ray against a convex-hull
+const int CollisionManager::RAY_MAX_ITERATIONS = 32;
+//! Number of the most recent batches which are searched for a free lane of a contact
+const int CollisionManager::MAX_OPEN_BATCHES = 8;
+//! Contacts deeper than this ratio of the smaller coarse radius are sampled in the distance-fields
+const double CollisionManager::DEEP_CONTACT_RATIO = 0.05;
+
 
 void print(std::string name, Eigen::Vector3d &v) {
 	std::cout << name << "= [" << v.x() << " " << v.y() << " " << v.z() << "]; " << std::endl;
@@ -32,125 +72,280 @@ void print(std::string name, Eigen::Matrix3d &m) {
 		<< m(2, 0) << " " << m(2, 1) << " " << m(2, 2) << "];" << std::endl;
 }
 
-CollisionManager::CollisionManager(std::vector<SpaceObject*> spaceObjects) {
-	_xList = std::vector<SpaceObject*>(spaceObjects);
-	_yList = std::vector<SpaceObject*>(spaceObjects);
-	_zList = std::vector<SpaceObject*>(spaceObjects);
+CollisionManager::CollisionManager(std::vector<SpaceObject*> spaceObjects)
+	: _spaceObjects(spaceObjects) {
+	// sort the endpoints
+	_sweepAndPrune.init(spaceObjects);
+}
+
+
+/**
+ * \brief Replace the checked objects (e.g. the bodies and ghosts of a domain), the broad-phase is
+ *        initialized again.
+ *
+ * \param spaceObjects
+ *      Space-objects which are checked for collisions.
+ */
+void CollisionManager::setSpaceObjects(const std::vector<SpaceObject*> &spaceObjects) {
+	_spaceObjects = spaceObjects;
+
+	if (_broadPhase == AABB_TREE) {
+		_aabbTree.init(_spaceObjects);
+	} else if (_broadPhase == SPATIAL_HASH) {
+		_spatialHash.init(_spaceObjects);
+	} else {
+		_sweepAndPrune.init(_spaceObjects);
+	}
+
+	_isQueryTreeDirty = true;
+}
+
+
+/**
+ * \brief Append a checked object (e.g. a spawned body), only the current broad-phase is updated.
+ *
+ * \param spaceObject
+ *      Space-object which is checked from now on (gets the last index).
+ */
+void CollisionManager::addSpaceObject(SpaceObject* spaceObject) {
+	_spaceObjects.push_back(spaceObject);
+
+	if (_broadPhase == AABB_TREE) {
+		_aabbTree.insert(spaceObject);
+	} else if (_broadPhase == SPATIAL_HASH) {
+		_spatialHash.insert(spaceObject);
+	} else {
+		_sweepAndPrune.insert(spaceObject);
+	}
 
-	// sort the lists
-	insertionSort(_xList, 0);
-	insertionSort(_yList, 1);
-	insertionSort(_zList, 2);
+	_isQueryTreeDirty = true;
 }
 
 
-/*
- * \brief Sort the space-objects based on the minimum coordinate on the given axis.
- * For this, the insertion-sort is used, since the relative order should normaly not change a lot.
- * Therefore it is mostly in O(n) to go through the list.
+/**
+ * \brief Remove a checked object, the last object is moved to its index (same as BodyState::remove()).
  *
- * \param A
- *      Output-parameter:
- *			Input:	Vector with all possibly unsorted space-objects.
- *			Output: Vector with all space-objects sorted so that: for each i => i.min[dim] <= i+1.min[dim].
- * \param dim
- *	    Current axis for which the sort-criteria is checked.
+ * \param i
+ *      Index of the removed object.
  */
-void CollisionManager::insertionSort(std::vector<SpaceObject*> &A, int dim) const {
-	for (unsigned int i = 1; i < A.size(); ++i) {
-		SpaceObject* tmp = A[i];
-		int j = i - 1;
+void CollisionManager::removeSpaceObject(unsigned int i) {
+	if (i >= _spaceObjects.size()) {
+		return;
+	}
 
-		while (j >= 0 && A[j]->getAABB()._min[dim] > A[j + 1]->getAABB()._min[dim]) {
-			std::swap(A[j], A[j + 1]);
-			j--;
-		}
+	_spaceObjects[i] = _spaceObjects.back();
+	_spaceObjects.pop_back();
 
-		A[j + 1] = tmp;
+	if (_broadPhase == AABB_TREE) {
+		_aabbTree.remove(i);
+	} else if (_broadPhase == SPATIAL_HASH) {
+		_spatialHash.remove(i);
+	} else {
+		_sweepAndPrune.remove(i);
 	}
+
+	_isQueryTreeDirty = true;
 }
 
 
 /**
+ * \brief Set the method to find the possible collisions.
  *
+ * \param broadPhase
+ *      New broad-phase.
  */
-void CollisionManager::handleCollisions(double dt, std::vector<SpaceObject *> &spaceObjects) {
-	std::vector<std::pair<SpaceObject *, SpaceObject *>> collision;
+void CollisionManager::setBroadPhase(BroadPhase broadPhase) {
+	_broadPhase = broadPhase;
+
+	if (_broadPhase == AABB_TREE) {
+		_aabbTree.init(_spaceObjects);
+	} else if (_broadPhase == SPATIAL_HASH) {
+		_spatialHash.init(_spaceObjects);
+	} else {
+		// without a device, the same sweep runs on the CPU
+		if (_broadPhase == GPU_SAP && !GpuBroadPhase::isAvailable()) {
+			LOG_WARNING("No CUDA-device for the broad-phase (cmake -DPBS17_CUDA=ON), it's swept on the CPU.");
+			_broadPhase = SINGLE_AXIS_SAP;
+		}
 
-	for (unsigned int i = 0; i < spaceObjects.size(); ++i) {
-		spaceObjects[i]->resetCollisionState();
+		SweepAndPrune::Mode mode = SweepAndPrune::INCREMENTAL;
+		if (_broadPhase == SINGLE_AXIS_SAP) {
+			mode = SweepAndPrune::SINGLE_AXIS;
+		} else if (_broadPhase == GPU_SAP) {
+			mode = SweepAndPrune::GPU;
+		}
+		_sweepAndPrune.setMode(mode);
+		// the objects may have been added or removed while another broad-phase was used
+		_sweepAndPrune.init(_spaceObjects);
 	}
 
-	this->broadPhase(collision);
-	this->narrowPhase(collision);
-	this->respondToCollisions();
+	_isQueryTreeDirty = true;
 }
 
 
 /**
- * \brief Find possible collisions based on the bounding-boxes of the objects.
- * The algorithm runs in O(n + #collisions), but the objects need to be sorted based on the min-edge.
+ * \brief Convert the name of a broad-phase (incremental, singleAxis, aabbTree, spatialHash, gpu) to its value.
  *
- * \param A
- *      Vector with all space-objects. Needs to be sorted based on i.min[dim] <= i+1.min[dim].
- * \param dim
- *	    Current axis for which the collisions checked.
- * \param res
- *	    Output-parameter: Vector with possible collisions. The value is a pair with the two objects which possibly colided.
- *	                      By convention, on the first position the object with the smaller id is stored (key.first.Id < key.second.Id)
+ * \param name
+ *      Name of the broad-phase as used in the scene-json and on the command-line.
+ * \param broadPhase
+ *      Parsed broad-phase (unchanged if the name is unknown).
+ *
+ * \return True if the name is known.
  */
-void CollisionManager::pruneAndSweep(std::vector<SpaceObject*> &A, int dim, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) {
-	for (unsigned int i = 0; i < A.size() - 1; ++i) {
-		double aabbMax = A[i]->getAABB()._max[dim];
-
-		for (unsigned int j = i + 1; j < A.size(); ++j) {
-			// If the left edge of the neighbor is smaller than the right edge of the current, a possible collision exists.
-			if (aabbMax >= A[j]->getAABB()._min[dim]) {
-				// always have the object with the smaller id first
-				if (A[i]->getId() < A[j]->getId()) {
-					res.push_back(std::make_pair(A[i], A[j]));
-				} else {
-					res.push_back(std::make_pair(A[j], A[i]));
-				}
-			} else {
-				// Because the list is ordered for the min-edge (left), as soon as the neigbour is greater, we can
-				// stop the search for possible collisions.
-				break;
+bool CollisionManager::parseBroadPhase(const std::string &name, BroadPhase &broadPhase) {
+	if (name == "incremental") {
+		broadPhase = INCREMENTAL_SAP;
+	} else if (name == "singleAxis") {
+		broadPhase = SINGLE_AXIS_SAP;
+	} else if (name == "aabbTree") {
+		broadPhase = AABB_TREE;
+	} else if (name == "spatialHash") {
+		broadPhase = SPATIAL_HASH;
+	} else if (name == "gpu") {
+		broadPhase = GPU_SAP;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Find and respond to the collisions of the last step. Objects which are flagged as continuous, or which
+ * moved further than CCD_MOTION_RATIO of their smallest extent, are swept over their displacement of the step.
+ *
+ * \param dt
+ *      Time difference since between the last frames.
+ * \param spaceObjects
+ *      All space-objects in the scene.
+ * \param bodies
+ *      State of all bodies, which is updated for the colliding objects.
+ */
+void CollisionManager::handleCollisions(double dt, std::vector<SpaceObject *> &spaceObjects, BodyState &bodies, bool isPrepared) {
+	std::vector<std::pair<SpaceObject *, SpaceObject *>> &collision = _broadPhasePairs;
+	int cntObjects = spaceObjects.size();
+	collision.clear();
+
+	// the contacts of the last step are kept until the next one (e.g. for the recorder)
+	_contacts.clear();
+	_speculativeContacts.clear();
+	_isQueryTreeDirty = true;
+
+	if (!_isEnabled) {
+		_minApproachTime = std::numeric_limits<double>::infinity();
+		return;
+	}
+
+	{
+		// the sweeps extend the AABBs of the broad-phase
+		Profiler::ScopedTimer timer(Profiler::BROAD_PHASE);
+
+		if (!isPrepared) {
+			int cntChunks = (cntObjects + 63) / 64;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+			for (int c = 0; c < cntChunks; ++c) {
+				prepareObjects(dt, spaceObjects, 64 * c, std::min(64 * (c + 1), cntObjects));
 			}
 		}
+
+		this->broadPhase(collision);
+	}
+
+	Profiler* profiler = Profiler::Instance();
+	profiler->count(Profiler::BROAD_PHASE_PAIRS, collision.size());
+
+	// the overlaps per axis only exist for the endpoints of the sweep-and-prune
+	if (_broadPhase != AABB_TREE && _broadPhase != SPATIAL_HASH) {
+		for (int axis = 0; axis < 3; ++axis) {
+			profiler->count(static_cast<Profiler::Counter>(Profiler::OVERLAPS_X + axis), _sweepAndPrune.getNumOverlaps(axis));
+		}
+	}
+
+	{
+		Profiler::ScopedTimer timer(Profiler::NARROW_PHASE);
+		this->narrowPhase(dt, collision);
+	}
+	profiler->count(Profiler::COLLIDING_PAIRS, _contacts.size());
+
+	{
+		Profiler::ScopedTimer timer(Profiler::RESPONSE);
+		this->respondToCollisions(dt, bodies);
 	}
 }
 
-void CollisionManager::broadPhase(std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) {
-	// Resort the list
-	insertionSort(_xList, 0);
-	insertionSort(_yList, 1);
-	insertionSort(_zList, 2);
 
-	// Vectors which contains the possible collisions per axis
-	std::vector<std::pair<SpaceObject *, SpaceObject *>> resX;
-	std::vector<std::pair<SpaceObject *, SpaceObject *>> resY;
-	std::vector<std::pair<SpaceObject *, SpaceObject *>> resZ;
+/**
+ * \brief Prepare a range of the objects for the broad-phase: reset their collision-state and set the sweep
+ *        of the objects which are checked continuously. Only needs the AABBs of these objects after the step.
+ *
+ * \param dt
+ *      Time difference since between the last frames.
+ * \param spaceObjects
+ *      All space-objects in the scene.
+ * \param first, last
+ *      Range of the prepared objects (last is excluded).
+ */
+void CollisionManager::prepareObjects(double dt, const std::vector<SpaceObject*> &spaceObjects, int first, int last) const {
+	last = std::min(last, static_cast<int>(spaceObjects.size()));
+
+	for (int i = first; i < last; ++i) {
+		SpaceObject* object = spaceObjects[i];
+
+		// the pairs of two sleeping objects are not checked again, so they keep their state
+		if (!object->isSleeping()) {
+			object->resetCollisionState();
+		}
+
+		const osg::BoundingBox &aabb = object->getAABB();
+		double minExtent = std::min(aabb.xMax() - aabb.xMin(), std::min(aabb.yMax() - aabb.yMin(), aabb.zMax() - aabb.zMin()));
+		Eigen::Vector3d displacement = dt * object->getLinearVelocity();
+
+		bool isContinuous = object->isContinuous() || displacement.norm() > CCD_MOTION_RATIO * minExtent;
+		object->setSweep(isContinuous ? displacement : Eigen::Vector3d::Zero());
+	}
+}
 
-	pruneAndSweep(_xList, 0, resX);
-	pruneAndSweep(_yList, 1, resY);
-	pruneAndSweep(_zList, 2, resZ);
 
-	std::sort(resX.begin(), resX.end());
-	std::sort(resY.begin(), resY.end());
-	std::sort(resZ.begin(), resZ.end());
-	//std::cout << "Collisions: " << resX.size()
-	//	<< ", " << resY.size()
-	//	<< ", " << resZ.size() << std::endl;
+/**
+ * \brief Find possible collisions based on the bounding-boxes of the objects.
+ * The swept AABBs are copied once into a flat array, then depending on the broad-phase, the persistent endpoints are
+ * resorted, the AABB-tree is refitted or the objects are binned into the hashed cells. Pairs of two sleeping objects
+ * are skipped (they have not moved).
+ *
+ * \param res
+ *	    Output-parameter: Vector with possible collisions. The value is a pair with the two objects which possibly colided.
+ *	                      By convention, on the first position the object with the smaller id is stored (key.first.Id < key.second.Id)
+ */
+void CollisionManager::broadPhase(std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) {
+	_aabbs.update(_spaceObjects);
 
-	std::vector<std::pair<SpaceObject *, SpaceObject *>> resXY;
+	if (_broadPhase == AABB_TREE) {
+		_aabbTree.update(_aabbs, res);
+	} else if (_broadPhase == SPATIAL_HASH) {
+		if (_sharedGrid != nullptr) {
+			_spatialHash.update(*_sharedGrid, _aabbs, res);
+		} else {
+			_spatialHash.update(_aabbs, res);
+		}
+	} else {
+		_sweepAndPrune.update(_aabbs, res);
+	}
 
-	// get only the instersections
-	std::set_intersection(resX.begin(), resX.end(), resY.begin(), resY.end(),
-		std::back_inserter(resXY));
+	res.erase(std::remove_if(res.begin(), res.end(), [](const std::pair<SpaceObject *, SpaceObject *> &pair) {
+		return pair.first->isSleeping() && pair.second->isSleeping();
+	}), res.end());
 
-	std::set_intersection(resXY.begin(), resXY.end(), resZ.begin(), resZ.end(),
-		std::back_inserter(res));
+	// the parallel broad-phases concatenate the pairs per thread
+	if (_isDeterministic) {
+		std::stable_sort(res.begin(), res.end(), [](const std::pair<SpaceObject *, SpaceObject *> &a, const std::pair<SpaceObject *, SpaceObject *> &b) {
+			return a.first->getId() < b.first->getId() || (a.first->getId() == b.first->getId() && a.second->getId() < b.second->getId());
+		});
+	}
 }
 
 bool CollisionManager::checkIntersection(Planet *p1, Planet *p2) {
@@ -185,279 +380,2016 @@ void CollisionManager::response(Planet *p1, Planet *p2) {
 	p2->setLinearVelocity(v1x * (2. * m1) / (m1 + m2) + v2x * (m2 - m1) / (m1 + m2) + v2y);
 }
 
-void CollisionManager::narrowPhase(std::vector<std::pair<SpaceObject *, SpaceObject *>> &collisions) {
-	for (unsigned int i = 0; i < collisions.size(); ++i) {
-		SpaceObject* o1 = collisions[i].first;
-		SpaceObject* o2 = collisions[i].second;
+/**
+ * \brief Check the possible collisions exactly with the test of their shape-types (see NARROW_PHASE_TESTS). The pairs are independent,
+ * so they are checked in parallel: the contacts are collected per thread, and the collision-states are set afterwards
+ * in the order of the pairs.
+ *
+ * \param collisions
+ *      Possible collisions of the broad-phase.
+ */
+void CollisionManager::narrowPhase(double dt, std::vector<std::pair<SpaceObject *, SpaceObject *>> &collisions) {
+	int cntPairs = collisions.size();
+
+	int cntThreads = 1;
+#if defined(_OPENMP)
+	cntThreads = omp_get_max_threads();
+#endif
+
+	// contacts per thread with the index of their pair, and the collision-state per pair (1 or 2)
+	FrameVector<FrameVector<std::pair<int, Collision>>> threadContacts(cntThreads);
+	FrameVector<FrameVector<std::pair<int, Collision>>> threadSpeculative(cntThreads);
+	FrameVector<int> states(cntPairs, 1);
+
+	// transform the convex-hulls of the moved objects once, so they are only read during the parallel checks
+	FrameVector<SpaceObject*> hullObjects;
+	FrameVector<char> isHullPair(cntPairs);
+	FrameVector<char> isContinuousPair(cntPairs);
+	FrameVector<char> isCoarse(cntPairs);
+	FrameVector<double> speculativeMargins(cntPairs, 0.0);
+	int cntCoarsePairs = 0;
+	_minApproachTime = std::numeric_limits<double>::infinity();
+	for (int i = 0; i < cntPairs; ++i) {
+		isCoarse[i] = isCoarsePair(collisions[i].first, collisions[i].second);
+		cntCoarsePairs += isCoarse[i];
+
+		// linear approach of the coarse spheres until they overlap by the motion-ratio of the smaller one
+		double r1 = collisions[i].first->getCoarseRadius();
+		double r2 = collisions[i].second->getCoarseRadius();
+		Eigen::Vector3d delta = collisions[i].second->getPosition() - collisions[i].first->getPosition();
+		double distance = delta.norm();
+		double gap = distance - r1 - r2 + CCD_MOTION_RATIO * std::min(r1, r2);
+		double closingVelocity = distance > 0.0 ? -delta.dot(collisions[i].second->getLinearVelocity() - collisions[i].first->getLinearVelocity()) / distance : 0.0;
+		if (gap > 0.0 && closingVelocity > 0.0) {
+			_minApproachTime = std::min(_minApproachTime, gap / closingVelocity);
+		}
 
-		Planet* p1 = dynamic_cast<Planet*>(collisions[i].first);
-		Planet* p2 = dynamic_cast<Planet*>(collisions[i].second);
+		// the gap which the pair may close within the step
+		if (_isSpeculative && !isCoarse[i] && closingVelocity > 0.0) {
+			speculativeMargins[i] = SPECULATIVE_RATIO * closingVelocity * dt;
+		}
 
-		if (p1 != nullptr && p2 != nullptr) {
-			// we have a possible collision between 2 spheres.
+		// the far pairs need neither the convex-hulls nor the continuous test
+		isHullPair[i] = !isCoarse[i] && (collisions[i].first->getShapeType() != SpaceObject::SPHERE || collisions[i].second->getShapeType() != SpaceObject::SPHERE);
+		isContinuousPair[i] = !isCoarse[i] && (!collisions[i].first->getSweep().isZero(0.0) || !collisions[i].second->getSweep().isZero(0.0));
 
-			if (checkIntersection(p1, p2)) {
-				Collision sphereCollision;
-				sphereCollision.setFirstObject(p1);
-				sphereCollision.setSecondObject(p2);
-				sphereCollision.setUnitNormal((p1->getPosition() - p2->getPosition()).normalized());
-				sphereCollision.setFirstPOC(p1->getPosition() - p1->getRadius() * sphereCollision.getUnitNormal());
-				sphereCollision.setSecondPOC(p2->getPosition() + p2->getRadius() * sphereCollision.getUnitNormal());
-				sphereCollision.setIntersectionVector(sphereCollision.getUnitNormal() * (((p1->getPosition() - p2->getPosition()).norm()) - p1->getRadius() - p2->getRadius()));
-				_collisionQueue.push(sphereCollision);
-				//std::cout << "INTERSECTION DETECTED" << std::endl;
+		if (isHullPair[i]) {
+			hullObjects.push_back(collisions[i].first);
+			hullObjects.push_back(collisions[i].second);
+		}
+	}
 
-				p1->setCollisionState(2);
-				p2->setCollisionState(2);
-			} else {
-				p1->setCollisionState(1);
-				p2->setCollisionState(1);
+	std::sort(hullObjects.begin(), hullObjects.end());
+	hullObjects.erase(std::unique(hullObjects.begin(), hullObjects.end()), hullObjects.end());
+	int cntHullObjects = hullObjects.size();
+	Profiler::Instance()->count(Profiler::COARSE_PAIRS, cntCoarsePairs);
+
+	// the coarse convex-hulls reject most of the pairs, only the others need the full convex-hulls
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int i = 0; i < cntHullObjects; ++i) {
+		hullObjects[i]->updateCoarseHull();
+	}
+
+	// the loose AABBs of rotated, elongated hulls overlap much more often than their OBBs
+	FrameVector<char> isCulled(cntPairs, 0);
+	int cntCulled = 0;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 16) reduction(+:cntCulled)
+#endif
+	for (int i = 0; i < cntPairs; ++i) {
+		if (isHullPair[i]) {
+			isCulled[i] = !testMidPhase(collisions[i].first, collisions[i].second) || !testCoarseHulls(collisions[i].first, collisions[i].second);
+			cntCulled += isCulled[i];
+		}
+	}
+	Profiler::Instance()->count(Profiler::MIDPHASE_CULLED, cntCulled);
+
+	// transform the full convex-hulls of the remaining pairs once, so they are only read during the parallel checks
+	hullObjects.clear();
+	for (int i = 0; i < cntPairs; ++i) {
+		SpaceObject* objects[2] = { collisions[i].first, collisions[i].second };
+
+		for (int k = 0; k < 2; ++k) {
+			if ((isHullPair[i] && !isCulled[i] && !isCoarseContact(objects[k])) || isContinuousPair[i]) {
+				hullObjects.push_back(objects[k]);
 			}
-		} else {
-			std::vector<Eigen::Vector3d> convexHullP1 = o1->getConvexHull();
-			std::vector<Eigen::Vector3d> convexHullP2 = o2->getConvexHull();
-			Collision sphereCollision(o1, o2);
-
-			if (GjkAlgorithm::intersect(convexHullP1, convexHullP2, sphereCollision)) {
-				//sphereCollision.setUnitNormal((o1->getPosition() - o2->getPosition()).normalized());
-				sphereCollision.setFirstPOC(sphereCollision.getFirstPOC());
-				sphereCollision.setSecondPOC(sphereCollision.getSecondPOC());
-				_collisionQueue.push(sphereCollision);
-
-				o1->setCollisionState(2);
-				o2->setCollisionState(2);
-			} else {
-				o1->setCollisionState(1);
-				o2->setCollisionState(1);
+		}
+	}
+
+	std::sort(hullObjects.begin(), hullObjects.end());
+	hullObjects.erase(std::unique(hullObjects.begin(), hullObjects.end()), hullObjects.end());
+	cntHullObjects = hullObjects.size();
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int i = 0; i < cntHullObjects; ++i) {
+		hullObjects[i]->updateConvexHull();
+	}
+
+	// warm-start GJK with the support-vertices and the separating axis of the previous frame
+	FrameVector<uint64_t> keys(cntPairs);
+	FrameVector<PairCache> pairCaches(cntPairs);
+	for (int i = 0; i < cntPairs; ++i) {
+		keys[i] = getPairKey(collisions[i].first, collisions[i].second);
+
+		std::unordered_map<uint64_t, PairCache>::const_iterator it = _pairCache.find(keys[i]);
+		if (it != _pairCache.end()) {
+			pairCaches[i] = it->second;
+		}
+		pairCaches[i].speculativeMargin = speculativeMargins[i];
+	}
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+	{
+		// one span per thread shows the balance of the pairs
+		TRACE_SCOPE("narrowPhaseTask");
+
+		// the statistics of the GJK are counted per thread
+		GjkAlgorithm::Statistics gjkStart = GjkAlgorithm::getStatistics();
+
+		int thread = 0;
+#if defined(_OPENMP)
+		thread = omp_get_thread_num();
+#endif
+		FrameVector<std::pair<int, Collision>> &contacts = threadContacts[thread];
+		FrameVector<std::pair<int, Collision>> &speculative = threadSpeculative[thread];
+
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 8)
+#endif
+		for (int i = 0; i < cntPairs; ++i) {
+			SpaceObject* o1 = collisions[i].first;
+			SpaceObject* o2 = collisions[i].second;
+			Collision collision(o1, o2);
+
+			NarrowPhaseTest test = isCoarse[i] ? &CollisionManager::testCoarseSpheres : NARROW_PHASE_TESTS[o1->getShapeType()][o2->getShapeType()];
+
+			// a pair which is separated at the end of the step may have hit each other during the step
+			if ((!isCulled[i] && test(o1, o2, pairCaches[i], collision))
+				|| (isContinuousPair[i] && testContinuous(o1, o2, pairCaches[i], collision))) {
+				contacts.push_back(std::make_pair(i, collision));
+
+				states[i] = 2;
+			} else if (collision.getSeparation() > 0.0) {
+				speculative.push_back(std::make_pair(i, collision));
 			}
 		}
+
+		const GjkAlgorithm::Statistics &gjkEnd = GjkAlgorithm::getStatistics();
+		Profiler* profiler = Profiler::Instance();
+		profiler->count(Profiler::GJK_CALLS, gjkEnd.gjkCalls - gjkStart.gjkCalls);
+		profiler->count(Profiler::GJK_ITERATIONS, gjkEnd.gjkIterations - gjkStart.gjkIterations);
+		profiler->count(Profiler::EPA_ITERATIONS, gjkEnd.epaIterations - gjkStart.epaIterations);
+	}
+
+	// only keep the GJK-results of the current pairs
+	_pairCache.clear();
+	for (int i = 0; i < cntPairs; ++i) {
+		if (isHullPair[i] || isContinuousPair[i]) {
+			_pairCache[keys[i]] = pairCaches[i];
+		}
+	}
+
+	// merge the contacts in the order of the pairs, so the solver does not depend on the scheduling
+	FrameVector<std::pair<int, Collision>> contacts;
+	for (int t = 0; t < cntThreads; ++t) {
+		contacts.insert(contacts.end(), threadContacts[t].begin(), threadContacts[t].end());
+	}
+
+	std::sort(contacts.begin(), contacts.end(), [](const std::pair<int, Collision> &a, const std::pair<int, Collision> &b) {
+		return a.first < b.first;
+	});
+
+	for (unsigned int i = 0; i < contacts.size(); ++i) {
+		_contacts.push_back(contacts[i].second);
+	}
+
+	contacts.clear();
+	for (int t = 0; t < cntThreads; ++t) {
+		contacts.insert(contacts.end(), threadSpeculative[t].begin(), threadSpeculative[t].end());
+	}
+
+	std::sort(contacts.begin(), contacts.end(), [](const std::pair<int, Collision> &a, const std::pair<int, Collision> &b) {
+		return a.first < b.first;
+	});
+
+	for (unsigned int i = 0; i < contacts.size(); ++i) {
+		_speculativeContacts.push_back(contacts[i].second);
+	}
+
+	// deferred update of the shared objects (same result as setting the states one pair after the other)
+	for (int i = 0; i < cntPairs; ++i) {
+		collisions[i].first->setCollisionState(states[i]);
+		collisions[i].second->setCollisionState(states[i]);
 	}
 }
 
 
-Eigen::Matrix3d CollisionManager::getOrthonormalBasis(Eigen::Vector3d v) {
-	Eigen::Vector3d firstTangent;
-	Eigen::Vector3d secondTangent;
+/**
+ * \brief Exact test of two spheres.
+ */
+bool CollisionManager::testSpheres(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision) {
+	Planet* p1 = static_cast<Planet*>(o1);
+	Planet* p2 = static_cast<Planet*>(o2);
 
-	if (fabs(v[0]) > fabs(v[1])) {
-		firstTangent[0] = v[2];
-		firstTangent[1] = 0;
-		firstTangent[2] = -v[0];
+	bool isIntersecting = checkIntersection(p1, p2);
+	double gap = (p1->getPosition() - p2->getPosition()).norm() - p1->getRadius() - p2->getRadius();
 
-		firstTangent.normalize();
+	// a separated pair which may close its gap within the step gets a speculative contact
+	if (!isIntersecting && gap >= cache.speculativeMargin) {
+		return false;
+	}
 
-		secondTangent[0] = v[1] * firstTangent[0];
-		secondTangent[1] = v[2] * firstTangent[0] - v[0] * firstTangent[2];
-		secondTangent[2] = -v[1] * firstTangent[0];
+	collision.setUnitNormal((p1->getPosition() - p2->getPosition()).normalized());
+	collision.setFirstPOC(p1->getPosition() - p1->getRadius() * collision.getUnitNormal());
+	collision.setSecondPOC(p2->getPosition() + p2->getRadius() * collision.getUnitNormal());
+
+	if (isIntersecting) {
+		collision.setIntersectionVector(collision.getUnitNormal() * gap);
 	} else {
-		firstTangent[0] = 0;
-		firstTangent[1] = -v[2];
-		firstTangent[2] = v[1];
+		collision.setIntersectionVector(Eigen::Vector3d::Zero());
+		collision.setSeparation(gap);
+	}
 
-		firstTangent.normalize();
+	return isIntersecting;
+}
 
-		secondTangent[0] = v[1] * firstTangent[2] - v[2] * firstTangent[1];
-		secondTangent[1] = -v[0] * firstTangent[2];
-		secondTangent[2] = v[0] * firstTangent[1];
+
+/**
+ * \brief Test of the coarse spheres of two objects which are outside of the region of interest.
+ */
+bool CollisionManager::testCoarseSpheres(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision) {
+	Eigen::Vector3d delta = o1->getPosition() - o2->getPosition();
+	double r1 = o1->getCoarseRadius();
+	double r2 = o2->getCoarseRadius();
+	double distance = delta.norm();
+
+	if (distance >= r1 + r2 || distance <= 0.0) {
+		return false;
 	}
 
-	Eigen::Matrix3d result;
-	result << v[0], firstTangent[0], secondTangent[0],
-		v[1], firstTangent[1], secondTangent[1],
-		v[2], firstTangent[2], secondTangent[2];
+	// the normal goes through both centers => the contact does not spin the objects
+	collision.setUnitNormal(delta / distance);
+	collision.setFirstPOC(o1->getPosition() - r1 * collision.getUnitNormal());
+	collision.setSecondPOC(o2->getPosition() + r2 * collision.getUnitNormal());
+	collision.setIntersectionVector(collision.getUnitNormal() * (distance - r1 - r2));
 
-	return result;
+	return true;
+}
+
+
+/**
+ * \brief Cast a ray against the exact shapes of the objects (spheres or convex-hulls). The candidates are the
+ *        objects whose AABB is hit, in the order of the entry-distance, until a candidate is further away than
+ *        the closest exact hit.
+ *
+ * \param origin
+ *      Start of the ray.
+ * \param direction
+ *      Direction of the ray (is normalized).
+ * \param maxDistance
+ *      Maximum distance of the hit.
+ * \param hit
+ *      Output-parameter: Closest hit (object is nullptr if nothing is hit).
+ *
+ * \return True if an object is hit.
+ */
+bool CollisionManager::rayCast(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double maxDistance, RayHit &hit) {
+	std::vector<RayHit> hits;
+	rayCast(std::vector<Eigen::Vector3d>(1, origin), std::vector<Eigen::Vector3d>(1, direction), maxDistance, hits);
+	hit = hits[0];
+
+	return hit.object != nullptr;
+}
+
+
+/**
+ * \brief Cast a batch of rays in parallel (see rayCast()).
+ *
+ * \param origins
+ *      Start of the rays.
+ * \param directions
+ *      Direction of the rays (are normalized).
+ * \param maxDistance
+ *      Maximum distance of the hits.
+ * \param hits
+ *      Output-parameter: Closest hit per ray (overwritten).
+ */
+void CollisionManager::rayCast(const std::vector<Eigen::Vector3d> &origins, const std::vector<Eigen::Vector3d> &directions, double maxDistance, std::vector<RayHit> &hits) {
+	int cntRays = std::min(origins.size(), directions.size());
+	hits.assign(cntRays, RayHit());
+
+	// the AABBs which are missed have the entry-distance max()
+	maxDistance = std::min(maxDistance, 0.5 * std::numeric_limits<double>::max());
+
+	const AabbTree &tree = getQueryTree();
+	std::vector<Eigen::Vector3d> normalized(cntRays);
+	std::vector<std::vector<std::pair<double, SpaceObject*>>> candidates(cntRays);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int i = 0; i < cntRays; ++i) {
+		double length = directions[i].norm();
+		if (length > 0.0) {
+			normalized[i] = directions[i] / length;
+			tree.queryRay(origins[i], normalized[i], maxDistance, candidates[i]);
+		}
+	}
+
+	std::vector<SpaceObject*> objects;
+	for (int i = 0; i < cntRays; ++i) {
+		for (const auto &candidate : candidates[i]) {
+			objects.push_back(candidate.second);
+		}
+	}
+	prepareCandidates(objects);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int i = 0; i < cntRays; ++i) {
+		double closest = maxDistance;
+
+		for (const auto &candidate : candidates[i]) {
+			// the exact shape is inside of the AABB, so no later candidate can be closer
+			if (candidate.first > closest) break;
+
+			RayHit hit;
+			if (rayCastObject(candidate.second, origins[i], normalized[i], candidate.first, closest, hit)) {
+				hits[i] = hit;
+				closest = hit.distance;
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Get all objects whose exact shape overlaps with a sphere (see rayCast() for the thread-safety).
+ *
+ * \param center
+ *      Center of the sphere.
+ * \param radius
+ *      Radius of the sphere.
+ * \param res
+ *      Output-parameter: Overlapping objects (overwritten).
+ */
+void CollisionManager::querySphere(const Eigen::Vector3d &center, double radius, std::vector<SpaceObject*> &res) {
+	osg::BoundingBox region(center.x() - radius, center.y() - radius, center.z() - radius,
+							center.x() + radius, center.y() + radius, center.z() + radius);
+
+	std::vector<SpaceObject*> candidates;
+	getQueryTree().queryRegion(region, candidates);
+	prepareCandidates(candidates);
+
+	res.clear();
+	for (SpaceObject* object : candidates) {
+		bool isOverlapping;
+
+		if (object->getShapeType() == SpaceObject::SPHERE) {
+			Planet* planet = static_cast<Planet*>(object);
+			isOverlapping = (planet->getPosition() - center).norm() <= radius + planet->getRadius();
+		} else {
+			const ConvexHull3D* model = object->getConvexHullModel();
+			ConvexShape convexHull(object->getConvexHull(), model->getAdjacencyStart(), model->getAdjacency(), -1, object->getConvexHullSoa());
+			Eigen::Vector3d closest;
+
+			// the center is inside of the convex-hull if there is no closest point
+			isOverlapping = !GjkAlgorithm::getClosestPoint(convexHull, center, closest) || (center - closest).norm() <= radius;
+		}
+
+		if (isOverlapping) {
+			res.push_back(object);
+		}
+	}
 }
 
 
-void CollisionManager::respondToCollisions() {
-	while (!_collisionQueue.empty()) {
-		Collision currentCollision = _collisionQueue.top();
-		_collisionQueue.pop();
+/**
+ * \brief Get all objects whose exact shape overlaps with a box (see rayCast() for the thread-safety).
+ *
+ * \param box
+ *      Axis-aligned box in the world-space.
+ * \param res
+ *      Output-parameter: Overlapping objects (overwritten).
+ */
+void CollisionManager::queryBox(const osg::BoundingBox &box, std::vector<SpaceObject*> &res) {
+	std::vector<SpaceObject*> candidates;
+	getQueryTree().queryRegion(box, candidates);
+	prepareCandidates(candidates);
+
+	std::vector<Eigen::Vector3d> corners(8);
+	for (unsigned int c = 0; c < 8; ++c) {
+		osg::Vec3 corner = box.corner(c);
+		corners[c] = Eigen::Vector3d(corner.x(), corner.y(), corner.z());
+	}
+
+	res.clear();
+	for (SpaceObject* object : candidates) {
+		bool isOverlapping;
+
+		if (object->getShapeType() == SpaceObject::SPHERE) {
+			Planet* planet = static_cast<Planet*>(object);
+			const Eigen::Vector3d &center = planet->getPosition();
+			Eigen::Vector3d closest;
+			for (int axis = 0; axis < 3; ++axis) {
+				closest(axis) = std::max<double>(box._min[axis], std::min<double>(center(axis), box._max[axis]));
+			}
+
+			isOverlapping = (center - closest).norm() <= planet->getRadius();
+		} else {
+			const ConvexHull3D* model = object->getConvexHullModel();
+			ConvexShape convexHull(object->getConvexHull(), model->getAdjacencyStart(), model->getAdjacency(), -1, object->getConvexHullSoa());
+			ConvexShape boxShape(corners);
+			Eigen::Vector3d separation;
+
+			isOverlapping = !GjkAlgorithm::getDistance(boxShape, convexHull, Eigen::Vector3d::Zero(), separation);
+		}
 
-		SpaceObject* object1 = currentCollision.getFirstObject();
-		SpaceObject* object2 = currentCollision.getSecondObject();
+		if (isOverlapping) {
+			res.push_back(object);
+		}
+	}
+}
 
-		Eigen::Matrix3d contactBasis = getOrthonormalBasis(currentCollision.getUnitNormal()).inverse();
 
-		osg::Quat orientation1 = object1->getOrientation();
-		osg::Quat orientation2 = object2->getOrientation();
+/**
+ * \brief Get the k objects whose centers are closest to a point (see rayCast() for the thread-safety).
+ *
+ * \param point
+ *      Point in the world-space.
+ * \param k
+ *      Maximum number of objects.
+ * \param res
+ *      Output-parameter: Closest objects, ordered by the distance (overwritten).
+ * \param maxDistance
+ *      Maximum distance of the centers.
+ */
+void CollisionManager::queryNearest(const Eigen::Vector3d &point, unsigned int k, std::vector<SpaceObject*> &res, double maxDistance) {
+	std::vector<std::vector<SpaceObject*>> results;
+	queryNearest(std::vector<Eigen::Vector3d>(1, point), k, results, maxDistance);
+	res.swap(results[0]);
+}
 
-		Eigen::Matrix3d foRotationMatrix = fromOsg(osg::Matrix::rotate(orientation1)).block(0,0,3,3);
-		Eigen::Matrix3d soRotationMatrix = fromOsg(osg::Matrix::rotate(orientation2)).block(0,0,3,3);
 
-		Eigen::Matrix3d foWorldInertia = foRotationMatrix * object1->getMomentOfInertia() * foRotationMatrix.inverse();
-		Eigen::Matrix3d soWorldInertia = soRotationMatrix * object2->getMomentOfInertia() * soRotationMatrix.inverse();
+/**
+ * \brief Get the k nearest objects of a batch of points in parallel (see queryNearest()).
+ *
+ * \param points
+ *      Points in the world-space.
+ * \param k
+ *      Maximum number of objects per point.
+ * \param res
+ *      Output-parameter: Closest objects per point, ordered by the distance (overwritten).
+ * \param maxDistance
+ *      Maximum distance of the centers.
+ */
+void CollisionManager::queryNearest(const std::vector<Eigen::Vector3d> &points, unsigned int k, std::vector<std::vector<SpaceObject*>> &res, double maxDistance) {
+	int cntPoints = points.size();
+	res.assign(cntPoints, std::vector<SpaceObject*>());
+
+	const AabbTree &tree = getQueryTree();
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int i = 0; i < cntPoints; ++i) {
+		std::vector<std::pair<double, SpaceObject*>> nearest;
+		tree.queryNearest(points[i], k, maxDistance, nearest);
+
+		res[i].reserve(nearest.size());
+		for (const auto &candidate : nearest) {
+			res[i].push_back(candidate.second);
+		}
+	}
+}
 
-		Eigen::Vector3d velocityFirst = object1->getLinearVelocity() + object1->getAngularVelocity().cross(currentCollision.getFirstPOC() - object1->getPosition());
-		Eigen::Vector3d velocitySecond = object2->getLinearVelocity() + object2->getAngularVelocity().cross(currentCollision.getSecondPOC() - object2->getPosition());
 
-		double closingVelocity = (velocityFirst - velocitySecond).dot(currentCollision.getUnitNormal());
-		Eigen::Vector3d contactVelocity = contactBasis * (velocityFirst - velocitySecond);
-
-		double finalVelocity = -COEF_RESTITUTION * closingVelocity;
+/**
+ * \brief Get the tree of the queries (built again if the objects moved since the last query).
+ *
+ * \return AABB-tree with the AABBs of the last step.
+ */
+const AabbTree& CollisionManager::getQueryTree() {
+	// the tree of the broad-phase is refitted by each step
+	if (_broadPhase == AABB_TREE && _isEnabled) {
+		return _aabbTree;
+	}
 
-		double deltaVelocity = finalVelocity - closingVelocity;
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_queryMutex);
+	if (_isQueryTreeDirty) {
+		_queryTree.init(_spaceObjects);
+		_isQueryTreeDirty = false;
+	}
 
-		Eigen::Vector3d velocityToKill;
-		velocityToKill << deltaVelocity, -contactVelocity[1], -contactVelocity[2];
+	return _queryTree;
+}
 
-		Eigen::Matrix3d deltaVelWorld;
-		Eigen::Matrix3d linearResponsePerUnitImpulse = (1. / object1->getMass())*Eigen::Matrix3d::Identity();
-		linearResponsePerUnitImpulse += (1. / object2->getMass())*Eigen::Matrix3d::Identity();
 
-		Eigen::Vector3d skewOriginMatrix1 = (currentCollision.getFirstPOC() - object1->getPosition());
-		Eigen::Matrix3d skewSymmetricMatrix1;
-		skewSymmetricMatrix1 << 0, -skewOriginMatrix1(2), skewOriginMatrix1(1),
-			skewOriginMatrix1(2), 0, -skewOriginMatrix1(0),
-			-skewOriginMatrix1(1), skewOriginMatrix1(0), 0;
+/**
+ * \brief Transform the convex-hulls of the candidates of a query, so they are only read afterwards.
+ *
+ * \param candidates
+ *      Candidates of the queries (may contain duplicates).
+ */
+void CollisionManager::prepareCandidates(const std::vector<SpaceObject*> &candidates) {
+	std::vector<SpaceObject*> hullObjects;
+	for (SpaceObject* object : candidates) {
+		if (object->getShapeType() != SpaceObject::SPHERE) {
+			hullObjects.push_back(object);
+		}
+	}
 
-		Eigen::Vector3d skewOriginMatrix2 = (currentCollision.getSecondPOC() - object2->getPosition());
-		Eigen::Matrix3d skewSymmetricMatrix2;
-		skewSymmetricMatrix2 << 0, -skewOriginMatrix2(2), skewOriginMatrix2(1),
-			skewOriginMatrix2(2), 0, -skewOriginMatrix2(0),
-			-skewOriginMatrix2(1), skewOriginMatrix2(0), 0;
+	std::sort(hullObjects.begin(), hullObjects.end());
+	hullObjects.erase(std::unique(hullObjects.begin(), hullObjects.end()), hullObjects.end());
+	int cntHullObjects = hullObjects.size();
 
-		deltaVelWorld = (-1) * skewSymmetricMatrix1 * foWorldInertia.inverse() * skewSymmetricMatrix1;
-		deltaVelWorld += (-1) * skewSymmetricMatrix2 * soWorldInertia.inverse() * skewSymmetricMatrix2;
-		
-		Eigen::Matrix3d deltaVelocityMatrix = contactBasis * deltaVelWorld * contactBasis.inverse();
-		deltaVelocityMatrix += linearResponsePerUnitImpulse;
-		/*Eigen::Matrix3d rotationalResponsePerUnitImpulse = (-1. * (foWorldInertia.inverse() * skewSymmetricMatrix1 * contactBasis) * skewSymmetricMatrix1);
-		rotationalResponsePerUnitImpulse += (-1. * (soWorldInertia.inverse() * skewSymmetricMatrix2 * contactBasis) * skewSymmetricMatrix2);
-		Eigen::Matrix3d deltaVelocityMatrix = (linearResponsePerUnitImpulse + contactBasis.transpose() * rotationalResponsePerUnitImpulse * contactBasis);
-		Eigen::Vector3d impulseResponse = (deltaVelocityMatrix.inverse() * velocityToKill);*/
+	// another query may transform the same convex-hulls (only the first one does, as the objects do not move)
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_queryMutex);
 
-		Eigen::Vector3d contactImpulseResponse = deltaVelocityMatrix.inverse() * velocityToKill;
-		double planarImpulse = sqrt(contactImpulseResponse.y()*contactImpulseResponse.y() + contactImpulseResponse.z()*contactImpulseResponse.z());
-		
-		if (planarImpulse > contactImpulseResponse.x() * COEF_FRICTION) {
-			// We need to use dynamic friction.
-			contactImpulseResponse.y() /= planarImpulse;
-			contactImpulseResponse.z() /= planarImpulse;
-			contactImpulseResponse.x() = deltaVelocityMatrix(0, 0) +
-				deltaVelocityMatrix(1, 0) * COEF_FRICTION * contactImpulseResponse.y() +
-				deltaVelocityMatrix(2, 0) * COEF_FRICTION * contactImpulseResponse.z();
-			contactImpulseResponse.x() = deltaVelocity / contactImpulseResponse.x();
-			contactImpulseResponse.y() *= COEF_FRICTION * contactImpulseResponse.x();
-			contactImpulseResponse.z() *= COEF_FRICTION * contactImpulseResponse.x();
-		}
-
-		Eigen::Vector3d impulseResponse = contactBasis.inverse() * contactImpulseResponse;
-
-		
-		object1->setLinearVelocity(object1->getLinearVelocity() + impulseResponse / object1->getMass());
-		object2->setLinearVelocity(object2->getLinearVelocity() - impulseResponse / object2->getMass());
-
-		object1->setAngularVelocity(object1->getAngularVelocity() - foRotationMatrix * foWorldInertia.inverse() * (impulseResponse).cross(currentCollision.getFirstPOC() - object1->getPosition()));
-		object2->setAngularVelocity(object2->getAngularVelocity() - soRotationMatrix * soWorldInertia.inverse() * (impulseResponse).cross(currentCollision.getSecondPOC() - object2->getPosition()));
-
-		//object1->setPosition(object1->getPosition() - 0.5 * currentCollision.getIntersectionVector());
-		//object2->setPosition(object2->getPosition() + 0.5 * currentCollision.getIntersectionVector());
-
-		double angI1 = ((foWorldInertia.inverse() * (currentCollision.getFirstPOC() - object1->getPosition()).cross(currentCollision.getUnitNormal())).cross(currentCollision.getFirstPOC() - object1->getPosition())).dot(currentCollision.getUnitNormal());
-		double angI2 = ((soWorldInertia.inverse() * (currentCollision.getSecondPOC() - object2->getPosition()).cross(currentCollision.getUnitNormal())).cross(currentCollision.getSecondPOC() - object2->getPosition())).dot(currentCollision.getUnitNormal());
-		
-		double linI1 = 1 / object1->getMass();
-		double linI2 = 1 / object2->getMass();
-
-		double ratio1 = linI1 / (linI1 + linI2);
-		double ratio2 = 1 - ratio1;
-		/*if (angI1 > 0.5) {
-			linI1 += (angI1 - 0.5)*ratio1;
-			linI2 += (angI1 - 0.5)*ratio2;
-		}
-
-		if (angI2 > 0.5) {
-			linI1 += (angI2 - 0.5)*ratio1;
-			linI2 += (angI2 - 0.5)*ratio2;
-		}*/
-		double totalInertia = angI1 + angI2 + linI1 + linI2;
-		double inverseInertia = 1 / totalInertia;
-
-		double linMov1 = currentCollision.getIntersectionVector().norm() * linI1 * inverseInertia;
-		double linMov2 = currentCollision.getIntersectionVector().norm() * linI2 * inverseInertia;
-
-		double angMov1 = currentCollision.getIntersectionVector().norm() * angI1 * inverseInertia;
-		double angMov2 = currentCollision.getIntersectionVector().norm() * angI2 * inverseInertia;
-
-		Eigen::Vector3d newPos1 = object1->getPosition() + linMov1 * currentCollision.getUnitNormal();
-		Eigen::Vector3d newPos2 = object2->getPosition() - linMov2 * currentCollision.getUnitNormal();
-
-		Eigen::Vector3d rot1, rot2;
-		if (angI1 > 0.001)
-			rot1 = (foWorldInertia.inverse() * (currentCollision.getFirstPOC() - object1->getPosition()).cross(currentCollision.getUnitNormal())) * 1 / angI1 * angMov1;
-		else
-			rot1 = Eigen::Vector3d(0,0,0);
-		if (angI2 > 0.001)
-			rot2 = (foWorldInertia.inverse() * (currentCollision.getSecondPOC() - object2->getPosition()).cross(currentCollision.getUnitNormal())) * 1 / angI2 * angMov2;
-		else
-			rot2 = Eigen::Vector3d(0, 0, 0);
-		double sinQuat1 = sin(rot1.norm() / 2);
-		double cosQuat1 = cos(rot1.norm() / 2);
-
-		double sinQuat2 = sin(rot2.norm() / 2);
-		double cosQuat2 = cos(rot2.norm() / 2);
-
-		osg::Quat q1;
-		osg::Quat q2;
-
-		if (rot1.norm() < 0.001) {
-			q1.set(0, 0, 0, 1);
-		}
-		else {
-			q1.set(sinQuat1*rot1(0) / rot1.norm(), sinQuat1*rot1(1) / rot1.norm(), sinQuat1*rot1(2) / rot1.norm(), cosQuat1);
-		}
-
-		if (rot2.norm() < 0.001) {
-			q2.set(0, 0, 0, 1);
-		}
-		else {
-			q2.set(sinQuat2*rot2(0) / rot2.norm(), sinQuat2*rot2(1) / rot2.norm(), sinQuat2*rot2(2) / rot2.norm(), cosQuat2);
-		}
-			
-		
-		
-
-		q1 = q1 * object1->getOrientation();
-		q2 = q2 * object2->getOrientation();
-
-		object1->updatePositionOrientation(newPos1, q1);
-		object2->updatePositionOrientation(newPos2, q2);
-
-		//print("contactBasis", contactBasis);
-		//print("orientation1", orientation1);
-		//print("orientation2", orientation2);
-		//print("foOrientationX", foOrientationX);
-		//print("foOrientationY", foOrientationY);
-		//print("foOrientationZ", foOrientationZ);
-		//print("soOrientationX", soOrientationX);
-		//print("soOrientationY", soOrientationY);
-		//print("soOrientationZ", soOrientationZ);
-		//print("foRotationMatrix", foRotationMatrix);
-		//print("soRotationMatrix", soRotationMatrix);
-		//print("momentOfInertia1", object1->getMomentOfInertia());
-		//print("momentOfInertia2", object2->getMomentOfInertia());
-		//print("foWorldInertia", foWorldInertia);
-		//print("soWorldInertia", soWorldInertia);
-		//print("velocityFirst", velocityFirst);
-		//print("velocitySecond", velocitySecond);
-		//print("contactVelocity", contactVelocity);
-		//print("velocityToKill", velocityToKill);
-		//print("linearResponsePerUnitImpulse", linearResponsePerUnitImpulse);
-		//print("skewOriginMatrix1", skewOriginMatrix1);
-		//print("skewSymmetricMatrix1", skewSymmetricMatrix1);
-		//print("skewOriginMatrix2", skewOriginMatrix2);
-		//print("skewSymmetricMatrix2", skewSymmetricMatrix2);
-		//print("rotationalResponsePerUnitImpulse", rotationalResponsePerUnitImpulse);
-		//print("deltaVelocityMatrix", deltaVelocityMatrix);
-		//print("impulseResponse", impulseResponse);
-		//print("contactImpulseResponse", contactImpulseResponse);
-		//print("position1", object1->getPosition());
-		//print("position2", object2->getPosition());
-		//print("linearVelocity1", object1->getLinearVelocity());
-		//print("linearVelocity2", object2->getLinearVelocity());
-		//print("angularVelocity1", object1->getAngularVelocity());
-		//print("angularVelocity2", object2->getAngularVelocity());
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 16)
+#endif
+	for (int i = 0; i < cntHullObjects; ++i) {
+		hullObjects[i]->updateConvexHull();
 	}
 }
+
+
+/**
+ * \brief Cast a ray against the exact shape of an object. A convex-hull is approached by conservative
+ * advancement with the GJK closest-point (the ray moves up to the plane through the closest point).
+ *
+ * \param object
+ *      Candidate of the ray (its convex-hull has to be up to date).
+ * \param origin
+ *      Start of the ray.
+ * \param direction
+ *      Normalized direction of the ray.
+ * \param minDistance
+ *      Distance at which the ray enters the AABB of the object (start of the advancement).
+ * \param maxDistance
+ *      Maximum distance of the hit.
+ * \param hit
+ *      Output-parameter: Hit of the object (only if it is hit before maxDistance).
+ *
+ * \return True if the object is hit.
+ */
+bool CollisionManager::rayCastObject(SpaceObject *object, const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double minDistance, double maxDistance, RayHit &hit) {
+	double t;
+	Eigen::Vector3d normal = -direction;
+
+	if (object->getShapeType() == SpaceObject::SPHERE) {
+		Planet* planet = static_cast<Planet*>(object);
+		Eigen::Vector3d toCenter = planet->getPosition() - origin;
+		double radius = planet->getRadius();
+		double b = toCenter.dot(direction);
+		double c = toCenter.squaredNorm() - radius * radius;
+
+		if (c <= 0.0) {
+			// starts inside of the sphere
+			t = 0.0;
+		} else {
+			double discriminant = b * b - c;
+			if (b <= 0.0 || discriminant < 0.0) {
+				return false;
+			}
+
+			t = b - std::sqrt(discriminant);
+			normal = (origin + t * direction - planet->getPosition()) / radius;
+		}
+	} else {
+		const ConvexHull3D* model = object->getConvexHullModel();
+		ConvexShape convexHull(object->getConvexHull(), model->getAdjacencyStart(), model->getAdjacency(), -1, object->getConvexHullSoa());
+		double tolerance = RAY_TOLERANCE * object->getCoarseRadius();
+
+		t = minDistance;
+		for (int i = 0; i < RAY_MAX_ITERATIONS; ++i) {
+			Eigen::Vector3d point = origin + t * direction;
+			Eigen::Vector3d closest;
+
+			// inside of the convex-hull (or on its surface)
+			if (!GjkAlgorithm::getClosestPoint(convexHull, point, closest)) {
+				break;
+			}
+
+			Eigen::Vector3d toPoint = point - closest;
+			double distance = toPoint.norm();
+			normal = toPoint / distance;
+
+			if (distance <= tolerance) {
+				break;
+			}
+
+			// the plane through the closest point separates the ray from the convex-hull, if it moves away from it
+			double approach = -normal.dot(direction);
+			if (approach <= 0.0) {
+				return false;
+			}
+
+			t += distance / approach;
+			if (t > maxDistance) {
+				return false;
+			}
+		}
+	}
+
+	if (t > maxDistance) {
+		return false;
+	}
+
+	hit.object = object;
+	hit.distance = t;
+	hit.point = origin + t * direction;
+	hit.normal = normal;
+
+	return true;
+}
+
+
+/**
+ * \brief Mid-phase of a pair with at least one convex-hull: the bounding-spheres around the centers and the
+ * OBBs (AABB of the convex-hull in the model-space with the orientation of the object) are tested, before
+ * the pair is checked by GJK.
+ *
+ * \param o1, o2
+ *      Objects of the pair.
+ *
+ * \return False if the objects are separated for sure.
+ */
+bool CollisionManager::testMidPhase(const SpaceObject *o1, const SpaceObject *o2) {
+	const SpaceObject* objects[2] = { o1, o2 };
+	double radii[2];
+	Eigen::Matrix3d rotations[2];
+	Eigen::Vector3d centers[2];
+	Eigen::Vector3d halfExtents[2];
+
+	for (int k = 0; k < 2; ++k) {
+		const SpaceObject* object = objects[k];
+
+		if (object->getShapeType() == SpaceObject::SPHERE) {
+			radii[k] = static_cast<const Planet*>(object)->getRadius();
+			continue;
+		}
+
+		// same transformation as the convex-hull: R * s * v + t
+		const ConvexHull3D* model = object->getConvexHullModel();
+		const osg::Quat &orientation = object->getOrientation();
+		double scaling = object->getScaling();
+
+		radii[k] = scaling * model->getRadius();
+		rotations[k] = Eigen::Quaterniond(orientation.w(), orientation.x(), orientation.y(), orientation.z()).toRotationMatrix();
+		centers[k] = rotations[k] * (0.5 * scaling * (model->getBoxMin() + model->getBoxMax())) + object->getPosition();
+		halfExtents[k] = 0.5 * scaling * (model->getBoxMax() - model->getBoxMin());
+	}
+
+	Eigen::Vector3d delta = o2->getPosition() - o1->getPosition();
+	if (delta.squaredNorm() > (radii[0] + radii[1]) * (radii[0] + radii[1])) {
+		return false;
+	}
+
+	// a sphere against the OBB of the other object (closest point of the box in its frame)
+	bool isSphere1 = o1->getShapeType() == SpaceObject::SPHERE;
+	if (isSphere1 || o2->getShapeType() == SpaceObject::SPHERE) {
+		int sphere = isSphere1 ? 0 : 1;
+		int box = 1 - sphere;
+
+		Eigen::Vector3d local = rotations[box].transpose() * (objects[sphere]->getPosition() - centers[box]);
+		Eigen::Vector3d closest = local.cwiseMax(-halfExtents[box]).cwiseMin(halfExtents[box]);
+
+		return (local - closest).squaredNorm() <= radii[sphere] * radii[sphere];
+	}
+
+	// separating-axis test of two OBBs (15 axes) in the frame of the first one
+	const Eigen::Vector3d &a = halfExtents[0];
+	const Eigen::Vector3d &b = halfExtents[1];
+	Eigen::Matrix3d r = rotations[0].transpose() * rotations[1];
+	Eigen::Vector3d t = rotations[0].transpose() * (centers[1] - centers[0]);
+	// the epsilon keeps the cross-products of (nearly) parallel axes from separating
+	Eigen::Matrix3d absR = (r.cwiseAbs().array() + 1e-9).matrix();
+
+	for (int i = 0; i < 3; ++i) {
+		if (std::abs(t(i)) > a(i) + b.dot(absR.row(i))) return false;
+	}
+
+	for (int j = 0; j < 3; ++j) {
+		if (std::abs(t.dot(r.col(j))) > a.dot(absR.col(j)) + b(j)) return false;
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		int i1 = (i + 1) % 3;
+		int i2 = (i + 2) % 3;
+
+		for (int j = 0; j < 3; ++j) {
+			int j1 = (j + 1) % 3;
+			int j2 = (j + 2) % 3;
+
+			double ra = a(i1) * absR(i2, j) + a(i2) * absR(i1, j);
+			double rb = b(j1) * absR(i, j2) + b(j2) * absR(i, j1);
+
+			if (std::abs(t(i2) * r(i1, j) - t(i1) * r(i2, j)) > ra + rb) return false;
+		}
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Conservative test of a pair with the coarse levels of the convex-hulls (enlarged by their margins),
+ * which only needs the coarse convex-hulls to be up to date.
+ *
+ * \param o1, o2
+ *      Objects of the pair.
+ *
+ * \return False if the full convex-hulls are separated for sure.
+ */
+bool CollisionManager::testCoarseHulls(SpaceObject *o1, SpaceObject *o2) {
+	bool isSphere1 = o1->getShapeType() == SpaceObject::SPHERE;
+
+	if (isSphere1 || o2->getShapeType() == SpaceObject::SPHERE) {
+		Planet* sphere = static_cast<Planet*>(isSphere1 ? o1 : o2);
+		SpaceObject* convex = isSphere1 ? o2 : o1;
+		ConvexShape coarseHull(convex->getCoarseHull(), convex->getCoarseHullSoa());
+		Eigen::Vector3d closest;
+
+		if (!GjkAlgorithm::getClosestPoint(coarseHull, sphere->getPosition(), closest)) {
+			return true;
+		}
+
+		double reach = sphere->getRadius() + convex->getScaling() * convex->getConvexHullModel()->getCoarseMargin();
+		return (sphere->getPosition() - closest).squaredNorm() <= reach * reach;
+	}
+
+	ConvexShape coarseHull1(o1->getCoarseHull(), o1->getCoarseHullSoa());
+	ConvexShape coarseHull2(o2->getCoarseHull(), o2->getCoarseHullSoa());
+	Eigen::Vector3d separation;
+
+	if (!GjkAlgorithm::getDistance(coarseHull1, coarseHull2, Eigen::Vector3d::Zero(), separation)) {
+		return true;
+	}
+
+	double margin = o1->getScaling() * o1->getConvexHullModel()->getCoarseMargin() + o2->getScaling() * o2->getConvexHullModel()->getCoarseMargin();
+	return separation.squaredNorm() <= margin * margin;
+}
+
+
+/**
+ * \brief Get the shape of an object for the contacts (the full or the coarse convex-hull, which have to be
+ * up to date).
+ *
+ * \param object
+ *      Object of a pair.
+ * \param supportVertex
+ *      Vertex to start the first query from (result of the previous frame).
+ *
+ * \return Shape of the narrow-phase.
+ */
+ConvexShape CollisionManager::getContactShape(SpaceObject *object, int supportVertex) {
+	if (isCoarseContact(object)) {
+		return ConvexShape(object->getCoarseHull(), object->getCoarseHullSoa());
+	}
+
+	const ConvexHull3D* model = object->getConvexHullModel();
+	return ConvexShape(object->getConvexHull(), model->getAdjacencyStart(), model->getAdjacency(), supportVertex, object->getConvexHullSoa());
+}
+
+
+/**
+ * \brief Get the shape of a part of a compound for the contacts (the global parts have to be up to date).
+ *
+ * \param object
+ *      Object of a pair.
+ * \param part
+ *      Index of the part (-1 => shape of getContactShape()).
+ * \param supportVertex
+ *      Vertex to start the first query from (result of the previous frame).
+ *
+ * \return Shape of the narrow-phase.
+ */
+ConvexShape CollisionManager::getPartShape(SpaceObject *object, int part, int supportVertex) {
+	if (part < 0) {
+		return getContactShape(object, supportVertex);
+	}
+
+	const ConvexHull3D* model = object->getConvexHullModel()->getParts()[part];
+	return ConvexShape(object->getPartHull(part), model->getAdjacencyStart(), model->getAdjacency(), supportVertex, object->getPartHullSoa(part));
+}
+
+
+/**
+ * \brief Get the bounding-sphere of a node of the part-hierarchy in the global-world-space.
+ *
+ * \param object
+ *      Object of the hierarchy.
+ * \param rotation
+ *      Rotation of the object.
+ * \param node
+ *      Index of the node (-1 => sphere around the whole convex-hull).
+ * \param center, radius
+ *      Output-parameter: Bounding-sphere of the node.
+ */
+void CollisionManager::getPartSphere(const SpaceObject *object, const Eigen::Matrix3d &rotation, int node, Eigen::Vector3d &center, double &radius) {
+	const ConvexHull3D* model = object->getConvexHullModel();
+	double scaling = object->getScaling();
+
+	if (node < 0) {
+		center = object->getPosition();
+		radius = scaling * model->getRadius();
+		return;
+	}
+
+	// same transformation as the convex-hull: R * s * v + t
+	const ConvexHull3D::PartNode &partNode = model->getPartTree()[node];
+	center = rotation * (scaling * partNode.center) + object->getPosition();
+	radius = scaling * partNode.radius;
+}
+
+
+/**
+ * \brief Collect the pairs of parts whose bounding-spheres overlap by a traversal of both part-hierarchies
+ * (the larger sphere is descended first).
+ *
+ * \param o1, o2
+ *      Objects of the pair (at least one compound).
+ * \param pairs
+ *      Output-parameter: Overlapping parts of o1 and o2 (-1 => whole convex-hull of a convex object).
+ */
+void CollisionManager::collectPartPairs(const SpaceObject *o1, const SpaceObject *o2, std::vector<std::pair<int, int> > &pairs) {
+	const SpaceObject* objects[2] = { o1, o2 };
+	const std::vector<ConvexHull3D::PartNode>* trees[2];
+	Eigen::Matrix3d rotations[2];
+
+	for (int k = 0; k < 2; ++k) {
+		const osg::Quat &orientation = objects[k]->getOrientation();
+		rotations[k] = Eigen::Quaterniond(orientation.w(), orientation.x(), orientation.y(), orientation.z()).toRotationMatrix();
+		trees[k] = isCompoundContact(objects[k]) ? &objects[k]->getConvexHullModel()->getPartTree() : nullptr;
+	}
+
+	pairs.clear();
+
+	// a convex object is a single leaf (-1), a compound starts at the root of its hierarchy
+	std::vector<std::pair<int, int> > stack(1, std::make_pair(trees[0] ? 0 : -1, trees[1] ? 0 : -1));
+
+	while (!stack.empty()) {
+		int nodes[2] = { stack.back().first, stack.back().second };
+		stack.pop_back();
+
+		Eigen::Vector3d centers[2];
+		double radii[2];
+		int parts[2];
+		bool isLeaf[2];
+
+		for (int k = 0; k < 2; ++k) {
+			getPartSphere(objects[k], rotations[k], nodes[k], centers[k], radii[k]);
+			parts[k] = nodes[k] < 0 ? -1 : (*trees[k])[nodes[k]].part;
+			isLeaf[k] = nodes[k] < 0 || parts[k] >= 0;
+		}
+
+		if ((centers[0] - centers[1]).squaredNorm() > (radii[0] + radii[1]) * (radii[0] + radii[1])) {
+			continue;
+		}
+
+		if (isLeaf[0] && isLeaf[1]) {
+			pairs.push_back(std::make_pair(parts[0], parts[1]));
+			continue;
+		}
+
+		int k = isLeaf[0] ? 1 : (isLeaf[1] ? 0 : (radii[0] >= radii[1] ? 0 : 1));
+		const ConvexHull3D::PartNode &node = (*trees[k])[nodes[k]];
+		int children[2] = { node.left, node.right };
+
+		for (int c = 0; c < 2; ++c) {
+			nodes[k] = children[c];
+			stack.push_back(std::make_pair(nodes[0], nodes[1]));
+		}
+	}
+}
+
+
+/**
+ * \brief Test two objects of which at least one is a compound: GJK/EPA is only run for the pairs of parts
+ * whose bounding-spheres overlap, the deepest intersection is the contact of the pair.
+ *
+ * \param o1, o2
+ *      Objects of the pair (o1 has the smaller id).
+ * \param cache
+ *      Output-parameter: Parts and GJK-results of the previous contact, updated for the next frame.
+ * \param collision
+ *      Output-parameter: Collision with all information of the deepest intersection (if there is any).
+ *
+ * \return True if a pair of parts intersects.
+ */
+bool CollisionManager::testCompound(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision) {
+	std::vector<std::pair<int, int> > pairs;
+	collectPartPairs(o1, o2, pairs);
+
+	bool isIntersecting = false;
+	double deepest = 0.0;
+	PairCache next = cache;
+	Collision candidate = collision;
+
+	for (unsigned int i = 0; i < pairs.size(); ++i) {
+		// the warm-start only belongs to the parts of the previous contact
+		bool isCachedPair = pairs[i].first == cache.part1 && pairs[i].second == cache.part2;
+		PairCache partCache = isCachedPair ? cache : PairCache();
+		partCache.part1 = pairs[i].first;
+		partCache.part2 = pairs[i].second;
+
+		ConvexShape shape1 = getPartShape(o1, partCache.part1, partCache.supportVertex1);
+		ConvexShape shape2 = getPartShape(o2, partCache.part2, partCache.supportVertex2);
+
+		bool isPartIntersecting = GjkAlgorithm::intersect(shape1, shape2, partCache.direction, candidate);
+		partCache.supportVertex1 = shape1.getLastVertex();
+		partCache.supportVertex2 = shape2.getLastVertex();
+
+		if (isPartIntersecting) {
+			double depth = candidate.getIntersectionVector().squaredNorm();
+
+			if (!isIntersecting || depth > deepest) {
+				isIntersecting = true;
+				deepest = depth;
+				collision = candidate;
+				next = partCache;
+			}
+		} else if (isCachedPair && !isIntersecting) {
+			next = partCache;
+		}
+	}
+
+	cache = next;
+
+	return isIntersecting;
+}
+
+
+/**
+ * \brief Get the closest point of the parts of a compound to a point (only the parts whose bounding-spheres
+ * are closer than the maximum distance are queried).
+ *
+ * \param compound
+ *      Object with the parts.
+ * \param point
+ *      Query-point.
+ * \param maxDistance
+ *      Maximum distance of the closest point.
+ * \param part, supportVertex
+ *      Output-parameter: Part of the previous query and its support-vertex, updated to the closest part.
+ * \param closest
+ *      Output-parameter: Closest point of the parts (only if a part is closer than maxDistance).
+ * \param isInside
+ *      Output-parameter: True if the point is inside of a part (there is no unique closest point).
+ *
+ * \return True if a part is closer than maxDistance and the point is outside of all queried parts.
+ */
+bool CollisionManager::getClosestPart(SpaceObject *compound, const Eigen::Vector3d &point, double maxDistance, int &part, int &supportVertex,
+	Eigen::Vector3d &closest, bool &isInside) {
+	const std::vector<ConvexHull3D::PartNode> &tree = compound->getConvexHullModel()->getPartTree();
+	const osg::Quat &orientation = compound->getOrientation();
+	Eigen::Matrix3d rotation = Eigen::Quaterniond(orientation.w(), orientation.x(), orientation.y(), orientation.z()).toRotationMatrix();
+
+	double bestDistance = maxDistance;
+	int bestPart = -1;
+	int bestVertex = -1;
+	std::vector<int> stack(1, 0);
+	isInside = false;
+
+	while (!stack.empty()) {
+		int node = stack.back();
+		stack.pop_back();
+
+		Eigen::Vector3d center;
+		double radius;
+		getPartSphere(compound, rotation, node, center, radius);
+
+		if ((point - center).norm() - radius >= bestDistance) {
+			continue;
+		}
+
+		if (tree[node].part < 0) {
+			stack.push_back(tree[node].left);
+			stack.push_back(tree[node].right);
+			continue;
+		}
+
+		int p = tree[node].part;
+		ConvexShape shape = getPartShape(compound, p, p == part ? supportVertex : -1);
+		Eigen::Vector3d partClosest;
+
+		if (!GjkAlgorithm::getClosestPoint(shape, point, partClosest)) {
+			isInside = true;
+			part = p;
+			supportVertex = shape.getLastVertex();
+			return false;
+		}
+
+		double distance = (point - partClosest).norm();
+		if (distance < bestDistance) {
+			bestDistance = distance;
+			bestPart = p;
+			bestVertex = shape.getLastVertex();
+			closest = partClosest;
+		}
+	}
+
+	if (bestPart < 0) {
+		return false;
+	}
+
+	part = bestPart;
+	supportVertex = bestVertex;
+
+	return true;
+}
+
+
+/**
+ * \brief Check if a pair is outside of the region of interest (see setLevelOfDetail()).
+ *
+ * \param o1, o2
+ *      Objects of the pair.
+ *
+ * \return True if the pair is tested as spheres.
+ */
+bool CollisionManager::isCoarsePair(const SpaceObject *o1, const SpaceObject *o2) const {
+	if (_lodRadius <= 0.0) {
+		return false;
+	}
+
+	// two planets are exact spheres anyway
+	if (o1->getShapeType() == SpaceObject::SPHERE && o2->getShapeType() == SpaceObject::SPHERE) {
+		return false;
+	}
+
+	double radiusSq = _lodRadius * _lodRadius;
+	return (o1->getPosition() - _lodCenter).squaredNorm() > radiusSq && (o2->getPosition() - _lodCenter).squaredNorm() > radiusSq;
+}
+
+
+/**
+ * \brief Exact test of a sphere (o1) and a convex-hull (o2).
+ */
+bool CollisionManager::testSphereConvex(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision) {
+	return testSphereAgainstConvex(static_cast<Planet*>(o1), o2, cache, collision);
+}
+
+
+/**
+ * \brief Exact test of a convex-hull (o1) and a sphere (o2).
+ */
+bool CollisionManager::testConvexSphere(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision) {
+	return testSphereAgainstConvex(static_cast<Planet*>(o2), o1, cache, collision);
+}
+
+
+/**
+ * \brief Exact test of two convex-hulls (GJK/EPA, warm-started by the cache).
+ */
+bool CollisionManager::testConvexHulls(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision) {
+	// a pair which was deep in the last frame is sampled in the distance-fields (bounded cost, stable normals), only
+	// the shallow contacts (or a pair without a vertex inside) run EPA
+	if (cache.depth > DEEP_CONTACT_RATIO * std::min(o1->getCoarseRadius(), o2->getCoarseRadius())
+		&& testDistanceFields(o1, o2, collision)) {
+		cache.depth = collision.getIntersectionVector().norm();
+		return true;
+	}
+
+	if (isCompoundContact(o1) || isCompoundContact(o2)) {
+		bool isIntersecting = testCompound(o1, o2, cache, collision);
+		cache.depth = isIntersecting ? collision.getIntersectionVector().norm() : 0.0;
+		return isIntersecting;
+	}
+
+	ConvexShape convexHullP1 = getContactShape(o1, cache.supportVertex1);
+	ConvexShape convexHullP2 = getContactShape(o2, cache.supportVertex2);
+
+	// an approaching pair is first queried for its distance: a separated pair needs no EPA, and its closest
+	// points are the speculative contact if it may close the gap within the step
+	if (cache.speculativeMargin > 0.0) {
+		Eigen::Vector3d closest1, closest2;
+
+		if (GjkAlgorithm::getClosestPoints(convexHullP1, convexHullP2, cache.separation, closest1, closest2)) {
+			double gap = cache.separation.norm();
+
+			if (gap < cache.speculativeMargin) {
+				collision.setUnitNormal(cache.separation / gap);
+				collision.setFirstPOC(closest1);
+				collision.setSecondPOC(closest2);
+				collision.setIntersectionVector(Eigen::Vector3d::Zero());
+				collision.setSeparation(gap);
+			}
+
+			// the direction from the first to the second convex-hull separates them on the Minkowski-sum
+			cache.direction = -cache.separation;
+			cache.supportVertex1 = convexHullP1.getLastVertex();
+			cache.supportVertex2 = convexHullP2.getLastVertex();
+			cache.depth = 0.0;
+
+			return false;
+		}
+	}
+
+	bool isIntersecting = GjkAlgorithm::intersect(convexHullP1, convexHullP2, cache.direction, collision);
+	cache.supportVertex1 = convexHullP1.getLastVertex();
+	cache.supportVertex2 = convexHullP2.getLastVertex();
+	cache.depth = isIntersecting ? collision.getIntersectionVector().norm() : 0.0;
+
+	return isIntersecting;
+}
+
+
+/**
+ * \brief Test a deep contact with the distance-fields of the objects (see DistanceField): the vertices of
+ * each hull are sampled in the field of the other object, the deepest vertex is the contact. The cost only
+ * depends on the number of vertices, the normal is the gradient of the field.
+ *
+ * \param o1, o2
+ *      Objects of the pair (o1 has the smaller id, at least one should have a field).
+ * \param collision
+ *      Output-parameter: Collision with all information of the deepest vertex (if there is any).
+ *
+ * \return True if a vertex is inside of the other object (false => the pair is tested with GJK/EPA).
+ */
+bool CollisionManager::testDistanceFields(SpaceObject *o1, SpaceObject *o2, Collision &collision) {
+	double depth1 = 0.0, depth2 = 0.0;
+	Eigen::Vector3d normal1, normal2, vertex1, vertex2;
+
+	// vertices of o2 in the field of o1 and vice versa
+	bool isInside1 = sampleDistanceField(o1, o2, depth1, normal1, vertex1);
+	bool isInside2 = sampleDistanceField(o2, o1, depth2, normal2, vertex2);
+	if (!isInside1 && !isInside2) {
+		return false;
+	}
+
+	// the normal points from the second to the first object (same as for two spheres)
+	if (isInside1 && (!isInside2 || depth1 >= depth2)) {
+		collision.setUnitNormal(-normal1);
+		collision.setFirstPOC(vertex1 + depth1 * normal1);
+		collision.setSecondPOC(vertex1);
+		collision.setIntersectionVector(collision.getUnitNormal() * -depth1);
+	} else {
+		collision.setUnitNormal(normal2);
+		collision.setFirstPOC(vertex2);
+		collision.setSecondPOC(vertex2 + depth2 * normal2);
+		collision.setIntersectionVector(collision.getUnitNormal() * -depth2);
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Find the deepest vertex of the contact-shape of an object in the distance-field of another object.
+ *
+ * \param field
+ *      Object whose distance-field is sampled.
+ * \param other
+ *      Object whose vertices are sampled (full or coarse hull, see getContactShape()).
+ * \param depth
+ *      Output-parameter: Penetration-depth of the deepest vertex in the global-world-space.
+ * \param normal
+ *      Output-parameter: Unit normal of the surface of the field at the deepest vertex (points outwards).
+ * \param vertex
+ *      Output-parameter: Deepest vertex in the global-world-space.
+ *
+ * \return True if the object has a field and a vertex is inside of it.
+ */
+bool CollisionManager::sampleDistanceField(SpaceObject *field, SpaceObject *other, double &depth, Eigen::Vector3d &normal, Eigen::Vector3d &vertex) {
+	// the field is computed for the full hull (the coarse level is a different shape)
+	const DistanceField* distanceField = isCoarseContact(field) ? nullptr : field->getConvexHullModel()->getDistanceField();
+	if (distanceField == nullptr) {
+		return false;
+	}
+
+	// the field is unscaled like the hull: v = R * s * m + t => m = R^T * (v - t) / s
+	const osg::Quat &q = field->getOrientation();
+	Eigen::Matrix3d rotation = Eigen::Quaterniond(q.w(), q.x(), q.y(), q.z()).toRotationMatrix();
+	double scaling = field->getScaling();
+	Eigen::Matrix3d toModel = rotation.transpose() / scaling;
+	const Eigen::Vector3d &position = field->getPosition();
+
+	const std::vector<Eigen::Vector3d> &vertices = isCoarseContact(other) ? other->getCoarseHull() : other->getConvexHull();
+	double deepest = 0.0;
+	Eigen::Vector3d deepestGradient = Eigen::Vector3d::Zero();
+
+	for (unsigned int i = 0; i < vertices.size(); ++i) {
+		double distance;
+		Eigen::Vector3d gradient;
+
+		if (distanceField->sample(toModel * (vertices[i] - position), distance, gradient) && distance < deepest
+			&& gradient.squaredNorm() > 0.0) {
+			deepest = distance;
+			deepestGradient = gradient;
+			vertex = vertices[i];
+		}
+	}
+
+	if (deepest >= 0.0) {
+		return false;
+	}
+
+	depth = -deepest * scaling;
+	normal = (rotation * deepestGradient).normalized();
+
+	return true;
+}
+
+
+/**
+ * \brief Test a sphere against a convex-hull with a GJK point-query of the center. If the center is inside
+ * the convex-hull, both convex-hulls are tested.
+ *
+ * \param sphere
+ *      Planet of the pair.
+ * \param convex
+ *      Other object of the pair.
+ * \param cache
+ *      Output-parameter: GJK-results of the previous frame, updated for the next one.
+ * \param collision
+ *      Output-parameter: Collision with all information of the intersection (if there is any), or the speculative
+ *      contact of a separated pair.
+ *
+ * \return True if the objects intersect.
+ */
+bool CollisionManager::testSphereAgainstConvex(Planet *sphere, SpaceObject *convex, PairCache &cache, Collision &collision) {
+	bool isSphereFirst = collision.getFirstObject() == sphere;
+	int &supportVertex = isSphereFirst ? cache.supportVertex2 : cache.supportVertex1;
+	int &part = isSphereFirst ? cache.part2 : cache.part1;
+
+	const Eigen::Vector3d &center = sphere->getPosition();
+	Eigen::Vector3d closest;
+	bool isInside = false;
+
+	if (isCompoundContact(convex)) {
+		// only the parts within the radius of the sphere (and the speculative margin) can touch it
+		if (!getClosestPart(convex, center, sphere->getRadius() + cache.speculativeMargin, part, supportVertex, closest, isInside) && !isInside) {
+			return false;
+		}
+	} else {
+		ConvexShape convexHull = getContactShape(convex, supportVertex);
+		isInside = !GjkAlgorithm::getClosestPoint(convexHull, center, closest);
+
+		if (!isInside) {
+			supportVertex = convexHull.getLastVertex();
+		}
+	}
+
+	// Deep penetration (center inside the hull) => no unique closest point, use both convex-hulls
+	if (isInside) {
+		return testConvexHulls(collision.getFirstObject(), collision.getSecondObject(), cache, collision);
+	}
+
+	Eigen::Vector3d toSphere = center - closest;
+	double distance = toSphere.norm();
+	double gap = distance - sphere->getRadius();
+
+	// a separated pair which may close its gap within the step gets a speculative contact
+	if (gap >= 0.0 && gap >= cache.speculativeMargin) {
+		return false;
+	}
+
+	// Normal from the second to the first object (same as for two spheres)
+	Eigen::Vector3d normal = toSphere / distance;
+	Eigen::Vector3d pocSphere = center - sphere->getRadius() * normal;
+
+	if (isSphereFirst) {
+		collision.setUnitNormal(normal);
+		collision.setFirstPOC(pocSphere);
+		collision.setSecondPOC(closest);
+	} else {
+		collision.setUnitNormal(-normal);
+		collision.setFirstPOC(closest);
+		collision.setSecondPOC(pocSphere);
+	}
+
+	if (gap >= 0.0) {
+		collision.setIntersectionVector(Eigen::Vector3d::Zero());
+		collision.setSeparation(gap);
+		return false;
+	}
+
+	collision.setIntersectionVector(collision.getUnitNormal() * gap);
+
+	return true;
+}
+
+
+/**
+ * \brief Continuous test of two convex-hulls over their sweeps of the last step (conservative advancement
+ * with the GJK distance). The contact at the time of impact is reported at the end of the step, with the
+ * distance travelled after the impact as intersection.
+ *
+ * \param o1, o2
+ *      Objects of the pair (o1 has the smaller id).
+ * \param cache
+ *      Output-parameter: Support-vertices of the previous frame, updated for the next one.
+ * \param collision
+ *      Output-parameter: Collision with all information of the impact (if there is any).
+ *
+ * \return True if the objects hit each other during the step.
+ */
+bool CollisionManager::testContinuous(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision) {
+	const ConvexHull3D* model1 = o1->getConvexHullModel();
+	const ConvexHull3D* model2 = o2->getConvexHullModel();
+	ConvexShape convexHullP1(o1->getConvexHull(), model1->getAdjacencyStart(), model1->getAdjacency(), cache.supportVertex1, o1->getConvexHullSoa());
+	ConvexShape convexHullP2(o2->getConvexHull(), model2->getAdjacencyStart(), model2->getAdjacency(), cache.supportVertex2, o2->getConvexHullSoa());
+
+	// the convex-hulls are at the end of the step, o1 moved by motion relative to o2 (the rotation is neglected)
+	Eigen::Vector3d motion = o1->getSweep() - o2->getSweep();
+	Eigen::Vector3d normal = -motion.normalized();
+	Eigen::Vector3d separation;
+	double t = 0.0;
+
+	for (int i = 0; i < CCD_MAX_ITERATIONS; ++i) {
+		if (!GjkAlgorithm::getDistance(convexHullP1, convexHullP2, (t - 1.0) * motion, separation)) {
+			// intersecting at the start of the step => already handled by the discrete test of the last step
+			if (i == 0) return false;
+			break;
+		}
+
+		double distance = separation.norm();
+		normal = separation / distance;
+
+		if (distance < CCD_TOLERANCE) break;
+
+		// advance by the distance over the approaching speed, so the convex-hulls cannot pass each other
+		double approach = -motion.dot(normal);
+		if (approach <= 0.0) return false;
+
+		t += distance / approach;
+		if (t >= 1.0) return false;
+	}
+
+	// points of contact moved with the objects to the end of the step (replaces a speculative contact of the discrete test)
+	collision.setUnitNormal(normal);
+	collision.setSeparation(0.0);
+	collision.setFirstPOC(convexHullP1.getFurthestPoint(-normal));
+	collision.setSecondPOC(convexHullP2.getFurthestPoint(normal));
+	collision.setIntersectionVector(normal * ((1.0 - t) * motion.dot(normal)));
+
+	cache.supportVertex1 = convexHullP1.getLastVertex();
+	cache.supportVertex2 = convexHullP2.getLastVertex();
+
+	return true;
+}
+
+
+Eigen::Matrix3d CollisionManager::getOrthonormalBasis(Eigen::Vector3d v) {
+	Eigen::Vector3d firstTangent;
+	Eigen::Vector3d secondTangent;
+
+	if (fabs(v[0]) > fabs(v[1])) {
+		firstTangent[0] = v[2];
+		firstTangent[1] = 0;
+		firstTangent[2] = -v[0];
+
+		firstTangent.normalize();
+
+		secondTangent[0] = v[1] * firstTangent[0];
+		secondTangent[1] = v[2] * firstTangent[0] - v[0] * firstTangent[2];
+		secondTangent[2] = -v[1] * firstTangent[0];
+	} else {
+		firstTangent[0] = 0;
+		firstTangent[1] = -v[2];
+		firstTangent[2] = v[1];
+
+		firstTangent.normalize();
+
+		secondTangent[0] = v[1] * firstTangent[2] - v[2] * firstTangent[1];
+		secondTangent[1] = -v[0] * firstTangent[2];
+		secondTangent[2] = v[0] * firstTangent[1];
+	}
+
+	Eigen::Matrix3d result;
+	result << v[0], firstTangent[0], secondTangent[0],
+		v[1], firstTangent[1], secondTangent[1],
+		v[2], firstTangent[2], secondTangent[2];
+
+	return result;
+}
+
+
+/**
+ * \brief Respond to all found collisions with a sequential-impulse solver. The contacts are partitioned into
+ * islands (union-find over the objects of the contacts). Islands do not share any object, so they are solved in
+ * parallel: the velocities of an island are relaxed over all of its contacts a fixed number of iterations,
+ * starting with the accumulated impulses of the previous frame. Afterwards the intersections are resolved.
+ * The speculative contacts are solved with the others, but only the touching ones are kept as contacts of the step.
+ *
+ * \param dt
+ *      Time-step of the simulation (the speculative contacts may close their gap within it).
+ * \param bodies
+ *      State of the simulation which is kept in sync with the changed objects.
+ */
+void CollisionManager::respondToCollisions(double dt, BodyState &bodies) {
+	int cntTouching = _contacts.size();
+	_contacts.insert(_contacts.end(), _speculativeContacts.begin(), _speculativeContacts.end());
+
+	const std::vector<Collision> &contacts = _contacts;
+	int cntContacts = contacts.size();
+
+	// union-find over the objects of the contacts
+	typedef std::unordered_map<SpaceObject*, int, std::hash<SpaceObject*>, std::equal_to<SpaceObject*>,
+		FrameAllocator<std::pair<SpaceObject* const, int>>> ObjectIndices;
+	ObjectIndices objectIndices;
+	FrameVector<SpaceObject*> objects;
+	FrameVector<int> parents;
+	FrameVector<ContactConstraint> constraints(cntContacts);
+
+	double maxPenetration = 0.0;
+	for (int i = 0; i < cntContacts; ++i) {
+		maxPenetration = std::max(maxPenetration, contacts[i].getIntersectionVector().norm());
+	}
+
+	Profiler* profiler = Profiler::Instance();
+	profiler->count(Profiler::CONTACTS_RESOLVED, cntTouching);
+	profiler->count(Profiler::SPECULATIVE_CONTACTS, cntContacts - cntTouching);
+	profiler->count(Profiler::MAX_PENETRATION, maxPenetration);
+
+	for (int i = 0; i < cntContacts; ++i) {
+		SpaceObject* pair[2] = { contacts[i].getFirstObject(), contacts[i].getSecondObject() };
+		int indices[2];
+
+		for (int k = 0; k < 2; ++k) {
+			ObjectIndices::iterator it = objectIndices.find(pair[k]);
+
+			if (it == objectIndices.end()) {
+				indices[k] = parents.size();
+				objectIndices[pair[k]] = indices[k];
+				objects.push_back(pair[k]);
+				parents.push_back(indices[k]);
+			} else {
+				indices[k] = it->second;
+			}
+		}
+
+		int root1 = findRoot(parents, indices[0]);
+		int root2 = findRoot(parents, indices[1]);
+		parents[std::max(root1, root2)] = std::min(root1, root2);
+
+		constraints[i].body1 = indices[0];
+		constraints[i].body2 = indices[1];
+	}
+
+	// group the contacts by island (keeps the order of the pairs within an island)
+	FrameVector<int> islandOfRoot(parents.size(), -1);
+	FrameVector<FrameVector<int>> islands;
+
+	for (int i = 0; i < cntContacts; ++i) {
+		int root = findRoot(parents, constraints[i].body1);
+
+		if (islandOfRoot[root] < 0) {
+			islandOfRoot[root] = islands.size();
+			islands.push_back(FrameVector<int>());
+		}
+
+		islands[islandOfRoot[root]].push_back(i);
+	}
+
+	int cntIslands = islands.size();
+	int cntBodies = objects.size();
+
+	// velocities, inverse masses and world inverse inertia-tensors (once per body) of the bodies of all contacts
+	FrameVector<SolverBody> solverBodies(cntBodies);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static, 64)
+#endif
+	for (int i = 0; i < cntBodies; ++i) {
+		SpaceObject* object = objects[i];
+
+		solverBodies[i].inverseMass = 1.0 / object->getMass();
+		solverBodies[i].inverseInertia = object->getWorldInverseMomentOfInertia();
+		solverBodies[i].linearVelocity = object->getLinearVelocity();
+		solverBodies[i].angularVelocity = object->getAngularVelocity();
+	}
+
+	// velocities of the batched islands (6 per body, the islands do not share any body)
+	FrameVector<double> velocities(_isBatchedSolver ? 6 * cntBodies : 0);
+	int cntBatches = 0;
+
+	// accumulated impulses of the previous frame
+	FrameVector<uint64_t> keys(cntContacts);
+	for (int i = 0; i < cntContacts; ++i) {
+		keys[i] = getPairKey(contacts[i].getFirstObject(), contacts[i].getSecondObject());
+
+		std::unordered_map<uint64_t, ContactImpulse>::const_iterator it = _impulseCache.find(keys[i]);
+		if (it != _impulseCache.end()) {
+			constraints[i].normalImpulse = it->second.normal;
+			constraints[i].tangentImpulse = it->second.tangent;
+		}
+	}
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic) reduction(+:cntBatches)
+#endif
+	for (int i = 0; i < cntIslands; ++i) {
+		const FrameVector<int> &island = islands[i];
+
+		for (unsigned int c = 0; c < island.size(); ++c) {
+			prepareContact(dt, contacts[island[c]], solverBodies, constraints[island[c]]);
+		}
+
+		// warm-start with the accumulated impulses of the previous frame
+		for (unsigned int c = 0; c < island.size(); ++c) {
+			const ContactConstraint &constraint = constraints[island[c]];
+			applyImpulse(solverBodies, constraint, constraint.normalImpulse * constraint.normal + constraint.tangentImpulse);
+		}
+
+		// the small islands would mostly fill the batches with empty lanes
+		if (_isBatchedSolver && island.size() >= static_cast<unsigned int>(ContactBatch::LANES)) {
+			cntBatches += solveIslandBatched(island, solverBodies, constraints, velocities);
+			continue;
+		}
+
+		for (int iteration = 0; iteration < _solverIterations; ++iteration) {
+			for (unsigned int c = 0; c < island.size(); ++c) {
+				solveContact(solverBodies, constraints[island[c]]);
+			}
+		}
+	}
+	profiler->count(Profiler::SOLVER_BATCHES, cntBatches);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static, 64)
+#endif
+	for (int i = 0; i < cntBodies; ++i) {
+		objects[i]->setLinearVelocity(solverBodies[i].linearVelocity);
+		objects[i]->setAngularVelocity(solverBodies[i].angularVelocity);
+	}
+
+	// resolve the intersections with the new velocities
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int i = 0; i < cntIslands; ++i) {
+		for (unsigned int c = 0; c < islands[i].size(); ++c) {
+			if (contacts[islands[i][c]].getSeparation() <= 0.0) {
+				separateContact(contacts[islands[i][c]], solverBodies, constraints[islands[i][c]]);
+			}
+		}
+	}
+
+	// keep the state of the simulation in sync (a contact wakes sleeping objects)
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static, 64)
+#endif
+	for (int i = 0; i < cntBodies; ++i) {
+		objects[i]->setSleeping(false);
+		bodies.gather(objects[i]);
+	}
+
+	// only keep the impulses of the current contacts (the contacts keep theirs, e.g. for the fracture)
+	_impulseCache.clear();
+	for (int i = 0; i < cntContacts; ++i) {
+		ContactImpulse &impulse = _impulseCache[keys[i]];
+		impulse.normal = constraints[i].normalImpulse;
+		impulse.tangent = constraints[i].tangentImpulse;
+		_contacts[i].setImpulse(constraints[i].normalImpulse);
+		_contacts[i].setRelativeSpeed(-constraints[i].closingVelocity);
+	}
+
+	_contacts.erase(_contacts.begin() + cntTouching, _contacts.end());
+}
+
+
+/**
+ * \brief Copy the caches of the GJK and the warm-starting into a checkpoint.
+ *
+ * \param bodies
+ *      State of all bodies (the pairs are stored with the indices of the bodies).
+ * \param state
+ *      Output-parameter: State of the checkpoint.
+ */
+void CollisionManager::saveState(const BodyState &bodies, BinaryScene::State &state) const {
+	state.pairBodies.clear();
+	state.pairSupportVertices.clear();
+	state.pairDirections.clear();
+
+	for (std::unordered_map<uint64_t, PairCache>::const_iterator it = _pairCache.begin(); it != _pairCache.end(); ++it) {
+		int i1 = bodies.getIndex(static_cast<long>(it->first >> 32));
+		int i2 = bodies.getIndex(static_cast<long>(it->first & 0xffffffff));
+		if (i1 < 0 || i2 < 0) continue;
+
+		state.pairBodies.push_back(i1);
+		state.pairBodies.push_back(i2);
+		state.pairSupportVertices.push_back(it->second.supportVertex1);
+		state.pairSupportVertices.push_back(it->second.supportVertex2);
+		for (int axis = 0; axis < 3; ++axis) {
+			state.pairDirections.push_back(it->second.direction(axis));
+		}
+	}
+
+	state.impulseBodies.clear();
+	state.impulses.clear();
+
+	for (std::unordered_map<uint64_t, ContactImpulse>::const_iterator it = _impulseCache.begin(); it != _impulseCache.end(); ++it) {
+		int i1 = bodies.getIndex(static_cast<long>(it->first >> 32));
+		int i2 = bodies.getIndex(static_cast<long>(it->first & 0xffffffff));
+		if (i1 < 0 || i2 < 0) continue;
+
+		state.impulseBodies.push_back(i1);
+		state.impulseBodies.push_back(i2);
+		state.impulses.push_back(it->second.normal);
+		for (int axis = 0; axis < 3; ++axis) {
+			state.impulses.push_back(it->second.tangent(axis));
+		}
+	}
+}
+
+
+/**
+ * \brief Restore the caches of the GJK and the warm-starting from a checkpoint.
+ *
+ * \param bodies
+ *      State of all bodies (the indices of the pairs are mapped to the ids of the bodies).
+ * \param state
+ *      State of the checkpoint.
+ */
+void CollisionManager::restoreState(const BodyState &bodies, const BinaryScene::State &state) {
+	unsigned int n = bodies.size();
+
+	_pairCache.clear();
+	for (unsigned int p = 0; p < state.pairBodies.size() / 2; ++p) {
+		uint32_t i1 = state.pairBodies[2 * p];
+		uint32_t i2 = state.pairBodies[2 * p + 1];
+		if (i1 >= n || i2 >= n) continue;
+
+		PairCache &cache = _pairCache[static_cast<uint64_t>(bodies.id[i1]) << 32 | static_cast<uint32_t>(bodies.id[i2])];
+		cache.supportVertex1 = state.pairSupportVertices[2 * p];
+		cache.supportVertex2 = state.pairSupportVertices[2 * p + 1];
+		cache.direction = Eigen::Vector3d(state.pairDirections[3 * p], state.pairDirections[3 * p + 1], state.pairDirections[3 * p + 2]);
+	}
+
+	_impulseCache.clear();
+	for (unsigned int c = 0; c < state.impulseBodies.size() / 2; ++c) {
+		uint32_t i1 = state.impulseBodies[2 * c];
+		uint32_t i2 = state.impulseBodies[2 * c + 1];
+		if (i1 >= n || i2 >= n) continue;
+
+		ContactImpulse &impulse = _impulseCache[static_cast<uint64_t>(bodies.id[i1]) << 32 | static_cast<uint32_t>(bodies.id[i2])];
+		impulse.normal = state.impulses[4 * c];
+		impulse.tangent = Eigen::Vector3d(state.impulses[4 * c + 1], state.impulses[4 * c + 2], state.impulses[4 * c + 3]);
+	}
+}
+
+
+/**
+ * \brief Get the root of an element in the union-find (with path-halving).
+ *
+ * \param parents
+ *      Output-parameter: Parent per element (the paths are shortened).
+ * \param i
+ *      Element to search the root of.
+ *
+ * \return Root of the element.
+ */
+int CollisionManager::findRoot(FrameVector<int> &parents, int i) {
+	while (parents[i] != i) {
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+
+	return i;
+}
+
+
+/**
+ * \brief Get the key of a pair in the caches of the previous frame.
+ *
+ * \param o1, o2
+ *      Objects of the pair (o1 has the smaller id).
+ *
+ * \return Key of the pair (id1 << 32 | id2).
+ */
+uint64_t CollisionManager::getPairKey(const SpaceObject *o1, const SpaceObject *o2) {
+	return static_cast<uint64_t>(o1->getId()) << 32 | static_cast<uint32_t>(o2->getId());
+}
+
+
+/**
+ * \brief Precompute the lever-arms, the contact-basis, the effective masses and the restitution of a contact
+ * (before any impulse of this frame is applied).
+ *
+ * \param dt
+ *      Time-step of the simulation.
+ * \param collision
+ *      Collision of the contact.
+ * \param solverBodies
+ *      Velocities of the bodies.
+ * \param constraint
+ *      Output-parameter: Constraint of the contact (the bodies and the accumulated impulses are set).
+ */
+void CollisionManager::prepareContact(double dt, const Collision &collision, const FrameVector<SolverBody> &solverBodies, ContactConstraint &constraint) const {
+	const SolverBody &body1 = solverBodies[constraint.body1];
+	const SolverBody &body2 = solverBodies[constraint.body2];
+
+	constraint.r1 = collision.getFirstPOC() - collision.getFirstObject()->getPosition();
+	constraint.r2 = collision.getSecondPOC() - collision.getSecondObject()->getPosition();
+
+	Eigen::Matrix3d basis = getOrthonormalBasis(collision.getUnitNormal());
+	constraint.normal = basis.col(0);
+	constraint.tangents[0] = basis.col(1);
+	constraint.tangents[1] = basis.col(2);
+
+	const Eigen::Vector3d* axes[3] = { &constraint.normal, &constraint.tangents[0], &constraint.tangents[1] };
+	double* masses[3] = { &constraint.normalMass, &constraint.tangentMass[0], &constraint.tangentMass[1] };
+
+	for (int k = 0; k < 3; ++k) {
+		const Eigen::Vector3d &axis = *axes[k];
+		Eigen::Vector3d rn1 = constraint.r1.cross(axis);
+		Eigen::Vector3d rn2 = constraint.r2.cross(axis);
+
+		double inverseMass = body1.inverseMass + body2.inverseMass
+			+ rn1.dot(body1.inverseInertia * rn1) + rn2.dot(body2.inverseInertia * rn2);
+
+		*masses[k] = inverseMass > 0.0 ? 1.0 / inverseMass : 0.0;
+	}
+
+	// the restitution is based on the approaching velocity before the impulses of this frame
+	double closingVelocity = getRelativeVelocity(solverBodies, constraint).dot(constraint.normal);
+	constraint.velocityBias = closingVelocity < -RESTITUTION_THRESHOLD ? -_restitution * closingVelocity : 0.0;
+	constraint.closingVelocity = closingVelocity;
+
+	// a speculative contact allows the approach which just closes the gap within the step (no restitution)
+	if (collision.getSeparation() > 0.0 && dt > 0.0) {
+		constraint.velocityBias = -collision.getSeparation() / dt;
+	}
+
+	// the tangential impulse is projected onto the new contact-plane
+	constraint.tangentImpulse -= constraint.tangentImpulse.dot(constraint.normal) * constraint.normal;
+}
+
+
+/**
+ * \brief Relax the velocities of one contact: Friction-impulse (clamped to the friction-cone of the accumulated
+ * normal-impulse) and normal-impulse (the accumulated impulse only pushes the objects apart).
+ *
+ * \param solverBodies
+ *      Output-parameter: Velocities of the bodies.
+ * \param constraint
+ *      Output-parameter: Constraint of the contact with its accumulated impulses.
+ */
+void CollisionManager::solveContact(FrameVector<SolverBody> &solverBodies, ContactConstraint &constraint) const {
+	// friction
+	Eigen::Vector3d relativeVelocity = getRelativeVelocity(solverBodies, constraint);
+	Eigen::Vector3d tangentImpulse = constraint.tangentImpulse
+		- constraint.tangentMass[0] * relativeVelocity.dot(constraint.tangents[0]) * constraint.tangents[0]
+		- constraint.tangentMass[1] * relativeVelocity.dot(constraint.tangents[1]) * constraint.tangents[1];
+
+	double maxTangentImpulse = _friction * constraint.normalImpulse;
+	double tangentNorm = tangentImpulse.norm();
+	if (tangentNorm > maxTangentImpulse) {
+		tangentImpulse *= maxTangentImpulse / tangentNorm;
+	}
+
+	applyImpulse(solverBodies, constraint, tangentImpulse - constraint.tangentImpulse);
+	constraint.tangentImpulse = tangentImpulse;
+
+	// normal
+	double normalVelocity = getRelativeVelocity(solverBodies, constraint).dot(constraint.normal);
+	double normalImpulse = std::max(constraint.normalImpulse + constraint.normalMass * (constraint.velocityBias - normalVelocity), 0.0);
+
+	applyImpulse(solverBodies, constraint, (normalImpulse - constraint.normalImpulse) * constraint.normal);
+	constraint.normalImpulse = normalImpulse;
+}
+
+
+/**
+ * \brief Relax the velocities of an island with the vectorized solver (see setIsBatchedSolver()). The contacts are
+ * greedily colored in their order: each contact is put into the first of the most recent batches which has a free lane
+ * and none of its bodies (a body is at most once in a batch), otherwise a new batch is started. The batches are then
+ * relaxed in this order for the same number of iterations as the scalar solver.
+ *
+ * \param island
+ *      Indices of the contacts of the island (prepared and warm-started).
+ * \param solverBodies
+ *      Output-parameter: Velocities of the bodies.
+ * \param constraints
+ *      Output-parameter: Constraints of the contacts with their accumulated impulses.
+ * \param velocities
+ *      Output-parameter: Flat velocities of all bodies (6 per body, only the ones of this island are used).
+ *
+ * \return Number of batches.
+ */
+int CollisionManager::solveIslandBatched(const FrameVector<int> &island, FrameVector<SolverBody> &solverBodies,
+	FrameVector<ContactConstraint> &constraints, FrameVector<double> &velocities) const {
+	const int lanes = ContactBatch::LANES;
+
+	// color the contacts (the bodies per batch, 2 per lane)
+	FrameVector<int> batchContacts;
+	FrameVector<int> batchBodies;
+	FrameVector<int> batchSizes;
+	int firstOpen = 0;
+
+	for (unsigned int c = 0; c < island.size(); ++c) {
+		const ContactConstraint &constraint = constraints[island[c]];
+		int cntBatches = batchSizes.size();
+		int batch = std::max(firstOpen, cntBatches - MAX_OPEN_BATCHES);
+
+		for (; batch < cntBatches; ++batch) {
+			if (batchSizes[batch] == lanes) continue;
+
+			bool isFree = true;
+			for (int k = 0; k < 2 * batchSizes[batch] && isFree; ++k) {
+				int body = batchBodies[2 * lanes * batch + k];
+				isFree = body != constraint.body1 && body != constraint.body2;
+			}
+
+			if (isFree) break;
+		}
+
+		if (batch == cntBatches) {
+			batchContacts.resize(lanes * (cntBatches + 1), -1);
+			batchBodies.resize(2 * lanes * (cntBatches + 1), -1);
+			batchSizes.push_back(0);
+		}
+
+		int lane = batchSizes[batch]++;
+		batchContacts[lanes * batch + lane] = island[c];
+		batchBodies[2 * lanes * batch + 2 * lane] = constraint.body1;
+		batchBodies[2 * lanes * batch + 2 * lane + 1] = constraint.body2;
+
+		while (firstOpen < static_cast<int>(batchSizes.size()) && batchSizes[firstOpen] == lanes) {
+			++firstOpen;
+		}
+	}
+
+	// pack the constraints and the warm-started velocities
+	int cntBatches = batchSizes.size();
+	FrameVector<ContactBatch> batches(cntBatches);
+
+	for (int batch = 0; batch < cntBatches; ++batch) {
+		for (int lane = 0; lane < batchSizes[batch]; ++lane) {
+			const ContactConstraint &constraint = constraints[batchContacts[lanes * batch + lane]];
+			const SolverBody &body1 = solverBodies[constraint.body1];
+			const SolverBody &body2 = solverBodies[constraint.body2];
+
+			Eigen::Vector3d axes[3] = { constraint.normal, constraint.tangents[0], constraint.tangents[1] };
+			double masses[3] = { constraint.normalMass, constraint.tangentMass[0], constraint.tangentMass[1] };
+			double impulses[3] = { constraint.normalImpulse, constraint.tangentImpulse.dot(constraint.tangents[0]),
+				constraint.tangentImpulse.dot(constraint.tangents[1]) };
+
+			batches[batch].setLane(lane, constraint.body1, constraint.body2, body1.inverseMass, body2.inverseMass,
+				body1.inverseInertia, body2.inverseInertia, constraint.r1, constraint.r2, axes, masses,
+				constraint.velocityBias, impulses);
+		}
+	}
+
+	for (unsigned int c = 0; c < island.size(); ++c) {
+		const ContactConstraint &constraint = constraints[island[c]];
+		int bodies[2] = { constraint.body1, constraint.body2 };
+
+		for (int k = 0; k < 2; ++k) {
+			const SolverBody &body = solverBodies[bodies[k]];
+			Eigen::Map<Eigen::Vector3d>(&velocities[6 * bodies[k]]) = body.linearVelocity;
+			Eigen::Map<Eigen::Vector3d>(&velocities[6 * bodies[k] + 3]) = body.angularVelocity;
+		}
+	}
+
+	for (int iteration = 0; iteration < _solverIterations; ++iteration) {
+		for (int batch = 0; batch < cntBatches; ++batch) {
+			batches[batch].solve(velocities.data(), _friction);
+		}
+	}
+
+	// unpack the velocities and the accumulated impulses
+	for (unsigned int c = 0; c < island.size(); ++c) {
+		const ContactConstraint &constraint = constraints[island[c]];
+		int bodies[2] = { constraint.body1, constraint.body2 };
+
+		for (int k = 0; k < 2; ++k) {
+			SolverBody &body = solverBodies[bodies[k]];
+			body.linearVelocity = Eigen::Map<const Eigen::Vector3d>(&velocities[6 * bodies[k]]);
+			body.angularVelocity = Eigen::Map<const Eigen::Vector3d>(&velocities[6 * bodies[k] + 3]);
+		}
+	}
+
+	for (int batch = 0; batch < cntBatches; ++batch) {
+		for (int lane = 0; lane < batchSizes[batch]; ++lane) {
+			ContactConstraint &constraint = constraints[batchContacts[lanes * batch + lane]];
+
+			constraint.normalImpulse = batches[batch].getImpulse(lane, 0);
+			constraint.tangentImpulse = batches[batch].getImpulse(lane, 1) * constraint.tangents[0]
+				+ batches[batch].getImpulse(lane, 2) * constraint.tangents[1];
+		}
+	}
+
+	return cntBatches;
+}
+
+
+/**
+ * \brief Apply an impulse at the points of contact (positive on the first, negative on the second object).
+ *
+ * \param solverBodies
+ *      Output-parameter: Velocities of the bodies.
+ * \param constraint
+ *      Constraint of the contact.
+ * \param impulse
+ *      Impulse in world-coordinates.
+ */
+void CollisionManager::applyImpulse(FrameVector<SolverBody> &solverBodies, const ContactConstraint &constraint, const Eigen::Vector3d &impulse) {
+	SolverBody &body1 = solverBodies[constraint.body1];
+	SolverBody &body2 = solverBodies[constraint.body2];
+
+	body1.linearVelocity += body1.inverseMass * impulse;
+	body1.angularVelocity += body1.inverseInertia * constraint.r1.cross(impulse);
+
+	body2.linearVelocity -= body2.inverseMass * impulse;
+	body2.angularVelocity -= body2.inverseInertia * constraint.r2.cross(impulse);
+}
+
+
+/**
+ * \brief Get the velocity of the point of contact of the first object relative to the one of the second object.
+ *
+ * \param solverBodies
+ *      Velocities of the bodies.
+ * \param constraint
+ *      Constraint of the contact.
+ *
+ * \return Relative velocity.
+ */
+Eigen::Vector3d CollisionManager::getRelativeVelocity(const FrameVector<SolverBody> &solverBodies, const ContactConstraint &constraint) {
+	const SolverBody &body1 = solverBodies[constraint.body1];
+	const SolverBody &body2 = solverBodies[constraint.body2];
+
+	return body1.linearVelocity + body1.angularVelocity.cross(constraint.r1)
+		- body2.linearVelocity - body2.angularVelocity.cross(constraint.r2);
+}
+
+
+/**
+ * \brief Resolve the intersection of a contact by moving and rotating both objects (relative to their inertia).
+ *
+ * \param currentCollision
+ *      Collision to resolve.
+ * \param solverBodies
+ *      Inverse masses and inertia-tensors of the bodies (shared by all contacts of a body).
+ * \param constraint
+ *      Constraint of the contact.
+ */
+void CollisionManager::separateContact(const Collision &currentCollision, const FrameVector<SolverBody> &solverBodies, const ContactConstraint &constraint) const {
+	SpaceObject* object1 = currentCollision.getFirstObject();
+	SpaceObject* object2 = currentCollision.getSecondObject();
+
+	const Eigen::Matrix3d &foInverseInertia = solverBodies[constraint.body1].inverseInertia;
+	const Eigen::Matrix3d &soInverseInertia = solverBodies[constraint.body2].inverseInertia;
+
+	double angI1 = ((foInverseInertia * (currentCollision.getFirstPOC() - object1->getPosition()).cross(currentCollision.getUnitNormal())).cross(currentCollision.getFirstPOC() - object1->getPosition())).dot(currentCollision.getUnitNormal());
+	double angI2 = ((soInverseInertia * (currentCollision.getSecondPOC() - object2->getPosition()).cross(currentCollision.getUnitNormal())).cross(currentCollision.getSecondPOC() - object2->getPosition())).dot(currentCollision.getUnitNormal());
+	
+	double linI1 = solverBodies[constraint.body1].inverseMass;
+	double linI2 = solverBodies[constraint.body2].inverseMass;
+
+	double ratio1 = linI1 / (linI1 + linI2);
+	double ratio2 = 1 - ratio1;
+	/*if (angI1 > 0.5) {
+		linI1 += (angI1 - 0.5)*ratio1;
+		linI2 += (angI1 - 0.5)*ratio2;
+	}
+
+	if (angI2 > 0.5) {
+		linI1 += (angI2 - 0.5)*ratio1;
+		linI2 += (angI2 - 0.5)*ratio2;
+	}*/
+	double totalInertia = angI1 + angI2 + linI1 + linI2;
+	double inverseInertia = 1 / totalInertia;
+
+	double linMov1 = currentCollision.getIntersectionVector().norm() * linI1 * inverseInertia;
+	double linMov2 = currentCollision.getIntersectionVector().norm() * linI2 * inverseInertia;
+
+	double angMov1 = currentCollision.getIntersectionVector().norm() * angI1 * inverseInertia;
+	double angMov2 = currentCollision.getIntersectionVector().norm() * angI2 * inverseInertia;
+
+	Eigen::Vector3d newPos1 = object1->getPosition() + linMov1 * currentCollision.getUnitNormal();
+	Eigen::Vector3d newPos2 = object2->getPosition() - linMov2 * currentCollision.getUnitNormal();
+
+	Eigen::Vector3d rot1, rot2;
+	if (angI1 > 0.001)
+		rot1 = (foInverseInertia * (currentCollision.getFirstPOC() - object1->getPosition()).cross(currentCollision.getUnitNormal())) * 1 / angI1 * angMov1;
+	else
+		rot1 = Eigen::Vector3d(0,0,0);
+	if (angI2 > 0.001)
+		rot2 = (soInverseInertia * (currentCollision.getSecondPOC() - object2->getPosition()).cross(currentCollision.getUnitNormal())) * 1 / angI2 * angMov2;
+	else
+		rot2 = Eigen::Vector3d(0, 0, 0);
+	Eigen::Quaterniond rotation1 = BodyState::getRotation(rot1);
+	Eigen::Quaterniond rotation2 = BodyState::getRotation(rot2);
+	osg::Quat q1(rotation1.x(), rotation1.y(), rotation1.z(), rotation1.w());
+	osg::Quat q2(rotation2.x(), rotation2.y(), rotation2.z(), rotation2.w());
+
+	q1 = q1 * object1->getOrientation();
+	q2 = q2 * object2->getOrientation();
+
+	object1->setPositionOrientation(newPos1, q1);
+	object2->setPositionOrientation(newPos2, q2);
+}
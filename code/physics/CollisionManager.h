@@ -8,14 +8,27 @@
 #pragma once
 
 #include <vector>
-#include <queue>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <OpenThreads/Mutex>
 
 #include "Collision.h"
+#include "FrameArena.h"
+#include "AabbArray.h"
+#include "SweepAndPrune.h"
+#include "AabbTree.h"
+#include "SpatialHash.h"
+#include "../scene/BinaryScene.h"
+#include "../graphics/ConvexShape.h"
 #include <Eigen/Core>
 
 // Forward declarations
 namespace pbs17 {
 	class Planet;
+	class BodyState;
 }
 
 namespace pbs17 {
@@ -26,6 +39,23 @@ namespace pbs17 {
     class CollisionManager
     {
     public:
+        /**
+        * \brief Available methods to find the possible collisions.
+        */
+        enum BroadPhase {
+            //! Persistent sweep-and-prune on all three axes
+            INCREMENTAL_SAP,
+            //! Sweep-and-prune along the axis of the largest variance
+            SINGLE_AXIS_SAP,
+            //! Dynamic AABB-tree with fat AABBs
+            AABB_TREE,
+            //! Hashed uniform grid (or the cells of the gravity-grid)
+            SPATIAL_HASH,
+            //! Sweep-and-prune along the axis of the largest variance on the GPU (CUDA)
+            GPU_SAP
+        };
+
+
         /**
         * \brief Constructor of the CollisionManager.
         *
@@ -33,6 +63,34 @@ namespace pbs17 {
         CollisionManager(std::vector<SpaceObject*> _spaceObjects);
 
 
+		/**
+		 * \brief Replace the checked objects (e.g. the bodies and ghosts of a domain), the broad-phase is
+		 *        initialized again.
+		 *
+		 * \param spaceObjects
+		 *      Space-objects which are checked for collisions.
+		 */
+		void setSpaceObjects(const std::vector<SpaceObject*> &spaceObjects);
+
+
+		/**
+		 * \brief Append a checked object (e.g. a spawned body), only the current broad-phase is updated.
+		 *
+		 * \param spaceObject
+		 *      Space-object which is checked from now on (gets the last index).
+		 */
+		void addSpaceObject(SpaceObject* spaceObject);
+
+
+		/**
+		 * \brief Remove a checked object, the last object is moved to its index (same as BodyState::remove()).
+		 *
+		 * \param i
+		 *      Index of the removed object.
+		 */
+		void removeSpaceObject(unsigned int i);
+
+
         /**
         * \brief Simulate the scene.
         *
@@ -40,31 +98,886 @@ namespace pbs17 {
         *      Time difference since between the last frames.
         * \param spaceObjects
         *      All space-objects in the scene.
+        * \param bodies
+        *      State of all bodies, which is updated for the colliding objects.
+        * \param isPrepared
+        *      True if prepareObjects() was already called for all objects (e.g. by the pipeline of the simulation).
+        */
+        void handleCollisions(double dt, std::vector<SpaceObject*> &spaceObjects, BodyState &bodies, bool isPrepared = false);
+
+
+		/**
+		 * \brief Prepare a range of the objects for the broad-phase: reset their collision-state and set the sweep
+		 *        of the objects which are checked continuously. Only needs the AABBs of these objects after the step.
+		 *
+		 * \param dt
+		 *      Time difference since between the last frames.
+		 * \param spaceObjects
+		 *      All space-objects in the scene.
+		 * \param first, last
+		 *      Range of the prepared objects (last is excluded).
+		 */
+		void prepareObjects(double dt, const std::vector<SpaceObject*> &spaceObjects, int first, int last) const;
+
+
+        /**
+        * \brief Set the method to find the possible collisions.
+        *
+        * \param broadPhase
+        *      New broad-phase.
+        */
+        void setBroadPhase(BroadPhase broadPhase);
+
+
+        /**
+        * \brief Get the method to find the possible collisions.
+        *
+        * \return Current broad-phase.
+        */
+        BroadPhase getBroadPhase() const {
+            return _broadPhase;
+        }
+
+
+        /**
+        * \brief Convert the name of a broad-phase (incremental, singleAxis, aabbTree, spatialHash, gpu) to its value.
+        *
+        * \param name
+        *      Name of the broad-phase as used in the scene-json and on the command-line.
+        * \param broadPhase
+        *      Parsed broad-phase (unchanged if the name is unknown).
+        *
+        * \return True if the name is known.
+        */
+        static bool parseBroadPhase(const std::string &name, BroadPhase &broadPhase);
+
+
+        /**
+        * \brief Get the AABB-tree (e.g. for ray- and region-queries, only up to date if it is the broad-phase).
+        *
+        * \return AABB-tree.
+        */
+        AabbTree& getAabbTree() {
+            return _aabbTree;
+        }
+
+
+        /**
+        * \brief Hit of a ray-cast on the exact shape of an object.
+        */
+        struct RayHit {
+            //! Hit object (nullptr => nothing is hit)
+            SpaceObject* object = nullptr;
+            //! Distance along the normalized direction
+            double distance = std::numeric_limits<double>::infinity();
+            //! Point of the surface which is hit
+            Eigen::Vector3d point = Eigen::Vector3d::Zero();
+            //! Outward normal of the surface at the point (-direction if the ray starts inside)
+            Eigen::Vector3d normal = Eigen::Vector3d::Zero();
+        };
+
+
+        /**
+        * \brief Cast a ray against the exact shapes of the objects (spheres or convex-hulls). The candidates are the
+        *        objects whose AABB is hit, in the order of the entry-distance, until a candidate is further away than
+        *        the closest exact hit.
+        *
+        *        All queries run on the AABB-tree: the one of the broad-phase, or a query-tree which is built from the
+        *        AABBs of the last step when the first query after it is made. They can be called concurrently by
+        *        any thread, but not while a step is simulated (see SimulationManager::getStateMutex()).
+        *
+        * \param origin
+        *      Start of the ray.
+        * \param direction
+        *      Direction of the ray (is normalized).
+        * \param maxDistance
+        *      Maximum distance of the hit.
+        * \param hit
+        *      Output-parameter: Closest hit (object is nullptr if nothing is hit).
+        *
+        * \return True if an object is hit.
+        */
+        bool rayCast(const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double maxDistance, RayHit &hit);
+
+
+        /**
+        * \brief Cast a batch of rays in parallel (see rayCast()).
+        *
+        * \param origins
+        *      Start of the rays.
+        * \param directions
+        *      Direction of the rays (are normalized).
+        * \param maxDistance
+        *      Maximum distance of the hits.
+        * \param hits
+        *      Output-parameter: Closest hit per ray (overwritten).
+        */
+        void rayCast(const std::vector<Eigen::Vector3d> &origins, const std::vector<Eigen::Vector3d> &directions, double maxDistance, std::vector<RayHit> &hits);
+
+
+        /**
+        * \brief Get all objects whose exact shape overlaps with a sphere (see rayCast() for the thread-safety).
+        *
+        * \param center
+        *      Center of the sphere.
+        * \param radius
+        *      Radius of the sphere.
+        * \param res
+        *      Output-parameter: Overlapping objects (overwritten).
+        */
+        void querySphere(const Eigen::Vector3d &center, double radius, std::vector<SpaceObject*> &res);
+
+
+        /**
+        * \brief Get all objects whose exact shape overlaps with a box (see rayCast() for the thread-safety).
+        *
+        * \param box
+        *      Axis-aligned box in the world-space.
+        * \param res
+        *      Output-parameter: Overlapping objects (overwritten).
+        */
+        void queryBox(const osg::BoundingBox &box, std::vector<SpaceObject*> &res);
+
+
+        /**
+        * \brief Get the k objects whose centers are closest to a point (see rayCast() for the thread-safety).
+        *
+        * \param point
+        *      Point in the world-space.
+        * \param k
+        *      Maximum number of objects.
+        * \param res
+        *      Output-parameter: Closest objects, ordered by the distance (overwritten).
+        * \param maxDistance
+        *      Maximum distance of the centers.
+        */
+        void queryNearest(const Eigen::Vector3d &point, unsigned int k, std::vector<SpaceObject*> &res,
+                          double maxDistance = std::numeric_limits<double>::infinity());
+
+
+        /**
+        * \brief Get the k nearest objects of a batch of points in parallel (see queryNearest()).
+        *
+        * \param points
+        *      Points in the world-space.
+        * \param k
+        *      Maximum number of objects per point.
+        * \param res
+        *      Output-parameter: Closest objects per point, ordered by the distance (overwritten).
+        * \param maxDistance
+        *      Maximum distance of the centers.
+        */
+        void queryNearest(const std::vector<Eigen::Vector3d> &points, unsigned int k, std::vector<std::vector<SpaceObject*>> &res,
+                          double maxDistance = std::numeric_limits<double>::infinity());
+
+
+        /**
+        * \brief Get the spatial-hash (e.g. to set its cell-size).
+        *
+        * \return Spatial-hash.
+        */
+        SpatialHash& getSpatialHash() {
+            return _spatialHash;
+        }
+
+
+        /**
+        * \brief Reuse the cells of the gravity-grid for the spatial-hash broad-phase. The grid has to be updated
+        *        to the current positions before the collisions are handled.
+        *
+        * \param grid
+        *      Gravity-grid (nullptr => the spatial-hash uses its own cells).
+        */
+        void setSharedGrid(const SpatialGrid* grid) {
+            _sharedGrid = grid;
+        }
+
+
+        /**
+        * \brief Get the gravity-grid whose cells are reused.
+        *
+        * \return Gravity-grid (nullptr if the own cells are used).
+        */
+        const SpatialGrid* getSharedGrid() const {
+            return _sharedGrid;
+        }
+
+
+        /**
+        * \brief Get the contacts of the last step (in the order of the pairs).
+        *
+        * \return Contacts which have been resolved.
         */
-        void handleCollisions(double dt, std::vector<SpaceObject*> &spaceObjects);
+        const std::vector<Collision>& getContacts() const {
+            return _contacts;
+        }
+
+
+		/**
+		 * \brief Get the shortest time until two objects of the broad-phase pairs penetrate each other deeper than
+		 *        the motion-ratio of the continuous test, if they keep their velocities (e.g. for an adaptive time-step).
+		 *
+		 * \return Time of impact of the coarse spheres of the last narrow-phase (infinity => no pair approaches).
+		 */
+		double getMinApproachTime() const {
+			return _minApproachTime;
+		}
+
+
+		/**
+		 * \brief Copy the caches of the GJK and the warm-starting into a checkpoint.
+		 *
+		 * \param bodies
+		 *      State of all bodies (the pairs are stored with the indices of the bodies).
+		 * \param state
+		 *      Output-parameter: State of the checkpoint.
+		 */
+		void saveState(const BodyState &bodies, BinaryScene::State &state) const;
+
+
+		/**
+		 * \brief Restore the caches of the GJK and the warm-starting from a checkpoint.
+		 *
+		 * \param bodies
+		 *      State of all bodies (the indices of the pairs are mapped to the ids of the bodies).
+		 * \param state
+		 *      State of the checkpoint.
+		 */
+		void restoreState(const BodyState &bodies, const BinaryScene::State &state);
+
+
+        /**
+        * \brief Set the number of iterations of the contact-solver.
+        *
+        * \param iterations
+        *      Iterations over all contacts of an island per frame (at least 1).
+        */
+        void setSolverIterations(const int iterations) {
+            _solverIterations = iterations < 1 ? 1 : iterations;
+        }
+
+
+        /**
+        * \brief Get the number of iterations of the contact-solver.
+        *
+        * \return Iterations per frame.
+        */
+        int getSolverIterations() const {
+            return _solverIterations;
+        }
+
+
+		/**
+		 * \brief Enable or disable the vectorized contact-solver. The contacts of the larger islands are partitioned
+		 *        into batches of ContactBatch::LANES contacts without a common body, which are relaxed together with
+		 *        SIMD-lanes. The iterations are the same, only the order of the contacts within an island changes.
+		 *
+		 * \param isBatchedSolver
+		 *      True to solve the contacts in batches.
+		 */
+		void setIsBatchedSolver(const bool isBatchedSolver) {
+			_isBatchedSolver = isBatchedSolver;
+		}
+
+
+		/**
+		 * \brief Check if the contacts are solved in batches (see setIsBatchedSolver()).
+		 *
+		 * \return True if the vectorized contact-solver is used.
+		 */
+		bool getIsBatchedSolver() const {
+			return _isBatchedSolver;
+		}
+
+
+		/**
+		 * \brief Set the coefficient of restitution of the contacts.
+		 *
+		 * \param restitution
+		 *      Ratio of the separating to the closing velocity (0 => inelastic, 1 => elastic).
+		 */
+		void setRestitution(const double restitution) {
+			_restitution = std::max(0.0, std::min(restitution, 1.0));
+		}
+
+
+		/**
+		 * \brief Get the coefficient of restitution of the contacts.
+		 *
+		 * \return Coefficient of restitution.
+		 */
+		double getRestitution() const {
+			return _restitution;
+		}
+
+
+		/**
+		 * \brief Set the coefficient of friction of the contacts.
+		 *
+		 * \param friction
+		 *      Ratio of the maximal tangent to the normal impulse (at least 0).
+		 */
+		void setFriction(const double friction) {
+			_friction = std::max(0.0, friction);
+		}
+
+
+		/**
+		 * \brief Get the coefficient of friction of the contacts.
+		 *
+		 * \return Coefficient of friction.
+		 */
+		double getFriction() const {
+			return _friction;
+		}
+
+
+		/**
+		 * \brief Sort the pairs of the broad-phase by the ids of their objects, so the contacts and the islands
+		 *        (grouped in the order of the contacts) do not depend on the number of threads.
+		 *
+		 * \param isDeterministic
+		 *      True to sort the pairs.
+		 */
+		void setIsDeterministic(const bool isDeterministic) {
+			_isDeterministic = isDeterministic;
+		}
+
+
+		/**
+		 * \brief Enable or disable the collision-detection (e.g. for gravity-only scenes). While it is disabled,
+		 *        handleCollisions() returns without running the broad-phase.
+		 *
+		 * \param isEnabled
+		 *      False to skip the collisions.
+		 */
+		void setIsEnabled(const bool isEnabled) {
+			_isEnabled = isEnabled;
+		}
+
+
+		/**
+		 * \brief Check if the collision-detection is enabled.
+		 *
+		 * \return False if the collisions are skipped.
+		 */
+		bool getIsEnabled() const {
+			return _isEnabled;
+		}
+
+
+		/**
+		 * \brief Enable or disable the speculative contacts: the approaching pairs of convex-hulls and spheres which
+		 *        are still separated get a contact with their closest points (GJK distance-query), which only stops the
+		 *        part of the approach that would close the gap within the step. They are solved with the touching
+		 *        contacts, but not reported (see getContacts()).
+		 *
+		 * \param isSpeculative
+		 *      True to prevent the penetrations before they happen.
+		 */
+		void setIsSpeculative(const bool isSpeculative) {
+			_isSpeculative = isSpeculative;
+		}
+
+
+		/**
+		 * \brief Check if the speculative contacts are enabled.
+		 *
+		 * \return True if the approaching pairs get speculative contacts.
+		 */
+		bool getIsSpeculative() const {
+			return _isSpeculative;
+		}
+
+
+		/**
+		 * \brief Set the size below which the objects collide with the coarse level of their convex-hull (see
+		 *        ConvexHull3D::getCoarseVertices()), e.g. for small debris. Larger objects only use the coarse level
+		 *        to reject the separated pairs, the contacts are generated with the full convex-hull.
+		 *
+		 * \param radius
+		 *      Coarse radius (see SpaceObject::getCoarseRadius()) below which the coarse level is used for the contacts
+		 *      (<= 0.0 => always the full convex-hull).
+		 */
+		static void setCoarseContactRadius(const double radius) {
+			COARSE_CONTACT_RADIUS = radius;
+		}
+
+
+		/**
+		 * \brief Get the size below which the objects collide with the coarse level of their convex-hull.
+		 *
+		 * \return Coarse radius below which the coarse level is used for the contacts.
+		 */
+		static double getCoarseContactRadius() {
+			return COARSE_CONTACT_RADIUS;
+		}
+
+
+		/**
+		 * \brief Set the region of interest of the narrow-phase (e.g. around the camera). The pairs whose objects are
+		 *        both outside of it are tested as spheres (see SpaceObject::getCoarseRadius()), so they collide as
+		 *        point-masses without updating and testing their convex-hulls. An object gets its exact shape back
+		 *        as soon as it enters the region.
+		 *
+		 * \param center
+		 *      Center of the region.
+		 * \param radius
+		 *      Radius of the region (<= 0.0 => all pairs are tested exactly).
+		 */
+		void setLevelOfDetail(const Eigen::Vector3d &center, const double radius) {
+			_lodCenter = center;
+			_lodRadius = radius;
+		}
 
     private:
 
         void broadPhase(std::vector<std::pair<SpaceObject *, SpaceObject *>> &res);
-        void narrowPhase(std::vector<std::pair<SpaceObject *, SpaceObject *>> &collisions);
-        void insertionSort(std::vector<SpaceObject *> &A, int dim) const;
-		void respondToCollisions();
+        void narrowPhase(double dt, std::vector<std::pair<SpaceObject *, SpaceObject *>> &collisions);
+		void respondToCollisions(double dt, BodyState &bodies);
+
+		static int findRoot(FrameVector<int> &parents, int i);
+		static uint64_t getPairKey(const SpaceObject *o1, const SpaceObject *o2);
 
 	    static bool checkIntersection(Planet *p1, Planet *p2);
 	    static void response(Planet *p1, Planet *p2);
-	    static void pruneAndSweep(std::vector<SpaceObject*> &A, int dim, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res);
 
 		static Eigen::Matrix3d getOrthonormalBasis(Eigen::Vector3d v);
 
         //! All space-objects in the scene
-        std::vector<SpaceObject*> _xList;
-        std::vector<SpaceObject*> _yList;
-        std::vector<SpaceObject*> _zList;
+        std::vector<SpaceObject*> _spaceObjects;
+
+        //! Method to find the possible collisions
+        BroadPhase _broadPhase = INCREMENTAL_SAP;
+        //! Swept AABBs of all space-objects of the current step (read by all broad-phases)
+        AabbArray _aabbs;
+        //! Sorted endpoints of all space-objects in the scene
+        SweepAndPrune _sweepAndPrune;
+        //! Bounding-volume-hierarchy of all space-objects in the scene
+        AabbTree _aabbTree;
+        //! Hashed grid of all space-objects in the scene
+        SpatialHash _spatialHash;
+        //! Gravity-grid whose cells are reused by the spatial-hash (nullptr => own cells)
+        const SpatialGrid* _sharedGrid = nullptr;
+
+		/**
+		 * \brief Result of the GJK-algorithm of a pair which is reused in the next frame.
+		 */
+		struct PairCache {
+			//! Last support-vertices of both convex-hulls (-1 => new pair)
+			int supportVertex1 = -1;
+			int supportVertex2 = -1;
+			//! Parts of compounds which the support-vertices belong to (-1 => whole convex-hull)
+			int part1 = -1;
+			int part2 = -1;
+			//! Separating axis (or last search-direction if they intersect)
+			Eigen::Vector3d direction = Eigen::Vector3d(1.0, 1.0, 1.0);
+			//! Last vector of the distance-query from the second to the first convex-hull (zero => not queried yet)
+			Eigen::Vector3d separation = Eigen::Vector3d::Zero();
+			//! Gap below which the separated pair gets a speculative contact in this frame (0 => none)
+			double speculativeMargin = 0.0;
+			//! Penetration-depth of the last contact (0 => separated), the deep contacts are sampled in the distance-fields
+			double depth = 0.0;
+		};
+
+		//! GJK-results per pair of the previous narrow-phase (key = id1 << 32 | id2)
+		std::unordered_map<uint64_t, PairCache> _pairCache;
+
+		/**
+		 * \brief Exact test of a pair in the narrow-phase.
+		 *
+		 * \param o1, o2
+		 *      Objects of the pair (o1 has the smaller id).
+		 * \param cache
+		 *      Output-parameter: GJK-results of the previous frame, updated for the next one.
+		 * \param collision
+		 *      Output-parameter: Collision with all information of the intersection (if there is any), or the
+		 *      speculative contact of a separated pair within the margin of the cache (with its separation).
+		 *
+		 * \return True if the objects intersect.
+		 */
+		typedef bool (*NarrowPhaseTest)(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision);
+
+		//! Exact tests per shape-types of the pair ([o1->getShapeType()][o2->getShapeType()])
+		static const NarrowPhaseTest NARROW_PHASE_TESTS[2][2];
+
+		static bool testSpheres(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision);
+		static bool testSphereConvex(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision);
+		static bool testConvexSphere(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision);
+		static bool testConvexHulls(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision);
+		static bool testCoarseSpheres(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision);
+
+		/**
+		 * \brief Mid-phase of a pair with at least one convex-hull: the bounding-spheres around the centers and the
+		 * OBBs (AABB of the convex-hull in the model-space with the orientation of the object) are tested, before
+		 * the pair is checked by GJK.
+		 *
+		 * \param o1, o2
+		 *      Objects of the pair.
+		 *
+		 * \return False if the objects are separated for sure.
+		 */
+		static bool testMidPhase(const SpaceObject *o1, const SpaceObject *o2);
+
+		/**
+		 * \brief Conservative test of a pair with the coarse levels of the convex-hulls (enlarged by their margins),
+		 * which only needs the coarse convex-hulls to be up to date.
+		 *
+		 * \param o1, o2
+		 *      Objects of the pair.
+		 *
+		 * \return False if the full convex-hulls are separated for sure.
+		 */
+		static bool testCoarseHulls(SpaceObject *o1, SpaceObject *o2);
+
+		/**
+		 * \brief Check if an object collides with the coarse level of its convex-hull (see setCoarseContactRadius()).
+		 *
+		 * \param object
+		 *      Object of a pair.
+		 *
+		 * \return True if the contacts are generated with the coarse convex-hull.
+		 */
+		static bool isCoarseContact(const SpaceObject *object) {
+			return object->getCoarseRadius() < COARSE_CONTACT_RADIUS;
+		}
+
+		/**
+		 * \brief Get the shape of an object for the contacts (the full or the coarse convex-hull, which have to be
+		 * up to date).
+		 *
+		 * \param object
+		 *      Object of a pair.
+		 * \param supportVertex
+		 *      Vertex to start the first query from (result of the previous frame).
+		 *
+		 * \return Shape of the narrow-phase.
+		 */
+		static ConvexShape getContactShape(SpaceObject *object, int supportVertex);
+
+		/**
+		 * \brief Check if an object collides with the convex parts of its model (see ConvexDecomposition).
+		 *
+		 * \param object
+		 *      Object of a pair.
+		 *
+		 * \return True if the contacts are generated with the parts (not with the convex-hull).
+		 */
+		static bool isCompoundContact(const SpaceObject *object) {
+			return object->getConvexHullModel()->isCompound() && !isCoarseContact(object);
+		}
+
+		/**
+		 * \brief Get the shape of a part of a compound for the contacts (the global parts have to be up to date).
+		 *
+		 * \param object
+		 *      Object of a pair.
+		 * \param part
+		 *      Index of the part (-1 => shape of getContactShape()).
+		 * \param supportVertex
+		 *      Vertex to start the first query from (result of the previous frame).
+		 *
+		 * \return Shape of the narrow-phase.
+		 */
+		static ConvexShape getPartShape(SpaceObject *object, int part, int supportVertex);
+
+		/**
+		 * \brief Collect the pairs of parts whose bounding-spheres overlap by a traversal of both part-hierarchies
+		 * (the larger sphere is descended first).
+		 *
+		 * \param o1, o2
+		 *      Objects of the pair (at least one compound).
+		 * \param pairs
+		 *      Output-parameter: Overlapping parts of o1 and o2 (-1 => whole convex-hull of a convex object).
+		 */
+		static void collectPartPairs(const SpaceObject *o1, const SpaceObject *o2, std::vector<std::pair<int, int> > &pairs);
+
+		/**
+		 * \brief Get the bounding-sphere of a node of the part-hierarchy in the global-world-space.
+		 *
+		 * \param object
+		 *      Object of the hierarchy.
+		 * \param rotation
+		 *      Rotation of the object.
+		 * \param node
+		 *      Index of the node (-1 => sphere around the whole convex-hull).
+		 * \param center, radius
+		 *      Output-parameter: Bounding-sphere of the node.
+		 */
+		static void getPartSphere(const SpaceObject *object, const Eigen::Matrix3d &rotation, int node, Eigen::Vector3d &center, double &radius);
+
+		/**
+		 * \brief Test two objects of which at least one is a compound: GJK/EPA is only run for the pairs of parts
+		 * whose bounding-spheres overlap, the deepest intersection is the contact of the pair.
+		 *
+		 * \param o1, o2
+		 *      Objects of the pair (o1 has the smaller id).
+		 * \param cache
+		 *      Output-parameter: Parts and GJK-results of the previous contact, updated for the next frame.
+		 * \param collision
+		 *      Output-parameter: Collision with all information of the deepest intersection (if there is any).
+		 *
+		 * \return True if a pair of parts intersects.
+		 */
+		static bool testCompound(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision);
+
+		/**
+		 * \brief Get the closest point of the parts of a compound to a point (only the parts whose bounding-spheres
+		 * are closer than the maximum distance are queried).
+		 *
+		 * \param compound
+		 *      Object with the parts.
+		 * \param point
+		 *      Query-point.
+		 * \param maxDistance
+		 *      Maximum distance of the closest point.
+		 * \param part, supportVertex
+		 *      Output-parameter: Part of the previous query and its support-vertex, updated to the closest part.
+		 * \param closest
+		 *      Output-parameter: Closest point of the parts (only if a part is closer than maxDistance).
+		 * \param isInside
+		 *      Output-parameter: True if the point is inside of a part (there is no unique closest point).
+		 *
+		 * \return True if a part is closer than maxDistance and the point is outside of all queried parts.
+		 */
+		static bool getClosestPart(SpaceObject *compound, const Eigen::Vector3d &point, double maxDistance, int &part, int &supportVertex,
+			Eigen::Vector3d &closest, bool &isInside);
+
+		/**
+		 * \brief Test a deep contact with the distance-fields of the objects (see DistanceField): the vertices of
+		 * each hull are sampled in the field of the other object, the deepest vertex is the contact. The cost only
+		 * depends on the number of vertices, the normal is the gradient of the field.
+		 *
+		 * \param o1, o2
+		 *      Objects of the pair (o1 has the smaller id, at least one should have a field).
+		 * \param collision
+		 *      Output-parameter: Collision with all information of the deepest vertex (if there is any).
+		 *
+		 * \return True if a vertex is inside of the other object (false => the pair is tested with GJK/EPA).
+		 */
+		static bool testDistanceFields(SpaceObject *o1, SpaceObject *o2, Collision &collision);
+
+		/**
+		 * \brief Find the deepest vertex of the contact-shape of an object in the distance-field of another object.
+		 *
+		 * \param field
+		 *      Object whose distance-field is sampled.
+		 * \param other
+		 *      Object whose vertices are sampled (full or coarse hull, see getContactShape()).
+		 * \param depth
+		 *      Output-parameter: Penetration-depth of the deepest vertex in the global-world-space.
+		 * \param normal
+		 *      Output-parameter: Unit normal of the surface of the field at the deepest vertex (points outwards).
+		 * \param vertex
+		 *      Output-parameter: Deepest vertex in the global-world-space.
+		 *
+		 * \return True if the object has a field and a vertex is inside of it.
+		 */
+		static bool sampleDistanceField(SpaceObject *field, SpaceObject *other, double &depth, Eigen::Vector3d &normal, Eigen::Vector3d &vertex);
+
+		//! Contacts deeper than this ratio of the smaller coarse radius are sampled in the distance-fields
+		static const double DEEP_CONTACT_RATIO;
+
+		//! Objects below this coarse radius collide with their coarse convex-hull
+		static double COARSE_CONTACT_RADIUS;
+
+		//! Center of the region in which the pairs are tested exactly
+		Eigen::Vector3d _lodCenter = Eigen::Vector3d::Zero();
+		//! Radius of the region in which the pairs are tested exactly (<= 0.0 => everywhere)
+		double _lodRadius = 0.0;
+		//! Shortest time of impact of the approaching pairs of the last narrow-phase
+		double _minApproachTime = std::numeric_limits<double>::infinity();
+
+		/**
+		 * \brief Check if a pair is outside of the region of interest (see setLevelOfDetail()).
+		 *
+		 * \param o1, o2
+		 *      Objects of the pair.
+		 *
+		 * \return True if the pair is tested as spheres.
+		 */
+		bool isCoarsePair(const SpaceObject *o1, const SpaceObject *o2) const;
+
+
+		//! AABB-tree of the queries if another broad-phase is used
+		AabbTree _queryTree;
+		//! Flag if the query-tree has to be built again (the objects moved since the last query)
+		bool _isQueryTreeDirty = true;
+		//! Protects the query-tree and the convex-hulls of the candidates of concurrent queries
+		OpenThreads::Mutex _queryMutex;
+
+		//! Distance to the surface (relative to the coarse radius) at which a ray has hit a convex-hull
+		static const double RAY_TOLERANCE;
+		//! Maximum number of advancements of a ray against a convex-hull
+		static const int RAY_MAX_ITERATIONS;
+
+		/**
+		 * \brief Get the tree of the queries (built again if the objects moved since the last query).
+		 *
+		 * \return AABB-tree with the AABBs of the last step.
+		 */
+		const AabbTree& getQueryTree();
+
+		/**
+		 * \brief Transform the convex-hulls of the candidates of a query, so they are only read afterwards.
+		 *
+		 * \param candidates
+		 *      Candidates of the queries (may contain duplicates).
+		 */
+		void prepareCandidates(const std::vector<SpaceObject*> &candidates);
+
+		/**
+		 * \brief Cast a ray against the exact shape of an object. A convex-hull is approached by conservative
+		 * advancement with the GJK closest-point (the ray moves up to the plane through the closest point).
+		 *
+		 * \param object
+		 *      Candidate of the ray (its convex-hull has to be up to date).
+		 * \param origin
+		 *      Start of the ray.
+		 * \param direction
+		 *      Normalized direction of the ray.
+		 * \param minDistance
+		 *      Distance at which the ray enters the AABB of the object (start of the advancement).
+		 * \param maxDistance
+		 *      Maximum distance of the hit.
+		 * \param hit
+		 *      Output-parameter: Hit of the object (only if it is hit before maxDistance).
+		 *
+		 * \return True if the object is hit.
+		 */
+		static bool rayCastObject(SpaceObject *object, const Eigen::Vector3d &origin, const Eigen::Vector3d &direction, double minDistance, double maxDistance, RayHit &hit);
+
+		/**
+		 * \brief Test a sphere against a convex-hull with a GJK point-query of the center. If the center is inside
+		 * the convex-hull, both convex-hulls are tested.
+		 *
+		 * \param sphere
+		 *      Planet of the pair.
+		 * \param convex
+		 *      Other object of the pair.
+		 * \param cache
+		 *      Output-parameter: GJK-results of the previous frame, updated for the next one.
+		 * \param collision
+		 *      Output-parameter: Collision with all information of the intersection (if there is any), or the speculative
+		 *      contact of a separated pair.
+		 *
+		 * \return True if the objects intersect.
+		 */
+		static bool testSphereAgainstConvex(Planet *sphere, SpaceObject *convex, PairCache &cache, Collision &collision);
+
+		/**
+		 * \brief Continuous test of two convex-hulls over their sweeps of the last step (conservative advancement
+		 * with the GJK distance). The contact at the time of impact is reported at the end of the step, with the
+		 * distance travelled after the impact as intersection.
+		 *
+		 * \param o1, o2
+		 *      Objects of the pair (o1 has the smaller id).
+		 * \param cache
+		 *      Output-parameter: Support-vertices of the previous frame, updated for the next one.
+		 * \param collision
+		 *      Output-parameter: Collision with all information of the impact (if there is any).
+		 *
+		 * \return True if the objects hit each other during the step.
+		 */
+		static bool testContinuous(SpaceObject *o1, SpaceObject *o2, PairCache &cache, Collision &collision);
+
+		//! Objects which move further than this ratio of their smallest extent per step are checked continuously
+		static const double CCD_MOTION_RATIO;
+		//! Distance at which the conservative advancement has found the time of impact
+		static const double CCD_TOLERANCE;
+		//! Maximum number of advancements per pair
+		static const int CCD_MAX_ITERATIONS;
+		//! Multiple of the approach of a pair within a step below which its gap gets a speculative contact (> 1 => the rotation may close it faster)
+		static const double SPECULATIVE_RATIO;
+
+		/**
+		 * \brief Accumulated impulse of a contact which is reused in the next frame (warm-starting).
+		 */
+		struct ContactImpulse {
+			//! Impulse along the normal
+			double normal = 0.0;
+			//! Impulse in the contact-plane (world-coordinates)
+			Eigen::Vector3d tangent = Eigen::Vector3d::Zero();
+		};
+
+		//! Accumulated impulses per pair of the previous frame (key = id1 << 32 | id2)
+		std::unordered_map<uint64_t, ContactImpulse> _impulseCache;
+
+		/**
+		 * \brief Velocities and inverse masses of an object while the contacts are solved.
+		 */
+		struct SolverBody {
+			double inverseMass;
+			//! Inverse moment of inertia in world-coordinates
+			Eigen::Matrix3d inverseInertia;
+			Eigen::Vector3d linearVelocity;
+			Eigen::Vector3d angularVelocity;
+		};
+
+		/**
+		 * \brief Precomputed terms and accumulated impulses of a contact.
+		 */
+		struct ContactConstraint {
+			//! Indices of the solver-bodies of both objects
+			int body1;
+			int body2;
+			//! Points of contact relative to the centers of the objects
+			Eigen::Vector3d r1;
+			Eigen::Vector3d r2;
+			//! Contact-basis (normal from the second to the first object)
+			Eigen::Vector3d normal;
+			Eigen::Vector3d tangents[2];
+			//! Effective masses along the normal and the tangents
+			double normalMass;
+			double tangentMass[2];
+			//! Separating velocity along the normal after the contact (restitution)
+			double velocityBias;
+			//! Relative velocity along the normal before the impulses of this frame (< 0 => approaching)
+			double closingVelocity;
+			//! Accumulated impulses
+			double normalImpulse = 0.0;
+			Eigen::Vector3d tangentImpulse = Eigen::Vector3d::Zero();
+		};
+
+		void prepareContact(double dt, const Collision &collision, const FrameVector<SolverBody> &solverBodies, ContactConstraint &constraint) const;
+		void solveContact(FrameVector<SolverBody> &solverBodies, ContactConstraint &constraint) const;
+		int solveIslandBatched(const FrameVector<int> &island, FrameVector<SolverBody> &solverBodies,
+			FrameVector<ContactConstraint> &constraints, FrameVector<double> &velocities) const;
+		void separateContact(const Collision &currentCollision, const FrameVector<SolverBody> &solverBodies, const ContactConstraint &constraint) const;
+
+		static void applyImpulse(FrameVector<SolverBody> &solverBodies, const ContactConstraint &constraint, const Eigen::Vector3d &impulse);
+		static Eigen::Vector3d getRelativeVelocity(const FrameVector<SolverBody> &solverBodies, const ContactConstraint &constraint);
+
+		//! Contacts of the narrow-phase in the order of the pairs
+		std::vector<Collision> _contacts;
+		//! Speculative contacts of the separated pairs in the order of the pairs (only solved)
+		std::vector<Collision> _speculativeContacts;
+
+		//! Possible collisions of the broad-phase of the current step (kept, so the next steps reuse its capacity)
+		std::vector<std::pair<SpaceObject *, SpaceObject *>> _broadPhasePairs;
+
+		//! Iterations of the contact-solver per frame
+		int _solverIterations = 10;
+
+		//! Flag if the contacts of the larger islands are solved in SIMD-batches
+		bool _isBatchedSolver = false;
+		//! Number of the most recent batches which are searched for a free lane of a contact
+		static const int MAX_OPEN_BATCHES;
+
+		//! Flag if the pairs of the broad-phase are sorted (independent of the threads)
+		bool _isDeterministic = false;
+
+		//! Flag if the collisions are detected at all
+		bool _isEnabled = true;
 
-		std::priority_queue<Collision, std::vector<Collision>, CollisionCompareLess> _collisionQueue;
+		//! Flag if the approaching separated pairs get speculative contacts
+		bool _isSpeculative = false;
 
-        const double COEF_RESTITUTION = 0.9;
-		const double COEF_FRICTION = 0.8;
+		//! Coefficients of the restitution and the (Coulomb-)friction of the contacts
+		double _restitution = 0.9;
+		double _friction = 0.8;
+		//! Closing velocities below are not restituted (resting contacts)
+		const double RESTITUTION_THRESHOLD = 1e-2;
     };
 
 }
@@ -0,0 +1,351 @@
+﻿/**
+ * \brief Batch of contact-constraints as structure-of-arrays for the vectorized sequential-impulse solver.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "ContactBatch.h"
+
+#include <math.h>
+#include <algorithm>
+
+#include <Eigen/Geometry>
+
+// Same as the gravity-kernel: the vectorized kernel is compiled with a function-specific target-attribute
+// and selected at runtime, so the rest of the project does not need any special compiler-flags.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PBS17_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+using namespace pbs17;
+
+//! Number of contacts per batch (doubles per AVX-register)
+const int ContactBatch::LANES;
+
+
+/**
+ * \brief Create an empty batch (all lanes inactive).
+ */
+ContactBatch::ContactBatch() {
+	// inactive lanes have no mass and no impulse, so they never change a velocity
+	std::fill(_body1, _body1 + LANES, -1);
+	std::fill(_body2, _body2 + LANES, -1);
+	std::fill(&_axis[0][0][0], &_axis[0][0][0] + 9 * LANES, 0.0);
+	std::fill(&_angular1[0][0][0], &_angular1[0][0][0] + 9 * LANES, 0.0);
+	std::fill(&_angular2[0][0][0], &_angular2[0][0][0] + 9 * LANES, 0.0);
+	std::fill(&_inertia1[0][0][0], &_inertia1[0][0][0] + 9 * LANES, 0.0);
+	std::fill(&_inertia2[0][0][0], &_inertia2[0][0][0] + 9 * LANES, 0.0);
+	std::fill(_inverseMass1, _inverseMass1 + LANES, 0.0);
+	std::fill(_inverseMass2, _inverseMass2 + LANES, 0.0);
+	std::fill(&_mass[0][0], &_mass[0][0] + 3 * LANES, 0.0);
+	std::fill(_velocityBias, _velocityBias + LANES, 0.0);
+	std::fill(&_impulse[0][0], &_impulse[0][0] + 3 * LANES, 0.0);
+}
+
+
+/**
+ * \brief Set one lane of the batch. The lanes have to be set in order, unset lanes do not change anything.
+ *
+ * \param lane
+ *      Lane to set (0 to LANES - 1).
+ * \param body1, body2
+ *      Indices of both bodies in the velocity-array (must not be in another lane of this batch).
+ * \param inverseMass1, inverseMass2
+ *      Inverse masses of both bodies.
+ * \param inverseInertia1, inverseInertia2
+ *      Inverse moments of inertia of both bodies in world-coordinates.
+ * \param r1, r2
+ *      Points of contact relative to the centers of the bodies.
+ * \param axes
+ *      Contact-basis (normal from the second to the first body, both tangents).
+ * \param masses
+ *      Effective masses along the axes.
+ * \param velocityBias
+ *      Separating velocity along the normal after the contact (restitution).
+ * \param impulses
+ *      Accumulated impulses along the axes (warm-start).
+ */
+void ContactBatch::setLane(int lane, int body1, int body2, double inverseMass1, double inverseMass2,
+	const Eigen::Matrix3d &inverseInertia1, const Eigen::Matrix3d &inverseInertia2,
+	const Eigen::Vector3d &r1, const Eigen::Vector3d &r2, const Eigen::Vector3d axes[3], const double masses[3],
+	double velocityBias, const double impulses[3]) {
+	_body1[lane] = body1;
+	_body2[lane] = body2;
+	_inverseMass1[lane] = inverseMass1;
+	_inverseMass2[lane] = inverseMass2;
+	_velocityBias[lane] = velocityBias;
+
+	for (int a = 0; a < 3; ++a) {
+		Eigen::Vector3d angular1 = r1.cross(axes[a]);
+		Eigen::Vector3d angular2 = r2.cross(axes[a]);
+		Eigen::Vector3d inertia1 = inverseInertia1 * angular1;
+		Eigen::Vector3d inertia2 = inverseInertia2 * angular2;
+
+		for (int k = 0; k < 3; ++k) {
+			_axis[a][k][lane] = axes[a][k];
+			_angular1[a][k][lane] = angular1[k];
+			_angular2[a][k][lane] = angular2[k];
+			_inertia1[a][k][lane] = inertia1[k];
+			_inertia2[a][k][lane] = inertia2[k];
+		}
+
+		_mass[a][lane] = masses[a];
+		_impulse[a][lane] = impulses[a];
+	}
+
+	_size = std::max(_size, lane + 1);
+}
+
+
+/**
+ * \brief Relax the velocities of all lanes once.
+ *
+ * \param velocities
+ *      Output-parameter: Velocities of the bodies (6 per body).
+ * \param friction
+ *      Coefficient of the (Coulomb-)friction.
+ */
+void ContactBatch::solve(double* velocities, double friction) {
+	static const KernelFunction kernel = selectKernel();
+
+	// gather the velocities per lane (the inactive lanes stay at rest)
+	double v1[6][LANES] = {};
+	double v2[6][LANES] = {};
+
+	for (int lane = 0; lane < _size; ++lane) {
+		const double* src1 = velocities + 6 * _body1[lane];
+		const double* src2 = velocities + 6 * _body2[lane];
+
+		for (int k = 0; k < 6; ++k) {
+			v1[k][lane] = src1[k];
+			v2[k][lane] = src2[k];
+		}
+	}
+
+	kernel(*this, v1, v2, friction);
+
+	// scatter (no body is in two lanes, so the order does not matter)
+	for (int lane = 0; lane < _size; ++lane) {
+		double* dst1 = velocities + 6 * _body1[lane];
+		double* dst2 = velocities + 6 * _body2[lane];
+
+		for (int k = 0; k < 6; ++k) {
+			dst1[k] = v1[k][lane];
+			dst2[k] = v2[k][lane];
+		}
+	}
+}
+
+
+/**
+ * \brief Get the name of the instruction set which is used by the solver.
+ *
+ * \return "avx2" or "scalar".
+ */
+std::string ContactBatch::getInstructionSet() {
+	KernelFunction kernel = selectKernel();
+
+	if (kernel == &ContactBatch::solveAvx2) {
+		return "avx2";
+	}
+
+	return "scalar";
+}
+
+
+/**
+ * \brief Select the best kernel which is supported by the CPU.
+ *
+ * \return Kernel implementation.
+ */
+ContactBatch::KernelFunction ContactBatch::selectKernel() {
+#if defined(PBS17_X86_SIMD)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return &ContactBatch::solveAvx2;
+	}
+#endif
+
+	return &ContactBatch::solveScalar;
+}
+
+
+/**
+ * \brief Scalar implementation (fallback).
+ *
+ * \param batch
+ *      Output-parameter: Batch with its accumulated impulses.
+ * \param v1, v2
+ *      Output-parameter: Velocities of the first and the second bodies (6 rows of LANES).
+ * \param friction
+ *      Coefficient of the (Coulomb-)friction.
+ */
+void ContactBatch::solveScalar(ContactBatch &batch, double(*v1)[LANES], double(*v2)[LANES], double friction) {
+	for (int lane = 0; lane < LANES; ++lane) {
+		// velocity of the first point of contact relative to the second one along an axis
+		double relative[3];
+		for (int a = 1; a < 3; ++a) {
+			relative[a] = 0.0;
+			for (int k = 0; k < 3; ++k) {
+				relative[a] += batch._axis[a][k][lane] * (v1[k][lane] - v2[k][lane])
+					+ batch._angular1[a][k][lane] * v1[3 + k][lane] - batch._angular2[a][k][lane] * v2[3 + k][lane];
+			}
+		}
+
+		// friction (clamped to the cone of the accumulated normal-impulse)
+		double tangent1 = batch._impulse[1][lane] - batch._mass[1][lane] * relative[1];
+		double tangent2 = batch._impulse[2][lane] - batch._mass[2][lane] * relative[2];
+		double maxTangent = friction * batch._impulse[0][lane];
+		double tangentNorm = sqrt(tangent1 * tangent1 + tangent2 * tangent2);
+		if (tangentNorm > maxTangent) {
+			tangent1 *= maxTangent / tangentNorm;
+			tangent2 *= maxTangent / tangentNorm;
+		}
+
+		double delta1 = tangent1 - batch._impulse[1][lane];
+		double delta2 = tangent2 - batch._impulse[2][lane];
+		batch._impulse[1][lane] = tangent1;
+		batch._impulse[2][lane] = tangent2;
+
+		for (int k = 0; k < 3; ++k) {
+			double impulse = delta1 * batch._axis[1][k][lane] + delta2 * batch._axis[2][k][lane];
+			v1[k][lane] += batch._inverseMass1[lane] * impulse;
+			v2[k][lane] -= batch._inverseMass2[lane] * impulse;
+			v1[3 + k][lane] += delta1 * batch._inertia1[1][k][lane] + delta2 * batch._inertia1[2][k][lane];
+			v2[3 + k][lane] -= delta1 * batch._inertia2[1][k][lane] + delta2 * batch._inertia2[2][k][lane];
+		}
+
+		// normal (the accumulated impulse only pushes the bodies apart)
+		relative[0] = 0.0;
+		for (int k = 0; k < 3; ++k) {
+			relative[0] += batch._axis[0][k][lane] * (v1[k][lane] - v2[k][lane])
+				+ batch._angular1[0][k][lane] * v1[3 + k][lane] - batch._angular2[0][k][lane] * v2[3 + k][lane];
+		}
+
+		double normal = std::max(batch._impulse[0][lane] + batch._mass[0][lane] * (batch._velocityBias[lane] - relative[0]), 0.0);
+		double delta0 = normal - batch._impulse[0][lane];
+		batch._impulse[0][lane] = normal;
+
+		for (int k = 0; k < 3; ++k) {
+			v1[k][lane] += batch._inverseMass1[lane] * delta0 * batch._axis[0][k][lane];
+			v2[k][lane] -= batch._inverseMass2[lane] * delta0 * batch._axis[0][k][lane];
+			v1[3 + k][lane] += delta0 * batch._inertia1[0][k][lane];
+			v2[3 + k][lane] -= delta0 * batch._inertia2[0][k][lane];
+		}
+	}
+}
+
+
+#if defined(PBS17_X86_SIMD)
+
+namespace {
+
+	/**
+	 * \brief Velocity of the first point of contact relative to the second one along an axis, for all lanes.
+	 *
+	 * \param axis, angular1, angular2
+	 *      Axis and its angular terms of both bodies per component.
+	 * \param v1, v2
+	 *      Velocities of both bodies (linear and angular, per component).
+	 *
+	 * \return Relative velocities.
+	 */
+	__attribute__((target("avx2,fma")))
+	inline __m256d getRelativeVelocityAvx2(const double(*axis)[ContactBatch::LANES], const double(*angular1)[ContactBatch::LANES],
+		const double(*angular2)[ContactBatch::LANES], const __m256d* v1, const __m256d* v2) {
+		__m256d relative = _mm256_setzero_pd();
+
+		for (int k = 0; k < 3; ++k) {
+			relative = _mm256_fmadd_pd(_mm256_loadu_pd(axis[k]), _mm256_sub_pd(v1[k], v2[k]), relative);
+			relative = _mm256_fmadd_pd(_mm256_loadu_pd(angular1[k]), v1[3 + k], relative);
+			relative = _mm256_fnmadd_pd(_mm256_loadu_pd(angular2[k]), v2[3 + k], relative);
+		}
+
+		return relative;
+	}
+}
+
+
+/**
+ * \brief AVX2/FMA implementation with all lanes in one register. Same parameters as solveScalar().
+ */
+__attribute__((target("avx2,fma")))
+void ContactBatch::solveAvx2(ContactBatch &batch, double(*v1)[LANES], double(*v2)[LANES], double friction) {
+	__m256d vel1[6];
+	__m256d vel2[6];
+	for (int k = 0; k < 6; ++k) {
+		vel1[k] = _mm256_loadu_pd(v1[k]);
+		vel2[k] = _mm256_loadu_pd(v2[k]);
+	}
+
+	const __m256d inverseMass1 = _mm256_loadu_pd(batch._inverseMass1);
+	const __m256d inverseMass2 = _mm256_loadu_pd(batch._inverseMass2);
+
+	// friction (clamped to the cone of the accumulated normal-impulse)
+	__m256d relative1 = getRelativeVelocityAvx2(batch._axis[1], batch._angular1[1], batch._angular2[1], vel1, vel2);
+	__m256d relative2 = getRelativeVelocityAvx2(batch._axis[2], batch._angular1[2], batch._angular2[2], vel1, vel2);
+
+	__m256d impulse1 = _mm256_loadu_pd(batch._impulse[1]);
+	__m256d impulse2 = _mm256_loadu_pd(batch._impulse[2]);
+	__m256d tangent1 = _mm256_fnmadd_pd(_mm256_loadu_pd(batch._mass[1]), relative1, impulse1);
+	__m256d tangent2 = _mm256_fnmadd_pd(_mm256_loadu_pd(batch._mass[2]), relative2, impulse2);
+
+	__m256d maxTangent = _mm256_mul_pd(_mm256_set1_pd(friction), _mm256_loadu_pd(batch._impulse[0]));
+	__m256d tangentNorm = _mm256_sqrt_pd(_mm256_fmadd_pd(tangent1, tangent1, _mm256_mul_pd(tangent2, tangent2)));
+	// the division of the lanes inside the cone (possibly by zero) is not used
+	__m256d scale = _mm256_blendv_pd(_mm256_set1_pd(1.0), _mm256_div_pd(maxTangent, tangentNorm),
+		_mm256_cmp_pd(tangentNorm, maxTangent, _CMP_GT_OQ));
+	tangent1 = _mm256_mul_pd(tangent1, scale);
+	tangent2 = _mm256_mul_pd(tangent2, scale);
+
+	__m256d delta1 = _mm256_sub_pd(tangent1, impulse1);
+	__m256d delta2 = _mm256_sub_pd(tangent2, impulse2);
+	_mm256_storeu_pd(batch._impulse[1], tangent1);
+	_mm256_storeu_pd(batch._impulse[2], tangent2);
+
+	for (int k = 0; k < 3; ++k) {
+		__m256d impulse = _mm256_fmadd_pd(delta1, _mm256_loadu_pd(batch._axis[1][k]), _mm256_mul_pd(delta2, _mm256_loadu_pd(batch._axis[2][k])));
+		vel1[k] = _mm256_fmadd_pd(inverseMass1, impulse, vel1[k]);
+		vel2[k] = _mm256_fnmadd_pd(inverseMass2, impulse, vel2[k]);
+
+		__m256d angular1 = _mm256_fmadd_pd(delta1, _mm256_loadu_pd(batch._inertia1[1][k]), _mm256_mul_pd(delta2, _mm256_loadu_pd(batch._inertia1[2][k])));
+		__m256d angular2 = _mm256_fmadd_pd(delta1, _mm256_loadu_pd(batch._inertia2[1][k]), _mm256_mul_pd(delta2, _mm256_loadu_pd(batch._inertia2[2][k])));
+		vel1[3 + k] = _mm256_add_pd(vel1[3 + k], angular1);
+		vel2[3 + k] = _mm256_sub_pd(vel2[3 + k], angular2);
+	}
+
+	// normal (the accumulated impulse only pushes the bodies apart)
+	__m256d relative0 = getRelativeVelocityAvx2(batch._axis[0], batch._angular1[0], batch._angular2[0], vel1, vel2);
+	__m256d impulse0 = _mm256_loadu_pd(batch._impulse[0]);
+	__m256d normal = _mm256_max_pd(_mm256_fmadd_pd(_mm256_loadu_pd(batch._mass[0]),
+		_mm256_sub_pd(_mm256_loadu_pd(batch._velocityBias), relative0), impulse0), _mm256_setzero_pd());
+	__m256d delta0 = _mm256_sub_pd(normal, impulse0);
+	_mm256_storeu_pd(batch._impulse[0], normal);
+
+	for (int k = 0; k < 3; ++k) {
+		__m256d impulse = _mm256_mul_pd(delta0, _mm256_loadu_pd(batch._axis[0][k]));
+		vel1[k] = _mm256_fmadd_pd(inverseMass1, impulse, vel1[k]);
+		vel2[k] = _mm256_fnmadd_pd(inverseMass2, impulse, vel2[k]);
+		vel1[3 + k] = _mm256_fmadd_pd(delta0, _mm256_loadu_pd(batch._inertia1[0][k]), vel1[3 + k]);
+		vel2[3 + k] = _mm256_fnmadd_pd(delta0, _mm256_loadu_pd(batch._inertia2[0][k]), vel2[3 + k]);
+	}
+
+	for (int k = 0; k < 6; ++k) {
+		_mm256_storeu_pd(v1[k], vel1[k]);
+		_mm256_storeu_pd(v2[k], vel2[k]);
+	}
+}
+
+#else
+
+/**
+ * \brief AVX2/FMA implementation (not available for this compiler/architecture => scalar).
+ */
+void ContactBatch::solveAvx2(ContactBatch &batch, double(*v1)[LANES], double(*v2)[LANES], double friction) {
+	solveScalar(batch, v1, v2, friction);
+}
+
+#endif
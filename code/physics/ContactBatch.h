@@ -0,0 +1,167 @@
+﻿/**
+ * \brief Batch of contact-constraints as structure-of-arrays for the vectorized sequential-impulse solver.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <string>
+
+#include <Eigen/Core>
+
+namespace pbs17 {
+
+	/**
+	 * \brief Up to LANES contacts without a common body, which are relaxed together with one sequential-impulse
+	 * iteration per lane (friction clamped to the Coulomb-cone, then the non-negative normal-impulse). All terms which
+	 * do not change during the iterations (contact-basis, effective masses, angular terms multiplied by the inverse
+	 * inertia) are precomputed per lane, so an iteration is a gather of the velocities, straight-line arithmetic and a
+	 * scatter. Since no body is shared within a batch, the result is the same as solving the lanes one after the other.
+	 * The instruction set (AVX2 with 4 doubles per register, or scalar) is selected once at runtime based on the
+	 * capabilities of the CPU.
+	 *
+	 * The velocities are passed as a flat array with 6 doubles per body (linear x, y, z, angular x, y, z).
+	 */
+	class ContactBatch {
+	public:
+		//! Number of contacts per batch (doubles per AVX-register)
+		static const int LANES = 4;
+
+
+		/**
+		 * \brief Create an empty batch (all lanes inactive).
+		 */
+		ContactBatch();
+
+
+		/**
+		 * \brief Set one lane of the batch. The lanes have to be set in order, unset lanes do not change anything.
+		 *
+		 * \param lane
+		 *      Lane to set (0 to LANES - 1).
+		 * \param body1, body2
+		 *      Indices of both bodies in the velocity-array (must not be in another lane of this batch).
+		 * \param inverseMass1, inverseMass2
+		 *      Inverse masses of both bodies.
+		 * \param inverseInertia1, inverseInertia2
+		 *      Inverse moments of inertia of both bodies in world-coordinates.
+		 * \param r1, r2
+		 *      Points of contact relative to the centers of the bodies.
+		 * \param axes
+		 *      Contact-basis (normal from the second to the first body, both tangents).
+		 * \param masses
+		 *      Effective masses along the axes.
+		 * \param velocityBias
+		 *      Separating velocity along the normal after the contact (restitution).
+		 * \param impulses
+		 *      Accumulated impulses along the axes (warm-start).
+		 */
+		void setLane(int lane, int body1, int body2, double inverseMass1, double inverseMass2,
+			const Eigen::Matrix3d &inverseInertia1, const Eigen::Matrix3d &inverseInertia2,
+			const Eigen::Vector3d &r1, const Eigen::Vector3d &r2, const Eigen::Vector3d axes[3], const double masses[3],
+			double velocityBias, const double impulses[3]);
+
+
+		/**
+		 * \brief Relax the velocities of all lanes once.
+		 *
+		 * \param velocities
+		 *      Output-parameter: Velocities of the bodies (6 per body).
+		 * \param friction
+		 *      Coefficient of the (Coulomb-)friction.
+		 */
+		void solve(double* velocities, double friction);
+
+
+		/**
+		 * \brief Get the accumulated impulse of a lane.
+		 *
+		 * \param lane
+		 *      Lane of the contact.
+		 * \param axis
+		 *      Axis (0 = normal, 1 and 2 = tangents).
+		 *
+		 * \return Accumulated impulse along the axis.
+		 */
+		double getImpulse(int lane, int axis) const {
+			return _impulse[axis][lane];
+		}
+
+
+		/**
+		 * \brief Get the number of set lanes.
+		 *
+		 * \return Number of contacts in the batch.
+		 */
+		int size() const {
+			return _size;
+		}
+
+
+		/**
+		 * \brief Get the name of the instruction set which is used by the solver.
+		 *
+		 * \return "avx2" or "scalar".
+		 */
+		static std::string getInstructionSet();
+
+
+	private:
+		//! Signature of the kernel implementations (batch, velocities of the first and second bodies per lane, friction)
+		typedef void(*KernelFunction)(ContactBatch&, double(*)[LANES], double(*)[LANES], double);
+
+
+		/**
+		 * \brief Select the best kernel which is supported by the CPU.
+		 *
+		 * \return Kernel implementation.
+		 */
+		static KernelFunction selectKernel();
+
+
+		/**
+		 * \brief Scalar implementation (fallback).
+		 *
+		 * \param batch
+		 *      Output-parameter: Batch with its accumulated impulses.
+		 * \param v1, v2
+		 *      Output-parameter: Velocities of the first and the second bodies (6 rows of LANES).
+		 * \param friction
+		 *      Coefficient of the (Coulomb-)friction.
+		 */
+		static void solveScalar(ContactBatch &batch, double(*v1)[LANES], double(*v2)[LANES], double friction);
+
+
+		/**
+		 * \brief AVX2/FMA implementation with all lanes in one register. Same parameters as solveScalar().
+		 */
+		static void solveAvx2(ContactBatch &batch, double(*v1)[LANES], double(*v2)[LANES], double friction);
+
+
+		//! Indices of the bodies
+		int _body1[LANES];
+		int _body2[LANES];
+		//! Number of set lanes
+		int _size = 0;
+
+		//! Contact-basis per axis and component
+		double _axis[3][3][LANES];
+		//! Angular terms r x axis of both bodies per axis and component
+		double _angular1[3][3][LANES];
+		double _angular2[3][3][LANES];
+		//! Change of the angular velocity per unit impulse (inverse inertia * (r x axis)) per axis and component
+		double _inertia1[3][3][LANES];
+		double _inertia2[3][3][LANES];
+		//! Inverse masses of the bodies
+		double _inverseMass1[LANES];
+		double _inverseMass2[LANES];
+		//! Effective masses per axis
+		double _mass[3][LANES];
+		//! Separating velocity along the normal after the contact
+		double _velocityBias[LANES];
+		//! Accumulated impulses per axis
+		double _impulse[3][LANES];
+	};
+}
@@ -0,0 +1,160 @@
+﻿/**
+ * \brief Implementation of the stream of the contacts of each step for the game- and analysis-logic.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "ContactEvents.h"
+
+#include "Collision.h"
+
+using namespace pbs17;
+
+
+//! Pointer to the only instance of this class.
+ContactEvents* ContactEvents::_pInstance = nullptr;
+
+//! Nothing is published until a consumer enables it.
+bool ContactEvents::IS_ENABLED = false;
+
+//! Mask of all collision-groups.
+const uint32_t ContactEvents::ALL_GROUPS;
+
+//! The newest frame, the written one and two pinned ones.
+const int ContactEvents::SLOTS;
+
+
+/**
+ * \brief Private constructor of the stream.
+ */
+ContactEvents::ContactEvents() : _newest(-1), _cntDropped(0) {
+	for (int i = 0; i < SLOTS; ++i) {
+		_readers[i] = 0;
+	}
+}
+
+
+/**
+ * \brief Singleton instance of the ContactEvents-class.
+ */
+ContactEvents* ContactEvents::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new ContactEvents();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Publish the contacts of a step (only called by the simulating thread, never waits). The frame is only
+ *        written while no consumer pins it: a consumer which pins it afterwards sees that it's not the newest
+ *        frame and retries.
+ *
+ * \param step
+ *      Number of the step.
+ * \param time
+ *      Simulated time after the step.
+ * \param contacts
+ *      Resolved contacts of the step (see SimulationManager::getStepContacts()).
+ */
+void ContactEvents::publish(unsigned long step, double time, const std::vector<Collision> &contacts) {
+	int newest = _newest.load();
+	int slot = -1;
+
+	for (int i = 0; i < SLOTS && slot < 0; ++i) {
+		if (i != newest && _readers[i].load() == 0) {
+			slot = i;
+		}
+	}
+
+	if (slot < 0) {
+		++_cntDropped;
+		return;
+	}
+
+	Frame &frame = _frames[slot];
+	frame.step = step;
+	frame.time = time;
+	frame.events.resize(contacts.size());
+
+	for (unsigned int i = 0; i < contacts.size(); ++i) {
+		const Collision &contact = contacts[i];
+		const SpaceObject* first = contact.getFirstObject();
+		const SpaceObject* second = contact.getSecondObject();
+		ContactEvent &event = frame.events[i];
+
+		Eigen::Vector3d point = 0.5 * (contact.getFirstPOC() + contact.getSecondPOC());
+		Eigen::Vector3d normal = contact.getUnitNormal();
+
+		event.id1 = first->getId();
+		event.id2 = second->getId();
+		event.groups1 = first->getCollisionGroup();
+		event.groups2 = second->getCollisionGroup();
+		event.impulse = static_cast<float>(contact.getImpulse());
+		event.relativeSpeed = static_cast<float>(contact.getRelativeSpeed());
+
+		for (int k = 0; k < 3; ++k) {
+			event.point[k] = static_cast<float>(point[k]);
+			event.normal[k] = static_cast<float>(normal[k]);
+		}
+	}
+
+	_newest.store(slot);
+}
+
+
+/**
+ * \brief Copy the events of the newest step (can be called by any thread, never waits for the simulation).
+ *        The newest frame is pinned and copied only if it's still the newest one afterwards, otherwise the
+ *        simulation could already be writing it.
+ *
+ * \param step
+ *      Input-/output-parameter: Step of the last read events (0 => nothing has been read), set to the step
+ *      of the copied events.
+ * \param events
+ *      Output-parameter: Events of the step of which at least one object is in the groups.
+ * \param groups
+ *      Bits of the collision-groups of the events.
+ * \param time
+ *      Output-parameter: Simulated time after the step (nullptr => not needed).
+ *
+ * \return False if no newer step has been published (the events are not changed).
+ */
+bool ContactEvents::read(unsigned long &step, std::vector<ContactEvent> &events, uint32_t groups, double* time) {
+	int slot;
+
+	// a retry means that a newer step has been published in the meantime
+	while (true) {
+		slot = _newest.load();
+		if (slot < 0) return false;
+
+		++_readers[slot];
+		if (_newest.load() == slot) break;
+		--_readers[slot];
+	}
+
+	const Frame &frame = _frames[slot];
+	bool isNewer = frame.step != step;
+
+	if (isNewer) {
+		step = frame.step;
+		if (time != nullptr) {
+			*time = frame.time;
+		}
+
+		events.clear();
+		for (unsigned int i = 0; i < frame.events.size(); ++i) {
+			const ContactEvent &event = frame.events[i];
+
+			if (((event.groups1 | event.groups2) & groups) != 0) {
+				events.push_back(event);
+			}
+		}
+	}
+
+	--_readers[slot];
+	return isNewer;
+}
@@ -0,0 +1,174 @@
+﻿/**
+ * \brief Implementation of the stream of the contacts of each step for the game- and analysis-logic.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+
+
+// forward declarations
+namespace pbs17 {
+	class Collision;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Compact record of a resolved contact.
+	 */
+	struct ContactEvent {
+		//! IDs of both objects (see SpaceObject::getId())
+		int64_t id1;
+		int64_t id2;
+		//! Collision-groups of both objects (see SpaceObject::getCollisionGroup())
+		uint32_t groups1;
+		uint32_t groups2;
+		//! Accumulated impulse along the normal after the contact-solver
+		float impulse;
+		//! Approaching speed along the normal before the contact-solver (> 0 => approaching)
+		float relativeSpeed;
+		//! Point of contact (world-coordinates, between the points of both objects)
+		float point[3];
+		//! Unit normal from the second to the first object
+		float normal[3];
+	};
+
+
+	/**
+	 * \brief Publishes the contacts of each step as one contiguous array of ContactEvents, so the consumers (e.g.
+	 * scoring or an analysis) do not hook into the contact-solver. The simulating thread converts the contacts once
+	 * after the step, the solver-loop does not know about the consumers.
+	 *
+	 * The events of a step are written into one of SLOTS frames which is neither the newest frame nor read by any
+	 * consumer, and then published by an atomic index. A consumer pins the newest frame with a counter of the frame
+	 * and copies it (filtered by the collision-groups), so neither side takes a lock and the simulation never waits
+	 * for a consumer. If all other frames are pinned, the step is dropped (see getNumDropped()). The consumers
+	 * always read the newest step, so a consumer which polls slower than the steps misses steps.
+	 */
+	class ContactEvents {
+	public:
+		//! Mask of all collision-groups
+		static const uint32_t ALL_GROUPS = 0xffffffffu;
+
+
+		/**
+		 * \brief Singleton instance of the ContactEvents-class.
+		 */
+		static ContactEvents* Instance();
+
+
+		/**
+		 * \brief Publish the contacts of a step (only called by the simulating thread, never waits).
+		 *
+		 * \param step
+		 *      Number of the step.
+		 * \param time
+		 *      Simulated time after the step.
+		 * \param contacts
+		 *      Resolved contacts of the step (see SimulationManager::getStepContacts()).
+		 */
+		void publish(unsigned long step, double time, const std::vector<Collision> &contacts);
+
+
+		/**
+		 * \brief Copy the events of the newest step (can be called by any thread, never waits for the simulation).
+		 *
+		 * \param step
+		 *      Input-/output-parameter: Step of the last read events (0 => nothing has been read), set to the step
+		 *      of the copied events.
+		 * \param events
+		 *      Output-parameter: Events of the step of which at least one object is in the groups.
+		 * \param groups
+		 *      Bits of the collision-groups of the events.
+		 * \param time
+		 *      Output-parameter: Simulated time after the step (nullptr => not needed).
+		 *
+		 * \return False if no newer step has been published (the events are not changed).
+		 */
+		bool read(unsigned long &step, std::vector<ContactEvent> &events, uint32_t groups = ALL_GROUPS,
+			double* time = nullptr);
+
+
+		/**
+		 * \brief Get the number of steps which could not be published, because all other frames were read.
+		 *
+		 * \return Dropped steps.
+		 */
+		unsigned long getNumDropped() const {
+			return _cntDropped;
+		}
+
+
+		/**
+		 * \brief Enable or disable the publishing of the contacts. Enabling creates the instance, so it has to be
+		 *        enabled before the consumer-threads are started.
+		 *
+		 * \param isEnabled
+		 *      True if the contacts of each step are published.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			if (isEnabled) {
+				Instance();
+			}
+
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the contacts are published.
+		 *
+		 * \return True if the contacts of each step are published.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+	private:
+		/**
+		 * \brief Events of a step.
+		 */
+		struct Frame {
+			unsigned long step = 0;
+			double time = 0.0;
+			std::vector<ContactEvent> events;
+		};
+
+
+		//! Number of frames (the newest one, the one which is written and the ones pinned by the consumers)
+		static const int SLOTS = 4;
+
+		//! Frames of the last steps
+		Frame _frames[SLOTS];
+		//! Number of consumers which copy each frame
+		std::atomic<int> _readers[SLOTS];
+		//! Index of the newest frame (-1 => nothing is published)
+		std::atomic<int> _newest;
+		//! Number of steps which could not be published
+		std::atomic<unsigned long> _cntDropped;
+
+		//! True if the contacts of each step are published
+		static bool IS_ENABLED;
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		ContactEvents();
+
+		//! Private copy-constructor to prevent copying the class.
+		ContactEvents(ContactEvents const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		ContactEvents& operator=(ContactEvents const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static ContactEvents* _pInstance;
+	};
+}
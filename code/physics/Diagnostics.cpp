@@ -0,0 +1,101 @@
+﻿/**
+ * \brief Implementation of the diagnostics of the conserved quantities (energy, momentum and angular momentum).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "Diagnostics.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "BodyState.h"
+#include "NBodyManager.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Measure the conserved quantities of the bodies.
+ *
+ * \param step, time
+ *      Current step and simulated time.
+ * \param bodies
+ *      State of all bodies.
+ * \param nManager
+ *      Nbody-manager with the active gravity-solver (for the potential).
+ *
+ * \return Measurement (the first one is the reference of the drifts).
+ */
+const Diagnostics::Sample& Diagnostics::measure(unsigned long step, double time, const BodyState &bodies, NBodyManager &nManager) {
+	int n = bodies.size();
+
+	nManager.computePotentials(bodies, _phi);
+
+	double kinetic = 0.0, potential = 0.0;
+	double px = 0.0, py = 0.0, pz = 0.0;
+	double lx = 0.0, ly = 0.0, lz = 0.0;
+	double momentumScale = 0.0, angularMomentumScale = 0.0;
+
+	const double* x = bodies.x.data();
+	const double* y = bodies.y.data();
+	const double* z = bodies.z.data();
+	const double* vx = bodies.vx.data();
+	const double* vy = bodies.vy.data();
+	const double* vz = bodies.vz.data();
+	const double* m = bodies.m.data();
+	const double* phi = _phi.data();
+
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(+:kinetic, potential, px, py, pz, lx, ly, lz, momentumScale, angularMomentumScale)
+#endif
+	for (int i = 0; i < n; ++i) {
+		double v2 = vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i];
+		kinetic += 0.5 * m[i] * v2;
+		// each pair is in the potential of both bodies
+		potential += 0.5 * m[i] * phi[i];
+
+		px += m[i] * vx[i];
+		py += m[i] * vy[i];
+		pz += m[i] * vz[i];
+
+		double ax = m[i] * (y[i] * vz[i] - z[i] * vy[i]);
+		double ay = m[i] * (z[i] * vx[i] - x[i] * vz[i]);
+		double az = m[i] * (x[i] * vy[i] - y[i] * vx[i]);
+		lx += ax;
+		ly += ay;
+		lz += az;
+
+		momentumScale += m[i] * sqrt(v2);
+		angularMomentumScale += sqrt(ax * ax + ay * ay + az * az);
+	}
+
+	_last.step = step;
+	_last.time = time;
+	_last.kineticEnergy = kinetic;
+	_last.potentialEnergy = potential;
+	_last.totalEnergy = kinetic + potential;
+	_last.momentum = Eigen::Vector3d(px, py, pz);
+	_last.angularMomentum = Eigen::Vector3d(lx, ly, lz);
+
+	if (!_hasReference) {
+		_hasReference = true;
+		_energy0 = _last.totalEnergy;
+		_momentum0 = _last.momentum;
+		_angularMomentum0 = _last.angularMomentum;
+		_momentumScale = momentumScale;
+		_angularMomentumScale = angularMomentumScale;
+	}
+
+	// a scene at rest has no scale, the drifts are absolute then
+	_last.energyDrift = std::abs(_last.totalEnergy - _energy0) / (_energy0 != 0.0 ? std::abs(_energy0) : 1.0);
+	_last.momentumDrift = (_last.momentum - _momentum0).norm() / (_momentumScale > 0.0 ? _momentumScale : 1.0);
+	_last.angularMomentumDrift = (_last.angularMomentum - _angularMomentum0).norm() / (_angularMomentumScale > 0.0 ? _angularMomentumScale : 1.0);
+
+	return _last;
+}
@@ -0,0 +1,141 @@
+﻿/**
+ * \brief Implementation of the diagnostics of the conserved quantities (energy, momentum and angular momentum).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <vector>
+
+
+// forward declarations
+namespace pbs17 {
+	class BodyState;
+	class NBodyManager;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Measures the conserved quantities of the simulated bodies every few steps, to validate the integrators
+	 * and the approximations of the gravity-solvers. The kinetic energy, the momentum and the angular momentum are
+	 * parallel reductions over the body-state, the potential energy is calculated by the active gravity-solver at the
+	 * same approximation as its forces (see NBodyManager::computePotentials()), so a measurement costs about one
+	 * evaluation of the forces.
+	 *
+	 * The drifts are relative to the first measurement. Only the translational motion is measured (the spins of the
+	 * bodies and the energy which is dissipated by the collisions or added by spawned bodies show up as drift).
+	 */
+	class Diagnostics {
+	public:
+		/**
+		 * \brief Conserved quantities of one measurement.
+		 */
+		struct Sample {
+			//! Step and simulated time of the measurement
+			unsigned long step = 0;
+			double time = 0.0;
+			//! Kinetic, potential and total energy
+			double kineticEnergy = 0.0;
+			double potentialEnergy = 0.0;
+			double totalEnergy = 0.0;
+			//! Total momentum and angular momentum (around the origin)
+			Eigen::Vector3d momentum = Eigen::Vector3d::Zero();
+			Eigen::Vector3d angularMomentum = Eigen::Vector3d::Zero();
+			//! Change since the first measurement: relative to |E_0|, sum(m_i |v_i|) and sum(m_i |r_i x v_i|) of the first measurement
+			double energyDrift = 0.0;
+			double momentumDrift = 0.0;
+			double angularMomentumDrift = 0.0;
+		};
+
+
+		/**
+		 * \brief Measure the conserved quantities of the bodies.
+		 *
+		 * \param step, time
+		 *      Current step and simulated time.
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param nManager
+		 *      Nbody-manager with the active gravity-solver (for the potential).
+		 *
+		 * \return Measurement (the first one is the reference of the drifts).
+		 */
+		const Sample& measure(unsigned long step, double time, const BodyState &bodies, NBodyManager &nManager);
+
+
+		/**
+		 * \brief Set the steps between two measurements.
+		 *
+		 * \param interval
+		 *      Steps between two measurements (0 => no measurements).
+		 */
+		void setInterval(const unsigned int interval) {
+			_interval = interval;
+		}
+
+
+		/**
+		 * \brief Check if a step has to be measured.
+		 *
+		 * \param step
+		 *      Number of the step.
+		 *
+		 * \return True if the step is a multiple of the interval.
+		 */
+		bool isDue(const unsigned long step) const {
+			return _interval > 0 && step % _interval == 0;
+		}
+
+
+		/**
+		 * \brief Check if the diagnostics are enabled.
+		 *
+		 * \return True if the interval is set.
+		 */
+		bool isEnabled() const {
+			return _interval > 0;
+		}
+
+
+		/**
+		 * \brief Get the last measurement.
+		 *
+		 * \return Last measurement (zero before the first one).
+		 */
+		const Sample& getLast() const {
+			return _last;
+		}
+
+
+		/**
+		 * \brief Use the next measurement as the new reference of the drifts (e.g. after the scene was changed).
+		 */
+		void reset() {
+			_hasReference = false;
+		}
+
+
+	private:
+		//! Steps between two measurements (0 => no measurements)
+		unsigned int _interval = 0;
+		//! True if the reference has been measured
+		bool _hasReference = false;
+		//! Total energy of the reference
+		double _energy0 = 0.0;
+		//! Momentum and angular momentum of the reference
+		Eigen::Vector3d _momentum0 = Eigen::Vector3d::Zero();
+		Eigen::Vector3d _angularMomentum0 = Eigen::Vector3d::Zero();
+		//! Scales of the drifts of the momentum and the angular momentum (sums of the magnitudes of the reference)
+		double _momentumScale = 0.0;
+		double _angularMomentumScale = 0.0;
+		//! Last measurement
+		Sample _last;
+		//! Potential per body (kept between the measurements)
+		std::vector<double> _phi;
+	};
+}
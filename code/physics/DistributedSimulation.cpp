@@ -0,0 +1,592 @@
+﻿/**
+ * \brief Implementation of the headless simulation which is split across MPI-ranks by spatial domains.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-08
+ */
+
+#include "DistributedSimulation.h"
+
+#include <iostream>
+#include <limits>
+#include <cmath>
+
+#if defined(PBS17_MPI)
+#include <mpi.h>
+#endif
+
+#include "../scene/SpaceObject.h"
+#include "CollisionManager.h"
+#include "Logger.h"
+
+using namespace pbs17;
+
+const double DistributedSimulation::G = 1.0;
+const double DistributedSimulation::EPS = 0.000000001;
+
+
+namespace {
+
+	/**
+	 * \brief Append the state of a space-object to a buffer (see BODY_RECORD).
+	 *
+	 * \param index
+	 *      Index of the space-object in the scene.
+	 * \param spaceObject
+	 *      Space-object which is sent.
+	 * \param force
+	 *      Force of the last step.
+	 * \param buffer
+	 *      Output-parameter: Buffer of the target rank.
+	 */
+	void packBody(int index, const SpaceObject* spaceObject, const Eigen::Vector3d &force, std::vector<double> &buffer) {
+		Eigen::Vector3d p = spaceObject->getPosition();
+		osg::Quat q = spaceObject->getOrientation();
+		Eigen::Vector3d v = spaceObject->getLinearVelocity();
+		Eigen::Vector3d w = spaceObject->getAngularVelocity();
+
+		double record[] = { static_cast<double>(index), p(0), p(1), p(2), q.x(), q.y(), q.z(), q.w(),
+			v(0), v(1), v(2), w(0), w(1), w(2), force(0), force(1), force(2) };
+		buffer.insert(buffer.end(), record, record + sizeof(record) / sizeof(double));
+	}
+
+
+	/**
+	 * \brief Apply a received state to its space-object.
+	 *
+	 * \param record
+	 *      Received record (see BODY_RECORD).
+	 * \param spaceObjects
+	 *      All space-objects in the scene.
+	 * \param force
+	 *      Output-parameter: Force of the last step.
+	 *
+	 * \return Index of the space-object in the scene.
+	 */
+	int unpackBody(const double* record, const std::vector<SpaceObject*> &spaceObjects, Eigen::Vector3d &force) {
+		int index = static_cast<int>(record[0]);
+		SpaceObject* spaceObject = spaceObjects[index];
+
+		spaceObject->setLinearVelocity(Eigen::Vector3d(record[8], record[9], record[10]));
+		spaceObject->setAngularVelocity(Eigen::Vector3d(record[11], record[12], record[13]));
+		spaceObject->setPositionOrientation(Eigen::Vector3d(record[1], record[2], record[3]),
+			osg::Quat(record[4], record[5], record[6], record[7]));
+		force = Eigen::Vector3d(record[14], record[15], record[16]);
+
+		return index;
+	}
+}
+
+
+/**
+ * \brief Constructor of the distributed simulation (initializes MPI if needed). Every rank has to
+ *        load the same scene.
+ *
+ * \param spaceObjects
+ *      All space-objects in the scene.
+ * \param settings
+ *      Simulation-settings of the scene (theta, dt, broadPhase, solverIterations, rebalanceInterval, ...).
+ */
+DistributedSimulation::DistributedSimulation(const std::vector<SpaceObject*> &spaceObjects, json settings)
+	: _spaceObjects(spaceObjects) {
+#if defined(PBS17_MPI)
+	int isInitialized = 0;
+	MPI_Initialized(&isInitialized);
+	if (!isInitialized) {
+		MPI_Init(nullptr, nullptr);
+		_isMpiOwner = true;
+	}
+
+	MPI_Comm_rank(MPI_COMM_WORLD, &_rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &_cntRanks);
+#endif
+
+	if (settings["theta"].is_number()) {
+		_tree.setTheta(settings["theta"].get<double>());
+	}
+
+	if (settings["dt"].is_number()) {
+		_dt = std::min(std::max(settings["dt"].get<double>(), 0.0), 1.0);
+	}
+
+	if (settings["rebalanceInterval"].is_number_integer()) {
+		setRebalanceInterval(settings["rebalanceInterval"].get<int>());
+	}
+
+	// the local objects change every step, the spatial-hash is rebuilt anyway
+	_cManager = new CollisionManager(std::vector<SpaceObject*>());
+	CollisionManager::BroadPhase broadPhase = CollisionManager::SPATIAL_HASH;
+	if (settings["broadPhase"].is_string()
+		&& !CollisionManager::parseBroadPhase(settings["broadPhase"].get<std::string>(), broadPhase)) {
+		LOG_WARNING("Broad-phase (" + settings["broadPhase"].get<std::string>() + ") not supported!");
+	}
+	_cManager->setBroadPhase(broadPhase);
+
+	if (settings["collisions"].is_boolean()) {
+		_cManager->setIsEnabled(settings["collisions"].get<bool>());
+	}
+
+	if (settings["hashCellSize"].is_number()) {
+		_cManager->getSpatialHash().setCellSize(settings["hashCellSize"].get<double>());
+	}
+
+	if (settings["solverIterations"].is_number_integer()) {
+		_cManager->setSolverIterations(settings["solverIterations"].get<int>());
+	}
+
+	if (settings["batchedSolver"].is_boolean()) {
+		_cManager->setIsBatchedSolver(settings["batchedSolver"].get<bool>());
+	}
+
+	if (settings["restitution"].is_number()) {
+		_cManager->setRestitution(settings["restitution"].get<double>());
+	}
+
+	if (settings["friction"].is_number()) {
+		_cManager->setFriction(settings["friction"].get<double>());
+	}
+
+	// the contacts of the own bodies and the ghosts are in a different order on each rank
+	_cManager->setIsDeterministic(true);
+
+	decompose(true);
+}
+
+
+/**
+ * \brief Destructor of the distributed simulation (finalizes MPI if it was initialized by the constructor).
+ */
+DistributedSimulation::~DistributedSimulation() {
+	delete _cManager;
+
+#if defined(PBS17_MPI)
+	if (_isMpiOwner) {
+		MPI_Finalize();
+	}
+#endif
+}
+
+
+/**
+ * \brief Simulate one step of the bodies of the own domain.
+ *
+ * \param dt
+ *      Time difference of the step.
+ */
+void DistributedSimulation::step(double dt) {
+	_bodies.gather(_ownedObjects);
+	if (!_hasForces) {
+		computeForces();
+	}
+
+	// first kick and drift (same as the leapfrog of NBodyManager)
+	int n = _owned.size();
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		Eigen::Vector3d v = _bodies.getLinearVelocity(i) + (0.5 * dt / _bodies.m[i]) * _forces[i];
+		_bodies.setLinearVelocity(i, v);
+		_bodies.setPosition(i, _bodies.getPosition(i) + dt * v);
+	}
+	_bodies.rotate(nullptr, n, dt);
+	_bodies.scatter(_ownedObjects);
+
+	++_cntSteps;
+	if (_cntSteps % _rebalanceInterval == 0) {
+		decompose(false);
+	} else {
+		migrate();
+	}
+
+	// second kick with the forces at the new positions
+	_bodies.gather(_ownedObjects);
+	computeForces();
+
+	n = _owned.size();
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		_bodies.setLinearVelocity(i, _bodies.getLinearVelocity(i) + (0.5 * dt / _bodies.m[i]) * _forces[i]);
+	}
+	_bodies.scatter(_ownedObjects);
+
+	handleCollisions(dt);
+}
+
+
+/**
+ * \brief Get the number of bodies of each rank (collective call, all ranks have to call it).
+ *
+ * \return Bodies per rank.
+ */
+std::vector<unsigned int> DistributedSimulation::getNumBodiesPerRank() const {
+	std::vector<double> recv;
+	allGather(std::vector<double>(1, static_cast<double>(_owned.size())), recv);
+
+	std::vector<unsigned int> bodiesPerRank(recv.size());
+	for (unsigned int r = 0; r < recv.size(); ++r) {
+		bodiesPerRank[r] = static_cast<unsigned int>(recv[r]);
+	}
+
+	return bodiesPerRank;
+}
+
+
+/**
+ * \brief Check if MPI is compiled in (cmake -DPBS17_MPI=ON).
+ *
+ * \return True if the ranks are separate processes.
+ */
+bool DistributedSimulation::isEnabled() {
+#if defined(PBS17_MPI)
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * \brief Split the bodies into the domains (orthogonal recursive bisection) and send the bodies whose
+ *        domain has changed to their new rank.
+ *
+ * \param isInitial
+ *      True if all ranks know the state of all bodies (after loading), nothing is sent.
+ */
+void DistributedSimulation::decompose(bool isInitial) {
+	std::vector<std::pair<Eigen::Vector3d, int>> items;
+
+	if (isInitial) {
+		for (unsigned int i = 0; i < _spaceObjects.size(); ++i) {
+			items.push_back(std::make_pair(_spaceObjects[i]->getPosition(), static_cast<int>(i)));
+		}
+	} else {
+		std::vector<double> send;
+		for (unsigned int k = 0; k < _owned.size(); ++k) {
+			Eigen::Vector3d p = _ownedObjects[k]->getPosition();
+			send.push_back(_owned[k]);
+			send.push_back(p(0));
+			send.push_back(p(1));
+			send.push_back(p(2));
+		}
+
+		std::vector<double> recv;
+		allGather(send, recv);
+
+		for (unsigned int j = 0; j + 3 < recv.size(); j += 4) {
+			items.push_back(std::make_pair(Eigen::Vector3d(recv[j + 1], recv[j + 2], recv[j + 3]), static_cast<int>(recv[j])));
+		}
+
+		// every rank bisects the same sequence (independent of the previous owners)
+		std::sort(items.begin(), items.end(), [](const std::pair<Eigen::Vector3d, int> &a, const std::pair<Eigen::Vector3d, int> &b) {
+			return a.second < b.second;
+		});
+	}
+
+	double max = std::numeric_limits<double>::max();
+	Domain domain = { Eigen::Vector3d(-max, -max, -max), Eigen::Vector3d(max, max, max) };
+	_domains.resize(_cntRanks);
+	bisect(items, 0, items.size(), 0, _cntRanks, domain);
+
+	if (isInitial) {
+		_owned.clear();
+		_ownedObjects.clear();
+		for (unsigned int i = 0; i < _spaceObjects.size(); ++i) {
+			if (getOwner(_spaceObjects[i]->getPosition()) == _rank) {
+				_owned.push_back(i);
+				_ownedObjects.push_back(_spaceObjects[i]);
+			}
+		}
+
+		_forces.assign(_owned.size(), Eigen::Vector3d::Zero());
+		_hasForces = false;
+	} else {
+		migrate();
+	}
+}
+
+
+/**
+ * \brief Bisect the bodies recursively into the domains of a range of ranks.
+ *
+ * \param items
+ *      Positions and indices of the bodies (reordered).
+ * \param first, last
+ *      Range of the bodies.
+ * \param firstRank, cntRanks
+ *      Range of the ranks which share the bodies.
+ * \param domain
+ *      Box which is split.
+ */
+void DistributedSimulation::bisect(std::vector<std::pair<Eigen::Vector3d, int>> &items, int first, int last, int firstRank, int cntRanks, const Domain &domain) {
+	if (cntRanks == 1) {
+		_domains[firstRank] = domain;
+		return;
+	}
+
+	// the bodies are split in the ratio of the ranks along the longest extent
+	int leftRanks = cntRanks / 2;
+	int middle = first + static_cast<int>(static_cast<long long>(last - first) * leftRanks / cntRanks);
+	int axis = 0;
+	double split = std::min(std::max(0.0, domain.min(0)), domain.max(0));
+
+	if (last > first) {
+		double max = std::numeric_limits<double>::max();
+		Eigen::Vector3d bbMin(max, max, max);
+		Eigen::Vector3d bbMax(-max, -max, -max);
+		for (int j = first; j < last; ++j) {
+			bbMin = bbMin.cwiseMin(items[j].first);
+			bbMax = bbMax.cwiseMax(items[j].first);
+		}
+		(bbMax - bbMin).maxCoeff(&axis);
+
+		// ties are broken by the index, so all ranks get the same split
+		std::nth_element(items.begin() + first, items.begin() + middle, items.begin() + last,
+			[axis](const std::pair<Eigen::Vector3d, int> &a, const std::pair<Eigen::Vector3d, int> &b) {
+			return a.first(axis) < b.first(axis) || (a.first(axis) == b.first(axis) && a.second < b.second);
+		});
+		split = items[middle].first(axis);
+	}
+
+	Domain left = domain;
+	left.max(axis) = split;
+	Domain right = domain;
+	right.min(axis) = split;
+
+	bisect(items, first, middle, firstRank, leftRanks, left);
+	bisect(items, middle, last, firstRank + leftRanks, cntRanks - leftRanks, right);
+}
+
+
+/**
+ * \brief Send the bodies which have left the own domain to the rank of their new domain.
+ */
+void DistributedSimulation::migrate() {
+	std::vector<int> owners(_owned.size());
+	for (unsigned int k = 0; k < _owned.size(); ++k) {
+		owners[k] = getOwner(_ownedObjects[k]->getPosition());
+	}
+
+	sendBodies(owners);
+}
+
+
+/**
+ * \brief Send the bodies of the own domain to their new ranks and receive the bodies of the other ranks.
+ *
+ * \param owners
+ *      New rank per own body.
+ */
+void DistributedSimulation::sendBodies(const std::vector<int> &owners) {
+	std::vector<std::vector<double>> send(_cntRanks);
+	std::vector<int> owned;
+	std::vector<SpaceObject*> ownedObjects;
+	std::vector<Eigen::Vector3d> forces;
+
+	for (unsigned int k = 0; k < _owned.size(); ++k) {
+		if (owners[k] == _rank) {
+			owned.push_back(_owned[k]);
+			ownedObjects.push_back(_ownedObjects[k]);
+			forces.push_back(_forces[k]);
+		} else {
+			packBody(_owned[k], _ownedObjects[k], _forces[k], send[owners[k]]);
+		}
+	}
+
+	std::vector<double> recv;
+	exchange(send, recv);
+
+	for (unsigned int j = 0; j + BODY_RECORD <= recv.size(); j += BODY_RECORD) {
+		Eigen::Vector3d force;
+		int index = unpackBody(&recv[j], _spaceObjects, force);
+
+		owned.push_back(index);
+		ownedObjects.push_back(_spaceObjects[index]);
+		forces.push_back(force);
+	}
+
+	_owned.swap(owned);
+	_ownedObjects.swap(ownedObjects);
+	_forces.swap(forces);
+}
+
+
+/**
+ * \brief Calculate the forces of the own bodies with the locally essential trees of the other domains.
+ */
+void DistributedSimulation::computeForces() {
+	int n = _owned.size();
+	std::vector<Eigen::Vector3d> positions(n);
+	std::vector<double> masses(n);
+	for (int i = 0; i < n; ++i) {
+		positions[i] = _bodies.getPosition(i);
+		masses[i] = _bodies.m[i];
+	}
+
+	// the cells of the own tree which each remote domain needs (4 doubles per point-mass)
+	_tree.build(positions, masses.data());
+	std::vector<std::vector<double>> send(_cntRanks);
+	for (int r = 0; r < _cntRanks; ++r) {
+		if (r == _rank) continue;
+
+		std::vector<Eigen::Vector3d> essentialPositions;
+		std::vector<double> essentialMasses;
+		_tree.collectEssential(_domains[r].min, _domains[r].max, essentialPositions, essentialMasses);
+
+		for (unsigned int j = 0; j < essentialPositions.size(); ++j) {
+			send[r].push_back(essentialPositions[j](0));
+			send[r].push_back(essentialPositions[j](1));
+			send[r].push_back(essentialPositions[j](2));
+			send[r].push_back(essentialMasses[j]);
+		}
+	}
+
+	std::vector<double> recv;
+	exchange(send, recv);
+	_cntImported = recv.size() / 4;
+
+	// the own bodies come first, so their index in the tree is the same as in the state
+	for (unsigned int j = 0; j + 3 < recv.size(); j += 4) {
+		positions.push_back(Eigen::Vector3d(recv[j], recv[j + 1], recv[j + 2]));
+		masses.push_back(recv[j + 3]);
+	}
+	_tree.build(positions, masses.data());
+
+	_forces.resize(n);
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int i = 0; i < n; ++i) {
+		_forces[i] = (G * masses[i]) * _tree.computeField(i, EPS);
+	}
+
+	_hasForces = true;
+}
+
+
+/**
+ * \brief Detect and respond to the collisions of the own bodies (with the ghosts of the other domains).
+ *
+ * \param dt
+ *      Time difference of the step (extends the ghost-region).
+ */
+void DistributedSimulation::handleCollisions(double dt) {
+	std::vector<std::vector<double>> send(_cntRanks);
+
+	for (unsigned int k = 0; k < _owned.size(); ++k) {
+		osg::BoundingBox aabb = _ownedObjects[k]->getAABB();
+		double margin = dt * _ownedObjects[k]->getLinearVelocity().norm();
+		Eigen::Vector3d aabbMin(aabb.xMin() - margin, aabb.yMin() - margin, aabb.zMin() - margin);
+		Eigen::Vector3d aabbMax(aabb.xMax() + margin, aabb.yMax() + margin, aabb.zMax() + margin);
+
+		for (int r = 0; r < _cntRanks; ++r) {
+			if (r == _rank) continue;
+
+			if ((aabbMax.array() >= _domains[r].min.array()).all() && (aabbMin.array() < _domains[r].max.array()).all()) {
+				packBody(_owned[k], _ownedObjects[k], _forces[k], send[r]);
+			}
+		}
+	}
+
+	std::vector<double> recv;
+	exchange(send, recv);
+
+	std::vector<SpaceObject*> localObjects = _ownedObjects;
+	for (unsigned int j = 0; j + BODY_RECORD <= recv.size(); j += BODY_RECORD) {
+		Eigen::Vector3d force;
+		localObjects.push_back(_spaceObjects[unpackBody(&recv[j], _spaceObjects, force)]);
+	}
+	_cntGhosts = localObjects.size() - _ownedObjects.size();
+
+	// the ghosts are updated as well, but their rank owns their actual state
+	BodyState localBodies;
+	localBodies.gather(localObjects);
+	_cManager->setSpaceObjects(localObjects);
+	_cManager->handleCollisions(dt, localObjects, localBodies);
+}
+
+
+/**
+ * \brief Get the rank of the domain which contains a position.
+ *
+ * \param position
+ *      Position of a body.
+ *
+ * \return Rank of the domain.
+ */
+int DistributedSimulation::getOwner(const Eigen::Vector3d &position) const {
+	for (int r = 0; r < _cntRanks; ++r) {
+		if ((position.array() >= _domains[r].min.array()).all() && (position.array() < _domains[r].max.array()).all()) {
+			return r;
+		}
+	}
+
+	// outside of all boxes (not finite), the body stays on its rank
+	return _rank;
+}
+
+
+/**
+ * \brief Exchange a buffer with each rank (all-to-all).
+ *
+ * \param send
+ *      Buffer per target rank.
+ * \param recv
+ *      Output-parameter: Received buffers of all ranks, in the order of the ranks (overwritten).
+ */
+void DistributedSimulation::exchange(const std::vector<std::vector<double>> &send, std::vector<double> &recv) const {
+#if defined(PBS17_MPI)
+	std::vector<int> sendCounts(_cntRanks), sendOffsets(_cntRanks), recvCounts(_cntRanks), recvOffsets(_cntRanks);
+	std::vector<double> sendBuffer;
+	for (int r = 0; r < _cntRanks; ++r) {
+		sendCounts[r] = send[r].size();
+		sendOffsets[r] = sendBuffer.size();
+		sendBuffer.insert(sendBuffer.end(), send[r].begin(), send[r].end());
+	}
+
+	MPI_Alltoall(sendCounts.data(), 1, MPI_INT, recvCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+	int total = 0;
+	for (int r = 0; r < _cntRanks; ++r) {
+		recvOffsets[r] = total;
+		total += recvCounts[r];
+	}
+
+	recv.resize(total);
+	MPI_Alltoallv(sendBuffer.data(), sendCounts.data(), sendOffsets.data(), MPI_DOUBLE,
+		recv.data(), recvCounts.data(), recvOffsets.data(), MPI_DOUBLE, MPI_COMM_WORLD);
+#else
+	recv = send[_rank];
+#endif
+}
+
+
+/**
+ * \brief Gather a buffer of each rank on all ranks.
+ *
+ * \param send
+ *      Buffer of the own rank.
+ * \param recv
+ *      Output-parameter: Buffers of all ranks, in the order of the ranks (overwritten).
+ */
+void DistributedSimulation::allGather(const std::vector<double> &send, std::vector<double> &recv) const {
+#if defined(PBS17_MPI)
+	int count = send.size();
+	std::vector<int> recvCounts(_cntRanks), recvOffsets(_cntRanks);
+	MPI_Allgather(&count, 1, MPI_INT, recvCounts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+	int total = 0;
+	for (int r = 0; r < _cntRanks; ++r) {
+		recvOffsets[r] = total;
+		total += recvCounts[r];
+	}
+
+	recv.resize(total);
+	MPI_Allgatherv(const_cast<double*>(send.data()), count, MPI_DOUBLE,
+		recv.data(), recvCounts.data(), recvOffsets.data(), MPI_DOUBLE, MPI_COMM_WORLD);
+#else
+	recv = send;
+#endif
+}
@@ -0,0 +1,294 @@
+﻿/**
+ * \brief Implementation of the headless simulation which is split across MPI-ranks by spatial domains.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-08
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <json.hpp>
+#include <Eigen/Core>
+
+#include "BodyState.h"
+#include "BarnesHutTree.h"
+
+using json = nlohmann::json;
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+	class CollisionManager;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Simulates a scene on several MPI-ranks (headless). Each rank loads the whole scene, but only integrates
+	 * the bodies of its domain. The domains are boxes of an orthogonal recursive bisection with the same number of
+	 * bodies per rank, they are recomputed every n steps (rebalance).
+	 *
+	 * Each step (kick-drift-kick leapfrog):
+	 *  - The bodies which left the domain migrate to the rank of their new domain (with their last force).
+	 *  - Gravity: each rank sends the locally essential tree of its Barnes-Hut tree to the other domains (the cells
+	 *    which the whole remote domain approximates, and the bodies of the opened cells). The forces of the own
+	 *    bodies are calculated with the tree of the own bodies and the received cells.
+	 *  - Collisions: the bodies whose AABB (extended by their motion of the step) overlaps another domain are sent
+	 *    to its rank as ghosts. The own bodies are checked against each other and the ghosts, the response of the
+	 *    ghosts is dropped (it's calculated by their own rank as well).
+	 *
+	 * Without MPI (cmake -DPBS17_MPI=OFF), the simulation runs as a single rank which owns all bodies.
+	 */
+	class DistributedSimulation {
+	public:
+		/**
+		 * \brief Constructor of the distributed simulation (initializes MPI if needed). Every rank has to
+		 *        load the same scene.
+		 *
+		 * \param spaceObjects
+		 *      All space-objects in the scene.
+		 * \param settings
+		 *      Simulation-settings of the scene (theta, broadPhase, solverIterations, rebalanceInterval, ...).
+		 */
+		DistributedSimulation(const std::vector<SpaceObject*> &spaceObjects, json settings = json::object());
+
+
+		/**
+		 * \brief Destructor of the distributed simulation (finalizes MPI if it was initialized by the constructor).
+		 */
+		~DistributedSimulation();
+
+
+		/**
+		 * \brief Simulate one step of the bodies of the own domain.
+		 *
+		 * \param dt
+		 *      Time difference of the step.
+		 */
+		void step(double dt);
+
+
+		/**
+		 * \brief Get the time difference of a step (simulation-setting dt, same default as SimulationManager).
+		 *
+		 * \return Time difference of a step.
+		 */
+		double getSimulationDt() const {
+			return _dt;
+		}
+
+
+		/**
+		 * \brief Get the index of the own rank.
+		 *
+		 * \return Rank (0 => reports the results).
+		 */
+		int getRank() const {
+			return _rank;
+		}
+
+
+		/**
+		 * \brief Get the number of ranks.
+		 *
+		 * \return Number of domains.
+		 */
+		int getNumRanks() const {
+			return _cntRanks;
+		}
+
+
+		/**
+		 * \brief Get the number of bodies of each rank (collective call, all ranks have to call it).
+		 *
+		 * \return Bodies per rank.
+		 */
+		std::vector<unsigned int> getNumBodiesPerRank() const;
+
+
+		/**
+		 * \brief Get the number of bodies which were received as ghosts in the last step.
+		 *
+		 * \return Ghosts of the own domain.
+		 */
+		unsigned int getNumGhosts() const {
+			return _cntGhosts;
+		}
+
+
+		/**
+		 * \brief Get the number of cells and bodies which were received as locally essential tree in the last step.
+		 *
+		 * \return Imported point-masses.
+		 */
+		unsigned int getNumImported() const {
+			return _cntImported;
+		}
+
+
+		/**
+		 * \brief Set the number of steps between two decompositions.
+		 *
+		 * \param interval
+		 *      Steps between two rebalances (at least 1).
+		 */
+		void setRebalanceInterval(const int interval) {
+			_rebalanceInterval = std::max(interval, 1);
+		}
+
+
+		/**
+		 * \brief Check if MPI is compiled in (cmake -DPBS17_MPI=ON).
+		 *
+		 * \return True if the ranks are separate processes.
+		 */
+		static bool isEnabled();
+
+
+	private:
+		/**
+		 * \brief Box of the domain of a rank (lower bound inclusive, upper bound exclusive).
+		 */
+		struct Domain {
+			Eigen::Vector3d min;
+			Eigen::Vector3d max;
+		};
+
+		//! Doubles per migrated body: index, position, orientation (x, y, z, w), linear and angular velocity, force
+		static const int BODY_RECORD = 17;
+		//! Same gravitational constant and softening as NBodyManager
+		static const double G;
+		static const double EPS;
+
+		//! Rank and number of ranks
+		int _rank = 0;
+		int _cntRanks = 1;
+		//! True if MPI was initialized by this simulation
+		bool _isMpiOwner = false;
+
+		//! All space-objects in the scene (the same on all ranks)
+		std::vector<SpaceObject*> _spaceObjects;
+		//! Indices of the bodies of the own domain, their space-objects, state and forces (same order)
+		std::vector<int> _owned;
+		std::vector<SpaceObject*> _ownedObjects;
+		BodyState _bodies;
+		std::vector<Eigen::Vector3d> _forces;
+		//! True if the forces are calculated for the current positions
+		bool _hasForces = false;
+
+		//! Domain per rank
+		std::vector<Domain> _domains;
+		//! Time difference of a step
+		double _dt = 0.01;
+		//! Steps between two decompositions
+		int _rebalanceInterval = 50;
+		//! Number of simulated steps
+		unsigned long _cntSteps = 0;
+
+		//! Tree of the own bodies and the received cells
+		BarnesHutTree _tree;
+		//! Collision-detection of the own bodies and the ghosts
+		CollisionManager* _cManager;
+
+		//! Statistics of the last step
+		unsigned int _cntGhosts = 0;
+		unsigned int _cntImported = 0;
+
+
+		/**
+		 * \brief Split the bodies into the domains (orthogonal recursive bisection) and send the bodies whose
+		 *        domain has changed to their new rank.
+		 *
+		 * \param isInitial
+		 *      True if all ranks know the state of all bodies (after loading), nothing is sent.
+		 */
+		void decompose(bool isInitial);
+
+
+		/**
+		 * \brief Bisect the bodies recursively into the domains of a range of ranks.
+		 *
+		 * \param items
+		 *      Positions and indices of the bodies (reordered).
+		 * \param first, last
+		 *      Range of the bodies.
+		 * \param firstRank, cntRanks
+		 *      Range of the ranks which share the bodies.
+		 * \param domain
+		 *      Box which is split.
+		 */
+		void bisect(std::vector<std::pair<Eigen::Vector3d, int>> &items, int first, int last, int firstRank, int cntRanks, const Domain &domain);
+
+
+		/**
+		 * \brief Send the bodies which have left the own domain to the rank of their new domain.
+		 */
+		void migrate();
+
+
+		/**
+		 * \brief Send the bodies of the own domain to their new ranks and receive the bodies of the other ranks.
+		 *
+		 * \param owners
+		 *      New rank per own body.
+		 */
+		void sendBodies(const std::vector<int> &owners);
+
+
+		/**
+		 * \brief Calculate the forces of the own bodies with the locally essential trees of the other domains.
+		 */
+		void computeForces();
+
+
+		/**
+		 * \brief Detect and respond to the collisions of the own bodies (with the ghosts of the other domains).
+		 *
+		 * \param dt
+		 *      Time difference of the step (extends the ghost-region).
+		 */
+		void handleCollisions(double dt);
+
+
+		/**
+		 * \brief Get the rank of the domain which contains a position.
+		 *
+		 * \param position
+		 *      Position of a body.
+		 *
+		 * \return Rank of the domain.
+		 */
+		int getOwner(const Eigen::Vector3d &position) const;
+
+
+		/**
+		 * \brief Exchange a buffer with each rank (all-to-all).
+		 *
+		 * \param send
+		 *      Buffer per target rank.
+		 * \param recv
+		 *      Output-parameter: Received buffers of all ranks, in the order of the ranks (overwritten).
+		 */
+		void exchange(const std::vector<std::vector<double>> &send, std::vector<double> &recv) const;
+
+
+		/**
+		 * \brief Gather a buffer of each rank on all ranks.
+		 *
+		 * \param send
+		 *      Buffer of the own rank.
+		 * \param recv
+		 *      Output-parameter: Buffers of all ranks, in the order of the ranks (overwritten).
+		 */
+		void allGather(const std::vector<double> &send, std::vector<double> &recv) const;
+
+
+		//! Copying would share the collision-manager
+		DistributedSimulation(DistributedSimulation const&) = delete;
+		DistributedSimulation& operator=(DistributedSimulation const&) = delete;
+	};
+}
@@ -0,0 +1,545 @@
+﻿/**
+ * \brief Implementation of the massless dust-particles of the ring-systems.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "DustManager.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <algorithm>
+#include <OpenThreads/ScopedLock>
+#include <osg/Math>
+#include <osg/NodeCallback>
+#include <osgUtil/CullVisitor>
+#include <Eigen/Geometry>
+
+#include "BodyState.h"
+#include "Profiler.h"
+#include "../scene/SpaceObject.h"
+#include "../osg/JsonEigenConversions.h"
+#include "../osg/OsgEigenConversions.h"
+#include "../osg/shaders/DustShader.h"
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Uniform random number of a particle (hashed, so the particles are generated independently).
+	 *
+	 * \param seed
+	 *      Seed of the dust.
+	 * \param index
+	 *      Index of the particle.
+	 * \param k
+	 *      Index of the random number of the particle.
+	 *
+	 * \return Random number in [0, 1).
+	 */
+	double getRandom(uint64_t seed, uint64_t index, uint64_t k) {
+		uint64_t z = seed * 0x9E3779B97F4A7C15ull + index * 4 + k + 1;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		z ^= z >> 31;
+		return static_cast<double>(z >> 11) / 9007199254740992.0;
+	}
+
+
+	/**
+	 * \brief Random numbers of a cell in a step (splitmix64).
+	 */
+	struct CellRandom {
+		uint64_t state;
+
+		CellRandom(uint64_t seed, uint64_t step, int x, int y, int z)
+			: state(seed * 0x9E3779B97F4A7C15ull ^ step * 0xD1B54A32D192ED03ull ^ static_cast<uint32_t>(x) * 73856093ull
+				^ (static_cast<uint64_t>(static_cast<uint32_t>(y)) << 21) * 19349663ull ^ (static_cast<uint64_t>(static_cast<uint32_t>(z)) << 42) * 83492791ull) {}
+
+		//! Random number in [0, 1)
+		double next() {
+			uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			z ^= z >> 31;
+			return static_cast<double>(z >> 11) / 9007199254740992.0;
+		}
+	};
+
+
+	/**
+	 * \brief Hash-function of a cell (same as the SpatialHash).
+	 */
+	int getBucket(int x, int y, int z, unsigned int mask) {
+		return static_cast<int>(((static_cast<unsigned int>(x) * 73856093u) ^ (static_cast<unsigned int>(y) * 19349663u)
+			^ (static_cast<unsigned int>(z) * 83492791u)) & mask);
+	}
+
+
+	/**
+	 * \brief Copies the snapshot of the physics-thread to the geometry.
+	 */
+	class DustUpdateCallback : public osg::NodeCallback {
+	public:
+		DustUpdateCallback(DustManager* manager) : _manager(manager) {}
+
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			_manager->applySnapshot();
+			traverse(node, nv);
+		}
+
+	private:
+		DustManager* _manager;
+	};
+
+
+	/**
+	 * \brief Updates the height of the viewport for the size of the sprites.
+	 */
+	class DustCullCallback : public osg::NodeCallback {
+	public:
+		DustCullCallback(osg::ref_ptr<osg::Uniform> viewportHeight) : _viewportHeight(viewportHeight) {}
+
+		void operator()(osg::Node* node, osg::NodeVisitor* nv) override {
+			osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(nv);
+
+			if (cv) {
+				_viewportHeight->set(static_cast<float>(cv->getViewport()->height()));
+			}
+
+			traverse(node, nv);
+		}
+
+	private:
+		osg::ref_ptr<osg::Uniform> _viewportHeight;
+	};
+}
+
+
+/**
+ * \brief Constructor of the dust-manager: Generate the particles on circular orbits around the heaviest body.
+ *
+ * \param settings
+ *      The "dust"-settings of the simulation.
+ * \param bodies
+ *      State of the bodies at the start.
+ */
+DustManager::DustManager(nlohmann::json settings, const BodyState &bodies) {
+	int count = settings["count"].is_number_integer() ? std::max(settings["count"].get<int>(), 0) : 0;
+	double innerRadius = settings["innerRadius"].is_number() ? settings["innerRadius"].get<double>() : 2.0;
+	double outerRadius = settings["outerRadius"].is_number() ? settings["outerRadius"].get<double>() : 4.0;
+	double thickness = settings["thickness"].is_number() ? settings["thickness"].get<double>() : 0.05;
+	uint64_t seed = settings["seed"].is_number_integer() ? settings["seed"].get<unsigned long>() : 0;
+	float size = settings["size"].is_number() ? settings["size"].get<float>() : 0.002f;
+	Eigen::Vector3d normal = settings["normal"].is_object() ? fromJson(settings["normal"]).normalized() : Eigen::Vector3d::UnitZ();
+	Eigen::Vector3d color = settings["color"].is_object() ? fromJson(settings["color"]) : Eigen::Vector3d(0.6, 0.55, 0.5);
+
+	// the dust orbits the heaviest body (the test-particles don't attract)
+	int center = -1;
+	for (unsigned int i = 0; i < bodies.size(); ++i) {
+		if (!bodies.testParticle[i] && (center < 0 || bodies.m[i] > bodies.m[center])) {
+			center = i;
+		}
+	}
+
+	double centerMass = center >= 0 ? bodies.m[center] : 0.0;
+	Eigen::Vector3d centerPosition = center >= 0 ? bodies.getPosition(center) : Eigen::Vector3d::Zero();
+	Eigen::Vector3d centerVelocity = center >= 0
+		? Eigen::Vector3d(bodies.vx[center], bodies.vy[center], bodies.vz[center]) : Eigen::Vector3d::Zero();
+
+	// the light bodies are skipped, a ring of many asteroids would cost more than the sun
+	_sourceMass = settings["sourceMass"].is_number() ? settings["sourceMass"].get<double>() : 0.01 * centerMass;
+
+	// the cells are as high as the ring, the cross-section is the one of two particles of the drawn size
+	_hasCollisions = settings["collisions"].is_boolean() && settings["collisions"].get<bool>();
+	_cellSize = settings["cellSize"].is_number() ? settings["cellSize"].get<double>() : std::max(thickness, 10.0 * size);
+	_cellSize = std::max(_cellSize, 1e-9);
+	_restitution = settings["restitution"].is_number() ? std::min(std::max(settings["restitution"].get<double>(), 0.0), 1.0) : 0.5;
+	_crossSection = settings["crossSection"].is_number() ? std::max(settings["crossSection"].get<double>(), 0.0)
+		: osg::PI * 4.0 * size * size;
+	_seed = seed;
+
+	_x.resize(count);
+	_y.resize(count);
+	_z.resize(count);
+	_vx.resize(count);
+	_vy.resize(count);
+	_vz.resize(count);
+
+	// uniform over the area of the annulus, the dust starts on circular orbits in the plane of the normal
+	Eigen::Matrix3d rotation = Eigen::Quaterniond::FromTwoVectors(Eigen::Vector3d::UnitZ(), normal).toRotationMatrix();
+	double innerSquared = innerRadius * innerRadius;
+	double areaSquared = outerRadius * outerRadius - innerSquared;
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < count; ++i) {
+		double radius = sqrt(innerSquared + getRandom(seed, i, 0) * areaSquared);
+		double angle = 2.0 * osg::PI * getRandom(seed, i, 1);
+		double height = thickness * (getRandom(seed, i, 2) - 0.5);
+		double speed = radius > 0.0 ? sqrt(G * centerMass / radius) : 0.0;
+
+		Eigen::Vector3d position = centerPosition + rotation * Eigen::Vector3d(radius * cos(angle), radius * sin(angle), height);
+		Eigen::Vector3d velocity = centerVelocity + rotation * Eigen::Vector3d(-speed * sin(angle), speed * cos(angle), 0.0);
+		_x[i] = position.x();
+		_y[i] = position.y();
+		_z[i] = position.z();
+		_vx[i] = velocity.x();
+		_vy[i] = velocity.y();
+		_vz[i] = velocity.z();
+	}
+
+	if (!SpaceObject::getIsHeadless()) {
+		_snapshot.resize(3 * count);
+		osg::BoundingSphere bound(toOsg(centerPosition), outerRadius + thickness);
+		createRoot(osg::Vec3(color.x(), color.y(), color.z()), size, bound);
+	}
+}
+
+
+/**
+ * \brief Destructor of the dust-manager.
+ */
+DustManager::~DustManager() {}
+
+
+/**
+ * \brief Collect the bodies which are heavy enough to attract the dust.
+ *
+ * \param bodies
+ *      State of the bodies.
+ */
+void DustManager::gatherSources(const BodyState &bodies) {
+	_sx.clear();
+	_sy.clear();
+	_sz.clear();
+	_sm.clear();
+
+	for (unsigned int i = 0; i < bodies.size(); ++i) {
+		if (bodies.testParticle[i] || bodies.m[i] < _sourceMass) continue;
+
+		_sx.push_back(bodies.x[i]);
+		_sy.push_back(bodies.y[i]);
+		_sz.push_back(bodies.z[i]);
+		_sm.push_back(bodies.m[i]);
+	}
+}
+
+
+/**
+ * \brief Move the particles by the gravity of the massive bodies (symplectic Euler) and write the snapshot.
+ *
+ * \param dt
+ *      Time-step: unit = s
+ * \param bodies
+ *      State of the bodies after the step.
+ */
+void DustManager::step(double dt, const BodyState &bodies) {
+	gatherSources(bodies);
+	int n = _x.size();
+	int cntSources = _sm.size();
+	const double* sx = _sx.data();
+	const double* sy = _sy.data();
+	const double* sz = _sz.data();
+	const double* sm = _sm.data();
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+	for (int i = 0; i < n; ++i) {
+		double ax = 0.0, ay = 0.0, az = 0.0;
+
+		for (int s = 0; s < cntSources; ++s) {
+			double dx = sx[s] - _x[i];
+			double dy = sy[s] - _y[i];
+			double dz = sz[s] - _z[i];
+			double distanceSquared = dx * dx + dy * dy + dz * dz + EPS;
+			double factor = G * sm[s] / (distanceSquared * sqrt(distanceSquared));
+			ax += factor * dx;
+			ay += factor * dy;
+			az += factor * dz;
+		}
+
+		_vx[i] += ax * dt;
+		_vy[i] += ay * dt;
+		_vz[i] += az * dt;
+		_x[i] += _vx[i] * dt;
+		_y[i] += _vy[i] * dt;
+		_z[i] += _vz[i] * dt;
+	}
+
+	if (_hasCollisions) {
+		collide(dt);
+	}
+	++_cntSteps;
+
+	if (!_root.valid()) {
+		return;
+	}
+
+	// the render-thread only copies the snapshot, so it's never blocked by the integration
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_snapshotMutex);
+	float* snapshot = _snapshot.data();
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+	for (int i = 0; i < n; ++i) {
+		snapshot[3 * i] = static_cast<float>(_x[i]);
+		snapshot[3 * i + 1] = static_cast<float>(_y[i]);
+		snapshot[3 * i + 2] = static_cast<float>(_z[i]);
+	}
+
+	_hasNewSnapshot = true;
+}
+
+
+/**
+ * \brief Collide the particles statistically (no-time-counter scheme of Bird): per cell (with N particles
+ *        of the volume V), 0.5 * N * (N - 1) * crossSection * gMax * dt / V pairs are sampled and each is
+ *        accepted with its relative speed / gMax. An accepted pair keeps its center of mass, its relative
+ *        velocity is scaled by the restitution and scattered isotropically.
+ *
+ * \param dt
+ *      Time-step: unit = s
+ */
+void DustManager::collide(double dt) {
+	binParticles();
+	int cntBuckets = static_cast<int>(_bucketStart.size()) - 1;
+	const int* cells = _cellOfParticle.data();
+	unsigned int cntCollisions = 0;
+
+	// the cells are independent, each has its own random numbers => the same pairs collide for any number of threads
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:cntCollisions)
+#endif
+	for (int b = 0; b < cntBuckets; ++b) {
+		int* first = _bucketParticles.data() + _bucketStart[b];
+		int* last = _bucketParticles.data() + _bucketStart[b + 1];
+		if (last - first < 2) continue;
+
+		// the cells which share a bucket are grouped (by the particle within a cell, so the order is fixed)
+		std::sort(first, last, [cells](int i, int j) {
+			for (int axis = 0; axis < 3; ++axis) {
+				if (cells[3 * i + axis] != cells[3 * j + axis]) return cells[3 * i + axis] < cells[3 * j + axis];
+			}
+			return i < j;
+		});
+
+		for (int* cell = first; cell < last;) {
+			int* end = cell + 1;
+			while (end < last && std::equal(cells + 3 * *end, cells + 3 * *end + 3, cells + 3 * *cell)) {
+				++end;
+			}
+
+			if (end - cell >= 2) {
+				cntCollisions += collideCell(cell, static_cast<int>(end - cell), dt);
+			}
+			cell = end;
+		}
+	}
+
+	_cntCollisions = cntCollisions;
+	Profiler::Instance()->count(Profiler::DUST_COLLISIONS, cntCollisions);
+}
+
+
+/**
+ * \brief Bin the particles into the buckets of their cells (counting-sort, linear in the particles).
+ */
+void DustManager::binParticles() {
+	int n = _x.size();
+
+	// about 8 particles per bucket, the occupied cells of a thin ring are far fewer than the buckets of its box
+	unsigned int cntBuckets = 1;
+	while (cntBuckets < static_cast<unsigned int>(std::max(n / 8, 1))) {
+		cntBuckets <<= 1;
+	}
+	unsigned int mask = cntBuckets - 1;
+
+	_cellOfParticle.resize(3 * n);
+	_bucketOfParticle.resize(n);
+	double invCellSize = 1.0 / _cellSize;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+	for (int i = 0; i < n; ++i) {
+		int x = static_cast<int>(std::floor(_x[i] * invCellSize));
+		int y = static_cast<int>(std::floor(_y[i] * invCellSize));
+		int z = static_cast<int>(std::floor(_z[i] * invCellSize));
+		_cellOfParticle[3 * i] = x;
+		_cellOfParticle[3 * i + 1] = y;
+		_cellOfParticle[3 * i + 2] = z;
+		_bucketOfParticle[i] = getBucket(x, y, z, mask);
+	}
+
+	// the scatter keeps the order of the particles within a bucket
+	_bucketStart.assign(cntBuckets + 1, 0);
+	for (int i = 0; i < n; ++i) {
+		++_bucketStart[_bucketOfParticle[i] + 1];
+	}
+	for (unsigned int b = 0; b < cntBuckets; ++b) {
+		_bucketStart[b + 1] += _bucketStart[b];
+	}
+
+	_bucketParticles.resize(n);
+	std::vector<int> fill(_bucketStart.begin(), _bucketStart.end() - 1);
+	for (int i = 0; i < n; ++i) {
+		_bucketParticles[fill[_bucketOfParticle[i]]++] = i;
+	}
+}
+
+
+/**
+ * \brief Collide the particles of one cell (see collide()).
+ *
+ * \param particles
+ *      Indices of the particles of the cell.
+ * \param count
+ *      Number of the particles (at least 2).
+ * \param dt
+ *      Time-step: unit = s
+ *
+ * \return Number of the accepted pairs.
+ */
+unsigned int DustManager::collideCell(const int* particles, int count, double dt) {
+	// the largest relative speed is at most twice the largest deviation from the mean velocity
+	double mx = 0.0, my = 0.0, mz = 0.0;
+	for (int k = 0; k < count; ++k) {
+		mx += _vx[particles[k]];
+		my += _vy[particles[k]];
+		mz += _vz[particles[k]];
+	}
+	mx /= count;
+	my /= count;
+	mz /= count;
+
+	double maxDeviationSquared = 0.0;
+	for (int k = 0; k < count; ++k) {
+		double dx = _vx[particles[k]] - mx;
+		double dy = _vy[particles[k]] - my;
+		double dz = _vz[particles[k]] - mz;
+		maxDeviationSquared = std::max(maxDeviationSquared, dx * dx + dy * dy + dz * dz);
+	}
+
+	double gMax = 2.0 * sqrt(maxDeviationSquared);
+	if (gMax <= 0.0) {
+		return 0;
+	}
+
+	const int* cell = &_cellOfParticle[3 * particles[0]];
+	CellRandom random(_seed, _cntSteps, cell[0], cell[1], cell[2]);
+
+	// the fraction of a candidate is sampled, so the mean number of collisions does not depend on the time-step
+	double candidates = 0.5 * count * (count - 1) * _crossSection * gMax * dt / (_cellSize * _cellSize * _cellSize);
+	int cntCandidates = static_cast<int>(candidates);
+	if (random.next() < candidates - cntCandidates) {
+		++cntCandidates;
+	}
+
+	unsigned int cntCollisions = 0;
+	for (int c = 0; c < cntCandidates; ++c) {
+		int a = static_cast<int>(random.next() * count);
+		int b = static_cast<int>(random.next() * (count - 1));
+		if (b >= a) ++b;
+		int i = particles[a];
+		int j = particles[b];
+
+		double gx = _vx[i] - _vx[j];
+		double gy = _vy[i] - _vy[j];
+		double gz = _vz[i] - _vz[j];
+		double g = sqrt(gx * gx + gy * gy + gz * gz);
+		if (random.next() * gMax >= g) continue;
+
+		// equal masses: the center of mass keeps its velocity, the relative velocity gets a random direction
+		double cosTheta = 2.0 * random.next() - 1.0;
+		double sinTheta = sqrt(std::max(1.0 - cosTheta * cosTheta, 0.0));
+		double phi = 2.0 * osg::PI * random.next();
+		double halfSpeed = 0.5 * _restitution * g;
+
+		double cx = 0.5 * (_vx[i] + _vx[j]);
+		double cy = 0.5 * (_vy[i] + _vy[j]);
+		double cz = 0.5 * (_vz[i] + _vz[j]);
+		double hx = halfSpeed * sinTheta * cos(phi);
+		double hy = halfSpeed * sinTheta * sin(phi);
+		double hz = halfSpeed * cosTheta;
+
+		_vx[i] = cx + hx;
+		_vy[i] = cy + hy;
+		_vz[i] = cz + hz;
+		_vx[j] = cx - hx;
+		_vy[j] = cy - hy;
+		_vz[j] = cz - hz;
+		++cntCollisions;
+	}
+
+	return cntCollisions;
+}
+
+
+/**
+ * \brief Copy the latest snapshot to the geometry (called by the update-traversal).
+ */
+void DustManager::applySnapshot() {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_snapshotMutex);
+	if (!_hasNewSnapshot || _vertices->empty()) {
+		return;
+	}
+
+	memcpy(&(*_vertices)[0], _snapshot.data(), _snapshot.size() * sizeof(float));
+	_vertices->dirty();
+	_hasNewSnapshot = false;
+}
+
+
+/**
+ * \brief Create the geometry of the point-sprites.
+ *
+ * \param color
+ *      Color of the dust.
+ * \param size
+ *      Radius of a particle: unit = m
+ * \param bound
+ *      Sphere around the annulus (the particles are not bounded each frame).
+ */
+void DustManager::createRoot(const osg::Vec3 &color, float size, const osg::BoundingSphere &bound) {
+	unsigned int n = _x.size();
+	_vertices = new osg::Vec3Array(n);
+	for (unsigned int i = 0; i < n; ++i) {
+		(*_vertices)[i].set(_x[i], _y[i], _z[i]);
+	}
+
+	// the vertices are streamed each step, so they live in a dynamic vertex-buffer
+	_vertices->setDataVariance(osg::Object::DYNAMIC);
+	_geometry = new osg::Geometry;
+	_geometry->setUseDisplayList(false);
+	_geometry->setUseVertexBufferObjects(true);
+	_geometry->setDataVariance(osg::Object::DYNAMIC);
+	_geometry->setVertexArray(_vertices.get());
+	_geometry->addPrimitiveSet(new osg::DrawArrays(GL_POINTS, 0, n));
+	_geometry->setInitialBound(osg::BoundingBox(bound.center() - osg::Vec3(bound.radius(), bound.radius(), bound.radius()),
+		bound.center() + osg::Vec3(bound.radius(), bound.radius(), bound.radius())));
+	_geometry->setCullingActive(false);
+
+	_root = new osg::Geode;
+	_root->addDrawable(_geometry.get());
+	_root->setCullingActive(false);
+
+	osg::ref_ptr<osg::Uniform> viewportHeight = new osg::Uniform("viewportHeight", 1.0f);
+	viewportHeight->setDataVariance(osg::Object::DYNAMIC);
+	_root->addUpdateCallback(new DustUpdateCallback(this));
+	_root->addCullCallback(new DustCullCallback(viewportHeight));
+
+	DustShader dustShader(color, size, viewportHeight);
+	dustShader.apply(_root);
+}
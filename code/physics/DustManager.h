@@ -0,0 +1,219 @@
+﻿/**
+ * \brief Implementation of the massless dust-particles of the ring-systems.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <json.hpp>
+#include <osg/Geode>
+#include <osg/Geometry>
+#include <osg/Array>
+#include <OpenThreads/Mutex>
+
+
+// forward declarations
+namespace pbs17 {
+	class BodyState;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief The manager of the dust: Massless test-particles which are stored in their own arrays (no space-objects,
+	 * no exact collisions) and only feel the gravity of the massive bodies. The gravity of the dust is ignored, so a
+	 * particle costs one force-evaluation per source and step.
+	 *
+	 * With "collisions", the dust collides statistically (DSMC, see collide()): the particles are binned into cells
+	 * and per cell a number of pairs proportional to its density and relative speed collides inelastically. So the
+	 * rings are damped in a time linear in the particles, the dust never collides with the bodies.
+	 *
+	 * All particles are drawn as point-sprites of a single geometry (see DustShader). The physics-thread writes a
+	 * snapshot of the positions after each step, which is copied to the geometry by the update-traversal.
+	 *
+	 * The dust is generated from the "dust"-settings of the simulation (not stored by the scene or the checkpoints):
+	 * \code
+	 * "dust": { "count": 1000000, "innerRadius": 2.0, "outerRadius": 4.0, "thickness": 0.05,
+	 *           "normal": { "x": 0, "y": 0, "z": 1 }, "seed": 0, "size": 0.002, "sourceMass": 1.0,
+	 *           "color": { "x": 0.6, "y": 0.55, "z": 0.5 },
+	 *           "collisions": true, "cellSize": 0.05, "restitution": 0.5, "crossSection": 0.00005 }
+	 * \endcode
+	 */
+	class DustManager {
+	public:
+		/**
+		 * \brief Constructor of the dust-manager: Generate the particles on circular orbits around the heaviest body.
+		 *
+		 * \param settings
+		 *      The "dust"-settings of the simulation.
+		 * \param bodies
+		 *      State of the bodies at the start.
+		 */
+		DustManager(nlohmann::json settings, const BodyState &bodies);
+
+
+		/**
+		 * \brief Destructor of the dust-manager.
+		 */
+		~DustManager();
+
+
+		/**
+		 * \brief Move the particles by the gravity of the massive bodies (symplectic Euler) and write the snapshot.
+		 *
+		 * \param dt
+		 *      Time-step: unit = s
+		 * \param bodies
+		 *      State of the bodies after the step.
+		 */
+		void step(double dt, const BodyState &bodies);
+
+
+		/**
+		 * \brief Copy the latest snapshot to the geometry (called by the update-traversal).
+		 */
+		void applySnapshot();
+
+
+		/**
+		 * \brief Get the node of the point-sprites.
+		 *
+		 * \return Geode of the dust.
+		 */
+		osg::ref_ptr<osg::Geode> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Get the number of particles.
+		 *
+		 * \return Number of dust-particles.
+		 */
+		unsigned int size() const {
+			return _x.size();
+		}
+
+
+		/**
+		 * \brief Get the number of statistical collisions of the last step.
+		 *
+		 * \return Accepted pairs (0 => no collisions).
+		 */
+		unsigned int getNumCollisions() const {
+			return _cntCollisions;
+		}
+
+
+	private:
+		/**
+		 * \brief Collect the bodies which are heavy enough to attract the dust.
+		 *
+		 * \param bodies
+		 *      State of the bodies.
+		 */
+		void gatherSources(const BodyState &bodies);
+
+
+		/**
+		 * \brief Collide the particles statistically (no-time-counter scheme of Bird): per cell (with N particles
+		 *        of the volume V), 0.5 * N * (N - 1) * crossSection * gMax * dt / V pairs are sampled and each is
+		 *        accepted with its relative speed / gMax. An accepted pair keeps its center of mass, its relative
+		 *        velocity is scaled by the restitution and scattered isotropically.
+		 *
+		 * \param dt
+		 *      Time-step: unit = s
+		 */
+		void collide(double dt);
+
+
+		/**
+		 * \brief Bin the particles into the buckets of their cells (counting-sort, linear in the particles).
+		 */
+		void binParticles();
+
+
+		/**
+		 * \brief Collide the particles of one cell (see collide()).
+		 *
+		 * \param particles
+		 *      Indices of the particles of the cell.
+		 * \param count
+		 *      Number of the particles (at least 2).
+		 * \param dt
+		 *      Time-step: unit = s
+		 *
+		 * \return Number of the accepted pairs.
+		 */
+		unsigned int collideCell(const int* particles, int count, double dt);
+
+
+		/**
+		 * \brief Create the geometry of the point-sprites.
+		 *
+		 * \param color
+		 *      Color of the dust.
+		 * \param size
+		 *      Radius of a particle: unit = m
+		 * \param bound
+		 *      Sphere around the annulus (the particles are not bounded each frame).
+		 */
+		void createRoot(const osg::Vec3 &color, float size, const osg::BoundingSphere &bound);
+
+		//! Position of the particles
+		std::vector<double> _x, _y, _z;
+		//! Velocity of the particles
+		std::vector<double> _vx, _vy, _vz;
+
+		//! Position and mass of the sources of the last step
+		std::vector<double> _sx, _sy, _sz, _sm;
+		//! Minimal mass of a source
+		double _sourceMass;
+
+		//! True if the particles collide statistically (see collide())
+		bool _hasCollisions = false;
+		//! Width of the cells of the collisions: unit = m
+		double _cellSize = 0.05;
+		//! Fraction of the relative speed of a pair which is kept by a collision
+		double _restitution = 0.5;
+		//! Cross-section of a pair: unit = m^2
+		double _crossSection = 0.0;
+		//! Seed of the dust (also of the sampled pairs)
+		uint64_t _seed = 0;
+		//! Number of steps (the pairs of each step are sampled independently)
+		uint64_t _cntSteps = 0;
+		//! Number of accepted pairs of the last step
+		unsigned int _cntCollisions = 0;
+
+		//! Cell (3 coordinates) and bucket per particle
+		std::vector<int> _cellOfParticle;
+		std::vector<int> _bucketOfParticle;
+		//! First entry in _bucketParticles per bucket (size = buckets + 1)
+		std::vector<int> _bucketStart;
+		//! Indices of the particles, sorted by bucket
+		std::vector<int> _bucketParticles;
+
+		//! Positions of the last step (written by the physics-thread)
+		std::vector<float> _snapshot;
+		//! True if the snapshot is not copied to the geometry yet
+		bool _hasNewSnapshot = false;
+		//! Mutex of the snapshot
+		OpenThreads::Mutex _snapshotMutex;
+
+		//! Node of the point-sprites
+		osg::ref_ptr<osg::Geode> _root;
+		//! Vertices of the point-sprites
+		osg::ref_ptr<osg::Vec3Array> _vertices;
+		//! Geometry of the point-sprites
+		osg::ref_ptr<osg::Geometry> _geometry;
+
+		//! Gravitational constant and softening (same as the NBodyManager)
+		const double G = 1.0;
+		const double EPS = 0.000000001;
+	};
+}
@@ -0,0 +1,367 @@
+﻿/**
+ * \brief Implementation of the integrator which simulates many small independent systems at once.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "EnsembleIntegrator.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "BodyState.h"
+
+// The vectorized kernel is compiled with a function-specific target-attribute and
+// selected at runtime, so the rest of the project does not need any special compiler-flags.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PBS17_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+using namespace pbs17;
+
+//! Softening which is added to the square distance (same as the NBodyManager)
+const double EnsembleIntegrator::EPS = 0.000000001;
+
+
+/**
+ * \brief Constructor of the ensemble (all bodies are at the origin without mass until they are set).
+ *
+ * \param cntBodies
+ *      Number of bodies per system.
+ * \param cntSystems
+ *      Number of systems.
+ */
+EnsembleIntegrator::EnsembleIntegrator(unsigned int cntBodies, unsigned int cntSystems)
+	: _cntBodies(cntBodies), _cntSystems(cntSystems), _stride((cntSystems + WIDTH - 1) / WIDTH * WIDTH), _g(1.0) {
+	size_t size = static_cast<size_t>(_cntBodies) * _stride;
+
+	_x.assign(size, 0.0);
+	_y.assign(size, 0.0);
+	_z.assign(size, 0.0);
+	_vx.assign(size, 0.0);
+	_vy.assign(size, 0.0);
+	_vz.assign(size, 0.0);
+	_m.assign(size, 0.0);
+
+	setIntegrator(NBodyManager::LEAPFROG);
+}
+
+
+/**
+ * \brief Set the state of a body.
+ *
+ * \param system
+ *      Index of the system.
+ * \param body
+ *      Index of the body in the system.
+ * \param mass
+ *      Mass of the body.
+ * \param position
+ *      Position of the body.
+ * \param velocity
+ *      Velocity of the body.
+ */
+void EnsembleIntegrator::setBody(unsigned int system, unsigned int body, double mass, const Eigen::Vector3d &position, const Eigen::Vector3d &velocity) {
+	unsigned int i = body * _stride + system;
+
+	_m[i] = mass;
+	_x[i] = position.x();
+	_y[i] = position.y();
+	_z[i] = position.z();
+	_vx[i] = velocity.x();
+	_vy[i] = velocity.y();
+	_vz[i] = velocity.z();
+}
+
+
+/**
+ * \brief Set the integrator of all systems.
+ *
+ * \param integrator
+ *      Integrator (the Wisdom-Holman map is not supported, the leapfrog is used instead).
+ *
+ * \return False if the integrator is not supported.
+ */
+bool EnsembleIntegrator::setIntegrator(NBodyManager::Integrator integrator) {
+	// all integrators are compositions of drifts and kicks (the drifts with a zero coefficient are skipped)
+	switch (integrator) {
+	case NBodyManager::SEMI_IMPLICIT_EULER:
+		_drifts = { 0.0, 1.0 };
+		_kicks = { 1.0 };
+		return true;
+	case NBodyManager::YOSHIDA:
+	{
+		const double cbrt2 = pow(2.0, 1.0 / 3.0);
+		const double w1 = 1.0 / (2.0 - cbrt2);
+		const double w0 = -cbrt2 * w1;
+		_drifts = { 0.5 * w1, 0.5 * (w0 + w1), 0.5 * (w0 + w1), 0.5 * w1 };
+		_kicks = { w1, w0, w1 };
+		return true;
+	}
+	default:
+		// leapfrog and velocity-verlet are the same drift-kick-drift sequence
+		_drifts = { 0.5, 0.5 };
+		_kicks = { 1.0 };
+		return integrator == NBodyManager::LEAPFROG || integrator == NBodyManager::VELOCITY_VERLET;
+	}
+}
+
+
+/**
+ * \brief Integrate all systems by one step.
+ *
+ * \param dt
+ *      Time-step.
+ */
+void EnsembleIntegrator::step(double dt) {
+	const int cntBlocks = static_cast<int>((_stride + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+	{
+		// accelerations of a block (per thread)
+		std::vector<double> ax(_cntBodies * BLOCK_SIZE), ay(_cntBodies * BLOCK_SIZE), az(_cntBodies * BLOCK_SIZE);
+
+		// the whole step of a block is done while its arrays are in the cache
+#if defined(_OPENMP)
+#pragma omp for schedule(static)
+#endif
+		for (int b = 0; b < cntBlocks; ++b) {
+			unsigned int first = b * BLOCK_SIZE;
+			unsigned int cnt = std::min(BLOCK_SIZE, _stride - first);
+
+			for (unsigned int k = 0; k < _drifts.size(); ++k) {
+				if (_drifts[k] != 0.0) {
+					double h = _drifts[k] * dt;
+
+					for (unsigned int body = 0; body < _cntBodies; ++body) {
+						unsigned int offset = body * _stride + first;
+						for (unsigned int s = 0; s < cnt; ++s) {
+							_x[offset + s] += h * _vx[offset + s];
+							_y[offset + s] += h * _vy[offset + s];
+							_z[offset + s] += h * _vz[offset + s];
+						}
+					}
+				}
+
+				if (k < _kicks.size()) {
+					double h = _kicks[k] * dt;
+					computeAccelerations(first, cnt, ax.data(), ay.data(), az.data());
+
+					for (unsigned int body = 0; body < _cntBodies; ++body) {
+						unsigned int offset = body * _stride + first;
+						for (unsigned int s = 0; s < cnt; ++s) {
+							_vx[offset + s] += h * ax[body * cnt + s];
+							_vy[offset + s] += h * ay[body * cnt + s];
+							_vz[offset + s] += h * az[body * cnt + s];
+						}
+					}
+				}
+			}
+		}
+	}
+
+	_time += dt;
+}
+
+
+/**
+ * \brief Compute the total energy of a system (kinetic and softened potential energy).
+ *
+ * \param system
+ *      Index of the system.
+ *
+ * \return Energy of the system.
+ */
+double EnsembleIntegrator::computeEnergy(unsigned int system) const {
+	double energy = 0.0;
+
+	for (unsigned int i = 0; i < _cntBodies; ++i) {
+		unsigned int a = i * _stride + system;
+		energy += 0.5 * _m[a] * (_vx[a] * _vx[a] + _vy[a] * _vy[a] + _vz[a] * _vz[a]);
+
+		for (unsigned int j = i + 1; j < _cntBodies; ++j) {
+			unsigned int b = j * _stride + system;
+			double dx = _x[b] - _x[a];
+			double dy = _y[b] - _y[a];
+			double dz = _z[b] - _z[a];
+
+			energy -= _g * _m[a] * _m[b] / sqrt(dx * dx + dy * dy + dz * dz + EPS);
+		}
+	}
+
+	return energy;
+}
+
+
+/**
+ * \brief Copy the state of all systems into a body-state, e.g. for the TrajectoryRecorder. The bodies are in the
+ *        order of the systems, the id of body b of system s is s * getNumBodies() + b.
+ *
+ * \param bodies
+ *      Output-parameter: State of getNumSystems() * getNumBodies() bodies (resized).
+ */
+void EnsembleIntegrator::copyTo(BodyState &bodies) const {
+	unsigned int n = _cntSystems * _cntBodies;
+
+	bodies.x.resize(n);
+	bodies.y.resize(n);
+	bodies.z.resize(n);
+	bodies.vx.resize(n);
+	bodies.vy.resize(n);
+	bodies.vz.resize(n);
+	bodies.m.resize(n);
+	bodies.id.resize(n);
+
+	// the bodies don't rotate
+	bodies.qx.assign(n, 0.0);
+	bodies.qy.assign(n, 0.0);
+	bodies.qz.assign(n, 0.0);
+	bodies.qw.assign(n, 1.0);
+
+	for (unsigned int s = 0; s < _cntSystems; ++s) {
+		for (unsigned int body = 0; body < _cntBodies; ++body) {
+			unsigned int i = s * _cntBodies + body;
+			unsigned int j = body * _stride + s;
+
+			bodies.x[i] = _x[j];
+			bodies.y[i] = _y[j];
+			bodies.z[i] = _z[j];
+			bodies.vx[i] = _vx[j];
+			bodies.vy[i] = _vy[j];
+			bodies.vz[i] = _vz[j];
+			bodies.m[i] = _m[j];
+			bodies.id[i] = static_cast<long>(i);
+		}
+	}
+}
+
+
+/**
+ * \brief Compute the accelerations of all bodies of a block of systems.
+ *
+ * \param first
+ *      First system of the block.
+ * \param cnt
+ *      Number of systems of the block (multiple of WIDTH).
+ * \param ax, ay, az
+ *      Output-parameter: Accelerations per body of the block (cntBodies * cnt, overwritten).
+ */
+void EnsembleIntegrator::computeAccelerations(unsigned int first, unsigned int cnt, double* ax, double* ay, double* az) const {
+	static const KernelFunction kernel = selectKernel();
+
+	std::fill(ax, ax + _cntBodies * cnt, 0.0);
+	std::fill(ay, ay + _cntBodies * cnt, 0.0);
+	std::fill(az, az + _cntBodies * cnt, 0.0);
+
+	// each pair is evaluated once for all systems of the block
+	for (unsigned int i = 0; i < _cntBodies; ++i) {
+		unsigned int a = i * _stride + first;
+
+		for (unsigned int j = i + 1; j < _cntBodies; ++j) {
+			unsigned int b = j * _stride + first;
+
+			kernel(&_x[a], &_y[a], &_z[a], &_m[a], &_x[b], &_y[b], &_z[b], &_m[b], static_cast<int>(cnt), _g, EPS,
+				ax + i * cnt, ay + i * cnt, az + i * cnt, ax + j * cnt, ay + j * cnt, az + j * cnt);
+		}
+	}
+}
+
+
+/**
+ * \brief Select the best kernel which is supported by the CPU.
+ *
+ * \return Kernel implementation.
+ */
+EnsembleIntegrator::KernelFunction EnsembleIntegrator::selectKernel() {
+#if defined(PBS17_X86_SIMD)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return &EnsembleIntegrator::accumulatePairAvx2;
+	}
+#endif
+
+	return &EnsembleIntegrator::accumulatePairScalar;
+}
+
+
+/**
+ * \brief Scalar implementation (fallback): Accumulate the accelerations of a pair of bodies in n systems.
+ *
+ * \param xi, yi, zi, mi
+ *      Positions and masses of the first body.
+ * \param xj, yj, zj, mj
+ *      Positions and masses of the second body.
+ * \param n
+ *      Number of systems (multiple of WIDTH).
+ * \param g
+ *      Gravitational constant.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param axi, ayi, azi
+ *      Output-parameter: Accelerations of the first body (accumulated).
+ * \param axj, ayj, azj
+ *      Output-parameter: Accelerations of the second body (accumulated).
+ */
+void EnsembleIntegrator::accumulatePairScalar(const double* xi, const double* yi, const double* zi, const double* mi,
+	const double* xj, const double* yj, const double* zj, const double* mj, int n, double g, double eps,
+	double* axi, double* ayi, double* azi, double* axj, double* ayj, double* azj) {
+	for (int s = 0; s < n; ++s) {
+		double dx = xj[s] - xi[s];
+		double dy = yj[s] - yi[s];
+		double dz = zj[s] - zi[s];
+		double invR = 1.0 / sqrt(dx * dx + dy * dy + dz * dz + eps);
+		double invR3 = g * invR * invR * invR;
+
+		axi[s] += mj[s] * invR3 * dx;
+		ayi[s] += mj[s] * invR3 * dy;
+		azi[s] += mj[s] * invR3 * dz;
+		axj[s] -= mi[s] * invR3 * dx;
+		ayj[s] -= mi[s] * invR3 * dy;
+		azj[s] -= mi[s] * invR3 * dz;
+	}
+}
+
+
+#if defined(PBS17_X86_SIMD)
+
+/**
+ * \brief AVX2/FMA implementation with 4 systems per register. Same parameters as accumulatePairScalar().
+ */
+__attribute__((target("avx2,fma")))
+void EnsembleIntegrator::accumulatePairAvx2(const double* xi, const double* yi, const double* zi, const double* mi,
+	const double* xj, const double* yj, const double* zj, const double* mj, int n, double g, double eps,
+	double* axi, double* ayi, double* azi, double* axj, double* ayj, double* azj) {
+	const __m256d vG = _mm256_set1_pd(g);
+	const __m256d vEps = _mm256_set1_pd(eps);
+	const __m256d vOne = _mm256_set1_pd(1.0);
+
+	for (int s = 0; s < n; s += WIDTH) {
+		__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xj + s), _mm256_loadu_pd(xi + s));
+		__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(yj + s), _mm256_loadu_pd(yi + s));
+		__m256d dz = _mm256_sub_pd(_mm256_loadu_pd(zj + s), _mm256_loadu_pd(zi + s));
+		__m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_fmadd_pd(dz, dz, vEps)));
+		__m256d invR = _mm256_div_pd(vOne, _mm256_sqrt_pd(r2));
+		__m256d invR3 = _mm256_mul_pd(vG, _mm256_mul_pd(invR, _mm256_mul_pd(invR, invR)));
+
+		__m256d fi = _mm256_mul_pd(_mm256_loadu_pd(mj + s), invR3);
+		__m256d fj = _mm256_mul_pd(_mm256_loadu_pd(mi + s), invR3);
+
+		_mm256_storeu_pd(axi + s, _mm256_fmadd_pd(fi, dx, _mm256_loadu_pd(axi + s)));
+		_mm256_storeu_pd(ayi + s, _mm256_fmadd_pd(fi, dy, _mm256_loadu_pd(ayi + s)));
+		_mm256_storeu_pd(azi + s, _mm256_fmadd_pd(fi, dz, _mm256_loadu_pd(azi + s)));
+		_mm256_storeu_pd(axj + s, _mm256_fnmadd_pd(fj, dx, _mm256_loadu_pd(axj + s)));
+		_mm256_storeu_pd(ayj + s, _mm256_fnmadd_pd(fj, dy, _mm256_loadu_pd(ayj + s)));
+		_mm256_storeu_pd(azj + s, _mm256_fnmadd_pd(fj, dz, _mm256_loadu_pd(azj + s)));
+	}
+}
+
+#endif
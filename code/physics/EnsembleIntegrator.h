@@ -0,0 +1,264 @@
+﻿/**
+ * \brief Implementation of the integrator which simulates many small independent systems at once.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "NBodyManager.h"
+
+
+// forward declarations
+namespace pbs17 {
+	class BodyState;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Integrates an ensemble of independent gravitational systems with the same number of bodies (e.g. the
+	 * variations of a small scene of a parameter-study). The arrays are stored system-major: the value of body b of
+	 * system s is at b * stride + s, so the systems are the lanes of the vectorized pair-kernel and each pair of
+	 * bodies is evaluated for 4 systems per register (AVX2/FMA or scalar, selected once at runtime). The systems are
+	 * processed in blocks which fit into the caches, the blocks are distributed over the OpenMP-threads.
+	 *
+	 * Only the gravity is simulated (same softening and constant as the NBodyManager, no collisions), all systems
+	 * use the same integrator and time-step.
+	 */
+	class EnsembleIntegrator {
+	public:
+		/**
+		 * \brief Constructor of the ensemble (all bodies are at the origin without mass until they are set).
+		 *
+		 * \param cntBodies
+		 *      Number of bodies per system.
+		 * \param cntSystems
+		 *      Number of systems.
+		 */
+		EnsembleIntegrator(unsigned int cntBodies, unsigned int cntSystems);
+
+
+		/**
+		 * \brief Set the state of a body.
+		 *
+		 * \param system
+		 *      Index of the system.
+		 * \param body
+		 *      Index of the body in the system.
+		 * \param mass
+		 *      Mass of the body.
+		 * \param position
+		 *      Position of the body.
+		 * \param velocity
+		 *      Velocity of the body.
+		 */
+		void setBody(unsigned int system, unsigned int body, double mass, const Eigen::Vector3d &position, const Eigen::Vector3d &velocity);
+
+
+		/**
+		 * \brief Get the position of a body.
+		 *
+		 * \return Position of the body in the system.
+		 */
+		Eigen::Vector3d getPosition(unsigned int system, unsigned int body) const {
+			unsigned int i = body * _stride + system;
+			return Eigen::Vector3d(_x[i], _y[i], _z[i]);
+		}
+
+
+		/**
+		 * \brief Get the velocity of a body.
+		 *
+		 * \return Velocity of the body in the system.
+		 */
+		Eigen::Vector3d getVelocity(unsigned int system, unsigned int body) const {
+			unsigned int i = body * _stride + system;
+			return Eigen::Vector3d(_vx[i], _vy[i], _vz[i]);
+		}
+
+
+		/**
+		 * \brief Get the mass of a body.
+		 *
+		 * \return Mass of the body in the system.
+		 */
+		double getMass(unsigned int system, unsigned int body) const {
+			return _m[body * _stride + system];
+		}
+
+
+		/**
+		 * \brief Set the integrator of all systems.
+		 *
+		 * \param integrator
+		 *      Integrator (the Wisdom-Holman map is not supported, the leapfrog is used instead).
+		 *
+		 * \return False if the integrator is not supported.
+		 */
+		bool setIntegrator(NBodyManager::Integrator integrator);
+
+
+		/**
+		 * \brief Set the gravitational constant.
+		 *
+		 * \param g
+		 *      Gravitational constant (default: same as the NBodyManager).
+		 */
+		void setGravitationalConstant(double g) {
+			_g = g;
+		}
+
+
+		/**
+		 * \brief Integrate all systems by one step.
+		 *
+		 * \param dt
+		 *      Time-step.
+		 */
+		void step(double dt);
+
+
+		/**
+		 * \brief Compute the total energy of a system (kinetic and softened potential energy).
+		 *
+		 * \param system
+		 *      Index of the system.
+		 *
+		 * \return Energy of the system.
+		 */
+		double computeEnergy(unsigned int system) const;
+
+
+		/**
+		 * \brief Copy the state of all systems into a body-state, e.g. for the TrajectoryRecorder. The bodies are in the
+		 *        order of the systems, the id of body b of system s is s * getNumBodies() + b.
+		 *
+		 * \param bodies
+		 *      Output-parameter: State of getNumSystems() * getNumBodies() bodies (resized).
+		 */
+		void copyTo(BodyState &bodies) const;
+
+
+		/**
+		 * \brief Get the number of bodies per system.
+		 *
+		 * \return Number of bodies.
+		 */
+		unsigned int getNumBodies() const {
+			return _cntBodies;
+		}
+
+
+		/**
+		 * \brief Get the number of systems.
+		 *
+		 * \return Number of systems.
+		 */
+		unsigned int getNumSystems() const {
+			return _cntSystems;
+		}
+
+
+		/**
+		 * \brief Get the simulated time.
+		 *
+		 * \return Sum of the time-steps.
+		 */
+		double getTime() const {
+			return _time;
+		}
+
+
+	private:
+		//! Number of systems per register of the vectorized kernel (the stride is padded to a multiple of it)
+		static const unsigned int WIDTH = 4;
+		//! Number of systems which are integrated together (multiple of WIDTH, the arrays of a block fit into the L2-cache)
+		static const unsigned int BLOCK_SIZE = 256;
+		//! Softening which is added to the square distance (same as the NBodyManager)
+		static const double EPS;
+
+		//! Signature of the kernel implementations
+		typedef void(*KernelFunction)(const double*, const double*, const double*, const double*, const double*, const double*,
+			const double*, const double*, int, double, double, double*, double*, double*, double*, double*, double*);
+
+
+		/**
+		 * \brief Select the best kernel which is supported by the CPU.
+		 *
+		 * \return Kernel implementation.
+		 */
+		static KernelFunction selectKernel();
+
+
+		/**
+		 * \brief Scalar implementation (fallback): Accumulate the accelerations of a pair of bodies in n systems.
+		 *
+		 * \param xi, yi, zi, mi
+		 *      Positions and masses of the first body.
+		 * \param xj, yj, zj, mj
+		 *      Positions and masses of the second body.
+		 * \param n
+		 *      Number of systems (multiple of WIDTH).
+		 * \param g
+		 *      Gravitational constant.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param axi, ayi, azi
+		 *      Output-parameter: Accelerations of the first body (accumulated).
+		 * \param axj, ayj, azj
+		 *      Output-parameter: Accelerations of the second body (accumulated).
+		 */
+		static void accumulatePairScalar(const double* xi, const double* yi, const double* zi, const double* mi,
+			const double* xj, const double* yj, const double* zj, const double* mj, int n, double g, double eps,
+			double* axi, double* ayi, double* azi, double* axj, double* ayj, double* azj);
+
+
+		/**
+		 * \brief AVX2/FMA implementation with 4 systems per register. Same parameters as accumulatePairScalar().
+		 */
+		static void accumulatePairAvx2(const double* xi, const double* yi, const double* zi, const double* mi,
+			const double* xj, const double* yj, const double* zj, const double* mj, int n, double g, double eps,
+			double* axi, double* ayi, double* azi, double* axj, double* ayj, double* azj);
+
+
+		/**
+		 * \brief Compute the accelerations of all bodies of a block of systems.
+		 *
+		 * \param first
+		 *      First system of the block.
+		 * \param cnt
+		 *      Number of systems of the block (multiple of WIDTH).
+		 * \param ax, ay, az
+		 *      Output-parameter: Accelerations per body of the block (cntBodies * cnt, overwritten).
+		 */
+		void computeAccelerations(unsigned int first, unsigned int cnt, double* ax, double* ay, double* az) const;
+
+
+		//! Number of bodies per system and number of systems
+		unsigned int _cntBodies;
+		unsigned int _cntSystems;
+		//! Distance between the bodies in the arrays (number of systems padded to a multiple of WIDTH)
+		unsigned int _stride;
+
+		//! State of all bodies (system-major, the padded systems have no mass)
+		std::vector<double> _x, _y, _z;
+		std::vector<double> _vx, _vy, _vz;
+		std::vector<double> _m;
+
+		//! Coefficients of the drifts and kicks of a step (drift, kick, drift, ..., drift)
+		std::vector<double> _drifts;
+		std::vector<double> _kicks;
+
+		//! Gravitational constant
+		double _g;
+		//! Simulated time
+		double _time = 0.0;
+	};
+}
@@ -0,0 +1,399 @@
+﻿/**
+ * \brief Implementation of the fast multipole method (FMM) with quadrupole expansions.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-10
+ */
+
+#include "FastMultipole.h"
+
+#include <math.h>
+#include <limits>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "BodyState.h"
+#include "MortonCode.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor of the fast multipole solver.
+ *
+ * \param theta
+ *      Opening angle ((r_A + r_B) / distance) up to which two cells interact by their expansions.
+ */
+FastMultipole::FastMultipole(double theta)
+	: _theta(theta) {}
+
+
+/**
+ * \brief Calculate the field sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) for all bodies (same convention
+ *        as the other solvers, the expansions are not softened).
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param eps
+ *      Softening which is added to the square distance of the direct pairs.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ */
+void FastMultipole::computeFields(const BodyState &bodies, double eps, std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az) {
+	int n = bodies.size();
+	ax.assign(n, 0.0);
+	ay.assign(n, 0.0);
+	az.assign(n, 0.0);
+
+	if (n == 0) {
+		return;
+	}
+
+	_eps = eps;
+	build(bodies);
+	computeMultipoles();
+
+	// sub-trees which are walked in parallel (each one only writes into its own cells and bodies)
+	std::vector<int> targets(1, 0);
+	unsigned int cntTargets = 64;
+#if defined(_OPENMP)
+	cntTargets *= omp_get_max_threads();
+#endif
+	for (unsigned int k = 0; k < targets.size() && targets.size() < cntTargets; ) {
+		const Cell &cell = _cells[targets[k]];
+
+		if (cell.cntChildren == 0) {
+			++k;
+			continue;
+		}
+
+		int first = cell.firstChild;
+		int cntChildren = cell.cntChildren;
+		targets[k] = first;
+		for (int c = 1; c < cntChildren; ++c) {
+			targets.push_back(first + c);
+		}
+	}
+
+	int cntSubtrees = targets.size();
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (int k = 0; k < cntSubtrees; ++k) {
+		interact(0, targets[k]);
+		evaluateLocal(targets[k]);
+	}
+
+	for (int k = 0; k < n; ++k) {
+		ax[_order[k]] = _ax[k];
+		ay[_order[k]] = _ay[k];
+		az[_order[k]] = _az[k];
+	}
+}
+
+
+/**
+ * \brief Sort the bodies and split the cells until they have at most _leafSize bodies.
+ *
+ * \param bodies
+ *      State of all bodies.
+ */
+void FastMultipole::build(const BodyState &bodies) {
+	int n = bodies.size();
+
+	// Bounding cube of all bodies
+	double max = std::numeric_limits<double>::max();
+	Eigen::Vector3d bbMin(max, max, max);
+	Eigen::Vector3d bbMax(-max, -max, -max);
+	for (int i = 0; i < n; ++i) {
+		bbMin = bbMin.cwiseMin(bodies.getPosition(i));
+		bbMax = bbMax.cwiseMax(bodies.getPosition(i));
+	}
+
+	double scale = ((1 << MortonCode::BITS_PER_AXIS) - 1) / std::max((bbMax - bbMin).maxCoeff(), 1e-9);
+
+	_codes.resize(n);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		_codes[i] = MortonCode::encode(bodies.getPosition(i), bbMin, Eigen::Vector3d(scale, scale, scale));
+	}
+
+	MortonCode::sort(_codes, _order, _tmpCodes, _tmpOrder);
+
+	// the bodies of a cell are contiguous
+	_x.resize(n); _y.resize(n); _z.resize(n); _m.resize(n);
+	_ax.assign(n, 0.0); _ay.assign(n, 0.0); _az.assign(n, 0.0);
+	for (int k = 0; k < n; ++k) {
+		int i = _order[k];
+		_x[k] = bodies.x[i];
+		_y[k] = bodies.y[i];
+		_z[k] = bodies.z[i];
+		_m[k] = bodies.m[i];
+	}
+
+	_cells.clear();
+	Cell root;
+	root.begin = 0;
+	root.end = n;
+	_cells.push_back(root);
+	split(0, 0);
+}
+
+
+/**
+ * \brief Split a cell into the octants of the next level of the codes (recursively).
+ *
+ * \param cell
+ *      Index of the cell.
+ * \param level
+ *      Level of the cell (0 => root).
+ */
+void FastMultipole::split(int cell, int level) {
+	int begin = _cells[cell].begin;
+	int end = _cells[cell].end;
+	_cells[cell].firstChild = -1;
+	_cells[cell].cntChildren = 0;
+
+	if (end - begin <= _leafSize || level >= MAX_DEPTH) {
+		return;
+	}
+
+	// the codes are sorted, so the octants of the next level are consecutive ranges
+	int shift = 3 * (MAX_DEPTH - 1 - level);
+	int firstChild = _cells.size();
+	int start = begin;
+	while (start < end) {
+		uint64_t octant = (_codes[start] >> shift) & 7;
+		int stop = start + 1;
+		while (stop < end && ((_codes[stop] >> shift) & 7) == octant) {
+			++stop;
+		}
+
+		Cell child;
+		child.begin = start;
+		child.end = stop;
+		_cells.push_back(child);
+		start = stop;
+	}
+
+	int cntChildren = static_cast<int>(_cells.size()) - firstChild;
+	_cells[cell].firstChild = firstChild;
+	_cells[cell].cntChildren = cntChildren;
+
+	for (int c = 0; c < cntChildren; ++c) {
+		split(firstChild + c, level + 1);
+	}
+}
+
+
+/**
+ * \brief Calculate the multipole-expansions bottom-up (leaves from their bodies, the others from their children).
+ */
+void FastMultipole::computeMultipoles() {
+	// children are always stored after their parents
+	for (int c = static_cast<int>(_cells.size()) - 1; c >= 0; --c) {
+		Cell &cell = _cells[c];
+		cell.mass = 0.0;
+		cell.center = Eigen::Vector3d::Zero();
+		cell.quadrupole = Eigen::Matrix3d::Zero();
+		cell.radius = 0.0;
+		cell.field = Eigen::Vector3d::Zero();
+		cell.gradient = Eigen::Matrix3d::Zero();
+		for (int axis = 0; axis < 3; ++axis) {
+			cell.hessian[axis] = Eigen::Matrix3d::Zero();
+		}
+
+		if (cell.cntChildren == 0) {
+			Eigen::Vector3d weighted(0.0, 0.0, 0.0);
+			for (int k = cell.begin; k < cell.end; ++k) {
+				cell.mass += _m[k];
+				weighted += _m[k] * Eigen::Vector3d(_x[k], _y[k], _z[k]);
+			}
+			cell.center = cell.mass > 0.0 ? Eigen::Vector3d(weighted / cell.mass) : Eigen::Vector3d(_x[cell.begin], _y[cell.begin], _z[cell.begin]);
+
+			for (int k = cell.begin; k < cell.end; ++k) {
+				Eigen::Vector3d s = Eigen::Vector3d(_x[k], _y[k], _z[k]) - cell.center;
+				cell.quadrupole += _m[k] * s * s.transpose();
+				cell.radius = std::max(cell.radius, s.norm());
+			}
+		} else {
+			Eigen::Vector3d weighted(0.0, 0.0, 0.0);
+			for (int k = cell.firstChild; k < cell.firstChild + cell.cntChildren; ++k) {
+				cell.mass += _cells[k].mass;
+				weighted += _cells[k].mass * _cells[k].center;
+			}
+			cell.center = cell.mass > 0.0 ? Eigen::Vector3d(weighted / cell.mass) : _cells[cell.firstChild].center;
+
+			// the quadrupoles of the children are shifted to the new center (parallel-axis theorem)
+			for (int k = cell.firstChild; k < cell.firstChild + cell.cntChildren; ++k) {
+				const Cell &child = _cells[k];
+				Eigen::Vector3d d = child.center - cell.center;
+				cell.quadrupole += child.quadrupole + child.mass * d * d.transpose();
+				cell.radius = std::max(cell.radius, d.norm() + child.radius);
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Dual tree-walk: add the interactions of the source-cell to the target-cell and its sub-tree.
+ *
+ * \param source
+ *      Index of the source-cell.
+ * \param target
+ *      Index of the target-cell.
+ */
+void FastMultipole::interact(int source, int target) {
+	const Cell &a = _cells[source];
+	Cell &b = _cells[target];
+
+	if (a.mass <= 0.0) {
+		return;
+	}
+
+	double r2 = (b.center - a.center).squaredNorm();
+	double size = a.radius + b.radius;
+
+	if (source != target && size * size < _theta * _theta * r2) {
+		multipoleToLocal(a, b);
+	} else if (a.cntChildren == 0 && b.cntChildren == 0) {
+		particleToParticle(a, b);
+	} else if (b.cntChildren == 0 || (a.cntChildren > 0 && a.radius > b.radius)) {
+		// open the larger cell
+		for (int c = a.firstChild; c < a.firstChild + a.cntChildren; ++c) {
+			interact(c, target);
+		}
+	} else {
+		for (int c = b.firstChild; c < b.firstChild + b.cntChildren; ++c) {
+			interact(source, c);
+		}
+	}
+}
+
+
+/**
+ * \brief Translate the multipole-expansion of the source to the local expansion of the target.
+ *
+ * \param source
+ *      Source-cell.
+ * \param target
+ *      Output-parameter: Target-cell (its local expansion is updated).
+ */
+void FastMultipole::multipoleToLocal(const Cell &source, Cell &target) {
+	// derivatives of 1/r at R = z_target - z_source, contracted with the mass and the quadrupole
+	Eigen::Vector3d R = target.center - source.center;
+	double invR2 = 1.0 / R.squaredNorm();
+	double invR = std::sqrt(invR2);
+	double invR3 = invR * invR2;
+	double invR5 = invR3 * invR2;
+	double invR7 = invR5 * invR2;
+	double invR9 = invR7 * invR2;
+
+	const Eigen::Matrix3d &Q = source.quadrupole;
+	Eigen::Vector3d QR = Q * R;
+	double RQR = R.dot(QR);
+	double traceQ = Q.trace();
+	Eigen::Matrix3d RR = R * R.transpose();
+	Eigen::Matrix3d identity = Eigen::Matrix3d::Identity();
+
+	// field: first derivative with the mass, third derivative with the quadrupole
+	target.field += -source.mass * invR3 * R
+		+ 0.5 * (-15.0 * RQR * invR7 * R + 3.0 * invR5 * (traceQ * R + 2.0 * QR));
+
+	// gradient: second derivative with the mass, fourth derivative with the quadrupole
+	Eigen::Matrix3d QRR = QR * R.transpose();
+	target.gradient += source.mass * (3.0 * invR5 * RR - invR3 * identity)
+		+ 0.5 * (105.0 * RQR * invR9 * RR - 15.0 * invR7 * (RQR * identity + 2.0 * (QRR + QRR.transpose()) + traceQ * RR)
+		+ 3.0 * invR5 * (traceQ * identity + 2.0 * Q));
+
+	// second derivatives of the field: third derivative with the mass
+	for (int c = 0; c < 3; ++c) {
+		Eigen::Matrix3d cross = Eigen::Matrix3d::Zero();
+		cross.row(c) += R.transpose();
+		cross.col(c) += R;
+
+		target.hessian[c] += source.mass * (-15.0 * R(c) * invR7 * RR + 3.0 * invR5 * (R(c) * identity + cross));
+	}
+}
+
+
+/**
+ * \brief Sum the field of the bodies of the source directly at the bodies of the target.
+ *
+ * \param source
+ *      Source-cell.
+ * \param target
+ *      Target-cell.
+ */
+void FastMultipole::particleToParticle(const Cell &source, const Cell &target) {
+	for (int i = target.begin; i < target.end; ++i) {
+		double xi = _x[i], yi = _y[i], zi = _z[i];
+		double fx = 0.0, fy = 0.0, fz = 0.0;
+
+		// the pair of a body with itself has no distance, so it does not contribute
+		for (int j = source.begin; j < source.end; ++j) {
+			double dx = _x[j] - xi;
+			double dy = _y[j] - yi;
+			double dz = _z[j] - zi;
+			double r2 = dx * dx + dy * dy + dz * dz + _eps;
+			double s = r2 > 0.0 ? _m[j] / (r2 * std::sqrt(r2)) : 0.0;
+
+			fx += s * dx;
+			fy += s * dy;
+			fz += s * dz;
+		}
+
+		_ax[i] += fx;
+		_ay[i] += fy;
+		_az[i] += fz;
+	}
+}
+
+
+/**
+ * \brief Shift the local expansion of a cell down to its children and evaluate it at the bodies of the leaves.
+ *
+ * \param cell
+ *      Index of the cell.
+ */
+void FastMultipole::evaluateLocal(int cell) {
+	const Cell &parent = _cells[cell];
+
+	if (parent.cntChildren == 0) {
+		for (int k = parent.begin; k < parent.end; ++k) {
+			Eigen::Vector3d y = Eigen::Vector3d(_x[k], _y[k], _z[k]) - parent.center;
+			Eigen::Vector3d field = parent.field + parent.gradient * y;
+			for (int axis = 0; axis < 3; ++axis) {
+				field(axis) += 0.5 * y.dot(parent.hessian[axis] * y);
+			}
+
+			_ax[k] += field(0);
+			_ay[k] += field(1);
+			_az[k] += field(2);
+		}
+		return;
+	}
+
+	// Taylor-shift of the expansion to the center of the child
+	for (int c = parent.firstChild; c < parent.firstChild + parent.cntChildren; ++c) {
+		Cell &child = _cells[c];
+		Eigen::Vector3d y = child.center - parent.center;
+
+		child.field += parent.field + parent.gradient * y;
+		child.gradient += parent.gradient;
+		for (int axis = 0; axis < 3; ++axis) {
+			Eigen::Vector3d hy = parent.hessian[axis] * y;
+			child.field(axis) += 0.5 * y.dot(hy);
+			child.gradient.row(axis) += hy.transpose();
+			child.hessian[axis] += parent.hessian[axis];
+		}
+
+		evaluateLocal(c);
+	}
+}
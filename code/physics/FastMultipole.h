@@ -0,0 +1,207 @@
+﻿/**
+ * \brief Implementation of the fast multipole method (FMM) with quadrupole expansions.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-10
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+namespace pbs17 {
+	class BodyState;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Fast multipole solver O(N): the bodies are sorted into an adaptive octree (Morton-codes), each cell
+	 *        gets a multipole-expansion (mass and quadrupole around its center of mass), and the cells which are
+	 *        well separated ((r_A + r_B) < theta * |z_A - z_B|) interact by a multipole-to-local translation
+	 *        instead of opening them (dual tree-walk). The local expansions (field, its gradient and second
+	 *        derivatives) are shifted down the tree and evaluated at the bodies, the remaining close pairs are
+	 *        summed directly.
+	 *
+	 * All terms up to the third order (quadrupole of the source, second order of the local expansion) are kept,
+	 * so the error of the field decreases with theta^3.
+	 * The walk only writes into the sub-tree of the target, so the sub-trees are processed in parallel.
+	 */
+	class FastMultipole {
+	public:
+		/**
+		 * \brief Constructor of the fast multipole solver.
+		 *
+		 * \param theta
+		 *      Opening angle ((r_A + r_B) / distance) up to which two cells interact by their expansions.
+		 */
+		FastMultipole(double theta = 0.5);
+
+
+		/**
+		 * \brief Calculate the field sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) for all bodies (same convention
+		 *        as the other solvers, the expansions are not softened).
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance of the direct pairs.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 */
+		void computeFields(const BodyState &bodies, double eps, std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az);
+
+
+		/**
+		 * \brief Set the opening angle.
+		 *
+		 * \param theta
+		 *      New opening angle (smaller => more accurate and slower, 0.0 means exact all-pairs summation).
+		 */
+		void setTheta(const double theta) {
+			_theta = theta;
+		}
+
+
+		/**
+		 * \brief Get the opening angle.
+		 *
+		 * \return Opening angle.
+		 */
+		double getTheta() const {
+			return _theta;
+		}
+
+
+		/**
+		 * \brief Set the maximal number of bodies per leaf (the bodies of two close leaves are summed directly).
+		 *
+		 * \param leafSize
+		 *      Bodies per leaf (>= 1).
+		 */
+		void setLeafSize(const int leafSize) {
+			_leafSize = std::max(leafSize, 1);
+		}
+
+
+	private:
+		/**
+		 * \brief Cell of the octree with its multipole- and local-expansion. The children of a cell are stored
+		 *        consecutively and always after their parent.
+		 */
+		struct Cell {
+			//! Range of the bodies of the cell (in the order of the codes)
+			int begin;
+			int end;
+			//! First child and number of children (0 => leaf)
+			int firstChild;
+			int cntChildren;
+			//! Center of mass (center of both expansions)
+			Eigen::Vector3d center;
+			//! Distance of the farthest body to the center of mass
+			double radius;
+			double mass;
+			//! Second moment of the masses around the center of mass
+			Eigen::Matrix3d quadrupole;
+			//! Local expansion: field at the center, its gradient and second derivatives (hessian[c](a, b) = d^2 field_c / da db)
+			Eigen::Vector3d field;
+			Eigen::Matrix3d gradient;
+			Eigen::Matrix3d hessian[3];
+		};
+
+		//! Maximal depth of the octree (bits per axis of the Morton-codes)
+		static const int MAX_DEPTH = 21;
+
+		//! Opening angle
+		double _theta;
+		//! Maximal number of bodies per leaf
+		int _leafSize = 32;
+		//! Softening of the direct pairs
+		double _eps = 0.0;
+
+		//! All cells of the tree, the root is at index 0
+		std::vector<Cell> _cells;
+
+		//! Sorted Morton-codes and the buffers of the sort
+		std::vector<uint64_t> _codes;
+		std::vector<uint64_t> _tmpCodes;
+		std::vector<int> _tmpOrder;
+		//! Index of the body at each position of the codes
+		std::vector<int> _order;
+
+		//! Positions, masses and fields of the bodies in the order of the codes
+		std::vector<double> _x, _y, _z, _m;
+		std::vector<double> _ax, _ay, _az;
+
+
+		/**
+		 * \brief Sort the bodies and split the cells until they have at most _leafSize bodies.
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 */
+		void build(const BodyState &bodies);
+
+
+		/**
+		 * \brief Split a cell into the octants of the next level of the codes (recursively).
+		 *
+		 * \param cell
+		 *      Index of the cell.
+		 * \param level
+		 *      Level of the cell (0 => root).
+		 */
+		void split(int cell, int level);
+
+
+		/**
+		 * \brief Calculate the multipole-expansions bottom-up (leaves from their bodies, the others from their children).
+		 */
+		void computeMultipoles();
+
+
+		/**
+		 * \brief Dual tree-walk: add the interactions of the source-cell to the target-cell and its sub-tree.
+		 *
+		 * \param source
+		 *      Index of the source-cell.
+		 * \param target
+		 *      Index of the target-cell.
+		 */
+		void interact(int source, int target);
+
+
+		/**
+		 * \brief Translate the multipole-expansion of the source to the local expansion of the target.
+		 *
+		 * \param source
+		 *      Source-cell.
+		 * \param target
+		 *      Output-parameter: Target-cell (its local expansion is updated).
+		 */
+		static void multipoleToLocal(const Cell &source, Cell &target);
+
+
+		/**
+		 * \brief Sum the field of the bodies of the source directly at the bodies of the target.
+		 *
+		 * \param source
+		 *      Source-cell.
+		 * \param target
+		 *      Target-cell.
+		 */
+		void particleToParticle(const Cell &source, const Cell &target);
+
+
+		/**
+		 * \brief Shift the local expansion of a cell down to its children and evaluate it at the bodies of the leaves.
+		 *
+		 * \param cell
+		 *      Index of the cell.
+		 */
+		void evaluateLocal(int cell);
+	};
+}
@@ -0,0 +1,169 @@
+﻿/**
+ * \brief Implementation of the fracture of the asteroids into pre-fractured pieces.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#include "FractureManager.h"
+
+#include <iostream>
+#include <Eigen/Geometry>
+
+#include "../scene/SpaceObject.h"
+#include "../scene/Asteroid.h"
+#include "../scene/Fragment.h"
+#include "BodyPool.h"
+#include "Tracer.h"
+#include "Logger.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor of the fracture-manager: pre-fracture the models of the asteroids and fill the pools.
+ *
+ * \param spaceObjects
+ *      All space-objects in the scene.
+ * \param cntPieces
+ *      Number of Voronoi-pieces per model.
+ * \param cntSlots
+ *      Number of asteroids per model and texture which can break.
+ */
+FractureManager::FractureManager(const std::vector<SpaceObject*> &spaceObjects, int cntPieces, int cntSlots)
+	: _root(new osg::Group) {
+	TRACE_SCOPE("prefracture");
+	bool withGeometry = !SpaceObject::getIsHeadless();
+
+	for (unsigned int i = 0; i < spaceObjects.size(); ++i) {
+		const ConvexHull3D* hull = spaceObjects[i]->getConvexHullModel();
+		PoolKey key(hull, spaceObjects[i]->getTextureName());
+
+		if (dynamic_cast<Asteroid*>(spaceObjects[i]) == nullptr || hull == nullptr || _pools.count(key) > 0) continue;
+
+		// the pieces are shared by the pools of all textures of the model
+		std::map<const ConvexHull3D*, std::vector<VoronoiFracture::Piece> >::iterator found = _pieces.find(hull);
+		if (found == _pieces.end()) {
+			found = _pieces.insert(std::make_pair(hull, std::vector<VoronoiFracture::Piece>())).first;
+			VoronoiFracture::fracture(*hull, cntPieces, SEED, withGeometry, found->second);
+		}
+
+		const std::vector<VoronoiFracture::Piece> &pieces = found->second;
+		if (pieces.size() < 2) continue;
+
+		Pool &pool = _pools[key];
+		pool.pieces = &pieces;
+		for (unsigned int p = 0; p < pieces.size(); ++p) {
+			BodyPool* bodies = new BodyPool();
+			bodies->reserve(cntSlots);
+
+			for (int slot = 0; slot < cntSlots; ++slot) {
+				Fragment* fragment = new Fragment(pieces[p], key.second);
+
+				bodies->add(fragment);
+				_fragments.push_back(fragment);
+				_root->addChild(fragment->getModel());
+			}
+
+			pool.bodies.push_back(bodies);
+		}
+	}
+
+	LOG_INFO("Pre-fractured " << _pieces.size() << " models into " << _fragments.size() << " pooled fragments.");
+}
+
+
+/**
+ * \brief Destructor of the fracture-manager (deletes the pools of the fragments and the hulls of the pieces).
+ */
+FractureManager::~FractureManager() {
+	for (std::map<PoolKey, Pool>::iterator it = _pools.begin(); it != _pools.end(); ++it) {
+		for (unsigned int p = 0; p < it->second.bodies.size(); ++p) {
+			delete it->second.bodies[p];
+		}
+	}
+
+	for (std::map<const ConvexHull3D*, std::vector<VoronoiFracture::Piece> >::iterator it = _pieces.begin(); it != _pieces.end(); ++it) {
+		for (unsigned int p = 0; p < it->second.size(); ++p) {
+			delete it->second[p].hull;
+		}
+	}
+}
+
+
+/**
+ * \brief Break the objects of the contacts whose velocity is changed too much by the impulse of the contact.
+ *        The fragments are activated with the state of their objects.
+ *
+ * \param contacts
+ *      Solved contacts of the last step (see Collision::getImpulse()).
+ * \param broken
+ *      Output-parameter: The broken objects are appended (to be despawned).
+ * \param fragments
+ *      Output-parameter: The activated fragments are appended (to be spawned).
+ *
+ * \return True if any object broke.
+ */
+bool FractureManager::fracture(const std::vector<Collision> &contacts, std::vector<SpaceObject*> &broken, std::vector<SpaceObject*> &fragments) {
+	unsigned int cntBroken = 0;
+
+	// in the order of the contacts, so the same objects break independent of the threads
+	for (unsigned int i = 0; i < contacts.size() && cntBroken < MAX_FRACTURES_PER_STEP; ++i) {
+		SpaceObject* pair[2] = { contacts[i].getFirstObject(), contacts[i].getSecondObject() };
+
+		for (int k = 0; k < 2 && cntBroken < MAX_FRACTURES_PER_STEP; ++k) {
+			SpaceObject* object = pair[k];
+
+			if (!object->isActive() || object->getMass() <= 0.0 || contacts[i].getImpulse() < _fractureVelocity * object->getMass()) continue;
+
+			// the fragments and the other objects have no pool
+			std::map<PoolKey, Pool>::iterator it = _pools.find(PoolKey(object->getConvexHullModel(), object->getTextureName()));
+			if (it == _pools.end() || dynamic_cast<Asteroid*>(object) == nullptr) continue;
+
+			// the pieces are spawned together, so the pools of a model have the same number of free fragments
+			if (it->second.bodies.empty() || it->second.bodies[0]->getNumFree() == 0) continue;
+
+			breakObject(object, it->second, fragments);
+			broken.push_back(object);
+			++cntBroken;
+		}
+	}
+
+	_cntFractures += cntBroken;
+
+	return cntBroken > 0;
+}
+
+
+/**
+ * \brief Activate a free fragment per piece of the pool with the state of a broken object.
+ *
+ * \param object
+ *      Broken object.
+ * \param pool
+ *      Pool of the model and the texture of the object (has a free fragment per piece).
+ * \param fragments
+ *      Output-parameter: The activated fragments are appended.
+ */
+void FractureManager::breakObject(SpaceObject* object, Pool &pool, std::vector<SpaceObject*> &fragments) {
+	const std::vector<VoronoiFracture::Piece> &pieces = *pool.pieces;
+
+	osg::Quat orientation = object->getOrientation();
+	Eigen::Matrix3d rotation = Eigen::Quaterniond(orientation.w(), orientation.x(), orientation.y(), orientation.z()).toRotationMatrix();
+	double scaling = object->getScaling();
+
+	// the pieces move with the rigid motion of the object (the contact-solver already changed it)
+	for (unsigned int p = 0; p < pieces.size(); ++p) {
+		Fragment* fragment = static_cast<Fragment*>(pool.bodies[p]->acquire());
+		Eigen::Vector3d offset = rotation * (scaling * pieces[p].centroid);
+
+		fragment->activate(object->getPosition() + offset, orientation, scaling, pieces[p].volumeRatio * object->getMass(),
+			object->getLinearVelocity() + object->getAngularVelocity().cross(offset), object->getAngularVelocity());
+		// the debris is filtered like its object
+		fragment->setCollisionFilter(object->getCollisionGroup(), object->getCollisionMask());
+		fragments.push_back(fragment);
+	}
+
+	// the object is not broken twice by its other contacts
+	object->setActive(false);
+}
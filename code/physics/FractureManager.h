@@ -0,0 +1,161 @@
+﻿/**
+ * \brief Implementation of the fracture of the asteroids into pre-fractured pieces.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <string>
+#include <osg/Group>
+
+#include "Collision.h"
+#include "../graphics/VoronoiFracture.h"
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+	class BodyPool;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief The manager which breaks the asteroids on contacts with a high impulse. The models are split into their
+	 * Voronoi-pieces once when the manager is created (see VoronoiFracture) and a pool of fragments is created per
+	 * model, texture and piece (see BodyPool), so a fracture only spawns one free fragment per piece with the state of
+	 * the asteroid. Nothing is computed or allocated during the steps (no CGAL, no new nodes).
+	 *
+	 * The fragments do not break again. A despawned fragment returns to its pool, once the pool of a model is
+	 * exhausted, its asteroids stay whole.
+	 */
+	class FractureManager {
+	public:
+		/**
+		 * \brief Constructor of the fracture-manager: pre-fracture the models of the asteroids and fill the pools.
+		 *
+		 * \param spaceObjects
+		 *      All space-objects in the scene.
+		 * \param cntPieces
+		 *      Number of Voronoi-pieces per model.
+		 * \param cntSlots
+		 *      Number of asteroids per model and texture which can break.
+		 */
+		FractureManager(const std::vector<SpaceObject*> &spaceObjects, int cntPieces = 8, int cntSlots = 4);
+
+
+		/**
+		 * \brief Destructor of the fracture-manager (deletes the pools of the fragments and the hulls of the pieces).
+		 */
+		~FractureManager();
+
+
+		/**
+		 * \brief Break the objects of the contacts whose velocity is changed too much by the impulse of the contact.
+		 *        The fragments are activated with the state of their objects.
+		 *
+		 * \param contacts
+		 *      Solved contacts of the last step (see Collision::getImpulse()).
+		 * \param broken
+		 *      Output-parameter: The broken objects are appended (to be despawned).
+		 * \param fragments
+		 *      Output-parameter: The activated fragments are appended (to be spawned).
+		 *
+		 * \return True if any object broke.
+		 */
+		bool fracture(const std::vector<Collision> &contacts, std::vector<SpaceObject*> &broken, std::vector<SpaceObject*> &fragments);
+
+
+		/**
+		 * \brief Set the change of the velocity (impulse / mass) by a contact at which an asteroid breaks.
+		 *
+		 * \param velocity
+		 *      Change of the velocity: unit = m/s
+		 */
+		void setFractureVelocity(const double velocity) {
+			_fractureVelocity = velocity;
+		}
+
+
+		/**
+		 * \brief Get all fragments of the pools (active or not).
+		 *
+		 * \return Fragments in the order of the pools.
+		 */
+		const std::vector<SpaceObject*>& getFragments() const {
+			return _fragments;
+		}
+
+
+		/**
+		 * \brief Get the root of the nodes of the fragments (hidden until they are activated).
+		 *
+		 * \return Root-node of the fragments.
+		 */
+		osg::ref_ptr<osg::Group> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Get the number of broken objects.
+		 *
+		 * \return Fractures since the start.
+		 */
+		unsigned int getNumFractures() const {
+			return _cntFractures;
+		}
+
+
+	private:
+		/**
+		 * \brief Fragments of a model and a texture.
+		 */
+		struct Pool {
+			//! Pre-fractured pieces of the model
+			const std::vector<VoronoiFracture::Piece>* pieces = nullptr;
+			//! Fragments per piece (owned by the pools)
+			std::vector<BodyPool*> bodies;
+		};
+
+		//! Key of a pool: convex-hull of the model (shared by all of its asteroids) and texture
+		typedef std::pair<const ConvexHull3D*, std::string> PoolKey;
+
+		//! Pre-fractured pieces per convex-hull of a model
+		std::map<const ConvexHull3D*, std::vector<VoronoiFracture::Piece> > _pieces;
+		//! Pools of the fragments
+		std::map<PoolKey, Pool> _pools;
+		//! All fragments of the pools
+		std::vector<SpaceObject*> _fragments;
+		//! Root of the nodes of the fragments
+		osg::ref_ptr<osg::Group> _root;
+
+		//! Change of the velocity at which an asteroid breaks
+		double _fractureVelocity = 1.0;
+		//! Number of broken objects
+		unsigned int _cntFractures = 0;
+
+		//! Objects which break per step at most (bounds the work of a step)
+		static const unsigned int MAX_FRACTURES_PER_STEP = 4;
+		//! Seed of the Voronoi-seeds (the same model always breaks in the same way)
+		static const unsigned int SEED = 17;
+
+
+		/**
+		 * \brief Activate a free fragment per piece of the pool with the state of a broken object.
+		 *
+		 * \param object
+		 *      Broken object.
+		 * \param pool
+		 *      Pool of the model and the texture of the object (has a free fragment per piece).
+		 * \param fragments
+		 *      Output-parameter: The activated fragments are appended.
+		 */
+		static void breakObject(SpaceObject* object, Pool &pool, std::vector<SpaceObject*> &fragments);
+	};
+}
@@ -0,0 +1,164 @@
+﻿/**
+ * \brief Implementation of the per-step arena of the transient buffers.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/ScopedLock>
+
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+using namespace pbs17;
+
+
+//! Size of the first block of an arena (64 KB)
+const size_t FrameArena::MIN_BLOCK_SIZE = 1 << 16;
+
+//! Number of nested open frames
+int FrameArena::_cntOpenFrames = 0;
+
+
+namespace {
+	//! Arena of each thread (owned by the list of all arenas)
+	thread_local FrameArena* threadArena = nullptr;
+
+	//! Arenas of all threads which have allocated a buffer
+	std::vector<FrameArena*> arenas;
+
+	//! Protects the list of the arenas.
+	OpenThreads::Mutex arenasMutex;
+}
+
+
+/**
+ * \brief Begin a step of the arenas.
+ */
+FrameArena::Frame::Frame() {
+	++_cntOpenFrames;
+}
+
+
+/**
+ * \brief End the step: Reset all arenas and count their heap-allocations (Profiler::FRAME_ALLOCATIONS).
+ */
+FrameArena::Frame::~Frame() {
+	if (--_cntOpenFrames == 0) {
+		Profiler::Instance()->count(Profiler::FRAME_ALLOCATIONS, resetAll());
+	}
+}
+
+
+/**
+ * \brief Allocate memory from the arena of the current thread (created with its first allocation).
+ *
+ * \param bytes
+ *      Size of the memory.
+ * \param alignment
+ *      Alignment of the memory (power of two).
+ *
+ * \return Memory, valid until the end of the frame.
+ */
+void* FrameArena::allocate(size_t bytes, size_t alignment) {
+	return getThreadArena()->allocateBytes(bytes, alignment);
+}
+
+
+/**
+ * \brief Private constructor to be sure the class can only be created by getThreadArena().
+ */
+FrameArena::FrameArena() : _block(nullptr), _size(0), _used(0), _fullSize(0), _cntHeapAllocations(0) {}
+
+
+/**
+ * \brief Get the arena of the current thread (created with the first call of the thread).
+ *
+ * \return Arena of the thread.
+ */
+FrameArena* FrameArena::getThreadArena() {
+	if (threadArena == nullptr) {
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(arenasMutex);
+
+		threadArena = new FrameArena();
+		arenas.push_back(threadArena);
+	}
+
+	return threadArena;
+}
+
+
+/**
+ * \brief Reset all arenas of the threads (called at the end of the outermost frame).
+ *
+ * \return Number of blocks which were allocated from the heap during the frame.
+ */
+int FrameArena::resetAll() {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(arenasMutex);
+	int cntHeapAllocations = 0;
+
+	for (unsigned int i = 0; i < arenas.size(); ++i) {
+		cntHeapAllocations += arenas[i]->reset();
+	}
+
+	return cntHeapAllocations;
+}
+
+
+/**
+ * \brief Allocate memory from this arena. Same parameters as allocate().
+ */
+void* FrameArena::allocateBytes(size_t bytes, size_t alignment) {
+	// the blocks are aligned to the largest fundamental alignment
+	alignment = std::max(alignment, alignof(std::max_align_t));
+	size_t offset = (_used + alignment - 1) & ~(alignment - 1);
+
+	if (_block == nullptr || offset + bytes > _size) {
+		if (_block != nullptr) {
+			_fullBlocks.push_back(_block);
+			_fullSize += _size;
+		}
+
+		// the blocks at least double, so a frame needs few of them
+		_size = std::max(std::max(2 * _size, MIN_BLOCK_SIZE), bytes);
+		_block = static_cast<char*>(::operator new(_size));
+		MemoryTracker::add(MemoryTracker::FRAME_ARENAS, static_cast<long long>(_size));
+		++_cntHeapAllocations;
+		offset = 0;
+	}
+
+	_used = offset + bytes;
+
+	return _block + offset;
+}
+
+
+/**
+ * \brief Reset the arena: The full blocks are freed and a single block with their total size replaces them.
+ *
+ * \return Number of blocks which were allocated from the heap since the last reset.
+ */
+int FrameArena::reset() {
+	if (!_fullBlocks.empty()) {
+		for (unsigned int i = 0; i < _fullBlocks.size(); ++i) {
+			::operator delete(_fullBlocks[i]);
+		}
+		::operator delete(_block);
+
+		// the next frame of the same size fits into one block (the tracked memory stays the same)
+		_size += _fullSize;
+		_block = static_cast<char*>(::operator new(_size));
+		_fullBlocks.clear();
+		_fullSize = 0;
+	}
+
+	int cntHeapAllocations = _cntHeapAllocations;
+	_cntHeapAllocations = 0;
+	_used = 0;
+
+	return cntHeapAllocations;
+}
@@ -0,0 +1,215 @@
+﻿/**
+ * \brief Implementation of the per-step arena of the transient buffers.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <new>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Bump-allocator of the transient buffers of a step. Each thread allocates from its own arena (no locking
+	 * per allocation), nothing is freed during the step and all arenas are reset at its end (see Frame). An arena which
+	 * needed more than its block during a step is grown to the total, so the steps after the first ones allocate
+	 * nothing from the heap.
+	 */
+	class FrameArena {
+	public:
+
+		/**
+		 * \brief Opens a step of the arenas from its construction to its destruction (only by one driving thread,
+		 *        while no parallel region is running). Nested frames belong to the outermost one.
+		 */
+		class Frame {
+		public:
+
+			/**
+			 * \brief Begin a step of the arenas.
+			 */
+			Frame();
+
+
+			/**
+			 * \brief End the step: Reset all arenas and count their heap-allocations (Profiler::FRAME_ALLOCATIONS).
+			 */
+			~Frame();
+
+
+		private:
+
+			Frame(Frame const&) = delete;
+			Frame& operator=(Frame const&) = delete;
+		};
+
+
+		/**
+		 * \brief Check if a frame is open, so the frame-buffers are allocated from the arenas.
+		 *
+		 * \return True within a frame.
+		 */
+		static bool isFrameOpen() {
+			return _cntOpenFrames > 0;
+		}
+
+
+		/**
+		 * \brief Allocate memory from the arena of the current thread (created with its first allocation).
+		 *
+		 * \param bytes
+		 *      Size of the memory.
+		 * \param alignment
+		 *      Alignment of the memory (power of two).
+		 *
+		 * \return Memory, valid until the end of the frame.
+		 */
+		static void* allocate(size_t bytes, size_t alignment);
+
+
+	private:
+
+		//! Size of the first block of an arena
+		static const size_t MIN_BLOCK_SIZE;
+
+		//! Number of nested open frames
+		static int _cntOpenFrames;
+
+		//! Current block of the arena
+		char* _block;
+
+		//! Size of the current block
+		size_t _size;
+
+		//! Used bytes of the current block
+		size_t _used;
+
+		//! Full blocks of the current frame (freed at its end)
+		std::vector<char*> _fullBlocks;
+
+		//! Size of the full blocks of the current frame
+		size_t _fullSize;
+
+		//! Number of blocks which were allocated from the heap in the current frame
+		int _cntHeapAllocations;
+
+
+		/**
+		 * \brief Get the arena of the current thread (created with the first call of the thread).
+		 *
+		 * \return Arena of the thread.
+		 */
+		static FrameArena* getThreadArena();
+
+
+		/**
+		 * \brief Reset all arenas of the threads (called at the end of the outermost frame).
+		 *
+		 * \return Number of blocks which were allocated from the heap during the frame.
+		 */
+		static int resetAll();
+
+
+		/**
+		 * \brief Allocate memory from this arena. Same parameters as allocate().
+		 */
+		void* allocateBytes(size_t bytes, size_t alignment);
+
+
+		/**
+		 * \brief Reset the arena: The full blocks are freed and a single block with their total size replaces them.
+		 *
+		 * \return Number of blocks which were allocated from the heap since the last reset.
+		 */
+		int reset();
+
+
+		//! Private constructor to be sure the class can only be created by getThreadArena().
+		FrameArena();
+		FrameArena(FrameArena const&) = delete;
+		FrameArena& operator=(FrameArena const&) = delete;
+	};
+
+
+	/**
+	 * \brief STL-allocator of the transient buffers of a step. Within a frame, the memory comes from the arena of the
+	 * allocating thread and is never freed individually, outside of a frame it comes from the heap. A buffer which is
+	 * created within a frame must not be used after the end of the frame.
+	 */
+	template<typename T>
+	class FrameAllocator {
+	public:
+		typedef T value_type;
+
+
+		/**
+		 * \brief Create an allocator for the arenas (within a frame) or the heap (outside of a frame).
+		 */
+		FrameAllocator() : _isFrame(FrameArena::isFrameOpen()) {}
+
+
+		/**
+		 * \brief Copy an allocator of another type (e.g. for the nodes of a container).
+		 */
+		template<typename U>
+		FrameAllocator(const FrameAllocator<U> &other) : _isFrame(other.isFrame()) {}
+
+
+		/**
+		 * \brief Allocate the memory of n values.
+		 */
+		T* allocate(size_t n) {
+			if (_isFrame) {
+				return static_cast<T*>(FrameArena::allocate(n * sizeof(T), alignof(T)));
+			}
+
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+		}
+
+
+		/**
+		 * \brief Free the memory of n values (released with the arena within a frame).
+		 */
+		void deallocate(T* p, size_t /*n*/) {
+			if (!_isFrame) {
+				::operator delete(p);
+			}
+		}
+
+
+		/**
+		 * \brief Check if the allocator uses the arenas.
+		 */
+		bool isFrame() const {
+			return _isFrame;
+		}
+
+
+	private:
+
+		//! True if the memory comes from the arenas
+		bool _isFrame;
+	};
+
+
+	template<typename T, typename U>
+	bool operator==(const FrameAllocator<T> &a, const FrameAllocator<U> &b) {
+		return a.isFrame() == b.isFrame();
+	}
+
+
+	template<typename T, typename U>
+	bool operator!=(const FrameAllocator<T> &a, const FrameAllocator<U> &b) {
+		return a.isFrame() != b.isFrame();
+	}
+
+
+	//! Transient buffer of a step (see FrameAllocator)
+	template<typename T>
+	using FrameVector = std::vector<T, FrameAllocator<T>>;
+}
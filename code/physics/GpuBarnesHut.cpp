@@ -0,0 +1,161 @@
+﻿/**
+ * \brief Implementation of the Barnes-Hut tree on the GPU (CUDA).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "GpuBarnesHut.h"
+#include "Logger.h"
+
+#include <algorithm>
+
+#if defined(PBS17_CUDA)
+#include <cuda_runtime_api.h>
+
+namespace pbs17 {
+	// defined in GpuBarnesHut.cu
+	bool launchTreeBuild(const double* bodies, int n, double* sorted, unsigned long long* codes, int* order,
+		double* nodes, int* topology);
+	bool launchTreeTraversal(const double* sorted, const int* order, int n, const double* nodes, const int* topology,
+		double eps, double theta, double* fields, int* overflow);
+}
+#endif
+
+using namespace pbs17;
+
+
+namespace {
+	//! Arrays of the node-data and of the topology per node (see GpuBarnesHut.cu)
+	const int CNT_NODE_DATA = 11;
+	const int CNT_TOPOLOGY = 7;
+}
+
+
+/**
+ * \brief Destructor of the GPU-tree (frees the device-buffers).
+ */
+GpuBarnesHut::~GpuBarnesHut() {
+	release();
+}
+
+
+/**
+ * \brief Calculate the softened field a_i = sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) for all bodies, where
+ *        the far away cells are approximated by their center of mass.
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param theta
+ *      Opening angle (cell-size / distance) up to which a cell is approximated.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ *
+ * \return False if the GPU is not available or failed (the fields are not calculated).
+ */
+bool GpuBarnesHut::computeFields(const double* x, const double* y, const double* z, const double* m, int n, double eps, double theta,
+	double* ax, double* ay, double* az) {
+#if defined(PBS17_CUDA)
+	// a single body has no tree (and no field)
+	if (n < 2) {
+		std::fill(ax, ax + std::max(n, 0), 0.0);
+		std::fill(ay, ay + std::max(n, 0), 0.0);
+		std::fill(az, az + std::max(n, 0), 0.0);
+		return true;
+	}
+
+	// the buffers only grow, so a changing number of bodies does not reallocate each step
+	bool isResized = false;
+	if (n > _capacity) {
+		release();
+		_capacity = n;
+		int cntNodes = 2 * n - 1;
+
+		if (cudaMalloc(reinterpret_cast<void**>(&_deviceBodies), 4 * sizeof(double) * n) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceSorted), 4 * sizeof(double) * n) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceCodes), sizeof(unsigned long long) * n) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceOrder), sizeof(int) * n) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceNodes), CNT_NODE_DATA * sizeof(double) * cntNodes) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceTopology), CNT_TOPOLOGY * sizeof(int) * cntNodes) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceFields), 3 * sizeof(double) * n) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceOverflow), sizeof(int)) != cudaSuccess) {
+			LOG_WARNING("The device-buffers of the tree for " << n << " bodies can't be allocated on the GPU!");
+			release();
+			return false;
+		}
+		isResized = true;
+	}
+
+	bool isOk = cudaMemcpy(_deviceBodies, x, sizeof(double) * n, cudaMemcpyHostToDevice) == cudaSuccess
+		&& cudaMemcpy(_deviceBodies + n, y, sizeof(double) * n, cudaMemcpyHostToDevice) == cudaSuccess
+		&& cudaMemcpy(_deviceBodies + 2 * n, z, sizeof(double) * n, cudaMemcpyHostToDevice) == cudaSuccess;
+
+	// the masses are at the offset 3 * n, so they are uploaded again if the number of bodies changes
+	if (isOk && (isResized || _uploadedMasses.size() != static_cast<unsigned int>(n) || !std::equal(m, m + n, _uploadedMasses.begin()))) {
+		isOk = cudaMemcpy(_deviceBodies + 3 * n, m, sizeof(double) * n, cudaMemcpyHostToDevice) == cudaSuccess;
+		_uploadedMasses.assign(m, m + n);
+	}
+
+	// the tree is rebuilt each step on the device, which is cheaper than the traversal
+	int overflow = 0;
+	_fields.resize(3 * n);
+	isOk = isOk && launchTreeBuild(_deviceBodies, n, _deviceSorted, _deviceCodes, _deviceOrder, _deviceNodes, _deviceTopology)
+		&& launchTreeTraversal(_deviceSorted, _deviceOrder, n, _deviceNodes, _deviceTopology, eps, theta, _deviceFields, _deviceOverflow)
+		&& cudaMemcpy(&overflow, _deviceOverflow, sizeof(int), cudaMemcpyDeviceToHost) == cudaSuccess
+		&& cudaMemcpy(_fields.data(), _deviceFields, 3 * sizeof(double) * n, cudaMemcpyDeviceToHost) == cudaSuccess;
+
+	if (!isOk) {
+		// the masses are uploaded again by the next call
+		_uploadedMasses.clear();
+		LOG_WARNING("The tree-kernels failed on the GPU: " << cudaGetErrorString(cudaGetLastError()));
+		return false;
+	}
+
+	if (overflow != 0) {
+		LOG_WARNING("The stack of the tree-traversal overflowed on the GPU (theta too small?)");
+		return false;
+	}
+
+	std::copy(_fields.begin(), _fields.begin() + n, ax);
+	std::copy(_fields.begin() + n, _fields.begin() + 2 * n, ay);
+	std::copy(_fields.begin() + 2 * n, _fields.begin() + 3 * n, az);
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * \brief Free the device-buffers.
+ */
+void GpuBarnesHut::release() {
+#if defined(PBS17_CUDA)
+	cudaFree(_deviceBodies);
+	cudaFree(_deviceSorted);
+	cudaFree(_deviceCodes);
+	cudaFree(_deviceOrder);
+	cudaFree(_deviceNodes);
+	cudaFree(_deviceTopology);
+	cudaFree(_deviceFields);
+	cudaFree(_deviceOverflow);
+#endif
+
+	_deviceBodies = nullptr;
+	_deviceSorted = nullptr;
+	_deviceCodes = nullptr;
+	_deviceOrder = nullptr;
+	_deviceNodes = nullptr;
+	_deviceTopology = nullptr;
+	_deviceFields = nullptr;
+	_deviceOverflow = nullptr;
+	_capacity = 0;
+	_uploadedMasses.clear();
+}
@@ -0,0 +1,522 @@
+﻿/**
+ * \brief Implementation of the Barnes-Hut tree on the GPU: the linear radix-tree is built from the Morton-codes on
+ *        the device and traversed by warps (compiled with -DPBS17_CUDA=ON).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include <cuda_runtime.h>
+#include <thrust/device_ptr.h>
+#include <thrust/extrema.h>
+#include <thrust/pair.h>
+#include <thrust/sequence.h>
+#include <thrust/sort.h>
+#include <thrust/system/cuda/execution_policy.h>
+
+
+namespace {
+
+	//! Threads per block of the building kernels
+	const int BLOCK_SIZE = 256;
+	//! Threads per warp (one group of bodies per warp)
+	const int WARP_SIZE = 32;
+	//! Warps per block of the traversal
+	const int WARPS_PER_BLOCK = 4;
+	//! Nodes of the shared stack per warp (the warp pops up to 32 nodes at once, so the stack is wider than deep)
+	const int STACK_SIZE = 2048;
+	//! Nodes of the shared interaction-list per warp (evaluated as soon as it has 32 nodes)
+	const int LIST_SIZE = 2 * WARP_SIZE;
+	//! Bits per axis of the Morton-codes (see MortonCode)
+	const int BITS_PER_AXIS = 21;
+
+	//! Arrays of the node-data (each with the stride of the number of nodes)
+	enum NodeData { COM_X, COM_Y, COM_Z, MASS, MIN_X, MIN_Y, MIN_Z, MAX_X, MAX_Y, MAX_Z, CELL_SIZE, CNT_NODE_DATA };
+	//! Arrays of the topology (each with the stride of the number of nodes)
+	enum Topology { LEFT, RIGHT, PARENT, FIRST, COUNT, LEVEL, VISITS, CNT_TOPOLOGY };
+
+
+	/**
+	 * \brief Insert two zero-bits between each of the lower 21 bits (see MortonCode::spreadBits()).
+	 */
+	__device__ unsigned long long spreadBits(unsigned long long value) {
+		value &= 0x1fffff;
+		value = (value | value << 32) & 0x1f00000000ffffULL;
+		value = (value | value << 16) & 0x1f0000ff0000ffULL;
+		value = (value | value << 8) & 0x100f00f00f00f00fULL;
+		value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+		value = (value | value << 2) & 0x1249249249249249ULL;
+
+		return value;
+	}
+
+
+	/**
+	 * \brief Calculate the Morton-code of each body (see MortonCode::encode()).
+	 *
+	 * \param bodies
+	 *      Positions and masses (x, y, z, m with the stride n).
+	 * \param n
+	 *      Number of bodies.
+	 * \param minX, minY, minZ
+	 *      Lower corner of the bounding cube.
+	 * \param scale
+	 *      Cells per unit.
+	 * \param codes
+	 *      Output-parameter: Code per body.
+	 * \param order
+	 *      Output-parameter: Index of the body (sorted together with the codes).
+	 */
+	__global__ void encodeBodies(const double* __restrict__ bodies, int n, double minX, double minY, double minZ, double scale,
+		unsigned long long* __restrict__ codes, int* __restrict__ order) {
+		int i = blockIdx.x * blockDim.x + threadIdx.x;
+		if (i >= n) return;
+
+		const double maxCell = static_cast<double>((1 << BITS_PER_AXIS) - 1);
+		double origin[3] = { minX, minY, minZ };
+		unsigned long long code = 0;
+
+		for (int axis = 0; axis < 3; ++axis) {
+			double cell = fmax(0.0, fmin((bodies[axis * n + i] - origin[axis]) * scale, maxCell));
+			code |= spreadBits(static_cast<unsigned long long>(cell)) << axis;
+		}
+
+		codes[i] = code;
+		order[i] = i;
+	}
+
+
+	/**
+	 * \brief Copy the bodies into the sorted order of the codes, so the bodies of a warp are close to each other.
+	 *
+	 * \param bodies
+	 *      Positions and masses (x, y, z, m with the stride n).
+	 * \param order
+	 *      Index of the body at each sorted position.
+	 * \param n
+	 *      Number of bodies.
+	 * \param sorted
+	 *      Output-parameter: Positions and masses in the sorted order.
+	 */
+	__global__ void gatherBodies(const double* __restrict__ bodies, const int* __restrict__ order, int n, double* __restrict__ sorted) {
+		int k = blockIdx.x * blockDim.x + threadIdx.x;
+		if (k >= n) return;
+
+		int i = order[k];
+		for (int c = 0; c < 4; ++c) {
+			sorted[c * n + k] = bodies[c * n + i];
+		}
+	}
+
+
+	/**
+	 * \brief Get the length of the common prefix of two sorted codes (the index breaks the ties of equal codes, see
+	 *        BarnesHutTree::getCommonPrefix()).
+	 */
+	__device__ int getCommonPrefix(const unsigned long long* codes, int n, int i, int j) {
+		if (j < 0 || j >= n) {
+			return -1;
+		}
+
+		if (codes[i] == codes[j]) {
+			return 64 + __clz(i ^ j);
+		}
+
+		return __clzll(codes[i] ^ codes[j]);
+	}
+
+
+	/**
+	 * \brief Find the range and the split of each inner node independently (Karras 2012, see
+	 *        BarnesHutTree::buildInnerNode()).
+	 *
+	 * \param codes
+	 *      Sorted codes.
+	 * \param n
+	 *      Number of bodies (n - 1 inner nodes, followed by the n leaves).
+	 * \param topology
+	 *      Output-parameter: Children, parents, ranges and levels of the nodes.
+	 */
+	__global__ void buildInnerNodes(const unsigned long long* __restrict__ codes, int n, int* __restrict__ topology) {
+		int i = blockIdx.x * blockDim.x + threadIdx.x;
+		int cntInner = n - 1;
+		if (i >= cntInner) return;
+
+		int cntNodes = 2 * n - 1;
+		int direction = getCommonPrefix(codes, n, i, i + 1) - getCommonPrefix(codes, n, i, i - 1) >= 0 ? 1 : -1;
+		int minPrefix = getCommonPrefix(codes, n, i, i - direction);
+
+		// upper bound of the length of the range, then the exact end by a binary search
+		int maxLength = 2;
+		while (getCommonPrefix(codes, n, i, i + maxLength * direction) > minPrefix) {
+			maxLength *= 2;
+		}
+
+		int length = 0;
+		for (int step = maxLength / 2; step >= 1; step /= 2) {
+			if (getCommonPrefix(codes, n, i, i + (length + step) * direction) > minPrefix) {
+				length += step;
+			}
+		}
+		int j = i + length * direction;
+
+		// the split is the last code which shares more than the prefix of the range with the first one
+		int nodePrefix = getCommonPrefix(codes, n, i, j);
+		int split = 0;
+		int step = length;
+		do {
+			step = (step + 1) / 2;
+			if (getCommonPrefix(codes, n, i, i + (split + step) * direction) > nodePrefix) {
+				split += step;
+			}
+		} while (step > 1);
+		int gamma = i + split * direction + min(direction, 0);
+
+		int left = min(i, j) == gamma ? cntInner + gamma : gamma;
+		int right = max(i, j) == gamma + 1 ? cntInner + gamma + 1 : gamma + 1;
+
+		topology[LEFT * cntNodes + i] = left;
+		topology[RIGHT * cntNodes + i] = right;
+		topology[FIRST * cntNodes + i] = min(i, j);
+		topology[COUNT * cntNodes + i] = length + 1;
+		topology[LEVEL * cntNodes + i] = (nodePrefix - 1) / 3;
+		topology[VISITS * cntNodes + i] = 0;
+		topology[PARENT * cntNodes + left] = i;
+		topology[PARENT * cntNodes + right] = i;
+
+		if (i == 0) {
+			topology[PARENT * cntNodes] = -1;
+		}
+	}
+
+
+	/**
+	 * \brief Set the leaves to the sorted bodies and sum the inner nodes bottom-up: each leaf walks up to the root,
+	 *        the first child which arrives at a node stops there (see BarnesHutTree::sumBottomUp()).
+	 *
+	 * \param sorted
+	 *      Positions and masses in the sorted order.
+	 * \param n
+	 *      Number of bodies.
+	 * \param rootSize
+	 *      Edge-length of the bounding cube (the cell-size of the root).
+	 * \param nodes
+	 *      Output-parameter: Centers of mass, masses, boxes and cell-sizes of the nodes.
+	 * \param topology
+	 *      Input-/Output-parameter: Topology of buildInnerNodes() (the visits are counted).
+	 */
+	__global__ void sumBottomUp(const double* __restrict__ sorted, int n, double rootSize, double* nodes, int* topology) {
+		int k = blockIdx.x * blockDim.x + threadIdx.x;
+		if (k >= n) return;
+
+		int cntInner = n - 1;
+		int cntNodes = 2 * n - 1;
+		int leaf = cntInner + k;
+
+		for (int c = 0; c < 3; ++c) {
+			double position = sorted[c * n + k];
+			nodes[(COM_X + c) * cntNodes + leaf] = position;
+			nodes[(MIN_X + c) * cntNodes + leaf] = position;
+			nodes[(MAX_X + c) * cntNodes + leaf] = position;
+		}
+		nodes[MASS * cntNodes + leaf] = sorted[3 * n + k];
+		nodes[CELL_SIZE * cntNodes + leaf] = 0.0;
+
+		// the data of the other child was written by another thread, so it's read past the caches
+		const volatile double* data = nodes;
+		const volatile int* links = topology;
+
+		for (int parent = links[PARENT * cntNodes + leaf]; parent != -1; parent = links[PARENT * cntNodes + parent]) {
+			__threadfence();
+			if (atomicAdd(&topology[VISITS * cntNodes + parent], 1) == 0) {
+				break;
+			}
+			__threadfence();
+
+			int left = links[LEFT * cntNodes + parent];
+			int right = links[RIGHT * cntNodes + parent];
+			double leftMass = data[MASS * cntNodes + left];
+			double rightMass = data[MASS * cntNodes + right];
+			double mass = leftMass + rightMass;
+			double extent = 0.0;
+
+			for (int c = 0; c < 3; ++c) {
+				double boxMin = fmin(data[(MIN_X + c) * cntNodes + left], data[(MIN_X + c) * cntNodes + right]);
+				double boxMax = fmax(data[(MAX_X + c) * cntNodes + left], data[(MAX_X + c) * cntNodes + right]);
+				double com = mass > 0.0
+					? (leftMass * data[(COM_X + c) * cntNodes + left] + rightMass * data[(COM_X + c) * cntNodes + right]) / mass
+					: 0.5 * (boxMin + boxMax);
+
+				nodes[(MIN_X + c) * cntNodes + parent] = boxMin;
+				nodes[(MAX_X + c) * cntNodes + parent] = boxMax;
+				nodes[(COM_X + c) * cntNodes + parent] = com;
+				extent = fmax(extent, boxMax - boxMin);
+			}
+
+			nodes[MASS * cntNodes + parent] = mass;
+			nodes[CELL_SIZE * cntNodes + parent] = fmax(ldexp(rootSize, -min(links[LEVEL * cntNodes + parent], BITS_PER_AXIS)), extent);
+		}
+	}
+
+
+	/**
+	 * \brief Add the softened field of the interaction-list to the body of each lane: the lanes load one node
+	 *        each, which is broadcast to the whole warp.
+	 */
+	__device__ void evaluateList(const int* list, int cntList, const double* __restrict__ nodes, int cntNodes, double eps,
+		double xi, double yi, double zi, double &fx, double &fy, double &fz) {
+		int lane = threadIdx.x % WARP_SIZE;
+
+		for (int start = 0; start < cntList; start += WARP_SIZE) {
+			int entry = start + lane;
+			int node = entry < cntList ? list[entry] : 0;
+
+			// the padding of the last chunk has no mass
+			double cx = nodes[COM_X * cntNodes + node];
+			double cy = nodes[COM_Y * cntNodes + node];
+			double cz = nodes[COM_Z * cntNodes + node];
+			double cm = entry < cntList ? nodes[MASS * cntNodes + node] : 0.0;
+
+			for (int t = 0; t < WARP_SIZE; ++t) {
+				double dx = __shfl_sync(0xffffffff, cx, t) - xi;
+				double dy = __shfl_sync(0xffffffff, cy, t) - yi;
+				double dz = __shfl_sync(0xffffffff, cz, t) - zi;
+				double m = __shfl_sync(0xffffffff, cm, t);
+				double r2 = dx * dx + dy * dy + dz * dz + eps;
+
+				// the body itself is at distance 0 and does not contribute
+				double invDist = r2 > 0.0 ? rsqrt(r2) : 0.0;
+				double s = m * invDist * invDist * invDist;
+
+				fx += s * dx;
+				fy += s * dy;
+				fz += s * dz;
+			}
+		}
+	}
+
+
+	/**
+	 * \brief Field of the sorted bodies: each warp is a group of 32 consecutive bodies which traverses the tree
+	 *        once. The lanes decide on up to 32 nodes of the shared stack at once against the box of the group
+	 *        (see BarnesHutTree::computeFieldsGrouped()), the accepted nodes and leaves are appended to a shared
+	 *        interaction-list which is evaluated by the whole warp.
+	 *
+	 * \param sorted
+	 *      Positions and masses in the sorted order.
+	 * \param order
+	 *      Index of the body at each sorted position.
+	 * \param n
+	 *      Number of bodies.
+	 * \param nodes
+	 *      Centers of mass, masses, boxes and cell-sizes of the nodes.
+	 * \param topology
+	 *      Children and ranges of the nodes.
+	 * \param eps
+	 *      Softening which is added to the square distance.
+	 * \param theta2
+	 *      Square of the opening angle.
+	 * \param fields
+	 *      Output-parameter: Field per body (ax, ay, az with the stride n, in the order of the bodies).
+	 * \param overflow
+	 *      Output-parameter: Set to 1 if the stack of a warp was too small (the fields are not complete).
+	 */
+	__global__ void traverseTree(const double* __restrict__ sorted, const int* __restrict__ order, int n,
+		const double* __restrict__ nodes, const int* __restrict__ topology, double eps, double theta2,
+		double* __restrict__ fields, int* overflow) {
+		__shared__ int stacks[WARPS_PER_BLOCK][STACK_SIZE];
+		__shared__ int lists[WARPS_PER_BLOCK][LIST_SIZE];
+
+		const unsigned int FULL = 0xffffffff;
+		int warp = threadIdx.x / WARP_SIZE;
+		int lane = threadIdx.x % WARP_SIZE;
+		int k = blockIdx.x * blockDim.x + threadIdx.x;
+		int groupFirst = k - lane;
+
+		// the whole warp leaves together, so the shuffles always have all lanes
+		if (groupFirst >= n) return;
+
+		int cntInner = n - 1;
+		int cntNodes = 2 * n - 1;
+		int groupCount = min(WARP_SIZE, n - groupFirst);
+		int body = min(k, n - 1);
+		double xi = sorted[body];
+		double yi = sorted[n + body];
+		double zi = sorted[2 * n + body];
+
+		// box of the group by the reductions over the lanes
+		double groupMin[3] = { xi, yi, zi };
+		double groupMax[3] = { xi, yi, zi };
+		for (int offset = WARP_SIZE / 2; offset > 0; offset /= 2) {
+			for (int c = 0; c < 3; ++c) {
+				groupMin[c] = fmin(groupMin[c], __shfl_xor_sync(FULL, groupMin[c], offset));
+				groupMax[c] = fmax(groupMax[c], __shfl_xor_sync(FULL, groupMax[c], offset));
+			}
+		}
+
+		int* stack = stacks[warp];
+		int* list = lists[warp];
+		int stackSize = 1;
+		int listSize = 0;
+		unsigned int lowerLanes = (1u << lane) - 1;
+		double fx = 0.0, fy = 0.0, fz = 0.0;
+
+		if (lane == 0) {
+			stack[0] = 0;
+		}
+		__syncwarp();
+
+		while (stackSize > 0) {
+			int cntPopped = min(stackSize, WARP_SIZE);
+			int node = lane < cntPopped ? stack[stackSize - 1 - lane] : -1;
+			stackSize -= cntPopped;
+			__syncwarp();
+
+			bool isOpened = false;
+			bool isAccepted = false;
+
+			if (node >= cntInner) {
+				// the bodies of the group are part of the list, they contribute nothing to themselves
+				isAccepted = nodes[MASS * cntNodes + node] > 0.0;
+			} else if (node >= 0) {
+				int first = topology[FIRST * cntNodes + node];
+				bool isAncestor = first < groupFirst + groupCount && groupFirst < first + topology[COUNT * cntNodes + node];
+
+				if (nodes[MASS * cntNodes + node] > 0.0 || isAncestor) {
+					// the closest position of the group decides
+					double r2 = 0.0;
+					bool isOverlapping = true;
+					for (int c = 0; c < 3; ++c) {
+						double com = nodes[(COM_X + c) * cntNodes + node];
+						double d = com - fmin(fmax(com, groupMin[c]), groupMax[c]);
+						r2 += d * d;
+						isOverlapping = isOverlapping && nodes[(MIN_X + c) * cntNodes + node] <= groupMax[c]
+							&& nodes[(MAX_X + c) * cntNodes + node] >= groupMin[c];
+					}
+
+					double size = nodes[CELL_SIZE * cntNodes + node];
+					isOpened = isAncestor || isOverlapping || size * size >= theta2 * r2;
+					isAccepted = !isOpened;
+				}
+			}
+
+			unsigned int openMask = __ballot_sync(FULL, isOpened);
+			unsigned int acceptMask = __ballot_sync(FULL, isAccepted);
+			int cntOpened = __popc(openMask);
+
+			if (stackSize + 2 * cntOpened > STACK_SIZE) {
+				if (lane == 0) {
+					atomicExch(overflow, 1);
+				}
+				return;
+			}
+
+			if (isOpened) {
+				int slot = stackSize + 2 * __popc(openMask & lowerLanes);
+				stack[slot] = topology[RIGHT * cntNodes + node];
+				stack[slot + 1] = topology[LEFT * cntNodes + node];
+			}
+			if (isAccepted) {
+				list[listSize + __popc(acceptMask & lowerLanes)] = node;
+			}
+			stackSize += 2 * cntOpened;
+			listSize += __popc(acceptMask);
+			__syncwarp();
+
+			if (listSize >= WARP_SIZE || stackSize == 0) {
+				evaluateList(list, listSize, nodes, cntNodes, eps, xi, yi, zi, fx, fy, fz);
+				listSize = 0;
+				__syncwarp();
+			}
+		}
+
+		if (k < n) {
+			int i = order[k];
+			fields[i] = fx;
+			fields[n + i] = fy;
+			fields[2 * n + i] = fz;
+		}
+	}
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Build the tree on the device-buffers (see GpuBarnesHut): bounding cube, Morton-codes, radix-sort,
+	 *        inner nodes and the bottom-up sums.
+	 *
+	 * \param bodies
+	 *      Positions and masses on the device (x, y, z, m with the stride n, n >= 2).
+	 * \param n
+	 *      Number of bodies.
+	 * \param sorted
+	 *      Output-parameter: Positions and masses in the sorted order on the device.
+	 * \param codes, order
+	 *      Output-parameter: Sorted codes and the index of the body at each sorted position on the device.
+	 * \param nodes, topology
+	 *      Output-parameter: Data and topology of the 2n - 1 nodes on the device.
+	 *
+	 * \return False if a kernel failed.
+	 */
+	bool launchTreeBuild(const double* bodies, int n, double* sorted, unsigned long long* codes, int* order,
+		double* nodes, int* topology) {
+		// bounding cube of all bodies (the same scale on all axes, so the prefixes are cubic octree-cells)
+		double bbMin[3];
+		double rootSize = 1e-9;
+		for (int c = 0; c < 3; ++c) {
+			thrust::device_ptr<const double> axis = thrust::device_pointer_cast(bodies + c * n);
+			thrust::pair<thrust::device_ptr<const double>, thrust::device_ptr<const double>> extrema =
+				thrust::minmax_element(thrust::cuda::par, axis, axis + n);
+
+			bbMin[c] = *extrema.first;
+			rootSize = fmax(rootSize, *extrema.second - bbMin[c]);
+		}
+		double scale = ((1 << BITS_PER_AXIS) - 1) / rootSize;
+
+		int cntBlocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		encodeBodies<<<cntBlocks, BLOCK_SIZE>>>(bodies, n, bbMin[0], bbMin[1], bbMin[2], scale, codes, order);
+
+		// equal codes keep their order, as with MortonCode::sort()
+		thrust::stable_sort_by_key(thrust::cuda::par, thrust::device_pointer_cast(codes), thrust::device_pointer_cast(codes + n),
+			thrust::device_pointer_cast(order));
+
+		gatherBodies<<<cntBlocks, BLOCK_SIZE>>>(bodies, order, n, sorted);
+		buildInnerNodes<<<(n - 1 + BLOCK_SIZE - 1) / BLOCK_SIZE, BLOCK_SIZE>>>(codes, n, topology);
+		sumBottomUp<<<cntBlocks, BLOCK_SIZE>>>(sorted, n, rootSize, nodes, topology);
+
+		return cudaGetLastError() == cudaSuccess;
+	}
+
+
+	/**
+	 * \brief Traverse the tree of launchTreeBuild() with one warp per group of 32 sorted bodies.
+	 *
+	 * \param sorted, order
+	 *      Sorted bodies and the index of the body at each sorted position on the device.
+	 * \param n
+	 *      Number of bodies.
+	 * \param nodes, topology
+	 *      Data and topology of the nodes on the device.
+	 * \param eps
+	 *      Softening which is added to the square distance.
+	 * \param theta
+	 *      Opening angle.
+	 * \param fields
+	 *      Output-parameter: Field per body on the device (ax, ay, az with the stride n).
+	 * \param overflow
+	 *      Output-parameter: Flag on the device which is set if a stack was too small.
+	 *
+	 * \return False if the kernel failed.
+	 */
+	bool launchTreeTraversal(const double* sorted, const int* order, int n, const double* nodes, const int* topology,
+		double eps, double theta, double* fields, int* overflow) {
+		int threads = WARPS_PER_BLOCK * WARP_SIZE;
+		int cntBlocks = (n + threads - 1) / threads;
+
+		cudaMemset(overflow, 0, sizeof(int));
+		traverseTree<<<cntBlocks, threads>>>(sorted, order, n, nodes, topology, eps, theta * theta, fields, overflow);
+
+		return cudaGetLastError() == cudaSuccess;
+	}
+}
@@ -0,0 +1,98 @@
+﻿/**
+ * \brief Implementation of the Barnes-Hut tree on the GPU (CUDA).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+
+namespace pbs17 {
+
+	/**
+	 * \brief Barnes-Hut gravity on the GPU for the scenes which are too large for the all-pairs sum: the tree is the
+	 * same linear radix-tree as the BarnesHutTree, but built on the device (bounding cube by a reduction, Morton-codes,
+	 * radix-sort of thrust, the inner nodes independently per thread and the sums bottom-up with atomic visits).
+	 * It's traversed by warps: the 32 consecutive bodies of the sorted order are a group (see
+	 * BarnesHutTree::computeFieldsGrouped()), whose lanes decide on up to 32 nodes at once against the box of the
+	 * group and evaluate the accepted nodes as a shared interaction-list. The device-buffers are kept between the
+	 * steps, the masses are only uploaded when they change and only the fields are copied back.
+	 *
+	 * Without CUDA (cmake -DPBS17_CUDA=OFF), nothing is calculated (see GpuGravity::isAvailable()).
+	 */
+	class GpuBarnesHut {
+	public:
+		/**
+		 * \brief Constructor of the GPU-tree (the device-buffers are allocated on the first call).
+		 */
+		GpuBarnesHut() = default;
+
+
+		/**
+		 * \brief Destructor of the GPU-tree (frees the device-buffers).
+		 */
+		~GpuBarnesHut();
+
+
+		/**
+		 * \brief Calculate the softened field a_i = sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) for all bodies, where
+		 *        the far away cells are approximated by their center of mass.
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param theta
+		 *      Opening angle (cell-size / distance) up to which a cell is approximated.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 *
+		 * \return False if the GPU is not available or failed (the fields are not calculated).
+		 */
+		bool computeFields(const double* x, const double* y, const double* z, const double* m, int n, double eps, double theta,
+			double* ax, double* ay, double* az);
+
+
+	private:
+		//! Positions and masses on the device (x, y, z, m with the stride of the number of bodies)
+		double* _deviceBodies = nullptr;
+		//! Positions and masses in the order of the Morton-codes on the device
+		double* _deviceSorted = nullptr;
+		//! Sorted Morton-codes on the device
+		unsigned long long* _deviceCodes = nullptr;
+		//! Index of the body at each sorted position on the device
+		int* _deviceOrder = nullptr;
+		//! Centers of mass, masses, boxes and cell-sizes of the nodes on the device
+		double* _deviceNodes = nullptr;
+		//! Children, parents, ranges, levels and visits of the nodes on the device
+		int* _deviceTopology = nullptr;
+		//! Fields of all bodies on the device (ax, ay, az with the stride of the number of bodies)
+		double* _deviceFields = nullptr;
+		//! Flag of an overflowing stack of the traversal on the device
+		int* _deviceOverflow = nullptr;
+		//! Number of bodies which fit into the device-buffers
+		int _capacity = 0;
+
+		//! Masses of the last upload (the masses rarely change)
+		std::vector<double> _uploadedMasses;
+		//! Fields copied back from the device
+		std::vector<double> _fields;
+
+
+		/**
+		 * \brief Free the device-buffers.
+		 */
+		void release();
+
+
+		//! Copying would free the device-buffers twice
+		GpuBarnesHut(GpuBarnesHut const&) = delete;
+		GpuBarnesHut& operator=(GpuBarnesHut const&) = delete;
+	};
+}
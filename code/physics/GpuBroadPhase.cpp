@@ -0,0 +1,179 @@
+﻿/**
+ * \brief Implementation of the single-axis sweep-and-prune on the GPU (CUDA).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "GpuBroadPhase.h"
+#include "GpuGravity.h"
+#include "Logger.h"
+
+#include <algorithm>
+
+#if defined(PBS17_CUDA)
+#include <cuda_runtime_api.h>
+
+namespace pbs17 {
+	// defined in GpuBroadPhase.cu
+	bool launchBroadPhaseSort(const float* aabbs, int n, int sweepAxis, float* keys, int* order);
+	bool launchBroadPhaseSweep(const float* aabbs, int n, int sweepAxis, const float* keys, const int* order,
+		unsigned long long* pairs, unsigned int capacity, unsigned int* counters);
+	bool launchBroadPhaseCompact(unsigned long long* pairs, unsigned int cntPairs);
+}
+#endif
+
+using namespace pbs17;
+
+
+//! A dense field has a few contacts per object, the buffer grows for denser ones.
+const unsigned int GpuBroadPhase::PAIRS_PER_OBJECT = 4;
+
+
+/**
+ * \brief Destructor of the GPU-broad-phase (frees the device-buffers).
+ */
+GpuBroadPhase::~GpuBroadPhase() {
+	release();
+}
+
+
+/**
+ * \brief Check if CUDA is compiled in and a device is present.
+ *
+ * \return True if the pairs can be found on the GPU.
+ */
+bool GpuBroadPhase::isAvailable() {
+	return GpuGravity::isAvailable();
+}
+
+
+/**
+ * \brief Find the pairs of overlapping AABBs.
+ *
+ * \param aabbMin, aabbMax
+ *      Min- and max-edges of the AABBs per axis (x, y, z of all objects).
+ * \param n
+ *      Number of objects.
+ * \param sweepAxis
+ *      Axis along which the objects are sorted (e.g. the axis of the largest variance).
+ * \param pairs
+ *      Output-parameter: Overlapping pairs, the smaller index in the upper 32 bits (sorted, overwritten).
+ * \param cntSweepOverlaps
+ *      Output-parameter: Number of pairs which overlap on the sweep-axis.
+ *
+ * \return False if the GPU is not available or failed (the pairs are not found).
+ */
+bool GpuBroadPhase::findPairs(const float* const aabbMin[3], const float* const aabbMax[3], int n, int sweepAxis,
+	std::vector<uint64_t> &pairs, unsigned int &cntSweepOverlaps) {
+#if defined(PBS17_CUDA)
+	pairs.clear();
+	cntSweepOverlaps = 0;
+	if (n < 2) {
+		return true;
+	}
+
+	// the buffers only grow, so a changing number of objects does not reallocate each step
+	if (n > _capacity) {
+		release();
+		_capacity = n;
+
+		if (cudaMalloc(reinterpret_cast<void**>(&_deviceAabbs), 6 * sizeof(float) * _capacity) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceKeys), sizeof(float) * _capacity) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceOrder), sizeof(int) * _capacity) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceCounters), 2 * sizeof(unsigned int)) != cudaSuccess
+			|| !reservePairs(PAIRS_PER_OBJECT * n)) {
+			LOG_WARNING("The device-buffers for " << n << " objects can't be allocated on the GPU!");
+			release();
+			return false;
+		}
+	}
+
+	bool isOk = true;
+	for (int axis = 0; axis < 3 && isOk; ++axis) {
+		isOk = cudaMemcpy(_deviceAabbs + axis * n, aabbMin[axis], sizeof(float) * n, cudaMemcpyHostToDevice) == cudaSuccess
+			&& cudaMemcpy(_deviceAabbs + (3 + axis) * n, aabbMax[axis], sizeof(float) * n, cudaMemcpyHostToDevice) == cudaSuccess;
+	}
+
+	unsigned int counters[2] = { 0, 0 };
+	isOk = isOk && launchBroadPhaseSort(_deviceAabbs, n, sweepAxis, _deviceKeys, _deviceOrder)
+		&& launchBroadPhaseSweep(_deviceAabbs, n, sweepAxis, _deviceKeys, _deviceOrder, _devicePairs, _pairCapacity, _deviceCounters)
+		&& cudaMemcpy(counters, _deviceCounters, 2 * sizeof(unsigned int), cudaMemcpyDeviceToHost) == cudaSuccess;
+
+	// the list was too short => swept again with a buffer which fits all pairs (the sorted order is kept)
+	if (isOk && counters[0] > _pairCapacity) {
+		isOk = reservePairs(counters[0])
+			&& launchBroadPhaseSweep(_deviceAabbs, n, sweepAxis, _deviceKeys, _deviceOrder, _devicePairs, _pairCapacity, _deviceCounters)
+			&& cudaMemcpy(counters, _deviceCounters, 2 * sizeof(unsigned int), cudaMemcpyDeviceToHost) == cudaSuccess;
+	}
+
+	if (isOk && counters[0] > 0) {
+		pairs.resize(counters[0]);
+		isOk = launchBroadPhaseCompact(_devicePairs, counters[0])
+			&& cudaMemcpy(pairs.data(), _devicePairs, sizeof(uint64_t) * counters[0], cudaMemcpyDeviceToHost) == cudaSuccess;
+	}
+
+	if (!isOk) {
+		pairs.clear();
+		LOG_WARNING("The broad-phase failed on the GPU: " << cudaGetErrorString(cudaGetLastError()));
+		return false;
+	}
+
+	cntSweepOverlaps = counters[1];
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * \brief Grow the buffer of the pairs.
+ *
+ * \param cntPairs
+ *      Number of pairs which have to fit.
+ *
+ * \return False if the buffer can't be allocated.
+ */
+bool GpuBroadPhase::reservePairs(unsigned int cntPairs) {
+#if defined(PBS17_CUDA)
+	if (cntPairs <= _pairCapacity && _devicePairs) {
+		return true;
+	}
+
+	// a quarter more, so a slowly growing number of contacts does not reallocate each step
+	cudaFree(_devicePairs);
+	_pairCapacity = std::max(cntPairs + cntPairs / 4, 1u);
+	if (cudaMalloc(reinterpret_cast<void**>(&_devicePairs), sizeof(unsigned long long) * _pairCapacity) != cudaSuccess) {
+		_devicePairs = nullptr;
+		_pairCapacity = 0;
+		return false;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * \brief Free the device-buffers.
+ */
+void GpuBroadPhase::release() {
+#if defined(PBS17_CUDA)
+	cudaFree(_deviceAabbs);
+	cudaFree(_deviceKeys);
+	cudaFree(_deviceOrder);
+	cudaFree(_devicePairs);
+	cudaFree(_deviceCounters);
+#endif
+
+	_deviceAabbs = nullptr;
+	_deviceKeys = nullptr;
+	_deviceOrder = nullptr;
+	_devicePairs = nullptr;
+	_deviceCounters = nullptr;
+	_capacity = 0;
+	_pairCapacity = 0;
+}
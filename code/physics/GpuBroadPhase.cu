@@ -0,0 +1,176 @@
+﻿/**
+ * \brief Implementation of the sort and the sweep of the broad-phase on the GPU (compiled with -DPBS17_CUDA=ON).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include <cuda_runtime.h>
+#include <thrust/device_ptr.h>
+#include <thrust/sort.h>
+#include <thrust/system/cuda/execution_policy.h>
+
+
+namespace {
+
+	//! Threads per block
+	const int BLOCK_SIZE = 256;
+
+
+	/**
+	 * \brief Min-edges on the sweep-axis as the keys of the sort, the identity as the order.
+	 *
+	 * \param aabbs
+	 *      AABBs (min x, y, z, max x, y, z with the stride n).
+	 * \param n
+	 *      Number of objects.
+	 * \param sweepAxis
+	 *      Axis along which the objects are sorted.
+	 * \param keys
+	 *      Output-parameter: Min-edge per object.
+	 * \param order
+	 *      Output-parameter: Index per object.
+	 */
+	__global__ void sweepKeys(const float* __restrict__ aabbs, int n, int sweepAxis, float* __restrict__ keys, int* __restrict__ order) {
+		int i = blockIdx.x * blockDim.x + threadIdx.x;
+		if (i < n) {
+			keys[i] = aabbs[sweepAxis * n + i];
+			order[i] = i;
+		}
+	}
+
+
+	/**
+	 * \brief Sweep: each thread tests its object against the following ones in the sorted order until their min-edge
+	 *        is greater than its max-edge, the overlapping pairs are appended to the list (as long as it has room).
+	 *
+	 * \param aabbs
+	 *      AABBs (min x, y, z, max x, y, z with the stride n).
+	 * \param n
+	 *      Number of objects.
+	 * \param sweepAxis
+	 *      Axis along which the objects are sorted.
+	 * \param keys
+	 *      Sorted min-edges on the sweep-axis.
+	 * \param order
+	 *      Objects in the sorted order.
+	 * \param pairs
+	 *      Output-parameter: Overlapping pairs (the smaller index in the upper 32 bits).
+	 * \param capacity
+	 *      Number of pairs which fit into the list.
+	 * \param counters
+	 *      Output-parameter: Number of the pairs (also the ones which did not fit) and of the overlaps on the sweep-axis.
+	 */
+	__global__ void sweepPairs(const float* __restrict__ aabbs, int n, int sweepAxis, const float* __restrict__ keys,
+		const int* __restrict__ order, unsigned long long* __restrict__ pairs, unsigned int capacity, unsigned int* counters) {
+		int i = blockIdx.x * blockDim.x + threadIdx.x;
+		if (i >= n - 1) return;
+
+		int axis1 = (sweepAxis + 1) % 3;
+		int axis2 = (sweepAxis + 2) % 3;
+		const float* aabbMax = aabbs + 3 * n;
+
+		int a = order[i];
+		float sweepMax = aabbMax[sweepAxis * n + a];
+		float min1 = aabbs[axis1 * n + a], max1 = aabbMax[axis1 * n + a];
+		float min2 = aabbs[axis2 * n + a], max2 = aabbMax[axis2 * n + a];
+		unsigned int cntSweepOverlaps = 0;
+
+		for (int j = i + 1; j < n; ++j) {
+			// as soon as the min-edge of the neighbour is greater, no later object can overlap
+			if (keys[j] > sweepMax) break;
+			++cntSweepOverlaps;
+
+			int b = order[j];
+			if (max1 >= aabbs[axis1 * n + b] && aabbMax[axis1 * n + b] >= min1 && max2 >= aabbs[axis2 * n + b] && aabbMax[axis2 * n + b] >= min2) {
+				unsigned int slot = atomicAdd(&counters[0], 1u);
+				if (slot < capacity) {
+					unsigned long long first = static_cast<unsigned long long>(min(a, b));
+					pairs[slot] = (first << 32) | static_cast<unsigned long long>(max(a, b));
+				}
+			}
+		}
+
+		atomicAdd(&counters[1], cntSweepOverlaps);
+	}
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Radix-sort the objects by their min-edge on the sweep-axis (see GpuBroadPhase).
+	 *
+	 * \param aabbs
+	 *      AABBs on the device (min x, y, z, max x, y, z with the stride n).
+	 * \param n
+	 *      Number of objects.
+	 * \param sweepAxis
+	 *      Axis along which the objects are sorted.
+	 * \param keys
+	 *      Output-parameter: Sorted min-edges on the device.
+	 * \param order
+	 *      Output-parameter: Objects in the sorted order on the device.
+	 *
+	 * \return False if a kernel failed.
+	 */
+	bool launchBroadPhaseSort(const float* aabbs, int n, int sweepAxis, float* keys, int* order) {
+		int cntBlocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		sweepKeys<<<cntBlocks, BLOCK_SIZE>>>(aabbs, n, sweepAxis, keys, order);
+		if (cudaGetLastError() != cudaSuccess) return false;
+
+		// the float-keys are sorted by the radix-sort of thrust
+		thrust::sort_by_key(thrust::cuda::par, thrust::device_pointer_cast(keys), thrust::device_pointer_cast(keys + n),
+			thrust::device_pointer_cast(order));
+
+		return cudaGetLastError() == cudaSuccess;
+	}
+
+
+	/**
+	 * \brief Sweep the sorted objects and append the overlapping pairs (see GpuBroadPhase).
+	 *
+	 * \param aabbs
+	 *      AABBs on the device (min x, y, z, max x, y, z with the stride n).
+	 * \param n
+	 *      Number of objects.
+	 * \param sweepAxis
+	 *      Axis along which the objects are sorted.
+	 * \param keys, order
+	 *      Sorted min-edges and objects on the device.
+	 * \param pairs
+	 *      Output-parameter: Overlapping pairs on the device.
+	 * \param capacity
+	 *      Number of pairs which fit into the list.
+	 * \param counters
+	 *      Output-parameter: Number of the pairs and of the overlaps on the sweep-axis on the device (reset first).
+	 *
+	 * \return False if the kernel failed.
+	 */
+	bool launchBroadPhaseSweep(const float* aabbs, int n, int sweepAxis, const float* keys, const int* order,
+		unsigned long long* pairs, unsigned int capacity, unsigned int* counters) {
+		if (cudaMemset(counters, 0, 2 * sizeof(unsigned int)) != cudaSuccess) return false;
+
+		int cntBlocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		sweepPairs<<<cntBlocks, BLOCK_SIZE>>>(aabbs, n, sweepAxis, keys, order, pairs, capacity, counters);
+
+		return cudaGetLastError() == cudaSuccess;
+	}
+
+
+	/**
+	 * \brief Sort the appended pairs, so their order does not depend on the scheduling of the threads.
+	 *
+	 * \param pairs
+	 *      Overlapping pairs on the device.
+	 * \param cntPairs
+	 *      Number of pairs.
+	 *
+	 * \return False if the sort failed.
+	 */
+	bool launchBroadPhaseCompact(unsigned long long* pairs, unsigned int cntPairs) {
+		thrust::sort(thrust::cuda::par, thrust::device_pointer_cast(pairs), thrust::device_pointer_cast(pairs + cntPairs));
+
+		return cudaGetLastError() == cudaSuccess;
+	}
+}
@@ -0,0 +1,106 @@
+﻿/**
+ * \brief Implementation of the single-axis sweep-and-prune on the GPU (CUDA).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+namespace pbs17 {
+
+	/**
+	 * \brief Broad-phase of the single-axis sweep-and-prune on the GPU: The AABBs are uploaded, the min-edges on the
+	 * sweep-axis are radix-sorted on the device (thrust), and each thread sweeps the sorted objects after its own
+	 * one with the full AABB-test. The overlapping pairs are appended to a compact list (atomic counter), which is
+	 * sorted on the device for a deterministic order, so only the pairs are copied back (not the sorted order).
+	 * The device-buffers are kept between the steps and only grow.
+	 *
+	 * Without CUDA (cmake -DPBS17_CUDA=OFF), isAvailable() is false and nothing is calculated.
+	 */
+	class GpuBroadPhase {
+	public:
+		/**
+		 * \brief Constructor of the GPU-broad-phase (the device-buffers are allocated on the first call).
+		 */
+		GpuBroadPhase() = default;
+
+
+		/**
+		 * \brief Destructor of the GPU-broad-phase (frees the device-buffers).
+		 */
+		~GpuBroadPhase();
+
+
+		/**
+		 * \brief Check if CUDA is compiled in and a device is present.
+		 *
+		 * \return True if the pairs can be found on the GPU.
+		 */
+		static bool isAvailable();
+
+
+		/**
+		 * \brief Find the pairs of overlapping AABBs.
+		 *
+		 * \param aabbMin, aabbMax
+		 *      Min- and max-edges of the AABBs per axis (x, y, z of all objects).
+		 * \param n
+		 *      Number of objects.
+		 * \param sweepAxis
+		 *      Axis along which the objects are sorted (e.g. the axis of the largest variance).
+		 * \param pairs
+		 *      Output-parameter: Overlapping pairs, the smaller index in the upper 32 bits (sorted, overwritten).
+		 * \param cntSweepOverlaps
+		 *      Output-parameter: Number of pairs which overlap on the sweep-axis.
+		 *
+		 * \return False if the GPU is not available or failed (the pairs are not found).
+		 */
+		bool findPairs(const float* const aabbMin[3], const float* const aabbMax[3], int n, int sweepAxis,
+			std::vector<uint64_t> &pairs, unsigned int &cntSweepOverlaps);
+
+
+	private:
+		//! Number of pairs per object which the pair-buffer has initially
+		static const unsigned int PAIRS_PER_OBJECT;
+
+		//! AABBs on the device (min x, y, z, max x, y, z with the stride of the number of objects)
+		float* _deviceAabbs = nullptr;
+		//! Sorted min-edges on the sweep-axis on the device
+		float* _deviceKeys = nullptr;
+		//! Objects in the sorted order on the device
+		int* _deviceOrder = nullptr;
+		//! Overlapping pairs on the device
+		unsigned long long* _devicePairs = nullptr;
+		//! Number of pairs and of overlaps on the sweep-axis on the device
+		unsigned int* _deviceCounters = nullptr;
+		//! Number of objects and pairs which fit into the device-buffers
+		int _capacity = 0;
+		unsigned int _pairCapacity = 0;
+
+
+		/**
+		 * \brief Grow the buffer of the pairs.
+		 *
+		 * \param cntPairs
+		 *      Number of pairs which have to fit.
+		 *
+		 * \return False if the buffer can't be allocated.
+		 */
+		bool reservePairs(unsigned int cntPairs);
+
+
+		/**
+		 * \brief Free the device-buffers.
+		 */
+		void release();
+
+
+		//! Copying would free the device-buffers twice
+		GpuBroadPhase(GpuBroadPhase const&) = delete;
+		GpuBroadPhase& operator=(GpuBroadPhase const&) = delete;
+	};
+}
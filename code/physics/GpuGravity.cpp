@@ -0,0 +1,224 @@
+﻿/**
+ * \brief Implementation of the direct-sum gravity on the GPU (CUDA).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-09
+ */
+
+#include "GpuGravity.h"
+#include "Logger.h"
+
+#include <iostream>
+#include <algorithm>
+
+#if defined(PBS17_CUDA)
+#include <cuda_runtime_api.h>
+
+namespace pbs17 {
+	// defined in GpuGravity.cu
+	bool launchGravityTiles(const double* bodies, int n, double eps, const int* targets, int cntTargets, double* fields);
+}
+#endif
+
+using namespace pbs17;
+
+
+/**
+ * \brief Destructor of the GPU-gravity (frees the device-buffers).
+ */
+GpuGravity::~GpuGravity() {
+	release();
+}
+
+
+/**
+ * \brief Check if CUDA is compiled in and a device is present.
+ *
+ * \return True if the fields can be calculated on the GPU.
+ */
+bool GpuGravity::isAvailable() {
+#if defined(PBS17_CUDA)
+	int cntDevices = 0;
+	return cudaGetDeviceCount(&cntDevices) == cudaSuccess && cntDevices > 0;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * \brief Get the name of the used device (e.g. for the reports of the benchmarks).
+ *
+ * \return Name of the device ("none" without a device).
+ */
+std::string GpuGravity::getDeviceName() {
+#if defined(PBS17_CUDA)
+	int device = 0;
+	cudaDeviceProp properties;
+	if (isAvailable() && cudaGetDevice(&device) == cudaSuccess && cudaGetDeviceProperties(&properties, device) == cudaSuccess) {
+		return properties.name;
+	}
+#endif
+
+	return "none";
+}
+
+
+/**
+ * \brief Calculate the softened field a_i = sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) for all bodies
+ *        (see GravityKernel::computeFields()).
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ *
+ * \return False if the GPU is not available or failed (the fields are not calculated).
+ */
+bool GpuGravity::computeFields(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	double* ax, double* ay, double* az) {
+	if (!run(x, y, z, m, n, eps, nullptr, n)) {
+		return false;
+	}
+
+	std::copy(_fields.begin(), _fields.begin() + n, ax);
+	std::copy(_fields.begin() + n, _fields.begin() + 2 * n, ay);
+	std::copy(_fields.begin() + 2 * n, _fields.begin() + 3 * n, az);
+
+	return true;
+}
+
+
+/**
+ * \brief Same as computeFields(), but the field is only calculated and copied back for the given bodies.
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param targets
+ *      Indices of the bodies for which the field is calculated.
+ * \param cntTargets
+ *      Number of targets.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (only the targets are overwritten).
+ *
+ * \return False if the GPU is not available or failed (the fields are not calculated).
+ */
+bool GpuGravity::computeFieldsSubset(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az) {
+	if (!run(x, y, z, m, n, eps, targets, cntTargets)) {
+		return false;
+	}
+
+	for (int k = 0; k < cntTargets; ++k) {
+		ax[targets[k]] = _fields[k];
+		ay[targets[k]] = _fields[cntTargets + k];
+		az[targets[k]] = _fields[2 * cntTargets + k];
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Upload the positions (and the changed masses) and calculate the fields of the targets.
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param targets
+ *      Indices of the targets (nullptr => all bodies).
+ * \param cntTargets
+ *      Number of targets.
+ *
+ * \return False if the GPU failed.
+ */
+bool GpuGravity::run(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	const int* targets, int cntTargets) {
+#if defined(PBS17_CUDA)
+	if (n <= 0 || cntTargets <= 0) {
+		_fields.clear();
+		return true;
+	}
+
+	// the buffers only grow, so a changing number of bodies does not reallocate each step
+	bool isResized = false;
+	if (n > _capacity || cntTargets > _targetCapacity) {
+		release();
+		_capacity = std::max(n, _capacity);
+		_targetCapacity = std::max(std::max(cntTargets, n), _targetCapacity);
+
+		if (cudaMalloc(reinterpret_cast<void**>(&_deviceBodies), 4 * sizeof(double) * _capacity) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceFields), 3 * sizeof(double) * _targetCapacity) != cudaSuccess
+			|| cudaMalloc(reinterpret_cast<void**>(&_deviceTargets), sizeof(int) * _targetCapacity) != cudaSuccess) {
+			LOG_WARNING("The device-buffers for " << n << " bodies can't be allocated on the GPU!");
+			release();
+			return false;
+		}
+		isResized = true;
+	}
+
+	bool isOk = cudaMemcpy(_deviceBodies, x, sizeof(double) * n, cudaMemcpyHostToDevice) == cudaSuccess
+		&& cudaMemcpy(_deviceBodies + n, y, sizeof(double) * n, cudaMemcpyHostToDevice) == cudaSuccess
+		&& cudaMemcpy(_deviceBodies + 2 * n, z, sizeof(double) * n, cudaMemcpyHostToDevice) == cudaSuccess;
+
+	// the masses are at the offset 3 * n, so they are uploaded again if the number of bodies changes
+	if (isOk && (isResized || _uploadedMasses.size() != static_cast<unsigned int>(n) || !std::equal(m, m + n, _uploadedMasses.begin()))) {
+		isOk = cudaMemcpy(_deviceBodies + 3 * n, m, sizeof(double) * n, cudaMemcpyHostToDevice) == cudaSuccess;
+		_uploadedMasses.assign(m, m + n);
+	}
+
+	if (isOk && targets) {
+		isOk = cudaMemcpy(_deviceTargets, targets, sizeof(int) * cntTargets, cudaMemcpyHostToDevice) == cudaSuccess;
+	}
+
+	_fields.resize(3 * cntTargets);
+	isOk = isOk && launchGravityTiles(_deviceBodies, n, eps, targets ? _deviceTargets : nullptr, cntTargets, _deviceFields)
+		&& cudaMemcpy(_fields.data(), _deviceFields, 3 * sizeof(double) * cntTargets, cudaMemcpyDeviceToHost) == cudaSuccess;
+
+	if (!isOk) {
+		// the masses are uploaded again by the next call
+		_uploadedMasses.clear();
+		LOG_WARNING("The gravity-kernel failed on the GPU: " << cudaGetErrorString(cudaGetLastError()));
+	}
+
+	return isOk;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * \brief Free the device-buffers.
+ */
+void GpuGravity::release() {
+#if defined(PBS17_CUDA)
+	cudaFree(_deviceBodies);
+	cudaFree(_deviceFields);
+	cudaFree(_deviceTargets);
+#endif
+
+	_deviceBodies = nullptr;
+	_deviceFields = nullptr;
+	_deviceTargets = nullptr;
+	_capacity = 0;
+	_targetCapacity = 0;
+	_uploadedMasses.clear();
+}
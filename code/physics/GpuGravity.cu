@@ -0,0 +1,112 @@
+﻿/**
+ * \brief Implementation of the tiled all-pairs gravity kernel of the GPU (compiled with -DPBS17_CUDA=ON).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-09
+ */
+
+#include <cuda_runtime.h>
+
+
+namespace {
+
+	//! Threads per block, also the number of bodies of a tile in shared memory
+	const int BLOCK_SIZE = 256;
+
+
+	/**
+	 * \brief Field of the targets: each block loads the sources tile by tile into shared memory, each thread
+	 *        sums the field of its target over the tile.
+	 *
+	 * \param bodies
+	 *      Positions and masses (x, y, z, m with the stride n).
+	 * \param n
+	 *      Number of bodies.
+	 * \param eps
+	 *      Softening which is added to the square distance.
+	 * \param targets
+	 *      Indices of the targets (nullptr => all bodies).
+	 * \param cntTargets
+	 *      Number of targets.
+	 * \param fields
+	 *      Output-parameter: Field per target (ax, ay, az with the stride cntTargets).
+	 */
+	__global__ void gravityTiles(const double* __restrict__ bodies, int n, double eps, const int* __restrict__ targets,
+		int cntTargets, double* __restrict__ fields) {
+		__shared__ double tileX[BLOCK_SIZE];
+		__shared__ double tileY[BLOCK_SIZE];
+		__shared__ double tileZ[BLOCK_SIZE];
+		__shared__ double tileM[BLOCK_SIZE];
+
+		const double* x = bodies;
+		const double* y = bodies + n;
+		const double* z = bodies + 2 * n;
+		const double* m = bodies + 3 * n;
+
+		int k = blockIdx.x * blockDim.x + threadIdx.x;
+		int i = k < cntTargets ? (targets ? targets[k] : k) : 0;
+		double xi = x[i];
+		double yi = y[i];
+		double zi = z[i];
+		double fx = 0.0, fy = 0.0, fz = 0.0;
+
+		for (int start = 0; start < n; start += BLOCK_SIZE) {
+			// the padding of the last tile has no mass
+			int j = start + threadIdx.x;
+			tileX[threadIdx.x] = j < n ? x[j] : 0.0;
+			tileY[threadIdx.x] = j < n ? y[j] : 0.0;
+			tileZ[threadIdx.x] = j < n ? z[j] : 0.0;
+			tileM[threadIdx.x] = j < n ? m[j] : 0.0;
+			__syncthreads();
+
+#pragma unroll 8
+			for (int t = 0; t < BLOCK_SIZE; ++t) {
+				double dx = tileX[t] - xi;
+				double dy = tileY[t] - yi;
+				double dz = tileZ[t] - zi;
+				double invDist = rsqrt(dx * dx + dy * dy + dz * dz + eps);
+				double s = tileM[t] * invDist * invDist * invDist;
+
+				fx += s * dx;
+				fy += s * dy;
+				fz += s * dz;
+			}
+			__syncthreads();
+		}
+
+		if (k < cntTargets) {
+			fields[k] = fx;
+			fields[cntTargets + k] = fy;
+			fields[2 * cntTargets + k] = fz;
+		}
+	}
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Launch the tiled gravity kernel on the device-buffers (see GpuGravity).
+	 *
+	 * \param bodies
+	 *      Positions and masses on the device (x, y, z, m with the stride n).
+	 * \param n
+	 *      Number of bodies.
+	 * \param eps
+	 *      Softening which is added to the square distance.
+	 * \param targets
+	 *      Indices of the targets on the device (nullptr => all bodies).
+	 * \param cntTargets
+	 *      Number of targets.
+	 * \param fields
+	 *      Output-parameter: Field per target on the device (ax, ay, az with the stride cntTargets).
+	 *
+	 * \return False if the kernel failed.
+	 */
+	bool launchGravityTiles(const double* bodies, int n, double eps, const int* targets, int cntTargets, double* fields) {
+		int cntBlocks = (cntTargets + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		gravityTiles<<<cntBlocks, BLOCK_SIZE>>>(bodies, n, eps, targets, cntTargets, fields);
+
+		return cudaGetLastError() == cudaSuccess;
+	}
+}
@@ -0,0 +1,147 @@
+﻿/**
+ * \brief Implementation of the direct-sum gravity on the GPU (CUDA).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-09
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace pbs17 {
+
+	/**
+	 * \brief All-pairs gravity on the GPU: a tiled kernel where each block stages the bodies in shared memory and
+	 * each thread accumulates the field of one body (same softened field as GravityKernel, in double precision).
+	 * The device-buffers are kept between the steps, the masses are only uploaded when they change and
+	 * only the fields of the requested bodies are copied back.
+	 *
+	 * Without CUDA (cmake -DPBS17_CUDA=OFF), isAvailable() is false and nothing is calculated.
+	 */
+	class GpuGravity {
+	public:
+		/**
+		 * \brief Constructor of the GPU-gravity (the device-buffers are allocated on the first call).
+		 */
+		GpuGravity() = default;
+
+
+		/**
+		 * \brief Destructor of the GPU-gravity (frees the device-buffers).
+		 */
+		~GpuGravity();
+
+
+		/**
+		 * \brief Check if CUDA is compiled in and a device is present.
+		 *
+		 * \return True if the fields can be calculated on the GPU.
+		 */
+		static bool isAvailable();
+
+
+		/**
+		 * \brief Get the name of the used device (e.g. for the reports of the benchmarks).
+		 *
+		 * \return Name of the device ("none" without a device).
+		 */
+		static std::string getDeviceName();
+
+
+		/**
+		 * \brief Calculate the softened field a_i = sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) for all bodies
+		 *        (see GravityKernel::computeFields()).
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 *
+		 * \return False if the GPU is not available or failed (the fields are not calculated).
+		 */
+		bool computeFields(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			double* ax, double* ay, double* az);
+
+
+		/**
+		 * \brief Same as computeFields(), but the field is only calculated and copied back for the given bodies.
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param targets
+		 *      Indices of the bodies for which the field is calculated.
+		 * \param cntTargets
+		 *      Number of targets.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (only the targets are overwritten).
+		 *
+		 * \return False if the GPU is not available or failed (the fields are not calculated).
+		 */
+		bool computeFieldsSubset(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			const int* targets, int cntTargets, double* ax, double* ay, double* az);
+
+
+	private:
+		//! Positions and masses on the device (x, y, z, m with the stride of the number of bodies)
+		double* _deviceBodies = nullptr;
+		//! Fields of the targets on the device (ax, ay, az with the stride of the number of targets)
+		double* _deviceFields = nullptr;
+		//! Indices of the targets on the device
+		int* _deviceTargets = nullptr;
+		//! Number of bodies and targets which fit into the device-buffers
+		int _capacity = 0;
+		int _targetCapacity = 0;
+
+		//! Masses of the last upload (the masses rarely change)
+		std::vector<double> _uploadedMasses;
+		//! Fields of the targets copied back from the device
+		std::vector<double> _fields;
+
+
+		/**
+		 * \brief Upload the positions (and the changed masses) and calculate the fields of the targets.
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param targets
+		 *      Indices of the targets (nullptr => all bodies).
+		 * \param cntTargets
+		 *      Number of targets.
+		 *
+		 * \return False if the GPU failed.
+		 */
+		bool run(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			const int* targets, int cntTargets);
+
+
+		/**
+		 * \brief Free the device-buffers.
+		 */
+		void release();
+
+
+		//! Copying would free the device-buffers twice
+		GpuGravity(GpuGravity const&) = delete;
+		GpuGravity& operator=(GpuGravity const&) = delete;
+	};
+}
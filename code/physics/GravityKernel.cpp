@@ -0,0 +1,1139 @@
+﻿/**
+ * \brief Implementation of the vectorized all-pairs gravity kernel.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#include "GravityKernel.h"
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "BodyState.h"
+#include "Tracer.h"
+
+// The vectorized kernels are compiled with function-specific target-attributes and
+// selected at runtime, so the rest of the project does not need any special compiler-flags.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PBS17_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+using namespace pbs17;
+
+//! Bound of the relative error of computeFieldsMixed() (single precision pairs, relative positions)
+const double GravityKernel::MIXED_ERROR_BOUND = 1e-4;
+
+
+//! Target policy: The field is calculated for all bodies (target k is body k)
+struct GravityKernel::AllTargets {
+	static const bool IS_PARALLEL = true;
+
+	static inline int get(const int* /*targets*/, int k) {
+		return k;
+	}
+};
+
+
+//! Target policy: The field is calculated for the listed bodies (target k is body targets[k])
+struct GravityKernel::SubsetTargets {
+	static const bool IS_PARALLEL = true;
+
+	static inline int get(const int* targets, int k) {
+		return targets[k];
+	}
+};
+
+
+//! Target policy: Same as SubsetTargets, but on the calling thread
+struct GravityKernel::ListTargets {
+	static const bool IS_PARALLEL = false;
+
+	static inline int get(const int* targets, int k) {
+		return targets[k];
+	}
+};
+
+
+/**
+ * \brief Calculate the softened field a_i = sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) for all bodies.
+ *        Multiplied by G and the mass of the body, this is the gravitational force on the body.
+ *        The pair i == j does not contribute, since its distance is zero.
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ */
+void GravityKernel::computeFields(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	double* ax, double* ay, double* az) {
+	static const KernelFunction kernel = selectKernel<AllTargets>();
+
+	kernel(x, y, z, m, n, eps, nullptr, n, ax, ay, az);
+}
+
+
+/**
+ * \brief Same as computeFields(), but each unordered pair is only evaluated once and applied
+ *        to both bodies (Newton's third law). The pairs are processed in tiles, each thread
+ *        accumulates into its own buffer and the buffers are reduced at the end.
+ *        In the deterministic mode, the tiles are assigned to a fixed number of buffers instead of
+ *        the threads, so the order of the summation does not depend on the number of threads.
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ * \param isDeterministic
+ *      True to get bitwise the same result with any number of threads.
+ */
+void GravityKernel::computeFieldsSymmetric(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	double* ax, double* ay, double* az, bool isDeterministic) {
+	int numThreads = 1;
+#if defined(_OPENMP)
+	numThreads = omp_get_max_threads();
+#endif
+
+	// deterministic: buffer b sums the tiles b, b + DETERMINISTIC_BUFFERS, ... in this order
+	int numBuffers = isDeterministic ? DETERMINISTIC_BUFFERS : numThreads;
+
+	// all tiles (bi, bj) with bi <= bj of the upper triangle
+	int numBlocks = (n + TILE_SIZE - 1) / TILE_SIZE;
+	std::vector<std::pair<int, int>> tiles;
+	tiles.reserve(numBlocks * (numBlocks + 1) / 2);
+	for (int bi = 0; bi < numBlocks; ++bi) {
+		for (int bj = bi; bj < numBlocks; ++bj) {
+			tiles.push_back(std::make_pair(bi, bj));
+		}
+	}
+
+	// accumulation buffer per thread (x, y, z after each other)
+	std::vector<double> buffers(static_cast<size_t>(numBuffers) * 3 * n, 0.0);
+	int cntTiles = tiles.size();
+	int cntTasks = isDeterministic ? numBuffers : cntTiles;
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+	{
+		// one span per thread shows the balance of the tiles
+		TRACE_SCOPE("forceTiles");
+
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 1)
+#endif
+		for (int task = 0; task < cntTasks; ++task) {
+			int buffer = 0;
+#if defined(_OPENMP)
+			buffer = omp_get_thread_num();
+#endif
+			if (isDeterministic) {
+				buffer = task;
+			}
+			double* bx = &buffers[static_cast<size_t>(buffer) * 3 * n];
+			double* by = bx + n;
+			double* bz = by + n;
+
+			// one tile per task, or all tiles of the buffer in a fixed order
+			int tileStep = isDeterministic ? numBuffers : cntTiles;
+			for (int t = task; t < cntTiles; t += tileStep) {
+				int iStart = tiles[t].first * TILE_SIZE;
+				int iEnd = std::min(iStart + TILE_SIZE, n);
+				int jStart = tiles[t].second * TILE_SIZE;
+				int jEnd = std::min(jStart + TILE_SIZE, n);
+				bool isDiagonal = tiles[t].first == tiles[t].second;
+
+				for (int i = iStart; i < iEnd; ++i) {
+					double sx = 0.0, sy = 0.0, sz = 0.0;
+
+					for (int j = isDiagonal ? i + 1 : jStart; j < jEnd; ++j) {
+						double dx = x[j] - x[i];
+						double dy = y[j] - y[i];
+						double dz = z[j] - z[i];
+
+						double r2 = dx * dx + dy * dy + dz * dz + eps;
+						double invR = 1.0 / sqrt(r2);
+						double invR3 = invR * invR * invR;
+
+						// i is pulled towards j and j towards i
+						sx += m[j] * invR3 * dx;
+						sy += m[j] * invR3 * dy;
+						sz += m[j] * invR3 * dz;
+						bx[j] -= m[i] * invR3 * dx;
+						by[j] -= m[i] * invR3 * dy;
+						bz[j] -= m[i] * invR3 * dz;
+					}
+
+					bx[i] += sx;
+					by[i] += sy;
+					bz[i] += sz;
+				}
+			}
+		}
+	}
+
+	// reduce the buffers in a fixed order
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		double sx = 0.0, sy = 0.0, sz = 0.0;
+
+		for (int buffer = 0; buffer < numBuffers; ++buffer) {
+			const double* bx = &buffers[static_cast<size_t>(buffer) * 3 * n];
+			sx += bx[i];
+			sy += bx[n + i];
+			sz += bx[2 * n + i];
+		}
+
+		ax[i] = sx;
+		ay[i] = sy;
+		az[i] = sz;
+	}
+}
+
+
+/**
+ * \brief Same as computeFields(), but the field is only calculated for the given bodies
+ *        (e.g. the active bodies of a block-timestep). All bodies are used as sources.
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param targets
+ *      Indices of the bodies for which the field is calculated.
+ * \param cntTargets
+ *      Number of targets.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (only the targets are overwritten).
+ */
+void GravityKernel::computeFieldsSubset(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az) {
+	static const KernelFunction kernel = selectKernel<SubsetTargets>();
+
+	kernel(x, y, z, m, n, eps, targets, cntTargets, ax, ay, az);
+}
+
+
+/**
+ * \brief Same as computeFieldsSubset(), but on the calling thread (e.g. for the interaction-list of a group of
+ *        a tree-walk, whose groups are evaluated in parallel).
+ *
+ * \param x, y, z
+ *      Positions of all sources (the targets are among them).
+ * \param m
+ *      Masses of all sources.
+ * \param n
+ *      Number of sources.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param targets
+ *      Indices of the sources for which the field is calculated.
+ * \param cntTargets
+ *      Number of targets.
+ * \param ax, ay, az
+ *      Output-parameter: Field per source (only the targets are overwritten).
+ */
+void GravityKernel::computeFieldsList(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az) {
+	static const KernelFunction kernel = selectKernel<ListTargets>();
+
+	kernel(x, y, z, m, n, eps, targets, cntTargets, ax, ay, az);
+}
+
+
+/**
+ * \brief Same as computeFieldsSubset(), but also the time-derivative of the field (jerk)
+ *        j_i = sum_j(m_j * (v_ij / r^3 - 3 * (d_ij . v_ij) * d_ij / r^5)) with r^2 = |d_ij|^2 + eps, as needed by
+ *        the Hermite-integrator. Both share the distance and its inverse powers per pair.
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param vx, vy, vz
+ *      Velocities of all bodies.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param targets
+ *      Indices of the bodies for which the field is calculated.
+ * \param cntTargets
+ *      Number of targets.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (only the targets are overwritten).
+ * \param jx, jy, jz
+ *      Output-parameter: Jerk of the field per body (only the targets are overwritten).
+ */
+void GravityKernel::computeFieldsAndJerks(const double* x, const double* y, const double* z,
+	const double* vx, const double* vy, const double* vz, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az, double* jx, double* jy, double* jz) {
+	static const JerkKernelFunction kernel = selectJerkKernel();
+
+	kernel(x, y, z, vx, vy, vz, m, n, eps, targets, cntTargets, ax, ay, az, jx, jy, jz);
+}
+
+
+/**
+ * \brief Same as computeFields(), but the pairs are evaluated in single precision (twice the lanes per
+ *        register) and the fields are summed in double precision. The targets are sorted into spatially
+ *        compact tiles (Morton order) and all positions are converted relative to the center of the tile,
+ *        so the close pairs keep their precision. The error of the field of a body, relative to the sum of
+ *        the magnitudes of its pairs, stays below MIXED_ERROR_BOUND (see the micro-benchmark).
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ */
+void GravityKernel::computeFieldsMixed(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	double* ax, double* ay, double* az) {
+	static const MixedRowFunction row = selectMixedRow();
+
+	std::vector<int> order;
+	BodyState::sortMorton(x, y, z, n, order);
+	int numTiles = (n + TILE_SIZE - 1) / TILE_SIZE;
+	float epsFloat = static_cast<float>(eps);
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+	{
+		// the sources are converted once per tile (n / TILE_SIZE conversions per pair of the tile)
+		std::vector<float> fx(n), fy(n), fz(n), fm(n);
+		for (int j = 0; j < n; ++j) {
+			fm[j] = static_cast<float>(m[j]);
+		}
+
+#if defined(_OPENMP)
+#pragma omp for schedule(dynamic, 1)
+#endif
+		for (int t = 0; t < numTiles; ++t) {
+			int start = t * TILE_SIZE;
+			int end = std::min(start + TILE_SIZE, n);
+
+			// origin at the center of the targets of the tile
+			double min[3] = { HUGE_VAL, HUGE_VAL, HUGE_VAL };
+			double max[3] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+			for (int k = start; k < end; ++k) {
+				int i = order[k];
+				min[0] = std::min(min[0], x[i]); max[0] = std::max(max[0], x[i]);
+				min[1] = std::min(min[1], y[i]); max[1] = std::max(max[1], y[i]);
+				min[2] = std::min(min[2], z[i]); max[2] = std::max(max[2], z[i]);
+			}
+			double ox = 0.5 * (min[0] + max[0]);
+			double oy = 0.5 * (min[1] + max[1]);
+			double oz = 0.5 * (min[2] + max[2]);
+
+			for (int j = 0; j < n; ++j) {
+				fx[j] = static_cast<float>(x[j] - ox);
+				fy[j] = static_cast<float>(y[j] - oy);
+				fz[j] = static_cast<float>(z[j] - oz);
+			}
+
+			for (int k = start; k < end; ++k) {
+				int i = order[k];
+				double sum[3];
+				row(fx.data(), fy.data(), fz.data(), fm.data(), n, epsFloat, fx[i], fy[i], fz[i], sum);
+
+				ax[i] = sum[0];
+				ay[i] = sum[1];
+				az[i] = sum[2];
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Calculate the softened potential phi_i = -sum_j(m_j / (|d_ij|^2 + eps)^(1/2)) for all bodies (the potential
+ *        of the fields of computeFields(), e.g. for the diagnostics of the energy). The pair i == j is skipped.
+ *
+ * \param x, y, z
+ *      Positions of all bodies.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param phi
+ *      Output-parameter: Potential per body (overwritten).
+ */
+void GravityKernel::computePotentials(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	double* phi) {
+	// only evaluated every few steps, so the plain loop is vectorized by the compiler
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int i = 0; i < n; ++i) {
+		double sum = 0.0;
+
+		for (int j = 0; j < n; ++j) {
+			double dx = x[j] - x[i];
+			double dy = y[j] - y[i];
+			double dz = z[j] - z[i];
+
+			double p = m[j] / sqrt(dx * dx + dy * dy + dz * dz + eps);
+			sum += j != i ? p : 0.0;
+		}
+
+		phi[i] = -sum;
+	}
+}
+
+
+/**
+ * \brief Get the name of the instruction set which is used by the kernel.
+ *
+ * \return "avx512", "avx2" or "scalar".
+ */
+std::string GravityKernel::getInstructionSet() {
+	switch (selectInstructionSet()) {
+	case AVX512:
+		return "avx512";
+	case AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+
+/**
+ * \brief Select the best instruction set which is supported by the CPU.
+ *
+ * \return Instruction set of the kernels.
+ */
+GravityKernel::InstructionSet GravityKernel::selectInstructionSet() {
+#if defined(PBS17_X86_SIMD)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f")) {
+		return AVX512;
+	}
+
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return AVX2;
+	}
+#endif
+
+	return SCALAR;
+}
+
+
+/**
+ * \brief Select the best kernel for the target policy which is supported by the CPU.
+ *
+ * \return Kernel implementation.
+ */
+template<typename Targets>
+GravityKernel::KernelFunction GravityKernel::selectKernel() {
+	switch (selectInstructionSet()) {
+	case AVX512:
+		return &GravityKernel::computeAvx512<Targets>;
+	case AVX2:
+		return &GravityKernel::computeAvx2<Targets>;
+	default:
+		return &GravityKernel::computeScalar<Targets>;
+	}
+}
+
+
+/**
+ * \brief Select the best field- and jerk-kernel which is supported by the CPU (same instruction set as selectKernel()).
+ *
+ * \return Kernel implementation.
+ */
+GravityKernel::JerkKernelFunction GravityKernel::selectJerkKernel() {
+	switch (selectInstructionSet()) {
+	case AVX512:
+		return &GravityKernel::computeJerksAvx512;
+	case AVX2:
+		return &GravityKernel::computeJerksAvx2;
+	default:
+		return &GravityKernel::computeJerksScalar;
+	}
+}
+
+
+/**
+ * \brief Select the best single precision row which is supported by the CPU (same instruction set as selectKernel()).
+ *
+ * \return Row implementation.
+ */
+GravityKernel::MixedRowFunction GravityKernel::selectMixedRow() {
+	switch (selectInstructionSet()) {
+	case AVX512:
+		return &GravityKernel::rowMixedAvx512;
+	case AVX2:
+		return &GravityKernel::rowMixedAvx2;
+	default:
+		return &GravityKernel::rowMixedScalar;
+	}
+}
+
+
+/**
+ * \brief Scalar implementation (fallback). Same parameters as computeFieldsSubset().
+ */
+template<typename Targets>
+void GravityKernel::computeScalar(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az) {
+#if defined(_OPENMP)
+#pragma omp parallel for if(Targets::IS_PARALLEL)
+#endif
+	for (int k = 0; k < cntTargets; ++k) {
+		int i = Targets::get(targets, k);
+		double sx = 0.0, sy = 0.0, sz = 0.0;
+
+		for (int j = 0; j < n; ++j) {
+			double dx = x[j] - x[i];
+			double dy = y[j] - y[i];
+			double dz = z[j] - z[i];
+
+			double r2 = dx * dx + dy * dy + dz * dz + eps;
+			double invR = 1.0 / sqrt(r2);
+			double s = m[j] * invR * invR * invR;
+
+			sx += s * dx;
+			sy += s * dy;
+			sz += s * dz;
+		}
+
+		ax[i] = sx;
+		ay[i] = sy;
+		az[i] = sz;
+	}
+}
+
+
+/**
+ * \brief Scalar field- and jerk-kernel (fallback). Same parameters as computeFieldsAndJerks().
+ */
+void GravityKernel::computeJerksScalar(const double* x, const double* y, const double* z,
+	const double* vx, const double* vy, const double* vz, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az, double* jx, double* jy, double* jz) {
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntTargets; ++k) {
+		int i = targets[k];
+		double rax = 0.0, ray = 0.0, raz = 0.0;
+		double rjx = 0.0, rjy = 0.0, rjz = 0.0;
+
+		for (int j = 0; j < n; ++j) {
+			double dx = x[j] - x[i];
+			double dy = y[j] - y[i];
+			double dz = z[j] - z[i];
+			double dvx = vx[j] - vx[i];
+			double dvy = vy[j] - vy[i];
+			double dvz = vz[j] - vz[i];
+
+			double invR2 = 1.0 / (dx * dx + dy * dy + dz * dz + eps);
+			double s = m[j] * invR2 * sqrt(invR2);
+			double q = 3.0 * (dx * dvx + dy * dvy + dz * dvz) * invR2;
+
+			rax += s * dx;
+			ray += s * dy;
+			raz += s * dz;
+			rjx += s * (dvx - q * dx);
+			rjy += s * (dvy - q * dy);
+			rjz += s * (dvz - q * dz);
+		}
+
+		ax[i] = rax;
+		ay[i] = ray;
+		az[i] = raz;
+		jx[i] = rjx;
+		jy[i] = rjy;
+		jz[i] = rjz;
+	}
+}
+
+
+/**
+ * \brief Scalar single precision row: Sum the field of all bodies at one target in double precision.
+ *
+ * \param x, y, z
+ *      Positions of all bodies relative to the tile of the target.
+ * \param m
+ *      Masses of all bodies.
+ * \param n
+ *      Number of bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param xi, yi, zi
+ *      Position of the target relative to its tile.
+ * \param sum
+ *      Output-parameter: Field at the target (x, y, z).
+ */
+void GravityKernel::rowMixedScalar(const float* x, const float* y, const float* z, const float* m, int n, float eps,
+	float xi, float yi, float zi, double* sum) {
+	double sx = 0.0, sy = 0.0, sz = 0.0;
+
+	for (int j = 0; j < n; ++j) {
+		float dx = x[j] - xi;
+		float dy = y[j] - yi;
+		float dz = z[j] - zi;
+
+		float r2 = dx * dx + dy * dy + dz * dz + eps;
+		float invR = 1.0f / sqrtf(r2);
+		float s = m[j] * invR * invR * invR;
+
+		sx += s * dx;
+		sy += s * dy;
+		sz += s * dz;
+	}
+
+	sum[0] = sx;
+	sum[1] = sy;
+	sum[2] = sz;
+}
+
+
+#if defined(PBS17_X86_SIMD)
+
+/**
+ * \brief AVX2/FMA implementation with 4 bodies per register. Same parameters as computeFieldsSubset().
+ */
+template<typename Targets>
+__attribute__((target("avx2,fma")))
+void GravityKernel::computeAvx2(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az) {
+	const __m256d vEps = _mm256_set1_pd(eps);
+	const __m256d vHalf = _mm256_set1_pd(0.5);
+	const __m256d vThreeHalf = _mm256_set1_pd(1.5);
+	int nVec = n - n % 4;
+
+#if defined(_OPENMP)
+#pragma omp parallel for if(Targets::IS_PARALLEL)
+#endif
+	for (int k = 0; k < cntTargets; ++k) {
+		int i = Targets::get(targets, k);
+		__m256d xi = _mm256_set1_pd(x[i]);
+		__m256d yi = _mm256_set1_pd(y[i]);
+		__m256d zi = _mm256_set1_pd(z[i]);
+		__m256d sx = _mm256_setzero_pd();
+		__m256d sy = _mm256_setzero_pd();
+		__m256d sz = _mm256_setzero_pd();
+
+		for (int j = 0; j < nVec; j += 4) {
+			__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), xi);
+			__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), yi);
+			__m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + j), zi);
+
+			__m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_fmadd_pd(dz, dz, vEps)));
+
+			// single precision estimate of 1/sqrt(r2), refined twice with Newton-Raphson
+			__m256d invR = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(r2)));
+			__m256d halfR2 = _mm256_mul_pd(vHalf, r2);
+			invR = _mm256_mul_pd(invR, _mm256_fnmadd_pd(halfR2, _mm256_mul_pd(invR, invR), vThreeHalf));
+			invR = _mm256_mul_pd(invR, _mm256_fnmadd_pd(halfR2, _mm256_mul_pd(invR, invR), vThreeHalf));
+
+			__m256d s = _mm256_mul_pd(_mm256_loadu_pd(m + j), _mm256_mul_pd(invR, _mm256_mul_pd(invR, invR)));
+
+			sx = _mm256_fmadd_pd(s, dx, sx);
+			sy = _mm256_fmadd_pd(s, dy, sy);
+			sz = _mm256_fmadd_pd(s, dz, sz);
+		}
+
+		double bx[4], by[4], bz[4];
+		_mm256_storeu_pd(bx, sx);
+		_mm256_storeu_pd(by, sy);
+		_mm256_storeu_pd(bz, sz);
+		double rx = bx[0] + bx[1] + bx[2] + bx[3];
+		double ry = by[0] + by[1] + by[2] + by[3];
+		double rz = bz[0] + bz[1] + bz[2] + bz[3];
+
+		// remaining bodies
+		for (int j = nVec; j < n; ++j) {
+			double dx = x[j] - x[i];
+			double dy = y[j] - y[i];
+			double dz = z[j] - z[i];
+
+			double r2 = dx * dx + dy * dy + dz * dz + eps;
+			double invR = 1.0 / sqrt(r2);
+			double s = m[j] * invR * invR * invR;
+
+			rx += s * dx;
+			ry += s * dy;
+			rz += s * dz;
+		}
+
+		ax[i] = rx;
+		ay[i] = ry;
+		az[i] = rz;
+	}
+}
+
+
+/**
+ * \brief AVX-512 implementation with 8 bodies per register. Same parameters as computeFieldsSubset().
+ */
+template<typename Targets>
+__attribute__((target("avx512f")))
+void GravityKernel::computeAvx512(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az) {
+	const __m512d vEps = _mm512_set1_pd(eps);
+	const __m512d vHalf = _mm512_set1_pd(0.5);
+	const __m512d vThreeHalf = _mm512_set1_pd(1.5);
+	int nVec = n - n % 8;
+
+#if defined(_OPENMP)
+#pragma omp parallel for if(Targets::IS_PARALLEL)
+#endif
+	for (int k = 0; k < cntTargets; ++k) {
+		int i = Targets::get(targets, k);
+		__m512d xi = _mm512_set1_pd(x[i]);
+		__m512d yi = _mm512_set1_pd(y[i]);
+		__m512d zi = _mm512_set1_pd(z[i]);
+		__m512d sx = _mm512_setzero_pd();
+		__m512d sy = _mm512_setzero_pd();
+		__m512d sz = _mm512_setzero_pd();
+
+		for (int j = 0; j < nVec; j += 8) {
+			__m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + j), xi);
+			__m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + j), yi);
+			__m512d dz = _mm512_sub_pd(_mm512_loadu_pd(z + j), zi);
+
+			__m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_fmadd_pd(dz, dz, vEps)));
+
+			// 14-bit estimate of 1/sqrt(r2), refined twice with Newton-Raphson
+			__m512d invR = _mm512_rsqrt14_pd(r2);
+			__m512d halfR2 = _mm512_mul_pd(vHalf, r2);
+			invR = _mm512_mul_pd(invR, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(invR, invR), vThreeHalf));
+			invR = _mm512_mul_pd(invR, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(invR, invR), vThreeHalf));
+
+			__m512d s = _mm512_mul_pd(_mm512_loadu_pd(m + j), _mm512_mul_pd(invR, _mm512_mul_pd(invR, invR)));
+
+			sx = _mm512_fmadd_pd(s, dx, sx);
+			sy = _mm512_fmadd_pd(s, dy, sy);
+			sz = _mm512_fmadd_pd(s, dz, sz);
+		}
+
+		double rx = _mm512_reduce_add_pd(sx);
+		double ry = _mm512_reduce_add_pd(sy);
+		double rz = _mm512_reduce_add_pd(sz);
+
+		// remaining bodies
+		for (int j = nVec; j < n; ++j) {
+			double dx = x[j] - x[i];
+			double dy = y[j] - y[i];
+			double dz = z[j] - z[i];
+
+			double r2 = dx * dx + dy * dy + dz * dz + eps;
+			double invR = 1.0 / sqrt(r2);
+			double s = m[j] * invR * invR * invR;
+
+			rx += s * dx;
+			ry += s * dy;
+			rz += s * dz;
+		}
+
+		ax[i] = rx;
+		ay[i] = ry;
+		az[i] = rz;
+	}
+}
+
+/**
+ * \brief AVX2/FMA field- and jerk-kernel with 4 bodies per register. Same parameters as computeFieldsAndJerks().
+ */
+__attribute__((target("avx2,fma")))
+void GravityKernel::computeJerksAvx2(const double* x, const double* y, const double* z,
+	const double* vx, const double* vy, const double* vz, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az, double* jx, double* jy, double* jz) {
+	const __m256d vEps = _mm256_set1_pd(eps);
+	const __m256d vHalf = _mm256_set1_pd(0.5);
+	const __m256d vThreeHalf = _mm256_set1_pd(1.5);
+	const __m256d vThree = _mm256_set1_pd(3.0);
+	int nVec = n - n % 4;
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntTargets; ++k) {
+		int i = targets[k];
+		__m256d xi = _mm256_set1_pd(x[i]);
+		__m256d yi = _mm256_set1_pd(y[i]);
+		__m256d zi = _mm256_set1_pd(z[i]);
+		__m256d vxi = _mm256_set1_pd(vx[i]);
+		__m256d vyi = _mm256_set1_pd(vy[i]);
+		__m256d vzi = _mm256_set1_pd(vz[i]);
+		__m256d sax = _mm256_setzero_pd();
+		__m256d say = _mm256_setzero_pd();
+		__m256d saz = _mm256_setzero_pd();
+		__m256d sjx = _mm256_setzero_pd();
+		__m256d sjy = _mm256_setzero_pd();
+		__m256d sjz = _mm256_setzero_pd();
+
+		for (int j = 0; j < nVec; j += 4) {
+			__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + j), xi);
+			__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + j), yi);
+			__m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + j), zi);
+			__m256d dvx = _mm256_sub_pd(_mm256_loadu_pd(vx + j), vxi);
+			__m256d dvy = _mm256_sub_pd(_mm256_loadu_pd(vy + j), vyi);
+			__m256d dvz = _mm256_sub_pd(_mm256_loadu_pd(vz + j), vzi);
+
+			__m256d r2 = _mm256_fmadd_pd(dx, dx, _mm256_fmadd_pd(dy, dy, _mm256_fmadd_pd(dz, dz, vEps)));
+
+			// single precision estimate of 1/sqrt(r2), refined twice with Newton-Raphson
+			__m256d invR = _mm256_cvtps_pd(_mm_rsqrt_ps(_mm256_cvtpd_ps(r2)));
+			__m256d halfR2 = _mm256_mul_pd(vHalf, r2);
+			invR = _mm256_mul_pd(invR, _mm256_fnmadd_pd(halfR2, _mm256_mul_pd(invR, invR), vThreeHalf));
+			invR = _mm256_mul_pd(invR, _mm256_fnmadd_pd(halfR2, _mm256_mul_pd(invR, invR), vThreeHalf));
+
+			// the field and the jerk share m / r^3, the jerk adds the radial part 3 * (d . v) / r^2
+			__m256d invR2 = _mm256_mul_pd(invR, invR);
+			__m256d s = _mm256_mul_pd(_mm256_loadu_pd(m + j), _mm256_mul_pd(invR, invR2));
+			__m256d rv = _mm256_fmadd_pd(dx, dvx, _mm256_fmadd_pd(dy, dvy, _mm256_mul_pd(dz, dvz)));
+			__m256d q = _mm256_mul_pd(vThree, _mm256_mul_pd(rv, invR2));
+
+			sax = _mm256_fmadd_pd(s, dx, sax);
+			say = _mm256_fmadd_pd(s, dy, say);
+			saz = _mm256_fmadd_pd(s, dz, saz);
+			sjx = _mm256_fmadd_pd(s, _mm256_fnmadd_pd(q, dx, dvx), sjx);
+			sjy = _mm256_fmadd_pd(s, _mm256_fnmadd_pd(q, dy, dvy), sjy);
+			sjz = _mm256_fmadd_pd(s, _mm256_fnmadd_pd(q, dz, dvz), sjz);
+		}
+
+		double b[6][4];
+		_mm256_storeu_pd(b[0], sax);
+		_mm256_storeu_pd(b[1], say);
+		_mm256_storeu_pd(b[2], saz);
+		_mm256_storeu_pd(b[3], sjx);
+		_mm256_storeu_pd(b[4], sjy);
+		_mm256_storeu_pd(b[5], sjz);
+		double rax = b[0][0] + b[0][1] + b[0][2] + b[0][3];
+		double ray = b[1][0] + b[1][1] + b[1][2] + b[1][3];
+		double raz = b[2][0] + b[2][1] + b[2][2] + b[2][3];
+		double rjx = b[3][0] + b[3][1] + b[3][2] + b[3][3];
+		double rjy = b[4][0] + b[4][1] + b[4][2] + b[4][3];
+		double rjz = b[5][0] + b[5][1] + b[5][2] + b[5][3];
+
+		// remaining bodies
+		for (int j = nVec; j < n; ++j) {
+			double dx = x[j] - x[i];
+			double dy = y[j] - y[i];
+			double dz = z[j] - z[i];
+			double dvx = vx[j] - vx[i];
+			double dvy = vy[j] - vy[i];
+			double dvz = vz[j] - vz[i];
+
+			double invR2 = 1.0 / (dx * dx + dy * dy + dz * dz + eps);
+			double s = m[j] * invR2 * sqrt(invR2);
+			double q = 3.0 * (dx * dvx + dy * dvy + dz * dvz) * invR2;
+
+			rax += s * dx;
+			ray += s * dy;
+			raz += s * dz;
+			rjx += s * (dvx - q * dx);
+			rjy += s * (dvy - q * dy);
+			rjz += s * (dvz - q * dz);
+		}
+
+		ax[i] = rax;
+		ay[i] = ray;
+		az[i] = raz;
+		jx[i] = rjx;
+		jy[i] = rjy;
+		jz[i] = rjz;
+	}
+}
+
+
+/**
+ * \brief AVX-512 field- and jerk-kernel with 8 bodies per register. Same parameters as computeFieldsAndJerks().
+ */
+__attribute__((target("avx512f")))
+void GravityKernel::computeJerksAvx512(const double* x, const double* y, const double* z,
+	const double* vx, const double* vy, const double* vz, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az, double* jx, double* jy, double* jz) {
+	const __m512d vEps = _mm512_set1_pd(eps);
+	const __m512d vHalf = _mm512_set1_pd(0.5);
+	const __m512d vThreeHalf = _mm512_set1_pd(1.5);
+	const __m512d vThree = _mm512_set1_pd(3.0);
+	int nVec = n - n % 8;
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntTargets; ++k) {
+		int i = targets[k];
+		__m512d xi = _mm512_set1_pd(x[i]);
+		__m512d yi = _mm512_set1_pd(y[i]);
+		__m512d zi = _mm512_set1_pd(z[i]);
+		__m512d vxi = _mm512_set1_pd(vx[i]);
+		__m512d vyi = _mm512_set1_pd(vy[i]);
+		__m512d vzi = _mm512_set1_pd(vz[i]);
+		__m512d sax = _mm512_setzero_pd();
+		__m512d say = _mm512_setzero_pd();
+		__m512d saz = _mm512_setzero_pd();
+		__m512d sjx = _mm512_setzero_pd();
+		__m512d sjy = _mm512_setzero_pd();
+		__m512d sjz = _mm512_setzero_pd();
+
+		for (int j = 0; j < nVec; j += 8) {
+			__m512d dx = _mm512_sub_pd(_mm512_loadu_pd(x + j), xi);
+			__m512d dy = _mm512_sub_pd(_mm512_loadu_pd(y + j), yi);
+			__m512d dz = _mm512_sub_pd(_mm512_loadu_pd(z + j), zi);
+			__m512d dvx = _mm512_sub_pd(_mm512_loadu_pd(vx + j), vxi);
+			__m512d dvy = _mm512_sub_pd(_mm512_loadu_pd(vy + j), vyi);
+			__m512d dvz = _mm512_sub_pd(_mm512_loadu_pd(vz + j), vzi);
+
+			__m512d r2 = _mm512_fmadd_pd(dx, dx, _mm512_fmadd_pd(dy, dy, _mm512_fmadd_pd(dz, dz, vEps)));
+
+			// 14-bit estimate of 1/sqrt(r2), refined twice with Newton-Raphson
+			__m512d invR = _mm512_rsqrt14_pd(r2);
+			__m512d halfR2 = _mm512_mul_pd(vHalf, r2);
+			invR = _mm512_mul_pd(invR, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(invR, invR), vThreeHalf));
+			invR = _mm512_mul_pd(invR, _mm512_fnmadd_pd(halfR2, _mm512_mul_pd(invR, invR), vThreeHalf));
+
+			// the field and the jerk share m / r^3, the jerk adds the radial part 3 * (d . v) / r^2
+			__m512d invR2 = _mm512_mul_pd(invR, invR);
+			__m512d s = _mm512_mul_pd(_mm512_loadu_pd(m + j), _mm512_mul_pd(invR, invR2));
+			__m512d rv = _mm512_fmadd_pd(dx, dvx, _mm512_fmadd_pd(dy, dvy, _mm512_mul_pd(dz, dvz)));
+			__m512d q = _mm512_mul_pd(vThree, _mm512_mul_pd(rv, invR2));
+
+			sax = _mm512_fmadd_pd(s, dx, sax);
+			say = _mm512_fmadd_pd(s, dy, say);
+			saz = _mm512_fmadd_pd(s, dz, saz);
+			sjx = _mm512_fmadd_pd(s, _mm512_fnmadd_pd(q, dx, dvx), sjx);
+			sjy = _mm512_fmadd_pd(s, _mm512_fnmadd_pd(q, dy, dvy), sjy);
+			sjz = _mm512_fmadd_pd(s, _mm512_fnmadd_pd(q, dz, dvz), sjz);
+		}
+
+		double rax = _mm512_reduce_add_pd(sax);
+		double ray = _mm512_reduce_add_pd(say);
+		double raz = _mm512_reduce_add_pd(saz);
+		double rjx = _mm512_reduce_add_pd(sjx);
+		double rjy = _mm512_reduce_add_pd(sjy);
+		double rjz = _mm512_reduce_add_pd(sjz);
+
+		// remaining bodies
+		for (int j = nVec; j < n; ++j) {
+			double dx = x[j] - x[i];
+			double dy = y[j] - y[i];
+			double dz = z[j] - z[i];
+			double dvx = vx[j] - vx[i];
+			double dvy = vy[j] - vy[i];
+			double dvz = vz[j] - vz[i];
+
+			double invR2 = 1.0 / (dx * dx + dy * dy + dz * dz + eps);
+			double s = m[j] * invR2 * sqrt(invR2);
+			double q = 3.0 * (dx * dvx + dy * dvy + dz * dvz) * invR2;
+
+			rax += s * dx;
+			ray += s * dy;
+			raz += s * dz;
+			rjx += s * (dvx - q * dx);
+			rjy += s * (dvy - q * dy);
+			rjz += s * (dvz - q * dz);
+		}
+
+		ax[i] = rax;
+		ay[i] = ray;
+		az[i] = raz;
+		jx[i] = rjx;
+		jy[i] = rjy;
+		jz[i] = rjz;
+	}
+}
+
+
+/**
+ * \brief AVX2/FMA single precision row with 8 bodies per register. Same parameters as rowMixedScalar().
+ */
+__attribute__((target("avx2,fma")))
+void GravityKernel::rowMixedAvx2(const float* x, const float* y, const float* z, const float* m, int n, float eps,
+	float xi, float yi, float zi, double* sum) {
+	const __m256 vEps = _mm256_set1_ps(eps);
+	const __m256 vHalf = _mm256_set1_ps(0.5f);
+	const __m256 vThreeHalf = _mm256_set1_ps(1.5f);
+	const __m256 vxi = _mm256_set1_ps(xi);
+	const __m256 vyi = _mm256_set1_ps(yi);
+	const __m256 vzi = _mm256_set1_ps(zi);
+	__m256d sx = _mm256_setzero_pd();
+	__m256d sy = _mm256_setzero_pd();
+	__m256d sz = _mm256_setzero_pd();
+	int nVec = n - n % 8;
+
+	for (int j = 0; j < nVec; j += 8) {
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + j), vxi);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + j), vyi);
+		__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + j), vzi);
+
+		__m256 r2 = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_fmadd_ps(dz, dz, vEps)));
+
+		// 12-bit estimate of 1/sqrt(r2), refined once with Newton-Raphson to single precision
+		__m256 invR = _mm256_rsqrt_ps(r2);
+		invR = _mm256_mul_ps(invR, _mm256_fnmadd_ps(_mm256_mul_ps(vHalf, r2), _mm256_mul_ps(invR, invR), vThreeHalf));
+
+		__m256 s = _mm256_mul_ps(_mm256_loadu_ps(m + j), _mm256_mul_ps(invR, _mm256_mul_ps(invR, invR)));
+		__m256 fx = _mm256_mul_ps(s, dx);
+		__m256 fy = _mm256_mul_ps(s, dy);
+		__m256 fz = _mm256_mul_ps(s, dz);
+
+		// both halves are summed in double precision
+		sx = _mm256_add_pd(sx, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(fx)), _mm256_cvtps_pd(_mm256_extractf128_ps(fx, 1))));
+		sy = _mm256_add_pd(sy, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(fy)), _mm256_cvtps_pd(_mm256_extractf128_ps(fy, 1))));
+		sz = _mm256_add_pd(sz, _mm256_add_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(fz)), _mm256_cvtps_pd(_mm256_extractf128_ps(fz, 1))));
+	}
+
+	double bx[4], by[4], bz[4];
+	_mm256_storeu_pd(bx, sx);
+	_mm256_storeu_pd(by, sy);
+	_mm256_storeu_pd(bz, sz);
+
+	// remaining bodies
+	double rest[3];
+	rowMixedScalar(x + nVec, y + nVec, z + nVec, m + nVec, n - nVec, eps, xi, yi, zi, rest);
+
+	sum[0] = bx[0] + bx[1] + bx[2] + bx[3] + rest[0];
+	sum[1] = by[0] + by[1] + by[2] + by[3] + rest[1];
+	sum[2] = bz[0] + bz[1] + bz[2] + bz[3] + rest[2];
+}
+
+
+/**
+ * \brief AVX-512 single precision row with 16 bodies per register. Same parameters as rowMixedScalar().
+ */
+__attribute__((target("avx512f")))
+void GravityKernel::rowMixedAvx512(const float* x, const float* y, const float* z, const float* m, int n, float eps,
+	float xi, float yi, float zi, double* sum) {
+	const __m512 vEps = _mm512_set1_ps(eps);
+	const __m512 vHalf = _mm512_set1_ps(0.5f);
+	const __m512 vThreeHalf = _mm512_set1_ps(1.5f);
+	const __m512 vxi = _mm512_set1_ps(xi);
+	const __m512 vyi = _mm512_set1_ps(yi);
+	const __m512 vzi = _mm512_set1_ps(zi);
+	__m512d sx = _mm512_setzero_pd();
+	__m512d sy = _mm512_setzero_pd();
+	__m512d sz = _mm512_setzero_pd();
+	int nVec = n - n % 16;
+
+	for (int j = 0; j < nVec; j += 16) {
+		__m512 dx = _mm512_sub_ps(_mm512_loadu_ps(x + j), vxi);
+		__m512 dy = _mm512_sub_ps(_mm512_loadu_ps(y + j), vyi);
+		__m512 dz = _mm512_sub_ps(_mm512_loadu_ps(z + j), vzi);
+
+		__m512 r2 = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, _mm512_fmadd_ps(dz, dz, vEps)));
+
+		// 14-bit estimate of 1/sqrt(r2), refined once with Newton-Raphson to single precision
+		__m512 invR = _mm512_rsqrt14_ps(r2);
+		invR = _mm512_mul_ps(invR, _mm512_fnmadd_ps(_mm512_mul_ps(vHalf, r2), _mm512_mul_ps(invR, invR), vThreeHalf));
+
+		__m512 s = _mm512_mul_ps(_mm512_loadu_ps(m + j), _mm512_mul_ps(invR, _mm512_mul_ps(invR, invR)));
+		__m512 fx = _mm512_mul_ps(s, dx);
+		__m512 fy = _mm512_mul_ps(s, dy);
+		__m512 fz = _mm512_mul_ps(s, dz);
+
+		// both halves are summed in double precision (the upper half is extracted as 4 doubles of raw bits)
+		sx = _mm512_add_pd(sx, _mm512_add_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(fx)),
+			_mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(fx), 1)))));
+		sy = _mm512_add_pd(sy, _mm512_add_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(fy)),
+			_mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(fy), 1)))));
+		sz = _mm512_add_pd(sz, _mm512_add_pd(_mm512_cvtps_pd(_mm512_castps512_ps256(fz)),
+			_mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(fz), 1)))));
+	}
+
+	// remaining bodies
+	double rest[3];
+	rowMixedScalar(x + nVec, y + nVec, z + nVec, m + nVec, n - nVec, eps, xi, yi, zi, rest);
+
+	sum[0] = _mm512_reduce_add_pd(sx) + rest[0];
+	sum[1] = _mm512_reduce_add_pd(sy) + rest[1];
+	sum[2] = _mm512_reduce_add_pd(sz) + rest[2];
+}
+
+#else
+
+/**
+ * \brief AVX2/FMA implementation (not available for this compiler/architecture => scalar).
+ */
+template<typename Targets>
+void GravityKernel::computeAvx2(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az) {
+	computeScalar<Targets>(x, y, z, m, n, eps, targets, cntTargets, ax, ay, az);
+}
+
+
+/**
+ * \brief AVX-512 implementation (not available for this compiler/architecture => scalar).
+ */
+template<typename Targets>
+void GravityKernel::computeAvx512(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az) {
+	computeScalar<Targets>(x, y, z, m, n, eps, targets, cntTargets, ax, ay, az);
+}
+
+
+/**
+ * \brief AVX2/FMA field- and jerk-kernel (not available for this compiler/architecture => scalar).
+ */
+void GravityKernel::computeJerksAvx2(const double* x, const double* y, const double* z,
+	const double* vx, const double* vy, const double* vz, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az, double* jx, double* jy, double* jz) {
+	computeJerksScalar(x, y, z, vx, vy, vz, m, n, eps, targets, cntTargets, ax, ay, az, jx, jy, jz);
+}
+
+
+/**
+ * \brief AVX-512 field- and jerk-kernel (not available for this compiler/architecture => scalar).
+ */
+void GravityKernel::computeJerksAvx512(const double* x, const double* y, const double* z,
+	const double* vx, const double* vy, const double* vz, const double* m, int n, double eps,
+	const int* targets, int cntTargets, double* ax, double* ay, double* az, double* jx, double* jy, double* jz) {
+	computeJerksScalar(x, y, z, vx, vy, vz, m, n, eps, targets, cntTargets, ax, ay, az, jx, jy, jz);
+}
+
+
+/**
+ * \brief AVX2/FMA single precision row (not available for this compiler/architecture => scalar).
+ */
+void GravityKernel::rowMixedAvx2(const float* x, const float* y, const float* z, const float* m, int n, float eps,
+	float xi, float yi, float zi, double* sum) {
+	rowMixedScalar(x, y, z, m, n, eps, xi, yi, zi, sum);
+}
+
+
+/**
+ * \brief AVX-512 single precision row (not available for this compiler/architecture => scalar).
+ */
+void GravityKernel::rowMixedAvx512(const float* x, const float* y, const float* z, const float* m, int n, float eps,
+	float xi, float yi, float zi, double* sum) {
+	rowMixedScalar(x, y, z, m, n, eps, xi, yi, zi, sum);
+}
+
+#endif
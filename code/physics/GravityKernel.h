@@ -0,0 +1,341 @@
+﻿/**
+ * \brief Implementation of the vectorized all-pairs gravity kernel.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#pragma once
+
+#include <string>
+
+namespace pbs17 {
+
+	/**
+	 * \brief All-pairs gravity kernel over structure-of-arrays positions and masses.
+	 * Per pair, one inverse-cube distance is evaluated with a reciprocal square root
+	 * (refined by Newton-Raphson to double precision). The instruction set (AVX-512, AVX2 or scalar)
+	 * is selected once at runtime based on the capabilities of the CPU.
+	 * The implementations are templates on the set of the targets (all bodies or a subset), so every
+	 * combination is instantiated at compile time and the inner loops stay free of branches.
+	 */
+	class GravityKernel {
+	public:
+		/**
+		 * \brief Calculate the softened field a_i = sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) for all bodies.
+		 *        Multiplied by G and the mass of the body, this is the gravitational force on the body.
+		 *        The pair i == j does not contribute, since its distance is zero.
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 */
+		static void computeFields(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			double* ax, double* ay, double* az);
+
+
+		/**
+		 * \brief Same as computeFields(), but each unordered pair is only evaluated once and applied
+		 *        to both bodies (Newton's third law). The pairs are processed in tiles, each thread
+		 *        accumulates into its own buffer and the buffers are reduced at the end.
+		 *        In the deterministic mode, the tiles are assigned to a fixed number of buffers instead of
+		 *        the threads, so the order of the summation does not depend on the number of threads.
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 * \param isDeterministic
+		 *      True to get bitwise the same result with any number of threads.
+		 */
+		static void computeFieldsSymmetric(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			double* ax, double* ay, double* az, bool isDeterministic = false);
+
+
+		/**
+		 * \brief Same as computeFields(), but the field is only calculated for the given bodies
+		 *        (e.g. the active bodies of a block-timestep). All bodies are used as sources.
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param targets
+		 *      Indices of the bodies for which the field is calculated.
+		 * \param cntTargets
+		 *      Number of targets.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (only the targets are overwritten).
+		 */
+		static void computeFieldsSubset(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			const int* targets, int cntTargets, double* ax, double* ay, double* az);
+
+
+		/**
+		 * \brief Same as computeFieldsSubset(), but on the calling thread (e.g. for the interaction-list of a group of
+		 *        a tree-walk, whose groups are evaluated in parallel).
+		 *
+		 * \param x, y, z
+		 *      Positions of all sources (the targets are among them).
+		 * \param m
+		 *      Masses of all sources.
+		 * \param n
+		 *      Number of sources.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param targets
+		 *      Indices of the sources for which the field is calculated.
+		 * \param cntTargets
+		 *      Number of targets.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per source (only the targets are overwritten).
+		 */
+		static void computeFieldsList(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			const int* targets, int cntTargets, double* ax, double* ay, double* az);
+
+
+		/**
+		 * \brief Same as computeFieldsSubset(), but also the time-derivative of the field (jerk)
+		 *        j_i = sum_j(m_j * (v_ij / r^3 - 3 * (d_ij . v_ij) * d_ij / r^5)) with r^2 = |d_ij|^2 + eps, as needed by
+		 *        the Hermite-integrator. Both share the distance and its inverse powers per pair.
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param vx, vy, vz
+		 *      Velocities of all bodies.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param targets
+		 *      Indices of the bodies for which the field is calculated.
+		 * \param cntTargets
+		 *      Number of targets.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (only the targets are overwritten).
+		 * \param jx, jy, jz
+		 *      Output-parameter: Jerk of the field per body (only the targets are overwritten).
+		 */
+		static void computeFieldsAndJerks(const double* x, const double* y, const double* z,
+			const double* vx, const double* vy, const double* vz, const double* m, int n, double eps,
+			const int* targets, int cntTargets, double* ax, double* ay, double* az, double* jx, double* jy, double* jz);
+
+
+		/**
+		 * \brief Same as computeFields(), but the pairs are evaluated in single precision (twice the lanes per
+		 *        register) and the fields are summed in double precision. The targets are sorted into spatially
+		 *        compact tiles (Morton order) and all positions are converted relative to the center of the tile,
+		 *        so the close pairs keep their precision. The error of the field of a body, relative to the sum of
+		 *        the magnitudes of its pairs, stays below MIXED_ERROR_BOUND (see the micro-benchmark).
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 */
+		static void computeFieldsMixed(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			double* ax, double* ay, double* az);
+
+
+		/**
+		 * \brief Calculate the softened potential phi_i = -sum_j(m_j / (|d_ij|^2 + eps)^(1/2)) for all bodies (the potential
+		 *        of the fields of computeFields(), e.g. for the diagnostics of the energy). The pair i == j is skipped.
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param phi
+		 *      Output-parameter: Potential per body (overwritten).
+		 */
+		static void computePotentials(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			double* phi);
+
+
+		/**
+		 * \brief Get the name of the instruction set which is used by the kernel.
+		 *
+		 * \return "avx512", "avx2" or "scalar".
+		 */
+		static std::string getInstructionSet();
+
+
+		//! Bound of the relative error of computeFieldsMixed() (single precision pairs, relative positions)
+		static const double MIXED_ERROR_BOUND;
+
+
+	private:
+		//! Number of bodies per tile of the symmetric and the mixed-precision kernel
+		static const int TILE_SIZE = 64;
+		//! Number of accumulation buffers of the deterministic symmetric kernel (independent of the threads)
+		static const int DETERMINISTIC_BUFFERS = 16;
+
+		//! Signature of the kernel implementations (the list of the targets is ignored for all bodies)
+		typedef void(*KernelFunction)(const double*, const double*, const double*, const double*, int, double,
+			const int*, int, double*, double*, double*);
+		//! Signature of the field- and jerk-kernels (see computeFieldsAndJerks())
+		typedef void(*JerkKernelFunction)(const double*, const double*, const double*, const double*, const double*, const double*,
+			const double*, int, double, const int*, int, double*, double*, double*, double*, double*, double*);
+		//! Signature of the single precision row of one target (positions relative to its tile, sums in double)
+		typedef void(*MixedRowFunction)(const float*, const float*, const float*, const float*, int, float, float, float, float, double*);
+
+
+		//! Instruction sets of the kernels
+		enum InstructionSet {
+			SCALAR,
+			AVX2,
+			AVX512
+		};
+
+		//! Target policy: The field is calculated for all bodies (target k is body k)
+		struct AllTargets;
+		//! Target policy: The field is calculated for the listed bodies (target k is body targets[k])
+		struct SubsetTargets;
+		//! Target policy: Same as SubsetTargets, but on the calling thread
+		struct ListTargets;
+
+
+		/**
+		 * \brief Select the best instruction set which is supported by the CPU.
+		 *
+		 * \return Instruction set of the kernels.
+		 */
+		static InstructionSet selectInstructionSet();
+
+
+		/**
+		 * \brief Select the best kernel for the target policy which is supported by the CPU.
+		 *
+		 * \return Kernel implementation.
+		 */
+		template<typename Targets>
+		static KernelFunction selectKernel();
+
+
+		/**
+		 * \brief Select the best field- and jerk-kernel which is supported by the CPU (same instruction set as selectKernel()).
+		 *
+		 * \return Kernel implementation.
+		 */
+		static JerkKernelFunction selectJerkKernel();
+
+
+		/**
+		 * \brief Select the best single precision row which is supported by the CPU (same instruction set as selectKernel()).
+		 *
+		 * \return Row implementation.
+		 */
+		static MixedRowFunction selectMixedRow();
+
+
+		/**
+		 * \brief Scalar implementation (fallback). Same parameters as computeFieldsSubset().
+		 */
+		template<typename Targets>
+		static void computeScalar(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			const int* targets, int cntTargets, double* ax, double* ay, double* az);
+
+
+		/**
+		 * \brief AVX2/FMA implementation with 4 bodies per register. Same parameters as computeFieldsSubset().
+		 */
+		template<typename Targets>
+		static void computeAvx2(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			const int* targets, int cntTargets, double* ax, double* ay, double* az);
+
+
+		/**
+		 * \brief AVX-512 implementation with 8 bodies per register. Same parameters as computeFieldsSubset().
+		 */
+		template<typename Targets>
+		static void computeAvx512(const double* x, const double* y, const double* z, const double* m, int n, double eps,
+			const int* targets, int cntTargets, double* ax, double* ay, double* az);
+
+
+		/**
+		 * \brief Scalar field- and jerk-kernel (fallback). Same parameters as computeFieldsAndJerks().
+		 */
+		static void computeJerksScalar(const double* x, const double* y, const double* z,
+			const double* vx, const double* vy, const double* vz, const double* m, int n, double eps,
+			const int* targets, int cntTargets, double* ax, double* ay, double* az, double* jx, double* jy, double* jz);
+
+
+		/**
+		 * \brief AVX2/FMA field- and jerk-kernel with 4 bodies per register. Same parameters as computeFieldsAndJerks().
+		 */
+		static void computeJerksAvx2(const double* x, const double* y, const double* z,
+			const double* vx, const double* vy, const double* vz, const double* m, int n, double eps,
+			const int* targets, int cntTargets, double* ax, double* ay, double* az, double* jx, double* jy, double* jz);
+
+
+		/**
+		 * \brief AVX-512 field- and jerk-kernel with 8 bodies per register. Same parameters as computeFieldsAndJerks().
+		 */
+		static void computeJerksAvx512(const double* x, const double* y, const double* z,
+			const double* vx, const double* vy, const double* vz, const double* m, int n, double eps,
+			const int* targets, int cntTargets, double* ax, double* ay, double* az, double* jx, double* jy, double* jz);
+
+
+		/**
+		 * \brief Scalar single precision row: Sum the field of all bodies at one target in double precision.
+		 *
+		 * \param x, y, z
+		 *      Positions of all bodies relative to the tile of the target.
+		 * \param m
+		 *      Masses of all bodies.
+		 * \param n
+		 *      Number of bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param xi, yi, zi
+		 *      Position of the target relative to its tile.
+		 * \param sum
+		 *      Output-parameter: Field at the target (x, y, z).
+		 */
+		static void rowMixedScalar(const float* x, const float* y, const float* z, const float* m, int n, float eps,
+			float xi, float yi, float zi, double* sum);
+
+
+		/**
+		 * \brief AVX2/FMA single precision row with 8 bodies per register. Same parameters as rowMixedScalar().
+		 */
+		static void rowMixedAvx2(const float* x, const float* y, const float* z, const float* m, int n, float eps,
+			float xi, float yi, float zi, double* sum);
+
+
+		/**
+		 * \brief AVX-512 single precision row with 16 bodies per register. Same parameters as rowMixedScalar().
+		 */
+		static void rowMixedAvx512(const float* x, const float* y, const float* z, const float* m, int n, float eps,
+			float xi, float yi, float zi, double* sum);
+	};
+}
@@ -0,0 +1,194 @@
+﻿/**
+ * \brief Implementation of the time-sliced jobs which amortize the work that is not needed by the current step.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "JobSystem.h"
+
+#include <osg/Timer>
+
+#include "Profiler.h"
+#include "ThreadBudget.h"
+
+using namespace pbs17;
+
+
+//! Pointer to the only instance of this class.
+JobSystem* JobSystem::_pInstance = nullptr;
+
+//! The jobs are spread over the frames by default
+bool JobSystem::IS_ENABLED = true;
+
+//! 2 ms of a frame of 16 ms
+double JobSystem::BUDGET = 2e-3;
+
+
+/**
+ * \brief Singleton instance of the JobSystem-class.
+ */
+JobSystem* JobSystem::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new JobSystem();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Run a job on the background-workers, its callback is called by the next update() after it's done.
+ *
+ * \param work
+ *      Work to do on a worker (must not throw and must not touch the simulation).
+ * \param done
+ *      Callback on the thread of the simulation (e.g. to hand the result back, can be empty).
+ */
+void JobSystem::submit(const std::function<void()> &work, const std::function<void()> &done) {
+	if (!IS_ENABLED) {
+		work();
+		if (done) done();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		++_cntRunning;
+	}
+
+	ThreadBudget::Instance()->submit(ThreadBudget::BACKGROUND, [this, work, done]() {
+		work();
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_completions.push_back(done);
+		_completed.notify_all();
+	});
+}
+
+
+/**
+ * \brief Run a job in slices on the thread of the simulation (has to be called by it).
+ *
+ * \param slice
+ *      Next part of the work (a fraction of the budget), returns true when the job is done.
+ * \param done
+ *      Callback after the last slice (can be empty).
+ */
+void JobSystem::submitSliced(const std::function<bool()> &slice, const std::function<void()> &done) {
+	if (!IS_ENABLED) {
+		while (!slice()) {}
+		if (done) done();
+		return;
+	}
+
+	SlicedJob job;
+	job.slice = slice;
+	job.done = done;
+	_slicedJobs.push_back(job);
+}
+
+
+/**
+ * \brief Run the callbacks of the finished background-jobs and the slices of the sliced jobs within the
+ *        remaining budget of the frame (called by the simulation between two steps).
+ */
+void JobSystem::update() {
+	// without a main-loop (headless), each update has its own budget
+	unsigned int frame = _cntFrames.load(std::memory_order_relaxed);
+	bool isNewFrame = frame != _lastFrame || frame == 0;
+	if (isNewFrame) {
+		_lastFrame = frame;
+		_spent = 0.0;
+	}
+
+	const osg::Timer* timer = osg::Timer::instance();
+	osg::Timer_t start = timer->tick();
+
+	// the first job of a frame runs also if its slice exceeds the budget, so every job makes progress
+	bool hasWork = true;
+	for (bool isFirst = isNewFrame; hasWork && (isFirst || _spent + timer->delta_s(start, timer->tick()) < BUDGET); isFirst = false) {
+		// the callbacks first, they hand the results back (and may queue the next jobs)
+		hasWork = runCompletion() || runSlice();
+	}
+
+	_spent += timer->delta_s(start, timer->tick());
+	Profiler::Instance()->count(Profiler::PENDING_JOBS, getNumPending());
+}
+
+
+/**
+ * \brief Wait for all background-jobs and do all callbacks and slices (e.g. before the simulation is deleted).
+ */
+void JobSystem::finish() {
+	while (true) {
+		while (runCompletion() || runSlice()) {}
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (_cntRunning == 0) {
+			return;
+		}
+		_completed.wait(lock, [this]() { return !_completions.empty(); });
+	}
+}
+
+
+/**
+ * \brief Get the number of jobs which are not done (including their callbacks).
+ *
+ * \return Number of the background- and the sliced jobs.
+ */
+unsigned int JobSystem::getNumPending() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _cntRunning + static_cast<unsigned int>(_slicedJobs.size());
+}
+
+
+/**
+ * \brief Run the oldest callback of a finished background-job.
+ *
+ * \return False if no background-job is finished.
+ */
+bool JobSystem::runCompletion() {
+	std::function<void()> done;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_completions.empty()) {
+			return false;
+		}
+
+		done = _completions.front();
+		_completions.pop_front();
+	}
+
+	if (done) done();
+
+	// the job is pending until its callback is done (see finish())
+	std::lock_guard<std::mutex> lock(_mutex);
+	--_cntRunning;
+	return true;
+}
+
+
+/**
+ * \brief Run a slice of the oldest sliced job (its callback after the last slice).
+ *
+ * \return False if no sliced job is queued.
+ */
+bool JobSystem::runSlice() {
+	if (_slicedJobs.empty()) {
+		return false;
+	}
+
+	// the slice may queue another sliced job
+	std::function<bool()> slice = _slicedJobs.front().slice;
+	if (slice()) {
+		std::function<void()> done = _slicedJobs.front().done;
+		_slicedJobs.pop_front();
+		if (done) done();
+	}
+
+	return true;
+}
@@ -0,0 +1,182 @@
+﻿/**
+ * \brief Implementation of the time-sliced jobs which amortize the work that is not needed by the current step.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+namespace pbs17 {
+
+	/**
+	 * \brief JobSystem spreads the expensive work which no step waits for (e.g. writing a checkpoint or a file of
+	 * the asset-cache) over the frames, so it does not land in a single frame:
+	 *  - Background-jobs run on the shared low-priority workers (see ThreadBudget::BACKGROUND), their
+	 *    completion-callbacks are handed back to the thread of the simulation.
+	 *  - Sliced jobs run on the thread of the simulation, one short slice after the other as long as the budget
+	 *    of the frame is not used up.
+	 * update() is called by the simulation between two steps, so the callbacks and slices see a consistent state.
+	 * The budget is shared by all steps of a frame (see beginFrame()) and at least the oldest callback or slice runs
+	 * per frame, so no job starves. Without the job-system, the jobs are done immediately by submit().
+	 */
+	class JobSystem {
+	public:
+		/**
+		 * \brief Singleton instance of the JobSystem-class.
+		 */
+		static JobSystem* Instance();
+
+
+		/**
+		 * \brief Run a job on the background-workers, its callback is called by the next update() after it's done.
+		 *
+		 * \param work
+		 *      Work to do on a worker (must not throw and must not touch the simulation).
+		 * \param done
+		 *      Callback on the thread of the simulation (e.g. to hand the result back, can be empty).
+		 */
+		void submit(const std::function<void()> &work, const std::function<void()> &done = std::function<void()>());
+
+
+		/**
+		 * \brief Run a job in slices on the thread of the simulation (has to be called by it).
+		 *
+		 * \param slice
+		 *      Next part of the work (a fraction of the budget), returns true when the job is done.
+		 * \param done
+		 *      Callback after the last slice (can be empty).
+		 */
+		void submitSliced(const std::function<bool()> &slice, const std::function<void()> &done = std::function<void()>());
+
+
+		/**
+		 * \brief Start the budget of a new frame (called by the main-loop once per frame, by any thread).
+		 */
+		void beginFrame() {
+			_cntFrames.fetch_add(1, std::memory_order_relaxed);
+		}
+
+
+		/**
+		 * \brief Run the callbacks of the finished background-jobs and the slices of the sliced jobs within the
+		 *        remaining budget of the frame (called by the simulation between two steps).
+		 */
+		void update();
+
+
+		/**
+		 * \brief Wait for all background-jobs and do all callbacks and slices (e.g. before the simulation is deleted).
+		 */
+		void finish();
+
+
+		/**
+		 * \brief Get the number of jobs which are not done (including their callbacks).
+		 *
+		 * \return Number of the background- and the sliced jobs.
+		 */
+		unsigned int getNumPending() const;
+
+
+		/**
+		 * \brief Enable or disable the job-system (disabled => the jobs are done immediately by submit()).
+		 *
+		 * \param isEnabled
+		 *      True if the jobs are spread over the frames.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Check if the job-system is enabled.
+		 *
+		 * \return True if the jobs are spread over the frames.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+		/**
+		 * \brief Set the time per frame for the callbacks and the slices on the thread of the simulation.
+		 *
+		 * \param budget
+		 *      Budget in milliseconds.
+		 */
+		static void setBudget(double budget) {
+			BUDGET = budget > 0.0 ? budget * 1e-3 : 0.0;
+		}
+
+
+	private:
+		//! True if the jobs are spread over the frames
+		static bool IS_ENABLED;
+		//! Seconds per frame for the callbacks and the slices
+		static double BUDGET;
+
+		/**
+		 * \brief Job which is done in slices by update().
+		 */
+		struct SlicedJob {
+			std::function<bool()> slice;
+			std::function<void()> done;
+		};
+
+		//! Callbacks of the finished background-jobs (in the order of their completion)
+		std::deque<std::function<void()> > _completions;
+		//! Number of background-jobs whose callback has not been called
+		unsigned int _cntRunning = 0;
+		//! Protects the callbacks and the number of running jobs
+		mutable std::mutex _mutex;
+		//! Signaled if a background-job is done
+		std::condition_variable _completed;
+
+		//! Sliced jobs in the order of their submission (only used by the thread of the simulation)
+		std::deque<SlicedJob> _slicedJobs;
+
+		//! Number of started frames (see beginFrame())
+		std::atomic<unsigned int> _cntFrames;
+		//! Frame of the last update()
+		unsigned int _lastFrame = 0;
+		//! Seconds of the budget used by the current frame
+		double _spent = 0.0;
+
+
+		/**
+		 * \brief Run the oldest callback of a finished background-job.
+		 *
+		 * \return False if no background-job is finished.
+		 */
+		bool runCompletion();
+
+
+		/**
+		 * \brief Run a slice of the oldest sliced job (its callback after the last slice).
+		 *
+		 * \return False if no sliced job is queued.
+		 */
+		bool runSlice();
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		JobSystem() : _cntFrames(0) {}
+
+		//! Private copy-constructor to prevent copying the class.
+		JobSystem(JobSystem const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		JobSystem& operator=(JobSystem const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static JobSystem* _pInstance;
+	};
+}
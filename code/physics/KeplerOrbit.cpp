@@ -0,0 +1,104 @@
+﻿/**
+ * \brief Implementation of the closed-form propagation of a body on a Kepler-orbit.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "KeplerOrbit.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace pbs17;
+
+const double KeplerOrbit::TOLERANCE = 1e-12;
+
+
+/**
+ * \brief Move a body along its orbit relative to the central body (Lagrange-coefficients f, g of the
+ *        universal anomaly, which is solved with Newton's method).
+ *
+ * \param mu
+ *      Gravitational parameter of the pair: G * (M + m)
+ * \param position
+ *      Input- and output-parameter: Position relative to the central body.
+ * \param velocity
+ *      Input- and output-parameter: Velocity relative to the central body.
+ * \param dt
+ *      Time-step (can be larger than the period).
+ *
+ * \return False if the anomaly didn't converge (the state is unchanged).
+ */
+bool KeplerOrbit::propagate(double mu, Eigen::Vector3d &position, Eigen::Vector3d &velocity, double dt) {
+	double r0 = position.norm();
+	if (mu <= 0.0 || r0 <= 0.0) {
+		return false;
+	}
+
+	double sqrtMu = std::sqrt(mu);
+	double vr0 = position.dot(velocity) / r0;
+	// reciprocal of the semi-major axis (< 0 => hyperbolic)
+	double alpha = 2.0 / r0 - velocity.squaredNorm() / mu;
+
+	double chi = sqrtMu * std::abs(alpha) * dt;
+	double c, s;
+	bool isConverged = false;
+
+	for (int k = 0; k < MAX_ITERATIONS && !isConverged; ++k) {
+		double z = alpha * chi * chi;
+		stumpff(z, c, s);
+
+		double f = r0 * vr0 / sqrtMu * chi * chi * c + (1.0 - alpha * r0) * chi * chi * chi * s + r0 * chi - sqrtMu * dt;
+		double df = r0 * vr0 / sqrtMu * chi * (1.0 - z * s) + (1.0 - alpha * r0) * chi * chi * c + r0;
+		double step = f / df;
+
+		chi -= step;
+		isConverged = std::abs(step) <= TOLERANCE * std::max(1.0, std::abs(chi));
+	}
+
+	if (!isConverged || !std::isfinite(chi)) {
+		return false;
+	}
+
+	stumpff(alpha * chi * chi, c, s);
+
+	double f = 1.0 - chi * chi / r0 * c;
+	double g = dt - chi * chi * chi / sqrtMu * s;
+	Eigen::Vector3d newPosition = f * position + g * velocity;
+
+	double r = newPosition.norm();
+	double df = sqrtMu / (r * r0) * (alpha * chi * chi * chi * s - chi);
+	double dg = 1.0 - chi * chi / r * c;
+
+	velocity = df * position + dg * velocity;
+	position = newPosition;
+
+	return true;
+}
+
+
+/**
+ * \brief Evaluate the Stumpff-functions C(z) and S(z) (series near z = 0).
+ *
+ * \param z
+ *      Argument: alpha * chi^2
+ * \param c
+ *      Output-parameter: C(z)
+ * \param s
+ *      Output-parameter: S(z)
+ */
+void KeplerOrbit::stumpff(double z, double &c, double &s) {
+	if (z > 1e-6) {
+		double sqrtZ = std::sqrt(z);
+		c = (1.0 - std::cos(sqrtZ)) / z;
+		s = (sqrtZ - std::sin(sqrtZ)) / (z * sqrtZ);
+	} else if (z < -1e-6) {
+		double sqrtZ = std::sqrt(-z);
+		c = (std::cosh(sqrtZ) - 1.0) / -z;
+		s = (std::sinh(sqrtZ) - sqrtZ) / (-z * sqrtZ);
+	} else {
+		c = 0.5 - z / 24.0 + z * z / 720.0;
+		s = 1.0 / 6.0 - z / 120.0 + z * z / 5040.0;
+	}
+}
@@ -0,0 +1,57 @@
+﻿/**
+ * \brief Implementation of the closed-form propagation of a body on a Kepler-orbit.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+
+namespace pbs17 {
+
+	/**
+	 * \brief Two-body orbits in universal variables (elliptic, parabolic and hyperbolic alike), so a body can be moved
+	 *        along its orbit around a central body for any time-step without integrating it.
+	 */
+	class KeplerOrbit {
+	public:
+		/**
+		 * \brief Move a body along its orbit relative to the central body (Lagrange-coefficients f, g of the
+		 *        universal anomaly, which is solved with Newton's method).
+		 *
+		 * \param mu
+		 *      Gravitational parameter of the pair: G * (M + m)
+		 * \param position
+		 *      Input- and output-parameter: Position relative to the central body.
+		 * \param velocity
+		 *      Input- and output-parameter: Velocity relative to the central body.
+		 * \param dt
+		 *      Time-step (can be larger than the period).
+		 *
+		 * \return False if the anomaly didn't converge (the state is unchanged).
+		 */
+		static bool propagate(double mu, Eigen::Vector3d &position, Eigen::Vector3d &velocity, double dt);
+
+
+	private:
+		//! Maximum number of Newton-iterations of the universal anomaly
+		static const int MAX_ITERATIONS = 32;
+		//! Relative tolerance of the universal anomaly
+		static const double TOLERANCE;
+
+
+		/**
+		 * \brief Evaluate the Stumpff-functions C(z) and S(z) (series near z = 0).
+		 *
+		 * \param z
+		 *      Argument: alpha * chi^2
+		 * \param c
+		 *      Output-parameter: C(z)
+		 * \param s
+		 *      Output-parameter: S(z)
+		 */
+		static void stumpff(double z, double &c, double &s);
+	};
+}
@@ -0,0 +1,236 @@
+﻿/**
+ * \brief Functionality for writing the log-messages of all threads on a background-thread.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "Logger.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+using namespace pbs17;
+
+
+//! Singleton-instance
+Logger* Logger::_pInstance = nullptr;
+
+//! Everything which is compiled in is written by default.
+Logger::Level Logger::LEVEL = Logger::LEVEL_DEBUG;
+
+//! About 256 KB of records, more than the messages of a loaded scene.
+const size_t Logger::CAPACITY = 1024;
+
+//! The messages appear on the console within a few milliseconds.
+const unsigned int Logger::SLEEP_TIME = 2000;
+
+
+/**
+ * \brief Constructor of a message.
+ *
+ * \param level
+ *      Level of the message.
+ */
+Logger::Stream::Stream(Level level)
+	: std::ostream(nullptr), _level(level), _buffer(_text, sizeof(_text)) {
+	rdbuf(&_buffer);
+	// same format as the console of the main-program
+	setf(std::ios::fixed);
+	precision(6);
+}
+
+
+/**
+ * \brief Destructor of a message (queues it).
+ */
+Logger::Stream::~Stream() {
+	Logger::Instance()->write(_level, _text, _buffer.length());
+}
+
+
+/**
+ * \brief Private constructor of the logger.
+ */
+Logger::Logger() : _records(new Record[CAPACITY]), _tail(0), _head(0), _cntDropped(0), _isRunning(true) {
+	for (size_t i = 0; i < CAPACITY; ++i) {
+		_records[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+
+/**
+ * \brief Singleton instance of the Logger-class (starts the sink-thread).
+ */
+Logger* Logger::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	// The first message is written by the main-thread, before any other thread is started.
+	if (!_pInstance) {
+		_pInstance = new Logger();
+		_pInstance->start();
+		std::atexit(&Logger::stopAtExit);
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Parse the name of a level (debug, info, warning or error).
+ *
+ * \param name
+ *      Name of the level.
+ * \param level
+ *      Output-parameter: Parsed level.
+ *
+ * \return False if the name is not known.
+ */
+bool Logger::parseLevel(const std::string &name, Level &level) {
+	if (name == "debug") {
+		level = LEVEL_DEBUG;
+	} else if (name == "info") {
+		level = LEVEL_INFO;
+	} else if (name == "warning") {
+		level = LEVEL_WARNING;
+	} else if (name == "error") {
+		level = LEVEL_ERROR;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Start a new sink-thread in a forked child (the thread of the parent does not exist in it).
+ */
+void Logger::restartAfterFork() {
+	// the copy of the parent's instance can't be stopped or joined, it is left to the exit of the child
+	_pInstance = new Logger();
+	_pInstance->start();
+}
+
+
+/**
+ * \brief Queue a message (called by any thread).
+ *
+ * \param level
+ *      Level of the message.
+ * \param text
+ *      Text of the message (without the line-break).
+ * \param length
+ *      Length of the text.
+ */
+void Logger::write(Level level, const char* text, size_t length) {
+	// bounded multi-producer queue: a producer claims a slot by advancing the tail, the sequence of the slot tells
+	// if the sink has already released it
+	size_t position = _tail.load(std::memory_order_relaxed);
+	Record* record;
+
+	while (true) {
+		record = &_records[position & (CAPACITY - 1)];
+		size_t sequence = record->sequence.load(std::memory_order_acquire);
+		std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+
+		if (difference == 0) {
+			if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (difference < 0) {
+			_cntDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		} else {
+			position = _tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	record->level = level;
+	record->length = std::min(length, sizeof(record->text));
+	std::memcpy(record->text, text, record->length);
+	record->sequence.store(position + 1, std::memory_order_release);
+}
+
+
+/**
+ * \brief Main-loop of the sink-thread.
+ */
+void Logger::run() {
+	while (_isRunning.load(std::memory_order_acquire)) {
+		if (!drain()) {
+			OpenThreads::Thread::microSleep(SLEEP_TIME);
+		}
+	}
+
+	// the messages of the last moments before the exit
+	drain();
+}
+
+
+/**
+ * \brief Write the queued messages and stop the sink-thread (at the exit of the program).
+ */
+void Logger::stop() {
+	_isRunning.store(false, std::memory_order_release);
+
+	if (isRunning()) {
+		join();
+	}
+}
+
+
+/**
+ * \brief Write all queued messages to the console.
+ *
+ * \return True if at least one message was written.
+ */
+bool Logger::drain() {
+	bool hasWritten = false;
+	bool hasErrors = false;
+
+	while (true) {
+		Record &record = _records[_head & (CAPACITY - 1)];
+
+		if (record.sequence.load(std::memory_order_acquire) != _head + 1) {
+			break;
+		}
+
+		// the errors go to stderr like the uncaught exceptions, everything else to stdout
+		FILE* stream = record.level == LEVEL_ERROR ? stderr : stdout;
+		fwrite(record.text, 1, record.length, stream);
+		fputc('\n', stream);
+		hasWritten = true;
+		hasErrors = hasErrors || record.level == LEVEL_ERROR;
+
+		record.sequence.store(_head + CAPACITY, std::memory_order_release);
+		++_head;
+	}
+
+	unsigned int cntDropped = _cntDropped.exchange(0, std::memory_order_relaxed);
+	if (cntDropped > 0) {
+		fprintf(stdout, "Dropped %u log-messages\n", cntDropped);
+		hasWritten = true;
+	}
+
+	// one flush per batch instead of one per message
+	if (hasWritten) {
+		fflush(stdout);
+	}
+	if (hasErrors) {
+		fflush(stderr);
+	}
+
+	return hasWritten;
+}
+
+
+/**
+ * \brief Stop the sink-thread of the singleton (registered with atexit).
+ */
+void Logger::stopAtExit() {
+	if (_pInstance) {
+		_pInstance->stop();
+	}
+}
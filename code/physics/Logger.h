@@ -0,0 +1,237 @@
+﻿/**
+ * \brief Functionality for writing the log-messages of all threads on a background-thread.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+#include <OpenThreads/Thread>
+
+
+// lowest level which is compiled in (0 => debug, 1 => info, 2 => warning, 3 => error), see cmake -DPBS17_LOG_LEVEL
+#if !defined(PBS17_LOG_LEVEL)
+#if defined(NDEBUG)
+#define PBS17_LOG_LEVEL 1
+#else
+#define PBS17_LOG_LEVEL 0
+#endif
+#endif
+
+// the message is only formatted if its level is enabled, the levels below PBS17_LOG_LEVEL are removed by the compiler
+#define PBS17_LOG(level, message) \
+	do { \
+		if (pbs17::Logger::isEnabled(level)) { \
+			pbs17::Logger::Stream pbs17LogStream(level); \
+			pbs17LogStream << message; \
+		} \
+	} while (false)
+#define LOG_DEBUG(message) PBS17_LOG(pbs17::Logger::LEVEL_DEBUG, message)
+#define LOG_INFO(message) PBS17_LOG(pbs17::Logger::LEVEL_INFO, message)
+#define LOG_WARNING(message) PBS17_LOG(pbs17::Logger::LEVEL_WARNING, message)
+#define LOG_ERROR(message) PBS17_LOG(pbs17::Logger::LEVEL_ERROR, message)
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Logger passes the messages of all threads (main-loop, physics-thread, OpenMP-threads, ...) to a
+	 * background-thread which writes them to the console. A message is formatted by its thread into a fixed-size
+	 * record and appended to a bounded lock-free ring-buffer, so logging never blocks on the console and never
+	 * allocates. If the sink can't keep up, the messages are dropped (and counted) instead of stalling the caller.
+	 *
+	 * The messages are written with the macros LOG_DEBUG, LOG_INFO, LOG_WARNING and LOG_ERROR, e.g.
+	 * LOG_INFO("Loaded " << n << " objects"). A disabled message costs one comparison (nothing below PBS17_LOG_LEVEL).
+	 */
+	class Logger : public OpenThreads::Thread {
+	public:
+		//! Levels of the messages
+		enum Level {
+			LEVEL_DEBUG = 0,
+			LEVEL_INFO,
+			LEVEL_WARNING,
+			LEVEL_ERROR
+		};
+
+
+		/**
+		 * \brief Stream which formats one message into a record and queues it when it is destroyed.
+		 */
+		class Stream : public std::ostream {
+		public:
+			/**
+			 * \brief Constructor of a message.
+			 *
+			 * \param level
+			 *      Level of the message.
+			 */
+			explicit Stream(Level level);
+
+
+			/**
+			 * \brief Destructor of a message (queues it).
+			 */
+			~Stream();
+
+
+		private:
+			/**
+			 * \brief Buffer which writes into the text of the record (the end of a long message is cut).
+			 */
+			class Buffer : public std::streambuf {
+			public:
+				Buffer(char* text, size_t size) {
+					setp(text, text + size);
+				}
+
+				size_t length() const {
+					return static_cast<size_t>(pptr() - pbase());
+				}
+			};
+
+			//! Level of the message
+			Level _level;
+			//! Text of the message
+			char _text[256];
+			//! Buffer of the stream
+			Buffer _buffer;
+		};
+
+
+		/**
+		 * \brief Singleton instance of the Logger-class (starts the sink-thread).
+		 */
+		static Logger* Instance();
+
+
+		/**
+		 * \brief Check if messages of a level are written.
+		 *
+		 * \param level
+		 *      Level of the message.
+		 *
+		 * \return True if the level is compiled in and not below the level of the command-line.
+		 */
+		static bool isEnabled(Level level) {
+			return level >= PBS17_LOG_LEVEL && level >= LEVEL;
+		}
+
+
+		/**
+		 * \brief Set the lowest level which is written (the levels below PBS17_LOG_LEVEL are never written).
+		 *
+		 * \param level
+		 *      Lowest written level.
+		 */
+		static void setLevel(Level level) {
+			LEVEL = level;
+		}
+
+
+		/**
+		 * \brief Parse the name of a level (debug, info, warning or error).
+		 *
+		 * \param name
+		 *      Name of the level.
+		 * \param level
+		 *      Output-parameter: Parsed level.
+		 *
+		 * \return False if the name is not known.
+		 */
+		static bool parseLevel(const std::string &name, Level &level);
+
+
+		/**
+		 * \brief Start a new sink-thread in a forked child (the thread of the parent does not exist in it).
+		 */
+		static void restartAfterFork();
+
+
+		/**
+		 * \brief Queue a message (called by any thread).
+		 *
+		 * \param level
+		 *      Level of the message.
+		 * \param text
+		 *      Text of the message (without the line-break).
+		 * \param length
+		 *      Length of the text.
+		 */
+		void write(Level level, const char* text, size_t length);
+
+
+		/**
+		 * \brief Main-loop of the sink-thread.
+		 */
+		void run() override;
+
+
+		/**
+		 * \brief Write the queued messages and stop the sink-thread (at the exit of the program).
+		 */
+		void stop();
+
+
+	private:
+		/**
+		 * \brief Formatted message in a slot of the ring-buffer.
+		 */
+		struct Record {
+			//! Number of the push which may use the slot next (the slot is filled if it is one more)
+			std::atomic<size_t> sequence;
+			Level level;
+			size_t length;
+			char text[256];
+		};
+
+
+		//! Singleton-instance
+		static Logger* _pInstance;
+		//! Lowest level which is written
+		static Level LEVEL;
+		//! Number of records of the ring-buffer (a power of two)
+		static const size_t CAPACITY;
+		//! Time in microseconds which the sink sleeps while the ring-buffer is empty
+		static const unsigned int SLEEP_TIME;
+
+		//! Slots of the ring-buffer
+		Record* _records;
+		//! Number of the next push (shared by all producers)
+		std::atomic<size_t> _tail;
+		//! Number of the next pop (only used by the sink)
+		size_t _head;
+		//! Number of messages which were dropped because the ring-buffer was full
+		std::atomic<unsigned int> _cntDropped;
+		//! True as long as the sink-thread should run
+		std::atomic<bool> _isRunning;
+
+
+		/**
+		 * \brief Private constructor of the logger.
+		 */
+		Logger();
+		Logger(const Logger&) = delete;
+		Logger& operator=(const Logger&) = delete;
+
+
+		/**
+		 * \brief Write all queued messages to the console.
+		 *
+		 * \return True if at least one message was written.
+		 */
+		bool drain();
+
+
+		/**
+		 * \brief Stop the sink-thread of the singleton (registered with atexit).
+		 */
+		static void stopAtExit();
+	};
+}
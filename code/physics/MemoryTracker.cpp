@@ -0,0 +1,154 @@
+﻿/**
+ * \brief Functionality for attributing the memory of the program to its subsystems.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "MemoryTracker.h"
+
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "Profiler.h"
+
+using namespace pbs17;
+
+
+//! Nothing is allocated before the static initialization.
+std::atomic<long long> MemoryTracker::BYTES[MemoryTracker::CNT_CATEGORIES];
+
+//! Twice per second at 60 fps (the file of the OS is read).
+const unsigned int MemoryTracker::RESIDENT_INTERVAL = 30;
+
+
+/**
+ * \brief Get the memory of all categories (the simplified levels are part of the models).
+ *
+ * \return Tracked bytes.
+ */
+long long MemoryTracker::getTotal() {
+	long long total = 0;
+
+	for (int c = 0; c < CNT_CATEGORIES; ++c) {
+		if (c != SIMPLIFIED_LEVELS) {
+			total += get(static_cast<Category>(c));
+		}
+	}
+
+	return total;
+}
+
+
+/**
+ * \brief Get the resident memory of the process (Linux, 0 on the other systems).
+ *
+ * \return Resident bytes.
+ */
+long long MemoryTracker::getResidentSize() {
+#if defined(__linux__)
+	// second number of statm: resident pages
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (!file) {
+		return 0;
+	}
+
+	long long cntPages = 0, cntResident = 0;
+	int cntRead = fscanf(file, "%lld %lld", &cntPages, &cntResident);
+	fclose(file);
+
+	return cntRead == 2 ? cntResident * sysconf(_SC_PAGESIZE) : 0;
+#else
+	return 0;
+#endif
+}
+
+
+/**
+ * \brief Count the tracked and the resident memory of the current frame (see Profiler).
+ */
+void MemoryTracker::count() {
+	if (!Profiler::getIsEnabled()) return;
+
+	// only called by the thread which ends the frames
+	static unsigned int cntCalls = 0;
+	static long long resident = 0;
+	if (cntCalls++ % RESIDENT_INTERVAL == 0) {
+		resident = getResidentSize();
+	}
+
+	Profiler::Instance()->count(Profiler::TRACKED_MEMORY, getTotal() / (1024.0 * 1024.0));
+	Profiler::Instance()->count(Profiler::RESIDENT_MEMORY, resident / (1024.0 * 1024.0));
+}
+
+
+/**
+ * \brief Get the breakdown of the memory by the categories.
+ *
+ * \return Lines of the report.
+ */
+std::string MemoryTracker::getReport() {
+	const double MB = 1024.0 * 1024.0;
+	long long total = getTotal();
+	long long resident = getResidentSize();
+
+	std::ostringstream report;
+	report << std::fixed << std::setprecision(1);
+	report << "Memory: " << total / MB << " MB tracked";
+	if (resident > 0) {
+		report << ", " << resident / MB << " MB resident (" << (resident - total) / MB << " MB untracked)";
+	}
+
+	for (int c = 0; c < CNT_CATEGORIES; ++c) {
+		Category category = static_cast<Category>(c);
+		report << "\n  " << std::left << std::setw(18) << getCategoryName(category) << std::right << std::setw(10)
+			<< get(category) / MB << " MB";
+
+		if (category == SIMPLIFIED_LEVELS) {
+			report << " (part of the models)";
+		} else if (category == NODES) {
+			report << " (estimated)";
+		}
+	}
+
+	return report.str();
+}
+
+
+/**
+ * \brief Get the name of a category.
+ *
+ * \param category
+ *      Category of the memory.
+ *
+ * \return Name of the category.
+ */
+const char* MemoryTracker::getCategoryName(Category category) {
+	switch (category) {
+	case MODELS:
+		return "models";
+	case SIMPLIFIED_LEVELS:
+		return "simplified levels";
+	case TEXTURES:
+		return "textures";
+	case HULLS:
+		return "convex-hulls";
+	case HULL_COPIES:
+		return "hull copies";
+	case NODES:
+		return "scene-nodes";
+	case BODIES:
+		return "bodies";
+	case FRAME_ARENAS:
+		return "frame-arenas";
+	case REWIND_KEYFRAMES:
+		return "rewind keyframes";
+	default:
+		return "other";
+	}
+}
@@ -0,0 +1,129 @@
+﻿/**
+ * \brief Functionality for attributing the memory of the program to its subsystems.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief MemoryTracker counts the bytes of each category of memory where it is allocated and released: the
+	 * resource-caches of the models and textures, the shared convex-hulls, the per-object copies of the hulls, the
+	 * arrays of the bodies (see NumaAllocator) and the frame-arenas. The nodes of the scene-graph are estimated once
+	 * the scene is loaded. The categories are only changed by allocations, so the counting costs nothing per frame.
+	 *
+	 * The tracked total and the resident memory of the process are counted by the Profiler (HUD and csv-file), the
+	 * breakdown is logged on demand (key M).
+	 */
+	class MemoryTracker {
+	public:
+		//! Categories of the tracked memory
+		enum Category {
+			MODELS = 0,
+			SIMPLIFIED_LEVELS,
+			TEXTURES,
+			HULLS,
+			HULL_COPIES,
+			NODES,
+			BODIES,
+			FRAME_ARENAS,
+			REWIND_KEYFRAMES,
+			CNT_CATEGORIES
+		};
+
+
+		/**
+		 * \brief Add allocated or released memory to a category (called by any thread).
+		 *
+		 * \param category
+		 *      Category of the memory.
+		 * \param bytes
+		 *      Allocated bytes (negative => released).
+		 */
+		static void add(Category category, long long bytes) {
+			BYTES[category].fetch_add(bytes, std::memory_order_relaxed);
+		}
+
+
+		/**
+		 * \brief Replace the memory of an estimated category.
+		 *
+		 * \param category
+		 *      Category of the memory.
+		 * \param bytes
+		 *      Estimated bytes.
+		 */
+		static void set(Category category, long long bytes) {
+			BYTES[category].store(bytes, std::memory_order_relaxed);
+		}
+
+
+		/**
+		 * \brief Get the memory of a category.
+		 *
+		 * \param category
+		 *      Category of the memory.
+		 *
+		 * \return Tracked bytes.
+		 */
+		static long long get(Category category) {
+			return BYTES[category].load(std::memory_order_relaxed);
+		}
+
+
+		/**
+		 * \brief Get the memory of all categories (the simplified levels are part of the models).
+		 *
+		 * \return Tracked bytes.
+		 */
+		static long long getTotal();
+
+
+		/**
+		 * \brief Get the resident memory of the process (Linux, 0 on the other systems).
+		 *
+		 * \return Resident bytes.
+		 */
+		static long long getResidentSize();
+
+
+		/**
+		 * \brief Count the tracked and the resident memory of the current frame (see Profiler).
+		 */
+		static void count();
+
+
+		/**
+		 * \brief Get the breakdown of the memory by the categories.
+		 *
+		 * \return Lines of the report.
+		 */
+		static std::string getReport();
+
+
+		/**
+		 * \brief Get the name of a category.
+		 *
+		 * \param category
+		 *      Category of the memory.
+		 *
+		 * \return Name of the category.
+		 */
+		static const char* getCategoryName(Category category);
+
+
+	private:
+		//! Tracked bytes of each category
+		static std::atomic<long long> BYTES[CNT_CATEGORIES];
+		//! The resident memory is read from the OS every n-th call of count()
+		static const unsigned int RESIDENT_INTERVAL;
+	};
+}
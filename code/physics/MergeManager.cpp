@@ -0,0 +1,145 @@
+﻿/**
+ * \brief Implementation of the inelastic merging (accretion) of colliding bodies.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#include "MergeManager.h"
+
+#include <cmath>
+#include <algorithm>
+#include <Eigen/Geometry>
+
+#include "../scene/SpaceObject.h"
+#include "../scene/SpaceShip.h"
+
+using namespace pbs17;
+
+const double MergeManager::G = 1.0;
+
+
+/**
+ * \brief Merge the objects of the contacts which are slow enough. The survivors get the combined state.
+ *
+ * \param contacts
+ *      Contacts of the last step.
+ * \param survivors
+ *      Output-parameter: The grown objects are appended (their forces have to be recalculated).
+ * \param absorbed
+ *      Output-parameter: The absorbed objects are appended (deactivated, to be despawned).
+ *
+ * \return True if any objects merged.
+ */
+bool MergeManager::merge(const std::vector<Collision> &contacts, std::vector<SpaceObject*> &survivors, std::vector<SpaceObject*> &absorbed) {
+	unsigned int cntAbsorbed = absorbed.size();
+
+	// in the order of the contacts, an absorbed object is inactive for its later contacts
+	for (unsigned int i = 0; i < contacts.size(); ++i) {
+		SpaceObject* a = contacts[i].getFirstObject();
+		SpaceObject* b = contacts[i].getSecondObject();
+
+		if (!canMerge(a, b)) continue;
+
+		if (b->getMass() > a->getMass()) {
+			std::swap(a, b);
+		}
+
+		absorb(a, b);
+		absorbed.push_back(b);
+		if (std::find(survivors.begin(), survivors.end(), a) == survivors.end()) {
+			survivors.push_back(a);
+		}
+	}
+
+	cntAbsorbed = absorbed.size() - cntAbsorbed;
+	_cntMerges += cntAbsorbed;
+
+	return cntAbsorbed > 0;
+}
+
+
+/**
+ * \brief Check if two objects can merge.
+ *
+ * \param a
+ *      First object of the contact.
+ * \param b
+ *      Second object of the contact.
+ *
+ * \return True if both are active, mergeable and slow enough.
+ */
+bool MergeManager::canMerge(const SpaceObject* a, const SpaceObject* b) const {
+	if (!a->isActive() || !b->isActive() || !a->isMergeable() || !b->isMergeable()) return false;
+
+	// the player is controlled from outside of the simulation
+	if (dynamic_cast<const SpaceShip*>(a) != nullptr || dynamic_cast<const SpaceShip*>(b) != nullptr) return false;
+
+	if (a->getMass() <= 0.0 || b->getMass() <= 0.0) return false;
+
+	double maxVelocity = _mergeVelocity;
+	if (maxVelocity <= 0.0) {
+		maxVelocity = std::sqrt(2.0 * G * (a->getMass() + b->getMass()) / std::max(getRadius(a) + getRadius(b), 1e-9));
+	}
+
+	return (a->getLinearVelocity() - b->getLinearVelocity()).squaredNorm() <= maxVelocity * maxVelocity;
+}
+
+
+/**
+ * \brief Let the survivor absorb the other object (mass, momentum, angular momentum and size).
+ *
+ * \param survivor
+ *      Heavier object (gets the combined state).
+ * \param other
+ *      Lighter object (deactivated).
+ */
+void MergeManager::absorb(SpaceObject* survivor, SpaceObject* other) {
+	double ma = survivor->getMass();
+	double mb = other->getMass();
+	double m = ma + mb;
+
+	Eigen::Vector3d center = (ma * survivor->getPosition() + mb * other->getPosition()) / m;
+	Eigen::Vector3d v = (ma * survivor->getLinearVelocity() + mb * other->getLinearVelocity()) / m;
+
+	osg::Quat qa = survivor->getOrientation();
+	osg::Quat qb = other->getOrientation();
+	Eigen::Matrix3d ra = Eigen::Quaterniond(qa.w(), qa.x(), qa.y(), qa.z()).toRotationMatrix();
+	Eigen::Matrix3d rb = Eigen::Quaterniond(qb.w(), qb.x(), qb.y(), qb.z()).toRotationMatrix();
+
+	// spin of both objects and their orbit around the common center of mass
+	Eigen::Vector3d l = ra * survivor->getMomentOfInertia() * ra.transpose() * survivor->getAngularVelocity()
+		+ rb * other->getMomentOfInertia() * rb.transpose() * other->getAngularVelocity()
+		+ ma * (survivor->getPosition() - center).cross(survivor->getLinearVelocity() - v)
+		+ mb * (other->getPosition() - center).cross(other->getLinearVelocity() - v);
+
+	// same density => the volume grows with the mass, the inertia with mass * size^2
+	double factor = std::cbrt(m / ma);
+	Eigen::Matrix3d inertia = survivor->getMomentOfInertia() * (m / ma) * factor * factor;
+
+	survivor->grow(factor);
+	survivor->setMass(m);
+	survivor->setMomentOfInertia(inertia);
+	survivor->setLinearVelocity(v);
+	survivor->setAngularVelocity(ra * survivor->getInverseMomentOfInertia() * ra.transpose() * l);
+	survivor->setPositionOrientation(center, qa);
+	survivor->setSleeping(false);
+
+	other->setActive(false);
+}
+
+
+/**
+ * \brief Get the radius of an object for the escape-velocity.
+ *
+ * \param object
+ *      Object of a contact.
+ *
+ * \return Mean half-extent of its global AABB.
+ */
+double MergeManager::getRadius(const SpaceObject* object) {
+	osg::BoundingBox aabb = object->getAABB();
+	osg::Vec3 extent = aabb._max - aabb._min;
+
+	return (extent.x() + extent.y() + extent.z()) / 6.0;
+}
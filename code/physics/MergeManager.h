@@ -0,0 +1,113 @@
+﻿/**
+ * \brief Implementation of the inelastic merging (accretion) of colliding bodies.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "Collision.h"
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief The manager which merges the bodies of slow contacts into one body, so the number of bodies shrinks over
+	 * time. The heavier body absorbs the lighter one: mass, momentum and angular momentum (around the common center of
+	 * mass) are conserved, the survivor grows with a constant density and its moment of inertia is scaled with it.
+	 *
+	 * Two bodies merge if both are mergeable (scene-json: "merge") and their relative velocity is below the merge-
+	 * velocity (or below their mutual escape-velocity if no merge-velocity is set). The absorbed bodies are despawned.
+	 */
+	class MergeManager {
+	public:
+		/**
+		 * \brief Merge the objects of the contacts which are slow enough. The survivors get the combined state.
+		 *
+		 * \param contacts
+		 *      Contacts of the last step.
+		 * \param survivors
+		 *      Output-parameter: The grown objects are appended (their forces have to be recalculated).
+		 * \param absorbed
+		 *      Output-parameter: The absorbed objects are appended (deactivated, to be despawned).
+		 *
+		 * \return True if any objects merged.
+		 */
+		bool merge(const std::vector<Collision> &contacts, std::vector<SpaceObject*> &survivors, std::vector<SpaceObject*> &absorbed);
+
+
+		/**
+		 * \brief Set the relative velocity below which two objects merge.
+		 *
+		 * \param velocity
+		 *      Relative velocity: unit = m/s (<= 0.0 => the mutual escape-velocity of the objects)
+		 */
+		void setMergeVelocity(const double velocity) {
+			_mergeVelocity = velocity;
+		}
+
+
+		/**
+		 * \brief Get the number of absorbed objects.
+		 *
+		 * \return Merges since the start.
+		 */
+		unsigned int getNumMerges() const {
+			return _cntMerges;
+		}
+
+
+	private:
+		//! Relative velocity below which two objects merge (<= 0.0 => the mutual escape-velocity)
+		double _mergeVelocity = 0.0;
+		//! Number of absorbed objects
+		unsigned int _cntMerges = 0;
+
+		//! Same gravitational constant as NBodyManager (for the escape-velocity)
+		static const double G;
+
+
+		/**
+		 * \brief Check if two objects can merge.
+		 *
+		 * \param a
+		 *      First object of the contact.
+		 * \param b
+		 *      Second object of the contact.
+		 *
+		 * \return True if both are active, mergeable and slow enough.
+		 */
+		bool canMerge(const SpaceObject* a, const SpaceObject* b) const;
+
+
+		/**
+		 * \brief Let the survivor absorb the other object (mass, momentum, angular momentum and size).
+		 *
+		 * \param survivor
+		 *      Heavier object (gets the combined state).
+		 * \param other
+		 *      Lighter object (deactivated).
+		 */
+		static void absorb(SpaceObject* survivor, SpaceObject* other);
+
+
+		/**
+		 * \brief Get the radius of an object for the escape-velocity.
+		 *
+		 * \param object
+		 *      Object of a contact.
+		 *
+		 * \return Mean half-extent of its global AABB.
+		 */
+		static double getRadius(const SpaceObject* object);
+	};
+}
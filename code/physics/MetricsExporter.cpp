@@ -0,0 +1,215 @@
+﻿/**
+ * \brief Implementation of the exporter which serves the counters of the simulation to a monitoring-system.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "MetricsExporter.h"
+
+#include <cstring>
+#include <sstream>
+
+#include "Socket.h"
+#include "Profiler.h"
+#include "MemoryTracker.h"
+#include "Logger.h"
+
+using namespace pbs17;
+
+//! Seconds over which the step-rate is averaged
+const double MetricsExporter::RATE_INTERVAL = 1.0;
+
+
+/**
+ * \brief Write the help- and type-line of a metric.
+ *
+ * \param out
+ *      Output-parameter: Body of the response.
+ * \param name
+ *      Name of the metric.
+ * \param type
+ *      Type of the metric (counter or gauge).
+ * \param help
+ *      Description of the metric.
+ */
+static void writeHeader(std::ostream &out, const char* name, const char* type, const char* help) {
+	out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+}
+
+
+/**
+ * \brief Constructor of the exporter (listens on the port, the thread has to be started).
+ *
+ * \param port
+ *      TCP-port of the HTTP-endpoint.
+ */
+MetricsExporter::MetricsExporter(unsigned short port) {
+	_listener = Socket::listen(port);
+
+	if (_listener < 0) {
+		LOG_ERROR("Port " << port << " can't be opened for the metrics!");
+	} else {
+		LOG_INFO("Serving the metrics on port " << port << " (/metrics)");
+	}
+}
+
+
+/**
+ * \brief Destructor of the exporter (stops the thread).
+ */
+MetricsExporter::~MetricsExporter() {
+	stop();
+
+	if (_listener >= 0) {
+		Socket::close(_listener);
+	}
+}
+
+
+/**
+ * \brief Main-loop of the thread.
+ */
+void MetricsExporter::run() {
+	_lastRate = osg::Timer::instance()->tick();
+
+	while (_isRunning.load(std::memory_order_relaxed)) {
+		updateRate();
+
+		int socket = _listener >= 0 ? Socket::accept(_listener) : -1;
+		if (socket >= 0) {
+			serve(socket);
+		} else {
+			OpenThreads::Thread::microSleep(ACCEPT_INTERVAL);
+		}
+	}
+}
+
+
+/**
+ * \brief Stop the thread and wait until it is finished.
+ */
+void MetricsExporter::stop() {
+	_isRunning = false;
+
+	if (isRunning()) {
+		join();
+	}
+}
+
+
+/**
+ * \brief Format the metrics in the text-format of Prometheus.
+ *
+ * \return Body of the response.
+ */
+std::string MetricsExporter::format() const {
+	Profiler* profiler = Profiler::Instance();
+	std::ostringstream out;
+	out.precision(9);
+
+	writeHeader(out, "pbs17_steps_total", "counter", "Simulated steps.");
+	out << "pbs17_steps_total " << _steps.load(std::memory_order_relaxed) << "\n";
+	writeHeader(out, "pbs17_step_rate", "gauge", "Simulated steps per second (averaged over the last second).");
+	out << "pbs17_step_rate " << _stepRate << "\n";
+	writeHeader(out, "pbs17_bodies", "gauge", "Simulated bodies.");
+	out << "pbs17_bodies " << _cntBodies.load(std::memory_order_relaxed) << "\n";
+
+	// CNT_PHASES => total time of the frames
+	writeHeader(out, "pbs17_phase_seconds_total", "counter", "Time of the phases of all frames.");
+	for (int phase = 0; phase <= Profiler::CNT_PHASES; ++phase) {
+		Profiler::Phase p = static_cast<Profiler::Phase>(phase);
+		out << "pbs17_phase_seconds_total{phase=\"" << Profiler::getPhaseName(p) << "\"} " << profiler->getTotal(p) << "\n";
+	}
+	writeHeader(out, "pbs17_phase_seconds", "gauge", "Percentiles of the phases over the rolling window of frames.");
+	for (int phase = 0; phase <= Profiler::CNT_PHASES; ++phase) {
+		Profiler::Phase p = static_cast<Profiler::Phase>(phase);
+		out << "pbs17_phase_seconds{phase=\"" << Profiler::getPhaseName(p) << "\",quantile=\"0.5\"} " << profiler->getPercentile(p, 50.0) << "\n";
+		out << "pbs17_phase_seconds{phase=\"" << Profiler::getPhaseName(p) << "\",quantile=\"0.99\"} " << profiler->getPercentile(p, 99.0) << "\n";
+	}
+
+	writeHeader(out, "pbs17_frame_counter", "gauge", "Counters of the last frame (e.g. contactsResolved, energyDrift).");
+	for (int counter = 0; counter < Profiler::CNT_COUNTERS; ++counter) {
+		Profiler::Counter c = static_cast<Profiler::Counter>(counter);
+		out << "pbs17_frame_counter{counter=\"" << Profiler::getCounterName(c) << "\"} " << profiler->getCounter(c) << "\n";
+	}
+
+	// the simplified levels are a part of the models, so the categories don't add up to the total
+	writeHeader(out, "pbs17_memory_bytes", "gauge", "Tracked memory per subsystem.");
+	for (int category = 0; category < MemoryTracker::CNT_CATEGORIES; ++category) {
+		MemoryTracker::Category c = static_cast<MemoryTracker::Category>(category);
+		out << "pbs17_memory_bytes{subsystem=\"" << MemoryTracker::getCategoryName(c) << "\"} " << MemoryTracker::get(c) << "\n";
+	}
+	writeHeader(out, "pbs17_resident_memory_bytes", "gauge", "Resident memory of the process (0 => not available).");
+	out << "pbs17_resident_memory_bytes " << MemoryTracker::getResidentSize() << "\n";
+
+	return out.str();
+}
+
+
+/**
+ * \brief Update the step-rate once the rate-interval has passed.
+ */
+void MetricsExporter::updateRate() {
+	const osg::Timer* timer = osg::Timer::instance();
+	osg::Timer_t now = timer->tick();
+	double elapsed = timer->delta_s(_lastRate, now);
+
+	if (elapsed < RATE_INTERVAL) {
+		return;
+	}
+
+	// a restored checkpoint may start with fewer steps
+	unsigned long steps = _steps.load(std::memory_order_relaxed);
+	_stepRate = steps >= _lastSteps ? (steps - _lastSteps) / elapsed : 0.0;
+	_lastSteps = steps;
+	_lastRate = now;
+}
+
+
+/**
+ * \brief Answer the request of a scrape and close its connection.
+ *
+ * \param socket
+ *      Connected socket of the scrape.
+ */
+void MetricsExporter::serve(int socket) {
+	// only the request-line is needed, a scrape which sends nothing is dropped after the timeout
+	Socket::setTimeout(socket, REQUEST_TIMEOUT);
+
+	std::string request;
+	char buffer[512];
+	while (request.size() < MAX_REQUEST && request.find("\r\n") == std::string::npos) {
+		long received = Socket::receive(socket, buffer, sizeof(buffer));
+		if (received <= 0) break;
+
+		request.append(buffer, static_cast<size_t>(received));
+	}
+
+	std::string status;
+	std::string body;
+	if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+		status = "200 OK";
+		body = format();
+	} else {
+		status = "404 Not Found";
+		body = "Only /metrics is served.\n";
+	}
+
+	std::ostringstream response;
+	response << "HTTP/1.0 " << status << "\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " << body.size()
+		<< "\r\nConnection: close\r\n\r\n" << body;
+
+	std::string data = response.str();
+	const char* bytes = data.data();
+	size_t size = data.size();
+	while (size > 0) {
+		long sent = Socket::send(socket, bytes, size);
+		if (sent <= 0) break;
+
+		bytes += sent;
+		size -= static_cast<size_t>(sent);
+	}
+
+	Socket::close(socket);
+}
@@ -0,0 +1,127 @@
+﻿/**
+ * \brief Implementation of the exporter which serves the counters of the simulation to a monitoring-system.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <OpenThreads/Thread>
+#include <osg/Timer>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Serves the instrumentation over HTTP in the text-format of Prometheus ("GET /metrics"): the simulated
+	 * steps and their rate, the number of bodies, the sums and percentiles of the phases (see Profiler), the counters
+	 * of the last frame (e.g. the contacts and the energy-drift) and the memory per subsystem (see MemoryTracker).
+	 *
+	 * The simulation only stores the number of steps and bodies in atomics, everything else is read by the thread of
+	 * the exporter when a scrape arrives, so a slow or stuck monitoring-system never blocks the simulation.
+	 */
+	class MetricsExporter : public OpenThreads::Thread {
+	public:
+		/**
+		 * \brief Constructor of the exporter (listens on the port, the thread has to be started).
+		 *
+		 * \param port
+		 *      TCP-port of the HTTP-endpoint.
+		 */
+		explicit MetricsExporter(unsigned short port);
+
+
+		/**
+		 * \brief Destructor of the exporter (stops the thread).
+		 */
+		~MetricsExporter();
+
+
+		/**
+		 * \brief Check if the port could be opened.
+		 *
+		 * \return True if the metrics can be scraped.
+		 */
+		bool isListening() const {
+			return _listener >= 0;
+		}
+
+
+		/**
+		 * \brief Main-loop of the thread.
+		 */
+		void run() override;
+
+
+		/**
+		 * \brief Stop the thread and wait until it is finished.
+		 */
+		void stop();
+
+
+		/**
+		 * \brief Store the progress of the simulation (never waits). Has to be called from the simulating thread
+		 *        after each step.
+		 *
+		 * \param step
+		 *      Number of the step.
+		 * \param cntBodies
+		 *      Number of simulated bodies.
+		 */
+		void publish(unsigned long step, unsigned int cntBodies) {
+			_steps.store(step, std::memory_order_relaxed);
+			_cntBodies.store(cntBodies, std::memory_order_relaxed);
+		}
+
+
+		/**
+		 * \brief Format the metrics in the text-format of Prometheus.
+		 *
+		 * \return Body of the response.
+		 */
+		std::string format() const;
+
+	private:
+		//! Listening socket (-1 => not listening)
+		int _listener = -1;
+
+		//! Progress of the simulation (written by the simulating thread)
+		std::atomic<unsigned long> _steps { 0 };
+		std::atomic<unsigned int> _cntBodies { 0 };
+
+		//! Steps per second over the last rate-interval (only used by the exporter-thread)
+		double _stepRate = 0.0;
+		unsigned long _lastSteps = 0;
+		osg::Timer_t _lastRate = 0;
+
+		//! True as long as the thread should run
+		std::atomic<bool> _isRunning { true };
+
+		//! Microseconds which the thread sleeps if no scrape is waiting
+		static const unsigned int ACCEPT_INTERVAL = 100000;
+		//! Seconds over which the step-rate is averaged
+		static const double RATE_INTERVAL;
+		//! Milliseconds which a scrape may take to send its request
+		static const unsigned int REQUEST_TIMEOUT = 1000;
+		//! Maximal size of a request (the rest is ignored)
+		static const unsigned int MAX_REQUEST = 4096;
+
+
+		/**
+		 * \brief Update the step-rate once the rate-interval has passed.
+		 */
+		void updateRate();
+
+
+		/**
+		 * \brief Answer the request of a scrape and close its connection.
+		 *
+		 * \param socket
+		 *      Connected socket of the scrape.
+		 */
+		void serve(int socket);
+	};
+}
@@ -0,0 +1,130 @@
+﻿/**
+ * \brief Implementation of the Morton-codes (Z-curve) which sort positions by their spatial locality.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-10
+ */
+
+#include "MortonCode.h"
+
+#include <algorithm>
+
+using namespace pbs17;
+
+
+/**
+ * \brief Get the code of a position.
+ *
+ * \param position
+ *      Position which is encoded.
+ * \param origin
+ *      Lower corner of the encoded region.
+ * \param scale
+ *      Cells per unit per axis (the region has 2^21 cells per axis).
+ *
+ * \return Morton-code of the cell of the position.
+ */
+uint64_t MortonCode::encode(const Eigen::Vector3d &position, const Eigen::Vector3d &origin, const Eigen::Vector3d &scale) {
+	const double maxCell = static_cast<double>((1 << BITS_PER_AXIS) - 1);
+	uint64_t code = 0;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		double cell = std::max(0.0, std::min((position(axis) - origin(axis)) * scale(axis), maxCell));
+		code |= spreadBits(static_cast<uint64_t>(cell)) << axis;
+	}
+
+	return code;
+}
+
+
+/**
+ * \brief Sort the codes with a stable radix-sort (equal codes keep their order).
+ *
+ * \param codes
+ *      Input- and output-parameter: Codes which are sorted.
+ * \param order
+ *      Output-parameter: Index of the code before the sort at each position (overwritten).
+ * \param tmpCodes, tmpOrder
+ *      Buffers of the sort (reused by the caller, so nothing is allocated in each step).
+ */
+void MortonCode::sort(std::vector<uint64_t> &codes, std::vector<int> &order, std::vector<uint64_t> &tmpCodes, std::vector<int> &tmpOrder) {
+	unsigned int n = codes.size();
+
+	order.resize(n);
+	for (unsigned int i = 0; i < n; ++i) {
+		order[i] = i;
+	}
+	tmpCodes.resize(n);
+	tmpOrder.resize(n);
+
+	// 8 passes of 8 bits (least significant first), the passes in which all codes have the same digit are skipped
+	for (int shift = 0; shift < 3 * BITS_PER_AXIS; shift += 8) {
+		unsigned int offsets[257] = { 0 };
+		for (unsigned int i = 0; i < n; ++i) {
+			++offsets[((codes[i] >> shift) & 0xff) + 1];
+		}
+
+		if (n == 0 || offsets[((codes[0] >> shift) & 0xff) + 1] == n) {
+			continue;
+		}
+
+		for (int digit = 0; digit < 256; ++digit) {
+			offsets[digit + 1] += offsets[digit];
+		}
+
+		for (unsigned int i = 0; i < n; ++i) {
+			unsigned int target = offsets[(codes[i] >> shift) & 0xff]++;
+			tmpCodes[target] = codes[i];
+			tmpOrder[target] = order[i];
+		}
+
+		codes.swap(tmpCodes);
+		order.swap(tmpOrder);
+	}
+}
+
+
+/**
+ * \brief Count the leading zero-bits of a 64 bit value.
+ *
+ * \param value
+ *      Value which is checked.
+ *
+ * \return Leading zeros (64 for 0).
+ */
+int MortonCode::countLeadingZeros(uint64_t value) {
+	if (value == 0) {
+		return 64;
+	}
+
+#if defined(__GNUC__)
+	return __builtin_clzll(value);
+#else
+	int count = 0;
+	while (!(value & (static_cast<uint64_t>(1) << 63))) {
+		value <<= 1;
+		++count;
+	}
+	return count;
+#endif
+}
+
+
+/**
+ * \brief Insert two zero-bits between each of the lower 21 bits.
+ *
+ * \param value
+ *      Quantized coordinate.
+ *
+ * \return Spread bits of the coordinate.
+ */
+uint64_t MortonCode::spreadBits(uint64_t value) {
+	value &= 0x1fffff;
+	value = (value | value << 32) & 0x1f00000000ffffULL;
+	value = (value | value << 16) & 0x1f0000ff0000ffULL;
+	value = (value | value << 8) & 0x100f00f00f00f00fULL;
+	value = (value | value << 4) & 0x10c30c30c30c30c3ULL;
+	value = (value | value << 2) & 0x1249249249249249ULL;
+
+	return value;
+}
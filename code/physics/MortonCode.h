@@ -0,0 +1,76 @@
+﻿/**
+ * \brief Implementation of the Morton-codes (Z-curve) which sort positions by their spatial locality.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-10
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <vector>
+#include <stdint.h>
+
+namespace pbs17 {
+
+	/**
+	 * \brief Morton-codes interleave the bits of the quantized coordinates (21 bits per axis), so sorting the codes
+	 *        orders the positions along a Z-curve. A common prefix of two codes is a common octree-cell.
+	 */
+	class MortonCode {
+	public:
+		//! Bits per axis (3 * 21 = 63 bits of a code)
+		static const int BITS_PER_AXIS = 21;
+
+
+		/**
+		 * \brief Get the code of a position.
+		 *
+		 * \param position
+		 *      Position which is encoded.
+		 * \param origin
+		 *      Lower corner of the encoded region.
+		 * \param scale
+		 *      Cells per unit per axis (the region has 2^21 cells per axis).
+		 *
+		 * \return Morton-code of the cell of the position.
+		 */
+		static uint64_t encode(const Eigen::Vector3d &position, const Eigen::Vector3d &origin, const Eigen::Vector3d &scale);
+
+
+		/**
+		 * \brief Sort the codes with a stable radix-sort (equal codes keep their order).
+		 *
+		 * \param codes
+		 *      Input- and output-parameter: Codes which are sorted.
+		 * \param order
+		 *      Output-parameter: Index of the code before the sort at each position (overwritten).
+		 * \param tmpCodes, tmpOrder
+		 *      Buffers of the sort (reused by the caller, so nothing is allocated in each step).
+		 */
+		static void sort(std::vector<uint64_t> &codes, std::vector<int> &order, std::vector<uint64_t> &tmpCodes, std::vector<int> &tmpOrder);
+
+
+		/**
+		 * \brief Count the leading zero-bits of a 64 bit value.
+		 *
+		 * \param value
+		 *      Value which is checked.
+		 *
+		 * \return Leading zeros (64 for 0).
+		 */
+		static int countLeadingZeros(uint64_t value);
+
+
+	private:
+		/**
+		 * \brief Insert two zero-bits between each of the lower 21 bits.
+		 *
+		 * \param value
+		 *      Quantized coordinate.
+		 *
+		 * \return Spread bits of the coordinate.
+		 */
+		static uint64_t spreadBits(uint64_t value);
+	};
+}
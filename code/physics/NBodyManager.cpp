@@ -8,286 +8,1873 @@
 #include "NBodyManager.h"
 
 #include <math.h>
+#include <algorithm>
+#include <limits>
 
 #if defined(_OPENMP)
 #include <omp.h>
 #endif
 
-#include "../scene/SpaceObject.h"
+#include "BodyState.h"
+#include "FrameArena.h"
+#include "GravityKernel.h"
+#include "KeplerOrbit.h"
+#include "Profiler.h"
+#include "TaskGraph.h"
 
 using namespace pbs17;
 
+//! Maximum tidal acceleration by the other bodies relative to the mutual acceleration of a binary
+const double NBodyManager::BINARY_PERTURBATION = 0.1;
 
-NBodyManager::NBodyManager() {}
 
+NBodyManager::NBodyManager() {
+	// all bodies of the near-field and of the search for the binaries are binned (no far-reaching ones)
+	_nearFieldGrid.setThreshold(std::numeric_limits<double>::max());
+	_binaryGrid.setThreshold(std::numeric_limits<double>::max());
+}
+
+
+/**
+ * \brief Copy the state which is carried from one step to the next (forces, resting steps and levels of the
+ *        block-timesteps) into a checkpoint.
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param state
+ *      Output-parameter: State of the checkpoint (one value per body).
+ */
+void NBodyManager::saveState(const BodyState &bodies, BinaryScene::State &state) const {
+	unsigned int n = bodies.size();
+
+	state.forces.clear();
+	if (_hasForces && _forces.size() == n) {
+		state.forces.resize(3 * n);
+		for (unsigned int i = 0; i < n; ++i) {
+			// the checkpoint has no binaries, so it gets the full forces
+			Eigen::Vector3d force = _forces[i];
+			if (_binaryPartners.size() == n && _binaryPartners[i] >= 0) {
+				force += getMutualForce(bodies, i, _binaryPartners[i]);
+			}
+
+			state.forces[3 * i] = force(0);
+			state.forces[3 * i + 1] = force(1);
+			state.forces[3 * i + 2] = force(2);
+		}
+	}
+
+	// the unused states are stored with the values of a fresh start
+	state.restingSteps.assign(n, 0);
+	if (_restingSteps.size() == n) {
+		std::copy(_restingSteps.begin(), _restingSteps.end(), state.restingSteps.begin());
+	}
+
+	state.timestepLevels.assign(n, -1);
+	if (_timestepLevels.size() == n) {
+		std::copy(_timestepLevels.begin(), _timestepLevels.end(), state.timestepLevels.begin());
+	}
+}
+
+
+/**
+ * \brief Reorder the state which is carried from one step to the next in the same way as the bodies
+ *        (see BodyState::permute()).
+ *
+ * \param order
+ *      Old index of the body at each new index.
+ */
+void NBodyManager::permuteState(const std::vector<int> &order) {
+	BodyState::permuteArray(_forces, order);
+	BodyState::permuteArray(_jerks, order);
+	BodyState::permuteArray(_restingSteps, order);
+	BodyState::permuteArray(_timestepLevels, order);
+	BodyState::permuteArray(_isOnRails, order);
+	BodyState::permuteArray(_farForces, order);
+	BodyState::permuteArray(_farJerks, order);
+	BodyState::permuteArray(_farTimes, order);
+	BodyState::permuteArray(_binaryPartners, order);
+
+	// the added bodies and the partners of the binaries are kept by their index
+	std::vector<int> newIndex(order.size());
+	for (unsigned int k = 0; k < order.size(); ++k) {
+		newIndex[order[k]] = k;
+	}
+	for (unsigned int k = 0; k < _changedBodies.size(); ++k) {
+		_changedBodies[k] = newIndex[_changedBodies[k]];
+	}
+	for (unsigned int k = 0; k < _binaryPartners.size(); ++k) {
+		if (_binaryPartners[k] >= 0) {
+			_binaryPartners[k] = newIndex[_binaryPartners[k]];
+		}
+	}
+
+	// the cells of the grids and the leaves of the tree refer to the old indices
+	_spatialGrid.invalidate();
+	_nearFieldGrid.invalidate();
+	_binaryGrid.invalidate();
+	_barnesHutTree.invalidate();
+}
+
+
+/**
+ * \brief Drop the state which is carried from one step to the next, e.g. after bodies were added or removed
+ *        (the forces are recomputed by the next step).
+ */
+void NBodyManager::resetState() {
+	_forces.clear();
+	_jerks.clear();
+	_hasForces = false;
+	_changedBodies.clear();
+	_restingSteps.clear();
+	_timestepLevels.clear();
+	_isOnRails.clear();
+	_farForces.clear();
+	_binaryPartners.clear();
+
+	// the cells of the grids and the leaves of the tree refer to the old indices
+	_spatialGrid.invalidate();
+	_nearFieldGrid.invalidate();
+	_binaryGrid.invalidate();
+	_barnesHutTree.invalidate();
+}
+
+
+/**
+ * \brief Extend the state which is carried from one step to the next by the last body after it was added
+ *        (see BodyState::add()), its force is calculated by the next step.
+ *
+ * \param bodies
+ *      State of all bodies (with the new body).
+ */
+void NBodyManager::addBody(const BodyState &bodies) {
+	unsigned int n = bodies.size();
+
+	// the arrays which don't belong to the other bodies are recomputed anyway
+	if (_forces.size() + 1 == n) {
+		_forces.push_back(Eigen::Vector3d::Zero());
+		_changedBodies.push_back(n - 1);
+	}
+	if (_restingSteps.size() + 1 == n) {
+		_restingSteps.push_back(0);
+	}
+	if (_timestepLevels.size() + 1 == n) {
+		_timestepLevels.push_back(_maxTimestepLevel);
+	}
+	if (_isOnRails.size() + 1 == n) {
+		_isOnRails.push_back(0);
+	}
+	if (_binaryPartners.size() + 1 == n) {
+		_binaryPartners.push_back(-1);
+	}
+	// the far-field of the new body is calculated by the next full recalculation, its jerk with all others
+	_farForces.clear();
+	_jerks.clear();
+
+	_spatialGrid.addBody(bodies, G);
+	_barnesHutTree.invalidate();
+}
+
+
+/**
+ * \brief Remove a body from the state which is carried from one step to the next in the same way as
+ *        BodyState::remove().
+ *
+ * \param i
+ *      Index of the removed body.
+ * \param bodies
+ *      State of all bodies (without the removed body).
+ */
+void NBodyManager::removeBody(unsigned int i, const BodyState &bodies) {
+	unsigned int n = bodies.size();
+
+	if (_forces.size() == n + 1) {
+		BodyState::removeFromArray(_forces, i);
+	}
+	if (_restingSteps.size() == n + 1) {
+		BodyState::removeFromArray(_restingSteps, i);
+	}
+	if (_timestepLevels.size() == n + 1) {
+		BodyState::removeFromArray(_timestepLevels, i);
+	}
+	if (_isOnRails.size() == n + 1) {
+		BodyState::removeFromArray(_isOnRails, i);
+	}
+	if (_binaryPartners.size() == n + 1) {
+		// the force of the partner already misses the removed body
+		if (_binaryPartners[i] >= 0) {
+			_binaryPartners[_binaryPartners[i]] = -1;
+		}
+
+		BodyState::removeFromArray(_binaryPartners, i);
+		std::replace(_binaryPartners.begin(), _binaryPartners.end(), static_cast<int>(n), static_cast<int>(i));
+	}
+	// the bodies have lost the attraction of the removed one
+	_farForces.clear();
+	_jerks.clear();
+
+	// the last body has been moved to the index
+	_changedBodies.erase(std::remove(_changedBodies.begin(), _changedBodies.end(), static_cast<int>(i)), _changedBodies.end());
+	std::replace(_changedBodies.begin(), _changedBodies.end(), static_cast<int>(n), static_cast<int>(i));
+
+	_spatialGrid.removeBody(i);
+	_barnesHutTree.invalidate();
+}
+
+
+/**
+ * \brief Recalculate the force of a body by the next step after its mass or its position was changed
+ *        from outside of the integration (e.g. by a merge).
+ *
+ * \param i
+ *      Index of the changed body.
+ */
+void NBodyManager::changeBody(unsigned int i) {
+	if (std::find(_changedBodies.begin(), _changedBodies.end(), static_cast<int>(i)) == _changedBodies.end()) {
+		_changedBodies.push_back(i);
+	}
+
+	// the masses of the cells, the far-fields and the jerks are outdated
+	_spatialGrid.invalidate();
+	_farForces.clear();
+	_jerks.clear();
+}
+
+
+/**
+ * \brief Restore the state which is carried from one step to the next from a checkpoint.
+ *
+ * \param state
+ *      State of the checkpoint (without forces => they are recomputed by the next step).
+ */
+void NBodyManager::restoreState(const BinaryScene::State &state) {
+	unsigned int n = state.sleeping.size();
+
+	_forces.resize(state.forces.size() / 3);
+	for (unsigned int i = 0; i < _forces.size(); ++i) {
+		_forces[i] = Eigen::Vector3d(state.forces[3 * i], state.forces[3 * i + 1], state.forces[3 * i + 2]);
+	}
+	_hasForces = !_forces.empty();
+	_farForces.clear();
+	_jerks.clear();
+	_binaryPartners.clear();
+
+	_restingSteps.assign(state.restingSteps.begin(), state.restingSteps.end());
+
+	// levels of -1 => the block-timesteps were not used
+	if (std::find(state.timestepLevels.begin(), state.timestepLevels.end(), -1) == state.timestepLevels.end()) {
+		_timestepLevels.assign(state.timestepLevels.begin(), state.timestepLevels.end());
+	} else {
+		_timestepLevels.clear();
+	}
+
+	if (_restingSteps.size() != n) {
+		_restingSteps.clear();
+	}
+}
+
+
+void NBodyManager::simulateStep(double dt, BodyState &bodies) {
+	int cntSpaceObj = bodies.size();
+	_forceTime += dt;
+
+	// only the added (or changed) bodies get new forces, the reused ones miss the change of their attraction for this step
+	if (!_changedBodies.empty()) {
+		if (_hasForces && _forces.size() == static_cast<unsigned int>(cntSpaceObj)) {
+			computeForcesActive(bodies, _changedBodies, _forces);
+		}
+		_changedBodies.clear();
+	}
+
+	selectActiveBodies(dt, bodies);
+	selectRailBodies(bodies);
+	selectBinaries(bodies);
+
+	if (_useBlockTimesteps) {
+		simulateBlockStep(dt, bodies);
+	} else if (_integrator == SEMI_IMPLICIT_EULER) {
+		updateForcesAndKick(dt, bodies, true);
+	} else if (_integrator == YOSHIDA) {
+		// 4th-order composition of three leapfrog-steps (drift-kick-drift-...-drift)
+		const double cbrt2 = pow(2.0, 1.0 / 3.0);
+		const double w1 = 1.0 / (2.0 - cbrt2);
+		const double w0 = -cbrt2 * w1;
+		const double c[4] = { 0.5 * w1, 0.5 * (w0 + w1), 0.5 * (w0 + w1), 0.5 * w1 };
+		const double d[3] = { w1, w0, w1 };
+
+		for (int k = 0; k < 3; ++k) {
+			drift(c[k] * dt, bodies);
+			updateForcesAndKick(d[k] * dt, bodies, false);
+		}
+		drift(c[3] * dt, bodies);
+
+		// the forces belong to an intermediate position and cannot be reused
+		_hasForces = false;
+	} else if (_integrator == WISDOM_HOLMAN) {
+		simulateWisdomHolmanStep(dt, bodies);
+	} else if (_integrator == HERMITE) {
+		simulateHermiteStep(dt, bodies);
+	} else {
+		// leapfrog (kick-drift-kick) and velocity-verlet reuse the forces of the last step
+		if (!_hasForces || _forces.size() != static_cast<unsigned int>(cntSpaceObj)) {
+			computeForces(bodies, _forces);
+		}
+
+		if (_integrator == LEAPFROG && isKickFused(bodies)) {
+			kickAndDrift(0.5 * dt, dt, bodies);
+		} else if (_integrator == LEAPFROG) {
+			kick(0.5 * dt, bodies);
+			drift(dt, bodies);
+		} else {
+			// x(t + dt) = x(t) + v(t) * dt + 0.5 * a(t) * dt^2
+			int cntActive = _activeBodies.size();
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+			for (int k = 0; k < cntActive; ++k) {
+				int i = _activeBodies[k];
+				Eigen::Vector3d a = _forces[i] / bodies.m[i];
+				bodies.setPosition(i, bodies.getPosition(i) + dt * bodies.getLinearVelocity(i) + (0.5 * dt * dt) * a);
+				bodies.setLinearVelocity(i, bodies.getLinearVelocity(i) + (0.5 * dt) * a);
+			}
+		}
+
+		updateForcesAndKick(0.5 * dt, bodies, false);
+		_hasForces = true;
+	}
+
+	if (!_railBodies.empty()) {
+		moveOnRails(dt, bodies);
+	}
+
+	rotate(dt, bodies);
+
+	if (_useSleeping && !_useBlockTimesteps) {
+		updateRestingBodies(dt, bodies);
+	}
+}
+
+
+/**
+ * \brief Simulate a substep between two steps with the forces of the last evaluation (semi-implicit euler),
+ *        so the contacts can be resolved more often than the forces are calculated. The bodies which were
+ *        integrated by the last step are integrated, the bodies on rails stay on their orbits.
+ *
+ * \param dt
+ *      Time difference of the substep.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::simulateSubstep(double dt, BodyState &bodies) {
+	int cntSpaceObj = bodies.size();
+
+	// the bodies were added or removed since the last step
+	if (_forces.size() != static_cast<unsigned int>(cntSpaceObj)) {
+		simulateStep(dt, bodies);
+		return;
+	}
+
+	if (!_changedBodies.empty()) {
+		computeForcesActive(bodies, _changedBodies, _forces);
+		_changedBodies.clear();
+	}
+
+	// the indices of the last step are still valid (nothing is spawned between the substeps), the bodies which
+	// fell asleep by the last step stay where they are
+	_activeBodies.erase(std::remove_if(_activeBodies.begin(), _activeBodies.end(), [&bodies](int i) {
+		return bodies.sleeping[i] != 0;
+	}), _activeBodies.end());
+
+	for (unsigned int i = 0; i < _binaryPartners.size(); ++i) {
+		if (_binaryPartners[i] >= 0 && bodies.sleeping[i] != 0) {
+			dissolveBinary(i, bodies);
+		}
+	}
+
+	if (!_railBodies.empty()) {
+		_centralPosition = bodies.getPosition(_centralBody);
+		_centralVelocity = bodies.getLinearVelocity(_centralBody);
+	}
+
+	kick(dt, bodies);
+	drift(dt, bodies);
+	_forceTime += dt;
+
+	if (!_railBodies.empty()) {
+		moveOnRails(dt, bodies);
+	}
+
+	rotate(dt, bodies);
+}
+
+
+/**
+ * \brief Convert the name of a gravity-solver (direct, spatialGrid, barnesHut, particleMesh, gpu, fmm, gpuBarnesHut) to its value.
+ *
+ * \param name
+ *      Name of the solver as used in the scene-json and on the command-line.
+ * \param solver
+ *      Parsed solver (unchanged if the name is unknown).
+ *
+ * \return True if the name is known.
+ */
+bool NBodyManager::parseGravitySolver(const std::string &name, GravitySolver &solver) {
+	if (name == "direct") {
+		solver = DIRECT;
+	} else if (name == "spatialGrid") {
+		solver = SPATIAL_GRID;
+	} else if (name == "barnesHut") {
+		solver = BARNES_HUT;
+	} else if (name == "particleMesh") {
+		solver = PARTICLE_MESH;
+	} else if (name == "gpu") {
+		solver = GPU;
+	} else if (name == "fmm") {
+		solver = FAST_MULTIPOLE;
+	} else if (name == "gpuBarnesHut") {
+		solver = GPU_BARNES_HUT;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Convert the name of an integrator (euler, leapfrog, velocityVerlet, yoshida, wisdomHolman, hermite) to its value.
+ *
+ * \param name
+ *      Name of the integrator as used in the scene-json and on the command-line.
+ * \param integrator
+ *      Parsed integrator (unchanged if the name is unknown).
+ *
+ * \return True if the name is known.
+ */
+bool NBodyManager::parseIntegrator(const std::string &name, Integrator &integrator) {
+	if (name == "euler") {
+		integrator = SEMI_IMPLICIT_EULER;
+	} else if (name == "leapfrog") {
+		integrator = LEAPFROG;
+	} else if (name == "velocityVerlet") {
+		integrator = VELOCITY_VERLET;
+	} else if (name == "yoshida") {
+		integrator = YOSHIDA;
+	} else if (name == "wisdomHolman") {
+		integrator = WISDOM_HOLMAN;
+	} else if (name == "hermite") {
+		integrator = HERMITE;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Calculate the forces with the selected gravity-solver.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param forces
+ *      Resulting force per space-object (resized).
+ */
+void NBodyManager::computeForces(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces) {
+	Profiler::ScopedTimer timer(Profiler::FORCES);
+	forces.assign(bodies.size(), Eigen::Vector3d(0.0, 0.0, 0.0));
+
+	if (_gravitySolver == BARNES_HUT) {
+		computeForcesBarnesHut(bodies, forces);
+	} else if (_gravitySolver == SPATIAL_GRID) {
+		computeForcesSpatialGrid(bodies, forces);
+	} else if (_gravitySolver == PARTICLE_MESH) {
+		computeForcesParticleMesh(bodies, forces);
+	} else if (_gravitySolver == FAST_MULTIPOLE) {
+		computeForcesFastMultipole(bodies, forces);
+	} else if (_gravitySolver == GPU_BARNES_HUT) {
+		computeForcesGpuBarnesHut(bodies, forces);
+	} else {
+		computeForcesDirect(bodies, forces);
+	}
+
+	if (_binaryPartners.size() == bodies.size()) {
+		for (unsigned int i = 0; i < _binaryPartners.size(); ++i) {
+			if (_binaryPartners[i] >= 0) {
+				forces[i] -= getMutualForce(bodies, i, _binaryPartners[i]);
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Calculate the gravitational potential of all bodies with the selected gravity-solver at the same
+ *        approximation as its forces (the tree, the grid or the mesh are rebuilt from the current positions). The
+ *        fast multipole method has no potential in its expansions, the octree with the same opening angle is used.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param phi
+ *      Output-parameter: Potential per body (including G, resized). The potential energy is sum(m_i * phi_i) / 2.
+ */
+void NBodyManager::computePotentials(const BodyState &bodies, std::vector<double> &phi) {
+	int cntSpaceObj = bodies.size();
+	phi.assign(cntSpaceObj, 0.0);
+
+	if (_gravitySolver == BARNES_HUT || _gravitySolver == FAST_MULTIPOLE || _gravitySolver == GPU_BARNES_HUT) {
+		std::vector<Eigen::Vector3d> positions(cntSpaceObj);
+		for (int i = 0; i < cntSpaceObj; ++i) {
+			positions[i] = bodies.getPosition(i);
+		}
+
+		_barnesHutTree.update(positions, bodies.m.data());
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+		for (int i = 0; i < cntSpaceObj; ++i) {
+			phi[i] = _barnesHutTree.computePotential(i, EPS);
+		}
+	} else if (_gravitySolver == SPATIAL_GRID) {
+		_spatialGrid.update(bodies, G);
+		_spatialGrid.computePotentials(bodies, EPS, phi);
+	} else if (_gravitySolver == PARTICLE_MESH) {
+		_particleMesh.computePotentials(bodies, EPS, phi);
+	} else {
+		// the GPU-solvers have no potential-kernel, the all-pairs sum (or the tree) is done on the CPU
+		GravityKernel::computePotentials(bodies.x.data(), bodies.y.data(), bodies.z.data(), bodies.m.data(), cntSpaceObj, EPS, phi.data());
+	}
+
+	for (int i = 0; i < cntSpaceObj; ++i) {
+		phi[i] *= G;
+	}
+}
+
+
+/**
+ * \brief Calculate the forces only for the given bodies. All bodies are used as sources.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param active
+ *      Indices of the bodies for which the forces are calculated.
+ * \param forces
+ *      Resulting force per space-object (only the active ones are overwritten).
+ */
+void NBodyManager::computeForcesActive(const BodyState &bodies, const std::vector<int> &active, std::vector<Eigen::Vector3d> &forces) {
+	Profiler::ScopedTimer timer(Profiler::FORCES);
+	int cntSpaceObj = bodies.size();
+	int cntActive = active.size();
+
+	if (cntActive == cntSpaceObj) {
+		computeForces(bodies, forces);
+		return;
+	}
+
+	if (_gravitySolver == GPU_BARNES_HUT) {
+		// the warps traverse the tree for all bodies, only the forces of the active ones are kept
+		std::vector<Eigen::Vector3d> allForces(cntSpaceObj);
+		computeForcesGpuBarnesHut(bodies, allForces);
+
+		for (int k = 0; k < cntActive; ++k) {
+			forces[active[k]] = allForces[active[k]];
+		}
+	} else if (_gravitySolver == BARNES_HUT) {
+		std::vector<Eigen::Vector3d> positions(cntSpaceObj);
+		for (int i = 0; i < cntSpaceObj; ++i) {
+			positions[i] = bodies.getPosition(i);
+		}
+
+		_barnesHutTree.update(positions, bodies.m.data());
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+		for (int k = 0; k < cntActive; ++k) {
+			int i = active[k];
+			forces[i] = (G * bodies.m[i]) * _barnesHutTree.computeField(i, EPS);
+		}
+	} else {
+		std::vector<double> ax(cntSpaceObj), ay(cntSpaceObj), az(cntSpaceObj);
+
+		if (_gravitySolver == SPATIAL_GRID) {
+			// the cells are traversed as a whole, so the grid calculates the field for all bodies
+			_spatialGrid.update(bodies, G);
+			_spatialGrid.computeFields(bodies, EPS, ax, ay, az);
+		} else if (_gravitySolver == PARTICLE_MESH) {
+			// the mesh is solved as a whole as well
+			_particleMesh.computeFields(bodies, EPS, ax, ay, az);
+		} else if (_gravitySolver == FAST_MULTIPOLE) {
+			// the expansions are shifted down the whole tree
+			_fastMultipole.computeFields(bodies, EPS, ax, ay, az);
+		} else if (_gravitySolver != GPU || !_gpuGravity.computeFieldsSubset(bodies.x.data(), bodies.y.data(), bodies.z.data(),
+			bodies.m.data(), cntSpaceObj, EPS, active.data(), cntActive, ax.data(), ay.data(), az.data())) {
+			GravityKernel::computeFieldsSubset(bodies.x.data(), bodies.y.data(), bodies.z.data(), bodies.m.data(), cntSpaceObj, EPS,
+				active.data(), cntActive, ax.data(), ay.data(), az.data());
+		}
+
+		for (int k = 0; k < cntActive; ++k) {
+			int i = active[k];
+			forces[i] = (G * bodies.m[i]) * Eigen::Vector3d(ax[i], ay[i], az[i]);
+		}
+	}
+
+	removeBinaryForces(bodies, active, forces);
+}
+
+
+/**
+ * \brief Calculate the forces of the bodies which are integrated in the current step (_activeBodies).
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::updateForces(const BodyState &bodies) {
+	if (isForceReused()) {
+		updateForcesReused(bodies);
+	} else if (_forces.size() != bodies.size()) {
+		computeForces(bodies, _forces);
+	} else {
+		computeForcesActive(bodies, _activeBodies, _forces);
+	}
+}
+
+
+/**
+ * \brief Same as updateForces(), but the full forces are only recalculated every _forceReuseInterval steps.
+ *        In between, the forces are the extrapolated far-field plus the exact near-field.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::updateForcesReused(const BodyState &bodies) {
+	unsigned int n = bodies.size();
+	bool isFull = _forces.size() != n || _farForces.size() != n || ++_stepsSinceFullForces >= _forceReuseInterval;
+
+	// bodies which get a full force (their far-field is refreshed)
+	std::vector<int> refreshed;
+
+	if (isFull) {
+		if (_forces.size() != n) {
+			computeForces(bodies, _forces);
+
+			refreshed.resize(n);
+			for (unsigned int i = 0; i < n; ++i) {
+				refreshed[i] = i;
+			}
+		} else {
+			computeForcesActive(bodies, _activeBodies, _forces);
+			refreshed = _activeBodies;
+		}
+
+		if (_farForces.size() != n) {
+			_farForces.assign(n, Eigen::Vector3d::Zero());
+			_farJerks.assign(n, Eigen::Vector3d::Zero());
+			_farTimes.assign(n, -1.0);
+		}
+
+		_stepsSinceFullForces = 0;
+		_fullForcesTime = _forceTime;
+	} else {
+		// the bodies which missed the last full recalculation (e.g. they were sleeping) are not extrapolated
+		for (unsigned int k = 0; k < _activeBodies.size(); ++k) {
+			if (_farTimes[_activeBodies[k]] < _fullForcesTime) {
+				refreshed.push_back(_activeBodies[k]);
+			}
+		}
+
+		if (!refreshed.empty()) {
+			computeForcesActive(bodies, refreshed, _forces);
+		}
+	}
+
+	std::vector<Eigen::Vector3d> nearForces;
+	computeNearForces(bodies, nearForces);
+
+	if (!isFull) {
+		int cntActive = _activeBodies.size();
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+		for (int k = 0; k < cntActive; ++k) {
+			int i = _activeBodies[k];
+
+			if (_farTimes[i] >= _fullForcesTime) {
+				_forces[i] = _farForces[i] + (_forceTime - _farTimes[i]) * _farJerks[i] + nearForces[i];
+			}
+		}
+	}
+
+	// the error of the extrapolation is measured against the new far-field
+	double maxError = 0.0;
+
+	for (unsigned int k = 0; k < refreshed.size(); ++k) {
+		int i = refreshed[k];
+		Eigen::Vector3d farForce = _forces[i] - nearForces[i];
+		double elapsed = _forceTime - _farTimes[i];
+
+		if (_farTimes[i] >= 0.0 && elapsed > 0.0) {
+			Eigen::Vector3d predicted = _farForces[i] + elapsed * _farJerks[i];
+			double norm = farForce.norm();
+
+			if (norm > 0.0) {
+				maxError = std::max(maxError, (predicted - farForce).norm() / norm);
+			}
+
+			_farJerks[i] = (farForce - _farForces[i]) / elapsed;
+		} else {
+			_farJerks[i].setZero();
+		}
+
+		_farForces[i] = farForce;
+		_farTimes[i] = _forceTime;
+	}
+
+	if (isFull) {
+		Profiler::Instance()->count(Profiler::FORCE_REUSE_ERROR, maxError);
+	}
+}
+
+
+/**
+ * \brief Calculate the near-field forces of all bodies (see setNearFieldRadius()).
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param forces
+ *      Output-parameter: Near-field force per body (resized, zero without a near-field).
+ */
+void NBodyManager::computeNearForces(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces) {
+	int cntSpaceObj = bodies.size();
+	forces.assign(cntSpaceObj, Eigen::Vector3d::Zero());
+
+	if (_nearFieldRadius <= 0.0) {
+		return;
+	}
+
+	Profiler::ScopedTimer timer(Profiler::FORCES);
+
+	// the cells are only re-sorted if a body changed its cell
+	_nearFieldGrid.update(bodies, G);
+
+	std::vector<double> ax, ay, az;
+	_nearFieldGrid.computeNearFields(bodies, EPS, _nearFieldRadius, ax, ay, az);
+
+	for (int i = 0; i < cntSpaceObj; ++i) {
+		forces[i] = (G * bodies.m[i]) * Eigen::Vector3d(ax[i], ay[i], az[i]);
+	}
+}
+
+
+/**
+ * \brief Calculate the forces of the integrated bodies (_activeBodies) and kick their velocities, optionally
+ *        followed by a drift of the positions. The Barnes-Hut solver overlaps the phases with a task-graph.
+ *
+ * \param h
+ *      Time-step of the kick (and of the drift).
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param isDrifted
+ *      True to drift the positions after the kick (semi-implicit euler).
+ */
+void NBodyManager::updateForcesAndKick(double h, BodyState &bodies, bool isDrifted) {
+	int cntSpaceObj = bodies.size();
+
+	if (!_useTaskGraph || _gravitySolver != BARNES_HUT || _forces.size() != static_cast<unsigned int>(cntSpaceObj) || isForceReused()
+		|| isUsingBinaries()) {
+		if (isKickFused(bodies)) {
+			updateForcesAndKickFused(h, bodies, isDrifted);
+			return;
+		}
+
+		updateForces(bodies);
+		kick(h, bodies);
+		if (isDrifted) {
+			drift(h, bodies);
+		}
+		return;
+	}
+
+	// the kicks are overlapped with the forces, so they are measured together
+	Profiler::ScopedTimer timer(Profiler::FORCES);
+	TaskGraph graph;
+
+	int build = graph.addTask([this, &bodies, cntSpaceObj]() {
+		std::vector<Eigen::Vector3d> positions(cntSpaceObj);
+		for (int i = 0; i < cntSpaceObj; ++i) {
+			positions[i] = bodies.getPosition(i);
+		}
+
+		_barnesHutTree.update(positions, bodies.m.data());
+	});
+
+	// the tree keeps its own copy of the positions, so a chunk can be drifted while the others are traversing it
+	int cntActive = _activeBodies.size();
+	std::vector<int> forceChunks = graph.addChunks(0, cntActive, TASK_GRAIN_SIZE, [this, &bodies](int first, int last) {
+		for (int k = first; k < last; ++k) {
+			int i = _activeBodies[k];
+			_forces[i] = (G * bodies.m[i]) * _barnesHutTree.computeField(i, EPS);
+		}
+	}, std::vector<int>(1, build));
+
+	for (unsigned int c = 0; c < forceChunks.size(); ++c) {
+		int first = c * TASK_GRAIN_SIZE;
+		int last = std::min(first + TASK_GRAIN_SIZE, cntActive);
+
+		graph.addTask([this, &bodies, h, isDrifted, first, last]() {
+			for (int k = first; k < last; ++k) {
+				int i = _activeBodies[k];
+				Eigen::Vector3d a = _forces[i] / bodies.m[i];
+				bodies.setLinearVelocity(i, bodies.getLinearVelocity(i) + h * a);
+
+				if (isDrifted) {
+					bodies.setPosition(i, bodies.getPosition(i) + h * bodies.getLinearVelocity(i));
+				}
+			}
+		}, std::vector<int>(1, forceChunks[c]));
+	}
+
+	graph.run();
+}
+
+
+/**
+ * \brief Check if the forces of the current solver can be fused with the integration (see setUseFusedKick()).
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ *
+ * \return True if updateForcesAndKickFused() and kickAndDrift() are used.
+ */
+bool NBodyManager::isKickFused(const BodyState &bodies) const {
+	bool isPerBody = _gravitySolver == BARNES_HUT || (_gravitySolver == DIRECT && !_useSymmetricForces && !_useMixedPrecision);
+	return _useFusedKick && isPerBody && _forces.size() == bodies.size() && !isForceReused() && !isUsingBinaries();
+}
+
+
+/**
+ * \brief Same as updateForcesAndKick(), but each chunk of integrated bodies is kicked (and drifted) on the
+ *        thread which just accumulated its forces (see setUseFusedKick()).
+ *
+ * \param h
+ *      Time-step of the kick (and of the drift).
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param isDrifted
+ *      True to drift the positions after the kick (semi-implicit euler).
+ */
+void NBodyManager::updateForcesAndKickFused(double h, BodyState &bodies, bool isDrifted) {
+	// the kicks are fused into the forces, so they are measured together
+	Profiler::ScopedTimer timer(Profiler::FORCES);
+	int cntSpaceObj = bodies.size();
+	int cntActive = _activeBodies.size();
+	bool isTree = _gravitySolver == BARNES_HUT;
+
+	// the sources must not move while the other chunks are summing: the tree keeps its own copy of the positions,
+	// the direct kernel reads a copy only if the chunks are drifted
+	FrameVector<double> x, y, z;
+	const double *px = bodies.x.data();
+	const double *py = bodies.y.data();
+	const double *pz = bodies.z.data();
+
+	if (isTree) {
+		std::vector<Eigen::Vector3d> positions(cntSpaceObj);
+		for (int i = 0; i < cntSpaceObj; ++i) {
+			positions[i] = bodies.getPosition(i);
+		}
+
+		_barnesHutTree.update(positions, bodies.m.data());
+	} else if (isDrifted) {
+		x.assign(bodies.x.begin(), bodies.x.end());
+		y.assign(bodies.y.begin(), bodies.y.end());
+		z.assign(bodies.z.begin(), bodies.z.end());
+		px = x.data();
+		py = y.data();
+		pz = z.data();
+	}
+
+	// the kernel writes the field at the index of each target, so the chunks share the arrays
+	FrameVector<double> ax(isTree ? 0 : cntSpaceObj), ay(isTree ? 0 : cntSpaceObj), az(isTree ? 0 : cntSpaceObj);
+	int cntChunks = (cntActive + TASK_GRAIN_SIZE - 1) / TASK_GRAIN_SIZE;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (int c = 0; c < cntChunks; ++c) {
+		int first = c * TASK_GRAIN_SIZE;
+		int last = std::min(first + TASK_GRAIN_SIZE, cntActive);
+
+		if (!isTree) {
+			GravityKernel::computeFieldsList(px, py, pz, bodies.m.data(), cntSpaceObj, EPS, _activeBodies.data() + first, last - first,
+				ax.data(), ay.data(), az.data());
+		}
+
+		for (int k = first; k < last; ++k) {
+			int i = _activeBodies[k];
+			Eigen::Vector3d a = isTree ? G * _barnesHutTree.computeField(i, EPS) : G * Eigen::Vector3d(ax[i], ay[i], az[i]);
+
+			// the forces are still stored for the opening kick of the next step
+			_forces[i] = bodies.m[i] * a;
+			bodies.setLinearVelocity(i, bodies.getLinearVelocity(i) + h * a);
+
+			if (isDrifted) {
+				bodies.setPosition(i, bodies.getPosition(i) + h * bodies.getLinearVelocity(i));
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Wake the sleeping bodies which are moved (by contacts or the player) or whose field got stronger,
+ *        and collect the bodies which are integrated in the current step.
+ *
+ * \param dt
+ *      Time difference since between the last frames.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::selectActiveBodies(double dt, BodyState &bodies) {
+	int cntSpaceObj = bodies.size();
+	_activeBodies.clear();
+
+	if (!_useSleeping || _useBlockTimesteps) {
+		for (int i = 0; i < cntSpaceObj; ++i) {
+			bodies.sleeping[i] = 0;
+			_activeBodies.push_back(i);
+		}
+
+		_restingSteps.assign(cntSpaceObj, 0);
+		return;
+	}
+
+	if (_restingSteps.size() != static_cast<unsigned int>(cntSpaceObj)) {
+		_restingSteps.assign(cntSpaceObj, 0);
+	}
+
+	// the forces of the sleeping bodies are only recalculated periodically
+	bool checkField = ++_stepsSinceFieldCheck >= SLEEP_STEPS && _forces.size() == static_cast<unsigned int>(cntSpaceObj);
+	if (checkField) {
+		computeForces(bodies, _forces);
+		_stepsSinceFieldCheck = 0;
+	}
+
+	for (int i = 0; i < cntSpaceObj; ++i) {
+		if (bodies.sleeping[i]) {
+			// a visual spin does not change the state of the body
+			bool isSpinning = !bodies.visualSpin[i] && bodies.getAngularVelocity(i).norm() > _sleepVelocity;
+			bool isMoving = bodies.getLinearVelocity(i).norm() > _sleepVelocity || isSpinning;
+			bool isAccelerated = checkField && _forces[i].norm() / bodies.m[i] * dt > _sleepVelocity;
+
+			if (!isMoving && !isAccelerated) continue;
+
+			bodies.sleeping[i] = 0;
+		}
+
+		// woken up by a contact since the last step
+		if (_restingSteps[i] >= SLEEP_STEPS) {
+			_restingSteps[i] = 0;
+		}
+
+		_activeBodies.push_back(i);
+	}
+}
+
+
+/**
+ * \brief Move the active bodies outside of the inner zone to the rails (see setRails()). The bodies which
+ *        come back from the rails get new forces.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::selectRailBodies(const BodyState &bodies) {
+	int cntSpaceObj = bodies.size();
+	_railBodies.clear();
+
+	if (_isOnRails.size() != static_cast<unsigned int>(cntSpaceObj)) {
+		_isOnRails.assign(cntSpaceObj, 0);
+	}
+
+	if (_railsRadius <= 0.0 || _useBlockTimesteps || cntSpaceObj == 0) {
+		std::fill(_isOnRails.begin(), _isOnRails.end(), 0);
+		return;
+	}
+
+	_centralBody = static_cast<int>(std::max_element(bodies.m.begin(), bodies.m.end()) - bodies.m.begin());
+	_centralPosition = bodies.getPosition(_centralBody);
+	_centralVelocity = bodies.getLinearVelocity(_centralBody);
+
+	double radiusSq = _railsRadius * _railsRadius;
+	std::vector<int> returned;
+	unsigned int cntActive = 0;
+
+	for (unsigned int k = 0; k < _activeBodies.size(); ++k) {
+		int i = _activeBodies[k];
+		bool isOuter = i != _centralBody && (bodies.getPosition(i) - _railsCenter).squaredNorm() > radiusSq;
+
+		if (isOuter) {
+			_railBodies.push_back(i);
+		} else {
+			if (_isOnRails[i]) {
+				returned.push_back(i);
+			}
+			_activeBodies[cntActive++] = i;
+		}
+	}
+	_activeBodies.resize(cntActive);
+
+	std::fill(_isOnRails.begin(), _isOnRails.end(), 0);
+	for (unsigned int k = 0; k < _railBodies.size(); ++k) {
+		_isOnRails[_railBodies[k]] = 1;
+	}
+
+	// the reused forces of the returned bodies belong to the step at which they left the inner zone
+	if (!returned.empty() && _hasForces && _forces.size() == static_cast<unsigned int>(cntSpaceObj)) {
+		computeForcesActive(bodies, returned, _forces);
+	}
+}
+
+
+/**
+ * \brief Detect the binaries among the integrated bodies (see setBinaryRadius()) and move the forces of
+ *        the formed and dissolved pairs on each other out of, or back into, the current forces.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::selectBinaries(const BodyState &bodies) {
+	int cntSpaceObj = bodies.size();
+	std::vector<int> partners(cntSpaceObj, -1);
 
-void NBodyManager::simulateStep(double dt, std::vector<SpaceObject *> &spaceObjects) {
-	int cntSpaceObj = spaceObjects.size();
+	if (_binaryPartners.size() != static_cast<unsigned int>(cntSpaceObj)) {
+		_binaryPartners.assign(cntSpaceObj, -1);
+	}
 
-	// initialize the forces
-	std::vector<Eigen::Vector3d> forces(cntSpaceObj);
-	for (int i = 0; i < cntSpaceObj; ++i) {
-		forces[i] = Eigen::Vector3d(0.0, 0.0, 0.0);
+	// the forces belong to the current positions if they were calculated for all bodies
+	bool hasForces = _forces.size() == static_cast<unsigned int>(cntSpaceObj);
+
+	if (isUsingBinaries() && cntSpaceObj > 1) {
+		_binaryGrid.update(bodies, G);
+
+		std::vector<char> isActive(cntSpaceObj, 0);
+		for (unsigned int k = 0; k < _activeBodies.size(); ++k) {
+			isActive[_activeBodies[k]] = 1;
+		}
+
+		// nearest integrated neighbour within the radius (the cells are at least as large as the radius)
+		const Eigen::Vector3i &resolution = _binaryGrid.getResolution();
+		const std::vector<int> &cellStarts = _binaryGrid.getCellStarts();
+		const std::vector<int> &cellBodies = _binaryGrid.getCellBodies();
+		int cntActive = _activeBodies.size();
+		std::vector<int> nearest(cntSpaceObj, -1);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+		for (int k = 0; k < cntActive; ++k) {
+			int i = _activeBodies[k];
+			int cell = _binaryGrid.getCell(i);
+			if (cell < 0) continue;
+
+			int cx = cell % resolution(0);
+			int cy = (cell / resolution(0)) % resolution(1);
+			int cz = cell / (resolution(0) * resolution(1));
+			double minDistance2 = _binaryRadius * _binaryRadius;
+			Eigen::Vector3d position = bodies.getPosition(i);
+
+			for (int iz = std::max(cz - 1, 0); iz <= std::min(cz + 1, resolution(2) - 1); ++iz) {
+				for (int iy = std::max(cy - 1, 0); iy <= std::min(cy + 1, resolution(1) - 1); ++iy) {
+					for (int ix = std::max(cx - 1, 0); ix <= std::min(cx + 1, resolution(0) - 1); ++ix) {
+						int neighbour = ix + resolution(0) * (iy + resolution(1) * iz);
+
+						for (int l = cellStarts[neighbour]; l < cellStarts[neighbour + 1]; ++l) {
+							int j = cellBodies[l];
+							if (j == i || !isActive[j]) continue;
+
+							double distance2 = (bodies.getPosition(j) - position).squaredNorm();
+							if (distance2 < minDistance2) {
+								minDistance2 = distance2;
+								nearest[i] = j;
+							}
+						}
+					}
+				}
+			}
+		}
+
+		for (int k = 0; k < cntActive; ++k) {
+			int i = _activeBodies[k];
+			int j = nearest[i];
+			if (j < i || nearest[j] != i) continue;
+
+			double mass = bodies.m[i] + bodies.m[j];
+			if (bodies.m[i] <= 0.0 || bodies.m[j] <= 0.0) continue;
+
+			// bound relative orbit
+			Eigen::Vector3d r = bodies.getPosition(i) - bodies.getPosition(j);
+			Eigen::Vector3d v = bodies.getLinearVelocity(i) - bodies.getLinearVelocity(j);
+			double distance = r.norm();
+			if (0.5 * v.squaredNorm() - G * mass / distance >= 0.0) continue;
+
+			// the other bodies (the forces without the pair on each other) barely pull the pair apart
+			if (hasForces) {
+				Eigen::Vector3d forceI = _forces[i];
+				Eigen::Vector3d forceJ = _forces[j];
+				if (_binaryPartners[i] >= 0) forceI += getMutualForce(bodies, i, _binaryPartners[i]);
+				if (_binaryPartners[j] >= 0) forceJ += getMutualForce(bodies, j, _binaryPartners[j]);
+
+				Eigen::Vector3d tidal = (forceI - getMutualForce(bodies, i, j)) / bodies.m[i]
+					- (forceJ - getMutualForce(bodies, j, i)) / bodies.m[j];
+				if (tidal.norm() > BINARY_PERTURBATION * G * mass / (distance * distance)) continue;
+			}
+
+			partners[i] = j;
+			partners[j] = i;
+		}
 	}
 
-	if (_useSpatialGrid) {
+	// move the forces of the changed pairs (the cached far-fields contain the old ones)
+	if (partners != _binaryPartners) {
 		for (int i = 0; i < cntSpaceObj; ++i) {
-			SpaceObject* curObject = spaceObjects[i];
-			// Calculate a rotation around the rotation-center of the object
-			Eigen::Vector3d curCenter = curObject->getPosition();
-			double m = curObject->getMass();
+			int oldPartner = _binaryPartners[i];
+			int newPartner = partners[i];
+			if (!hasForces || oldPartner == newPartner) continue;
+
+			if (oldPartner >= 0) {
+				_forces[i] += getMutualForce(bodies, i, oldPartner);
+			}
+			if (newPartner >= 0) {
+				_forces[i] -= getMutualForce(bodies, i, newPartner);
+			}
+		}
 
-			// acceleration vector
-			std::vector<SpaceObject*> objectsToIterate;
+		_binaryPartners.swap(partners);
+		_farForces.clear();
+	}
 
-			Eigen::Vector3i gridPosition = _spatialPosition.row(i);
-			unsigned int index = getIndex(gridPosition);
+	Profiler::Instance()->count(Profiler::BINARIES,
+		static_cast<double>(cntSpaceObj - std::count(_binaryPartners.begin(), _binaryPartners.end(), -1)) / 2.0);
+}
 
-			//for (int j = 0; j < cntSpaceObj; ++j) {
-			if (index > 0 && index < _influencer.size()) {
-				for (std::map<long, SpaceObject*>::iterator it = _influencer[index].begin(); it != _influencer[index].end(); ++it) {
-					SpaceObject* compareObject = (*it).second;
 
-					if (curObject->getId() == compareObject->getId()) continue; // do not compare the object with it self
+/**
+ * \brief Dissolve the binary of a body and add the forces of the pair on each other back to the current forces.
+ *
+ * \param i
+ *      Index of a body of the binary.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::dissolveBinary(int i, const BodyState &bodies) {
+	int j = _binaryPartners[i];
+	if (j < 0) return;
 
-					// compare the objects based on the center of mass
-					Eigen::Vector3d compareCenter = compareObject->getPosition();
+	if (_forces.size() == bodies.size()) {
+		_forces[i] += getMutualForce(bodies, i, j);
+		_forces[j] += getMutualForce(bodies, j, i);
+	}
 
-					// get the distance
-					Eigen::Vector3d d = compareCenter - curCenter;
+	_binaryPartners[i] = -1;
+	_binaryPartners[j] = -1;
+	_farForces.clear();
+}
 
-					// compute the square distance
-					double r = (compareCenter - curCenter).norm();
-					r *= r;
 
-					// F is the force between the masses
-					double f = (G * m * compareObject->getMass()) / (r + EPS);
-					forces[i] += f * d.normalized();
-				}
+/**
+ * \brief Get the softened newtonian force of one body on another one (the same as in the gravity-solvers).
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param i
+ *      Index of the attracted body.
+ * \param j
+ *      Index of the attracting body.
+ *
+ * \return Force on the body i.
+ */
+Eigen::Vector3d NBodyManager::getMutualForce(const BodyState &bodies, int i, int j) const {
+	Eigen::Vector3d d = bodies.getPosition(j) - bodies.getPosition(i);
+	double invR = 1.0 / sqrt(d.squaredNorm() + EPS);
+
+	return (G * bodies.m[i] * bodies.m[j] * invR * invR * invR) * d;
+}
+
+
+/**
+ * \brief Remove the forces of the partners of the binaries on each other.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param targets
+ *      Indices of the bodies whose forces were calculated.
+ * \param forces
+ *      Output-parameter: Force per body (only the targets are changed).
+ */
+void NBodyManager::removeBinaryForces(const BodyState &bodies, const std::vector<int> &targets, std::vector<Eigen::Vector3d> &forces) const {
+	if (_binaryPartners.size() != bodies.size()) {
+		return;
+	}
+
+	for (unsigned int k = 0; k < targets.size(); ++k) {
+		int i = targets[k];
+		if (_binaryPartners[i] >= 0) {
+			forces[i] -= getMutualForce(bodies, i, _binaryPartners[i]);
+		}
+	}
+}
+
+
+/**
+ * \brief Drift a binary: its center of mass moves with its velocity, the relative motion follows the
+ *        Kepler-orbit of the pair (linear if the anomaly doesn't converge).
+ *
+ * \param h
+ *      Time-step of the drift.
+ * \param i, j
+ *      Indices of both bodies of the binary.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::driftBinary(double h, int i, int j, BodyState &bodies) {
+	double mass = bodies.m[i] + bodies.m[j];
+	double ratioI = bodies.m[i] / mass;
+	double ratioJ = bodies.m[j] / mass;
+
+	Eigen::Vector3d center = ratioI * bodies.getPosition(i) + ratioJ * bodies.getPosition(j);
+	Eigen::Vector3d centerVelocity = ratioI * bodies.getLinearVelocity(i) + ratioJ * bodies.getLinearVelocity(j);
+	Eigen::Vector3d r = bodies.getPosition(i) - bodies.getPosition(j);
+	Eigen::Vector3d v = bodies.getLinearVelocity(i) - bodies.getLinearVelocity(j);
+
+	center += h * centerVelocity;
+	if (!KeplerOrbit::propagate(G * mass, r, v, h)) {
+		r += h * v;
+	}
+
+	bodies.setPosition(i, center + ratioJ * r);
+	bodies.setPosition(j, center - ratioI * r);
+	bodies.setLinearVelocity(i, centerVelocity + ratioJ * v);
+	bodies.setLinearVelocity(j, centerVelocity - ratioI * v);
+}
+
+
+/**
+ * \brief Move the bodies on rails along their Kepler-orbits relative to the central body.
+ *
+ * \param dt
+ *      Time difference since between the last frames.
+ * \param bodies
+ *      State of all bodies in the scene (the central body is already integrated).
+ */
+void NBodyManager::moveOnRails(double dt, BodyState &bodies) {
+	int cntRails = _railBodies.size();
+	Eigen::Vector3d centralPosition = bodies.getPosition(_centralBody);
+	Eigen::Vector3d centralVelocity = bodies.getLinearVelocity(_centralBody);
+	double centralMass = bodies.m[_centralBody];
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntRails; ++k) {
+		int i = _railBodies[k];
+		Eigen::Vector3d position = bodies.getPosition(i) - _centralPosition;
+		Eigen::Vector3d velocity = bodies.getLinearVelocity(i) - _centralVelocity;
+
+		if (KeplerOrbit::propagate(G * (centralMass + bodies.m[i]), position, velocity, dt)) {
+			bodies.setPosition(i, centralPosition + position);
+			bodies.setLinearVelocity(i, centralVelocity + velocity);
+		} else {
+			bodies.setPosition(i, bodies.getPosition(i) + dt * bodies.getLinearVelocity(i));
+		}
+	}
+}
+
+
+/**
+ * \brief Count the resting steps of the integrated bodies and put them to sleep after SLEEP_STEPS.
+ *
+ * \param dt
+ *      Time difference since between the last frames.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::updateRestingBodies(double dt, BodyState &bodies) {
+	int cntActive = _activeBodies.size();
+	bool hasForces = _forces.size() == bodies.size();
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntActive; ++k) {
+		int i = _activeBodies[k];
+		double velocityChange = hasForces ? _forces[i].norm() / bodies.m[i] * dt : 0.0;
+
+		// a visual spin does not keep the body awake and goes on while it sleeps
+		bool isSpinning = !bodies.visualSpin[i] && bodies.getAngularVelocity(i).norm() > _sleepVelocity;
+
+		if (bodies.getLinearVelocity(i).norm() > _sleepVelocity || isSpinning || velocityChange > _sleepVelocity) {
+			_restingSteps[i] = 0;
+		} else if (++_restingSteps[i] >= SLEEP_STEPS) {
+			bodies.sleeping[i] = 1;
+			bodies.setLinearVelocity(i, Eigen::Vector3d(0.0, 0.0, 0.0));
+			if (!bodies.visualSpin[i]) {
+				bodies.setAngularVelocity(i, Eigen::Vector3d(0.0, 0.0, 0.0));
 			}
 		}
-	} else {
+	}
+}
+
+
+/**
+ * \brief Advance all bodies by dt with hierarchical block-timesteps (kick-drift-kick leapfrog per body).
+ *        Each body steps with dt / 2^level, where the level is selected with eta * |a| / |da/dt|.
+ *        All bodies are drifted each sub-step, but only the bodies at the end of their step get new forces.
+ *
+ * \param dt
+ *      Time difference since between the last frames.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::simulateBlockStep(double dt, BodyState &bodies) {
+	int cntSpaceObj = bodies.size();
+	int maxLevel = _maxTimestepLevel;
+	int cntSubsteps = 1 << maxLevel;
+	double h = dt / static_cast<double>(cntSubsteps);
+
+	if (!_hasForces || _forces.size() != static_cast<unsigned int>(cntSpaceObj) || _timestepLevels.size() != _forces.size()) {
+		computeForces(bodies, _forces);
+
+		// without an estimate of the jerk, all bodies start on the finest level
+		_timestepLevels.assign(cntSpaceObj, maxLevel);
+	}
+
+	std::vector<int> active;
+	std::vector<Eigen::Vector3d> oldForces;
+	active.reserve(cntSpaceObj);
 
+	for (int s = 0; s < cntSubsteps; ++s) {
+		// opening half-kick of all bodies which start a new step
 #if defined(_OPENMP)
 #pragma omp parallel for
 #endif
 		for (int i = 0; i < cntSpaceObj; ++i) {
-			SpaceObject* curObject = spaceObjects[i];
-			// Calculate a rotation around the rotation-center of the object
-			Eigen::Vector3d curCenter = curObject->getPosition();
-			double m = curObject->getMass();
+			int stride = 1 << (maxLevel - _timestepLevels[i]);
+
+			if (s % stride == 0) {
+				Eigen::Vector3d a = _forces[i] / bodies.m[i];
+				bodies.setLinearVelocity(i, bodies.getLinearVelocity(i) + (0.5 * stride * h) * a);
+			}
+		}
+
+		drift(h, bodies);
+
+		active.clear();
+		for (int i = 0; i < cntSpaceObj; ++i) {
+			if ((s + 1) % (1 << (maxLevel - _timestepLevels[i])) == 0) {
+				active.push_back(i);
+			}
+		}
 
-			// acceleration vector
-			std::vector<SpaceObject*> objectsToIterate;
+		if (active.empty()) continue;
+
+		// keep the old forces of the active bodies for the estimate of the jerk
+		int cntActive = active.size();
+		oldForces.resize(cntActive);
+		for (int k = 0; k < cntActive; ++k) {
+			oldForces[k] = _forces[active[k]];
+		}
 
+		computeForcesActive(bodies, active, _forces);
 
-			for (int j = 0; j < cntSpaceObj; ++j) {
-				if (i == j) continue; // do not compare the object with it self
+		// closing half-kick and selection of the next level
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+		for (int k = 0; k < cntActive; ++k) {
+			int i = active[k];
+			int level = _timestepLevels[i];
+			double dti = static_cast<double>(1 << (maxLevel - level)) * h;
 
-									  // compare the objects based on the center of mass
-				SpaceObject* compareObject = spaceObjects[j];
-				Eigen::Vector3d compareCenter = compareObject->getPosition();
+			Eigen::Vector3d a = _forces[i] / bodies.m[i];
+			Eigen::Vector3d aOld = oldForces[k] / bodies.m[i];
+			bodies.setLinearVelocity(i, bodies.getLinearVelocity(i) + (0.5 * dti) * a);
 
-				// get the distance
-				Eigen::Vector3d d = compareCenter - curCenter;
+			double jerk = (a - aOld).norm() / dti;
+			double desiredDt = jerk > 0.0 ? _timestepAccuracy * a.norm() / jerk : dt;
 
-				// compute the square distance
-				double r = (compareCenter - curCenter).norm();
-				r *= r;
+			int newLevel = 0;
+			while (newLevel < maxLevel && dt / static_cast<double>(1 << newLevel) > desiredDt) {
+				++newLevel;
+			}
 
-				// F is the force between the masses
-				double f = (G * m * compareObject->getMass()) / (r + EPS);
-				forces[i] += f * d.normalized();
+			// a body may only move to a coarser level (by one) if it is synchronized with it
+			if (newLevel < level) {
+				newLevel = level - 1;
+				if ((s + 1) % (1 << (maxLevel - newLevel)) != 0) {
+					newLevel = level;
+				}
 			}
+
+			_timestepLevels[i] = newLevel;
 		}
 	}
 
+	// at the end of the step all bodies are synchronized
+	_hasForces = true;
+}
+
+
+/**
+ * \brief Update the linear velocities of the integrated bodies with the current forces.
+ *
+ * \param h
+ *      Time-step of the kick.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::kick(double h, BodyState &bodies) {
+	int cntActive = _activeBodies.size();
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntActive; ++k) {
+		int i = _activeBodies[k];
+		Eigen::Vector3d a = _forces[i] / bodies.m[i];
+		bodies.setLinearVelocity(i, bodies.getLinearVelocity(i) + h * a);
+	}
+}
+
+
+/**
+ * \brief Update the positions of the integrated bodies with the current linear velocities.
+ *
+ * \param h
+ *      Time-step of the drift.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::drift(double h, BodyState &bodies) {
+	int cntActive = _activeBodies.size();
 
 #if defined(_OPENMP)
 #pragma omp parallel for
 #endif
-	// update positions
-	for (int i = 0; i < cntSpaceObj; ++i) {
-		SpaceObject* spaceObject = spaceObjects[i];
-		Eigen::Vector3d a = forces[i] / spaceObject->getMass();
-		Eigen::Vector3d v = spaceObject->getLinearVelocity() + (dt * a);
-		spaceObject->setLinearVelocity(v);
-
-		Eigen::Vector3d dtv = dt * v;
-		Eigen::Vector3d p = spaceObject->getPosition() + dtv;
-
-		Eigen::Vector3d dto = dt * spaceObject->getAngularVelocity();
-		osg::Quat q;
-		double sinQuat = sin(dto.norm() / 2);
-		double cosQuat = cos(dto.norm() / 2);
-		if (dto.norm() > 0) {
-			q.set(sinQuat*dto(0) / dto.norm(), sinQuat*dto(1) / dto.norm(), sinQuat*dto(2) / dto.norm(), cosQuat);
-		} else {
-			q.set(0.0, 0.0, 0.0, 1.0);
+	for (int k = 0; k < cntActive; ++k) {
+		int i = _activeBodies[k];
+		int partner = _binaryPartners.size() == bodies.size() ? _binaryPartners[i] : -1;
+
+		// a binary is drifted by its first body
+		if (partner < 0) {
+			bodies.setPosition(i, bodies.getPosition(i) + h * bodies.getLinearVelocity(i));
+		} else if (i < partner) {
+			driftBinary(h, i, partner, bodies);
 		}
-		osg::Quat newQ = q*spaceObject->getOrientation();
+	}
+}
+
 
-		spaceObject->updatePositionOrientation(p, newQ);
+/**
+ * \brief Kick and drift the integrated bodies in one sweep (same as kick() followed by drift() without binaries).
+ *
+ * \param hKick
+ *      Time-step of the kick.
+ * \param hDrift
+ *      Time-step of the drift.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::kickAndDrift(double hKick, double hDrift, BodyState &bodies) {
+	int cntActive = _activeBodies.size();
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntActive; ++k) {
+		int i = _activeBodies[k];
+		Eigen::Vector3d v = bodies.getLinearVelocity(i) + (hKick / bodies.m[i]) * _forces[i];
+		bodies.setLinearVelocity(i, v);
+		bodies.setPosition(i, bodies.getPosition(i) + hDrift * v);
+	}
+}
 
-		if (_useSpatialGrid) {
-			// Update influencing area
-			Eigen::Vector3i oldPosition = _spatialPosition.row(i);
-			Eigen::Vector3i newPosition = binSpatialInformation(p);
-			Eigen::Vector3i diffPosition = oldPosition - newPosition;
 
-			if (diffPosition.squaredNorm() != 0) {
-				removeInfluencer(i, spaceObject, oldPosition);
-				addInfluencer(i, spaceObject, newPosition);
-			}
+/**
+ * \brief Advance the integrated bodies with the Wisdom-Holman map (kick-drift-kick): the other bodies move
+ *        along their Kepler-orbit around the heaviest body (the primary) during the drift, the kicks only
+ *        apply the perturbation of all other bodies. A pure two-body orbit is exact for any time-step.
+ *
+ * \param dt
+ *      Time difference since between the last frames.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::simulateWisdomHolmanStep(double dt, BodyState &bodies) {
+	int cntSpaceObj = bodies.size();
+	if (cntSpaceObj == 0) {
+		return;
+	}
 
-			_spatialPosition.row(i) = newPosition;
-		}
+	if (!_hasForces || _forces.size() != static_cast<unsigned int>(cntSpaceObj)) {
+		computeForces(bodies, _forces);
 	}
+
+	int primary = static_cast<int>(std::max_element(bodies.m.begin(), bodies.m.end()) - bodies.m.begin());
+
+	kickPerturbations(0.5 * dt, primary, bodies);
+	driftKepler(dt, primary, bodies);
+	updateForces(bodies);
+	kickPerturbations(0.5 * dt, primary, bodies);
+
+	_hasForces = true;
 }
 
 
+/**
+ * \brief Advance the integrated bodies with the fourth-order Hermite predictor-corrector: the positions and
+ *        velocities are predicted with the accelerations and jerks of the last step, both are evaluated once
+ *        at the predicted state, and the corrector interpolates the two evaluations. The next step starts with
+ *        the evaluation at the predicted state (P(EC)^1), so there is still only one evaluation per step.
+ *
+ * \param dt
+ *      Time difference since between the last frames.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::simulateHermiteStep(double dt, BodyState &bodies) {
+	int cntSpaceObj = bodies.size();
+	int cntActive = _activeBodies.size();
+
+	// the first step (or the first after bodies were added or changed) needs the jerks of the current state
+	if (!_hasForces || _forces.size() != static_cast<unsigned int>(cntSpaceObj) || _jerks.size() != _forces.size()) {
+		std::vector<int> all(cntSpaceObj);
+		for (int i = 0; i < cntSpaceObj; ++i) {
+			all[i] = i;
+		}
+
+		_forces.resize(cntSpaceObj);
+		_jerks.resize(cntSpaceObj);
+		computeForcesAndJerks(bodies, all);
+	}
+
+	// state at the start of the step
+	FrameVector<Eigen::Vector3d> x0(cntActive), v0(cntActive), a0(cntActive), j0(cntActive);
 
-void NBodyManager::initSpatialGrid(std::vector<SpaceObject*> &spaceObjects, Eigen::Vector3i gridResolution) {
-	_useSpatialGrid = true;
-	_resolutionSize = gridResolution;
+	// predictor: taylor-series up to the jerk (the bodies which are not integrated are sources at their positions)
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntActive; ++k) {
+		int i = _activeBodies[k];
+		x0[k] = bodies.getPosition(i);
+		v0[k] = bodies.getLinearVelocity(i);
+		a0[k] = _forces[i] / bodies.m[i];
+		j0[k] = _jerks[i];
+
+		bodies.setPosition(i, x0[k] + dt * (v0[k] + (0.5 * dt) * (a0[k] + (dt / 3.0) * j0[k])));
+		bodies.setLinearVelocity(i, v0[k] + dt * (a0[k] + (0.5 * dt) * j0[k]));
+	}
 
-	double max = std::numeric_limits<double>::max();
-	Eigen::Vector3d spatialBbMax = Eigen::Vector3d(-max, -max, -max);
-	Eigen::Vector3d spatialBbMin = Eigen::Vector3d(max, max, max);
+	computeForcesAndJerks(bodies, _activeBodies);
 
-	for (std::vector<SpaceObject*>::iterator it = spaceObjects.begin(); it != spaceObjects.end(); ++it) {
-		osg::BoundingBox bbBox = (*it)->getAABB();
+	// corrector: the velocities first, the positions are interpolated with them
+	double dt2 = dt * dt / 12.0;
 
-		spatialBbMax(0) = std::max(spatialBbMax(0), static_cast<double>(bbBox.xMax()));
-		spatialBbMax(1) = std::max(spatialBbMax(1), static_cast<double>(bbBox.yMax()));
-		spatialBbMax(2) = std::max(spatialBbMax(2), static_cast<double>(bbBox.zMax()));
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntActive; ++k) {
+		int i = _activeBodies[k];
+		Eigen::Vector3d a1 = _forces[i] / bodies.m[i];
+		Eigen::Vector3d v1 = v0[k] + (0.5 * dt) * (a0[k] + a1) + dt2 * (j0[k] - _jerks[i]);
 
-		spatialBbMin(0) = std::min(spatialBbMin(0), static_cast<double>(bbBox.xMin()));
-		spatialBbMin(1) = std::min(spatialBbMin(1), static_cast<double>(bbBox.yMin()));
-		spatialBbMin(2) = std::min(spatialBbMin(2), static_cast<double>(bbBox.zMin()));
+		bodies.setLinearVelocity(i, v1);
+		bodies.setPosition(i, x0[k] + (0.5 * dt) * (v0[k] + v1) + dt2 * (a0[k] - a1));
 	}
 
-	Eigen::Vector3d spatialBbCenter = (spatialBbMax + spatialBbMin) * 0.5;
-	Eigen::Vector3d centerToMax = (spatialBbMax - spatialBbCenter).cwiseAbs().maxCoeff() * Eigen::Vector3d(1.0, 1.0, 1.0);
-	Eigen::Vector3d centerToMin = (spatialBbMin - spatialBbCenter).cwiseAbs().maxCoeff() * Eigen::Vector3d(-1.0, -1.0, -1.0);
+	_hasForces = true;
+}
 
-	_spatialBbMax = spatialBbCenter + 2 * centerToMax;
-	_spatialBbMin = spatialBbCenter + 2 * centerToMin;
-	Eigen::Vector3d bbDim = _spatialBbMax - _spatialBbMin;
 
-	_spatialGrid = std::vector<std::vector<SpaceObject*>>(gridResolution(0) * gridResolution(1) * gridResolution(2), std::vector<SpaceObject*>(0));
-	_influencer = std::vector<std::map<long, SpaceObject*>>(gridResolution(0) * gridResolution(1) * gridResolution(2));
+/**
+ * \brief Calculate the forces and the jerks of their accelerations with the all-pairs kernel at the current
+ *        state (positions and velocities) of the bodies. All bodies are used as sources.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param targets
+ *      Indices of the bodies whose forces (_forces) and jerks (_jerks) are overwritten.
+ */
+void NBodyManager::computeForcesAndJerks(const BodyState &bodies, const std::vector<int> &targets) {
+	Profiler::ScopedTimer timer(Profiler::FORCES);
+	int cntSpaceObj = bodies.size();
+	int cntTargets = targets.size();
+
+	FrameVector<double> ax(cntSpaceObj), ay(cntSpaceObj), az(cntSpaceObj);
+	FrameVector<double> jx(cntSpaceObj), jy(cntSpaceObj), jz(cntSpaceObj);
+	GravityKernel::computeFieldsAndJerks(bodies.x.data(), bodies.y.data(), bodies.z.data(),
+		bodies.vx.data(), bodies.vy.data(), bodies.vz.data(), bodies.m.data(), cntSpaceObj, EPS,
+		targets.data(), cntTargets, ax.data(), ay.data(), az.data(), jx.data(), jy.data(), jz.data());
+
+	for (int k = 0; k < cntTargets; ++k) {
+		int i = targets[k];
+		_forces[i] = (G * bodies.m[i]) * Eigen::Vector3d(ax[i], ay[i], az[i]);
+		_jerks[i] = G * Eigen::Vector3d(jx[i], jy[i], jz[i]);
+	}
+}
 
-	_spatialPosition.resize(spaceObjects.size(), 3);
-	_influenceRadius.resize(spaceObjects.size(), 3);
 
-	_resolution(0) = bbDim(0) / static_cast<double>(_resolutionSize(0) - 1);
-	_resolution(1) = bbDim(1) / static_cast<double>(_resolutionSize(1) - 1);
-	_resolution(2) = bbDim(2) / static_cast<double>(_resolutionSize(2) - 1);
+/**
+ * \brief Kick the integrated bodies by their forces without the Kepler-acceleration of the primary.
+ *
+ * \param h
+ *      Time-step of the kick.
+ * \param primary
+ *      Index of the primary body.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::kickPerturbations(double h, int primary, BodyState &bodies) {
+	int cntActive = _activeBodies.size();
+	Eigen::Vector3d primaryPosition = bodies.getPosition(primary);
+	double primaryMass = bodies.m[primary];
 
-	// Bin each point
-	for (unsigned int i = 0; i < spaceObjects.size(); ++i) {
-		Eigen::Vector3d current = spaceObjects[i]->getPosition();
-		Eigen::Vector3i position = binSpatialInformation(current);
-		unsigned int index = getIndex(position);
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntActive; ++k) {
+		int i = _activeBodies[k];
+		Eigen::Vector3d a = _forces[i] / bodies.m[i];
 
-		_spatialPosition.row(i) << position(0), position(1), position(2);
-		_spatialGrid[index].push_back(spaceObjects[i]);
+		// the primary pulls the body relative to itself during the drift, only its own acceleration is kicked
+		if (i != primary) {
+			Eigen::Vector3d r = bodies.getPosition(i) - primaryPosition;
+			double distance = r.norm();
 
-		double influenceForce = -(_treshold * EPS - G * spaceObjects[i]->getMass()) / _treshold;
-		Eigen::Vector3i influence = Eigen::Vector3i(static_cast<unsigned int>(influenceForce / _resolution(0)),
-			static_cast<unsigned int>(influenceForce / _resolution(1)),
-			static_cast<unsigned int>(influenceForce / _resolution(2)));
-		influence(0) = std::max(influence(0), 1);
-		influence(1) = std::max(influence(1), 1);
-		influence(2) = std::max(influence(2), 1);
-		_influenceRadius.row(i) = influence;
+			if (distance > 0.0) {
+				a += (G * (primaryMass + bodies.m[i]) / (distance * distance * distance)) * r;
+			}
+		}
 
-		addInfluencer(i, spaceObjects[i], position);
+		bodies.setLinearVelocity(i, bodies.getLinearVelocity(i) + h * a);
 	}
 }
 
 
+/**
+ * \brief Drift the primary along its velocity and the other integrated bodies along their Kepler-orbits
+ *        around it (see KeplerOrbit).
+ *
+ * \param h
+ *      Time-step of the drift.
+ * \param primary
+ *      Index of the primary body.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::driftKepler(double h, int primary, BodyState &bodies) {
+	int cntActive = _activeBodies.size();
+	Eigen::Vector3d primaryPosition = bodies.getPosition(primary);
+	Eigen::Vector3d primaryVelocity = bodies.getLinearVelocity(primary);
+	double primaryMass = bodies.m[primary];
+
+	// a sleeping primary does not move
+	bool isPrimaryActive = std::find(_activeBodies.begin(), _activeBodies.end(), primary) != _activeBodies.end();
+	Eigen::Vector3d newPrimaryPosition = isPrimaryActive ? Eigen::Vector3d(primaryPosition + h * primaryVelocity) : primaryPosition;
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int k = 0; k < cntActive; ++k) {
+		int i = _activeBodies[k];
+
+		if (i == primary) {
+			bodies.setPosition(i, newPrimaryPosition);
+			continue;
+		}
+
+		Eigen::Vector3d position = bodies.getPosition(i) - primaryPosition;
+		Eigen::Vector3d velocity = bodies.getLinearVelocity(i) - primaryVelocity;
+
+		if (KeplerOrbit::propagate(G * (primaryMass + bodies.m[i]), position, velocity, h)) {
+			bodies.setPosition(i, newPrimaryPosition + position);
+			bodies.setLinearVelocity(i, primaryVelocity + velocity);
+		} else {
+			bodies.setPosition(i, bodies.getPosition(i) + h * bodies.getLinearVelocity(i));
+		}
+	}
+}
+
 
 /**
- * \brief Get the position of the point in the spatial-index-grid for a given point.
+ * \brief Update the orientations of the integrated bodies (and of the bodies on rails) with the angular velocities.
  *
- * \param position Position of the point which one want to know the index in the spatial-grid
+ * \param dt
+ *      Time difference since between the last frames.
+ * \param bodies
+ *      State of all bodies in the scene.
+ */
+void NBodyManager::rotate(double dt, BodyState &bodies) {
+	bodies.rotate(_activeBodies.data(), _activeBodies.size(), dt);
+	bodies.rotate(_railBodies.data(), _railBodies.size(), dt);
+}
+
+
+/**
+ * \brief Calculate the forces with the exact all-pairs summation (vectorized kernel, or the GPU with the gpu-solver).
  *
- * \return Position in the spatial-index
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param forces
+ *      Resulting force per space-object.
  */
-Eigen::Vector3i NBodyManager::binSpatialInformation(Eigen::Vector3d position) {
-	Eigen::Vector3d current = position - _spatialBbMin;
-	unsigned int i_x = std::floor(current(0) / _resolution(0));
-	unsigned int i_y = std::floor(current(1) / _resolution(1));
-	unsigned int i_z = std::floor(current(2) / _resolution(2));
+void NBodyManager::computeForcesDirect(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces) {
+	int cntSpaceObj = bodies.size();
+
+	// vectorized all-pairs kernel directly on the arrays of the body-state
+	FrameVector<double> ax(cntSpaceObj), ay(cntSpaceObj), az(cntSpaceObj);
+	if (_gravitySolver == GPU && _gpuGravity.computeFields(bodies.x.data(), bodies.y.data(), bodies.z.data(), bodies.m.data(),
+		cntSpaceObj, EPS, ax.data(), ay.data(), az.data())) {
+		// the GPU keeps the buffers between the steps, only the fields are copied back
+	} else if (_useSymmetricForces) {
+		GravityKernel::computeFieldsSymmetric(bodies.x.data(), bodies.y.data(), bodies.z.data(), bodies.m.data(), cntSpaceObj, EPS,
+			ax.data(), ay.data(), az.data(), _isDeterministic);
+	} else if (_useMixedPrecision) {
+		GravityKernel::computeFieldsMixed(bodies.x.data(), bodies.y.data(), bodies.z.data(), bodies.m.data(), cntSpaceObj, EPS,
+			ax.data(), ay.data(), az.data());
+	} else {
+		GravityKernel::computeFields(bodies.x.data(), bodies.y.data(), bodies.z.data(), bodies.m.data(), cntSpaceObj, EPS,
+			ax.data(), ay.data(), az.data());
+	}
 
-	return Eigen::Vector3i(i_x, i_y, i_z);
+	for (int i = 0; i < cntSpaceObj; ++i) {
+		forces[i] = (G * bodies.m[i]) * Eigen::Vector3d(ax[i], ay[i], az[i]);
+	}
 }
 
-unsigned int NBodyManager::getIndex(Eigen::Vector3i position) {
-	unsigned int index = position(0) + _resolutionSize(0) * (position(1) + _resolutionSize(1) * position(2));
-	return index;
+
+/**
+ * \brief Calculate the forces with the cut-off solver (neighbouring cells and far-reaching bodies).
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param forces
+ *      Resulting force per space-object.
+ */
+void NBodyManager::computeForcesSpatialGrid(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces) {
+	int cntSpaceObj = bodies.size();
+
+	// the cells are only re-sorted if a body changed its cell
+	_spatialGrid.update(bodies, G);
+
+	std::vector<double> ax, ay, az;
+	_spatialGrid.computeFields(bodies, EPS, ax, ay, az);
+
+	for (int i = 0; i < cntSpaceObj; ++i) {
+		forces[i] = (G * bodies.m[i]) * Eigen::Vector3d(ax[i], ay[i], az[i]);
+	}
 }
 
-void NBodyManager::addInfluencer(unsigned int i, SpaceObject* spaceObject, Eigen::Vector3i position) {
-	Eigen::Vector3i influence = _influenceRadius.row(i);
 
-	if (position(0) < 0 || position(1) < 0 || position(2) < 0
-		|| position(0) > _resolutionSize(0) || position(1) > _resolutionSize(1) || position(2) >_resolutionSize(2)) {
-		return;
+/**
+ * \brief Calculate the forces with the Barnes-Hut octree, which is rebuilt from the current positions.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param forces
+ *      Resulting force per space-object.
+ */
+void NBodyManager::computeForcesBarnesHut(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces) {
+	int cntSpaceObj = bodies.size();
+
+	std::vector<Eigen::Vector3d> positions(cntSpaceObj);
+	for (int i = 0; i < cntSpaceObj; ++i) {
+		positions[i] = bodies.getPosition(i);
 	}
 
-	unsigned int x_min = std::max(position(0) - influence(0), 0);
-	unsigned int x_max = std::min(position(0) + influence(0), static_cast<int>(_resolutionSize(0) - 1));
-	unsigned int y_min = std::max(position(1) - influence(1), 0);
-	unsigned int y_max = std::min(position(1) + influence(1), static_cast<int>(_resolutionSize(1) - 1));
-	unsigned int z_min = std::max(position(2) - influence(2), 0);
-	unsigned int z_max = std::min(position(2) + influence(2), static_cast<int>(_resolutionSize(2) - 1));
+	// the tree is refitted or rebuilt each step, since all objects are moving
+	_barnesHutTree.update(positions, bodies.m.data());
 
-	// First look in the same cell as well the direct neighbors
-	for (unsigned int i_x = x_min; i_x <= x_max; ++i_x) {
-		for (unsigned int i_y = y_min; i_y <= y_max; ++i_y) {
-			for (unsigned int i_z = z_min; i_z <= z_max; ++i_z) {
-				unsigned int indexInfluence = i_x + _resolutionSize(0) * (i_y + _resolutionSize(1) * i_z);
+	if (_useGroupedWalk) {
+		_barnesHutTree.computeFieldsGrouped(EPS, forces);
 
-				if (indexInfluence < _influencer.size()) {
-					_influencer[indexInfluence][spaceObject->getId()] = spaceObject;
-				}
-			}
+		for (int i = 0; i < cntSpaceObj; ++i) {
+			forces[i] *= G * bodies.m[i];
 		}
+		return;
+	}
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+	for (int i = 0; i < cntSpaceObj; ++i) {
+		forces[i] = (G * bodies.m[i]) * _barnesHutTree.computeField(i, EPS);
 	}
 }
 
-void NBodyManager::removeInfluencer(unsigned int i, SpaceObject* spaceObject, Eigen::Vector3i position) {
-	Eigen::Vector3i influence = _influenceRadius.row(i);
 
-	if (position(0) < 0 || position(1) < 0 || position(2) < 0
-		|| position(0) > _resolutionSize(0) || position(1) > _resolutionSize(1) || position(2) >_resolutionSize(2)) {
+/**
+ * \brief Calculate the forces with the Barnes-Hut tree on the GPU (the tree on the CPU if the GPU failed).
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param forces
+ *      Resulting force per space-object.
+ */
+void NBodyManager::computeForcesGpuBarnesHut(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces) {
+	int cntSpaceObj = bodies.size();
+
+	// the tree is built on the device each step, only the fields are copied back
+	FrameVector<double> ax(cntSpaceObj), ay(cntSpaceObj), az(cntSpaceObj);
+	if (!_gpuBarnesHut.computeFields(bodies.x.data(), bodies.y.data(), bodies.z.data(), bodies.m.data(), cntSpaceObj, EPS,
+		_barnesHutTree.getTheta(), ax.data(), ay.data(), az.data())) {
+		computeForcesBarnesHut(bodies, forces);
 		return;
 	}
 
-	unsigned int x_min = std::max(position(0) - influence(0), 0);
-	unsigned int x_max = std::min(position(0) + influence(0), static_cast<int>(_resolutionSize(0) - 1));
-	unsigned int y_min = std::max(position(1) - influence(1), 0);
-	unsigned int y_max = std::min(position(1) + influence(1), static_cast<int>(_resolutionSize(1) - 1));
-	unsigned int z_min = std::max(position(2) - influence(2), 0);
-	unsigned int z_max = std::min(position(2) + influence(2), static_cast<int>(_resolutionSize(2) - 1));
-
-	// First look in the same cell as well the direct neighbors
-	for (unsigned int i_x = x_min; i_x <= x_max; ++i_x) {
-		for (unsigned int i_y = y_min; i_y <= y_max; ++i_y) {
-			for (unsigned int i_z = z_min; i_z <= z_max; ++i_z) {
-				unsigned int indexInfluence = i_x + _resolutionSize(0) * (i_y + _resolutionSize(1) * i_z);
-
-				if (indexInfluence < _influencer.size()) {
-					std::map<long, SpaceObject*> fluencerMap = _influencer[indexInfluence];
-					std::map<long, SpaceObject*>::iterator iter = fluencerMap.find(spaceObject->getId());
-					if (iter != fluencerMap.end()) {
-						fluencerMap.erase(spaceObject->getId());
-					}
-				}
-			}
-		}
+	for (int i = 0; i < cntSpaceObj; ++i) {
+		forces[i] = (G * bodies.m[i]) * Eigen::Vector3d(ax[i], ay[i], az[i]);
+	}
+}
+
+
+/**
+ * \brief Calculate the forces with the particle-mesh solver.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param forces
+ *      Resulting force per space-object.
+ */
+void NBodyManager::computeForcesParticleMesh(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces) {
+	int cntSpaceObj = bodies.size();
+
+	std::vector<double> ax, ay, az;
+	_particleMesh.computeFields(bodies, EPS, ax, ay, az);
+
+	for (int i = 0; i < cntSpaceObj; ++i) {
+		forces[i] = (G * bodies.m[i]) * Eigen::Vector3d(ax[i], ay[i], az[i]);
+	}
+}
+
+
+/**
+ * \brief Calculate the forces with the fast multipole method.
+ *
+ * \param bodies
+ *      State of all bodies in the scene.
+ * \param forces
+ *      Resulting force per space-object.
+ */
+void NBodyManager::computeForcesFastMultipole(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces) {
+	int cntSpaceObj = bodies.size();
+
+	std::vector<double> ax, ay, az;
+	_fastMultipole.computeFields(bodies, EPS, ax, ay, az);
+
+	for (int i = 0; i < cntSpaceObj; ++i) {
+		forces[i] = (G * bodies.m[i]) * Eigen::Vector3d(ax[i], ay[i], az[i]);
 	}
-}
\ No newline at end of file
+}
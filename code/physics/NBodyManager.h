@@ -10,10 +10,20 @@
 #include <Eigen/Core>
 #include <vector>
 #include <map>
+#include <string>
+#include <algorithm>
+
+#include "BarnesHutTree.h"
+#include "SpatialGrid.h"
+#include "ParticleMesh.h"
+#include "FastMultipole.h"
+#include "GpuGravity.h"
+#include "GpuBarnesHut.h"
+#include "../scene/BinaryScene.h"
 
 // Forward declarations
 namespace pbs17 {
-	class SpaceObject;
+	class BodyState;
 }
 
 namespace pbs17 {
@@ -23,6 +33,46 @@ namespace pbs17 {
 	 */
 	class NBodyManager {
 	public:
+		/**
+		 * \brief Available methods to calculate the gravitational forces.
+		 */
+		enum GravitySolver {
+			//! Exact all-pairs summation O(N^2), vectorized
+			DIRECT,
+			//! Cut-off solver based on the spatial-grid
+			SPATIAL_GRID,
+			//! Barnes-Hut octree approximation O(N log N)
+			BARNES_HUT,
+			//! Particle-mesh (FFT) with optional short-range correction (P3M)
+			PARTICLE_MESH,
+			//! Exact all-pairs summation on the GPU (needs -DPBS17_CUDA=ON, falls back to DIRECT)
+			GPU,
+			//! Fast multipole method with quadrupole expansions O(N)
+			FAST_MULTIPOLE,
+			//! Barnes-Hut tree built and traversed on the GPU (needs -DPBS17_CUDA=ON, falls back to BARNES_HUT)
+			GPU_BARNES_HUT
+		};
+
+
+		/**
+		 * \brief Available methods to integrate the positions and velocities.
+		 */
+		enum Integrator {
+			//! Explicit semi-implicit euler (first order)
+			SEMI_IMPLICIT_EULER,
+			//! Kick-drift-kick leapfrog (second order, symplectic)
+			LEAPFROG,
+			//! Velocity-verlet (second order, symplectic)
+			VELOCITY_VERLET,
+			//! Yoshida composition of three leapfrog-steps (fourth order, symplectic)
+			YOSHIDA,
+			//! Wisdom-Holman map: Kepler-drifts around the heaviest body, kicks by the other bodies (symplectic)
+			WISDOM_HOLMAN,
+			//! Hermite predictor-corrector with the jerks of the all-pairs sum (fourth order, not symplectic)
+			HERMITE
+		};
+
+
 		/**
 		 * \brief Constructor of the CollisionManager.
 		 *
@@ -35,13 +85,484 @@ namespace pbs17 {
 		 *
 		 * \param dt
 		 *      Time difference since between the last frames.
-		 * \param spaceObjects
-		 *      All space-objects in the scene.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void simulateStep(double dt, BodyState &bodies);
+
+
+		/**
+		 * \brief Simulate a substep between two steps with the forces of the last evaluation (semi-implicit euler),
+		 *        so the contacts can be resolved more often than the forces are calculated. The bodies which were
+		 *        integrated by the last step are integrated, the bodies on rails stay on their orbits.
+		 *
+		 * \param dt
+		 *      Time difference of the substep.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void simulateSubstep(double dt, BodyState &bodies);
+
+
+		/**
+		 * \brief Set the method used to calculate the gravitational forces.
+		 *
+		 * \param solver
+		 *      Gravity-solver.
+		 */
+		void setGravitySolver(const GravitySolver solver) {
+			_gravitySolver = solver;
+		}
+
+
+		/**
+		 * \brief Get the method used to calculate the gravitational forces.
+		 *
+		 * \return Gravity-solver.
+		 */
+		GravitySolver getGravitySolver() const {
+			return _gravitySolver;
+		}
+
+
+		/**
+		 * \brief Set the method used to integrate the positions and velocities. Leapfrog, velocity-verlet and
+		 *        wisdom-holman reuse the forces of the last step (one evaluation per step), yoshida needs three evaluations.
+		 *        Hermite evaluates the forces and their jerks once per step with the all-pairs kernel (independent of
+		 *        the gravity-solver).
+		 *
+		 * \param integrator
+		 *      Integrator.
+		 */
+		void setIntegrator(const Integrator integrator) {
+			_integrator = integrator;
+			_hasForces = false;
+		}
+
+
+		/**
+		 * \brief Get the method used to integrate the positions and velocities.
+		 *
+		 * \return Integrator.
+		 */
+		Integrator getIntegrator() const {
+			return _integrator;
+		}
+
+
+		/**
+		 * \brief Use hierarchical block-timesteps: each body advances with dt / 2^level (kick-drift-kick leapfrog),
+		 *        and only the bodies at the end of their step get new forces. Replaces the integrator if enabled.
+		 *
+		 * \param useBlockTimesteps
+		 *      True to use block-timesteps.
+		 */
+		void setUseBlockTimesteps(const bool useBlockTimesteps) {
+			_useBlockTimesteps = useBlockTimesteps;
+			_hasForces = false;
+		}
+
+
+		/**
+		 * \brief Set the finest level of the block-timesteps (the smallest step is dt / 2^maxLevel).
+		 *
+		 * \param maxLevel
+		 *      Finest level (0 - 16).
+		 */
+		void setMaxTimestepLevel(const int maxLevel) {
+			_maxTimestepLevel = std::max(0, std::min(maxLevel, 16));
+			_hasForces = false;
+		}
+
+
+		/**
+		 * \brief Set the accuracy-parameter eta of the block-timesteps (dt_i = eta * |a_i| / |da_i/dt|).
+		 *
+		 * \param eta
+		 *      Accuracy-parameter (smaller => more accurate).
+		 */
+		void setTimestepAccuracy(const double eta) {
+			_timestepAccuracy = eta;
+		}
+
+
+		/**
+		 * \brief Let bodies sleep which are at rest: If the velocities and the velocity-change of the forces of a
+		 *        body stay below the threshold for a number of steps, it is not integrated anymore and its forces
+		 *        are only checked periodically. Contacts (or the player) and a stronger field wake it up.
+		 *        Not used with block-timesteps.
+		 *
+		 * \param useSleeping
+		 *      True to let resting bodies sleep.
+		 */
+		void setUseSleeping(const bool useSleeping) {
+			_useSleeping = useSleeping;
+		}
+
+
+		/**
+		 * \brief Set the threshold of the sleeping bodies.
+		 *
+		 * \param sleepVelocity
+		 *      Maximum linear and angular velocity (and velocity-change per step) of a resting body.
+		 */
+		void setSleepVelocity(const double sleepVelocity) {
+			_sleepVelocity = sleepVelocity;
+		}
+
+
+		/**
+		 * \brief Set the inner zone which is integrated, the bodies outside of it are moved on rails along their
+		 *        Kepler-orbits around the heaviest body (see KeplerOrbit). They still attract the inner bodies and
+		 *        collide, a contact changes their orbit. Not used with the block-timesteps.
+		 *
+		 * \param center
+		 *      Center of the inner zone (e.g. the player).
+		 * \param radius
+		 *      Radius of the inner zone (<= 0.0 => all bodies are integrated).
+		 */
+		void setRails(const Eigen::Vector3d &center, const double radius) {
+			_railsCenter = center;
+			_railsRadius = radius;
+		}
+
+
+		/**
+		 * \brief Set the opening angle of the Barnes-Hut tree and of the fast multipole method.
+		 *
+		 * \param theta
+		 *      Opening angle (0.0 means exact all-pairs summation).
+		 */
+		void setTheta(const double theta) {
+			_barnesHutTree.setTheta(theta);
+			_fastMultipole.setTheta(theta);
+		}
+
+
+		/**
+		 * \brief Get the opening angle of the Barnes-Hut tree and of the fast multipole method.
+		 *
+		 * \return Opening angle.
+		 */
+		double getTheta() const {
+			return _barnesHutTree.getTheta();
+		}
+
+
+		/**
+		 * \brief Refit the Barnes-Hut tree to the moved bodies instead of rebuilding it each step, as long as its
+		 *        summed cell-sizes grew by at most the given factor (see BarnesHutTree::update()).
+		 *
+		 * \param treeRefitThreshold
+		 *      Maximum growth of the cell-sizes (1.0 or less means rebuild each step).
+		 */
+		void setTreeRefitThreshold(const double treeRefitThreshold) {
+			_barnesHutTree.setRefitThreshold(treeRefitThreshold);
+		}
+
+
+		/**
+		 * \brief Evaluate each pair of the all-pairs solver only once and apply the force to both bodies.
+		 *
+		 * \param useSymmetricForces
+		 *      True to use the symmetric accumulation, false to evaluate each pair per body.
+		 */
+		void setUseSymmetricForces(const bool useSymmetricForces) {
+			_useSymmetricForces = useSymmetricForces;
+		}
+
+
+		/**
+		 * \brief Evaluate the pairs of the all-pairs solver in single precision (twice the lanes per register) and
+		 *        sum them in double precision (see GravityKernel::computeFieldsMixed()).
+		 *
+		 * \param useMixedPrecision
+		 *      True to use the mixed-precision kernel, false to evaluate the pairs in double precision.
+		 */
+		void setUseMixedPrecision(const bool useMixedPrecision) {
+			_useMixedPrecision = useMixedPrecision;
+		}
+
+
+		/**
+		 * \brief Traverse the Barnes-Hut tree once per group of nearby bodies and evaluate the shared interaction-list
+		 *        with the vectorized kernel (see BarnesHutTree::computeFieldsGrouped()) instead of once per body.
+		 *
+		 * \param useGroupedWalk
+		 *      True to use the grouped traversal, false to traverse the tree per body.
+		 */
+		void setUseGroupedWalk(const bool useGroupedWalk) {
+			_useGroupedWalk = useGroupedWalk;
+		}
+
+
+		/**
+		 * \brief Calculate the forces of the Barnes-Hut solver and integrate the bodies as a graph of tasks on a
+		 *        work-stealing pool (see TaskGraph): each chunk of bodies is kicked (and drifted) as soon as its
+		 *        forces are done, while the traversals of the other chunks are still running. The other solvers
+		 *        calculate the fields of all bodies at once and are not affected.
+		 *
+		 * \param useTaskGraph
+		 *      True to overlap the forces and the integration.
+		 */
+		void setUseTaskGraph(const bool useTaskGraph) {
+			_useTaskGraph = useTaskGraph;
+		}
+
+
+		/**
+		 * \brief Kick (and drift) each chunk of integrated bodies right after its forces are accumulated, while its
+		 *        state is still in the cache, instead of a second sweep over the forces, masses and velocities. The
+		 *        opening kick and the drift of the leapfrog are fused into one sweep as well. Only used with the
+		 *        direct (double precision, not symmetric) and the Barnes-Hut solver, without force-reuse and binaries.
+		 *
+		 * \param useFusedKick
+		 *      True to fuse the forces and the integration.
+		 */
+		void setUseFusedKick(const bool useFusedKick) {
+			_useFusedKick = useFusedKick;
+		}
+
+
+		/**
+		 * \brief Only recalculate the full forces every interval steps. In between, the far-field of each integrated
+		 *        body (its force without the near-field, see setNearFieldRadius()) is extrapolated linearly with the
+		 *        jerk estimated from its last two full forces, and only the near-field is calculated exactly.
+		 *        The largest relative error of the extrapolation is measured at each full recalculation (profiler-counter
+		 *        "forceReuseError"). Only used with the integrators which evaluate the forces once per step (not with
+		 *        yoshida, hermite and the block-timesteps).
+		 *
+		 * \param interval
+		 *      Steps between two full recalculations (1 => the forces are recalculated each step).
+		 */
+		void setForceReuseInterval(const int interval) {
+			_forceReuseInterval = std::max(interval, 1);
+			_farForces.clear();
+		}
+
+
+		/**
+		 * \brief Set the radius of the near-field of the reused forces (see setForceReuseInterval()). The pairs within
+		 *        the radius are summed exactly each step with a cell-list.
+		 *
+		 * \param radius
+		 *      Radius of the near-field (<= 0.0 => the whole force is extrapolated).
+		 */
+		void setNearFieldRadius(const double radius) {
+			_nearFieldRadius = radius;
+			_nearFieldGrid.setCutoffRadius(radius);
+			_farForces.clear();
+		}
+
+
+		/**
+		 * \brief Detect the tightly bound pairs (binaries) at the start of each step and integrate their relative
+		 *        motion exactly along the Kepler-orbit of the pair (see KeplerOrbit), while their center of mass is
+		 *        integrated with the rest of the system. The forces of the pair on each other are removed from the
+		 *        kicks (and from the adaptive time-step), only the perturbation by the other bodies is kicked.
+		 *        A pair is a binary if both bodies are integrated and each other's nearest neighbour within the
+		 *        radius, if it is bound, and if the other bodies pull them apart by less than BINARY_PERTURBATION
+		 *        of their mutual acceleration. Used with euler, leapfrog and yoshida.
+		 *
+		 * \param radius
+		 *      Maximum separation of a binary (<= 0.0 => no binaries).
+		 */
+		void setBinaryRadius(const double radius) {
+			_binaryRadius = radius;
+			_binaryGrid.setCutoffRadius(radius);
+		}
+
+
+		/**
+		 * \brief Get the partner of each body in a binary (see setBinaryRadius()).
+		 *
+		 * \return Index of the partner per body (-1 => single body, empty without binaries).
+		 */
+		const std::vector<int>& getBinaryPartners() const {
+			return _binaryPartners;
+		}
+
+
+		/**
+		 * \brief Sum the forces in a fixed order, so the result is bitwise the same with any number of threads
+		 *        (only the symmetric all-pairs solver depends on the threads otherwise).
+		 *
+		 * \param isDeterministic
+		 *      True to use the fixed order (slightly slower).
+		 */
+		void setIsDeterministic(const bool isDeterministic) {
+			_isDeterministic = isDeterministic;
+		}
+
+
+		/**
+		 * \brief Copy the state which is carried from one step to the next (forces, resting steps and levels of the
+		 *        block-timesteps) into a checkpoint.
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param state
+		 *      Output-parameter: State of the checkpoint (one value per body).
+		 */
+		void saveState(const BodyState &bodies, BinaryScene::State &state) const;
+
+
+		/**
+		 * \brief Reorder the state which is carried from one step to the next in the same way as the bodies
+		 *        (see BodyState::permute()).
+		 *
+		 * \param order
+		 *      Old index of the body at each new index.
+		 */
+		void permuteState(const std::vector<int> &order);
+
+
+		/**
+		 * \brief Drop the state which is carried from one step to the next, e.g. after bodies were added or removed
+		 *        (the forces are recomputed by the next step).
 		 */
-		void simulateStep(double dt, std::vector<SpaceObject*> &spaceObjects);
+		void resetState();
 
 
-		void initSpatialGrid(std::vector<SpaceObject*> &spaceObjects, Eigen::Vector3i gridResolution);
+		/**
+		 * \brief Extend the state which is carried from one step to the next by the last body after it was added
+		 *        (see BodyState::add()), its force is calculated by the next step.
+		 *
+		 * \param bodies
+		 *      State of all bodies (with the new body).
+		 */
+		void addBody(const BodyState &bodies);
+
+
+		/**
+		 * \brief Remove a body from the state which is carried from one step to the next in the same way as
+		 *        BodyState::remove().
+		 *
+		 * \param i
+		 *      Index of the removed body.
+		 * \param bodies
+		 *      State of all bodies (without the removed body).
+		 */
+		void removeBody(unsigned int i, const BodyState &bodies);
+
+
+		/**
+		 * \brief Recalculate the force of a body by the next step after its mass or its position was changed
+		 *        from outside of the integration (e.g. by a merge).
+		 *
+		 * \param i
+		 *      Index of the changed body.
+		 */
+		void changeBody(unsigned int i);
+
+
+		/**
+		 * \brief Restore the state which is carried from one step to the next from a checkpoint.
+		 *
+		 * \param state
+		 *      State of the checkpoint (without forces => they are recomputed by the next step).
+		 */
+		void restoreState(const BinaryScene::State &state);
+
+
+		/**
+		 * \brief Convert the name of a gravity-solver (direct, spatialGrid, barnesHut, particleMesh, gpu, fmm, gpuBarnesHut) to its value.
+		 *
+		 * \param name
+		 *      Name of the solver as used in the scene-json and on the command-line.
+		 * \param solver
+		 *      Parsed solver (unchanged if the name is unknown).
+		 *
+		 * \return True if the name is known.
+		 */
+		static bool parseGravitySolver(const std::string &name, GravitySolver &solver);
+
+
+		/**
+		 * \brief Convert the name of an integrator (euler, leapfrog, velocityVerlet, yoshida, wisdomHolman, hermite) to its value.
+		 *
+		 * \param name
+		 *      Name of the integrator as used in the scene-json and on the command-line.
+		 * \param integrator
+		 *      Parsed integrator (unchanged if the name is unknown).
+		 *
+		 * \return True if the name is known.
+		 */
+		static bool parseIntegrator(const std::string &name, Integrator &integrator);
+
+
+		/**
+		 * \brief Get the forces of the last evaluation (e.g. for an adaptive time-step).
+		 *
+		 * \return Force per body (empty before the first step, outdated for the sleeping bodies).
+		 */
+		const std::vector<Eigen::Vector3d>& getForces() const {
+			return _forces;
+		}
+
+
+		/**
+		 * \brief Calculate the gravitational potential of all bodies with the selected gravity-solver at the same
+		 *        approximation as its forces (the tree, the grid or the mesh are rebuilt from the current positions). The
+		 *        fast multipole method has no potential in its expansions, the octree with the same opening angle is used.
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param phi
+		 *      Output-parameter: Potential per body (including G, resized). The potential energy is sum(m_i * phi_i) / 2.
+		 */
+		void computePotentials(const BodyState &bodies, std::vector<double> &phi);
+
+
+		/**
+		 * \brief Get the spatial-grid of the cut-off solver (e.g. to set its parameters).
+		 *
+		 * \return Spatial-grid.
+		 */
+		SpatialGrid& getSpatialGrid() {
+			return _spatialGrid;
+		}
+
+
+		/**
+		 * \brief Update the spatial-grid to the current positions (e.g. if its cells are reused by the collision-detection).
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void updateSpatialGrid(const BodyState &bodies) {
+			_spatialGrid.update(bodies, G);
+		}
+
+
+		/**
+		 * \brief Get the particle-mesh solver (e.g. to set its parameters).
+		 *
+		 * \return Particle-mesh.
+		 */
+		ParticleMesh& getParticleMesh() {
+			return _particleMesh;
+		}
+
+
+		/**
+		 * \brief Get the fast multipole solver (e.g. to set its parameters).
+		 *
+		 * \return Fast multipole solver.
+		 */
+		FastMultipole& getFastMultipole() {
+			return _fastMultipole;
+		}
+
+
+		/**
+		 * \brief Get the gravitational constant of the simulation (e.g. for the orbits of the parked bodies).
+		 *
+		 * \return Gravitational constant.
+		 */
+		double getGravitationalConstant() const {
+			return G;
+		}
 
 		
 	private:
@@ -49,57 +570,515 @@ namespace pbs17 {
 		const double G = 1.0; // 6.67408 * pow(10.0, -4.0);
 		const double EPS = 0.000000001;
 
-		//! Flag if the spatial grid is used or not.
-		bool _useSpatialGrid = false;
+		//! Method used to calculate the gravitational forces.
+		GravitySolver _gravitySolver = DIRECT;
 
-		//! Bounding-box of the spatial-grid
-		Eigen::Vector3d _spatialBbMin;
-		Eigen::Vector3d _spatialBbMax;
+		//! Method used to integrate the positions and velocities.
+		Integrator _integrator = SEMI_IMPLICIT_EULER;
 
-		//! Reoslution size (number of grids) and length of each grid.
-		Eigen::Vector3i _resolutionSize;
-		Eigen::Vector3d _resolution;;
+		//! Forces of the last evaluation (reused by the next leapfrog/verlet-step)
+		std::vector<Eigen::Vector3d> _forces;
+		//! Jerks of the accelerations of the last evaluation (for the predictor of the next hermite-step)
+		std::vector<Eigen::Vector3d> _jerks;
+		//! True if _forces belong to the current positions
+		bool _hasForces = false;
+		//! Bodies which were added or changed after the forces were calculated (see addBody(), changeBody())
+		std::vector<int> _changedBodies;
 
-		//! Treshold used to cut of the influencer.
-		double _treshold = 0.1;
+		//! Flag if hierarchical block-timesteps are used
+		bool _useBlockTimesteps = false;
+		//! Finest level of the block-timesteps
+		int _maxTimestepLevel = 6;
+		//! Accuracy-parameter of the block-timesteps
+		double _timestepAccuracy = 0.02;
+		//! Current level per body
+		std::vector<int> _timestepLevels;
 
-		//! Spatial grid which contains the objects per grid
-		std::vector<std::vector<SpaceObject*>> _spatialGrid;
-		//! Grid-cells with the references of the influencer which have an impact on this cell
-		std::vector<std::map<long, SpaceObject*>> _influencer;
+		//! Flag if the all-pairs solver evaluates each pair only once (Newton's third law)
+		bool _useSymmetricForces = false;
+		//! Flag if the all-pairs solver evaluates the pairs in single precision (summed in double precision)
+		bool _useMixedPrecision = false;
+		//! Flag if the Barnes-Hut solver traverses the tree once per group of bodies
+		bool _useGroupedWalk = false;
+		//! Flag if the forces are summed in a fixed order (independent of the threads)
+		bool _isDeterministic = false;
 
-		//! Positions in the grid of each object. (row => object, 3d vector of indices per object)
-		Eigen::MatrixXi _spatialPosition;
+		//! Steps between two full recalculations of the forces (see setForceReuseInterval())
+		int _forceReuseInterval = 1;
+		//! Radius of the exact near-field of the reused forces
+		double _nearFieldRadius = 0.0;
+		//! Cell-list of the near-field (all bodies are binned)
+		SpatialGrid _nearFieldGrid;
+		//! Far-field (force without the near-field) per body at its last full recalculation, and its rate of change
+		std::vector<Eigen::Vector3d> _farForces;
+		std::vector<Eigen::Vector3d> _farJerks;
+		//! Time of the last full recalculation per body (-1.0 => no previous far-field for the jerk)
+		std::vector<double> _farTimes;
+		//! Steps since the last full recalculation
+		int _stepsSinceFullForces = 0;
+		//! Time of the last full recalculation
+		double _fullForcesTime = 0.0;
+		//! Simulated time, at which the forces of a step are evaluated
+		double _forceTime = 0.0;
+
+		//! Maximum separation of a binary (see setBinaryRadius())
+		double _binaryRadius = 0.0;
+		//! Cell-list of the search for the binaries (all bodies are binned)
+		SpatialGrid _binaryGrid;
+		//! Partner per body in a binary of the current step (-1 => single body). The forces of the partners on each other are not in _forces.
+		std::vector<int> _binaryPartners;
+		//! Maximum tidal acceleration by the other bodies relative to the mutual acceleration of a binary
+		static const double BINARY_PERTURBATION;
+
+		//! Flag if the forces and the integration of the Barnes-Hut solver are overlapped by a task-graph
+		bool _useTaskGraph = false;
+		//! Bodies per task of the task-graph
+		const int TASK_GRAIN_SIZE = 64;
+		//! Flag if the integration is fused into the calculation of the forces (see setUseFusedKick())
+		bool _useFusedKick = false;
+
+		//! Flag if resting bodies are put to sleep
+		bool _useSleeping = false;
+		//! Maximum velocity (and velocity-change per step) of a resting body
+		double _sleepVelocity = 1e-3;
+		//! Steps a body has to rest before it falls asleep (and interval of the checks of the field of sleeping bodies)
+		const int SLEEP_STEPS = 60;
+		//! Consecutive resting steps per body (>= SLEEP_STEPS => sleeping)
+		std::vector<int> _restingSteps;
+		//! Steps since the forces of the sleeping bodies have been checked
+		int _stepsSinceFieldCheck = 0;
+		//! Indices of the bodies which are integrated in the current step
+		std::vector<int> _activeBodies;
+
+		//! Center of the inner zone which is integrated (see setRails())
+		Eigen::Vector3d _railsCenter = Eigen::Vector3d::Zero();
+		//! Radius of the inner zone (<= 0.0 => no rails)
+		double _railsRadius = 0.0;
+		//! Indices of the bodies which are moved on rails in the current step
+		std::vector<int> _railBodies;
+		//! True per body which was moved on rails in the last step (its force is outdated)
+		std::vector<char> _isOnRails;
+		//! Heaviest body (center of the orbits) and its state at the start of the step
+		int _centralBody = -1;
+		Eigen::Vector3d _centralPosition;
+		Eigen::Vector3d _centralVelocity;
+
+		//! Octree which is rebuilt each step if the Barnes-Hut solver is used
+		BarnesHutTree _barnesHutTree;
+
+		//! Cell-list of the cut-off solver, which is updated each step
+		SpatialGrid _spatialGrid;
+
+		//! Mesh of the particle-mesh solver
+		ParticleMesh _particleMesh;
+
+		//! Tree and expansions of the fast multipole solver
+		FastMultipole _fastMultipole;
+
+		//! Device-buffers of the GPU-solver
+		GpuGravity _gpuGravity;
+
+		//! Device-buffers of the GPU-tree (same opening angle as the Barnes-Hut tree)
+		GpuBarnesHut _gpuBarnesHut;
+
+
+		/**
+		 * \brief Calculate the forces with the selected gravity-solver.
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param forces
+		 *      Resulting force per space-object (resized).
+		 */
+		void computeForces(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces);
+
+
+		/**
+		 * \brief Calculate the forces only for the given bodies. All bodies are used as sources.
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param active
+		 *      Indices of the bodies for which the forces are calculated.
+		 * \param forces
+		 *      Resulting force per space-object (only the active ones are overwritten).
+		 */
+		void computeForcesActive(const BodyState &bodies, const std::vector<int> &active, std::vector<Eigen::Vector3d> &forces);
+
+
+		/**
+		 * \brief Calculate the forces of the bodies which are integrated in the current step (_activeBodies).
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void updateForces(const BodyState &bodies);
+
+
+		/**
+		 * \brief Check if the forces of the current integrator are reused (see setForceReuseInterval()).
+		 * \return True if the far-field is extrapolated between the full recalculations.
+		 */
+		bool isForceReused() const {
+			return _forceReuseInterval > 1 && !_useBlockTimesteps && _integrator != YOSHIDA && _integrator != HERMITE;
+		}
+
+
+		/**
+		 * \brief Same as updateForces(), but the full forces are only recalculated every _forceReuseInterval steps.
+		 *        In between, the forces are the extrapolated far-field plus the exact near-field.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void updateForcesReused(const BodyState &bodies);
+
+
+		/**
+		 * \brief Calculate the near-field forces of all bodies (see setNearFieldRadius()).
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param forces
+		 *      Output-parameter: Near-field force per body (resized, zero without a near-field).
+		 */
+		void computeNearForces(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces);
 
-		//! Number of cells in each dimension the objects have influence
-		Eigen::MatrixXi _influenceRadius;
-		
 
 		/**
-		 * \brief Get the position of the point in the spatial-index-grid for a given point.
+		 * \brief Calculate the forces of the integrated bodies (_activeBodies) and kick their velocities, optionally
+		 *        followed by a drift of the positions. The Barnes-Hut solver overlaps the phases with a task-graph.
 		 *
-		 * \param position Position of the point which one want to know the index in the spatial-grid
+		 * \param h
+		 *      Time-step of the kick (and of the drift).
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param isDrifted
+		 *      True to drift the positions after the kick (semi-implicit euler).
+		 */
+		void updateForcesAndKick(double h, BodyState &bodies, bool isDrifted);
+
+
+		/**
+		 * \brief Check if the forces of the current solver can be fused with the integration (see setUseFusedKick()).
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \return True if updateForcesAndKickFused() and kickAndDrift() are used.
+		 */
+		bool isKickFused(const BodyState &bodies) const;
+
+
+		/**
+		 * \brief Same as updateForcesAndKick(), but each chunk of integrated bodies is kicked (and drifted) on the
+		 *        thread which just accumulated its forces (see setUseFusedKick()).
 		 *
-		 * \return Position in the spatial-index
+		 * \param h
+		 *      Time-step of the kick (and of the drift).
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param isDrifted
+		 *      True to drift the positions after the kick (semi-implicit euler).
 		 */
-		Eigen::Vector3i binSpatialInformation(Eigen::Vector3d position);
+		void updateForcesAndKickFused(double h, BodyState &bodies, bool isDrifted);
 
 
 		/**
-		 * \brief Get the position of the point in the spatial-index-grid for a given point.
+		 * \brief Kick and drift the integrated bodies in one sweep (same as kick() followed by drift() without binaries).
 		 *
-		 * \param position Position of the point which one want to know the index in the spatial-grid
+		 * \param hKick
+		 *      Time-step of the kick.
+		 * \param hDrift
+		 *      Time-step of the drift.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void kickAndDrift(double hKick, double hDrift, BodyState &bodies);
+
+
+		/**
+		 * \brief Wake the sleeping bodies which are moved (by contacts or the player) or whose field got stronger,
+		 *        and collect the bodies which are integrated in the current step.
 		 *
-		 * \return Position in the spatial-index
+		 * \param dt
+		 *      Time difference since between the last frames.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void selectActiveBodies(double dt, BodyState &bodies);
+
+
+		/**
+		 * \brief Check if the binaries are integrated with the current integrator (see setBinaryRadius()).
+		 * \return True if binaries are detected.
+		 */
+		bool isUsingBinaries() const {
+			return _binaryRadius > 0.0 && !_useBlockTimesteps
+				&& (_integrator == SEMI_IMPLICIT_EULER || _integrator == LEAPFROG || _integrator == YOSHIDA);
+		}
+
+
+		/**
+		 * \brief Detect the binaries among the integrated bodies (see setBinaryRadius()) and move the forces of
+		 *        the formed and dissolved pairs on each other out of, or back into, the current forces.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void selectBinaries(const BodyState &bodies);
+
+
+		/**
+		 * \brief Dissolve the binary of a body and add the forces of the pair on each other back to the current forces.
+		 * \param i
+		 *      Index of a body of the binary.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void dissolveBinary(int i, const BodyState &bodies);
+
+
+		/**
+		 * \brief Get the softened newtonian force of one body on another one (the same as in the gravity-solvers).
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param i
+		 *      Index of the attracted body.
+		 * \param j
+		 *      Index of the attracting body.
+		 * \return Force on the body i.
+		 */
+		Eigen::Vector3d getMutualForce(const BodyState &bodies, int i, int j) const;
+
+
+		/**
+		 * \brief Remove the forces of the partners of the binaries on each other.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param targets
+		 *      Indices of the bodies whose forces were calculated.
+		 * \param forces
+		 *      Output-parameter: Force per body (only the targets are changed).
+		 */
+		void removeBinaryForces(const BodyState &bodies, const std::vector<int> &targets, std::vector<Eigen::Vector3d> &forces) const;
+
+
+		/**
+		 * \brief Drift a binary: its center of mass moves with its velocity, the relative motion follows the
+		 *        Kepler-orbit of the pair (linear if the anomaly doesn't converge).
+		 * \param h
+		 *      Time-step of the drift.
+		 * \param i, j
+		 *      Indices of both bodies of the binary.
+		 * \param bodies
+		 *      State of all bodies in the scene.
 		 */
-		unsigned int getIndex(Eigen::Vector3i position);
+		void driftBinary(double h, int i, int j, BodyState &bodies);
+
 
 		/**
-		 * \brief Add an influencer on the specified
+		 * \brief Move the active bodies outside of the inner zone to the rails (see setRails()). The bodies which
+		 *        come back from the rails get new forces.
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
 		 */
-		void addInfluencer(unsigned int i, SpaceObject* spaceObject, Eigen::Vector3i position);
-		void removeInfluencer(unsigned int i, SpaceObject* spaceObject, Eigen::Vector3i position);
+		void selectRailBodies(const BodyState &bodies);
+
 
+		/**
+		 * \brief Move the bodies on rails along their Kepler-orbits relative to the central body.
+		 *
+		 * \param dt
+		 *      Time difference since between the last frames.
+		 * \param bodies
+		 *      State of all bodies in the scene (the central body is already integrated).
+		 */
+		void moveOnRails(double dt, BodyState &bodies);
+
+
+		/**
+		 * \brief Count the resting steps of the integrated bodies and put them to sleep after SLEEP_STEPS.
+		 *
+		 * \param dt
+		 *      Time difference since between the last frames.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void updateRestingBodies(double dt, BodyState &bodies);
+
+
+		/**
+		 * \brief Advance all bodies by dt with hierarchical block-timesteps (kick-drift-kick leapfrog per body).
+		 *        Each body steps with dt / 2^level, where the level is selected with eta * |a| / |da/dt|.
+		 *        All bodies are drifted each sub-step, but only the bodies at the end of their step get new forces.
+		 *
+		 * \param dt
+		 *      Time difference since between the last frames.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void simulateBlockStep(double dt, BodyState &bodies);
+
+
+		/**
+		 * \brief Update the linear velocities of the integrated bodies with the current forces.
+		 *
+		 * \param h
+		 *      Time-step of the kick.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void kick(double h, BodyState &bodies);
+
+
+		/**
+		 * \brief Update the positions of the integrated bodies with the current linear velocities.
+		 *
+		 * \param h
+		 *      Time-step of the drift.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void drift(double h, BodyState &bodies);
+
+
+		/**
+		 * \brief Advance the integrated bodies with the Wisdom-Holman map (kick-drift-kick): the other bodies move
+		 *        along their Kepler-orbit around the heaviest body (the primary) during the drift, the kicks only
+		 *        apply the perturbation of all other bodies. A pure two-body orbit is exact for any time-step.
+		 *
+		 * \param dt
+		 *      Time difference since between the last frames.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void simulateWisdomHolmanStep(double dt, BodyState &bodies);
+
+
+		/**
+		 * \brief Advance the integrated bodies with the fourth-order Hermite predictor-corrector: the positions and
+		 *        velocities are predicted with the accelerations and jerks of the last step, both are evaluated once
+		 *        at the predicted state, and the corrector interpolates the two evaluations.
+		 *
+		 * \param dt
+		 *      Time difference since between the last frames.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void simulateHermiteStep(double dt, BodyState &bodies);
+
+
+		/**
+		 * \brief Calculate the forces and the jerks of their accelerations with the all-pairs kernel at the current
+		 *        state (positions and velocities) of the bodies. All bodies are used as sources.
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param targets
+		 *      Indices of the bodies whose forces (_forces) and jerks (_jerks) are overwritten.
+		 */
+		void computeForcesAndJerks(const BodyState &bodies, const std::vector<int> &targets);
+
+
+		/**
+		 * \brief Kick the integrated bodies by their forces without the Kepler-acceleration of the primary.
+		 *
+		 * \param h
+		 *      Time-step of the kick.
+		 * \param primary
+		 *      Index of the primary body.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void kickPerturbations(double h, int primary, BodyState &bodies);
+
+
+		/**
+		 * \brief Drift the primary along its velocity and the other integrated bodies along their Kepler-orbits
+		 *        around it (see KeplerOrbit).
+		 *
+		 * \param h
+		 *      Time-step of the drift.
+		 * \param primary
+		 *      Index of the primary body.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void driftKepler(double h, int primary, BodyState &bodies);
+
+
+		/**
+		 * \brief Update the orientations of the integrated bodies (and of the bodies on rails) with the angular velocities.
+		 *
+		 * \param dt
+		 *      Time difference since between the last frames.
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 */
+		void rotate(double dt, BodyState &bodies);
+
+
+		/**
+		 * \brief Calculate the forces with the exact all-pairs summation (vectorized kernel).
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param forces
+		 *      Resulting force per space-object.
+		 */
+		void computeForcesDirect(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces);
+
+
+		/**
+		 * \brief Calculate the forces with the cut-off solver (neighbouring cells and far-reaching bodies).
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param forces
+		 *      Resulting force per space-object.
+		 */
+		void computeForcesSpatialGrid(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces);
+
+
+		/**
+		 * \brief Calculate the forces with the Barnes-Hut octree, which is rebuilt from the current positions.
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param forces
+		 *      Resulting force per space-object.
+		 */
+		void computeForcesBarnesHut(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces);
+
+
+		/**
+		 * \brief Calculate the forces with the Barnes-Hut tree on the GPU (the tree on the CPU if the GPU failed).
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param forces
+		 *      Resulting force per space-object.
+		 */
+		void computeForcesGpuBarnesHut(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces);
+
+
+		/**
+		 * \brief Calculate the forces with the particle-mesh solver.
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param forces
+		 *      Resulting force per space-object.
+		 */
+		void computeForcesParticleMesh(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces);
+
+
+		/**
+		 * \brief Calculate the forces with the fast multipole method.
+		 *
+		 * \param bodies
+		 *      State of all bodies in the scene.
+		 * \param forces
+		 *      Resulting force per space-object.
+		 */
+		void computeForcesFastMultipole(const BodyState &bodies, std::vector<Eigen::Vector3d> &forces);
 	};
 
 }
@@ -0,0 +1,182 @@
+﻿/**
+ * \brief Implementation of the placement of the simulation on the NUMA-nodes (memory and threads).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "NumaPolicy.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "ThreadBudget.h"
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "MemoryTracker.h"
+
+using namespace pbs17;
+
+
+//! By default, the threads are scheduled by the OS
+bool NumaPolicy::IS_PINNED = false;
+bool NumaPolicy::USE_HUGE_PAGES = false;
+int NumaPolicy::RENDER_CPUS = 1;
+
+//! Smaller arrays (e.g. of a few thousand bodies) fit into the caches anyway
+const size_t NumaPolicy::LARGE_ARRAY = 256 * 1024;
+//! Size of the huge pages of x86-64
+const size_t NumaPolicy::HUGE_PAGE = 2 * 1024 * 1024;
+
+
+/**
+ * \brief Allocate the memory of an array and touch its pages in parallel (small arrays are allocated
+ *        normally).
+ *
+ * \param bytes
+ *      Size of the array.
+ *
+ * \return Allocated memory (throws std::bad_alloc if it is not available).
+ */
+void* NumaPolicy::allocate(size_t bytes) {
+	if (bytes < LARGE_ARRAY) {
+		void* memory = ::operator new(bytes);
+		MemoryTracker::add(MemoryTracker::BODIES, static_cast<long long>(bytes));
+		return memory;
+	}
+
+#if defined(__linux__)
+	// the mapped pages are untouched, so they are not placed yet
+	size_t size = USE_HUGE_PAGES ? (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE : bytes;
+	size_t mapped = USE_HUGE_PAGES ? size + HUGE_PAGE : size;
+	void* memory = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		throw std::bad_alloc();
+	}
+
+	if (USE_HUGE_PAGES) {
+		// only the aligned huge pages are kept, the rest of the mapping is released again
+		uintptr_t begin = reinterpret_cast<uintptr_t>(memory);
+		uintptr_t aligned = (begin + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+		if (aligned > begin) {
+			munmap(memory, aligned - begin);
+		}
+		if (begin + mapped > aligned + size) {
+			munmap(reinterpret_cast<void*>(aligned + size), begin + mapped - aligned - size);
+		}
+
+		memory = reinterpret_cast<void*>(aligned);
+		madvise(memory, size, MADV_HUGEPAGE);
+	}
+
+	touchPages(memory, size);
+	MemoryTracker::add(MemoryTracker::BODIES, static_cast<long long>(bytes));
+	return memory;
+#else
+	void* memory = ::operator new(bytes);
+	touchPages(memory, bytes);
+	MemoryTracker::add(MemoryTracker::BODIES, static_cast<long long>(bytes));
+	return memory;
+#endif
+}
+
+
+/**
+ * \brief Free the memory of an array.
+ *
+ * \param memory
+ *      Memory returned by allocate().
+ * \param bytes
+ *      Same size as passed to allocate().
+ */
+void NumaPolicy::deallocate(void* memory, size_t bytes) {
+	MemoryTracker::add(MemoryTracker::BODIES, -static_cast<long long>(bytes));
+
+#if defined(__linux__)
+	if (bytes >= LARGE_ARRAY) {
+		munmap(memory, USE_HUGE_PAGES ? (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE : bytes);
+		return;
+	}
+#endif
+
+	::operator delete(memory);
+}
+
+
+/**
+ * \brief Pin the OpenMP-threads of the calling thread to the cpus behind the ones of the rendering and use one
+ *        thread per remaining cpu (has to be called by every thread which runs the parallel loops, before the
+ *        bodies are loaded).
+ */
+void NumaPolicy::pinWorkers() {
+#if defined(__linux__) && defined(_OPENMP)
+	if (!IS_PINNED) return;
+
+	int cpus = std::max(static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)), 1);
+	int reserved = std::min(RENDER_CPUS, cpus - 1);
+	int workers = std::max(std::min(cpus - reserved, ThreadBudget::getNumThreads(ThreadBudget::CRITICAL)), 1);
+	omp_set_num_threads(workers);
+
+	// the thread k of every team runs on the same cpu, so the teams of different threads share the placement
+#pragma omp parallel
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(reserved + omp_get_thread_num() % workers, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	}
+#endif
+}
+
+
+/**
+ * \brief Pin the calling thread (the rendering) to the cpus which are reserved for it.
+ */
+void NumaPolicy::pinRenderThread() {
+#if defined(__linux__)
+	if (!IS_PINNED) return;
+
+	int cpus = std::max(static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)), 1);
+	int reserved = std::max(std::min(RENDER_CPUS, cpus - 1), 1);
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int cpu = 0; cpu < reserved; ++cpu) {
+		CPU_SET(cpu, &set);
+	}
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+
+/**
+ * \brief Write one byte per page by the OpenMP-threads in a static partition.
+ *
+ * \param memory
+ *      Untouched memory.
+ * \param bytes
+ *      Size of the memory.
+ */
+void NumaPolicy::touchPages(void* memory, size_t bytes) {
+	// the same static partition as the loops over the bodies => each thread owns the pages of its bodies
+	const long pageSize = 4096;
+	char* pages = static_cast<char*>(memory);
+	long cntPages = static_cast<long>((bytes + pageSize - 1) / pageSize);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+	for (long i = 0; i < cntPages; ++i) {
+		pages[i * pageSize] = 0;
+	}
+}
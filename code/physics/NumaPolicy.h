@@ -0,0 +1,167 @@
+﻿/**
+ * \brief Implementation of the placement of the simulation on the NUMA-nodes (memory and threads).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief NumaPolicy places the arrays of the bodies and the OpenMP-threads which work on them, so each thread finds
+	 * its part of the bodies in the memory of its own socket:
+	 *  - The pages of the large arrays are touched first by the OpenMP-threads in the static partition of the loops
+	 *    over the bodies (the OS places a page on the node of the thread which touches it first), instead of by the
+	 *    thread which loads the scene. Optionally the arrays are backed by (transparent) huge pages.
+	 *  - The OpenMP-threads can be pinned: The thread k of each team always runs on the same cpu (behind the cpus
+	 *    which are reserved for the rendering), so the team of the physics-thread works on the pages which the team of
+	 *    the loading thread has touched.
+	 * The placement by the first touch is done on every OS, the huge pages and the pinning need Linux.
+	 */
+	class NumaPolicy {
+	public:
+
+		/**
+		 * \brief Allocate the memory of an array and touch its pages in parallel (small arrays are allocated
+		 *        normally).
+		 *
+		 * \param bytes
+		 *      Size of the array.
+		 *
+		 * \return Allocated memory (throws std::bad_alloc if it is not available).
+		 */
+		static void* allocate(size_t bytes);
+
+
+		/**
+		 * \brief Free the memory of an array.
+		 *
+		 * \param memory
+		 *      Memory returned by allocate().
+		 * \param bytes
+		 *      Same size as passed to allocate().
+		 */
+		static void deallocate(void* memory, size_t bytes);
+
+
+		/**
+		 * \brief Pin the OpenMP-threads of the calling thread to the cpus behind the ones of the rendering and use one
+		 *        thread per remaining cpu (has to be called by every thread which runs the parallel loops, before the
+		 *        bodies are loaded).
+		 */
+		static void pinWorkers();
+
+
+		/**
+		 * \brief Pin the calling thread (the rendering) to the cpus which are reserved for it.
+		 */
+		static void pinRenderThread();
+
+
+		/**
+		 * \brief Enable or disable the pinning of the threads. Has to be set before the scene is loaded.
+		 *
+		 * \param isPinned
+		 *      True if the threads are pinned to their cpus.
+		 */
+		static void setIsPinned(bool isPinned) {
+			IS_PINNED = isPinned;
+		}
+
+
+		/**
+		 * \brief Back the large arrays by huge pages (madvise, the transparent huge pages have to be enabled). Has to
+		 *        be set before the scene is loaded.
+		 *
+		 * \param useHugePages
+		 *      True if the arrays are aligned to and advised for huge pages.
+		 */
+		static void setUseHugePages(bool useHugePages) {
+			USE_HUGE_PAGES = useHugePages;
+		}
+
+
+		/**
+		 * \brief Set the number of cpus which are left to the rendering by the pinned OpenMP-threads.
+		 *
+		 * \param renderCpus
+		 *      Number of the first cpus which are reserved.
+		 */
+		static void setRenderCpus(int renderCpus) {
+			RENDER_CPUS = renderCpus > 0 ? renderCpus : 0;
+		}
+
+
+	private:
+
+		//! True if the threads are pinned to their cpus
+		static bool IS_PINNED;
+		//! True if the large arrays are backed by huge pages
+		static bool USE_HUGE_PAGES;
+		//! Number of the first cpus which are reserved for the rendering
+		static int RENDER_CPUS;
+
+		//! Size above which an array is placed by its first touch
+		static const size_t LARGE_ARRAY;
+		//! Size and alignment of a huge page
+		static const size_t HUGE_PAGE;
+
+
+		/**
+		 * \brief Write one byte per page by the OpenMP-threads in a static partition.
+		 *
+		 * \param memory
+		 *      Untouched memory.
+		 * \param bytes
+		 *      Size of the memory.
+		 */
+		static void touchPages(void* memory, size_t bytes);
+	};
+
+
+	/**
+	 * \brief Allocator of the arrays of the bodies (see BodyState), which are placed by the NumaPolicy.
+	 *
+	 * \tparam T
+	 *      Type of the values.
+	 */
+	template <typename T>
+	class NumaAllocator {
+	public:
+		typedef T value_type;
+
+		NumaAllocator() {}
+
+		template <typename U>
+		NumaAllocator(const NumaAllocator<U>&) {}
+
+		T* allocate(size_t n) {
+			return static_cast<T*>(NumaPolicy::allocate(n * sizeof(T)));
+		}
+
+		void deallocate(T* memory, size_t n) {
+			NumaPolicy::deallocate(memory, n * sizeof(T));
+		}
+
+		template <typename U>
+		struct rebind {
+			typedef NumaAllocator<U> other;
+		};
+	};
+
+	template <typename T, typename U>
+	bool operator==(const NumaAllocator<T>&, const NumaAllocator<U>&) {
+		return true;
+	}
+
+	template <typename T, typename U>
+	bool operator!=(const NumaAllocator<T>&, const NumaAllocator<U>&) {
+		return false;
+	}
+}
@@ -0,0 +1,324 @@
+﻿/**
+ * \brief Implementation of the time-parallel (Parareal) integrator for long orbit studies.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "PararealIntegrator.h"
+
+#include <math.h>
+#include <algorithm>
+
+#include "EnsembleIntegrator.h"
+#include "KeplerOrbit.h"
+
+using namespace pbs17;
+
+
+//! Gravitational constant of the Kepler-propagator (same as the EnsembleIntegrator)
+const double PararealIntegrator::G = 1.0;
+
+
+/**
+ * \brief Constructor of the integrator (all bodies are at the origin without mass until they are set).
+ *
+ * \param cntBodies
+ *      Number of bodies.
+ */
+PararealIntegrator::PararealIntegrator(unsigned int cntBodies)
+	: _cntBodies(cntBodies), _masses(cntBodies, 0.0), _state(6 * cntBodies, 0.0), _integrator(NBodyManager::LEAPFROG),
+	_coarse(LEAPFROG), _cntCoarseSteps(1), _tolerance(1e-8), _maxIterations(0), _lastCorrection(0.0) {
+}
+
+
+/**
+ * \brief Set the state of a body.
+ *
+ * \param body
+ *      Index of the body.
+ * \param mass
+ *      Mass of the body.
+ * \param position
+ *      Position of the body.
+ * \param velocity
+ *      Velocity of the body.
+ */
+void PararealIntegrator::setBody(unsigned int body, double mass, const Eigen::Vector3d &position, const Eigen::Vector3d &velocity) {
+	_masses[body] = mass;
+	for (int d = 0; d < 3; ++d) {
+		_state[6 * body + d] = position[d];
+		_state[6 * body + 3 + d] = velocity[d];
+	}
+}
+
+
+/**
+ * \brief Set the fine integrator.
+ *
+ * \param integrator
+ *      Integrator (the Wisdom-Holman map is not supported, the leapfrog is used instead).
+ *
+ * \return False if the integrator is not supported.
+ */
+bool PararealIntegrator::setIntegrator(NBodyManager::Integrator integrator) {
+	_integrator = integrator;
+
+	// the ensemble reports (and replaces) the unsupported integrators
+	EnsembleIntegrator probe(1, 1);
+	return probe.setIntegrator(integrator);
+}
+
+
+/**
+ * \brief Set the coarse propagator.
+ *
+ * \param coarse
+ *      Leapfrog with large steps or Kepler-orbits about the heaviest body.
+ * \param cntSteps
+ *      Number of leapfrog-steps per slice (ignored by the Kepler-propagator).
+ */
+void PararealIntegrator::setCoarse(Coarse coarse, unsigned int cntSteps) {
+	_coarse = coarse;
+	_cntCoarseSteps = std::max(1u, cntSteps);
+}
+
+
+/**
+ * \brief Set the convergence-criteria.
+ *
+ * \param tolerance
+ *      Largest change of the boundary-states (relative to the size of the system) between two iterations.
+ * \param maxIterations
+ *      Maximum number of iterations (0: the number of slices, after which the result is exact).
+ */
+void PararealIntegrator::setConvergence(double tolerance, unsigned int maxIterations) {
+	_tolerance = tolerance;
+	_maxIterations = maxIterations;
+}
+
+
+/**
+ * \brief Integrate the system.
+ *
+ * \param dt
+ *      Time-step of the fine integrator.
+ * \param cntSteps
+ *      Number of fine time-steps.
+ * \param cntSlices
+ *      Number of time-slices (limited to the number of steps).
+ *
+ * \return Number of iterations.
+ */
+unsigned int PararealIntegrator::integrate(double dt, unsigned int cntSteps, unsigned int cntSlices) {
+	_lastCorrection = 0.0;
+	if (cntSteps == 0) {
+		return 0;
+	}
+
+	const unsigned int n = std::max(1u, std::min(cntSlices, cntSteps));
+	const unsigned int maxIterations = _maxIterations == 0 ? n : std::min(_maxIterations, n);
+
+	// the remainder of the steps is distributed over the first slices
+	std::vector<unsigned int> steps(n, cntSteps / n);
+	for (unsigned int j = 0; j < cntSteps % n; ++j) {
+		steps[j]++;
+	}
+
+	// initial prediction: the coarse propagator is applied sequentially over all slices, the results are kept
+	// for the correction of the next iteration
+	std::vector<State> boundaries(n + 1, _state);
+	std::vector<State> coarse(n);
+	std::vector<State> fine(n);
+	for (unsigned int j = 0; j < n; ++j) {
+		coarse[j] = boundaries[j];
+		propagateCoarse(coarse[j], steps[j] * dt);
+		boundaries[j + 1] = coarse[j];
+	}
+
+	unsigned int iterations = 0;
+	while (iterations < maxIterations) {
+		// after k iterations, the first k slices are exact and don't need to be integrated again
+		const int first = (int) iterations;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+		for (int j = first; j < (int) n; ++j) {
+			fine[j] = boundaries[j];
+			propagateEnsemble(fine[j], _integrator, dt, steps[j]);
+		}
+
+		// sequential correction: U[j+1] = G(U_new[j]) + F(U_old[j]) - G(U_old[j])
+		double correction = 0.0;
+		State predicted;
+		for (unsigned int j = first; j < n; ++j) {
+			predicted = boundaries[j];
+			propagateCoarse(predicted, steps[j] * dt);
+
+			State corrected(predicted.size());
+			for (std::size_t i = 0; i < corrected.size(); ++i) {
+				corrected[i] = predicted[i] + fine[j][i] - coarse[j][i];
+			}
+
+			correction = std::max(correction, computeDifference(corrected, boundaries[j + 1]));
+			boundaries[j + 1].swap(corrected);
+			coarse[j].swap(predicted);
+		}
+
+		iterations++;
+		_lastCorrection = correction;
+		if (correction <= _tolerance) {
+			break;
+		}
+	}
+
+	_state = boundaries[n];
+	return iterations;
+}
+
+
+/**
+ * \brief Compute the total energy of the system (kinetic and softened potential energy).
+ *
+ * \return Energy of the system.
+ */
+double PararealIntegrator::computeEnergy() const {
+	EnsembleIntegrator ensemble(_cntBodies, 1);
+	for (unsigned int b = 0; b < _cntBodies; ++b) {
+		ensemble.setBody(0, b, _masses[b], getPosition(b), getVelocity(b));
+	}
+
+	return ensemble.computeEnergy(0);
+}
+
+
+/**
+ * \brief Parse the name of a coarse propagator.
+ *
+ * \param name
+ *      Name of the propagator ("leapfrog" or "kepler").
+ * \param coarse
+ *      Output-parameter: Parsed propagator.
+ *
+ * \return False if the name is unknown.
+ */
+bool PararealIntegrator::parseCoarse(const std::string &name, Coarse &coarse) {
+	if (name == "leapfrog") {
+		coarse = LEAPFROG;
+	} else if (name == "kepler") {
+		coarse = KEPLER;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Integrate a state with the EnsembleIntegrator (fine integrator or leapfrog-propagator).
+ *
+ * \param state
+ *      Input- and output-parameter: State which is integrated.
+ * \param integrator
+ *      Integrator.
+ * \param dt
+ *      Time-step.
+ * \param cntSteps
+ *      Number of time-steps.
+ */
+void PararealIntegrator::propagateEnsemble(State &state, NBodyManager::Integrator integrator, double dt, unsigned int cntSteps) const {
+	EnsembleIntegrator ensemble(_cntBodies, 1);
+	ensemble.setIntegrator(integrator);
+	for (unsigned int b = 0; b < _cntBodies; ++b) {
+		ensemble.setBody(0, b, _masses[b], Eigen::Vector3d(state[6 * b], state[6 * b + 1], state[6 * b + 2]),
+			Eigen::Vector3d(state[6 * b + 3], state[6 * b + 4], state[6 * b + 5]));
+	}
+
+	for (unsigned int s = 0; s < cntSteps; ++s) {
+		ensemble.step(dt);
+	}
+
+	for (unsigned int b = 0; b < _cntBodies; ++b) {
+		Eigen::Vector3d position = ensemble.getPosition(0, b);
+		Eigen::Vector3d velocity = ensemble.getVelocity(0, b);
+		for (int d = 0; d < 3; ++d) {
+			state[6 * b + d] = position[d];
+			state[6 * b + 3 + d] = velocity[d];
+		}
+	}
+}
+
+
+/**
+ * \brief Integrate a state with the coarse propagator.
+ *
+ * \param state
+ *      Input- and output-parameter: State which is integrated.
+ * \param duration
+ *      Length of the slice.
+ */
+void PararealIntegrator::propagateCoarse(State &state, double duration) const {
+	if (_coarse == LEAPFROG) {
+		propagateEnsemble(state, NBodyManager::LEAPFROG, duration / _cntCoarseSteps, _cntCoarseSteps);
+		return;
+	}
+
+	// Kepler: the heaviest body drifts with its velocity, all others move on their two-body orbits about it
+	unsigned int central = (unsigned int) (std::max_element(_masses.begin(), _masses.end()) - _masses.begin());
+	Eigen::Vector3d centralPosition(state[6 * central], state[6 * central + 1], state[6 * central + 2]);
+	Eigen::Vector3d centralVelocity(state[6 * central + 3], state[6 * central + 4], state[6 * central + 5]);
+
+	for (unsigned int b = 0; b < _cntBodies; ++b) {
+		if (b == central) {
+			continue;
+		}
+
+		Eigen::Vector3d position = Eigen::Vector3d(state[6 * b], state[6 * b + 1], state[6 * b + 2]) - centralPosition;
+		Eigen::Vector3d velocity = Eigen::Vector3d(state[6 * b + 3], state[6 * b + 4], state[6 * b + 5]) - centralVelocity;
+		if (!KeplerOrbit::propagate(G * (_masses[central] + _masses[b]), position, velocity, duration)) {
+			// e.g. a massless central body: the relative motion is a straight line
+			position += velocity * duration;
+		}
+
+		position += centralPosition + centralVelocity * duration;
+		velocity += centralVelocity;
+		for (int d = 0; d < 3; ++d) {
+			state[6 * b + d] = position[d];
+			state[6 * b + 3 + d] = velocity[d];
+		}
+	}
+
+	for (int d = 0; d < 3; ++d) {
+		state[6 * central + d] += centralVelocity[d] * duration;
+	}
+}
+
+
+/**
+ * \brief Compute the largest difference of two states relative to the size of the system.
+ *
+ * \return Relative difference of the positions or velocities.
+ */
+double PararealIntegrator::computeDifference(const State &a, const State &b) {
+	double scalePosition = 0.0;
+	double scaleVelocity = 0.0;
+	double diffPosition = 0.0;
+	double diffVelocity = 0.0;
+
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		bool isPosition = (i % 6) < 3;
+		double scale = fabs(a[i]);
+		double diff = fabs(a[i] - b[i]);
+		if (isPosition) {
+			scalePosition = std::max(scalePosition, scale);
+			diffPosition = std::max(diffPosition, diff);
+		} else {
+			scaleVelocity = std::max(scaleVelocity, scale);
+			diffVelocity = std::max(diffVelocity, diff);
+		}
+	}
+
+	return std::max(diffPosition / std::max(scalePosition, 1e-12), diffVelocity / std::max(scaleVelocity, 1e-12));
+}
@@ -0,0 +1,223 @@
+﻿/**
+ * \brief Implementation of the time-parallel (Parareal) integrator for long orbit studies.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "NBodyManager.h"
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Integrates one gravitational system over a long time-span in parallel in time (Parareal): the span is
+	 * split into slices, a cheap coarse propagator predicts the states at the slice-boundaries sequentially and the
+	 * fine integrator (EnsembleIntegrator with the configured integrator and time-step) corrects all slices at once
+	 * on the OpenMP-threads. The corrections are iterated until the boundary-states don't change anymore.
+	 *
+	 * Only the gravity is simulated (same as the EnsembleIntegrator, no collisions).
+	 */
+	class PararealIntegrator {
+	public:
+		/**
+		 * \brief Propagator which is used for the predictions.
+		 */
+		enum Coarse {
+			LEAPFROG,
+			KEPLER
+		};
+
+
+		/**
+		 * \brief Constructor of the integrator (all bodies are at the origin without mass until they are set).
+		 *
+		 * \param cntBodies
+		 *      Number of bodies.
+		 */
+		explicit PararealIntegrator(unsigned int cntBodies);
+
+
+		/**
+		 * \brief Set the state of a body.
+		 *
+		 * \param body
+		 *      Index of the body.
+		 * \param mass
+		 *      Mass of the body.
+		 * \param position
+		 *      Position of the body.
+		 * \param velocity
+		 *      Velocity of the body.
+		 */
+		void setBody(unsigned int body, double mass, const Eigen::Vector3d &position, const Eigen::Vector3d &velocity);
+
+
+		/**
+		 * \brief Get the position of a body.
+		 *
+		 * \return Position of the body.
+		 */
+		Eigen::Vector3d getPosition(unsigned int body) const {
+			return Eigen::Vector3d(_state[6 * body], _state[6 * body + 1], _state[6 * body + 2]);
+		}
+
+
+		/**
+		 * \brief Get the velocity of a body.
+		 *
+		 * \return Velocity of the body.
+		 */
+		Eigen::Vector3d getVelocity(unsigned int body) const {
+			return Eigen::Vector3d(_state[6 * body + 3], _state[6 * body + 4], _state[6 * body + 5]);
+		}
+
+
+		/**
+		 * \brief Set the fine integrator.
+		 *
+		 * \param integrator
+		 *      Integrator (the Wisdom-Holman map is not supported, the leapfrog is used instead).
+		 *
+		 * \return False if the integrator is not supported.
+		 */
+		bool setIntegrator(NBodyManager::Integrator integrator);
+
+
+		/**
+		 * \brief Set the coarse propagator.
+		 *
+		 * \param coarse
+		 *      Leapfrog with large steps or Kepler-orbits about the heaviest body.
+		 * \param cntSteps
+		 *      Number of leapfrog-steps per slice (ignored by the Kepler-propagator).
+		 */
+		void setCoarse(Coarse coarse, unsigned int cntSteps);
+
+
+		/**
+		 * \brief Set the convergence-criteria.
+		 *
+		 * \param tolerance
+		 *      Largest change of the boundary-states (relative to the size of the system) between two iterations.
+		 * \param maxIterations
+		 *      Maximum number of iterations (0: the number of slices, after which the result is exact).
+		 */
+		void setConvergence(double tolerance, unsigned int maxIterations);
+
+
+		/**
+		 * \brief Integrate the system.
+		 *
+		 * \param dt
+		 *      Time-step of the fine integrator.
+		 * \param cntSteps
+		 *      Number of fine time-steps.
+		 * \param cntSlices
+		 *      Number of time-slices (limited to the number of steps).
+		 *
+		 * \return Number of iterations.
+		 */
+		unsigned int integrate(double dt, unsigned int cntSteps, unsigned int cntSlices);
+
+
+		/**
+		 * \brief Compute the total energy of the system (kinetic and softened potential energy).
+		 *
+		 * \return Energy of the system.
+		 */
+		double computeEnergy() const;
+
+
+		/**
+		 * \brief Get the change of the boundary-states of the last iteration.
+		 *
+		 * \return Relative change.
+		 */
+		double getLastCorrection() const {
+			return _lastCorrection;
+		}
+
+
+		/**
+		 * \brief Parse the name of a coarse propagator.
+		 *
+		 * \param name
+		 *      Name of the propagator ("leapfrog" or "kepler").
+		 * \param coarse
+		 *      Output-parameter: Parsed propagator.
+		 *
+		 * \return False if the name is unknown.
+		 */
+		static bool parseCoarse(const std::string &name, Coarse &coarse);
+
+
+	private:
+		//! State of a system: position and velocity of each body (6 values per body)
+		typedef std::vector<double> State;
+
+		//! Gravitational constant of the Kepler-propagator (same as the EnsembleIntegrator)
+		static const double G;
+
+
+		/**
+		 * \brief Integrate a state with the EnsembleIntegrator (fine integrator or leapfrog-propagator).
+		 *
+		 * \param state
+		 *      Input- and output-parameter: State which is integrated.
+		 * \param integrator
+		 *      Integrator.
+		 * \param dt
+		 *      Time-step.
+		 * \param cntSteps
+		 *      Number of time-steps.
+		 */
+		void propagateEnsemble(State &state, NBodyManager::Integrator integrator, double dt, unsigned int cntSteps) const;
+
+
+		/**
+		 * \brief Integrate a state with the coarse propagator.
+		 *
+		 * \param state
+		 *      Input- and output-parameter: State which is integrated.
+		 * \param duration
+		 *      Length of the slice.
+		 */
+		void propagateCoarse(State &state, double duration) const;
+
+
+		/**
+		 * \brief Compute the largest difference of two states relative to the size of the system.
+		 *
+		 * \return Relative difference of the positions or velocities.
+		 */
+		static double computeDifference(const State &a, const State &b);
+
+
+		//! Number of bodies
+		unsigned int _cntBodies;
+		//! Masses of the bodies
+		std::vector<double> _masses;
+		//! Current state of the system
+		State _state;
+		//! Fine integrator
+		NBodyManager::Integrator _integrator;
+		//! Coarse propagator
+		Coarse _coarse;
+		//! Number of leapfrog-steps per slice of the coarse propagator
+		unsigned int _cntCoarseSteps;
+		//! Tolerance of the convergence
+		double _tolerance;
+		//! Maximum number of iterations
+		unsigned int _maxIterations;
+		//! Change of the boundary-states of the last iteration
+		double _lastCorrection;
+	};
+}
@@ -0,0 +1,344 @@
+﻿/**
+ * \brief Implementation of the particle-mesh (FFT) gravity solver.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#include "ParticleMesh.h"
+
+#include <math.h>
+#include <cmath>
+#include <limits>
+#include <unsupported/Eigen/FFT>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "BodyState.h"
+
+using namespace pbs17;
+
+const double ParticleMesh::SPLIT_RADIUS = 1.25;
+const double ParticleMesh::SHORT_RANGE_CUTOFF = 4.5;
+
+
+/**
+ * \brief Constructor of the particle-mesh.
+ */
+ParticleMesh::ParticleMesh() : _origin(0.0, 0.0, 0.0) {
+	std::fill(_greenNear, _greenNear + 8, 0.0);
+}
+
+
+/**
+ * \brief Calculate the field sum_j(m_j * d_ij / |d_ij|^3) for all bodies (same convention as the other solvers).
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param eps
+ *      Softening which is added to the square distance of the short-range pairs.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ */
+void ParticleMesh::computeFields(const BodyState &bodies, double eps, std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az) {
+	int n = bodies.size();
+	ax.assign(n, 0.0);
+	ay.assign(n, 0.0);
+	az.assign(n, 0.0);
+
+	if (n == 0) return;
+
+	solve(bodies);
+
+	// field = -grad(potential) with central differences, interpolated with the same weights
+	double scale = -1.0 / (2.0 * _cellSize * _cellSize);
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		Eigen::Vector3d u = (bodies.getPosition(i) - _origin) / _cellSize;
+		int ix = static_cast<int>(floor(u(0)));
+		int iy = static_cast<int>(floor(u(1)));
+		int iz = static_cast<int>(floor(u(2)));
+		double fx = u(0) - ix, fy = u(1) - iy, fz = u(2) - iz;
+		Eigen::Vector3d field(0.0, 0.0, 0.0);
+
+		for (int c = 0; c < 8; ++c) {
+			int cx = ix + (c & 1), cy = iy + ((c >> 1) & 1), cz = iz + ((c >> 2) & 1);
+			double w = ((c & 1) ? fx : 1.0 - fx) * (((c >> 1) & 1) ? fy : 1.0 - fy) * (((c >> 2) & 1) ? fz : 1.0 - fz);
+
+			field(0) += w * (getPotential(cx + 1, cy, cz) - getPotential(cx - 1, cy, cz));
+			field(1) += w * (getPotential(cx, cy + 1, cz) - getPotential(cx, cy - 1, cz));
+			field(2) += w * (getPotential(cx, cy, cz + 1) - getPotential(cx, cy, cz - 1));
+		}
+
+		ax[i] = scale * field(0);
+		ay[i] = scale * field(1);
+		az[i] = scale * field(2);
+	}
+
+	if (_useP3M) {
+		double splitRadius = SPLIT_RADIUS * _cellSize;
+		double cutoff = SHORT_RANGE_CUTOFF * splitRadius;
+
+		// all bodies are binned (no far-reaching ones), the cells are at least as large as the cut-off
+		_shortRangeGrid.setThreshold(std::numeric_limits<double>::max());
+		_shortRangeGrid.setCutoffRadius(cutoff);
+		_shortRangeGrid.update(bodies, 1.0);
+
+		std::vector<double> sx, sy, sz;
+		_shortRangeGrid.computeShortRangeFields(bodies, eps, splitRadius, cutoff, sx, sy, sz);
+
+		for (int i = 0; i < n; ++i) {
+			ax[i] += sx[i];
+			ay[i] += sy[i];
+			az[i] += sz[i];
+		}
+	}
+}
+
+
+/**
+ * \brief Calculate the potential of all bodies with the same mesh (and short-range correction) as computeFields(),
+ *        e.g. for the diagnostics of the energy. The potential of the own cloud of each body is subtracted.
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param eps
+ *      Softening which is added to the square distance of the short-range pairs.
+ * \param phi
+ *      Output-parameter: Potential per body (overwritten).
+ */
+void ParticleMesh::computePotentials(const BodyState &bodies, double eps, std::vector<double> &phi) {
+	int n = bodies.size();
+	phi.assign(n, 0.0);
+
+	if (n == 0) return;
+
+	solve(bodies);
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		Eigen::Vector3d u = (bodies.getPosition(i) - _origin) / _cellSize;
+		int ix = static_cast<int>(floor(u(0)));
+		int iy = static_cast<int>(floor(u(1)));
+		int iz = static_cast<int>(floor(u(2)));
+		double fx = u(0) - ix, fy = u(1) - iy, fz = u(2) - iz;
+		double w[8];
+		double potential = 0.0;
+
+		for (int c = 0; c < 8; ++c) {
+			w[c] = ((c & 1) ? fx : 1.0 - fx) * (((c >> 1) & 1) ? fy : 1.0 - fy) * (((c >> 2) & 1) ? fz : 1.0 - fz);
+			potential += w[c] * getPotential(ix + (c & 1), iy + ((c >> 1) & 1), iz + ((c >> 2) & 1));
+		}
+
+		// the own cloud is part of the mesh, its cells are at most one cell apart per axis (c ^ d)
+		double self = 0.0;
+		for (int c = 0; c < 8; ++c) {
+			for (int d = 0; d < 8; ++d) {
+				self += w[c] * w[d] * _greenNear[c ^ d];
+			}
+		}
+
+		phi[i] = (potential - bodies.m[i] * self) / _cellSize;
+	}
+
+	if (_useP3M) {
+		double splitRadius = SPLIT_RADIUS * _cellSize;
+		double cutoff = SHORT_RANGE_CUTOFF * splitRadius;
+
+		_shortRangeGrid.setThreshold(std::numeric_limits<double>::max());
+		_shortRangeGrid.setCutoffRadius(cutoff);
+		_shortRangeGrid.update(bodies, 1.0);
+
+		std::vector<double> shortRange;
+		_shortRangeGrid.computeShortRangePotentials(bodies, eps, splitRadius, cutoff, shortRange);
+
+		for (int i = 0; i < n; ++i) {
+			phi[i] += shortRange[i];
+		}
+	}
+}
+
+
+/**
+ * \brief Deposit the masses onto the mesh and convolve them with the green-function (the mesh contains the
+ *        potential afterwards, in units of cells).
+ *
+ * \param bodies
+ *      State of all bodies (at least one).
+ */
+void ParticleMesh::solve(const BodyState &bodies) {
+	int n = bodies.size();
+	int N = _resolution;
+	int M = 2 * N;
+
+	if (_greenResolution != N) {
+		computeGreen();
+	}
+
+	// cubic mesh around all bodies, the outermost cells stay empty for the interpolation
+	double max = std::numeric_limits<double>::max();
+	Eigen::Vector3d bbMax = Eigen::Vector3d(-max, -max, -max);
+	Eigen::Vector3d bbMin = Eigen::Vector3d(max, max, max);
+	for (int i = 0; i < n; ++i) {
+		bbMax = bbMax.cwiseMax(bodies.getPosition(i));
+		bbMin = bbMin.cwiseMin(bodies.getPosition(i));
+	}
+
+	double extent = std::max((bbMax - bbMin).maxCoeff(), 1e-6);
+	_cellSize = extent * (1.0 + 1e-6) / static_cast<double>(N - 2);
+	_origin = (bbMax + bbMin) * 0.5 - Eigen::Vector3d(1.0, 1.0, 1.0) * (0.5 * (N - 1) * _cellSize);
+
+	// cloud-in-cell deposit of the masses
+	_mesh.assign(static_cast<size_t>(M) * M * M, std::complex<double>(0.0, 0.0));
+	for (int i = 0; i < n; ++i) {
+		Eigen::Vector3d u = (bodies.getPosition(i) - _origin) / _cellSize;
+		int ix = static_cast<int>(floor(u(0)));
+		int iy = static_cast<int>(floor(u(1)));
+		int iz = static_cast<int>(floor(u(2)));
+		double fx = u(0) - ix, fy = u(1) - iy, fz = u(2) - iz;
+
+		for (int c = 0; c < 8; ++c) {
+			int dx = c & 1, dy = (c >> 1) & 1, dz = (c >> 2) & 1;
+			double w = (dx ? fx : 1.0 - fx) * (dy ? fy : 1.0 - fy) * (dz ? fz : 1.0 - fz);
+			_mesh[(ix + dx) + M * ((iy + dy) + static_cast<size_t>(M) * (iz + dz))] += bodies.m[i] * w;
+		}
+	}
+
+	// potential = density (*) green-function
+	fft3(_mesh, false);
+	for (size_t k = 0; k < _mesh.size(); ++k) {
+		_mesh[k] *= _greenHat[k];
+	}
+	fft3(_mesh, true);
+}
+
+
+/**
+ * \brief Compute the transformed green-function of the long-range potential (in units of cells).
+ */
+void ParticleMesh::computeGreen() {
+	int N = _resolution;
+	int M = 2 * N;
+	double invSqrtPi = 1.0 / sqrt(3.14159265358979323846);
+
+	std::vector<std::complex<double>> green(static_cast<size_t>(M) * M * M);
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int iz = 0; iz < M; ++iz) {
+		for (int iy = 0; iy < M; ++iy) {
+			for (int ix = 0; ix < M; ++ix) {
+				// distance with wrap-around, so the convolution of the padded mesh is isolated
+				double dx = std::min(ix, M - ix);
+				double dy = std::min(iy, M - iy);
+				double dz = std::min(iz, M - iz);
+				double r = sqrt(dx * dx + dy * dy + dz * dz);
+
+				double g;
+				if (r > 0.0) {
+					g = -std::erf(r / (2.0 * SPLIT_RADIUS)) / r;
+				} else {
+					g = -invSqrtPi / SPLIT_RADIUS;
+				}
+
+				green[ix + M * (iy + static_cast<size_t>(M) * iz)] = std::complex<double>(g, 0.0);
+
+				if (ix <= 1 && iy <= 1 && iz <= 1) {
+					_greenNear[ix + 2 * iy + 4 * iz] = g;
+				}
+			}
+		}
+	}
+
+	fft3(green, false);
+
+	// the green-function is real and even, so is its transform
+	_greenHat.resize(green.size());
+	for (size_t k = 0; k < green.size(); ++k) {
+		_greenHat[k] = green[k].real();
+	}
+
+	_greenResolution = N;
+}
+
+
+/**
+ * \brief Forward- or backward 3D FFT of a padded mesh (1D transforms along each axis).
+ *
+ * \param mesh
+ *      Mesh with (2 * resolution)^3 entries.
+ * \param inverse
+ *      True for the inverse transform (scaled).
+ */
+void ParticleMesh::fft3(std::vector<std::complex<double>> &mesh, bool inverse) const {
+	int M = 2 * _resolution;
+	int cntLines = M * M;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		size_t stride = axis == 0 ? 1 : (axis == 1 ? M : static_cast<size_t>(M) * M);
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+		{
+			// the plans of the FFT are cached per object, so each thread has its own
+			Eigen::FFT<double> fft;
+			std::vector<std::complex<double>> in(M), out(M);
+
+#if defined(_OPENMP)
+#pragma omp for
+#endif
+			for (int l = 0; l < cntLines; ++l) {
+				size_t a = l % M, b = l / M;
+				size_t base;
+				if (axis == 0) {
+					base = M * (a + static_cast<size_t>(M) * b);
+				} else if (axis == 1) {
+					base = a + static_cast<size_t>(M) * M * b;
+				} else {
+					base = a + static_cast<size_t>(M) * b;
+				}
+
+				for (int k = 0; k < M; ++k) {
+					in[k] = mesh[base + k * stride];
+				}
+
+				if (inverse) {
+					fft.inv(out, in);
+				} else {
+					fft.fwd(out, in);
+				}
+
+				for (int k = 0; k < M; ++k) {
+					mesh[base + k * stride] = out[k];
+				}
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Get the potential of a cell of the padded mesh (the index wraps around).
+ *
+ * \param ix, iy, iz
+ *      Cell.
+ *
+ * \return Potential.
+ */
+double ParticleMesh::getPotential(int ix, int iy, int iz) const {
+	int M = 2 * _resolution;
+	ix = (ix + M) % M;
+	iy = (iy + M) % M;
+	iz = (iz + M) % M;
+
+	return _mesh[ix + M * (iy + static_cast<size_t>(M) * iz)].real();
+}
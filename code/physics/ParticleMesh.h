@@ -0,0 +1,154 @@
+﻿/**
+ * \brief Implementation of the particle-mesh (FFT) gravity solver.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <vector>
+#include <complex>
+#include <algorithm>
+
+#include "SpatialGrid.h"
+
+namespace pbs17 {
+	class BodyState;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Particle-mesh solver for large fields: the masses are deposited onto a 3D grid (cloud-in-cell),
+	 *        the potential is calculated with a FFT-convolution (zero-padded, so the boundaries are isolated)
+	 *        and the field is interpolated back to the bodies.
+	 *
+	 * The mesh only carries the smooth long-range part of the potential -erf(r / 2r_s) / r. With P3M enabled,
+	 * the missing short-range part is added for all pairs closer than a few cells, using the cell-list of
+	 * the spatial-grid.
+	 */
+	class ParticleMesh {
+	public:
+		/**
+		 * \brief Constructor of the particle-mesh.
+		 */
+		ParticleMesh();
+
+
+		/**
+		 * \brief Calculate the field sum_j(m_j * d_ij / |d_ij|^3) for all bodies (same convention as the other solvers).
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance of the short-range pairs.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 */
+		void computeFields(const BodyState &bodies, double eps, std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az);
+
+
+		/**
+		 * \brief Calculate the potential of all bodies with the same mesh (and short-range correction) as computeFields(),
+		 *        e.g. for the diagnostics of the energy. The potential of the own cloud of each body is subtracted.
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance of the short-range pairs.
+		 * \param phi
+		 *      Output-parameter: Potential per body (overwritten).
+		 */
+		void computePotentials(const BodyState &bodies, double eps, std::vector<double> &phi);
+
+
+		/**
+		 * \brief Set the number of mesh-cells per axis (the FFT uses twice as many because of the zero-padding).
+		 *
+		 * \param resolution
+		 *      Cells per axis (>= 8, powers of two are the fastest).
+		 */
+		void setResolution(const int resolution) {
+			_resolution = std::max(resolution, 8);
+		}
+
+
+		/**
+		 * \brief Add the short-range correction (P3M) for the pairs within a few cells.
+		 *
+		 * \param useP3M
+		 *      True to add the short-range correction.
+		 */
+		void setUseP3M(const bool useP3M) {
+			_useP3M = useP3M;
+		}
+
+
+	private:
+		//! Split-radius between short- and long-range part in cells
+		static const double SPLIT_RADIUS;
+		//! Cut-off radius of the short-range part in split-radii
+		static const double SHORT_RANGE_CUTOFF;
+
+		//! Cells per axis
+		int _resolution = 64;
+		//! Flag if the short-range correction is added
+		bool _useP3M = true;
+
+		//! Resolution the green-function has been transformed for
+		int _greenResolution = 0;
+		//! Transformed green-function of the padded mesh (real, since the function is even)
+		std::vector<double> _greenHat;
+		//! Green-function of the neighbouring cells (index dx + 2 dy + 4 dz), for the potential of the own cloud
+		double _greenNear[8];
+		//! Padded mesh of the density and later of the potential
+		std::vector<std::complex<double>> _mesh;
+
+		//! Origin (lower corner) and width of the cells
+		Eigen::Vector3d _origin;
+		double _cellSize = 1.0;
+
+		//! Cell-list for the short-range correction
+		SpatialGrid _shortRangeGrid;
+
+
+		/**
+		 * \brief Compute the transformed green-function of the long-range potential (in units of cells).
+		 */
+		void computeGreen();
+
+
+		/**
+		 * \brief Deposit the masses onto the mesh and convolve them with the green-function (the mesh contains the
+		 *        potential afterwards, in units of cells).
+		 *
+		 * \param bodies
+		 *      State of all bodies (at least one).
+		 */
+		void solve(const BodyState &bodies);
+
+
+		/**
+		 * \brief Forward- or backward 3D FFT of a padded mesh (1D transforms along each axis).
+		 *
+		 * \param mesh
+		 *      Mesh with (2 * resolution)^3 entries.
+		 * \param inverse
+		 *      True for the inverse transform (scaled).
+		 */
+		void fft3(std::vector<std::complex<double>> &mesh, bool inverse) const;
+
+
+		/**
+		 * \brief Get the potential of a cell of the padded mesh (the index wraps around).
+		 *
+		 * \param ix, iy, iz
+		 *      Cell.
+		 *
+		 * \return Potential.
+		 */
+		double getPotential(int ix, int iy, int iz) const;
+	};
+}
@@ -0,0 +1,249 @@
+﻿/**
+ * \brief Implementation of the thread which simulates the scene with a fixed rate.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#include "PhysicsThread.h"
+
+#include <algorithm>
+#include <OpenThreads/ScopedLock>
+
+#include "SimulationManager.h"
+#include "Profiler.h"
+#include "NumaPolicy.h"
+#include "ThreadBudget.h"
+#include "../scene/SpaceObject.h"
+#include "../osg/OsgEigenConversions.h"
+#include "../osg/IdleRenderer.h"
+
+using namespace pbs17;
+
+
+//! As often as the idle rendering draws a static scene
+const double PhysicsThread::IDLE_PERIOD = 1.0;
+
+
+/**
+ * \brief Constructor of the physics-thread.
+ *
+ * \param simulationManager
+ *      Simulation which is stepped by the thread.
+ * \param rate
+ *      Number of steps per second (wall-clock).
+ */
+PhysicsThread::PhysicsThread(SimulationManager* simulationManager, double rate)
+	: _simulationManager(simulationManager), _period(1.0 / std::max(rate, 1.0)), _isRunning(true) {}
+
+
+/**
+ * \brief Destructor of the physics-thread (stops the thread).
+ */
+PhysicsThread::~PhysicsThread() {
+	stop();
+}
+
+
+/**
+ * \brief Main-loop of the thread.
+ */
+void PhysicsThread::run() {
+	const osg::Timer* timer = osg::Timer::instance();
+	osg::Timer_t next = timer->tick();
+	osg::Timer_t periodTicks = static_cast<osg::Timer_t>(_period / timer->getSecondsPerTick());
+
+	// the team of this thread runs on the same cpus as the one which has touched the bodies
+	ThreadBudget::enterThread(ThreadBudget::CRITICAL);
+	NumaPolicy::pinWorkers();
+
+	osg::Timer_t published = timer->tick();
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(SimulationManager::getStateMutex());
+		publishSnapshot();
+	}
+
+	while (_isRunning) {
+		// fast-forward: the steps are not waited for, only the newest state is published at the rate
+		bool isFastForward = _simulationManager->getIsFastForward() && !_simulationManager->getIsPaused();
+		// the idle rendering does not read the snapshots of a paused simulation (only the edits of the scene)
+		bool isIdle = IdleRenderer::getIsEnabled() && _simulationManager->getIsPaused();
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(SimulationManager::getStateMutex());
+			_simulationManager->step(_simulationManager->getSimulationDt());
+			if (isIdle ? timer->delta_s(published, timer->tick()) >= IDLE_PERIOD : !isFastForward || timer->tick() >= next) {
+				publishSnapshot();
+				published = timer->tick();
+			}
+		}
+
+		osg::Timer_t now = timer->tick();
+		if (isFastForward) {
+			if (now >= next) {
+				next = now + periodTicks;
+			}
+			continue;
+		}
+
+		// fixed rate: wait for the next step, but do not try to catch up if the simulation is too slow
+		next += periodTicks;
+		if (now < next) {
+			microSleep(static_cast<unsigned int>(timer->delta_u(now, next)));
+		} else if (now > next + 4 * periodTicks) {
+			next = now;
+		}
+	}
+}
+
+
+/**
+ * \brief Stop the thread and wait until it is finished.
+ */
+void PhysicsThread::stop() {
+	_isRunning = false;
+
+	if (isRunning()) {
+		join();
+	}
+}
+
+
+/**
+ * \brief Write the interpolated snapshot to the OSG-nodes. Has to be called from the rendering-thread
+ *        (e.g. by an update-callback).
+ */
+void PhysicsThread::applySnapshot() {
+	Profiler::ScopedTimer timer(Profiler::SCENE_SYNC);
+
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_snapshotMutex);
+		if (_hasNewSnapshot) {
+			std::swap(_previous, _current);
+			std::swap(_current, _ready);
+			_hasNewSnapshot = false;
+		}
+	}
+
+	if (_current.objects.empty()) return;
+
+	// the rendering is one step behind, so it can interpolate between the last two steps
+	double alpha = 1.0;
+	if (_previous.objects.size() == _current.objects.size() && _current.time > _previous.time) {
+		alpha = getAlpha(_previous.time, _current.time);
+	}
+
+	const std::vector<SpaceObject*> &spaceObjects = _simulationManager->getSpaceObjects();
+	unsigned int n = std::min(static_cast<unsigned int>(spaceObjects.size()), static_cast<unsigned int>(_current.objects.size()));
+
+	for (unsigned int i = 0; i < n; ++i) {
+		const ObjectState &current = _current.objects[i];
+		spaceObjects[i]->applyActive(current.isActive);
+
+		// a fragment which was just activated starts at its position (it was parked in the pool before)
+		if (alpha < 1.0 && _previous.objects[i].isActive) {
+			const ObjectState &previous = _previous.objects[i];
+			osg::Vec3d position = previous.position + (current.position - previous.position) * alpha;
+			osg::Quat orientation;
+			orientation.slerp(alpha, previous.orientation, current.orientation);
+
+			spaceObjects[i]->applyTransformation(position, orientation, current.aabb, current.collisionState);
+		} else {
+			spaceObjects[i]->applyTransformation(current.position, current.orientation, current.aabb, current.collisionState);
+		}
+	}
+}
+
+
+/**
+ * \brief Write the newest interpolated state of a single space-object to its OSG-nodes just before the
+ *        rendering-traversals (late-latching, e.g. the player which is tracked by the camera). A snapshot which
+ *        has been published after the update-traversal is already used, the other objects keep the state
+ *        of applySnapshot(). Has to be called from the rendering-thread.
+ *
+ * \param object
+ *      Space-object which is latched.
+ */
+void PhysicsThread::latchObject(const SpaceObject* object) {
+	Profiler::ScopedTimer timer(Profiler::SCENE_SYNC);
+
+	const std::vector<SpaceObject*> &spaceObjects = _simulationManager->getSpaceObjects();
+	auto it = std::find(spaceObjects.begin(), spaceObjects.end(), object);
+	if (it == spaceObjects.end()) return;
+	size_t index = it - spaceObjects.begin();
+
+	// only the state of the object is copied, the snapshots are swapped by the next applySnapshot()
+	ObjectState previous, current;
+	osg::Timer_t previousTime = 0, currentTime = 0;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_snapshotMutex);
+		const Snapshot &newest = _hasNewSnapshot ? _ready : _current;
+		const Snapshot &before = _hasNewSnapshot ? _current : _previous;
+		if (index >= newest.objects.size()) return;
+
+		current = newest.objects[index];
+		currentTime = newest.time;
+		if (index < before.objects.size()) {
+			previous = before.objects[index];
+			previousTime = before.time;
+		}
+	}
+
+	SpaceObject* spaceObject = *it;
+	spaceObject->applyActive(current.isActive);
+
+	if (currentTime > previousTime && previousTime != 0 && previous.isActive) {
+		double alpha = getAlpha(previousTime, currentTime);
+		osg::Vec3d position = previous.position + (current.position - previous.position) * alpha;
+		osg::Quat orientation;
+		orientation.slerp(alpha, previous.orientation, current.orientation);
+
+		spaceObject->applyTransformation(position, orientation, current.aabb, current.collisionState);
+	} else {
+		spaceObject->applyTransformation(current.position, current.orientation, current.aabb, current.collisionState);
+	}
+}
+
+
+/**
+ * \brief Copy the state of all space-objects into the write-buffer and publish it.
+ *        The state-mutex of the simulation has to be locked.
+ */
+void PhysicsThread::publishSnapshot() {
+	Profiler::ScopedTimer timer(Profiler::SCENE_SYNC);
+
+	const std::vector<SpaceObject*> &spaceObjects = _simulationManager->getSpaceObjects();
+
+	_write.objects.resize(spaceObjects.size());
+	for (unsigned int i = 0; i < spaceObjects.size(); ++i) {
+		ObjectState &state = _write.objects[i];
+		state.position = toOsg(spaceObjects[i]->getPosition());
+		state.orientation = spaceObjects[i]->getOrientation();
+		state.aabb = spaceObjects[i]->getAABB();
+		state.collisionState = spaceObjects[i]->getCollisionState();
+		state.isActive = spaceObjects[i]->isActive();
+	}
+	_write.time = osg::Timer::instance()->tick();
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_snapshotMutex);
+	std::swap(_write, _ready);
+	_hasNewSnapshot = true;
+}
+
+
+/**
+ * \brief Get the weight of the current snapshot at this time (the previous one is rendered at the time of
+ *        the current one, so the rendering is one step behind).
+ *
+ * \param previous
+ *      Time of the previous snapshot.
+ * \param current
+ *      Time of the current snapshot.
+ *
+ * \return Weight between 0 (previous snapshot) and 1 (current snapshot).
+ */
+double PhysicsThread::getAlpha(osg::Timer_t previous, osg::Timer_t current) {
+	const osg::Timer* timer = osg::Timer::instance();
+	double alpha = timer->delta_s(current, timer->tick()) / timer->delta_s(previous, current);
+
+	return std::max(0.0, std::min(alpha, 1.0));
+}
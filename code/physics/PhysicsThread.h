@@ -0,0 +1,156 @@
+﻿/**
+ * \brief Implementation of the thread which simulates the scene with a fixed rate.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <osg/Vec3d>
+#include <osg/Quat>
+#include <osg/BoundingBox>
+#include <osg/Timer>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+
+// forward declarations
+namespace pbs17 {
+	class SimulationManager;
+	class SpaceObject;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Simulates the scene on its own thread with a fixed rate, so rendering and simulation overlap.
+	 *
+	 * After each step, the state of all space-objects is published as a snapshot (triple-buffered: the
+	 * physics-thread writes one buffer, one is ready and one is read by the rendering-thread). The
+	 * rendering-thread interpolates between the last two snapshots and writes them to the OSG-nodes.
+	 */
+	class PhysicsThread : public OpenThreads::Thread {
+	public:
+		/**
+		 * \brief Constructor of the physics-thread.
+		 *
+		 * \param simulationManager
+		 *      Simulation which is stepped by the thread.
+		 * \param rate
+		 *      Number of steps per second (wall-clock).
+		 */
+		PhysicsThread(SimulationManager* simulationManager, double rate = 60.0);
+
+
+		/**
+		 * \brief Destructor of the physics-thread (stops the thread).
+		 */
+		~PhysicsThread();
+
+
+		/**
+		 * \brief Main-loop of the thread.
+		 */
+		void run() override;
+
+
+		/**
+		 * \brief Stop the thread and wait until it is finished.
+		 */
+		void stop();
+
+
+		/**
+		 * \brief Write the interpolated snapshot to the OSG-nodes. Has to be called from the rendering-thread
+		 *        (e.g. by an update-callback).
+		 */
+		void applySnapshot();
+
+
+		/**
+		 * \brief Write the newest interpolated state of a single space-object to its OSG-nodes just before the
+		 *        rendering-traversals (late-latching, e.g. the player which is tracked by the camera). A snapshot which
+		 *        has been published after the update-traversal is already used, the other objects keep the state
+		 *        of applySnapshot(). Has to be called from the rendering-thread.
+		 *
+		 * \param object
+		 *      Space-object which is latched.
+		 */
+		void latchObject(const SpaceObject* object);
+
+
+	private:
+		/**
+		 * \brief State of a single space-object which is needed for the rendering.
+		 */
+		struct ObjectState {
+			osg::Vec3d position;
+			osg::Quat orientation;
+			osg::BoundingBox aabb;
+			int collisionState;
+			//! False if the object is not simulated (its nodes are hidden)
+			bool isActive;
+		};
+
+
+		/**
+		 * \brief State of all space-objects after a step.
+		 */
+		struct Snapshot {
+			//! State per space-object (same order as the space-objects)
+			std::vector<ObjectState> objects;
+			//! Time at which the step was finished
+			osg::Timer_t time = 0;
+		};
+
+
+		//! Time between two snapshots of a paused simulation while the rendering idles: unit = s
+		static const double IDLE_PERIOD;
+
+		//! Simulation which is stepped by the thread
+		SimulationManager* _simulationManager;
+
+		//! Time between two steps in seconds
+		double _period;
+
+		//! True as long as the thread should run
+		std::atomic<bool> _isRunning;
+
+		//! Protects _ready and _hasNewSnapshot
+		OpenThreads::Mutex _snapshotMutex;
+		//! Snapshot which is written by the physics-thread
+		Snapshot _write;
+		//! Last published snapshot
+		Snapshot _ready;
+		//! True if _ready has not been read yet
+		bool _hasNewSnapshot = false;
+
+		//! Snapshots which are interpolated by the rendering-thread
+		Snapshot _previous;
+		Snapshot _current;
+
+
+		/**
+		 * \brief Copy the state of all space-objects into the write-buffer and publish it.
+		 *        The state-mutex of the simulation has to be locked.
+		 */
+		void publishSnapshot();
+
+
+		/**
+		 * \brief Get the weight of the current snapshot at this time (the previous one is rendered at the time of
+		 *        the current one, so the rendering is one step behind).
+		 *
+		 * \param previous
+		 *      Time of the previous snapshot.
+		 * \param current
+		 *      Time of the current snapshot.
+		 *
+		 * \return Weight between 0 (previous snapshot) and 1 (current snapshot).
+		 */
+		static double getAlpha(osg::Timer_t previous, osg::Timer_t current);
+	};
+}
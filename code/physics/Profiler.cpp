@@ -0,0 +1,506 @@
+﻿/**
+ * \brief Implementation of the profiler for the phases of a frame.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#include "Profiler.h"
+
+#include <algorithm>
+
+#include <OpenThreads/ScopedLock>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(__linux__)
+#include <time.h>
+#endif
+
+#include "Tracer.h"
+
+using namespace pbs17;
+
+
+//! Pointer to the only instance of this class.
+Profiler* Profiler::_pInstance = nullptr;
+
+//! The profiling is enabled by default (a timer costs less than a microsecond).
+bool Profiler::IS_ENABLED = true;
+
+//! The thread-times are only measured by the benchmarks (two parallel regions per outermost phase).
+bool Profiler::IS_THREAD_TIMES = false;
+
+//! About 4 seconds at 60 fps.
+const unsigned int Profiler::WINDOW_SIZE = 256;
+
+
+namespace {
+	//! Innermost running timer of each thread (its time is reduced by the nested timers)
+	thread_local Profiler::ScopedTimer* currentTimer = nullptr;
+}
+
+
+/**
+ * \brief Start the timer of a phase.
+ *
+ * \param phase
+ *      Measured phase.
+ */
+Profiler::ScopedTimer::ScopedTimer(Phase phase)
+	: _phase(phase), _start(0), _nested(0.0), _parent(nullptr) {
+	if (!IS_ENABLED) return;
+
+	_parent = currentTimer;
+	currentTimer = this;
+
+#if defined(_OPENMP)
+	// a timer inside of a parallel region can't start a team of its own
+	if (IS_THREAD_TIMES && _parent == nullptr && !omp_in_parallel()) {
+		sampleThreadTimes(_threadStart);
+	}
+#endif
+
+	_start = osg::Timer::instance()->tick();
+}
+
+
+/**
+ * \brief Stop the timer and add its own time to the current frame.
+ */
+Profiler::ScopedTimer::~ScopedTimer() {
+	if (currentTimer != this) return;
+
+	osg::Timer_t end = osg::Timer::instance()->tick();
+	double elapsed = osg::Timer::instance()->delta_s(_start, end);
+	currentTimer = _parent;
+
+#if defined(PBS17_TRACING)
+	// the span of the trace includes the nested timers
+	Tracer::Instance()->addSpan(Profiler::getPhaseName(_phase), _start, end);
+#endif
+
+	if (_parent != nullptr) {
+		_parent->_nested += elapsed;
+	}
+
+	Profiler::Instance()->add(_phase, elapsed - _nested);
+
+	if (!_threadStart.empty()) {
+		std::vector<double> threadEnd;
+		sampleThreadTimes(threadEnd);
+		Profiler::Instance()->addThreadTimes(_phase, _threadStart, threadEnd);
+	}
+}
+
+
+/**
+ * \brief Private constructor of the profiler.
+ */
+Profiler::Profiler() : _window(WINDOW_SIZE * (CNT_PHASES + 1), 0.0), _cntFrames(0) {
+	std::fill(_current, _current + CNT_PHASES, 0.0);
+	std::fill(_totals, _totals + CNT_PHASES + 1, 0.0);
+	std::fill(_currentCounters, _currentCounters + CNT_COUNTERS, 0.0);
+	std::fill(_counters, _counters + CNT_COUNTERS, 0.0);
+}
+
+
+/**
+ * \brief Singleton instance of the Profiler-class.
+ */
+Profiler* Profiler::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new Profiler();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Add the time of a phase to the current frame.
+ *
+ * \param phase
+ *      Measured phase.
+ * \param seconds
+ *      Time of the phase.
+ */
+void Profiler::add(Phase phase, double seconds) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_current[phase] += seconds;
+}
+
+
+/**
+ * \brief Store the sums of the phases of the current frame and start the next one.
+ *
+ * \param frameTime
+ *      Total time of the frame in seconds (including the unmeasured parts like the rendering).
+ */
+void Profiler::endFrame(double frameTime) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	double* frame = &_window[(_cntFrames % WINDOW_SIZE) * (CNT_PHASES + 1)];
+	std::copy(_current, _current + CNT_PHASES, frame);
+	frame[CNT_PHASES] = frameTime;
+	std::fill(_current, _current + CNT_PHASES, 0.0);
+
+	for (int i = 0; i <= CNT_PHASES; ++i) {
+		_totals[i] += frame[i];
+	}
+
+	std::copy(_currentCounters, _currentCounters + CNT_COUNTERS, _counters);
+	std::fill(_currentCounters, _currentCounters + CNT_COUNTERS, 0.0);
+
+	// the rows are not flushed, so writing the file does not stall the frames
+	if (_csv.is_open()) {
+		_csv << _cntFrames;
+		for (int i = 0; i <= CNT_PHASES; ++i) {
+			_csv << ',' << 1000.0 * frame[i];
+		}
+		for (int i = 0; i < CNT_COUNTERS; ++i) {
+			_csv << ',' << _counters[i];
+		}
+		_csv << '\n';
+	}
+
+	++_cntFrames;
+}
+
+
+/**
+ * \brief Add a value to a counter of the current frame.
+ *
+ * \param counter
+ *      Counted value.
+ * \param value
+ *      Value to add (MAX_PENETRATION, STEP_DT, FORCE_REUSE_ERROR => the maximum is kept, the diagnostics and the
+ *      scale of the resolution => the last value is kept).
+ */
+void Profiler::count(Counter counter, double value) {
+	if (!IS_ENABLED) return;
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	if (counter == MAX_PENETRATION || counter == STEP_DT || counter == FORCE_REUSE_ERROR) {
+		_currentCounters[counter] = std::max(_currentCounters[counter], value);
+	} else if (counter >= TOTAL_ENERGY) {
+		// the energy can be negative and the scale is a state, so the last measurement is kept
+		_currentCounters[counter] = value;
+	} else {
+		_currentCounters[counter] += value;
+	}
+}
+
+
+/**
+ * \brief Get a counter of the last frame which has ended.
+ *
+ * \param counter
+ *      Counted value.
+ *
+ * \return Value of the counter.
+ */
+double Profiler::getCounter(Counter counter) const {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	return _counters[counter];
+}
+
+
+/**
+ * \brief Get a percentile of a phase over the frames of the rolling window.
+ *
+ * \param phase
+ *      Phase of the frames (CNT_PHASES => total time of the frames).
+ * \param percentile
+ *      Percentile in [0, 100].
+ *
+ * \return Time in seconds (0 if no frame has ended yet).
+ */
+double Profiler::getPercentile(Phase phase, double percentile) const {
+	std::vector<double> values;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		unsigned int cntValues = std::min(_cntFrames, static_cast<unsigned long>(WINDOW_SIZE));
+
+		values.resize(cntValues);
+		for (unsigned int i = 0; i < cntValues; ++i) {
+			values[i] = _window[i * (CNT_PHASES + 1) + phase];
+		}
+	}
+
+	if (values.empty()) return 0.0;
+
+	// nearest-rank: the smallest value which is greater or equal than the percentage of the values
+	unsigned int rank = static_cast<unsigned int>(std::max(0.0, std::min(percentile / 100.0, 1.0)) * (values.size() - 1) + 0.5);
+	std::nth_element(values.begin(), values.begin() + rank, values.end());
+
+	return values[rank];
+}
+
+
+/**
+ * \brief Get the sum of a phase over all frames since the last reset.
+ *
+ * \param phase
+ *      Phase of the frames (CNT_PHASES => total time of the frames).
+ *
+ * \return Time in seconds.
+ */
+double Profiler::getTotal(Phase phase) const {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	return _totals[phase];
+}
+
+
+/**
+ * \brief Get the cpu-time of each thread of the OpenMP-team (called outside of a parallel region).
+ *
+ * \param times
+ *      Output-parameter: Cpu-time per thread in seconds.
+ */
+void Profiler::sampleThreadTimes(std::vector<double> &times) {
+	times.clear();
+
+#if defined(_OPENMP) && defined(__linux__)
+	times.resize(omp_get_max_threads(), 0.0);
+
+	// each thread of the team reads its own clock (the team of the phases is the same pool of threads)
+	#pragma omp parallel
+	{
+		timespec ts;
+		if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0 && omp_get_thread_num() < static_cast<int>(times.size())) {
+			times[omp_get_thread_num()] = ts.tv_sec + 1e-9 * ts.tv_nsec;
+		}
+	}
+#endif
+}
+
+
+/**
+ * \brief Add the cpu-time of each thread to a phase.
+ *
+ * \param phase
+ *      Outermost phase.
+ * \param start, end
+ *      Cpu-time per thread at the start and the end of the phase.
+ */
+void Profiler::addThreadTimes(Phase phase, const std::vector<double> &start, const std::vector<double> &end) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	std::vector<double> &times = _threadTimes[phase];
+	size_t cntThreads = std::min(start.size(), end.size());
+	if (times.size() < cntThreads) {
+		times.resize(cntThreads, 0.0);
+	}
+
+	for (size_t i = 0; i < cntThreads; ++i) {
+		times[i] += std::max(end[i] - start[i], 0.0);
+	}
+}
+
+
+/**
+ * \brief Get the cpu-time of each OpenMP-thread within a phase since the last reset (see setIsThreadTimes()).
+ *
+ * \param phase
+ *      Outermost phase.
+ *
+ * \return Time in seconds per thread (empty if not measured).
+ */
+std::vector<double> Profiler::getThreadTimes(Phase phase) const {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	return _threadTimes[phase];
+}
+
+
+/**
+ * \brief Get the imbalance of the OpenMP-threads within a phase since the last reset: The largest cpu-time of a
+ *        thread divided by the mean (1 => balanced).
+ *
+ * \param phase
+ *      Outermost phase.
+ *
+ * \return Imbalance (0 if not measured).
+ */
+double Profiler::getThreadImbalance(Phase phase) const {
+	std::vector<double> times = getThreadTimes(phase);
+	if (times.empty()) return 0.0;
+
+	double maxTime = 0.0;
+	double sum = 0.0;
+	for (double time : times) {
+		maxTime = std::max(maxTime, time);
+		sum += time;
+	}
+
+	if (sum <= 0.0) return 0.0;
+	return maxTime * times.size() / sum;
+}
+
+
+/**
+ * \brief Forget all frames (the window and the sums), e.g. before the next benchmark.
+ */
+void Profiler::reset() {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	for (int i = 0; i < CNT_PHASES; ++i) {
+		_threadTimes[i].clear();
+	}
+
+	std::fill(_current, _current + CNT_PHASES, 0.0);
+	std::fill(_totals, _totals + CNT_PHASES + 1, 0.0);
+	std::fill(_window.begin(), _window.end(), 0.0);
+	std::fill(_currentCounters, _currentCounters + CNT_COUNTERS, 0.0);
+	std::fill(_counters, _counters + CNT_COUNTERS, 0.0);
+	_cntFrames = 0;
+}
+
+
+/**
+ * \brief Get the name of a phase.
+ *
+ * \param phase
+ *      Phase of a frame (CNT_PHASES => total time of the frames).
+ *
+ * \return Name of the phase (also used in the header of the csv-file).
+ */
+const char* Profiler::getPhaseName(Phase phase) {
+	switch (phase) {
+	case FORCES:
+		return "forces";
+	case INTEGRATION:
+		return "integration";
+	case BROAD_PHASE:
+		return "broadPhase";
+	case NARROW_PHASE:
+		return "narrowPhase";
+	case RESPONSE:
+		return "response";
+	case AABB_UPDATE:
+		return "aabbUpdate";
+	case SCENE_SYNC:
+		return "sceneSync";
+	default:
+		return "frame";
+	}
+}
+
+
+/**
+ * \brief Get the name of a counter.
+ *
+ * \param counter
+ *      Counted value.
+ *
+ * \return Name of the counter (also used in the header of the csv-file).
+ */
+const char* Profiler::getCounterName(Counter counter) {
+	switch (counter) {
+	case BROAD_PHASE_PAIRS:
+		return "broadPhasePairs";
+	case OVERLAPS_X:
+		return "overlapsX";
+	case OVERLAPS_Y:
+		return "overlapsY";
+	case OVERLAPS_Z:
+		return "overlapsZ";
+	case COLLIDING_PAIRS:
+		return "collidingPairs";
+	case COARSE_PAIRS:
+		return "coarsePairs";
+	case MIDPHASE_CULLED:
+		return "midPhaseCulled";
+	case GJK_CALLS:
+		return "gjkCalls";
+	case GJK_ITERATIONS:
+		return "gjkIterations";
+	case EPA_ITERATIONS:
+		return "epaIterations";
+	case CONTACTS_RESOLVED:
+		return "contactsResolved";
+	case SPECULATIVE_CONTACTS:
+		return "speculativeContacts";
+	case SOLVER_BATCHES:
+		return "solverBatches";
+	case BINARIES:
+		return "binaries";
+	case CLUSTERED_BODIES:
+		return "clusteredBodies";
+	case DUST_COLLISIONS:
+		return "dustCollisions";
+	case FRAME_ALLOCATIONS:
+		return "frameAllocations";
+	case RESOURCE_HITS:
+		return "resourceHits";
+	case RESOURCE_MISSES:
+		return "resourceMisses";
+	case RESOURCE_EVICTIONS:
+		return "resourceEvictions";
+	case MAX_PENETRATION:
+		return "maxPenetration";
+	case FORCE_REUSE_ERROR:
+		return "forceReuseError";
+	case TOTAL_ENERGY:
+		return "totalEnergy";
+	case ENERGY_DRIFT:
+		return "energyDrift";
+	case MOMENTUM_DRIFT:
+		return "momentumDrift";
+	case ANGULAR_MOMENTUM_DRIFT:
+		return "angularMomentumDrift";
+	case RENDER_SCALE:
+		return "renderScale";
+	case TRACKED_MEMORY:
+		return "trackedMemory";
+	case RESIDENT_MEMORY:
+		return "residentMemory";
+	case PENDING_JOBS:
+		return "pendingJobs";
+	default:
+		return "stepDt";
+	}
+}
+
+
+/**
+ * \brief Write the phases and counters of each frame into a csv-file (one row per frame, times in milliseconds).
+ *
+ * \param filePath
+ *      Complete path to the csv-file (overwritten).
+ *
+ * \return False if the file can't be written.
+ */
+bool Profiler::openCsv(std::string filePath) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	_csv.open(filePath, std::ios::out | std::ios::trunc);
+	if (!_csv) return false;
+
+	_csv << "frame";
+	for (int i = 0; i <= CNT_PHASES; ++i) {
+		_csv << ',' << getPhaseName(static_cast<Phase>(i));
+	}
+	for (int i = 0; i < CNT_COUNTERS; ++i) {
+		_csv << ',' << getCounterName(static_cast<Counter>(i));
+	}
+	_csv << '\n';
+
+	return true;
+}
+
+
+/**
+ * \brief Write the remaining rows and close the csv-file.
+ */
+void Profiler::closeCsv() {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	if (_csv.is_open()) {
+		_csv.close();
+	}
+}
@@ -0,0 +1,369 @@
+﻿/**
+ * \brief Functionality for measuring the time of the phases of a frame (forces, integration, collisions, ...).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#include <osg/Timer>
+#include <OpenThreads/Mutex>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Profiler collects the time of each phase of a frame. The phases are measured with a ScopedTimer, which
+	 * only counts its own time (the time of the nested timers is subtracted), so the phases of a frame add up to the
+	 * measured part of the frame. At the end of each frame, the sums of the phases are stored in a rolling window
+	 * (to get the percentiles) and optionally written as a row of a csv-file.
+	 *
+	 * The phases can be measured by the physics-thread, while the rendering-thread ends the frames.
+	 *
+	 * With the thread-times (setIsThreadTimes()), the outermost timers also measure the cpu-time of each OpenMP-thread
+	 * within their phase (including the nested phases), so the imbalance of the team (max vs. mean) can be reported.
+	 */
+	class Profiler {
+	public:
+
+		//! Measured phases of a frame
+		enum Phase {
+			FORCES = 0,
+			INTEGRATION,
+			BROAD_PHASE,
+			NARROW_PHASE,
+			RESPONSE,
+			AABB_UPDATE,
+			SCENE_SYNC,
+			CNT_PHASES
+		};
+
+		//! Counted values of a frame (sums, except for the maximal penetration, the largest time-step, the largest error of the reused forces, the last diagnostics, the last scale of the dynamic resolution, the last memory in MB and the last number of pending jobs)
+		enum Counter {
+			BROAD_PHASE_PAIRS = 0,
+			OVERLAPS_X,
+			OVERLAPS_Y,
+			OVERLAPS_Z,
+			COLLIDING_PAIRS,
+			COARSE_PAIRS,
+			MIDPHASE_CULLED,
+			GJK_CALLS,
+			GJK_ITERATIONS,
+			EPA_ITERATIONS,
+			CONTACTS_RESOLVED,
+			SPECULATIVE_CONTACTS,
+			SOLVER_BATCHES,
+			BINARIES,
+			CLUSTERED_BODIES,
+			DUST_COLLISIONS,
+			FRAME_ALLOCATIONS,
+			RESOURCE_HITS,
+			RESOURCE_MISSES,
+			RESOURCE_EVICTIONS,
+			MAX_PENETRATION,
+			STEP_DT,
+			FORCE_REUSE_ERROR,
+			TOTAL_ENERGY,
+			ENERGY_DRIFT,
+			MOMENTUM_DRIFT,
+			ANGULAR_MOMENTUM_DRIFT,
+			RENDER_SCALE,
+			TRACKED_MEMORY,
+			RESIDENT_MEMORY,
+			PENDING_JOBS,
+			CNT_COUNTERS
+		};
+
+
+		/**
+		 * \brief Measures the time of a phase from its construction to its destruction (without the nested timers).
+		 */
+		class ScopedTimer {
+		public:
+
+			/**
+			 * \brief Start the timer of a phase.
+			 *
+			 * \param phase
+			 *      Measured phase.
+			 */
+			explicit ScopedTimer(Phase phase);
+
+
+			/**
+			 * \brief Stop the timer and add its own time to the current frame.
+			 */
+			~ScopedTimer();
+
+
+		private:
+
+			//! Measured phase
+			Phase _phase;
+
+			//! Start of the timer
+			osg::Timer_t _start;
+
+			//! Time of the nested timers in seconds
+			double _nested;
+
+			//! Enclosing timer of the same thread (nullptr => outermost)
+			ScopedTimer* _parent;
+
+			//! Cpu-time of each OpenMP-thread at the start (empty => not measured)
+			std::vector<double> _threadStart;
+
+			ScopedTimer(ScopedTimer const&) = delete;
+			ScopedTimer& operator=(ScopedTimer const&) = delete;
+		};
+
+
+		/**
+		 * \brief Singleton instance of the Profiler-class.
+		 */
+		static Profiler* Instance();
+
+
+		/**
+		 * \brief Add the time of a phase to the current frame.
+		 *
+		 * \param phase
+		 *      Measured phase.
+		 * \param seconds
+		 *      Time of the phase.
+		 */
+		void add(Phase phase, double seconds);
+
+
+		/**
+		 * \brief Store the sums of the phases of the current frame and start the next one.
+		 *
+		 * \param frameTime
+		 *      Total time of the frame in seconds (including the unmeasured parts like the rendering).
+		 */
+		void endFrame(double frameTime);
+
+
+		/**
+		 * \brief Add a value to a counter of the current frame.
+		 *
+		 * \param counter
+		 *      Counted value.
+		 * \param value
+		 *      Value to add (MAX_PENETRATION, STEP_DT, FORCE_REUSE_ERROR => the maximum is kept, the diagnostics and the
+		 *      scale of the resolution => the last value is kept).
+		 */
+		void count(Counter counter, double value);
+
+
+		/**
+		 * \brief Get a counter of the last frame which has ended.
+		 *
+		 * \param counter
+		 *      Counted value.
+		 *
+		 * \return Value of the counter.
+		 */
+		double getCounter(Counter counter) const;
+
+
+		/**
+		 * \brief Get the name of a counter.
+		 *
+		 * \param counter
+		 *      Counted value.
+		 *
+		 * \return Name of the counter (also used in the header of the csv-file).
+		 */
+		static const char* getCounterName(Counter counter);
+
+
+		/**
+		 * \brief Get a percentile of a phase over the frames of the rolling window.
+		 *
+		 * \param phase
+		 *      Phase of the frames (CNT_PHASES => total time of the frames).
+		 * \param percentile
+		 *      Percentile in [0, 100].
+		 *
+		 * \return Time in seconds (0 if no frame has ended yet).
+		 */
+		double getPercentile(Phase phase, double percentile) const;
+
+
+		/**
+		 * \brief Get the sum of a phase over all frames since the last reset.
+		 *
+		 * \param phase
+		 *      Phase of the frames (CNT_PHASES => total time of the frames).
+		 *
+		 * \return Time in seconds.
+		 */
+		double getTotal(Phase phase) const;
+
+
+		/**
+		 * \brief Get the cpu-time of each OpenMP-thread within a phase since the last reset (see setIsThreadTimes()).
+		 *
+		 * \param phase
+		 *      Outermost phase.
+		 *
+		 * \return Time in seconds per thread (empty if not measured).
+		 */
+		std::vector<double> getThreadTimes(Phase phase) const;
+
+
+		/**
+		 * \brief Get the imbalance of the OpenMP-threads within a phase since the last reset: The largest cpu-time of a
+		 *        thread divided by the mean (1 => balanced).
+		 *
+		 * \param phase
+		 *      Outermost phase.
+		 *
+		 * \return Imbalance (0 if not measured).
+		 */
+		double getThreadImbalance(Phase phase) const;
+
+
+		/**
+		 * \brief Forget all frames (the window and the sums), e.g. before the next benchmark.
+		 */
+		void reset();
+
+
+		/**
+		 * \brief Get the name of a phase.
+		 *
+		 * \param phase
+		 *      Phase of a frame (CNT_PHASES => total time of the frames).
+		 *
+		 * \return Name of the phase (also used in the header of the csv-file).
+		 */
+		static const char* getPhaseName(Phase phase);
+
+
+		/**
+		 * \brief Write the phases and counters of each frame into a csv-file (one row per frame, times in milliseconds).
+		 *
+		 * \param filePath
+		 *      Complete path to the csv-file (overwritten).
+		 *
+		 * \return False if the file can't be written.
+		 */
+		bool openCsv(std::string filePath);
+
+
+		/**
+		 * \brief Write the remaining rows and close the csv-file.
+		 */
+		void closeCsv();
+
+
+		/**
+		 * \brief Enable or disable the profiling (if disabled, the timers are not started).
+		 *
+		 * \param isEnabled
+		 *      True if the phases are measured.
+		 */
+		static void setIsEnabled(bool isEnabled) {
+			IS_ENABLED = isEnabled;
+		}
+
+
+		/**
+		 * \brief Get if the profiling is enabled.
+		 *
+		 * \return True if the phases are measured.
+		 */
+		static bool getIsEnabled() {
+			return IS_ENABLED;
+		}
+
+
+		/**
+		 * \brief Enable or disable the thread-times of the outermost phases (costs two parallel regions per phase).
+		 *
+		 * \param isThreadTimes
+		 *      True if the cpu-time of each OpenMP-thread is measured.
+		 */
+		static void setIsThreadTimes(bool isThreadTimes) {
+			IS_THREAD_TIMES = isThreadTimes;
+		}
+
+
+	private:
+
+		//! Number of frames in the rolling window
+		static const unsigned int WINDOW_SIZE;
+
+		//! Sums of the phases of the current frame
+		double _current[CNT_PHASES];
+
+		//! Phases and total time of the last frames (CNT_PHASES + 1 values per frame, ring-buffer)
+		std::vector<double> _window;
+
+		//! Counters of the current frame
+		double _currentCounters[CNT_COUNTERS];
+
+		//! Counters of the last frame which has ended
+		double _counters[CNT_COUNTERS];
+
+		//! Sums of the phases and the total time of all frames since the last reset
+		double _totals[CNT_PHASES + 1];
+
+		//! Cpu-time of each OpenMP-thread per outermost phase since the last reset
+		std::vector<double> _threadTimes[CNT_PHASES];
+
+		//! Number of frames which have ended
+		unsigned long _cntFrames;
+
+		//! Csv-file of the frames (not open => not written)
+		std::ofstream _csv;
+
+		//! Protects the current frame, the window and the csv-file.
+		mutable OpenThreads::Mutex _mutex;
+
+		//! True if the phases are measured
+		static bool IS_ENABLED;
+		//! True if the cpu-time of each OpenMP-thread is measured
+		static bool IS_THREAD_TIMES;
+
+
+		/**
+		 * \brief Get the cpu-time of each thread of the OpenMP-team (called outside of a parallel region).
+		 *
+		 * \param times
+		 *      Output-parameter: Cpu-time per thread in seconds.
+		 */
+		static void sampleThreadTimes(std::vector<double> &times);
+
+
+		/**
+		 * \brief Add the cpu-time of each thread to a phase.
+		 *
+		 * \param phase
+		 *      Outermost phase.
+		 * \param start, end
+		 *      Cpu-time per thread at the start and the end of the phase.
+		 */
+		void addThreadTimes(Phase phase, const std::vector<double> &start, const std::vector<double> &end);
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		Profiler();
+
+		//! Private copy-constructor to prevent copying the class.
+		Profiler(Profiler const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		Profiler& operator=(Profiler const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static Profiler* _pInstance;
+	};
+}
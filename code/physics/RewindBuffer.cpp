@@ -0,0 +1,340 @@
+﻿/**
+ * \brief Implementation of the ring of compressed keyframes for rewinding a live simulation.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "RewindBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include "MemoryTracker.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Append an unsigned number with 7 bits per byte (the high bit marks a following byte).
+	 */
+	void appendCount(std::vector<uint8_t> &data, uint64_t value) {
+		while (value >= 0x80) {
+			data.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		data.push_back(static_cast<uint8_t>(value));
+	}
+
+
+	/**
+	 * \brief Read a number of appendCount().
+	 */
+	uint64_t readCount(const uint8_t* &data) {
+		uint64_t value = 0;
+		int shift = 0;
+
+		while (*data & 0x80) {
+			value |= static_cast<uint64_t>(*data++ & 0x7f) << shift;
+			shift += 7;
+		}
+
+		return value | (static_cast<uint64_t>(*data++) << shift);
+	}
+
+
+	/**
+	 * \brief Get the bits of a value (the integers are not sign-extended).
+	 */
+	template<class T>
+	uint64_t getBits(T value) {
+		return static_cast<typename std::make_unsigned<T>::type>(value);
+	}
+
+	template<>
+	uint64_t getBits<double>(double value) {
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+
+	/**
+	 * \brief Get the value of the bits of getBits().
+	 */
+	template<class T>
+	T fromBits(uint64_t bits) {
+		return static_cast<T>(static_cast<typename std::make_unsigned<T>::type>(bits));
+	}
+
+	template<>
+	double fromBits<double>(uint64_t bits) {
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+
+	/**
+	 * \brief Append an array XORed with its reference (zero beyond the reference), each value with the number of
+	 *        its low bytes up to the highest one which is not zero.
+	 */
+	template<class T>
+	void encodeArray(const std::vector<T> &values, const std::vector<T> &reference, std::vector<uint8_t> &data) {
+		appendCount(data, values.size());
+
+		for (unsigned int i = 0; i < values.size(); ++i) {
+			uint64_t bits = getBits(values[i]) ^ (i < reference.size() ? getBits(reference[i]) : 0);
+			int cntBytes = 0;
+			while (cntBytes < 8 && (bits >> (8 * cntBytes)) != 0) {
+				++cntBytes;
+			}
+
+			data.push_back(static_cast<uint8_t>(cntBytes));
+			for (int b = 0; b < cntBytes; ++b) {
+				data.push_back(static_cast<uint8_t>(bits >> (8 * b)));
+			}
+		}
+	}
+
+
+	/**
+	 * \brief Read an array of encodeArray() with the same reference.
+	 */
+	template<class T>
+	void decodeArray(const uint8_t* &data, const std::vector<T> &reference, std::vector<T> &values) {
+		values.resize(readCount(data));
+
+		for (unsigned int i = 0; i < values.size(); ++i) {
+			int cntBytes = *data++;
+			uint64_t bits = 0;
+			for (int b = 0; b < cntBytes; ++b) {
+				bits |= static_cast<uint64_t>(*data++) << (8 * b);
+			}
+
+			values[i] = fromBits<T>(bits ^ (i < reference.size() ? getBits(reference[i]) : 0));
+		}
+	}
+}
+
+
+/**
+ * \brief Constructor of an empty ring.
+ *
+ * \param interval
+ *      Steps between two keyframes.
+ * \param capacity
+ *      Maximum number of keyframes (the oldest one is dropped).
+ */
+RewindBuffer::RewindBuffer(unsigned int interval, unsigned int capacity)
+	: _interval(std::max(interval, 1u)), _capacity(std::max(capacity, 1u)) {
+}
+
+
+/**
+ * \brief Destructor of the ring.
+ */
+RewindBuffer::~RewindBuffer() {
+	clear();
+}
+
+
+/**
+ * \brief Append the state after a step (the keyframes from this step on are replaced, e.g. after a rewind).
+ *
+ * \param step
+ *      Number of the step.
+ * \param time
+ *      Simulated time after the step.
+ * \param dt
+ *      Simulation-step.
+ * \param state
+ *      Complete state of the simulation.
+ */
+void RewindBuffer::push(unsigned long step, double time, double dt, const BinaryScene::State &state) {
+	// the keyframes from this step on belong to a previous run, the newest remaining one is the reference
+	if (!_keyframes.empty() && _keyframes.back().step >= step) {
+		while (!_keyframes.empty() && _keyframes.back().step >= step) {
+			track(-static_cast<long long>(_keyframes.back().data.size()));
+			_keyframes.pop_back();
+		}
+
+		_lastState = BinaryScene::State();
+		if (!_keyframes.empty()) {
+			decodeChain(_keyframes.size() - 1, _lastState);
+		}
+	}
+
+	Keyframe keyframe;
+	keyframe.step = step;
+	keyframe.time = time;
+	keyframe.dt = dt;
+	encode(state, _keyframes.empty() ? BinaryScene::State() : _lastState, keyframe.data);
+
+	track(keyframe.data.size());
+	_keyframes.push_back(keyframe);
+	_lastState = state;
+
+	// the second keyframe becomes the oldest one => it's encoded against zero
+	if (_keyframes.size() > _capacity) {
+		BinaryScene::State first;
+		BinaryScene::State second;
+		decode(_keyframes[0].data, BinaryScene::State(), first);
+		decode(_keyframes[1].data, first, second);
+
+		long long oldSize = _keyframes[0].data.size() + _keyframes[1].data.size();
+		encode(second, BinaryScene::State(), _keyframes[1].data);
+		track(static_cast<long long>(_keyframes[1].data.size()) - oldSize);
+
+		_keyframes.pop_front();
+	}
+}
+
+
+/**
+ * \brief Decode the newest keyframe up to a step. The newer keyframes are dropped (they are recorded again
+ *        by the re-simulation).
+ *
+ * \param step
+ *      Step to which the simulation is rewound.
+ * \param keyStep
+ *      Output-parameter: Step of the keyframe (<= step).
+ * \param time
+ *      Output-parameter: Simulated time of the keyframe.
+ * \param dt
+ *      Output-parameter: Simulation-step of the keyframe.
+ * \param state
+ *      Output-parameter: Complete state of the keyframe.
+ *
+ * \return False if the ring has no keyframe up to the step.
+ */
+bool RewindBuffer::restore(unsigned long step, unsigned long &keyStep, double &time, double &dt, BinaryScene::State &state) {
+	if (_keyframes.empty() || _keyframes.front().step > step) {
+		return false;
+	}
+
+	unsigned int last = 0;
+	while (last + 1 < _keyframes.size() && _keyframes[last + 1].step <= step) {
+		++last;
+	}
+
+	decodeChain(last, state);
+	keyStep = _keyframes[last].step;
+	time = _keyframes[last].time;
+	dt = _keyframes[last].dt;
+
+	while (_keyframes.size() > last + 1) {
+		track(-static_cast<long long>(_keyframes.back().data.size()));
+		_keyframes.pop_back();
+	}
+	_lastState = state;
+	++_generation;
+
+	return true;
+}
+
+
+/**
+ * \brief Drop all keyframes (e.g. when the bodies change).
+ */
+void RewindBuffer::clear() {
+	_keyframes.clear();
+	_lastState = BinaryScene::State();
+	track(-_memorySize);
+	++_generation;
+}
+
+
+/**
+ * \brief Compress a state.
+ *
+ * \param state
+ *      State to compress.
+ * \param reference
+ *      State of the previous keyframe (empty => zero).
+ * \param data
+ *      Output-parameter: Compressed state (overwritten).
+ */
+void RewindBuffer::encode(const BinaryScene::State &state, const BinaryScene::State &reference, std::vector<uint8_t> &data) {
+	data.clear();
+
+	encodeArray(state.positions, reference.positions, data);
+	encodeArray(state.orientations, reference.orientations, data);
+	encodeArray(state.linearVelocities, reference.linearVelocities, data);
+	encodeArray(state.angularVelocities, reference.angularVelocities, data);
+	encodeArray(state.sleeping, reference.sleeping, data);
+	encodeArray(state.restingSteps, reference.restingSteps, data);
+	encodeArray(state.timestepLevels, reference.timestepLevels, data);
+	encodeArray(state.forces, reference.forces, data);
+	encodeArray(state.pairBodies, reference.pairBodies, data);
+	encodeArray(state.pairSupportVertices, reference.pairSupportVertices, data);
+	encodeArray(state.pairDirections, reference.pairDirections, data);
+	encodeArray(state.impulseBodies, reference.impulseBodies, data);
+	encodeArray(state.impulses, reference.impulses, data);
+
+	data.shrink_to_fit();
+}
+
+
+/**
+ * \brief Decompress a state.
+ *
+ * \param data
+ *      Compressed state.
+ * \param reference
+ *      State of the previous keyframe (empty => zero), the same as for the compression.
+ * \param state
+ *      Output-parameter: Decompressed state.
+ */
+void RewindBuffer::decode(const std::vector<uint8_t> &data, const BinaryScene::State &reference, BinaryScene::State &state) {
+	const uint8_t* p = data.data();
+
+	decodeArray(p, reference.positions, state.positions);
+	decodeArray(p, reference.orientations, state.orientations);
+	decodeArray(p, reference.linearVelocities, state.linearVelocities);
+	decodeArray(p, reference.angularVelocities, state.angularVelocities);
+	decodeArray(p, reference.sleeping, state.sleeping);
+	decodeArray(p, reference.restingSteps, state.restingSteps);
+	decodeArray(p, reference.timestepLevels, state.timestepLevels);
+	decodeArray(p, reference.forces, state.forces);
+	decodeArray(p, reference.pairBodies, state.pairBodies);
+	decodeArray(p, reference.pairSupportVertices, state.pairSupportVertices);
+	decodeArray(p, reference.pairDirections, state.pairDirections);
+	decodeArray(p, reference.impulseBodies, state.impulseBodies);
+	decodeArray(p, reference.impulses, state.impulses);
+}
+
+
+/**
+ * \brief Decompress a keyframe with all keyframes before it.
+ *
+ * \param last
+ *      Index of the keyframe.
+ * \param state
+ *      Output-parameter: Decompressed state of the keyframe.
+ */
+void RewindBuffer::decodeChain(unsigned int last, BinaryScene::State &state) const {
+	BinaryScene::State reference;
+
+	for (unsigned int i = 0; i <= last; ++i) {
+		decode(_keyframes[i].data, reference, state);
+		if (i < last) {
+			reference = state;
+		}
+	}
+}
+
+
+/**
+ * \brief Add the change of the compressed keyframes to the memory-tracker.
+ *
+ * \param bytes
+ *      Allocated bytes (negative => released).
+ */
+void RewindBuffer::track(long long bytes) {
+	_memorySize += bytes;
+	MemoryTracker::add(MemoryTracker::REWIND_KEYFRAMES, bytes);
+}
@@ -0,0 +1,202 @@
+﻿/**
+ * \brief Implementation of the ring of compressed keyframes for rewinding a live simulation.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+#include "../scene/BinaryScene.h"
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Keeps the complete state of the simulation (the state of a checkpoint, see BinaryScene::State) every
+	 * interval steps in a bounded ring, so the simulation can be rewound to any step of the ring: the nearest
+	 * keyframe before the step is restored and the rest is simulated again (at most interval steps).
+	 *
+	 * The keyframes are compressed without loss, so the re-simulation is bitwise the same: each value is XORed with
+	 * the same value of the previous keyframe (the oldest keyframe with zero) and only its low bytes up to the highest
+	 * one which is not zero are stored (one byte with their number, then the bytes). The unchanged values (e.g. of the
+	 * sleeping bodies) take one byte. When the oldest keyframe is dropped, the next one is encoded again against zero.
+	 */
+	class RewindBuffer {
+	public:
+
+		/**
+		 * \brief Constructor of an empty ring.
+		 *
+		 * \param interval
+		 *      Steps between two keyframes.
+		 * \param capacity
+		 *      Maximum number of keyframes (the oldest one is dropped).
+		 */
+		RewindBuffer(unsigned int interval, unsigned int capacity);
+
+
+		/**
+		 * \brief Destructor of the ring.
+		 */
+		~RewindBuffer();
+
+
+		/**
+		 * \brief Append the state after a step (the keyframes from this step on are replaced, e.g. after a rewind).
+		 *
+		 * \param step
+		 *      Number of the step.
+		 * \param time
+		 *      Simulated time after the step.
+		 * \param dt
+		 *      Simulation-step.
+		 * \param state
+		 *      Complete state of the simulation.
+		 */
+		void push(unsigned long step, double time, double dt, const BinaryScene::State &state);
+
+
+		/**
+		 * \brief Decode the newest keyframe up to a step. The newer keyframes are dropped (they are recorded again
+		 *        by the re-simulation).
+		 *
+		 * \param step
+		 *      Step to which the simulation is rewound.
+		 * \param keyStep
+		 *      Output-parameter: Step of the keyframe (<= step).
+		 * \param time
+		 *      Output-parameter: Simulated time of the keyframe.
+		 * \param dt
+		 *      Output-parameter: Simulation-step of the keyframe.
+		 * \param state
+		 *      Output-parameter: Complete state of the keyframe.
+		 *
+		 * \return False if the ring has no keyframe up to the step.
+		 */
+		bool restore(unsigned long step, unsigned long &keyStep, double &time, double &dt, BinaryScene::State &state);
+
+
+		/**
+		 * \brief Drop all keyframes (e.g. when the bodies change).
+		 */
+		void clear();
+
+
+		/**
+		 * \brief Get the steps between two keyframes.
+		 *
+		 * \return Interval of the keyframes.
+		 */
+		unsigned int getInterval() const {
+			return _interval;
+		}
+
+
+		/**
+		 * \brief Get the number of keyframes.
+		 *
+		 * \return Keyframes in the ring.
+		 */
+		unsigned int size() const {
+			return static_cast<unsigned int>(_keyframes.size());
+		}
+
+
+		/**
+		 * \brief Get the memory of the compressed keyframes.
+		 *
+		 * \return Size in bytes.
+		 */
+		long long getMemorySize() const {
+			return _memorySize;
+		}
+
+
+		/**
+		 * \brief Get the generation of the ring, it changes with clear() and restore() (e.g. a queued push is
+		 *        dropped, since its state belongs to the previous bodies or the previous run).
+		 *
+		 * \return Number of the clears and the restores.
+		 */
+		unsigned int getGeneration() const {
+			return _generation;
+		}
+
+
+	private:
+		/**
+		 * \brief Compressed state after a step.
+		 */
+		struct Keyframe {
+			unsigned long step;
+			double time;
+			double dt;
+			std::vector<uint8_t> data;
+		};
+
+
+		//! Steps between two keyframes
+		unsigned int _interval;
+		//! Maximum number of keyframes
+		unsigned int _capacity;
+		//! Keyframes in the order of their steps
+		std::deque<Keyframe> _keyframes;
+		//! Decoded newest keyframe (reference of the next one)
+		BinaryScene::State _lastState;
+		//! Memory of the compressed keyframes in bytes
+		long long _memorySize = 0;
+		//! Number of the clears and the restores
+		unsigned int _generation = 0;
+
+
+		/**
+		 * \brief Compress a state.
+		 *
+		 * \param state
+		 *      State to compress.
+		 * \param reference
+		 *      State of the previous keyframe (empty => zero).
+		 * \param data
+		 *      Output-parameter: Compressed state (overwritten).
+		 */
+		static void encode(const BinaryScene::State &state, const BinaryScene::State &reference, std::vector<uint8_t> &data);
+
+
+		/**
+		 * \brief Decompress a state.
+		 *
+		 * \param data
+		 *      Compressed state.
+		 * \param reference
+		 *      State of the previous keyframe (empty => zero), the same as for the compression.
+		 * \param state
+		 *      Output-parameter: Decompressed state.
+		 */
+		static void decode(const std::vector<uint8_t> &data, const BinaryScene::State &reference, BinaryScene::State &state);
+
+
+		/**
+		 * \brief Decompress a keyframe with all keyframes before it.
+		 *
+		 * \param last
+		 *      Index of the keyframe.
+		 * \param state
+		 *      Output-parameter: Decompressed state of the keyframe.
+		 */
+		void decodeChain(unsigned int last, BinaryScene::State &state) const;
+
+
+		/**
+		 * \brief Add the change of the compressed keyframes to the memory-tracker.
+		 *
+		 * \param bytes
+		 *      Allocated bytes (negative => released).
+		 */
+		void track(long long bytes);
+	};
+}
@@ -0,0 +1,257 @@
+﻿/**
+ * \brief Implementation of the server which forks the runs of a sweep from a preloaded scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "RunServer.h"
+
+#include <cstdio>
+#include <string>
+#include <OpenThreads/Thread>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "Socket.h"
+#include "NumaPolicy.h"
+#include "Logger.h"
+
+using namespace pbs17;
+using json = nlohmann::json;
+
+
+//! The children use all cpus unless prepareParent has recorded the threads of the command-line.
+int RunServer::CNT_THREADS = 0;
+const unsigned int RunServer::ACCEPT_INTERVAL;
+const unsigned int RunServer::REQUEST_TIMEOUT;
+const unsigned int RunServer::MAX_REQUEST;
+
+
+/**
+ * \brief Constructor of the server (listens on the port).
+ *
+ * \param port
+ *      TCP-port on which the parameter-sets are received.
+ * \param maxRuns
+ *      Maximal number of concurrent children (0 => unlimited).
+ * \param run
+ *      Simulation of a parameter-set (called in the child).
+ */
+RunServer::RunServer(unsigned short port, unsigned int maxRuns, const Run &run) : _maxRuns(maxRuns), _run(run) {
+	_listener = Socket::listen(port);
+
+	if (_listener < 0) {
+		LOG_ERROR("Port " << port << " can't be opened for the runs!");
+	} else {
+		LOG_INFO("Serving the runs of the scene on port " << port);
+	}
+}
+
+
+/**
+ * \brief Destructor of the server (closes the port).
+ */
+RunServer::~RunServer() {
+	if (_listener >= 0) {
+		Socket::close(_listener);
+	}
+}
+
+
+/**
+ * \brief Check if the runs can be forked (POSIX).
+ *
+ * \return True if the server is supported on this platform.
+ */
+bool RunServer::isSupported() {
+#if defined(__unix__) || defined(__APPLE__)
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * \brief Prepare the process of the server before the scene is loaded: the OpenMP-threads of the parent would
+ *        not exist in the forked children, so the server loads the scene on a single thread and the children
+ *        start their own team with the original number of threads.
+ */
+void RunServer::prepareParent() {
+#if defined(_OPENMP)
+	// the runtime can't be used by a child which was forked after a parallel region with more than one thread
+	CNT_THREADS = omp_get_max_threads();
+	omp_set_num_threads(1);
+#endif
+}
+
+
+/**
+ * \brief Receive the parameter-sets and fork their runs until a shutdown is requested.
+ *
+ * \return Exit-code of the server.
+ */
+int RunServer::serve() {
+	if (!isSupported() || _listener < 0) {
+		return 1;
+	}
+
+	bool isServing = true;
+	while (isServing) {
+		reap(_maxRuns > 0 && _cntRunning >= _maxRuns);
+
+		int socket = _cntRunning < _maxRuns || _maxRuns == 0 ? Socket::accept(_listener) : -1;
+		if (socket >= 0) {
+			isServing = handle(socket);
+		} else {
+			OpenThreads::Thread::microSleep(ACCEPT_INTERVAL);
+		}
+	}
+
+	// the runs which are already forked are finished
+	while (_cntRunning > 0) {
+		reap(true);
+	}
+
+	LOG_INFO("Stopped serving the runs");
+	return 0;
+}
+
+
+/**
+ * \brief Collect the finished children.
+ *
+ * \param isBlocking
+ *      Wait until at least one child is finished.
+ */
+void RunServer::reap(bool isBlocking) {
+#if defined(__unix__) || defined(__APPLE__)
+	int status;
+	pid_t pid;
+
+	while (_cntRunning > 0 && (pid = waitpid(-1, &status, isBlocking ? 0 : WNOHANG)) > 0) {
+		--_cntRunning;
+		isBlocking = false;
+
+		if (WIFEXITED(status)) {
+			LOG_INFO("Run " << pid << " finished with " << WEXITSTATUS(status));
+		} else {
+			LOG_WARNING("Run " << pid << " was terminated");
+		}
+	}
+#endif
+}
+
+
+/**
+ * \brief Receive the parameter-set of a client and fork its run.
+ *
+ * \param socket
+ *      Connected socket of the client.
+ *
+ * \return False if the shutdown is requested.
+ */
+bool RunServer::handle(int socket) {
+	// a client which sends nothing is dropped after the timeout
+	Socket::setTimeout(socket, REQUEST_TIMEOUT);
+
+	std::string request;
+	char buffer[4096];
+	while (request.size() < MAX_REQUEST && request.find('\n') == std::string::npos) {
+		long received = Socket::receive(socket, buffer, sizeof(buffer));
+		if (received <= 0) break;
+		request.append(buffer, static_cast<size_t>(received));
+	}
+
+	json parameters;
+	try {
+		parameters = json::parse(request.substr(0, request.find('\n')));
+	} catch (const std::exception &ex) {
+		std::string answer = std::string("Invalid parameter-set: ") + ex.what() + "\n";
+		Socket::send(socket, answer.c_str(), answer.size());
+		Socket::close(socket);
+		return true;
+	}
+
+	if (parameters.count("shutdown") && parameters["shutdown"].get<bool>()) {
+		const char answer[] = "Shutting down\n";
+		Socket::send(socket, answer, sizeof(answer) - 1);
+		Socket::close(socket);
+		return false;
+	}
+
+#if defined(__unix__) || defined(__APPLE__)
+	// the buffered output of the server would be written a second time by the child
+	std::fflush(nullptr);
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		runChild(socket, parameters);
+	}
+
+	if (pid < 0) {
+		const char answer[] = "The run can't be forked\n";
+		Socket::send(socket, answer, sizeof(answer) - 1);
+		LOG_ERROR("The run can't be forked!");
+	} else {
+		++_cntRunning;
+		LOG_INFO("Run " << pid << " started: " << request.substr(0, request.find('\n')));
+	}
+#endif
+
+	Socket::close(socket);
+	return true;
+}
+
+
+/**
+ * \brief Simulate the parameter-set in the forked child and exit (never returns).
+ *
+ * \param socket
+ *      Connected socket of the client (receives the console-output).
+ * \param request
+ *      Parameter-set of the run.
+ */
+void RunServer::runChild(int socket, const json &request) {
+#if defined(__unix__) || defined(__APPLE__)
+	Socket::close(_listener);
+	// a slow client must not fail the writes of a long run
+	Socket::setTimeout(socket, 0);
+
+	// the console of the run is streamed to its client
+	dup2(socket, STDOUT_FILENO);
+	dup2(socket, STDERR_FILENO);
+	Socket::close(socket);
+	Logger::restartAfterFork();
+
+	// the child starts its own team of OpenMP-threads
+#if defined(_OPENMP)
+	if (CNT_THREADS > 0) {
+		omp_set_num_threads(CNT_THREADS);
+	}
+#endif
+	NumaPolicy::pinWorkers();
+
+	int code;
+	try {
+		code = _run(request);
+	} catch (const std::exception &ex) {
+		LOG_ERROR("Run failed: " << ex.what());
+		code = 1;
+	}
+
+	// the destructors of the server's state are not run, its copy is discarded with the process
+	Logger::Instance()->stop();
+	std::fflush(nullptr);
+	_exit(code);
+#endif
+}
@@ -0,0 +1,135 @@
+﻿/**
+ * \brief Implementation of the server which forks the runs of a sweep from a preloaded scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <functional>
+#include <json.hpp>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Serves the runs of a sweep from a scene which is loaded only once: the models, the convex-hulls, the
+	 * textures and the json are prepared by the server, each received parameter-set is simulated by a forked child
+	 * which inherits all of it copy-on-write (POSIX only). The children of concurrent runs share the pages which they
+	 * don't write, so only the state of the bodies is copied per run.
+	 *
+	 * Protocol: a client sends one json-line per connection, e.g. {"steps": 1000, "settings": {"theta": 0.7}} (see the
+	 * run-callback), and receives the console-output of its child until the run is finished. {"shutdown": true} stops
+	 * the server once the running children are finished.
+	 */
+	class RunServer {
+	public:
+		//! Simulates one parameter-set in the child, the result is its exit-code
+		typedef std::function<int(const nlohmann::json&)> Run;
+
+
+		/**
+		 * \brief Constructor of the server (listens on the port).
+		 *
+		 * \param port
+		 *      TCP-port on which the parameter-sets are received.
+		 * \param maxRuns
+		 *      Maximal number of concurrent children (0 => unlimited).
+		 * \param run
+		 *      Simulation of a parameter-set (called in the child).
+		 */
+		RunServer(unsigned short port, unsigned int maxRuns, const Run &run);
+
+
+		/**
+		 * \brief Destructor of the server (closes the port).
+		 */
+		~RunServer();
+
+
+		/**
+		 * \brief Check if the port could be opened.
+		 *
+		 * \return True if the parameter-sets can be received.
+		 */
+		bool isListening() const {
+			return _listener >= 0;
+		}
+
+
+		/**
+		 * \brief Receive the parameter-sets and fork their runs until a shutdown is requested.
+		 *
+		 * \return Exit-code of the server.
+		 */
+		int serve();
+
+
+		/**
+		 * \brief Check if the runs can be forked (POSIX).
+		 *
+		 * \return True if the server is supported on this platform.
+		 */
+		static bool isSupported();
+
+
+		/**
+		 * \brief Prepare the process of the server before the scene is loaded: the OpenMP-threads of the parent would
+		 *        not exist in the forked children, so the server loads the scene on a single thread and the children
+		 *        start their own team with the original number of threads.
+		 */
+		static void prepareParent();
+
+
+	private:
+		//! Listening socket (-1 => not listening)
+		int _listener = -1;
+		//! Maximal number of concurrent children (0 => unlimited)
+		unsigned int _maxRuns;
+		//! Simulation of a parameter-set
+		Run _run;
+		//! Number of the running children
+		unsigned int _cntRunning = 0;
+
+		//! Number of OpenMP-threads of the children (recorded by prepareParent)
+		static int CNT_THREADS;
+		//! Microseconds which the server sleeps if no parameter-set is waiting
+		static const unsigned int ACCEPT_INTERVAL = 100000;
+		//! Milliseconds which a client may take to send its parameter-set
+		static const unsigned int REQUEST_TIMEOUT = 1000;
+		//! Maximal size of a parameter-set
+		static const unsigned int MAX_REQUEST = 65536;
+
+
+		/**
+		 * \brief Collect the finished children.
+		 *
+		 * \param isBlocking
+		 *      Wait until at least one child is finished.
+		 */
+		void reap(bool isBlocking);
+
+
+		/**
+		 * \brief Receive the parameter-set of a client and fork its run.
+		 *
+		 * \param socket
+		 *      Connected socket of the client.
+		 *
+		 * \return False if the shutdown is requested.
+		 */
+		bool handle(int socket);
+
+
+		/**
+		 * \brief Simulate the parameter-set in the forked child and exit (never returns).
+		 *
+		 * \param socket
+		 *      Connected socket of the client (receives the console-output).
+		 * \param request
+		 *      Parameter-set of the run.
+		 */
+		void runChild(int socket, const nlohmann::json &request);
+	};
+}
@@ -0,0 +1,456 @@
+﻿/**
+ * \brief Implementation of the streaming of the sectors of a very large asteroid-field around the camera.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "SectorManager.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <OpenThreads/ScopedLock>
+
+#include "../osg/JsonEigenConversions.h"
+#include "../osg/OsgEigenConversions.h"
+#include "../scene/Asteroid.h"
+#include "../scene/BinaryScene.h"
+#include "../scene/SpaceObject.h"
+#include "KeplerOrbit.h"
+#include "Logger.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor of the sector-manager: create the pool of asteroids (nothing is loaded yet).
+ *
+ * \param settings
+ *      Sector-settings of the scene (e.g. {"directory": "field", "size": 500, "radius": 1, "pool": 2048,
+ *      "asteroid": {...}}), the asteroid is the json-object of the pooled asteroids (model, texture, scaling).
+ * \param spaceObjects
+ *      All space-objects in the scene (the heaviest one is the center of the orbits).
+ * \param G
+ *      Gravitational constant of the simulation.
+ */
+SectorManager::SectorManager(json settings, const std::vector<SpaceObject*> &spaceObjects, double G)
+	: _root(new osg::Group), _G(G) {
+	_directory = settings["directory"].is_string() ? settings["directory"].get<std::string>() : ".";
+	if (settings["size"].is_number() && settings["size"].get<double>() > 0.0) {
+		_sectorSize = settings["size"].get<double>();
+	}
+	if (settings["radius"].is_number_integer()) {
+		_radius = std::max(settings["radius"].get<int>(), 0);
+	}
+
+	for (unsigned int i = 0; i < spaceObjects.size(); ++i) {
+		if (spaceObjects[i]->getMass() > 0.0 && (_central == nullptr || spaceObjects[i]->getMass() > _central->getMass())) {
+			_central = spaceObjects[i];
+		}
+	}
+
+	if (_central) {
+		_centralPosition = _central->getPosition();
+		_centralVelocity = _central->getLinearVelocity();
+	}
+
+	// the pooled asteroids share the model, the texture and the scaling, the state is set when they are spawned
+	int cntPool = settings["pool"].is_number_integer() ? std::max(settings["pool"].get<int>(), 0) : 1024;
+	if (!settings["asteroid"].is_object()) {
+		LOG_WARNING("Sectors need a pooled asteroid (\"asteroid\")!");
+		cntPool = 0;
+	}
+
+	json asteroid = settings["asteroid"];
+	const char* vectors[] = { "position", "linearVelocity", "angularVelocity", "force", "torque" };
+	for (int k = 0; k < 5 && cntPool > 0; ++k) {
+		if (!asteroid[vectors[k]].is_object()) {
+			asteroid[vectors[k]] = { { "x", 0.0 }, { "y", 0.0 }, { "z", 0.0 } };
+		}
+	}
+	if (!asteroid["ratio"].is_number()) asteroid["ratio"] = 1.0;
+	if (!asteroid["scaling"].is_number()) asteroid["scaling"] = 1.0;
+	if (!asteroid["mass"].is_number() || asteroid["mass"].get<double>() <= 0.0) asteroid["mass"] = 1.0;
+
+	_pool.reserve(cntPool);
+	for (int i = 0; i < cntPool; ++i) {
+		Asteroid* object = new Asteroid(asteroid);
+
+		if (i == 0) {
+			_inertiaPerMass = object->getMomentOfInertia() / object->getMass();
+		}
+
+		_pool.add(object);
+		_root->addChild(object->getModel());
+	}
+
+	LOG_INFO("Pooled " << cntPool << " asteroids for the sectors in " << _directory);
+}
+
+
+/**
+ * \brief Destructor of the sector-manager (stops the thread and deletes the pooled asteroids).
+ */
+SectorManager::~SectorManager() {
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		_isRunning = false;
+		_notEmpty.signal();
+	}
+
+	if (isRunning()) {
+		join();
+	}
+}
+
+
+/**
+ * \brief Load the sectors around the focus and park the sectors which left the radius. Has to be called by the
+ *        thread of the simulation between two steps (the objects are spawned and despawned by the caller).
+ *
+ * \param focus
+ *      Center of the loaded sectors.
+ * \param time
+ *      Simulated time.
+ * \param spawned
+ *      Output-parameter: The activated asteroids are appended (to be spawned).
+ * \param despawned
+ *      Output-parameter: The asteroids of the parked sectors are appended (to be despawned).
+ */
+void SectorManager::update(const Eigen::Vector3d &focus, double time, std::vector<SpaceObject*> &spawned, std::vector<SpaceObject*> &despawned) {
+	int cx = static_cast<int>(std::floor(focus.x() / _sectorSize));
+	int cy = static_cast<int>(std::floor(focus.y() / _sectorSize));
+	int cz = static_cast<int>(std::floor(focus.z() / _sectorSize));
+
+	// the sectors are parked one sector later than they are loaded, so the border can be crossed back and forth
+	for (unsigned int i = 0; i < _resident.size();) {
+		Sector &sector = _sectors[_resident[i]];
+		int distance = std::max(std::abs(sector.x - cx), std::max(std::abs(sector.y - cy), std::abs(sector.z - cz)));
+
+		if (distance > _radius + 1) {
+			park(_resident[i], sector, time, despawned);
+			_resident[i] = _resident.back();
+			_resident.pop_back();
+		} else {
+			++i;
+		}
+	}
+
+	// the loaded files are parked at the time zero (they are spawned below if they are still in the radius)
+	std::deque<Request> loaded;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		loaded.swap(_loaded);
+	}
+
+	for (unsigned int i = 0; i < loaded.size(); ++i) {
+		Sector &sector = _sectors[loaded[i].key];
+		sector.bodies.swap(loaded[i].bodies);
+		sector.time = 0.0;
+		sector.state = PARKED;
+	}
+
+	for (int x = cx - _radius; x <= cx + _radius; ++x) {
+		for (int y = cy - _radius; y <= cy + _radius; ++y) {
+			for (int z = cz - _radius; z <= cz + _radius; ++z) {
+				uint64_t key = getKey(x, y, z);
+				Sector &sector = _sectors[key];
+
+				if (sector.state == UNKNOWN) {
+					sector.x = x;
+					sector.y = y;
+					sector.z = z;
+					sector.state = PENDING;
+
+					Request request;
+					request.key = key;
+					request.x = x;
+					request.y = y;
+					request.z = z;
+
+					OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+					_queue.push_back(request);
+					_notEmpty.signal();
+
+					if (!_isStarted) {
+						_isStarted = true;
+						start();
+					}
+				} else if (sector.state == PARKED) {
+					restore(key, sector, time, spawned);
+					_resident.push_back(key);
+				}
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Main-loop of the thread: read the requested sector-files (waits while the queue is empty).
+ */
+void SectorManager::run() {
+	while (true) {
+		Request request;
+
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+			while (_queue.empty() && _isRunning) {
+				_notEmpty.wait(&_mutex);
+			}
+
+			// the queued sectors are not needed anymore
+			if (!_isRunning) {
+				return;
+			}
+
+			request = _queue.front();
+			_queue.pop_front();
+		}
+
+		readSector(request);
+
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		_loaded.push_back(request);
+	}
+}
+
+
+/**
+ * \brief Partition the asteroids of a scene into sector-files (the other objects stay in the scene).
+ *        The remaining scene is written into the same directory ("scene.pbsc"), its simulation streams
+ *        the sectors with the first asteroid as the pooled one.
+ *
+ * \param scene
+ *      Scene with the asteroids.
+ * \param directory
+ *      Directory of the sector-files.
+ * \param size
+ *      Edge-length of a sector.
+ *
+ * \return Number of written sectors (-1 => a file can't be written).
+ */
+int SectorManager::writeSectors(const BinaryScene &scene, std::string directory, double size) {
+	std::map<uint64_t, BinaryScene> sectors;
+	std::map<uint64_t, Eigen::Vector3i> coordinates;
+	BinaryScene rest;
+	json settings = scene.getSettings();
+	json asteroid;
+
+	for (unsigned int i = 0; i < scene.getNumBodies(); ++i) {
+		json d = scene.getBody(i);
+
+		if (d["type"] != "asteroid") {
+			rest.addBody(d);
+			continue;
+		}
+
+		if (asteroid.is_null()) {
+			asteroid = d;
+		}
+
+		Eigen::Vector3d position = fromJson(d["position"]);
+		int x = static_cast<int>(std::floor(position.x() / size));
+		int y = static_cast<int>(std::floor(position.y() / size));
+		int z = static_cast<int>(std::floor(position.z() / size));
+		uint64_t key = getKey(x, y, z);
+
+		coordinates[key] = Eigen::Vector3i(x, y, z);
+		sectors[key].addBody(d);
+	}
+
+	for (std::map<uint64_t, BinaryScene>::iterator it = sectors.begin(); it != sectors.end(); ++it) {
+		const Eigen::Vector3i &c = coordinates[it->first];
+		if (!it->second.save(getFilePath(directory, c.x(), c.y(), c.z()))) {
+			return -1;
+		}
+	}
+
+	if (!asteroid.is_null() && !settings["simulation"]["sectors"].is_object()) {
+		settings["simulation"]["sectors"] = { { "directory", directory }, { "size", size }, { "asteroid", asteroid } };
+	}
+
+	rest.setSettings(settings);
+	if (!rest.save(directory + "/scene.pbsc")) {
+		return -1;
+	}
+
+	return static_cast<int>(sectors.size());
+}
+
+
+/**
+ * \brief Get the key of a sector from its integer coordinates (21 bits per axis).
+ *
+ * \return Key of the sector.
+ */
+uint64_t SectorManager::getKey(int x, int y, int z) {
+	const int64_t offset = 1 << 20;
+	const uint64_t mask = (1 << 21) - 1;
+
+	return ((static_cast<uint64_t>(x + offset) & mask) << 42)
+		| ((static_cast<uint64_t>(y + offset) & mask) << 21)
+		| (static_cast<uint64_t>(z + offset) & mask);
+}
+
+
+/**
+ * \brief Get the file of a sector.
+ *
+ * \return Complete path to the binary scene of the sector.
+ */
+std::string SectorManager::getFilePath(const std::string &directory, int x, int y, int z) {
+	std::ostringstream path;
+	path << directory << "/sector_" << x << "_" << y << "_" << z << ".pbsc";
+
+	return path.str();
+}
+
+
+/**
+ * \brief Read the asteroids of a sector-file (a missing file is an empty sector).
+ *
+ * \param request
+ *      Requested sector, its bodies are appended.
+ */
+void SectorManager::readSector(Request &request) const {
+	BinaryScene scene;
+	if (!scene.load(getFilePath(_directory, request.x, request.y, request.z))) {
+		return;
+	}
+
+	request.bodies.reserve(scene.getNumBodies());
+	for (unsigned int i = 0; i < scene.getNumBodies(); ++i) {
+		json d = scene.getBody(i);
+		if (d["type"] != "asteroid") continue;
+
+		// the files store the absolute state at the time zero
+		Body body;
+		body.position = fromJson(d["position"]) - _centralPosition;
+		body.linearVelocity = fromJson(d["linearVelocity"]) - _centralVelocity;
+		body.angularVelocity = fromJson(d["angularVelocity"]);
+		body.orientation = osg::Quat(0, osg::X_AXIS);
+		body.mass = d["mass"].get<double>();
+		request.bodies.push_back(body);
+	}
+}
+
+
+/**
+ * \brief Move parked bodies along their orbits around the center.
+ *
+ * \param bodies
+ *      Input- and output-parameter: Parked bodies.
+ * \param dt
+ *      Time since the bodies were parked.
+ */
+void SectorManager::propagate(std::vector<Body> &bodies, double dt) const {
+	if (dt == 0.0) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < bodies.size(); ++i) {
+		Body &body = bodies[i];
+
+		// the orbits which don't converge (and all bodies without a center) drift on straight lines
+		if (_central == nullptr || !KeplerOrbit::propagate(_G * (_central->getMass() + body.mass), body.position, body.linearVelocity, dt)) {
+			body.position += dt * body.linearVelocity;
+		}
+
+		double angle = body.angularVelocity.norm() * dt;
+		if (angle > 0.0) {
+			body.orientation = body.orientation * osg::Quat(angle, toOsg(body.angularVelocity.normalized()));
+		}
+	}
+}
+
+
+/**
+ * \brief Spawn the parked bodies of a sector into the pool (the bodies which don't fit stay parked).
+ *
+ * \param key
+ *      Key of the sector.
+ * \param sector
+ *      Parked sector.
+ * \param time
+ *      Simulated time.
+ * \param spawned
+ *      Output-parameter: The activated asteroids are appended.
+ */
+void SectorManager::restore(uint64_t key, Sector &sector, double time, std::vector<SpaceObject*> &spawned) {
+	propagate(sector.bodies, time - sector.time);
+
+	Eigen::Vector3d offset = _central ? _central->getPosition() : Eigen::Vector3d::Zero();
+	Eigen::Vector3d velocity = _central ? _central->getLinearVelocity() : Eigen::Vector3d::Zero();
+
+	unsigned int cntSpawned = 0;
+	for (; cntSpawned < sector.bodies.size(); ++cntSpawned) {
+		SpaceObject* object = _pool.acquire();
+		if (object == nullptr) break;
+
+		const Body &body = sector.bodies[cntSpawned];
+		// the moment of inertia of the template is not scaled again by the asteroid
+		object->SpaceObject::initPhysics(body.mass, body.linearVelocity + velocity, body.angularVelocity, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+		object->setMomentOfInertia(body.mass * _inertiaPerMass);
+		object->setSleeping(false);
+		object->resetCollisionState();
+		object->setPositionOrientation(body.position + offset, body.orientation);
+		object->setActive(true);
+
+		sector.objects.push_back(object);
+		_owners[object] = key;
+		spawned.push_back(object);
+	}
+
+	sector.bodies.erase(sector.bodies.begin(), sector.bodies.begin() + cntSpawned);
+	sector.time = time;
+	sector.state = RESIDENT;
+}
+
+
+/**
+ * \brief Park the asteroids of a resident sector.
+ *
+ * \param key
+ *      Key of the sector.
+ * \param sector
+ *      Resident sector.
+ * \param time
+ *      Simulated time.
+ * \param despawned
+ *      Output-parameter: The parked asteroids are appended.
+ */
+void SectorManager::park(uint64_t key, Sector &sector, double time, std::vector<SpaceObject*> &despawned) {
+	// the bodies which didn't fit into the pool are moved to the same time as the parked ones
+	propagate(sector.bodies, time - sector.time);
+
+	Eigen::Vector3d offset = _central ? _central->getPosition() : Eigen::Vector3d::Zero();
+	Eigen::Vector3d velocity = _central ? _central->getLinearVelocity() : Eigen::Vector3d::Zero();
+
+	for (unsigned int i = 0; i < sector.objects.size(); ++i) {
+		SpaceObject* object = sector.objects[i];
+
+		// the broken and the absorbed asteroids went back to the pool (and may be used by another sector)
+		std::unordered_map<SpaceObject*, uint64_t>::iterator owner = _owners.find(object);
+		if (owner == _owners.end() || owner->second != key || !object->isActive()) continue;
+
+		Body body;
+		body.position = object->getPosition() - offset;
+		body.linearVelocity = object->getLinearVelocity() - velocity;
+		body.angularVelocity = object->getAngularVelocity();
+		body.orientation = object->getOrientation();
+		body.mass = object->getMass();
+		sector.bodies.push_back(body);
+
+		_owners.erase(owner);
+		despawned.push_back(object);
+	}
+
+	sector.objects.clear();
+	sector.time = time;
+	sector.state = PARKED;
+}
@@ -0,0 +1,295 @@
+﻿/**
+ * \brief Implementation of the streaming of the sectors of a very large asteroid-field around the camera.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+
+#include <Eigen/Core>
+#include <osg/Group>
+#include <osg/Quat>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+#include <json.hpp>
+
+#include "BodyPool.h"
+
+using json = nlohmann::json;
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+	class BinaryScene;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief The manager which streams the asteroids of a field which is too large to be simulated (or kept in memory
+	 * as space-objects) at once. The world is partitioned into cubic sectors, the asteroids of each sector are stored
+	 * in their own binary scene (see writeSectors()). The sectors around the focus (the player or the camera) are read
+	 * on a background-thread and spawned into a pool of asteroids (see BodyPool), which is created with the scene, so
+	 * loading a sector neither allocates nodes nor rebuilds the managers of the simulation.
+	 *
+	 * A sector which leaves the radius is despawned and its bodies are parked as plain states relative to the heaviest
+	 * body of the scene. When it comes back, the parked bodies (and the bodies of a file, which are stored at the time
+	 * zero) are moved along their Kepler-orbits around the heaviest body for the time they were away (see KeplerOrbit),
+	 * so the field stays consistent without being integrated.
+	 *
+	 * A body stays in the sector in which it was loaded. Once the pool is exhausted, the remaining bodies of a sector
+	 * stay parked (they are moved on their orbits with the sector).
+	 */
+	class SectorManager : public OpenThreads::Thread {
+	public:
+		/**
+		 * \brief Constructor of the sector-manager: create the pool of asteroids (nothing is loaded yet).
+		 *
+		 * \param settings
+		 *      Sector-settings of the scene (e.g. {"directory": "field", "size": 500, "radius": 1, "pool": 2048,
+		 *      "asteroid": {...}}), the asteroid is the json-object of the pooled asteroids (model, texture, scaling).
+		 * \param spaceObjects
+		 *      All space-objects in the scene (the heaviest one is the center of the orbits).
+		 * \param G
+		 *      Gravitational constant of the simulation.
+		 */
+		SectorManager(json settings, const std::vector<SpaceObject*> &spaceObjects, double G);
+
+
+		/**
+		 * \brief Destructor of the sector-manager (stops the thread and deletes the pooled asteroids).
+		 */
+		~SectorManager();
+
+
+		/**
+		 * \brief Load the sectors around the focus and park the sectors which left the radius. Has to be called by the
+		 *        thread of the simulation between two steps (the objects are spawned and despawned by the caller).
+		 *
+		 * \param focus
+		 *      Center of the loaded sectors.
+		 * \param time
+		 *      Simulated time.
+		 * \param spawned
+		 *      Output-parameter: The activated asteroids are appended (to be spawned).
+		 * \param despawned
+		 *      Output-parameter: The asteroids of the parked sectors are appended (to be despawned).
+		 */
+		void update(const Eigen::Vector3d &focus, double time, std::vector<SpaceObject*> &spawned, std::vector<SpaceObject*> &despawned);
+
+
+		/**
+		 * \brief Main-loop of the thread: read the requested sector-files (waits while the queue is empty).
+		 */
+		void run() override;
+
+
+		/**
+		 * \brief Get all pooled asteroids (spawned or not).
+		 *
+		 * \return Asteroids of the pool.
+		 */
+		const std::vector<SpaceObject*>& getObjects() const {
+			return _pool.getObjects();
+		}
+
+
+		/**
+		 * \brief Get the root of the pooled asteroids (has to be added once to the scene).
+		 *
+		 * \return Root-node of the asteroids (the free ones are hidden).
+		 */
+		osg::ref_ptr<osg::Group> getRoot() const {
+			return _root;
+		}
+
+
+		/**
+		 * \brief Partition the asteroids of a scene into sector-files (the other objects stay in the scene).
+		 *
+		 * \param scene
+		 *      Scene with the asteroids.
+		 * \param directory
+		 *      Directory of the sector-files.
+		 * \param size
+		 *      Edge-length of a sector.
+		 *
+		 * \return Number of written sectors (-1 => a file can't be written).
+		 */
+		static int writeSectors(const BinaryScene &scene, std::string directory, double size);
+
+
+	private:
+		/**
+		 * \brief Parked state of a body (relative to the heaviest body if there is one).
+		 */
+		struct Body {
+			Eigen::Vector3d position;
+			Eigen::Vector3d linearVelocity;
+			Eigen::Vector3d angularVelocity;
+			osg::Quat orientation;
+			double mass;
+		};
+
+
+		//! Loading state of a sector
+		enum SectorState {
+			//! Never requested
+			UNKNOWN,
+			//! Its file is read by the thread
+			PENDING,
+			//! Its bodies are parked
+			PARKED,
+			//! Its bodies are simulated
+			RESIDENT
+		};
+
+
+		/**
+		 * \brief Sector with its objects (resident) or parked bodies.
+		 */
+		struct Sector {
+			int x = 0, y = 0, z = 0;
+			SectorState state = UNKNOWN;
+			//! Parked bodies (of a resident sector: the bodies which didn't fit into the pool)
+			std::vector<Body> bodies;
+			//! Simulated time of the parked bodies
+			double time = 0.0;
+			//! Spawned asteroids of a resident sector
+			std::vector<SpaceObject*> objects;
+		};
+
+
+		/**
+		 * \brief Sector-file which is read by the thread (or whose bodies wait for the next update).
+		 */
+		struct Request {
+			uint64_t key;
+			int x, y, z;
+			std::vector<Body> bodies;
+		};
+
+
+		//! Directory of the sector-files
+		std::string _directory;
+		//! Edge-length of a sector
+		double _sectorSize = 1000.0;
+		//! Sectors in each direction around the sector of the focus which are loaded
+		int _radius = 1;
+
+		//! All sectors which have been requested
+		std::unordered_map<uint64_t, Sector> _sectors;
+		//! Sector of each spawned asteroid (an asteroid which was despawned by the simulation may be reused)
+		std::unordered_map<SpaceObject*, uint64_t> _owners;
+		//! Keys of the resident sectors
+		std::vector<uint64_t> _resident;
+
+		//! Asteroids which are spawned with the bodies of the sectors
+		BodyPool _pool;
+		osg::ref_ptr<osg::Group> _root;
+		//! Moment of inertia of the pooled asteroids per mass (it's scaled by the mass of the spawned body)
+		Eigen::Matrix3d _inertiaPerMass = Eigen::Matrix3d::Identity();
+
+		//! Center of the orbits (nullptr => the bodies move on straight lines)
+		const SpaceObject* _central = nullptr;
+		//! State of the center at the time zero (the bodies of the files are stored relative to it)
+		Eigen::Vector3d _centralPosition = Eigen::Vector3d::Zero();
+		Eigen::Vector3d _centralVelocity = Eigen::Vector3d::Zero();
+		//! Gravitational constant of the simulation
+		double _G;
+
+		//! Sector-files which wait for the thread
+		std::deque<Request> _queue;
+		//! Read sectors which wait for the next update
+		std::deque<Request> _loaded;
+		//! True until the manager is destroyed
+		bool _isRunning = true;
+		//! True if the thread has been started by the first request
+		bool _isStarted = false;
+		//! Protects _queue, _loaded, _isRunning and _isStarted
+		OpenThreads::Mutex _mutex;
+		//! Signaled if a sector-file has been queued
+		OpenThreads::Condition _notEmpty;
+
+
+		/**
+		 * \brief Get the key of a sector from its integer coordinates (21 bits per axis).
+		 *
+		 * \return Key of the sector.
+		 */
+		static uint64_t getKey(int x, int y, int z);
+
+
+		/**
+		 * \brief Get the file of a sector.
+		 *
+		 * \return Complete path to the binary scene of the sector.
+		 */
+		static std::string getFilePath(const std::string &directory, int x, int y, int z);
+
+
+		/**
+		 * \brief Read the asteroids of a sector-file (a missing file is an empty sector).
+		 *
+		 * \param request
+		 *      Requested sector, its bodies are appended.
+		 */
+		void readSector(Request &request) const;
+
+
+		/**
+		 * \brief Move parked bodies along their orbits around the center.
+		 *
+		 * \param bodies
+		 *      Input- and output-parameter: Parked bodies.
+		 * \param dt
+		 *      Time since the bodies were parked.
+		 */
+		void propagate(std::vector<Body> &bodies, double dt) const;
+
+
+		/**
+		 * \brief Spawn the parked bodies of a sector into the pool (the bodies which don't fit stay parked).
+		 *
+		 * \param key
+		 *      Key of the sector.
+		 * \param sector
+		 *      Parked sector.
+		 * \param time
+		 *      Simulated time.
+		 * \param spawned
+		 *      Output-parameter: The activated asteroids are appended.
+		 */
+		void restore(uint64_t key, Sector &sector, double time, std::vector<SpaceObject*> &spawned);
+
+
+		/**
+		 * \brief Park the asteroids of a resident sector.
+		 *
+		 * \param key
+		 *      Key of the sector.
+		 * \param sector
+		 *      Resident sector.
+		 * \param time
+		 *      Simulated time.
+		 * \param despawned
+		 *      Output-parameter: The parked asteroids are appended.
+		 */
+		void park(uint64_t key, Sector &sector, double time, std::vector<SpaceObject*> &despawned);
+
+
+		//! Copying would delete the pooled asteroids twice
+		SectorManager(SectorManager const&) = delete;
+		SectorManager& operator=(SectorManager const&) = delete;
+	};
+}
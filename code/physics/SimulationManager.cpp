@@ -7,47 +7,1388 @@
 
 #include "SimulationManager.h"
 
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <cmath>
+#include <limits>
+#include <memory>
+
 #include "../scene/SpaceObject.h"
+#include "../scene/SpaceShip.h"
+#include "BodyPool.h"
+#include "FrameArena.h"
 #include "CollisionManager.h"
+#include "DustManager.h"
+#include "FractureManager.h"
+#include "MergeManager.h"
+#include "ClusterManager.h"
+#include "SectorManager.h"
+#include "RewindBuffer.h"
+#include "JobSystem.h"
 #include "NBodyManager.h"
+#include "GravityKernel.h"
+#include "GpuGravity.h"
+#include "Profiler.h"
+#include "TaskGraph.h"
+#include "StatePublisher.h"
+#include "MetricsExporter.h"
+#include "ContactEvents.h"
+#include "TrajectoryRecorder.h"
+#include "../osg/OsgEigenConversions.h"
+#include "../osg/MaterialCache.h"
+#include "../osg/particles/GpuParticleSystem.h"
+#include "Logger.h"
 
 using namespace pbs17;
 
-bool SimulationManager::IS_PAUSED = false;
-double SimulationManager::SIMULATION_DT = 0.01;;
+OpenThreads::Mutex SimulationManager::STATE_MUTEX;
 
 /**
  * \brief Constructor of the simulation-manager.
  * 
  * \param spaceObjects
  *      All space-objects in the scene.
+ * \param settings
+ *      Simulation-settings of the scene (e.g. {"gravitySolver": "barnesHut", "theta": 0.5}).
  */
-SimulationManager::SimulationManager(std::vector<SpaceObject*> spaceObjects)
-	: _spaceObjects(spaceObjects) {
+SimulationManager::SimulationManager(std::vector<SpaceObject*> spaceObjects, json settings)
+	: _sceneObjects(spaceObjects), _spaceObjects(spaceObjects) {
+	_bodies.gather(spaceObjects);
+
+	// the space-ship is steered directly by the keyboard-handler
+	for (unsigned int i = 0; i < spaceObjects.size(); ++i) {
+		if (dynamic_cast<SpaceShip*>(spaceObjects[i]) != nullptr) {
+			_controlledObjects.push_back(spaceObjects[i]);
+		}
+	}
+
     _nManager = new NBodyManager();
 
-	// Todo: So far it is faster to let the simulation run on parallel-for-loop
-	//_nManager->initSpatialGrid(spaceObjects, Eigen::Vector3i(30, 30, 30));
+	NBodyManager::GravitySolver solver = NBodyManager::DIRECT;
+	if (settings["gravitySolver"].is_string()
+		&& !NBodyManager::parseGravitySolver(settings["gravitySolver"].get<std::string>(), solver)) {
+		LOG_WARNING("Gravity-solver (" + settings["gravitySolver"].get<std::string>() + ") not supported!");
+	}
+	if (solver == NBodyManager::GPU && !GpuGravity::isAvailable()) {
+		LOG_WARNING("No GPU available (cmake -DPBS17_CUDA=ON), the direct solver is used.");
+		solver = NBodyManager::DIRECT;
+	}
+	if (solver == NBodyManager::GPU_BARNES_HUT && !GpuGravity::isAvailable()) {
+		LOG_WARNING("No GPU available (cmake -DPBS17_CUDA=ON), the Barnes-Hut tree of the CPU is used.");
+		solver = NBodyManager::BARNES_HUT;
+	}
+
+	if (settings["theta"].is_number()) {
+		_nManager->setTheta(settings["theta"].get<double>());
+	}
+	if (settings["treeRefitThreshold"].is_number()) {
+		_nManager->setTreeRefitThreshold(settings["treeRefitThreshold"].get<double>());
+	}
+
+	if (settings["symmetricForces"].is_boolean()) {
+		_nManager->setUseSymmetricForces(settings["symmetricForces"].get<bool>());
+	}
+	if (settings["mixedPrecision"].is_boolean()) {
+		_nManager->setUseMixedPrecision(settings["mixedPrecision"].get<bool>());
+	}
+	if (settings["groupedWalk"].is_boolean()) {
+		_nManager->setUseGroupedWalk(settings["groupedWalk"].get<bool>());
+	}
+
+	if (settings["taskGraph"].is_boolean()) {
+		_nManager->setUseTaskGraph(settings["taskGraph"].get<bool>());
+	}
+	if (settings["fusedKick"].is_boolean()) {
+		_nManager->setUseFusedKick(settings["fusedKick"].get<bool>());
+	}
+
+	NBodyManager::Integrator integrator = NBodyManager::SEMI_IMPLICIT_EULER;
+	if (settings["integrator"].is_string()
+		&& !NBodyManager::parseIntegrator(settings["integrator"].get<std::string>(), integrator)) {
+		LOG_WARNING("Integrator (" + settings["integrator"].get<std::string>() + ") not supported!");
+	}
+	_nManager->setIntegrator(integrator);
+
+	if (settings["blockTimesteps"].is_boolean()) {
+		_nManager->setUseBlockTimesteps(settings["blockTimesteps"].get<bool>());
+	}
+
+	if (settings["maxTimestepLevel"].is_number_integer()) {
+		_nManager->setMaxTimestepLevel(settings["maxTimestepLevel"].get<int>());
+	}
+
+	if (settings["timestepAccuracy"].is_number()) {
+		_nManager->setTimestepAccuracy(settings["timestepAccuracy"].get<double>());
+	}
+
+	if (settings["forceReuseInterval"].is_number_integer()) {
+		_nManager->setForceReuseInterval(settings["forceReuseInterval"].get<int>());
+	}
+
+	if (settings["nearFieldRadius"].is_number()) {
+		_nManager->setNearFieldRadius(settings["nearFieldRadius"].get<double>());
+	}
+
+	if (settings["binaryRadius"].is_number()) {
+		_nManager->setBinaryRadius(settings["binaryRadius"].get<double>());
+	}
+
+	if (settings["sleeping"].is_boolean()) {
+		_nManager->setUseSleeping(settings["sleeping"].get<bool>());
+	}
+
+	if (settings["sleepVelocity"].is_number()) {
+		_nManager->setSleepVelocity(settings["sleepVelocity"].get<double>());
+	}
+
+	if (settings["gridThreshold"].is_number()) {
+		_nManager->getSpatialGrid().setThreshold(settings["gridThreshold"].get<double>());
+	}
+
+	if (settings["cutoffRadius"].is_number()) {
+		_nManager->getSpatialGrid().setCutoffRadius(settings["cutoffRadius"].get<double>());
+	}
+
+	if (settings["gridResolution"].is_number_integer()) {
+		_nManager->getSpatialGrid().setMaxResolution(settings["gridResolution"].get<int>());
+	}
+
+	if (settings["testParticles"].is_boolean()) {
+		_nManager->getSpatialGrid().setUseTestParticles(settings["testParticles"].get<bool>());
+	}
+
+	if (settings["sourceTable"].is_boolean()) {
+		_nManager->getSpatialGrid().getSourceTable().setIsEnabled(settings["sourceTable"].get<bool>());
+	}
+
+	if (settings["sourceTableResolution"].is_number_integer()) {
+		_nManager->getSpatialGrid().getSourceTable().setResolution(settings["sourceTableResolution"].get<int>());
+	}
+
+	if (settings["sourceTableLevels"].is_number_integer()) {
+		_nManager->getSpatialGrid().getSourceTable().setNumLevels(settings["sourceTableLevels"].get<int>());
+	}
+
+	if (settings["sourceTableTolerance"].is_number()) {
+		_nManager->getSpatialGrid().getSourceTable().setTolerance(settings["sourceTableTolerance"].get<double>());
+	}
+
+	if (settings["meshResolution"].is_number_integer()) {
+		_nManager->getParticleMesh().setResolution(settings["meshResolution"].get<int>());
+	}
+
+	if (settings["p3m"].is_boolean()) {
+		_nManager->getParticleMesh().setUseP3M(settings["p3m"].get<bool>());
+	}
+
+	if (settings["fmmLeafSize"].is_number_integer()) {
+		_nManager->getFastMultipole().setLeafSize(settings["fmmLeafSize"].get<int>());
+	}
+
+	LOG_INFO("Gravity-kernel uses " << GravityKernel::getInstructionSet());
+
+	_nManager->setGravitySolver(solver);
+
     _cManager = new CollisionManager(spaceObjects);
+
+	if (settings["hashCellSize"].is_number()) {
+		_cManager->getSpatialHash().setCellSize(settings["hashCellSize"].get<double>());
+	}
+
+	if (settings["fatMargin"].is_number()) {
+		_cManager->getAabbTree().setFatMargin(settings["fatMargin"].get<double>());
+	}
+
+	if (settings["solverIterations"].is_number_integer()) {
+		_cManager->setSolverIterations(settings["solverIterations"].get<int>());
+	}
+
+	if (settings["batchedSolver"].is_boolean()) {
+		_cManager->setIsBatchedSolver(settings["batchedSolver"].get<bool>());
+	}
+
+	if (settings["speculativeContacts"].is_boolean()) {
+		_cManager->setIsSpeculative(settings["speculativeContacts"].get<bool>());
+	}
+
+	if (settings["restitution"].is_number()) {
+		_cManager->setRestitution(settings["restitution"].get<double>());
+	}
+
+	if (settings["friction"].is_number()) {
+		_cManager->setFriction(settings["friction"].get<double>());
+	}
+
+	if (settings["reorderInterval"].is_number_integer()) {
+		setReorderInterval(std::max(settings["reorderInterval"].get<int>(), 0));
+	}
+
+	if (settings["pipeline"].is_boolean()) {
+		setUsePipeline(settings["pipeline"].get<bool>());
+	}
+
+	if (settings["rewindInterval"].is_number_integer() && settings["rewindInterval"].get<int>() > 0) {
+		unsigned int capacity = 32;
+		if (settings["rewindKeyframes"].is_number_integer()) {
+			capacity = static_cast<unsigned int>(std::max(settings["rewindKeyframes"].get<int>(), 1));
+		}
+		_rewindBuffer = new RewindBuffer(settings["rewindInterval"].get<int>(), capacity);
+	}
+
+	if (settings["diagnosticsInterval"].is_number_integer()) {
+		_diagnostics.setInterval(std::max(settings["diagnosticsInterval"].get<int>(), 0));
+	}
+
+	if (settings["dt"].is_number()) {
+		setSimulationDt(settings["dt"].get<double>());
+	}
+
+	// bitwise reproducible with any number of threads (e.g. for regression-tests)
+	if (settings["deterministic"].is_boolean()) {
+		_nManager->setIsDeterministic(settings["deterministic"].get<bool>());
+		_cManager->setIsDeterministic(settings["deterministic"].get<bool>());
+	}
+
+	CollisionManager::BroadPhase broadPhase = CollisionManager::INCREMENTAL_SAP;
+	if (settings["broadPhase"].is_string()
+		&& !CollisionManager::parseBroadPhase(settings["broadPhase"].get<std::string>(), broadPhase)) {
+		LOG_WARNING("Broad-phase (" + settings["broadPhase"].get<std::string>() + ") not supported!");
+	}
+
+	if (broadPhase != _cManager->getBroadPhase()) {
+		_cManager->setBroadPhase(broadPhase);
+	}
+
+	// gravity-only scenes skip the broad-phase completely
+	if (settings["collisions"].is_boolean()) {
+		_cManager->setIsEnabled(settings["collisions"].get<bool>());
+	}
+
+	// both grids bin by the position, so the collision-detection can use the cells of the gravity-grid
+	if (broadPhase == CollisionManager::SPATIAL_HASH && solver == NBodyManager::SPATIAL_GRID) {
+		_cManager->setSharedGrid(&_nManager->getSpatialGrid());
+	}
+
+	// the asteroids of the sectors are spawned into a pool, which is created with the scene (so they can break as well)
+	if (settings["sectors"].is_object()) {
+		_sectorManager = new SectorManager(settings["sectors"], spaceObjects, _nManager->getGravitationalConstant());
+
+		const std::vector<SpaceObject*> &asteroids = _sectorManager->getObjects();
+		_sceneObjects.insert(_sceneObjects.end(), asteroids.begin(), asteroids.end());
+		_spaceObjects.reserve(_sceneObjects.size());
+		_bodies.reserve(_sceneObjects.size());
+	}
+
+	// the models are pre-fractured now, the fragments wait in the pools until their asteroids break
+	if (settings["fracture"].is_boolean() && settings["fracture"].get<bool>()) {
+		int cntPieces = settings["fracturePieces"].is_number_integer() ? settings["fracturePieces"].get<int>() : 8;
+		int cntSlots = settings["fracturePool"].is_number_integer() ? settings["fracturePool"].get<int>() : 4;
+		_fManager = new FractureManager(_sceneObjects, cntPieces, cntSlots);
+
+		if (settings["fractureVelocity"].is_number()) {
+			_fManager->setFractureVelocity(settings["fractureVelocity"].get<double>());
+		}
+
+		const std::vector<SpaceObject*> &fragments = _fManager->getFragments();
+		_sceneObjects.insert(_sceneObjects.end(), fragments.begin(), fragments.end());
+
+		// all pooled bodies fit into the arrays, so spawning them does not reallocate
+		_spaceObjects.reserve(_sceneObjects.size());
+		_bodies.reserve(_sceneObjects.size());
+	}
+
+	if (settings["lodRadius"].is_number()) {
+		_lodRadius = settings["lodRadius"].get<double>();
+	}
+
+	// small debris collides with the coarse level of its convex-hull
+	if (settings["coarseContactRadius"].is_number()) {
+		CollisionManager::setCoarseContactRadius(settings["coarseContactRadius"].get<double>());
+	}
+
+	if (settings["adaptiveDt"].is_boolean()) {
+		double minDt = settings["minDt"].is_number() ? settings["minDt"].get<double>() : 1e-4;
+		double accuracy = settings["dtAccuracy"].is_number() ? settings["dtAccuracy"].get<double>() : 0.2;
+		setAdaptiveDt(settings["adaptiveDt"].get<bool>(), minDt, accuracy);
+	}
+
+	if (settings["railsRadius"].is_number()) {
+		_railsRadius = settings["railsRadius"].get<double>();
+	}
+
+	if (settings["collisionSubsteps"].is_number_integer()) {
+		_collisionSubsteps = std::max(settings["collisionSubsteps"].get<int>(), 1);
+	}
+
+	if (settings["particleVelocity"].is_number()) {
+		_particleVelocity = settings["particleVelocity"].get<double>();
+	}
+
+	if (settings["merge"].is_boolean() && settings["merge"].get<bool>()) {
+		_mManager = new MergeManager();
+
+		if (settings["mergeVelocity"].is_number()) {
+			_mManager->setMergeVelocity(settings["mergeVelocity"].get<double>());
+		}
+	}
+
+	if (settings["clusters"].is_boolean() && settings["clusters"].get<bool>()) {
+		_clManager = new ClusterManager();
+
+		if (settings["clusterVelocity"].is_number()) {
+			_clManager->setRestingVelocity(settings["clusterVelocity"].get<double>());
+		}
+		if (settings["clusterSplitVelocity"].is_number()) {
+			_clManager->setSplitVelocity(settings["clusterSplitVelocity"].get<double>());
+		}
+	}
+
+	// the dust is generated from its settings, it's neither part of the scene nor of the checkpoints
+	if (settings["dust"].is_object()) {
+		_dManager = new DustManager(settings["dust"], _bodies);
+		LOG_INFO("Generated " << _dManager->size() << " dust-particles");
+	}
+}
+
+
+/**
+ * \brief Destructor of the simulation-manager (the space-objects are owned by the scene-manager).
+ */
+SimulationManager::~SimulationManager() {
+	// the callbacks of the jobs may use the managers
+	JobSystem::Instance()->finish();
+
+	delete _cManager;
+	delete _nManager;
+	delete _fManager;
+	delete _mManager;
+	delete _clManager;
+	delete _dManager;
+	delete _sectorManager;
+	delete _rewindBuffer;
 }
 
 
 /**
- * \brief Simulate the scene.
+ * \brief Simulate the scene and update the OSG-nodes (single-threaded).
  *
  * \param dt
  *      Time difference since between the last frames.
  */
 void SimulationManager::simulate(double dt) {
-	if (IS_PAUSED) {
+	if (_isPaused) {
+		return;
+	}
+
+	step(dt);
+	syncScene();
+}
+
+
+/**
+ * \brief Simulate as many steps as the elapsed wall-clock needs at a fixed rate (used by the main-loop), so the
+ *        simulated time does not depend on the frame-rate. The next syncs interpolate between the states
+ *        before and after the last step by the remaining time.
+ *
+ * \param seconds
+ *      Wall-clock since the last call.
+ * \param period
+ *      Wall-clock per step (1 / steps per second).
+ * \param maxSteps
+ *      Maximum number of steps per call (the remaining time is dropped if the simulation is too slow).
+ *
+ * \return Number of simulated steps.
+ */
+int SimulationManager::advance(double seconds, double period, int maxSteps) {
+	_period = std::max(period, 1e-6);
+	_accumulator += std::max(seconds, 0.0);
+
+	int cntSteps = std::min(static_cast<int>(_accumulator / _period), std::max(maxSteps, 1));
+	_accumulator -= cntSteps * _period;
+
+	// no spiral of death: a slow simulation gets slower instead of stepping more and more per frame
+	_accumulator = std::min(_accumulator, _period);
+
+	for (int k = 0; k < cntSteps; ++k) {
+		// only the last step is interpolated
+		if (k + 1 == cntSteps) {
+			_previousStates.resize(_sceneObjects.size());
+			for (unsigned int i = 0; i < _sceneObjects.size(); ++i) {
+				_previousStates[i].position = _sceneObjects[i]->getPosition();
+				_previousStates[i].orientation = _sceneObjects[i]->getOrientation();
+				_previousStates[i].isActive = _sceneObjects[i]->isActive();
+			}
+		}
+
+		step(_dt);
+	}
+
+	return cntSteps;
+}
+
+
+/**
+ * \brief Simulate as many steps as fit a wall-clock budget (fast-forward mode of the main-loop). The next step
+ *        is only started if it is expected to finish within the budget, the next syncs show the newest state
+ *        without interpolation.
+ *
+ * \param budget
+ *      Wall-clock in seconds for all steps (at least one step is simulated).
+ *
+ * \return Number of simulated steps.
+ */
+int SimulationManager::fastForward(double budget) {
+	const osg::Timer* timer = osg::Timer::instance();
+	osg::Timer_t start = timer->tick();
+	int cntSteps = 0;
+	double elapsed = 0.0;
+
+	// the duration of the next step is estimated by the mean of the previous ones
+	do {
+		step(_dt);
+		++cntSteps;
+		elapsed = timer->delta_s(start, timer->tick());
+	} while (!_isPaused && elapsed + elapsed / cntSteps <= budget);
+
+	_previousStates.clear();
+	_accumulator = 0.0;
+
+	return cntSteps;
+}
+
+
+/**
+ * \brief Write the changed objects to the OSG-nodes (called by the update-traversal, see SceneSyncCallback).
+ *        After advance(), the moved objects are interpolated between their last two states.
+ */
+void SimulationManager::syncScene() {
+	// the nodes share their parents, so updating them is not parallelized (the broken objects hide their nodes)
+	Profiler::ScopedTimer timer(Profiler::SCENE_SYNC);
+
+	bool isInterpolated = _previousStates.size() == _sceneObjects.size() && _accumulator < _period;
+	double alpha = isInterpolated ? _accumulator / _period : 1.0;
+
+	// the objects with a visual spin are rotated by the shader to the time of the interpolated state
+	MaterialCache::Instance()->setSpinTime(isInterpolated ? _time - (1.0 - alpha) * _period : _time);
+
+	for (unsigned int i = 0; i < _sceneObjects.size(); ++i) {
+		SpaceObject* object = _sceneObjects[i];
+
+		// a fragment which was just activated starts at its position (it was parked in the pool before)
+		if (isInterpolated && object->isActive() && _previousStates[i].isActive && object->getPosition() != _previousStates[i].position) {
+			const RenderState &previous = _previousStates[i];
+			Eigen::Vector3d position = previous.position + alpha * (object->getPosition() - previous.position);
+			osg::Quat orientation;
+			orientation.slerp(alpha, previous.orientation, object->getOrientation());
+
+			object->applyTransformation(toOsg(position), orientation, object->getAABB(), object->getCollisionState());
+			continue;
+		}
+
+		// unchanged objects (e.g. sleeping ones) do not dirty the bounds of the scene-graph
+		if (object->isTransformationDirty()) {
+			object->updateTransformation();
+		}
+	}
+}
+
+
+/**
+ * \brief Add a pooled object to the simulation (e.g. a fragment or a projectile), it's appended to the bodies
+ *        and sorted into the broad-phase and the grid without rebuilding them. Has to be called by the thread
+ *        of the simulation between two steps.
+ *
+ * \param object
+ *      Object which has been activated with its state (see BodyPool::acquire()).
+ */
+void SimulationManager::spawn(SpaceObject* object) {
+	if (_bodies.getIndex(object->getId()) >= 0) {
+		return;
+	}
+
+	object->setActive(true);
+	_spaceObjects.push_back(object);
+	_bodies.add(object);
+	_nManager->addBody(_bodies);
+	_cManager->addSpaceObject(object);
+	_hasSpawned = true;
+
+	// the keyframes have a different number of bodies
+	if (_rewindBuffer) {
+		_rewindBuffer->clear();
+	}
+}
+
+
+/**
+ * \brief Remove an object from the simulation, the last body is moved to its index (in all managers). A pooled
+ *        object returns to its pool. Has to be called by the thread of the simulation between two steps.
+ *
+ * \param object
+ *      Simulated object (deactivated, its OSG-nodes are hidden by the next sync-pass).
+ */
+void SimulationManager::despawn(SpaceObject* object) {
+	int i = _bodies.getIndex(object->getId());
+	if (i < 0) {
+		return;
+	}
+
+	BodyState::removeFromArray(_spaceObjects, i);
+	_bodies.remove(i);
+	_nManager->removeBody(i, _bodies);
+	_cManager->removeSpaceObject(i);
+	_controlledObjects.erase(std::remove(_controlledObjects.begin(), _controlledObjects.end(), object), _controlledObjects.end());
+
+	// the other members of its cluster move on their own again
+	if (_clManager) {
+		_clManager->remove(object);
+	}
+
+	if (object->getPool()) {
+		object->getPool()->release(object);
+	} else {
+		object->setActive(false);
+	}
+
+	_hasSpawned = true;
+
+	// the keyframes have a different number of bodies
+	if (_rewindBuffer) {
+		_rewindBuffer->clear();
+	}
+}
+
+
+/**
+ * \brief Queue a change of the scene, the changes are applied in their order before the next step (also if
+ *        the simulation is paused). Can be called by any thread.
+ *
+ * \param change
+ *      Added, removed or modified object.
+ */
+void SimulationManager::queueSceneChange(const SceneChange &change) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_sceneChangeMutex);
+	_sceneChanges.push_back(change);
+}
+
+
+/**
+ * \brief Update the held controls by the queued input and steer the player with them.
+ *
+ * \param dt
+ *      Time-step of the steering.
+ */
+void SimulationManager::applyInput(double dt) {
+	InputCommand command;
+	while (_inputQueue.pop(command)) {
+		_heldControls[command.control] = command.isHeld;
+	}
+
+	SpaceShip* player = _controlledObjects.empty() ? nullptr : dynamic_cast<SpaceShip*>(_controlledObjects[0]);
+	if (!player) {
+		return;
+	}
+
+	int pitch = static_cast<int>(_heldControls[TURN_UP]) - static_cast<int>(_heldControls[TURN_DOWN]);
+	int yaw = static_cast<int>(_heldControls[TURN_LEFT]) - static_cast<int>(_heldControls[TURN_RIGHT]);
+	int throttle = static_cast<int>(_heldControls[ACCELERATE]) - static_cast<int>(_heldControls[DECELERATE]);
+
+	if (pitch != 0 || yaw != 0 || throttle != 0) {
+		player->steer(pitch, yaw, throttle, dt);
+	}
+}
+
+
+/**
+ * \brief Apply the queued changes of the scene (see queueSceneChange()).
+ */
+void SimulationManager::applySceneChanges() {
+	std::vector<SceneChange> changes;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_sceneChangeMutex);
+		changes.swap(_sceneChanges);
+	}
+
+	for (unsigned int i = 0; i < changes.size(); ++i) {
+		SpaceObject* object = changes[i].object;
+
+		if (changes[i].type == SceneChange::ADD) {
+			_sceneObjects.push_back(object);
+			spawn(object);
+		} else if (changes[i].type == SceneChange::REMOVE) {
+			despawn(object);
+		} else {
+			// e.g. a broken object is not simulated anymore
+			int index = _bodies.getIndex(object->getId());
+			if (index < 0) continue;
+
+			if (object->getMass() > 0.0 && changes[i].mass > 0.0) {
+				object->setMomentOfInertia((changes[i].mass / object->getMass()) * object->getMomentOfInertia());
+			}
+			object->setMass(changes[i].mass);
+			object->setLinearVelocity(changes[i].linearVelocity);
+			object->setAngularVelocity(changes[i].angularVelocity);
+			object->setPositionOrientation(changes[i].position, object->getOrientation());
+			object->setSleeping(false);
+
+			_bodies.gather(object);
+			_nManager->changeBody(index);
+			_hasSpawned = true;
+		}
+	}
+}
+
+
+/**
+ * \brief Simulate one step of the scene without touching the OSG-nodes (used by the physics-thread and the main-loop).
+ *
+ * \param dt
+ *      Time difference since between the last frames.
+ */
+void SimulationManager::step(double dt) {
+	// the edited scene is shown without simulating it
+	applySceneChanges();
+
+	// a rewind calls step() again for the re-simulated steps
+	if (_rewindRequest > 0) {
+		unsigned long cntSteps = _rewindRequest;
+		_rewindRequest = 0;
+		rewind(cntSteps);
+	}
+
+	// the finished jobs hand their results back between two steps (also while the scene is paused)
+	JobSystem::Instance()->update();
+
+	if (_isPaused) {
 		return;
 	}
 
-    // simulate on step
-    _nManager->simulateStep(dt, this->_spaceObjects);
+	// the transient buffers of the step are allocated from the arenas, which are reset at its end
+	FrameArena::Frame frame;
+
+	if (_isAdaptiveDt) {
+		dt = selectTimeStep(dt);
+	}
+	_stepDt = dt;
+	Profiler::Instance()->count(Profiler::STEP_DT, dt);
 
-    // check for collisions
-    _cManager->handleCollisions(dt, this->_spaceObjects);
+	// the sectors follow the player (or the camera without a player), the solvers only see the added and removed bodies
+	if (_sectorManager) {
+		Eigen::Vector3d focus;
+		if (_controlledObjects.empty()) {
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_focusMutex);
+			focus = _focus;
+		} else {
+			focus = _controlledObjects[0]->getPosition();
+		}
+
+		std::vector<SpaceObject*> spawned;
+		std::vector<SpaceObject*> despawned;
+		_sectorManager->update(focus, _time, spawned, despawned);
+
+		for (unsigned int i = 0; i < despawned.size(); ++i) {
+			despawn(despawned[i]);
+		}
+		for (unsigned int i = 0; i < spawned.size(); ++i) {
+			spawn(spawned[i]);
+		}
+	}
+
+	// the bodies are sorted again after restoring the order of the scene (e.g. for a checkpoint)
+	if (_reorderInterval > 0 && (_cntSteps % _reorderInterval == 0 || !_bodies.isReordered())) {
+		std::vector<int> order;
+		BodyState::sortMorton(_bodies.x.data(), _bodies.y.data(), _bodies.z.data(), _bodies.size(), order);
+		reorderBodies(order);
+	}
+
+	if (_lodRadius > 0.0) {
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_focusMutex);
+		_cManager->setLevelOfDetail(_focus, _lodRadius);
+	}
+
+	// the held controls are sampled once per step, so the steering does not depend on the frame-rate
+	applyInput(dt);
+
+	for (unsigned int i = 0; i < _controlledObjects.size(); ++i) {
+		_bodies.gather(_controlledObjects[i]);
+	}
+
+	// the inner zone follows the player (or the camera without a player)
+	if (_railsRadius > 0.0) {
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_focusMutex);
+		_nManager->setRails(_controlledObjects.empty() ? _focus : _controlledObjects[0]->getPosition(), _railsRadius);
+	}
+
+	// the contacts are resolved with a smaller time-step than the forces are evaluated
+	int cntSubsteps = std::max(_collisionSubsteps, 1);
+	double h = dt / cntSubsteps;
+	_stepContacts.clear();
+
+	for (int s = 0; s < cntSubsteps; ++s) {
+		// simulate on step (the forces are measured separately), the substeps reuse its forces
+		{
+			Profiler::ScopedTimer timer(Profiler::INTEGRATION);
+			if (s == 0) {
+				_nManager->simulateStep(h, _bodies);
+			} else {
+				_nManager->simulateSubstep(h, _bodies);
+			}
+		}
+
+		// sync the new state to the space-objects (this updates their AABBs)
+		if (_usePipeline) {
+			Profiler::ScopedTimer timer(Profiler::AABB_UPDATE);
+			TaskGraph graph;
+
+			// each chunk is prepared for the broad-phase as soon as its AABBs are updated, the grid only reads the bodies
+			int n = std::min(static_cast<unsigned int>(_spaceObjects.size()), _bodies.size());
+			std::vector<int> scatterChunks = graph.addChunks(0, n, PIPELINE_GRAIN_SIZE, [this](int first, int last) {
+				_bodies.scatter(_spaceObjects, first, last);
+			});
+
+			for (unsigned int c = 0; c < scatterChunks.size() && _cManager->getIsEnabled(); ++c) {
+				int first = c * PIPELINE_GRAIN_SIZE;
+				int last = std::min(first + PIPELINE_GRAIN_SIZE, n);
+
+				graph.addTask([this, h, first, last]() {
+					_cManager->prepareObjects(h, _spaceObjects, first, last);
+				}, std::vector<int>(1, scatterChunks[c]));
+			}
+
+			if (_cManager->getSharedGrid() != nullptr) {
+				graph.addTask([this]() { _nManager->updateSpatialGrid(_bodies); });
+			}
+
+			graph.run();
+		} else {
+			Profiler::ScopedTimer timer(Profiler::AABB_UPDATE);
+			_bodies.scatter(_spaceObjects);
+
+			// the shared grid has to be binned with the positions after the step
+			if (_cManager->getSharedGrid() != nullptr) {
+				_nManager->updateSpatialGrid(_bodies);
+			}
+		}
+
+		// check for collisions
+		_cManager->handleCollisions(h, this->_spaceObjects, _bodies, _usePipeline);
+
+		// the fracture and the merges see the contacts of all substeps
+		if (cntSubsteps > 1) {
+			_stepContacts.insert(_stepContacts.end(), _cManager->getContacts().begin(), _cManager->getContacts().end());
+		}
+	}
+
+	// the members of the clusters were integrated separately, they are moved rigidly with their combined momentum
+	if (_clManager) {
+		Profiler::ScopedTimer timer(Profiler::INTEGRATION);
+		std::vector<SpaceObject*> moved;
+		_clManager->update(getStepContacts(), moved);
+
+		for (unsigned int i = 0; i < moved.size(); ++i) {
+			_bodies.gather(moved[i]);
+		}
+	}
+
+	// the dust only feels the bodies (after the collisions, so it sees the resolved positions)
+	if (_dManager) {
+		Profiler::ScopedTimer timer(Profiler::INTEGRATION);
+		_dManager->step(dt, _bodies);
+	}
+
+	++_cntSteps;
+	_time += dt;
+
+	// the recorder only copies the state, it's written by its own thread
+	if (_recorder) {
+		_recorder->record(_cntSteps, _time, _bodies, getStepContacts());
+	}
+
+	// the conserved quantities are only measured every few steps, the last ones are counted in every frame
+	if (_diagnostics.isDue(_cntSteps)) {
+		_diagnostics.measure(_cntSteps, _time, _bodies, *_nManager);
+	}
+	if (_diagnostics.isEnabled()) {
+		const Diagnostics::Sample &sample = _diagnostics.getLast();
+		Profiler* profiler = Profiler::Instance();
+		profiler->count(Profiler::TOTAL_ENERGY, sample.totalEnergy);
+		profiler->count(Profiler::ENERGY_DRIFT, sample.energyDrift);
+		profiler->count(Profiler::MOMENTUM_DRIFT, sample.momentumDrift);
+		profiler->count(Profiler::ANGULAR_MOMENTUM_DRIFT, sample.angularMomentumDrift);
+	}
+
+	// the publisher only copies the quantized state, it's sent by its own thread
+	if (_publisher) {
+		_publisher->publish(_cntSteps, _time, _sceneObjects);
+	}
+	if (_metrics) {
+		_metrics->publish(_cntSteps, static_cast<unsigned int>(_sceneObjects.size()));
+	}
+	if (ContactEvents::getIsEnabled()) {
+		ContactEvents::Instance()->publish(_cntSteps, _time, getStepContacts());
+	}
+
+	// the checkpoint is written between two steps, so it's consistent
+	if (_checkpointPath != "") {
+		const osg::Timer* timer = osg::Timer::instance();
+		bool isDue = _checkpointInterval > 0.0 && timer->delta_s(_lastCheckpoint, timer->tick()) >= _checkpointInterval;
+
+		if (_isCheckpointRequested || isDue) {
+			_isCheckpointRequested = false;
+			saveCheckpoint(_checkpointPath);
+			_lastCheckpoint = timer->tick();
+		}
+	}
+
+	// the slow contacts merge before the fast ones break
+	std::vector<SpaceObject*> survivors;
+	std::vector<SpaceObject*> absorbed;
+	if (_mManager && _mManager->merge(getStepContacts(), survivors, absorbed)) {
+		for (unsigned int i = 0; i < absorbed.size(); ++i) {
+			despawn(absorbed[i]);
+		}
+
+		// a survivor can be absorbed by a heavier object later in the same step
+		for (unsigned int i = 0; i < survivors.size(); ++i) {
+			int index = _bodies.getIndex(survivors[i]->getId());
+			if (index < 0 || !survivors[i]->isActive()) continue;
+
+			_bodies.gather(survivors[i]);
+			_nManager->changeBody(index);
+		}
+	}
+
+	// the asteroids which are hit too hard are replaced by their pooled fragments
+	std::vector<SpaceObject*> broken;
+	std::vector<SpaceObject*> fragments;
+	if (_fManager && _fManager->fracture(getStepContacts(), broken, fragments)) {
+		for (unsigned int i = 0; i < broken.size(); ++i) {
+			despawn(broken[i]);
+		}
+		for (unsigned int i = 0; i < fragments.size(); ++i) {
+			spawn(fragments[i]);
+		}
+	}
+
+	// the keyframes have the order of the scene, the next step sorts the bodies again
+	if (_rewindBuffer && _cntSteps % _rewindBuffer->getInterval() == 0) {
+		if (_bodies.isReordered()) {
+			reorderBodies(_bodies.getLoadOrder());
+		}
+
+		std::shared_ptr<BinaryScene::State> state = std::make_shared<BinaryScene::State>();
+		saveState(*state);
+
+		// only the copy is part of the step, the keyframe is compressed within the budget of the jobs
+		RewindBuffer* rewindBuffer = _rewindBuffer;
+		unsigned int generation = rewindBuffer->getGeneration();
+		unsigned long step = _cntSteps;
+		double time = _time;
+		double simulationDt = _dt;
+		JobSystem::Instance()->submitSliced([rewindBuffer, generation, step, time, simulationDt, state]() {
+			// the bodies changed or the simulation has been rewound meanwhile
+			if (rewindBuffer->getGeneration() == generation) {
+				rewindBuffer->push(step, time, simulationDt, *state);
+			}
+			return true;
+		});
+	}
+
+	// the bursts are queued, they are spawned by the next update-traversal
+	// the bursts of the fast-forward would flood the particles of all skipped frames
+	if (GpuParticleSystem::getIsEnabled() && !SpaceObject::getIsHeadless() && !_isFastForward) {
+		emitParticles(broken);
+	}
+}
+
+
+/**
+ * \brief Move the region of interest of the collision-detection (e.g. with the camera), the objects outside of
+ *        it collide as spheres (see CollisionManager::setLevelOfDetail()). Can be called by any thread, it's
+ *        used from the next step on.
+ *
+ * \param center
+ *      Center of the region (its radius is set by the scene: "lodRadius"). Without a player, it's also
+ *      the center of the integrated zone ("railsRadius", see NBodyManager::setRails()).
+ */
+void SimulationManager::setFocus(const Eigen::Vector3d &center) {
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_focusMutex);
+	_focus = center;
+}
+
+
+/**
+ * \brief Set the opening angle of the Barnes-Hut and the fast multipole solver (between two steps).
+ *
+ * \param theta
+ *      Opening angle (smaller => more exact, larger => faster).
+ */
+void SimulationManager::setTheta(const double theta) {
+	_nManager->setTheta(theta);
+}
+
+
+/**
+ * \brief Get the opening angle of the Barnes-Hut and the fast multipole solver.
+ *
+ * \return Opening angle (0 => the gravity-solver does not use it).
+ */
+double SimulationManager::getTheta() const {
+	NBodyManager::GravitySolver solver = _nManager->getGravitySolver();
+	if (solver != NBodyManager::BARNES_HUT && solver != NBodyManager::FAST_MULTIPOLE && solver != NBodyManager::GPU_BARNES_HUT) {
+		return 0.0;
+	}
+
+	return _nManager->getTheta();
+}
+
+
+/**
+ * \brief Get the contacts of the last step (of all its collision-substeps).
+ *
+ * \return Contacts which were resolved during the last step.
+ */
+const std::vector<Collision>& SimulationManager::getStepContacts() const {
+	return _collisionSubsteps > 1 ? _stepContacts : _cManager->getContacts();
+}
+
+
+/**
+ * \brief Emit the particles of the events of the last step into the GpuParticleSystem: dust at the hard
+ *        contacts and debris at the broken objects.
+ *
+ * \param broken
+ *      Objects which broke during the last step.
+ */
+void SimulationManager::emitParticles(const std::vector<SpaceObject*> &broken) const {
+	GpuParticleSystem* particles = GpuParticleSystem::Instance();
+	const std::vector<Collision> &contacts = getStepContacts();
+	unsigned int cntBursts = 0;
+
+	// the dust is raised by the change of the velocity of the lighter object, like the fracture
+	for (unsigned int i = 0; i < contacts.size() && cntBursts < MAX_DUST_BURSTS; ++i) {
+		const Collision &contact = contacts[i];
+		SpaceObject* first = contact.getFirstObject();
+		SpaceObject* second = contact.getSecondObject();
+		double mass = std::min(first->getMass(), second->getMass());
+		double velocity = mass > 0.0 ? contact.getImpulse() / mass : 0.0;
+		if (velocity < _particleVelocity) continue;
+
+		GpuParticleSystem::Emission dust;
+		dust.position = toOsg(0.5 * (contact.getFirstPOC() + contact.getSecondPOC()));
+		dust.velocity = toOsg((first->getMass() * first->getLinearVelocity() + second->getMass() * second->getLinearVelocity())
+			/ (first->getMass() + second->getMass()));
+		dust.direction = toOsg(contact.getUnitNormal());
+		dust.speed = 0.25f * velocity;
+		dust.spread = osg::PI;
+		dust.lifetime = 3.0f;
+		dust.size = 0.1f * std::min(first->getCoarseRadius(), second->getCoarseRadius());
+		dust.color = osg::Vec3(0.6f, 0.55f, 0.5f);
+		particles->emit(dust, std::min(8 + static_cast<int>(4.0 * velocity / _particleVelocity), 64));
+		++cntBursts;
+	}
+
+	// the debris flies apart with the object, the pieces are hidden in the cloud
+	for (unsigned int i = 0; i < broken.size(); ++i) {
+		double radius = broken[i]->getCoarseRadius();
+
+		GpuParticleSystem::Emission debris;
+		debris.position = toOsg(broken[i]->getPosition());
+		debris.velocity = toOsg(broken[i]->getLinearVelocity());
+		debris.speed = static_cast<float>(radius);
+		debris.spread = osg::PI;
+		debris.lifetime = 5.0f;
+		debris.size = 0.2f * radius;
+		debris.color = osg::Vec3(1.0f, 0.6f, 0.3f);
+		particles->emit(debris, 96);
+	}
+}
+
+
+/**
+ * \brief Select the time-step of the next step from the accelerations of the last force-evaluation and
+ *        the approaching pairs of the last narrow-phase (see setAdaptiveDt()).
+ *
+ * \param maxDt
+ *      Upper bound of the time-step.
+ *
+ * \return Time-step between the minimum and maxDt, at most twice the last one.
+ */
+double SimulationManager::selectTimeStep(double maxDt) const {
+	double dt = maxDt;
+
+	// a body moves about dt^2 * |a| by its acceleration, which should stay a fraction of its size
+	const std::vector<Eigen::Vector3d> &forces = _nManager->getForces();
+	if (forces.size() == _bodies.size()) {
+		double minRatio = std::numeric_limits<double>::infinity();
+		int n = _bodies.size();
+
+		for (int i = 0; i < n; ++i) {
+			if (_bodies.sleeping[i] || _bodies.m[i] <= 0.0) continue;
+
+			double acceleration = forces[i].norm() / _bodies.m[i];
+			if (acceleration > 0.0) {
+				minRatio = std::min(minRatio, _spaceObjects[i]->getCoarseRadius() / acceleration);
+			}
+		}
+
+		if (minRatio < std::numeric_limits<double>::infinity()) {
+			dt = std::min(dt, _dtAccuracy * std::sqrt(minRatio));
+		}
+	}
+
+	// the closest approaching pair would penetrate too deep within the step
+	double approachTime = _cManager->getMinApproachTime();
+	if (approachTime < std::numeric_limits<double>::infinity()) {
+		dt = std::min(dt, approachTime);
+	}
+
+	// grows smoothly after an encounter
+	if (_stepDt > 0.0) {
+		dt = std::min(dt, 2.0 * _stepDt);
+	}
+
+	return std::max(std::min(dt, maxDt), std::min(_minDt, maxDt));
+}
+
+
+/**
+ * \brief Get the number of contacts of the last step.
+ *
+ * \return Contacts of the narrow-phase.
+ */
+unsigned int SimulationManager::getNumContacts() const {
+	return getStepContacts().size();
+}
+
+
+/**
+ * \brief Get the root of the pooled fragments which replace the broken asteroids (see FractureManager).
+ *
+ * \return Root-node of the fragments (nullptr => the asteroids don't break).
+ */
+osg::ref_ptr<osg::Group> SimulationManager::getFragmentRoot() const {
+	return _fManager ? _fManager->getRoot() : osg::ref_ptr<osg::Group>();
+}
+
+
+/**
+ * \brief Get the root of the pooled asteroids of the streamed sectors (see SectorManager).
+ *
+ * \return Root-node of the asteroids (nullptr => the scene has no sectors).
+ */
+osg::ref_ptr<osg::Group> SimulationManager::getSectorRoot() const {
+	return _sectorManager ? _sectorManager->getRoot() : osg::ref_ptr<osg::Group>();
+}
+
+
+/**
+ * \brief Get the root of the point-sprites of the massless dust (see DustManager).
+ *
+ * \return Root-node of the dust (nullptr => no dust or headless).
+ */
+osg::ref_ptr<osg::Node> SimulationManager::getDustRoot() const {
+	return _dManager ? osg::ref_ptr<osg::Node>(_dManager->getRoot().get()) : osg::ref_ptr<osg::Node>();
+}
+
+
+/**
+ * \brief Write checkpoints after the steps which are requested (see requestCheckpoint()) or periodically.
+ *
+ * \param scene
+ *      Loaded scene (the checkpoint is this scene with the current state of the simulation).
+ * \param filePath
+ *      Complete path to the checkpoint (overwritten by each checkpoint).
+ * \param interval
+ *      Seconds (wall-clock) between two checkpoints (0 => only the requested ones).
+ */
+void SimulationManager::setCheckpoint(const BinaryScene &scene, std::string filePath, double interval) {
+	_checkpointScene = scene;
+	_checkpointPath = filePath;
+	_checkpointInterval = std::max(interval, 0.0);
+	_lastCheckpoint = osg::Timer::instance()->tick();
+}
+
+
+/**
+ * \brief Write the loaded scene with the complete state of the simulation into a binary scene. The state is
+ *        copied by the step, the file is written by a background-job (see JobSystem).
+ *
+ * \param filePath
+ *      Complete path to the checkpoint (overwritten).
+ *
+ * \return False if no scene is set (see setCheckpoint()) or the previous checkpoint is still written.
+ */
+bool SimulationManager::saveCheckpoint(std::string filePath) {
+	// the checkpoint has the order of the scene
+	if (_bodies.isReordered()) {
+		reorderBodies(_bodies.getLoadOrder());
+	}
+
+	// the bodies of the scene have been replaced (e.g. by their fragments)
+	if (_hasSpawned) {
+		LOG_WARNING("The scene can't be written as checkpoint after bodies were spawned or despawned!");
+		return false;
+	}
+
+	unsigned int n = _bodies.size();
+	unsigned int cntSceneBodies = _checkpointScene.getNumBodies();
+
+	// the player of a game is simulated before the bodies of the scene
+	if (cntSceneBodies == 0 || cntSceneBodies > n) {
+		LOG_WARNING("The scene can't be written as checkpoint!");
+		return false;
+	}
+
+	BinaryScene scene = _checkpointScene;
+	unsigned int offset = n - cntSceneBodies;
+	for (unsigned int i = 0; i < cntSceneBodies; ++i) {
+		scene.setMotion(i, _bodies.getPosition(offset + i), _bodies.getLinearVelocity(offset + i), _bodies.getAngularVelocity(offset + i));
+	}
+
+	BinaryScene::State state;
+	saveState(state);
+	scene.setState(state);
+
+	json settings = scene.getSettings();
+	settings["checkpoint"] = { { "step", _cntSteps }, { "time", _time }, { "dt", _dt } };
+	scene.setSettings(settings);
+
+	// the previous checkpoint is still written to the same file
+	if (_isCheckpointWriting) {
+		LOG_WARNING("The previous checkpoint is still written!");
+		return false;
+	}
+
+	// the file is written by a background-job, so the frame does not wait for the disk
+	std::shared_ptr<BinaryScene> checkpoint = std::make_shared<BinaryScene>();
+	std::swap(*checkpoint, scene);
+	std::shared_ptr<bool> isSaved = std::make_shared<bool>(false);
+	unsigned long step = _cntSteps;
+	_isCheckpointWriting = true;
+
+	JobSystem::Instance()->submit([checkpoint, filePath, isSaved]() {
+		// a crash while writing does not destroy the previous checkpoint
+		std::string tmpPath = filePath + ".tmp";
+		*isSaved = checkpoint->save(tmpPath) && (std::remove(filePath.c_str()) == 0 || errno == ENOENT) && std::rename(tmpPath.c_str(), filePath.c_str()) == 0;
+	}, [this, filePath, step, isSaved]() {
+		_isCheckpointWriting = false;
+
+		if (*isSaved) {
+			LOG_INFO("Saved checkpoint of step " << step << " to `" << filePath << "`");
+		} else {
+			LOG_WARNING("File " + filePath + " can't be written!");
+		}
+	});
+
+	return true;
+}
+
+
+/**
+ * \brief Continue the simulation from the state of a checkpoint (the scene has to be loaded from the same
+ *        checkpoint). The acceleration-structures are rebuilt by the next step.
+ *
+ * \param scene
+ *      Loaded checkpoint.
+ *
+ * \return False if the scene has no state or a different number of bodies.
+ */
+bool SimulationManager::restoreCheckpoint(const BinaryScene &scene) {
+	if (!scene.hasState()) {
+		return false;
+	}
+
+	if (_bodies.isReordered()) {
+		reorderBodies(_bodies.getLoadOrder());
+	}
+
+	if (!restoreState(scene.getState())) {
+		return false;
+	}
+
+	// the keyframes are from a different run
+	if (_rewindBuffer) {
+		_rewindBuffer->clear();
+	}
+
+	json checkpoint = scene.getSettings()["checkpoint"];
+	if (checkpoint.is_object()) {
+		_cntSteps = checkpoint["step"].get<unsigned long>();
+		_time = checkpoint["time"].get<double>();
+		setSimulationDt(checkpoint["dt"].get<double>());
+	}
+
+	LOG_INFO("Restored checkpoint of step " << _cntSteps);
+	return true;
+}
+
+
+/**
+ * \brief Copy the complete state of the simulation (in the current order of the bodies).
+ *
+ * \param state
+ *      Output-parameter: State of the bodies and the managers.
+ */
+void SimulationManager::saveState(BinaryScene::State &state) {
+	unsigned int n = _bodies.size();
+
+	state = BinaryScene::State();
+	state.positions.resize(3 * n);
+	state.orientations.resize(4 * n);
+	state.linearVelocities.resize(3 * n);
+	state.angularVelocities.resize(3 * n);
+	state.sleeping.resize(n);
+
+	for (unsigned int i = 0; i < n; ++i) {
+		double orientation[4] = { _bodies.qx[i], _bodies.qy[i], _bodies.qz[i], _bodies.qw[i] };
+		std::copy(orientation, orientation + 4, state.orientations.begin() + 4 * i);
+
+		for (int axis = 0; axis < 3; ++axis) {
+			state.positions[3 * i + axis] = _bodies.getPosition(i)(axis);
+			state.linearVelocities[3 * i + axis] = _bodies.getLinearVelocity(i)(axis);
+			state.angularVelocities[3 * i + axis] = _bodies.getAngularVelocity(i)(axis);
+		}
+
+		state.sleeping[i] = _bodies.sleeping[i];
+	}
+
+	_nManager->saveState(_bodies, state);
+	_cManager->saveState(_bodies, state);
+}
+
+
+/**
+ * \brief Continue the simulation from a state of saveState() (in the same order of the bodies). The
+ *        acceleration-structures are rebuilt by the next step.
+ *
+ * \param state
+ *      State of the bodies and the managers.
+ *
+ * \return False if the state has a different number of bodies.
+ */
+bool SimulationManager::restoreState(const BinaryScene::State &state) {
+	unsigned int n = _bodies.size();
+
+	if (state.sleeping.size() != n) {
+		LOG_WARNING("The state has " << state.sleeping.size() << " bodies instead of " << n << "!");
+		return false;
+	}
+
+	for (unsigned int i = 0; i < n; ++i) {
+		_bodies.setPosition(i, Eigen::Vector3d(state.positions[3 * i], state.positions[3 * i + 1], state.positions[3 * i + 2]));
+		_bodies.setLinearVelocity(i, Eigen::Vector3d(state.linearVelocities[3 * i], state.linearVelocities[3 * i + 1], state.linearVelocities[3 * i + 2]));
+		_bodies.setAngularVelocity(i, Eigen::Vector3d(state.angularVelocities[3 * i], state.angularVelocities[3 * i + 1], state.angularVelocities[3 * i + 2]));
+		_bodies.setOrientation(i, Eigen::Quaterniond(state.orientations[4 * i + 3], state.orientations[4 * i], state.orientations[4 * i + 1], state.orientations[4 * i + 2]));
+		_bodies.sleeping[i] = state.sleeping[i];
+	}
+
+	_nManager->restoreState(state);
+	_cManager->restoreState(_bodies, state);
+
+	// the clusters are not stored, they are fused again by the resting contacts
+	if (_clManager) {
+		_clManager->clear();
+	}
+
+	// the space-objects (and with them the AABBs) get the restored state
+	_bodies.scatter(_spaceObjects);
+	return true;
+}
+
+
+/**
+ * \brief Request a rewind by a number of steps, it's done by the thread of the simulation before the next step.
+ *
+ * \param cntSteps
+ *      Number of steps to go back.
+ */
+void SimulationManager::requestRewind(unsigned long cntSteps) {
+	_rewindRequest = cntSteps;
+}
+
+
+/**
+ * \brief Get the steps between two keyframes of the rewind-buffer.
+ *
+ * \return Number of steps (0 => the simulation can't be rewound).
+ */
+unsigned int SimulationManager::getRewindInterval() const {
+	return _rewindBuffer ? _rewindBuffer->getInterval() : 0;
+}
+
+
+/**
+ * \brief Go back by a number of steps: the newest keyframe before the target is restored and the steps up to
+ *        the target are simulated again (bitwise the same, the input of the player is not recorded).
+ *
+ * \param cntSteps
+ *      Number of steps to go back.
+ *
+ * \return False if the rewind-buffer is disabled or has no keyframe before the target.
+ */
+bool SimulationManager::rewind(unsigned long cntSteps) {
+	if (!_rewindBuffer || cntSteps == 0) {
+		return false;
+	}
+
+	unsigned long target = _cntSteps > cntSteps ? _cntSteps - cntSteps : 0;
+	unsigned long keyStep;
+	double time;
+	double dt;
+	BinaryScene::State state;
+	if (!_rewindBuffer->restore(target, keyStep, time, dt, state)) {
+		LOG_WARNING("No keyframe to rewind to step " << target << "!");
+		return false;
+	}
+
+	// the keyframes have the order of the scene
+	if (_bodies.isReordered()) {
+		reorderBodies(_bodies.getLoadOrder());
+	}
+
+	if (!restoreState(state)) {
+		_rewindBuffer->clear();
+		return false;
+	}
+
+	_cntSteps = keyStep;
+	_time = time;
+	setSimulationDt(dt);
+
+	// the steps after the keyframe are simulated again (also if the scene is paused), without their bursts
+	bool isPaused = _isPaused;
+	bool isFastForward = _isFastForward;
+	_isPaused = false;
+	_isFastForward = true;
+	while (_cntSteps < target) {
+		step(_dt);
+	}
+	_isPaused = isPaused;
+	_isFastForward = isFastForward;
+
+	// the rendered objects jump to the new state
+	_previousStates.clear();
+	_accumulator = 0.0;
+
+	LOG_INFO("Rewound to step " << _cntSteps << " (from the keyframe of step " << keyStep << ")");
+	return true;
+}
+
+
+/**
+ * \brief Reorder the bodies, the space-objects and the state of the managers by the same permutation.
+ *
+ * \param order
+ *      Old index of the body at each new index.
+ */
+void SimulationManager::reorderBodies(const std::vector<int> &order) {
+	_bodies.permute(order);
+	BodyState::permuteArray(_spaceObjects, order);
+	_nManager->permuteState(order);
 
-    // TBD: check for fraction
+	// the broad-phase is initialized again in the new order
+	_cManager->setSpaceObjects(_spaceObjects);
 }
@@ -8,14 +8,38 @@
 #pragma once
 
 #include <vector>
+#include <string>
 #include <algorithm>
+#include <json.hpp>
+#include <osg/Timer>
+#include <osg/Group>
+#include <osg/Quat>
+#include <OpenThreads/Mutex>
+#include <Eigen/Core>
+
+#include "BodyState.h"
+#include "Collision.h"
+#include "Diagnostics.h"
+#include "SpscQueue.h"
+#include "../scene/BinaryScene.h"
+
+using json = nlohmann::json;
 
 
 // forward declarations
 namespace pbs17 {
 	class NBodyManager;
 	class CollisionManager;
+	class FractureManager;
+	class DustManager;
+	class MergeManager;
+	class ClusterManager;
+	class SectorManager;
+	class RewindBuffer;
 	class SpaceObject;
+	class TrajectoryRecorder;
+	class StatePublisher;
+	class MetricsExporter;
 }
 
 
@@ -26,17 +50,69 @@ namespace pbs17 {
 	 */
 	class SimulationManager {
 	public:
+		/**
+		 * \brief Change of a body which is requested from outside of the simulation (e.g. by the reload of the scene).
+		 */
+		struct SceneChange {
+			//! Kind of the change
+			enum Type {
+				//! The new object is added to the scene and spawned
+				ADD,
+				//! The object is despawned (it's kept by the scene-manager)
+				REMOVE,
+				//! The state and the mass of the object are replaced
+				MODIFY
+			};
+
+			Type type;
+			SpaceObject* object;
+			Eigen::Vector3d position;
+			Eigen::Vector3d linearVelocity;
+			Eigen::Vector3d angularVelocity;
+			double mass;
+		};
+
+
+		//! Controls of the player which are held or released by the keyboard (see queueInput())
+		enum PlayerControl {
+			TURN_UP = 0,
+			TURN_DOWN,
+			TURN_LEFT,
+			TURN_RIGHT,
+			ACCELERATE,
+			DECELERATE,
+			CNT_CONTROLS
+		};
+
+
+		/**
+		 * \brief A control of the player which has been pressed or released.
+		 */
+		struct InputCommand {
+			PlayerControl control;
+			bool isHeld;
+		};
+
+
 		/**
 		 * \brief Constructor of the simulation-manager.
 		 *
 		 * \param spaceObjects
 		 *      All space-objects in the scene.
+		 * \param settings
+		 *      Simulation-settings of the scene (e.g. {"gravitySolver": "barnesHut", "theta": 0.5}).
 		 */
-		SimulationManager(std::vector<SpaceObject*> spaceObjects);
+		SimulationManager(std::vector<SpaceObject*> spaceObjects, json settings = json::object());
 
 
 		/**
-		 * \brief Simulate the scene.
+		 * \brief Destructor of the simulation-manager (the space-objects are owned by the scene-manager).
+		 */
+		~SimulationManager();
+
+
+		/**
+		 * \brief Simulate the scene and update the OSG-nodes (single-threaded).
 		 *
 		 * \param dt
 		 *      Time difference since between the last frames.
@@ -44,14 +120,356 @@ namespace pbs17 {
 		void simulate(double dt);
 
 
+		/**
+		 * \brief Simulate one step of the scene without touching the OSG-nodes (used by the physics-thread and the main-loop).
+		 *
+		 * \param dt
+		 *      Time difference since between the last frames.
+		 */
+		void step(double dt);
+
+
+		/**
+		 * \brief Simulate as many steps as the elapsed wall-clock needs at a fixed rate (used by the main-loop), so the
+		 *        simulated time does not depend on the frame-rate. The next syncs interpolate between the states
+		 *        before and after the last step by the remaining time.
+		 *
+		 * \param seconds
+		 *      Wall-clock since the last call.
+		 * \param period
+		 *      Wall-clock per step (1 / steps per second).
+		 * \param maxSteps
+		 *      Maximum number of steps per call (the remaining time is dropped if the simulation is too slow).
+		 *
+		 * \return Number of simulated steps.
+		 */
+		int advance(double seconds, double period, int maxSteps);
+
+
+		/**
+		 * \brief Simulate as many steps as fit a wall-clock budget (fast-forward mode of the main-loop). The next step
+		 *        is only started if it is expected to finish within the budget, the next syncs show the newest state
+		 *        without interpolation.
+		 *
+		 * \param budget
+		 *      Wall-clock in seconds for all steps (at least one step is simulated).
+		 *
+		 * \return Number of simulated steps.
+		 */
+		int fastForward(double budget);
+
+
+		/**
+		 * \brief Write the changed objects to the OSG-nodes (called by the update-traversal, see SceneSyncCallback).
+		 *        After advance(), the moved objects are interpolated between their last two states.
+		 */
+		void syncScene();
+
+
+		/**
+		 * \brief Add a pooled object to the simulation (e.g. a fragment or a projectile), it's appended to the bodies
+		 *        and sorted into the broad-phase and the grid without rebuilding them. Has to be called by the thread
+		 *        of the simulation between two steps.
+		 *
+		 * \param object
+		 *      Object which has been activated with its state (see BodyPool::acquire()).
+		 */
+		void spawn(SpaceObject* object);
+
+
+		/**
+		 * \brief Remove an object from the simulation, the last body is moved to its index (in all managers). A pooled
+		 *        object returns to its pool. Has to be called by the thread of the simulation between two steps.
+		 *
+		 * \param object
+		 *      Simulated object (deactivated, its OSG-nodes are hidden by the next sync-pass).
+		 */
+		void despawn(SpaceObject* object);
+
+
+		/**
+		 * \brief Queue a change of the scene, the changes are applied in their order before the next step (also if
+		 *        the simulation is paused). Can be called by any thread.
+		 *
+		 * \param change
+		 *      Added, removed or modified object.
+		 */
+		void queueSceneChange(const SceneChange &change);
+
+
+		/**
+		 * \brief Queue a pressed or released control of the player without blocking (lock-free). The held controls
+		 *        steer the player in every step by its time-step, independent of the frame-rate and the key-repeat.
+		 *        Has to be called by a single thread (the event-traversal).
+		 *
+		 * \param command
+		 *      Pressed or released control.
+		 *
+		 * \return False if the queue is full (the command is dropped).
+		 */
+		bool queueInput(const InputCommand &command) {
+			return _inputQueue.push(command);
+		}
+
+
+		/**
+		 * \brief Get all space-objects of the simulation.
+		 *
+		 * \return Space-objects in the order of the scene (independent of the reordering of the bodies), followed
+		 *         by the pooled asteroids and fragments (see SectorManager and FractureManager) and the objects
+		 *         which have been added since (see queueSceneChange()).
+		 */
+		const std::vector<SpaceObject*>& getSpaceObjects() const {
+			return _sceneObjects;
+		}
+
+
+		/**
+		 * \brief Get the state of the simulated bodies (e.g. for the analysis in the same process, see python/module.cpp).
+		 *        The arrays are reordered and resized by the steps, so they are only valid until the next step.
+		 *
+		 * \return State of all simulated bodies in the current order of the bodies.
+		 */
+		const BodyState& getBodies() const {
+			return _bodies;
+		}
+
+
+		/**
+		 * \brief Get the collision-manager (e.g. for ray-casts and proximity-queries between the steps, see
+		 *        CollisionManager::rayCast()).
+		 *
+		 * \return Collision-manager of the simulation.
+		 */
+		CollisionManager* getCollisionManager() const {
+			return _cManager;
+		}
+
+
+		/**
+		 * \brief Get the diagnostics of the conserved quantities (scene-json: "diagnosticsInterval").
+		 *
+		 * \return Diagnostics with the last measurement.
+		 */
+		const Diagnostics& getDiagnostics() const {
+			return _diagnostics;
+		}
+
+
+		/**
+		 * \brief Sort the bodies along a Morton-curve every few steps, so the bodies which are close to each other
+		 *        are also close in memory (tree-builds, grid-binning and the sweeps of the broad-phase).
+		 *
+		 * \param interval
+		 *      Steps between two reorderings (0 => the bodies stay in the order of the scene).
+		 */
+		void setReorderInterval(const unsigned int interval) {
+			_reorderInterval = interval;
+		}
+
+
+		/**
+		 * \brief Overlap the update of the AABBs, the preparation of the broad-phase and the binning of the shared
+		 *        grid in a task-graph (see TaskGraph), instead of running them one after the other.
+		 *
+		 * \param usePipeline
+		 *      True to pipeline the phases between the integration and the broad-phase.
+		 */
+		void setUsePipeline(const bool usePipeline) {
+			_usePipeline = usePipeline;
+		}
+
+
+		/**
+		 * \brief Set the recorder which gets the state and the contacts after each step.
+		 *
+		 * \param recorder
+		 *      Recorder of the trajectories (nullptr => nothing is recorded).
+		 */
+		void setRecorder(TrajectoryRecorder* recorder) {
+			_recorder = recorder;
+		}
+
+
+		/**
+		 * \brief Set the publisher which streams the state to the remote viewers after each step.
+		 *
+		 * \param publisher
+		 *      Publisher of the state (nullptr => nothing is streamed).
+		 */
+		void setPublisher(StatePublisher* publisher) {
+			_publisher = publisher;
+		}
+
+
+		/**
+		 * \brief Set the exporter which serves the progress and the counters to a monitoring-system.
+		 *
+		 * \param metrics
+		 *      Exporter of the metrics (nullptr => nothing is exported).
+		 */
+		void setMetrics(MetricsExporter* metrics) {
+			_metrics = metrics;
+		}
+
+
+		/**
+		 * \brief Move the region of interest of the collision-detection (e.g. with the camera), the objects outside of
+		 *        it collide as spheres (see CollisionManager::setLevelOfDetail()). Can be called by any thread, it's
+		 *        used from the next step on.
+		 *
+		 * \param center
+		 *      Center of the region (its radius is set by the scene: "lodRadius"). Without a player, it's also
+		 *      the center of the integrated zone ("railsRadius", see NBodyManager::setRails()).
+		 */
+		void setFocus(const Eigen::Vector3d &center);
+
+
+		/**
+		 * \brief Get the number of simulated steps.
+		 *
+		 * \return Steps since the start (or since the start of the restored checkpoint).
+		 */
+		unsigned long getNumSteps() const {
+			return _cntSteps;
+		}
+
+
+		/**
+		 * \brief Get the simulated time.
+		 *
+		 * \return Sum of the time-steps.
+		 */
+		double getTime() const {
+			return _time;
+		}
+
+
+		/**
+		 * \brief Get the number of contacts of the last step.
+		 *
+		 * \return Contacts of the narrow-phase.
+		 */
+		unsigned int getNumContacts() const;
+
+
+		/**
+		 * \brief Get the root of the pooled fragments which replace the broken asteroids (see FractureManager).
+		 *
+		 * \return Root-node of the fragments (nullptr => the asteroids don't break).
+		 */
+		osg::ref_ptr<osg::Group> getFragmentRoot() const;
+
+
+		/**
+		 * \brief Get the root of the pooled asteroids of the streamed sectors (see SectorManager).
+		 *
+		 * \return Root-node of the asteroids (nullptr => the scene has no sectors).
+		 */
+		osg::ref_ptr<osg::Group> getSectorRoot() const;
+
+
+		/**
+		 * \brief Get the root of the point-sprites of the massless dust (see DustManager).
+		 *
+		 * \return Root-node of the dust (nullptr => no dust or headless).
+		 */
+		osg::ref_ptr<osg::Node> getDustRoot() const;
+
+
+		/**
+		 * \brief Write checkpoints after the steps which are requested (see requestCheckpoint()) or periodically.
+		 *
+		 * \param scene
+		 *      Loaded scene (the checkpoint is this scene with the current state of the simulation).
+		 * \param filePath
+		 *      Complete path to the checkpoint (overwritten by each checkpoint).
+		 * \param interval
+		 *      Seconds (wall-clock) between two checkpoints (0 => only the requested ones).
+		 */
+		void setCheckpoint(const BinaryScene &scene, std::string filePath, double interval = 0.0);
+
+
+		/**
+		 * \brief Write the loaded scene with the complete state of the simulation into a binary scene. The state is
+		 *        copied by the step, the file is written by a background-job (see JobSystem).
+		 *
+		 * \param filePath
+		 *      Complete path to the checkpoint (overwritten).
+		 *
+		 * \return False if no scene is set (see setCheckpoint()) or the previous checkpoint is still written.
+		 */
+		bool saveCheckpoint(std::string filePath);
+
+
+		/**
+		 * \brief Continue the simulation from the state of a checkpoint (the scene has to be loaded from the same
+		 *        checkpoint). The acceleration-structures are rebuilt by the next step.
+		 *
+		 * \param scene
+		 *      Loaded checkpoint.
+		 *
+		 * \return False if the scene has no state or a different number of bodies.
+		 */
+		bool restoreCheckpoint(const BinaryScene &scene);
+
+
+		/**
+		 * \brief Request a rewind by a number of steps, it's done by the thread of the simulation before the next step.
+		 *
+		 * \param cntSteps
+		 *      Number of steps to go back.
+		 */
+		void requestRewind(unsigned long cntSteps);
+
+
+		/**
+		 * \brief Get the steps between two keyframes of the rewind-buffer.
+		 *
+		 * \return Number of steps (0 => the simulation can't be rewound).
+		 */
+		unsigned int getRewindInterval() const;
+
+
+		/**
+		 * \brief Go back by a number of steps: the newest keyframe before the target is restored and the steps up to
+		 *        the target are simulated again (bitwise the same, the input of the player is not recorded).
+		 *
+		 * \param cntSteps
+		 *      Number of steps to go back.
+		 *
+		 * \return False if the rewind-buffer is disabled or has no keyframe before the target.
+		 */
+		bool rewind(unsigned long cntSteps);
+
+
+		/**
+		 * \brief Request a checkpoint after the next step (e.g. by the keyboard-handler).
+		 */
+		void requestCheckpoint() {
+			_isCheckpointRequested = true;
+		}
+
+
+		/**
+		 * \brief Get the mutex which protects the state of the space-objects while a step is simulated.
+		 *        Everything which changes the space-objects from outside (e.g. the keyboard) has to lock it.
+		 *
+		 * \return Mutex of the simulation-state.
+		 */
+		static OpenThreads::Mutex& getStateMutex() {
+			return STATE_MUTEX;
+		}
+
+
 		/**
 		 * \brief Set paused-state of the simulation
 		 * 
 		 * \param isPaused
 		 *      True if the simulation is paused, false if it is running.
 		 */
-		static void setIsPaused(const bool isPaused) {
-			IS_PAUSED = isPaused;
+		void setIsPaused(const bool isPaused) {
+			_isPaused = isPaused;
 		}
 
 
@@ -60,8 +478,51 @@ namespace pbs17 {
 		*
 		* \return True if the simulation is paused, false if it is running.
 		*/
-		static bool getIsPaused() {
-			return IS_PAUSED;
+		bool getIsPaused() const {
+			return _isPaused;
+		}
+
+
+		/**
+		 * \brief Enable or disable the fast-forward mode (e.g. by the keyboard-handler): the main-loop and the
+		 *        physics-thread step as fast as possible and only the newest state is rendered.
+		 *
+		 * \param isFastForward
+		 *      True if the steps are not bound to the wall-clock.
+		 */
+		void setIsFastForward(const bool isFastForward) {
+			_isFastForward = isFastForward;
+		}
+
+
+		/**
+		 * \brief Get if the fast-forward mode is enabled.
+		 *
+		 * \return True if the steps are not bound to the wall-clock.
+		 */
+		bool getIsFastForward() const {
+			return _isFastForward;
+		}
+
+
+		/**
+		 * \brief Set the wall-clock which is simulated per frame in the fast-forward mode.
+		 *
+		 * \param budget
+		 *      Wall-clock in seconds per frame.
+		 */
+		void setFastForwardBudget(const double budget) {
+			_fastForwardBudget = std::max(budget, 0.0);
+		}
+
+
+		/**
+		 * \brief Get the wall-clock which is simulated per frame in the fast-forward mode.
+		 *
+		 * \return Wall-clock in seconds per frame.
+		 */
+		double getFastForwardBudget() const {
+			return _fastForwardBudget;
 		}
 
 
@@ -71,9 +532,9 @@ namespace pbs17 {
 		 * \param dt
 		 *      New simulation step.
 		 */
-		static void setSimulationDt(const double dt) {
-			SIMULATION_DT = std::max(dt, 0.0);
-			SIMULATION_DT = std::min(SIMULATION_DT, 1.0);
+		void setSimulationDt(const double dt) {
+			_dt = std::max(dt, 0.0);
+			_dt = std::min(_dt, 1.0);
 		}
 
 
@@ -83,8 +544,8 @@ namespace pbs17 {
 		 * \param dt
 		 *      Increasing-change of the simulation-step.
 		 */
-		static void increaseSimulationDt(const double dt) {
-			setSimulationDt(SIMULATION_DT + dt);
+		void increaseSimulationDt(const double dt) {
+			setSimulationDt(_dt + dt);
 		}
 
 
@@ -94,8 +555,8 @@ namespace pbs17 {
 		 * \param dt
 		 *      Decrease-change of the simulation-step.
 		 */
-		static void decreaseSimulationDt(const double dt) {
-			setSimulationDt(SIMULATION_DT - dt);
+		void decreaseSimulationDt(const double dt) {
+			setSimulationDt(_dt - dt);
 		}
 
 
@@ -104,24 +565,273 @@ namespace pbs17 {
 		 *
 		 * \return Simulation-step.
 		 */
-		static double getSimulationDt() {
-			return SIMULATION_DT;
+		double getSimulationDt() const {
+			return _dt;
+		}
+
+
+		/**
+		 * \brief Set the opening angle of the Barnes-Hut and the fast multipole solver (between two steps).
+		 *
+		 * \param theta
+		 *      Opening angle (smaller => more exact, larger => faster).
+		 */
+		void setTheta(const double theta);
+
+
+		/**
+		 * \brief Get the opening angle of the Barnes-Hut and the fast multipole solver.
+		 *
+		 * \return Opening angle (0 => the gravity-solver does not use it).
+		 */
+		double getTheta() const;
+
+
+		/**
+		 * \brief Set the number of collision-substeps per evaluation of the forces (between two steps).
+		 *
+		 * \param collisionSubsteps
+		 *      Collision-substeps (at least 1).
+		 */
+		void setCollisionSubsteps(const int collisionSubsteps) {
+			_collisionSubsteps = std::max(collisionSubsteps, 1);
+		}
+
+
+		/**
+		 * \brief Get the number of collision-substeps per evaluation of the forces.
+		 *
+		 * \return Collision-substeps.
+		 */
+		int getCollisionSubsteps() const {
+			return _collisionSubsteps;
+		}
+
+
+		/**
+		 * \brief Let each step select its time-step between a minimum and the simulation-step (the +/- keys scale
+		 *        the upper bound): the bodies may only move a fraction of their size by their accelerations, and the
+		 *        approaching pairs of the broad-phase may not penetrate each other too deep within a step.
+		 *
+		 * \param isAdaptive
+		 *      True to adapt the time-step, false to step with the simulation-step.
+		 * \param minDt
+		 *      Smallest time-step (close encounters are stepped with it).
+		 * \param accuracy
+		 *      Fraction of the time-scales of the encounters (smaller => smaller time-steps).
+		 */
+		void setAdaptiveDt(const bool isAdaptive, const double minDt = 1e-4, const double accuracy = 0.2) {
+			_isAdaptiveDt = isAdaptive;
+			_minDt = std::max(minDt, 0.0);
+			_dtAccuracy = accuracy;
+		}
+
+
+		/**
+		 * \brief Get the time-step of the last step.
+		 *
+		 * \return Selected (or constant) time-step.
+		 */
+		double getStepDt() const {
+			return _stepDt;
 		}
 
 
 	private:
 
-		//! All space-objects in the scene
+		//! All space-objects in the scene (and the pooled fragments)
+		std::vector<SpaceObject*> _sceneObjects;
+		//! All simulated space-objects in the order of the bodies (see _reorderInterval)
 		std::vector<SpaceObject*> _spaceObjects;
+		//! State of all space-objects which is used (and updated) by the simulation
+		BodyState _bodies;
+		//! Space-objects which are controlled from outside of the simulation (e.g. the player)
+		std::vector<SpaceObject*> _controlledObjects;
 		//! Collision-manager for this scene
 		CollisionManager* _cManager;
 		//! Nbody-manager for this scene
 		NBodyManager* _nManager;
+		//! Fracture-manager for this scene (nullptr => the asteroids don't break)
+		FractureManager* _fManager = nullptr;
+		//! Merge-manager for this scene (nullptr => the bodies don't merge)
+		MergeManager* _mManager = nullptr;
+		//! Cluster-manager for this scene (nullptr => the resting objects are not fused)
+		ClusterManager* _clManager = nullptr;
+		//! Dust-manager for this scene (nullptr => no dust)
+		DustManager* _dManager = nullptr;
+		//! Sector-manager for this scene (nullptr => all objects are in the scene)
+		SectorManager* _sectorManager = nullptr;
+		//! Ring of the keyframes for rewinding (nullptr => the simulation can't be rewound)
+		RewindBuffer* _rewindBuffer = nullptr;
+		//! Number of steps to go back before the next step (0 => no rewind, written by the keyboard-handler)
+		volatile unsigned long _rewindRequest = 0;
+		//! Recorder of the trajectories (nullptr => nothing is recorded)
+		TrajectoryRecorder* _recorder = nullptr;
+		//! Publisher of the state for the remote viewers (nullptr => nothing is streamed)
+		StatePublisher* _publisher = nullptr;
+		//! Exporter of the metrics (nullptr => nothing is exported)
+		MetricsExporter* _metrics = nullptr;
+		//! Measurements of the energy, the momentum and the angular momentum every few steps
+		Diagnostics _diagnostics;
+		//! Number of simulated steps
+		unsigned long _cntSteps = 0;
+		//! Simulated time
+		double _time = 0.0;
 
-		//! True if the simulation is paused
-		static bool IS_PAUSED;
+		//! Loaded scene on which the checkpoints are based
+		BinaryScene _checkpointScene;
+		//! Complete path to the checkpoint ("" => no checkpoints are written)
+		std::string _checkpointPath;
+		//! Seconds between two checkpoints (0 => only the requested ones)
+		double _checkpointInterval = 0.0;
+		//! Time of the last checkpoint
+		osg::Timer_t _lastCheckpoint = 0;
 
+		//! True if the simulation is paused
+		bool _isPaused = false;
+		//! True if a checkpoint is written after the next step
+		volatile bool _isCheckpointRequested = false;
+		//! True while the background-job writes a checkpoint
+		bool _isCheckpointWriting = false;
+		//! True if the steps are not bound to the wall-clock (written by the keyboard-handler)
+		volatile bool _isFastForward = false;
+		//! Wall-clock in seconds per frame of the fast-forward mode
+		double _fastForwardBudget = 0.05;
 		//! Simulation-step (time-difference)
-		static double SIMULATION_DT;
+		double _dt = 0.01;
+		//! Flag if the time-step is selected per step (the simulation-step is the upper bound)
+		bool _isAdaptiveDt = false;
+		//! Smallest adaptive time-step
+		double _minDt = 1e-4;
+		//! Fraction of the time-scales of the bodies and pairs
+		double _dtAccuracy = 0.2;
+		//! Time-step of the last step
+		double _stepDt = 0.0;
+
+		/**
+		 * \brief Rendered state of an object before the last step of advance().
+		 */
+		struct RenderState {
+			Eigen::Vector3d position;
+			osg::Quat orientation;
+			bool isActive;
+		};
+
+		//! States of the scene-objects before the last step of advance() (empty => nothing is interpolated)
+		std::vector<RenderState> _previousStates;
+		//! Wall-clock which has not been simulated by advance()
+		double _accumulator = 0.0;
+		//! Wall-clock per step of advance()
+		double _period = 0.0;
+		//! Steps between two reorderings of the bodies (0 => never)
+		unsigned int _reorderInterval = 0;
+		//! Flag if the phases between the integration and the broad-phase are pipelined
+		bool _usePipeline = false;
+		//! True if the bodies differ from the scene (no checkpoints)
+		bool _hasSpawned = false;
+		//! Center of the region of interest of the collision-detection (see setFocus())
+		Eigen::Vector3d _focus = Eigen::Vector3d::Zero();
+		//! Radius of the region of interest (<= 0.0 => all pairs are tested exactly)
+		double _lodRadius = 0.0;
+		//! Radius of the integrated zone around the player, the bodies outside are on rails (<= 0.0 => no rails)
+		double _railsRadius = 0.0;
+		//! Collision-substeps per evaluation of the forces
+		int _collisionSubsteps = 1;
+		//! Change of the velocity by a contact which raises dust (see GpuParticleSystem)
+		double _particleVelocity = 0.1;
+		//! Maximal number of contacts per step which raise dust
+		static const unsigned int MAX_DUST_BURSTS = 64;
+		//! Contacts of all substeps of the last step (only used with more than one substep)
+		std::vector<Collision> _stepContacts;
+		//! Protects the focus, which is set by the rendering-thread
+		OpenThreads::Mutex _focusMutex;
+		//! Changes of the scene which wait for the next step (see queueSceneChange())
+		std::vector<SceneChange> _sceneChanges;
+		//! Protects the queued changes of the scene
+		OpenThreads::Mutex _sceneChangeMutex;
+		//! Controls of the player which wait for the next step (see queueInput())
+		SpscQueue<InputCommand, 256> _inputQueue;
+		//! Held controls of the player
+		bool _heldControls[CNT_CONTROLS] = {};
+		//! Bodies per task of the pipeline
+		static const int PIPELINE_GRAIN_SIZE = 64;
+
+		//! Mutex of the simulation-state
+		static OpenThreads::Mutex STATE_MUTEX;
+
+
+		/**
+		 * \brief Reorder the bodies, the space-objects and the state of the managers by the same permutation.
+		 *
+		 * \param order
+		 *      Old index of the body at each new index.
+		 */
+		void reorderBodies(const std::vector<int> &order);
+
+
+		/**
+		 * \brief Copy the complete state of the simulation (in the current order of the bodies).
+		 *
+		 * \param state
+		 *      Output-parameter: State of the bodies and the managers.
+		 */
+		void saveState(BinaryScene::State &state);
+
+
+		/**
+		 * \brief Continue the simulation from a state of saveState() (in the same order of the bodies). The
+		 *        acceleration-structures are rebuilt by the next step.
+		 *
+		 * \param state
+		 *      State of the bodies and the managers.
+		 *
+		 * \return False if the state has a different number of bodies.
+		 */
+		bool restoreState(const BinaryScene::State &state);
+
+
+		/**
+		 * \brief Apply the queued changes of the scene (see queueSceneChange()).
+		 */
+		void applySceneChanges();
+
+
+		/**
+		 * \brief Update the held controls by the queued input and steer the player with them.
+		 *
+		 * \param dt
+		 *      Time-step of the steering.
+		 */
+		void applyInput(double dt);
+
+
+		/**
+		 * \brief Select the time-step of the next step from the accelerations of the last force-evaluation and
+		 *        the approaching pairs of the last narrow-phase (see setAdaptiveDt()).
+		 *
+		 * \param maxDt
+		 *      Upper bound of the time-step.
+		 *
+		 * \return Time-step between the minimum and maxDt, at most twice the last one.
+		 */
+		double selectTimeStep(double maxDt) const;
+
+
+		/**
+		 * \brief Get the contacts of the last step (of all its collision-substeps).
+		 *
+		 * \return Contacts which were resolved during the last step.
+		 */
+		const std::vector<Collision>& getStepContacts() const;
+
+
+		/**
+		 * \brief Emit the particles of the events of the last step into the GpuParticleSystem: dust at the hard
+		 *        contacts and debris at the broken objects.
+		 *
+		 * \param broken
+		 *      Objects which broke during the last step.
+		 */
+		void emitParticles(const std::vector<SpaceObject*> &broken) const;
 	};
 }
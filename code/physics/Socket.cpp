@@ -0,0 +1,228 @@
+﻿/**
+ * \brief Implementation of the minimal TCP-sockets of the state-streaming.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "Socket.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
+
+using namespace pbs17;
+
+
+/**
+ * \brief Open a socket which listens on all interfaces, its accept() does not wait.
+ *
+ * \param port
+ *      TCP-port.
+ *
+ * \return Listening socket (-1 => the port can't be opened).
+ */
+int Socket::listen(unsigned short port) {
+	if (!init()) return -1;
+
+	int listener = static_cast<int>(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+	if (listener < 0) return -1;
+
+	// a restarted simulation can use the port again while the old connections time out
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in address;
+	std::memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+
+	if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 8) != 0) {
+		close(listener);
+		return -1;
+	}
+
+#if defined(_WIN32)
+	u_long isNonBlocking = 1;
+	ioctlsocket(listener, FIONBIO, &isNonBlocking);
+#else
+	fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+	return listener;
+}
+
+
+/**
+ * \brief Accept a waiting connection.
+ *
+ * \param listener
+ *      Listening socket.
+ *
+ * \return Connected socket (-1 => nobody is waiting).
+ */
+int Socket::accept(int listener) {
+	int socket = static_cast<int>(::accept(listener, nullptr, nullptr));
+	if (socket < 0) return -1;
+
+#if defined(_WIN32)
+	u_long isNonBlocking = 0;
+	ioctlsocket(socket, FIONBIO, &isNonBlocking);
+#else
+	fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) & ~O_NONBLOCK);
+#endif
+
+	// the frames are sent at once, they should not wait for the acknowledgements
+	int noDelay = 1;
+	setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+	return socket;
+}
+
+
+/**
+ * \brief Connect to a listening socket.
+ *
+ * \param host
+ *      Name or address of the host.
+ * \param port
+ *      TCP-port.
+ *
+ * \return Connected socket (-1 => the host can't be reached).
+ */
+int Socket::connect(const std::string &host, unsigned short port) {
+	if (!init()) return -1;
+
+	addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo* addresses = nullptr;
+	if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+		return -1;
+	}
+
+	int socket = -1;
+	for (addrinfo* a = addresses; a != nullptr && socket < 0; a = a->ai_next) {
+		socket = static_cast<int>(::socket(a->ai_family, a->ai_socktype, a->ai_protocol));
+		if (socket >= 0 && ::connect(socket, a->ai_addr, static_cast<int>(a->ai_addrlen)) != 0) {
+			close(socket);
+			socket = -1;
+		}
+	}
+
+	freeaddrinfo(addresses);
+	return socket;
+}
+
+
+/**
+ * \brief Send a part of a buffer (waits until something is sent).
+ *
+ * \return Number of sent bytes (<= 0 => disconnected).
+ */
+long Socket::send(int socket, const char* data, size_t size) {
+#if defined(_WIN32)
+	return ::send(socket, data, static_cast<int>(size), 0);
+#elif defined(MSG_NOSIGNAL)
+	// a closed viewer does not kill the simulation with SIGPIPE
+	return ::send(socket, data, size, MSG_NOSIGNAL);
+#else
+	return ::send(socket, data, size, 0);
+#endif
+}
+
+
+/**
+ * \brief Receive a part of a buffer (waits until something is received).
+ *
+ * \return Number of received bytes (<= 0 => disconnected).
+ */
+long Socket::receive(int socket, char* data, size_t size) {
+#if defined(_WIN32)
+	return ::recv(socket, data, static_cast<int>(size), 0);
+#else
+	return ::recv(socket, data, size, 0);
+#endif
+}
+
+
+/**
+ * \brief Limit the time which a send() or receive() waits (e.g. for a client which sends nothing).
+ *
+ * \param socket
+ *      Connected socket.
+ * \param milliseconds
+ *      Timeout (0 => wait forever).
+ */
+void Socket::setTimeout(int socket, unsigned int milliseconds) {
+#if defined(_WIN32)
+	DWORD timeout = milliseconds;
+#else
+	timeval timeout;
+	timeout.tv_sec = milliseconds / 1000;
+	timeout.tv_usec = (milliseconds % 1000) * 1000;
+#endif
+
+	setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+	setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+}
+
+
+/**
+ * \brief Shut the connection down, so a waiting receive() returns (the socket stays open).
+ */
+void Socket::shutdown(int socket) {
+#if defined(_WIN32)
+	::shutdown(socket, SD_BOTH);
+#else
+	::shutdown(socket, SHUT_RDWR);
+#endif
+}
+
+
+/**
+ * \brief Close a socket.
+ */
+void Socket::close(int socket) {
+#if defined(_WIN32)
+	closesocket(socket);
+#else
+	::close(socket);
+#endif
+}
+
+
+/**
+ * \brief Initialize the sockets of the platform once (only needed by Winsock).
+ *
+ * \return True if the sockets can be used.
+ */
+bool Socket::init() {
+#if defined(_WIN32)
+	static bool isInitialized = false;
+	static bool isAvailable = false;
+	if (!isInitialized) {
+		WSADATA data;
+		isAvailable = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		isInitialized = true;
+	}
+
+	return isAvailable;
+#else
+	return true;
+#endif
+}
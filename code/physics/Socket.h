@@ -0,0 +1,102 @@
+﻿/**
+ * \brief Implementation of the minimal TCP-sockets of the state-streaming.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <string>
+#include <stddef.h>
+
+namespace pbs17 {
+
+	/**
+	 * \brief Blocking TCP-sockets on top of the BSD-sockets (Winsock on Windows), the sockets are plain integers
+	 *        (-1 => invalid). Only used by the publisher and the subscriber of the state (see StatePublisher) and the metrics (see MetricsExporter).
+	 */
+	class Socket {
+	public:
+		/**
+		 * \brief Open a socket which listens on all interfaces, its accept() does not wait.
+		 *
+		 * \param port
+		 *      TCP-port.
+		 *
+		 * \return Listening socket (-1 => the port can't be opened).
+		 */
+		static int listen(unsigned short port);
+
+
+		/**
+		 * \brief Accept a waiting connection.
+		 *
+		 * \param listener
+		 *      Listening socket.
+		 *
+		 * \return Connected socket (-1 => nobody is waiting).
+		 */
+		static int accept(int listener);
+
+
+		/**
+		 * \brief Connect to a listening socket.
+		 *
+		 * \param host
+		 *      Name or address of the host.
+		 * \param port
+		 *      TCP-port.
+		 *
+		 * \return Connected socket (-1 => the host can't be reached).
+		 */
+		static int connect(const std::string &host, unsigned short port);
+
+
+		/**
+		 * \brief Send a part of a buffer (waits until something is sent).
+		 *
+		 * \return Number of sent bytes (<= 0 => disconnected).
+		 */
+		static long send(int socket, const char* data, size_t size);
+
+
+		/**
+		 * \brief Receive a part of a buffer (waits until something is received).
+		 *
+		 * \return Number of received bytes (<= 0 => disconnected).
+		 */
+		static long receive(int socket, char* data, size_t size);
+
+
+		/**
+		 * \brief Limit the time which a send() or receive() waits (e.g. for a client which sends nothing).
+		 *
+		 * \param socket
+		 *      Connected socket.
+		 * \param milliseconds
+		 *      Timeout (0 => wait forever).
+		 */
+		static void setTimeout(int socket, unsigned int milliseconds);
+
+
+		/**
+		 * \brief Shut the connection down, so a waiting receive() returns (the socket stays open).
+		 */
+		static void shutdown(int socket);
+
+
+		/**
+		 * \brief Close a socket.
+		 */
+		static void close(int socket);
+
+	private:
+		/**
+		 * \brief Initialize the sockets of the platform once (only needed by Winsock).
+		 *
+		 * \return True if the sockets can be used.
+		 */
+		static bool init();
+	};
+}
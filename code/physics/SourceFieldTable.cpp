@@ -0,0 +1,274 @@
+﻿/**
+ * \brief Implementation of the tabulated field of the static sources (used by the cut-off gravity solver).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "SourceFieldTable.h"
+
+#include <math.h>
+#include <cmath>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "BodyState.h"
+
+using namespace pbs17;
+
+
+//! The relative error of the trilinear interpolation is about (spacing / distance)^2, i.e. a few percent at 4 samples
+const double SourceFieldTable::EXACT_SAMPLES = 4.0;
+
+
+/**
+ * \brief Sample the levels again if the sources or the bounds changed since the last sampling.
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param sources
+ *      Indices of the sources.
+ * \param bbMin, bbMax
+ *      Bounds of the test-particles (covered by the coarsest level).
+ * \param eps
+ *      Softening which is added to the square distance.
+ *
+ * \return True if the levels were sampled again.
+ */
+bool SourceFieldTable::update(const BodyState &bodies, const std::vector<int> &sources, const Eigen::Vector3d &bbMin,
+	const Eigen::Vector3d &bbMax, double eps) {
+	if (!hasChanged(bodies, sources, bbMin, bbMax, eps)) return false;
+
+	int cntSources = sources.size();
+	_sourceX.resize(cntSources);
+	_sourceY.resize(cntSources);
+	_sourceZ.resize(cntSources);
+	_sourceM.resize(cntSources);
+	for (int s = 0; s < cntSources; ++s) {
+		int j = sources[s];
+		_sourceX[s] = bodies.x[j];
+		_sourceY[s] = bodies.y[j];
+		_sourceZ[s] = bodies.z[j];
+		_sourceM[s] = bodies.m[j];
+	}
+
+	_bbMin = bbMin;
+	_bbMax = bbMax;
+	_eps = eps;
+	_halfSize = std::max(0.5 * (bbMax - bbMin).maxCoeff(), 1e-9);
+
+	// the coarsest level is a cube around the bounds, the nested levels halve the size around their source
+	_levels.resize(1 + cntSources * _cntLevels);
+	_levels[0].origin = 0.5 * (bbMin + bbMax) - Eigen::Vector3d::Constant(_halfSize);
+	_levels[0].spacing = 2.0 * _halfSize / (_resolution - 1);
+
+	for (int s = 0; s < cntSources; ++s) {
+		double halfSize = _halfSize;
+
+		for (int l = 0; l < _cntLevels; ++l) {
+			halfSize *= 0.5;
+
+			Level &level = _levels[1 + s * _cntLevels + l];
+			level.origin = Eigen::Vector3d(_sourceX[s], _sourceY[s], _sourceZ[s]) - Eigen::Vector3d::Constant(halfSize);
+			level.spacing = 2.0 * halfSize / (_resolution - 1);
+		}
+	}
+
+	for (unsigned int l = 0; l < _levels.size(); ++l) {
+		sample(_levels[l]);
+	}
+
+	_needsRebuild = false;
+	++_cntRebuilds;
+
+	return true;
+}
+
+
+/**
+ * \brief Interpolate the field of the sources at a position. update() has to be called before.
+ *
+ * \param x, y, z
+ *      Position.
+ * \param ax, ay, az
+ *      Output-parameter: Field at the position (only written if it's tabulated).
+ *
+ * \return False if the position is not tabulated (the field has to be summed up exactly).
+ */
+bool SourceFieldTable::lookup(double x, double y, double z, double &ax, double &ay, double &az) const {
+	if (_levels.empty()) return false;
+
+	// the finest level of all sources which contains the position
+	const Level* best = &_levels[0];
+	int bestDepth = 0;
+	double exactDistance = EXACT_SAMPLES * getFinestSpacing();
+	int cntSources = _sourceX.size();
+
+	for (int s = 0; s < cntSources; ++s) {
+		double d = std::max(std::abs(x - _sourceX[s]), std::max(std::abs(y - _sourceY[s]), std::abs(z - _sourceZ[s])));
+		if (d < exactDistance) return false;
+
+		int depth = 0;
+		double halfSize = 0.5 * _halfSize;
+		while (depth < _cntLevels && d < halfSize) {
+			++depth;
+			halfSize *= 0.5;
+		}
+
+		if (depth > bestDepth) {
+			bestDepth = depth;
+			best = &_levels[s * _cntLevels + depth];
+		}
+	}
+
+	// the coarsest level covers the bounds of the test-particles only
+	if (bestDepth == 0) {
+		double extent = 2.0 * _halfSize;
+		if (x < best->origin.x() || y < best->origin.y() || z < best->origin.z() ||
+			x > best->origin.x() + extent || y > best->origin.y() + extent || z > best->origin.z() + extent) {
+			return false;
+		}
+	}
+
+	interpolate(*best, x, y, z, ax, ay, az);
+	return true;
+}
+
+
+/**
+ * \brief Check if the sources or the bounds changed since the last sampling.
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param sources
+ *      Indices of the sources.
+ * \param bbMin, bbMax
+ *      Bounds of the test-particles.
+ * \param eps
+ *      Softening.
+ *
+ * \return True if the levels have to be sampled again.
+ */
+bool SourceFieldTable::hasChanged(const BodyState &bodies, const std::vector<int> &sources, const Eigen::Vector3d &bbMin,
+	const Eigen::Vector3d &bbMax, double eps) const {
+	if (_needsRebuild || sources.size() != _sourceX.size() || eps != _eps || bbMin != _bbMin || bbMax != _bbMax) {
+		return true;
+	}
+
+	double maxMove2 = (_tolerance * getFinestSpacing()) * (_tolerance * getFinestSpacing());
+
+	for (unsigned int s = 0; s < sources.size(); ++s) {
+		int j = sources[s];
+		double dx = bodies.x[j] - _sourceX[s];
+		double dy = bodies.y[j] - _sourceY[s];
+		double dz = bodies.z[j] - _sourceZ[s];
+
+		if (bodies.m[j] != _sourceM[s] || dx * dx + dy * dy + dz * dz > maxMove2) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/**
+ * \brief Sample the field of the sources at all samples of a level.
+ *
+ * \param level
+ *      Level with its origin and spacing (the field is written).
+ */
+void SourceFieldTable::sample(Level &level) const {
+	int res = _resolution;
+	int cntSamples = res * res * res;
+	level.field.resize(3 * cntSamples);
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(static)
+#endif
+	for (int k = 0; k < cntSamples; ++k) {
+		int ix = k % res;
+		int iy = (k / res) % res;
+		int iz = k / (res * res);
+
+		double ax, ay, az;
+		sumSources(level.origin.x() + ix * level.spacing, level.origin.y() + iy * level.spacing,
+			level.origin.z() + iz * level.spacing, ax, ay, az);
+
+		level.field[3 * k] = static_cast<float>(ax);
+		level.field[3 * k + 1] = static_cast<float>(ay);
+		level.field[3 * k + 2] = static_cast<float>(az);
+	}
+}
+
+
+/**
+ * \brief Sum up the field of all sampled sources at a position.
+ *
+ * \param x, y, z
+ *      Position.
+ * \param ax, ay, az
+ *      Output-parameter: Field at the position.
+ */
+void SourceFieldTable::sumSources(double x, double y, double z, double &ax, double &ay, double &az) const {
+	ax = 0.0;
+	ay = 0.0;
+	az = 0.0;
+
+	for (unsigned int s = 0; s < _sourceX.size(); ++s) {
+		double dx = _sourceX[s] - x;
+		double dy = _sourceY[s] - y;
+		double dz = _sourceZ[s] - z;
+		double invR = 1.0 / sqrt(dx * dx + dy * dy + dz * dz + _eps);
+		double f = _sourceM[s] * invR * invR * invR;
+
+		ax += f * dx;
+		ay += f * dy;
+		az += f * dz;
+	}
+}
+
+
+/**
+ * \brief Interpolate the field of a level trilinearly.
+ *
+ * \param level
+ *      Level which contains the position.
+ * \param x, y, z
+ *      Position.
+ * \param ax, ay, az
+ *      Output-parameter: Field at the position.
+ */
+void SourceFieldTable::interpolate(const Level &level, double x, double y, double z, double &ax, double &ay, double &az) const {
+	int res = _resolution;
+	double u[3] = {
+		(x - level.origin.x()) / level.spacing,
+		(y - level.origin.y()) / level.spacing,
+		(z - level.origin.z()) / level.spacing
+	};
+	int i[3];
+	double f[3];
+
+	for (int axis = 0; axis < 3; ++axis) {
+		i[axis] = std::min(std::max(static_cast<int>(std::floor(u[axis])), 0), res - 2);
+		f[axis] = std::min(std::max(u[axis] - i[axis], 0.0), 1.0);
+	}
+
+	ax = 0.0;
+	ay = 0.0;
+	az = 0.0;
+
+	for (int corner = 0; corner < 8; ++corner) {
+		int cx = corner & 1;
+		int cy = (corner >> 1) & 1;
+		int cz = corner >> 2;
+		double w = (cx ? f[0] : 1.0 - f[0]) * (cy ? f[1] : 1.0 - f[1]) * (cz ? f[2] : 1.0 - f[2]);
+		const float* sample = &level.field[3 * ((i[0] + cx) + res * ((i[1] + cy) + res * (i[2] + cz)))];
+
+		ax += w * sample[0];
+		ay += w * sample[1];
+		az += w * sample[2];
+	}
+}
@@ -0,0 +1,234 @@
+﻿/**
+ * \brief Implementation of the tabulated field of the static sources (used by the cut-off gravity solver).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace pbs17 {
+	class BodyState;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Nested grids which sample the field sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) of the sources (the
+	 * far-reaching bodies of the SpatialGrid), so a test-particle interpolates the field trilinearly in O(1) instead
+	 * of summing up all M sources.
+	 *
+	 * The coarsest level covers the bounds of the grid, each source has a cascade of levels of half the size around
+	 * it (the field changes fastest near the sources). A position uses the finest level which contains it. Within
+	 * the inner half of the finest level of a source and outside of the coarsest level, the field is summed up
+	 * exactly. The levels are sampled again once a source moved by more than the tolerance, its mass changed or the
+	 * bounds of the grid changed.
+	 */
+	class SourceFieldTable {
+	public:
+
+		/**
+		 * \brief Sample the levels again if the sources or the bounds changed since the last sampling.
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param sources
+		 *      Indices of the sources.
+		 * \param bbMin, bbMax
+		 *      Bounds of the test-particles (covered by the coarsest level).
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 *
+		 * \return True if the levels were sampled again.
+		 */
+		bool update(const BodyState &bodies, const std::vector<int> &sources, const Eigen::Vector3d &bbMin,
+			const Eigen::Vector3d &bbMax, double eps);
+
+
+		/**
+		 * \brief Interpolate the field of the sources at a position. update() has to be called before.
+		 *
+		 * \param x, y, z
+		 *      Position.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field at the position (only written if it's tabulated).
+		 *
+		 * \return False if the position is not tabulated (the field has to be summed up exactly).
+		 */
+		bool lookup(double x, double y, double z, double &ax, double &ay, double &az) const;
+
+
+		/**
+		 * \brief Enable or disable the table (if disabled, the cut-off solver sums up all sources).
+		 *
+		 * \param isEnabled
+		 *      True if the field of the sources is interpolated.
+		 */
+		void setIsEnabled(bool isEnabled) {
+			_isEnabled = isEnabled;
+			_needsRebuild = true;
+		}
+
+
+		/**
+		 * \brief Get if the table is enabled.
+		 *
+		 * \return True if the field of the sources is interpolated.
+		 */
+		bool getIsEnabled() const {
+			return _isEnabled;
+		}
+
+
+		/**
+		 * \brief Set the number of samples per axis of each level.
+		 *
+		 * \param resolution
+		 *      Samples per axis (at least 4).
+		 */
+		void setResolution(int resolution) {
+			_resolution = std::max(resolution, 4);
+			_needsRebuild = true;
+		}
+
+
+		/**
+		 * \brief Set the number of nested levels around each source.
+		 *
+		 * \param cntLevels
+		 *      Levels per source (0 => only the coarsest level).
+		 */
+		void setNumLevels(int cntLevels) {
+			_cntLevels = std::max(cntLevels, 0);
+			_needsRebuild = true;
+		}
+
+
+		/**
+		 * \brief Set the distance by which a source can move before the levels are sampled again.
+		 *
+		 * \param tolerance
+		 *      Fraction of the sample-spacing of the finest level of the source.
+		 */
+		void setTolerance(double tolerance) {
+			_tolerance = tolerance;
+		}
+
+
+		/**
+		 * \brief Get the number of samplings since the start.
+		 *
+		 * \return Number of rebuilds.
+		 */
+		unsigned long getNumRebuilds() const {
+			return _cntRebuilds;
+		}
+
+
+	private:
+		/**
+		 * \brief Cube of samples (x fastest, three components per sample).
+		 */
+		struct Level {
+			//! Position of the first sample
+			Eigen::Vector3d origin;
+			//! Distance between two samples
+			double spacing;
+			//! Field per sample
+			std::vector<float> field;
+		};
+
+		//! True if the field of the sources is interpolated
+		bool _isEnabled = false;
+		//! Samples per axis of each level
+		int _resolution = 32;
+		//! Nested levels around each source
+		int _cntLevels = 4;
+		//! Movement of a source which samples the levels again (fraction of the spacing of its finest level)
+		double _tolerance = 0.25;
+
+		//! True if the levels have to be sampled by the next update()
+		bool _needsRebuild = true;
+		//! Number of samplings since the start
+		unsigned long _cntRebuilds = 0;
+
+		//! Coarsest level, then the nested levels of each source (finer ones last)
+		std::vector<Level> _levels;
+		//! Sampled positions, masses and bounds of the sources
+		std::vector<double> _sourceX, _sourceY, _sourceZ, _sourceM;
+		//! Half the size of the coarsest level
+		double _halfSize = 0.0;
+		//! Bounds and softening of the sampling
+		Eigen::Vector3d _bbMin, _bbMax;
+		double _eps = 0.0;
+
+		//! Distance to a source (in samples of its finest level) within which the field is summed up exactly
+		static const double EXACT_SAMPLES;
+
+
+		/**
+		 * \brief Check if the sources or the bounds changed since the last sampling.
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param sources
+		 *      Indices of the sources.
+		 * \param bbMin, bbMax
+		 *      Bounds of the test-particles.
+		 * \param eps
+		 *      Softening.
+		 *
+		 * \return True if the levels have to be sampled again.
+		 */
+		bool hasChanged(const BodyState &bodies, const std::vector<int> &sources, const Eigen::Vector3d &bbMin,
+			const Eigen::Vector3d &bbMax, double eps) const;
+
+
+		/**
+		 * \brief Get the distance between two samples of the finest level of a source.
+		 *
+		 * \return Spacing of the finest level.
+		 */
+		double getFinestSpacing() const {
+			return 2.0 * std::ldexp(_halfSize, -_cntLevels) / (_resolution - 1);
+		}
+
+
+		/**
+		 * \brief Sample the field of the sources at all samples of a level.
+		 *
+		 * \param level
+		 *      Level with its origin and spacing (the field is written).
+		 */
+		void sample(Level &level) const;
+
+
+		/**
+		 * \brief Sum up the field of all sampled sources at a position.
+		 *
+		 * \param x, y, z
+		 *      Position.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field at the position.
+		 */
+		void sumSources(double x, double y, double z, double &ax, double &ay, double &az) const;
+
+
+		/**
+		 * \brief Interpolate the field of a level trilinearly.
+		 *
+		 * \param level
+		 *      Level which contains the position.
+		 * \param x, y, z
+		 *      Position.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field at the position.
+		 */
+		void interpolate(const Level &level, double x, double y, double z, double &ax, double &ay, double &az) const;
+	};
+}
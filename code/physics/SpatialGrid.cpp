@@ -0,0 +1,688 @@
+﻿/**
+ * \brief Implementation of the uniform cell-list used by the cut-off gravity solver.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#include "SpatialGrid.h"
+
+#include <math.h>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "BodyState.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	/**
+	 * \brief Newtonian pair-factor 1 / (r^2 + eps)^(3/2).
+	 */
+	struct NewtonKernel {
+		double eps;
+
+		explicit NewtonKernel(double eps) : eps(eps) {}
+
+		double operator()(double r2) const {
+			double invR = 1.0 / sqrt(r2 + eps);
+			return invR * invR * invR;
+		}
+	};
+
+
+	/**
+	 * \brief Newtonian pair-factor within the cut-off (zero outside of it).
+	 */
+	struct NearFieldKernel {
+		double eps;
+		double cutoff2;
+
+		NearFieldKernel(double eps, double cutoff) : eps(eps), cutoff2(cutoff * cutoff) {}
+
+		double operator()(double r2) const {
+			if (r2 >= cutoff2) return 0.0;
+
+			double invR = 1.0 / sqrt(r2 + eps);
+			return invR * invR * invR;
+		}
+	};
+
+
+	/**
+	 * \brief Short-range pair-factor of the gaussian force-split (zero outside of the cut-off).
+	 */
+	struct ShortRangeKernel {
+		double eps;
+		double splitRadius;
+		double cutoff2;
+		double invSqrtPi;
+
+		ShortRangeKernel(double eps, double splitRadius, double cutoff)
+			: eps(eps), splitRadius(splitRadius), cutoff2(cutoff * cutoff), invSqrtPi(1.0 / sqrt(3.14159265358979323846)) {}
+
+		double operator()(double r2) const {
+			if (r2 >= cutoff2) return 0.0;
+
+			double r = sqrt(r2);
+			double x = r / (2.0 * splitRadius);
+			double invR = 1.0 / sqrt(r2 + eps);
+			double split = std::erfc(x) + (r * invSqrtPi / splitRadius) * exp(-x * x);
+
+			return invR * invR * invR * split;
+		}
+	};
+
+
+	/**
+	 * \brief Newtonian pair-potential -1 / (r^2 + eps)^(1/2).
+	 */
+	struct NewtonPotentialKernel {
+		double eps;
+
+		explicit NewtonPotentialKernel(double eps) : eps(eps) {}
+
+		double operator()(double r2) const {
+			return -1.0 / sqrt(r2 + eps);
+		}
+	};
+
+
+	/**
+	 * \brief Short-range pair-potential of the gaussian force-split (zero outside of the cut-off).
+	 */
+	struct ShortRangePotentialKernel {
+		double eps;
+		double splitRadius;
+		double cutoff2;
+
+		ShortRangePotentialKernel(double eps, double splitRadius, double cutoff)
+			: eps(eps), splitRadius(splitRadius), cutoff2(cutoff * cutoff) {}
+
+		double operator()(double r2) const {
+			if (r2 >= cutoff2) return 0.0;
+
+			return -std::erfc(sqrt(r2) / (2.0 * splitRadius)) / sqrt(r2 + eps);
+		}
+	};
+}
+
+
+/**
+ * \brief Constructor of the spatial-grid.
+ */
+SpatialGrid::SpatialGrid()
+	: _bbMin(0.0, 0.0, 0.0), _bbMax(0.0, 0.0, 0.0), _resolutionSize(1, 1, 1), _cellSize(1.0, 1.0, 1.0) {}
+
+
+/**
+ * \brief Update the grid to the current positions. The cells are only rebuilt if at least one body
+ *        changed its cell, and the bounds are enlarged if a body leaves them.
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param G
+ *      Gravitational constant (used for the influence radius).
+ */
+void SpatialGrid::update(const BodyState &bodies, double G) {
+	int n = bodies.size();
+
+	if (static_cast<unsigned int>(n) != _numBodies) {
+		_needsRebuild = true;
+	}
+
+	if (!_needsRebuild) {
+		int hasChanged = 0;
+		int isOutside = 0;
+		std::vector<int> newCells(_cellOfBody);
+
+#if defined(_OPENMP)
+#pragma omp parallel for reduction(|:hasChanged, isOutside)
+#endif
+		for (int i = 0; i < n; ++i) {
+			if (_cellOfBody[i] < 0) continue; // far-reaching bodies are not binned
+
+			int cell = getCellIndex(bodies.x[i], bodies.y[i], bodies.z[i]);
+			if (cell < 0) {
+				isOutside |= 1;
+			} else if (cell != _cellOfBody[i]) {
+				newCells[i] = cell;
+				hasChanged |= 1;
+			}
+		}
+
+		if (isOutside) {
+			// at least one body left the bounds => grow the grid
+			_needsRebuild = true;
+		} else if (hasChanged || _needsSort) {
+			_cellOfBody.swap(newCells);
+			sortIntoCells();
+		}
+	}
+
+	if (_needsRebuild) {
+		rebuild(bodies, G);
+	}
+}
+
+
+/**
+ * \brief Calculate the field sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) of all bodies within the
+ *        neighbouring cells and of all far-reaching bodies. update() has to be called before.
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ */
+void SpatialGrid::computeFields(const BodyState &bodies, double eps, std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az) const {
+	// the table is sampled with the softening of the field (only the static sources trigger a new sampling)
+	const SourceFieldTable* table = nullptr;
+	if (_sourceTable.getIsEnabled()) {
+		_sourceTable.update(bodies, _farBodies, _bbMin, _bbMax, eps);
+		table = &_sourceTable;
+	}
+
+	accumulateFields(bodies, NewtonKernel(eps), ax, ay, az, table);
+}
+
+
+/**
+ * \brief Calculate the newtonian field of each pair within the cut-off radius (the near-field of the reused forces,
+ *        see NBodyManager::setForceReuseInterval()). The cell-size has to be at least the cut-off radius
+ *        (setCutoffRadius()).
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param cutoff
+ *      Pairs with a larger distance do not contribute.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ */
+void SpatialGrid::computeNearFields(const BodyState &bodies, double eps, double cutoff,
+	std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az) const {
+	accumulateFields(bodies, NearFieldKernel(eps, cutoff), ax, ay, az, nullptr);
+}
+
+
+/**
+ * \brief Calculate the short-range part of the field of a P3M-solver: The newtonian field of each pair within
+ *        the cut-off radius, multiplied by erfc(r / 2r_s) + r / (r_s sqrt(pi)) exp(-r^2 / 4r_s^2). The cell-size
+ *        has to be at least the cut-off radius (setCutoffRadius()).
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param splitRadius
+ *      Split-radius r_s between the short- and long-range part.
+ * \param cutoff
+ *      Pairs with a larger distance do not contribute.
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ */
+void SpatialGrid::computeShortRangeFields(const BodyState &bodies, double eps, double splitRadius, double cutoff,
+	std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az) const {
+	accumulateFields(bodies, ShortRangeKernel(eps, splitRadius, cutoff), ax, ay, az, nullptr);
+}
+
+
+/**
+ * \brief Calculate the softened potential -sum_j(m_j / (|d_ij|^2 + eps)^(1/2)) of the same pairs as computeFields()
+ *        (neighbouring cells and far-reaching bodies), e.g. for the diagnostics of the energy.
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param phi
+ *      Output-parameter: Potential per body (overwritten).
+ */
+void SpatialGrid::computePotentials(const BodyState &bodies, double eps, std::vector<double> &phi) const {
+	accumulatePotentials(bodies, NewtonPotentialKernel(eps), phi);
+}
+
+
+/**
+ * \brief Calculate the short-range part of the potential of a P3M-solver: -erfc(r / 2r_s) / (r^2 + eps)^(1/2) of
+ *        each pair within the cut-off radius (the potential of computeShortRangeFields()).
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param eps
+ *      Softening which is added to the square distance.
+ * \param splitRadius
+ *      Split-radius r_s between the short- and long-range part.
+ * \param cutoff
+ *      Pairs with a larger distance do not contribute.
+ * \param phi
+ *      Output-parameter: Potential per body (overwritten).
+ */
+void SpatialGrid::computeShortRangePotentials(const BodyState &bodies, double eps, double splitRadius, double cutoff,
+	std::vector<double> &phi) const {
+	accumulatePotentials(bodies, ShortRangePotentialKernel(eps, splitRadius, cutoff), phi);
+}
+
+
+/**
+ * \brief Accumulate the field of all bodies within the neighbouring cells and of all far-reaching bodies.
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param kernel
+ *      Functor which returns the factor s(r^2) of a pair (the field of the pair is m_j * s * d_ij).
+ * \param ax, ay, az
+ *      Output-parameter: Field per body (overwritten).
+ * \param table
+ *      Tabulated field of the far-reaching bodies for the binned bodies (nullptr => summed up).
+ */
+template<typename PairKernel>
+void SpatialGrid::accumulateFields(const BodyState &bodies, const PairKernel &kernel, std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az,
+	const SourceFieldTable* table) const {
+	int n = bodies.size();
+	ax.assign(n, 0.0);
+	ay.assign(n, 0.0);
+	az.assign(n, 0.0);
+
+	const double* x = bodies.x.data();
+	const double* y = bodies.y.data();
+	const double* z = bodies.z.data();
+	const double* m = bodies.m.data();
+
+	int cntFar = _farBodies.size();
+	int cntActive = _activeCells.size();
+	int resX = _resolutionSize(0);
+	int resY = _resolutionSize(1);
+	int resZ = _resolutionSize(2);
+
+	// the receivers are either the bodies of a cell (cellIndex >= 0) or a far-reaching body
+	int cntTasks = cntActive + cntFar;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 4)
+#endif
+	for (int t = 0; t < cntTasks; ++t) {
+		int cell;
+		int first, last;
+		int farBody = -1;
+
+		if (t < cntActive) {
+			cell = _activeCells[t];
+			first = _cellStart[cell];
+			last = _cellStart[cell + 1];
+		} else {
+			farBody = _farBodies[t - cntActive];
+			cell = getCellIndex(x[farBody], y[farBody], z[farBody]);
+			first = 0;
+			last = 1;
+		}
+
+		int cx = -1, cy = -1, cz = -1;
+		if (cell >= 0) {
+			cx = cell % resX;
+			cy = (cell / resX) % resY;
+			cz = cell / (resX * resY);
+		}
+
+		for (int k = first; k < last; ++k) {
+			int i = farBody >= 0 ? farBody : _cellBodies[k];
+			double sx = 0.0, sy = 0.0, sz = 0.0;
+
+			// binned bodies in the neighbouring cells (the test-particles do not attract the sources)
+			if (cell >= 0 && (farBody < 0 || !_useTestParticles)) {
+				for (int iz = std::max(cz - 1, 0); iz <= std::min(cz + 1, resZ - 1); ++iz) {
+					for (int iy = std::max(cy - 1, 0); iy <= std::min(cy + 1, resY - 1); ++iy) {
+						for (int ix = std::max(cx - 1, 0); ix <= std::min(cx + 1, resX - 1); ++ix) {
+							int neighbour = ix + resX * (iy + resY * iz);
+
+							for (int l = _cellStart[neighbour]; l < _cellStart[neighbour + 1]; ++l) {
+								int j = _cellBodies[l];
+								double dx = x[j] - x[i];
+								double dy = y[j] - y[i];
+								double dz = z[j] - z[i];
+
+								// the body itself has a distance of zero and does not contribute
+								double s = m[j] * kernel(dx * dx + dy * dy + dz * dz);
+
+								sx += s * dx;
+								sy += s * dy;
+								sz += s * dz;
+							}
+						}
+					}
+				}
+			}
+
+			// far-reaching bodies have an influence everywhere (interpolated from the table away from them)
+			double tx, ty, tz;
+			if (table && farBody < 0 && table->lookup(x[i], y[i], z[i], tx, ty, tz)) {
+				sx += tx;
+				sy += ty;
+				sz += tz;
+			} else {
+				for (int f = 0; f < cntFar; ++f) {
+					int j = _farBodies[f];
+					double dx = x[j] - x[i];
+					double dy = y[j] - y[i];
+					double dz = z[j] - z[i];
+
+					double s = m[j] * kernel(dx * dx + dy * dy + dz * dz);
+
+					sx += s * dx;
+					sy += s * dy;
+					sz += s * dz;
+				}
+			}
+
+			ax[i] = sx;
+			ay[i] = sy;
+			az[i] = sz;
+		}
+	}
+}
+
+
+/**
+ * \brief Accumulate the potential of all bodies within the neighbouring cells and of all far-reaching bodies
+ *        (same pairs as accumulateFields(), without the body itself).
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param kernel
+ *      Functor which returns the potential p(r^2) of a pair per mass (the potential of the pair is m_j * p).
+ * \param phi
+ *      Output-parameter: Potential per body (overwritten).
+ */
+template<typename PairKernel>
+void SpatialGrid::accumulatePotentials(const BodyState &bodies, const PairKernel &kernel, std::vector<double> &phi) const {
+	int n = bodies.size();
+	phi.assign(n, 0.0);
+
+	const double* x = bodies.x.data();
+	const double* y = bodies.y.data();
+	const double* z = bodies.z.data();
+	const double* m = bodies.m.data();
+
+	int cntFar = _farBodies.size();
+	int cntActive = _activeCells.size();
+	int resX = _resolutionSize(0);
+	int resY = _resolutionSize(1);
+	int resZ = _resolutionSize(2);
+
+	int cntTasks = cntActive + cntFar;
+
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 4)
+#endif
+	for (int t = 0; t < cntTasks; ++t) {
+		int cell;
+		int first, last;
+		int farBody = -1;
+
+		if (t < cntActive) {
+			cell = _activeCells[t];
+			first = _cellStart[cell];
+			last = _cellStart[cell + 1];
+		} else {
+			farBody = _farBodies[t - cntActive];
+			cell = getCellIndex(x[farBody], y[farBody], z[farBody]);
+			first = 0;
+			last = 1;
+		}
+
+		int cx = -1, cy = -1, cz = -1;
+		if (cell >= 0) {
+			cx = cell % resX;
+			cy = (cell / resX) % resY;
+			cz = cell / (resX * resY);
+		}
+
+		for (int k = first; k < last; ++k) {
+			int i = farBody >= 0 ? farBody : _cellBodies[k];
+			double sum = 0.0;
+
+			if (cell >= 0 && (farBody < 0 || !_useTestParticles)) {
+				for (int iz = std::max(cz - 1, 0); iz <= std::min(cz + 1, resZ - 1); ++iz) {
+					for (int iy = std::max(cy - 1, 0); iy <= std::min(cy + 1, resY - 1); ++iy) {
+						for (int ix = std::max(cx - 1, 0); ix <= std::min(cx + 1, resX - 1); ++ix) {
+							int neighbour = ix + resX * (iy + resY * iz);
+
+							for (int l = _cellStart[neighbour]; l < _cellStart[neighbour + 1]; ++l) {
+								int j = _cellBodies[l];
+								if (j == i) continue;
+
+								double dx = x[j] - x[i];
+								double dy = y[j] - y[i];
+								double dz = z[j] - z[i];
+
+								sum += m[j] * kernel(dx * dx + dy * dy + dz * dz);
+							}
+						}
+					}
+				}
+			}
+
+			for (int f = 0; f < cntFar; ++f) {
+				int j = _farBodies[f];
+				if (j == i) continue;
+
+				double dx = x[j] - x[i];
+				double dy = y[j] - y[i];
+				double dz = z[j] - z[i];
+
+				sum += m[j] * kernel(dx * dx + dy * dy + dz * dz);
+			}
+
+			phi[i] = sum;
+		}
+	}
+}
+
+
+/**
+ * \brief Classify the bodies (far-reaching or binned) and set the bounds and the resolution.
+ *
+ * \param bodies
+ *      State of all bodies.
+ * \param G
+ *      Gravitational constant.
+ */
+void SpatialGrid::rebuild(const BodyState &bodies, double G) {
+	unsigned int n = bodies.size();
+	_numBodies = n;
+	_needsRebuild = false;
+	_cellOfBody.assign(n, -1);
+	_farBodies.clear();
+
+	if (n == 0) {
+		_cellStart.assign(2, 0);
+		_cellBodies.clear();
+		_activeCells.clear();
+		return;
+	}
+
+	// Radius outside of which the acceleration of the body is below the threshold
+	std::vector<double> influence(n);
+	for (unsigned int i = 0; i < n; ++i) {
+		influence[i] = sqrt(std::max(G * bodies.m[i], 0.0) / _threshold);
+	}
+
+	_activeCutoff = _cutoffRadius;
+	if (_activeCutoff <= 0.0) {
+		std::vector<double> sorted(influence);
+		std::nth_element(sorted.begin(), sorted.begin() + n / 2, sorted.end());
+		_activeCutoff = 2.0 * sorted[n / 2];
+	}
+	_activeCutoff = std::max(_activeCutoff, 1e-9);
+
+	double max = std::numeric_limits<double>::max();
+	Eigen::Vector3d bbMax = Eigen::Vector3d(-max, -max, -max);
+	Eigen::Vector3d bbMin = Eigen::Vector3d(max, max, max);
+	bool hasBinned = false;
+
+	// without flags (e.g. bodies which were not gathered), all bodies are sources
+	std::vector<char> isFar(n);
+	bool hasFlags = bodies.testParticle.size() == n;
+	for (unsigned int i = 0; i < n; ++i) {
+		isFar[i] = _useTestParticles ? !hasFlags || !bodies.testParticle[i] : influence[i] > _activeCutoff;
+	}
+
+	for (unsigned int i = 0; i < n; ++i) {
+		if (isFar[i]) {
+			_farBodies.push_back(i);
+		} else {
+			bbMax = bbMax.cwiseMax(bodies.getPosition(i));
+			bbMin = bbMin.cwiseMin(bodies.getPosition(i));
+			hasBinned = true;
+		}
+	}
+
+	if (!hasBinned) {
+		bbMin = bbMax = Eigen::Vector3d(0.0, 0.0, 0.0);
+	}
+
+	// Enlarge the bounds, so that the grid has not to be rebuilt as soon as a body moves
+	Eigen::Vector3d center = (bbMax + bbMin) * 0.5;
+	Eigen::Vector3d halfSize = ((bbMax - bbMin) * 0.5).cwiseMax(Eigen::Vector3d(_activeCutoff, _activeCutoff, _activeCutoff));
+	_bbMin = center - 2.0 * halfSize;
+	_bbMax = center + 2.0 * halfSize;
+	Eigen::Vector3d bbDim = _bbMax - _bbMin;
+
+	for (int d = 0; d < 3; ++d) {
+		// cells are at least as large as the cut-off radius
+		int res = static_cast<int>(bbDim(d) / _activeCutoff);
+		_resolutionSize(d) = std::max(1, std::min(res, _maxResolution));
+		_cellSize(d) = bbDim(d) / static_cast<double>(_resolutionSize(d));
+	}
+
+	for (unsigned int i = 0; i < n; ++i) {
+		if (!isFar[i]) {
+			_cellOfBody[i] = getCellIndex(bodies.x[i], bodies.y[i], bodies.z[i]);
+		}
+	}
+
+	sortIntoCells();
+}
+
+
+/**
+ * \brief Bin the last body after it was added (see BodyState::add()), the cells are sorted again by the
+ *        next update(). A body outside of the bounds rebuilds the grid.
+ *
+ * \param bodies
+ *      State of all bodies (with the new body).
+ * \param G
+ *      Gravitational constant (used for the influence radius).
+ */
+void SpatialGrid::addBody(const BodyState &bodies, double G) {
+	unsigned int i = bodies.size() - 1;
+
+	if (_needsRebuild || _numBodies != i) {
+		_needsRebuild = true;
+		return;
+	}
+
+	// same classification as rebuild() with the current cut-off
+	double influence = sqrt(std::max(G * bodies.m[i], 0.0) / _threshold);
+	bool hasFlags = bodies.testParticle.size() == bodies.size();
+	bool isFar = _useTestParticles ? !hasFlags || !bodies.testParticle[i] : influence > _activeCutoff;
+	int cell = isFar ? -1 : getCellIndex(bodies.x[i], bodies.y[i], bodies.z[i]);
+
+	if (!isFar && cell < 0) {
+		_needsRebuild = true;
+		return;
+	}
+
+	if (isFar) {
+		_farBodies.push_back(i);
+	}
+	_cellOfBody.push_back(cell);
+	++_numBodies;
+	_needsSort = true;
+}
+
+
+/**
+ * \brief Remove a body in the same way as BodyState::remove(), the cells are sorted again by the next update().
+ *
+ * \param i
+ *      Index of the removed body.
+ */
+void SpatialGrid::removeBody(unsigned int i) {
+	if (_needsRebuild || i >= _numBodies) {
+		_needsRebuild = true;
+		return;
+	}
+
+	int last = _numBodies - 1;
+	BodyState::removeFromArray(_cellOfBody, i);
+	_farBodies.erase(std::remove(_farBodies.begin(), _farBodies.end(), static_cast<int>(i)), _farBodies.end());
+	std::replace(_farBodies.begin(), _farBodies.end(), last, static_cast<int>(i));
+	--_numBodies;
+	_needsSort = true;
+}
+
+
+/**
+ * \brief Sort the binned bodies into the flat cell-arrays (counting-sort).
+ */
+void SpatialGrid::sortIntoCells() {
+	_needsSort = false;
+	int cntCells = _resolutionSize(0) * _resolutionSize(1) * _resolutionSize(2);
+	_cellStart.assign(cntCells + 1, 0);
+
+	for (unsigned int i = 0; i < _cellOfBody.size(); ++i) {
+		if (_cellOfBody[i] >= 0) {
+			++_cellStart[_cellOfBody[i] + 1];
+		}
+	}
+
+	_activeCells.clear();
+	for (int c = 0; c < cntCells; ++c) {
+		if (_cellStart[c + 1] > 0) {
+			_activeCells.push_back(c);
+		}
+		_cellStart[c + 1] += _cellStart[c];
+	}
+
+	_cellBodies.resize(_cellStart[cntCells]);
+	std::vector<int> fill(_cellStart.begin(), _cellStart.end() - 1);
+
+	for (unsigned int i = 0; i < _cellOfBody.size(); ++i) {
+		if (_cellOfBody[i] >= 0) {
+			_cellBodies[fill[_cellOfBody[i]]++] = i;
+		}
+	}
+}
+
+
+/**
+ * \brief Get the cell for a position.
+ *
+ * \param x, y, z
+ *      Position.
+ *
+ * \return Index of the cell (-1 if outside of the bounds).
+ */
+int SpatialGrid::getCellIndex(double x, double y, double z) const {
+	int ix = static_cast<int>(floor((x - _bbMin(0)) / _cellSize(0)));
+	int iy = static_cast<int>(floor((y - _bbMin(1)) / _cellSize(1)));
+	int iz = static_cast<int>(floor((z - _bbMin(2)) / _cellSize(2)));
+
+	if (ix < 0 || iy < 0 || iz < 0 || ix >= _resolutionSize(0) || iy >= _resolutionSize(1) || iz >= _resolutionSize(2)) {
+		return -1;
+	}
+
+	return ix + _resolutionSize(0) * (iy + _resolutionSize(1) * iz);
+}
@@ -0,0 +1,397 @@
+﻿/**
+ * \brief Implementation of the uniform cell-list used by the cut-off gravity solver.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#pragma once
+
+#include <Eigen/Core>
+#include <vector>
+
+#include "SourceFieldTable.h"
+
+namespace pbs17 {
+	class BodyState;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Uniform grid with flat per-cell index arrays (cell-list).
+	 *
+	 * Each body has an influence radius sqrt(G * m / threshold), outside of which its acceleration is below
+	 * the threshold. Bodies with a radius larger than the cut-off radius (suns, planets) are far-reaching and
+	 * summed up for all bodies. All other bodies are binned into cells of at least the cut-off radius, so only
+	 * the 27 neighbouring cells have to be visited per body.
+	 *
+	 * With test-particles (setUseTestParticles()), the bodies which are flagged as test-particles are binned and
+	 * all others are the massive sources (far-reaching). The sources only feel each other (a frozen background for
+	 * the light bodies), so the field costs O(N * M) for M sources instead of O(N^2). With the source-table
+	 * (getSourceTable()), the binned bodies interpolate the field of the far-reaching bodies in O(1).
+	 */
+	class SpatialGrid {
+	public:
+		/**
+		 * \brief Constructor of the spatial-grid.
+		 */
+		SpatialGrid();
+
+
+		/**
+		 * \brief Update the grid to the current positions. The cells are only rebuilt if at least one body
+		 *        changed its cell, and the bounds are enlarged if a body leaves them.
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param G
+		 *      Gravitational constant (used for the influence radius).
+		 */
+		void update(const BodyState &bodies, double G);
+
+
+		/**
+		 * \brief Calculate the field sum_j(m_j * d_ij / (|d_ij|^2 + eps)^(3/2)) of all bodies within the
+		 *        neighbouring cells and of all far-reaching bodies. update() has to be called before.
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 */
+		void computeFields(const BodyState &bodies, double eps, std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az) const;
+
+
+		/**
+		 * \brief Calculate the newtonian field of each pair within the cut-off radius (the near-field of the reused forces,
+		 *        see NBodyManager::setForceReuseInterval()). The cell-size has to be at least the cut-off radius
+		 *        (setCutoffRadius()).
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param cutoff
+		 *      Pairs with a larger distance do not contribute.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 */
+		void computeNearFields(const BodyState &bodies, double eps, double cutoff,
+			std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az) const;
+
+
+		/**
+		 * \brief Calculate the short-range part of the field of a P3M-solver: The newtonian field of each pair within
+		 *        the cut-off radius, multiplied by erfc(r / 2r_s) + r / (r_s sqrt(pi)) exp(-r^2 / 4r_s^2). The cell-size
+		 *        has to be at least the cut-off radius (setCutoffRadius()).
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param splitRadius
+		 *      Split-radius r_s between the short- and long-range part.
+		 * \param cutoff
+		 *      Pairs with a larger distance do not contribute.
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 */
+		void computeShortRangeFields(const BodyState &bodies, double eps, double splitRadius, double cutoff,
+			std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az) const;
+
+
+		/**
+		 * \brief Calculate the softened potential -sum_j(m_j / (|d_ij|^2 + eps)^(1/2)) of the same pairs as computeFields()
+		 *        (neighbouring cells and far-reaching bodies), e.g. for the diagnostics of the energy.
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param phi
+		 *      Output-parameter: Potential per body (overwritten).
+		 */
+		void computePotentials(const BodyState &bodies, double eps, std::vector<double> &phi) const;
+
+
+		/**
+		 * \brief Calculate the short-range part of the potential of a P3M-solver: -erfc(r / 2r_s) / (r^2 + eps)^(1/2) of
+		 *        each pair within the cut-off radius (the potential of computeShortRangeFields()).
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param eps
+		 *      Softening which is added to the square distance.
+		 * \param splitRadius
+		 *      Split-radius r_s between the short- and long-range part.
+		 * \param cutoff
+		 *      Pairs with a larger distance do not contribute.
+		 * \param phi
+		 *      Output-parameter: Potential per body (overwritten).
+		 */
+		void computeShortRangePotentials(const BodyState &bodies, double eps, double splitRadius, double cutoff,
+			std::vector<double> &phi) const;
+
+
+		/**
+		 * \brief Set the acceleration below which the influence of a body is neglected.
+		 *
+		 * \param threshold
+		 *      Acceleration-threshold.
+		 */
+		void setThreshold(const double threshold) {
+			_threshold = threshold;
+			_needsRebuild = true;
+		}
+
+
+		/**
+		 * \brief Set the cut-off radius. Bodies with a larger influence radius are far-reaching.
+		 *
+		 * \param cutoffRadius
+		 *      Cut-off radius (<= 0.0 => derived from the median mass).
+		 */
+		void setCutoffRadius(const double cutoffRadius) {
+			_cutoffRadius = cutoffRadius;
+			_needsRebuild = true;
+		}
+
+
+		/**
+		 * \brief Set the maximum number of cells per axis. If the bounds get larger, the cells get larger as well.
+		 *
+		 * \param maxResolution
+		 *      Maximum number of cells per axis.
+		 */
+		void setMaxResolution(const int maxResolution) {
+			_maxResolution = maxResolution;
+			_needsRebuild = true;
+		}
+
+
+		/**
+		 * \brief Classify the bodies by their flag (BodyState::testParticle) instead of their influence radius: the
+		 *        test-particles feel the sources and the test-particles of the neighbouring cells, the sources only
+		 *        feel each other.
+		 *
+		 * \param useTestParticles
+		 *      True to let the test-particles feel the sources without attracting them.
+		 */
+		void setUseTestParticles(const bool useTestParticles) {
+			_needsRebuild |= _useTestParticles != useTestParticles;
+			_useTestParticles = useTestParticles;
+		}
+
+
+		/**
+		 * \brief Get the tabulated field of the far-reaching bodies (sampled by computeFields() if it's enabled).
+		 *
+		 * \return Source-table.
+		 */
+		SourceFieldTable& getSourceTable() {
+			return _sourceTable;
+		}
+
+
+		/**
+		 * \brief Rebuild the grid by the next update(), e.g. after the bodies were reordered (the cells and the
+		 *        far-reaching bodies are stored per index).
+		 */
+		void invalidate() {
+			_needsRebuild = true;
+		}
+
+
+		/**
+		 * \brief Bin the last body after it was added (see BodyState::add()), the cells are sorted again by the
+		 *        next update(). A body outside of the bounds rebuilds the grid.
+		 *
+		 * \param bodies
+		 *      State of all bodies (with the new body).
+		 * \param G
+		 *      Gravitational constant (used for the influence radius).
+		 */
+		void addBody(const BodyState &bodies, double G);
+
+
+		/**
+		 * \brief Remove a body in the same way as BodyState::remove(), the cells are sorted again by the next update().
+		 *
+		 * \param i
+		 *      Index of the removed body.
+		 */
+		void removeBody(unsigned int i);
+
+
+		/**
+		 * \brief Get the cell of a body.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 *
+		 * \return Index of the cell or -1 if the body is far-reaching (not binned).
+		 */
+		int getCell(unsigned int i) const {
+			return _cellOfBody[i];
+		}
+
+
+		/**
+		 * \brief Get the number of bodies the grid was built for.
+		 *
+		 * \return Number of bodies.
+		 */
+		unsigned int getNumBodies() const {
+			return _numBodies;
+		}
+
+
+		/**
+		 * \brief Get the number of cells per axis.
+		 *
+		 * \return Resolution of the grid.
+		 */
+		const Eigen::Vector3i& getResolution() const {
+			return _resolutionSize;
+		}
+
+
+		/**
+		 * \brief Get the size of the cells.
+		 *
+		 * \return Size of a cell per axis.
+		 */
+		const Eigen::Vector3d& getCellSize() const {
+			return _cellSize;
+		}
+
+
+		/**
+		 * \brief Get the first entry in getCellBodies() per cell (size = cells + 1).
+		 *
+		 * \return Start of each cell.
+		 */
+		const std::vector<int>& getCellStarts() const {
+			return _cellStart;
+		}
+
+
+		/**
+		 * \brief Get the indices of the binned bodies, sorted by cell.
+		 *
+		 * \return Bodies of all cells.
+		 */
+		const std::vector<int>& getCellBodies() const {
+			return _cellBodies;
+		}
+
+
+	private:
+		//! Acceleration below which the influence of a body is neglected
+		double _threshold = 0.1;
+
+		//! Cut-off radius (<= 0.0 => derived from the median mass)
+		double _cutoffRadius = 0.0;
+		//! Cut-off radius which is currently used
+		double _activeCutoff = 0.0;
+
+		//! Maximum number of cells per axis
+		int _maxResolution = 64;
+
+		//! True if the flagged test-particles are binned and all other bodies are sources
+		bool _useTestParticles = false;
+
+		//! Bounding-box of the grid
+		Eigen::Vector3d _bbMin;
+		Eigen::Vector3d _bbMax;
+
+		//! Number of cells per axis and size of each cell
+		Eigen::Vector3i _resolutionSize;
+		Eigen::Vector3d _cellSize;
+
+		//! True if the masses, bounds or parameters changed and everything needs to be recomputed
+		bool _needsRebuild = true;
+		//! True if bodies were added or removed since the cells were sorted
+		bool _needsSort = false;
+
+		//! Number of bodies the grid was built for
+		unsigned int _numBodies = 0;
+
+		//! Cell per body (-1 => far-reaching)
+		std::vector<int> _cellOfBody;
+		//! First entry in _cellBodies per cell (size = cells + 1)
+		std::vector<int> _cellStart;
+		//! Indices of the binned bodies, sorted by cell
+		std::vector<int> _cellBodies;
+		//! Indices of the far-reaching bodies
+		std::vector<int> _farBodies;
+		//! Non-empty cells (used for the parallelization over cells)
+		std::vector<int> _activeCells;
+
+		//! Tabulated field of the far-reaching bodies (sampled by computeFields() with its softening)
+		mutable SourceFieldTable _sourceTable;
+
+
+		/**
+		 * \brief Accumulate the field of all bodies within the neighbouring cells and of all far-reaching bodies.
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param kernel
+		 *      Functor which returns the factor s(r^2) of a pair (the field of the pair is m_j * s * d_ij).
+		 * \param ax, ay, az
+		 *      Output-parameter: Field per body (overwritten).
+		 * \param table
+		 *      Tabulated field of the far-reaching bodies for the binned bodies (nullptr => summed up).
+		 */
+		template<typename PairKernel>
+		void accumulateFields(const BodyState &bodies, const PairKernel &kernel, std::vector<double> &ax, std::vector<double> &ay, std::vector<double> &az,
+			const SourceFieldTable* table) const;
+
+
+		/**
+		 * \brief Accumulate the potential of all bodies within the neighbouring cells and of all far-reaching bodies
+		 *        (same pairs as accumulateFields(), without the body itself).
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param kernel
+		 *      Functor which returns the potential p(r^2) of a pair per mass (the potential of the pair is m_j * p).
+		 * \param phi
+		 *      Output-parameter: Potential per body (overwritten).
+		 */
+		template<typename PairKernel>
+		void accumulatePotentials(const BodyState &bodies, const PairKernel &kernel, std::vector<double> &phi) const;
+
+
+		/**
+		 * \brief Classify the bodies (far-reaching or binned) and set the bounds and the resolution.
+		 *
+		 * \param bodies
+		 *      State of all bodies.
+		 * \param G
+		 *      Gravitational constant.
+		 */
+		void rebuild(const BodyState &bodies, double G);
+
+
+		/**
+		 * \brief Sort the binned bodies into the flat cell-arrays (counting-sort).
+		 */
+		void sortIntoCells();
+
+
+		/**
+		 * \brief Get the cell for a position.
+		 *
+		 * \param x, y, z
+		 *      Position.
+		 *
+		 * \return Index of the cell (-1 if outside of the bounds).
+		 */
+		int getCellIndex(double x, double y, double z) const;
+	};
+}
@@ -0,0 +1,363 @@
+﻿/**
+ * \brief Implementation of the hashed uniform grid used by the broad-phase.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#include "SpatialHash.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "AabbArray.h"
+#include "SpatialGrid.h"
+#include "../scene/SpaceObject.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor of the spatial-hash.
+ */
+SpatialHash::SpatialHash() {}
+
+
+/**
+ * \brief Set the objects of the hash.
+ *
+ * \param objects
+ *      All space-objects which are checked for collisions.
+ */
+void SpatialHash::init(const std::vector<SpaceObject*> &objects) {
+	_objects = objects;
+}
+
+
+/**
+ * \brief Bin the objects into the hashed cells and get the possible collisions.
+ *
+ * \param aabbs
+ *      Swept AABBs of the objects of this step (same indices).
+ * \param res
+ *      Output-parameter: Pairs whose AABBs overlap (overwritten). By convention, on the first position the
+ *	                      object with the smaller id is stored (key.first.Id < key.second.Id).
+ */
+void SpatialHash::update(const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) {
+	int n = _objects.size();
+	res.clear();
+
+	if (n < 2) return;
+
+	setAABBs(aabbs);
+
+	double cellSize = _cellSize;
+	if (cellSize <= 0.0) {
+		std::vector<float> extents(n);
+		for (int i = 0; i < n; ++i) {
+			extents[i] = std::max(_aabbMax[0][i] - _aabbMin[0][i],
+				std::max(_aabbMax[1][i] - _aabbMin[1][i], _aabbMax[2][i] - _aabbMin[2][i]));
+		}
+
+		std::nth_element(extents.begin(), extents.begin() + n / 2, extents.end());
+		cellSize = 2.0 * extents[n / 2];
+	}
+	cellSize = std::max(cellSize, 1e-6);
+	double invCellSize = 1.0 / cellSize;
+
+	// about two buckets per object keeps the collisions of the hash rare
+	unsigned int cntBuckets = 1;
+	while (cntBuckets < 2u * static_cast<unsigned int>(n)) {
+		cntBuckets <<= 1;
+	}
+	unsigned int mask = cntBuckets - 1;
+
+	_cellOfObject.resize(3 * n);
+	_bucketOfObject.resize(n);
+	std::vector<char> isLarge(n);
+
+	// bin-pass: each object is binned by the center of its AABB
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		bool large = false;
+		for (int axis = 0; axis < 3; ++axis) {
+			large |= _aabbMax[axis][i] - _aabbMin[axis][i] > cellSize;
+
+			double center = 0.5 * (static_cast<double>(_aabbMin[axis][i]) + _aabbMax[axis][i]);
+			_cellOfObject[3 * i + axis] = static_cast<int>(floor(center * invCellSize));
+		}
+
+		isLarge[i] = large;
+		_bucketOfObject[i] = large ? -1 : getBucket(_cellOfObject[3 * i], _cellOfObject[3 * i + 1], _cellOfObject[3 * i + 2], mask);
+	}
+
+	// counting-sort into the buckets
+	_bucketStart.assign(cntBuckets + 1, 0);
+	_largeObjects.clear();
+	for (int i = 0; i < n; ++i) {
+		if (isLarge[i]) {
+			_largeObjects.push_back(i);
+		} else {
+			++_bucketStart[_bucketOfObject[i] + 1];
+		}
+	}
+
+	for (unsigned int b = 0; b < cntBuckets; ++b) {
+		_bucketStart[b + 1] += _bucketStart[b];
+	}
+
+	_bucketObjects.resize(_bucketStart[cntBuckets]);
+	std::vector<int> fill(_bucketStart.begin(), _bucketStart.end() - 1);
+	for (int i = 0; i < n; ++i) {
+		if (!isLarge[i]) {
+			_bucketObjects[fill[_bucketOfObject[i]]++] = i;
+		}
+	}
+
+	int cntThreads = 1;
+#if defined(_OPENMP)
+	cntThreads = omp_get_max_threads();
+#endif
+
+	// pairs per thread, concatenated in the order of the threads so the result is deterministic
+	std::vector<std::vector<std::pair<SpaceObject *, SpaceObject *>>> threadPairs(cntThreads);
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+	{
+		int thread = 0;
+#if defined(_OPENMP)
+		thread = omp_get_thread_num();
+#endif
+		std::vector<std::pair<SpaceObject *, SpaceObject *>> &pairs = threadPairs[thread];
+
+#if defined(_OPENMP)
+#pragma omp for schedule(static, 64)
+#endif
+		for (int i = 0; i < n; ++i) {
+			// the pairs of a sleeping object are reported by the other (awake) object
+			if (isLarge[i] || _objects[i]->isSleeping()) continue;
+
+			int cx = _cellOfObject[3 * i];
+			int cy = _cellOfObject[3 * i + 1];
+			int cz = _cellOfObject[3 * i + 2];
+
+			for (int z = cz - 1; z <= cz + 1; ++z) {
+				for (int y = cy - 1; y <= cy + 1; ++y) {
+					for (int x = cx - 1; x <= cx + 1; ++x) {
+						int bucket = getBucket(x, y, z, mask);
+
+						for (int k = _bucketStart[bucket]; k < _bucketStart[bucket + 1]; ++k) {
+							int j = _bucketObjects[k];
+
+							// each pair is reported once, and other cells in the same bucket are skipped
+							if ((j <= i && !_objects[j]->isSleeping()) || _cellOfObject[3 * j] != x || _cellOfObject[3 * j + 1] != y || _cellOfObject[3 * j + 2] != z) {
+								continue;
+							}
+
+							if (overlaps(i, j) && SpaceObject::canCollide(_objects[i], _objects[j])) {
+								pairs.push_back(makePair(i, j));
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for (int t = 0; t < cntThreads; ++t) {
+		res.insert(res.end(), threadPairs[t].begin(), threadPairs[t].end());
+	}
+
+	addLargePairs(isLarge, res);
+}
+
+
+/**
+ * \brief Get the possible collisions with the cell-lists of the gravity-grid. The grid has to be up to date
+ *        with the positions of the objects (same order as the objects).
+ *
+ * \param grid
+ *      Gravity-grid whose cells are reused.
+ * \param aabbs
+ *      Swept AABBs of the objects of this step (same indices).
+ * \param res
+ *      Output-parameter: Pairs whose AABBs overlap (overwritten).
+ */
+void SpatialHash::update(const SpatialGrid &grid, const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) {
+	int n = _objects.size();
+
+	// the grid is built for other bodies => use the own cells
+	if (grid.getNumBodies() != static_cast<unsigned int>(n)) {
+		update(aabbs, res);
+		return;
+	}
+
+	res.clear();
+
+	if (n < 2) return;
+
+	setAABBs(aabbs);
+
+	const Eigen::Vector3d &cellSize = grid.getCellSize();
+	const Eigen::Vector3i &resolution = grid.getResolution();
+	const std::vector<int> &cellStart = grid.getCellStarts();
+	const std::vector<int> &cellBodies = grid.getCellBodies();
+
+	// objects which reach further than half a cell from their position (or are not binned) are large
+	std::vector<char> isLarge(n);
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		bool large = grid.getCell(i) < 0;
+		const Eigen::Vector3d &position = _objects[i]->getPosition();
+
+		for (int axis = 0; axis < 3; ++axis) {
+			double reach = std::max(position(axis) - _aabbMin[axis][i], _aabbMax[axis][i] - position(axis));
+			large |= reach > 0.5 * cellSize(axis);
+		}
+
+		isLarge[i] = large;
+	}
+
+	int cntThreads = 1;
+#if defined(_OPENMP)
+	cntThreads = omp_get_max_threads();
+#endif
+
+	std::vector<std::vector<std::pair<SpaceObject *, SpaceObject *>>> threadPairs(cntThreads);
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+	{
+		int thread = 0;
+#if defined(_OPENMP)
+		thread = omp_get_thread_num();
+#endif
+		std::vector<std::pair<SpaceObject *, SpaceObject *>> &pairs = threadPairs[thread];
+
+#if defined(_OPENMP)
+#pragma omp for schedule(static, 64)
+#endif
+		for (int i = 0; i < n; ++i) {
+			if (isLarge[i] || _objects[i]->isSleeping()) continue;
+
+			int cell = grid.getCell(i);
+			int cx = cell % resolution(0);
+			int cy = (cell / resolution(0)) % resolution(1);
+			int cz = cell / (resolution(0) * resolution(1));
+
+			for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, resolution(2) - 1); ++z) {
+				for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, resolution(1) - 1); ++y) {
+					for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, resolution(0) - 1); ++x) {
+						int neighbour = x + resolution(0) * (y + resolution(1) * z);
+
+						for (int k = cellStart[neighbour]; k < cellStart[neighbour + 1]; ++k) {
+							int j = cellBodies[k];
+
+							if ((j > i || _objects[j]->isSleeping()) && !isLarge[j] && overlaps(i, j) && SpaceObject::canCollide(_objects[i], _objects[j])) {
+								pairs.push_back(makePair(i, j));
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for (int t = 0; t < cntThreads; ++t) {
+		res.insert(res.end(), threadPairs[t].begin(), threadPairs[t].end());
+	}
+
+	_largeObjects.clear();
+	for (int i = 0; i < n; ++i) {
+		if (isLarge[i]) {
+			_largeObjects.push_back(i);
+		}
+	}
+
+	addLargePairs(isLarge, res);
+}
+
+
+/**
+ * \brief Point to the AABBs of the objects (they are read by the binning and the overlap-tests of this step).
+ *
+ * \param aabbs
+ *      Swept AABBs of the objects.
+ */
+void SpatialHash::setAABBs(const AabbArray &aabbs) {
+	for (int axis = 0; axis < 3; ++axis) {
+		_aabbMin[axis] = aabbs.getMin(axis);
+		_aabbMax[axis] = aabbs.getMax(axis);
+	}
+}
+
+
+/**
+ * \brief Add the pairs of the large objects with all other objects.
+ *
+ * \param isLarge
+ *      Flag per object if it is a large object.
+ * \param res
+ *      Output-parameter: The pairs are appended.
+ */
+void SpatialHash::addLargePairs(const std::vector<char> &isLarge, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) const {
+	int n = _objects.size();
+
+	for (unsigned int l = 0; l < _largeObjects.size(); ++l) {
+		int i = _largeObjects[l];
+
+		for (int j = 0; j < n; ++j) {
+			// pairs of two large objects are reported by the one with the smaller index
+			if (j == i || (isLarge[j] && j < i) || (_objects[i]->isSleeping() && _objects[j]->isSleeping())) continue;
+
+			if (overlaps(i, j) && SpaceObject::canCollide(_objects[i], _objects[j])) {
+				res.push_back(makePair(i, j));
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Check if the AABBs of two objects overlap (touching AABBs overlap).
+ *
+ * \param a, b
+ *      Indices of the objects.
+ *
+ * \return True if they overlap.
+ */
+bool SpatialHash::overlaps(int a, int b) const {
+	return _aabbMax[0][a] >= _aabbMin[0][b] && _aabbMax[0][b] >= _aabbMin[0][a]
+		&& _aabbMax[1][a] >= _aabbMin[1][b] && _aabbMax[1][b] >= _aabbMin[1][a]
+		&& _aabbMax[2][a] >= _aabbMin[2][b] && _aabbMax[2][b] >= _aabbMin[2][a];
+}
+
+
+/**
+ * \brief Get the pair of two objects, with the smaller id first.
+ *
+ * \param a, b
+ *      Indices of the objects.
+ *
+ * \return Ordered pair.
+ */
+std::pair<SpaceObject *, SpaceObject *> SpatialHash::makePair(int a, int b) const {
+	// always have the object with the smaller id first
+	if (_objects[a]->getId() < _objects[b]->getId()) {
+		return std::make_pair(_objects[a], _objects[b]);
+	}
+
+	return std::make_pair(_objects[b], _objects[a]);
+}
@@ -0,0 +1,189 @@
+﻿/**
+ * \brief Implementation of the hashed uniform grid used by the broad-phase.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#pragma once
+
+#include <vector>
+
+namespace pbs17 {
+	class AabbArray;
+	class SpaceObject;
+	class SpatialGrid;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Uniform grid whose cells are hashed into a table of buckets, so the grid has no bounds.
+	 *
+	 * Each object is binned by the center of its AABB. If the cells are at least as large as the AABBs, two
+	 * overlapping objects are in the same or in neighbouring cells, so only 27 cells have to be visited per object.
+	 * Objects which are larger than the cells are tested against all others.
+	 *
+	 * Instead of its own cells, the cell-lists of the gravity-grid can be used (both are binned by the position).
+	 */
+	class SpatialHash {
+	public:
+		/**
+		 * \brief Constructor of the spatial-hash.
+		 */
+		SpatialHash();
+
+
+		/**
+		 * \brief Set the objects of the hash.
+		 *
+		 * \param objects
+		 *      All space-objects which are checked for collisions.
+		 */
+		void init(const std::vector<SpaceObject*> &objects);
+
+
+		/**
+		 * \brief Append an object (the cells are binned again by each update).
+		 *
+		 * \param object
+		 *      Space-object which is checked from now on (gets the last index).
+		 */
+		void insert(SpaceObject* object) {
+			_objects.push_back(object);
+		}
+
+
+		/**
+		 * \brief Remove an object, the last object is moved to its index (same as BodyState::remove()).
+		 *
+		 * \param i
+		 *      Index of the removed object.
+		 */
+		void remove(unsigned int i) {
+			if (i < _objects.size()) {
+				_objects[i] = _objects.back();
+				_objects.pop_back();
+			}
+		}
+
+
+		/**
+		 * \brief Bin the objects into the hashed cells and get the possible collisions.
+		 *
+		 * \param aabbs
+		 *      Swept AABBs of the objects of this step (same indices).
+		 * \param res
+		 *      Output-parameter: Pairs whose AABBs overlap (overwritten). By convention, on the first position the
+		 *	                      object with the smaller id is stored (key.first.Id < key.second.Id).
+		 */
+		void update(const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res);
+
+
+		/**
+		 * \brief Get the possible collisions with the cell-lists of the gravity-grid. The grid has to be up to date
+		 *        with the positions of the objects (same order as the objects).
+		 *
+		 * \param grid
+		 *      Gravity-grid whose cells are reused.
+		 * \param aabbs
+		 *      Swept AABBs of the objects of this step (same indices).
+		 * \param res
+		 *      Output-parameter: Pairs whose AABBs overlap (overwritten).
+		 */
+		void update(const SpatialGrid &grid, const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res);
+
+
+		/**
+		 * \brief Set the size of the cells.
+		 *
+		 * \param cellSize
+		 *      Width of the cells (<= 0.0 => twice the median extent of the AABBs).
+		 */
+		void setCellSize(const double cellSize) {
+			_cellSize = cellSize;
+		}
+
+
+	private:
+		//! Width of the cells (<= 0.0 => derived from the AABBs)
+		double _cellSize = 0.0;
+
+		//! All space-objects which are checked
+		std::vector<SpaceObject*> _objects;
+
+		//! AABBs of all objects per axis (of the array of the current update)
+		const float* _aabbMin[3] = { nullptr, nullptr, nullptr };
+		const float* _aabbMax[3] = { nullptr, nullptr, nullptr };
+
+		//! Cell (3 coordinates) and bucket per object (-1 => larger than a cell)
+		std::vector<int> _cellOfObject;
+		std::vector<int> _bucketOfObject;
+
+		//! First entry in _bucketObjects per bucket (size = buckets + 1)
+		std::vector<int> _bucketStart;
+		//! Indices of the binned objects, sorted by bucket
+		std::vector<int> _bucketObjects;
+
+		//! Objects which are larger than a cell
+		std::vector<int> _largeObjects;
+
+
+		/**
+		 * \brief Point to the AABBs of the objects (they are read by the binning and the overlap-tests of this step).
+		 *
+		 * \param aabbs
+		 *      Swept AABBs of the objects.
+		 */
+		void setAABBs(const AabbArray &aabbs);
+
+
+		/**
+		 * \brief Add the pairs of the large objects with all other objects.
+		 *
+		 * \param isLarge
+		 *      Flag per object if it is a large object.
+		 * \param res
+		 *      Output-parameter: The pairs are appended.
+		 */
+		void addLargePairs(const std::vector<char> &isLarge, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) const;
+
+
+		/**
+		 * \brief Check if the AABBs of two objects overlap (touching AABBs overlap).
+		 *
+		 * \param a, b
+		 *      Indices of the objects.
+		 *
+		 * \return True if they overlap.
+		 */
+		bool overlaps(int a, int b) const;
+
+
+		/**
+		 * \brief Get the pair of two objects, with the smaller id first.
+		 *
+		 * \param a, b
+		 *      Indices of the objects.
+		 *
+		 * \return Ordered pair.
+		 */
+		std::pair<SpaceObject *, SpaceObject *> makePair(int a, int b) const;
+
+
+		/**
+		 * \brief Hash-function of a cell.
+		 *
+		 * \param x, y, z
+		 *      Coordinates of the cell.
+		 * \param mask
+		 *      Number of buckets - 1 (power of two).
+		 *
+		 * \return Bucket of the cell.
+		 */
+		static int getBucket(int x, int y, int z, unsigned int mask) {
+			return static_cast<int>(((static_cast<unsigned int>(x) * 73856093u) ^ (static_cast<unsigned int>(y) * 19349663u)
+				^ (static_cast<unsigned int>(z) * 83492791u)) & mask);
+		}
+	};
+}
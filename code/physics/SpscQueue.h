@@ -0,0 +1,82 @@
+﻿/**
+ * \brief Implementation of a lock-free queue between one producer- and one consumer-thread.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Bounded ring-buffer for a single producer and a single consumer (e.g. the input of the event-traversal
+	 * which is consumed by the physics-step). Neither side blocks: The producer only writes the tail, the consumer only
+	 * writes the head, and the acquire/release-ordering of the indices publishes the items between the threads.
+	 *
+	 * \tparam T
+	 *      Type of the items (copyable).
+	 * \tparam CAPACITY
+	 *      Size of the ring-buffer (a power of two, one slot stays empty).
+	 */
+	template <typename T, size_t CAPACITY>
+	class SpscQueue {
+		static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0, "the capacity has to be a power of two");
+
+	public:
+		/**
+		 * \brief Append an item (only called by the producer).
+		 *
+		 * \param item
+		 *      New item.
+		 *
+		 * \return False if the queue is full (the item is dropped).
+		 */
+		bool push(const T &item) {
+			size_t tail = _tail.load(std::memory_order_relaxed);
+			size_t next = (tail + 1) & (CAPACITY - 1);
+
+			if (next == _head.load(std::memory_order_acquire)) {
+				return false;
+			}
+
+			_items[tail] = item;
+			_tail.store(next, std::memory_order_release);
+			return true;
+		}
+
+
+		/**
+		 * \brief Remove the oldest item (only called by the consumer).
+		 *
+		 * \param item
+		 *      Output-parameter: Removed item.
+		 *
+		 * \return False if the queue is empty.
+		 */
+		bool pop(T &item) {
+			size_t head = _head.load(std::memory_order_relaxed);
+
+			if (head == _tail.load(std::memory_order_acquire)) {
+				return false;
+			}
+
+			item = _items[head];
+			_head.store((head + 1) & (CAPACITY - 1), std::memory_order_release);
+			return true;
+		}
+
+
+	private:
+		//! Items of the ring-buffer
+		T _items[CAPACITY];
+		//! Next item to pop (written by the consumer), on its own cache-line
+		alignas(64) std::atomic<size_t> _head { 0 };
+		//! Next free slot (written by the producer), on its own cache-line
+		alignas(64) std::atomic<size_t> _tail { 0 };
+	};
+}
@@ -0,0 +1,295 @@
+﻿/**
+ * \brief Implementation of the publisher which streams the state of the simulation to remote viewers.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "StatePublisher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <iostream>
+#include <OpenThreads/ScopedLock>
+
+#include "Socket.h"
+#include "../scene/SpaceObject.h"
+#include "Logger.h"
+
+using namespace pbs17;
+
+//! Magic bytes of the header
+const char StatePublisher::MAGIC[8] = { 'P', 'B', 'S', 'N', 'E', 'T', '1', '\0' };
+//! Version of the protocol
+const uint32_t StatePublisher::VERSION = 1;
+
+
+/**
+ * \brief Append the bytes of a value to a buffer.
+ *
+ * \param buffer
+ *      Output-parameter: Encoded frame.
+ * \param value
+ *      Appended value (native byte-order).
+ */
+template<typename T>
+static void append(std::vector<char> &buffer, const T &value) {
+	const char* bytes = reinterpret_cast<const char*>(&value);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+
+/**
+ * \brief Constructor of the publisher (listens on the port, the thread has to be started).
+ *
+ * \param port
+ *      TCP-port of the viewers.
+ * \param quantization
+ *      Resolution of the streamed positions.
+ * \param rate
+ *      Maximal number of frames per second (the steps in between are not published).
+ */
+StatePublisher::StatePublisher(unsigned short port, double quantization, double rate)
+	: _quantization(quantization > 0.0 ? quantization : 0.001), _period(rate > 0.0 ? 1.0 / rate : 0.0) {
+	_listener = Socket::listen(port);
+
+	if (_listener < 0) {
+		LOG_ERROR("Port " << port << " can't be opened for the viewers!");
+	} else {
+		LOG_INFO("Streaming the state on port " << port);
+	}
+}
+
+
+/**
+ * \brief Destructor of the publisher (stops the thread and disconnects the viewers).
+ */
+StatePublisher::~StatePublisher() {
+	stop();
+
+	for (unsigned int i = 0; i < _viewers.size(); ++i) {
+		Socket::close(_viewers[i].socket);
+	}
+	if (_listener >= 0) {
+		Socket::close(_listener);
+	}
+}
+
+
+/**
+ * \brief Main-loop of the thread.
+ */
+void StatePublisher::run() {
+	while (true) {
+		bool hasFrame = false;
+
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+			// the new viewers are accepted without waiting for the next frame
+			if (!_hasNewFrame && _isRunning) {
+				_notEmpty.wait(&_mutex, ACCEPT_INTERVAL);
+			}
+
+			if (!_isRunning) {
+				return;
+			}
+
+			if (_hasNewFrame) {
+				std::swap(_ready, _sending);
+				_hasNewFrame = false;
+				hasFrame = true;
+			}
+		}
+
+		acceptViewers();
+
+		for (unsigned int i = 0; i < _viewers.size() && hasFrame;) {
+			encode(_viewers[i], _sending);
+
+			if (sendAll(_viewers[i].socket, _buffer.data(), _buffer.size())) {
+				++i;
+			} else {
+				LOG_INFO("Viewer disconnected");
+				Socket::close(_viewers[i].socket);
+				_viewers[i] = _viewers.back();
+				_viewers.pop_back();
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Stop the thread and wait until it is finished.
+ */
+void StatePublisher::stop() {
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		_isRunning = false;
+		_notEmpty.signal();
+	}
+
+	if (isRunning()) {
+		join();
+	}
+}
+
+
+/**
+ * \brief Copy the state of the objects for the viewers (never waits for the network). Has to be called from
+ *        the simulating thread after each step.
+ *
+ * \param step
+ *      Number of the step.
+ * \param time
+ *      Simulated time after the step.
+ * \param objects
+ *      All objects of the scene, in the same order as in the viewers (see SimulationManager::getSpaceObjects()).
+ */
+void StatePublisher::publish(unsigned long step, double time, const std::vector<SpaceObject*> &objects) {
+	if (_listener < 0) return;
+
+	const osg::Timer* timer = osg::Timer::instance();
+	osg::Timer_t now = timer->tick();
+	if (_hasPublished && timer->delta_s(_lastPublished, now) < _period) {
+		return;
+	}
+	_lastPublished = now;
+	_hasPublished = true;
+
+	unsigned int n = static_cast<unsigned int>(objects.size());
+	_write.step = step;
+	_write.time = time;
+	_write.position.resize(3 * n);
+	_write.orientation.resize(4 * n);
+	_write.isActive.resize(n);
+
+	for (unsigned int i = 0; i < n; ++i) {
+		const Eigen::Vector3d &position = objects[i]->getPosition();
+		const osg::Quat &orientation = objects[i]->getOrientation();
+
+		for (int k = 0; k < 3; ++k) {
+			_write.position[3 * i + k] = static_cast<int64_t>(std::llround(position[k] / _quantization));
+		}
+		for (int k = 0; k < 4; ++k) {
+			_write.orientation[4 * i + k] = static_cast<int16_t>(std::lround(std::max(-1.0, std::min(orientation[k], 1.0)) * 32767.0));
+		}
+		_write.isActive[i] = objects[i]->isActive() ? 1 : 0;
+	}
+
+	// a frame which has not been taken by the thread is replaced
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	std::swap(_write, _ready);
+	_hasNewFrame = true;
+	_notEmpty.signal();
+}
+
+
+/**
+ * \brief Accept the waiting viewers and send them the header.
+ */
+void StatePublisher::acceptViewers() {
+	if (_listener < 0) return;
+
+	for (int socket = Socket::accept(_listener); socket >= 0; socket = Socket::accept(_listener)) {
+		_buffer.clear();
+		_buffer.insert(_buffer.end(), MAGIC, MAGIC + 8);
+		append(_buffer, VERSION);
+		append(_buffer, static_cast<uint32_t>(_sending.isActive.size()));
+		append(_buffer, _quantization);
+
+		if (!sendAll(socket, _buffer.data(), _buffer.size())) {
+			Socket::close(socket);
+			continue;
+		}
+
+		// the first frame contains all objects
+		Viewer viewer;
+		viewer.socket = socket;
+		_viewers.push_back(viewer);
+		LOG_INFO("Viewer connected");
+	}
+}
+
+
+/**
+ * \brief Encode the changes of the frame since the last frame of a viewer.
+ *
+ * \param viewer
+ *      Viewer whose last frame is updated.
+ * \param frame
+ *      Frame which is sent.
+ */
+void StatePublisher::encode(Viewer &viewer, const Frame &frame) {
+	Frame &last = viewer.last;
+	unsigned int n = static_cast<unsigned int>(frame.isActive.size());
+	// the objects which are new for the viewer are sent with their absolute position
+	unsigned int cntKnown = static_cast<unsigned int>(last.isActive.size());
+
+	_buffer.clear();
+	append(_buffer, static_cast<uint32_t>(0));
+	append(_buffer, frame.step);
+	append(_buffer, frame.time);
+	append(_buffer, static_cast<uint32_t>(0));
+
+	uint32_t cntEntries = 0;
+	for (unsigned int i = 0; i < n; ++i) {
+		bool isKnown = i < cntKnown;
+		if (isKnown && last.isActive[i] == frame.isActive[i]
+			&& std::equal(&frame.position[3 * i], &frame.position[3 * i] + 3, &last.position[3 * i])
+			&& std::equal(&frame.orientation[4 * i], &frame.orientation[4 * i] + 4, &last.orientation[4 * i])) {
+			continue;
+		}
+
+		int64_t delta[3];
+		bool isAbsolute = !isKnown;
+		for (int k = 0; k < 3 && !isAbsolute; ++k) {
+			delta[k] = frame.position[3 * i + k] - last.position[3 * i + k];
+			isAbsolute = delta[k] < std::numeric_limits<int32_t>::min() || delta[k] > std::numeric_limits<int32_t>::max();
+		}
+
+		append(_buffer, static_cast<uint32_t>(i));
+		append(_buffer, static_cast<uint8_t>((frame.isActive[i] ? ACTIVE : 0) | (isAbsolute ? ABSOLUTE : 0)));
+		for (int k = 0; k < 3; ++k) {
+			if (isAbsolute) {
+				append(_buffer, frame.position[3 * i + k]);
+			} else {
+				append(_buffer, static_cast<int32_t>(delta[k]));
+			}
+		}
+		for (int k = 0; k < 4; ++k) {
+			append(_buffer, frame.orientation[4 * i + k]);
+		}
+
+		++cntEntries;
+	}
+
+	uint32_t size = static_cast<uint32_t>(_buffer.size() - sizeof(uint32_t));
+	std::memcpy(_buffer.data(), &size, sizeof(size));
+	std::memcpy(_buffer.data() + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(double), &cntEntries, sizeof(cntEntries));
+
+	// the viewer reconstructs the same quantized state
+	last = frame;
+}
+
+
+/**
+ * \brief Send a buffer completely to a viewer.
+ *
+ * \return False if the viewer disconnected.
+ */
+bool StatePublisher::sendAll(int socket, const char* data, size_t size) {
+	while (size > 0) {
+		long sent = Socket::send(socket, data, size);
+		if (sent <= 0) return false;
+
+		data += sent;
+		size -= static_cast<size_t>(sent);
+		_cntSent += static_cast<uint64_t>(sent);
+	}
+
+	return true;
+}
@@ -0,0 +1,211 @@
+﻿/**
+ * \brief Implementation of the publisher which streams the state of the simulation to remote viewers.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+#include <osg/Timer>
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Streams the transformations of the simulated objects to the viewers which are connected over TCP (see
+	 * StateSubscriber). The simulation only copies the state into the write-buffer of a triple-buffer (the newest
+	 * state replaces a state which has not been sent yet), the publisher-thread accepts the viewers and encodes and
+	 * sends the frames, so a slow network or viewer never blocks the simulation.
+	 *
+	 * Each viewer gets the objects whose quantized transformation changed since its last frame, so the bandwidth is
+	 * proportional to the moving objects. A new viewer gets all objects with its first frame.
+	 *
+	 * Protocol (native byte-order):
+	 *  - Header: "PBSNET1" and a null-byte, uint32 version, uint32 number of objects, double quantization.
+	 *  - Frames: uint32 size of the rest of the frame, uint64 step, double time, uint32 number of entries, entries:
+	 *    uint32 index of the object, uint8 flags (ACTIVE, ABSOLUTE), int32 quantized position[3] relative to the last
+	 *    frame of the viewer (ABSOLUTE: int64 quantized position[3]), int16 orientation[4] (x, y, z, w in 1/32767).
+	 */
+	class StatePublisher : public OpenThreads::Thread {
+	public:
+		//! Flags of the entries of a frame
+		enum EntryFlags {
+			//! The object is simulated
+			ACTIVE = 1,
+			//! The position is not relative to the last frame
+			ABSOLUTE = 2
+		};
+
+
+		/**
+		 * \brief Constructor of the publisher (listens on the port, the thread has to be started).
+		 *
+		 * \param port
+		 *      TCP-port of the viewers.
+		 * \param quantization
+		 *      Resolution of the streamed positions.
+		 * \param rate
+		 *      Maximal number of frames per second (the steps in between are not published).
+		 */
+		StatePublisher(unsigned short port, double quantization = 0.001, double rate = 60.0);
+
+
+		/**
+		 * \brief Destructor of the publisher (stops the thread and disconnects the viewers).
+		 */
+		~StatePublisher();
+
+
+		/**
+		 * \brief Check if the port could be opened.
+		 *
+		 * \return True if the viewers can connect.
+		 */
+		bool isListening() const {
+			return _listener >= 0;
+		}
+
+
+		/**
+		 * \brief Main-loop of the thread.
+		 */
+		void run() override;
+
+
+		/**
+		 * \brief Stop the thread and wait until it is finished.
+		 */
+		void stop();
+
+
+		/**
+		 * \brief Copy the state of the objects for the viewers (never waits for the network). Has to be called from
+		 *        the simulating thread after each step.
+		 *
+		 * \param step
+		 *      Number of the step.
+		 * \param time
+		 *      Simulated time after the step.
+		 * \param objects
+		 *      All objects of the scene, in the same order as in the viewers (see SimulationManager::getSpaceObjects()).
+		 */
+		void publish(unsigned long step, double time, const std::vector<SpaceObject*> &objects);
+
+
+		/**
+		 * \brief Get the number of bytes which have been sent to all viewers.
+		 *
+		 * \return Sent bytes.
+		 */
+		uint64_t getNumSent() const {
+			return _cntSent;
+		}
+
+
+		//! Magic bytes of the header
+		static const char MAGIC[8];
+		//! Version of the protocol
+		static const uint32_t VERSION;
+
+	private:
+		/**
+		 * \brief Quantized state of all objects.
+		 */
+		struct Frame {
+			uint64_t step = 0;
+			double time = 0.0;
+			std::vector<int64_t> position;
+			std::vector<int16_t> orientation;
+			std::vector<uint8_t> isActive;
+		};
+
+		/**
+		 * \brief Connected viewer with the state of its last frame.
+		 */
+		struct Viewer {
+			int socket;
+			Frame last;
+		};
+
+
+		//! Resolution of the streamed positions
+		double _quantization;
+		//! Minimal wall-clock between two published frames
+		double _period;
+		//! Tick of the last published frame (only used by the simulating thread)
+		osg::Timer_t _lastPublished = 0;
+		bool _hasPublished = false;
+
+		//! Listening socket (-1 => not listening)
+		int _listener = -1;
+		//! Connected viewers (only used by the publisher-thread)
+		std::vector<Viewer> _viewers;
+		//! Encoded frame (only used by the publisher-thread)
+		std::vector<char> _buffer;
+		//! Number of bytes which have been sent
+		std::atomic<uint64_t> _cntSent { 0 };
+
+		//! Frame which is written by the simulation
+		Frame _write;
+		//! Newest frame which has not been taken by the publisher-thread
+		Frame _ready;
+		//! Frame which is sent by the publisher-thread
+		Frame _sending;
+		//! True if _ready is newer than _sending
+		bool _hasNewFrame = false;
+
+		//! True as long as the thread should run
+		bool _isRunning = true;
+		//! Protects _ready, _hasNewFrame and _isRunning
+		OpenThreads::Mutex _mutex;
+		//! Signaled if a frame has been published or the thread should stop
+		OpenThreads::Condition _notEmpty;
+
+		//! Milliseconds which the thread waits for a frame before it looks for new viewers
+		static const unsigned long ACCEPT_INTERVAL = 100;
+
+
+		/**
+		 * \brief Accept the waiting viewers and send them the header.
+		 */
+		void acceptViewers();
+
+
+		/**
+		 * \brief Encode the changes of the frame since the last frame of a viewer.
+		 *
+		 * \param viewer
+		 *      Viewer whose last frame is updated.
+		 * \param frame
+		 *      Frame which is sent.
+		 */
+		void encode(Viewer &viewer, const Frame &frame);
+
+
+		/**
+		 * \brief Send a buffer completely to a viewer.
+		 *
+		 * \return False if the viewer disconnected.
+		 */
+		bool sendAll(int socket, const char* data, size_t size);
+
+
+		//! Copying would close the sockets twice
+		StatePublisher(StatePublisher const&) = delete;
+		StatePublisher& operator=(StatePublisher const&) = delete;
+	};
+}
@@ -0,0 +1,271 @@
+﻿/**
+ * \brief Implementation of the subscriber which renders the state streamed by a remote simulation.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "StateSubscriber.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <OpenThreads/ScopedLock>
+
+#include "Profiler.h"
+#include "Socket.h"
+#include "StatePublisher.h"
+#include "../scene/SpaceObject.h"
+#include "Logger.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Read a value from a buffer and advance the buffer.
+ *
+ * \param data
+ *      Input- and output-parameter: Current position in the frame.
+ * \param end
+ *      End of the frame.
+ * \param value
+ *      Output-parameter: Read value (native byte-order).
+ *
+ * \return False if the frame ends before the value.
+ */
+template<typename T>
+static bool read(const char* &data, const char* end, T &value) {
+	if (end - data < static_cast<std::ptrdiff_t>(sizeof(T))) return false;
+
+	std::memcpy(&value, data, sizeof(T));
+	data += sizeof(T);
+	return true;
+}
+
+
+/**
+ * \brief Constructor of the subscriber (the thread has to be started).
+ *
+ * \param host
+ *      Name or address of the simulation.
+ * \param port
+ *      TCP-port of its publisher.
+ * \param objects
+ *      All objects of the scene, in the same order as in the simulation (see SimulationManager::getSpaceObjects()).
+ */
+StateSubscriber::StateSubscriber(std::string host, unsigned short port, const std::vector<SpaceObject*> &objects)
+	: _host(host), _port(port), _objects(objects) {
+	unsigned int n = static_cast<unsigned int>(_objects.size());
+	_position.resize(3 * n, 0);
+	_orientation.resize(4 * n, 0);
+	_isActive.resize(n, 0);
+	_isChanged.resize(n, 0);
+}
+
+
+/**
+ * \brief Destructor of the subscriber (stops the thread).
+ */
+StateSubscriber::~StateSubscriber() {
+	stop();
+}
+
+
+/**
+ * \brief Main-loop of the thread: connect and decode the frames until the simulation disconnects.
+ */
+void StateSubscriber::run() {
+	int socket = Socket::connect(_host, _port);
+
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		if (socket < 0 || !_isRunning) {
+			if (socket >= 0) Socket::close(socket);
+			LOG_ERROR("Simulation " << _host << ":" << _port << " can't be reached!");
+			return;
+		}
+		_socket = socket;
+	}
+
+	char magic[8];
+	uint32_t version, cntObjects;
+	if (!receiveAll(magic, 8) || std::memcmp(magic, StatePublisher::MAGIC, 8) != 0
+		|| !receiveAll(reinterpret_cast<char*>(&version), sizeof(version)) || version != StatePublisher::VERSION
+		|| !receiveAll(reinterpret_cast<char*>(&cntObjects), sizeof(cntObjects))
+		|| !receiveAll(reinterpret_cast<char*>(&_quantization), sizeof(_quantization))) {
+		LOG_ERROR("Simulation " << _host << ":" << _port << " does not stream a supported state!");
+		return;
+	}
+
+	if (cntObjects > 0 && cntObjects != _objects.size()) {
+		LOG_INFO("The simulation streams " << cntObjects << " objects, the scene has " << _objects.size());
+	}
+	LOG_INFO("Connected to the simulation " << _host << ":" << _port);
+
+	while (true) {
+		uint32_t size;
+		if (!receiveAll(reinterpret_cast<char*>(&size), sizeof(size))) break;
+
+		_buffer.resize(size);
+		if (!receiveAll(_buffer.data(), size) || !decode(size)) break;
+	}
+
+	LOG_INFO("Disconnected from the simulation");
+}
+
+
+/**
+ * \brief Stop the thread and wait until it is finished.
+ */
+void StateSubscriber::stop() {
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		_isRunning = false;
+
+		// the thread waits in the receive
+		if (_socket >= 0) {
+			Socket::shutdown(_socket);
+		}
+	}
+
+	if (isRunning()) {
+		join();
+	}
+
+	if (_socket >= 0) {
+		Socket::close(_socket);
+		_socket = -1;
+	}
+}
+
+
+/**
+ * \brief Write the objects which changed since the last update to the OSG-nodes. Has to be called from the
+ *        rendering-thread (e.g. by an update-callback).
+ */
+void StateSubscriber::update() {
+	Profiler::ScopedTimer timer(Profiler::SCENE_SYNC);
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	for (unsigned int c = 0; c < _changed.size(); ++c) {
+		unsigned int i = _changed[c];
+		SpaceObject* object = _objects[i];
+		bool isActive = _isActive[i] != 0;
+
+		Eigen::Vector3d position(_position[3 * i] * _quantization, _position[3 * i + 1] * _quantization, _position[3 * i + 2] * _quantization);
+		osg::Quat orientation(_orientation[4 * i] / 32767.0, _orientation[4 * i + 1] / 32767.0, _orientation[4 * i + 2] / 32767.0, _orientation[4 * i + 3] / 32767.0);
+		if (orientation.length() > 0.0) {
+			orientation /= orientation.length();
+		}
+
+		object->setActive(isActive);
+		object->applyActive(isActive);
+		object->setPositionOrientation(position, orientation);
+		object->updateTransformation();
+		_isChanged[i] = 0;
+	}
+
+	_changed.clear();
+}
+
+
+/**
+ * \brief Split an address of the form host:port.
+ *
+ * \param address
+ *      Address (e.g. "compute-node:7117").
+ * \param host
+ *      Output-parameter: Name of the host.
+ * \param port
+ *      Output-parameter: TCP-port.
+ *
+ * \return True if the address has a valid port.
+ */
+bool StateSubscriber::parseAddress(const std::string &address, std::string &host, unsigned short &port) {
+	size_t colon = address.rfind(':');
+	if (colon == std::string::npos || colon + 1 == address.size()) return false;
+
+	char* end;
+	long value = std::strtol(address.c_str() + colon + 1, &end, 10);
+	if (*end != '\0' || value <= 0 || value > 65535) return false;
+
+	host = colon > 0 ? address.substr(0, colon) : "localhost";
+	port = static_cast<unsigned short>(value);
+	return true;
+}
+
+
+/**
+ * \brief Receive a buffer completely.
+ *
+ * \return False if the simulation disconnected.
+ */
+bool StateSubscriber::receiveAll(char* data, size_t size) {
+	while (size > 0) {
+		long received = Socket::receive(_socket, data, size);
+		if (received <= 0) return false;
+
+		data += received;
+		size -= static_cast<size_t>(received);
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Decode a received frame into the state of the objects.
+ *
+ * \param size
+ *      Size of the frame in the buffer.
+ *
+ * \return False if the frame is malformed.
+ */
+bool StateSubscriber::decode(size_t size) {
+	const char* data = _buffer.data();
+	const char* end = data + size;
+
+	uint64_t step;
+	double time;
+	uint32_t cntEntries;
+	if (!read(data, end, step) || !read(data, end, time) || !read(data, end, cntEntries)) return false;
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+	for (uint32_t e = 0; e < cntEntries; ++e) {
+		uint32_t i;
+		uint8_t flags;
+		if (!read(data, end, i) || !read(data, end, flags)) return false;
+
+		// the objects which are not in the scene of the viewer are skipped (e.g. added by a reload)
+		bool isKnown = i < _isActive.size();
+		int64_t position[3];
+		int16_t orientation[4];
+
+		for (int k = 0; k < 3; ++k) {
+			if (flags & StatePublisher::ABSOLUTE) {
+				if (!read(data, end, position[k])) return false;
+			} else {
+				int32_t delta;
+				if (!read(data, end, delta)) return false;
+				position[k] = (isKnown ? _position[3 * i + k] : 0) + delta;
+			}
+		}
+		for (int k = 0; k < 4; ++k) {
+			if (!read(data, end, orientation[k])) return false;
+		}
+
+		if (!isKnown) continue;
+
+		std::memcpy(&_position[3 * i], position, sizeof(position));
+		std::memcpy(&_orientation[4 * i], orientation, sizeof(orientation));
+		_isActive[i] = (flags & StatePublisher::ACTIVE) ? 1 : 0;
+
+		if (!_isChanged[i]) {
+			_isChanged[i] = 1;
+			_changed.push_back(i);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,135 @@
+﻿/**
+ * \brief Implementation of the subscriber which renders the state streamed by a remote simulation.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Receives the frames of a StatePublisher on its own thread and writes the changed objects to their
+	 *        OSG-nodes (see update()). The viewer loads the same scene as the simulation, so the objects have the
+	 *        same order; it does not simulate anything.
+	 */
+	class StateSubscriber : public OpenThreads::Thread {
+	public:
+		/**
+		 * \brief Constructor of the subscriber (the thread has to be started).
+		 *
+		 * \param host
+		 *      Name or address of the simulation.
+		 * \param port
+		 *      TCP-port of its publisher.
+		 * \param objects
+		 *      All objects of the scene, in the same order as in the simulation (see SimulationManager::getSpaceObjects()).
+		 */
+		StateSubscriber(std::string host, unsigned short port, const std::vector<SpaceObject*> &objects);
+
+
+		/**
+		 * \brief Destructor of the subscriber (stops the thread).
+		 */
+		~StateSubscriber();
+
+
+		/**
+		 * \brief Main-loop of the thread: connect and decode the frames until the simulation disconnects.
+		 */
+		void run() override;
+
+
+		/**
+		 * \brief Stop the thread and wait until it is finished.
+		 */
+		void stop();
+
+
+		/**
+		 * \brief Write the objects which changed since the last update to the OSG-nodes. Has to be called from the
+		 *        rendering-thread (e.g. by an update-callback).
+		 */
+		void update();
+
+
+		/**
+		 * \brief Split an address of the form host:port.
+		 *
+		 * \param address
+		 *      Address (e.g. "compute-node:7117").
+		 * \param host
+		 *      Output-parameter: Name of the host.
+		 * \param port
+		 *      Output-parameter: TCP-port.
+		 *
+		 * \return True if the address has a valid port.
+		 */
+		static bool parseAddress(const std::string &address, std::string &host, unsigned short &port);
+
+	private:
+		//! Name or address of the simulation
+		std::string _host;
+		//! TCP-port of the publisher
+		unsigned short _port;
+		//! Objects of the scene
+		std::vector<SpaceObject*> _objects;
+
+		//! Connected socket (-1 => not connected)
+		int _socket = -1;
+		//! True as long as the thread should run
+		bool _isRunning = true;
+		//! Resolution of the streamed positions
+		double _quantization = 0.001;
+
+		//! Quantized state of all objects (3 positions, 4 orientations and the active-flag per object)
+		std::vector<int64_t> _position;
+		std::vector<int16_t> _orientation;
+		std::vector<uint8_t> _isActive;
+		//! Indices of the objects which changed since the last update (and the flag per object)
+		std::vector<unsigned int> _changed;
+		std::vector<uint8_t> _isChanged;
+		//! Received frame (only used by the thread)
+		std::vector<char> _buffer;
+		//! Protects the state, the changed objects, _socket and _isRunning
+		OpenThreads::Mutex _mutex;
+
+
+		/**
+		 * \brief Receive a buffer completely.
+		 *
+		 * \return False if the simulation disconnected.
+		 */
+		bool receiveAll(char* data, size_t size);
+
+
+		/**
+		 * \brief Decode a received frame into the state of the objects.
+		 *
+		 * \param size
+		 *      Size of the frame in the buffer.
+		 *
+		 * \return False if the frame is malformed.
+		 */
+		bool decode(size_t size);
+
+
+		//! Copying would close the socket twice
+		StateSubscriber(StateSubscriber const&) = delete;
+		StateSubscriber& operator=(StateSubscriber const&) = delete;
+	};
+}
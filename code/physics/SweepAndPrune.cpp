@@ -0,0 +1,651 @@
+﻿/**
+ * \brief Implementation of the incremental sweep-and-prune used by the broad-phase.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "../scene/SpaceObject.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor of the sweep-and-prune.
+ */
+SweepAndPrune::SweepAndPrune() {}
+
+
+/**
+ * \brief Sort the endpoints of all objects and count the initial overlaps.
+ *
+ * \param objects
+ *      All space-objects which are checked for collisions.
+ */
+void SweepAndPrune::init(const std::vector<SpaceObject*> &objects) {
+	_objects = objects;
+	_pairs.clear();
+	_candidates.clear();
+	std::fill(_cntOverlaps, _cntOverlaps + 3, 0u);
+
+	// the single-axis mode does not keep any state between the frames
+	if (_mode != INCREMENTAL) {
+		return;
+	}
+
+	unsigned int n = _objects.size();
+	AabbArray aabbs;
+	aabbs.update(_objects);
+
+	for (int axis = 0; axis < 3; ++axis) {
+		std::vector<Endpoint> &endpoints = _endpoints[axis];
+		endpoints.resize(2 * n);
+
+		for (unsigned int i = 0; i < 2 * n; ++i) {
+			endpoints[i].data = i;
+		}
+
+		updateValues(axis, aabbs);
+		std::sort(endpoints.begin(), endpoints.end(), isLess);
+
+		// sweep: each min-endpoint overlaps with all objects which are open at the moment
+		std::vector<unsigned int> open;
+		for (unsigned int i = 0; i < endpoints.size(); ++i) {
+			unsigned int object = endpoints[i].data >> 1;
+
+			if ((endpoints[i].data & 1) == 0) {
+				for (unsigned int j = 0; j < open.size(); ++j) {
+					addOverlap(object, open[j]);
+				}
+				_cntOverlaps[axis] += open.size();
+
+				open.push_back(object);
+			} else {
+				std::vector<unsigned int>::iterator found = std::find(open.begin(), open.end(), object);
+				*found = open.back();
+				open.pop_back();
+			}
+		}
+	}
+}
+
+
+/**
+ * \brief Append an object: its endpoints are sorted in from the end of the axes, the overlaps are counted
+ *        while they pass the other endpoints.
+ *
+ * \param object
+ *      Space-object which is checked from now on (gets the last index).
+ */
+void SweepAndPrune::insert(SpaceObject* object) {
+	unsigned int i = _objects.size();
+	_objects.push_back(object);
+
+	if (_mode != INCREMENTAL) {
+		return;
+	}
+
+	osg::BoundingBox aabb = object->getSweptAABB();
+	for (int axis = 0; axis < 3; ++axis) {
+		std::vector<Endpoint> &endpoints = _endpoints[axis];
+
+		// the min-endpoint only passes maxima (overlaps start), the max-endpoint only minima (overlaps end)
+		Endpoint min = { aabb._min[axis], 2 * i };
+		endpoints.push_back(min);
+		sinkEndpoint(axis, endpoints.size() - 1);
+
+		Endpoint max = { aabb._max[axis], 2 * i + 1 };
+		endpoints.push_back(max);
+		sinkEndpoint(axis, endpoints.size() - 1);
+	}
+}
+
+
+/**
+ * \brief Remove an object with its endpoints and overlaps, the last object is moved to its index (same as
+ *        BodyState::remove()).
+ *
+ * \param i
+ *      Index of the removed object.
+ */
+void SweepAndPrune::remove(unsigned int i) {
+	if (i >= _objects.size()) {
+		return;
+	}
+
+	unsigned int last = _objects.size() - 1;
+
+	if (_mode == INCREMENTAL) {
+		std::vector<unsigned int> overlaps;
+
+		for (int axis = 0; axis < 3; ++axis) {
+			std::vector<Endpoint> &endpoints = _endpoints[axis];
+
+			findOverlaps(axis, i, overlaps);
+			for (unsigned int k = 0; k < overlaps.size(); ++k) {
+				removeOverlap(i, overlaps[k]);
+			}
+			_cntOverlaps[axis] -= overlaps.size();
+
+			endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(), [i](const Endpoint &endpoint) {
+				return (endpoint.data >> 1) == i;
+			}), endpoints.end());
+		}
+
+		// the pairs and endpoints of the last object get its new index
+		for (int axis = 0; i != last && axis < 3; ++axis) {
+			std::vector<Endpoint> &endpoints = _endpoints[axis];
+
+			findOverlaps(axis, last, overlaps);
+			for (unsigned int k = 0; k < overlaps.size(); ++k) {
+				renamePair(getPairKey(last, overlaps[k]), getPairKey(i, overlaps[k]));
+			}
+
+			for (unsigned int k = 0; k < endpoints.size(); ++k) {
+				if ((endpoints[k].data >> 1) == last) {
+					endpoints[k].data = 2 * i + (endpoints[k].data & 1);
+				}
+			}
+		}
+	}
+
+	_objects[i] = _objects[last];
+	_objects.pop_back();
+}
+
+
+/**
+ * \brief Resort the endpoints to the current AABBs and get the possible collisions.
+ *
+ * \param aabbs
+ *      Swept AABBs of the objects of this step (same indices).
+ * \param res
+ *      Output-parameter: Pairs whose AABBs overlap (overwritten). By convention, on the first position the
+ *	                      object with the smaller id is stored (key.first.Id < key.second.Id).
+ */
+void SweepAndPrune::update(const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) {
+	if (_mode == SINGLE_AXIS || _mode == GPU) {
+		updateSingleAxis(aabbs, res);
+	} else {
+		updateIncremental(aabbs, res);
+	}
+}
+
+
+/**
+ * \brief Set the method to find the overlapping pairs.
+ *
+ * \param mode
+ *      New method.
+ */
+void SweepAndPrune::setMode(Mode mode) {
+	_mode = mode;
+
+	// rebuild the state of the new mode
+	init(_objects);
+}
+
+
+/**
+ * \brief Resort the persistent endpoints and get the candidates (incremental mode).
+ *
+ * \param aabbs
+ *      Swept AABBs of the objects.
+ * \param res
+ *      Output-parameter: Overlapping pairs (overwritten).
+ */
+void SweepAndPrune::updateIncremental(const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) {
+	for (int axis = 0; axis < 3; ++axis) {
+		updateValues(axis, aabbs);
+		sortAxis(axis);
+	}
+
+	res.clear();
+	res.reserve(_candidates.size());
+	for (unsigned int i = 0; i < _candidates.size(); ++i) {
+		SpaceObject* a = _objects[static_cast<unsigned int>(_candidates[i] >> 32)];
+		SpaceObject* b = _objects[static_cast<unsigned int>(_candidates[i] & 0xffffffff)];
+
+		// the filtered pairs keep their overlap-state, only they are not reported
+		if (!SpaceObject::canCollide(a, b)) continue;
+
+		// always have the object with the smaller id first
+		if (a->getId() < b->getId()) {
+			res.push_back(std::make_pair(a, b));
+		} else {
+			res.push_back(std::make_pair(b, a));
+		}
+	}
+}
+
+
+/**
+ * \brief Sort along the axis of the largest variance and sweep with a full AABB-test (single-axis mode).
+ *
+ * \param aabbs
+ *      Swept AABBs of the objects (also uploaded in the GPU-mode).
+ * \param res
+ *      Output-parameter: Overlapping pairs (overwritten).
+ */
+void SweepAndPrune::updateSingleAxis(const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res) {
+	int n = _objects.size();
+	res.clear();
+
+	if (n < 2) return;
+
+	const float* mins[3] = { aabbs.getMin(0), aabbs.getMin(1), aabbs.getMin(2) };
+	const float* maxs[3] = { aabbs.getMax(0), aabbs.getMax(1), aabbs.getMax(2) };
+
+	// the variance of the centers per axis
+	double sum[3] = { 0.0, 0.0, 0.0 };
+	double sumSq[3] = { 0.0, 0.0, 0.0 };
+
+	for (int axis = 0; axis < 3; ++axis) {
+		for (int i = 0; i < n; ++i) {
+			double center = 0.5 * (static_cast<double>(mins[axis][i]) + maxs[axis][i]);
+			sum[axis] += center;
+			sumSq[axis] += center * center;
+		}
+	}
+
+	int sweepAxis = 0;
+	double maxVariance = -1.0;
+	for (int axis = 0; axis < 3; ++axis) {
+		double mean = sum[axis] / n;
+		double variance = sumSq[axis] / n - mean * mean;
+
+		if (variance > maxVariance) {
+			maxVariance = variance;
+			sweepAxis = axis;
+		}
+	}
+
+	// only the AABBs are uploaded and only the overlapping pairs are copied back (in the order of their indices)
+	if (_mode == GPU) {
+		unsigned int cntSweepOverlaps = 0;
+
+		if (_gpuBroadPhase.findPairs(mins, maxs, n, sweepAxis, _gpuPairs, cntSweepOverlaps)) {
+			res.reserve(_gpuPairs.size());
+			for (unsigned int i = 0; i < _gpuPairs.size(); ++i) {
+				SpaceObject* a = _objects[static_cast<unsigned int>(_gpuPairs[i] >> 32)];
+				SpaceObject* b = _objects[static_cast<unsigned int>(_gpuPairs[i] & 0xffffffff)];
+				if (!SpaceObject::canCollide(a, b)) continue;
+
+				// always have the object with the smaller id first
+				if (a->getId() < b->getId()) {
+					res.push_back(std::make_pair(a, b));
+				} else {
+					res.push_back(std::make_pair(b, a));
+				}
+			}
+
+			std::fill(_cntOverlaps, _cntOverlaps + 3, 0u);
+			_cntOverlaps[sweepAxis] = cntSweepOverlaps;
+			return;
+		}
+	}
+
+	// sort by the min-edge on the sweep-axis
+	_keys.resize(n);
+	_order.resize(n);
+	for (int i = 0; i < n; ++i) {
+		_keys[i] = toRadixKey(mins[sweepAxis][i]);
+		_order[i] = i;
+	}
+
+	radixSort();
+
+	const float* sweepMin = mins[sweepAxis];
+	const float* sweepMax = maxs[sweepAxis];
+	const float* min1 = mins[(sweepAxis + 1) % 3];
+	const float* max1 = maxs[(sweepAxis + 1) % 3];
+	const float* min2 = mins[(sweepAxis + 2) % 3];
+	const float* max2 = maxs[(sweepAxis + 2) % 3];
+
+	int cntThreads = 1;
+#if defined(_OPENMP)
+	cntThreads = omp_get_max_threads();
+#endif
+
+	// pairs per thread, concatenated in the order of the threads so the result is deterministic
+	std::vector<std::vector<std::pair<SpaceObject *, SpaceObject *>>> threadPairs(cntThreads);
+	unsigned int cntSweepOverlaps = 0;
+
+#if defined(_OPENMP)
+#pragma omp parallel
+#endif
+	{
+		int thread = 0;
+#if defined(_OPENMP)
+		thread = omp_get_thread_num();
+#endif
+		std::vector<std::pair<SpaceObject *, SpaceObject *>> &pairs = threadPairs[thread];
+
+#if defined(_OPENMP)
+#pragma omp for schedule(static, 64) reduction(+:cntSweepOverlaps)
+#endif
+		for (int i = 0; i < n - 1; ++i) {
+			unsigned int a = _order[i];
+			float aabbMax = sweepMax[a];
+
+			for (int j = i + 1; j < n; ++j) {
+				unsigned int b = _order[j];
+
+				// as soon as the min-edge of the neighbour is greater, no later object can overlap
+				if (sweepMin[b] > aabbMax) break;
+				++cntSweepOverlaps;
+
+				if (max1[a] >= min1[b] && max1[b] >= min1[a] && max2[a] >= min2[b] && max2[b] >= min2[a]
+					&& SpaceObject::canCollide(_objects[a], _objects[b])) {
+					// always have the object with the smaller id first
+					if (_objects[a]->getId() < _objects[b]->getId()) {
+						pairs.push_back(std::make_pair(_objects[a], _objects[b]));
+					} else {
+						pairs.push_back(std::make_pair(_objects[b], _objects[a]));
+					}
+				}
+			}
+		}
+	}
+
+	for (int t = 0; t < cntThreads; ++t) {
+		res.insert(res.end(), threadPairs[t].begin(), threadPairs[t].end());
+	}
+
+	std::fill(_cntOverlaps, _cntOverlaps + 3, 0u);
+	_cntOverlaps[sweepAxis] = cntSweepOverlaps;
+}
+
+
+/**
+ * \brief Parallel LSD radix-sort (4 passes of 8 bits) of _keys, _order is permuted the same way.
+ */
+void SweepAndPrune::radixSort() {
+	int n = _keys.size();
+	_keysBuffer.resize(n);
+	_orderBuffer.resize(n);
+
+	int maxThreads = 1;
+#if defined(_OPENMP)
+	maxThreads = omp_get_max_threads();
+#endif
+
+	// histogram per thread and digit, turned into the scatter-offsets
+	std::vector<unsigned int> histogram(maxThreads * 256);
+
+	for (int shift = 0; shift < 32; shift += 8) {
+		std::fill(histogram.begin(), histogram.end(), 0);
+
+#if defined(_OPENMP)
+#pragma omp parallel if(n > 4096)
+#endif
+		{
+			int thread = 0;
+			int cntThreads = 1;
+#if defined(_OPENMP)
+			thread = omp_get_thread_num();
+			cntThreads = omp_get_num_threads();
+#endif
+			// contiguous chunk per thread, so the sort is stable
+			int begin = static_cast<int>(static_cast<long long>(n) * thread / cntThreads);
+			int end = static_cast<int>(static_cast<long long>(n) * (thread + 1) / cntThreads);
+			unsigned int* counts = &histogram[thread * 256];
+
+			for (int i = begin; i < end; ++i) {
+				++counts[(_keys[i] >> shift) & 0xff];
+			}
+
+#if defined(_OPENMP)
+#pragma omp barrier
+#pragma omp single
+#endif
+			{
+				unsigned int offset = 0;
+				for (int digit = 0; digit < 256; ++digit) {
+					for (int t = 0; t < cntThreads; ++t) {
+						unsigned int count = histogram[t * 256 + digit];
+						histogram[t * 256 + digit] = offset;
+						offset += count;
+					}
+				}
+			}
+
+			for (int i = begin; i < end; ++i) {
+				unsigned int position = counts[(_keys[i] >> shift) & 0xff]++;
+				_keysBuffer[position] = _keys[i];
+				_orderBuffer[position] = _order[i];
+			}
+		}
+
+		std::swap(_keys, _keysBuffer);
+		std::swap(_order, _orderBuffer);
+	}
+}
+
+
+/**
+ * \brief Convert a float to a key whose unsigned order is the order of the floats.
+ *
+ * \param value
+ *      Float to convert.
+ *
+ * \return Radix-key.
+ */
+uint32_t SweepAndPrune::toRadixKey(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	// negative floats are ordered reversed, positive ones only need to be above them
+	return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+
+/**
+ * \brief Copy the current AABBs of the objects into the endpoints of an axis.
+ *
+ * \param axis
+ *      Axis of the endpoints.
+ * \param aabbs
+ *      Swept AABBs of the objects.
+ */
+void SweepAndPrune::updateValues(int axis, const AabbArray &aabbs) {
+	std::vector<Endpoint> &endpoints = _endpoints[axis];
+	const float* min = aabbs.getMin(axis);
+	const float* max = aabbs.getMax(axis);
+
+	for (unsigned int i = 0; i < endpoints.size(); ++i) {
+		unsigned int object = endpoints[i].data >> 1;
+		endpoints[i].value = (endpoints[i].data & 1) ? max[object] : min[object];
+	}
+}
+
+
+/**
+ * \brief Insertion-sort of the endpoints of an axis, each swap of a min- and max-endpoint updates the overlaps.
+ *
+ * \param axis
+ *      Axis of the endpoints.
+ */
+void SweepAndPrune::sortAxis(int axis) {
+	for (unsigned int i = 1; i < _endpoints[axis].size(); ++i) {
+		sinkEndpoint(axis, i);
+	}
+}
+
+
+/**
+ * \brief Move an endpoint to the left until it's sorted, each passed endpoint of another object updates
+ *        the overlaps (see sortAxis()).
+ *
+ * \param axis
+ *      Axis of the endpoints.
+ * \param i
+ *      Position of the endpoint (the endpoints before it are sorted).
+ */
+void SweepAndPrune::sinkEndpoint(int axis, unsigned int i) {
+	std::vector<Endpoint> &endpoints = _endpoints[axis];
+	Endpoint current = endpoints[i];
+	int j = i - 1;
+
+	while (j >= 0 && isLess(current, endpoints[j])) {
+		const Endpoint &passed = endpoints[j];
+		unsigned int a = current.data >> 1;
+		unsigned int b = passed.data >> 1;
+
+		// min passes max to the left => overlap starts, max passes min to the left => overlap ends
+		if (a != b) {
+			bool currentIsMax = (current.data & 1) != 0;
+			bool passedIsMax = (passed.data & 1) != 0;
+
+			if (!currentIsMax && passedIsMax) {
+				addOverlap(a, b);
+				++_cntOverlaps[axis];
+			} else if (currentIsMax && !passedIsMax) {
+				removeOverlap(a, b);
+				--_cntOverlaps[axis];
+			}
+		}
+
+		endpoints[j + 1] = passed;
+		--j;
+	}
+
+	endpoints[j + 1] = current;
+}
+
+
+/**
+ * \brief Get the objects which overlap with an object on one axis (by the order of the endpoints).
+ *
+ * \param axis
+ *      Axis of the endpoints.
+ * \param object
+ *      Index of the object.
+ * \param res
+ *      Output-parameter: Indices of the overlapping objects (overwritten).
+ */
+void SweepAndPrune::findOverlaps(int axis, unsigned int object, std::vector<unsigned int> &res) {
+	const std::vector<Endpoint> &endpoints = _endpoints[axis];
+	unsigned int n = endpoints.size();
+	res.clear();
+	_isOpen.resize(_objects.size(), 0);
+
+	unsigned int minPosition = n;
+	unsigned int maxPosition = n;
+	for (unsigned int i = 0; i < n; ++i) {
+		if ((endpoints[i].data >> 1) == object) {
+			((endpoints[i].data & 1) ? maxPosition : minPosition) = i;
+		}
+	}
+
+	// the intervals which are open at the min-endpoint overlap, as well as the ones which start before the max-endpoint
+	for (unsigned int i = 0; i < minPosition; ++i) {
+		_isOpen[endpoints[i].data >> 1] = (endpoints[i].data & 1) == 0;
+	}
+
+	for (unsigned int i = minPosition; i < n; ++i) {
+		unsigned int other = endpoints[i].data >> 1;
+		if (other == object) continue;
+
+		if (endpoints[i].data & 1) {
+			if (_isOpen[other]) {
+				res.push_back(other);
+				_isOpen[other] = 0;
+			}
+		} else if (i < maxPosition) {
+			res.push_back(other);
+		}
+	}
+}
+
+
+/**
+ * \brief Move the overlap-state of a pair to a new key (e.g. after an object got a new index).
+ *
+ * \param oldKey, newKey
+ *      Keys of the pair.
+ */
+void SweepAndPrune::renamePair(uint64_t oldKey, uint64_t newKey) {
+	std::unordered_map<uint64_t, PairState>::iterator found = _pairs.find(oldKey);
+
+	if (found == _pairs.end()) {
+		return;
+	}
+
+	PairState state = found->second;
+	_pairs.erase(found);
+	_pairs.insert(std::make_pair(newKey, state));
+
+	if (state.candidate >= 0) {
+		_candidates[state.candidate] = newKey;
+	}
+}
+
+
+/**
+ * \brief Two objects started to overlap on one axis.
+ *
+ * \param a, b
+ *      Indices of the objects.
+ */
+void SweepAndPrune::addOverlap(unsigned int a, unsigned int b) {
+	uint64_t key = getPairKey(a, b);
+	std::unordered_map<uint64_t, PairState>::iterator found = _pairs.find(key);
+
+	if (found == _pairs.end()) {
+		PairState state;
+		state.count = 1;
+		state.candidate = -1;
+		_pairs.insert(std::make_pair(key, state));
+		return;
+	}
+
+	++found->second.count;
+
+	if (found->second.count == 3) {
+		found->second.candidate = _candidates.size();
+		_candidates.push_back(key);
+	}
+}
+
+
+/**
+ * \brief Two objects stopped to overlap on one axis.
+ *
+ * \param a, b
+ *      Indices of the objects.
+ */
+void SweepAndPrune::removeOverlap(unsigned int a, unsigned int b) {
+	uint64_t key = getPairKey(a, b);
+	std::unordered_map<uint64_t, PairState>::iterator found = _pairs.find(key);
+
+	if (found == _pairs.end()) {
+		return;
+	}
+
+	PairState &state = found->second;
+
+	// remove the candidate by moving the last one to its position
+	if (state.candidate >= 0) {
+		uint64_t last = _candidates.back();
+		_candidates[state.candidate] = last;
+		_pairs[last].candidate = state.candidate;
+		_candidates.pop_back();
+		state.candidate = -1;
+	}
+
+	--state.count;
+
+	if (state.count == 0) {
+		_pairs.erase(found);
+	}
+}
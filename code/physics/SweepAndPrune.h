@@ -0,0 +1,322 @@
+﻿/**
+ * \brief Implementation of the incremental sweep-and-prune used by the broad-phase.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-11-11
+ */
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "AabbArray.h"
+#include "GpuBroadPhase.h"
+
+namespace pbs17 {
+	class SpaceObject;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Persistent sweep-and-prune: The min- and max-endpoints of the AABBs are kept sorted per axis. Since the
+	 *        objects only move a bit per frame, the insertion-sort does only few swaps. Each swap of a min- and a
+	 *        max-endpoint starts or ends the overlap of two objects on the axis, which is counted per pair. The pairs
+	 *        which overlap on all three axes are the candidates of the broad-phase.
+	 *
+	 * The cost of an update is O(n + #swaps), so it is proportional to the motion and not to the number of candidates.
+	 *
+	 * For dense fields, where a lot of pairs overlap on single axes, the single-axis mode sorts the objects once per frame
+	 * along the axis of the largest variance (parallel radix-sort) and tests the full AABBs while sweeping. The GPU-mode
+	 * does the sort and the sweep on the device and falls back to the CPU for a step if the device fails.
+	 */
+	class SweepAndPrune {
+	public:
+		/**
+		 * \brief Available methods to find the overlapping pairs.
+		 */
+		enum Mode {
+			//! Persistent endpoints on all three axes with overlap-counters per pair
+			INCREMENTAL,
+			//! Sort along the axis of the largest variance each frame and test the full AABBs inline
+			SINGLE_AXIS,
+			//! Same as SINGLE_AXIS, but sorted and swept on the GPU (see GpuBroadPhase)
+			GPU
+		};
+
+
+		/**
+		 * \brief Constructor of the sweep-and-prune.
+		 */
+		SweepAndPrune();
+
+
+		/**
+		 * \brief Sort the endpoints of all objects and count the initial overlaps.
+		 *
+		 * \param objects
+		 *      All space-objects which are checked for collisions.
+		 */
+		void init(const std::vector<SpaceObject*> &objects);
+
+
+		/**
+		 * \brief Append an object: its endpoints are sorted in from the end of the axes, the overlaps are counted
+		 *        while they pass the other endpoints.
+		 *
+		 * \param object
+		 *      Space-object which is checked from now on (gets the last index).
+		 */
+		void insert(SpaceObject* object);
+
+
+		/**
+		 * \brief Remove an object with its endpoints and overlaps, the last object is moved to its index (same as
+		 *        BodyState::remove()).
+		 *
+		 * \param i
+		 *      Index of the removed object.
+		 */
+		void remove(unsigned int i);
+
+
+		/**
+		 * \brief Resort the endpoints to the current AABBs and get the possible collisions.
+		 *
+		 * \param aabbs
+		 *      Swept AABBs of the objects of this step (same indices).
+		 * \param res
+		 *      Output-parameter: Pairs whose AABBs overlap (overwritten). By convention, on the first position the
+		 *	                      object with the smaller id is stored (key.first.Id < key.second.Id).
+		 */
+		void update(const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res);
+
+
+		/**
+		 * \brief Set the method to find the overlapping pairs.
+		 *
+		 * \param mode
+		 *      New method.
+		 */
+		void setMode(Mode mode);
+
+
+		/**
+		 * \brief Get the method to find the overlapping pairs.
+		 *
+		 * \return Current method.
+		 */
+		Mode getMode() const {
+			return _mode;
+		}
+
+
+		/**
+		 * \brief Get the number of pairs which overlap on an axis after the last update. In the single-axis mode,
+		 * only the pairs of the sweep-axis are counted (the other axes are zero).
+		 *
+		 * \param axis
+		 *      Axis of the overlaps.
+		 *
+		 * \return Number of overlapping pairs.
+		 */
+		unsigned int getNumOverlaps(int axis) const {
+			return _cntOverlaps[axis];
+		}
+
+
+	private:
+		/**
+		 * \brief Min- or max-endpoint of an AABB on one axis.
+		 */
+		struct Endpoint {
+			//! Coordinate on the axis
+			double value;
+			//! Index of the object * 2 (+ 1 for the max-endpoint)
+			unsigned int data;
+		};
+
+
+		/**
+		 * \brief Overlap-state of a pair.
+		 */
+		struct PairState {
+			//! Number of axes on which the pair overlaps
+			unsigned char count;
+			//! Position in _candidates (-1 => not a candidate)
+			int candidate;
+		};
+
+
+		//! Method to find the overlapping pairs
+		Mode _mode = INCREMENTAL;
+
+		//! All space-objects which are checked
+		std::vector<SpaceObject*> _objects;
+
+		//! Sorted endpoints per axis
+		std::vector<Endpoint> _endpoints[3];
+
+		//! Pairs which overlap on at least one axis
+		std::unordered_map<uint64_t, PairState> _pairs;
+
+		//! Pairs which overlap on all axes
+		std::vector<uint64_t> _candidates;
+
+		//! Number of pairs which overlap per axis
+		unsigned int _cntOverlaps[3] = { 0, 0, 0 };
+		//! Flag per object if its interval is open at an endpoint (see findOverlaps())
+		std::vector<char> _isOpen;
+
+
+		//! Radix-keys and objects sorted along the sweep-axis, with buffers for the passes (single-axis mode)
+		std::vector<uint32_t> _keys;
+		std::vector<uint32_t> _keysBuffer;
+		std::vector<unsigned int> _order;
+		std::vector<unsigned int> _orderBuffer;
+
+		//! Sort and sweep on the device, with the pairs which are copied back (GPU-mode)
+		GpuBroadPhase _gpuBroadPhase;
+		std::vector<uint64_t> _gpuPairs;
+
+
+		/**
+		 * \brief Resort the persistent endpoints and get the candidates (incremental mode).
+		 *
+		 * \param aabbs
+		 *      Swept AABBs of the objects.
+		 * \param res
+		 *      Output-parameter: Overlapping pairs (overwritten).
+		 */
+		void updateIncremental(const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res);
+
+
+		/**
+		 * \brief Sort along the axis of the largest variance and sweep with a full AABB-test (single-axis mode).
+		 *
+		 * \param aabbs
+		 *      Swept AABBs of the objects (also uploaded in the GPU-mode).
+		 * \param res
+		 *      Output-parameter: Overlapping pairs (overwritten).
+		 */
+		void updateSingleAxis(const AabbArray &aabbs, std::vector<std::pair<SpaceObject *, SpaceObject *>> &res);
+
+
+		/**
+		 * \brief Parallel LSD radix-sort (4 passes of 8 bits) of _keys, _order is permuted the same way.
+		 */
+		void radixSort();
+
+
+		/**
+		 * \brief Convert a float to a key whose unsigned order is the order of the floats.
+		 *
+		 * \param value
+		 *      Float to convert.
+		 *
+		 * \return Radix-key.
+		 */
+		static uint32_t toRadixKey(float value);
+
+
+		/**
+		 * \brief Copy the current AABBs of the objects into the endpoints of an axis.
+		 *
+		 * \param axis
+		 *      Axis of the endpoints.
+		 * \param aabbs
+		 *      Swept AABBs of the objects.
+		 */
+		void updateValues(int axis, const AabbArray &aabbs);
+
+
+		/**
+		 * \brief Insertion-sort of the endpoints of an axis, each swap of a min- and max-endpoint updates the overlaps.
+		 *
+		 * \param axis
+		 *      Axis of the endpoints.
+		 */
+		void sortAxis(int axis);
+
+
+		/**
+		 * \brief Move an endpoint to the left until it's sorted, each passed endpoint of another object updates
+		 *        the overlaps (see sortAxis()).
+		 *
+		 * \param axis
+		 *      Axis of the endpoints.
+		 * \param i
+		 *      Position of the endpoint (the endpoints before it are sorted).
+		 */
+		void sinkEndpoint(int axis, unsigned int i);
+
+
+		/**
+		 * \brief Get the objects which overlap with an object on one axis (by the order of the endpoints).
+		 *
+		 * \param axis
+		 *      Axis of the endpoints.
+		 * \param object
+		 *      Index of the object.
+		 * \param res
+		 *      Output-parameter: Indices of the overlapping objects (overwritten).
+		 */
+		void findOverlaps(int axis, unsigned int object, std::vector<unsigned int> &res);
+
+
+		/**
+		 * \brief Move the overlap-state of a pair to a new key (e.g. after an object got a new index).
+		 *
+		 * \param oldKey, newKey
+		 *      Keys of the pair.
+		 */
+		void renamePair(uint64_t oldKey, uint64_t newKey);
+
+
+		/**
+		 * \brief Two objects started to overlap on one axis.
+		 *
+		 * \param a, b
+		 *      Indices of the objects.
+		 */
+		void addOverlap(unsigned int a, unsigned int b);
+
+
+		/**
+		 * \brief Two objects stopped to overlap on one axis.
+		 *
+		 * \param a, b
+		 *      Indices of the objects.
+		 */
+		void removeOverlap(unsigned int a, unsigned int b);
+
+
+		/**
+		 * \brief Get the key of a pair (independent of the order of the objects).
+		 *
+		 * \param a, b
+		 *      Indices of the objects.
+		 *
+		 * \return Key of the pair.
+		 */
+		static uint64_t getPairKey(unsigned int a, unsigned int b) {
+			return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+		}
+
+
+		/**
+		 * \brief Order of the endpoints: By the coordinate, and min-endpoints before max-endpoints, so touching
+		 *        AABBs overlap.
+		 *
+		 * \param a, b
+		 *      Endpoints to compare.
+		 *
+		 * \return True if a is before b.
+		 */
+		static bool isLess(const Endpoint &a, const Endpoint &b) {
+			return a.value < b.value || (a.value == b.value && (a.data & 1) < (b.data & 1));
+		}
+	};
+}
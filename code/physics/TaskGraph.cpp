@@ -0,0 +1,186 @@
+﻿/**
+ * \brief Implementation of a graph of tasks which are executed by a work-stealing thread-pool.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-12
+ */
+
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <unsupported/Eigen/CXX11/ThreadPool>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#include "Tracer.h"
+#include "ThreadBudget.h"
+
+using namespace pbs17;
+
+
+namespace {
+
+	//! Signals the end of a graph to the waiting thread
+	std::mutex finishedMutex;
+	std::condition_variable finished;
+}
+
+
+/**
+ * \brief Constructor of an empty graph.
+ */
+TaskGraph::TaskGraph() : _cntRemaining(0) {}
+
+
+/**
+ * \brief Add a task to the graph.
+ *
+ * \param task
+ *      Function which is executed.
+ * \param dependencies
+ *      Tasks which have to be finished before the task starts (returned by addTask()).
+ *
+ * \return Index of the task.
+ */
+int TaskGraph::addTask(const std::function<void()> &task, const std::vector<int> &dependencies) {
+	int index = _nodes.size();
+
+	std::unique_ptr<Node> node(new Node);
+	node->task = task;
+	node->cntDependencies = 0;
+	_nodes.push_back(std::move(node));
+
+	for (unsigned int k = 0; k < dependencies.size(); ++k) {
+		addDependency(index, dependencies[k]);
+	}
+
+	return index;
+}
+
+
+/**
+ * \brief Add one task per chunk of a range, e.g. a phase over all bodies.
+ *
+ * \param begin, end
+ *      Range of the indices.
+ * \param grainSize
+ *      Number of indices per chunk.
+ * \param task
+ *      Function which is executed per chunk (first and last index + 1).
+ * \param dependencies
+ *      Tasks which have to be finished before the chunks start.
+ *
+ * \return Index of the task of each chunk.
+ */
+std::vector<int> TaskGraph::addChunks(int begin, int end, int grainSize, const std::function<void(int, int)> &task,
+	const std::vector<int> &dependencies) {
+	std::vector<int> chunks;
+	grainSize = std::max(grainSize, 1);
+
+	for (int first = begin; first < end; first += grainSize) {
+		int last = std::min(first + grainSize, end);
+		chunks.push_back(addTask([task, first, last]() { task(first, last); }, dependencies));
+	}
+
+	return chunks;
+}
+
+
+/**
+ * \brief Add a dependency between two tasks (has to be added before run()).
+ *
+ * \param task
+ *      Task which has to wait.
+ * \param dependency
+ *      Task which has to be finished before.
+ */
+void TaskGraph::addDependency(int task, int dependency) {
+	_nodes[dependency]->successors.push_back(task);
+	++_nodes[task]->cntDependencies;
+}
+
+
+/**
+ * \brief Execute all tasks and wait until they are finished.
+ */
+void TaskGraph::run() {
+	int cntNodes = _nodes.size();
+	if (cntNodes == 0) {
+		return;
+	}
+
+	_cntRemaining = cntNodes;
+	for (int k = 0; k < cntNodes; ++k) {
+		_nodes[k]->cntPending = _nodes[k]->cntDependencies;
+	}
+
+	Eigen::ThreadPoolInterface &pool = getPool();
+	for (int k = 0; k < cntNodes; ++k) {
+		if (_nodes[k]->cntDependencies == 0) {
+			pool.Schedule([this, k]() { execute(k); });
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(finishedMutex);
+	finished.wait(lock, [this]() { return _cntRemaining.load() == 0; });
+}
+
+
+/**
+ * \brief Get the number of threads of the shared pool.
+ *
+ * \return Number of worker-threads.
+ */
+int TaskGraph::getNumThreads() {
+	return getPool().NumThreads();
+}
+
+
+/**
+ * \brief Execute a task and schedule the successors which have no pending dependencies anymore.
+ *
+ * \param index
+ *      Index of the task.
+ */
+void TaskGraph::execute(int index) {
+	Node &node = *_nodes[index];
+
+	{
+		TRACE_SCOPE("graphTask");
+		node.task();
+	}
+
+	// the released tasks are pushed into the queue of this thread (the others steal them if they are idle)
+	Eigen::ThreadPoolInterface &pool = getPool();
+	for (unsigned int k = 0; k < node.successors.size(); ++k) {
+		int successor = node.successors[k];
+
+		if (_nodes[successor]->cntPending.fetch_sub(1) == 1) {
+			pool.Schedule([this, successor]() { execute(successor); });
+		}
+	}
+
+	if (_cntRemaining.fetch_sub(1) == 1) {
+		// the lock makes sure the waiting thread checks the counter before or after the notification
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		finished.notify_all();
+	}
+}
+
+
+/**
+ * \brief Get the shared pool (created with the first graph, one thread per thread of the critical class).
+ *
+ * \return Thread-pool.
+ */
+Eigen::ThreadPoolInterface& TaskGraph::getPool() {
+	static Eigen::NonBlockingThreadPool pool(ThreadBudget::getNumThreads(ThreadBudget::CRITICAL));
+
+	return pool;
+}
@@ -0,0 +1,138 @@
+﻿/**
+ * \brief Implementation of a graph of tasks which are executed by a work-stealing thread-pool.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-12
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Forward declarations
+namespace Eigen {
+	class ThreadPoolInterface;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief Graph of tasks with dependencies: A task is scheduled as soon as all its dependencies are finished, so
+	 * the phases of a step can overlap (e.g. a chunk of bodies is integrated while the forces of the other chunks are
+	 * still calculated). The tasks run on a shared NonBlockingThreadPool of Eigen, where each thread pushes the tasks
+	 * it releases into its own queue and idle threads steal from the others, so uneven tasks are balanced.
+	 *
+	 * The tasks must not wait for each other (use dependencies instead), and a graph is executed only once.
+	 */
+	class TaskGraph {
+	public:
+		/**
+		 * \brief Constructor of an empty graph.
+		 */
+		TaskGraph();
+
+
+		/**
+		 * \brief Add a task to the graph.
+		 *
+		 * \param task
+		 *      Function which is executed.
+		 * \param dependencies
+		 *      Tasks which have to be finished before the task starts (returned by addTask()).
+		 *
+		 * \return Index of the task.
+		 */
+		int addTask(const std::function<void()> &task, const std::vector<int> &dependencies = std::vector<int>());
+
+
+		/**
+		 * \brief Add one task per chunk of a range, e.g. a phase over all bodies.
+		 *
+		 * \param begin, end
+		 *      Range of the indices.
+		 * \param grainSize
+		 *      Number of indices per chunk.
+		 * \param task
+		 *      Function which is executed per chunk (first and last index + 1).
+		 * \param dependencies
+		 *      Tasks which have to be finished before the chunks start.
+		 *
+		 * \return Index of the task of each chunk.
+		 */
+		std::vector<int> addChunks(int begin, int end, int grainSize, const std::function<void(int, int)> &task,
+			const std::vector<int> &dependencies = std::vector<int>());
+
+
+		/**
+		 * \brief Add a dependency between two tasks (has to be added before run()).
+		 *
+		 * \param task
+		 *      Task which has to wait.
+		 * \param dependency
+		 *      Task which has to be finished before.
+		 */
+		void addDependency(int task, int dependency);
+
+
+		/**
+		 * \brief Execute all tasks and wait until they are finished.
+		 */
+		void run();
+
+
+		/**
+		 * \brief Get the number of threads of the shared pool.
+		 *
+		 * \return Number of worker-threads.
+		 */
+		static int getNumThreads();
+
+
+	private:
+
+		/**
+		 * \brief Task with the tasks which depend on it.
+		 */
+		struct Node {
+			//! Function which is executed
+			std::function<void()> task;
+			//! Tasks which wait for this one
+			std::vector<int> successors;
+			//! Number of dependencies which are not finished yet
+			std::atomic<int> cntPending;
+			//! Number of dependencies
+			int cntDependencies;
+		};
+
+		//! Tasks of the graph (stable addresses, they are referenced by the threads)
+		std::vector<std::unique_ptr<Node>> _nodes;
+
+		//! Number of tasks which are not finished yet
+		std::atomic<int> _cntRemaining;
+
+
+		/**
+		 * \brief Execute a task and schedule the successors which have no pending dependencies anymore.
+		 *
+		 * \param index
+		 *      Index of the task.
+		 */
+		void execute(int index);
+
+
+		/**
+		 * \brief Get the shared pool (created with the first graph, one thread per OpenMP-thread).
+		 *
+		 * \return Thread-pool.
+		 */
+		static Eigen::ThreadPoolInterface& getPool();
+
+
+		//! A graph is referenced by its tasks
+		TaskGraph(TaskGraph const&) = delete;
+		TaskGraph& operator=(TaskGraph const&) = delete;
+	};
+}
@@ -0,0 +1,168 @@
+﻿/**
+ * \brief Implementation of the process-wide budget of the threads (physics, rendering and background-work).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include "ThreadBudget.h"
+
+#include <algorithm>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace pbs17;
+
+
+//! Pointer to the only instance of this class.
+ThreadBudget* ThreadBudget::_pInstance = nullptr;
+
+//! By default, all cores are used, one is left to the rendering and one to the background-work
+int ThreadBudget::CNT_CORES = 0;
+int ThreadBudget::CNT_RENDER_THREADS = 1;
+int ThreadBudget::CNT_BACKGROUND_THREADS = 1;
+bool ThreadBudget::HAS_CRITICAL = false;
+
+//! The physics keeps the default priority, the rendering is slightly and the background-work clearly lower
+const int ThreadBudget::NICENESS[3] = { 0, 2, 10 };
+
+
+/**
+ * \brief Singleton instance of the ThreadBudget-class.
+ */
+ThreadBudget* ThreadBudget::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new ThreadBudget();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Queue a task for the shared workers (started with the first task). The tasks of the render-class are
+ *        taken first, critical work has to run on the team of the physics.
+ *
+ * \param priority
+ *      Class of the task (RENDER or BACKGROUND).
+ * \param task
+ *      Work to do (must not throw).
+ */
+void ThreadBudget::submit(Priority priority, const std::function<void()> &task) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_tasks[priority == RENDER ? 0 : 1].push_back(task);
+
+	if (_workers.empty()) {
+		for (int i = 0; i < getNumThreads(BACKGROUND); ++i) {
+			_workers.push_back(std::thread([this]() { work(); }));
+			_workers.back().detach();
+		}
+	}
+
+	_notEmpty.notify_one();
+}
+
+
+/**
+ * \brief Give the calling thread the priority of its class and size its OpenMP-team to the budget of the class.
+ *
+ * \param priority
+ *      Class of the calling thread.
+ */
+void ThreadBudget::enterThread(Priority priority) {
+	if (priority == CRITICAL) {
+		HAS_CRITICAL = true;
+	}
+
+#if defined(_OPENMP)
+	omp_set_num_threads(getNumThreads(priority));
+#endif
+	setThreadPriority(priority);
+}
+
+
+/**
+ * \brief Get the number of threads of a class.
+ *
+ * \param priority
+ *      Class of the threads.
+ *
+ * \return Number of threads (at least 1).
+ */
+int ThreadBudget::getNumThreads(Priority priority) {
+	int cores = getNumCores();
+
+	if (priority == BACKGROUND) {
+		return std::max(std::min(CNT_BACKGROUND_THREADS, cores - 1), 1);
+	}
+
+	// the loops of the rendering only compete with the physics when it runs
+	if (priority == RENDER) {
+		return HAS_CRITICAL ? std::max(std::min(CNT_RENDER_THREADS, cores - 1), 1) : cores;
+	}
+
+	return std::max(cores - CNT_RENDER_THREADS - CNT_BACKGROUND_THREADS, 1);
+}
+
+
+/**
+ * \brief Get the number of cores of the budget.
+ *
+ * \return Configured cores or all cores of the machine.
+ */
+int ThreadBudget::getNumCores() {
+	if (CNT_CORES > 0) {
+		return CNT_CORES;
+	}
+
+	return std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+}
+
+
+/**
+ * \brief Main-loop of a worker: run the queued tasks, the render-class first (waits while the queues are empty).
+ */
+void ThreadBudget::work() {
+	// without privileges the niceness can't be decreased again => the render-class is only preferred by the order
+	setThreadPriority(BACKGROUND);
+
+	while (true) {
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_notEmpty.wait(lock, [this]() { return !_tasks[0].empty() || !_tasks[1].empty(); });
+
+			int queue = _tasks[0].empty() ? 1 : 0;
+			task = _tasks[queue].front();
+			_tasks[queue].pop_front();
+		}
+
+		task();
+	}
+}
+
+
+/**
+ * \brief Set the priority of the OS of the calling thread (Linux).
+ *
+ * \param priority
+ *      Class of the thread.
+ */
+void ThreadBudget::setThreadPriority(Priority priority) {
+#if defined(__linux__)
+	// the niceness of Linux is set per thread (and inherited by the threads and processes it starts)
+	setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), NICENESS[priority]);
+#else
+	(void) priority;
+#endif
+}
@@ -0,0 +1,175 @@
+﻿/**
+ * \brief Implementation of the process-wide budget of the threads (physics, rendering and background-work).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+namespace pbs17 {
+
+	/**
+	 * \brief ThreadBudget divides the cores of the process between three priority-classes, so the subsystems which
+	 * start their own threads do not oversubscribe the cores and the physics does not compete with background-work:
+	 *  - CRITICAL: The team of the physics-thread (OpenMP and the pool of the task-graphs) gets all cores which are
+	 *    not reserved for the other classes.
+	 *  - RENDER: The threads of the rendering (the team of the main-thread while a physics-thread simulates).
+	 *  - BACKGROUND: Asset- and texture-decoding, capture-encoding, recording and the database-pager of OSG. The
+	 *    work is submitted to a few shared workers, which run with a lower priority of the OS.
+	 * The workers take the submitted work of the render-class before the one of the background-class. While no
+	 * team of the critical class exists (e.g. while the scene is loaded), the OpenMP-loops of the rendering may use
+	 * all cores.
+	 * The number of cores and of the reserved threads have to be set before the threads are started.
+	 */
+	class ThreadBudget {
+	public:
+		/**
+		 * \brief Priority-classes of the threads (highest first).
+		 */
+		enum Priority {
+			//! Critical path of the physics
+			CRITICAL,
+			//! Rendering and the work which a frame waits for
+			RENDER,
+			//! Loading, decoding, encoding and writing
+			BACKGROUND
+		};
+
+
+		/**
+		 * \brief Singleton instance of the ThreadBudget-class.
+		 */
+		static ThreadBudget* Instance();
+
+
+		/**
+		 * \brief Queue a task for the shared workers (started with the first task). The tasks of the render-class are
+		 *        taken first, critical work has to run on the team of the physics.
+		 *
+		 * \param priority
+		 *      Class of the task (RENDER or BACKGROUND).
+		 * \param task
+		 *      Work to do (must not throw).
+		 */
+		void submit(Priority priority, const std::function<void()> &task);
+
+
+		/**
+		 * \brief Give the calling thread the priority of its class and size its OpenMP-team to the budget of the class.
+		 *
+		 * \param priority
+		 *      Class of the calling thread.
+		 */
+		static void enterThread(Priority priority);
+
+
+		/**
+		 * \brief Get the number of threads of a class.
+		 *
+		 * \param priority
+		 *      Class of the threads.
+		 *
+		 * \return Number of threads (at least 1).
+		 */
+		static int getNumThreads(Priority priority);
+
+
+		/**
+		 * \brief Get the number of cores of the budget.
+		 *
+		 * \return Configured cores or all cores of the machine.
+		 */
+		static int getNumCores();
+
+
+		/**
+		 * \brief Set the number of cores which are used by the process.
+		 *
+		 * \param cores
+		 *      Number of cores (<= 0 => all cores of the machine).
+		 */
+		static void setNumCores(int cores) {
+			CNT_CORES = cores;
+		}
+
+
+		/**
+		 * \brief Set the number of threads of the rendering (the physics does not use their cores).
+		 *
+		 * \param threads
+		 *      Number of reserved threads.
+		 */
+		static void setRenderThreads(int threads) {
+			CNT_RENDER_THREADS = threads > 0 ? threads : 1;
+		}
+
+
+		/**
+		 * \brief Set the number of shared workers for the background-work (the physics does not use their cores).
+		 *
+		 * \param threads
+		 *      Number of workers.
+		 */
+		static void setBackgroundThreads(int threads) {
+			CNT_BACKGROUND_THREADS = threads > 0 ? threads : 1;
+		}
+
+
+	private:
+		//! Cores of the process (<= 0 => all cores of the machine)
+		static int CNT_CORES;
+		//! Threads which are reserved for the rendering
+		static int CNT_RENDER_THREADS;
+		//! Shared workers of the background-work
+		static int CNT_BACKGROUND_THREADS;
+		//! True after the first thread of the critical class entered (the loading is done)
+		static bool HAS_CRITICAL;
+		//! Niceness of the OS per class (only lowered, so no privileges are needed)
+		static const int NICENESS[3];
+
+		//! Queued tasks of the render- and the background-class
+		std::deque<std::function<void()> > _tasks[2];
+		//! Shared workers (started with the first task)
+		std::vector<std::thread> _workers;
+		//! Protects the queues and the workers
+		std::mutex _mutex;
+		//! Signaled if a task has been queued
+		std::condition_variable _notEmpty;
+
+
+		/**
+		 * \brief Main-loop of a worker: run the queued tasks, the render-class first (waits while the queues are empty).
+		 */
+		void work();
+
+
+		/**
+		 * \brief Set the priority of the OS of the calling thread (Linux).
+		 *
+		 * \param priority
+		 *      Class of the thread.
+		 */
+		static void setThreadPriority(Priority priority);
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		ThreadBudget() {}
+
+		//! Private copy-constructor to prevent copying the class.
+		ThreadBudget(ThreadBudget const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		ThreadBudget& operator=(ThreadBudget const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static ThreadBudget* _pInstance;
+	};
+}
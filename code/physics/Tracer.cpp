@@ -0,0 +1,141 @@
+﻿/**
+ * \brief Implementation of the recorder of the spans in the chrome trace-event format.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#include "Tracer.h"
+#include "Logger.h"
+
+#include <fstream>
+#include <iostream>
+
+#include <OpenThreads/ScopedLock>
+
+using namespace pbs17;
+
+
+//! Pointer to the only instance of this class.
+Tracer* Tracer::_pInstance = nullptr;
+
+//! About 100 MB per thread.
+const unsigned int Tracer::MAX_EVENTS_PER_THREAD = 1 << 22;
+
+
+namespace {
+	//! Buffer of each thread (owned by the tracer)
+	thread_local void* threadBuffer = nullptr;
+}
+
+
+/**
+ * \brief Singleton instance of the Tracer-class.
+ */
+Tracer* Tracer::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new Tracer();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Start recording the spans.
+ *
+ * \param filePath
+ *      Complete path to the json-file of the trace (written by close()).
+ */
+void Tracer::open(std::string filePath) {
+	_filePath = filePath;
+	_start = osg::Timer::instance()->tick();
+	_isOpen = true;
+}
+
+
+/**
+ * \brief Stop recording and write all spans into the file.
+ *
+ * \return False if the file can't be written.
+ */
+bool Tracer::close() {
+	if (!_isOpen) return true;
+	_isOpen = false;
+
+	std::ofstream file(_filePath, std::ios::out | std::ios::trunc);
+	if (!file) return false;
+
+	const osg::Timer* timer = osg::Timer::instance();
+	unsigned long cntDropped = 0;
+	bool isFirst = true;
+
+	// complete-events ("X") with the timestamps and durations in microseconds
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	file << "{\"traceEvents\":[\n";
+
+	for (unsigned int b = 0; b < _buffers.size(); ++b) {
+		const ThreadBuffer* buffer = _buffers[b];
+		cntDropped += buffer->cntDropped;
+
+		for (unsigned int i = 0; i < buffer->events.size(); ++i) {
+			const Event &event = buffer->events[i];
+
+			file << (isFirst ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << buffer->tid
+				<< ",\"ts\":" << timer->delta_u(_start, event.start) << ",\"dur\":" << timer->delta_u(event.start, event.end) << "}";
+			isFirst = false;
+		}
+	}
+
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	if (cntDropped > 0) {
+		LOG_WARNING("Dropped trace-events: " << cntDropped);
+	}
+
+	return static_cast<bool>(file);
+}
+
+
+/**
+ * \brief Record a span of the current thread (ignored if the trace is not open).
+ *
+ * \param name
+ *      Name of the span.
+ * \param start, end
+ *      Begin and end of the span.
+ */
+void Tracer::addSpan(const char* name, osg::Timer_t start, osg::Timer_t end) {
+	if (!_isOpen) return;
+
+	ThreadBuffer* buffer = getThreadBuffer();
+	if (buffer->events.size() >= MAX_EVENTS_PER_THREAD) {
+		++buffer->cntDropped;
+		return;
+	}
+
+	Event event = { name, start, end };
+	buffer->events.push_back(event);
+}
+
+
+/**
+ * \brief Get the buffer of the current thread (created with the first span of the thread).
+ *
+ * \return Buffer of the thread.
+ */
+Tracer::ThreadBuffer* Tracer::getThreadBuffer() {
+	if (threadBuffer == nullptr) {
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+		ThreadBuffer* buffer = new ThreadBuffer;
+		buffer->tid = _buffers.size();
+		buffer->cntDropped = 0;
+		_buffers.push_back(buffer);
+
+		threadBuffer = buffer;
+	}
+
+	return static_cast<ThreadBuffer*>(threadBuffer);
+}
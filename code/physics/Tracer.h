@@ -0,0 +1,170 @@
+﻿/**
+ * \brief Functionality for recording the spans of the simulation-loop in the chrome trace-event format.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <osg/Timer>
+#include <OpenThreads/Mutex>
+
+
+// The spans are only recorded if the tracing is compiled in (cmake -DPBS17_TRACING=ON), otherwise they are removed.
+#if defined(PBS17_TRACING)
+#define PBS17_TRACE_CONCAT_(a, b) a##b
+#define PBS17_TRACE_CONCAT(a, b) PBS17_TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) pbs17::Tracer::Span PBS17_TRACE_CONCAT(traceSpan, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Tracer records begin/end-spans of the phases and the parallel tasks, so the outliers of single frames
+	 * and the load of the threads can be inspected in chrome://tracing (or any viewer of the trace-event format).
+	 * Each thread records into its own buffer (no locking per span), the buffers are written when the trace is closed.
+	 */
+	class Tracer {
+	public:
+
+		/**
+		 * \brief Records the span from its construction to its destruction.
+		 */
+		class Span {
+		public:
+
+			/**
+			 * \brief Begin a span.
+			 *
+			 * \param name
+			 *      Name of the span (has to live until the trace is closed, e.g. a string-literal).
+			 */
+			explicit Span(const char* name) : _name(name), _start(osg::Timer::instance()->tick()) {}
+
+
+			/**
+			 * \brief End the span.
+			 */
+			~Span() {
+				Tracer::Instance()->addSpan(_name, _start, osg::Timer::instance()->tick());
+			}
+
+
+		private:
+
+			//! Name of the span
+			const char* _name;
+
+			//! Begin of the span
+			osg::Timer_t _start;
+
+			Span(Span const&) = delete;
+			Span& operator=(Span const&) = delete;
+		};
+
+
+		/**
+		 * \brief Singleton instance of the Tracer-class.
+		 */
+		static Tracer* Instance();
+
+
+		/**
+		 * \brief Start recording the spans.
+		 *
+		 * \param filePath
+		 *      Complete path to the json-file of the trace (written by close()).
+		 */
+		void open(std::string filePath);
+
+
+		/**
+		 * \brief Stop recording and write all spans into the file.
+		 *
+		 * \return False if the file can't be written.
+		 */
+		bool close();
+
+
+		/**
+		 * \brief Record a span of the current thread (ignored if the trace is not open).
+		 *
+		 * \param name
+		 *      Name of the span.
+		 * \param start, end
+		 *      Begin and end of the span.
+		 */
+		void addSpan(const char* name, osg::Timer_t start, osg::Timer_t end);
+
+
+	private:
+
+		/**
+		 * \brief Recorded span.
+		 */
+		struct Event {
+			//! Name of the span
+			const char* name;
+			//! Begin and end of the span
+			osg::Timer_t start, end;
+		};
+
+		/**
+		 * \brief Spans of one thread.
+		 */
+		struct ThreadBuffer {
+			//! Index of the thread in the trace
+			unsigned int tid;
+			//! Recorded spans
+			std::vector<Event> events;
+			//! Number of dropped spans
+			unsigned long cntDropped;
+		};
+
+		//! Maximal number of spans per thread (the further spans are dropped)
+		static const unsigned int MAX_EVENTS_PER_THREAD;
+
+		//! Buffers of all threads which have recorded a span
+		std::vector<ThreadBuffer*> _buffers;
+
+		//! Path of the trace-file
+		std::string _filePath;
+
+		//! Begin of the trace (timestamp zero)
+		osg::Timer_t _start;
+
+		//! True while the spans are recorded
+		volatile bool _isOpen;
+
+		//! Protects the list of the buffers.
+		OpenThreads::Mutex _mutex;
+
+
+		/**
+		 * \brief Get the buffer of the current thread (created with the first span of the thread).
+		 *
+		 * \return Buffer of the thread.
+		 */
+		ThreadBuffer* getThreadBuffer();
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		Tracer() : _start(0), _isOpen(false) {}
+
+		//! Private copy-constructor to prevent copying the class.
+		Tracer(Tracer const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		Tracer& operator=(Tracer const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static Tracer* _pInstance;
+	};
+}
@@ -0,0 +1,438 @@
+﻿/**
+ * \brief Implementation of the playback of a recorded trajectory-log.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#include "TrajectoryPlayer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <osg/Quat>
+
+#include "TrajectoryRecorder.h"
+#include "Profiler.h"
+#include "../scene/SpaceObject.h"
+#include "Logger.h"
+
+using namespace pbs17;
+
+
+//! Pointer to the only instance of this class.
+TrajectoryPlayer* TrajectoryPlayer::_pInstance = nullptr;
+
+const double TrajectoryPlayer::MIN_SPEED = 1.0 / 64.0;
+const double TrajectoryPlayer::MAX_SPEED = 1024.0;
+const double TrajectoryPlayer::STEPS_PER_SECOND = 60.0;
+
+
+namespace {
+	//! Size of the header of the file without the ids (magic, version, bodies, interval, flags, quantization)
+	const size_t HEADER_SIZE = 8 + 4 * sizeof(uint32_t) + sizeof(double);
+
+	//! Size of the header of a chunk (type, items, step, time, size of the payload)
+	const size_t CHUNK_HEADER_SIZE = 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t) + sizeof(double);
+}
+
+
+/**
+ * \brief Read a value at an offset of the log.
+ */
+template <typename T>
+T TrajectoryPlayer::read(size_t offset) const {
+	// the values of the log are not aligned
+	T value;
+	std::memcpy(&value, _data + offset, sizeof(T));
+	return value;
+}
+
+
+/**
+ * \brief Singleton instance of the TrajectoryPlayer-class.
+ */
+TrajectoryPlayer* TrajectoryPlayer::Instance() {
+	// singleton-implementation => if there is not yet an instance initialized, create one.
+	if (!_pInstance) {
+		_pInstance = new TrajectoryPlayer();
+	}
+
+	return _pInstance;
+}
+
+
+/**
+ * \brief Load a log and assign its bodies to the space-objects of the scene (by their ids).
+ *
+ * \param filePath
+ *      Complete path of the log.
+ * \param spaceObjects
+ *      All space-objects of the scene (the same scene as recorded).
+ *
+ * \return False if the file is not a trajectory-log.
+ */
+bool TrajectoryPlayer::load(std::string filePath, const std::vector<SpaceObject*> &spaceObjects) {
+	unload();
+
+#if defined(_WIN32)
+	// no mapping on windows, the whole file is read
+	std::ifstream file(filePath, std::ios::in | std::ios::binary);
+	if (!file) return false;
+
+	_content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	_data = _content.data();
+	_size = _content.size();
+#else
+	int fd = ::open(filePath.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* map = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED) return false;
+
+	_data = static_cast<const char*>(map);
+	_size = static_cast<size_t>(info.st_size);
+#endif
+
+	if (_size < HEADER_SIZE || std::memcmp(_data, "PBSTRAJ1", 8) != 0 || read<uint32_t>(8) != 1) {
+		unload();
+		return false;
+	}
+
+	_cntBodies = read<uint32_t>(12);
+	_quantization = read<uint32_t>(20) != 0 ? read<double>(24) : 0.0;
+
+	size_t offset = HEADER_SIZE + _cntBodies * sizeof(int64_t);
+	if (offset > _size) {
+		unload();
+		return false;
+	}
+
+	// the bodies are assigned by their ids, so the order of the scene does not matter
+	std::map<long, SpaceObject*> objectsById;
+	for (unsigned int i = 0; i < spaceObjects.size(); ++i) {
+		objectsById[spaceObjects[i]->getId()] = spaceObjects[i];
+	}
+
+	_objects.assign(_cntBodies, nullptr);
+	for (unsigned int i = 0; i < _cntBodies; ++i) {
+		std::map<long, SpaceObject*>::const_iterator it = objectsById.find(static_cast<long>(read<int64_t>(HEADER_SIZE + i * sizeof(int64_t))));
+		if (it != objectsById.end()) {
+			_objects[i] = it->second;
+		}
+	}
+
+	// index the frames (a truncated chunk at the end, e.g. of a crashed recording, is ignored)
+	int keyFrame = -1;
+	while (offset + CHUNK_HEADER_SIZE <= _size) {
+		uint32_t type = read<uint32_t>(offset);
+		uint32_t cntItems = read<uint32_t>(offset + 4);
+		uint64_t payloadSize = read<uint64_t>(offset + 24);
+
+		if (payloadSize > _size - offset - CHUNK_HEADER_SIZE) break;
+
+		if (type == TrajectoryRecorder::KEY_FRAME) {
+			keyFrame = _frames.size();
+		}
+
+		bool isFrame = type == TrajectoryRecorder::RAW_FRAME || type == TrajectoryRecorder::KEY_FRAME
+			|| (type == TrajectoryRecorder::DELTA_FRAME && keyFrame >= 0);
+
+		if (isFrame && cntItems == _cntBodies) {
+			FrameIndex frame;
+			frame.offset = offset + CHUNK_HEADER_SIZE;
+			frame.type = type;
+			frame.step = read<uint64_t>(offset + 8);
+			frame.time = read<double>(offset + 16);
+			frame.keyFrame = std::max(keyFrame, 0);
+			_frames.push_back(frame);
+		}
+
+		offset += CHUNK_HEADER_SIZE + payloadSize;
+	}
+
+	if (_frames.empty()) {
+		unload();
+		return false;
+	}
+
+	_quantized.assign(3 * _cntBodies, 0);
+	_quantizedFrame = -1;
+	_step = static_cast<double>(_frames.front().step);
+
+	LOG_INFO("Replay of " << _frames.size() << " frames with " << _cntBodies << " bodies (steps " << _frames.front().step
+		<< " - " << _frames.back().step << ")");
+
+	return true;
+}
+
+
+/**
+ * \brief Advance the playback and write the interpolated state to the space-objects. Has to be called from
+ *        the rendering-thread (e.g. by an update-callback).
+ *
+ * \param elapsed
+ *      Elapsed time since the last update in seconds.
+ */
+void TrajectoryPlayer::update(double elapsed) {
+	if (!isLoaded()) return;
+
+	Profiler::ScopedTimer timer(Profiler::SCENE_SYNC);
+
+	// the playback is paused with the simulation (see SimulationKeyboardHandler)
+	if (!_isPaused) {
+		_step += _speed * elapsed * STEPS_PER_SECOND;
+	}
+	_step = std::max(static_cast<double>(_frames.front().step), std::min(_step, static_cast<double>(_frames.back().step)));
+
+	// last frame at or before the current step
+	unsigned int i = std::upper_bound(_frames.begin(), _frames.end(), _step, [](double step, const FrameIndex &frame) {
+		return step < static_cast<double>(frame.step);
+	}) - _frames.begin() - 1;
+	unsigned int j = std::min(i + 1, static_cast<unsigned int>(_frames.size() - 1));
+
+	// while playing forward, the next frame of the last update becomes the current one
+	if (_decoded[0].index != static_cast<int>(i)) {
+		if (_decoded[1].index == static_cast<int>(i)) {
+			std::swap(_decoded[0], _decoded[1]);
+		} else {
+			decode(i, _decoded[0]);
+		}
+	}
+	if (_decoded[1].index != static_cast<int>(j)) {
+		decode(j, _decoded[1]);
+	}
+
+	double alpha = 0.0;
+	if (j != i) {
+		alpha = (_step - _frames[i].step) / static_cast<double>(_frames[j].step - _frames[i].step);
+	}
+
+	const Frame &a = _decoded[0];
+	const Frame &b = _decoded[1];
+
+	for (unsigned int k = 0; k < _cntBodies; ++k) {
+		if (_objects[k] == nullptr) continue;
+
+		Eigen::Vector3d position(a.x[k] + (b.x[k] - a.x[k]) * alpha, a.y[k] + (b.y[k] - a.y[k]) * alpha, a.z[k] + (b.z[k] - a.z[k]) * alpha);
+		osg::Quat orientation;
+		orientation.slerp(alpha, osg::Quat(a.qx[k], a.qy[k], a.qz[k], a.qw[k]), osg::Quat(b.qx[k], b.qy[k], b.qz[k], b.qw[k]));
+
+		_objects[k]->setPositionOrientation(position, orientation);
+		_objects[k]->updateTransformation();
+	}
+}
+
+
+/**
+ * \brief Move the playback by a part of the whole log.
+ *
+ * \param fraction
+ *      Part of the log (negative => backwards).
+ */
+void TrajectoryPlayer::seek(double fraction) {
+	if (!isLoaded()) return;
+
+	double first = static_cast<double>(_frames.front().step);
+	double last = static_cast<double>(_frames.back().step);
+	_step = std::max(first, std::min(_step + fraction * (last - first), last));
+
+	LOG_INFO("Replay at step " << _step);
+}
+
+
+/**
+ * \brief Move the playback to a time of the rendered playback (e.g. the first frame of a range of a video).
+ *
+ * \param seconds
+ *      Time since the first frame of the log at the current speed.
+ */
+void TrajectoryPlayer::seekTime(double seconds) {
+	if (!isLoaded()) return;
+
+	// the key-frame of the step is found by the index, nothing before it is decoded
+	double first = static_cast<double>(_frames.front().step);
+	double last = static_cast<double>(_frames.back().step);
+	_step = std::max(first, std::min(first + _speed * seconds * STEPS_PER_SECOND, last));
+}
+
+
+/**
+ * \brief Get the length of the rendered playback.
+ *
+ * \return Time from the first to the last frame of the log at the current speed: unit = s
+ */
+double TrajectoryPlayer::getDuration() const {
+	if (!isLoaded()) return 0.0;
+
+	return static_cast<double>(_frames.back().step - _frames.front().step) / (_speed * STEPS_PER_SECOND);
+}
+
+
+/**
+ * \brief Move the playback to the first frame.
+ */
+void TrajectoryPlayer::rewind() {
+	if (!isLoaded()) return;
+
+	_step = static_cast<double>(_frames.front().step);
+}
+
+
+/**
+ * \brief Multiply the speed of the playback.
+ *
+ * \param factor
+ *      Factor of the speed (the speed is clamped to [MIN_SPEED, MAX_SPEED]).
+ */
+void TrajectoryPlayer::scaleSpeed(double factor) {
+	_speed = std::max(MIN_SPEED, std::min(_speed * factor, MAX_SPEED));
+
+	LOG_INFO("Replay speed: " << _speed << "x");
+}
+
+
+/**
+ * \brief Get the id of a body of the log.
+ *
+ * \param body
+ *      Index of the body in the frames.
+ *
+ * \return Id of the recorded space-object.
+ */
+long TrajectoryPlayer::getBodyId(unsigned int body) const {
+	return static_cast<long>(read<int64_t>(HEADER_SIZE + body * sizeof(int64_t)));
+}
+
+
+/**
+ * \brief Decode the state of a frame without writing it to the space-objects (e.g. for the analysis of a log).
+ *
+ * \param index
+ *      Index of the frame.
+ * \param positions
+ *      Output-parameter: Positions of all bodies (x of all bodies, then y and z).
+ * \param orientations
+ *      Output-parameter: Orientations of all bodies (x of all bodies, then y, z and w).
+ */
+void TrajectoryPlayer::readFrame(unsigned int index, std::vector<double> &positions, std::vector<double> &orientations) {
+	Frame frame;
+	decode(index, frame);
+
+	const std::vector<double>* p[3] = { &frame.x, &frame.y, &frame.z };
+	const std::vector<double>* q[4] = { &frame.qx, &frame.qy, &frame.qz, &frame.qw };
+
+	positions.clear();
+	orientations.clear();
+	for (unsigned int c = 0; c < 3; ++c) {
+		positions.insert(positions.end(), p[c]->begin(), p[c]->end());
+	}
+	for (unsigned int c = 0; c < 4; ++c) {
+		orientations.insert(orientations.end(), q[c]->begin(), q[c]->end());
+	}
+}
+
+
+/**
+ * \brief Decode a frame (the quantized frames based on the last decoded frame or their key-frame).
+ *
+ * \param index
+ *      Index of the frame.
+ * \param frame
+ *      Output-parameter: Decoded frame.
+ */
+void TrajectoryPlayer::decode(unsigned int index, Frame &frame) {
+	const FrameIndex &info = _frames[index];
+	const size_t n = _cntBodies;
+
+	std::vector<double>* positions[3] = { &frame.x, &frame.y, &frame.z };
+	std::vector<double>* orientations[4] = { &frame.qx, &frame.qy, &frame.qz, &frame.qw };
+
+	if (info.type == TrajectoryRecorder::RAW_FRAME) {
+		for (unsigned int c = 0; c < 3; ++c) {
+			positions[c]->resize(n);
+			std::memcpy(positions[c]->data(), _data + info.offset + c * n * sizeof(double), n * sizeof(double));
+		}
+		for (unsigned int c = 0; c < 4; ++c) {
+			orientations[c]->resize(n);
+			std::memcpy(orientations[c]->data(), _data + info.offset + (3 + c) * n * sizeof(double), n * sizeof(double));
+		}
+
+		frame.index = index;
+		return;
+	}
+
+	// roll the quantized positions forward, from the last decoded frame if it's of the same key-frame
+	unsigned int first = info.keyFrame;
+	if (_quantizedFrame >= static_cast<int>(info.keyFrame) && _quantizedFrame <= static_cast<int>(index)) {
+		first = _quantizedFrame + 1;
+	}
+
+	for (unsigned int f = first; f <= index; ++f) {
+		const FrameIndex &delta = _frames[f];
+
+		if (delta.type == TrajectoryRecorder::KEY_FRAME) {
+			std::memcpy(_quantized.data(), _data + delta.offset, 3 * n * sizeof(int64_t));
+		} else {
+			for (size_t k = 0; k < 3 * n; ++k) {
+				_quantized[k] += read<int32_t>(delta.offset + k * sizeof(int32_t));
+			}
+		}
+	}
+	_quantizedFrame = index;
+
+	for (unsigned int c = 0; c < 3; ++c) {
+		positions[c]->resize(n);
+		for (size_t k = 0; k < n; ++k) {
+			(*positions[c])[k] = _quantized[c * n + k] * _quantization;
+		}
+	}
+
+	size_t offset = info.offset + 3 * n * (info.type == TrajectoryRecorder::KEY_FRAME ? sizeof(int64_t) : sizeof(int32_t));
+	for (unsigned int c = 0; c < 4; ++c) {
+		orientations[c]->resize(n);
+		for (size_t k = 0; k < n; ++k) {
+			(*orientations[c])[k] = read<float>(offset + (c * n + k) * sizeof(float));
+		}
+	}
+
+	frame.index = index;
+}
+
+
+/**
+ * \brief Unmap the loaded log.
+ */
+void TrajectoryPlayer::unload() {
+#if !defined(_WIN32)
+	if (_data != nullptr) {
+		munmap(const_cast<char*>(_data), _size);
+	}
+#endif
+
+	_content.clear();
+	_data = nullptr;
+	_size = 0;
+	_frames.clear();
+	_objects.clear();
+	_decoded[0].index = -1;
+	_decoded[1].index = -1;
+	_quantizedFrame = -1;
+}
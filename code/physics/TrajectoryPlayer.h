@@ -0,0 +1,303 @@
+﻿/**
+ * \brief Implementation of the playback of a recorded trajectory-log.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+
+// forward declarations
+namespace pbs17 {
+	class SpaceObject;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Plays a log of the TrajectoryRecorder back: The recorded states are interpolated and written directly into
+	 * the space-objects (and their OSG-nodes) without running the physics, so heavy scenes can be presented at the full
+	 * frame-rate. The playback can be paused (like the simulation), sped up, slowed down and moved to any position.
+	 *
+	 * The log is mapped into the memory and only indexed when it's loaded, the frames are decoded when they are needed.
+	 */
+	class TrajectoryPlayer {
+	public:
+
+		/**
+		 * \brief Singleton instance of the TrajectoryPlayer-class.
+		 */
+		static TrajectoryPlayer* Instance();
+
+
+		/**
+		 * \brief Load a log and assign its bodies to the space-objects of the scene (by their ids).
+		 *
+		 * \param filePath
+		 *      Complete path of the log.
+		 * \param spaceObjects
+		 *      All space-objects of the scene (the same scene as recorded).
+		 *
+		 * \return False if the file is not a trajectory-log.
+		 */
+		bool load(std::string filePath, const std::vector<SpaceObject*> &spaceObjects);
+
+
+		/**
+		 * \brief Get if a log is loaded (=> the playback replaces the simulation).
+		 *
+		 * \return True if a log is loaded.
+		 */
+		bool isLoaded() const {
+			return !_frames.empty();
+		}
+
+
+		/**
+		 * \brief Advance the playback and write the interpolated state to the space-objects. Has to be called from
+		 *        the rendering-thread (e.g. by an update-callback).
+		 *
+		 * \param elapsed
+		 *      Elapsed time since the last update in seconds.
+		 */
+		void update(double elapsed);
+
+
+		/**
+		 * \brief Move the playback by a part of the whole log.
+		 *
+		 * \param fraction
+		 *      Part of the log (negative => backwards).
+		 */
+		void seek(double fraction);
+
+
+		/**
+		 * \brief Move the playback to a time of the rendered playback (e.g. the first frame of a range of a video).
+		 *
+		 * \param seconds
+		 *      Time since the first frame of the log at the current speed.
+		 */
+		void seekTime(double seconds);
+
+
+		/**
+		 * \brief Get the length of the rendered playback.
+		 *
+		 * \return Time from the first to the last frame of the log at the current speed: unit = s
+		 */
+		double getDuration() const;
+
+
+		/**
+		 * \brief Move the playback to the first frame.
+		 */
+		void rewind();
+
+
+		/**
+		 * \brief Multiply the speed of the playback.
+		 *
+		 * \param factor
+		 *      Factor of the speed (the speed is clamped to [MIN_SPEED, MAX_SPEED]).
+		 */
+		void scaleSpeed(double factor);
+
+
+		/**
+		 * \brief Get the speed of the playback.
+		 *
+		 * \return Recorded steps per rendered step of the live simulation (1 => same speed).
+		 */
+		double getSpeed() const {
+			return _speed;
+		}
+
+
+		/**
+		 * \brief Pause or continue the playback (e.g. with the simulation).
+		 *
+		 * \param isPaused
+		 *      True if the playback is paused.
+		 */
+		void setIsPaused(const bool isPaused) {
+			_isPaused = isPaused;
+		}
+
+
+		/**
+		 * \brief Get the number of frames of the loaded log.
+		 *
+		 * \return Frames of the log (0 => no log is loaded).
+		 */
+		unsigned int getNumFrames() const {
+			return _frames.size();
+		}
+
+
+		/**
+		 * \brief Get the number of bodies per frame of the loaded log.
+		 *
+		 * \return Bodies per frame.
+		 */
+		unsigned int getNumBodies() const {
+			return _cntBodies;
+		}
+
+
+		/**
+		 * \brief Get the simulated step of a frame.
+		 *
+		 * \param index
+		 *      Index of the frame.
+		 *
+		 * \return Step of the frame.
+		 */
+		uint64_t getFrameStep(unsigned int index) const {
+			return _frames[index].step;
+		}
+
+
+		/**
+		 * \brief Get the simulated time of a frame.
+		 *
+		 * \param index
+		 *      Index of the frame.
+		 *
+		 * \return Time of the frame.
+		 */
+		double getFrameTime(unsigned int index) const {
+			return _frames[index].time;
+		}
+
+
+		/**
+		 * \brief Get the id of a body of the log.
+		 *
+		 * \param body
+		 *      Index of the body in the frames.
+		 *
+		 * \return Id of the recorded space-object.
+		 */
+		long getBodyId(unsigned int body) const;
+
+
+		/**
+		 * \brief Decode the state of a frame without writing it to the space-objects (e.g. for the analysis of a log).
+		 *
+		 * \param index
+		 *      Index of the frame.
+		 * \param positions
+		 *      Output-parameter: Positions of all bodies (x of all bodies, then y and z).
+		 * \param orientations
+		 *      Output-parameter: Orientations of all bodies (x of all bodies, then y, z and w).
+		 */
+		void readFrame(unsigned int index, std::vector<double> &positions, std::vector<double> &orientations);
+
+
+	private:
+		/**
+		 * \brief Position of a frame in the log.
+		 */
+		struct FrameIndex {
+			//! Offset of the payload in the file
+			size_t offset;
+			//! Type of the chunk
+			uint32_t type;
+			//! Step and time of the frame
+			uint64_t step;
+			double time;
+			//! Index of the key-frame which the deltas are based on
+			unsigned int keyFrame;
+		};
+
+		/**
+		 * \brief Decoded state of a frame.
+		 */
+		struct Frame {
+			int index = -1;
+			std::vector<double> x, y, z;
+			std::vector<double> qx, qy, qz, qw;
+		};
+
+
+		//! Speed-limits of the playback
+		static const double MIN_SPEED;
+		static const double MAX_SPEED;
+		//! Steps per second at the speed 1 (one step per frame at 60 fps, like the live simulation)
+		static const double STEPS_PER_SECOND;
+
+		//! Mapped log
+		const char* _data = nullptr;
+		//! Size of the log in bytes
+		size_t _size = 0;
+		//! Content of the log (the fallback without memory-mapping)
+		std::vector<char> _content;
+
+		//! Number of bodies per frame
+		unsigned int _cntBodies = 0;
+		//! Resolution of the quantized positions (0 => doubles)
+		double _quantization = 0.0;
+		//! Space-object per body of the log (nullptr => not in the scene)
+		std::vector<SpaceObject*> _objects;
+
+		//! All frames of the log
+		std::vector<FrameIndex> _frames;
+		//! Decoded frames around the current position of the playback
+		Frame _decoded[2];
+		//! Quantized positions of the last decoded frame
+		std::vector<int64_t> _quantized;
+		//! Index of the frame of _quantized (-1 => none)
+		int _quantizedFrame = -1;
+
+		//! Current position of the playback in recorded steps
+		double _step = 0.0;
+		//! Speed of the playback
+		double _speed = 1.0;
+		//! True if the playback is paused
+		bool _isPaused = false;
+
+
+		/**
+		 * \brief Decode a frame (the quantized frames based on the last decoded frame or their key-frame).
+		 *
+		 * \param index
+		 *      Index of the frame.
+		 * \param frame
+		 *      Output-parameter: Decoded frame.
+		 */
+		void decode(unsigned int index, Frame &frame);
+
+
+		/**
+		 * \brief Read a value at an offset of the log.
+		 */
+		template <typename T>
+		T read(size_t offset) const;
+
+
+		/**
+		 * \brief Unmap the loaded log.
+		 */
+		void unload();
+
+
+		//! Private constructor to be sure the class can't be created outside of this class.
+		TrajectoryPlayer() {}
+
+		//! Private copy-constructor to prevent copying the class.
+		TrajectoryPlayer(TrajectoryPlayer const&) = delete;
+
+		//! Private assignment-operator to prevent copying/saving referencec to the class.
+		TrajectoryPlayer& operator=(TrajectoryPlayer const&) = delete;
+
+		//! Private member-var which contains the singleton of the class.
+		static TrajectoryPlayer* _pInstance;
+	};
+}
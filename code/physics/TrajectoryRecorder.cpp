@@ -0,0 +1,482 @@
+﻿/**
+ * \brief Implementation of the recorder which writes the trajectories of the bodies into a binary log.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#include "TrajectoryRecorder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <iostream>
+#include <OpenThreads/ScopedLock>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "BodyState.h"
+#include "../scene/SpaceObject.h"
+#include "Logger.h"
+#include "ThreadBudget.h"
+
+using namespace pbs17;
+
+
+//! 64 MB per mapped window.
+const size_t TrajectoryRecorder::MAP_WINDOW_SIZE = 64 * 1024 * 1024;
+
+//! A key-frame limits how many deltas have to be summed up when a frame is read.
+const unsigned int TrajectoryRecorder::KEY_FRAME_INTERVAL = 64;
+
+
+namespace {
+
+	/**
+	 * \brief Append a value to the encoded chunk.
+	 */
+	template <typename T>
+	void append(std::vector<char> &buffer, T value) {
+		const char* bytes = reinterpret_cast<const char*>(&value);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+
+	/**
+	 * \brief Append all values of an array (converted to T) to the encoded chunk.
+	 */
+	template <typename T, typename S>
+	void appendArray(std::vector<char> &buffer, const std::vector<S> &values) {
+		for (unsigned int i = 0; i < values.size(); ++i) {
+			append<T>(buffer, static_cast<T>(values[i]));
+		}
+	}
+
+
+	/**
+	 * \brief Copy an array of the bodies in the order of the scene (the frames of the log have a fixed order).
+	 */
+	template <typename T>
+	void copyInLoadOrder(const BodyState::Array<T> &values, const BodyState &bodies, std::vector<T> &copy) {
+		if (!bodies.isReordered()) {
+			copy.assign(values.begin(), values.end());
+			return;
+		}
+
+		const std::vector<int> &order = bodies.getLoadOrder();
+		copy.resize(order.size());
+		for (unsigned int i = 0; i < order.size(); ++i) {
+			copy[i] = values[order[i]];
+		}
+	}
+
+
+	/**
+	 * \brief Append the header of a chunk (the size of the payload is set by endChunk()).
+	 *
+	 * \return Offset of the chunk in the buffer.
+	 */
+	size_t beginChunk(std::vector<char> &buffer, uint32_t type, uint32_t cntItems, uint64_t step, double time) {
+		size_t start = buffer.size();
+		append<uint32_t>(buffer, type);
+		append<uint32_t>(buffer, cntItems);
+		append<uint64_t>(buffer, step);
+		append<double>(buffer, time);
+		append<uint64_t>(buffer, 0);
+		return start;
+	}
+
+
+	/**
+	 * \brief Set the size of the payload of a chunk.
+	 */
+	void endChunk(std::vector<char> &buffer, size_t start) {
+		const size_t sizeOffset = start + 2 * sizeof(uint32_t) + sizeof(uint64_t) + sizeof(double);
+		uint64_t size = buffer.size() - sizeOffset - sizeof(uint64_t);
+		std::memcpy(&buffer[sizeOffset], &size, sizeof(uint64_t));
+	}
+}
+
+
+/**
+ * \brief Constructor of the recorder-thread.
+ *
+ * \param filePath
+ *      Complete path of the log (overwritten).
+ * \param interval
+ *      A snapshot of the bodies is recorded every interval steps.
+ * \param quantization
+ *      Resolution of the quantized positions (0 => the positions are stored as doubles).
+ * \param maxQueueSize
+ *      Number of snapshots which can wait for the writer.
+ */
+TrajectoryRecorder::TrajectoryRecorder(std::string filePath, unsigned int interval, double quantization, unsigned int maxQueueSize)
+	: _filePath(filePath), _interval(std::max(interval, 1u)), _quantization(std::max(quantization, 0.0)),
+	_maxQueueSize(std::max(maxQueueSize, 1u)), _isRunning(true) {}
+
+
+/**
+ * \brief Destructor of the recorder-thread (writes the queued snapshots and stops the thread).
+ */
+TrajectoryRecorder::~TrajectoryRecorder() {
+	stop();
+
+	for (unsigned int i = 0; i < _snapshots.size(); ++i) {
+		delete _snapshots[i];
+	}
+}
+
+
+/**
+ * \brief Main-loop of the thread.
+ */
+void TrajectoryRecorder::run() {
+	ThreadBudget::enterThread(ThreadBudget::BACKGROUND);
+
+	while (true) {
+		Snapshot* snapshot;
+
+		{
+			OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+			while (_queue.empty() && _isRunning) {
+				_notEmpty.wait(&_mutex);
+			}
+
+			// the queued snapshots are written before the thread stops
+			if (_queue.empty()) {
+				return;
+			}
+
+			snapshot = _queue.front();
+			_queue.pop_front();
+		}
+
+		writeSnapshot(*snapshot);
+
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		_free.push_back(snapshot);
+	}
+}
+
+
+/**
+ * \brief Write the queued snapshots, stop the thread and close the file.
+ */
+void TrajectoryRecorder::stop() {
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+		_isRunning = false;
+		_notEmpty.signal();
+	}
+
+	if (isRunning()) {
+		join();
+	}
+
+	closeFile();
+}
+
+
+/**
+ * \brief Record a step of the simulation. Has to be called from the simulating thread after each step.
+ *
+ * \param step
+ *      Number of the step.
+ * \param time
+ *      Simulated time after the step.
+ * \param bodies
+ *      State of all bodies after the step.
+ * \param contacts
+ *      Contacts of the step.
+ */
+void TrajectoryRecorder::record(unsigned long step, double time, const BodyState &bodies, const std::vector<Collision> &contacts) {
+	// the contacts of every step are recorded, independent of the interval
+	for (unsigned int i = 0; i < contacts.size(); ++i) {
+		const Collision &contact = contacts[i];
+		Eigen::Vector3d point = contact.getFirstPOC();
+		Eigen::Vector3d normal = contact.getUnitNormal();
+
+		Event event = {
+			step,
+			{ contact.getFirstObject()->getId(), contact.getSecondObject()->getId() },
+			{ point.x(), point.y(), point.z() },
+			{ normal.x(), normal.y(), normal.z() },
+			contact.getIntersectionVector().norm()
+		};
+		_events.push_back(event);
+	}
+
+	if (step % _interval != 0) {
+		return;
+	}
+
+	Snapshot* snapshot = nullptr;
+
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+
+		if (!_isRunning) {
+			return;
+		}
+
+		// the simulation never waits for the writer => drop the snapshot if the pool is exhausted
+		if (!_free.empty()) {
+			snapshot = _free.back();
+			_free.pop_back();
+		} else if (_snapshots.size() < _maxQueueSize) {
+			snapshot = new Snapshot;
+			_snapshots.push_back(snapshot);
+		} else {
+			++_cntDropped;
+			return;
+		}
+	}
+
+	// the reused vectors keep their capacity, so the copies do not allocate after the first snapshots
+	snapshot->step = step;
+	snapshot->time = time;
+	copyInLoadOrder(bodies.x, bodies, snapshot->x);
+	copyInLoadOrder(bodies.y, bodies, snapshot->y);
+	copyInLoadOrder(bodies.z, bodies, snapshot->z);
+	copyInLoadOrder(bodies.qx, bodies, snapshot->qx);
+	copyInLoadOrder(bodies.qy, bodies, snapshot->qy);
+	copyInLoadOrder(bodies.qz, bodies, snapshot->qz);
+	copyInLoadOrder(bodies.qw, bodies, snapshot->qw);
+	copyInLoadOrder(bodies.vx, bodies, snapshot->vx);
+	copyInLoadOrder(bodies.vy, bodies, snapshot->vy);
+	copyInLoadOrder(bodies.vz, bodies, snapshot->vz);
+	copyInLoadOrder(bodies.id, bodies, snapshot->id);
+	snapshot->events.swap(_events);
+	_events.clear();
+
+	OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_mutex);
+	_queue.push_back(snapshot);
+	_notEmpty.signal();
+}
+
+
+/**
+ * \brief Encode a snapshot into its chunks and write them.
+ *
+ * \param snapshot
+ *      Snapshot of the bodies.
+ */
+void TrajectoryRecorder::writeSnapshot(const Snapshot &snapshot) {
+	if (_filePath == "") {
+		return;
+	}
+
+	const uint32_t cntBodies = static_cast<uint32_t>(snapshot.x.size());
+	_buffer.clear();
+
+	if (!_hasHeader) {
+#if defined(_WIN32)
+		_file = fopen(_filePath.c_str(), "wb");
+		bool isOpen = _file != nullptr;
+#else
+		_fd = ::open(_filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		bool isOpen = _fd >= 0;
+#endif
+
+		if (!isOpen) {
+			LOG_ERROR("File " + _filePath + " can't be written!");
+			_filePath = "";
+			return;
+		}
+
+		const char magic[8] = { 'P', 'B', 'S', 'T', 'R', 'A', 'J', '1' };
+		_buffer.insert(_buffer.end(), magic, magic + 8);
+		append<uint32_t>(_buffer, 1);
+		append<uint32_t>(_buffer, cntBodies);
+		append<uint32_t>(_buffer, _interval);
+		append<uint32_t>(_buffer, _quantization > 0.0 ? 1 : 0);
+		append<double>(_buffer, _quantization);
+		appendArray<int64_t>(_buffer, snapshot.id);
+
+		_hasHeader = true;
+	}
+
+	if (_quantization <= 0.0) {
+		size_t start = beginChunk(_buffer, RAW_FRAME, cntBodies, snapshot.step, snapshot.time);
+		appendArray<double>(_buffer, snapshot.x);
+		appendArray<double>(_buffer, snapshot.y);
+		appendArray<double>(_buffer, snapshot.z);
+		appendArray<double>(_buffer, snapshot.qx);
+		appendArray<double>(_buffer, snapshot.qy);
+		appendArray<double>(_buffer, snapshot.qz);
+		appendArray<double>(_buffer, snapshot.qw);
+		appendArray<double>(_buffer, snapshot.vx);
+		appendArray<double>(_buffer, snapshot.vy);
+		appendArray<double>(_buffer, snapshot.vz);
+		endChunk(_buffer, start);
+	} else {
+		const std::vector<double>* positions[3] = { &snapshot.x, &snapshot.y, &snapshot.z };
+		std::vector<int64_t> quantized(3 * cntBodies);
+
+		for (unsigned int k = 0; k < 3; ++k) {
+			for (unsigned int i = 0; i < cntBodies; ++i) {
+				quantized[k * cntBodies + i] = std::llround((*positions[k])[i] / _quantization);
+			}
+		}
+
+		// a delta which does not fit into 32 bits forces a key-frame
+		bool isKeyFrame = _cntFrames % KEY_FRAME_INTERVAL == 0 || _lastQuantized.size() != quantized.size();
+		for (unsigned int i = 0; i < quantized.size() && !isKeyFrame; ++i) {
+			int64_t delta = quantized[i] - _lastQuantized[i];
+			isKeyFrame = delta < std::numeric_limits<int32_t>::min() || delta > std::numeric_limits<int32_t>::max();
+		}
+
+		size_t start = beginChunk(_buffer, isKeyFrame ? KEY_FRAME : DELTA_FRAME, cntBodies, snapshot.step, snapshot.time);
+		for (unsigned int i = 0; i < quantized.size(); ++i) {
+			if (isKeyFrame) {
+				append<int64_t>(_buffer, quantized[i]);
+			} else {
+				append<int32_t>(_buffer, static_cast<int32_t>(quantized[i] - _lastQuantized[i]));
+			}
+		}
+		appendArray<float>(_buffer, snapshot.qx);
+		appendArray<float>(_buffer, snapshot.qy);
+		appendArray<float>(_buffer, snapshot.qz);
+		appendArray<float>(_buffer, snapshot.qw);
+		appendArray<float>(_buffer, snapshot.vx);
+		appendArray<float>(_buffer, snapshot.vy);
+		appendArray<float>(_buffer, snapshot.vz);
+		endChunk(_buffer, start);
+
+		_lastQuantized.swap(quantized);
+	}
+	++_cntFrames;
+
+	// side-table of the contacts since the last snapshot
+	if (!snapshot.events.empty()) {
+		size_t start = beginChunk(_buffer, COLLISIONS, static_cast<uint32_t>(snapshot.events.size()), snapshot.step, snapshot.time);
+		for (unsigned int i = 0; i < snapshot.events.size(); ++i) {
+			const Event &event = snapshot.events[i];
+			append<uint64_t>(_buffer, event.step);
+			append<int64_t>(_buffer, event.ids[0]);
+			append<int64_t>(_buffer, event.ids[1]);
+			for (unsigned int k = 0; k < 3; ++k) {
+				append<double>(_buffer, event.point[k]);
+			}
+			for (unsigned int k = 0; k < 3; ++k) {
+				append<double>(_buffer, event.normal[k]);
+			}
+			append<double>(_buffer, event.depth);
+		}
+		endChunk(_buffer, start);
+	}
+
+	if (!write(_buffer.data(), _buffer.size())) {
+		LOG_ERROR("File " + _filePath + " can't be written!");
+		closeFile();
+		_filePath = "";
+	}
+}
+
+
+/**
+ * \brief Append bytes to the file (through the mapped window).
+ *
+ * \param data
+ *      Bytes to write.
+ * \param size
+ *      Number of bytes.
+ *
+ * \return False if the file can't be written.
+ */
+bool TrajectoryRecorder::write(const char* data, size_t size) {
+#if defined(_WIN32)
+	// no mapping on windows, the file is written buffered
+	size_t written = fwrite(data, 1, size, _file);
+	_written += written;
+	return written == size;
+#else
+	while (size > 0) {
+		if (_map == nullptr || _written >= _mapOffset + MAP_WINDOW_SIZE) {
+			if (!mapWindow(_written)) {
+				return false;
+			}
+		}
+
+		size_t cntBytes = std::min(size, _mapOffset + MAP_WINDOW_SIZE - _written);
+		std::memcpy(_map + (_written - _mapOffset), data, cntBytes);
+
+		_written += cntBytes;
+		data += cntBytes;
+		size -= cntBytes;
+	}
+
+	return true;
+#endif
+}
+
+
+/**
+ * \brief Map the window of the file which contains the given offset (the file is extended).
+ *
+ * \param offset
+ *      Offset in the file.
+ *
+ * \return False if the window can't be mapped.
+ */
+bool TrajectoryRecorder::mapWindow(size_t offset) {
+#if defined(_WIN32)
+	return false;
+#else
+	if (_map != nullptr) {
+		munmap(_map, MAP_WINDOW_SIZE);
+		_map = nullptr;
+	}
+
+	// the offset of a mapping has to be aligned to the pages
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	_mapOffset = offset - offset % pageSize;
+
+	if (ftruncate(_fd, static_cast<off_t>(_mapOffset + MAP_WINDOW_SIZE)) != 0) {
+		return false;
+	}
+
+	void* map = mmap(nullptr, MAP_WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, static_cast<off_t>(_mapOffset));
+	if (map == MAP_FAILED) {
+		return false;
+	}
+
+	_map = static_cast<char*>(map);
+	return true;
+#endif
+}
+
+
+/**
+ * \brief Unmap the window and truncate the file to the written bytes.
+ */
+void TrajectoryRecorder::closeFile() {
+#if defined(_WIN32)
+	if (_file) {
+		fclose(_file);
+		_file = nullptr;
+		LOG_INFO("Saved trajectories to `" << _filePath << "`");
+	}
+#else
+	if (_map != nullptr) {
+		munmap(_map, MAP_WINDOW_SIZE);
+		_map = nullptr;
+	}
+
+	if (_fd >= 0) {
+		// the last window has been extended beyond the written bytes
+		if (ftruncate(_fd, static_cast<off_t>(_written)) != 0) {
+			LOG_ERROR("File " + _filePath + " can't be truncated!");
+		}
+		::close(_fd);
+		_fd = -1;
+		LOG_INFO("Saved trajectories to `" << _filePath << "`");
+	}
+#endif
+}
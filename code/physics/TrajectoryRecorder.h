@@ -0,0 +1,237 @@
+﻿/**
+ * \brief Implementation of the recorder which writes the trajectories of the bodies into a binary log.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-23
+ */
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdio.h>
+#include <OpenThreads/Thread>
+#include <OpenThreads/Mutex>
+#include <OpenThreads/Condition>
+
+#include "Collision.h"
+
+
+// forward declarations
+namespace pbs17 {
+	class BodyState;
+}
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief Records the positions, orientations and velocities of all bodies every K steps and the contacts of every
+	 * step into a chunked binary log. The physics-thread only copies the arrays of the state into a pooled snapshot,
+	 * the snapshots are encoded and written by the recorder-thread through a memory-mapped window of the file.
+	 * If the recorder can't keep up, the snapshots are dropped instead of stalling the simulation (the contacts of a
+	 * dropped snapshot are kept for the next one).
+	 *
+	 * Layout of the file (native byte-order):
+	 *  - Header: "PBSTRAJ1", uint32 version, uint32 number of bodies, uint32 interval, uint32 flags (1 => quantized),
+	 *    double quantization, int64 id of each body (order of the bodies in all frames).
+	 *  - Chunks: uint32 type, uint32 number of items, uint64 step, double time, uint64 size of the payload, payload.
+	 *    The arrays of the payloads are stored per component (x of all bodies, then y, ...):
+	 *    - RAW_FRAME: double position[3], orientation[4] (x, y, z, w), velocity[3].
+	 *    - KEY_FRAME: int64 quantized position[3], float orientation[4], velocity[3].
+	 *    - DELTA_FRAME: int32 quantized position[3] relative to the last written frame, float orientation[4], velocity[3].
+	 *    - COLLISIONS: per contact uint64 step, int64 ids[2], double point[3], normal[3], penetration-depth.
+	 */
+	class TrajectoryRecorder : public OpenThreads::Thread {
+	public:
+		//! Types of the chunks
+		enum ChunkType {
+			RAW_FRAME = 1,
+			KEY_FRAME = 2,
+			DELTA_FRAME = 3,
+			COLLISIONS = 4
+		};
+
+
+		/**
+		 * \brief Constructor of the recorder-thread.
+		 *
+		 * \param filePath
+		 *      Complete path of the log (overwritten).
+		 * \param interval
+		 *      A snapshot of the bodies is recorded every interval steps.
+		 * \param quantization
+		 *      Resolution of the quantized positions (0 => the positions are stored as doubles).
+		 * \param maxQueueSize
+		 *      Number of snapshots which can wait for the writer.
+		 */
+		TrajectoryRecorder(std::string filePath, unsigned int interval = 1, double quantization = 0.0, unsigned int maxQueueSize = 16);
+
+
+		/**
+		 * \brief Destructor of the recorder-thread (writes the queued snapshots and stops the thread).
+		 */
+		~TrajectoryRecorder();
+
+
+		/**
+		 * \brief Main-loop of the thread.
+		 */
+		void run() override;
+
+
+		/**
+		 * \brief Write the queued snapshots, stop the thread and close the file.
+		 */
+		void stop();
+
+
+		/**
+		 * \brief Record a step of the simulation. Has to be called from the simulating thread after each step.
+		 *
+		 * \param step
+		 *      Number of the step.
+		 * \param time
+		 *      Simulated time after the step.
+		 * \param bodies
+		 *      State of all bodies after the step.
+		 * \param contacts
+		 *      Contacts of the step.
+		 */
+		void record(unsigned long step, double time, const BodyState &bodies, const std::vector<Collision> &contacts);
+
+
+		/**
+		 * \brief Get the number of snapshots which have been dropped.
+		 *
+		 * \return Number of dropped snapshots.
+		 */
+		unsigned int getNumDropped() const {
+			return _cntDropped;
+		}
+
+
+	private:
+		/**
+		 * \brief Contact of a step.
+		 */
+		struct Event {
+			uint64_t step;
+			int64_t ids[2];
+			double point[3];
+			double normal[3];
+			double depth;
+		};
+
+		/**
+		 * \brief Copied state of the bodies (and the contacts since the last snapshot) which waits for the writer.
+		 */
+		struct Snapshot {
+			uint64_t step;
+			double time;
+			std::vector<double> x, y, z;
+			std::vector<double> qx, qy, qz, qw;
+			std::vector<double> vx, vy, vz;
+			std::vector<long> id;
+			std::vector<Event> events;
+		};
+
+
+		//! Size of the mapped window of the file (multiple of the page-size)
+		static const size_t MAP_WINDOW_SIZE;
+		//! Each n-th quantized frame is written as key-frame
+		static const unsigned int KEY_FRAME_INTERVAL;
+
+		//! Complete path of the log
+		std::string _filePath;
+		//! A snapshot is recorded every interval steps
+		unsigned int _interval;
+		//! Resolution of the quantized positions (0 => doubles)
+		double _quantization;
+		//! Number of snapshots which can wait for the writer
+		unsigned int _maxQueueSize;
+		//! Number of snapshots which have been dropped
+		unsigned int _cntDropped = 0;
+
+		//! True as long as the thread should run
+		bool _isRunning;
+
+		//! Contacts since the last queued snapshot (only used by the simulating thread)
+		std::vector<Event> _events;
+
+		//! All snapshots of the pool
+		std::vector<Snapshot*> _snapshots;
+		//! Snapshots which can be reused
+		std::vector<Snapshot*> _free;
+		//! Snapshots which wait for the writer
+		std::deque<Snapshot*> _queue;
+		//! Protects _free, _queue and _isRunning
+		OpenThreads::Mutex _mutex;
+		//! Signaled if a snapshot has been queued or the thread should stop
+		OpenThreads::Condition _notEmpty;
+
+		//! Encoded chunk (only used by the recorder-thread)
+		std::vector<char> _buffer;
+		//! Quantized positions of the last written frame
+		std::vector<int64_t> _lastQuantized;
+		//! Number of frames which have been written
+		unsigned long _cntFrames = 0;
+		//! True if the header has been written
+		bool _hasHeader = false;
+
+		//! Number of bytes which have been written
+		size_t _written = 0;
+#if defined(_WIN32)
+		//! File of the log (the fallback without memory-mapping)
+		FILE* _file = nullptr;
+#else
+		//! File-descriptor of the log
+		int _fd = -1;
+#endif
+		//! Mapped window of the file (nullptr => not mapped)
+		char* _map = nullptr;
+		//! Offset of the mapped window in the file
+		size_t _mapOffset = 0;
+
+
+		/**
+		 * \brief Encode a snapshot into its chunks and write them.
+		 *
+		 * \param snapshot
+		 *      Snapshot of the bodies.
+		 */
+		void writeSnapshot(const Snapshot &snapshot);
+
+
+		/**
+		 * \brief Append bytes to the file (through the mapped window).
+		 *
+		 * \param data
+		 *      Bytes to write.
+		 * \param size
+		 *      Number of bytes.
+		 *
+		 * \return False if the file can't be written.
+		 */
+		bool write(const char* data, size_t size);
+
+
+		/**
+		 * \brief Map the window of the file which contains the given offset (the file is extended).
+		 *
+		 * \param offset
+		 *      Offset in the file.
+		 *
+		 * \return False if the window can't be mapped.
+		 */
+		bool mapWindow(size_t offset);
+
+
+		/**
+		 * \brief Unmap the window and truncate the file to the written bytes.
+		 */
+		void closeFile();
+	};
+}
@@ -0,0 +1,310 @@
+﻿/**
+ * \brief Python-module pbs17: Runs a headless simulation in the process of the interpreter and exposes the state of
+ *        the bodies as NumPy-arrays without copying them
+ *        (cmake -DPBS17_PYTHON=ON, e.g. `sim = pbs17.Simulation("scene.json"); sim.run(100); sim.x.mean()`).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-14
+ */
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdexcept>
+#include <json.hpp>
+
+#include "../scene/SceneManager.h"
+#include "../scene/BinaryScene.h"
+#include "../scene/SpaceObject.h"
+#include "../physics/SimulationManager.h"
+#include "../physics/TrajectoryPlayer.h"
+#include "../osg/AssetCache.h"
+
+namespace py = pybind11;
+using json = nlohmann::json;
+
+
+namespace {
+
+	/**
+	 * \brief Read-only NumPy-view of an array of the body-state. The memory stays owned by the simulation, the view
+	 *        keeps the python-object of the simulation (base) alive.
+	 *
+	 * \param values
+	 *      Values per body.
+	 * \param base
+	 *      Python-object which owns the values.
+	 *
+	 * \return Array without a copy of the values.
+	 */
+	template <typename T, typename V>
+	py::array view(const std::vector<V> &values, py::handle base) {
+		static_assert(sizeof(T) == sizeof(V), "the view has to have the size of the values");
+
+		py::array_t<T> array({ values.size() }, { sizeof(T) }, reinterpret_cast<const T*>(values.data()), base);
+		// the state is only written by the simulation (the space-objects and the managers are not updated by numpy)
+		array.attr("setflags")(py::arg("write") = false);
+		return array;
+	}
+
+
+	/**
+	 * \brief Headless simulation of a scene (json or binary), owns its scene- and simulation-manager.
+	 */
+	class Simulation {
+	public:
+		/**
+		 * \brief Load a scene and create its simulation.
+		 *
+		 * \param filePath
+		 *      Complete path to the scene (*.pbsc => binary scene, otherwise json).
+		 * \param overrides
+		 *      Json-object with the simulation-settings which replace the settings of the scene.
+		 */
+		Simulation(std::string filePath, std::string overrides) {
+			pbs17::SpaceObject::setIsHeadless(true);
+			pbs17::AssetCache::setIsEnabled(false);
+
+			_sceneManager = new pbs17::SceneManager;
+
+			const std::string extension = ".pbsc";
+			bool isBinary = filePath.size() > extension.size()
+				&& filePath.compare(filePath.size() - extension.size(), extension.size(), extension) == 0;
+
+			if (isBinary) {
+				pbs17::BinaryScene binaryScene;
+				if (!binaryScene.load(filePath)) {
+					delete _sceneManager;
+					throw std::runtime_error("Scene " + filePath + " can't be loaded!");
+				}
+
+				_sceneManager->loadScene(binaryScene);
+			} else {
+				std::ifstream stream(filePath);
+				if (!stream) {
+					delete _sceneManager;
+					throw std::runtime_error("Scene " + filePath + " can't be loaded!");
+				}
+
+				_sceneManager->loadScene(stream);
+			}
+
+			json settings = _sceneManager->getSimulationSettings();
+			if (overrides != "") {
+				json j = json::parse(overrides);
+				for (json::iterator it = j.begin(); it != j.end(); ++it) {
+					settings[it.key()] = it.value();
+				}
+			}
+
+			_simulationManager = new pbs17::SimulationManager(_sceneManager->getSpaceObjects(), settings);
+		}
+
+
+		/**
+		 * \brief Destructor of the simulation (the space-objects are owned by the scene-manager).
+		 */
+		~Simulation() {
+			delete _simulationManager;
+			delete _sceneManager;
+		}
+
+
+		/**
+		 * \brief Simulate a number of steps.
+		 *
+		 * \param steps
+		 *      Number of steps.
+		 * \param dt
+		 *      Timestep (<= 0 => the timestep of the scene).
+		 */
+		void run(int steps, double dt) {
+			if (dt <= 0.0) {
+				dt = _simulationManager->getSimulationDt();
+			}
+
+			for (int i = 0; i < steps; ++i) {
+				_simulationManager->step(dt);
+			}
+		}
+
+
+		/**
+		 * \brief Get the simulation-manager.
+		 */
+		const pbs17::SimulationManager& getSimulation() const {
+			return *_simulationManager;
+		}
+
+
+		/**
+		 * \brief Get the space-objects of the scene (e.g. to assign the bodies of a trajectory-log).
+		 */
+		const std::vector<pbs17::SpaceObject*>& getSpaceObjects() const {
+			return _simulationManager->getSpaceObjects();
+		}
+
+	private:
+		//! Scene-manager which owns the space-objects
+		pbs17::SceneManager* _sceneManager = nullptr;
+		//! Simulation of the scene
+		pbs17::SimulationManager* _simulationManager = nullptr;
+	};
+
+
+	/**
+	 * \brief Log of the TrajectoryRecorder which is read frame by frame (the frames are copied into new arrays).
+	 */
+	class Trajectory {
+	public:
+		/**
+		 * \brief Load a log (the player is a singleton, so the last loaded log is read).
+		 *
+		 * \param filePath
+		 *      Complete path of the log.
+		 */
+		explicit Trajectory(std::string filePath) {
+			if (!pbs17::TrajectoryPlayer::Instance()->load(filePath, std::vector<pbs17::SpaceObject*>())) {
+				throw std::runtime_error("File " + filePath + " is not a trajectory-log!");
+			}
+		}
+
+
+		/**
+		 * \brief Decode a frame.
+		 *
+		 * \param index
+		 *      Index of the frame (negative => from the end).
+		 *
+		 * \return Tuple of the positions (3 x bodies) and the orientations (4 x bodies, x, y, z, w).
+		 */
+		py::tuple frame(int index) const {
+			pbs17::TrajectoryPlayer* player = pbs17::TrajectoryPlayer::Instance();
+			int cntFrames = static_cast<int>(player->getNumFrames());
+			if (index < 0) {
+				index += cntFrames;
+			}
+			if (index < 0 || index >= cntFrames) {
+				throw py::index_error("frame out of range");
+			}
+
+			std::vector<double> positions, orientations;
+			player->readFrame(index, positions, orientations);
+
+			size_t n = player->getNumBodies();
+			py::array_t<double> p({ size_t(3), n });
+			py::array_t<double> q({ size_t(4), n });
+			std::copy(positions.begin(), positions.end(), p.mutable_data());
+			std::copy(orientations.begin(), orientations.end(), q.mutable_data());
+
+			return py::make_tuple(p, q);
+		}
+
+
+		/**
+		 * \brief Get the steps of all frames.
+		 */
+		py::array_t<uint64_t> steps() const {
+			pbs17::TrajectoryPlayer* player = pbs17::TrajectoryPlayer::Instance();
+			py::array_t<uint64_t> result(player->getNumFrames());
+			for (unsigned int i = 0; i < player->getNumFrames(); ++i) {
+				result.mutable_data()[i] = player->getFrameStep(i);
+			}
+			return result;
+		}
+
+
+		/**
+		 * \brief Get the times of all frames.
+		 */
+		py::array_t<double> times() const {
+			pbs17::TrajectoryPlayer* player = pbs17::TrajectoryPlayer::Instance();
+			py::array_t<double> result(player->getNumFrames());
+			for (unsigned int i = 0; i < player->getNumFrames(); ++i) {
+				result.mutable_data()[i] = player->getFrameTime(i);
+			}
+			return result;
+		}
+
+
+		/**
+		 * \brief Get the ids of the bodies (in the order of the frames).
+		 */
+		py::array_t<int64_t> ids() const {
+			pbs17::TrajectoryPlayer* player = pbs17::TrajectoryPlayer::Instance();
+			py::array_t<int64_t> result(player->getNumBodies());
+			for (unsigned int i = 0; i < player->getNumBodies(); ++i) {
+				result.mutable_data()[i] = player->getBodyId(i);
+			}
+			return result;
+		}
+	};
+}
+
+
+PYBIND11_MODULE(pbs17, m) {
+	m.doc() = "Headless asteroid-field simulation with zero-copy views of the body-state";
+
+	// the views are created on every access, because the steps reorder and resize the arrays of the bodies
+#define PBS17_VIEW(NAME, TYPE, DOC) \
+	def_property_readonly(#NAME, [](py::object self) { \
+		return view<TYPE>(self.cast<const Simulation&>().getSimulation().getBodies().NAME, self); \
+	}, DOC)
+
+	py::class_<Simulation>(m, "Simulation")
+		.def(py::init<std::string, std::string>(), py::arg("scene"), py::arg("settings") = "",
+			"Load a scene (*.pbsc or json) with optional json-overrides of its simulation-settings")
+		.def("step", [](Simulation &self, double dt) { self.run(1, dt); }, py::arg("dt") = 0.0,
+			py::call_guard<py::gil_scoped_release>(), "Simulate one step (dt <= 0 => timestep of the scene)")
+		.def("run", &Simulation::run, py::arg("steps"), py::arg("dt") = 0.0,
+			py::call_guard<py::gil_scoped_release>(), "Simulate a number of steps (dt <= 0 => timestep of the scene)")
+		.def_property_readonly("time", [](const Simulation &self) { return self.getSimulation().getTime(); })
+		.def_property_readonly("num_steps", [](const Simulation &self) { return self.getSimulation().getNumSteps(); })
+		.def_property_readonly("dt", [](const Simulation &self) { return self.getSimulation().getSimulationDt(); })
+		.def("__len__", [](const Simulation &self) { return self.getSimulation().getBodies().id.size(); })
+		.def_property_readonly("diagnostics", [](const Simulation &self) {
+			// last measurement of the conserved quantities (see the setting diagnosticsInterval)
+			const pbs17::Diagnostics::Sample &sample = self.getSimulation().getDiagnostics().getLast();
+			py::dict result;
+			result["step"] = sample.step;
+			result["time"] = sample.time;
+			result["kinetic_energy"] = sample.kineticEnergy;
+			result["potential_energy"] = sample.potentialEnergy;
+			result["total_energy"] = sample.totalEnergy;
+			result["momentum"] = py::make_tuple(sample.momentum(0), sample.momentum(1), sample.momentum(2));
+			result["angular_momentum"] = py::make_tuple(sample.angularMomentum(0), sample.angularMomentum(1), sample.angularMomentum(2));
+			result["energy_drift"] = sample.energyDrift;
+			result["momentum_drift"] = sample.momentumDrift;
+			result["angular_momentum_drift"] = sample.angularMomentumDrift;
+			return result;
+		})
+		.PBS17_VIEW(x, double, "Positions (x), valid until the next step")
+		.PBS17_VIEW(y, double, "Positions (y), valid until the next step")
+		.PBS17_VIEW(z, double, "Positions (z), valid until the next step")
+		.PBS17_VIEW(vx, double, "Linear velocities (x), valid until the next step")
+		.PBS17_VIEW(vy, double, "Linear velocities (y), valid until the next step")
+		.PBS17_VIEW(vz, double, "Linear velocities (z), valid until the next step")
+		.PBS17_VIEW(wx, double, "Angular velocities (x), valid until the next step")
+		.PBS17_VIEW(wy, double, "Angular velocities (y), valid until the next step")
+		.PBS17_VIEW(wz, double, "Angular velocities (z), valid until the next step")
+		.PBS17_VIEW(qx, double, "Orientations (x), valid until the next step")
+		.PBS17_VIEW(qy, double, "Orientations (y), valid until the next step")
+		.PBS17_VIEW(qz, double, "Orientations (z), valid until the next step")
+		.PBS17_VIEW(qw, double, "Orientations (w), valid until the next step")
+		.PBS17_VIEW(m, double, "Masses, valid until the next step")
+		.PBS17_VIEW(id, long, "Ids of the space-objects (the bodies are reordered by the steps), valid until the next step")
+		.PBS17_VIEW(sleeping, int8_t, "Flags of the sleeping bodies, valid until the next step");
+
+#undef PBS17_VIEW
+
+	py::class_<Trajectory>(m, "Trajectory")
+		.def(py::init<std::string>(), py::arg("path"), "Load a log of the TrajectoryRecorder (see --record)")
+		.def("__len__", [](const Trajectory&) { return pbs17::TrajectoryPlayer::Instance()->getNumFrames(); })
+		.def("frame", &Trajectory::frame, py::arg("index"), "Positions (3 x bodies) and orientations (4 x bodies) of a frame")
+		.def_property_readonly("steps", &Trajectory::steps)
+		.def_property_readonly("times", &Trajectory::times)
+		.def_property_readonly("ids", &Trajectory::ids);
+}
@@ -15,8 +15,8 @@
 #include "../osg/OsgEigenConversions.h"
 #include "../osg/Loader.h"
 #include "../osg/ModelManager.h"
-#include "../osg/visitors/ConvexHullVisitor.h"
-#include "../osg/visitors/VertexListVisitor.h"
+#include "../osg/InstanceManager.h"
+#include "../osg/ProceduralAsteroid.h"
 
 using namespace pbs17;
 
@@ -35,7 +35,7 @@ Asteroid::Asteroid()
  * \param j
  *      JSON-configuration for the asteroid.
  */
-Asteroid::Asteroid(json j) :
+Asteroid::Asteroid(const json &j) :
     SpaceObject(j) {
 
     Eigen::Vector3d pos = fromJson(j["position"]);
@@ -48,8 +48,8 @@ Asteroid::Asteroid(json j) :
 
     initPhysics(j["mass"].get<double>(),linearVelocity,angularVelocity,force, torque);
 
-	if (j["useFollowingRibbon"].is_boolean() && j["useFollowingRibbon"].get<bool>() == true) {
-		json ribbonInfo = j["followingRibbon"];
+	if (j.count("useFollowingRibbon") && j["useFollowingRibbon"].is_boolean() && j["useFollowingRibbon"].get<bool>() == true) {
+		const json &ribbonInfo = j["followingRibbon"];
 
 		initFollowingRibbon(toOsg(fromJson(ribbonInfo["color"])),
 			ribbonInfo["numPoints"].get<unsigned int>(),
@@ -81,46 +81,34 @@ void Asteroid::initOsg(Eigen::Vector3d position, double ratio, double scaling) {
 
 	// Load the model
 	std::string modelPath = DATA_PATH + "/" + _filename;
-	_modelFile = ModelManager::Instance()->loadModel(modelPath, true);
+	_modelFile = ModelManager::Instance()->loadModel(modelPath, !getIsHeadless());
 
 	// Scale the model if needed
 	if (scaling != 1.0) {
 		_modelFile = Loader::scaleNode(_modelFile, scaling);
 	}
 
-	// Compute convex hull
-	osg::Matrix scalingMatrix = osg::Matrix::scale(_scaling, _scaling, _scaling);
-	ConvexHullVisitor convexHull(scalingMatrix);
-	_modelFile->accept(convexHull);
-	_convexHull = convexHull.getConvexHull();
-	
-	osg::Geode* geodeConvexHull = new osg::Geode;
-	geodeConvexHull->addDrawable(_convexHull->getOsgModel());
-
-	// Switch to decide if the convex hull or the model has to be rendered.
-	_convexRenderSwitch = new osg::Switch;
-	_convexRenderSwitch->addChild(_modelFile, true);
-	_convexRenderSwitch->addChild(geodeConvexHull, false);
-
-    VertexListVisitor vListVisitor;
-    _modelFile->accept(vListVisitor);
-	const osg::Vec3Array* vertices = dynamic_cast<const osg::Vec3Array*>(vListVisitor.getVertices());
-
-	double minX = DBL_MAX, maxX = -DBL_MAX, minY = DBL_MAX, maxY = -DBL_MAX, minZ = DBL_MAX, maxZ = -DBL_MAX;
-
-    for (unsigned int i = 0; i < vertices->size(); i++) {
-		minX = std::min(minX, static_cast<double>(vertices->at(i).x()));
-		minY = std::min(minY, static_cast<double>(vertices->at(i).y()));
-		minZ = std::min(minZ, static_cast<double>(vertices->at(i).z()));
-
-		maxX = std::max(maxX, static_cast<double>(vertices->at(i).x()));
-		maxY = std::max(maxY, static_cast<double>(vertices->at(i).y()));
-		maxZ = std::max(maxZ, static_cast<double>(vertices->at(i).z()));
+	// The convex hull (shared by all instances of the model, the scaling is applied to its vertices) is only
+	// computed once the object reaches the narrow-phase or the hull is shown
+	setLazyConvexHull(modelPath, !getIsHeadless());
+
+	if (InstanceManager::getIsEnabled() && !getIsHeadless()) {
+		// the model is drawn by the instanced model (see initNodes())
+		std::string texturePath = _textureName != "" ? DATA_PATH + "/texture/" + _textureName : "";
+		std::string bumpmapPath = _bumpmapName != "" ? DATA_PATH + "/texture/" + _bumpmapName : "";
+		unsigned int layer;
+		unsigned int seed = 0;
+		ProceduralAsteroid::getSeed(modelPath, seed);
+		_instancedModel = InstanceManager::Instance()->getModel(modelPath, texturePath, bumpmapPath, layer);
+		_instance = _instancedModel->addInstance(osg::Matrix::scale(scaling, scaling, scaling) * osg::Matrix::translate(toOsg(position)), layer, seed);
 	}
 
-	double a = maxX - minX;
-	double b = maxY - minY;
-	double c = maxZ - minZ;
+	// Bounding-box of the unscaled model (shared by all instances of the model)
+	const osg::BoundingBox &modelBox = ModelManager::Instance()->getBoundingBox(modelPath, !getIsHeadless());
+
+	double a = modelBox.xMax() - modelBox.xMin();
+	double b = modelBox.yMax() - modelBox.yMin();
+	double c = modelBox.zMax() - modelBox.zMin();
 	double Ixx = 1. / 12.*(b*b + c*c) * scaling * scaling;
 	double Iyy = 1. / 12.*(a*a + c*c) * scaling * scaling;
 	double Izz = 1. / 12.*(a*a + b*b) * scaling * scaling;
@@ -131,16 +119,43 @@ void Asteroid::initOsg(Eigen::Vector3d position, double ratio, double scaling) {
 	_momentOfInertia(1, 1) = Iyy;
 	_momentOfInertia(2, 2) = Izz;
 
+	calculateAABB();
+
+	// the root-node is part of the scene, the nodes below are only built once it's visible (if lazy)
+	_modelRoot = new osg::Switch;
+	if (getIsLazyNodes() && !getIsHeadless()) {
+		initLazyNodes();
+	} else {
+		initNodes();
+	}
+}
+
+
+/**
+ * \brief Build the transformation, the switch of the convex-hull and the texturing below the root-node
+ *        (objects with lazy nodes call it from the sync-pass once they are visible).
+ */
+void Asteroid::initNodes() {
+	_convexHullGeode = new osg::Geode;
+
+	// Switch to decide if the convex hull or the model has to be rendered.
+	_convexRenderSwitch = new osg::Switch;
+	if (_instancedModel.valid()) {
+		// the model is drawn by the instanced model => an empty node keeps the convex-hull at the second position
+		_convexRenderSwitch->addChild(new osg::Node, !_isConvexHullShown);
+	} else {
+		_convexRenderSwitch->addChild(_modelFile, !_isConvexHullShown);
+	}
+	_convexRenderSwitch->addChild(Loader::scaleNode(_convexHullGeode.get(), _scaling), _isConvexHullShown);
+
 	// Transformation-node for position and rotation updates.
 	_transformation = new osg::MatrixTransform;
-	_transformation->setMatrix(osg::Matrix::translate(toOsg(position)));
+	// written by the update-traversal while the previous frame may still be drawn (see SceneManager::initViewer())
+	_transformation->setDataVariance(osg::Object::DYNAMIC);
+	_transformation->setMatrix(osg::Matrix::translate(toOsg(_position)));
 	_transformation->addChild(_convexRenderSwitch);
 
-	calculateAABB();
-
-	_modelRoot = new osg::Switch;
-	_modelRoot->insertChild(0, _transformation, true);
-	_modelRoot->insertChild(1, _aabbRendering, false);
+	_modelRoot->insertChild(0, _transformation, _isRenderedActive);
 
 	initTexturing();
 }
@@ -162,5 +177,5 @@ void Asteroid::initOsg(Eigen::Vector3d position, double ratio, double scaling) {
 void Asteroid::initPhysics(double mass, Eigen::Vector3d linearVelocity, Eigen::Vector3d angularVelocity, Eigen::Vector3d force, Eigen::Vector3d torque) {
 	SpaceObject::initPhysics(mass, linearVelocity, angularVelocity, force, torque);
 
-    _momentOfInertia = mass * _momentOfInertia;
+    setMomentOfInertia(mass * _momentOfInertia);
 }
@@ -29,7 +29,7 @@ namespace pbs17 {
 		 * \param j
 		 *      JSON-configuration for the asteroid.
 		 */
-        explicit Asteroid(json j);
+        explicit Asteroid(const json &j);
 
 
 		/**
@@ -67,6 +67,15 @@ namespace pbs17 {
 		 */
 		void initPhysics(double mass, Eigen::Vector3d linearVelocity, Eigen::Vector3d angularVelocity, Eigen::Vector3d force, Eigen::Vector3d torque) override;
 
+
+	protected:
+
+		/**
+		 * \brief Build the transformation, the switch of the convex-hull and the texturing below the root-node
+		 *        (objects with lazy nodes call it from the sync-pass once they are visible).
+		 */
+		void initNodes() override;
+
 	};
 
 }
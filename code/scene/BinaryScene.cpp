@@ -0,0 +1,583 @@
+﻿/**
+ * \brief Compact binary representation of a json-scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-19
+ */
+
+#include "BinaryScene.h"
+#include "../physics/Logger.h"
+
+#include <fstream>
+#include <algorithm>
+#include <iostream>
+
+using namespace pbs17;
+
+
+//! Identifier at the beginning of the file ("PBSC")
+const uint32_t BinaryScene::MAGIC = 0x43534250;
+//! Version of the format (increase if the layout changes)
+const uint32_t BinaryScene::VERSION = 1;
+
+const uint32_t BinaryScene::HAS_FORCES;
+const uint32_t BinaryScene::HAS_STATE;
+const uint8_t BinaryScene::IS_CONTINUOUS;
+const uint8_t BinaryScene::IS_TEST_PARTICLE;
+const uint8_t BinaryScene::IS_VISUAL_SPIN;
+
+
+namespace {
+
+	/**
+	 * \brief Write a column in the binary representation.
+	 */
+	template<typename T>
+	void writeColumn(std::ofstream &stream, const std::vector<T> &values) {
+		stream.write(reinterpret_cast<const char*>(values.data()), sizeof(T) * values.size());
+	}
+
+
+	/**
+	 * \brief Reads the columns of a file which is completely read into the memory.
+	 */
+	struct BufferReader {
+		const std::vector<char> &buffer;
+		size_t position;
+
+		explicit BufferReader(const std::vector<char> &buffer) : buffer(buffer), position(0) {}
+
+		template<typename T>
+		bool read(T *values, size_t count) {
+			size_t size = sizeof(T) * count;
+
+			if (position + size > buffer.size()) {
+				return false;
+			}
+
+			std::copy(buffer.begin() + position, buffer.begin() + position + size, reinterpret_cast<char*>(values));
+			position += size;
+			return true;
+		}
+
+		template<typename T>
+		bool readColumn(std::vector<T> &values, size_t count) {
+			// the counts of a broken file are not trusted for the allocation
+			if (position + sizeof(T) * count > buffer.size()) {
+				return false;
+			}
+
+			values.resize(count);
+			return read(values.data(), count);
+		}
+
+		bool readString(std::string &value) {
+			uint32_t length;
+			if (!read(&length, 1) || position + length > buffer.size()) {
+				return false;
+			}
+
+			value.assign(buffer.begin() + position, buffer.begin() + position + length);
+			position += length;
+			return true;
+		}
+	};
+
+
+	/**
+	 * \brief Append a vector of a json-scene to a column.
+	 */
+	void appendVector(std::vector<double> &column, const json &j) {
+		column.push_back(j["x"].get<double>());
+		column.push_back(j["y"].get<double>());
+		column.push_back(j["z"].get<double>());
+	}
+
+
+	/**
+	 * \brief Get a vector of a column in the format of the json-scenes.
+	 */
+	template<typename T>
+	json toJson(const std::vector<T> &column, unsigned int i) {
+		json j;
+		j["x"] = column[3 * i];
+		j["y"] = column[3 * i + 1];
+		j["z"] = column[3 * i + 2];
+		return j;
+	}
+
+
+	/**
+	 * \brief Write a string with its length.
+	 */
+	void writeString(std::ofstream &stream, const std::string &value) {
+		uint32_t length = value.size();
+		stream.write(reinterpret_cast<const char*>(&length), sizeof(length));
+		stream.write(value.data(), length);
+	}
+}
+
+
+/**
+ * \brief Constructor of an empty binary scene.
+ */
+BinaryScene::BinaryScene()
+	: _settings(json::object()) {}
+
+
+/**
+ * \brief Convert a json-scene.
+ *
+ * \param j
+ *      Loaded json-file.
+ *
+ * \return False if an object has an unsupported type.
+ */
+bool BinaryScene::fromJson(const json &j) {
+	*this = BinaryScene();
+
+	for (json::const_iterator it = j.begin(); it != j.end(); ++it) {
+		if (it.key() != "objects") {
+			_settings[it.key()] = it.value();
+		}
+	}
+	_settings["objects"] = json::array();
+
+	const json &objects = j["objects"];
+
+	for (unsigned int i = 0; i < objects.size(); ++i) {
+		if (!addBody(objects[i])) {
+			return false;
+		}
+	}
+
+	// most scenes don't apply any external forces => the columns are not even created (see addBody())
+	return true;
+}
+
+
+/**
+ * \brief Append a body in the format of the objects of the json-scenes.
+ *
+ * \param d
+ *      JSON-configuration of the object.
+ *
+ * \return False if the object has an unsupported type.
+ */
+bool BinaryScene::addBody(const json &d) {
+	unsigned int i = getNumBodies();
+	std::string type = d["type"].get<std::string>();
+
+	if (type == "asteroid") {
+		_types.push_back(ASTEROID);
+		_scales.push_back(d["scaling"].get<double>());
+	} else if (type == "planet" || type == "sun") {
+		_types.push_back(type == "planet" ? PLANET : SUN);
+		_scales.push_back(d["size"].get<double>());
+	} else {
+		LOG_WARNING("Type (" + type + ") not supported!");
+		return false;
+	}
+
+	bool isContinuous = d.count("continuous") && d["continuous"].is_boolean() && d["continuous"].get<bool>();
+	bool isTestParticle = d.count("testParticle") && d["testParticle"].is_boolean() && d["testParticle"].get<bool>();
+	bool isVisualSpin = d.count("visualSpin") && d["visualSpin"].is_boolean() && d["visualSpin"].get<bool>();
+	_flags.push_back((isContinuous ? IS_CONTINUOUS : 0) | (isTestParticle ? IS_TEST_PARTICLE : 0) | (isVisualSpin ? IS_VISUAL_SPIN : 0));
+	_models.push_back(d.count("obj") ? addName(d["obj"]) : -1);
+	_textures.push_back(d.count("texture") ? addName(d["texture"]) : -1);
+	_bumpmaps.push_back(d.count("bumpmap") ? addName(d["bumpmap"]) : -1);
+	_ratios.push_back(d["ratio"].get<float>());
+	_masses.push_back(d["mass"].get<double>());
+	appendVector(_positions, d["position"]);
+	appendVector(_linearVelocities, d["linearVelocity"]);
+	appendVector(_angularVelocities, d["angularVelocity"]);
+
+	// the columns of the forces are only kept (for all bodies) as soon as a body has a force
+	bool hasForce = false;
+	const char* keys[2] = { "force", "torque" };
+	for (int k = 0; k < 2; ++k) {
+		hasForce |= d[keys[k]]["x"].get<double>() != 0.0 || d[keys[k]]["y"].get<double>() != 0.0 || d[keys[k]]["z"].get<double>() != 0.0;
+	}
+
+	if (hasForce && _forces.empty()) {
+		_forces.resize(3 * i, 0.0);
+		_torques.resize(3 * i, 0.0);
+	}
+	if (!_forces.empty()) {
+		appendVector(_forces, d["force"]);
+		appendVector(_torques, d["torque"]);
+	}
+
+	if (d.count("useFollowingRibbon") && d["useFollowingRibbon"].is_boolean() && d["useFollowingRibbon"].get<bool>() == true) {
+		const json &ribbonInfo = d["followingRibbon"];
+
+		_ribbonBodies.push_back(i);
+		_ribbonColors.push_back(ribbonInfo["color"]["x"].get<float>());
+		_ribbonColors.push_back(ribbonInfo["color"]["y"].get<float>());
+		_ribbonColors.push_back(ribbonInfo["color"]["z"].get<float>());
+		_ribbonPoints.push_back(ribbonInfo["numPoints"].get<unsigned int>());
+		_ribbonHalfWidths.push_back(ribbonInfo["halfWidth"].get<float>());
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Load the scene from a binary file. The file is read at once and the columns are copied directly.
+ *
+ * \param filePath
+ *      Complete path to the binary scene.
+ *
+ * \return False if the file can't be read or has a different format.
+ */
+bool BinaryScene::load(std::string filePath) {
+	*this = BinaryScene();
+
+	std::ifstream stream(filePath, std::ios::binary | std::ios::ate);
+	if (!stream) {
+		return false;
+	}
+
+	std::vector<char> buffer(static_cast<size_t>(stream.tellg()));
+	stream.seekg(0);
+	if (!stream.read(buffer.data(), buffer.size())) {
+		return false;
+	}
+
+	BufferReader reader(buffer);
+	uint32_t header[6];
+	std::string settings;
+
+	if (!reader.read(header, 6) || header[0] != MAGIC || header[1] != VERSION || !reader.readString(settings)) {
+		return false;
+	}
+
+	uint32_t cntStrings = header[2];
+	uint32_t n = header[3];
+	uint32_t cntRibbons = header[4];
+	uint32_t flags = header[5];
+
+	_settings = json::parse(settings);
+
+	_strings.resize(cntStrings);
+	for (uint32_t i = 0; i < cntStrings; ++i) {
+		if (!reader.readString(_strings[i])) {
+			return false;
+		}
+	}
+
+	bool isValid = reader.readColumn(_types, n) && reader.readColumn(_flags, n)
+		&& reader.readColumn(_models, n) && reader.readColumn(_textures, n) && reader.readColumn(_bumpmaps, n)
+		&& reader.readColumn(_ratios, n) && reader.readColumn(_scales, n) && reader.readColumn(_masses, n)
+		&& reader.readColumn(_positions, 3 * n) && reader.readColumn(_linearVelocities, 3 * n)
+		&& reader.readColumn(_angularVelocities, 3 * n);
+
+	if (isValid && (flags & HAS_FORCES)) {
+		isValid = reader.readColumn(_forces, 3 * n) && reader.readColumn(_torques, 3 * n);
+	}
+
+	isValid = isValid && reader.readColumn(_ribbonBodies, cntRibbons) && reader.readColumn(_ribbonColors, 3 * cntRibbons)
+		&& reader.readColumn(_ribbonPoints, cntRibbons) && reader.readColumn(_ribbonHalfWidths, cntRibbons);
+
+	// the checkpoint only copies the columns, the acceleration-structures are rebuilt by the simulation
+	uint32_t counts[4];
+	if (isValid && (flags & HAS_STATE)) {
+		isValid = reader.read(counts, 4);
+
+		uint32_t m = counts[0];
+		isValid = isValid && reader.readColumn(_state.positions, 3 * m) && reader.readColumn(_state.orientations, 4 * m)
+			&& reader.readColumn(_state.linearVelocities, 3 * m) && reader.readColumn(_state.angularVelocities, 3 * m)
+			&& reader.readColumn(_state.sleeping, m) && reader.readColumn(_state.restingSteps, m)
+			&& reader.readColumn(_state.timestepLevels, m) && reader.readColumn(_state.forces, 3 * counts[1])
+			&& reader.readColumn(_state.pairBodies, 2 * counts[2]) && reader.readColumn(_state.pairSupportVertices, 2 * counts[2])
+			&& reader.readColumn(_state.pairDirections, 3 * counts[2])
+			&& reader.readColumn(_state.impulseBodies, 2 * counts[3]) && reader.readColumn(_state.impulses, 4 * counts[3]);
+
+		_hasState = isValid;
+	}
+
+	if (!isValid) {
+		*this = BinaryScene();
+	}
+
+	return isValid;
+}
+
+
+/**
+ * \brief Write the scene to a binary file.
+ *
+ * \param filePath
+ *      Complete path to the binary scene.
+ *
+ * \return False if the file can't be written.
+ */
+bool BinaryScene::save(std::string filePath) const {
+	std::ofstream stream(filePath, std::ios::binary | std::ios::trunc);
+	if (!stream) {
+		return false;
+	}
+
+	uint32_t header[6] = { MAGIC, VERSION, static_cast<uint32_t>(_strings.size()), getNumBodies(),
+		static_cast<uint32_t>(_ribbonBodies.size()), (_forces.empty() ? 0 : HAS_FORCES) | (_hasState ? HAS_STATE : 0) };
+
+	stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+	writeString(stream, _settings.dump());
+
+	for (unsigned int i = 0; i < _strings.size(); ++i) {
+		writeString(stream, _strings[i]);
+	}
+
+	writeColumn(stream, _types);
+	writeColumn(stream, _flags);
+	writeColumn(stream, _models);
+	writeColumn(stream, _textures);
+	writeColumn(stream, _bumpmaps);
+	writeColumn(stream, _ratios);
+	writeColumn(stream, _scales);
+	writeColumn(stream, _masses);
+	writeColumn(stream, _positions);
+	writeColumn(stream, _linearVelocities);
+	writeColumn(stream, _angularVelocities);
+	writeColumn(stream, _forces);
+	writeColumn(stream, _torques);
+
+	writeColumn(stream, _ribbonBodies);
+	writeColumn(stream, _ribbonColors);
+	writeColumn(stream, _ribbonPoints);
+	writeColumn(stream, _ribbonHalfWidths);
+
+	if (_hasState) {
+		uint32_t counts[4] = { static_cast<uint32_t>(_state.sleeping.size()), static_cast<uint32_t>(_state.forces.size() / 3),
+			static_cast<uint32_t>(_state.pairBodies.size() / 2), static_cast<uint32_t>(_state.impulseBodies.size() / 2) };
+		stream.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+
+		writeColumn(stream, _state.positions);
+		writeColumn(stream, _state.orientations);
+		writeColumn(stream, _state.linearVelocities);
+		writeColumn(stream, _state.angularVelocities);
+		writeColumn(stream, _state.sleeping);
+		writeColumn(stream, _state.restingSteps);
+		writeColumn(stream, _state.timestepLevels);
+		writeColumn(stream, _state.forces);
+		writeColumn(stream, _state.pairBodies);
+		writeColumn(stream, _state.pairSupportVertices);
+		writeColumn(stream, _state.pairDirections);
+		writeColumn(stream, _state.impulseBodies);
+		writeColumn(stream, _state.impulses);
+	}
+
+	return static_cast<bool>(stream);
+}
+
+
+/**
+ * \brief Resize the body table. The added bodies are set with setBody() (they can be set concurrently).
+ *
+ * \param cntBodies
+ *      Number of bodies.
+ */
+void BinaryScene::resize(unsigned int cntBodies) {
+	_types.resize(cntBodies, ASTEROID);
+	_flags.resize(cntBodies, 0);
+	_models.resize(cntBodies, -1);
+	_textures.resize(cntBodies, -1);
+	_bumpmaps.resize(cntBodies, -1);
+	_ratios.resize(cntBodies, 1.0f);
+	_scales.resize(cntBodies, 1.0);
+	_masses.resize(cntBodies, 1.0);
+	_positions.resize(3 * cntBodies, 0.0);
+	_linearVelocities.resize(3 * cntBodies, 0.0);
+	_angularVelocities.resize(3 * cntBodies, 0.0);
+
+	if (!_forces.empty()) {
+		_forces.resize(3 * cntBodies, 0.0);
+		_torques.resize(3 * cntBodies, 0.0);
+	}
+}
+
+
+/**
+ * \brief Set a body of the table (without external forces and following-ribbon).
+ *
+ * \param i
+ *      Index of the body.
+ * \param type
+ *      Type of the space-object.
+ * \param model
+ *      Model (index into the strings, -1 => not set).
+ * \param texture
+ *      Texture (index into the strings, -1 => not set).
+ * \param bumpmap
+ *      Bumpmap (index into the strings, -1 => not set).
+ * \param scale
+ *      Scaling (asteroids) or size (planets and suns).
+ * \param mass
+ *      Mass of the object.
+ * \param position
+ *      Initial position of the object.
+ * \param linearVelocity
+ *      Initial linear velocity of the object.
+ * \param angularVelocity
+ *      Initial angular velocity of the object.
+ */
+void BinaryScene::setBody(unsigned int i, BodyType type, int32_t model, int32_t texture, int32_t bumpmap, double scale, double mass,
+	const Eigen::Vector3d &position, const Eigen::Vector3d &linearVelocity, const Eigen::Vector3d &angularVelocity) {
+	_types[i] = type;
+	_flags[i] = 0;
+	_models[i] = model;
+	_textures[i] = texture;
+	_bumpmaps[i] = bumpmap;
+	_ratios[i] = 1.0f;
+	_scales[i] = scale;
+	_masses[i] = mass;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		_positions[3 * i + axis] = position(axis);
+		_linearVelocities[3 * i + axis] = linearVelocity(axis);
+		_angularVelocities[3 * i + axis] = angularVelocity(axis);
+
+		if (!_forces.empty()) {
+			_forces[3 * i + axis] = 0.0;
+			_torques[3 * i + axis] = 0.0;
+		}
+	}
+}
+
+
+/**
+ * \brief Set the motion of a body of the table (e.g. the current one of a checkpoint).
+ *
+ * \param i
+ *      Index of the body.
+ * \param position
+ *      Position of the object.
+ * \param linearVelocity
+ *      Linear velocity of the object.
+ * \param angularVelocity
+ *      Angular velocity of the object.
+ */
+void BinaryScene::setMotion(unsigned int i, const Eigen::Vector3d &position, const Eigen::Vector3d &linearVelocity, const Eigen::Vector3d &angularVelocity) {
+	for (int axis = 0; axis < 3; ++axis) {
+		_positions[3 * i + axis] = position(axis);
+		_linearVelocities[3 * i + axis] = linearVelocity(axis);
+		_angularVelocities[3 * i + axis] = angularVelocity(axis);
+	}
+}
+
+
+/**
+ * \brief Get the json-configuration of a body, in the same format as the objects of the json-scenes.
+ *
+ * \param i
+ *      Index of the body.
+ *
+ * \return JSON-configuration of the object (the id is the index).
+ */
+json BinaryScene::getBody(unsigned int i) const {
+	json d;
+	d["id"] = i;
+
+	switch (_types[i]) {
+	case ASTEROID:
+		d["type"] = "asteroid";
+		d["scaling"] = _scales[i];
+		break;
+	case PLANET:
+		d["type"] = "planet";
+		d["size"] = _scales[i];
+		break;
+	default:
+		d["type"] = "sun";
+		d["size"] = _scales[i];
+		break;
+	}
+
+	d["obj"] = getString(_models[i]);
+	d["texture"] = getString(_textures[i]);
+	d["bumpmap"] = getString(_bumpmaps[i]);
+	d["continuous"] = (_flags[i] & IS_CONTINUOUS) != 0;
+	d["testParticle"] = (_flags[i] & IS_TEST_PARTICLE) != 0;
+	d["visualSpin"] = (_flags[i] & IS_VISUAL_SPIN) != 0;
+	d["ratio"] = _ratios[i];
+	d["mass"] = _masses[i];
+	d["position"] = toJson(_positions, i);
+	d["linearVelocity"] = toJson(_linearVelocities, i);
+	d["angularVelocity"] = toJson(_angularVelocities, i);
+
+	if (_forces.empty()) {
+		d["force"] = toJson(std::vector<double>(3, 0.0), 0);
+		d["torque"] = d["force"];
+	} else {
+		d["force"] = toJson(_forces, i);
+		d["torque"] = toJson(_torques, i);
+	}
+
+	// the ribbons are sorted by their bodies
+	std::vector<uint32_t>::const_iterator ribbon = std::lower_bound(_ribbonBodies.begin(), _ribbonBodies.end(), i);
+	if (ribbon != _ribbonBodies.end() && *ribbon == i) {
+		unsigned int r = ribbon - _ribbonBodies.begin();
+
+		d["useFollowingRibbon"] = true;
+		d["followingRibbon"]["color"] = toJson(_ribbonColors, r);
+		d["followingRibbon"]["numPoints"] = _ribbonPoints[r];
+		d["followingRibbon"]["halfWidth"] = _ribbonHalfWidths[r];
+	}
+
+	return d;
+}
+
+
+/**
+ * \brief Get the index of a name in the string table (the name is added if it's new).
+ *
+ * \param j
+ *      JSON-value of the name.
+ *
+ * \return Index into the strings (-1 => the value is not a string).
+ */
+int32_t BinaryScene::addName(const json &j) {
+	if (!j.is_string()) {
+		return -1;
+	}
+
+	return addString(j.get<std::string>());
+}
+
+
+/**
+ * \brief Get the index of a name in the string table (the name is added if it's new).
+ *
+ * \param value
+ *      Name of a model or a texture.
+ *
+ * \return Index into the strings.
+ */
+int32_t BinaryScene::addString(const std::string &value) {
+	std::vector<std::string>::iterator it = std::find(_strings.begin(), _strings.end(), value);
+
+	if (it != _strings.end()) {
+		return it - _strings.begin();
+	}
+
+	_strings.push_back(value);
+	return _strings.size() - 1;
+}
+
+
+/**
+ * \brief Get the name of a string index.
+ *
+ * \param index
+ *      Index into the strings.
+ *
+ * \return JSON-value of the name (null if not set).
+ */
+json BinaryScene::getString(int32_t index) const {
+	if (index < 0 || static_cast<size_t>(index) >= _strings.size()) {
+		return nullptr;
+	}
+
+	return _strings[index];
+}
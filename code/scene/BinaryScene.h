@@ -0,0 +1,361 @@
+﻿/**
+ * \brief Compact binary representation of a json-scene.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-19
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <Eigen/Core>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+
+namespace pbs17 {
+
+	/**
+	 * \brief BinaryScene stores the objects of a scene as packed columns (structure of arrays) instead of json.
+	 *
+	 * Layout of the file (little-endian, no padding):
+	 *  - Header: magic ("PBSC"), version, number of strings, bodies and ribbons, flags
+	 *  - Settings: length and text of the json-scene without the objects (name, simulation, gameplay, player)
+	 *  - String table: length and characters of each model- and texture-name
+	 *  - Body table: one column per property (types, flags, models, textures, bumpmaps, ratios, scales, masses,
+	 *    positions, linear velocities, angular velocities and, only if any is non-zero, forces and torques)
+	 *  - Ribbon table: body, color, number of points and half-width of each following-ribbon
+	 *  - State (only checkpoints): numbers of simulated bodies, forces, cached pairs and contacts, then the columns
+	 *    of the State in the order of its members
+	 *
+	 * The names in the body table are indices into the string table (-1 => not set). The step, the simulated time
+	 * and the seed of a checkpoint are stored in the settings ("checkpoint").
+	 */
+	class BinaryScene {
+	public:
+
+		//! Types of the space-objects
+		enum BodyType {
+			ASTEROID = 0,
+			PLANET = 1,
+			SUN = 2
+		};
+
+
+		/**
+		 * \brief Complete state of a running simulation (checkpoint), in the order of the simulated bodies (the
+		 * player is the first body of a game). The pairs refer to the indices of the bodies.
+		 */
+		struct State {
+			//! Positions, orientations (x, y, z, w), linear and angular velocities
+			std::vector<double> positions;
+			std::vector<double> orientations;
+			std::vector<double> linearVelocities;
+			std::vector<double> angularVelocities;
+			//! Flag per body if it is sleeping
+			std::vector<uint8_t> sleeping;
+			//! Consecutive resting steps and level of the block-timesteps per body
+			std::vector<int32_t> restingSteps;
+			std::vector<int32_t> timestepLevels;
+			//! Forces of the last evaluation (empty => recomputed by the next step)
+			std::vector<double> forces;
+			//! Pairs of the GJK-cache (2 bodies per pair), their support-vertices and directions
+			std::vector<uint32_t> pairBodies;
+			std::vector<int32_t> pairSupportVertices;
+			std::vector<double> pairDirections;
+			//! Contacts of the warm-starting (2 bodies per contact) and their impulses (normal, tangent)
+			std::vector<uint32_t> impulseBodies;
+			std::vector<double> impulses;
+		};
+
+
+		/**
+		 * \brief Constructor of an empty binary scene.
+		 */
+		BinaryScene();
+
+
+		/**
+		 * \brief Convert a json-scene.
+		 *
+		 * \param j
+		 *      Loaded json-file.
+		 *
+		 * \return False if an object has an unsupported type.
+		 */
+		bool fromJson(const json &j);
+
+
+		/**
+		 * \brief Load the scene from a binary file. The file is read at once and the columns are copied directly.
+		 *
+		 * \param filePath
+		 *      Complete path to the binary scene.
+		 *
+		 * \return False if the file can't be read or has a different format.
+		 */
+		bool load(std::string filePath);
+
+
+		/**
+		 * \brief Write the scene to a binary file.
+		 *
+		 * \param filePath
+		 *      Complete path to the binary scene.
+		 *
+		 * \return False if the file can't be written.
+		 */
+		bool save(std::string filePath) const;
+
+
+		/**
+		 * \brief Resize the body table. The added bodies are set with setBody() (they can be set concurrently).
+		 *
+		 * \param cntBodies
+		 *      Number of bodies.
+		 */
+		void resize(unsigned int cntBodies);
+
+
+		/**
+		 * \brief Set a body of the table (without external forces and following-ribbon).
+		 *
+		 * \param i
+		 *      Index of the body.
+		 * \param type
+		 *      Type of the space-object.
+		 * \param model
+		 *      Model (index into the strings, -1 => not set).
+		 * \param texture
+		 *      Texture (index into the strings, -1 => not set).
+		 * \param bumpmap
+		 *      Bumpmap (index into the strings, -1 => not set).
+		 * \param scale
+		 *      Scaling (asteroids) or size (planets and suns).
+		 * \param mass
+		 *      Mass of the object.
+		 * \param position
+		 *      Initial position of the object.
+		 * \param linearVelocity
+		 *      Initial linear velocity of the object.
+		 * \param angularVelocity
+		 *      Initial angular velocity of the object.
+		 */
+		void setBody(unsigned int i, BodyType type, int32_t model, int32_t texture, int32_t bumpmap, double scale, double mass,
+			const Eigen::Vector3d &position, const Eigen::Vector3d &linearVelocity, const Eigen::Vector3d &angularVelocity);
+
+
+		/**
+		 * \brief Get the index of a name in the string table (the name is added if it's new).
+		 *
+		 * \param value
+		 *      Name of a model or a texture.
+		 *
+		 * \return Index into the strings.
+		 */
+		int32_t addString(const std::string &value);
+
+
+		/**
+		 * \brief Append a body in the format of the objects of the json-scenes.
+		 *
+		 * \param d
+		 *      JSON-configuration of the object.
+		 *
+		 * \return False if the object has an unsupported type.
+		 */
+		bool addBody(const json &d);
+
+
+		/**
+		 * \brief Set the motion of a body of the table (e.g. the current one of a checkpoint).
+		 *
+		 * \param i
+		 *      Index of the body.
+		 * \param position
+		 *      Position of the object.
+		 * \param linearVelocity
+		 *      Linear velocity of the object.
+		 * \param angularVelocity
+		 *      Angular velocity of the object.
+		 */
+		void setMotion(unsigned int i, const Eigen::Vector3d &position, const Eigen::Vector3d &linearVelocity, const Eigen::Vector3d &angularVelocity);
+
+
+		/**
+		 * \brief Get the json-configuration of a body, in the same format as the objects of the json-scenes.
+		 *
+		 * \param i
+		 *      Index of the body.
+		 *
+		 * \return JSON-configuration of the object (the id is the index).
+		 */
+		json getBody(unsigned int i) const;
+
+
+		/**
+		 * \brief Get the scene without the objects (name, simulation-settings, gameplay and player).
+		 *
+		 * \return Json-scene with an empty "objects"-array.
+		 */
+		json getSettings() const {
+			return _settings;
+		}
+
+
+		/**
+		 * \brief Set the scene without the objects (name, simulation-settings, gameplay and player).
+		 *
+		 * \param settings
+		 *      Json-scene (the objects are ignored).
+		 */
+		void setSettings(const json &settings) {
+			_settings = settings;
+			_settings["objects"] = json::array();
+		}
+
+
+		/**
+		 * \brief Get the number of names in the string table.
+		 *
+		 * \return Number of strings.
+		 */
+		unsigned int getNumStrings() const {
+			return _strings.size();
+		}
+
+
+		/**
+		 * \brief Get the number of bodies in the scene.
+		 *
+		 * \return Number of bodies.
+		 */
+		unsigned int getNumBodies() const {
+			return _types.size();
+		}
+
+
+		/**
+		 * \brief Get if the scene is a checkpoint with the state of a simulation.
+		 *
+		 * \return True if the state is set.
+		 */
+		bool hasState() const {
+			return _hasState;
+		}
+
+
+		/**
+		 * \brief Get the state of the simulation of a checkpoint.
+		 *
+		 * \return State of the simulation.
+		 */
+		const State& getState() const {
+			return _state;
+		}
+
+
+		/**
+		 * \brief Set the state of the simulation (=> the scene is written as checkpoint).
+		 *
+		 * \param state
+		 *      State of the simulation.
+		 */
+		void setState(const State &state) {
+			_state = state;
+			_hasState = true;
+		}
+
+
+	private:
+
+		//! Identifier at the beginning of the file ("PBSC")
+		static const uint32_t MAGIC;
+		//! Version of the format (increase if the layout changes)
+		static const uint32_t VERSION;
+
+		//! Flag of the header: The forces and torques are stored
+		static const uint32_t HAS_FORCES = 1;
+		//! Flag of the header: The state of a simulation is stored (checkpoint)
+		static const uint32_t HAS_STATE = 2;
+		//! Flag of a body: The collisions are detected continuously
+		static const uint8_t IS_CONTINUOUS = 1;
+		//! Flag of a body: The body is a test-particle (does not attract the massive sources)
+		static const uint8_t IS_TEST_PARTICLE = 2;
+		//! Flag of a body: The rotation is only visual (see SpaceObject::isVisualSpin())
+		static const uint8_t IS_VISUAL_SPIN = 4;
+
+		//! Scene without the objects
+		json _settings;
+
+		//! Names of the models and textures
+		std::vector<std::string> _strings;
+
+		//! Type of each body
+		std::vector<uint8_t> _types;
+		//! Flags of each body
+		std::vector<uint8_t> _flags;
+		//! Model of each body (index into the strings)
+		std::vector<int32_t> _models;
+		//! Texture of each body (index into the strings)
+		std::vector<int32_t> _textures;
+		//! Bumpmap of each body (index into the strings)
+		std::vector<int32_t> _bumpmaps;
+		//! Ratio of the simplification of each body
+		std::vector<float> _ratios;
+		//! Scaling (asteroids) or size (planets and suns) of each body
+		std::vector<double> _scales;
+		//! Mass of each body
+		std::vector<double> _masses;
+		//! Position of each body (3 values per body)
+		std::vector<double> _positions;
+		//! Linear velocity of each body (3 values per body)
+		std::vector<double> _linearVelocities;
+		//! Angular velocity of each body (3 values per body)
+		std::vector<double> _angularVelocities;
+		//! Force of each body (3 values per body, empty if all are zero)
+		std::vector<double> _forces;
+		//! Torque of each body (3 values per body, empty if all are zero)
+		std::vector<double> _torques;
+
+		//! Body of each following-ribbon
+		std::vector<uint32_t> _ribbonBodies;
+		//! Color of each following-ribbon (3 values per ribbon)
+		std::vector<float> _ribbonColors;
+		//! Number of points of each following-ribbon
+		std::vector<uint32_t> _ribbonPoints;
+		//! Half-width of each following-ribbon
+		std::vector<float> _ribbonHalfWidths;
+
+		//! True if the state of a simulation is stored
+		bool _hasState = false;
+		//! State of the simulation (checkpoint)
+		State _state;
+
+
+		/**
+		 * \brief Get the index of a name in the string table (the name is added if it's new).
+		 *
+		 * \param j
+		 *      JSON-value of the name.
+		 *
+		 * \return Index into the strings (-1 => the value is not a string).
+		 */
+		int32_t addName(const json &j);
+
+
+		/**
+		 * \brief Get the name of a string index.
+		 *
+		 * \param index
+		 *      Index into the strings.
+		 *
+		 * \return JSON-value of the name (null if not set).
+		 */
+		json getString(int32_t index) const;
+	};
+}
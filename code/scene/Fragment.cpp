@@ -0,0 +1,166 @@
+﻿/**
+ * \brief Implementation of a pre-fractured piece of an asteroid.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#include "Fragment.h"
+
+#include <osg/Geode>
+
+#include "../osg/OsgEigenConversions.h"
+
+using namespace pbs17;
+
+
+/**
+ * \brief Constructor of Fragment (the fragment is not active until activate() is called).
+ *
+ * \param piece
+ *      Pre-fractured piece of the model (owned by the fracture-manager).
+ * \param textureName
+ *      Texture of the fractured asteroids.
+ */
+Fragment::Fragment(const VoronoiFracture::Piece &piece, std::string textureName)
+	: SpaceObject("", textureName), _geometry(piece.geometry), _inertiaPerMass(piece.inertiaPerMass) {
+	_convexHull = piece.hull;
+	_isActive = false;
+
+	initOsg(Eigen::Vector3d::Zero(), 1.0, 1.0);
+	initPhysics(1.0, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+	setMomentOfInertia(_inertiaPerMass);
+}
+
+
+/**
+ * \brief Destructor of Fragment.
+ */
+Fragment::~Fragment() {}
+
+
+/**
+ * \brief Initialize the space-object for OSG.
+ *
+ * \param position
+ *      Initial position of the object.
+ * \param ratio
+ *      Ratio of the simplifier. (Not used, the pieces are not simplified)
+ * \param scaling
+ *      Scaling of the model. (1.0 => not scaled, < 1.0 => smaller, > 1.0 => larger)
+ */
+void Fragment::initOsg(Eigen::Vector3d position, double ratio, double scaling) {
+	_position = position;
+	_scaling = scaling;
+	_renderedScaling = scaling;
+
+	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
+	if (_geometry.valid()) {
+		geode->addDrawable(_geometry);
+	}
+	_modelFile = geode;
+
+	osg::ref_ptr<osg::Geode> geodeConvexHull = new osg::Geode;
+	geodeConvexHull->addDrawable(getConvexHullModel()->getOsgModel());
+
+	// Switch to decide if the convex hull or the model has to be rendered.
+	_convexRenderSwitch = new osg::Switch;
+	_convexRenderSwitch->addChild(_modelFile, true);
+	_convexRenderSwitch->addChild(geodeConvexHull, false);
+
+	// the scaling of the fractured asteroid is only known when the fragment is activated
+	_scaleNode = new osg::MatrixTransform(osg::Matrix::scale(scaling, scaling, scaling));
+	_scaleNode->setDataVariance(osg::Object::DYNAMIC);
+	_scaleNode->addChild(_convexRenderSwitch);
+
+	_transformation = new osg::MatrixTransform;
+	_transformation->setDataVariance(osg::Object::DYNAMIC);
+	_transformation->setMatrix(osg::Matrix::translate(toOsg(position)));
+	_transformation->addChild(_scaleNode);
+
+	_modelRoot = new osg::Switch;
+	_modelRoot->insertChild(0, _transformation, true);
+
+	// the box of the scaled convex-hull (the pieces are small, the rotated box is tight enough)
+	_aabbLocal = osg::BoundingBox();
+	const std::vector<Eigen::Vector3d> &vertices = getConvexHullModel()->getVertices();
+	for (unsigned int i = 0; i < vertices.size(); ++i) {
+		_aabbLocal.expandBy(toOsg(Eigen::Vector3d(scaling * vertices[i])));
+	}
+	_aabbLocalOrig = _aabbLocal;
+	updateAABB();
+
+	initTexturing();
+}
+
+
+/**
+ * \brief Add the fragment to the simulation with the state of its piece in the fractured asteroid.
+ *
+ * \param position
+ *      Center of mass of the piece.
+ * \param orientation
+ *      Orientation of the fractured asteroid.
+ * \param scaling
+ *      Scaling of the fractured asteroid.
+ * \param mass
+ *      Mass of the piece.
+ * \param linearVelocity
+ *      Velocity of the fractured asteroid at the center of mass of the piece.
+ * \param angularVelocity
+ *      Angular velocity of the fractured asteroid.
+ */
+void Fragment::activate(Eigen::Vector3d position, osg::Quat orientation, double scaling, double mass,
+	Eigen::Vector3d linearVelocity, Eigen::Vector3d angularVelocity) {
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_scalingMutex);
+		_scaling = scaling;
+		_growth = 1.0;
+	}
+
+	_aabbLocal = osg::BoundingBox();
+	const std::vector<Eigen::Vector3d> &vertices = getConvexHullModel()->getVertices();
+	for (unsigned int i = 0; i < vertices.size(); ++i) {
+		_aabbLocal.expandBy(toOsg(Eigen::Vector3d(scaling * vertices[i])));
+	}
+	_aabbLocalOrig = _aabbLocal;
+
+	initPhysics(mass, linearVelocity, angularVelocity, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+	setMomentOfInertia((mass * scaling * scaling) * _inertiaPerMass);
+
+	_isSleeping = false;
+	_sweep = Eigen::Vector3d::Zero();
+	resetCollisionState();
+	setPositionOrientation(position, orientation);
+	setActive(true);
+}
+
+
+/**
+ * \brief Write the given state to the OSG-nodes (has to be called from the rendering-thread). The scaling
+ *        of the last activation is applied as well.
+ *
+ * \param position
+ *      Position of the object.
+ * \param orientation
+ *      Orientation of the object.
+ * \param aabb
+ *      Global AABB of the object.
+ * \param collisionState
+ *      Collision-state of the object (colour of the AABB).
+ */
+void Fragment::applyTransformation(const osg::Vec3d &position, const osg::Quat &orientation, const osg::BoundingBox &aabb, int collisionState) {
+	double scaling;
+	{
+		// the growth after the activation is applied by the transformation
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_scalingMutex);
+		scaling = _scaling / _growth;
+	}
+
+	if (scaling != _renderedScaling) {
+		_scaleNode->setMatrix(osg::Matrix::scale(scaling, scaling, scaling));
+		_renderedScaling = scaling;
+	}
+
+	SpaceObject::applyTransformation(position, orientation, aabb, collisionState);
+}
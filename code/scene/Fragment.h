@@ -0,0 +1,99 @@
+﻿/**
+ * \brief Implementation of a pre-fractured piece of an asteroid.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-13
+ */
+
+#pragma once
+
+
+#include "SpaceObject.h"
+#include "../graphics/VoronoiFracture.h"
+
+namespace pbs17 {
+
+	/**
+	 * \brief Fragment is a pre-fractured piece of an asteroid which waits in the pool of the fracture-manager until
+	 *        its asteroid breaks. Its convex-hull, geometry and inertia are baked once per model, the activation only
+	 *        sets the state of the piece (see FractureManager).
+	 */
+	class Fragment : public SpaceObject {
+	public:
+		/**
+		 * \brief Constructor of Fragment (the fragment is not active until activate() is called).
+		 *
+		 * \param piece
+		 *      Pre-fractured piece of the model (owned by the fracture-manager).
+		 * \param textureName
+		 *      Texture of the fractured asteroids.
+		 */
+		Fragment(const VoronoiFracture::Piece &piece, std::string textureName);
+
+
+		/**
+		 * \brief Destructor of Fragment.
+		 */
+		~Fragment();
+
+
+		/**
+		 * \brief Initialize the space-object for OSG.
+		 *
+		 * \param position
+		 *      Initial position of the object.
+		 * \param ratio
+		 *      Ratio of the simplifier. (Not used, the pieces are not simplified)
+		 * \param scaling
+		 *      Scaling of the model. (1.0 => not scaled, < 1.0 => smaller, > 1.0 => larger)
+		 */
+		void initOsg(Eigen::Vector3d position, double ratio, double scaling) override;
+
+
+		/**
+		 * \brief Add the fragment to the simulation with the state of its piece in the fractured asteroid.
+		 *
+		 * \param position
+		 *      Center of mass of the piece.
+		 * \param orientation
+		 *      Orientation of the fractured asteroid.
+		 * \param scaling
+		 *      Scaling of the fractured asteroid.
+		 * \param mass
+		 *      Mass of the piece.
+		 * \param linearVelocity
+		 *      Velocity of the fractured asteroid at the center of mass of the piece.
+		 * \param angularVelocity
+		 *      Angular velocity of the fractured asteroid.
+		 */
+		void activate(Eigen::Vector3d position, osg::Quat orientation, double scaling, double mass,
+			Eigen::Vector3d linearVelocity, Eigen::Vector3d angularVelocity);
+
+
+		/**
+		 * \brief Write the given state to the OSG-nodes (has to be called from the rendering-thread). The scaling
+		 *        of the last activation is applied as well.
+		 *
+		 * \param position
+		 *      Position of the object.
+		 * \param orientation
+		 *      Orientation of the object.
+		 * \param aabb
+		 *      Global AABB of the object.
+		 * \param collisionState
+		 *      Collision-state of the object (colour of the AABB).
+		 */
+		void applyTransformation(const osg::Vec3d &position, const osg::Quat &orientation, const osg::BoundingBox &aabb, int collisionState) override;
+
+
+	private:
+		//! Geometry of the piece (nullptr => headless)
+		osg::ref_ptr<osg::Geometry> _geometry;
+		//! Moment of inertia about the center of mass per unit of mass (unscaled)
+		Eigen::Matrix3d _inertiaPerMass;
+		//! Scaling of the geometry and the convex-hull
+		osg::ref_ptr<osg::MatrixTransform> _scaleNode;
+		//! Scaling which was last written to the OSG-nodes
+		double _renderedScaling = 1.0;
+	};
+}
@@ -7,15 +7,19 @@
 
 #include "Planet.h"
 
+#include <algorithm>
+
 #include <osg/Switch>
 #include <osgDB/ReadFile>
 
 #include "../config.h"
 #include "../osg/JsonEigenConversions.h"
 #include "../osg/OsgEigenConversions.h"
+#include "../osg/InstanceManager.h"
 #include "../osg/Loader.h"
+#include "../osg/MaterialCache.h"
+#include "../osg/MipStreamer.h"
 #include "../osg/ModelManager.h"
-#include "../osg/visitors/ConvexHullVisitor.h"
 
 using namespace pbs17;
 
@@ -27,7 +31,9 @@ using namespace pbs17;
  *      Size of the planet.
  */
 Planet::Planet(double size)
-	: SpaceObject("", 0), _radius(size) {}
+	: SpaceObject("", 0), _radius(size) {
+	_shapeType = SPHERE;
+}
 
 
 /**
@@ -36,7 +42,8 @@ Planet::Planet(double size)
  * \param j
  *      JSON-configuration for the planet.
  */
-Planet::Planet(json j) : SpaceObject(j) {
+Planet::Planet(const json &j) : SpaceObject(j) {
+	_shapeType = SPHERE;
 	_radius = j["size"].get<double>();
 	Eigen::Vector3d pos = fromJson(j["position"]);
 	initOsg(pos, j["ratio"].get<double>(), _radius);
@@ -48,8 +55,8 @@ Planet::Planet(json j) : SpaceObject(j) {
 
 	initPhysics(j["mass"].get<double>(), linearVelocity, angularVelocity, force, torque);
 
-	if (j["useFollowingRibbon"].is_boolean() && j["useFollowingRibbon"].get<bool>() == true) {
-		json ribbonInfo = j["followingRibbon"];
+	if (j.count("useFollowingRibbon") && j["useFollowingRibbon"].is_boolean() && j["useFollowingRibbon"].get<bool>() == true) {
+		const json &ribbonInfo = j["followingRibbon"];
 
 		initFollowingRibbon(toOsg(fromJson(ribbonInfo["color"])),
 			ribbonInfo["numPoints"].get<unsigned int>(),
@@ -67,7 +74,9 @@ Planet::Planet(json j) : SpaceObject(j) {
  *      Relative location to the texture-file. (Relative from the data-directory in the source).
  */
 Planet::Planet(double size, std::string textureName)
-	: SpaceObject("", textureName), _radius(size) {}
+	: SpaceObject("", textureName), _radius(size) {
+	_shapeType = SPHERE;
+}
 
 
 /**
@@ -100,35 +109,67 @@ void Planet::initOsg(Eigen::Vector3d position, double ratio, double scaling) {
 		_modelFile = Loader::scaleNode(_modelFile, _radius);
 	}
 
-	// Compute convex hull
-	osg::Matrix scalingMatrix = osg::Matrix::scale(_radius, _radius, _radius);
-	ConvexHullVisitor convexHull(scalingMatrix);
-	_modelFile->accept(convexHull);
-	_convexHull = convexHull.getConvexHull();
+	// Get the convex hull (shared by all instances of the model, the scaling is applied to its vertices)
+	_convexHull = ModelManager::Instance()->loadConvexHull(modelPath, false);
 
 	osg::Geode* geodeConvexHull = new osg::Geode;
-	geodeConvexHull->addDrawable(_convexHull->getOsgModel());
+	geodeConvexHull->addDrawable(getConvexHullModel()->getOsgModel());
 
 	// Switch to decide if the convex hull or the model has to be rendered.
 	_convexRenderSwitch = new osg::Switch;
 	_convexRenderSwitch->addChild(_modelFile, true);
-	_convexRenderSwitch->addChild(geodeConvexHull, false);
+	_convexRenderSwitch->addChild(Loader::scaleNode(geodeConvexHull, _scaling), false);
 
 	// Transformation-node for position and rotation updates.
 	_transformation = new osg::MatrixTransform;
+	// written by the update-traversal while the previous frame may still be drawn (see SceneManager::initViewer())
+	_transformation->setDataVariance(osg::Object::DYNAMIC);
 	_transformation->setMatrix(osg::Matrix::translate(toOsg(position)));
 	_transformation->addChild(_convexRenderSwitch);
 
 	calculateAABB();
 
+	// the vertices of the sphere lie within the largest half-extent of its box in any orientation
+	osg::Vec3 halfExtent = (_aabbLocal._max - _aabbLocal._min) * 0.5f;
+	setBoundingRadius(std::max(_radius, static_cast<double>(std::max(halfExtent.x(), std::max(halfExtent.y(), halfExtent.z())))));
+
 	_modelRoot = new osg::Switch;
 	_modelRoot->insertChild(0, _transformation, true);
-	_modelRoot->insertChild(1, _aabbRendering, false);
+
+	// the planet hides the instanced asteroids behind it (the facets of the coarsest level lie within 98% of the radius)
+	if (InstanceManager::getIsEnabled() && !getIsHeadless()) {
+		InstanceManager::Instance()->addOccluder(_transformation, static_cast<float>(0.98 * _radius));
+	}
 
 	initTexturing();
 }
 
 
+/**
+ * \brief Initialize the texture-properties and shader (the mip-levels of the textures are streamed by the
+ *        size of the planet on the screen if enabled, see MipStreamer).
+ */
+void Planet::initTexturing() {
+	if (!MipStreamer::getIsEnabled() || getIsHeadless() || _textureName == "") {
+		SpaceObject::initTexturing();
+		return;
+	}
+
+	// the streamed textures are shared by all planets with the same textures, the finest level is sampled by the largest one
+	std::string texturePath = DATA_PATH + "/texture/" + _textureName;
+	std::string bumpmapPath = _bumpmapName != "" ? DATA_PATH + "/texture/" + _bumpmapName : "";
+	_convexRenderSwitch->setStateSet(MaterialCache::Instance()->getStateSet(texturePath, bumpmapPath, MaterialCache::STREAMED));
+
+	std::vector<std::string> filePaths(1, texturePath);
+	if (bumpmapPath != "") {
+		filePaths.push_back(bumpmapPath);
+	}
+	MipStreamer::Instance()->addUser(_convexRenderSwitch, filePaths);
+
+	initVisualSpin(bumpmapPath != "");
+}
+
+
 /**
  * \brief Initialize the space-object for physics.
  *
@@ -146,8 +187,18 @@ void Planet::initOsg(Eigen::Vector3d position, double ratio, double scaling) {
 void Planet::initPhysics(double mass, Eigen::Vector3d linearVelocity, Eigen::Vector3d angularVelocity, Eigen::Vector3d force, Eigen::Vector3d torque) {
 	SpaceObject::initPhysics(mass, linearVelocity, angularVelocity, force, torque);
 
-	_momentOfInertia = Eigen::Matrix3d();
-	_momentOfInertia.setIdentity();
-	_momentOfInertia *= mass;
-	_momentOfInertia *= 0.4 * getRadius() * getRadius();
+	setMomentOfInertia(Eigen::Matrix3d::Identity() * mass * 0.4 * getRadius() * getRadius());
+}
+
+
+/**
+ * \brief Scale the planet around its center by a factor (its radius grows with it).
+ *
+ * \param factor
+ *      Factor of the scaling (1.0 => unchanged).
+ */
+void Planet::grow(double factor) {
+	SpaceObject::grow(factor);
+
+	_radius *= factor;
 }
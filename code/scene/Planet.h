@@ -34,7 +34,7 @@ namespace pbs17 {
 		 * \param j
 		 *      JSON-configuration for the planet.
 		 */
-        Planet(json j);
+        Planet(const json &j);
 
 
 		/**
@@ -84,6 +84,15 @@ namespace pbs17 {
 		void initPhysics(double mass, Eigen::Vector3d linearVelocity, Eigen::Vector3d angularVelocity, Eigen::Vector3d force, Eigen::Vector3d torque) override;
 
 
+		/**
+		 * \brief Scale the planet around its center by a factor (its radius grows with it).
+		 *
+		 * \param factor
+		 *      Factor of the scaling (1.0 => unchanged).
+		 */
+		void grow(double factor) override;
+
+
 		/**
 		 * \brief Get radius of the planet.
 		 * 
@@ -94,6 +103,13 @@ namespace pbs17 {
 		}
 
 
+		/**
+		 * \brief Initialize the texture-properties and shader (the mip-levels of the textures are streamed by the
+		 *        size of the planet on the screen if enabled, see MipStreamer).
+		 */
+		void initTexturing() override;
+
+
 	private:
 
 		//! Radius of the planet
@@ -0,0 +1,592 @@
+﻿/**
+ * \brief Procedural generators for the scenes which are not loaded from a file.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-19
+ */
+
+#include "SceneGenerator.h"
+
+#include <math.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+#include <osg/Math>
+#include <Eigen/Geometry>
+
+#include "BinaryScene.h"
+
+using namespace pbs17;
+
+
+//! Mass of the objects of the sphere- and cube-emitter
+const double SceneGenerator::DEFAULT_MASS = 500000;
+
+//! Mass of an asteroid of the orbiting scenes
+const double SceneGenerator::OBJECT_MASS = 0.001;
+
+//! Number of bodies above which the orbiting scenes use the particle-mesh solver
+const int SceneGenerator::PARTICLE_MESH_THRESHOLD = 50000;
+
+//! Number of asteroid-models (asteroid1.obj - asteroid30.obj)
+const int SceneGenerator::CNT_ASTEROID_MODELS = 30;
+//! Number of asteroid-textures (Am1.jpg - Am15.jpg)
+const int SceneGenerator::CNT_ASTEROID_TEXTURES = 15;
+//! Number of generated asteroid-models (each has its own convex-hull, the instanced models share one icosphere)
+const int SceneGenerator::CNT_PROCEDURAL_MODELS = 256;
+
+
+namespace {
+
+	/**
+	 * \brief Get the smallest number of samples per axis, so that the aligned samples cover all points.
+	 */
+	int getSamplesPerAxis(int pointCount, int dimension) {
+		int perAxis = std::max(static_cast<int>(pow(static_cast<double>(pointCount), 1.0 / dimension)), 1);
+
+		while (pow(static_cast<double>(perAxis), dimension) < pointCount) {
+			++perAxis;
+		}
+
+		return perAxis;
+	}
+}
+
+
+/**
+ * \brief Constructor of a generator.
+ *
+ * \param seed
+ *      Seed of the random numbers.
+ * \param isProcedural
+ *      True if the asteroids of the orbiting scenes are generated from seeds (see ProceduralAsteroid).
+ * \param cntDust
+ *      Number of massless dust-particles of the orbiting scenes (see DustManager).
+ */
+SceneGenerator::SceneGenerator(unsigned int seed, bool isProcedural, int cntDust)
+	: _seed(seed), _isProcedural(isProcedural), _cntDust(cntDust) {}
+
+
+/**
+ * \brief Generate the scene which is specified by the input parameters (emitter, spheres, asteroids, rings,
+ * rand, gameplay, seed, proceduralAsteroids and dust).
+ *
+ * \param vm
+ *      Input parameters which have been passed by starting the program.
+ * \param scene
+ *      Output-parameter: Generated scene (overwritten).
+ *
+ * \return False if the emitter is not supported.
+ */
+bool SceneGenerator::generate(variables_map vm, BinaryScene &scene) {
+	SceneGenerator generator(vm["seed"].as<unsigned int>(), vm["proceduralAsteroids"].as<bool>(), vm["dust"].as<int>());
+
+	std::string emitter = vm["emitter"].as<std::string>();
+	bool random = vm["rand"].as<bool>();
+	int spheres = vm["spheres"].as<int>();
+	int asteroids = vm["asteroids"].as<int>();
+	int rings = vm["rings"].as<int>();
+
+	if (emitter == "sphere") {
+		generator.sphereEmitter(spheres, asteroids, random, scene);
+	} else if (emitter == "cube") {
+		generator.cubeEmitter(spheres, asteroids, random, scene);
+	} else if (emitter == "galaxy") {
+		generator.galaxy(asteroids, rings, scene);
+	} else if (emitter == "ring") {
+		generator.ring(asteroids, rings, scene);
+	} else if (emitter == "belt") {
+		generator.belt(asteroids, scene);
+	} else {
+		return false;
+	}
+
+	// the seed is kept with the scene (e.g. to fork experiments from a checkpoint)
+	json settings = scene.getSettings();
+	settings["emitter"] = emitter;
+	settings["seed"] = vm["seed"].as<unsigned int>();
+	scene.setSettings(settings);
+
+	if (vm["gameplay"].as<bool>()) {
+		json zero = { { "x", 0.0 }, { "y", 0.0 }, { "z", 0.0 } };
+		settings = scene.getSettings();
+
+		settings["gameplay"] = true;
+		settings["player"] = {
+			{ "type", "spaceship" },
+			{ "obj", "starfighter.obj" },
+			{ "mass", 1.0 },
+			{ "ratio", 1.0 },
+			{ "scaling", 1.0 },
+			{ "position", zero },
+			{ "linearVelocity", { { "x", 1.0 }, { "y", 0.0 }, { "z", 0.0 } } },
+			{ "angularVelocity", zero },
+			{ "force", zero },
+			{ "torque", zero }
+		};
+
+		scene.setSettings(settings);
+	}
+
+	return true;
+}
+
+
+/**
+ * \brief Emmits the number of specified planets and asteroids. The space-objects are aligned in a sphere.
+ *
+ * \param planets
+ *      Number of planets on the scene.
+ * \param asteroids
+ *      Number of asteroids on the scene.
+ * \param random
+ *      Use random positions (true) or align the objects uniformly.
+ * \param scene
+ *      Output-parameter: Generated scene (overwritten).
+ */
+void SceneGenerator::sphereEmitter(int planets, int asteroids, bool random, BinaryScene &scene) const {
+	double radius = 15.0;
+	int n = planets + asteroids;
+
+	scene = BinaryScene();
+	scene.setSettings({ { "name", "Sphere-emitter" }, { "id", "sphere" } });
+	scene.resize(n);
+	int32_t model = scene.addString("A2.obj");
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		bool isPlanet = i < planets;
+		// the random samples depend on the body, the aligned samples on the index of the planet or asteroid
+		unsigned int index = random || isPlanet ? i : i - planets;
+		Eigen::Vector2d sample = getSample(index, isPlanet ? planets : asteroids, random);
+
+		Eigen::Vector2d cylSample = Eigen::Vector2d(2.0 * sample.y() - 1.0, 2.0 * osg::PI * sample.x());
+		double omegaZ = cylSample(0);
+		double r = sqrt(1.0 - omegaZ * omegaZ);
+		double phi = cylSample(1);
+		Eigen::Vector3d position(radius * r * cos(phi), radius * r * sin(phi), radius * omegaZ);
+
+		scene.setBody(i, isPlanet ? BinaryScene::PLANET : BinaryScene::ASTEROID, isPlanet ? -1 : model, -1, -1,
+			isPlanet ? 2.0 : 1.0, DEFAULT_MASS, position, Eigen::Vector3d::Zero(), Eigen::Vector3d(0.0, 0.0, 1.0));
+	}
+}
+
+
+/**
+ * \brief Emmits the number of specified planets and asteroids. The space-objects are aligned in a cube.
+ *
+ * \param planets
+ *      Number of planets on the scene.
+ * \param asteroids
+ *      Number of asteroids on the scene.
+ * \param random
+ *      Use random positions (true) or align the objects uniformly.
+ * \param scene
+ *      Output-parameter: Generated scene (overwritten).
+ */
+void SceneGenerator::cubeEmitter(int planets, int asteroids, bool random, BinaryScene &scene) const {
+	double sideLength = 15.0;
+	int n = planets + asteroids;
+
+	scene = BinaryScene();
+	scene.setSettings({ { "name", "Cube-emitter" }, { "id", "cube" } });
+	scene.resize(n);
+	int32_t model = scene.addString("A2.obj");
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int i = 0; i < n; ++i) {
+		bool isPlanet = i < planets;
+		unsigned int index = random || isPlanet ? i : i - planets;
+		Eigen::Vector3d sample = getSample3(index, isPlanet ? planets : asteroids, random);
+
+		scene.setBody(i, isPlanet ? BinaryScene::PLANET : BinaryScene::ASTEROID, isPlanet ? -1 : model, -1, -1,
+			isPlanet ? 2.0 : 1.0, DEFAULT_MASS, sample * sideLength, Eigen::Vector3d::Zero(), Eigen::Vector3d(0.0, 0.0, 1.0));
+	}
+}
+
+
+/**
+ * \brief Generate a tilted galaxy-disc: Rings with the same number of asteroids orbit a small and heavy sun.
+ * (Replaces demoScenes/galaxy/main_galaxy.py)
+ *
+ * \param asteroids
+ *      Number of asteroids on the scene.
+ * \param rings
+ *      Number of rings of the disc.
+ * \param scene
+ *      Output-parameter: Generated scene (overwritten).
+ */
+void SceneGenerator::galaxy(int asteroids, int rings, BinaryScene &scene) const {
+	const double attractorMass = 100.0;
+	const double firstRing = 2.0;
+	const double interringDistance = 0.5;
+	const double ringAngleOffset = 5.0;
+
+	int32_t firstModel = initOrbitingScene("Galaxy", asteroids + 1, attractorMass, 0.000001, "earth_normalmap_1024x512.jpg", scene);
+
+	int objectsPerRing = std::max((asteroids + std::max(rings, 1) - 1) / std::max(rings, 1), 1);
+	double angleOffset = 2.0 * osg::PI / objectsPerRing;
+	Eigen::Matrix3d rotation = Eigen::AngleAxisd(1.2, Eigen::Vector3d::UnitX()).toRotationMatrix();
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int a = 0; a < asteroids; ++a) {
+		unsigned int i = a + 1;
+		int ringIdx = a / objectsPerRing;
+		int objectIdx = a % objectsPerRing;
+
+		double objectAngle = ringIdx * ringAngleOffset + objectIdx * angleOffset;
+		double objectRadius = firstRing + ringIdx * interringDistance;
+		Eigen::Vector3d position(objectRadius * cos(objectAngle), objectRadius * sin(objectAngle), 0.0);
+		Eigen::Vector3d velocity = getOrbitalVelocity(attractorMass + ringIdx * objectsPerRing * OBJECT_MASS, position);
+
+		double scaling = 0.0001 * getRandomInt(i, 5, 1, 20 + ringIdx);
+		setAsteroid(i, scaling, rotation * position, rotation * velocity, firstModel, scene);
+	}
+
+	int cntRings = (asteroids + objectsPerRing - 1) / objectsPerRing;
+	setDust(rotation * Eigen::Vector3d::UnitZ(), firstRing - 0.5 * interringDistance,
+		firstRing + (std::max(cntRings, 1) - 0.5) * interringDistance, 0.05, scene);
+}
+
+
+/**
+ * \brief Generate tilted rings around a sun, where the asteroids have the same distance on all rings.
+ * (Replaces demoScenes/galaxy/main_ring.py)
+ *
+ * \param asteroids
+ *      Number of asteroids on the scene.
+ * \param rings
+ *      Number of rings.
+ * \param scene
+ *      Output-parameter: Generated scene (overwritten).
+ */
+void SceneGenerator::ring(int asteroids, int rings, BinaryScene &scene) const {
+	const double attractorMass = 50.0;
+	const double firstRing = 2.0;
+	const double interringDistance = 0.5;
+	const double ringAngleOffset = 5.0;
+
+	int32_t firstModel = initOrbitingScene("Ring", asteroids + 1, attractorMass, 1.0, "sunmap_normal.jpg", scene);
+	rings = std::max(rings, 1);
+
+	// the number of asteroids of a ring is proportional to its circumference (the remainder goes to the outer rings)
+	double sumRadii = rings * firstRing + 0.5 * rings * (rings - 1) * interringDistance;
+	std::vector<int> ringStart(rings + 1, 0);
+
+	for (int r = 0; r < rings; ++r) {
+		ringStart[r + 1] = static_cast<int>(asteroids * (firstRing + r * interringDistance) / sumRadii);
+	}
+
+	int remainder = asteroids;
+	for (int r = 1; r <= rings; ++r) {
+		remainder -= ringStart[r];
+	}
+
+	for (int r = rings; r > 0 && remainder > 0; --r, --remainder) {
+		++ringStart[r];
+	}
+
+	for (int r = 0; r < rings; ++r) {
+		ringStart[r + 1] += ringStart[r];
+	}
+
+	Eigen::Matrix3d rotation = Eigen::AngleAxisd(1.2, Eigen::Vector3d::UnitX()).toRotationMatrix();
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int a = 0; a < asteroids; ++a) {
+		unsigned int i = a + 1;
+		int ringIdx = std::upper_bound(ringStart.begin(), ringStart.end(), a) - ringStart.begin() - 1;
+		int objectIdx = a - ringStart[ringIdx];
+		int objectsPerRing = ringStart[ringIdx + 1] - ringStart[ringIdx];
+
+		double objectAngle = ringIdx * ringAngleOffset + objectIdx * 2.0 * osg::PI / objectsPerRing;
+		double objectRadius = firstRing + ringIdx * interringDistance;
+		Eigen::Vector3d position(objectRadius * cos(objectAngle), objectRadius * sin(objectAngle), 0.0);
+		Eigen::Vector3d velocity = getOrbitalVelocity(attractorMass + ringStart[ringIdx] * OBJECT_MASS, position);
+
+		double scaling = 0.00015 * getRandomInt(i, 5, 1, 20);
+		setAsteroid(i, scaling, rotation * position, rotation * velocity, firstModel, scene);
+	}
+
+	setDust(rotation * Eigen::Vector3d::UnitZ(), firstRing - 0.5 * interringDistance,
+		firstRing + (rings - 0.5) * interringDistance, 0.05, scene);
+}
+
+
+/**
+ * \brief Generate a Keplerian asteroid-belt: The asteroids are spread uniformly over an annulus with a small
+ * thickness and move on nearly circular orbits around a sun.
+ *
+ * \param asteroids
+ *      Number of asteroids on the scene.
+ * \param scene
+ *      Output-parameter: Generated scene (overwritten).
+ */
+void SceneGenerator::belt(int asteroids, BinaryScene &scene) const {
+	const double attractorMass = 100.0;
+	const double innerRadius = 4.0;
+	const double outerRadius = 8.0;
+	const double thickness = 0.2;
+	const double velocityDispersion = 0.02;
+
+	int32_t firstModel = initOrbitingScene("Belt", asteroids + 1, attractorMass, 1.0, "sunmap_normal.jpg", scene);
+
+	double innerSquared = innerRadius * innerRadius;
+	double areaSquared = outerRadius * outerRadius - innerSquared;
+
+#if defined(_OPENMP)
+#pragma omp parallel for
+#endif
+	for (int a = 0; a < asteroids; ++a) {
+		unsigned int i = a + 1;
+
+		// uniform over the area of the annulus
+		double radiusSquared = innerSquared + getRandom(i, 6) * areaSquared;
+		double radius = sqrt(radiusSquared);
+		double phi = 2.0 * osg::PI * getRandom(i, 7);
+		Eigen::Vector3d position(radius * cos(phi), radius * sin(phi), thickness * (getRandom(i, 8) - 0.5));
+
+		// the mass of the belt inside the orbit also attracts the asteroid
+		double centerMass = attractorMass + asteroids * OBJECT_MASS * (radiusSquared - innerSquared) / areaSquared;
+		Eigen::Vector3d velocity = getOrbitalVelocity(centerMass, position);
+		velocity *= 1.0 + velocityDispersion * (2.0 * getRandom(i, 9) - 1.0);
+
+		double scaling = 0.00015 * getRandomInt(i, 5, 1, 20);
+		setAsteroid(i, scaling, position, velocity, firstModel, scene);
+	}
+
+	setDust(Eigen::Vector3d::UnitZ(), innerRadius, outerRadius, thickness, scene);
+}
+
+
+/**
+ * \brief Get a random number of a body.
+ *
+ * \param body
+ *      Index of the body.
+ * \param k
+ *      Index of the random number of the body.
+ *
+ * \return Uniform random number in [0, 1).
+ */
+double SceneGenerator::getRandom(unsigned int body, unsigned int k) const {
+	// SplitMix64 of the seed, the body and the index of the number
+	uint64_t z = _seed + 0x9E3779B97F4A7C15ull * ((static_cast<uint64_t>(body) << 8) + k + 1);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	z ^= z >> 31;
+
+	return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+/**
+ * \brief Get a random integer of a body.
+ *
+ * \param body
+ *      Index of the body.
+ * \param k
+ *      Index of the random number of the body.
+ * \param min, max
+ *      Range of the integer (both included).
+ *
+ * \return Uniform random integer in [min, max].
+ */
+int SceneGenerator::getRandomInt(unsigned int body, unsigned int k, int min, int max) const {
+	return min + static_cast<int>(getRandom(body, k) * (max - min + 1));
+}
+
+
+/**
+ * \brief Get a sample in the unit-square (random or aligned uniformly).
+ *
+ * \param i
+ *      Index of the sample.
+ * \param pointCount
+ *      Number of samples.
+ * \param random
+ *      Use a random generator (true) or align the samples uniformly.
+ *
+ * \return 2d-sample.
+ */
+Eigen::Vector2d SceneGenerator::getSample(unsigned int i, int pointCount, bool random) const {
+	if (random) {
+		return Eigen::Vector2d(getRandom(i, 0), getRandom(i, 1));
+	}
+
+	int perAxis = getSamplesPerAxis(pointCount, 2);
+	double invPerAxis = 1.0 / perAxis;
+	int y = i / perAxis, x = i % perAxis;
+
+	return Eigen::Vector2d((x + 0.5) * invPerAxis, (y + 0.5) * invPerAxis);
+}
+
+
+/**
+ * \brief Get a sample in the unit-cube (random or aligned uniformly).
+ *
+ * \param i
+ *      Index of the sample.
+ * \param pointCount
+ *      Number of samples.
+ * \param random
+ *      Use a random generator (true) or align the samples uniformly.
+ *
+ * \return 3d-sample.
+ */
+Eigen::Vector3d SceneGenerator::getSample3(unsigned int i, int pointCount, bool random) const {
+	if (random) {
+		return Eigen::Vector3d(getRandom(i, 0), getRandom(i, 1), getRandom(i, 2));
+	}
+
+	int perAxis = getSamplesPerAxis(pointCount, 3);
+	double invPerAxis = 1.0 / perAxis;
+	int z = i % perAxis, y = (i / perAxis) % perAxis, x = i / (perAxis * perAxis);
+
+	return Eigen::Vector3d((x + 0.5) * invPerAxis, (y + 0.5) * invPerAxis, (z + 0.5) * invPerAxis);
+}
+
+
+/**
+ * \brief Set a random asteroid of the orbiting scenes (one of the asteroid-models with one of the textures).
+ *
+ * \param i
+ *      Index of the body.
+ * \param scaling
+ *      Scaling of the model.
+ * \param position
+ *      Initial position.
+ * \param linearVelocity
+ *      Initial linear velocity.
+ * \param firstModel
+ *      Index of the first asteroid-model in the strings (the textures follow the models).
+ * \param scene
+ *      Output-parameter: Scene whose body is set.
+ */
+void SceneGenerator::setAsteroid(unsigned int i, double scaling, const Eigen::Vector3d &position, const Eigen::Vector3d &linearVelocity,
+	int32_t firstModel, BinaryScene &scene) const {
+	int32_t model = firstModel + getRandomInt(i, 0, 0, getNumModels() - 1);
+	int32_t texture = firstModel + getNumModels() + getRandomInt(i, 1, 0, CNT_ASTEROID_TEXTURES - 1);
+	Eigen::Vector3d angularVelocity(getRandom(i, 2), getRandom(i, 3), getRandom(i, 4));
+
+	scene.setBody(i, BinaryScene::ASTEROID, model, texture, -1, scaling, OBJECT_MASS, position, linearVelocity, angularVelocity);
+}
+
+
+/**
+ * \brief Prepare a scene with a sun in the center which is orbited by asteroids.
+ *
+ * \param name
+ *      Name of the scene.
+ * \param cntBodies
+ *      Number of bodies (including the sun).
+ * \param mass
+ *      Mass of the sun.
+ * \param size
+ *      Size of the sun.
+ * \param bumpmap
+ *      Bumpmap of the sun.
+ * \param scene
+ *      Output-parameter: Scene with the sun as the first body.
+ *
+ * \return Index of the first asteroid-model in the strings (the textures follow the models).
+ */
+int32_t SceneGenerator::initOrbitingScene(std::string name, unsigned int cntBodies, double mass, double size, std::string bumpmap,
+	BinaryScene &scene) const {
+	json settings = { { "name", name }, { "id", name } };
+
+	// tree codes get expensive for very large discs, the particle-mesh solver scales near-linearly
+	if (cntBodies > static_cast<unsigned int>(PARTICLE_MESH_THRESHOLD)) {
+		settings["simulation"] = { { "gravitySolver", "particleMesh" }, { "meshResolution", 128 }, { "p3m", true } };
+	} else {
+		settings["simulation"] = { { "gravitySolver", "barnesHut" }, { "theta", 0.5 } };
+	}
+
+	scene = BinaryScene();
+	scene.setSettings(settings);
+	scene.resize(cntBodies);
+
+	int32_t texture = scene.addString("sunmap.jpg");
+	int32_t bumpmapIndex = scene.addString(bumpmap);
+	scene.setBody(0, BinaryScene::SUN, -1, texture, bumpmapIndex, size, mass, Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero(), Eigen::Vector3d::Zero());
+
+	int32_t firstModel = scene.getNumStrings();
+
+	for (int m = 1; m <= getNumModels(); ++m) {
+		std::ostringstream model;
+		if (_isProcedural) {
+			// the seeds of the shapes depend on the seed of the scene
+			model << "procedural:" << ((_seed * CNT_PROCEDURAL_MODELS + m) & 0xffffff);
+		} else {
+			model << "asteroid" << m << ".obj";
+		}
+		scene.addString(model.str());
+	}
+
+	for (int t = 1; t <= CNT_ASTEROID_TEXTURES; ++t) {
+		std::ostringstream texture;
+		texture << "Am" << t << ".jpg";
+		scene.addString(texture.str());
+	}
+
+	return firstModel;
+}
+
+
+/**
+ * \brief Get the velocity of a circular orbit around the z-axis.
+ *
+ * \param centerMass
+ *      Mass inside the orbit.
+ * \param position
+ *      Position in the xy-plane.
+ *
+ * \return Velocity in the xy-plane.
+ */
+Eigen::Vector3d SceneGenerator::getOrbitalVelocity(double centerMass, const Eigen::Vector3d &position) {
+	double radius = sqrt(position.x() * position.x() + position.y() * position.y());
+	double speed = sqrt(centerMass / radius);
+
+	return Eigen::Vector3d(-position.y() / radius * speed, position.x() / radius * speed, 0.0);
+}
+
+
+/**
+ * \brief Add the settings of the dust to the simulation of an orbiting scene (nothing if there's no dust).
+ *
+ * \param normal
+ *      Normal of the plane of the annulus.
+ * \param innerRadius, outerRadius
+ *      Radii of the annulus.
+ * \param thickness
+ *      Thickness of the annulus.
+ * \param scene
+ *      Output-parameter: Scene whose settings are extended.
+ */
+void SceneGenerator::setDust(const Eigen::Vector3d &normal, double innerRadius, double outerRadius, double thickness,
+	BinaryScene &scene) const {
+	if (_cntDust <= 0) {
+		return;
+	}
+
+	// the dust is generated by the simulation (see DustManager), the scene only stores its parameters
+	json settings = scene.getSettings();
+	settings["simulation"]["dust"] = {
+		{ "count", _cntDust },
+		{ "innerRadius", innerRadius },
+		{ "outerRadius", outerRadius },
+		{ "thickness", thickness },
+		{ "normal", { { "x", normal.x() }, { "y", normal.y() }, { "z", normal.z() } } },
+		{ "seed", _seed }
+	};
+	scene.setSettings(settings);
+}
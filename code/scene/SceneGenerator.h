@@ -0,0 +1,297 @@
+﻿/**
+ * \brief Procedural generators for the scenes which are not loaded from a file.
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2017-12-19
+ */
+
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+#include <Eigen/Core>
+#include <boost/program_options.hpp>
+
+using namespace boost::program_options;
+
+
+// Forward declarations
+namespace pbs17 {
+	class BinaryScene;
+}
+
+namespace pbs17 {
+
+	/**
+	 * \brief SceneGenerator creates the bodies of a scene directly in a binary scene (no json is involved).
+	 * The bodies are generated concurrently. Each random number is derived from the seed, the index of the body and
+	 * the index of the number, so a scene only depends on its parameters and not on the number of threads.
+	 */
+	class SceneGenerator {
+	public:
+
+		/**
+		 * \brief Constructor of a generator.
+		 *
+		 * \param seed
+		 *      Seed of the random numbers.
+		 * \param isProcedural
+		 *      True if the asteroids of the orbiting scenes are generated from seeds (see ProceduralAsteroid).
+		 * \param cntDust
+		 *      Number of massless dust-particles of the orbiting scenes (see DustManager).
+		 */
+		explicit SceneGenerator(unsigned int seed, bool isProcedural = false, int cntDust = 0);
+
+
+		/**
+		 * \brief Generate the scene which is specified by the input parameters (emitter, spheres, asteroids, rings,
+		 * rand, gameplay, seed, proceduralAsteroids and dust).
+		 *
+		 * \param vm
+		 *      Input parameters which have been passed by starting the program.
+		 * \param scene
+		 *      Output-parameter: Generated scene (overwritten).
+		 *
+		 * \return False if the emitter is not supported.
+		 */
+		static bool generate(variables_map vm, BinaryScene &scene);
+
+
+		/**
+		 * \brief Emmits the number of specified planets and asteroids. The space-objects are aligned in a sphere.
+		 *
+		 * \param planets
+		 *      Number of planets on the scene.
+		 * \param asteroids
+		 *      Number of asteroids on the scene.
+		 * \param random
+		 *      Use random positions (true) or align the objects uniformly.
+		 * \param scene
+		 *      Output-parameter: Generated scene (overwritten).
+		 */
+		void sphereEmitter(int planets, int asteroids, bool random, BinaryScene &scene) const;
+
+
+		/**
+		 * \brief Emmits the number of specified planets and asteroids. The space-objects are aligned in a cube.
+		 *
+		 * \param planets
+		 *      Number of planets on the scene.
+		 * \param asteroids
+		 *      Number of asteroids on the scene.
+		 * \param random
+		 *      Use random positions (true) or align the objects uniformly.
+		 * \param scene
+		 *      Output-parameter: Generated scene (overwritten).
+		 */
+		void cubeEmitter(int planets, int asteroids, bool random, BinaryScene &scene) const;
+
+
+		/**
+		 * \brief Generate a tilted galaxy-disc: Rings with the same number of asteroids orbit a small and heavy sun.
+		 * (Replaces demoScenes/galaxy/main_galaxy.py)
+		 *
+		 * \param asteroids
+		 *      Number of asteroids on the scene.
+		 * \param rings
+		 *      Number of rings of the disc.
+		 * \param scene
+		 *      Output-parameter: Generated scene (overwritten).
+		 */
+		void galaxy(int asteroids, int rings, BinaryScene &scene) const;
+
+
+		/**
+		 * \brief Generate tilted rings around a sun, where the asteroids have the same distance on all rings.
+		 * (Replaces demoScenes/galaxy/main_ring.py)
+		 *
+		 * \param asteroids
+		 *      Number of asteroids on the scene.
+		 * \param rings
+		 *      Number of rings.
+		 * \param scene
+		 *      Output-parameter: Generated scene (overwritten).
+		 */
+		void ring(int asteroids, int rings, BinaryScene &scene) const;
+
+
+		/**
+		 * \brief Generate a Keplerian asteroid-belt: The asteroids are spread uniformly over an annulus with a small
+		 * thickness and move on nearly circular orbits around a sun.
+		 *
+		 * \param asteroids
+		 *      Number of asteroids on the scene.
+		 * \param scene
+		 *      Output-parameter: Generated scene (overwritten).
+		 */
+		void belt(int asteroids, BinaryScene &scene) const;
+
+
+	private:
+
+		//! Seed of the random numbers
+		uint64_t _seed;
+
+		//! True if the asteroids of the orbiting scenes are generated from seeds
+		bool _isProcedural;
+
+		//! Number of dust-particles of the orbiting scenes
+		int _cntDust;
+
+		//! Mass of the objects of the sphere- and cube-emitter
+		static const double DEFAULT_MASS;
+
+		//! Mass of an asteroid of the orbiting scenes
+		static const double OBJECT_MASS;
+
+		//! Number of bodies above which the orbiting scenes use the particle-mesh solver
+		static const int PARTICLE_MESH_THRESHOLD;
+
+		//! Number of asteroid-models (asteroid1.obj - asteroid30.obj)
+		static const int CNT_ASTEROID_MODELS;
+		//! Number of asteroid-textures (Am1.jpg - Am15.jpg)
+		static const int CNT_ASTEROID_TEXTURES;
+		//! Number of generated asteroid-models (procedural:<seed>)
+		static const int CNT_PROCEDURAL_MODELS;
+
+
+		/**
+		 * \brief Get the number of asteroid-models of the orbiting scenes.
+		 *
+		 * \return Number of generated or OBJ-models.
+		 */
+		int getNumModels() const {
+			return _isProcedural ? CNT_PROCEDURAL_MODELS : CNT_ASTEROID_MODELS;
+		}
+
+
+		/**
+		 * \brief Get a random number of a body.
+		 *
+		 * \param body
+		 *      Index of the body.
+		 * \param k
+		 *      Index of the random number of the body.
+		 *
+		 * \return Uniform random number in [0, 1).
+		 */
+		double getRandom(unsigned int body, unsigned int k) const;
+
+
+		/**
+		 * \brief Get a random integer of a body.
+		 *
+		 * \param body
+		 *      Index of the body.
+		 * \param k
+		 *      Index of the random number of the body.
+		 * \param min, max
+		 *      Range of the integer (both included).
+		 *
+		 * \return Uniform random integer in [min, max].
+		 */
+		int getRandomInt(unsigned int body, unsigned int k, int min, int max) const;
+
+
+		/**
+		 * \brief Get a sample in the unit-square (random or aligned uniformly).
+		 *
+		 * \param i
+		 *      Index of the sample (index of the body for random samples).
+		 * \param pointCount
+		 *      Number of samples.
+		 * \param random
+		 *      Use a random generator (true) or align the samples uniformly.
+		 *
+		 * \return 2d-sample.
+		 */
+		Eigen::Vector2d getSample(unsigned int i, int pointCount, bool random) const;
+
+
+		/**
+		 * \brief Get a sample in the unit-cube (random or aligned uniformly).
+		 *
+		 * \param i
+		 *      Index of the sample (index of the body for random samples).
+		 * \param pointCount
+		 *      Number of samples.
+		 * \param random
+		 *      Use a random generator (true) or align the samples uniformly.
+		 *
+		 * \return 3d-sample.
+		 */
+		Eigen::Vector3d getSample3(unsigned int i, int pointCount, bool random) const;
+
+
+		/**
+		 * \brief Set a random asteroid of the orbiting scenes (one of the asteroid-models with one of the textures).
+		 *
+		 * \param i
+		 *      Index of the body.
+		 * \param scaling
+		 *      Scaling of the model.
+		 * \param position
+		 *      Initial position.
+		 * \param linearVelocity
+		 *      Initial linear velocity.
+		 * \param firstModel
+		 *      Index of the first asteroid-model in the strings (the textures follow the models).
+		 * \param scene
+		 *      Output-parameter: Scene whose body is set.
+		 */
+		void setAsteroid(unsigned int i, double scaling, const Eigen::Vector3d &position, const Eigen::Vector3d &linearVelocity,
+			int32_t firstModel, BinaryScene &scene) const;
+
+
+		/**
+		 * \brief Prepare a scene with a sun in the center which is orbited by asteroids.
+		 *
+		 * \param name
+		 *      Name of the scene.
+		 * \param cntBodies
+		 *      Number of bodies (including the sun).
+		 * \param mass
+		 *      Mass of the sun.
+		 * \param size
+		 *      Size of the sun.
+		 * \param bumpmap
+		 *      Bumpmap of the sun.
+		 * \param scene
+		 *      Output-parameter: Scene with the sun as the first body.
+		 *
+		 * \return Index of the first asteroid-model in the strings (the textures follow the models).
+		 */
+		int32_t initOrbitingScene(std::string name, unsigned int cntBodies, double mass, double size, std::string bumpmap,
+			BinaryScene &scene) const;
+
+
+		/**
+		 * \brief Get the velocity of a circular orbit around the z-axis.
+		 *
+		 * \param centerMass
+		 *      Mass inside the orbit.
+		 * \param position
+		 *      Position in the xy-plane.
+		 *
+		 * \return Velocity in the xy-plane.
+		 */
+		static Eigen::Vector3d getOrbitalVelocity(double centerMass, const Eigen::Vector3d &position);
+
+
+		/**
+		 * \brief Add the settings of the dust to the simulation of an orbiting scene (nothing if there's no dust).
+		 *
+		 * \param normal
+		 *      Normal of the plane of the annulus.
+		 * \param innerRadius, outerRadius
+		 *      Radii of the annulus.
+		 * \param thickness
+		 *      Thickness of the annulus.
+		 * \param scene
+		 *      Output-parameter: Scene whose settings are extended.
+		 */
+		void setDust(const Eigen::Vector3d &normal, double innerRadius, double outerRadius, double thickness,
+			BinaryScene &scene) const;
+	};
+}
@@ -15,17 +15,41 @@
 #include <osgGA/NodeTrackerManipulator>
 #include <osgGA/KeySwitchMatrixManipulator>
 #include <osgViewer/Viewer>
-#include <osgUtil/Optimizer>
+#include <osgDB/DatabasePager>
 
 #include "Asteroid.h"
+#include "BinaryScene.h"
+#include "SceneGenerator.h"
 #include "Planet.h"
 #include "Sun.h"
 #include "../osg/SkyBox.h"
+#include "../osg/ModelManager.h"
+#include "../osg/ImageManager.h"
+#include "../osg/InstanceManager.h"
+#include "../osg/TrailSystem.h"
+#include "../osg/particles/GpuParticleSystem.h"
+#include "../osg/SpatialCells.h"
+#include "../osg/OsgEigenConversions.h"
+#include "../osg/TextureStreamer.h"
+#include "../osg/MipStreamer.h"
+#include "../osg/MaterialCache.h"
+#include "../osg/ProgramBinaryCache.h"
+#include "../osg/DynamicResolution.h"
+#include "../osg/StereoRenderer.h"
+#include "../osg/DensitySplat.h"
+#include "../osg/OffscreenContext.h"
+#include "../osg/DebugOverlay.h"
+#include "../osg/StatsOverlay.h"
 #include "../config.h"
 #include "SpaceShip.h"
 
 #include "../osg/events/SimulationKeyboardHandler.h"
 #include "../osg/events/GameKeyboardHandler.h"
+#include "../physics/Logger.h"
+#include "../physics/ThreadBudget.h"
+#include "../osg/LoadProfiler.h"
+#include "../osg/visitors/NodeMemoryVisitor.h"
+#include "../physics/MemoryTracker.h"
 
 using namespace pbs17;
 
@@ -123,72 +147,205 @@ osg::ref_ptr<osg::Node> SceneManager::loadScene() {
 
 
 /**
- * \brief Load the scene based on the input parameters.
+ * \brief Load the scene based on the input parameters. The bodies are generated by the emitter (see SceneGenerator).
  *
  * \param vm
  *      Input parameters which have been passed by starting the program.
  */
 osg::ref_ptr<osg::Node> SceneManager::loadScene(variables_map vm) {
-	_scene = new osg::Group();
+	// the bodies are generated directly into the columns of a binary scene
+	BinaryScene scene;
+	bool isGenerated;
+	{
+		LoadProfiler::ScopedTimer timer(LoadProfiler::SCENE_FILE);
+		isGenerated = SceneGenerator::generate(vm, scene);
+	}
+	if (!isGenerated) {
+		LOG_WARNING("Emitter (" + vm["emitter"].as<std::string>() + ") not supported!");
+	}
 
-	// add the skybox
-	addSkybox();
+	return loadScene(scene);
+}
 
-	// check values and with emitter
-	bool useSphereEmitter = vm["emitter"].as<std::string>() == "sphere";
-	bool random = vm["rand"].as<bool>();
-	int spheres = vm["spheres"].as<int>();
-	int asteroids = vm["asteroids"].as<int>();
-    bool gameplay = vm["gameplay"].as<bool>();
-    
-	if (gameplay) {
-        std::cout << "YEAH, gaming!" << std::endl;
-        _isGame = true;
-
-        _player = new SpaceShip();
-        _spaceObjects.push_back(_player);
-        _scene->addChild(_player->getModel());
-
-        _keyboardHandler = new GameKeyboardHandler(_spaceObjects, _player);
-    } else {
-        _keyboardHandler = new SimulationKeyboardHandler(_spaceObjects);
-    }
-
-	if (useSphereEmitter) {
-		sphereEmitter(spheres, asteroids, random);
-	} else {
-		cubeEmitter(spheres, asteroids, random);
+
+/**
+ * \brief Load the scene based on the specified json-file.
+ *
+ * \param j
+ *      Loaded json-file.
+ *
+ */
+osg::ref_ptr<osg::Node> SceneManager::loadScene(json j) {
+	json &objects = j["objects"];
+
+	SceneAssets assets;
+	if (isGame(j)) {
+		assets.add(j["player"], SceneAssets::PLAYER);
+	}
+	for (unsigned int i = 0; i < objects.size(); ++i) {
+		assets.add(objects[i], SceneAssets::OBJECT);
 	}
 
-	_keyboardHandler = new SimulationKeyboardHandler(_spaceObjects);
+	osg::ref_ptr<osg::Group> planets = initScene(j, objects.size(), assets);
 
+	for (unsigned int i = 0; i < objects.size(); ++i) {
+		addSpaceObject(objects[i], planets);
+	}
 
-	return _scene;
+	return finishScene();
+}
+
+
+/**
+ * \brief Load the scene from a stream of a json-file without keeping the whole json-document in the memory.
+ * The stream is parsed twice: The first pass keeps everything but the objects (which are only scanned for their
+ * models and textures), the second pass constructs each object as soon as it is read and drops it again.
+ *
+ * \param stream
+ *      Stream of the json-file (has to be seekable).
+ * \param binaryScene
+ *      Output-parameter: The objects are also collected into this binary scene (nullptr => not collected).
+ */
+osg::ref_ptr<osg::Node> SceneManager::loadScene(std::istream &stream, BinaryScene* binaryScene) {
+	std::streampos start = stream.tellg();
+
+	SceneAssets assets;
+	unsigned int cntObjects = 0;
+
+	json j = parseScene(stream, [&](json &object) {
+		assets.add(object, SceneAssets::OBJECT);
+		++cntObjects;
+	});
+
+	if (isGame(j)) {
+		assets.add(j["player"], SceneAssets::PLAYER);
+	}
+
+	osg::ref_ptr<osg::Group> planets = initScene(j, cntObjects, assets);
+
+	// e.g. the base of the checkpoints
+	if (binaryScene) {
+		*binaryScene = BinaryScene();
+		binaryScene->setSettings(j);
+	}
+
+	stream.clear();
+	stream.seekg(start);
+	parseScene(stream, [&](json &object) {
+		if (binaryScene) {
+			binaryScene->addBody(object);
+		}
+		addSpaceObject(object, planets);
+	});
+
+	return finishScene();
 }
 
 
+/**
+ * \brief Load the scene from a binary scene-file. The objects are constructed with the same configurations as the
+ * objects of the json-scenes.
+ *
+ * \param scene
+ *      Loaded binary scene.
+ */
+osg::ref_ptr<osg::Node> SceneManager::loadScene(const BinaryScene &scene) {
+	json j = scene.getSettings();
+	unsigned int cntObjects = scene.getNumBodies();
+
+	SceneAssets assets;
+	if (isGame(j)) {
+		assets.add(j["player"], SceneAssets::PLAYER);
+	}
+	for (unsigned int i = 0; i < cntObjects; ++i) {
+		json d = scene.getBody(i);
+		assets.add(d, SceneAssets::OBJECT);
+	}
+
+	osg::ref_ptr<osg::Group> planets = initScene(j, cntObjects, assets);
+
+	for (unsigned int i = 0; i < cntObjects; ++i) {
+		json d = scene.getBody(i);
+		addSpaceObject(d, planets);
+	}
+
+	return finishScene();
+}
+
 
 /**
- * \brief Load the scene based on the specified json-file.
+ * \brief Parse a json-scene and pass each element of the "objects"-array to the handler as soon as it is read.
+ * The elements are dropped afterwards, so they are not part of the returned document.
+ *
+ * \param stream
+ *      Stream of the json-file.
+ * \param handleObject
+ *      Handler which is called for each object (in the order of the file).
+ *
+ * \return Scene without the objects (empty "objects"-array).
+ */
+json SceneManager::parseScene(std::istream &stream, const std::function<void(json&)> &handleObject) {
+	// the construction of the objects is measured by its own timers
+	LoadProfiler::ScopedTimer timer(LoadProfiler::SCENE_FILE);
+
+	// key of the top-level member which is currently parsed
+	std::string member;
+
+	return json::parse(stream, [&](int depth, json::parse_event_t event, json &parsed) -> bool {
+		if (depth == 1 && event == json::parse_event_t::key) {
+			member = parsed.get<std::string>();
+		} else if (depth == 2 && event == json::parse_event_t::object_end && member == "objects") {
+			handleObject(parsed);
+			return false;
+		}
+
+		return true;
+	});
+}
+
+
+/**
+ * \brief Check if the json-scene is a game.
  *
  * \param j
- *      Loaded json-file.
+ *      Loaded json-file (the objects are not needed).
  *
+ * \return True if the scene is played with the space-ship of the player.
  */
-osg::ref_ptr<osg::Node> SceneManager::loadScene(json j) {
+bool SceneManager::isGame(json &j) {
+	return j["gameplay"].is_boolean() && j["gameplay"].get<bool>() == true;
+}
+
+
+/**
+ * \brief Create the root of a json-scene with the skybox, the settings and the player and prepare the assets.
+ *
+ * \param j
+ *      Loaded json-file (the objects are not needed).
+ * \param cntObjects
+ *      Number of objects in the scene.
+ * \param assets
+ *      Models and textures of the player and the objects.
+ *
+ * \return Group to which the space-objects are added.
+ */
+osg::ref_ptr<osg::Group> SceneManager::initScene(json &j, unsigned int cntObjects, const SceneAssets &assets) {
 	_scene = new osg::Group();
 	osg::ref_ptr<osg::Group> planets = new osg::Group;
 	_scene->addChild(planets);
 	// add the skybox
 	addSkybox();
 
-	std::cout << "Loading scene " + j["name"].get<std::string>() << " ";
+	LOG_INFO("Loading scene " + j["name"].get<std::string>() << " with " << cntObjects << " objects.");
 
-	std::vector<json> objects = j["objects"].get<std::vector<json>>();
-	std::cout << "with " << objects.size() << " objects." << std::endl;
+	if (j["simulation"].is_object()) {
+		_simulationSettings = j["simulation"];
+	}
+
+	prepareAssets(assets);
 
-	if (j["gameplay"].is_boolean() && j["gameplay"].get<bool>() == true) {
-		std::cout << "YEAH, gaming!" << std::endl;
+	if (isGame(j)) {
+		LOG_INFO("YEAH, gaming!");
 		_isGame = true;
 
 		_player = new SpaceShip(j["player"]);
@@ -200,199 +357,225 @@ osg::ref_ptr<osg::Node> SceneManager::loadScene(json j) {
 		_keyboardHandler = new SimulationKeyboardHandler(_spaceObjects);
 	}
 
-	for (json d : objects) {
-		SpaceObject* so;
-
-		std::cout << d["id"] << std::endl;
-
-		if (d["type"].get<std::string>() == "planet") {
-			so = new Planet(d);
-		} else if (d["type"].get<std::string>() == "asteroid") {
-			so = new Asteroid(d);
-        } else if (d["type"].get<std::string>() == "sun") {
-            Sun* sun = new Sun(d);
-			sun->initTexturing();
-			sun->addLight(osg::Vec4(1.0, 1.0, 1.0, 1.0));
-			so = sun;
-        } else {
-			std::cout << "Type (" + d["type"].get<std::string>() + ") not supported!" << std::endl;
-		}
+	return planets;
+}
 
-		_spaceObjects.push_back(so);
-		planets->addChild(so->getModel());
-	}
 
-	osgUtil::Optimizer optOSGFile;
-	optOSGFile.optimize(_scene.get());
+/**
+ * \brief Construct a space-object of a json-scene and add it to the scene.
+ *
+ * \param d
+ *      JSON-configuration of the object.
+ * \param planets
+ *      Group to which the model of the object is added.
+ */
+void SceneManager::addSpaceObject(json &d, osg::ref_ptr<osg::Group> planets) {
+	LOG_DEBUG(d["id"]);
+	LoadProfiler::ScopedTimer timer(LoadProfiler::OBJECTS);
 
-	return _scene;
+	SpaceObject* so = createSpaceObject(d);
+	if (so) {
+		planets->addChild(so->getModel());
+	}
 }
 
 
 /**
- * \brief Get multiple random samples in the 2d-space.
+ * \brief Construct a space-object of a json-scene (e.g. an object which is added by the reload of the scene).
+ *        The scene-manager owns the object, its model is not added to the scene.
+ *
+ * \param d
+ *      JSON-configuration of the object.
  *
- * \param pointCount
- *      Number of random 2d-samples.
- * \param random
- *      Use a random generator (true) or align the samples uniformly on the border.
+ * \return Constructed object (nullptr => the type is not supported).
  */
-std::vector<Eigen::Vector2d> SceneManager::getSamples(int pointCount, bool random) const {
-	std::vector<Eigen::Vector2d> res;
-	int sqrtVal = static_cast<int>(std::sqrt(static_cast<float>(pointCount)) + 0.5f);
-	double invSqrtVal = 1.f / sqrtVal;
-	pointCount = sqrtVal*sqrtVal;
-
-	for (int i = 0; i < pointCount; ++i) {
-		if (random) {
-			double x = static_cast<double>(rand()) / static_cast<double>(RAND_MAX);
-			double y = static_cast<double>(rand()) / static_cast<double>(RAND_MAX);
-			res.push_back(Eigen::Vector2d(x, y));
-		} else {
-			int y = i / sqrtVal, x = i % sqrtVal;
-			res.push_back(Eigen::Vector2d((x + 0.5) * invSqrtVal, (y + 0.5) * invSqrtVal));
-		}
+SpaceObject* SceneManager::createSpaceObject(json &d) {
+	SpaceObject* so = nullptr;
+
+	if (d["type"] == "planet") {
+		so = new Planet(d);
+	} else if (d["type"] == "asteroid") {
+		so = new Asteroid(d);
+	} else if (d["type"] == "sun") {
+		Sun* sun = new Sun(d);
+		sun->initTexturing();
+		sun->addLight(osg::Vec4(1.0, 1.0, 1.0, 1.0));
+		so = sun;
+	} else {
+		LOG_WARNING("Type (" + d["type"].dump() + ") not supported!");
+		return nullptr;
 	}
 
-	return res;
+	_spaceObjects.push_back(so);
+	return so;
 }
 
 
 /**
- * \brief Get multiple random samples in the 3d-space.
+ * \brief Prepare the loaded json-scene for the rendering (the models have already been optimized by the
+ *        ModelManager, the nodes of the space-objects are kept as they are).
  *
- * \param pointCount
- *      Number of random 3d-samples.
- * \param random
- *      Use a random generator (true) or align the samples uniformly on the border.
+ * \return Root-node of OSG for rendering.
  */
-std::vector<Eigen::Vector3d> SceneManager::getSamples3(int pointCount, bool random) const {
-	std::vector<Eigen::Vector3d> res;
-	int sqrtVal = static_cast<int>(std::cbrt(static_cast<float>(pointCount)) + 0.5f);
-	double invSqrtVal = 1.f / sqrtVal;
-	pointCount = sqrtVal*sqrtVal*sqrtVal;
-
-	if (random) {
-		for (int i = 0; i < pointCount; ++i) {
-			double x = static_cast<double>(rand()) / static_cast<double>(RAND_MAX);
-			double y = static_cast<double>(rand()) / static_cast<double>(RAND_MAX);
-			double z = static_cast<double>(rand()) / static_cast<double>(RAND_MAX);
-			res.push_back(Eigen::Vector3d(x, y, z));
+osg::ref_ptr<osg::Node> SceneManager::finishScene() {
+	if (!SpaceObject::getIsHeadless()) {
+		// the models are moved into the cells of their position (the player stays, the node-tracker of the camera
+		// keeps the path to its model)
+		if (SpatialCells::getIsEnabled()) {
+			osg::BoundingBox region;
+			for (unsigned int i = 0; i < _spaceObjects.size(); ++i) {
+				region.expandBy(toOsg(_spaceObjects[i]->getPosition()));
+			}
+
+			SpatialCells::Instance()->init(region, _spaceObjects.size());
+			for (unsigned int i = 0; i < _spaceObjects.size(); ++i) {
+				if (_spaceObjects[i] != _player) {
+					_spaceObjects[i]->setCell(SpatialCells::Instance()->add(_spaceObjects[i]->getModel(), toOsg(_spaceObjects[i]->getPosition())));
+				}
+			}
+
+			_scene->addChild(SpatialCells::Instance()->getRoot());
 		}
-	} else {
-		for (int x = 0; x < sqrtVal; ++x) {
-			for (int y = 0; y < sqrtVal; ++y) {
-				for (int z = 0; z < sqrtVal; ++z) {
-					res.push_back(Eigen::Vector3d((x + 0.5) * invSqrtVal, (y + 0.5) * invSqrtVal, (z + 0.5) * invSqrtVal));
+
+		// the shared renderers of the instanced models, the trails, the particles and the streamed textures
+		if (InstanceManager::getIsEnabled()) {
+			_scene->addChild(InstanceManager::Instance()->getRoot());
+		}
+		if (TrailSystem::getIsEnabled()) {
+			_scene->addChild(TrailSystem::Instance()->getRoot());
+		}
+		if (GpuParticleSystem::getIsEnabled()) {
+			_scene->addChild(GpuParticleSystem::Instance()->getRoot());
+		}
+		if (TextureStreamer::getIsEnabled()) {
+			_scene->addChild(TextureStreamer::Instance()->getRoot());
+		}
+		if (MipStreamer::getIsEnabled()) {
+			_scene->addChild(MipStreamer::Instance()->getRoot());
+		}
+
+		// the bodies of a galaxy are splatted once they are smaller than a pixel (the player keeps its model)
+		if (DensitySplat::getIsEnabled()) {
+			std::vector<SpaceObject*> bodies;
+			std::vector<osg::ref_ptr<osg::Node> > meshRoots;
+			for (unsigned int i = 0; i < _spaceObjects.size(); ++i) {
+				if (_spaceObjects[i] != _player) {
+					bodies.push_back(_spaceObjects[i]);
+					if (!SpatialCells::getIsEnabled()) {
+						meshRoots.push_back(_spaceObjects[i]->getModel());
+					}
 				}
 			}
+			if (SpatialCells::getIsEnabled()) {
+				meshRoots.push_back(SpatialCells::Instance()->getRoot());
+			}
+			if (InstanceManager::getIsEnabled()) {
+				meshRoots.push_back(InstanceManager::Instance()->getRoot());
+			}
+
+			DensitySplat::Instance()->init(bodies, meshRoots);
+			_scene->addChild(DensitySplat::Instance()->getRoot());
 		}
+
+		// the shaders of all objects are lit by the same light-uniforms (written by the first sun)
+		MaterialCache::Instance()->applyLight(_scene->getOrCreateStateSet());
+
+		// the bounding-boxes and the HUD with the timing of the phases are hidden until they are toggled
+		_scene->addChild(DebugOverlay::Instance()->getRoot());
+		_scene->addChild(StatsOverlay::Instance()->getRoot());
 	}
 
-	return res;
+	LoadProfiler::Instance()->report();
+
+	// estimated once after the loading (the lazily built nodes of the objects are not included)
+	NodeMemoryVisitor nodeMemory;
+	_scene->accept(nodeMemory);
+	MemoryTracker::set(MemoryTracker::NODES, static_cast<long long>(nodeMemory.getMemorySize()));
+
+	return _scene;
 }
 
 
 /**
- * \brief Emmits the number of specified planets and asteroids. The space-objects are aligned in a sphere.
+ * \brief Collect the model and the textures of a player or an object of a json-scene (each asset only once).
+ * The models keep the order of the construction, because the first use decides if the LOD is used.
  *
- * \param planets
- *      Number of planets on the scene.
- * \param asteroids
- *      Number of asteroids on the scene.
+ * \param d
+ *      JSON-configuration of the player or the object.
+ * \param role
+ *      Player or object (the player is a space-ship).
  */
-void SceneManager::sphereEmitter(int planets, int asteroids, bool random) {
-	double radius = 15.0;
-	osg::ref_ptr<osg::Group> objects = new osg::Group;
-	_scene->addChild(objects);
-
-	std::vector<Eigen::Vector2d> samples = getSamples(planets, random);
-	// for spheres
-	for (int i = 0; i < planets; ++i) {
-		Eigen::Vector2d cylSample = Eigen::Vector2d(2.0 * samples[i].y() - 1.0, 2.0 * osg::PI * samples[i].x());
-		double omegaZ = cylSample(0);
-		double r = sqrt(1.0 - omegaZ * omegaZ);
-		double phi = cylSample(1);
-		double omegaX = r * cos(phi);
-		double omegaY = r * sin(phi);
-
-		SpaceObject* planet = new Planet(2.0);
-		planet->initOsg(Eigen::Vector3d(radius * omegaX, radius * omegaY, radius * omegaZ), 1.0, 1.0);
-		planet->initPhysics(DEFAULT_MASS,
-			Eigen::Vector3d(0.0, 0.0, 0.0),
-			Eigen::Vector3d(0.0, 0.0, 1.0),
-			Eigen::Vector3d(0.0, 0.0, 0.0),
-			Eigen::Vector3d(0.0, 0.0, 0.0));
-		_spaceObjects.push_back(planet);
-		objects->addChild(planet->getModel());
+void SceneManager::SceneAssets::add(json &d, Role role) {
+	bool isHeadless = SpaceObject::getIsHeadless();
+	std::string model;
+	bool useLod = true;
+
+	if (role == PLAYER) {
+		model = DATA_PATH + "/" + d["obj"].get<std::string>();
+	} else if (d["type"] == "planet" || d["type"] == "sun") {
+		model = DATA_PATH + "/sphere.obj";
+		useLod = false;
+	} else if (d["type"] == "asteroid") {
+		model = DATA_PATH + "/" + d["obj"].get<std::string>();
+		useLod = !isHeadless;
 	}
 
-	// Generate asteroids
-	samples = getSamples(asteroids, random);
-
-	for (int i = 0; i < asteroids; ++i) {
-		Eigen::Vector2d cylSample = Eigen::Vector2d(2.0 * samples[i].y() - 1.0, 2.0 * osg::PI * samples[i].x());
-		double omegaZ = cylSample(0);
-		double r = sqrt(1.0 - omegaZ * omegaZ);
-		double phi = cylSample(1);
-		double omegaX = r * cos(phi);
-		double omegaY = r * sin(phi);
-
-		SpaceObject* asteroid = new Asteroid();
-		asteroid->initOsg(Eigen::Vector3d(radius * omegaX, radius * omegaY, radius * omegaZ), 1.0, 1.0);
-		asteroid->initPhysics(DEFAULT_MASS,
-			Eigen::Vector3d(0.0, 0.0, 0.0),
-			Eigen::Vector3d(0.0, 0.0, 1.0),
-			Eigen::Vector3d(0.0, 0.0, 0.0),
-			Eigen::Vector3d(0.0, 0.0, 0.0));
-		_spaceObjects.push_back(asteroid);
-		objects->addChild(asteroid->getModel());
+	if (model != "" && found.insert(model).second) {
+		models.push_back(std::make_pair(model, useLod));
+	}
+
+	const char* keys[2] = { "texture", "bumpmap" };
+
+	for (int k = 0; k < 2 && !isHeadless; ++k) {
+		if (d[keys[k]].is_string()) {
+			std::string texture = DATA_PATH + "/texture/" + d[keys[k]].get<std::string>();
+
+			if (found.insert(texture).second) {
+				textures.push_back(std::make_pair(texture, k == 1));
+			}
+		}
 	}
 }
 
 
 /**
- * \brief Emmits the number of specified planets and asteroids. The space-objects are aligned in a cube.
+ * \brief Load and prepare the models (with their convex-hulls) and textures of a json-scene concurrently.
+ * The space-objects are constructed afterwards with the shared assets of the managers.
  *
- * \param planets
- *      Number of planets on the scene.
- * \param asteroids
- *      Number of asteroids on the scene.
+ * \param assets
+ *      Models and textures of the scene.
  */
-void SceneManager::cubeEmitter(int planets, int asteroids, bool random) {
-	osg::ref_ptr<osg::Group> objects = new osg::Group;
-	_scene->addChild(objects);
-
-	double sideLength = 15.0;
-
-	// Generate planets
-	std::vector<Eigen::Vector3d> samples = getSamples3(planets, random);
-
-	for (int i = 0; i < planets; ++i) {
-		SpaceObject* planet = new Planet(2.0);
-		planet->initOsg(samples[i] * sideLength, 1.0, 1.0);
-		planet->initPhysics(DEFAULT_MASS,
-			Eigen::Vector3d(0.0, 0.0, 0.0),
-			Eigen::Vector3d(0.0, 0.0, 1.0),
-			Eigen::Vector3d(0.0, 0.0, 0.0),
-			Eigen::Vector3d(0.0, 0.0, 0.0));
-		_spaceObjects.push_back(planet);
-		objects->addChild(planet->getModel());
+void SceneManager::prepareAssets(const SceneAssets &assets) const {
+	const std::vector<std::pair<std::string, bool> > &models = assets.models;
+	const std::vector<std::pair<std::string, bool> > &textures = assets.textures;
+
+	LOG_INFO("Preparing " << models.size() << " models and " << textures.size() << " textures.");
+
+	// create the singletons before they are used concurrently
+	ModelManager* modelManager = ModelManager::Instance();
+	ImageManager* imageManager = ImageManager::Instance();
+	if (TextureStreamer::getIsEnabled()) {
+		TextureStreamer::Instance();
+	}
+	if (MipStreamer::getIsEnabled()) {
+		MipStreamer::Instance();
 	}
 
-	// Generate asteroids
-	samples = getSamples3(asteroids, random);
-
-	for (int i = 0; i < asteroids; ++i) {
-		SpaceObject* asteroid = new Asteroid("A2.obj");
-		asteroid->initOsg(samples[i] * sideLength, 1.0, 1.0);
-		asteroid->initPhysics(DEFAULT_MASS,
-			Eigen::Vector3d(0.0, 0.0, 0.0),
-			Eigen::Vector3d(0.0, 0.0, 1.0),
-			Eigen::Vector3d(0.0, 0.0, 0.0),
-			Eigen::Vector3d(0.0, 0.0, 0.0));
-		_spaceObjects.push_back(asteroid);
-		objects->addChild(asteroid->getModel());
+	int cntModels = models.size();
+	int cntAssets = cntModels + textures.size();
+
+	// the models (with the expensive convex-hulls) come first, so they are started as early as possible
+#if defined(_OPENMP)
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (int i = 0; i < cntAssets; ++i) {
+		if (i < cntModels) {
+			// loads the model and prepares its convex-hull and bounding-box
+			modelManager->loadConvexHull(models[i].first, models[i].second);
+		} else {
+			// only queues the image-file if the textures are streamed
+			imageManager->loadTexture(textures[i - cntModels].first, textures[i - cntModels].second);
+		}
 	}
 }
 
@@ -401,6 +584,10 @@ void SceneManager::cubeEmitter(int planets, int asteroids, bool random) {
  * \brief Add the skybox to the scene.
  */
 void SceneManager::addSkybox() const {
+	if (SpaceObject::getIsHeadless()) {
+		return;
+	}
+
 	osg::ref_ptr<osg::Drawable> skyDrawable = new osg::ShapeDrawable;
 	skyDrawable->setShape(new osg::Sphere(osg::Vec3(), 10));
 
@@ -427,17 +614,44 @@ void SceneManager::addSkybox() const {
  *
  * \param scene
  *      Root-node of OSG which contains the objects.
+ * \param simulationManager
+ *      Simulation of the scene which is controlled by the keyboard (nullptr => none).
  *
  * \return OSG-viewer which handles the rendering
  */
-osg::ref_ptr<osgViewer::Viewer> SceneManager::initViewer(osg::ref_ptr<osg::Node> scene) const {
+osg::ref_ptr<osgViewer::Viewer> SceneManager::initViewer(osg::ref_ptr<osg::Node> scene, SimulationManager* simulationManager) const {
 	_keyboardHandler->setObjects(_spaceObjects);
+	_keyboardHandler->setSimulationManager(simulationManager);
 
 	osg::ref_ptr<osgViewer::Viewer> viewer = new osgViewer::Viewer;
 	//viewer->setUpViewOnSingleScreen(0);
-	viewer->setUpViewInWindow(80, 80, 1000, 600, 0);
+	// the pager loads from the disk with the budget of the background-work (plus the thread for the http-requests)
+	viewer->getDatabasePager()->setUpThreads(ThreadBudget::getNumThreads(ThreadBudget::BACKGROUND) + 1, 1);
+	viewer->getDatabasePager()->setSchedulePriority(OpenThreads::Thread::THREAD_PRIORITY_LOW);
+	osg::ref_ptr<osg::GraphicsContext> offscreen = OffscreenContext::getIsEnabled()
+		? OffscreenContext::create(OffscreenContext::getWidth(), OffscreenContext::getHeight(), 0) : nullptr;
+	if (offscreen.valid()) {
+		// the frames are only read back by the capture (there are no events without a window)
+		int width = OffscreenContext::getWidth();
+		int height = OffscreenContext::getHeight();
+		GLenum buffer = offscreen->getTraits()->doubleBuffer ? GL_BACK : GL_FRONT;
+
+		osg::Camera* camera = viewer->getCamera();
+		camera->setGraphicsContext(offscreen.get());
+		camera->setViewport(new osg::Viewport(0, 0, width, height));
+		camera->setProjectionMatrixAsPerspective(30.0, static_cast<double>(width) / height, 1.0, 10000.0);
+		camera->setDrawBuffer(buffer);
+		camera->setReadBuffer(buffer);
+	} else {
+		viewer->setUpViewInWindow(80, 80, 1000, 600, 0);
+	}
 	viewer->addEventHandler(_keyboardHandler);
 
+	// the programs of the scene are loaded from their binaries when the window is realized
+	if (ProgramBinaryCache::getIsEnabled()) {
+		ProgramBinaryCache::Instance()->attach(viewer.get());
+	}
+
 	if (_isGame) {
 		osg::Matrix rotation = osg::Matrix::rotate(-osg::PI / .6, osg::X_AXIS);
 		osg::Matrix translation = osg::Matrix::translate(0.0f, 0.0f, 5.0f);
@@ -467,7 +681,46 @@ osg::ref_ptr<osgViewer::Viewer> SceneManager::initViewer(osg::ref_ptr<osg::Node>
 		manipulator->setByMatrix(translation);
 	}
 
-	viewer->setSceneData(scene);
+	// both eyes are rendered into the layers of an offscreen-target, the instanced models in a single pass
+	if (StereoRenderer::getIsEnabled()) {
+		osg::ref_ptr<osg::Node> instanced = InstanceManager::getIsEnabled() ? InstanceManager::Instance()->getRoot() : nullptr;
+		viewer->setSceneData(StereoRenderer::Instance()->attach(viewer.get(), scene, instanced));
+	} else if (DynamicResolution::getIsEnabled()) {
+		// the scene is rendered into an offscreen-target with a scaled resolution, which is upscaled into the window
+		viewer->setSceneData(DynamicResolution::Instance()->attach(viewer.get(), scene));
+	} else {
+		viewer->setSceneData(scene);
+	}
 
 	return viewer;
 }
+
+
+/**
+ * \brief Convert the name of a threading-model of the viewer (singleThreaded, cullDrawThreadPerContext,
+ *        drawThreadPerContext, cullThreadPerCameraDrawThreadPerContext, automatic) to its value.
+ *
+ * \param name
+ *      Name of the threading-model as used on the command-line.
+ * \param threadingModel
+ *      Parsed threading-model (unchanged if the name is unknown).
+ *
+ * \return True if the name is known.
+ */
+bool SceneManager::parseThreadingModel(const std::string &name, osgViewer::ViewerBase::ThreadingModel &threadingModel) {
+	if (name == "singleThreaded") {
+		threadingModel = osgViewer::ViewerBase::SingleThreaded;
+	} else if (name == "cullDrawThreadPerContext") {
+		threadingModel = osgViewer::ViewerBase::CullDrawThreadPerContext;
+	} else if (name == "drawThreadPerContext") {
+		threadingModel = osgViewer::ViewerBase::DrawThreadPerContext;
+	} else if (name == "cullThreadPerCameraDrawThreadPerContext") {
+		threadingModel = osgViewer::ViewerBase::CullThreadPerCameraDrawThreadPerContext;
+	} else if (name == "automatic") {
+		threadingModel = osgViewer::ViewerBase::AutomaticSelection;
+	} else {
+		return false;
+	}
+
+	return true;
+}
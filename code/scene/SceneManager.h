@@ -13,6 +13,10 @@
 #include <boost/program_options.hpp>
 #include <json.hpp>
 
+#include <istream>
+#include <functional>
+#include <set>
+
 
 using namespace boost::program_options;
 using json = nlohmann::json;
@@ -22,7 +26,9 @@ using json = nlohmann::json;
 namespace pbs17 {
 	class SpaceObject;
 	class SpaceShip;
+	class BinaryScene;
 	class KeyboardHandler;
+	class SimulationManager;
 }
 
 namespace pbs17 {
@@ -57,8 +63,8 @@ namespace pbs17 {
 
 		
 		/**
-		 * \brief Load the scene based on the input parameters.
-		 * 
+		 * \brief Load the scene based on the input parameters. The bodies are generated by the emitter (see SceneGenerator).
+		 *
 		 * \param vm
 		 *      Input parameters which have been passed by starting the program.
 		 */
@@ -75,25 +81,26 @@ namespace pbs17 {
 
 
 		/**
-		 * \brief Get multiple random samples in the 2d-space.
+		 * \brief Load the scene from a stream of a json-file without keeping the whole json-document in the memory.
+		 * The stream is parsed twice: The first pass keeps everything but the objects (which are only scanned for their
+		 * models and textures), the second pass constructs each object as soon as it is read and drops it again.
 		 *
-		 * \param pointCount
-		 *      Number of random 2d-samples.
-		 * \param random
-		 *      Use a random generator (true) or align the samples uniformly on the border.
+		 * \param stream
+		 *      Stream of the json-file (has to be seekable).
+		 * \param binaryScene
+		 *      Output-parameter: The objects are also collected into this binary scene (nullptr => not collected).
 		 */
-        std::vector<Eigen::Vector2d> getSamples(int pointCount, bool random) const;
+		osg::ref_ptr<osg::Node> loadScene(std::istream &stream, BinaryScene* binaryScene = nullptr);
 
 
 		/**
-		 * \brief Get multiple random samples in the 3d-space.
-		 * 
-		 * \param pointCount
-		 *      Number of random 3d-samples.
-		 * \param random
-		 *      Use a random generator (true) or align the samples uniformly on the border.
+		 * \brief Load the scene from a binary scene-file. The objects are constructed with the same configurations as the
+		 * objects of the json-scenes.
+		 *
+		 * \param scene
+		 *      Loaded binary scene.
 		 */
-        std::vector<Eigen::Vector3d> getSamples3(int pointCount, bool random) const;
+		osg::ref_ptr<osg::Node> loadScene(const BinaryScene &scene);
 
 
 		/**
@@ -102,14 +109,42 @@ namespace pbs17 {
 		 *
 		 * \param scene
 		 *      Root-node of OSG which contains the objects.
+		 * \param simulationManager
+		 *      Simulation of the scene which is controlled by the keyboard (nullptr => none).
 		 *
 		 * \return OSG-viewer which handles the rendering
 		 */
-		osg::ref_ptr<osgViewer::Viewer> initViewer(osg::ref_ptr<osg::Node> scene) const;
+		osg::ref_ptr<osgViewer::Viewer> initViewer(osg::ref_ptr<osg::Node> scene, SimulationManager* simulationManager = nullptr) const;
+
 
+		/**
+		 * \brief Convert the name of a threading-model of the viewer (singleThreaded, cullDrawThreadPerContext,
+		 *        drawThreadPerContext, cullThreadPerCameraDrawThreadPerContext, automatic) to its value.
+		 *
+		 * \param name
+		 *      Name of the threading-model as used on the command-line.
+		 * \param threadingModel
+		 *      Parsed threading-model (unchanged if the name is unknown).
+		 *
+		 * \return True if the name is known.
+		 */
+		static bool parseThreadingModel(const std::string &name, osgViewer::ViewerBase::ThreadingModel &threadingModel);
 
 
 
+
+		/**
+		 * \brief Construct a space-object of a json-scene (e.g. an object which is added by the reload of the scene).
+		 *        The scene-manager owns the object, its model is not added to the scene.
+		 *
+		 * \param d
+		 *      JSON-configuration of the object.
+		 *
+		 * \return Constructed object (nullptr => the type is not supported).
+		 */
+		SpaceObject* createSpaceObject(json &d);
+
+
 		/**
 		 * \brief Get the loaded space-objects.
 		 *
@@ -119,14 +154,68 @@ namespace pbs17 {
 			return _spaceObjects;
 		}
 
+
+		/**
+		 * \brief Get the space-ship of the player.
+		 *
+		 * \return Space-ship of the player (nullptr => the scene is not a game).
+		 */
+		SpaceShip* getPlayer() const {
+			return _player;
+		}
+
+
+		/**
+		 * \brief Get the simulation-settings of the loaded scene ("simulation" in the json-file).
+		 *
+		 * \return Simulation-settings (empty object if the scene does not define any).
+		 */
+		json getSimulationSettings() const {
+			return _simulationSettings;
+		}
+
 	private:
 
+		/**
+		 * \brief Unique models and textures of a json-scene, which are prepared before the objects are constructed.
+		 */
+		struct SceneAssets {
+			//! Space-objects whose assets are collected
+			enum Role {
+				PLAYER,
+				OBJECT
+			};
+
+			//! Models in the order of the construction with the flag if the LOD is used
+			std::vector<std::pair<std::string, bool> > models;
+			//! Textures and bumpmaps with the flag if it's a bumpmap
+			std::vector<std::pair<std::string, bool> > textures;
+			//! All collected paths
+			std::set<std::string> found;
+
+
+			/**
+			 * \brief Collect the model and the textures of a player or an object of a json-scene (each asset only once).
+			 * The models keep the order of the construction, because the first use decides if the LOD is used.
+			 *
+			 * \param d
+			 *      JSON-configuration of the player or the object.
+			 * \param role
+			 *      Player or object (the player is a space-ship).
+			 */
+			void add(json &d, Role role);
+		};
+
+
 		//! Root-node of OSG which contains the whole scene (used for rendering)
 		osg::ref_ptr<osg::Group> _scene;
 
 		//! All space-objects in the scene (used for calcualtions)
 		std::vector<SpaceObject*> _spaceObjects;
 
+		//! Simulation-settings of the scene
+		json _simulationSettings = json::object();
+
 		//! True if it is a game and false if it is a simulation
 		bool _isGame = false;
 
@@ -136,9 +225,6 @@ namespace pbs17 {
 		//! Keyboard-handler
 		KeyboardHandler* _keyboardHandler = nullptr;
 
-        const double DEFAULT_MASS = 500000;
-
-
 		/**
 		 * \brief Add the skybox to the scene.
 		 */
@@ -146,24 +232,72 @@ namespace pbs17 {
 
 
 		/**
-		* \brief Emmits the number of specified planets and asteroids. The space-objects are aligned in a sphere.
-		*
-		* \param planets
-		*      Number of planets on the scene.
-		* \param asteroids
-		*      Number of asteroids on the scene.
-		*/
-		void sphereEmitter(int planets, int asteroids, bool random);
+		 * \brief Parse a json-scene and pass each element of the "objects"-array to the handler as soon as it is read.
+		 * The elements are dropped afterwards, so they are not part of the returned document.
+		 *
+		 * \param stream
+		 *      Stream of the json-file.
+		 * \param handleObject
+		 *      Handler which is called for each object (in the order of the file).
+		 *
+		 * \return Scene without the objects (empty "objects"-array).
+		 */
+		static json parseScene(std::istream &stream, const std::function<void(json&)> &handleObject);
+
+
+		/**
+		 * \brief Check if the json-scene is a game.
+		 *
+		 * \param j
+		 *      Loaded json-file (the objects are not needed).
+		 *
+		 * \return True if the scene is played with the space-ship of the player.
+		 */
+		static bool isGame(json &j);
+
+
+		/**
+		 * \brief Create the root of a json-scene with the skybox, the settings and the player and prepare the assets.
+		 *
+		 * \param j
+		 *      Loaded json-file (the objects are not needed).
+		 * \param cntObjects
+		 *      Number of objects in the scene.
+		 * \param assets
+		 *      Models and textures of the player and the objects.
+		 *
+		 * \return Group to which the space-objects are added.
+		 */
+		osg::ref_ptr<osg::Group> initScene(json &j, unsigned int cntObjects, const SceneAssets &assets);
+
+
+		/**
+		 * \brief Construct a space-object of a json-scene and add it to the scene.
+		 *
+		 * \param d
+		 *      JSON-configuration of the object.
+		 * \param planets
+		 *      Group to which the model of the object is added.
+		 */
+		void addSpaceObject(json &d, osg::ref_ptr<osg::Group> planets);
+
+
+		/**
+		 * \brief Prepare the loaded json-scene for the rendering (the models have already been optimized by the
+		 *        ModelManager, the nodes of the space-objects are kept as they are).
+		 *
+		 * \return Root-node of OSG for rendering.
+		 */
+		osg::ref_ptr<osg::Node> finishScene();
 
 
 		/**
-		* \brief Emmits the number of specified planets and asteroids. The space-objects are aligned in a cube.
-		*
-		* \param planets
-		*      Number of planets on the scene.
-		* \param asteroids
-		*      Number of asteroids on the scene.
-		*/
-		void cubeEmitter(int planets, int asteroids, bool random);
+		 * \brief Load and prepare the models (with their convex-hulls) and textures of a json-scene concurrently.
+		 * The space-objects are constructed afterwards with the shared assets of the managers.
+		 *
+		 * \param assets
+		 *      Models and textures of the scene.
+		 */
+		void prepareAssets(const SceneAssets &assets) const;
 	};
 }
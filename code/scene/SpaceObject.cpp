@@ -7,18 +7,24 @@
 
 #include "SpaceObject.h"
 
-#include <osg/PolygonMode>
-#include <osg/ShapeDrawable>
-#include <osg/Material>
+#include <Eigen/Geometry>
+#include <Eigen/LU>
+#include <osg/Timer>
 
 #include "../osg/OsgEigenConversions.h"
 #include "../osg/visitors/BoundingBoxVisitor.h"
-#include "../osg/ImageManager.h"
-#include "../osg/visitors/ComputeTangentVisitor.h"
-#include "../osg/shaders/BumpmapShader.h"
+#include "../osg/MaterialCache.h"
+#include "../osg/shaders/RibbonShader.h"
 #include "../config.h"
 #include "../osg/FollowingRibbon.h"
+#include "../osg/TrailSystem.h"
+#include "../osg/DebugOverlay.h"
+#include "../osg/ModelManager.h"
+#include "../osg/SpatialCells.h"
 #include "../osg/visitors/TrailerCallback.h"
+#include "../osg/visitors/LazyNodeCallback.h"
+#include "../physics/Logger.h"
+#include "../physics/MemoryTracker.h"
 
 using namespace pbs17;
 
@@ -26,6 +32,13 @@ using namespace pbs17;
 //! ID's start from 0.
 long SpaceObject::RunningId = 0;
 
+bool SpaceObject::IS_HEADLESS = false;
+
+bool SpaceObject::IS_LAZY_NODES = false;
+
+//! The nodes of the objects which are only briefly outside of the view are kept
+const double SpaceObject::RELEASE_TIME = 30.0;
+
 
 /**
 * \brief Constructor of SpaceObject.
@@ -35,34 +48,35 @@ long SpaceObject::RunningId = 0;
 */
 SpaceObject::SpaceObject(std::string filename, int i)
     : SpaceObject(filename, "") {
-    std::cout << "should not be called" << std::endl;
+    LOG_WARNING("should not be called");
 }
 
-SpaceObject::SpaceObject(json j) {
-	_textureName = j["texture"].is_string() ? j["texture"].get<std::string>() : "";
-	_bumpmapName = j["bumpmap"].is_string() ? j["bumpmap"].get<std::string>() : "";
+SpaceObject::SpaceObject(const json &j) {
+	// the optional keys have to be checked first (the configuration is not modified)
+	_textureName = j.count("texture") && j["texture"].is_string() ? j["texture"].get<std::string>() : "";
+	_bumpmapName = j.count("bumpmap") && j["bumpmap"].is_string() ? j["bumpmap"].get<std::string>() : "";
     
-	_filename = j["obj"].is_string()? j["obj"].get<std::string>(): "";
+	_filename = j.count("obj") && j["obj"].is_string()? j["obj"].get<std::string>(): "";
+	_isContinuous = j.count("continuous") && j["continuous"].is_boolean() && j["continuous"].get<bool>();
+	_isTestParticle = j.count("testParticle") && j["testParticle"].is_boolean() && j["testParticle"].get<bool>();
+	_isVisualSpin = j.count("visualSpin") && j["visualSpin"].is_boolean() && j["visualSpin"].get<bool>();
+	_isMergeable = !(j.count("merge") && j["merge"].is_boolean() && !j["merge"].get<bool>());
+	if (j.count("collisionGroup") && j["collisionGroup"].is_number_unsigned()) {
+		_collisionGroup = j["collisionGroup"].get<uint32_t>();
+	}
+	if (j.count("collisionMask") && j["collisionMask"].is_number_unsigned()) {
+		_collisionMask = j["collisionMask"].get<uint32_t>();
+	}
     _id = RunningId;
     ++RunningId;
 
     _position = Eigen::Vector3d(0, 0, 0);
     _orientation = osg::Quat(0, osg::X_AXIS);
-;
-
-    // For visually debuggin => Make bounding-box visible
-    osg::ref_ptr<osg::Geode> geode = new osg::Geode;
-    _aabbShape = new osg::ShapeDrawable(new osg::Box(osg::Vec3(), 1.0f));
-    _aabbShape->setColor(osg::Vec4(1.0, 0, 0, 1.0));
-    geode->addDrawable(_aabbShape);
 
-    _aabbRendering = new osg::MatrixTransform;
-    _aabbRendering->setNodeMask(0x1);
-    _aabbRendering->addChild(geode.get());
-    osg::StateSet* ss = _aabbRendering->getOrCreateStateSet();
-    ss->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
-    ss->setAttributeAndModes(new osg::PolygonMode(
-        osg::PolygonMode::FRONT_AND_BACK, osg::PolygonMode::LINE));
+    // For visually debuggin => the bounding-box is drawn by the shared debug-overlay
+    if (!IS_HEADLESS) {
+        _debugBox = DebugOverlay::Instance()->addBox();
+    }
 }
 
 
@@ -83,19 +97,10 @@ SpaceObject::SpaceObject(std::string filename, std::string textureName)
 	_orientation = osg::Quat(0, osg::X_AXIS);
 
 
-	// For visually debuggin => Make bounding-box visible
-	osg::ref_ptr<osg::Geode> geode = new osg::Geode;
-	_aabbShape = new osg::ShapeDrawable(new osg::Box(osg::Vec3(), 1.0f));
-	_aabbShape->setColor(osg::Vec4(1.0, 0, 0, 1.0));
-	geode->addDrawable(_aabbShape);
-
-	_aabbRendering = new osg::MatrixTransform;
-	_aabbRendering->setNodeMask(0x1);
-	_aabbRendering->addChild(geode.get());
-	osg::StateSet* ss = _aabbRendering->getOrCreateStateSet();
-	ss->setMode(GL_LIGHTING, osg::StateAttribute::OFF);
-	ss->setAttributeAndModes(new osg::PolygonMode(
-		osg::PolygonMode::FRONT_AND_BACK, osg::PolygonMode::LINE));
+	// For visually debuggin => the bounding-box is drawn by the shared debug-overlay
+	if (!IS_HEADLESS) {
+		_debugBox = DebugOverlay::Instance()->addBox();
+	}
 }
 
 
@@ -106,6 +111,8 @@ SpaceObject::~SpaceObject() {
 	if (_modelRoot) {
 		_modelRoot = nullptr;
 	}
+
+	MemoryTracker::add(MemoryTracker::HULL_COPIES, -getHullCopySize());
 }
 
 
@@ -138,13 +145,17 @@ void SpaceObject::initPhysics(double mass, Eigen::Vector3d linearVelocity, Eigen
  * \param newPosition
  *	    New position of the object.
  */
-void SpaceObject::setPosition(Eigen::Vector3d newPosition) {
+void SpaceObject::setPosition(const Eigen::Vector3d &newPosition) {
 	_position = newPosition;
+	_isConvexHullDirty = true;
+	_isCoarseHullDirty = true;
 
 	osg::Matrixd rotation;
 	_orientation.get(rotation);
 
-	_transformation->setMatrix(rotation * osg::Matrix::translate(toOsg(newPosition)));
+	if (_transformation.valid()) {
+		_transformation->setMatrix(rotation * osg::Matrix::translate(toOsg(newPosition)));
+	}
 	calculateAABB();
 }
 
@@ -158,16 +169,215 @@ void SpaceObject::setPosition(Eigen::Vector3d newPosition) {
  *      New orientation of the object.
  */
 void SpaceObject::updatePositionOrientation(Eigen::Vector3d newPosition, osg::Quat newOrientation) {
+	setPositionOrientation(newPosition, newOrientation);
+	updateTransformation();
+}
+
+
+/**
+ * \brief Set the position and orientation of the space-object without touching the OSG-nodes
+ *        (so it can be called from the physics-thread). The AABB is updated as well.
+ *
+ * \param newPosition
+ *      New position of the object.
+ * \param newOrientation
+ *      New orientation of the object.
+ */
+void SpaceObject::setPositionOrientation(const Eigen::Vector3d &newPosition, const osg::Quat &newOrientation) {
 	_position = newPosition;
-    _orientation = newOrientation;
+	_orientation = newOrientation;
+	_isConvexHullDirty = true;
+	_isCoarseHullDirty = true;
+	_isTransformationDirty = true;
 
+	updateAABB();
+}
+
+
+/**
+ * \brief Write the current state (position, orientation, AABB and collision-state) to the OSG-nodes.
+ */
+void SpaceObject::updateTransformation() {
+	applyActive(_isActive);
+	applyTransformation(toOsg(_position), _orientation, _aabbGlobal, _collisionState);
+	_isTransformationDirty = false;
+}
+
+
+/**
+ * \brief Show or hide the OSG-nodes of the object (has to be called from the rendering-thread before
+ *        applyTransformation()).
+ *
+ * \param isActive
+ *      True if the object is simulated.
+ */
+void SpaceObject::applyActive(bool isActive) {
+	if (isActive == _isRenderedActive) {
+		return;
+	}
+	_isRenderedActive = isActive;
+
+	if (isActive) {
+		_modelRoot->setAllChildrenOn();
+	} else {
+		_modelRoot->setAllChildrenOff();
+
+		// the instance is drawn by the shared renderer of the model
+		if (_instancedModel.valid()) {
+			_instancedModel->setMatrix(_instance, osg::Matrix::scale(0.0, 0.0, 0.0));
+		}
+	}
+
+	// the bound of a root-node without children is the rendered AABB (invalid while hidden)
+	if (_isLazyNodes) {
+		_modelRoot->dirtyBound();
+	}
+}
+
+
+/**
+ * \brief Write the given state to the OSG-nodes (has to be called from the rendering-thread).
+ *
+ * \param position
+ *      Position of the object.
+ * \param orientation
+ *      Orientation of the object.
+ * \param aabb
+ *      Global AABB of the object.
+ * \param collisionState
+ *      Collision-state of the object (colour of the AABB).
+ */
+void SpaceObject::applyTransformation(const osg::Vec3d &position, const osg::Quat &orientation, const osg::BoundingBox &aabb, int collisionState) {
+	// the nodes are hidden (see applyActive()), only the box of the debug-overlay is collapsed
+	if (!_isRenderedActive) {
+		if (_debugBox >= 0 && DebugOverlay::Instance()->isVisible()) {
+			DebugOverlay::Instance()->setBox(_debugBox, osg::BoundingBox(position, position), 0);
+		}
+		_renderedCollisionState = collisionState;
+		return;
+	}
+
+	if (_isLazyNodes) {
+		updateLazyNodes(aabb);
+	}
+
+	// with a visual spin, the transformation only changes if the angular velocity does
 	osg::Matrixd rotation;
-    newOrientation.get(rotation);
-	osg::Matrixd translation = osg::Matrix::translate(toOsg(newPosition));
+	(_spinUniform.valid() ? applyVisualSpin(orientation) : orientation).get(rotation);
+	osg::Matrixd translation = osg::Matrix::translate(position);
+
+	double scaling, growth;
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_scalingMutex);
+		scaling = _scaling;
+		growth = _growth;
+	}
 
-    _transformation->setMatrix(rotation * translation);
+	// the nodes are built with the initial scaling
+	if (_transformation.valid()) {
+		_transformation->setMatrix(growth != 1.0 ? osg::Matrix::scale(growth, growth, growth) * rotation * translation : rotation * translation);
+	}
 
-	updateAABB();
+	// the box is only written while the bounding-boxes are shown (the handler marks the objects dirty when toggled)
+	if (_debugBox >= 0 && DebugOverlay::Instance()->isVisible()) {
+		DebugOverlay::Instance()->setBox(_debugBox, aabb, collisionState);
+	}
+	_renderedCollisionState = collisionState;
+
+	// a lazy convex-hull is loaded once it's shown (the handlers mark the objects dirty when toggled)
+	if (_convexHullGeode.valid() && _convexHullGeode->getNumDrawables() == 0 && _isConvexHullShown) {
+		_convexHullGeode->addDrawable(getConvexHullModel()->getOsgModel());
+	}
+
+	// the instance is hidden (zero-matrix) while the convex-hull is shown instead of the model
+	if (_instancedModel.valid()) {
+		osg::Matrixd model = !_isConvexHullShown ?
+			osg::Matrix::scale(scaling, scaling, scaling) * rotation * translation : osg::Matrix::scale(0.0, 0.0, 0.0);
+		_instancedModel->setMatrix(_instance, model);
+	}
+
+	if (_trail >= 0) {
+		TrailSystem::Instance()->setPosition(_trail, position);
+	}
+
+	if (_cell >= 0) {
+		SpatialCells::Instance()->setPosition(_cell, position);
+	}
+}
+
+
+/**
+ * \brief Show the convex-hull or the model of the object (the nodes of a lazy object are built with the
+ *        selected representation).
+ *
+ * \param isShown
+ *      True if the convex-hull is drawn instead of the model.
+ */
+void SpaceObject::showConvexHull(bool isShown) {
+	_isConvexHullShown = isShown;
+
+	if (_convexRenderSwitch.valid()) {
+		_convexRenderSwitch->setValue(0, !isShown);
+		_convexRenderSwitch->setValue(1, isShown);
+	}
+	_isTransformationDirty = true;
+}
+
+
+/**
+ * \brief Build the nodes below the root-node only once the object is visible (see initNodes()).
+ */
+void SpaceObject::initLazyNodes() {
+	_isLazyNodes = true;
+	_renderedBound.init();
+	_renderedBound.expandBy(_aabbGlobal);
+
+	// the root-node stays in the scene (and its cell), only its children are built and released
+	_modelRoot->setCullCallback(new LazyNodeCallback(this));
+	_modelRoot->setComputeBoundingSphereCallback(new LazyNodeBound(this));
+}
+
+
+/**
+ * \brief Report that the root-node passed the view-frustum (called by the cull-traversal, see LazyNodeCallback),
+ *        the nodes of a lazy object are built by the next sync-pass.
+ */
+void SpaceObject::markVisible() {
+	_lastVisibleTime.store(osg::Timer::instance()->time_s(), std::memory_order_relaxed);
+
+	if (_isLazyNodes && !_isNodeBuilt.load(std::memory_order_relaxed)) {
+		_isNodeRequested.store(true, std::memory_order_relaxed);
+	}
+}
+
+
+/**
+ * \brief Build the lazy nodes of a visible object or release them if it was culled for RELEASE_TIME.
+ *
+ * \param aabb
+ *      Global AABB of the object (bound of the root-node while the nodes aren't built).
+ */
+void SpaceObject::updateLazyNodes(const osg::BoundingBox &aabb) {
+	if (!_isNodeBuilt.load(std::memory_order_relaxed)) {
+		_renderedBound.init();
+		_renderedBound.expandBy(aabb);
+		_modelRoot->dirtyBound();
+
+		if (_isNodeRequested.exchange(false)) {
+			initNodes();
+			_isNodeBuilt.store(true, std::memory_order_relaxed);
+		}
+	} else if (osg::Timer::instance()->time_s() - _lastVisibleTime.load(std::memory_order_relaxed) > RELEASE_TIME) {
+		// the drawables of the previous frame are referenced by its render-leaves
+		_modelRoot->removeChildren(0, _modelRoot->getNumChildren());
+		_transformation = nullptr;
+		_convexRenderSwitch = nullptr;
+		_convexHullGeode = nullptr;
+
+		_renderedBound.init();
+		_renderedBound.expandBy(aabb);
+		_isNodeBuilt.store(false, std::memory_order_relaxed);
+	}
 }
 
 
@@ -187,41 +397,105 @@ void SpaceObject::calculateAABB() {
 	_aabbGlobal = bbox.getGlobalBoundBox();
 	_aabbLocalOrig = bbox.getLocalBoundBox();
 	_aabbGlobalOrig = bbox.getGlobalBoundBox();
-
-	_aabbRendering->setMatrix(osg::Matrix::scale(_aabbGlobal._max - _aabbGlobal._min) * osg::Matrix::translate(toOsg(_position)));
 }
 
 
 /**
- * \brief Update the AABB. Here, only the 8 corners of the original AABB are
- * rotated/translated correctly to speed up the calculateion. (to calculate the
- * bounding box for each time step correclty over all vertices is too time consuming).
+ * \brief Update the AABB from the local AABB (the box around the 8 rotated/translated corners, to calculate the
+ * bounding box for each time step correclty over all vertices is too time consuming). The extent of the rotated box
+ * is |R| * halfExtent (Arvo), objects with a bounding-sphere are only translated.
  */
 void SpaceObject::updateAABB() {
-	osg::Matrix translation = osg::Matrix::translate(toOsg(_position));
-	osg::Matrix rotation;
-	_orientation.get(rotation);
+	Eigen::Vector3d center = fromOsg(osg::Vec3d(_aabbLocal.center()));
+	Eigen::Vector3d extent;
+
+	if (_boundingRadius > 0.0) {
+		// the sphere is rotation-invariant, so is its box
+		center += _position;
+		extent = Eigen::Vector3d(_boundingRadius, _boundingRadius, _boundingRadius);
+	} else {
+		Eigen::Matrix3d rotation = Eigen::Quaterniond(_orientation.w(), _orientation.x(), _orientation.y(), _orientation.z()).toRotationMatrix();
+		Eigen::Vector3d halfExtent = 0.5 * fromOsg(osg::Vec3d(_aabbLocal._max - _aabbLocal._min));
+
+		center = rotation * center + _position;
+		extent = rotation.cwiseAbs() * halfExtent;
+	}
 
-	osg::Matrix localToWorld = rotation * translation;
+	_aabbGlobal = osg::BoundingBox(toOsg(center - extent), toOsg(center + extent));
+}
 
-	osg::BoundingBox newGlobal;
 
-	for (unsigned int i = 0; i < 8; ++i)
-		newGlobal.expandBy(_aabbLocal.corner(i) * localToWorld);
+/**
+ * \brief Get the radius of the sphere which replaces the shape of the object while it's far from the region
+ *        of interest (see CollisionManager::setLevelOfDetail()).
+ *
+ * \return Radius of the bounding-sphere, or the mean half-extent of the local AABB.
+ */
+double SpaceObject::getCoarseRadius() const {
+	if (_boundingRadius > 0.0) {
+		return _boundingRadius;
+	}
 
-	_aabbGlobal = newGlobal;
-	_aabbRendering->setMatrix(osg::Matrix::scale(_aabbGlobal._max - _aabbGlobal._min) * osg::Matrix::translate(toOsg(_position)));
+	// between the inscribed and the circumscribed sphere of the box
+	osg::Vec3 extent = _aabbLocal._max - _aabbLocal._min;
+	return (extent.x() + extent.y() + extent.z()) / 6.0;
 }
 
 
 /**
- * \brief Reset the collision state to 0. Usually before each frame.
+ * \brief Scale the object around its center by a factor (e.g. after it absorbed another object). The AABB,
+ *        the bounding-radius and the convex-hull are scaled at once, the OSG-nodes by the next sync-pass.
+ *
+ * \param factor
+ *      Factor of the scaling (1.0 => unchanged).
  */
-void SpaceObject::resetCollisionState() {
-	if (_collisionState == 0) {
-		_aabbShape->setColor(osg::Vec4(1, 1, 1, 1));
+void SpaceObject::grow(double factor) {
+	{
+		OpenThreads::ScopedLock<OpenThreads::Mutex> lock(_scalingMutex);
+		_scaling *= factor;
+		_growth *= factor;
 	}
 
+	float f = static_cast<float>(factor);
+	_aabbLocal = osg::BoundingBox(_aabbLocal._min * f, _aabbLocal._max * f);
+	_aabbLocalOrig = osg::BoundingBox(_aabbLocalOrig._min * f, _aabbLocalOrig._max * f);
+	_boundingRadius *= factor;
+
+	_isConvexHullDirty = true;
+	_isCoarseHullDirty = true;
+	updateAABB();
+	_isTransformationDirty = true;
+}
+
+
+/**
+ * \brief Set the moment of inertia of the object (and its inverse).
+ *
+ * \param m
+ *      New moment of inertia-matrix of the object.
+ */
+void SpaceObject::setMomentOfInertia(const Eigen::Matrix3d &m) {
+	_momentOfInertia = m;
+	_inverseMomentOfInertia = m.inverse();
+}
+
+
+/**
+ * \brief Get the inverse moment of inertia rotated into the world-space with the current orientation.
+ *
+ * \return Inverse moment of inertia in world-coordinates (R * I^-1 * R^T).
+ */
+Eigen::Matrix3d SpaceObject::getWorldInverseMomentOfInertia() const {
+	Eigen::Matrix3d rotation = Eigen::Quaterniond(_orientation.w(), _orientation.x(), _orientation.y(), _orientation.z()).toRotationMatrix();
+
+	return rotation * _inverseMomentOfInertia * rotation.transpose();
+}
+
+
+/**
+ * \brief Reset the collision state to 0. Usually before each frame.
+ */
+void SpaceObject::resetCollisionState() {
 	_collisionState = 0;
 }
 
@@ -237,31 +511,145 @@ void SpaceObject::resetCollisionState() {
  */
 void SpaceObject::setCollisionState(int c) {
 	_collisionState = std::max(_collisionState, c);
+}
+
+
+/**
+ * \brief Load the convex-hull of the model on the first use of getConvexHullModel() (instead of during the
+ * initialization, most objects never reach the narrow-phase).
+ *
+ * \param modelPath
+ *      Complete path to the model (see ModelManager::loadConvexHull()).
+ * \param useLod
+ *      True if simplified models should be used if the model is not loaded yet.
+ */
+void SpaceObject::setLazyConvexHull(std::string modelPath, bool useLod) {
+	_convexHullPath = modelPath;
+	_isConvexHullLod = useLod;
+}
+
+
+/**
+ * \brief Load the convex-hull which was deferred by setLazyConvexHull(). The hull is shared by all instances
+ * of the model => concurrent first uses (e.g. by the parallel narrow-phase) get the same hull.
+ *
+ * \return Convex-hull of the object.
+ */
+const ConvexHull3D* SpaceObject::loadConvexHullModel() const {
+	const ConvexHull3D* hull = ModelManager::Instance()->loadConvexHull(_convexHullPath, _isConvexHullLod);
+	_convexHull.store(hull, std::memory_order_release);
 
-	_aabbShape->setColor(c == 1 ? osg::Vec4(0, 1, 0, 1) : osg::Vec4(1, 0, 0, 1));
+	return hull;
 }
 
 
 /**
-* \brief Get the convex hull with the correct global-vertex positions.
+* \brief Get the convex hull with the correct global-vertex positions. The vertices are only
+* transformed again if the object has been moved since the last call.
 *
 * \return List of vertices of the convex-hull in the global-world-space.
 */
-std::vector<Eigen::Vector3d> SpaceObject::getConvexHull() const {
-	// Todo: use Eigen-transformations instead
-	osg::Matrix scaling = osg::Matrix::scale(_scaling, _scaling, _scaling);
-	osg::Matrix translation = osg::Matrix::translate(toOsg(_position));
-	osg::Matrix rotation;
-	_orientation.get(rotation);
+const std::vector<Eigen::Vector3d>& SpaceObject::getConvexHull() {
+	updateConvexHull();
+
+	return _convexHullGlobal;
+}
+
+
+/**
+ * \brief Transform the vertices of the convex-hull to the global-world-space if the object has been moved.
+ * Call this before the convex-hull is read concurrently (getConvexHull() is then only reading).
+ */
+void SpaceObject::updateConvexHull() {
+	if (!_isConvexHullDirty) {
+		return;
+	}
+
+	// the hull is unscaled => same transformation as scaling * rotation * translation in OSG (row-vectors): R * s * v + t
+	Eigen::Matrix3d transformation = _scaling * Eigen::Quaterniond(_orientation.w(), _orientation.x(), _orientation.y(), _orientation.z()).toRotationMatrix();
+	const ConvexHull3D* model = getConvexHullModel();
+	const std::vector<Eigen::Vector3d> &current = model->getVertices();
+	long long oldSize = getHullCopySize();
+
+	_convexHullGlobal.resize(current.size());
+
+	for (unsigned int i = 0; i < current.size(); ++i) {
+		_convexHullGlobal[i] = transformation * current[i] + _position;
+	}
+	_convexHullSoa.assign(_convexHullGlobal, _position);
+
+	// the parts of a compound are moved with the hull
+	const std::vector<ConvexHull3D*> &parts = model->getParts();
+	_partHullsGlobal.resize(parts.size());
+	_partHullsSoa.resize(parts.size());
+
+	for (unsigned int p = 0; p < parts.size(); ++p) {
+		const std::vector<Eigen::Vector3d> &partVertices = parts[p]->getVertices();
+		_partHullsGlobal[p].resize(partVertices.size());
+
+		for (unsigned int i = 0; i < partVertices.size(); ++i) {
+			_partHullsGlobal[p][i] = transformation * partVertices[i] + _position;
+		}
+		_partHullsSoa[p].assign(_partHullsGlobal[p], _position);
+	}
+	MemoryTracker::add(MemoryTracker::HULL_COPIES, getHullCopySize() - oldSize);
+
+	_isConvexHullDirty = false;
+}
+
+
+/**
+ * \brief Get the memory of the global copies of the convex-hulls (counted by the MemoryTracker).
+ *
+ * \return Memory in bytes.
+ */
+long long SpaceObject::getHullCopySize() const {
+	size_t size = (_convexHullGlobal.capacity() + _coarseHullGlobal.capacity()) * sizeof(Eigen::Vector3d);
+	size += _convexHullSoa.getMemorySize() + _coarseHullSoa.getMemorySize();
+
+	for (unsigned int p = 0; p < _partHullsGlobal.size(); ++p) {
+		size += _partHullsGlobal[p].capacity() * sizeof(Eigen::Vector3d) + _partHullsSoa[p].getMemorySize();
+	}
+
+	return static_cast<long long>(size);
+}
+
+
+/**
+ * \brief Get the coarse level of the convex-hull with the global-vertex positions (see ConvexHull3D::getCoarseVertices()).
+ * The vertices are only transformed again if the object has been moved since the last call.
+ *
+ * \return List of vertices of the coarse convex-hull in the global-world-space.
+ */
+const std::vector<Eigen::Vector3d>& SpaceObject::getCoarseHull() {
+	updateCoarseHull();
+
+	return _coarseHullGlobal;
+}
 
-	std::vector<Eigen::Vector3d> transformed;
-	std::vector<Eigen::Vector3d> current = _convexHull->getVertices();
+
+/**
+ * \brief Transform the vertices of the coarse convex-hull to the global-world-space if the object has been moved.
+ * Call this before the coarse convex-hull is read concurrently.
+ */
+void SpaceObject::updateCoarseHull() {
+	if (!_isCoarseHullDirty) {
+		return;
+	}
+
+	Eigen::Matrix3d transformation = _scaling * Eigen::Quaterniond(_orientation.w(), _orientation.x(), _orientation.y(), _orientation.z()).toRotationMatrix();
+	const std::vector<Eigen::Vector3d> &current = getConvexHullModel()->getCoarseVertices();
+	long long oldSize = getHullCopySize();
+
+	_coarseHullGlobal.resize(current.size());
 
 	for (unsigned int i = 0; i < current.size(); ++i) {
-		transformed.push_back(fromOsg(toOsg(current[i]) * rotation * translation * scaling));
+		_coarseHullGlobal[i] = transformation * current[i] + _position;
 	}
+	_coarseHullSoa.assign(_coarseHullGlobal, _position);
+	MemoryTracker::add(MemoryTracker::HULL_COPIES, getHullCopySize() - oldSize);
 
-	return transformed;
+	_isCoarseHullDirty = false;
 }
 
 
@@ -269,38 +657,84 @@ std::vector<Eigen::Vector3d> SpaceObject::getConvexHull() const {
  * \brief Initialize the texture-properties and shader.
  */
 void SpaceObject::initTexturing() {
-	bool useBumpmap = _bumpmapName != "";
-	osg::ref_ptr<osg::StateSet> stateset = _convexRenderSwitch->getOrCreateStateSet();
-
-	// Apply bumpmap-shaders
-	ComputeTangentVisitor ctv;
-	ctv.setTraversalMode(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN);
-	_modelFile->accept(ctv);
-
-	// Load the texture
-	if (_textureName != "") {
-		std::string texturePath = DATA_PATH + "/texture/" + _textureName;
-		osg::ref_ptr<osg::Texture2D> colorTex = ImageManager::Instance()->loadTexture(texturePath);
-
-		if (useBumpmap) {
-			std::string bumpmapPath = DATA_PATH + "/texture/" + _bumpmapName;
-			osg::ref_ptr<osg::Texture2D> normalTex = ImageManager::Instance()->loadTexture(bumpmapPath);
-
-			BumpmapShader bumpmapShader(colorTex, normalTex);
-			bumpmapShader.apply(_convexRenderSwitch);
-		} else {
-			stateset->setTextureAttributeAndModes(0, colorTex.get(), osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE);
-		}
+	if (IS_HEADLESS) {
+		return;
+	}
+
+	// the tangents of the bumpmap-shaders have been computed with the shared model (see ModelManager::loadModel())
+	// the textures, the shader and the material are shared by all objects with the same textures
+	std::string texturePath = _textureName != "" ? DATA_PATH + "/texture/" + _textureName : "";
+	std::string bumpmapPath = _textureName != "" && _bumpmapName != "" ? DATA_PATH + "/texture/" + _bumpmapName : "";
+	_convexRenderSwitch->setStateSet(MaterialCache::Instance()->getStateSet(texturePath, bumpmapPath, MaterialCache::DEFAULT));
+	initVisualSpin(bumpmapPath != "");
+}
+
+
+/**
+ * \brief Attach the uniform of the visual spin to the transformation-node (see isVisualSpin()). Without the
+ *        bumpmap-shader or with a shared instanced model, the object is rotated by the simulation again.
+ *
+ * \param hasShader
+ *      True if the state-set of the model uses the bumpmap-shader.
+ */
+void SpaceObject::initVisualSpin(bool hasShader) {
+	if (!_isVisualSpin || IS_HEADLESS) {
+		return;
+	}
+
+	if (!hasShader || _instancedModel.valid() || _isLazyNodes || !_transformation.valid()) {
+		LOG_WARNING("The visual spin needs the bumpmap-shader (texture and bumpmap) on an own model, the object is rotated by the simulation.");
+		_isVisualSpin = false;
+		return;
 	}
 
-	// Define material-properties
-	osg::ref_ptr<osg::Material> material = new osg::Material();
-	material->setDiffuse(osg::Material::FRONT, osg::Vec4(1.0, 1.0, 1.0, 1.0));
-	material->setSpecular(osg::Material::FRONT, osg::Vec4(0.0, 0.0, 0.0, 1.0));
-	material->setAmbient(osg::Material::FRONT, osg::Vec4f(0.4f, 0.4f, 0.4f, 1.0f));
-	material->setEmission(osg::Material::FRONT, osg::Vec4(0.0, 0.0, 0.0, 1.0));
-	material->setShininess(osg::Material::FRONT, 100);
-	stateset->setAttribute(material);
+	_spinOrientation = _orientation;
+	_spinBase = _orientation;
+	_renderedSpin = Eigen::Vector3d::Zero();
+
+	// overrides the uniform without spin of the shared state-set below
+	_spinUniform = new osg::Uniform("spin", osg::Vec4(0.0f, 0.0f, 0.0f, 0.0f));
+	_spinUniform->setDataVariance(osg::Object::DYNAMIC);
+	_transformation->getOrCreateStateSet()->addUniform(_spinUniform.get(), osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE);
+}
+
+
+/**
+ * \brief Update the uniform of the visual spin when the angular velocity changed (the rotation so far is
+ *        kept in the orientation of the transformation-node, so the model does not jump).
+ *
+ * \param orientation
+ *      Orientation of the object (only changed from outside the integration, e.g. by a checkpoint).
+ *
+ * \return Orientation of the transformation-node.
+ */
+osg::Quat SpaceObject::applyVisualSpin(const osg::Quat &orientation) {
+	float time = MaterialCache::Instance()->getSpinTime();
+
+	// the orientation was set (e.g. by a checkpoint) => the spin starts again from it
+	if ((orientation - _spinOrientation).length2() > 1e-12) {
+		_spinOrientation = orientation;
+		_spinBase = orientation;
+		_renderedSpin = Eigen::Vector3d::Zero();
+		_spinUniform->set(osg::Vec4(0.0f, 0.0f, 0.0f, time));
+	}
+
+	if (_angularVelocity == _renderedSpin) {
+		return _spinBase;
+	}
+
+	double rate = _renderedSpin.norm();
+	if (rate > 0.0) {
+		_spinBase = _spinBase * osg::Quat(rate * (time - _spinStart), toOsg(_renderedSpin / rate));
+	}
+	_renderedSpin = _angularVelocity;
+	_spinStart = time;
+
+	// the shader rotates the model before the transformation => axis in the model-space
+	osg::Vec3 axis = _spinBase.inverse() * toOsg(_angularVelocity);
+	_spinUniform->set(osg::Vec4(axis, time));
+
+	return _spinBase;
 }
 
 
@@ -316,6 +750,25 @@ void SpaceObject::initTexturing() {
  *      Width of the ribbon.
  */
 void SpaceObject::initFollowingRibbon(osg::Vec3 color, unsigned int numPoints, float halfWidth) {
+	if (IS_HEADLESS) {
+		return;
+	}
+
+	// the shared trail-system samples the position in applyTransformation()
+	if (TrailSystem::getIsEnabled()) {
+		_trail = TrailSystem::Instance()->addTrail(toOsg(_position), color, numPoints / 2, halfWidth);
+		return;
+	}
+
+	// the ribbon samples the transformation-node => the nodes are kept from now on
+	if (_isLazyNodes) {
+		if (!_isNodeBuilt.load(std::memory_order_relaxed)) {
+			initNodes();
+			_isNodeBuilt.store(true, std::memory_order_relaxed);
+		}
+		_isLazyNodes = false;
+	}
+
 	FollowingRibbon* ribbon = new FollowingRibbon();
 	osg::Geometry* geometry = ribbon->init(toOsg(_position), color, numPoints, halfWidth);
 
@@ -325,6 +778,10 @@ void SpaceObject::initFollowingRibbon(osg::Vec3 color, unsigned int numPoints, f
 	geode->getOrCreateStateSet()->setMode(GL_BLEND, osg::StateAttribute::ON);
 	geode->getOrCreateStateSet()->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
 
+	// the fading is computed from the head of the ring-buffer
+	RibbonShader ribbonShader(color, ribbon->getNumSegments(), ribbon->getHeadUniform());
+	ribbonShader.apply(geode);
+
 	_transformation->addUpdateCallback(new TrailerCallback(ribbon, geometry));
 	_modelRoot->addChild(geode);
 }
@@ -7,19 +7,30 @@
 
 #pragma once
 
+#include <cstdint>
+#include <atomic>
 #include <Eigen/Core>
 #include <osg/Switch>
 #include <osg/MatrixTransform>
+#include <osg/Uniform>
 #include <osg/BoundingBox>
-#include <osg/ShapeDrawable>
+#include <OpenThreads/Mutex>
 #include <json.hpp>
 
+#include "../osg/InstancedModel.h"
 #include "../osg/visitors/BoundingBoxVisitor.h"
 #include "../graphics/ConvexHull3D.h"
+#include "../graphics/SoaVertices.h"
 
 using json = nlohmann::json;
 
 
+// forward declarations
+namespace pbs17 {
+	class BodyPool;
+}
+
+
 namespace pbs17 {
 
 	/**
@@ -27,6 +38,17 @@ namespace pbs17 {
 	 */
 	class SpaceObject {
 	public:
+		/**
+		 * \brief Shape which is used by the narrow-phase.
+		 */
+		enum ShapeType {
+			//! Convex-hull of the model (GJK/EPA)
+			CONVEX_HULL = 0,
+			//! Sphere (only planets, the radius is known)
+			SPHERE = 1
+		};
+
+
 		/**
 		 * \brief Constructor of SpaceObject.
 		 *
@@ -34,7 +56,7 @@ namespace pbs17 {
 		 *      Relative location to the object-file. (Relative from the data-directory in the source).
 		 */
 		SpaceObject(std::string filename, int i);
-		SpaceObject(json j);
+		SpaceObject(const json &j);
 
 
 		/**
@@ -97,7 +119,8 @@ namespace pbs17 {
 		/**
 		 * \brief Get the osg-node which contains the switch for the real-model and convex-hull-model.
 		 * 
-		 * \return OSG-node which contains the rendering-model and convex-hull-model.
+		 * \return OSG-node which contains the rendering-model and convex-hull-model (nullptr while lazy nodes
+		 *         aren't built, see showConvexHull()).
 		 */
 		osg::ref_ptr<osg::Switch> getConvexSwitch() const {
 			return _convexRenderSwitch;
@@ -117,11 +140,195 @@ namespace pbs17 {
 		/**
 		 * \brief Get the AABB of the space-object.
 		 */
-		osg::BoundingBox getAABB() const {
+		const osg::BoundingBox& getAABB() const {
 			return _aabbGlobal;
 		}
 
 
+		/**
+		 * \brief Get the AABB of the space-object swept back over its displacement of the last step (equals the
+		 *        AABB if the object is not checked continuously). Used by the broad-phase.
+		 */
+		osg::BoundingBox getSweptAABB() const {
+			osg::BoundingBox swept = _aabbGlobal;
+			osg::Vec3 sweep(_sweep.x(), _sweep.y(), _sweep.z());
+
+			swept.expandBy(_aabbGlobal._min - sweep);
+			swept.expandBy(_aabbGlobal._max - sweep);
+
+			return swept;
+		}
+
+
+		/**
+		 * \brief Get the displacement of the last step which is checked continuously.
+		 *
+		 * \return Displacement (zero if the object is only checked at the end of the step).
+		 */
+		const Eigen::Vector3d& getSweep() const {
+			return _sweep;
+		}
+
+
+		/**
+		 * \brief Set the displacement of the last step which is checked continuously.
+		 *
+		 * \param sweep
+		 *      Displacement (zero => only checked at the end of the step).
+		 */
+		void setSweep(const Eigen::Vector3d &sweep) {
+			_sweep = sweep;
+		}
+
+
+		/**
+		 * \brief Check if the object is always checked continuously (e.g. fast projectiles).
+		 *
+		 * \return True if the object is checked continuously.
+		 */
+		bool isContinuous() const {
+			return _isContinuous;
+		}
+
+
+		/**
+		 * \brief Set if the object is always checked continuously. Other objects are only checked continuously
+		 *        if they move far compared to their size.
+		 *
+		 * \param isContinuous
+		 *      True to check the object continuously.
+		 */
+		void setContinuous(const bool isContinuous) {
+			_isContinuous = isContinuous;
+		}
+
+
+		/**
+		 * \brief Check if the object is a test-particle: it only feels the gravity of the massive sources (and of the
+		 *        test-particles nearby), but does not attract the sources itself (see SpatialGrid::setUseTestParticles()).
+		 *
+		 * \return True if the object is a test-particle.
+		 */
+		bool isTestParticle() const {
+			return _isTestParticle;
+		}
+
+
+		/**
+		 * \brief Set if the object is a test-particle (e.g. a light asteroid around a sun).
+		 *
+		 * \param isTestParticle
+		 *      True if the object does not attract the massive sources.
+		 */
+		void setTestParticle(const bool isTestParticle) {
+			_isTestParticle = isTestParticle;
+		}
+
+
+		/**
+		 * \brief Check if the rotation of the object has no physical effect (e.g. a planet with an isotropic inertia
+		 *        in a scene with only gravity): its orientation is not integrated by the simulation, the bumpmap-shader
+		 *        rotates the model by the angular velocity and the simulated time instead (scene-json: "visualSpin").
+		 *
+		 * \return True if the object only spins visually.
+		 */
+		bool isVisualSpin() const {
+			return _isVisualSpin;
+		}
+
+
+		/**
+		 * \brief Check if the object merges with the other mergeable objects it hits (see MergeManager).
+		 *
+		 * \return False if the object always bounces (scene-json: "merge": false).
+		 */
+		bool isMergeable() const {
+			return _isMergeable;
+		}
+
+
+		/**
+		 * \brief Set if the object merges with the other mergeable objects it hits.
+		 *
+		 * \param isMergeable
+		 *      False if the object always bounces.
+		 */
+		void setMergeable(const bool isMergeable) {
+			_isMergeable = isMergeable;
+		}
+
+
+		/**
+		 * \brief Get the collision-groups of the object (bits of the layers it belongs to).
+		 *
+		 * \return Groups of the object (scene-json: "collisionGroup", default 1).
+		 */
+		uint32_t getCollisionGroup() const {
+			return _collisionGroup;
+		}
+
+
+		/**
+		 * \brief Get the collision-mask of the object (bits of the groups it collides with).
+		 *
+		 * \return Mask of the object (scene-json: "collisionMask", default all groups).
+		 */
+		uint32_t getCollisionMask() const {
+			return _collisionMask;
+		}
+
+
+		/**
+		 * \brief Set the collision-groups and the mask of the object, e.g. a group whose mask does not contain
+		 *        its own bit (debris) never collides within itself.
+		 *
+		 * \param group
+		 *      Bits of the layers the object belongs to.
+		 * \param mask
+		 *      Bits of the groups it collides with.
+		 */
+		void setCollisionFilter(const uint32_t group, const uint32_t mask) {
+			_collisionGroup = group;
+			_collisionMask = mask;
+		}
+
+
+		/**
+		 * \brief Check if two objects may collide: each one has to be in a group of the mask of the other one and
+		 *        they must not be fused into the same rigid cluster. Checked by the broad-phase before a pair is reported.
+		 *
+		 * \param o1, o2
+		 *      Objects of the pair.
+		 *
+		 * \return False if the pair is filtered.
+		 */
+		static bool canCollide(const SpaceObject *o1, const SpaceObject *o2) {
+			return (o1->_collisionGroup & o2->_collisionMask) != 0 && (o2->_collisionGroup & o1->_collisionMask) != 0
+				&& (o1->_clusterId < 0 || o1->_clusterId != o2->_clusterId);
+		}
+
+
+		/**
+		 * \brief Get the rigid cluster the object is fused into (see ClusterManager).
+		 *
+		 * \return Id of the cluster (-1 => moves on its own).
+		 */
+		long getClusterId() const {
+			return _clusterId;
+		}
+
+
+		/**
+		 * \brief Fuse the object into a rigid cluster or release it from its cluster.
+		 *
+		 * \param clusterId
+		 *      Id of the cluster (-1 => moves on its own).
+		 */
+		void setClusterId(const long clusterId) {
+			_clusterId = clusterId;
+		}
+
+
 		/**
 		 * \brief Get the ID of the object.
 		 *
@@ -132,6 +339,36 @@ namespace pbs17 {
 		}
 
 
+		/**
+		 * \brief Get the texture of the object.
+		 *
+		 * \return Filename of the texture relative to the texture-directory ("" => not textured).
+		 */
+		std::string getTextureName() const {
+			return _textureName;
+		}
+
+
+		/**
+		 * \brief Get the instanced model which draws the object.
+		 *
+		 * \return Instanced model (nullptr => drawn by the own subtree).
+		 */
+		InstancedModel* getInstancedModel() const {
+			return _instancedModel.get();
+		}
+
+
+		/**
+		 * \brief Get the index of the instance in the instanced model.
+		 *
+		 * \return Index of the instance.
+		 */
+		unsigned int getInstance() const {
+			return _instance;
+		}
+
+
 		/**
 		 * \brief Get the mass of the object.
 		 * 
@@ -142,12 +379,43 @@ namespace pbs17 {
 		}
 
 
+		/**
+		 * \brief Set the mass of the object (e.g. after it absorbed another object).
+		 *
+		 * \param mass
+		 *      New mass: unit = kg
+		 */
+		void setMass(const double mass) {
+			_mass = mass;
+		}
+
+
+		/**
+		 * \brief Get the scaling of the model.
+		 *
+		 * \return Scaling of the model (1.0 => not scaled).
+		 */
+		double getScaling() const {
+			return _scaling;
+		}
+
+
+		/**
+		 * \brief Scale the object around its center by a factor (e.g. after it absorbed another object). The AABB,
+		 *        the bounding-radius and the convex-hull are scaled at once, the OSG-nodes by the next sync-pass.
+		 *
+		 * \param factor
+		 *      Factor of the scaling (1.0 => unchanged).
+		 */
+		virtual void grow(double factor);
+
+
 		/**
 		 * \brief Get the position of the object.
 		 * 
 		 * \return Position of the object.
 		 */
-		Eigen::Vector3d getPosition() const {
+		const Eigen::Vector3d& getPosition() const {
 			return _position;
 		}
 
@@ -158,7 +426,7 @@ namespace pbs17 {
 		 * \param newPosition
 		 *	    New position of the object.
 		 */
-		void setPosition(Eigen::Vector3d newPosition);
+		void setPosition(const Eigen::Vector3d &newPosition);
 
 
 		/**
@@ -166,7 +434,7 @@ namespace pbs17 {
 		 * 
 		 * \return Linear velocity of the object.
 		 */
-		Eigen::Vector3d getLinearVelocity() const {
+		const Eigen::Vector3d& getLinearVelocity() const {
 			return _linearVelocity;
 		}
 
@@ -177,7 +445,7 @@ namespace pbs17 {
 		 * \param v
 		 *      Linear velocity of the object.
 		 */
-		void setLinearVelocity(Eigen::Vector3d v) {
+		void setLinearVelocity(const Eigen::Vector3d &v) {
 			_linearVelocity = v;
 		}
 
@@ -187,28 +455,44 @@ namespace pbs17 {
 		 * 
 		 * \return Moment of inertia of the object.
 		 */
-		Eigen::Matrix3d getMomentOfInertia() const {
+		const Eigen::Matrix3d& getMomentOfInertia() const {
 			return _momentOfInertia;
 		}
 
 
 		/**
-		 * \brief Set the moment of inertia of the object.
+		 * \brief Set the moment of inertia of the object (and its inverse).
 		 * 
 		 * \param m
 		 *      New moment of inertia-matrix of the object.
 		 */
-		void setMomentOfInertia(Eigen::Matrix3d m) {
-			_momentOfInertia = m;
+		void setMomentOfInertia(const Eigen::Matrix3d &m);
+
+
+		/**
+		 * \brief Get the inverse moment of inertia of the object.
+		 *
+		 * \return Inverse moment of inertia of the object (in the local coordinate system).
+		 */
+		const Eigen::Matrix3d& getInverseMomentOfInertia() const {
+			return _inverseMomentOfInertia;
 		}
 
 
+		/**
+		 * \brief Get the inverse moment of inertia rotated into the world-space with the current orientation.
+		 *
+		 * \return Inverse moment of inertia in world-coordinates (R * I^-1 * R^T).
+		 */
+		Eigen::Matrix3d getWorldInverseMomentOfInertia() const;
+
+
 		/**
 		 * \brief Get the angular velocity of the object.
 		 * 
 		 * \return Angular velocity of the object.
 		 */
-		Eigen::Vector3d getAngularVelocity() const {
+		const Eigen::Vector3d& getAngularVelocity() const {
 			return _angularVelocity;
 		}
 
@@ -219,7 +503,7 @@ namespace pbs17 {
 		 * \param av
 		 *      New angular velocity of the object.
 		 */
-		void setAngularVelocity(Eigen::Vector3d av) {
+		void setAngularVelocity(const Eigen::Vector3d &av) {
 			_angularVelocity = av;
 		}
 
@@ -229,7 +513,7 @@ namespace pbs17 {
 		 * 
 		 * \return Orientation of the object.
 		 */
-		osg::Quat getOrientation() const {
+		const osg::Quat& getOrientation() const {
 			return _orientation;
 		}
 
@@ -242,6 +526,151 @@ namespace pbs17 {
 		 *      New orientation of the object.
 		 */
         virtual void updatePositionOrientation(Eigen::Vector3d newPosition, osg::Quat newOrientation);
+
+
+		/**
+		 * \brief Set the position and orientation of the space-object without touching the OSG-nodes
+		 *        (so it can be called from the physics-thread). The AABB is updated as well.
+		 *
+		 * \param newPosition
+		 *      New position of the object.
+		 * \param newOrientation
+		 *      New orientation of the object.
+		 */
+		void setPositionOrientation(const Eigen::Vector3d &newPosition, const osg::Quat &newOrientation);
+
+
+		/**
+		 * \brief Write the current state (position, orientation, AABB and collision-state) to the OSG-nodes.
+		 */
+		void updateTransformation();
+
+
+		/**
+		 * \brief Check if the state changed since it was written to the OSG-nodes by updateTransformation(), so the
+		 *        sync-pass can skip the unchanged objects (e.g. sleeping ones) without dirtying their bounds.
+		 *
+		 * \return True if the OSG-nodes are outdated.
+		 */
+		bool isTransformationDirty() const {
+			return _isTransformationDirty || _collisionState != _renderedCollisionState || _isNodeRequested.load(std::memory_order_relaxed);
+		}
+
+
+		/**
+		 * \brief Show the convex-hull or the model of the object (the nodes of a lazy object are built with the
+		 *        selected representation).
+		 *
+		 * \param isShown
+		 *      True if the convex-hull is drawn instead of the model.
+		 */
+		void showConvexHull(bool isShown);
+
+
+		/**
+		 * \brief Report that the root-node passed the view-frustum (called by the cull-traversal, see LazyNodeCallback),
+		 *        the nodes of a lazy object are built by the next sync-pass.
+		 */
+		void markVisible();
+
+
+		/**
+		 * \brief Get the bound of the root-node while the nodes of a lazy object aren't built (see LazyNodeBound).
+		 *
+		 * \return Bounding-sphere of the last rendered AABB (invalid while the object is hidden).
+		 */
+		osg::BoundingSphere getRenderedBound() const {
+			return _isRenderedActive ? _renderedBound : osg::BoundingSphere();
+		}
+
+
+
+		/**
+		 * \brief Set the index of the object in the spatial cells (it's moved between the cells by the sync-pass).
+		 *
+		 * \param cell
+		 *      Index of the object in the spatial cells.
+		 */
+		void setCell(int cell) {
+			_cell = cell;
+		}
+
+
+		/**
+		 * \brief Let the next sync-pass write the OSG-nodes, e.g. after the convex-hull was toggled (the instance of
+		 *        the model is hidden while the convex-hull is shown).
+		 */
+		void setTransformationDirty() {
+			_isTransformationDirty = true;
+		}
+
+
+		/**
+		 * \brief Check if the object is simulated.
+		 *
+		 * \return False if the object is not part of the simulation (e.g. broken into its fragments).
+		 */
+		bool isActive() const {
+			return _isActive;
+		}
+
+
+		/**
+		 * \brief Add the object to the simulation or remove it, the next sync-pass shows or hides its OSG-nodes.
+		 *
+		 * \param isActive
+		 *      True if the object is simulated.
+		 */
+		void setActive(const bool isActive) {
+			_isActive = isActive;
+			_isTransformationDirty = true;
+		}
+
+
+		/**
+		 * \brief Get the pool which owns the object.
+		 *
+		 * \return Pool of the object (nullptr => owned by the scene-manager).
+		 */
+		BodyPool* getPool() const {
+			return _pool;
+		}
+
+
+		/**
+		 * \brief Set the pool which owns the object (see BodyPool::add()).
+		 *
+		 * \param pool
+		 *      Pool of the object.
+		 */
+		void setPool(BodyPool* pool) {
+			_pool = pool;
+		}
+
+
+		/**
+		 * \brief Show or hide the OSG-nodes of the object (has to be called from the rendering-thread before
+		 *        applyTransformation()).
+		 *
+		 * \param isActive
+		 *      True if the object is simulated.
+		 */
+		void applyActive(bool isActive);
+
+
+		/**
+		 * \brief Write the given state to the OSG-nodes (has to be called from the rendering-thread).
+		 *
+		 * \param position
+		 *      Position of the object.
+		 * \param orientation
+		 *      Orientation of the object.
+		 * \param aabb
+		 *      Global AABB of the object.
+		 * \param collisionState
+		 *      Collision-state of the object (colour of the AABB).
+		 */
+		virtual void applyTransformation(const osg::Vec3d &position, const osg::Quat &orientation, const osg::BoundingBox &aabb, int collisionState);
         
 
 		/**
@@ -252,13 +681,34 @@ namespace pbs17 {
 
 
 		/**
-		 * \brief Update the AABB. Here, only the 8 corners of the original AABB are
-		 * rotated/translated correctly to speed up the calculateion. (to calculate the
-		 * bounding box for each time step correclty over all vertices is too time consuming).
+		 * \brief Update the AABB from the local AABB (the box around the 8 rotated/translated corners, to calculate the
+		 * bounding box for each time step correclty over all vertices is too time consuming). The extent of the rotated box
+		 * is |R| * halfExtent (Arvo), objects with a bounding-sphere are only translated.
 		 */
 		void updateAABB();
 
 
+		/**
+		 * \brief Set the radius of a bounding-sphere around the center of the local AABB for rotation-invariant
+		 *        shapes (e.g. planets), so the AABB is not enlarged by the rotation.
+		 *
+		 * \param radius
+		 *      Radius of the bounding-sphere (<= 0.0 => the local AABB is rotated).
+		 */
+		void setBoundingRadius(const double radius) {
+			_boundingRadius = radius;
+		}
+
+
+		/**
+		 * \brief Get the radius of the sphere which replaces the shape of the object while it's far from the region
+		 *        of interest (see CollisionManager::setLevelOfDetail()).
+		 *
+		 * \return Radius of the bounding-sphere, or the mean half-extent of the local AABB.
+		 */
+		double getCoarseRadius() const;
+
+
 		/**
 		 * \brief Reset the collision state to 0. Usually before each frame.
 		 */
@@ -278,11 +728,179 @@ namespace pbs17 {
 
 
 		/**
-		 * \brief Get the convex hull with the correct global-vertex positions.
+		 * \brief Get the collision state of the object.
+		 *
+		 * \return Collision-state (0 = no collision, 1 = collision possible, 2 = collision for sure).
+		 */
+		int getCollisionState() const {
+			return _collisionState;
+		}
+
+
+		/**
+		 * \brief Check if the object is sleeping (at rest and not integrated, see NBodyManager::setUseSleeping()).
+		 *
+		 * \return True if the object is sleeping.
+		 */
+		bool isSleeping() const {
+			return _isSleeping;
+		}
+
+
+		/**
+		 * \brief Set if the object is sleeping (e.g. wake it up after a contact).
+		 *
+		 * \param isSleeping
+		 *      True if the object is sleeping.
+		 */
+		void setSleeping(const bool isSleeping) {
+			_isSleeping = isSleeping;
+		}
+
+
+		/**
+		 * \brief Set the headless-mode: Only the physics-representation (mass, convex-hull, inertia) is built,
+		 *        textures, shaders, ribbons and simplified models are skipped. Has to be set before loading the scene.
+		 *
+		 * \param isHeadless
+		 *      True if the objects are never rendered.
+		 */
+		static void setIsHeadless(const bool isHeadless) {
+			IS_HEADLESS = isHeadless;
+		}
+
+
+		/**
+		 * \brief Get the headless-mode.
+		 *
+		 * \return True if the objects are never rendered.
+		 */
+		static bool getIsHeadless() {
+			return IS_HEADLESS;
+		}
+
+
+		/**
+		 * \brief Build the OSG-nodes of the asteroids only once they pass the view-frustum and release them after
+		 *        they were culled for RELEASE_TIME. Has to be set before loading the scene.
+		 *
+		 * \param isLazyNodes
+		 *      True if the nodes are built when they are visible.
+		 */
+		static void setIsLazyNodes(const bool isLazyNodes) {
+			IS_LAZY_NODES = isLazyNodes;
+		}
+
+
+		/**
+		 * \brief Check if the OSG-nodes of the asteroids are built when they are visible.
+		 *
+		 * \return True if the nodes are built when they are visible.
+		 */
+		static bool getIsLazyNodes() {
+			return IS_LAZY_NODES;
+		}
+
+
+		/**
+		 * \brief Get the convex hull with the correct global-vertex positions. The vertices are only
+		 * transformed again if the object has been moved since the last call.
 		 * 
 		 * \return List of vertices of the convex-hull in the global-world-space.
 		 */
-		std::vector<Eigen::Vector3d> getConvexHull() const;
+		const std::vector<Eigen::Vector3d>& getConvexHull();
+
+
+		/**
+		 * \brief Get the shape which is used by the narrow-phase.
+		 * 
+		 * \return Shape-type of the object.
+		 */
+		ShapeType getShapeType() const {
+			return _shapeType;
+		}
+
+
+		/**
+		 * \brief Get the convex-hull in the unscaled model-space (with the adjacency of the vertices).
+		 * 
+		 * \return Convex-hull of the object.
+		 */
+		const ConvexHull3D* getConvexHullModel() const {
+			const ConvexHull3D* hull = _convexHull.load(std::memory_order_acquire);
+			return hull ? hull : loadConvexHullModel();
+		}
+
+
+		/**
+		 * \brief Transform the vertices of the convex-hull to the global-world-space if the object has been moved.
+		 * Call this before the convex-hull is read concurrently (getConvexHull() is then only reading).
+		 */
+		void updateConvexHull();
+
+
+		/**
+		 * \brief Get the coarse level of the convex-hull with the global-vertex positions (see
+		 * ConvexHull3D::getCoarseVertices()). The vertices are only transformed again if the object has been moved.
+		 * 
+		 * \return List of vertices of the coarse convex-hull in the global-world-space.
+		 */
+		const std::vector<Eigen::Vector3d>& getCoarseHull();
+
+
+		/**
+		 * \brief Get the single precision copy of the global convex-hull for the vectorized support-queries
+		 * (only up to date after updateConvexHull()).
+		 * 
+		 * \return Vertices of the convex-hull relative to the position.
+		 */
+		const SoaVertices* getConvexHullSoa() const {
+			return &_convexHullSoa;
+		}
+
+
+		/**
+		 * \brief Get a convex part of a compound with the global-vertex positions (see ConvexHull3D::getParts(), only
+		 * up to date after updateConvexHull()).
+		 * 
+		 * \param part
+		 *      Index of the part.
+		 * 
+		 * \return List of vertices of the part in the global-world-space.
+		 */
+		const std::vector<Eigen::Vector3d>& getPartHull(int part) const {
+			return _partHullsGlobal[part];
+		}
+
+
+		/**
+		 * \brief Get the single precision copy of a global part of a compound (only up to date after updateConvexHull()).
+		 * 
+		 * \param part
+		 *      Index of the part.
+		 * 
+		 * \return Vertices of the part relative to the position.
+		 */
+		const SoaVertices* getPartHullSoa(int part) const {
+			return &_partHullsSoa[part];
+		}
+
+
+		/**
+		 * \brief Get the single precision copy of the global coarse convex-hull (only up to date after updateCoarseHull()).
+		 * 
+		 * \return Vertices of the coarse convex-hull relative to the position.
+		 */
+		const SoaVertices* getCoarseHullSoa() const {
+			return &_coarseHullSoa;
+		}
+
+
+		/**
+		 * \brief Transform the vertices of the coarse convex-hull to the global-world-space if the object has been moved.
+		 * Call this before the coarse convex-hull is read concurrently.
+		 */
+		void updateCoarseHull();
 
 
 		/**
@@ -291,6 +909,28 @@ namespace pbs17 {
 		virtual void initTexturing();
 
 
+		/**
+		 * \brief Attach the uniform of the visual spin to the transformation-node (see isVisualSpin()). Without the
+		 *        bumpmap-shader or with a shared instanced model, the object is rotated by the simulation again.
+		 *
+		 * \param hasShader
+		 *      True if the state-set of the model uses the bumpmap-shader.
+		 */
+		void initVisualSpin(bool hasShader);
+
+
+		/**
+		 * \brief Update the uniform of the visual spin when the angular velocity changed (the rotation so far is
+		 *        kept in the orientation of the transformation-node, so the model does not jump).
+		 *
+		 * \param orientation
+		 *      Orientation of the object (only changed from outside the integration, e.g. by a checkpoint).
+		 *
+		 * \return Orientation of the transformation-node.
+		 */
+		osg::Quat applyVisualSpin(const osg::Quat &orientation);
+
+
 		/**
 		 * \brief Initialize the geometry for the ribbon which follows the object to see
 		 * the object's trace.
@@ -304,6 +944,14 @@ namespace pbs17 {
 		 */
 		void initFollowingRibbon(osg::Vec3 color, unsigned int numPoints, float halfWidth);
 
+
+		/**
+		 * \brief Get the memory of the global copies of the convex-hulls (counted by the MemoryTracker).
+		 *
+		 * \return Memory in bytes.
+		 */
+		long long getHullCopySize() const;
+
 	protected:
 
 		//! Filename of the loaded object
@@ -320,10 +968,18 @@ namespace pbs17 {
 		osg::ref_ptr<osg::Switch> _modelRoot;
 		osg::ref_ptr<osg::Switch> _convexRenderSwitch;
 		osg::ref_ptr<osg::Node> _modelFile;
-		osg::ref_ptr<osg::MatrixTransform> _aabbRendering;
-		osg::ref_ptr<osg::ShapeDrawable> _aabbShape;
 		//! Local-rotation-node for the object
 		osg::ref_ptr<osg::MatrixTransform> _transformation;
+		//! Instanced model which draws the object (nullptr => drawn by the own subtree)
+		osg::ref_ptr<InstancedModel> _instancedModel;
+		//! Index of the instance in the instanced model
+		unsigned int _instance = 0;
+		//! Index of the trail in the trail-system (-1 => own following-ribbon or none)
+		int _trail = -1;
+		//! Index of the box in the debug-overlay (-1 => headless)
+		int _debugBox = -1;
+		//! Index of the object in the spatial cells (-1 => the model is not grouped by its position)
+		int _cell = -1;
 
 		//! Scaling ratio
 		double _scaling = 1.0;
@@ -336,8 +992,49 @@ namespace pbs17 {
 		osg::BoundingBox _aabbGlobal;
 		osg::BoundingBox _aabbLocalOrig;
 		osg::BoundingBox _aabbGlobalOrig;
-		//! ConvexHull of the object
-		ConvexHull3D* _convexHull = nullptr;
+		//! Radius of the bounding-sphere of rotation-invariant shapes (<= 0.0 => the local AABB is rotated)
+		double _boundingRadius = 0.0;
+		//! Shape which is used by the narrow-phase
+		ShapeType _shapeType = CONVEX_HULL;
+		//! ConvexHull of the unscaled model (shared by all instances of the model, owned by the ModelManager)
+		mutable std::atomic<const ConvexHull3D*> _convexHull { nullptr };
+		//! Model of a lazily loaded convex-hull ("" => set during the initialization, see setLazyConvexHull())
+		std::string _convexHullPath;
+		bool _isConvexHullLod = false;
+		//! Geode of the rendered convex-hull which is filled once the lazy hull is loaded
+		osg::ref_ptr<osg::Geode> _convexHullGeode;
+		//! True if the convex-hull is drawn instead of the model
+		bool _isConvexHullShown = false;
+		//! True if the nodes below the root-node are built once the object is visible (see initLazyNodes())
+		bool _isLazyNodes = false;
+		std::atomic<bool> _isNodeBuilt { false };
+		//! Written by the cull-traversal: the root-node was visible (the nodes are built by the next sync-pass)
+		std::atomic<bool> _isNodeRequested { false };
+		std::atomic<double> _lastVisibleTime { 0.0 };
+		//! Bound of the root-node while the lazy nodes aren't built (written by the sync-pass)
+		osg::BoundingSphere _renderedBound;
+		//! Vertices of the convex-hull in the global-world-space (cache of getConvexHull())
+		std::vector<Eigen::Vector3d> _convexHullGlobal;
+		//! True if the object has been moved since the global convex-hull was computed
+		bool _isConvexHullDirty = true;
+		//! Vertices of the coarse convex-hull in the global-world-space (cache of getCoarseHull())
+		std::vector<Eigen::Vector3d> _coarseHullGlobal;
+		//! True if the object has been moved since the global coarse convex-hull was computed
+		bool _isCoarseHullDirty = true;
+		//! Single precision copies of the global convex-hulls (relative to the position)
+		SoaVertices _convexHullSoa;
+		SoaVertices _coarseHullSoa;
+		//! Vertices of the parts of a compound in the global-world-space and their single precision copies
+		std::vector<std::vector<Eigen::Vector3d> > _partHullsGlobal;
+		std::vector<SoaVertices> _partHullsSoa;
+		//! True if the position or orientation changed since the OSG-nodes were updated
+		bool _isTransformationDirty = true;
+		//! True if the object is simulated (false => e.g. broken into fragments)
+		bool _isActive = true;
+		//! Activity which was last written to the OSG-nodes
+		bool _isRenderedActive = true;
+		//! Pool which owns the object (nullptr => owned by the scene-manager)
+		BodyPool* _pool = nullptr;
 
 		//! Mass: unit = kg
 		double _mass = 1.0;
@@ -347,6 +1044,8 @@ namespace pbs17 {
 		Eigen::Vector3d _angularVelocity;
 		//! Moment of inertia tensor (N.B. It is in the local coordinate system)
 		Eigen::Matrix3d _momentOfInertia;
+		//! Inverse of the moment of inertia tensor (local coordinate system, see setMomentOfInertia())
+		Eigen::Matrix3d _inverseMomentOfInertia;
 		//! Global force : unit = vector with norm equals to N
 		Eigen::Vector3d _force;
 		//! Global torque : unit = vector with norm equals to N*m(newton metre)
@@ -354,12 +1053,97 @@ namespace pbs17 {
 
 		//! Collision state of the object (0 = no collision, 1 = possible collision, 2 = collision for sure)
 		int _collisionState = 0;
+		//! Collision state which was last written to the OSG-nodes (-1 => not set yet)
+		int _renderedCollisionState = -1;
+		//! True if the object is at rest and its state is not changed by the simulation
+		bool _isSleeping = false;
+		//! True if the object is always checked continuously
+		bool _isContinuous = false;
+		//! True if the object is a test-particle (does not attract the massive sources)
+		bool _isTestParticle = false;
+		//! True if the orientation is not integrated, the shader spins the model instead
+		bool _isVisualSpin = false;
+		//! True if the object merges with the other mergeable objects it hits
+		bool _isMergeable = true;
+		//! Bits of the layers the object belongs to
+		uint32_t _collisionGroup = 1;
+		//! Bits of the groups the object collides with
+		uint32_t _collisionMask = 0xffffffff;
+		//! Rigid cluster the object is fused into (-1 => moves on its own, see ClusterManager)
+		long _clusterId = -1;
+		//! Scaling since the OSG-nodes were built (see grow(), applied by the transformation)
+		double _growth = 1.0;
+		//! Protects the scaling, which is set by the simulation and read by the rendering-thread
+		OpenThreads::Mutex _scalingMutex;
+		//! Displacement of the last step which is swept by the collision-detection
+		Eigen::Vector3d _sweep = Eigen::Vector3d::Zero();
+
+		//! Axis (model-space) times the rate and start-time of the visual spin (nullptr => rotated by the transformation)
+		osg::ref_ptr<osg::Uniform> _spinUniform;
+		//! Angular velocity which was last written to the uniform of the visual spin
+		Eigen::Vector3d _renderedSpin = Eigen::Vector3d::Zero();
+		//! Simulated time at which the angular velocity was written
+		float _spinStart = 0.0f;
+		//! Orientation of the object when the visual spin started
+		osg::Quat _spinOrientation;
+		//! Orientation of the transformation-node (the rotation of the visual spin up to _spinStart)
+		osg::Quat _spinBase;
+
+		/**
+		 * \brief Load the convex-hull of the model on the first use of getConvexHullModel() (instead of during the
+		 * initialization, most objects never reach the narrow-phase).
+		 *
+		 * \param modelPath
+		 *      Complete path to the model (see ModelManager::loadConvexHull()).
+		 * \param useLod
+		 *      True if simplified models should be used if the model is not loaded yet.
+		 *
+		 */
+		void setLazyConvexHull(std::string modelPath, bool useLod);
+
+
+		/**
+		 * \brief Build the transformation, the switch of the convex-hull and the texturing below the root-node
+		 *        (objects with lazy nodes call it from the sync-pass once they are visible).
+		 */
+		virtual void initNodes() {}
+
+
+		/**
+		 * \brief Build the nodes below the root-node only once the object is visible (see initNodes()).
+		 */
+		void initLazyNodes();
 
 
 	private:
 
+		/**
+		 * \brief Load the convex-hull which was deferred by setLazyConvexHull().
+		 *
+		 * \return Convex-hull of the object.
+		 */
+		const ConvexHull3D* loadConvexHullModel() const;
+
+
+		/**
+		 * \brief Build the lazy nodes of a visible object or release them if it was culled for RELEASE_TIME.
+		 *
+		 * \param aabb
+		 *      Global AABB of the object (bound of the root-node while the nodes aren't built).
+		 */
+		void updateLazyNodes(const osg::BoundingBox &aabb);
+
 		//! Running Id for uniquely identifying the objects.
 		static long RunningId;
+
+		//! True if only the physics-representation is built
+		static bool IS_HEADLESS;
+
+		//! True if the nodes of the asteroids are built when they are visible
+		static bool IS_LAZY_NODES;
+
+		//! Time (in seconds) after which the lazy nodes of a culled object are released
+		static const double RELEASE_TIME;
 	};
 
 }
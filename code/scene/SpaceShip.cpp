@@ -17,8 +17,8 @@
 #include "../osg/OsgEigenConversions.h"
 #include "../osg/Loader.h"
 #include "../osg/ModelManager.h"
-#include "../osg/visitors/ConvexHullVisitor.h"
 #include "../osg/particles/SmokeParticleSystem.h"
+#include "../osg/particles/GpuParticleSystem.h"
 
 using namespace pbs17;
 
@@ -37,6 +37,9 @@ SpaceShip::SpaceShip()
     Eigen::Vector3d torque = Eigen::Vector3d(0.0, 0.0, 0.0);;
 
     initPhysics(1.0, linearVelocity, angularVelocity, force, torque);
+
+    // the space-ship is fast enough to tunnel through asteroids
+    setContinuous(true);
 }
 
 
@@ -46,7 +49,7 @@ SpaceShip::SpaceShip()
  * \param j
  *      JSON-configuration for the space-ship.
  */
-SpaceShip::SpaceShip(json j) :
+SpaceShip::SpaceShip(const json &j) :
 	SpaceObject(j) {
 
 	Eigen::Vector3d pos = fromJson(j["position"]);
@@ -58,6 +61,9 @@ SpaceShip::SpaceShip(json j) :
 	Eigen::Vector3d torque = fromJson(j["torque"]);
 
 	initPhysics(j["mass"].get<double>(), linearVelocity, angularVelocity, force, torque);
+
+	// the space-ship is fast enough to tunnel through asteroids
+	setContinuous(true);
 }
 
 
@@ -91,39 +97,44 @@ void SpaceShip::initOsg(Eigen::Vector3d position, double ratio, double scaling)
 		_modelFile = Loader::scaleNode(_modelFile, scaling);
 	}
 
-	// Compute convex hull
-	osg::Matrix scalingMatrix = osg::Matrix::scale(_scaling, _scaling, _scaling);
-	ConvexHullVisitor convexHull(scalingMatrix);
-	_modelFile->accept(convexHull);
-	_convexHull = convexHull.getConvexHull();
+	// Get the convex hull (shared by all instances of the model, the scaling is applied to its vertices)
+	_convexHull = ModelManager::Instance()->loadConvexHull(modelPath, true);
 
 	osg::Geode* geodeConvexHull = new osg::Geode;
-	geodeConvexHull->addDrawable(_convexHull->getOsgModel());
+	geodeConvexHull->addDrawable(getConvexHullModel()->getOsgModel());
 
 	// Switch to decide if the convex hull or the model has to be rendered.
 	_convexRenderSwitch = new osg::Switch;
 	_convexRenderSwitch->addChild(_modelFile, true);
-	_convexRenderSwitch->addChild(geodeConvexHull, false);
+	_convexRenderSwitch->addChild(Loader::scaleNode(geodeConvexHull, _scaling), false);
 
 	// Transformation-node for position and rotation updates.
 	_transformation = new osg::MatrixTransform;
+	// written by the update-traversal while the previous frame may still be drawn (see SceneManager::initViewer())
+	_transformation->setDataVariance(osg::Object::DYNAMIC);
 	_transformation->setMatrix(osg::Matrix::translate(toOsg(position)));
 	_transformation->addChild(_convexRenderSwitch);
 
 	_particleRoot = new osg::MatrixTransform;
+	_particleRoot->setDataVariance(osg::Object::DYNAMIC);
 	_particleRoot->setMatrix(osg::Matrix::translate(toOsg(position)));
 
 	calculateAABB();
 
-	// Particle system
-	osg::ref_ptr<SmokeParticleSystem> smoke = new SmokeParticleSystem(_particleRoot, _particleRoot.get());
-
 	_modelRoot = new osg::Switch;
 	_modelRoot->addChild(_transformation, true);
-	_modelRoot->addChild(_aabbRendering, false);
-	_modelRoot->addChild(smoke, true);
 	_modelRoot->addChild(_particleRoot, true);
 
+	// Particle system: the exhaust is emitted into the shared GPU-particles (same parameters as the smoke)
+	if (GpuParticleSystem::getIsEnabled()) {
+		GpuParticleSystem::Emission exhaust;
+		exhaust.position = toOsg(position);
+		_emitter = GpuParticleSystem::Instance()->addEmitter(exhaust, 250.0f);
+	} else {
+		osg::ref_ptr<SmokeParticleSystem> smoke = new SmokeParticleSystem(_particleRoot, _particleRoot.get());
+		_modelRoot->addChild(smoke, true);
+	}
+
 	initTexturing();
 }
 
@@ -144,8 +155,7 @@ void SpaceShip::initOsg(Eigen::Vector3d position, double ratio, double scaling)
 void SpaceShip::initPhysics(double mass, Eigen::Vector3d linearVelocity, Eigen::Vector3d angularVelocity, Eigen::Vector3d force, Eigen::Vector3d torque) {
 	SpaceObject::initPhysics(mass, linearVelocity, angularVelocity, force, torque);
 
-	_momentOfInertia = Eigen::Matrix3d();
-	_momentOfInertia.setIdentity();
+	setMomentOfInertia(Eigen::Matrix3d::Identity());
 }
 
 
@@ -158,18 +168,35 @@ void SpaceShip::initPhysics(double mass, Eigen::Vector3d linearVelocity, Eigen::
  *      New orientation of the object.
  */
 void SpaceShip::updatePositionOrientation(Eigen::Vector3d newPosition, osg::Quat newOrientation) {
-	_position = newPosition;
-	_orientation = newOrientation;
+	// the local AABB does not change, so the vertices of the model are not traversed again
+	setPositionOrientation(newPosition, newOrientation);
+
+	// the nodes of the ship and of its engine are written by the same (overridden) sync as all other objects
+	updateTransformation();
+}
+
+
+/**
+ * \brief Write the given state to the OSG-nodes (incl. the particle-system of the engine).
+ *
+ * \param position
+ *      Position of the object.
+ * \param orientation
+ *      Orientation of the object.
+ * \param aabb
+ *      Global AABB of the object.
+ * \param collisionState
+ *      Collision-state of the object (colour of the AABB).
+ */
+void SpaceShip::applyTransformation(const osg::Vec3d &position, const osg::Quat &orientation, const osg::BoundingBox &aabb, int collisionState) {
+	SpaceObject::applyTransformation(position, orientation, aabb, collisionState);
 
 	osg::Matrixd rotation;
-	newOrientation.get(rotation);
-	osg::Matrixd translation = osg::Matrix::translate(toOsg(newPosition));
+	orientation.get(rotation);
 	osg::Matrixd localRotation = osg::Matrix::rotate(-90, osg::Y_AXIS);
 
-	_transformation->setMatrix(rotation * translation);
-	_particleRoot->setMatrix(localRotation * rotation * translation);
-
-	calculateAABB();
+	_particleRoot->setMatrix(localRotation * rotation * osg::Matrix::translate(position));
+	updateEmitter();
 }
 
 
@@ -183,6 +210,8 @@ void SpaceShip::updatePositionOrientation(Eigen::Vector3d newPosition, osg::Quat
  */
 void SpaceShip::updateDirectionOrientation(Eigen::Vector3d v, osg::Quat newOrientation) {
 	_orientation = newOrientation;
+	_isConvexHullDirty = true;
+	_isCoarseHullDirty = true;
 
 	osg::Matrixd rotation;
 	newOrientation.get(rotation);
@@ -191,10 +220,11 @@ void SpaceShip::updateDirectionOrientation(Eigen::Vector3d v, osg::Quat newOrien
 
 	_transformation->setMatrix(rotation * translation);
 	_particleRoot->setMatrix(localRotation * rotation * translation);
+	updateEmitter();
 
 	_linearVelocity = fromOsg(rotation).block(0, 0, 3, 3) * v;
 
-	calculateAABB();
+	updateAABB();
 }
 
 
@@ -298,3 +328,52 @@ void SpaceShip::decelerate() {
 
 	updateDirectionOrientation(Eigen::Vector3d(intensity, 0, 0), _orientation);
 }
+
+
+/**
+ * \brief Steer the space-ship continuously by the held controls over a time-step (called by the simulation,
+ *        the OSG-nodes are written by the next sync).
+ *
+ * \param pitch
+ *      Direction of the turn up (1) or down (-1), 0 => no turn.
+ * \param yaw
+ *      Direction of the turn left (1) or right (-1), 0 => no turn.
+ * \param throttle
+ *      Accelerate (1) or slow down (-1), 0 => same speed.
+ * \param dt
+ *      Time-step.
+ */
+void SpaceShip::steer(int pitch, int yaw, int throttle, double dt) {
+	// same axes as the discrete turns (up => y-axis, left => x-axis)
+	osg::Quat rotation = osg::Quat(pitch * _turnRate * dt, osg::Y_AXIS) * osg::Quat(yaw * _turnRate * dt, osg::X_AXIS);
+	osg::Quat newQ = rotation * getOrientation();
+
+	if (throttle > 0) {
+		intensity = std::min(intensity * exp(_accelerationRate * dt), 20.0);
+	} else if (throttle < 0) {
+		intensity = std::max(intensity * exp(-_decelerationRate * dt), 1.0);
+	}
+
+	// only the state is changed, the nodes of the ship and of its engine are written by the sync
+	setPositionOrientation(getPosition(), newQ);
+
+	osg::Matrixd matrix;
+	newQ.get(matrix);
+	_linearVelocity = fromOsg(matrix).block(0, 0, 3, 3) * Eigen::Vector3d(intensity, 0, 0);
+}
+
+
+/**
+ * \brief Move the emitter of the exhaust to the root-node of the particles (see GpuParticleSystem).
+ */
+void SpaceShip::updateEmitter() {
+	if (_emitter < 0) {
+		return;
+	}
+
+	// the smoke was shot along the z-axis of the root-node of the particles
+	const osg::Matrixd &matrix = _particleRoot->getMatrix();
+	osg::Vec3 direction = osg::Matrixd::transform3x3(osg::Vec3(osg::Z_AXIS), matrix);
+	direction.normalize();
+	GpuParticleSystem::Instance()->setEmitter(_emitter, matrix.getTrans(), direction);
+}
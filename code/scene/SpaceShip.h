@@ -29,7 +29,7 @@ namespace pbs17 {
 		 * \param j
 		 *      JSON-configuration for the spaceship.
 		 */
-		explicit SpaceShip(json j);
+		explicit SpaceShip(const json &j);
 
 
 		/**
@@ -89,6 +89,21 @@ namespace pbs17 {
 		void updatePositionOrientation(Eigen::Vector3d newPosition, osg::Quat newOrientation) override;
 
 
+		/**
+		 * \brief Write the given state to the OSG-nodes (incl. the particle-system of the engine).
+		 *
+		 * \param position
+		 *      Position of the object.
+		 * \param orientation
+		 *      Orientation of the object.
+		 * \param aabb
+		 *      Global AABB of the object.
+		 * \param collisionState
+		 *      Collision-state of the object (colour of the AABB).
+		 */
+		void applyTransformation(const osg::Vec3d &position, const osg::Quat &orientation, const osg::BoundingBox &aabb, int collisionState) override;
+
+
 		/**
 		 * \brief Update the direction and orientation of the space-ship.
 		 * 
@@ -135,10 +150,33 @@ namespace pbs17 {
 		 */
 		void decelerate();
 
+
+		/**
+		 * \brief Steer the space-ship continuously by the held controls over a time-step (called by the simulation,
+		 *        the OSG-nodes are written by the next sync).
+		 *
+		 * \param pitch
+		 *      Direction of the turn up (1) or down (-1), 0 => no turn.
+		 * \param yaw
+		 *      Direction of the turn left (1) or right (-1), 0 => no turn.
+		 * \param throttle
+		 *      Accelerate (1) or slow down (-1), 0 => same speed.
+		 * \param dt
+		 *      Time-step.
+		 */
+		void steer(int pitch, int yaw, int throttle, double dt);
+
 	private:
 
+		/**
+		 * \brief Move the emitter of the exhaust to the root-node of the particles (see GpuParticleSystem).
+		 */
+		void updateEmitter();
+
 		//! Root-node for the particles
 		osg::ref_ptr<osg::MatrixTransform> _particleRoot;
+		//! Emitter of the exhaust in the GpuParticleSystem (-1 => osgParticle-system)
+		int _emitter = -1;
 
 		//! Acceleration-factor
 		double _acceleration = 1.2;
@@ -146,6 +184,11 @@ namespace pbs17 {
 		double _decelerate = 0.8;
 		//! Rotation-angle
 		double _rotationAngle = 0.1; // randians ~ 5.7 degrees
+		//! Angular speed of the continuous steering (about the rotation-angle per key-repeat at 30 Hz): unit = rad/s
+		double _turnRate = 3.0;
+		//! Exponential rates of the speed-intensity of the continuous steering (the factors per key-repeat at 30 Hz): unit = 1/s
+		double _accelerationRate = 5.5;
+		double _decelerationRate = 6.7;
 		// Intensity
 		double intensity = 1.0;
 	};
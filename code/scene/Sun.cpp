@@ -11,10 +11,9 @@
 #include <osg/Material>
 #include <osg/LightSource>
 
-#include "../osg/visitors/ComputeTangentVisitor.h"
 #include "../config.h"
-#include "../osg/ImageManager.h"
-#include "../osg/shaders/SunShader.h"
+#include "../osg/MaterialCache.h"
+#include "../osg/OsgEigenConversions.h"
 
 
 using namespace pbs17;
@@ -42,7 +41,7 @@ Sun::Sun(double size)
  * \param j
  *      JSON-configuration for the planet.
  */
-Sun::Sun(json j)
+Sun::Sun(const json &j)
     : Planet(j) {
 	_lightId = LIGHT_ID;
 	++LIGHT_ID;
@@ -55,9 +54,13 @@ Sun::Sun(json j)
  * \param color
  *      Color of the light.
  *
- * \return Lightsource which can be added to the osg.
+ * \return Lightsource which can be added to the osg (nullptr in the headless-mode).
  */
 osg::ref_ptr<osg::LightSource> Sun::addLight(osg::Vec4 color) {
+	if (getIsHeadless()) {
+		return nullptr;
+	}
+
 	osg::Light *light = new osg::Light();
 
 	// each light must have a unique number
@@ -78,6 +81,12 @@ osg::ref_ptr<osg::LightSource> Sun::addLight(osg::Vec4 color) {
 	_transformation->addChild(lightSource);
 	_light = lightSource;
 
+	// the shaders only use the first light (see MaterialCache)
+	if (_lightId == 0) {
+		MaterialCache::Instance()->setLight(light->getAmbient(), light->getDiffuse(), light->getSpecular());
+		MaterialCache::Instance()->setLightPosition(toOsg(getPosition()));
+	}
+
 	return lightSource;
 }
 
@@ -86,36 +95,36 @@ osg::ref_ptr<osg::LightSource> Sun::addLight(osg::Vec4 color) {
  * \brief Initialize the texture-properties and shader.
  */
 void Sun::initTexturing() {
-	bool useBumpmap = _bumpmapName != "";
-	osg::ref_ptr<osg::StateSet> stateset = _convexRenderSwitch->getOrCreateStateSet();
-
-	// Apply bumpmap-shaders
-	ComputeTangentVisitor ctv;
-	ctv.setTraversalMode(osg::NodeVisitor::TRAVERSE_ALL_CHILDREN);
-	_modelFile->accept(ctv);
-
-	// Load the texture
-	if (_textureName != "") {
-		std::string texturePath = DATA_PATH + "/texture/" + _textureName;
-		osg::ref_ptr<osg::Texture2D> colorTex = ImageManager::Instance()->loadTexture(texturePath);
-
-		if (useBumpmap) {
-			std::string bumpmapPath = DATA_PATH + "/texture/" + _bumpmapName;
-			osg::ref_ptr<osg::Texture2D> normalTex = ImageManager::Instance()->loadTexture(bumpmapPath);
-
-			SunShader bumpmapShader(colorTex, normalTex);
-			bumpmapShader.apply(_convexRenderSwitch);
-		} else {
-			stateset->setTextureAttributeAndModes(0, colorTex.get(), osg::StateAttribute::ON | osg::StateAttribute::OVERRIDE);
-		}
+	if (getIsHeadless()) {
+		return;
 	}
 
-	// Define material-properties
-	osg::ref_ptr<osg::Material> material = new osg::Material();
-	material->setDiffuse(osg::Material::FRONT, osg::Vec4(1.0f, 1.0f, 1.0f, 1.0f));
-	material->setSpecular(osg::Material::FRONT, osg::Vec4(0.0f, 0.0f, 0.0f, 1.0f));
-	material->setAmbient(osg::Material::FRONT, osg::Vec4(0.1f, 0.1f, 0.1f, 1.0f));
-	material->setEmission(osg::Material::FRONT, osg::Vec4(0.0f, 0.0f, 0.0f, 1.0f));
-	material->setShininess(osg::Material::FRONT, 100);
-	stateset->setAttribute(material);
+	// the textures, the shader and the material are shared by all objects with the same textures
+	std::string texturePath = _textureName != "" ? DATA_PATH + "/texture/" + _textureName : "";
+	std::string bumpmapPath = _textureName != "" && _bumpmapName != "" ? DATA_PATH + "/texture/" + _bumpmapName : "";
+	_convexRenderSwitch->setStateSet(MaterialCache::Instance()->getStateSet(texturePath, bumpmapPath, MaterialCache::SUN));
+	// the sun-shader has no visual spin
+	initVisualSpin(false);
+}
+
+
+/**
+ * \brief Write the given state to the OSG-nodes (has to be called from the rendering-thread). The first sun
+ *        also moves the light of the shaders.
+ *
+ * \param position
+ *      Position of the object.
+ * \param orientation
+ *      Orientation of the object.
+ * \param aabb
+ *      Global AABB of the object.
+ * \param collisionState
+ *      Collision-state of the object (colour of the AABB).
+ */
+void Sun::applyTransformation(const osg::Vec3d &position, const osg::Quat &orientation, const osg::BoundingBox &aabb, int collisionState) {
+	Planet::applyTransformation(position, orientation, aabb, collisionState);
+
+	if (_lightId == 0 && _light.valid()) {
+		MaterialCache::Instance()->setLightPosition(position);
+	}
 }
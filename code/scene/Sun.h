@@ -31,7 +31,7 @@ namespace pbs17 {
          * \param j
          *      JSON-configuration for the planet.
          */
-        Sun(json j);
+        Sun(const json &j);
 
 
 		/**
@@ -40,7 +40,7 @@ namespace pbs17 {
 		 * \param color
 		 *      Color of the light.
 		 * 
-		 * \return Lightsource which can be added to the osg.
+		 * \return Lightsource which can be added to the osg (nullptr in the headless-mode).
 		 */
 		osg::ref_ptr<osg::LightSource> addLight(osg::Vec4 color);
 
@@ -51,6 +51,22 @@ namespace pbs17 {
 		void initTexturing() override;
 
 
+		/**
+		 * \brief Write the given state to the OSG-nodes (has to be called from the rendering-thread). The first sun
+		 *        also moves the light of the shaders.
+		 *
+		 * \param position
+		 *      Position of the object.
+		 * \param orientation
+		 *      Orientation of the object.
+		 * \param aabb
+		 *      Global AABB of the object.
+		 * \param collisionState
+		 *      Collision-state of the object (colour of the AABB).
+		 */
+		void applyTransformation(const osg::Vec3d &position, const osg::Quat &orientation, const osg::BoundingBox &aabb, int collisionState) override;
+
+
     private:
 		
 		//! Unique light id which is used for OpenGL.
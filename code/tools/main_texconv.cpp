@@ -0,0 +1,219 @@
+﻿/**
+ * \brief Starting point for the texture-converter: Bakes the textures of the data-directory into block-compressed
+ *        DDS-files with a full mip-chain (loaded instead of the images by the ImageManager).
+ *
+ * \Author: Alexander Lelidis, Andreas Emch, Uroš Tešić
+ * \Date:   2018-01-12
+ */
+
+#include <osg/Image>
+#include <osg/Texture>
+#include <osgDB/FileNameUtils>
+#include <osgDB/FileUtils>
+#include <osgDB/ImageProcessor>
+#include <osgDB/ReadFile>
+#include <osgDB/Registry>
+#include <osgDB/WriteFile>
+
+#include <boost/program_options.hpp>
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "../config.h"
+
+
+using namespace boost::program_options;
+
+
+namespace {
+
+	/**
+	 * \brief Check if the file is an image which is converted (jpg, png, tga).
+	 *
+	 * \param filePath
+	 *      Path to the file.
+	 *
+	 * \return True if the file is converted.
+	 */
+	bool isSourceImage(const std::string &filePath) {
+		std::string extension = osgDB::getLowerCaseFileExtension(filePath);
+
+		return extension == "jpg" || extension == "jpeg" || extension == "png" || extension == "tga";
+	}
+
+
+	/**
+	 * \brief Collect the images of a directory and its sub-directories (e.g. the faces of the skyboxes).
+	 *
+	 * \param directory
+	 *      Path to the directory.
+	 * \param files
+	 *      Output-parameter: Found images (appended).
+	 */
+	void collectImages(const std::string &directory, std::vector<std::string> &files) {
+		osgDB::DirectoryContents contents = osgDB::getDirectoryContents(directory);
+
+		for (unsigned int i = 0; i < contents.size(); ++i) {
+			if (contents[i] == "." || contents[i] == "..") continue;
+
+			std::string filePath = osgDB::concatPaths(directory, contents[i]);
+			if (osgDB::fileType(filePath) == osgDB::DIRECTORY) {
+				collectImages(filePath, files);
+			} else if (isSourceImage(filePath)) {
+				files.push_back(filePath);
+			}
+		}
+	}
+
+
+	/**
+	 * \brief Check if any pixel of the image is not opaque.
+	 *
+	 * \param image
+	 *      Uncompressed image.
+	 *
+	 * \return True if the alpha-channel is used.
+	 */
+	bool hasAlpha(const osg::Image &image) {
+		if (image.getPixelFormat() != GL_RGBA && image.getPixelFormat() != GL_BGRA) return false;
+
+		for (int t = 0; t < image.t(); ++t) {
+			for (int s = 0; s < image.s(); ++s) {
+				if (image.getColor(s, t).a() < 1.0f) return true;
+			}
+		}
+
+		return false;
+	}
+
+
+	/**
+	 * \brief Choose the block-compression of an image: BC5 for the normal-maps (x and y, z is reconstructed by the
+	 *        shaders), BC3 if the alpha-channel is used, otherwise BC1.
+	 *
+	 * \param filePath
+	 *      Path to the image.
+	 * \param image
+	 *      Uncompressed image.
+	 *
+	 * \return Compression of the image.
+	 */
+	osg::Texture::InternalFormatMode chooseCompression(const std::string &filePath, const osg::Image &image) {
+		if (osgDB::getSimpleFileName(filePath).find("normal") != std::string::npos) {
+			return osg::Texture::USE_RGTC2_COMPRESSION;
+		}
+
+		return hasAlpha(image) ? osg::Texture::USE_S3TC_DXT5_COMPRESSION : osg::Texture::USE_S3TC_DXT1_COMPRESSION;
+	}
+
+
+	/**
+	 * \brief Get the name of a compression for the report.
+	 *
+	 * \param compression
+	 *      Compression of the image.
+	 *
+	 * \return Name of the block-compression.
+	 */
+	const char* getCompressionName(osg::Texture::InternalFormatMode compression) {
+		switch (compression) {
+		case osg::Texture::USE_RGTC2_COMPRESSION:
+			return "BC5";
+		case osg::Texture::USE_S3TC_DXT5_COMPRESSION:
+			return "BC3";
+		default:
+			return "BC1";
+		}
+	}
+}
+
+
+int main(int argc, const char *argv[]) {
+	variables_map vm;
+
+	options_description desc{ "Options" };
+	desc.add_options()
+		("help,h", "Help screen")
+		("input,i", value<std::vector<std::string>>(), "Images or directories to convert (default: the textures and skyboxes of the data-directory)")
+		("force", value<bool>()->default_value(false), "Convert the images again even if their DDS-file exists")
+		("quality", value<std::string>()->default_value("production"), "Quality of the compression (fastest, normal, production, highest)");
+
+	try {
+		store(parse_command_line(argc, argv, desc), vm);
+		notify(vm);
+	}
+	catch (const error &ex) {
+		std::cerr << ex.what() << '\n';
+		return 1;
+	}
+
+	if (vm.count("help")) {
+		std::cout << desc << '\n';
+		return 0;
+	}
+
+	// the compression and the mip-maps are computed on the CPU by the plugin (without an OpenGL-context)
+	osgDB::ImageProcessor* processor = osgDB::Registry::instance()->getImageProcessor();
+	if (!processor) {
+		std::cerr << "No image-processor found, the converter needs the nvtt-plugin of OSG (osgdb_nvtt)!" << '\n';
+		return 1;
+	}
+
+	std::string qualityName = vm["quality"].as<std::string>();
+	osgDB::ImageProcessor::CompressionQuality quality = osgDB::ImageProcessor::PRODUCTION;
+	if (qualityName == "fastest") {
+		quality = osgDB::ImageProcessor::FASTEST;
+	} else if (qualityName == "normal") {
+		quality = osgDB::ImageProcessor::NORMAL;
+	} else if (qualityName == "highest") {
+		quality = osgDB::ImageProcessor::HIGHEST;
+	}
+
+	std::vector<std::string> inputs = vm.count("input") ? vm["input"].as<std::vector<std::string>>() :
+		std::vector<std::string>{ DATA_PATH + "/texture", DATA_PATH + "/skyBox" };
+	std::vector<std::string> files;
+	for (unsigned int i = 0; i < inputs.size(); ++i) {
+		if (osgDB::fileType(inputs[i]) == osgDB::DIRECTORY) {
+			collectImages(inputs[i], files);
+		} else if (isSourceImage(inputs[i])) {
+			files.push_back(inputs[i]);
+		}
+	}
+
+	bool isForced = vm["force"].as<bool>();
+	int cntFailed = 0;
+	for (unsigned int i = 0; i < files.size(); ++i) {
+		std::string outputPath = osgDB::getNameLessExtension(files[i]) + ".dds";
+
+		if (!isForced && osgDB::fileExists(outputPath)) {
+			std::cout << outputPath << ": exists (convert it again with --force true)" << std::endl;
+			continue;
+		}
+
+		osg::ref_ptr<osg::Image> image = osgDB::readImageFile(files[i]);
+		if (!image) {
+			std::cerr << files[i] << ": can't be read!" << '\n';
+			++cntFailed;
+			continue;
+		}
+
+		// the images are uploaded as they are => power-of-two sizes with the whole mip-chain
+		osg::Texture::InternalFormatMode compression = chooseCompression(files[i], *image);
+		unsigned int uncompressedSize = image->getTotalSizeInBytes();
+		processor->compress(*image, compression, true, true, osgDB::ImageProcessor::USE_CPU, quality);
+
+		if (!image->isCompressed() || !osgDB::writeImageFile(*image, outputPath)) {
+			std::cerr << outputPath << ": can't be written!" << '\n';
+			++cntFailed;
+			continue;
+		}
+
+		std::cout << outputPath << ": " << getCompressionName(compression) << ", " << image->s() << "x" << image->t()
+			<< ", " << image->getNumMipmapLevels() << " levels, " << uncompressedSize / 1024 << " KiB => "
+			<< image->getTotalSizeInBytesIncludingMipmaps() / 1024 << " KiB" << std::endl;
+	}
+
+	return cntFailed > 0 ? 1 : 0;
+}